@@ -29,6 +29,7 @@
 #include "format-table.h"
 #include "glob-util.h"
 #include "hashmap.h"
+#include "json.h"
 #include "locale-util.h"
 #include "log.h"
 #include "main-func.h"
@@ -82,6 +83,7 @@ static const char *arg_host = NULL;
 static UnitFileScope arg_scope = UNIT_FILE_SYSTEM;
 static bool arg_man = true;
 static bool arg_generators = false;
+static bool arg_stats = false;
 static const char *arg_root = NULL;
 static unsigned arg_iterations = 1;
 static usec_t arg_base_time = USEC_INFINITY;
@@ -131,6 +133,7 @@ struct unit_times {
         usec_t deactivated;
         usec_t deactivating;
         usec_t time;
+        char **after; /* NULL if the manager doesn't support ListUnitTimes() */
 };
 
 struct host_info {
@@ -213,8 +216,10 @@ static int compare_unit_start(const struct unit_times *a, const struct unit_time
 static void unit_times_free(struct unit_times *t) {
         struct unit_times *p;
 
-        for (p = t; p->has_data; p++)
+        for (p = t; p->has_data; p++) {
                 free(p->name);
+                strv_free(p->after);
+        }
         free(t);
 }
 
@@ -329,6 +334,113 @@ static void free_host_info(struct host_info *hi) {
 
 DEFINE_TRIVIAL_CLEANUP_FUNC(struct host_info *, free_host_info);
 
+static void unit_times_fixup(struct unit_times *t, const struct boot_times *boot_times) {
+        assert(t);
+        assert(boot_times);
+
+        subtract_timestamp(&t->activating, boot_times->reverse_offset);
+        subtract_timestamp(&t->activated, boot_times->reverse_offset);
+        subtract_timestamp(&t->deactivating, boot_times->reverse_offset);
+        subtract_timestamp(&t->deactivated, boot_times->reverse_offset);
+
+        if (t->activated >= t->activating)
+                t->time = t->activated - t->activating;
+        else if (t->deactivated >= t->activating)
+                t->time = t->deactivated - t->activating;
+        else
+                t->time = 0;
+}
+
+static int acquire_time_data_bulk(sd_bus *bus, const struct boot_times *boot_times, struct unit_times **out) {
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
+        _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
+        _cleanup_(unit_times_freep) struct unit_times *unit_times = NULL;
+        size_t allocated = 0, c = 0;
+        int r;
+
+        /* Gets the timestamps and ordering dependencies of all units in a single call, rather than
+         * querying the properties of each unit individually. Returns -EOPNOTSUPP if the manager is too old
+         * to know the method. */
+
+        r = sd_bus_call_method(
+                        bus,
+                        "org.freedesktop.systemd1",
+                        "/org/freedesktop/systemd1",
+                        "org.freedesktop.systemd1.Manager",
+                        "ListUnitTimes",
+                        &error, &reply,
+                        NULL);
+        if (r < 0) {
+                if (sd_bus_error_has_name(&error, SD_BUS_ERROR_UNKNOWN_METHOD))
+                        return -EOPNOTSUPP;
+
+                return log_error_errno(r, "Failed to list unit times: %s", bus_error_message(&error, r));
+        }
+
+        r = sd_bus_message_enter_container(reply, SD_BUS_TYPE_ARRAY, "(sttttas)");
+        if (r < 0)
+                return bus_log_parse_error(r);
+
+        for (;;) {
+                _cleanup_strv_free_ char **after = NULL;
+                struct unit_times *t;
+                const char *id;
+
+                if (!GREEDY_REALLOC(unit_times, allocated, c + 2))
+                        return log_oom();
+
+                unit_times[c + 1].has_data = false;
+                t = &unit_times[c];
+                t->name = NULL;
+                t->after = NULL;
+
+                assert_cc(sizeof(usec_t) == sizeof(uint64_t));
+
+                r = sd_bus_message_enter_container(reply, SD_BUS_TYPE_STRUCT, "sttttas");
+                if (r < 0)
+                        return bus_log_parse_error(r);
+                if (r == 0)
+                        break;
+
+                r = sd_bus_message_read(reply, "stttt",
+                                        &id,
+                                        &t->activating,
+                                        &t->activated,
+                                        &t->deactivating,
+                                        &t->deactivated);
+                if (r < 0)
+                        return bus_log_parse_error(r);
+
+                r = sd_bus_message_read_strv(reply, &after);
+                if (r < 0)
+                        return bus_log_parse_error(r);
+
+                r = sd_bus_message_exit_container(reply);
+                if (r < 0)
+                        return bus_log_parse_error(r);
+
+                unit_times_fixup(t, boot_times);
+
+                if (t->activating == 0)
+                        continue;
+
+                t->name = strdup(id);
+                if (!t->name)
+                        return log_oom();
+
+                t->after = TAKE_PTR(after);
+                t->has_data = true;
+                c++;
+        }
+
+        r = sd_bus_message_exit_container(reply);
+        if (r < 0)
+                return bus_log_parse_error(r);
+
+        *out = TAKE_PTR(unit_times);
+        return c;
+}
+
 static int acquire_time_data(sd_bus *bus, struct unit_times **out) {
         static const struct bus_properties_map property_map[] = {
                 { "InactiveExitTimestampMonotonic",  "t", NULL, offsetof(struct unit_times, activating)   },
@@ -349,6 +461,12 @@ static int acquire_time_data(sd_bus *bus, struct unit_times **out) {
         if (r < 0)
                 return r;
 
+        r = acquire_time_data_bulk(bus, boot_times, out);
+        if (r != -EOPNOTSUPP)
+                return r;
+
+        /* Fall back to querying the units one by one */
+
         r = sd_bus_call_method(
                         bus,
                         "org.freedesktop.systemd1",
@@ -373,6 +491,7 @@ static int acquire_time_data(sd_bus *bus, struct unit_times **out) {
                 unit_times[c + 1].has_data = false;
                 t = &unit_times[c];
                 t->name = NULL;
+                t->after = NULL;
 
                 assert_cc(sizeof(usec_t) == sizeof(uint64_t));
 
@@ -389,17 +508,7 @@ static int acquire_time_data(sd_bus *bus, struct unit_times **out) {
                         return log_error_errno(r, "Failed to get timestamp properties of unit %s: %s",
                                                u.id, bus_error_message(&error, r));
 
-                subtract_timestamp(&t->activating, boot_times->reverse_offset);
-                subtract_timestamp(&t->activated, boot_times->reverse_offset);
-                subtract_timestamp(&t->deactivating, boot_times->reverse_offset);
-                subtract_timestamp(&t->deactivated, boot_times->reverse_offset);
-
-                if (t->activated >= t->activating)
-                        t->time = t->activated - t->activating;
-                else if (t->deactivated >= t->activating)
-                        t->time = t->deactivated - t->activating;
-                else
-                        t->time = 0;
+                unit_times_fixup(t, boot_times);
 
                 if (t->activating == 0)
                         continue;
@@ -868,13 +977,26 @@ static int list_dependencies_print(
         return 0;
 }
 
+static Hashmap *unit_times_hashmap;
+
 static int list_dependencies_get_dependencies(sd_bus *bus, const char *name, char ***deps) {
         _cleanup_free_ char *path = NULL;
+        struct unit_times *times;
 
         assert(bus);
         assert(name);
         assert(deps);
 
+        /* Use the dependencies we got along with the timestamps if we have them, to save a round trip */
+        times = hashmap_get(unit_times_hashmap, name);
+        if (times && times->after) {
+                *deps = strv_copy(times->after);
+                if (!*deps)
+                        return log_oom();
+
+                return 0;
+        }
+
         path = unit_dbus_path_from_name(name);
         if (!path)
                 return -ENOMEM;
@@ -882,8 +1004,6 @@ static int list_dependencies_get_dependencies(sd_bus *bus, const char *name, cha
         return bus_get_unit_property_strv(bus, path, "After", deps);
 }
 
-static Hashmap *unit_times_hashmap;
-
 static int list_dependencies_compare(char *const *a, char *const *b) {
         usec_t usa = 0, usb = 0;
         struct unit_times *times;
@@ -1023,6 +1143,180 @@ static int list_dependencies(sd_bus *bus, const char *name) {
         return list_dependencies_one(bus, name, 0, &units, 0);
 }
 
+/* Thread ids used in the trace, so that the manager's own work and the unit activations are shown as
+ * separate tracks */
+#define TRACE_TID_MANAGER 1
+#define TRACE_TID_UNITS 2
+
+static int trace_append(JsonVariant ***events, size_t *n_events, size_t *n_allocated, JsonVariant *v) {
+        if (!GREEDY_REALLOC(*events, *n_allocated, *n_events + 1)) {
+                json_variant_unref(v);
+                return log_oom();
+        }
+
+        (*events)[(*n_events)++] = v;
+        return 0;
+}
+
+static int trace_add_event(
+                JsonVariant ***events,
+                size_t *n_events,
+                size_t *n_allocated,
+                const char *name,
+                const char *category,
+                int tid,
+                long double ts,
+                long double dur) {
+
+        JsonVariant *v = NULL;
+        int r;
+
+        /* The Trace Event Format, as understood by chrome://tracing and Perfetto, with times in µs */
+        r = json_build(&v, JSON_BUILD_OBJECT(
+                                       JSON_BUILD_PAIR("name", JSON_BUILD_STRING(name)),
+                                       JSON_BUILD_PAIR("cat", JSON_BUILD_STRING(category)),
+                                       JSON_BUILD_PAIR("ph", JSON_BUILD_STRING("X")),
+                                       JSON_BUILD_PAIR("ts", JSON_BUILD_REAL(ts)),
+                                       JSON_BUILD_PAIR("dur", JSON_BUILD_REAL(dur)),
+                                       JSON_BUILD_PAIR("pid", JSON_BUILD_INTEGER(1)),
+                                       JSON_BUILD_PAIR("tid", JSON_BUILD_INTEGER(tid))));
+        if (r < 0)
+                return log_error_errno(r, "Failed to build trace event: %m");
+
+        return trace_append(events, n_events, n_allocated, v);
+}
+
+static int trace_add_thread_name(
+                JsonVariant ***events,
+                size_t *n_events,
+                size_t *n_allocated,
+                int tid,
+                const char *name) {
+
+        JsonVariant *v = NULL;
+        int r;
+
+        r = json_build(&v, JSON_BUILD_OBJECT(
+                                       JSON_BUILD_PAIR("name", JSON_BUILD_STRING("thread_name")),
+                                       JSON_BUILD_PAIR("ph", JSON_BUILD_STRING("M")),
+                                       JSON_BUILD_PAIR("pid", JSON_BUILD_INTEGER(1)),
+                                       JSON_BUILD_PAIR("tid", JSON_BUILD_INTEGER(tid)),
+                                       JSON_BUILD_PAIR("args", JSON_BUILD_OBJECT(
+                                                                       JSON_BUILD_PAIR("name", JSON_BUILD_STRING(name))))));
+        if (r < 0)
+                return log_error_errno(r, "Failed to build trace event: %m");
+
+        return trace_append(events, n_events, n_allocated, v);
+}
+
+static int analyze_trace(int argc, char *argv[], void *userdata) {
+        _cleanup_(sd_bus_flush_close_unrefp) sd_bus *bus = NULL;
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
+        _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
+        _cleanup_(unit_times_freep) struct unit_times *times = NULL;
+        _cleanup_(json_variant_unrefp) JsonVariant *array = NULL, *v = NULL;
+        JsonVariant **events = NULL;
+        size_t n_events = 0, n_allocated = 0;
+        const char *phase, *subject;
+        struct boot_times *boot;
+        uint64_t start, duration;
+        struct unit_times *u;
+        long double offset;
+        int n, r;
+
+        r = acquire_bus(&bus, NULL);
+        if (r < 0)
+                return log_error_errno(r, "Failed to create bus connection: %m");
+
+        r = acquire_boot_times(bus, &boot);
+        if (r < 0)
+                return r;
+
+        /* Unit timestamps are shifted by the time before userspace when running in a container, shift the
+         * manager's own trace the same way, so that both line up */
+        offset = (long double) boot->reverse_offset;
+
+        r = sd_bus_call_method(
+                        bus,
+                        "org.freedesktop.systemd1",
+                        "/org/freedesktop/systemd1",
+                        "org.freedesktop.systemd1.Manager",
+                        "DumpTrace",
+                        &error,
+                        &reply,
+                        NULL);
+        if (r < 0)
+                return log_error_errno(r, "Failed to issue method call DumpTrace: %s", bus_error_message(&error, r));
+
+        r = trace_add_thread_name(&events, &n_events, &n_allocated, TRACE_TID_MANAGER, "manager");
+        if (r < 0)
+                goto finish;
+
+        r = trace_add_thread_name(&events, &n_events, &n_allocated, TRACE_TID_UNITS, "units");
+        if (r < 0)
+                goto finish;
+
+        r = sd_bus_message_enter_container(reply, SD_BUS_TYPE_ARRAY, "(sstt)");
+        if (r < 0) {
+                r = bus_log_parse_error(r);
+                goto finish;
+        }
+
+        while ((r = sd_bus_message_read(reply, "(sstt)", &phase, &subject, &start, &duration)) > 0) {
+                r = trace_add_event(&events, &n_events, &n_allocated,
+                                    isempty(subject) ? phase : subject,
+                                    phase,
+                                    TRACE_TID_MANAGER,
+                                    (long double) start / NSEC_PER_USEC - offset,
+                                    (long double) duration / NSEC_PER_USEC);
+                if (r < 0)
+                        goto finish;
+        }
+        if (r < 0) {
+                r = bus_log_parse_error(r);
+                goto finish;
+        }
+
+        n = acquire_time_data(bus, &times);
+        if (n < 0) {
+                r = n;
+                goto finish;
+        }
+
+        for (u = times; u && u->has_data; u++) {
+                r = trace_add_event(&events, &n_events, &n_allocated,
+                                    u->name,
+                                    "unit",
+                                    TRACE_TID_UNITS,
+                                    (long double) u->activating,
+                                    (long double) u->time);
+                if (r < 0)
+                        goto finish;
+        }
+
+        r = json_variant_new_array(&array, events, n_events);
+        if (r < 0) {
+                log_error_errno(r, "Failed to build trace event array: %m");
+                goto finish;
+        }
+
+        r = json_build(&v, JSON_BUILD_OBJECT(
+                                       JSON_BUILD_PAIR("traceEvents", JSON_BUILD_VARIANT(array)),
+                                       JSON_BUILD_PAIR("displayTimeUnit", JSON_BUILD_STRING("ms"))));
+        if (r < 0) {
+                log_error_errno(r, "Failed to build trace: %m");
+                goto finish;
+        }
+
+        json_variant_dump(v, JSON_FORMAT_NEWLINE, stdout, NULL);
+        r = 0;
+
+finish:
+        json_variant_unref_many(events, n_events);
+        free(events);
+        return r;
+}
+
 static int analyze_critical_chain(int argc, char *argv[], void *userdata) {
         _cleanup_(sd_bus_flush_close_unrefp) sd_bus *bus = NULL;
         _cleanup_(unit_times_freep) struct unit_times *times = NULL;
@@ -1356,6 +1650,57 @@ static int dump_fallback(sd_bus *bus) {
         return 0;
 }
 
+static int dump_stats(sd_bus *bus) {
+        _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
+        _cleanup_(table_unrefp) Table *table = NULL;
+        const char *name;
+        uint64_t value;
+        int r;
+
+        assert(bus);
+
+        r = sd_bus_call_method(
+                        bus,
+                        "org.freedesktop.systemd1",
+                        "/org/freedesktop/systemd1",
+                        "org.freedesktop.systemd1.Manager",
+                        "GetStatistics",
+                        &error,
+                        &reply,
+                        NULL);
+        if (r < 0)
+                return log_error_errno(r, "Failed to issue method call GetStatistics: %s", bus_error_message(&error, r));
+
+        table = table_new("name", "value");
+        if (!table)
+                return log_oom();
+
+        r = table_set_align_percent(table, table_get_cell(table, 0, 1), 100);
+        if (r < 0)
+                return log_error_errno(r, "Failed to right-align value: %m");
+
+        r = sd_bus_message_enter_container(reply, SD_BUS_TYPE_ARRAY, "(st)");
+        if (r < 0)
+                return bus_log_parse_error(r);
+
+        while ((r = sd_bus_message_read(reply, "(st)", &name, &value)) > 0) {
+                r = table_add_many(table,
+                                   TABLE_STRING, name,
+                                   TABLE_UINT64, value);
+                if (r < 0)
+                        return log_error_errno(r, "Failed to add row to table: %m");
+        }
+        if (r < 0)
+                return bus_log_parse_error(r);
+
+        r = sd_bus_message_exit_container(reply);
+        if (r < 0)
+                return bus_log_parse_error(r);
+
+        return table_print(table, NULL);
+}
+
 static int dump(int argc, char *argv[], void *userdata) {
         _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
         _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
@@ -1369,6 +1714,9 @@ static int dump(int argc, char *argv[], void *userdata) {
 
         (void) pager_open(arg_pager_flags);
 
+        if (arg_stats)
+                return dump_stats(bus);
+
         if (!sd_bus_can_send(bus, SD_BUS_TYPE_UNIX_FD))
                 return dump_fallback(bus);
 
@@ -2247,6 +2595,8 @@ static int help(int argc, char *argv[], void *userdata) {
                "  blame                    Print list of running units ordered by time to init\n"
                "  critical-chain [UNIT...] Print a tree of the time critical chain of units\n"
                "  plot                     Output SVG graphic showing service initialization\n"
+               "  trace                    Output trace of the service manager's work and of\n"
+               "                           service initialization as JSON\n"
                "  dot [UNIT...]            Output dependency graph in %s format\n"
                "  dump                     Output state serialization of service manager\n"
                "  cat-config               Show configuration file and drop-ins\n"
@@ -2279,6 +2629,7 @@ static int help(int argc, char *argv[], void *userdata) {
                "     --generators[=BOOL]   Do [not] run unit generators (requires privileges)\n"
                "     --iterations=N        Show the specified number of iterations\n"
                "     --base-time=TIMESTAMP Calculate calendar times relative to specified time\n"
+               "     --stats               Make \"dump\" show counters instead of the state\n"
                "\nSee the %s for details.\n"
                , program_invocation_short_name
                , ansi_highlight()
@@ -2310,6 +2661,7 @@ static int parse_argv(int argc, char *argv[]) {
                 ARG_GENERATORS,
                 ARG_ITERATIONS,
                 ARG_BASE_TIME,
+                ARG_STATS,
         };
 
         static const struct option options[] = {
@@ -2331,6 +2683,7 @@ static int parse_argv(int argc, char *argv[]) {
                 { "machine",      required_argument, NULL, 'M'                  },
                 { "iterations",   required_argument, NULL, ARG_ITERATIONS       },
                 { "base-time",    required_argument, NULL, ARG_BASE_TIME        },
+                { "stats",        no_argument,       NULL, ARG_STATS            },
                 {}
         };
 
@@ -2444,6 +2797,10 @@ static int parse_argv(int argc, char *argv[]) {
 
                         break;
 
+                case ARG_STATS:
+                        arg_stats = true;
+                        break;
+
                 case '?':
                         return -EINVAL;
 
@@ -2475,6 +2832,7 @@ static int run(int argc, char *argv[]) {
                 { "blame",             VERB_ANY, 1,        0,            analyze_blame          },
                 { "critical-chain",    VERB_ANY, VERB_ANY, 0,            analyze_critical_chain },
                 { "plot",              VERB_ANY, 1,        0,            analyze_plot           },
+                { "trace",             VERB_ANY, 1,        0,            analyze_trace          },
                 { "dot",               VERB_ANY, VERB_ANY, 0,            dot                    },
                 /* The following seven verbs are deprecated */
                 { "log-level",         VERB_ANY, 2,        0,            get_or_set_log_level   },
@@ -0,0 +1,164 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "alloc-util.h"
+#include "arena.h"
+#include "memory-util.h"
+
+/* Chunks grow with the arena, up to this size. Allocations larger than a quarter of it get a chunk of their
+ * own. */
+#define ARENA_CHUNK_SIZE_MIN (4U * 1024U)
+#define ARENA_CHUNK_SIZE_MAX (256U * 1024U)
+
+struct ArenaChunk {
+        ArenaChunk *next;
+        size_t size;   /* usable bytes in data */
+        size_t used;
+        size_t last;   /* offset of the most recent allocation, for arena_realloc() */
+        uint8_t data[] _alignas_(void*);
+};
+
+void arena_done(Arena *a) {
+        ArenaChunk *c;
+
+        assert(a);
+
+        while ((c = a->chunks)) {
+                a->chunks = c->next;
+                free(c);
+        }
+
+        a->n_allocated = 0;
+}
+
+static ArenaChunk *arena_add_chunk(Arena *a, size_t size) {
+        ArenaChunk *c;
+
+        if (size > SIZE_MAX - offsetof(ArenaChunk, data))
+                return NULL;
+
+        c = malloc(offsetof(ArenaChunk, data) + size);
+        if (!c)
+                return NULL;
+
+        *c = (ArenaChunk) {
+                .size = size,
+        };
+
+        a->n_allocated += size;
+        return c;
+}
+
+void *arena_alloc(Arena *a, size_t size) {
+        ArenaChunk *c;
+        size_t n;
+
+        assert(a);
+
+        size = ALIGN(MAX(size, 1U));
+        if (size == 0) /* overflow */
+                return NULL;
+
+        c = a->chunks;
+        if (c && c->size - c->used >= size) {
+                c->last = c->used;
+                c->used += size;
+                return c->data + c->last;
+        }
+
+        if (size > ARENA_CHUNK_SIZE_MAX / 4) {
+                /* Large allocations get a chunk of their own, which is queued behind the current one, so
+                 * that the free space left in that is still used. */
+                c = arena_add_chunk(a, size);
+                if (!c)
+                        return NULL;
+
+                c->used = size;
+
+                if (a->chunks) {
+                        c->next = a->chunks->next;
+                        a->chunks->next = c;
+                } else
+                        a->chunks = c;
+
+                return c->data;
+        }
+
+        /* Grow the chunk size with the arena, so that the number of chunks stays logarithmic */
+        n = CLAMP(a->n_allocated, (size_t) ARENA_CHUNK_SIZE_MIN, (size_t) ARENA_CHUNK_SIZE_MAX);
+
+        c = arena_add_chunk(a, n);
+        if (!c)
+                return NULL;
+
+        c->used = size;
+        c->next = a->chunks;
+        a->chunks = c;
+
+        return c->data;
+}
+
+void *arena_alloc0(Arena *a, size_t size) {
+        void *p;
+
+        p = arena_alloc(a, size);
+        if (p)
+                memzero(p, size);
+
+        return p;
+}
+
+void *arena_realloc(Arena *a, void *p, size_t old_size, size_t new_size) {
+        ArenaChunk *c;
+        void *q;
+
+        assert(a);
+
+        if (!p)
+                return arena_alloc(a, new_size);
+
+        c = a->chunks;
+        if (c && (uint8_t*) p == c->data + c->last) {
+                size_t n = ALIGN(MAX(new_size, 1U));
+
+                /* The most recent allocation, grow or shrink it in place if it fits */
+                if (n != 0 && n <= c->size - c->last) {
+                        c->used = c->last + n;
+                        return p;
+                }
+        }
+
+        if (new_size <= old_size)
+                return p;
+
+        q = arena_alloc(a, new_size);
+        if (!q)
+                return NULL;
+
+        return memcpy(q, p, old_size);
+}
+
+char *arena_strndup(Arena *a, const char *s, size_t n) {
+        char *p;
+
+        assert(a);
+        assert(s);
+
+        n = strnlen(s, n);
+
+        p = arena_alloc(a, n + 1);
+        if (!p)
+                return NULL;
+
+        memcpy(p, s, n);
+        p[n] = 0;
+
+        return p;
+}
+
+char *arena_strdup(Arena *a, const char *s) {
+        return arena_strndup(a, s, SIZE_MAX);
+}
@@ -0,0 +1,29 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+#pragma once
+
+#include <stddef.h>
+
+#include "macro.h"
+
+/* A simple bump allocator for short-lived data, for example the strings of a file that is parsed and
+ * discarded again. Allocations are carved out of larger chunks and can't be freed individually, all of them
+ * are released at once with arena_done(). Initialize with "Arena a = {};". */
+
+typedef struct ArenaChunk ArenaChunk;
+
+typedef struct Arena {
+        ArenaChunk *chunks; /* the chunk allocations are made from, followed by the older ones */
+        size_t n_allocated; /* total size of all chunks */
+} Arena;
+
+void arena_done(Arena *a);
+
+void *arena_alloc(Arena *a, size_t size);
+void *arena_alloc0(Arena *a, size_t size);
+
+/* Changes the size of an allocation. This happens in place if p was the last allocation made from the
+ * arena, otherwise a new one is made and the data copied. The old size must be passed in. */
+void *arena_realloc(Arena *a, void *p, size_t old_size, size_t new_size);
+
+char *arena_strndup(Arena *a, const char *s, size_t n);
+char *arena_strdup(Arena *a, const char *s);
@@ -99,37 +99,35 @@ int cg_read_event(
         if (r < 0)
                 return r;
 
-        r = read_full_file(events, &content, NULL);
+        /* This is called for every inotify event on cgroup.events, hence read it with a single read() and
+         * parse it in place, rather than going through stdio and allocating every line. */
+        r = read_full_virtual_file(events, &content, NULL);
         if (r < 0)
                 return r;
 
-        for (const char *p = content;;) {
-                _cleanup_free_ char *line = NULL, *key = NULL, *val = NULL;
-                const char *q;
+        for (const char *p = content; *p;) {
+                const char *q, *eol;
 
-                r = extract_first_word(&p, &line, "\n", 0);
-                if (r < 0)
-                        return r;
-                if (r == 0)
-                        return -ENOENT;
+                eol = strchrnul(p, '\n');
 
-                q = line;
-                r = extract_first_word(&q, &key, " ", 0);
-                if (r < 0)
-                        return r;
-                if (r == 0)
-                        return -EINVAL;
+                q = startswith(p, event);
+                if (q && *q == ' ') {
+                        char *val;
 
-                if (!streq(key, event))
-                        continue;
+                        q += strspn(q, " ");
 
-                val = strdup(q);
-                if (!val)
-                        return -ENOMEM;
+                        val = strndup(q, eol - q);
+                        if (!val)
+                                return -ENOMEM;
 
-                *ret = TAKE_PTR(val);
-                return 0;
+                        *ret = val;
+                        return 0;
+                }
+
+                p = *eol ? eol + 1 : eol;
         }
+
+        return -ENOENT;
 }
 
 bool cg_ns_supported(void) {
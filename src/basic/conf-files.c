@@ -5,6 +5,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "alloc-util.h"
 #include "conf-files.h"
 #include "def.h"
 #include "dirent-util.h"
@@ -19,25 +20,84 @@
 #include "string-util.h"
 #include "strv.h"
 #include "terminal-util.h"
+#include "time-util.h"
 
-static int files_add(
-                Hashmap *h,
-                Set *masked,
-                const char *suffix,
-                const char *root,
-                unsigned flags,
-                const char *path) {
+/* Directory listings are only trusted if the directory wasn't modified within this time before it was read,
+ * since a later modification might not change the mtime if it happens within the timestamp granularity. */
+#define CONF_FILES_CACHE_MIN_AGE_USEC USEC_PER_SEC
+
+typedef struct ConfFilesCacheEntry {
+        char *path;
+        char **names;
+
+        dev_t dev;
+        ino_t ino;
+        nsec_t mtime;
+        bool trusted;
+} ConfFilesCacheEntry;
+
+struct ConfFilesCache {
+        Hashmap *entries;
+};
+
+static ConfFilesCacheEntry* conf_files_cache_entry_free(ConfFilesCacheEntry *e) {
+        if (!e)
+                return NULL;
+
+        free(e->path);
+        strv_free(e->names);
+        return mfree(e);
+}
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(ConfFilesCacheEntry*, conf_files_cache_entry_free);
+
+DEFINE_PRIVATE_HASH_OPS_WITH_VALUE_DESTRUCTOR(conf_files_cache_hash_ops, char, path_hash_func, path_compare,
+                                              ConfFilesCacheEntry, conf_files_cache_entry_free);
+
+ConfFilesCache* conf_files_cache_new(void) {
+        return new0(ConfFilesCache, 1);
+}
+
+ConfFilesCache* conf_files_cache_free(ConfFilesCache *c) {
+        if (!c)
+                return NULL;
+
+        hashmap_free(c->entries);
+        return mfree(c);
+}
 
+static int conf_files_cache_get(ConfFilesCache *c, const char *dirpath, char ***ret) {
+        _cleanup_(conf_files_cache_entry_freep) ConfFilesCacheEntry *n = NULL;
         _cleanup_closedir_ DIR *dir = NULL;
-        const char *dirpath;
+        ConfFilesCacheEntry *e;
         struct dirent *de;
+        struct stat st;
         int r;
 
-        assert(h);
-        assert((flags & CONF_FILES_FILTER_MASKED) == 0 || masked);
-        assert(path);
+        assert(c);
+        assert(dirpath);
+        assert(ret);
 
-        dirpath = prefix_roota(root, path);
+        /* Returns the names of the entries of the directory, as FOREACH_DIRENT() would list them. Returns 0 if
+         * the directory doesn't exist. The returned list is owned by the cache. */
+
+        e = hashmap_get(c->entries, dirpath);
+        if (e) {
+                if (stat(dirpath, &st) < 0) {
+                        if (errno == ENOENT)
+                                return 0;
+
+                        return log_debug_errno(errno, "Failed to stat directory '%s': %m", dirpath);
+                }
+
+                if (e->trusted &&
+                    st.st_dev == e->dev &&
+                    st.st_ino == e->ino &&
+                    timespec_load_nsec(&st.st_mtim) == e->mtime) {
+                        *ret = e->names;
+                        return 1;
+                }
+        }
 
         dir = opendir(dirpath);
         if (!dir) {
@@ -47,85 +107,190 @@ static int files_add(
                 return log_debug_errno(errno, "Failed to open directory '%s': %m", dirpath);
         }
 
+        /* Take the timestamp before reading, so that changes while we read invalidate the listing */
+        if (fstat(dirfd(dir), &st) < 0)
+                return log_debug_errno(errno, "Failed to stat directory '%s': %m", dirpath);
+
+        n = new(ConfFilesCacheEntry, 1);
+        if (!n)
+                return -ENOMEM;
+
+        *n = (ConfFilesCacheEntry) {
+                .dev = st.st_dev,
+                .ino = st.st_ino,
+                .mtime = timespec_load_nsec(&st.st_mtim),
+                .trusted = timespec_load(&st.st_mtim) + CONF_FILES_CACHE_MIN_AGE_USEC < now(CLOCK_REALTIME),
+        };
+
+        n->path = strdup(dirpath);
+        if (!n->path)
+                return -ENOMEM;
+
         FOREACH_DIRENT(de, dir, return -errno) {
-                struct stat st;
-                char *p, *key;
+                r = strv_extend(&n->names, de->d_name);
+                if (r < 0)
+                        return r;
+        }
+
+        r = hashmap_ensure_allocated(&c->entries, &conf_files_cache_hash_ops);
+        if (r < 0)
+                return r;
+
+        if (e)
+                hashmap_remove(c->entries, dirpath);
+        e = conf_files_cache_entry_free(e);
+
+        r = hashmap_put(c->entries, n->path, n);
+        if (r < 0)
+                return r;
+
+        *ret = TAKE_PTR(n)->names;
+        return 1;
+}
+
+static int files_add_one(
+                Hashmap *h,
+                Set *masked,
+                const char *suffix,
+                unsigned flags,
+                const char *dirpath,
+                int dir_fd,
+                const char *name) {
+
+        struct stat st;
+        char *p, *key;
+        int r;
+
+        /* Does this match the suffix? */
+        if (suffix && !endswith(name, suffix))
+                return 0;
+
+        /* Has this file already been found in an earlier directory? */
+        if (hashmap_contains(h, name)) {
+                log_debug("Skipping overridden file '%s/%s'.", dirpath, name);
+                return 0;
+        }
+
+        /* Has this been masked in an earlier directory? */
+        if ((flags & CONF_FILES_FILTER_MASKED) && set_contains(masked, name)) {
+                log_debug("File '%s/%s' is masked by previous entry.", dirpath, name);
+                return 0;
+        }
+
+        /* Read file metadata if we shall validate the check for file masks, for node types or whether the node is marked executable. */
+        if (flags & (CONF_FILES_FILTER_MASKED|CONF_FILES_REGULAR|CONF_FILES_DIRECTORY|CONF_FILES_EXECUTABLE)) {
+                assert(dir_fd >= 0);
+
+                if (fstatat(dir_fd, name, &st, 0) < 0) {
+                        log_debug_errno(errno, "Failed to stat '%s/%s', ignoring: %m", dirpath, name);
+                        return 0;
+                }
+        }
 
-                /* Does this match the suffix? */
-                if (suffix && !endswith(de->d_name, suffix))
-                        continue;
+        /* Is this a masking entry? */
+        if ((flags & CONF_FILES_FILTER_MASKED))
+                if (null_or_empty(&st)) {
+                        /* Mark this one as masked */
+                        r = set_put_strdup(masked, name);
+                        if (r < 0)
+                                return r;
 
-                /* Has this file already been found in an earlier directory? */
-                if (hashmap_contains(h, de->d_name)) {
-                        log_debug("Skipping overridden file '%s/%s'.", dirpath, de->d_name);
-                        continue;
+                        log_debug("File '%s/%s' is a mask.", dirpath, name);
+                        return 0;
                 }
 
-                /* Has this been masked in an earlier directory? */
-                if ((flags & CONF_FILES_FILTER_MASKED) && set_contains(masked, de->d_name)) {
-                        log_debug("File '%s/%s' is masked by previous entry.", dirpath, de->d_name);
-                        continue;
+        /* Does this node have the right type? */
+        if (flags & (CONF_FILES_REGULAR|CONF_FILES_DIRECTORY))
+                if (!((flags & CONF_FILES_DIRECTORY) && S_ISDIR(st.st_mode)) &&
+                    !((flags & CONF_FILES_REGULAR) && S_ISREG(st.st_mode))) {
+                        log_debug("Ignoring '%s/%s', as it is not a of the right type.", dirpath, name);
+                        return 0;
                 }
 
-                /* Read file metadata if we shall validate the check for file masks, for node types or whether the node is marked executable. */
-                if (flags & (CONF_FILES_FILTER_MASKED|CONF_FILES_REGULAR|CONF_FILES_DIRECTORY|CONF_FILES_EXECUTABLE))
-                        if (fstatat(dirfd(dir), de->d_name, &st, 0) < 0) {
-                                log_debug_errno(errno, "Failed to stat '%s/%s', ignoring: %m", dirpath, de->d_name);
-                                continue;
-                        }
+        /* Does this node have the executable bit set? */
+        if (flags & CONF_FILES_EXECUTABLE)
+                /* As requested: check if the file is marked executable. Note that we don't check access(X_OK)
+                 * here, as we care about whether the file is marked executable at all, and not whether it is
+                 * executable for us, because if so, such errors are stuff we should log about. */
 
-                /* Is this a masking entry? */
-                if ((flags & CONF_FILES_FILTER_MASKED))
-                        if (null_or_empty(&st)) {
-                                /* Mark this one as masked */
-                                r = set_put_strdup(masked, de->d_name);
-                                if (r < 0)
-                                        return r;
+                if ((st.st_mode & 0111) == 0) { /* not executable */
+                        log_debug("Ignoring '%s/%s', as it is not marked executable.", dirpath, name);
+                        return 0;
+                }
 
-                                log_debug("File '%s/%s' is a mask.", dirpath, de->d_name);
-                                continue;
-                        }
+        if (flags & CONF_FILES_BASENAME) {
+                p = strdup(name);
+                if (!p)
+                        return -ENOMEM;
 
-                /* Does this node have the right type? */
-                if (flags & (CONF_FILES_REGULAR|CONF_FILES_DIRECTORY))
-                        if (!((flags & CONF_FILES_DIRECTORY) && S_ISDIR(st.st_mode)) &&
-                            !((flags & CONF_FILES_REGULAR) && S_ISREG(st.st_mode))) {
-                                log_debug("Ignoring '%s/%s', as it is not a of the right type.", dirpath, de->d_name);
-                                continue;
-                        }
+                key = p;
+        } else {
+                p = path_join(dirpath, name);
+                if (!p)
+                        return -ENOMEM;
 
-                /* Does this node have the executable bit set? */
-                if (flags & CONF_FILES_EXECUTABLE)
-                        /* As requested: check if the file is marked executable. Note that we don't check access(X_OK)
-                         * here, as we care about whether the file is marked executable at all, and not whether it is
-                         * executable for us, because if so, such errors are stuff we should log about. */
+                key = basename(p);
+        }
 
-                        if ((st.st_mode & 0111) == 0) { /* not executable */
-                                log_debug("Ignoring '%s/%s', as it is not marked executable.", dirpath, de->d_name);
-                                continue;
-                        }
+        r = hashmap_put(h, key, p);
+        if (r < 0) {
+                free(p);
+                return log_debug_errno(r, "Failed to add item to hashmap: %m");
+        }
 
-                if (flags & CONF_FILES_BASENAME) {
-                        p = strdup(de->d_name);
-                        if (!p)
-                                return -ENOMEM;
+        assert(r > 0);
+        return 0;
+}
 
-                        key = p;
-                } else {
-                        p = path_join(dirpath, de->d_name);
-                        if (!p)
-                                return -ENOMEM;
+static int files_add(
+                ConfFilesCache *cache,
+                Hashmap *h,
+                Set *masked,
+                const char *suffix,
+                const char *root,
+                unsigned flags,
+                const char *path) {
 
-                        key = basename(p);
-                }
+        _cleanup_closedir_ DIR *dir = NULL;
+        const char *dirpath;
+        struct dirent *de;
+        int r;
 
-                r = hashmap_put(h, key, p);
-                if (r < 0) {
-                        free(p);
-                        return log_debug_errno(r, "Failed to add item to hashmap: %m");
+        assert(h);
+        assert((flags & CONF_FILES_FILTER_MASKED) == 0 || masked);
+        assert(path);
+
+        dirpath = prefix_roota(root, path);
+
+        /* Only plain listings are cached, not the metadata of the files in them */
+        if (cache && (flags & (CONF_FILES_FILTER_MASKED|CONF_FILES_REGULAR|CONF_FILES_DIRECTORY|CONF_FILES_EXECUTABLE)) == 0) {
+                char **names, **name;
+
+                r = conf_files_cache_get(cache, dirpath, &names);
+                if (r <= 0)
+                        return r;
+
+                STRV_FOREACH(name, names) {
+                        r = files_add_one(h, masked, suffix, flags, dirpath, -1, *name);
+                        if (r < 0)
+                                return r;
                 }
 
-                assert(r > 0);
+                return 0;
+        }
+
+        dir = opendir(dirpath);
+        if (!dir) {
+                if (errno == ENOENT)
+                        return 0;
+
+                return log_debug_errno(errno, "Failed to open directory '%s': %m", dirpath);
+        }
+
+        FOREACH_DIRENT(de, dir, return -errno) {
+                r = files_add_one(h, masked, suffix, flags, dirpath, dirfd(dir), de->d_name);
+                if (r < 0)
+                        return r;
         }
 
         return 0;
@@ -135,7 +300,14 @@ static int base_cmp(char * const *a, char * const *b) {
         return strcmp(basename(*a), basename(*b));
 }
 
-static int conf_files_list_strv_internal(char ***strv, const char *suffix, const char *root, unsigned flags, char **dirs) {
+static int conf_files_list_strv_internal(
+                ConfFilesCache *cache,
+                char ***strv,
+                const char *suffix,
+                const char *root,
+                unsigned flags,
+                char **dirs) {
+
         _cleanup_hashmap_free_ Hashmap *fh = NULL;
         _cleanup_set_free_free_ Set *masked = NULL;
         char **files, **p;
@@ -158,7 +330,7 @@ static int conf_files_list_strv_internal(char ***strv, const char *suffix, const
         }
 
         STRV_FOREACH(p, dirs) {
-                r = files_add(fh, masked, suffix, root, flags, *p);
+                r = files_add(cache, fh, masked, suffix, root, flags, *p);
                 if (r == -ENOMEM)
                         return r;
                 if (r < 0)
@@ -246,7 +418,14 @@ int conf_files_insert(char ***strv, const char *root, char **dirs, const char *p
         return r;
 }
 
-int conf_files_list_strv(char ***strv, const char *suffix, const char *root, unsigned flags, const char* const* dirs) {
+int conf_files_list_strv_cached(
+                ConfFilesCache *cache,
+                char ***strv,
+                const char *suffix,
+                const char *root,
+                unsigned flags,
+                const char* const* dirs) {
+
         _cleanup_strv_free_ char **copy = NULL;
 
         assert(strv);
@@ -255,7 +434,11 @@ int conf_files_list_strv(char ***strv, const char *suffix, const char *root, uns
         if (!copy)
                 return -ENOMEM;
 
-        return conf_files_list_strv_internal(strv, suffix, root, flags, copy);
+        return conf_files_list_strv_internal(cache, strv, suffix, root, flags, copy);
+}
+
+int conf_files_list_strv(char ***strv, const char *suffix, const char *root, unsigned flags, const char* const* dirs) {
+        return conf_files_list_strv_cached(NULL, strv, suffix, root, flags, dirs);
 }
 
 int conf_files_list(char ***strv, const char *suffix, const char *root, unsigned flags, const char *dir) {
@@ -267,7 +450,7 @@ int conf_files_list(char ***strv, const char *suffix, const char *root, unsigned
         if (!dirs)
                 return -ENOMEM;
 
-        return conf_files_list_strv_internal(strv, suffix, root, flags, dirs);
+        return conf_files_list_strv_internal(NULL, strv, suffix, root, flags, dirs);
 }
 
 int conf_files_list_nulstr(char ***strv, const char *suffix, const char *root, unsigned flags, const char *dirs) {
@@ -279,7 +462,7 @@ int conf_files_list_nulstr(char ***strv, const char *suffix, const char *root, u
         if (!d)
                 return -ENOMEM;
 
-        return conf_files_list_strv_internal(strv, suffix, root, flags, d);
+        return conf_files_list_strv_internal(NULL, strv, suffix, root, flags, d);
 }
 
 int conf_files_list_with_replacement(
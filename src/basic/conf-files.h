@@ -11,8 +11,17 @@ enum {
         CONF_FILES_FILTER_MASKED = 1 << 4,
 };
 
+/* A cache of directory listings, validated by the inode and mtime of the directories. For listing the same
+ * directories for many units, as happens when looking for drop-ins. */
+typedef struct ConfFilesCache ConfFilesCache;
+
+ConfFilesCache* conf_files_cache_new(void);
+ConfFilesCache* conf_files_cache_free(ConfFilesCache *c);
+DEFINE_TRIVIAL_CLEANUP_FUNC(ConfFilesCache*, conf_files_cache_free);
+
 int conf_files_list(char ***ret, const char *suffix, const char *root, unsigned flags, const char *dir);
 int conf_files_list_strv(char ***ret, const char *suffix, const char *root, unsigned flags, const char* const* dirs);
+int conf_files_list_strv_cached(ConfFilesCache *cache, char ***ret, const char *suffix, const char *root, unsigned flags, const char* const* dirs);
 int conf_files_list_nulstr(char ***ret, const char *suffix, const char *root, unsigned flags, const char *dirs);
 int conf_files_insert(char ***strv, const char *root, char **dirs, const char *path);
 int conf_files_list_with_replacement(
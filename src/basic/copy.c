@@ -5,12 +5,12 @@
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/ioctl.h>
 #include <sys/sendfile.h>
 #include <sys/xattr.h>
 #include <unistd.h>
 
 #include "alloc-util.h"
-#include "btrfs-util.h"
 #include "chattr-util.h"
 #include "copy.h"
 #include "dirent-util.h"
@@ -18,6 +18,7 @@
 #include "fs-util.h"
 #include "io-util.h"
 #include "macro.h"
+#include "missing_fs.h"
 #include "missing_syscall.h"
 #include "mountpoint-util.h"
 #include "nulstr-util.h"
@@ -59,6 +60,51 @@ static ssize_t try_copy_file_range(
         return r;
 }
 
+static int try_reflink(int fdf, uint64_t foffset, int fdt, uint64_t toffset, uint64_t sz) {
+        int r;
+
+        /* Reflinks used to be a btrfs specific ioctl, but are now implemented by XFS, OCFS2, NFS, CIFS, … too,
+         * under a generic name. sz == UINT64_MAX means until the end of the file. Make sure we invoke the
+         * ioctl on a regular file, so that no device driver accidentally gets it. */
+
+        r = fd_verify_regular(fdt);
+        if (r < 0)
+                return r;
+
+        if (foffset == 0 && toffset == 0 && sz == UINT64_MAX) {
+                if (ioctl(fdt, FICLONE, fdf) < 0)
+                        return -errno;
+
+                return 0;
+        }
+
+        if (ioctl(fdt, FICLONERANGE, &(struct file_clone_range) {
+                                .src_fd = fdf,
+                                .src_offset = foffset,
+                                .src_length = sz == UINT64_MAX ? 0 : sz,
+                                .dest_offset = toffset,
+                        }) < 0)
+                return -errno;
+
+        return 0;
+}
+
+static int create_hole(int fdt, off_t sz) {
+        off_t offset;
+
+        /* Skips over sz bytes in the destination, and makes sure the file is at least as large as that,
+         * so that the hole is there even if nothing is written after it. */
+
+        offset = lseek(fdt, sz, SEEK_CUR);
+        if (offset < 0)
+                return -errno;
+
+        if (ftruncate(fdt, offset) < 0)
+                return -errno;
+
+        return 0;
+}
+
 enum {
         FD_IS_NO_PIPE,
         FD_IS_BLOCKING_PIPE,
@@ -129,7 +175,7 @@ int copy_bytes_full(
         if (ret_remains_size)
                 *ret_remains_size = 0;
 
-        /* Try btrfs reflinks first. This only works on regular, seekable files, hence let's check the file offsets of
+        /* Try reflinks first. This only works on regular, seekable files, hence let's check the file offsets of
          * source and destination first. */
         if ((copy_flags & COPY_REFLINK)) {
                 off_t foffset;
@@ -141,10 +187,7 @@ int copy_bytes_full(
                         toffset = lseek(fdt, 0, SEEK_CUR);
                         if (toffset >= 0) {
 
-                                if (foffset == 0 && toffset == 0 && max_bytes == UINT64_MAX)
-                                        r = btrfs_reflink(fdf, fdt); /* full file reflink */
-                                else
-                                        r = btrfs_clone_range(fdf, foffset, fdt, toffset, max_bytes == UINT64_MAX ? 0 : max_bytes); /* partial reflink */
+                                r = try_reflink(fdf, foffset, fdt, toffset, max_bytes);
                                 if (r >= 0) {
                                         off_t t;
 
@@ -183,6 +226,7 @@ int copy_bytes_full(
         }
 
         for (;;) {
+                size_t chunk;
                 ssize_t n;
 
                 if (max_bytes <= 0)
@@ -199,9 +243,69 @@ int copy_bytes_full(
                 if (max_bytes != UINT64_MAX && m > max_bytes)
                         m = max_bytes;
 
+                chunk = m;
+
+                if (copy_flags & COPY_HOLES) {
+                        off_t c, e;
+
+                        c = lseek(fdf, 0, SEEK_CUR);
+                        if (c < 0)
+                                return -errno;
+
+                        /* Are we in a hole? If there's no more data at all, we are in the final hole. */
+                        e = lseek(fdf, c, SEEK_DATA);
+                        if (e < 0 && errno == ENXIO)
+                                e = lseek(fdf, 0, SEEK_END);
+                        if (e < 0)
+                                return -errno;
+
+                        if (e > c) {
+                                uint64_t h = e - c;
+
+                                if (max_bytes != UINT64_MAX && h > max_bytes)
+                                        h = max_bytes;
+
+                                r = create_hole(fdt, h);
+                                if (r < 0)
+                                        return r;
+
+                                if (max_bytes != UINT64_MAX)
+                                        max_bytes -= h;
+
+                                c += h;
+                                if (lseek(fdf, c, SEEK_SET) < 0)
+                                        return -errno;
+
+                                if (progress) {
+                                        r = progress(h, userdata);
+                                        if (r < 0)
+                                                return r;
+                                }
+
+                                continue;
+                        }
+
+                        /* Only copy up to the end of this data segment, so that we notice the next hole */
+                        e = lseek(fdf, c, SEEK_HOLE);
+                        if (e < 0) {
+                                if (errno == ENXIO) /* EOF */
+                                        break;
+
+                                return -errno;
+                        }
+
+                        if (lseek(fdf, c, SEEK_SET) < 0)
+                                return -errno;
+
+                        if (e == c) /* EOF */
+                                break;
+
+                        chunk = MIN(m, (size_t) (e - c));
+                }
+
                 /* First try copy_file_range(), unless we already tried */
                 if (try_cfr) {
-                        n = try_copy_file_range(fdf, NULL, fdt, NULL, m, 0u);
+                        n = try_copy_file_range(fdf, NULL, fdt, NULL, chunk, 0u);
                         if (n < 0) {
                                 if (!IN_SET(n, -EINVAL, -ENOSYS, -EXDEV, -EBADF))
                                         return n;
@@ -217,7 +321,7 @@ int copy_bytes_full(
 
                 /* First try sendfile(), unless we already tried */
                 if (try_sendfile) {
-                        n = sendfile(fdt, fdf, NULL, m);
+                        n = sendfile(fdt, fdf, NULL, chunk);
                         if (n < 0) {
                                 if (!IN_SET(errno, EINVAL, ENOSYS))
                                         return -errno;
@@ -275,7 +379,7 @@ int copy_bytes_full(
                 }
 
                 if (try_splice) {
-                        n = splice(fdf, NULL, fdt, NULL, m, nonblock_pipe ? SPLICE_F_NONBLOCK : 0);
+                        n = splice(fdf, NULL, fdt, NULL, chunk, nonblock_pipe ? SPLICE_F_NONBLOCK : 0);
                         if (n < 0) {
                                 if (!IN_SET(errno, EINVAL, ENOSYS))
                                         return -errno;
@@ -291,7 +395,7 @@ int copy_bytes_full(
 
                 /* As a fallback just copy bits by hand */
                 {
-                        uint8_t buf[MIN(m, COPY_BUFFER_SIZE)], *p = buf;
+                        uint8_t buf[MIN(chunk, COPY_BUFFER_SIZE)], *p = buf;
                         ssize_t z;
 
                         n = read(fdf, buf, sizeof buf);
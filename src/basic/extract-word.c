@@ -9,6 +9,7 @@
 #include <syslog.h>
 
 #include "alloc-util.h"
+#include "arena.h"
 #include "escape.h"
 #include "extract-word.h"
 #include "log.h"
@@ -16,8 +17,35 @@
 #include "string-util.h"
 #include "utf8.h"
 
-int extract_first_word(const char **p, char **ret, const char *separators, ExtractFlags flags) {
-        _cleanup_free_ char *s = NULL;
+static bool word_reserve(char **s, char **owned, size_t *allocated, size_t need, const char *p, Arena *arena) {
+        if (!arena) {
+                if (!GREEDY_REALLOC(*owned, *allocated, need))
+                        return false;
+
+                *s = *owned;
+                return true;
+        }
+
+        /* The unescaped word is never longer than the input it is parsed from, hence with an arena allocate
+         * room for the rest of the input once, and give back what's unused when we are done. */
+        if (!*s) {
+                *allocated = strlen(p) + 8;
+                *s = arena_alloc(arena, *allocated);
+                return !!*s;
+        }
+
+        return need <= *allocated;
+}
+
+static int extract_first_word_internal(
+                const char **p,
+                char **ret,
+                const char *separators,
+                ExtractFlags flags,
+                Arena *arena) {
+
+        _cleanup_free_ char *owned = NULL;
+        char *s = NULL;
         size_t allocated = 0, sz = 0;
         char c;
         int r;
@@ -42,7 +70,7 @@ int extract_first_word(const char **p, char **ret, const char *separators, Extra
          * the pointer *p at the first invalid character. */
 
         if (flags & EXTRACT_DONT_COALESCE_SEPARATORS)
-                if (!GREEDY_REALLOC(s, allocated, sz+1))
+                if (!word_reserve(&s, &owned, &allocated, sz+1, *p, arena))
                         return -ENOMEM;
 
         for (;; (*p)++, c = **p) {
@@ -57,7 +85,7 @@ int extract_first_word(const char **p, char **ret, const char *separators, Extra
                         /* We found a non-blank character, so we will always
                          * want to return a string (even if it is empty),
                          * allocate it here. */
-                        if (!GREEDY_REALLOC(s, allocated, sz+1))
+                        if (!word_reserve(&s, &owned, &allocated, sz+1, *p, arena))
                                 return -ENOMEM;
                         break;
                 }
@@ -65,7 +93,7 @@ int extract_first_word(const char **p, char **ret, const char *separators, Extra
 
         for (;; (*p)++, c = **p) {
                 if (backslash) {
-                        if (!GREEDY_REALLOC(s, allocated, sz+7))
+                        if (!word_reserve(&s, &owned, &allocated, sz+7, *p, arena))
                                 return -ENOMEM;
 
                         if (c == 0) {
@@ -123,7 +151,7 @@ int extract_first_word(const char **p, char **ret, const char *separators, Extra
                                         backslash = true;
                                         break;
                                 } else {
-                                        if (!GREEDY_REALLOC(s, allocated, sz+2))
+                                        if (!word_reserve(&s, &owned, &allocated, sz+2, *p, arena))
                                                 return -ENOMEM;
 
                                         s[sz++] = c;
@@ -155,7 +183,7 @@ int extract_first_word(const char **p, char **ret, const char *separators, Extra
                                         goto finish;
 
                                 } else {
-                                        if (!GREEDY_REALLOC(s, allocated, sz+2))
+                                        if (!word_reserve(&s, &owned, &allocated, sz+2, *p, arena))
                                                 return -ENOMEM;
 
                                         s[sz++] = c;
@@ -175,11 +203,25 @@ finish:
 
 finish_force_next:
         s[sz] = 0;
-        *ret = TAKE_PTR(s);
+
+        if (arena)
+                *ret = arena_realloc(arena, s, allocated, sz + 1);
+        else
+                *ret = TAKE_PTR(owned);
 
         return 1;
 }
 
+int extract_first_word(const char **p, char **ret, const char *separators, ExtractFlags flags) {
+        return extract_first_word_internal(p, ret, separators, flags, NULL);
+}
+
+int extract_first_word_arena(const char **p, Arena *arena, char **ret, const char *separators, ExtractFlags flags) {
+        assert(arena);
+
+        return extract_first_word_internal(p, ret, separators, flags, arena);
+}
+
 int extract_first_word_and_warn(
                 const char **p,
                 char **ret,
@@ -0,0 +1,96 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include "fasthash.h"
+#include "macro.h"
+#include "unaligned.h"
+
+/* Arbitrary odd constants with roughly half of the bits set in each byte */
+#define FASTHASH_P0 UINT64_C(0xa0761d6478bd642f)
+#define FASTHASH_P1 UINT64_C(0xe7037ed1a0b428db)
+#define FASTHASH_P2 UINT64_C(0x8ebc6af09c88c6e3)
+#define FASTHASH_P3 UINT64_C(0x589965cc75374cc3)
+
+/* Full 64×64→128bit multiplication, the low half is returned in *a, the high half in *b */
+static inline void fasthash_mum(uint64_t *a, uint64_t *b) {
+#ifdef __SIZEOF_INT128__
+        __uint128_t r = (__uint128_t) *a * *b;
+
+        *a = (uint64_t) r;
+        *b = (uint64_t) (r >> 64);
+#else
+        uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t) *a, lb = (uint32_t) *b;
+        uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb, t, lo;
+
+        t = rl + (rm0 << 32);
+        lo = t + (rm1 << 32);
+        rh += (rm0 >> 32) + (rm1 >> 32) + (t < rl) + (lo < t);
+
+        *a = lo;
+        *b = rh;
+#endif
+}
+
+static inline uint64_t fasthash_mix(uint64_t a, uint64_t b) {
+        fasthash_mum(&a, &b);
+        return a ^ b;
+}
+
+static inline uint64_t read_small(const uint8_t *p, size_t n) {
+        /* 1…3 bytes: first, middle and last byte */
+        return ((uint64_t) p[0] << 16) | ((uint64_t) p[n >> 1] << 8) | p[n - 1];
+}
+
+uint64_t fasthash64(const void *in, size_t inlen, uint64_t seed) {
+        const uint8_t *p = in;
+        size_t left = inlen;
+        uint64_t a, b;
+
+        assert(in || inlen == 0);
+
+        seed ^= fasthash_mix(seed ^ FASTHASH_P0, FASTHASH_P1);
+
+        if (inlen <= 16) {
+                if (inlen >= 4) {
+                        /* Two possibly overlapping 32bit reads from each end cover 4…16 bytes */
+                        size_t off = (inlen >> 3) << 2;
+
+                        a = ((uint64_t) unaligned_read_le32(p) << 32) | unaligned_read_le32(p + off);
+                        b = ((uint64_t) unaligned_read_le32(p + inlen - 4) << 32) | unaligned_read_le32(p + inlen - 4 - off);
+                } else if (inlen > 0) {
+                        a = read_small(p, inlen);
+                        b = 0;
+                } else
+                        a = b = 0;
+        } else {
+                if (left > 48) {
+                        uint64_t s1 = seed, s2 = seed;
+
+                        /* Three independent lanes, so that the multiplications can run in parallel */
+                        do {
+                                seed = fasthash_mix(unaligned_read_le64(p) ^ FASTHASH_P1, unaligned_read_le64(p + 8) ^ seed);
+                                s1 = fasthash_mix(unaligned_read_le64(p + 16) ^ FASTHASH_P2, unaligned_read_le64(p + 24) ^ s1);
+                                s2 = fasthash_mix(unaligned_read_le64(p + 32) ^ FASTHASH_P3, unaligned_read_le64(p + 40) ^ s2);
+                                p += 48;
+                                left -= 48;
+                        } while (left > 48);
+
+                        seed ^= s1 ^ s2;
+                }
+
+                while (left > 16) {
+                        seed = fasthash_mix(unaligned_read_le64(p) ^ FASTHASH_P1, unaligned_read_le64(p + 8) ^ seed);
+                        p += 16;
+                        left -= 16;
+                }
+
+                /* The last 16 bytes, possibly overlapping with what was already consumed */
+                a = unaligned_read_le64(p + left - 16);
+                b = unaligned_read_le64(p + left - 8);
+        }
+
+        a ^= FASTHASH_P1;
+        b ^= seed;
+        fasthash_mum(&a, &b);
+
+        return fasthash_mix(a ^ FASTHASH_P0 ^ inlen, b ^ FASTHASH_P1);
+}
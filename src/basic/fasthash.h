@@ -0,0 +1,12 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* A keyed 64bit hash based on multiply-and-fold mixing, in the style of wyhash. It is a lot faster than
+ * SipHash-2-4 for short keys, but makes no cryptographic promises: with knowledge of the output an attacker
+ * might be able to construct colliding keys even without knowing the seed. Only use it for tables whose
+ * keys are not under the control of unprivileged parties, and stick to siphash24() otherwise. */
+
+uint64_t fasthash64(const void *in, size_t inlen, uint64_t seed);
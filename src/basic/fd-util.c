@@ -4,6 +4,7 @@
 #include <fcntl.h>
 #include <sys/resource.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <unistd.h>
 
 #include "alloc-util.h"
@@ -214,6 +215,35 @@ static int get_max_fd(void) {
         return (int) (m - 1);
 }
 
+static int close_all_fds_brute_force(const int except[], size_t n_except) {
+        int fd, max_fd, r = 0;
+
+        /* When /proc isn't available (for example in chroots) the fallback is brute forcing through the fd
+         * table */
+
+        max_fd = get_max_fd();
+        if (max_fd < 0)
+                return max_fd;
+
+        /* Refuse to do the loop over more too many elements. It's better to fail immediately than to spin the
+         * CPU for a long time. Doesn't log, since it is called from close_all_fds_without_malloc(). */
+        if (max_fd > MAX_FD_LOOP_LIMIT)
+                return -EPERM;
+
+        for (fd = 3; fd >= 0; fd = fd < max_fd ? fd + 1 : -1) {
+                int q;
+
+                if (fd_in_set(fd, except, n_except))
+                        continue;
+
+                q = close_nointr(fd);
+                if (q < 0 && q != -EBADF && r >= 0)
+                        r = q;
+        }
+
+        return r;
+}
+
 int close_all_fds(const int except[], size_t n_except) {
         _cleanup_closedir_ DIR *d = NULL;
         struct dirent *de;
@@ -223,32 +253,9 @@ int close_all_fds(const int except[], size_t n_except) {
 
         d = opendir("/proc/self/fd");
         if (!d) {
-                int fd, max_fd;
-
-                /* When /proc isn't available (for example in chroots) the fallback is brute forcing through
-                 * the fd table */
-
-                max_fd = get_max_fd();
-                if (max_fd < 0)
-                        return max_fd;
-
-                /* Refuse to do the loop over more too many elements. It's better to fail immediately than to
-                 * spin the CPU for a long time. */
-                if (max_fd > MAX_FD_LOOP_LIMIT)
-                        return log_debug_errno(SYNTHETIC_ERRNO(EPERM),
-                                               "/proc/self/fd is inaccessible. Refusing to loop over %d potential fds.",
-                                               max_fd);
-
-                for (fd = 3; fd >= 0; fd = fd < max_fd ? fd + 1 : -1) {
-                        int q;
-
-                        if (fd_in_set(fd, except, n_except))
-                                continue;
-
-                        q = close_nointr(fd);
-                        if (q < 0 && q != -EBADF && r >= 0)
-                                r = q;
-                }
+                r = close_all_fds_brute_force(except, n_except);
+                if (r == -EPERM)
+                        return log_debug_errno(r, "/proc/self/fd is inaccessible. Refusing to loop over that many potential fds.");
 
                 return r;
         }
@@ -277,6 +284,55 @@ int close_all_fds(const int except[], size_t n_except) {
         return r;
 }
 
+int close_all_fds_without_malloc(const int except[], size_t n_except) {
+        _cleanup_close_ int dir_fd = -1;
+        int r = 0;
+
+        assert(n_except == 0 || except);
+
+        /* Like close_all_fds(), but doesn't allocate any memory, and may hence be called in a child created
+         * with vfork(), which shares the address space of its parent. We read /proc/self/fd with getdents64()
+         * into a buffer on the stack instead of going through opendir(). */
+
+        dir_fd = open("/proc/self/fd", O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+        if (dir_fd < 0)
+                return close_all_fds_brute_force(except, n_except);
+
+        for (;;) {
+                uint8_t buf[4096] _alignas_(struct dirent64);
+                struct dirent64 *de;
+                ssize_t n;
+                size_t i;
+
+                n = syscall(SYS_getdents64, dir_fd, buf, sizeof(buf));
+                if (n < 0)
+                        return -errno;
+                if (n == 0)
+                        break;
+
+                for (i = 0; i < (size_t) n; i += de->d_reclen) {
+                        int fd = -1, q;
+
+                        de = (struct dirent64*) (buf + i);
+
+                        if (safe_atoi(de->d_name, &fd) < 0)
+                                continue;
+
+                        if (fd < 3 || fd == dir_fd)
+                                continue;
+
+                        if (fd_in_set(fd, except, n_except))
+                                continue;
+
+                        q = close_nointr(fd);
+                        if (q < 0 && q != -EBADF && r >= 0)
+                                r = q;
+                }
+        }
+
+        return r;
+}
+
 int same_fd(int a, int b) {
         struct stat sta, stb;
         pid_t pid;
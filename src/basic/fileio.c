@@ -954,6 +954,25 @@ static EndOfLineMarker categorize_eol(char c, ReadLineFlags flags) {
 
 DEFINE_TRIVIAL_CLEANUP_FUNC(FILE*, funlockfile);
 
+static int safe_fgetc_unlocked(FILE *f, char *ret) {
+        int k;
+
+        /* Like safe_fgetc(), but the caller must hold the lock on the stream */
+
+        errno = 0;
+        k = getc_unlocked(f);
+        if (k == EOF) {
+                if (ferror_unlocked(f))
+                        return errno_or_else(EIO);
+
+                *ret = 0;
+                return 0;
+        }
+
+        *ret = k;
+        return 1;
+}
+
 int read_line_full(FILE *f, size_t limit, ReadLineFlags flags, char **ret) {
         size_t n = 0, allocated = 0, count = 0;
         _cleanup_free_ char *buffer = NULL;
@@ -1005,7 +1024,9 @@ int read_line_full(FILE *f, size_t limit, ReadLineFlags flags, char **ret) {
                         if (count >= INT_MAX) /* We couldn't return the counter anymore as "int", hence refuse this */
                                 return -ENOBUFS;
 
-                        r = safe_fgetc(f, &c);
+                        /* We hold the lock on the stream already, hence we can use the unlocked
+                         * version, which avoids taking the lock again for each character. */
+                        r = safe_fgetc_unlocked(f, &c);
                         if (r < 0)
                                 return r;
                         if (r == 0) /* EOF is definitely EOL */
@@ -1048,7 +1069,7 @@ int read_line_full(FILE *f, size_t limit, ReadLineFlags flags, char **ret) {
                         }
 
                         if (ret) {
-                                if (!GREEDY_REALLOC(buffer, allocated, n + 2))
+                                if (n + 2 > allocated && !GREEDY_REALLOC(buffer, allocated, n + 2))
                                         return -ENOMEM;
 
                                 buffer[n] = c;
@@ -2,6 +2,7 @@
 
 #include <string.h>
 
+#include "fasthash.h"
 #include "hash-funcs.h"
 #include "path-util.h"
 
@@ -14,6 +15,16 @@ DEFINE_HASH_OPS_FULL(string_hash_ops_free_free,
                      char, string_hash_func, string_compare_func, free,
                      char, free);
 
+uint64_t string_fast_hash_func(const char *p, uint64_t seed) {
+        return fasthash64(p, strlen(p), seed);
+}
+
+const struct hash_ops string_fast_hash_ops = {
+        .hash = (hash_func_t) string_hash_func,
+        .compare = (compare_func_t) string_compare_func,
+        .fast_hash = (fast_hash_func_t) string_fast_hash_func,
+};
+
 void path_hash_func(const char *q, struct siphash *state) {
         size_t n;
 
@@ -6,6 +6,7 @@
 #include "siphash24.h"
 
 typedef void (*hash_func_t)(const void *p, struct siphash *state);
+typedef uint64_t (*fast_hash_func_t)(const void *p, uint64_t seed);
 typedef int (*compare_func_t)(const void *a, const void *b);
 
 struct hash_ops {
@@ -13,6 +14,10 @@ struct hash_ops {
         compare_func_t compare;
         free_func_t free_key;
         free_func_t free_value;
+
+        /* If set, used by hashmaps instead of hash. Only for keys that unprivileged parties cannot choose,
+         * see fasthash.h. */
+        fast_hash_func_t fast_hash;
 };
 
 #define _DEFINE_HASH_OPS(uq, name, type, hash_func, compare_func, free_key_func, free_value_func, scope) \
@@ -78,6 +83,11 @@ void string_hash_func(const char *p, struct siphash *state);
 extern const struct hash_ops string_hash_ops;
 extern const struct hash_ops string_hash_ops_free_free;
 
+/* Same semantics as string_hash_ops, but hashed with fasthash64() rather than SipHash. For internal tables
+ * with many lookups, whose keys are not controlled by unprivileged users. */
+uint64_t string_fast_hash_func(const char *p, uint64_t seed);
+extern const struct hash_ops string_fast_hash_ops;
+
 void path_hash_func(const char *p, struct siphash *state);
 extern const struct hash_ops path_hash_ops;
 
@@ -1,6 +1,7 @@
 /* SPDX-License-Identifier: LGPL-2.1+ */
 
 #include <errno.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdlib.h>
 
@@ -17,9 +18,9 @@
 #include "siphash24.h"
 #include "string-util.h"
 #include "strv.h"
+#include "unaligned.h"
 
 #if ENABLE_DEBUG_HASHMAP
-#include <pthread.h>
 #include "list.h"
 #endif
 
@@ -130,6 +131,7 @@ typedef uint8_t dib_raw_t;
 struct hashmap_debug_info {
         LIST_FIELDS(struct hashmap_debug_info, debug_list);
         unsigned max_entries;  /* high watermark of n_entries */
+        unsigned resize_count; /* counts reallocations of the bucket storage */
 
         /* who allocated this hashmap */
         int line;
@@ -250,7 +252,6 @@ assert_cc(sizeof(Hashmap) == sizeof(Set));
 struct hashmap_type_info {
         size_t head_size;
         size_t entry_size;
-        struct mempool *mempool;
         unsigned n_direct_buckets;
 };
 
@@ -258,23 +259,62 @@ static const struct hashmap_type_info hashmap_type_info[_HASHMAP_TYPE_MAX] = {
         [HASHMAP_TYPE_PLAIN] = {
                 .head_size        = sizeof(Hashmap),
                 .entry_size       = sizeof(struct plain_hashmap_entry),
-                .mempool          = &hashmap_pool,
                 .n_direct_buckets = DIRECT_BUCKETS(struct plain_hashmap_entry),
         },
         [HASHMAP_TYPE_ORDERED] = {
                 .head_size        = sizeof(OrderedHashmap),
                 .entry_size       = sizeof(struct ordered_hashmap_entry),
-                .mempool          = &ordered_hashmap_pool,
                 .n_direct_buckets = DIRECT_BUCKETS(struct ordered_hashmap_entry),
         },
         [HASHMAP_TYPE_SET] = {
                 .head_size        = sizeof(Set),
                 .entry_size       = sizeof(struct set_entry),
-                .mempool          = &hashmap_pool,
                 .n_direct_buckets = DIRECT_BUCKETS(struct set_entry),
         },
 };
 
+/* The pools are per thread, see mempool.h. Sets share the pool with plain hashmaps. */
+static struct mempool *hashmap_type_pool(enum HashmapType type) {
+        return type == HASHMAP_TYPE_ORDERED ? &ordered_hashmap_pool : &hashmap_pool;
+}
+
+/* Releases whatever it can of a thread's pools when the thread exits. The main thread's pools stay around
+ * until the process exits. */
+static pthread_key_t pool_key;
+static pthread_once_t pool_key_once = PTHREAD_ONCE_INIT;
+static bool pool_key_initialized;
+static thread_local bool pool_key_set;
+
+static void thread_trim_pools(void *p) {
+        (void) hashmap_trim_pools();
+}
+
+static void pool_key_init(void) {
+        pool_key_initialized = pthread_key_create(&pool_key, thread_trim_pools) == 0;
+}
+
+static void pool_key_register(void) {
+        if (_likely_(pool_key_set))
+                return;
+
+        /* Only done once per thread, and only for threads that actually use the pools */
+        pool_key_set = true;
+
+        if (is_main_thread())
+                return;
+
+        assert_se(pthread_once(&pool_key_once, pool_key_init) == 0);
+        if (pool_key_initialized)
+                (void) pthread_setspecific(pool_key, INT_TO_PTR(1));
+}
+
+_destructor_ static void pool_key_done(void) {
+        /* If we are part of a shared object that gets unloaded, make sure the key's destructor isn't
+         * called anymore afterwards */
+        if (pool_key_initialized)
+                (void) pthread_key_delete(pool_key);
+}
+
 #if VALGRIND
 _destructor_ static void cleanup_pools(void) {
         _cleanup_free_ char *t = NULL;
@@ -282,9 +322,8 @@ _destructor_ static void cleanup_pools(void) {
 
         /* Be nice to valgrind */
 
-        /* The pool is only allocated by the main thread, but the memory can
-         * be passed to other threads. Let's clean up if we are the main thread
-         * and no other threads are live. */
+        /* Let's clean up the main thread's pools if we are the main thread and
+         * no other threads are live. */
         /* We build our own is_main_thread() here, which doesn't use C11
          * TLS based caching of the result. That's because valgrind apparently
          * doesn't like malloc() (which C11 TLS internally uses) to be called
@@ -301,6 +340,17 @@ _destructor_ static void cleanup_pools(void) {
 }
 #endif
 
+size_t hashmap_trim_pools(void) {
+        size_t trimmed;
+
+        /* Only trims the calling thread's pools */
+
+        trimmed = mempool_trim(&hashmap_pool);
+        trimmed += mempool_trim(&ordered_hashmap_pool);
+
+        return trimmed;
+}
+
 static unsigned n_buckets(HashmapBase *h) {
         return h->has_indirect ? h->indirect.n_buckets
                                : hashmap_type_info[h->type].n_direct_buckets;
@@ -339,6 +389,13 @@ static unsigned base_bucket_hash(HashmapBase *h, const void *p) {
         struct siphash state;
         uint64_t hash;
 
+        if (h->hash_ops->fast_hash) {
+                const uint8_t *k = hash_key(h);
+
+                hash = h->hash_ops->fast_hash(p, unaligned_read_ne64(k) ^ unaligned_read_ne64(k + 8));
+                return (unsigned) (hash % n_buckets(h));
+        }
+
         siphash24_init(&state, hash_key(h));
 
         h->hash_ops->hash(p, &state);
@@ -777,7 +834,11 @@ static struct HashmapBase *hashmap_base_new(const struct hash_ops *hash_ops, enu
 
         up = mempool_enabled();
 
-        h = up ? mempool_alloc0_tile(hi->mempool) : malloc0(hi->head_size);
+        if (up) {
+                pool_key_register();
+                h = mempool_alloc0_tile(hashmap_type_pool(type));
+        } else
+                h = malloc0(hi->head_size);
         if (!h)
                 return NULL;
 
@@ -860,11 +921,11 @@ static void hashmap_free_no_clear(HashmapBase *h) {
         assert_se(pthread_mutex_unlock(&hashmap_debug_list_mutex) == 0);
 #endif
 
-        if (h->from_pool) {
-                /* Ensure that the object didn't get migrated between threads. */
-                assert_se(is_main_thread());
-                mempool_free_tile(hashmap_type_info[h->type].mempool, h);
-        } else
+        if (h->from_pool)
+                /* This might be another thread than the one that allocated the hashmap, the tile moves to
+                 * our own pool's freelist then, see mempool_free_tile(). */
+                mempool_free_tile(hashmap_type_pool(h->type), h);
+        else
                 free(h);
 }
 
@@ -1112,6 +1173,9 @@ static int resize_buckets(HashmapBase *h, unsigned entries_add) {
 
         h->has_indirect = true;
         h->indirect.storage = new_storage;
+#if ENABLE_DEBUG_HASHMAP
+        h->debug.resize_count++;
+#endif
         h->indirect.n_buckets = (1U << new_shift) /
                                 (hi->entry_size + sizeof(dib_raw_t));
 
@@ -1180,18 +1244,92 @@ static int resize_buckets(HashmapBase *h, unsigned entries_add) {
         return 1;
 }
 
+/* Probing looks at this many DIB bytes at once, see bucket_scan_group(). The DIBs expected in a group must
+ * fit in 7 bits. */
+#define DIB_GROUP_SIZE 8U
+#define DIB_GROUP_DISTANCE_MAX (0x80U - DIB_GROUP_SIZE)
+
+#define BYTES_LOW  UINT64_C(0x7f7f7f7f7f7f7f7f)
+#define BYTES_HIGH UINT64_C(0x8080808080808080)
+
+/* Sets the high bit of each byte of x that is zero */
+static uint64_t bytes_zero(uint64_t x) {
+        return ~(((x & BYTES_LOW) + BYTES_LOW) | x) & BYTES_HIGH;
+}
+
+/*
+ * Checks DIB_GROUP_SIZE buckets starting at idx (which must not wrap around) in one go, assuming an entry
+ * for key would be at distance 'distance' from its initial bucket in idx. With Robin Hood hashing the entry
+ * can only be in a bucket whose DIB equals its distance, and a bucket that is free or whose DIB is lower
+ * terminates the search. Both conditions are evaluated for all bytes of the group at once, so that misses
+ * are decided without walking the DIB array bucket by bucket.
+ * Returns: true if the search is decided, in which case *ret is the index of the found entry or IDX_NIL;
+ * false if the search must continue with the next group.
+ */
+static bool bucket_scan_group(HashmapBase *h, unsigned idx, unsigned distance, const void *key, unsigned *ret) {
+        uint64_t dibs, expected, le, eq, stop;
+
+        assert(idx + DIB_GROUP_SIZE <= n_buckets(h));
+        assert(distance <= DIB_GROUP_DISTANCE_MAX);
+        assert(ret);
+
+        /* Byte i of these is the DIB of bucket idx + i, resp. the DIB an entry for key would have there.
+         * All expected values are below 0x80, hence none of the byte-wise operations carry over. */
+        dibs = unaligned_read_le64(dib_raw_ptr(h) + idx);
+        expected = distance * UINT64_C(0x0101010101010101) + UINT64_C(0x0706050403020100);
+
+        /* DIB <= expected, only possible for bytes without the high bit. Free buckets and overflowing
+         * DIBs have it set, and count as greater here. */
+        le = ((expected | BYTES_HIGH) - (dibs & BYTES_LOW)) & ~dibs & BYTES_HIGH;
+        eq = bytes_zero(dibs ^ expected);
+        stop = (le & ~eq) | bytes_zero(~dibs);
+
+        /* Only candidates before the first stop bucket count */
+        if (stop != 0)
+                eq &= (UINT64_C(1) << __builtin_ctzll(stop)) - 1;
+
+        while (eq != 0) {
+                unsigned i = __builtin_ctzll(eq) / 8;
+
+                if (h->hash_ops->compare(bucket_at(h, idx + i)->key, key) == 0) {
+                        *ret = idx + i;
+                        return true;
+                }
+
+                eq &= eq - 1;
+        }
+
+        if (stop == 0)
+                return false;
+
+        *ret = IDX_NIL;
+        return true;
+}
+
 /*
  * Finds an entry with a matching key
  * Returns: index of the found entry, or IDX_NIL if not found.
  */
 static unsigned base_bucket_scan(HashmapBase *h, unsigned idx, const void *key) {
         struct hashmap_base_entry *e;
-        unsigned dib, distance;
+        unsigned dib, distance, r;
         dib_raw_t *dibs = dib_raw_ptr(h);
 
         assert(idx < n_buckets(h));
 
-        for (distance = 0; ; distance++) {
+        for (distance = 0; ; ) {
+                if (distance <= DIB_GROUP_DISTANCE_MAX && idx + DIB_GROUP_SIZE <= n_buckets(h)) {
+                        if (bucket_scan_group(h, idx, distance, key, &r))
+                                return r;
+
+                        distance += DIB_GROUP_SIZE;
+                        idx += DIB_GROUP_SIZE;
+                        if (idx == n_buckets(h))
+                                idx = 0;
+                        continue;
+                }
+
+                /* Near the end of the bucket array, and for very long probe sequences, go one by one */
                 if (dibs[idx] == DIB_RAW_FREE)
                         return IDX_NIL;
 
@@ -1205,6 +1343,7 @@ static unsigned base_bucket_scan(HashmapBase *h, unsigned idx, const void *key)
                                 return idx;
                 }
 
+                distance++;
                 idx = next_idx(h, idx);
         }
 }
@@ -1249,6 +1388,33 @@ int set_put(Set *s, const void *key) {
         return hashmap_put_boldly(s, hash, &swap, true);
 }
 
+int hashmap_put_many(Hashmap *h, const void * const *keys, void * const *values, unsigned n) {
+        unsigned i;
+        int added = 0, r;
+
+        assert(h);
+        assert(keys || n == 0);
+        assert(values || n == 0);
+
+        /* Size the table once for all entries, instead of growing it step by step while putting them.
+         * Returns the number of entries added, or the first error hashmap_put() returned, in which case
+         * the entries before it stay in the hashmap. */
+
+        r = hashmap_reserve(h, n);
+        if (r < 0)
+                return r;
+
+        for (i = 0; i < n; i++) {
+                r = hashmap_put(h, keys[i], values[i]);
+                if (r < 0)
+                        return r;
+
+                added += r;
+        }
+
+        return added;
+}
+
 int hashmap_replace(Hashmap *h, const void *key, void *value) {
         struct swap_entries swap;
         struct plain_hashmap_entry *e;
@@ -1809,12 +1975,42 @@ int set_put_strdup(Set *s, const char *p) {
         return set_consume(s, c);
 }
 
+int set_put_strv(Set *s, char **l) {
+        int n = 0, r;
+        char **i;
+
+        assert(s);
+
+        /* Like set_put_strdupv(), but puts the strings themselves into the set. Strings equal to one
+         * already in the set are skipped, the caller has to keep them around or free them. */
+
+        r = set_reserve(s, strv_length(l));
+        if (r < 0)
+                return r;
+
+        STRV_FOREACH(i, l) {
+                r = set_put(s, *i);
+                if (r == -EEXIST)
+                        continue;
+                if (r < 0)
+                        return r;
+
+                n += r;
+        }
+
+        return n;
+}
+
 int set_put_strdupv(Set *s, char **l) {
         int n = 0, r;
         char **i;
 
         assert(s);
 
+        r = set_reserve(s, strv_length(l));
+        if (r < 0)
+                return r;
+
         STRV_FOREACH(i, l) {
                 r = set_put_strdup(s, *i);
                 if (r < 0)
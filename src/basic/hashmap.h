@@ -149,6 +149,11 @@ static inline int ordered_hashmap_put(OrderedHashmap *h, const void *key, void *
 
 int hashmap_put_strdup(Hashmap **h, const char *k, const char *v);
 
+int hashmap_put_many(Hashmap *h, const void * const *keys, void * const *values, unsigned n);
+static inline int ordered_hashmap_put_many(OrderedHashmap *h, const void * const *keys, void * const *values, unsigned n) {
+        return hashmap_put_many(PLAIN_HASHMAP(h), keys, values, n);
+}
+
 int hashmap_update(Hashmap *h, const void *key, void *value);
 static inline int ordered_hashmap_update(OrderedHashmap *h, const void *key, void *value) {
         return hashmap_update(PLAIN_HASHMAP(h), key, value);
@@ -428,6 +433,10 @@ DEFINE_TRIVIAL_CLEANUP_FUNC(OrderedHashmap*, ordered_hashmap_free_free_free);
 #define _cleanup_ordered_hashmap_free_free_ _cleanup_(ordered_hashmap_free_freep)
 #define _cleanup_ordered_hashmap_free_free_free_ _cleanup_(ordered_hashmap_free_free_freep)
 
+/* Releases the memory pools hashmap objects are allocated from as far as they are unused. Returns the number of
+ * bytes released. */
+size_t hashmap_trim_pools(void);
+
 DEFINE_TRIVIAL_CLEANUP_FUNC(IteratedCache*, iterated_cache_free);
 
 #define _cleanup_iterated_cache_free_ _cleanup_(iterated_cache_freep)
@@ -4,6 +4,7 @@
 #include <fcntl.h>
 #include <inttypes.h>
 #include <limits.h>
+#include <pthread.h>
 #include <stdarg.h>
 #include <stddef.h>
 #include <sys/signalfd.h>
@@ -15,6 +16,7 @@
 #include "sd-messages.h"
 
 #include "alloc-util.h"
+#include "async.h"
 #include "errno-util.h"
 #include "fd-util.h"
 #include "format-util.h"
@@ -184,7 +186,236 @@ fail:
         return r;
 }
 
+/* In asynchronous mode messages for the journal are queued in a bounded in-process ring buffer, and sent
+ * by a background thread, so that a slow or blocked journald does not stall the logging process. When the
+ * ring is full, messages are dropped and counted. Each entry is a size_t length followed by the datagram. */
+#define LOG_ASYNC_RING_SIZE (256U*1024U)
+#define LOG_ASYNC_ENTRY_MAX (3U*LINE_MAX)
+
+static bool async_enabled = false;
+static bool async_thread_started = false;
+static bool async_sending = false;
+static pthread_mutex_t async_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t async_cond = PTHREAD_COND_INITIALIZER; /* broadcast on new entries, and when a send is complete */
+static uint8_t async_ring[LOG_ASYNC_RING_SIZE];
+static size_t async_ring_start = 0, async_ring_size = 0;
+static uint64_t async_n_dropped = 0, async_n_dropped_total = 0;
+
+static void async_ring_put(const void *p, size_t n) {
+        size_t pos = (async_ring_start + async_ring_size) % LOG_ASYNC_RING_SIZE,
+                k = MIN(n, LOG_ASYNC_RING_SIZE - pos);
+
+        memcpy(async_ring + pos, p, k);
+        memcpy(async_ring, (const uint8_t*) p + k, n - k);
+        async_ring_size += n;
+}
+
+static void async_ring_get(void *p, size_t n) {
+        size_t k = MIN(n, LOG_ASYNC_RING_SIZE - async_ring_start);
+
+        memcpy(p, async_ring + async_ring_start, k);
+        memcpy((uint8_t*) p + k, async_ring, n - k);
+        async_ring_start = (async_ring_start + n) % LOG_ASYNC_RING_SIZE;
+        async_ring_size -= n;
+}
+
+static size_t async_ring_pop(char buffer[static LOG_ASYNC_ENTRY_MAX]) {
+        size_t n;
+
+        /* Must be called with async_mutex held, and with a non-empty ring */
+        async_ring_get(&n, sizeof(n));
+        async_ring_get(buffer, n);
+
+        return n;
+}
+
+static void async_send_dropped(int fd, uint64_t n) {
+        char buffer[LINE_MAX];
+
+        (void) snprintf(buffer, sizeof(buffer),
+                        "PRIORITY=%i\n"
+                        "SYSLOG_IDENTIFIER=%s\n"
+                        "MESSAGE=Log ring buffer full, dropped %" PRIu64 " messages.\n",
+                        LOG_WARNING, strempty(program_invocation_short_name), n);
+
+        (void) send(fd, buffer, strlen(buffer), MSG_NOSIGNAL);
+}
+
+static void *async_thread(void *p) {
+        static char buffer[LOG_ASYNC_ENTRY_MAX];
+
+        (void) pthread_setname_np(pthread_self(), "log");
+
+        for (;;) {
+                uint64_t dropped;
+                size_t n;
+                int fd;
+
+                assert_raw(pthread_mutex_lock(&async_mutex) == 0);
+
+                while (async_ring_size == 0 && async_n_dropped == 0)
+                        assert_raw(pthread_cond_wait(&async_cond, &async_mutex) == 0);
+
+                n = async_ring_size > 0 ? async_ring_pop(buffer) : 0;
+                dropped = async_n_dropped;
+                async_n_dropped = 0;
+                fd = journal_fd;
+                async_sending = true;
+
+                assert_raw(pthread_mutex_unlock(&async_mutex) == 0);
+
+                /* Blocking is fine here, that's what we have the thread for */
+                if (fd >= 0) {
+                        if (dropped > 0)
+                                async_send_dropped(fd, dropped);
+                        if (n > 0)
+                                (void) send(fd, buffer, n, MSG_NOSIGNAL);
+                }
+
+                assert_raw(pthread_mutex_lock(&async_mutex) == 0);
+                async_sending = false;
+                assert_raw(pthread_cond_broadcast(&async_cond) == 0);
+                assert_raw(pthread_mutex_unlock(&async_mutex) == 0);
+        }
+
+        return NULL;
+}
+
+static void async_flush(bool wait) {
+        char buffer[LOG_ASYNC_ENTRY_MAX];
+
+        if (!async_thread_started)
+                return;
+
+        /* Sends out everything queued from the calling thread. When called on a crash path we must not
+         * block on the lock, since it might be held by the very thread that crashed, and thus give up then. */
+        if (wait)
+                assert_raw(pthread_mutex_lock(&async_mutex) == 0);
+        else if (pthread_mutex_trylock(&async_mutex) != 0)
+                return;
+
+        while (wait && async_sending)
+                assert_raw(pthread_cond_wait(&async_cond, &async_mutex) == 0);
+
+        if (journal_fd >= 0 && async_n_dropped > 0)
+                async_send_dropped(journal_fd, async_n_dropped);
+        async_n_dropped = 0;
+
+        while (async_ring_size > 0) {
+                size_t n;
+
+                n = async_ring_pop(buffer);
+                if (journal_fd >= 0)
+                        (void) send(journal_fd, buffer, n, MSG_NOSIGNAL);
+        }
+
+        assert_raw(pthread_mutex_unlock(&async_mutex) == 0);
+}
+
+void log_async_flush(void) {
+        async_flush(true);
+}
+
+static int async_queue(const char *header, const char *buffer) {
+        size_t a, b, n;
+
+        a = strlen(header);
+        b = strlen(buffer);
+        n = a + STRLEN("MESSAGE=") + b + 1;
+        if (n > LOG_ASYNC_ENTRY_MAX)
+                return 0; /* Too long, send it synchronously */
+
+        assert_raw(pthread_mutex_lock(&async_mutex) == 0);
+
+        if (async_ring_size + sizeof(n) + n > LOG_ASYNC_RING_SIZE) {
+                async_n_dropped++;
+                async_n_dropped_total++;
+        } else {
+                async_ring_put(&n, sizeof(n));
+                async_ring_put(header, a);
+                async_ring_put("MESSAGE=", STRLEN("MESSAGE="));
+                async_ring_put(buffer, b);
+                async_ring_put("\n", 1);
+
+                assert_raw(pthread_cond_broadcast(&async_cond) == 0);
+        }
+
+        assert_raw(pthread_mutex_unlock(&async_mutex) == 0);
+        return 1;
+}
+
+static void async_atfork_prepare(void) {
+        assert_raw(pthread_mutex_lock(&async_mutex) == 0);
+}
+
+static void async_atfork_parent(void) {
+        assert_raw(pthread_mutex_unlock(&async_mutex) == 0);
+}
+
+static void async_atfork_child(void) {
+        /* The thread does not exist in the child, hence go back to synchronous logging. Whatever is queued
+         * is sent by the parent. */
+        async_enabled = async_thread_started = async_sending = false;
+        async_ring_start = async_ring_size = 0;
+        async_n_dropped = async_n_dropped_total = 0;
+
+        assert_raw(pthread_mutex_unlock(&async_mutex) == 0);
+}
+
+static void async_atexit(void) {
+        log_async_flush();
+}
+
+int log_set_async(bool b) {
+        int r;
+
+        if (!b) {
+                async_enabled = false;
+                log_async_flush();
+                return 0;
+        }
+
+        if (!async_thread_started) {
+                static bool registered = false;
+
+                if (!registered) {
+                        r = pthread_atfork(async_atfork_prepare, async_atfork_parent, async_atfork_child);
+                        if (r != 0)
+                                return -r;
+
+                        if (atexit(async_atexit) != 0)
+                                return -ENOMEM;
+
+                        registered = true;
+                }
+
+                r = asynchronous_job(async_thread, NULL);
+                if (r < 0)
+                        return r;
+
+                async_thread_started = true;
+        }
+
+        async_enabled = true;
+        return 0;
+}
+
+uint64_t log_get_async_dropped(void) {
+        uint64_t n;
+
+        if (!async_thread_started)
+                return 0;
+
+        assert_raw(pthread_mutex_lock(&async_mutex) == 0);
+        n = async_n_dropped_total;
+        assert_raw(pthread_mutex_unlock(&async_mutex) == 0);
+
+        return n;
+}
+
 static void log_close_journal(void) {
+        /* Don't close the socket under the feet of the sender thread */
+        log_async_flush();
         journal_fd = safe_close(journal_fd);
 }
 
@@ -558,6 +789,15 @@ static int write_to_journal(
 
         log_do_header(header, sizeof(header), level, error, file, line, func, object_field, object, extra_field, extra);
 
+        if (async_enabled) {
+                /* Critical messages are likely followed by a crash, hence send them and everything queued
+                 * before them right away */
+                if (LOG_PRI(level) > LOG_CRIT && async_queue(header, buffer) > 0)
+                        return 1;
+
+                async_flush(LOG_PRI(level) > LOG_CRIT);
+        }
+
         iovec[0] = IOVEC_MAKE_STRING(header);
         iovec[1] = IOVEC_MAKE_STRING("MESSAGE=");
         iovec[2] = IOVEC_MAKE_STRING(buffer);
@@ -930,6 +1170,9 @@ int log_struct_internal(
                         if (r < 0)
                                 fallback = true;
                         else {
+                                /* Structured messages are always sent synchronously, after what is queued */
+                                log_async_flush();
+
                                 mh.msg_iovlen = n;
                                 (void) sendmsg(journal_fd, &mh, MSG_NOSIGNAL);
                         }
@@ -1021,6 +1264,8 @@ int log_struct_iovec_internal(
                         iovec[1+i*2+1] = IOVEC_MAKE_STRING("\n");
                 }
 
+                log_async_flush();
+
                 if (sendmsg(journal_fd, &mh, MSG_NOSIGNAL) >= 0)
                         return -ERRNO_VALUE(error);
         }
@@ -1130,6 +1375,17 @@ void log_parse_environment_realm(LogRealm realm) {
         e = getenv("SYSTEMD_LOG_LOCATION");
         if (e && log_show_location_from_string(e) < 0)
                 log_warning("Failed to parse log location '%s'. Ignoring.", e);
+
+        e = getenv("SYSTEMD_LOG_ASYNC");
+        if (e) {
+                int r;
+
+                r = parse_boolean(e);
+                if (r < 0)
+                        log_warning_errno(r, "Failed to parse $SYSTEMD_LOG_ASYNC, ignoring: %s", e);
+                else if (log_set_async(r) < 0)
+                        log_warning("Failed to enable asynchronous logging, ignoring.");
+        }
 }
 
 LogTarget log_get_target(void) {
@@ -296,6 +296,14 @@ void log_set_open_when_needed(bool b);
  * stderr, the console or kmsg */
 void log_set_prohibit_ipc(bool b);
 
+/* If turned on, messages for the journal are queued in a bounded in-process ring buffer and sent from a
+ * background thread, instead of blocking the caller while journald is busy. Messages that don't fit are
+ * dropped and counted. Critical and structured messages are still sent synchronously, after everything
+ * queued before them, and the ring is flushed on exit. */
+int log_set_async(bool b);
+uint64_t log_get_async_dropped(void);
+void log_async_flush(void);
+
 int log_dup_console(void);
 
 int log_syntax_internal(
@@ -337,4 +345,8 @@ int log_syntax_invalid_utf8_internal(
 
 #define DEBUG_LOGGING _unlikely_(log_get_max_level() >= LOG_DEBUG)
 
+/* Wrappers around log_internal() and friends should check this before evaluating any of their arguments,
+ * so that disabled (debug) messages cost nothing but this comparison. */
+#define log_level_enabled(level) (log_get_max_level() >= LOG_PRI(level))
+
 void log_setup_service(void);
@@ -7,7 +7,6 @@
 #include "macro.h"
 #include "memory-util.h"
 #include "mempool.h"
-#include "process-util.h"
 #include "util.h"
 
 struct pool {
@@ -69,16 +68,85 @@ void* mempool_alloc0_tile(struct mempool *mp) {
 }
 
 void mempool_free_tile(struct mempool *mp, void *p) {
+        /* The tile might come from another thread's pool, if the object was passed on between threads. It
+         * is put on our freelist nonetheless, and reused from here. That's safe, because a pool is only
+         * released once all tiles ever handed out from it are on its own thread's freelist again, see
+         * mempool_trim(). */
+
         * (void**) p = mp->freelist;
         mp->freelist = p;
 }
 
-bool mempool_enabled(void) {
-        static int b = -1;
+static void* pool_ptr(struct pool *p) {
+        return ((uint8_t*) p) + ALIGN(sizeof(struct pool));
+}
 
-        if (!is_main_thread())
+static bool pool_contains(struct mempool *mp, struct pool *p, void *ptr) {
+        size_t off;
+
+        if ((uint8_t*) ptr < (uint8_t*) pool_ptr(p))
                 return false;
 
+        off = (uint8_t*) ptr - (uint8_t*) pool_ptr(p);
+        return off < p->n_tiles * mp->tile_size;
+}
+
+static bool pool_is_unused(struct mempool *mp, struct pool *p) {
+        size_t n = 0;
+        void *i;
+
+        /* A pool is unused if every tile handed out from it is back on the freelist */
+
+        for (i = mp->freelist; i && n < p->n_used; i = * (void**) i)
+                if (pool_contains(mp, p, i))
+                        n++;
+
+        return n == p->n_used;
+}
+
+static void pool_unlink(struct mempool *mp, struct pool *p) {
+        size_t n = 0;
+        void **i;
+
+        /* Removes all tiles of the pool from the freelist */
+
+        for (i = &mp->freelist; *i && n < p->n_used; )
+                if (pool_contains(mp, p, *i)) {
+                        *i = * (void**) *i;
+                        n++;
+                } else
+                        i = (void**) *i;
+}
+
+size_t mempool_trim(struct mempool *mp) {
+        struct pool **p;
+        size_t trimmed = 0;
+
+        /* Releases all pools no tile is allocated from anymore. Note that this has to walk the freelist for
+         * each pool, hence it's expensive and should only be done when memory is tight. Tiles of our pools
+         * that ended up on another thread's freelist count as allocated, and keep their pool around. */
+
+        for (p = &mp->first_pool; *p; ) {
+                struct pool *d = *p;
+
+                if (!pool_is_unused(mp, d)) {
+                        p = &d->next;
+                        continue;
+                }
+
+                pool_unlink(mp, d);
+                *p = d->next;
+
+                trimmed += ALIGN(sizeof(struct pool)) + d->n_tiles * mp->tile_size;
+                free(d);
+        }
+
+        return trimmed;
+}
+
+bool mempool_enabled(void) {
+        static int b = -1;
+
         if (!mempool_use_allowed)
                 b = false;
         if (b < 0)
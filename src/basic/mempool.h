@@ -4,6 +4,8 @@
 #include <stdbool.h>
 #include <stddef.h>
 
+#include "macro.h"
+
 struct pool;
 
 struct mempool {
@@ -16,9 +18,12 @@ struct mempool {
 void* mempool_alloc_tile(struct mempool *mp);
 void* mempool_alloc0_tile(struct mempool *mp);
 void mempool_free_tile(struct mempool *mp, void *p);
+size_t mempool_trim(struct mempool *mp);
 
+/* Pools are per thread, hence need no locking. Tiles may be freed by a different thread than the one that
+ * allocated them. */
 #define DEFINE_MEMPOOL(pool_name, tile_type, alloc_at_least) \
-static struct mempool pool_name = { \
+static thread_local struct mempool pool_name = { \
         .tile_size = sizeof(tile_type), \
         .at_least = alloc_at_least, \
 }
@@ -47,6 +47,22 @@
 #define MS_LAZYTIME     (1<<25)
 #endif
 
+/* 04b38d601239b4d9be641b412cf4b7456a041c67 (4.5) */
+#ifndef FICLONE
+#define FICLONE _IOW(0x94, 9, int)
+#endif
+
+#ifndef FICLONERANGE
+struct file_clone_range {
+        __s64 src_fd;
+        __u64 src_offset;
+        __u64 src_length;
+        __u64 dest_offset;
+};
+
+#define FICLONERANGE _IOW(0x94, 13, struct file_clone_range)
+#endif
+
 /* Not exposed yet. Defined at fs/ext4/ext4.h */
 #ifndef EXT4_IOC_RESIZE_FS
 #define EXT4_IOC_RESIZE_FS _IOW('f', 16, __u64)
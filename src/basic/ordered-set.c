@@ -36,6 +36,10 @@ int ordered_set_put_strdupv(OrderedSet *s, char **l) {
         int n = 0, r;
         char **i;
 
+        r = ordered_set_reserve(s, strv_length(l));
+        if (r < 0)
+                return r;
+
         STRV_FOREACH(i, l) {
                 r = ordered_set_put_strdup(s, *i);
                 if (r < 0)
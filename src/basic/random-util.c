@@ -22,12 +22,34 @@
 #include "fd-util.h"
 #include "fileio.h"
 #include "io-util.h"
+#include "memory-util.h"
 #include "missing_random.h"
 #include "missing_syscall.h"
 #include "parse-util.h"
+#include "process-util.h"
 #include "random-util.h"
 #include "siphash24.h"
 #include "time-util.h"
+#include "unaligned.h"
+
+/* random_bytes() hands out the key stream of ChaCha20, keyed from the kernel's random pool. Every refill of
+ * the buffer generates RANDOM_BUFFER_BLOCKS blocks, the first 32 bytes of which replace the key, so that
+ * bytes handed out earlier cannot be recovered from the state. */
+#define RANDOM_BUFFER_BLOCKS 8U
+#define RANDOM_BUFFER_SIZE (RANDOM_BUFFER_BLOCKS * 64U - 32U)
+
+/* After this many bytes a fresh key is acquired from the kernel */
+#define RANDOM_BUFFER_RESEED (1024U * 1024U)
+
+typedef struct RandomBuffer {
+        uint32_t key[8];
+        uint8_t data[RANDOM_BUFFER_SIZE];
+        size_t n_available;     /* Unused bytes at the end of 'data' */
+        uint64_t n_since_seed;
+        pid_t pid;              /* The process we were seeded in, 0 if not seeded yet */
+} RandomBuffer;
+
+static thread_local RandomBuffer random_buffer;
 
 static bool srand_called = false;
 
@@ -358,6 +380,109 @@ void pseudo_random_bytes(void *p, size_t n) {
         }
 }
 
+#define ROTL32(v, n) (((v) << (n)) | ((v) >> (32 - (n))))
+
+#define QUARTERROUND(a, b, c, d)                        \
+        do {                                            \
+                a += b; d ^= a; d = ROTL32(d, 16);      \
+                c += d; b ^= c; b = ROTL32(b, 12);      \
+                a += b; d ^= a; d = ROTL32(d, 8);       \
+                c += d; b ^= c; b = ROTL32(b, 7);       \
+        } while (false)
+
+static void chacha20_block(const uint32_t key[static 8], uint32_t counter, uint8_t out[static 64]) {
+        uint32_t in[16] = {
+                0x61707865, 0x3320646e, 0x79622d32, 0x6b206574, /* "expand 32-byte k" */
+                key[0], key[1], key[2], key[3], key[4], key[5], key[6], key[7],
+                counter, 0, 0, 0,
+        }, x[16];
+        unsigned i;
+
+        memcpy(x, in, sizeof(x));
+
+        for (i = 0; i < 10; i++) {
+                QUARTERROUND(x[0], x[4], x[8], x[12]);
+                QUARTERROUND(x[1], x[5], x[9], x[13]);
+                QUARTERROUND(x[2], x[6], x[10], x[14]);
+                QUARTERROUND(x[3], x[7], x[11], x[15]);
+
+                QUARTERROUND(x[0], x[5], x[10], x[15]);
+                QUARTERROUND(x[1], x[6], x[11], x[12]);
+                QUARTERROUND(x[2], x[7], x[8], x[13]);
+                QUARTERROUND(x[3], x[4], x[9], x[14]);
+        }
+
+        for (i = 0; i < 16; i++)
+                unaligned_write_le32(out + i * 4, x[i] + in[i]);
+
+        explicit_bzero_safe(in, sizeof(in));
+        explicit_bzero_safe(x, sizeof(x));
+}
+
+static void random_buffer_refill(RandomBuffer *b) {
+        uint8_t stream[RANDOM_BUFFER_BLOCKS * 64];
+        unsigned i;
+
+        assert(b);
+
+        /* Each key is used for a single refill only, hence the nonce may stay zero */
+        for (i = 0; i < RANDOM_BUFFER_BLOCKS; i++)
+                chacha20_block(b->key, i, stream + i * 64);
+
+        for (i = 0; i < ELEMENTSOF(b->key); i++)
+                b->key[i] = unaligned_read_le32(stream + i * 4);
+
+        memcpy(b->data, stream + sizeof(b->key), sizeof(b->data));
+        b->n_available = sizeof(b->data);
+
+        explicit_bzero_safe(stream, sizeof(stream));
+}
+
+static int random_buffer_get(void *p, size_t n) {
+        RandomBuffer *b = &random_buffer;
+        pid_t pid;
+        int r;
+
+        /* Returns -ENODATA if the kernel's random pool is not initialized yet, in which case we keep trying
+         * with every call until it is, and leave it to the caller to find something else meanwhile */
+
+        pid = getpid_cached();
+
+        /* After fork() parent and child must not hand out the same bytes, hence the child gets its own key */
+        if (b->pid != pid || b->n_since_seed >= RANDOM_BUFFER_RESEED) {
+                r = genuine_random_bytes(b->key, sizeof(b->key), RANDOM_MAY_FAIL);
+                if (r < 0 && b->pid != pid)
+                        return r;
+                /* If reseeding fails otherwise, the current key is still good, keep using it */
+
+                b->n_available = 0;
+                b->n_since_seed = 0;
+                b->pid = pid;
+        }
+
+        b->n_since_seed += n;
+
+        while (n > 0) {
+                uint8_t *q;
+                size_t m;
+
+                if (b->n_available == 0)
+                        random_buffer_refill(b);
+
+                m = MIN(n, b->n_available);
+                q = b->data + sizeof(b->data) - b->n_available;
+
+                memcpy(p, q, m);
+                explicit_bzero_safe(q, m);
+
+                p = (uint8_t*) p + m;
+                n -= m;
+                b->n_available -= m;
+        }
+
+        return 0;
+}
+
 void random_bytes(void *p, size_t n) {
 
         /* This returns high quality randomness if we can get it cheaply. If we can't because for some reason
@@ -365,8 +490,12 @@ void random_bytes(void *p, size_t n) {
          *
          * What this function will do:
          *
-         *         • This function will preferably use the CPU's RDRAND operation, if it is available, in
-         *           order to return "mid-quality" random values cheaply.
+         *         • This function will preferably return bytes from a per-thread ChaCha20 key stream, keyed
+         *           with high-quality random values from the kernel, so that it usually does not have to
+         *           issue a system call at all.
+         *
+         *         • Until the kernel's random pool is initialized, it will use the CPU's RDRAND operation,
+         *           if it is available, in order to return "mid-quality" random values cheaply.
          *
          *         • Use getrandom() with GRND_NONBLOCK, to return high-quality random values if they are
          *           cheaply available.
@@ -392,6 +521,12 @@ void random_bytes(void *p, size_t n) {
          * This function is hence not useful for generating UUIDs or cryptographic key material.
          */
 
+        if (n == 0)
+                return;
+
+        if (random_buffer_get(p, n) >= 0)
+                return;
+
         if (genuine_random_bytes(p, n, RANDOM_EXTEND_WITH_PSEUDO|RANDOM_MAY_FAIL|RANDOM_ALLOW_RDRAND) >= 0)
                 return;
 
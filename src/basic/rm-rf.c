@@ -13,6 +13,7 @@
 #include "fd-util.h"
 #include "log.h"
 #include "macro.h"
+#include "missing_stat.h"
 #include "mountpoint-util.h"
 #include "path-util.h"
 #include "rm-rf.h"
@@ -72,9 +73,11 @@ int rm_rf_children(int fd, RemoveFlags flags, struct stat *root_dev) {
 
                 if (de->d_type == DT_UNKNOWN ||
                     (de->d_type == DT_DIR && (root_dev || (flags & REMOVE_SUBVOLUME)))) {
-                        if (fstatat(fd, de->d_name, &st, AT_SYMLINK_NOFOLLOW) < 0) {
-                                if (ret == 0 && errno != ENOENT)
-                                        ret = -errno;
+                        /* We only need the type, the inode number and the device here */
+                        r = fstatat_masked(fd, de->d_name, AT_SYMLINK_NOFOLLOW, STATX_TYPE|STATX_INO, &st);
+                        if (r < 0) {
+                                if (ret == 0 && r != -ENOENT)
+                                        ret = r;
                                 continue;
                         }
 
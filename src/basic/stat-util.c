@@ -14,6 +14,8 @@
 #include "macro.h"
 #include "missing_fs.h"
 #include "missing_magic.h"
+#include "missing_stat.h"
+#include "missing_syscall.h"
 #include "parse-util.h"
 #include "stat-util.h"
 #include "string-util.h"
@@ -231,6 +233,54 @@ int path_is_temporary_fs(const char *path) {
         return fd_is_temporary_fs(fd);
 }
 
+int fstatat_masked(int dir_fd, const char *path, int flags, unsigned mask, struct stat *ret) {
+        static bool avoid_statx = false;
+        struct_statx sx;
+
+        assert(path);
+        assert(ret);
+
+        /* Like fstatat(), but only asks for the fields in mask (a combination of STATX_xyz flags), and
+         * doesn't force a round trip to the server on network file systems. This is much cheaper when
+         * going through large directory trees. Fields that were not asked for might be left zero, except
+         * for st_dev, which is always filled in. Falls back to fstatat() if statx() isn't available. */
+
+        if (!avoid_statx) {
+                if (statx(dir_fd, path, flags|AT_STATX_DONT_SYNC, mask, &sx) >= 0) {
+                        *ret = (struct stat) {
+                                .st_dev = makedev(sx.stx_dev_major, sx.stx_dev_minor),
+                                .st_ino = sx.stx_ino,
+                                .st_mode = sx.stx_mode,
+                                .st_nlink = sx.stx_nlink,
+                                .st_uid = sx.stx_uid,
+                                .st_gid = sx.stx_gid,
+                                .st_rdev = makedev(sx.stx_rdev_major, sx.stx_rdev_minor),
+                                .st_size = sx.stx_size,
+                                .st_blksize = sx.stx_blksize,
+                                .st_blocks = sx.stx_blocks,
+                                .st_atim.tv_sec = sx.stx_atime.tv_sec,
+                                .st_atim.tv_nsec = sx.stx_atime.tv_nsec,
+                                .st_mtim.tv_sec = sx.stx_mtime.tv_sec,
+                                .st_mtim.tv_nsec = sx.stx_mtime.tv_nsec,
+                                .st_ctim.tv_sec = sx.stx_ctime.tv_sec,
+                                .st_ctim.tv_nsec = sx.stx_ctime.tv_nsec,
+                        };
+                        return 0;
+                }
+
+                /* Old kernel, or a seccomp filter that doesn't know statx() yet */
+                if (errno == ENOSYS)
+                        avoid_statx = true;
+                else if (errno != EPERM)
+                        return -errno;
+        }
+
+        if (fstatat(dir_fd, path, ret, flags) < 0)
+                return -errno;
+
+        return 0;
+}
+
 int stat_verify_regular(const struct stat *st) {
         assert(st);
 
@@ -59,6 +59,8 @@ int path_is_temporary_fs(const char *path);
  */
 #define F_TYPE_EQUAL(a, b) (a == (typeof(a)) b)
 
+int fstatat_masked(int dir_fd, const char *path, int flags, unsigned mask, struct stat *ret);
+
 int stat_verify_regular(const struct stat *st);
 int fd_verify_regular(int fd);
 
@@ -346,6 +346,54 @@ int strv_split_extract(char ***t, const char *s, const char *separators, Extract
         return (int) n;
 }
 
+int strv_split_extract_arena(Arena *arena, char ***t, const char *s, const char *separators, ExtractFlags flags) {
+        char **l = NULL;
+        size_t n = 0, allocated = 0;
+        int r;
+
+        assert(arena);
+        assert(t);
+        assert(s);
+
+        /* Like strv_split_extract(), but both the array and the strings are allocated from the arena. The
+         * array is grown by doubling, outgrown copies are only released together with the arena. */
+
+        for (;;) {
+                char *word;
+
+                r = extract_first_word_arena(&s, arena, &word, separators, flags);
+                if (r < 0)
+                        return r;
+                if (r == 0)
+                        break;
+
+                if (n + 2 > allocated) {
+                        size_t k = MAX(n * 2 + 2, 8U);
+                        char **m;
+
+                        m = arena_realloc(arena, l, allocated * sizeof(char*), k * sizeof(char*));
+                        if (!m)
+                                return -ENOMEM;
+
+                        l = m;
+                        allocated = k;
+                }
+
+                l[n++] = word;
+                l[n] = NULL;
+        }
+
+        if (!l) {
+                l = arena_alloc0(arena, sizeof(char*));
+                if (!l)
+                        return -ENOMEM;
+        }
+
+        *t = l;
+
+        return (int) n;
+}
+
 char *strv_join_prefix(char * const *l, const char *separator, const char *prefix) {
         char * const *s;
         char *r, *e;
@@ -76,6 +76,7 @@ static inline char **strv_split(const char *s, const char *separator) {
 char **strv_split_newlines(const char *s);
 
 int strv_split_extract(char ***t, const char *s, const char *separators, ExtractFlags flags);
+int strv_split_extract_arena(Arena *arena, char ***t, const char *s, const char *separators, ExtractFlags flags);
 
 char *strv_join_prefix(char * const *l, const char *separator, const char *prefix);
 static inline char *strv_join(char * const *l, const char *separator) {
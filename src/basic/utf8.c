@@ -132,6 +132,13 @@ bool utf8_is_printable_newline(const char* str, size_t length, bool newline) {
                 int encoded_len, r;
                 char32_t val;
 
+                /* Shortcut for the common case of printable ASCII */
+                if (((uint8_t) *p >= ' ' && (uint8_t) *p < 0x7F) || *p == '\t' || (newline && *p == '\n')) {
+                        p++;
+                        length--;
+                        continue;
+                }
+
                 encoded_len = utf8_encoded_valid_unichar(p, length);
                 if (encoded_len < 0)
                         return false;
@@ -159,6 +166,12 @@ char *utf8_is_valid(const char *str) {
         while (*p) {
                 int len;
 
+                /* Most strings we check are plain ASCII, skip over that quickly */
+                if ((uint8_t) *p < 0x80) {
+                        p++;
+                        continue;
+                }
+
                 len = utf8_encoded_valid_unichar(p, (size_t) -1);
                 if (len < 0)
                         return NULL;
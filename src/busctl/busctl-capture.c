@@ -0,0 +1,229 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+
+#include "alloc-util.h"
+#include "bus-dump.h"
+#include "bus-message.h"
+#include "busctl-capture.h"
+#include "io-util.h"
+
+struct CaptureRing {
+        pthread_mutex_t mutex;
+        pthread_cond_t cond;
+
+        pthread_t writer;
+        bool writer_running;
+
+        int fd;
+        size_t snaplen;
+
+        /* A ring buffer of complete pcap frames. The bytes between 'first' and 'first + n_used' belong to the
+         * writer thread, everything else to the monitor thread. Only the indexes are protected by the mutex,
+         * the frames are copied in and written out without holding it. */
+        uint8_t *buffer;
+        size_t size, first, n_used;
+
+        bool finished;
+        int error;
+
+        /* Only touched by the monitor thread */
+        uint64_t n_frames, n_dropped, n_dropped_bytes;
+};
+
+static void* capture_writer(void *userdata) {
+        CaptureRing *r = userdata;
+
+        (void) pthread_setname_np(pthread_self(), "busctl-capture");
+
+        for (;;) {
+                size_t first, n;
+                int k;
+
+                assert_se(pthread_mutex_lock(&r->mutex) == 0);
+
+                while (!r->finished && r->n_used == 0)
+                        assert_se(pthread_cond_wait(&r->cond, &r->mutex) == 0);
+
+                if (r->n_used == 0) {
+                        assert_se(pthread_mutex_unlock(&r->mutex) == 0);
+                        break;
+                }
+
+                /* Write everything up to the end of the buffer in one go, the rest in the next iteration */
+                first = r->first;
+                n = MIN(r->n_used, r->size - r->first);
+
+                assert_se(pthread_mutex_unlock(&r->mutex) == 0);
+
+                k = loop_write(r->fd, r->buffer + first, n, true);
+
+                assert_se(pthread_mutex_lock(&r->mutex) == 0);
+
+                if (k < 0) {
+                        /* Everything queued from now on is counted as dropped */
+                        r->error = k;
+                        r->n_used = 0;
+                        assert_se(pthread_mutex_unlock(&r->mutex) == 0);
+                        break;
+                }
+
+                r->first = (r->first + n) % r->size;
+                r->n_used -= n;
+
+                assert_se(pthread_mutex_unlock(&r->mutex) == 0);
+        }
+
+        return NULL;
+}
+
+int capture_ring_new(size_t size, size_t snaplen, int fd, CaptureRing **ret) {
+        _cleanup_(capture_ring_freep) CaptureRing *r = NULL;
+        sigset_t ss, saved_ss;
+        int k;
+
+        assert(snaplen > 0);
+        assert(fd >= 0);
+        assert(ret);
+
+        /* Every message must fit, even if only truncated */
+        if (size < sizeof(pcaprec_hdr_t) + snaplen)
+                return -ENOBUFS;
+
+        r = new(CaptureRing, 1);
+        if (!r)
+                return -ENOMEM;
+
+        *r = (CaptureRing) {
+                .mutex = PTHREAD_MUTEX_INITIALIZER,
+                .cond = PTHREAD_COND_INITIALIZER,
+                .fd = fd,
+                .snaplen = snaplen,
+                .size = size,
+        };
+
+        r->buffer = malloc(size);
+        if (!r->buffer)
+                return -ENOMEM;
+
+        /* Signals are handled by the monitor thread only */
+        assert_se(sigfillset(&ss) >= 0);
+        k = pthread_sigmask(SIG_BLOCK, &ss, &saved_ss);
+        if (k > 0)
+                return -k;
+
+        k = pthread_create(&r->writer, NULL, capture_writer, r);
+        assert_se(pthread_sigmask(SIG_SETMASK, &saved_ss, NULL) == 0);
+        if (k > 0)
+                return -k;
+
+        r->writer_running = true;
+
+        *ret = TAKE_PTR(r);
+        return 0;
+}
+
+static void capture_ring_put(CaptureRing *r, size_t *offset, const void *data, size_t size) {
+        size_t n;
+
+        n = MIN(size, r->size - *offset);
+        memcpy(r->buffer + *offset, data, n);
+        memcpy(r->buffer, (const uint8_t*) data + n, size - n);
+
+        *offset = (*offset + size) % r->size;
+}
+
+void capture_ring_push(CaptureRing *r, sd_bus_message *m) {
+        struct bus_body_part *part;
+        size_t offset, n_free, frame_size, left, w;
+        pcaprec_hdr_t hdr;
+        bool failed, wakeup;
+        unsigned i;
+
+        assert(r);
+        assert(m);
+
+        bus_message_pcap_frame_header(m, r->snaplen, &hdr);
+        frame_size = sizeof(hdr) + hdr.incl_len;
+
+        /* The free space can only grow while we copy, as the writer thread is the only one releasing it */
+        assert_se(pthread_mutex_lock(&r->mutex) == 0);
+        offset = (r->first + r->n_used) % r->size;
+        n_free = r->size - r->n_used;
+        failed = r->error < 0;
+        assert_se(pthread_mutex_unlock(&r->mutex) == 0);
+
+        if (failed || frame_size > n_free) {
+                r->n_dropped++;
+                r->n_dropped_bytes += hdr.orig_len;
+                return;
+        }
+
+        capture_ring_put(r, &offset, &hdr, sizeof(hdr));
+
+        left = hdr.incl_len;
+        w = MIN(BUS_MESSAGE_BODY_BEGIN(m), left);
+        capture_ring_put(r, &offset, m->header, w);
+        left -= w;
+
+        MESSAGE_FOREACH_PART(part, i, m) {
+                if (left <= 0)
+                        break;
+
+                w = MIN(part->size, left);
+                capture_ring_put(r, &offset, part->data, w);
+                left -= w;
+        }
+
+        assert_se(pthread_mutex_lock(&r->mutex) == 0);
+        if (r->error < 0) {
+                assert_se(pthread_mutex_unlock(&r->mutex) == 0);
+                r->n_dropped++;
+                r->n_dropped_bytes += hdr.orig_len;
+                return;
+        }
+        wakeup = r->n_used == 0;
+        r->n_used += frame_size;
+        if (wakeup)
+                assert_se(pthread_cond_signal(&r->cond) == 0);
+        assert_se(pthread_mutex_unlock(&r->mutex) == 0);
+
+        r->n_frames++;
+}
+
+int capture_ring_finish(CaptureRing *r, uint64_t *ret_frames, uint64_t *ret_dropped, uint64_t *ret_dropped_bytes) {
+        assert(r);
+
+        /* Waits until everything queued is written out */
+
+        if (r->writer_running) {
+                assert_se(pthread_mutex_lock(&r->mutex) == 0);
+                r->finished = true;
+                assert_se(pthread_cond_signal(&r->cond) == 0);
+                assert_se(pthread_mutex_unlock(&r->mutex) == 0);
+
+                (void) pthread_join(r->writer, NULL);
+                r->writer_running = false;
+        }
+
+        if (ret_frames)
+                *ret_frames = r->n_frames;
+        if (ret_dropped)
+                *ret_dropped = r->n_dropped;
+        if (ret_dropped_bytes)
+                *ret_dropped_bytes = r->n_dropped_bytes;
+
+        return r->error;
+}
+
+CaptureRing* capture_ring_free(CaptureRing *r) {
+        if (!r)
+                return NULL;
+
+        (void) capture_ring_finish(r, NULL, NULL, NULL);
+
+        free(r->buffer);
+        return mfree(r);
+}
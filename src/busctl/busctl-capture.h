@@ -0,0 +1,17 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+#pragma once
+
+#include <inttypes.h>
+
+#include "sd-bus.h"
+
+#include "macro.h"
+
+typedef struct CaptureRing CaptureRing;
+
+int capture_ring_new(size_t size, size_t snaplen, int fd, CaptureRing **ret);
+CaptureRing* capture_ring_free(CaptureRing *r);
+DEFINE_TRIVIAL_CLEANUP_FUNC(CaptureRing*, capture_ring_free);
+
+void capture_ring_push(CaptureRing *r, sd_bus_message *m);
+int capture_ring_finish(CaptureRing *r, uint64_t *ret_frames, uint64_t *ret_dropped, uint64_t *ret_dropped_bytes);
@@ -11,11 +11,13 @@
 #include "bus-signature.h"
 #include "bus-type.h"
 #include "bus-util.h"
+#include "busctl-capture.h"
 #include "busctl-introspect.h"
 #include "escape.h"
 #include "fd-util.h"
 #include "fileio.h"
 #include "format-table.h"
+#include "format-util.h"
 #include "json.h"
 #include "locale-util.h"
 #include "log.h"
@@ -25,6 +27,7 @@
 #include "path-util.h"
 #include "pretty-print.h"
 #include "set.h"
+#include "signal-util.h"
 #include "sort-util.h"
 #include "strv.h"
 #include "terminal-util.h"
@@ -48,6 +51,7 @@ static BusTransport arg_transport = BUS_TRANSPORT_LOCAL;
 static const char *arg_host = NULL;
 static bool arg_user = false;
 static size_t arg_snaplen = 4096;
+static size_t arg_buffer_size = 0;
 static bool arg_list = false;
 static bool arg_quiet = false;
 static bool arg_verbose = false;
@@ -1161,6 +1165,19 @@ static int message_pcap(sd_bus_message *m, FILE *f) {
         return bus_message_pcap_frame(m, arg_snaplen, f);
 }
 
+static CaptureRing *capture_ring = NULL;
+static volatile sig_atomic_t capture_interrupted = false;
+
+static int message_capture(sd_bus_message *m, FILE *f) {
+        /* Only copies the raw message into the ring, it's written out by the writer thread */
+        capture_ring_push(capture_ring, m);
+        return 0;
+}
+
+static void capture_interrupt_handler(int sig) {
+        capture_interrupted = true;
+}
+
 static int message_json(sd_bus_message *m, FILE *f) {
         _cleanup_(json_variant_unrefp) JsonVariant *v = NULL, *w = NULL;
         char e[2];
@@ -1278,6 +1295,11 @@ static int monitor(int argc, char **argv, int (*dump)(sd_bus_message *m, FILE *f
         for (;;) {
                 _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL;
 
+                if (capture_interrupted) {
+                        log_info("Interrupted, exiting.");
+                        return 0;
+                }
+
                 r = sd_bus_process(bus, &m);
                 if (r < 0)
                         return log_error_errno(r, "Failed to process bus: %m");
@@ -1315,6 +1337,8 @@ static int monitor(int argc, char **argv, int (*dump)(sd_bus_message *m, FILE *f
                         continue;
 
                 r = sd_bus_wait(bus, (uint64_t) -1);
+                if (r == -EINTR)
+                        continue;
                 if (r < 0)
                         return log_error_errno(r, "Failed to wait for bus: %m");
         }
@@ -1324,6 +1348,46 @@ static int verb_monitor(int argc, char **argv, void *userdata) {
         return monitor(argc, argv, arg_json != JSON_OFF ? message_json : message_dump);
 }
 
+static int capture_buffered(int argc, char **argv) {
+        static const struct sigaction sa = {
+                .sa_handler = capture_interrupt_handler,
+        };
+        _cleanup_(capture_ring_freep) CaptureRing *ring = NULL;
+        uint64_t n_frames, n_dropped, n_dropped_bytes;
+        char buf[FORMAT_BYTES_MAX];
+        int r, k;
+
+        r = fflush_and_check(stdout);
+        if (r < 0)
+                return log_error_errno(r, "Couldn't write capture file: %m");
+
+        r = capture_ring_new(arg_buffer_size, arg_snaplen, fileno(stdout), &ring);
+        if (r == -ENOBUFS)
+                return log_error_errno(r, "Buffer size must be larger than the maximum packet length.");
+        if (r < 0)
+                return log_error_errno(r, "Failed to set up capture buffer: %m");
+
+        /* Terminate cleanly on SIGINT/SIGTERM, so that whatever is still buffered makes it to the file. No
+         * SA_RESTART, so that waiting for the bus is interrupted. */
+        assert_se(sigaction_many(&sa, SIGINT, SIGTERM, -1) >= 0);
+
+        capture_ring = ring;
+        r = monitor(argc, argv, message_capture);
+        capture_ring = NULL;
+
+        k = capture_ring_finish(ring, &n_frames, &n_dropped, &n_dropped_bytes);
+        if (k < 0)
+                log_error_errno(k, "Couldn't write capture file: %m");
+
+        if (n_dropped > 0)
+                log_warning("Captured %" PRIu64 " messages, dropped %" PRIu64 " messages (%s) because the buffer was full.",
+                            n_frames, n_dropped, format_bytes(buf, sizeof(buf), n_dropped_bytes));
+        else
+                log_info("Captured %" PRIu64 " messages, dropped none.", n_frames);
+
+        return r < 0 ? r : k;
+}
+
 static int verb_capture(int argc, char **argv, void *userdata) {
         int r;
 
@@ -1333,6 +1397,9 @@ static int verb_capture(int argc, char **argv, void *userdata) {
 
         bus_pcap_header(arg_snaplen, stdout);
 
+        if (arg_buffer_size > 0)
+                return capture_buffered(argc, argv);
+
         r = monitor(argc, argv, message_pcap);
         if (r < 0)
                 return r;
@@ -2262,6 +2329,8 @@ static int help(void) {
                "     --activatable         Only show activatable names\n"
                "     --match=MATCH         Only show matching messages\n"
                "     --size=SIZE           Maximum length of captured packet\n"
+               "     --buffer-size=SIZE    Buffer captured packets in memory, drop them\n"
+               "                           when the buffer is full\n"
                "     --list                Don't show tree, but simple object path list\n"
                "  -q --quiet               Don't show method call reply\n"
                "     --verbose             Show result values in long format\n"
@@ -2305,6 +2374,7 @@ static int parse_argv(int argc, char *argv[]) {
                 ARG_ACQUIRED,
                 ARG_ACTIVATABLE,
                 ARG_SIZE,
+                ARG_BUFFER_SIZE,
                 ARG_LIST,
                 ARG_VERBOSE,
                 ARG_XML_INTERFACE,
@@ -2334,6 +2404,7 @@ static int parse_argv(int argc, char *argv[]) {
                 { "host",                            required_argument, NULL, 'H'                                 },
                 { "machine",                         required_argument, NULL, 'M'                                 },
                 { "size",                            required_argument, NULL, ARG_SIZE                            },
+                { "buffer-size",                     required_argument, NULL, ARG_BUFFER_SIZE                     },
                 { "list",                            no_argument,       NULL, ARG_LIST                            },
                 { "quiet",                           no_argument,       NULL, 'q'                                 },
                 { "verbose",                         no_argument,       NULL, ARG_VERBOSE                         },
@@ -2420,6 +2491,21 @@ static int parse_argv(int argc, char *argv[]) {
                         break;
                 }
 
+                case ARG_BUFFER_SIZE: {
+                        uint64_t sz;
+
+                        r = parse_size(optarg, 1024, &sz);
+                        if (r < 0)
+                                return log_error_errno(r, "Failed to parse buffer size '%s': %m", optarg);
+
+                        if ((uint64_t) (size_t) sz != sz)
+                                return log_error_errno(SYNTHETIC_ERRNO(E2BIG),
+                                                       "Buffer size out of range.");
+
+                        arg_buffer_size = (size_t) sz;
+                        break;
+                }
+
                 case ARG_LIST:
                         arg_list = true;
                         break;
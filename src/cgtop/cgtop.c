@@ -419,7 +419,7 @@ static int process(
 }
 
 static int refresh_one(
-                const char *controller,
+                char **controllers,
                 const char *path,
                 Hashmap *a,
                 Hashmap *b,
@@ -429,20 +429,23 @@ static int refresh_one(
 
         _cleanup_closedir_ DIR *d = NULL;
         Group *ours = NULL;
+        char **c;
         int r;
 
-        assert(controller);
+        assert(!strv_isempty(controllers));
         assert(path);
         assert(a);
 
         if (depth > arg_depth)
                 return 0;
 
-        r = process(controller, path, a, b, iteration, &ours);
-        if (r < 0)
-                return r;
+        STRV_FOREACH(c, controllers) {
+                r = process(*c, path, a, b, iteration, &ours);
+                if (r < 0)
+                        return r;
+        }
 
-        r = cg_enumerate_subgroups(controller, path, &d);
+        r = cg_enumerate_subgroups(controllers[0], path, &d);
         if (r == -ENOENT)
                 return 0;
         if (r < 0)
@@ -464,7 +467,7 @@ static int refresh_one(
 
                 path_simplify(p, false);
 
-                r = refresh_one(controller, p, a, b, iteration, depth + 1, &child);
+                r = refresh_one(controllers, p, a, b, iteration, depth + 1, &child);
                 if (r < 0)
                         return r;
 
@@ -472,7 +475,7 @@ static int refresh_one(
                     IN_SET(arg_count, COUNT_ALL_PROCESSES, COUNT_USERSPACE_PROCESSES) &&
                     child &&
                     child->n_tasks_valid &&
-                    streq(controller, SYSTEMD_CGROUP_CONTROLLER)) {
+                    strv_contains(controllers, SYSTEMD_CGROUP_CONTROLLER)) {
 
                         /* Recursively sum up processes */
 
@@ -495,8 +498,19 @@ static int refresh(const char *root, Hashmap *a, Hashmap *b, unsigned iteration)
         const char *c;
         int r;
 
+        r = cg_all_unified();
+        if (r < 0)
+                return r;
+        if (r > 0) {
+                /* On the unified hierarchy all controllers share the same tree, hence walk it only once, and
+                 * collect everything we want to know about a group while we are there. With many groups,
+                 * walking the tree is the expensive part. */
+                r = refresh_one(STRV_MAKE(SYSTEMD_CGROUP_CONTROLLER, "cpu", "memory", "io", "pids"), root, a, b, iteration, 0, NULL);
+                return r < 0 ? r : 0;
+        }
+
         FOREACH_STRING(c, SYSTEMD_CGROUP_CONTROLLER, "cpu", "cpuacct", "memory", "io", "blkio", "pids") {
-                r = refresh_one(c, root, a, b, iteration, 0, NULL);
+                r = refresh_one(STRV_MAKE(c), root, a, b, iteration, 0, NULL);
                 if (r < 0)
                         return r;
         }
@@ -581,6 +595,37 @@ static int group_compare(Group * const *a, Group * const *b) {
         return path_compare(x->path, y->path);
 }
 
+static unsigned select_top_groups(Group **array, unsigned n, unsigned k) {
+        unsigned m = 0, j;
+
+        /* Moves the first k groups in sort order to the beginning of the array, sorted, and returns how
+         * many there are. With thousands of groups and a screenful of them shown, this is a lot cheaper
+         * than sorting all of them. */
+
+        if (k == 0)
+                return 0;
+
+        for (j = 0; j < n; j++) {
+                Group *g = array[j];
+                unsigned p;
+
+                if (m >= k && group_compare(&g, &array[k - 1]) >= 0)
+                        continue;
+
+                if (m < k)
+                        p = m++;
+                else
+                        p = k - 1;
+
+                for (; p > 0 && group_compare(&g, &array[p - 1]) < 0; p--)
+                        array[p] = array[p - 1];
+
+                array[p] = g;
+        }
+
+        return m;
+}
+
 static void display(Hashmap *a) {
         Iterator i;
         Group *g;
@@ -600,7 +645,15 @@ static void display(Hashmap *a) {
                 if (g->n_tasks_valid || g->cpu_valid || g->memory_valid || g->io_valid)
                         array[n++] = g;
 
-        typesafe_qsort(array, n, group_compare);
+        rows = lines();
+        if (rows <= 10)
+                rows = 10;
+
+        /* On a terminal only the first few groups fit on the screen, hence don't bother sorting the rest */
+        if (on_tty())
+                n = select_top_groups(array, n, rows - 5);
+        else
+                typesafe_qsort(array, n, group_compare);
 
         /* Find the longest names in one run */
         for (j = 0; j < n; j++) {
@@ -619,10 +672,6 @@ static void display(Hashmap *a) {
         else
                 xsprintf(buffer, "%*s", maxtcpu, "CPU Time");
 
-        rows = lines();
-        if (rows <= 10)
-                rows = 10;
-
         if (on_tty()) {
                 const char *on, *off;
 
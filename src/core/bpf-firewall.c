@@ -18,6 +18,8 @@
 #include "bpf-firewall.h"
 #include "bpf-program.h"
 #include "fd-util.h"
+#include "hexdecoct.h"
+#include "in-addr-util.h"
 #include "ip-address-access.h"
 #include "memory-util.h"
 #include "missing_syscall.h"
@@ -35,6 +37,16 @@ enum {
         ACCESS_DENIED  = 2,
 };
 
+/* The access maps only depend on the configured addresses, hence units with the same rules (for example all
+ * instances of a template) share them, instead of each allocating an identical LPM trie in the kernel. The
+ * programs and accounting maps remain per unit, since the programs refer to the accounting maps. */
+struct BPFFirewallMap {
+        Manager *manager;
+        unsigned n_ref;
+        char *key;
+        int fd;
+};
+
 /* Compile instructions for one list of addresses, one direction and one specific verdict on matches. */
 
 static int add_lookup_instructions(
@@ -204,10 +216,10 @@ static int bpf_firewall_compile_bpf(
                 u->ip_accounting_egress_map_fd;
 
         access_enabled =
-                u->ipv4_allow_map_fd >= 0 ||
-                u->ipv6_allow_map_fd >= 0 ||
-                u->ipv4_deny_map_fd >= 0 ||
-                u->ipv6_deny_map_fd >= 0 ||
+                u->ipv4_allow_map ||
+                u->ipv6_allow_map ||
+                u->ipv4_deny_map ||
+                u->ipv6_deny_map ||
                 ip_allow_any ||
                 ip_deny_any;
 
@@ -233,26 +245,26 @@ static int bpf_firewall_compile_bpf(
                  * - Otherwise, access will be granted
                  */
 
-                if (u->ipv4_deny_map_fd >= 0) {
-                        r = add_lookup_instructions(p, u->ipv4_deny_map_fd, ETH_P_IP, is_ingress, ACCESS_DENIED);
+                if (u->ipv4_deny_map) {
+                        r = add_lookup_instructions(p, u->ipv4_deny_map->fd, ETH_P_IP, is_ingress, ACCESS_DENIED);
                         if (r < 0)
                                 return r;
                 }
 
-                if (u->ipv6_deny_map_fd >= 0) {
-                        r = add_lookup_instructions(p, u->ipv6_deny_map_fd, ETH_P_IPV6, is_ingress, ACCESS_DENIED);
+                if (u->ipv6_deny_map) {
+                        r = add_lookup_instructions(p, u->ipv6_deny_map->fd, ETH_P_IPV6, is_ingress, ACCESS_DENIED);
                         if (r < 0)
                                 return r;
                 }
 
-                if (u->ipv4_allow_map_fd >= 0) {
-                        r = add_lookup_instructions(p, u->ipv4_allow_map_fd, ETH_P_IP, is_ingress, ACCESS_ALLOWED);
+                if (u->ipv4_allow_map) {
+                        r = add_lookup_instructions(p, u->ipv4_allow_map->fd, ETH_P_IP, is_ingress, ACCESS_ALLOWED);
                         if (r < 0)
                                 return r;
                 }
 
-                if (u->ipv6_allow_map_fd >= 0) {
-                        r = add_lookup_instructions(p, u->ipv6_allow_map_fd, ETH_P_IPV6, is_ingress, ACCESS_ALLOWED);
+                if (u->ipv6_allow_map) {
+                        r = add_lookup_instructions(p, u->ipv6_allow_map->fd, ETH_P_IPV6, is_ingress, ACCESS_ALLOWED);
                         if (r < 0)
                                 return r;
                 }
@@ -362,64 +374,193 @@ static int bpf_firewall_count_access_items(IPAddressAccessItem *list, size_t *n_
 
 static int bpf_firewall_add_access_items(
                 IPAddressAccessItem *list,
-                int ipv4_map_fd,
-                int ipv6_map_fd,
+                int family,
+                int map_fd,
                 int verdict) {
 
-        struct bpf_lpm_trie_key *key_ipv4, *key_ipv6;
+        struct bpf_lpm_trie_key *key;
         uint64_t value = verdict;
         IPAddressAccessItem *a;
         int r;
 
-        key_ipv4 = alloca0(offsetof(struct bpf_lpm_trie_key, data) + sizeof(uint32_t));
-        key_ipv6 = alloca0(offsetof(struct bpf_lpm_trie_key, data) + sizeof(uint32_t) * 4);
+        key = alloca0(offsetof(struct bpf_lpm_trie_key, data) + FAMILY_ADDRESS_SIZE(family));
 
         LIST_FOREACH(items, a, list) {
-                switch (a->family) {
+                if (a->family != family)
+                        continue;
 
-                case AF_INET:
-                        key_ipv4->prefixlen = a->prefixlen;
-                        memcpy(key_ipv4->data, &a->address, sizeof(uint32_t));
+                key->prefixlen = a->prefixlen;
+                memcpy(key->data, &a->address, FAMILY_ADDRESS_SIZE(family));
 
-                        r = bpf_map_update_element(ipv4_map_fd, key_ipv4, &value);
-                        if (r < 0)
-                                return r;
+                r = bpf_map_update_element(map_fd, key, &value);
+                if (r < 0)
+                        return r;
+        }
 
-                        break;
+        return 0;
+}
 
-                case AF_INET6:
-                        key_ipv6->prefixlen = a->prefixlen;
-                        memcpy(key_ipv6->data, &a->address, 4 * sizeof(uint32_t));
+BPFFirewallMap *bpf_firewall_map_unref(BPFFirewallMap *m) {
+        if (!m)
+                return NULL;
+
+        assert(m->n_ref > 0);
+        if (--m->n_ref > 0)
+                return NULL;
+
+        if (m->manager)
+                (void) hashmap_remove_value(m->manager->bpf_firewall_maps, m->key, m);
+
+        safe_close(m->fd);
+        free(m->key);
+        return mfree(m);
+}
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(BPFFirewallMap*, bpf_firewall_map_unref);
+
+static int bpf_firewall_access_map_key(Unit *u, int verdict, int family, char **ret) {
+        _cleanup_strv_free_ char **l = NULL;
+        _cleanup_free_ char *joined = NULL;
+        char *key;
+        Unit *p;
+        int r;
+
+        assert(u);
+        assert(ret);
 
-                        r = bpf_map_update_element(ipv6_map_fd, key_ipv6, &value);
+        /* Describes the contents of the map we'd build for this unit. Since entries may appear in any
+         * order and more than once, sort them first. */
+
+        for (p = u; p; p = UNIT_DEREF(p->slice)) {
+                IPAddressAccessItem *a;
+                CGroupContext *cc;
+
+                cc = unit_get_cgroup_context(p);
+                if (!cc)
+                        continue;
+
+                LIST_FOREACH(items, a, verdict == ACCESS_ALLOWED ? cc->ip_address_allow : cc->ip_address_deny) {
+                        _cleanup_free_ char *h = NULL;
+                        char *e;
+
+                        if (a->family != family)
+                                continue;
+
+                        h = hexmem(&a->address, FAMILY_ADDRESS_SIZE(family));
+                        if (!h)
+                                return -ENOMEM;
+
+                        if (asprintf(&e, "%u/%s", a->prefixlen, h) < 0)
+                                return -ENOMEM;
+
+                        r = strv_consume(&l, e);
                         if (r < 0)
                                 return r;
+                }
+        }
 
-                        break;
+        strv_sort(l);
+        strv_uniq(l);
 
-                default:
-                        return -EAFNOSUPPORT;
-                }
+        joined = strv_join(l, ",");
+        if (!joined)
+                return -ENOMEM;
+
+        if (asprintf(&key, "%i %i %s", verdict, family, joined) < 0)
+                return -ENOMEM;
+
+        *ret = key;
+        return 0;
+}
+
+static int bpf_firewall_acquire_access_map(
+                Unit *u,
+                int verdict,
+                int family,
+                size_t n_entries,
+                BPFFirewallMap **ret) {
+
+        _cleanup_(bpf_firewall_map_unrefp) BPFFirewallMap *m = NULL;
+        _cleanup_free_ char *key = NULL;
+        Unit *p;
+        int r;
+
+        assert(u);
+        assert(n_entries > 0);
+        assert(ret);
+
+        r = bpf_firewall_access_map_key(u, verdict, family, &key);
+        if (r < 0)
+                return r;
+
+        m = hashmap_get(u->manager->bpf_firewall_maps, key);
+        if (m) {
+                m->n_ref++;
+                *ret = TAKE_PTR(m);
+                return 0;
+        }
+
+        m = new(BPFFirewallMap, 1);
+        if (!m)
+                return -ENOMEM;
+
+        *m = (BPFFirewallMap) {
+                .n_ref = 1,
+                .key = TAKE_PTR(key),
+                .fd = -1,
+        };
+
+        m->fd = bpf_map_new(
+                        BPF_MAP_TYPE_LPM_TRIE,
+                        offsetof(struct bpf_lpm_trie_key, data) + FAMILY_ADDRESS_SIZE(family),
+                        sizeof(uint64_t),
+                        n_entries,
+                        BPF_F_NO_PREALLOC);
+        if (m->fd < 0)
+                return m->fd;
+
+        for (p = u; p; p = UNIT_DEREF(p->slice)) {
+                CGroupContext *cc;
+
+                cc = unit_get_cgroup_context(p);
+                if (!cc)
+                        continue;
+
+                r = bpf_firewall_add_access_items(verdict == ACCESS_ALLOWED ? cc->ip_address_allow : cc->ip_address_deny,
+                                                  family, m->fd, verdict);
+                if (r < 0)
+                        return r;
         }
 
+        r = hashmap_ensure_allocated(&u->manager->bpf_firewall_maps, &string_hash_ops);
+        if (r < 0)
+                return r;
+
+        r = hashmap_put(u->manager->bpf_firewall_maps, m->key, m);
+        if (r < 0)
+                return r;
+
+        m->manager = u->manager;
+
+        *ret = TAKE_PTR(m);
         return 0;
 }
 
 static int bpf_firewall_prepare_access_maps(
                 Unit *u,
                 int verdict,
-                int *ret_ipv4_map_fd,
-                int *ret_ipv6_map_fd,
+                BPFFirewallMap **ret_ipv4_map,
+                BPFFirewallMap **ret_ipv6_map,
                 bool *ret_has_any) {
 
-        _cleanup_close_ int ipv4_map_fd = -1, ipv6_map_fd = -1;
+        _cleanup_(bpf_firewall_map_unrefp) BPFFirewallMap *ipv4_map = NULL, *ipv6_map = NULL;
         size_t n_ipv4 = 0, n_ipv6 = 0;
         IPAddressAccessItem *list;
         Unit *p;
         int r;
 
-        assert(ret_ipv4_map_fd);
-        assert(ret_ipv6_map_fd);
+        assert(ret_ipv4_map);
+        assert(ret_ipv6_map);
         assert(ret_has_any);
 
         for (p = u; p; p = UNIT_DEREF(p->slice)) {
@@ -442,42 +583,19 @@ static int bpf_firewall_prepare_access_maps(
         }
 
         if (n_ipv4 > 0) {
-                ipv4_map_fd = bpf_map_new(
-                                BPF_MAP_TYPE_LPM_TRIE,
-                                offsetof(struct bpf_lpm_trie_key, data) + sizeof(uint32_t),
-                                sizeof(uint64_t),
-                                n_ipv4,
-                                BPF_F_NO_PREALLOC);
-                if (ipv4_map_fd < 0)
-                        return ipv4_map_fd;
+                r = bpf_firewall_acquire_access_map(u, verdict, AF_INET, n_ipv4, &ipv4_map);
+                if (r < 0)
+                        return r;
         }
 
         if (n_ipv6 > 0) {
-                ipv6_map_fd = bpf_map_new(
-                                BPF_MAP_TYPE_LPM_TRIE,
-                                offsetof(struct bpf_lpm_trie_key, data) + sizeof(uint32_t)*4,
-                                sizeof(uint64_t),
-                                n_ipv6,
-                                BPF_F_NO_PREALLOC);
-                if (ipv6_map_fd < 0)
-                        return ipv6_map_fd;
-        }
-
-        for (p = u; p; p = UNIT_DEREF(p->slice)) {
-                CGroupContext *cc;
-
-                cc = unit_get_cgroup_context(p);
-                if (!cc)
-                        continue;
-
-                r = bpf_firewall_add_access_items(verdict == ACCESS_ALLOWED ? cc->ip_address_allow : cc->ip_address_deny,
-                                                  ipv4_map_fd, ipv6_map_fd, verdict);
+                r = bpf_firewall_acquire_access_map(u, verdict, AF_INET6, n_ipv6, &ipv6_map);
                 if (r < 0)
                         return r;
         }
 
-        *ret_ipv4_map_fd = TAKE_FD(ipv4_map_fd);
-        *ret_ipv6_map_fd = TAKE_FD(ipv6_map_fd);
+        *ret_ipv4_map = TAKE_PTR(ipv4_map);
+        *ret_ipv6_map = TAKE_PTR(ipv6_map);
         *ret_has_any = false;
         return 0;
 }
@@ -550,11 +668,11 @@ int bpf_firewall_compile(Unit *u) {
         u->ip_bpf_ingress = bpf_program_unref(u->ip_bpf_ingress);
         u->ip_bpf_egress = bpf_program_unref(u->ip_bpf_egress);
 
-        u->ipv4_allow_map_fd = safe_close(u->ipv4_allow_map_fd);
-        u->ipv4_deny_map_fd = safe_close(u->ipv4_deny_map_fd);
+        u->ipv4_allow_map = bpf_firewall_map_unref(u->ipv4_allow_map);
+        u->ipv4_deny_map = bpf_firewall_map_unref(u->ipv4_deny_map);
 
-        u->ipv6_allow_map_fd = safe_close(u->ipv6_allow_map_fd);
-        u->ipv6_deny_map_fd = safe_close(u->ipv6_deny_map_fd);
+        u->ipv6_allow_map = bpf_firewall_map_unref(u->ipv6_allow_map);
+        u->ipv6_deny_map = bpf_firewall_map_unref(u->ipv6_deny_map);
 
         if (u->type != UNIT_SLICE) {
                 /* In inner nodes we only do accounting, we do not actually bother with access control. However, leaf
@@ -563,11 +681,11 @@ int bpf_firewall_compile(Unit *u) {
                  * means that all configure IP access rules *will* take effect on processes, even though we never
                  * compile them for inner nodes. */
 
-                r = bpf_firewall_prepare_access_maps(u, ACCESS_ALLOWED, &u->ipv4_allow_map_fd, &u->ipv6_allow_map_fd, &ip_allow_any);
+                r = bpf_firewall_prepare_access_maps(u, ACCESS_ALLOWED, &u->ipv4_allow_map, &u->ipv6_allow_map, &ip_allow_any);
                 if (r < 0)
                         return log_unit_error_errno(u, r, "Preparation of eBPF allow maps failed: %m");
 
-                r = bpf_firewall_prepare_access_maps(u, ACCESS_DENIED, &u->ipv4_deny_map_fd, &u->ipv6_deny_map_fd, &ip_deny_any);
+                r = bpf_firewall_prepare_access_maps(u, ACCESS_DENIED, &u->ipv4_deny_map, &u->ipv6_deny_map, &ip_deny_any);
                 if (r < 0)
                         return log_unit_error_errno(u, r, "Preparation of eBPF deny maps failed: %m");
         }
@@ -749,6 +867,24 @@ int bpf_firewall_install(Unit *u) {
         return 0;
 }
 
+void bpf_firewall_dump_maps(Manager *m, FILE *f, const char *prefix) {
+        BPFFirewallMap *map;
+        unsigned n_ref = 0;
+        Iterator i;
+
+        assert(m);
+        assert(f);
+
+        if (hashmap_isempty(m->bpf_firewall_maps))
+                return;
+
+        HASHMAP_FOREACH(map, m->bpf_firewall_maps, i)
+                n_ref += map->n_ref;
+
+        fprintf(f, "%sBPF firewall access maps: %u (referenced %u times)\n",
+                strempty(prefix), hashmap_size(m->bpf_firewall_maps), n_ref);
+}
+
 int bpf_firewall_read_accounting(int map_fd, uint64_t *ret_bytes, uint64_t *ret_packets) {
         uint64_t key, packets;
         int r;
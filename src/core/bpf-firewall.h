@@ -17,6 +17,9 @@ int bpf_firewall_compile(Unit *u);
 int bpf_firewall_install(Unit *u);
 int bpf_firewall_load_custom(Unit *u);
 
+BPFFirewallMap *bpf_firewall_map_unref(BPFFirewallMap *m);
+void bpf_firewall_dump_maps(Manager *m, FILE *f, const char *prefix);
+
 int bpf_firewall_read_accounting(int map_fd, uint64_t *ret_bytes, uint64_t *ret_packets);
 int bpf_firewall_reset_accounting(int map_fd);
 
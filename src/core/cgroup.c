@@ -13,6 +13,8 @@
 #include "cgroup-setup.h"
 #include "cgroup-util.h"
 #include "cgroup.h"
+#include "escape.h"
+#include "extract-word.h"
 #include "fd-util.h"
 #include "fileio.h"
 #include "fs-util.h"
@@ -21,6 +23,7 @@
 #include "path-util.h"
 #include "process-util.h"
 #include "procfs-util.h"
+#include "serialize.h"
 #include "special.h"
 #include "stat-util.h"
 #include "stdio-util.h"
@@ -71,17 +74,110 @@ bool unit_has_host_root_cgroup(Unit *u) {
         return unit_has_name(u, SPECIAL_ROOT_SLICE);
 }
 
+static char *cgroup_attribute_key(const char *attribute, const char *value) {
+
+        /* Returns the key under which we remember the last value written to an attribute. Most attributes
+         * carry a single value, but some are keyed by a device (or "default"), and each line we write to them
+         * only changes the entry for that key. */
+
+        if (STR_IN_SET(attribute,
+                       "io.weight",
+                       "io.latency",
+                       "io.max",
+                       "blkio.weight_device",
+                       "blkio.throttle.read_bps_device",
+                       "blkio.throttle.write_bps_device")) {
+                char *k;
+
+                if (asprintf(&k, "%s %.*s", attribute, (int) strcspn(value, WHITESPACE), value) < 0)
+                        return NULL;
+
+                return k;
+        }
+
+        return strdup(attribute);
+}
+
+static void unit_remember_cgroup_attribute(Unit *u, const char *key, const char *value) {
+        _cleanup_free_ char *old_key = NULL;
+
+        free(hashmap_remove2(u->cgroup_attributes, key, (void**) &old_key));
+
+        if (value)
+                /* If this fails we'll simply write the attribute again next time */
+                (void) hashmap_put_strdup(&u->cgroup_attributes, key, value);
+}
+
+void unit_flush_cgroup_attributes(Unit *u) {
+        assert(u);
+
+        /* Forgets which attribute values we wrote last, so that the next cgroup_context_apply() writes all of
+         * them again. Needs to be called whenever the kernel might have reset them, i.e. whenever the cgroup
+         * or one of its controllers came and went. */
+
+        u->cgroup_attributes = hashmap_free(u->cgroup_attributes);
+}
+
 static int set_attribute_and_warn(Unit *u, const char *controller, const char *attribute, const char *value) {
+        _cleanup_free_ char *key = NULL;
         int r;
 
+        /* Skip the write if we wrote the very same value to the attribute before and the cgroup didn't go away
+         * in between. This saves us a lot of open()/write()/close() cycles when units are realized again, for
+         * example after each daemon-reload. */
+        key = cgroup_attribute_key(attribute, value);
+        if (key && streq_ptr(hashmap_get(u->cgroup_attributes, key), value))
+                return 0;
+
         r = cg_set_attribute(controller, u->cgroup_path, attribute, value);
         if (r < 0)
                 log_unit_full(u, LOG_LEVEL_CGROUP_WRITE(r), r, "Failed to set '%s' attribute on '%s' to '%.*s': %m",
                               strna(attribute), isempty(u->cgroup_path) ? "/" : u->cgroup_path, (int) strcspn(value, NEWLINE), value);
 
+        if (key)
+                unit_remember_cgroup_attribute(u, key, r >= 0 ? value : NULL);
+
         return r;
 }
 
+int unit_serialize_cgroup_attributes(Unit *u, FILE *f) {
+        const char *key, *value;
+        Iterator i;
+
+        assert(u);
+        assert(f);
+
+        HASHMAP_FOREACH_KEY(value, key, u->cgroup_attributes, i) {
+                _cleanup_free_ char *k = NULL, *v = NULL;
+
+                k = cescape(key);
+                v = cescape(value);
+                if (!k || !v)
+                        return log_oom();
+
+                (void) serialize_item_format(f, "cgroup-attribute", "\"%s\" \"%s\"", k, v);
+        }
+
+        return 0;
+}
+
+int unit_deserialize_cgroup_attribute(Unit *u, const char *value) {
+        _cleanup_free_ char *k = NULL, *v = NULL;
+        const char *p = value;
+        int r;
+
+        assert(u);
+        assert(value);
+
+        r = extract_many_words(&p, NULL, EXTRACT_UNQUOTE|EXTRACT_CUNESCAPE, &k, &v, NULL);
+        if (r < 0)
+                return r;
+        if (r != 2 || !isempty(p))
+                return -EINVAL;
+
+        return hashmap_put_strdup(&u->cgroup_attributes, k, v);
+}
+
 static void cgroup_compat_warn(void) {
         static bool cgroup_compat_warned = false;
 
@@ -1522,11 +1618,9 @@ CGroupMask unit_get_members_mask(Unit *u) {
         u->cgroup_members_mask = 0;
 
         if (u->type == UNIT_SLICE) {
-                void *v;
                 Unit *member;
-                Iterator i;
 
-                HASHMAP_FOREACH_KEY(v, member, u->dependencies[UNIT_BEFORE], i) {
+                UNIT_FOREACH_DEPENDENCY(member, u, UNIT_BEFORE) {
                         if (UNIT_DEREF(member->slice) == u)
                                 u->cgroup_members_mask |= unit_get_subtree_mask(member); /* note that this calls ourselves again, for the children */
                 }
@@ -1862,6 +1956,11 @@ static int unit_create_cgroup(
                 return log_unit_error_errno(u, r, "Failed to create cgroup %s: %m", u->cgroup_path);
         created = r;
 
+        /* If the cgroup was just created, or some of its controllers came or went, the kernel has reset the
+         * attributes, hence forget what we wrote earlier */
+        if (created || !u->cgroup_realized || u->cgroup_realized_mask != target_mask)
+                unit_flush_cgroup_attributes(u);
+
         /* Start watching it */
         (void) unit_watch_cgroup(u);
         (void) unit_watch_cgroup_memory(u);
@@ -2176,16 +2275,14 @@ static int unit_realize_cgroup_now_enable(Unit *u, ManagerState state) {
 /* Controllers can only be disabled depth-first, from the leaves of the
  * hierarchy upwards to the unit in question. */
 static int unit_realize_cgroup_now_disable(Unit *u, ManagerState state) {
-        Iterator i;
         Unit *m;
-        void *v;
 
         assert(u);
 
         if (u->type != UNIT_SLICE)
                 return 0;
 
-        HASHMAP_FOREACH_KEY(v, m, u->dependencies[UNIT_BEFORE], i) {
+        UNIT_FOREACH_DEPENDENCY(m, u, UNIT_BEFORE) {
                 CGroupMask target_mask, enable_mask, new_target_mask, new_enable_mask;
                 int r;
 
@@ -2339,11 +2436,9 @@ static void unit_add_siblings_to_cgroup_realize_queue(Unit *u) {
          * neither the specified unit itself nor the parents.) */
 
         while ((slice = UNIT_DEREF(u->slice))) {
-                Iterator i;
                 Unit *m;
-                void *v;
 
-                HASHMAP_FOREACH_KEY(v, m, u->dependencies[UNIT_BEFORE], i) {
+                UNIT_FOREACH_DEPENDENCY(m, u, UNIT_BEFORE) {
                         /* Skip units that have a dependency on the slice
                          * but aren't actually in it. */
                         if (UNIT_DEREF(m->slice) != slice)
@@ -2370,6 +2465,9 @@ static void unit_add_siblings_to_cgroup_realize_queue(Unit *u) {
 }
 
 int unit_realize_cgroup(Unit *u) {
+        nsec_t ts;
+        int r;
+
         assert(u);
 
         if (!UNIT_HAS_CGROUP_CONTEXT(u))
@@ -2386,11 +2484,16 @@ int unit_realize_cgroup(Unit *u) {
          * defer work on the siblings to the next event loop
          * iteration. */
 
+        ts = trace_now();
+
         /* Add all sibling slices to the cgroup queue. */
         unit_add_siblings_to_cgroup_realize_queue(u);
 
         /* And realize this one now (and apply the values) */
-        return unit_realize_cgroup_now(u, manager_state(u->manager));
+        r = unit_realize_cgroup_now(u, manager_state(u->manager));
+
+        trace_record(&u->manager->trace, TRACE_CGROUP_REALIZE, u->id, ts);
+        return r;
 }
 
 void unit_release_cgroup(Unit *u) {
@@ -2404,6 +2507,8 @@ void unit_release_cgroup(Unit *u) {
                 u->cgroup_path = mfree(u->cgroup_path);
         }
 
+        unit_flush_cgroup_attributes(u);
+
         if (u->cgroup_control_inotify_wd >= 0) {
                 if (inotify_rm_watch(u->manager->cgroup_inotify_fd, u->cgroup_control_inotify_wd) < 0)
                         log_unit_debug_errno(u, errno, "Failed to remove cgroup control inotify watch %i for %s, ignoring: %m", u->cgroup_control_inotify_wd, u->id);
@@ -2770,12 +2875,20 @@ static void unit_add_to_cgroup_oom_queue(Unit *u) {
 }
 
 static int on_cgroup_inotify_event(sd_event_source *s, int fd, uint32_t revents, void *userdata) {
+        _cleanup_set_free_ Set *empty = NULL;
         Manager *m = userdata;
+        Iterator i;
+        Unit *u;
+        int r = 0;
 
         assert(s);
         assert(fd >= 0);
         assert(m);
 
+        /* Drain the inotify queue first, and only then check each unit whose cgroup.events changed. During mass
+         * teardown a cgroup's events file is typically modified more than once per loop iteration, and checking
+         * whether it is empty means reading it back. */
+
         for (;;) {
                 union inotify_event_buffer buffer;
                 struct inotify_event *e;
@@ -2784,9 +2897,10 @@ static int on_cgroup_inotify_event(sd_event_source *s, int fd, uint32_t revents,
                 l = read(fd, &buffer, sizeof(buffer));
                 if (l < 0) {
                         if (IN_SET(errno, EINTR, EAGAIN))
-                                return 0;
+                                break;
 
-                        return log_error_errno(errno, "Failed to read control group inotify events: %m");
+                        r = log_error_errno(errno, "Failed to read control group inotify events: %m");
+                        break;
                 }
 
                 FOREACH_INOTIFY_EVENT(e, buffer, l) {
@@ -2804,7 +2918,9 @@ static int on_cgroup_inotify_event(sd_event_source *s, int fd, uint32_t revents,
                          * because it was queued before the removal. Let's ignore this here safely. */
 
                         u = hashmap_get(m->cgroup_control_inotify_wd_unit, INT_TO_PTR(e->wd));
-                        if (u)
+                        if (u && !u->in_cgroup_empty_queue &&
+                            (set_ensure_allocated(&empty, NULL) < 0 || set_put(empty, u) < 0))
+                                /* If we can't remember it for later, check it right away */
                                 unit_add_to_cgroup_empty_queue(u);
 
                         u = hashmap_get(m->cgroup_memory_inotify_wd_unit, INT_TO_PTR(e->wd));
@@ -2812,6 +2928,12 @@ static int on_cgroup_inotify_event(sd_event_source *s, int fd, uint32_t revents,
                                 unit_add_to_cgroup_oom_queue(u);
                 }
         }
+
+        /* Nothing is dispatched while we collect the units above, hence all of them are still valid here */
+        SET_FOREACH(u, empty, i)
+                unit_add_to_cgroup_empty_queue(u);
+
+        return r;
 }
 
 static int cg_bpf_mask_supported(CGroupMask *ret) {
@@ -3513,10 +3635,8 @@ void unit_invalidate_cgroup_bpf(Unit *u) {
          * list of our children includes our own. */
         if (u->type == UNIT_SLICE) {
                 Unit *member;
-                Iterator i;
-                void *v;
 
-                HASHMAP_FOREACH_KEY(v, member, u->dependencies[UNIT_BEFORE], i) {
+                UNIT_FOREACH_DEPENDENCY(member, u, UNIT_BEFORE) {
                         if (UNIT_DEREF(member->slice) == u)
                                 unit_invalidate_cgroup_bpf(member);
                 }
@@ -213,6 +213,9 @@ int unit_pick_cgroup_path(Unit *u);
 
 int unit_realize_cgroup(Unit *u);
 void unit_release_cgroup(Unit *u);
+void unit_flush_cgroup_attributes(Unit *u);
+int unit_serialize_cgroup_attributes(Unit *u, FILE *f);
+int unit_deserialize_cgroup_attribute(Unit *u, const char *value);
 void unit_prune_cgroup(Unit *u);
 int unit_watch_cgroup(Unit *u);
 int unit_watch_cgroup_memory(Unit *u);
@@ -1,6 +1,7 @@
 /* SPDX-License-Identifier: LGPL-2.1+ */
 
 #include <errno.h>
+#include <malloc.h>
 #include <sys/prctl.h>
 #include <sys/statvfs.h>
 #include <unistd.h>
@@ -663,7 +664,7 @@ static int method_unref_unit(sd_bus_message *message, void *userdata, sd_bus_err
         return method_generic_unit_operation(message, userdata, error, bus_unit_method_unref, 0);
 }
 
-static int reply_unit_info(sd_bus_message *reply, Unit *u) {
+static int append_unit_info(sd_bus_message *reply, Unit *u) {
         _cleanup_free_ char *unit_path = NULL, *job_path = NULL;
         Unit *following;
 
@@ -680,7 +681,7 @@ static int reply_unit_info(sd_bus_message *reply, Unit *u) {
         }
 
         return sd_bus_message_append(
-                        reply, "(ssssssouso)",
+                        reply, "ssssssouso",
                         u->id,
                         unit_description(u),
                         unit_load_state_to_string(u->load_state),
@@ -693,6 +694,38 @@ static int reply_unit_info(sd_bus_message *reply, Unit *u) {
                         empty_to_root(job_path));
 }
 
+static int reply_unit_info(sd_bus_message *reply, Unit *u) {
+        int r;
+
+        r = sd_bus_message_open_container(reply, 'r', "ssssssouso");
+        if (r < 0)
+                return r;
+
+        r = append_unit_info(reply, u);
+        if (r < 0)
+                return r;
+
+        return sd_bus_message_close_container(reply);
+}
+
+static int reply_unit_info_with_properties(sd_bus_message *reply, Unit *u, char **properties, sd_bus_error *error) {
+        int r;
+
+        r = sd_bus_message_open_container(reply, 'r', "ssssssousoa{sv}");
+        if (r < 0)
+                return r;
+
+        r = append_unit_info(reply, u);
+        if (r < 0)
+                return r;
+
+        r = bus_unit_append_properties(u, reply, properties, error);
+        if (r < 0)
+                return r;
+
+        return sd_bus_message_close_container(reply);
+}
+
 static int method_list_units_by_names(sd_bus_message *message, void *userdata, sd_bus_error *error) {
         _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
         Manager *m = userdata;
@@ -981,7 +1014,15 @@ static int method_reset_failed(sd_bus_message *message, void *userdata, sd_bus_e
         return sd_bus_reply_method_return(message, NULL);
 }
 
-static int list_units_filtered(sd_bus_message *message, void *userdata, sd_bus_error *error, char **states, char **patterns) {
+static int list_units_filtered(
+                sd_bus_message *message,
+                void *userdata,
+                sd_bus_error *error,
+                char **states,
+                char **patterns,
+                bool with_properties,
+                char **properties) {
+
         _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
         Manager *m = userdata;
         const char *k;
@@ -1002,7 +1043,7 @@ static int list_units_filtered(sd_bus_message *message, void *userdata, sd_bus_e
         if (r < 0)
                 return r;
 
-        r = sd_bus_message_open_container(reply, 'a', "(ssssssouso)");
+        r = sd_bus_message_open_container(reply, 'a', with_properties ? "(ssssssousoa{sv})" : "(ssssssouso)");
         if (r < 0)
                 return r;
 
@@ -1020,7 +1061,10 @@ static int list_units_filtered(sd_bus_message *message, void *userdata, sd_bus_e
                     !strv_fnmatch_or_empty(patterns, u->id, FNM_NOESCAPE))
                         continue;
 
-                r = reply_unit_info(reply, u);
+                if (with_properties)
+                        r = reply_unit_info_with_properties(reply, u, properties, error);
+                else
+                        r = reply_unit_info(reply, u);
                 if (r < 0)
                         return r;
         }
@@ -1033,7 +1077,7 @@ static int list_units_filtered(sd_bus_message *message, void *userdata, sd_bus_e
 }
 
 static int method_list_units(sd_bus_message *message, void *userdata, sd_bus_error *error) {
-        return list_units_filtered(message, userdata, error, NULL, NULL);
+        return list_units_filtered(message, userdata, error, NULL, NULL, false, NULL);
 }
 
 static int method_list_units_filtered(sd_bus_message *message, void *userdata, sd_bus_error *error) {
@@ -1044,7 +1088,7 @@ static int method_list_units_filtered(sd_bus_message *message, void *userdata, s
         if (r < 0)
                 return r;
 
-        return list_units_filtered(message, userdata, error, states, NULL);
+        return list_units_filtered(message, userdata, error, states, NULL, false, NULL);
 }
 
 static int method_list_units_by_patterns(sd_bus_message *message, void *userdata, sd_bus_error *error) {
@@ -1060,7 +1104,101 @@ static int method_list_units_by_patterns(sd_bus_message *message, void *userdata
         if (r < 0)
                 return r;
 
-        return list_units_filtered(message, userdata, error, states, patterns);
+        return list_units_filtered(message, userdata, error, states, patterns, false, NULL);
+}
+
+static int method_list_units_with_properties(sd_bus_message *message, void *userdata, sd_bus_error *error) {
+        _cleanup_strv_free_ char **states = NULL, **patterns = NULL, **properties = NULL;
+        int r;
+
+        r = sd_bus_message_read_strv(message, &states);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_read_strv(message, &patterns);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_read_strv(message, &properties);
+        if (r < 0)
+                return r;
+
+        return list_units_filtered(message, userdata, error, states, patterns, true, properties);
+}
+
+static int method_list_unit_times(sd_bus_message *message, void *userdata, sd_bus_error *error) {
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
+        Manager *m = userdata;
+        const char *k;
+        Iterator i;
+        Unit *u;
+        int r;
+
+        assert(message);
+        assert(m);
+
+        /* Anyone can call this method */
+
+        r = mac_selinux_access_check(message, "status", error);
+        if (r < 0)
+                return r;
+
+        /* Returns the activation timestamps and ordering dependencies of all units in one go, which is
+         * everything "systemd-analyze blame" and "critical-chain" need, without a property round trip per
+         * unit. */
+
+        r = sd_bus_message_new_method_return(message, &reply);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_open_container(reply, 'a', "(sttttas)");
+        if (r < 0)
+                return r;
+
+        HASHMAP_FOREACH_KEY(u, k, m->units, i) {
+                const UnitDependencyList *l = u->dependencies + UNIT_AFTER;
+                unsigned j;
+
+                if (k != u->id)
+                        continue;
+
+                r = sd_bus_message_open_container(reply, 'r', "sttttas");
+                if (r < 0)
+                        return r;
+
+                r = sd_bus_message_append(reply, "stttt",
+                                          u->id,
+                                          u->inactive_exit_timestamp.monotonic,
+                                          u->active_enter_timestamp.monotonic,
+                                          u->active_exit_timestamp.monotonic,
+                                          u->inactive_enter_timestamp.monotonic);
+                if (r < 0)
+                        return r;
+
+                r = sd_bus_message_open_container(reply, 'a', "s");
+                if (r < 0)
+                        return r;
+
+                for (j = 0; j < l->n_entries; j++) {
+                        r = sd_bus_message_append(reply, "s", l->entries[j].unit->id);
+                        if (r < 0)
+                                return r;
+                }
+
+                r = sd_bus_message_close_container(reply);
+                if (r < 0)
+                        return r;
+
+                r = sd_bus_message_close_container(reply);
+                if (r < 0)
+                        return r;
+        }
+
+        r = sd_bus_message_close_container(reply);
+        if (r < 0)
+                return r;
+
+        return sd_bus_send(NULL, reply, NULL);
 }
 
 static int method_list_jobs(sd_bus_message *message, void *userdata, sd_bus_error *error) {
@@ -1218,6 +1356,174 @@ static int method_dump_by_fd(sd_bus_message *message, void *userdata, sd_bus_err
         return dump_impl(message, userdata, error, reply_dump_by_fd);
 }
 
+static int method_dump_trace(sd_bus_message *message, void *userdata, sd_bus_error *error) {
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
+        Manager *m = userdata;
+        size_t i, n;
+        int r;
+
+        assert(message);
+        assert(m);
+
+        /* Anyone can call this method */
+
+        r = mac_selinux_access_check(message, "status", error);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_new_method_return(message, &reply);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_open_container(reply, 'a', "(sstt)");
+        if (r < 0)
+                return r;
+
+        n = trace_ring_size(&m->trace);
+        for (i = 0; i < n; i++) {
+                const TraceEvent *e = trace_ring_get(&m->trace, i);
+
+                r = sd_bus_message_append(reply, "(sstt)",
+                                          trace_phase_to_string(e->phase),
+                                          strempty(e->subject),
+                                          e->start,
+                                          e->duration);
+                if (r < 0)
+                        return r;
+        }
+
+        r = sd_bus_message_close_container(reply);
+        if (r < 0)
+                return r;
+
+        return sd_bus_send(NULL, reply, NULL);
+}
+
+static int append_statistic(sd_bus_message *reply, const char *prefix, const char *name, uint64_t value) {
+        const char *n;
+
+        n = prefix ? strjoina(prefix, ".", name) : name;
+
+        return sd_bus_message_append(reply, "(st)", n, value);
+}
+
+static int method_get_statistics(sd_bus_message *message, void *userdata, sd_bus_error *error) {
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
+        unsigned by_active_state[_UNIT_ACTIVE_STATE_MAX] = {}, by_load_state[_UNIT_LOAD_STATE_MAX] = {};
+        uint64_t queued_read = 0, queued_write = 0;
+        unsigned n_units = 0, n_dbus_units = 0, n_dbus_jobs = 0;
+        Manager *m = userdata;
+        struct mallinfo mi;
+        UnitActiveState a;
+        UnitLoadState l;
+        const char *k;
+        UnitType t;
+        Iterator i;
+        Unit *u;
+        Job *j;
+        int r;
+
+        assert(message);
+        assert(m);
+
+        /* Anyone can call this method */
+
+        r = mac_selinux_access_check(message, "status", error);
+        if (r < 0)
+                return r;
+
+        /* Returns a flat list of counters, meant for monitoring. The names are stable, new counters may be
+         * added. Times are in µs. */
+
+        HASHMAP_FOREACH_KEY(u, k, m->units, i) {
+                if (k != u->id)
+                        continue;
+
+                n_units++;
+                by_active_state[unit_active_state(u)]++;
+                by_load_state[u->load_state]++;
+        }
+
+        LIST_FOREACH(dbus_queue, u, m->dbus_unit_queue)
+                n_dbus_units++;
+        LIST_FOREACH(dbus_queue, j, m->dbus_job_queue)
+                n_dbus_jobs++;
+
+        if (m->api_bus) {
+                (void) sd_bus_get_n_queued_read(m->api_bus, &queued_read);
+                (void) sd_bus_get_n_queued_write(m->api_bus, &queued_write);
+        }
+
+        mi = mallinfo();
+
+        r = sd_bus_message_new_method_return(message, &reply);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_open_container(reply, 'a', "(st)");
+        if (r < 0)
+                return r;
+
+        r = append_statistic(reply, NULL, "units", n_units);
+        if (r < 0)
+                return r;
+
+        for (t = 0; t < _UNIT_TYPE_MAX; t++) {
+                unsigned n = 0;
+
+                LIST_FOREACH(units_by_type, u, m->units_by_type[t])
+                        n++;
+
+                r = append_statistic(reply, "units.type", unit_type_to_string(t), n);
+                if (r < 0)
+                        return r;
+        }
+
+        for (a = 0; a < _UNIT_ACTIVE_STATE_MAX; a++) {
+                r = append_statistic(reply, "units.active-state", unit_active_state_to_string(a), by_active_state[a]);
+                if (r < 0)
+                        return r;
+        }
+
+        for (l = 0; l < _UNIT_LOAD_STATE_MAX; l++) {
+                r = append_statistic(reply, "units.load-state", unit_load_state_to_string(l), by_load_state[l]);
+                if (r < 0)
+                        return r;
+        }
+
+        r = sd_bus_message_append(reply, "(st)(st)(st)(st)(st)(st)(st)(st)(st)(st)(st)(st)(st)(st)(st)(st)(st)(st)(st)(st)(st)(st)",
+                                  "load-queue.length", (uint64_t) m->n_load_queue,
+                                  "load-queue.max", (uint64_t) m->n_load_queue_max,
+                                  "jobs", (uint64_t) hashmap_size(m->jobs),
+                                  "jobs.running", (uint64_t) m->n_running_jobs,
+                                  "jobs.installed-total", (uint64_t) m->n_installed_jobs,
+                                  "jobs.failed-total", (uint64_t) m->n_failed_jobs,
+                                  "transactions.total", m->n_transactions,
+                                  "transactions.usec-total", m->transaction_usec_total,
+                                  "transactions.usec-max", m->transaction_usec_max,
+                                  "loop.iterations", m->n_loop_iterations,
+                                  "loop.usec-total", m->loop_usec_total,
+                                  "loop.usec-max", m->loop_usec_max,
+                                  "dbus.unit-queue", (uint64_t) n_dbus_units,
+                                  "dbus.job-queue", (uint64_t) n_dbus_jobs,
+                                  "dbus.api-bus.queued-read", queued_read,
+                                  "dbus.api-bus.queued-write", queued_write,
+                                  "dbus.private-connections", (uint64_t) set_size(m->private_buses),
+                                  "hashmap.units", (uint64_t) hashmap_size(m->units),
+                                  "hashmap.watch-pids", (uint64_t) hashmap_size(m->watch_pids),
+                                  "hashmap.cgroup-unit", (uint64_t) hashmap_size(m->cgroup_unit),
+                                  "memory.heap-arena", (uint64_t) (unsigned) mi.arena,
+                                  "memory.heap-in-use", (uint64_t) (unsigned) mi.uordblks);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_close_container(reply);
+        if (r < 0)
+                return r;
+
+        return sd_bus_send(NULL, reply, NULL);
+}
+
 static int method_refuse_snapshot(sd_bus_message *message, void *userdata, sd_bus_error *error) {
         return sd_bus_error_setf(error, SD_BUS_ERROR_NOT_SUPPORTED, "Support for snapshots has been removed.");
 }
@@ -2510,11 +2816,15 @@ const sd_bus_vtable bus_manager_vtable[] = {
         SD_BUS_METHOD("ListUnitsFiltered", "as", "a(ssssssouso)", method_list_units_filtered, SD_BUS_VTABLE_UNPRIVILEGED),
         SD_BUS_METHOD("ListUnitsByPatterns", "asas", "a(ssssssouso)", method_list_units_by_patterns, SD_BUS_VTABLE_UNPRIVILEGED),
         SD_BUS_METHOD("ListUnitsByNames", "as", "a(ssssssouso)", method_list_units_by_names, SD_BUS_VTABLE_UNPRIVILEGED),
+        SD_BUS_METHOD("ListUnitsWithProperties", "asasas", "a(ssssssousoa{sv})", method_list_units_with_properties, SD_BUS_VTABLE_UNPRIVILEGED),
+        SD_BUS_METHOD("ListUnitTimes", NULL, "a(sttttas)", method_list_unit_times, SD_BUS_VTABLE_UNPRIVILEGED),
         SD_BUS_METHOD("ListJobs", NULL, "a(usssoo)", method_list_jobs, SD_BUS_VTABLE_UNPRIVILEGED),
         SD_BUS_METHOD("Subscribe", NULL, NULL, method_subscribe, SD_BUS_VTABLE_UNPRIVILEGED),
         SD_BUS_METHOD("Unsubscribe", NULL, NULL, method_unsubscribe, SD_BUS_VTABLE_UNPRIVILEGED),
         SD_BUS_METHOD("Dump", NULL, "s", method_dump, SD_BUS_VTABLE_UNPRIVILEGED),
         SD_BUS_METHOD("DumpByFileDescriptor", NULL, "h", method_dump_by_fd, SD_BUS_VTABLE_UNPRIVILEGED),
+        SD_BUS_METHOD("DumpTrace", NULL, "a(sstt)", method_dump_trace, SD_BUS_VTABLE_UNPRIVILEGED),
+        SD_BUS_METHOD("GetStatistics", NULL, "a(st)", method_get_statistics, SD_BUS_VTABLE_UNPRIVILEGED),
         SD_BUS_METHOD("CreateSnapshot", "sb", "o", method_refuse_snapshot, SD_BUS_VTABLE_UNPRIVILEGED|SD_BUS_VTABLE_HIDDEN),
         SD_BUS_METHOD("RemoveSnapshot", "s", NULL, method_refuse_snapshot, SD_BUS_VTABLE_UNPRIVILEGED|SD_BUS_VTABLE_HIDDEN),
         SD_BUS_METHOD("Reload", NULL, NULL, method_reload, SD_BUS_VTABLE_UNPRIVILEGED),
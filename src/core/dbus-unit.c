@@ -5,9 +5,13 @@
 #include "alloc-util.h"
 #include "bpf-firewall.h"
 #include "bus-common-errors.h"
+#include "bus-objects.h"
 #include "cgroup-util.h"
 #include "condition.h"
+#include "dbus-cgroup.h"
+#include "dbus-execute.h"
 #include "dbus-job.h"
+#include "dbus-kill.h"
 #include "dbus-unit.h"
 #include "dbus-util.h"
 #include "dbus.h"
@@ -148,22 +152,20 @@ static int property_get_dependencies(
                 void *userdata,
                 sd_bus_error *error) {
 
-        Hashmap **h = userdata;
-        Iterator j;
-        Unit *u;
-        void *v;
+        UnitDependencyList *l = userdata;
+        unsigned j;
         int r;
 
         assert(bus);
         assert(reply);
-        assert(h);
+        assert(l);
 
         r = sd_bus_message_open_container(reply, 'a', "s");
         if (r < 0)
                 return r;
 
-        HASHMAP_FOREACH_KEY(v, u, *h, j) {
-                r = sd_bus_message_append(reply, "s", u->id);
+        for (j = 0; j < l->n_entries; j++) {
+                r = sd_bus_message_append(reply, "s", l->entries[j].unit->id);
                 if (r < 0)
                         return r;
         }
@@ -1828,8 +1830,26 @@ static int bus_unit_set_transient_property(
         /* Handles settings when transient units are created. This settings cannot be altered anymore after the unit
          * has been created. */
 
-        if (streq(name, "SourcePath"))
-                return bus_set_transient_path(u, name, &u->source_path, message, flags, error);
+        if (streq(name, "SourcePath")) {
+                const char *v;
+
+                r = sd_bus_message_read(message, "s", &v);
+                if (r < 0)
+                        return r;
+
+                if (!isempty(v) && !path_is_absolute(v))
+                        return sd_bus_error_setf(error, SD_BUS_ERROR_INVALID_ARGS, "Invalid %s setting: %s", name, v);
+
+                if (!UNIT_WRITE_FLAGS_NOOP(flags)) {
+                        r = unit_set_source_path(u, empty_to_null(v));
+                        if (r < 0)
+                                return r;
+
+                        unit_write_settingf(u, flags|UNIT_ESCAPE_SPECIFIERS, name, "%s=%s", name, strempty(v));
+                }
+
+                return 1;
+        }
 
         if (streq(name, "StopWhenUnneeded"))
                 return bus_set_transient_bool(u, name, &u->stop_when_unneeded, message, flags, error);
@@ -2160,6 +2180,94 @@ int bus_unit_set_properties(
         return n;
 }
 
+static const sd_bus_vtable *vtable_find_property(const sd_bus_vtable *vtable, const char *name) {
+        const sd_bus_vtable *v;
+
+        for (v = bus_vtable_next(vtable, vtable); v->type != _SD_BUS_VTABLE_END; v = bus_vtable_next(vtable, v))
+                if (IN_SET(v->type, _SD_BUS_VTABLE_PROPERTY, _SD_BUS_VTABLE_WRITABLE_PROPERTY) &&
+                    streq(v->x.property.member, name))
+                        return v;
+
+        return NULL;
+}
+
+int bus_unit_append_properties(Unit *u, sd_bus_message *reply, char **properties, sd_bus_error *error) {
+        _cleanup_free_ char *path = NULL;
+        char **p;
+        int r;
+
+        assert(u);
+        assert(reply);
+
+        /* Appends the listed properties of the unit as "a{sv}", picking them from the same vtables the unit
+         * object is exported with. Properties the unit doesn't have are skipped silently, so that callers
+         * may ask for type specific properties when listing units of all types. */
+
+        const char *interface = unit_dbus_interface_from_type(u->type);
+        const struct {
+                const char *interface;
+                const sd_bus_vtable *vtable;
+                void *userdata;
+        } tables[] = {
+                { "org.freedesktop.systemd1.Unit", bus_unit_vtable,            u                                     },
+                { interface,                       UNIT_VTABLE(u)->bus_vtable, u                                     },
+                { interface,                       bus_unit_cgroup_vtable,     UNIT_HAS_CGROUP_CONTEXT(u) ? u : NULL },
+                { interface,                       bus_cgroup_vtable,          unit_get_cgroup_context(u)            },
+                { interface,                       bus_exec_vtable,            unit_get_exec_context(u)              },
+                { interface,                       bus_kill_vtable,            unit_get_kill_context(u)              },
+        };
+
+        path = unit_dbus_path(u);
+        if (!path)
+                return -ENOMEM;
+
+        r = sd_bus_message_open_container(reply, 'a', "{sv}");
+        if (r < 0)
+                return r;
+
+        STRV_FOREACH(p, properties) {
+                const sd_bus_vtable *v = NULL;
+                size_t i;
+
+                for (i = 0; i < ELEMENTSOF(tables); i++) {
+                        if (!tables[i].userdata)
+                                continue;
+
+                        v = vtable_find_property(tables[i].vtable, *p);
+                        if (v)
+                                break;
+                }
+                if (!v)
+                        continue;
+
+                r = sd_bus_message_open_container(reply, 'e', "sv");
+                if (r < 0)
+                        return r;
+
+                r = sd_bus_message_append(reply, "s", *p);
+                if (r < 0)
+                        return r;
+
+                r = sd_bus_message_open_container(reply, 'v', v->x.property.signature);
+                if (r < 0)
+                        return r;
+
+                r = bus_vtable_property_get(sd_bus_message_get_bus(reply), v, path, tables[i].interface, reply, tables[i].userdata, error);
+                if (r < 0)
+                        return r;
+
+                r = sd_bus_message_close_container(reply);
+                if (r < 0)
+                        return r;
+
+                r = sd_bus_message_close_container(reply);
+                if (r < 0)
+                        return r;
+        }
+
+        return sd_bus_message_close_container(reply);
+}
+
 int bus_unit_validate_load_state(Unit *u, sd_bus_error *error) {
         assert(u);
 
@@ -77,7 +77,9 @@
 #include "signal-util.h"
 #include "smack-util.h"
 #include "socket-util.h"
+#include "sort-util.h"
 #include "special.h"
+#include "stdio-util.h"
 #include "stat-util.h"
 #include "string-table.h"
 #include "string-util.h"
@@ -1415,8 +1417,118 @@ static bool skip_seccomp_unavailable(const Unit* u, const char* msg) {
         return true;
 }
 
+static void syscall_filter_actions(const ExecContext *c, uint32_t *ret_default_action, uint32_t *ret_action) {
+        uint32_t negative_action;
+
+        assert(c);
+        assert(ret_default_action);
+        assert(ret_action);
+
+        negative_action = c->syscall_errno == 0 ? scmp_act_kill_process() : SCMP_ACT_ERRNO(c->syscall_errno);
+
+        if (c->syscall_whitelist) {
+                *ret_default_action = negative_action;
+                *ret_action = SCMP_ACT_ALLOW;
+        } else {
+                *ret_default_action = SCMP_ACT_ALLOW;
+                *ret_action = negative_action;
+        }
+}
+
+/* Compiled SystemCallFilter= programs, keyed by a description of the filter, so that instances of the same
+ * template, and units with the same filter, share one. Only the manager adds to this, the children look up
+ * what was there when they were forked off. */
+static Hashmap *syscall_filter_cache = NULL;
+
+#define SYSCALL_FILTER_CACHE_MAX 128U
+
+DEFINE_PRIVATE_HASH_OPS_FULL(syscall_filter_cache_hash_ops, char, string_hash_func, string_compare_func, free,
+                             SeccompCompiledFilter, seccomp_compiled_filter_free);
+
+static int syscall_filter_cache_key(const ExecContext *c, char **ret) {
+        _cleanup_free_ uint64_t *items = NULL;
+        _cleanup_free_ char *key = NULL;
+        uint32_t default_action, action;
+        size_t n = 0, i, l;
+        void *id, *val;
+        Iterator it;
+        char *p;
+
+        assert(c);
+        assert(ret);
+
+        /* The hashmap may enumerate the same entries in any order, hence sort them first */
+        items = new(uint64_t, hashmap_size(c->syscall_filter));
+        if (!items)
+                return -ENOMEM;
+
+        HASHMAP_FOREACH_KEY(val, id, c->syscall_filter, it)
+                items[n++] = (uint64_t) (uint32_t) PTR_TO_INT(id) << 32 | (uint32_t) PTR_TO_INT(val);
+
+        typesafe_qsort(items, n, uint64_compare_func);
+
+        syscall_filter_actions(c, &default_action, &action);
+
+        l = 2 * (DECIMAL_STR_MAX(uint32_t) + 1) + n * (2 * sizeof(uint64_t) + 1) + 1;
+        key = new(char, l);
+        if (!key)
+                return -ENOMEM;
+
+        p = key + sprintf(key, "%" PRIu32 " %" PRIu32, default_action, action);
+        for (i = 0; i < n; i++)
+                p += sprintf(p, " %" PRIx64, items[i]);
+
+        *ret = TAKE_PTR(key);
+        return 0;
+}
+
+static int exec_context_compile_syscall_filter(const Unit *u, const ExecContext *c) {
+        _cleanup_(seccomp_compiled_filter_freep) SeccompCompiledFilter *f = NULL;
+        _cleanup_free_ char *key = NULL;
+        uint32_t default_action, action;
+        int r;
+
+        assert(c);
+
+        /* Called in the manager before forking off a process, so that the child can load the filter as is,
+         * instead of building it from scratch. Failure is not fatal, the child builds it then. */
+
+        if (!context_has_syscall_filters(c) || !is_seccomp_available())
+                return 0;
+
+        r = syscall_filter_cache_key(c, &key);
+        if (r < 0)
+                return r;
+
+        if (hashmap_contains(syscall_filter_cache, key))
+                return 0;
+
+        syscall_filter_actions(c, &default_action, &action);
+
+        r = seccomp_compile_syscall_filter_set_raw(default_action, c->syscall_filter, action, false, &f);
+        if (r < 0)
+                return log_unit_debug_errno(u, r, "Failed to compile system call filter, leaving it to the child: %m");
+
+        /* Filters of units that are gone would otherwise pile up forever */
+        if (hashmap_size(syscall_filter_cache) >= SYSCALL_FILTER_CACHE_MAX)
+                syscall_filter_cache = hashmap_free(syscall_filter_cache);
+
+        r = hashmap_ensure_allocated(&syscall_filter_cache, &syscall_filter_cache_hash_ops);
+        if (r < 0)
+                return r;
+
+        r = hashmap_put(syscall_filter_cache, key, f);
+        if (r < 0)
+                return r;
+
+        TAKE_PTR(key);
+        TAKE_PTR(f);
+
+        return 1;
+}
+
 static int apply_syscall_filter(const Unit* u, const ExecContext *c, bool needs_ambient_hack) {
-        uint32_t negative_action, default_action, action;
+        uint32_t default_action, action;
         int r;
 
         assert(u);
@@ -1428,22 +1540,25 @@ static int apply_syscall_filter(const Unit* u, const ExecContext *c, bool needs_
         if (skip_seccomp_unavailable(u, "SystemCallFilter="))
                 return 0;
 
-        negative_action = c->syscall_errno == 0 ? scmp_act_kill_process() : SCMP_ACT_ERRNO(c->syscall_errno);
-
-        if (c->syscall_whitelist) {
-                default_action = negative_action;
-                action = SCMP_ACT_ALLOW;
-        } else {
-                default_action = SCMP_ACT_ALLOW;
-                action = negative_action;
-        }
-
         if (needs_ambient_hack) {
                 r = seccomp_filter_set_add(c->syscall_filter, c->syscall_whitelist, syscall_filter_sets + SYSCALL_FILTER_SET_SETUID);
                 if (r < 0)
                         return r;
+        } else if (syscall_filter_cache) {
+                _cleanup_free_ char *key = NULL;
+                SeccompCompiledFilter *f;
+
+                r = syscall_filter_cache_key(c, &key);
+                if (r < 0)
+                        return r;
+
+                f = hashmap_get(syscall_filter_cache, key);
+                if (f)
+                        return seccomp_load_compiled_filter(f);
         }
 
+        syscall_filter_actions(c, &default_action, &action);
+
         return seccomp_load_syscall_filter_set_raw(default_action, c->syscall_filter, action, false);
 }
 
@@ -3870,6 +3985,598 @@ static int exec_child(
         return log_unit_error_errno(unit, r, "Failed to execute command: %m");
 }
 
+/* For the common case of a process that needs none of the credential changes, namespacing, MAC and seccomp
+ * setup, terminal handling and logging connections that exec_child() knows about, there's a fast path: all
+ * the preparation that needs memory allocations happens in PID 1, and the child is created with vfork(),
+ * which doesn't copy our page tables. This matters, since PID 1 tends to be big, and fork() gets slower the
+ * bigger we are. The child shares our address space until it called execve() or _exit(), hence it may only
+ * do a couple of system calls: it must not allocate memory, must not log, and must not touch any global
+ * state. Whatever fails is reported back to us through the ExecFastChild structure. */
+
+typedef struct ExecFastChild {
+        const Unit *unit;
+        const ExecCommand *command;
+        const ExecContext *context;
+        const ExecParameters *params;
+
+        char **argv;
+        char **envp;
+
+        /* Buffers inside of envp which the child writes its own PID into */
+        char *listen_pid;
+        char *watchdog_pid;
+
+        int stdio[3];
+        int socket_fd;
+        int cgroup_procs_fd;
+
+        /* A copy of the fds to pass, with room for the exec fd at the end */
+        int *fds;
+        size_t n_socket_fds;
+        size_t n_storage_fds;
+
+        bool apply_rlimits;
+
+        /* Filled in by the child if it fails */
+        int error;
+        int exit_status;
+} ExecFastChild;
+
+static bool exec_fast_spawn_supported(void) {
+        static int cached = -1;
+        _cleanup_cap_free_ cap_t caps = NULL;
+        unsigned long i;
+
+        /* exec_child() drops all inheritable and ambient capabilities and resets the secure bits, which the
+         * fast path doesn't bother with. That's only correct as long as we don't have any of them ourselves,
+         * which doesn't change during our runtime, hence check this only once. */
+
+        if (cached >= 0)
+                return cached;
+
+        cached = false;
+
+        if (prctl(PR_GET_SECUREBITS) != 0)
+                return false;
+
+        caps = cap_get_proc();
+        if (!caps)
+                return false;
+
+        for (i = 0; i <= cap_last_cap(); i++) {
+                cap_flag_value_t v;
+
+                if (cap_get_flag(caps, i, CAP_INHERITABLE, &v) < 0)
+                        return false;
+                if (v == CAP_SET)
+                        return false;
+
+                if (ambient_capabilities_supported() &&
+                    prctl(PR_CAP_AMBIENT, PR_CAP_AMBIENT_IS_SET, i, 0, 0) != 0)
+                        return false;
+        }
+
+        cached = true;
+        return true;
+}
+
+static bool exec_context_may_spawn_fast(
+                Unit *unit,
+                const ExecCommand *command,
+                const ExecContext *c,
+                const ExecParameters *p,
+                const ExecRuntime *runtime) {
+
+        ExecDirectoryType dt;
+
+        assert(unit);
+        assert(command);
+        assert(c);
+        assert(p);
+
+        if (p->idle_pipe || unit_shall_confirm_spawn(unit))
+                return false;
+
+        if (p->stdin_fd >= 0 || p->stdout_fd >= 0 || p->stderr_fd >= 0)
+                return false;
+
+        if (!IN_SET(c->std_input, EXEC_INPUT_NULL, EXEC_INPUT_SOCKET) ||
+            !IN_SET(c->std_output, EXEC_OUTPUT_INHERIT, EXEC_OUTPUT_NULL, EXEC_OUTPUT_SOCKET) ||
+            !IN_SET(c->std_error, EXEC_OUTPUT_INHERIT, EXEC_OUTPUT_NULL, EXEC_OUTPUT_SOCKET))
+                return false;
+
+        if (c->tty_path || c->utmp_id)
+                return false;
+
+        if (c->user || c->group || !strv_isempty(c->supplementary_groups) || c->pam_name || c->dynamic_user)
+                return false;
+
+        if (c->working_directory_home || c->root_directory || c->root_image)
+                return false;
+
+        if (c->oom_score_adjust_set ||
+            c->cpu_sched_set ||
+            c->cpu_set.set ||
+            mpol_is_valid(numa_policy_get_type(&c->numa_policy)) ||
+            c->personality != PERSONALITY_INVALID)
+                return false;
+
+        for (dt = 0; dt < _EXEC_DIRECTORY_TYPE_MAX; dt++)
+                if (!strv_isempty(c->directories[dt].paths))
+                        return false;
+
+        if (c->private_network ||
+            c->network_namespace_path ||
+            c->protect_hostname ||
+            exec_needs_mount_namespace(c, p, runtime))
+                return false;
+
+        if (command->flags & EXEC_COMMAND_AMBIENT_MAGIC)
+                return false;
+
+        if ((p->flags & EXEC_APPLY_SANDBOXING) && !(command->flags & EXEC_COMMAND_FULLY_PRIVILEGED)) {
+
+                if (c->private_users ||
+                    c->restrict_realtime ||
+                    c->secure_bits != 0 ||
+                    !cap_test_all(c->capability_bounding_set) ||
+                    c->capability_ambient_set != 0 ||
+                    c->no_new_privileges)
+                        return false;
+
+                if (context_has_address_families(c) ||
+                    context_has_syscall_filters(c) ||
+                    !set_isempty(c->syscall_archs) ||
+                    c->memory_deny_write_execute ||
+                    c->restrict_suid_sgid ||
+                    exec_context_restrict_namespaces_set(c) ||
+                    c->protect_kernel_tunables ||
+                    c->protect_kernel_modules ||
+                    c->protect_kernel_logs ||
+                    c->private_devices ||
+                    c->lock_personality)
+                        return false;
+
+                if (c->selinux_context || c->apparmor_profile || c->smack_process_label || p->selinux_context_net)
+                        return false;
+
+#if ENABLE_SMACK
+                /* SMACK applies a default process label even if none is configured */
+                if (mac_smack_use())
+                        return false;
+#endif
+        }
+
+        /* On the legacy hierarchies we'd have to join a number of cgroups, keep things simple */
+        if (p->cgroup_path && cg_all_unified() <= 0)
+                return false;
+
+        return exec_fast_spawn_supported();
+}
+
+static int exec_fast_child_reserve_pid(char **env, const char *prefix, char **ret) {
+        char expected[DECIMAL_STR_MAX(pid_t)], **i;
+
+        assert(prefix);
+        assert(ret);
+
+        /* build_environment() fills in our own PID for $LISTEN_PID and $WATCHDOG_PID, since it usually runs in
+         * the child. Replace that by a buffer the child can write its PID into. But leave the variable alone if
+         * it was overridden by the user. */
+
+        xsprintf(expected, PID_FMT, getpid_cached());
+
+        STRV_FOREACH(i, env) {
+                const char *v;
+                char *n;
+
+                v = startswith(*i, prefix);
+                if (!v)
+                        continue;
+
+                if (!streq(v, expected))
+                        break;
+
+                n = new(char, strlen(prefix) + DECIMAL_STR_MAX(pid_t));
+                if (!n)
+                        return -ENOMEM;
+
+                strcpy(n, prefix);
+                free_and_replace(*i, n);
+
+                *ret = *i + strlen(prefix);
+                return 1;
+        }
+
+        *ret = NULL;
+        return 0;
+}
+
+static void format_pid_without_malloc(char *buf, pid_t pid) {
+        char t[DECIMAL_STR_MAX(pid_t)];
+        size_t n = 0;
+
+        assert(pid > 0);
+
+        do {
+                t[n++] = '0' + pid % 10;
+                pid /= 10;
+        } while (pid > 0);
+
+        while (n > 0)
+                *(buf++) = t[--n];
+
+        *buf = 0;
+}
+
+static int exec_fast_child_setup_keyring(const ExecFastChild *c) {
+        const ExecContext *context = c->context;
+        key_serial_t key;
+
+        /* Same as setup_keyring() for a process that doesn't change UID/GID, but doesn't log */
+
+        if (context->keyring_mode == EXEC_KEYRING_INHERIT)
+                return 0;
+
+        if (keyctl(KEYCTL_JOIN_SESSION_KEYRING, 0, 0, 0, 0) == -1)
+                return IN_SET(errno, ENOSYS, EACCES, EPERM, EDQUOT) ? 0 : -errno;
+
+        if (context->keyring_mode == EXEC_KEYRING_SHARED &&
+            keyctl(KEYCTL_LINK, KEY_SPEC_USER_KEYRING, KEY_SPEC_SESSION_KEYRING, 0, 0) < 0)
+                return -errno;
+
+        if (sd_id128_is_null(c->unit->invocation_id))
+                return 0;
+
+        key = add_key("user", "invocation_id", &c->unit->invocation_id, sizeof(c->unit->invocation_id), KEY_SPEC_SESSION_KEYRING);
+        if (key == -1)
+                return 0;
+
+        if (keyctl(KEYCTL_SETPERM, key,
+                   KEY_POS_VIEW|KEY_POS_READ|KEY_POS_SEARCH|
+                   KEY_USR_VIEW|KEY_USR_READ|KEY_USR_SEARCH, 0, 0) < 0)
+                return -errno;
+
+        return 0;
+}
+
+_noreturn_ static void exec_fast_child(ExecFastChild *c) {
+        static const int stdio_exit_status[3] = {
+                [STDIN_FILENO] = EXIT_STDIN,
+                [STDOUT_FILENO] = EXIT_STDOUT,
+                [STDERR_FILENO] = EXIT_STDERR,
+        };
+        const ExecContext *context = c->context;
+        size_t n_fds, n_fds_with_exec_fd;
+        int r, exit_status, exec_fd = -1, i;
+        pid_t pid;
+
+        /* Runs in the vfork()ed child, see above. */
+
+        (void) default_signals(SIGNALS_CRASH_HANDLER,
+                               SIGNALS_IGNORE, -1);
+
+        if (context->ignore_sigpipe)
+                (void) ignore_signals(SIGPIPE, -1);
+
+        r = reset_signal_mask();
+        if (r < 0) {
+                exit_status = EXIT_SIGNAL_MASK;
+                goto fail;
+        }
+
+        pid = raw_getpid();
+        if (c->listen_pid)
+                format_pid_without_malloc(c->listen_pid, pid);
+        if (c->watchdog_pid)
+                format_pid_without_malloc(c->watchdog_pid, pid);
+
+        if (!context->same_pgrp && setsid() < 0) {
+                r = -errno;
+                exit_status = EXIT_SETSID;
+                goto fail;
+        }
+
+        /* Writing "0" to cgroup.procs moves the writing process itself */
+        if (c->cgroup_procs_fd >= 0 && write(c->cgroup_procs_fd, "0", 1) < 0) {
+                r = -errno;
+                exit_status = EXIT_CGROUP;
+                goto fail;
+        }
+
+        if (c->socket_fd >= 0)
+                (void) fd_nonblock(c->socket_fd, false);
+
+        for (i = 0; i < 3; i++)
+                if (dup2(c->stdio[i], i) < 0) {
+                        r = -errno;
+                        exit_status = stdio_exit_status[i];
+                        goto fail;
+                }
+
+        if (context->nice_set && setpriority(PRIO_PROCESS, 0, context->nice) < 0) {
+                r = -errno;
+                exit_status = EXIT_NICE;
+                goto fail;
+        }
+
+        if (context->ioprio_set && ioprio_set(IOPRIO_WHO_PROCESS, 0, context->ioprio) < 0) {
+                r = -errno;
+                exit_status = EXIT_IOPRIO;
+                goto fail;
+        }
+
+        if (context->timer_slack_nsec != NSEC_INFINITY && prctl(PR_SET_TIMERSLACK, context->timer_slack_nsec) < 0) {
+                r = -errno;
+                exit_status = EXIT_TIMERSLACK;
+                goto fail;
+        }
+
+        (void) umask(context->umask);
+
+        r = exec_fast_child_setup_keyring(c);
+        if (r < 0) {
+                exit_status = EXIT_KEYRING;
+                goto fail;
+        }
+
+        if (c->apply_rlimits) {
+                r = setrlimit_closest_all((const struct rlimit* const *) context->rlimit, NULL);
+                if (r < 0) {
+                        exit_status = EXIT_LIMITS;
+                        goto fail;
+                }
+        }
+
+        n_fds = n_fds_with_exec_fd = c->n_socket_fds + c->n_storage_fds;
+
+        if (c->params->exec_fd >= 0) {
+                exec_fd = c->params->exec_fd;
+
+                /* Move the exec fd out of the way of the fds we pass, see exec_child() */
+                if (exec_fd < 3 + (int) n_fds) {
+                        exec_fd = fcntl(exec_fd, F_DUPFD_CLOEXEC, 3 + (int) n_fds);
+                        if (exec_fd < 0) {
+                                r = -errno;
+                                exit_status = EXIT_FDS;
+                                goto fail;
+                        }
+                }
+
+                c->fds[n_fds_with_exec_fd++] = exec_fd;
+        }
+
+        r = close_all_fds_without_malloc(c->fds, n_fds_with_exec_fd);
+        if (r >= 0)
+                r = shift_fds(c->fds, n_fds);
+        if (r >= 0)
+                r = flags_fds(c->fds, c->n_socket_fds, c->n_storage_fds, context->non_blocking);
+        if (r >= 0 && exec_fd >= 0)
+                r = fd_cloexec(exec_fd, true);
+        if (r < 0) {
+                exit_status = EXIT_FDS;
+                goto fail;
+        }
+
+        if (chdir(context->working_directory ?: "/") < 0 && !context->working_directory_missing_ok) {
+                r = -errno;
+                exit_status = EXIT_CHDIR;
+                goto fail;
+        }
+
+        if (exec_fd >= 0) {
+                uint8_t hot = 1;
+
+                if (write(exec_fd, &hot, sizeof(hot)) < 0) {
+                        r = -errno;
+                        exit_status = EXIT_EXEC;
+                        goto fail;
+                }
+        }
+
+        execve(c->command->path, c->argv, c->envp);
+        r = -errno;
+
+        if (exec_fd >= 0) {
+                uint8_t hot = 0;
+
+                if (write(exec_fd, &hot, sizeof(hot)) < 0) {
+                        r = -errno;
+                        exit_status = EXIT_EXEC;
+                        goto fail;
+                }
+        }
+
+        if (r == -ENOENT && (c->command->flags & EXEC_COMMAND_IGNORE_FAILURE))
+                exit_status = EXIT_SUCCESS;
+        else
+                exit_status = EXIT_EXEC;
+
+fail:
+        c->error = r;
+        c->exit_status = exit_status;
+        _exit(exit_status);
+}
+
+static int exec_spawn_fast(
+                Unit *unit,
+                const ExecCommand *command,
+                const ExecContext *context,
+                const ExecParameters *params,
+                int socket_fd,
+                int *fds,
+                size_t n_socket_fds,
+                size_t n_storage_fds,
+                char **files_env,
+                pid_t *ret) {
+
+        _cleanup_strv_free_ char **our_env = NULL, **pass_env = NULL, **accum_env = NULL, **replaced_argv = NULL;
+        _cleanup_close_ int null_fd = -1, cgroup_procs_fd = -1;
+        _cleanup_free_ int *fds_copy = NULL;
+        size_t n_fds = n_socket_fds + n_storage_fds;
+        ExecFastChild child;
+        ExecInput i;
+        ExecOutput o, e;
+        bool inherit;
+        pid_t pid;
+        int r, k;
+
+        assert(unit);
+        assert(command);
+        assert(context);
+        assert(params);
+        assert(ret);
+
+        r = build_environment(unit, context, params, n_fds, NULL, NULL, NULL, 0, 0, &our_env);
+        if (r < 0)
+                return log_oom();
+
+        r = build_pass_environment(context, &pass_env);
+        if (r < 0)
+                return log_oom();
+
+        accum_env = strv_env_merge(5,
+                                   params->environment,
+                                   our_env,
+                                   pass_env,
+                                   context->environment,
+                                   files_env,
+                                   NULL);
+        if (!accum_env)
+                return log_oom();
+        accum_env = strv_env_clean(accum_env);
+
+        if (!strv_isempty(context->unset_environment)) {
+                char **ee;
+
+                ee = strv_env_delete(accum_env, 1, context->unset_environment);
+                if (!ee)
+                        return log_oom();
+
+                strv_free_and_replace(accum_env, ee);
+        }
+
+        if (!FLAGS_SET(command->flags, EXEC_COMMAND_NO_ENV_EXPAND)) {
+                replaced_argv = replace_env_argv(command->argv, accum_env);
+                if (!replaced_argv)
+                        return log_oom();
+        }
+
+        child = (ExecFastChild) {
+                .unit = unit,
+                .command = command,
+                .context = context,
+                .params = params,
+                .argv = replaced_argv ?: command->argv,
+                .envp = accum_env,
+                .stdio = { -1, -1, -1 },
+                .socket_fd = socket_fd,
+                .cgroup_procs_fd = -1,
+                .n_socket_fds = n_socket_fds,
+                .n_storage_fds = n_storage_fds,
+                .apply_rlimits = (params->flags & EXEC_APPLY_SANDBOXING) && !(command->flags & EXEC_COMMAND_FULLY_PRIVILEGED),
+        };
+
+        r = exec_fast_child_reserve_pid(accum_env, "LISTEN_PID=", &child.listen_pid);
+        if (r >= 0)
+                r = exec_fast_child_reserve_pid(accum_env, "WATCHDOG_PID=", &child.watchdog_pid);
+        if (r < 0)
+                return log_oom();
+
+        /* Mirror what setup_input() and setup_output() do for the I/O settings we support. Note that the child's
+         * parent is us, so where they check getppid() we check whether we are PID 1. */
+        i = fixup_input(context, socket_fd, params->flags & EXEC_APPLY_TTY_STDIN);
+        o = fixup_output(context->std_output, socket_fd);
+        e = fixup_output(context->std_error, socket_fd);
+        inherit = getpid_cached() != 1;
+
+        if (i == EXEC_INPUT_SOCKET)
+                child.stdio[STDIN_FILENO] = socket_fd;
+
+        if (o == EXEC_OUTPUT_SOCKET)
+                child.stdio[STDOUT_FILENO] = socket_fd;
+        else if (o == EXEC_OUTPUT_INHERIT) {
+                if (i != EXEC_INPUT_NULL)
+                        child.stdio[STDOUT_FILENO] = STDIN_FILENO;
+                else if (inherit)
+                        child.stdio[STDOUT_FILENO] = STDOUT_FILENO;
+        }
+
+        if (e == EXEC_OUTPUT_INHERIT && o == EXEC_OUTPUT_INHERIT && i == EXEC_INPUT_NULL && inherit)
+                child.stdio[STDERR_FILENO] = STDERR_FILENO;
+        else if (can_inherit_stderr_from_stdout(context, o, e))
+                child.stdio[STDERR_FILENO] = STDOUT_FILENO;
+        else if (e == EXEC_OUTPUT_SOCKET)
+                child.stdio[STDERR_FILENO] = socket_fd;
+
+        for (k = 0; k < 3; k++) {
+                if (child.stdio[k] >= 0)
+                        continue;
+
+                if (null_fd < 0) {
+                        null_fd = open("/dev/null", O_RDWR|O_CLOEXEC|O_NOCTTY);
+                        if (null_fd < 0)
+                                return log_unit_error_errno(unit, errno, "Failed to open /dev/null: %m");
+                }
+
+                child.stdio[k] = null_fd;
+        }
+
+        if (params->cgroup_path) {
+                _cleanup_free_ char *p = NULL, *fn = NULL;
+
+                r = exec_parameters_get_cgroup_path(params, &p);
+                if (r < 0)
+                        return log_unit_error_errno(unit, r, "Failed to acquire cgroup path: %m");
+
+                r = cg_get_path(SYSTEMD_CGROUP_CONTROLLER, p, "cgroup.procs", &fn);
+                if (r < 0)
+                        return log_unit_error_errno(unit, r, "Failed to determine path of cgroup %s: %m", p);
+
+                cgroup_procs_fd = open(fn, O_WRONLY|O_CLOEXEC|O_NOCTTY);
+                if (cgroup_procs_fd < 0)
+                        return log_unit_error_errno(unit, errno, "Failed to open %s: %m", fn);
+
+                child.cgroup_procs_fd = cgroup_procs_fd;
+        }
+
+        fds_copy = new(int, n_fds + 1);
+        if (!fds_copy)
+                return log_oom();
+        memcpy_safe(fds_copy, fds, n_fds * sizeof(int));
+        child.fds = fds_copy;
+
+        pid = vfork();
+        if (pid < 0)
+                return log_unit_error_errno(unit, errno, "Failed to fork: %m");
+        if (pid == 0)
+                exec_fast_child(&child);
+
+        /* The child exited or called execve() by the time we get here. If it failed, it couldn't log, hence do
+         * it on its behalf. */
+
+        if (child.error < 0 && child.exit_status == EXIT_SUCCESS)
+                log_struct_errno(LOG_INFO, child.error,
+                                 "MESSAGE_ID=" SD_MESSAGE_SPAWN_FAILED_STR,
+                                 LOG_UNIT_ID(unit),
+                                 LOG_UNIT_INVOCATION_ID(unit),
+                                 LOG_UNIT_MESSAGE(unit, "Executable %s missing, skipping: %m",
+                                                  command->path),
+                                 "EXECUTABLE=%s", command->path);
+        else if (child.error < 0)
+                log_struct_errno(LOG_ERR, child.error,
+                                 "MESSAGE_ID=" SD_MESSAGE_SPAWN_FAILED_STR,
+                                 LOG_UNIT_ID(unit),
+                                 LOG_UNIT_INVOCATION_ID(unit),
+                                 LOG_UNIT_MESSAGE(unit, "Failed at step %s spawning %s: %m",
+                                                  exit_status_to_string(child.exit_status, EXIT_STATUS_LIBC | EXIT_STATUS_SYSTEMD),
+                                                  command->path),
+                                 "EXECUTABLE=%s", command->path);
+
+        *ret = pid;
+        return 0;
+}
+
 static int exec_context_load_environment(const Unit *unit, const ExecContext *c, char ***l);
 static int exec_context_named_iofds(const ExecContext *c, const ExecParameters *p, int named_iofds[static 3]);
 
@@ -3886,6 +4593,7 @@ int exec_spawn(Unit *unit,
         _cleanup_strv_free_ char **files_env = NULL;
         size_t n_storage_fds = 0, n_socket_fds = 0;
         _cleanup_free_ char *line = NULL;
+        nsec_t ts = trace_now();
         pid_t pid;
 
         assert(unit);
@@ -3946,6 +4654,21 @@ int exec_spawn(Unit *unit,
                 }
         }
 
+        if (exec_context_may_spawn_fast(unit, command, context, params, runtime)) {
+                r = exec_spawn_fast(unit, command, context, params, socket_fd, fds, n_socket_fds, n_storage_fds, files_env, &pid);
+                if (r < 0)
+                        return r;
+
+                log_unit_debug(unit, "Spawned %s as "PID_FMT" via fast path", command->path, pid);
+                goto spawned;
+        }
+
+#if HAVE_SECCOMP
+        if ((params->flags & EXEC_APPLY_SANDBOXING) &&
+            !(command->flags & (EXEC_COMMAND_FULLY_PRIVILEGED|EXEC_COMMAND_AMBIENT_MAGIC)))
+                (void) exec_context_compile_syscall_filter(unit, context);
+#endif
+
         pid = fork();
         if (pid < 0)
                 return log_unit_error_errno(unit, errno, "Failed to fork: %m");
@@ -3987,6 +4710,7 @@ int exec_spawn(Unit *unit,
 
         log_unit_debug(unit, "Forked %s as "PID_FMT, command->path, pid);
 
+spawned:
         /* We add the new process to the cgroup both in the child (so that we can be sure that no user code is ever
          * executed outside of the cgroup) and in the parent (so that we can be sure that when we kill the cgroup the
          * process will be killed too). */
@@ -3995,6 +4719,8 @@ int exec_spawn(Unit *unit,
 
         exec_status_start(&command->exec_status, pid);
 
+        trace_record(&unit->manager->trace, TRACE_SPAWN, unit->id, ts);
+
         *ret = pid;
         return 0;
 }
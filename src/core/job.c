@@ -454,9 +454,7 @@ int job_type_merge_and_collapse(JobType *a, JobType b, Unit *u) {
 }
 
 static bool job_is_runnable(Job *j) {
-        Iterator i;
         Unit *other;
-        void *v;
 
         assert(j);
         assert(j->installed);
@@ -478,11 +476,11 @@ static bool job_is_runnable(Job *j) {
         if (j->type == JOB_NOP)
                 return true;
 
-        HASHMAP_FOREACH_KEY(v, other, j->unit->dependencies[UNIT_AFTER], i)
+        UNIT_FOREACH_DEPENDENCY(other, j->unit, UNIT_AFTER)
                 if (other->job && job_compare(j, other->job, UNIT_AFTER) > 0)
                         return false;
 
-        HASHMAP_FOREACH_KEY(v, other, j->unit->dependencies[UNIT_BEFORE], i)
+        UNIT_FOREACH_DEPENDENCY(other, j->unit, UNIT_BEFORE)
                 if (other->job && job_compare(j, other->job, UNIT_BEFORE) > 0)
                         return false;
 
@@ -940,12 +938,10 @@ static void job_emit_done_status_message(Unit *u, uint32_t job_id, JobType t, Jo
 
 static void job_fail_dependencies(Unit *u, UnitDependency d) {
         Unit *other;
-        Iterator i;
-        void *v;
 
         assert(u);
 
-        HASHMAP_FOREACH_KEY(v, other, u->dependencies[d], i) {
+        UNIT_FOREACH_DEPENDENCY(other, u, d) {
                 Job *j = other->job;
 
                 if (!j)
@@ -961,8 +957,6 @@ int job_finish_and_invalidate(Job *j, JobResult result, bool recursive, bool alr
         Unit *u;
         Unit *other;
         JobType t;
-        Iterator i;
-        void *v;
 
         assert(j);
         assert(j->installed);
@@ -1054,12 +1048,12 @@ int job_finish_and_invalidate(Job *j, JobResult result, bool recursive, bool alr
 
 finish:
         /* Try to start the next jobs that can be started */
-        HASHMAP_FOREACH_KEY(v, other, u->dependencies[UNIT_AFTER], i)
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_AFTER)
                 if (other->job) {
                         job_add_to_run_queue(other->job);
                         job_add_to_gc_queue(other->job);
                 }
-        HASHMAP_FOREACH_KEY(v, other, u->dependencies[UNIT_BEFORE], i)
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_BEFORE)
                 if (other->job) {
                         job_add_to_run_queue(other->job);
                         job_add_to_gc_queue(other->job);
@@ -1220,7 +1214,7 @@ int job_deserialize(Job *j, FILE *f) {
                 char *l, *v;
                 size_t k;
 
-                r = read_line(f, LONG_LINE_MAX, &line);
+                r = deserialize_read_line(f, &line);
                 if (r < 0)
                         return log_error_errno(r, "Failed to read serialization line: %m");
                 if (r == 0)
@@ -1409,8 +1403,6 @@ int job_get_timeout(Job *j, usec_t *timeout) {
 
 bool job_may_gc(Job *j) {
         Unit *other;
-        Iterator i;
-        void *v;
 
         assert(j);
 
@@ -1439,11 +1431,11 @@ bool job_may_gc(Job *j) {
                 return false;
 
         /* The logic is inverse to job_is_runnable, we cannot GC as long as we block any job. */
-        HASHMAP_FOREACH_KEY(v, other, j->unit->dependencies[UNIT_BEFORE], i)
+        UNIT_FOREACH_DEPENDENCY(other, j->unit, UNIT_BEFORE)
                 if (other->job && job_compare(j, other->job, UNIT_BEFORE) < 0)
                         return false;
 
-        HASHMAP_FOREACH_KEY(v, other, j->unit->dependencies[UNIT_AFTER], i)
+        UNIT_FOREACH_DEPENDENCY(other, j->unit, UNIT_AFTER)
                 if (other->job && job_compare(j, other->job, UNIT_AFTER) < 0)
                         return false;
 
@@ -1490,8 +1482,6 @@ int job_get_before(Job *j, Job*** ret) {
         _cleanup_free_ Job** list = NULL;
         size_t n = 0, n_allocated = 0;
         Unit *other = NULL;
-        Iterator i;
-        void *v;
 
         /* Returns a list of all pending jobs that need to finish before this job may be started. */
 
@@ -1503,7 +1493,7 @@ int job_get_before(Job *j, Job*** ret) {
                 return 0;
         }
 
-        HASHMAP_FOREACH_KEY(v, other, j->unit->dependencies[UNIT_AFTER], i) {
+        UNIT_FOREACH_DEPENDENCY(other, j->unit, UNIT_AFTER) {
                 if (!other->job)
                         continue;
                 if (job_compare(j, other->job, UNIT_AFTER) <= 0)
@@ -1514,7 +1504,7 @@ int job_get_before(Job *j, Job*** ret) {
                 list[n++] = other->job;
         }
 
-        HASHMAP_FOREACH_KEY(v, other, j->unit->dependencies[UNIT_BEFORE], i) {
+        UNIT_FOREACH_DEPENDENCY(other, j->unit, UNIT_BEFORE) {
                 if (!other->job)
                         continue;
                 if (job_compare(j, other->job, UNIT_BEFORE) <= 0)
@@ -1536,15 +1526,13 @@ int job_get_after(Job *j, Job*** ret) {
         _cleanup_free_ Job** list = NULL;
         size_t n = 0, n_allocated = 0;
         Unit *other = NULL;
-        void *v;
-        Iterator i;
 
         assert(j);
         assert(ret);
 
         /* Returns a list of all pending jobs that are waiting for this job to finish. */
 
-        HASHMAP_FOREACH_KEY(v, other, j->unit->dependencies[UNIT_BEFORE], i) {
+        UNIT_FOREACH_DEPENDENCY(other, j->unit, UNIT_BEFORE) {
                 if (!other->job)
                         continue;
 
@@ -1559,7 +1547,7 @@ int job_get_after(Job *j, Job*** ret) {
                 list[n++] = other->job;
         }
 
-        HASHMAP_FOREACH_KEY(v, other, j->unit->dependencies[UNIT_AFTER], i) {
+        UNIT_FOREACH_DEPENDENCY(other, j->unit, UNIT_AFTER) {
                 if (!other->job)
                         continue;
 
@@ -11,6 +11,30 @@
 #include "unit-name.h"
 #include "unit.h"
 
+static ConfFilesCache* manager_dropin_cache(Manager *m) {
+        assert(m);
+
+        /* Many units share drop-in directories (e.g. "service.d/" or "foo-.service.d/"), hence keep their
+         * listings around until the unit path cache is flushed. If we can't allocate the cache, we just go
+         * without. */
+        if (!m->dropin_cache)
+                m->dropin_cache = conf_files_cache_new();
+
+        return m->dropin_cache;
+}
+
+int unit_find_dropin_paths(Unit *u, char ***paths) {
+        assert(u);
+
+        return unit_file_find_dropin_paths(NULL,
+                                           u->manager->lookup_paths.search_path,
+                                           u->manager->unit_path_cache,
+                                           manager_dropin_cache(u->manager),
+                                           ".d", ".conf",
+                                           u->names,
+                                           paths);
+}
+
 static int unit_name_compatible(const char *a, const char *b) {
         _cleanup_free_ char *template = NULL;
         int r;
@@ -37,6 +61,7 @@ static int process_deps(Unit *u, UnitDependency dependency, const char *dir_suff
         r = unit_file_find_dropin_paths(NULL,
                                         u->manager->lookup_paths.search_path,
                                         u->manager->unit_path_cache,
+                                        manager_dropin_cache(u->manager),
                                         dir_suffix,
                                         NULL,
                                         u->names,
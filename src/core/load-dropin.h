@@ -6,15 +6,6 @@
 
 /* Read service data supplementary drop-in directories */
 
-static inline int unit_find_dropin_paths(Unit *u, char ***paths) {
-        assert(u);
-
-        return unit_file_find_dropin_paths(NULL,
-                                           u->manager->lookup_paths.search_path,
-                                           u->manager->unit_path_cache,
-                                           ".d", ".conf",
-                                           u->names,
-                                           paths);
-}
+int unit_find_dropin_paths(Unit *u, char ***paths);
 
 int unit_load_dropin(Unit *u);
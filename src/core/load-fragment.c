@@ -37,6 +37,7 @@
 #include "journal-util.h"
 #include "limits-util.h"
 #include "load-fragment.h"
+#include "load-prefetch.h"
 #include "log.h"
 #include "mountpoint-util.h"
 #include "nulstr-util.h"
@@ -300,6 +301,42 @@ int config_parse_unit_path_printf(
         return config_parse_path(unit, filename, line, section, section_line, lvalue, ltype, k, data, userdata);
 }
 
+int config_parse_unit_source_path(
+                const char *unit,
+                const char *filename,
+                unsigned line,
+                const char *section,
+                unsigned section_line,
+                const char *lvalue,
+                int ltype,
+                const char *rvalue,
+                void *data,
+                void *userdata) {
+
+        _cleanup_free_ char *p = NULL;
+        Unit *u = userdata;
+        int r;
+
+        assert(u);
+
+        /* Parse into a private copy, since the source path is interned */
+        if (u->source_path) {
+                p = strdup(u->source_path);
+                if (!p)
+                        return log_oom();
+        }
+
+        r = config_parse_unit_path_printf(unit, filename, line, section, section_line, lvalue, ltype, rvalue, &p, userdata);
+        if (r < 0)
+                return r;
+
+        r = unit_set_source_path(u, p);
+        if (r < 0)
+                return log_oom();
+
+        return 0;
+}
+
 int config_parse_unit_path_strv_printf(
                 const char *unit,
                 const char *filename,
@@ -1623,7 +1660,7 @@ int config_parse_trigger_unit(
         assert(rvalue);
         assert(data);
 
-        if (!hashmap_isempty(u->dependencies[UNIT_TRIGGERS])) {
+        if (unit_dependency_count(u, UNIT_TRIGGERS) > 0) {
                 log_syntax(unit, LOG_ERR, filename, line, 0, "Multiple units to trigger specified, ignoring: %s", rvalue);
                 return 0;
         }
@@ -4690,14 +4727,11 @@ int unit_load_fragment(Unit *u) {
                 /* Try to open the file name. A symlink is OK, for example for linked files or masks. We
                  * expect that all symlinks within the lookup paths have been already resolved, but we don't
                  * verify this here. */
-                f = fopen(fragment, "re");
-                if (!f)
-                        return log_unit_notice_errno(u, errno, "Failed to open %s: %m", fragment);
-
-                if (fstat(fileno(f), &st) < 0)
-                        return -errno;
+                r = manager_open_prefetched_file(u->manager, fragment, &f, &st);
+                if (r < 0)
+                        return log_unit_notice_errno(u, r, "Failed to open %s: %m", fragment);
 
-                r = free_and_strdup(&u->fragment_path, fragment);
+                r = unit_set_fragment_path(u, fragment);
                 if (r < 0)
                         return r;
 
@@ -4773,6 +4807,7 @@ void unit_dump_config_items(FILE *f) {
                 { config_parse_string,                "STRING" },
                 { config_parse_path,                  "PATH" },
                 { config_parse_unit_path_printf,      "PATH" },
+                { config_parse_unit_source_path,      "PATH" },
                 { config_parse_strv,                  "STRING [...]" },
                 { config_parse_exec_nice,             "NICE" },
                 { config_parse_exec_oom_score_adjust, "OOMSCOREADJUST" },
@@ -0,0 +1,236 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include "alloc-util.h"
+#include "fd-util.h"
+#include "fileio.h"
+#include "fs-util.h"
+#include "hashmap.h"
+#include "load-prefetch.h"
+#include "log.h"
+#include "path-util.h"
+#include "set.h"
+#include "stat-util.h"
+#include "unit-file.h"
+#include "unit.h"
+
+/* Spawning threads isn't free either, hence only bother if there's enough to read */
+#define PREFETCH_FILES_MIN 32U
+#define PREFETCH_THREADS_MAX 8U
+
+typedef struct PrefetchContext {
+        PrefetchedFile **files;
+        size_t n_files;
+        size_t next;
+} PrefetchContext;
+
+static PrefetchedFile* prefetched_file_free(PrefetchedFile *p) {
+        if (!p)
+                return NULL;
+
+        free(p->path);
+        free(p->contents);
+        return mfree(p);
+}
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(PrefetchedFile*, prefetched_file_free);
+
+DEFINE_PRIVATE_HASH_OPS_WITH_VALUE_DESTRUCTOR(prefetched_file_hash_ops, char, path_hash_func, path_compare,
+                                              PrefetchedFile, prefetched_file_free);
+
+static void prefetched_file_read(PrefetchedFile *p) {
+        _cleanup_fclose_ FILE *f = NULL;
+        int r;
+
+        assert(p);
+
+        /* This runs in a worker thread, hence must only touch the object passed in, and not log either. */
+
+        f = fopen(p->path, "re");
+        if (!f) {
+                p->error = -errno;
+                return;
+        }
+
+        if (fstat(fileno(f), &p->st) < 0) {
+                p->error = -errno;
+                return;
+        }
+
+        /* A mask, nothing to read */
+        if (null_or_empty(&p->st))
+                return;
+
+        r = read_full_stream(f, &p->contents, &p->size);
+        if (r < 0)
+                p->error = r;
+}
+
+static void *prefetch_thread(void *userdata) {
+        PrefetchContext *c = userdata;
+
+        for (;;) {
+                size_t i;
+
+                i = __sync_fetch_and_add(&c->next, 1);
+                if (i >= c->n_files)
+                        break;
+
+                prefetched_file_read(c->files[i]);
+        }
+
+        return NULL;
+}
+
+static void prefetch_files(PrefetchContext *c) {
+        pthread_t threads[PREFETCH_THREADS_MAX];
+        sigset_t ss, saved_ss;
+        size_t n_threads, i;
+        long k;
+
+        assert(c);
+
+        /* One of the workers is the calling thread */
+        k = sysconf(_SC_NPROCESSORS_ONLN);
+        n_threads = MIN((size_t) MAX(k, 1L), (size_t) PREFETCH_THREADS_MAX) - 1;
+
+        /* Start the threads with all signals blocked, so that they don't affect signal handling of the main
+         * thread. If we can't create some of them, we'll do with fewer. */
+        assert_se(sigfillset(&ss) >= 0);
+        if (n_threads > 0 && pthread_sigmask(SIG_BLOCK, &ss, &saved_ss) == 0) {
+                for (i = 0; i < n_threads; i++)
+                        if (pthread_create(threads + i, NULL, prefetch_thread, c) != 0)
+                                break;
+                n_threads = i;
+
+                assert_se(pthread_sigmask(SIG_SETMASK, &saved_ss, NULL) == 0);
+        } else
+                n_threads = 0;
+
+        (void) prefetch_thread(c);
+
+        for (i = 0; i < n_threads; i++)
+                assert_se(pthread_join(threads[i], NULL) == 0);
+}
+
+void manager_prefetch_load_queue(Manager *m) {
+        _cleanup_set_free_ Set *seen = NULL;
+        PrefetchContext c = {};
+        size_t allocated = 0, i;
+        Unit *u;
+        int r;
+
+        assert(m);
+
+        (void) unit_file_build_name_map(&m->lookup_paths, &m->unit_cache_mtime,
+                                        &m->unit_id_map, &m->unit_name_map, &m->unit_path_cache);
+
+        seen = set_new(&path_hash_ops);
+        if (!seen)
+                goto finish;
+
+        LIST_FOREACH(load_queue, u, m->load_queue) {
+                _cleanup_set_free_free_ Set *names = NULL;
+                _cleanup_(prefetched_file_freep) PrefetchedFile *p = NULL;
+                const char *fragment;
+
+                if (u->load_prefetched)
+                        continue;
+                u->load_prefetched = true;
+
+                if (u->load_state != UNIT_STUB || u->transient)
+                        continue;
+
+                r = unit_file_find_fragment(m->unit_id_map, m->unit_name_map, u->id, &fragment, &names);
+                if (r < 0 || !fragment)
+                        continue;
+
+                if (hashmap_contains(m->prefetched_files, fragment) || set_contains(seen, fragment))
+                        continue;
+
+                if (!GREEDY_REALLOC(c.files, allocated, c.n_files + 1))
+                        goto finish;
+
+                p = new0(PrefetchedFile, 1);
+                if (!p)
+                        goto finish;
+
+                p->path = strdup(fragment);
+                if (!p->path)
+                        goto finish;
+
+                if (set_put(seen, p->path) < 0)
+                        goto finish;
+
+                c.files[c.n_files++] = TAKE_PTR(p);
+        }
+
+        if (c.n_files < PREFETCH_FILES_MIN)
+                goto finish;
+
+        log_debug("Reading %zu unit files ahead.", c.n_files);
+
+        prefetch_files(&c);
+
+        if (hashmap_ensure_allocated(&m->prefetched_files, &prefetched_file_hash_ops) < 0)
+                goto finish;
+
+        for (i = 0; i < c.n_files; i++) {
+                if (hashmap_put(m->prefetched_files, c.files[i]->path, c.files[i]) < 0)
+                        continue;
+
+                c.files[i] = NULL;
+        }
+
+finish:
+        /* Prefetching is an optimization only, if anything fails the files are simply read when needed */
+        for (i = 0; i < c.n_files; i++)
+                prefetched_file_free(c.files[i]);
+        free(c.files);
+}
+
+void manager_flush_prefetched_files(Manager *m) {
+        assert(m);
+
+        m->prefetched_files = hashmap_free(m->prefetched_files);
+}
+
+int manager_open_prefetched_file(Manager *m, const char *path, FILE **ret, struct stat *ret_st) {
+        _cleanup_fclose_ FILE *f = NULL;
+        PrefetchedFile *p;
+
+        assert(m);
+        assert(path);
+        assert(ret);
+        assert(ret_st);
+
+        /* Like fopen() followed by fstat(), but uses the prefetched file contents if we have them. Errors during
+         * prefetching as well as masks are left to the regular path, so that they are handled exactly as
+         * before. */
+
+        p = hashmap_get(m->prefetched_files, path);
+        if (p && p->error >= 0 && p->size > 0 && !null_or_empty(&p->st)) {
+                f = fmemopen(p->contents, p->size, "r");
+                if (f) {
+                        /* config_parse() can't check the permissions of a memory stream, do it here */
+                        (void) stat_warn_permissions(path, &p->st);
+
+                        *ret_st = p->st;
+                        *ret = TAKE_PTR(f);
+                        return 0;
+                }
+        }
+
+        f = fopen(path, "re");
+        if (!f)
+                return -errno;
+
+        if (fstat(fileno(f), ret_st) < 0)
+                return -errno;
+
+        *ret = TAKE_PTR(f);
+        return 0;
+}
@@ -0,0 +1,23 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+#pragma once
+
+#include <stdio.h>
+#include <sys/stat.h>
+
+#include "manager.h"
+
+/* Reads the unit files of the units in the load queue in parallel, so that loading them one by one on the main
+ * thread subsequently doesn't have to wait for the disk for each of them. */
+
+typedef struct PrefetchedFile {
+        char *path;
+        int error;
+        struct stat st;
+        char *contents;
+        size_t size;
+} PrefetchedFile;
+
+void manager_prefetch_load_queue(Manager *m);
+void manager_flush_prefetched_files(Manager *m);
+
+int manager_open_prefetched_file(Manager *m, const char *path, FILE **ret, struct stat *ret_st);
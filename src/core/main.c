@@ -106,6 +106,7 @@ static bool arg_crash_reboot;
 static char *arg_confirm_spawn;
 static ShowStatus arg_show_status;
 static StatusUnitFormat arg_status_unit_format;
+static usec_t arg_dbus_signal_coalesce_usec;
 static bool arg_switched_root;
 static PagerFlags arg_pager_flags;
 static bool arg_service_watchdogs;
@@ -581,6 +582,7 @@ static int parse_config_file(void) {
                 { "Manager", "CrashReboot",                  config_parse_bool,                  0, &arg_crash_reboot                      },
                 { "Manager", "ShowStatus",                   config_parse_show_status,           0, &arg_show_status                       },
                 { "Manager", "StatusUnitFormat",             config_parse_status_unit_format,    0, &arg_status_unit_format                },
+                { "Manager", "DBusSignalCoalesceSec",        config_parse_sec,                   0, &arg_dbus_signal_coalesce_usec         },
                 { "Manager", "CPUAffinity",                  config_parse_cpu_affinity2,         0, &arg_cpu_affinity                      },
                 { "Manager", "NUMAPolicy",                   config_parse_numa_policy,           0, &arg_numa_policy.type                  },
                 { "Manager", "NUMAMask",                     config_parse_numa_mask,             0, &arg_numa_policy                       },
@@ -713,6 +715,7 @@ static void set_manager_settings(Manager *m) {
 
         manager_set_show_status(m, arg_show_status);
         m->status_unit_format = arg_status_unit_format;
+        m->dbus_signal_coalesce_usec = arg_dbus_signal_coalesce_usec;
 }
 
 static int parse_argv(int argc, char *argv[]) {
@@ -2143,6 +2146,7 @@ static void reset_arguments(void) {
         arg_confirm_spawn = mfree(arg_confirm_spawn);
         arg_show_status = _SHOW_STATUS_INVALID;
         arg_status_unit_format = STATUS_UNIT_FORMAT_DEFAULT;
+        arg_dbus_signal_coalesce_usec = 0;
         arg_switched_root = false;
         arg_pager_flags = 0;
         arg_service_watchdogs = true;
@@ -3,6 +3,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <linux/kd.h>
+#include <poll.h>
 #include <sys/epoll.h>
 #include <sys/inotify.h>
 #include <sys/ioctl.h>
@@ -23,6 +24,7 @@
 #include "alloc-util.h"
 #include "audit-fd.h"
 #include "boot-timestamps.h"
+#include "bpf-firewall.h"
 #include "bus-common-errors.h"
 #include "bus-error.h"
 #include "bus-kernel.h"
@@ -37,6 +39,7 @@
 #include "dirent-util.h"
 #include "env-util.h"
 #include "escape.h"
+#include "event-util.h"
 #include "exec-util.h"
 #include "execute.h"
 #include "exit-status.h"
@@ -47,6 +50,7 @@
 #include "io-util.h"
 #include "install.h"
 #include "label.h"
+#include "load-prefetch.h"
 #include "locale-setup.h"
 #include "log.h"
 #include "macro.h"
@@ -61,6 +65,7 @@
 #include "rlimit-util.h"
 #include "rm-rf.h"
 #include "serialize.h"
+#include "siphash24.h"
 #include "signal-util.h"
 #include "socket-util.h"
 #include "special.h"
@@ -95,6 +100,18 @@
 /* How many units and jobs to process of the bus queue before returning to the event loop. */
 #define MANAGER_BUS_MESSAGE_BUDGET 100U
 
+/* How many exited children to reap before returning to the event loop. */
+#define MANAGER_SIGCHLD_BUDGET 64U
+
+/* How many notification messages to process before returning to the event loop. */
+#define MANAGER_NOTIFY_BUDGET 64U
+
+/* How many jobs to run, and for how long at most, before returning to the event loop. Starting a job usually means
+ * forking off a process, hence keep this low enough that SIGCHLD, notification and bus processing get a chance to run
+ * in between even during a mass start at boot. */
+#define MANAGER_RUN_QUEUE_BUDGET 64U
+#define MANAGER_RUN_QUEUE_BUDGET_USEC (10*USEC_PER_MSEC)
+
 static int manager_dispatch_notify_fd(sd_event_source *source, int fd, uint32_t revents, void *userdata);
 static int manager_dispatch_cgroups_agent_fd(sd_event_source *source, int fd, uint32_t revents, void *userdata);
 static int manager_dispatch_signal_fd(sd_event_source *source, int fd, uint32_t revents, void *userdata);
@@ -107,6 +124,7 @@ static int manager_dispatch_sigchld(sd_event_source *source, void *userdata);
 static int manager_dispatch_timezone_change(sd_event_source *source, const struct inotify_event *event, void *userdata);
 static int manager_run_environment_generators(Manager *m);
 static int manager_run_generators(Manager *m);
+static int manager_hash_generator_output(Manager *m, uint64_t *ret);
 
 static void manager_watch_jobs_in_progress(Manager *m) {
         usec_t next;
@@ -348,6 +366,24 @@ static void manager_close_idle_pipe(Manager *m) {
         safe_close_pair(m->idle_pipe + 2);
 }
 
+static int manager_setup_memory_pressure_event_source(Manager *m) {
+        int r;
+
+        assert(m);
+
+        /* We keep no caches that could be dropped, but unused hashmap pools and malloc() arenas can still
+         * be given back to the kernel, hence use the default handler */
+
+        r = sd_event_add_memory_pressure(m->event, &m->memory_pressure_event_source, NULL, NULL);
+        if (r < 0)
+                return log_full_errno(IN_SET(r, -EOPNOTSUPP, -EPERM, -EACCES) ? LOG_DEBUG : LOG_NOTICE, r,
+                                      "Failed to watch memory pressure, ignoring: %m");
+
+        (void) sd_event_source_set_description(m->memory_pressure_event_source, "manager-memory-pressure");
+
+        return 0;
+}
+
 static int manager_setup_time_change(Manager *m) {
         int r;
 
@@ -693,6 +729,7 @@ static void manager_free_unit_name_maps(Manager *m) {
         m->unit_id_map = hashmap_free(m->unit_id_map);
         m->unit_name_map = hashmap_free(m->unit_name_map);
         m->unit_path_cache = set_free_free(m->unit_path_cache);
+        m->dropin_cache = conf_files_cache_free(m->dropin_cache);
         m->unit_cache_mtime =  0;
 }
 
@@ -821,7 +858,7 @@ int manager_new(UnitFileScope scope, ManagerTestRunFlags test_run_flags, Manager
         if (r < 0)
                 return r;
 
-        r = hashmap_ensure_allocated(&m->units, &string_hash_ops);
+        r = hashmap_ensure_allocated(&m->units, &string_fast_hash_ops);
         if (r < 0)
                 return r;
 
@@ -876,6 +913,8 @@ int manager_new(UnitFileScope scope, ManagerTestRunFlags test_run_flags, Manager
 
                 (void) manager_setup_timezone_change(m);
 
+                (void) manager_setup_memory_pressure_event_source(m);
+
                 r = manager_setup_sigchld_event_source(m);
                 if (r < 0)
                         return r;
@@ -1123,13 +1162,11 @@ enum {
 
 static void unit_gc_mark_good(Unit *u, unsigned gc_marker) {
         Unit *other;
-        Iterator i;
-        void *v;
 
         u->gc_marker = gc_marker + GC_OFFSET_GOOD;
 
         /* Recursively mark referenced units as GOOD as well */
-        HASHMAP_FOREACH_KEY(v, other, u->dependencies[UNIT_REFERENCES], i)
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_REFERENCES)
                 if (other->gc_marker == gc_marker + GC_OFFSET_UNSURE)
                         unit_gc_mark_good(other, gc_marker);
 }
@@ -1137,8 +1174,6 @@ static void unit_gc_mark_good(Unit *u, unsigned gc_marker) {
 static void unit_gc_sweep(Unit *u, unsigned gc_marker) {
         Unit *other;
         bool is_bad;
-        Iterator i;
-        void *v;
 
         assert(u);
 
@@ -1156,7 +1191,7 @@ static void unit_gc_sweep(Unit *u, unsigned gc_marker) {
 
         is_bad = true;
 
-        HASHMAP_FOREACH_KEY(v, other, u->dependencies[UNIT_REFERENCED_BY], i) {
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_REFERENCED_BY) {
                 unit_gc_sweep(other, gc_marker);
 
                 if (other->gc_marker == gc_marker + GC_OFFSET_GOOD)
@@ -1350,6 +1385,13 @@ Manager* manager_free(Manager *m) {
         exec_runtime_vacuum(m);
         hashmap_free(m->exec_runtime_by_id);
 
+        /* All units are gone, and with them all references to the maps */
+        assert(hashmap_isempty(m->bpf_firewall_maps));
+        hashmap_free(m->bpf_firewall_maps);
+
+        assert(hashmap_isempty(m->interned_strings));
+        hashmap_free(m->interned_strings);
+
         dynamic_user_vacuum(m, false);
         hashmap_free(m->dynamic_users);
 
@@ -1371,9 +1413,11 @@ Manager* manager_free(Manager *m) {
         sd_event_source_unref(m->time_change_event_source);
         sd_event_source_unref(m->timezone_change_event_source);
         sd_event_source_unref(m->jobs_in_progress_event_source);
+        sd_event_source_unref(m->dbus_coalesce_event_source);
         sd_event_source_unref(m->run_queue_event_source);
         sd_event_source_unref(m->user_lookup_event_source);
         sd_event_source_unref(m->sync_bus_names_event_source);
+        sd_event_source_unref(m->memory_pressure_event_source);
 
         safe_close(m->signal_fd);
         safe_close(m->notify_fd);
@@ -1395,6 +1439,7 @@ Manager* manager_free(Manager *m) {
 
         hashmap_free(m->cgroup_unit);
         manager_free_unit_name_maps(m);
+        manager_flush_prefetched_files(m);
 
         free(m->switch_root);
         free(m->switch_root_init);
@@ -1410,6 +1455,8 @@ Manager* manager_free(Manager *m) {
         for (dt = 0; dt < _EXEC_DIRECTORY_TYPE_MAX; dt++)
                 m->prefix[dt] = mfree(m->prefix[dt]);
 
+        trace_ring_done(&m->trace);
+
         return mfree(m);
 }
 
@@ -1434,6 +1481,7 @@ static void manager_enumerate_perpetual(Manager *m) {
 }
 
 static void manager_enumerate(Manager *m) {
+        nsec_t ts = trace_now();
         UnitType c;
 
         assert(m);
@@ -1453,9 +1501,12 @@ static void manager_enumerate(Manager *m) {
         }
 
         manager_dispatch_load_queue(m);
+
+        trace_record(&m->trace, TRACE_ENUMERATE, NULL, ts);
 }
 
 static void manager_coldplug(Manager *m) {
+        nsec_t ts = trace_now();
         Iterator i;
         Unit *u;
         char *k;
@@ -1476,6 +1527,8 @@ static void manager_coldplug(Manager *m) {
                 if (r < 0)
                         log_warning_errno(r, "We couldn't coldplug %s, proceeding anyway: %m", u->id);
         }
+
+        trace_record(&m->trace, TRACE_COLDPLUG, NULL, ts);
 }
 
 static void manager_catchup(Manager *m) {
@@ -1651,6 +1704,10 @@ int manager_startup(Manager *m, FILE *serialization, FDSet *fds) {
         if (r < 0)
                 return r;
 
+        /* Remember what the units are going to be loaded from, so that a reload can tell if anything changed */
+        m->unit_config_timestamp = m->timestamps[manager_timestamp_initrd_mangle(MANAGER_TIMESTAMP_GENERATORS_START)].realtime;
+        (void) manager_hash_generator_output(m, &m->generator_output_hash);
+
         manager_preset_all(m);
 
         lookup_paths_log(&m->lookup_paths);
@@ -1672,9 +1729,13 @@ int manager_startup(Manager *m, FILE *serialization, FDSet *fds) {
 
                 /* Second, deserialize if there is something to deserialize */
                 if (serialization) {
+                        nsec_t ts = trace_now();
+
                         r = manager_deserialize(m, serialization, fds);
                         if (r < 0)
                                 return log_error_errno(r, "Deserialization failed: %m");
+
+                        trace_record(&m->trace, TRACE_DESERIALIZE, NULL, ts);
                 }
 
                 /* Any fds left? Find some unit which wants them. This is useful to allow container managers to pass
@@ -1724,6 +1785,20 @@ int manager_startup(Manager *m, FILE *serialization, FDSet *fds) {
         return 0;
 }
 
+static void manager_account_transaction(Manager *m, Unit *unit, nsec_t ts) {
+        usec_t t;
+
+        assert(m);
+        assert(unit);
+
+        trace_record(&m->trace, TRACE_TRANSACTION, unit->id, ts);
+
+        t = LESS_BY(trace_now(), ts) / NSEC_PER_USEC;
+        m->n_transactions++;
+        m->transaction_usec_total += t;
+        m->transaction_usec_max = MAX(m->transaction_usec_max, t);
+}
+
 int manager_add_job(
                 Manager *m,
                 JobType type,
@@ -1733,6 +1808,7 @@ int manager_add_job(
                 sd_bus_error *error,
                 Job **ret) {
 
+        nsec_t ts = trace_now();
         Transaction *tr;
         int r;
 
@@ -1788,11 +1864,13 @@ int manager_add_job(
                 *ret = tr->anchor_job;
 
         transaction_free(tr);
+        manager_account_transaction(m, unit, ts);
         return 0;
 
 tr_abort:
         transaction_abort(tr);
         transaction_free(tr);
+        manager_account_transaction(m, unit, ts);
         return r;
 }
 
@@ -1898,10 +1976,8 @@ static int manager_dispatch_target_deps_queue(Manager *m) {
 
                 for (k = 0; k < ELEMENTSOF(deps); k++) {
                         Unit *target;
-                        Iterator i;
-                        void *v;
 
-                        HASHMAP_FOREACH_KEY(v, target, u->dependencies[deps[k]], i) {
+                        UNIT_FOREACH_DEPENDENCY(target, u, deps[k]) {
                                 r = unit_add_default_target_dependency(u, target);
                                 if (r < 0)
                                         return r;
@@ -1928,12 +2004,25 @@ unsigned manager_dispatch_load_queue(Manager *m) {
          * tries to load its data until the queue is empty */
 
         while ((u = m->load_queue)) {
+                nsec_t ts;
+
                 assert(u->in_load_queue);
 
+                /* Loading units enqueues their dependencies. Whenever we get to those, read all their unit
+                 * files in parallel first. */
+                if (!u->load_prefetched)
+                        manager_prefetch_load_queue(m);
+
+                u->load_prefetched = false;
+
+                ts = trace_now();
                 unit_load(u);
+                trace_record(&m->trace, TRACE_UNIT_LOAD, u->id, ts);
                 n++;
         }
 
+        manager_flush_prefetched_files(m);
+
         m->dispatching_load_queue = false;
 
         /* Dispatch the units waiting for their target dependencies to be added now, as all targets that we know about
@@ -1968,6 +2057,15 @@ int manager_load_unit_prepare(
         if (!name)
                 name = basename(path);
 
+        /* Most lookups are for units we already know, e.g. for each dependency on one of the common targets
+         * while loading. Only names that passed the checks below end up in the table, hence look there
+         * first. */
+        ret = manager_get_unit(m, name);
+        if (ret) {
+                *_ret = ret;
+                return 1;
+        }
+
         t = unit_name_to_type(name);
 
         if (t == _UNIT_TYPE_INVALID || !unit_name_is_valid(name, UNIT_NAME_PLAIN|UNIT_NAME_INSTANCE)) {
@@ -1977,20 +2075,14 @@ int manager_load_unit_prepare(
                 return sd_bus_error_setf(e, SD_BUS_ERROR_INVALID_ARGS, "Unit name %s is not valid.", name);
         }
 
-        ret = manager_get_unit(m, name);
-        if (ret) {
-                *_ret = ret;
-                return 1;
-        }
-
         ret = cleanup_ret = unit_new(m, unit_vtable[t]->object_size);
         if (!ret)
                 return -ENOMEM;
 
         if (path) {
-                ret->fragment_path = strdup(path);
-                if (!ret->fragment_path)
-                        return -ENOMEM;
+                r = unit_set_fragment_path(ret, path);
+                if (r < 0)
+                        return r;
         }
 
         r = unit_add_name(ret, name);
@@ -2082,6 +2174,105 @@ void manager_dump_units(Manager *s, FILE *f, const char *prefix) {
                         unit_dump(u, f, prefix);
 }
 
+typedef struct InternedString {
+        unsigned n_ref;
+        char string[];
+} InternedString;
+
+char *manager_intern_string(Manager *m, const char *s) {
+        InternedString *i;
+        size_t l;
+        int r;
+
+        assert(m);
+        assert(s);
+
+        /* Many units carry the same paths, for example all instances of a template share the fragment path,
+         * and all mount units have the same source path. Hence keep only one copy of each such string
+         * around. The returned string must not be modified, and must be released with
+         * manager_unintern_string() instead of free(). */
+
+        i = hashmap_get(m->interned_strings, s);
+        if (i) {
+                i->n_ref++;
+                return i->string;
+        }
+
+        r = hashmap_ensure_allocated(&m->interned_strings, &string_hash_ops);
+        if (r < 0)
+                return NULL;
+
+        l = strlen(s);
+        i = malloc(offsetof(InternedString, string) + l + 1);
+        if (!i)
+                return NULL;
+
+        i->n_ref = 1;
+        memcpy(i->string, s, l + 1);
+
+        r = hashmap_put(m->interned_strings, i->string, i);
+        if (r < 0) {
+                free(i);
+                return NULL;
+        }
+
+        return i->string;
+}
+
+void manager_unintern_string(Manager *m, const char *s) {
+        InternedString *i;
+
+        assert(m);
+
+        if (!s)
+                return;
+
+        i = hashmap_get(m->interned_strings, s);
+        assert(i);
+        assert(i->string == s);
+        assert(i->n_ref > 0);
+
+        if (--i->n_ref > 0)
+                return;
+
+        hashmap_remove(m->interned_strings, i->string);
+        free(i);
+}
+
+static void manager_dump_memory(Manager *m, FILE *f, const char *prefix) {
+        size_t n_bytes = 0, n_saved = 0;
+        InternedString *i;
+        Iterator it;
+        UnitType t;
+
+        assert(m);
+        assert(f);
+
+        for (t = 0; t < _UNIT_TYPE_MAX; t++) {
+                unsigned n = 0;
+                Unit *u;
+
+                LIST_FOREACH(units_by_type, u, m->units_by_type[t])
+                        n++;
+
+                if (n == 0)
+                        continue;
+
+                fprintf(f, "%sUnit objects of type %s: %u, %zu bytes\n",
+                        strempty(prefix), unit_type_to_string(t), n, n * unit_vtable[t]->object_size);
+        }
+
+        HASHMAP_FOREACH(i, m->interned_strings, it) {
+                size_t l = strlen(i->string) + 1;
+
+                n_bytes += offsetof(InternedString, string) + l;
+                n_saved += (i->n_ref - 1) * l;
+        }
+
+        fprintf(f, "%sInterned strings: %u, %zu bytes, %zu bytes saved\n",
+                strempty(prefix), hashmap_size(m->interned_strings), n_bytes, n_saved);
+}
+
 void manager_dump(Manager *m, FILE *f, const char *prefix) {
         ManagerTimestamp q;
 
@@ -2100,6 +2291,12 @@ void manager_dump(Manager *m, FILE *f, const char *prefix) {
                                                                 format_timespan(buf, sizeof buf, t->monotonic, 1));
         }
 
+        fprintf(f, "%sNotification messages: %" PRIu64 "\n", strempty(prefix), m->n_notify_messages);
+
+        event_dump_statistics(m->event, f, prefix);
+        bpf_firewall_dump_maps(m, f, prefix);
+        manager_dump_memory(m, f, prefix);
+
         manager_dump_units(m, f, prefix);
         manager_dump_jobs(m, f, prefix);
 }
@@ -2152,16 +2349,34 @@ void manager_unwatch_pid(Manager *m, pid_t pid) {
 
 static int manager_dispatch_run_queue(sd_event_source *source, void *userdata) {
         Manager *m = userdata;
+        bool budget = true;
+        usec_t deadline;
+        unsigned n = 0;
         Job *j;
+        int r;
 
         assert(source);
         assert(m);
 
+        deadline = usec_add(now(CLOCK_MONOTONIC), MANAGER_RUN_QUEUE_BUDGET_USEC);
+
         while ((j = prioq_peek(m->run_queue))) {
                 assert(j->installed);
                 assert(j->in_run_queue);
 
+                /* Out of budget? Then let everything else pending in the event loop run first and come back
+                 * here afterwards. The event source is a oneshot one, and has hence been turned off already. */
+                if (budget && (n >= MANAGER_RUN_QUEUE_BUDGET || (n > 0 && now(CLOCK_MONOTONIC) >= deadline))) {
+                        r = sd_event_source_set_enabled(source, SD_EVENT_ONESHOT);
+                        if (r >= 0)
+                                break;
+
+                        log_warning_errno(r, "Failed to re-enable job run queue event source, processing all jobs now: %m");
+                        budget = false;
+                }
+
                 (void) job_run_and_invalidate(j);
+                n++;
         }
 
         if (m->n_running_jobs > 0)
@@ -2173,8 +2388,51 @@ static int manager_dispatch_run_queue(sd_event_source *source, void *userdata) {
         return 1;
 }
 
+static int manager_dispatch_dbus_coalesce(sd_event_source *source, usec_t usec, void *userdata) {
+        /* Nothing to do here, we just need the event loop to wake up, so that the queue is dispatched */
+        return 0;
+}
+
+static bool manager_coalesce_dbus_unit_queue(Manager *m) {
+        usec_t until;
+        int r;
+
+        assert(m);
+
+        /* Returns true if the units' change signals shall be held back for now */
+
+        if (m->dbus_signal_coalesce_usec == 0 || !m->dbus_unit_queue)
+                return false;
+
+        until = usec_add(m->dbus_unit_queue_since, m->dbus_signal_coalesce_usec);
+        if (now(CLOCK_MONOTONIC) >= until)
+                return false;
+
+        if (m->dbus_coalesce_event_source) {
+                r = sd_event_source_set_time(m->dbus_coalesce_event_source, until);
+                if (r >= 0)
+                        r = sd_event_source_set_enabled(m->dbus_coalesce_event_source, SD_EVENT_ONESHOT);
+        } else {
+                r = sd_event_add_time(
+                                m->event,
+                                &m->dbus_coalesce_event_source,
+                                CLOCK_MONOTONIC,
+                                until, 0,
+                                manager_dispatch_dbus_coalesce, m);
+                if (r >= 0)
+                        (void) sd_event_source_set_description(m->dbus_coalesce_event_source, "manager-dbus-coalesce");
+        }
+        if (r < 0) {
+                log_warning_errno(r, "Failed to set up timer for coalescing D-Bus signals, sending them right away: %m");
+                return false;
+        }
+
+        return true;
+}
+
 static unsigned manager_dispatch_dbus_queue(Manager *m) {
         unsigned n = 0, budget;
+        bool coalesce = false;
         Unit *u;
         Job *j;
 
@@ -2206,9 +2464,14 @@ static unsigned manager_dispatch_dbus_queue(Manager *m) {
                  * i.e. space, while the "budget" should put a limit on time. Also note that the "threshold" is
                  * currently chosen much higher than the "budget". */
                 budget = MANAGER_BUS_MESSAGE_BUDGET;
+
+                /* Give units a chance to change some more before we tell anybody, so that clients get woken up
+                 * once with the final state rather than for every intermediary one. Jobs are not held back:
+                 * those are usually announced once and removed shortly after anyway. */
+                coalesce = manager_coalesce_dbus_unit_queue(m);
         }
 
-        while (budget != 0 && (u = m->dbus_unit_queue)) {
+        while (!coalesce && budget != 0 && (u = m->dbus_unit_queue)) {
 
                 assert(u->in_dbus_queue);
 
@@ -2310,14 +2573,11 @@ static void manager_invoke_notify_message(
         }
 }
 
-static int manager_dispatch_notify_fd(sd_event_source *source, int fd, uint32_t revents, void *userdata) {
-
+static int manager_dispatch_one_notify_message(Manager *m, char *buf, pid_t *cached_pid, Unit **cached_unit) {
         _cleanup_fdset_free_ FDSet *fds = NULL;
-        Manager *m = userdata;
-        char buf[NOTIFY_BUFFER_MAX+1];
         struct iovec iovec = {
                 .iov_base = buf,
-                .iov_len = sizeof(buf)-1,
+                .iov_len = NOTIFY_BUFFER_MAX,
         };
         union {
                 struct cmsghdr cmsghdr;
@@ -2341,17 +2601,16 @@ static int manager_dispatch_notify_fd(sd_event_source *source, int fd, uint32_t
         ssize_t n;
 
         assert(m);
-        assert(m->notify_fd == fd);
+        assert(buf);
+        assert(cached_pid);
+        assert(cached_unit);
 
-        if (revents != EPOLLIN) {
-                log_warning("Got unexpected poll event for notify fd.");
-                return 0;
-        }
+        /* Returns > 0 if a message was read (even if it was ignored), 0 if there's nothing to read. */
 
         n = recvmsg(m->notify_fd, &msghdr, MSG_DONTWAIT|MSG_CMSG_CLOEXEC|MSG_TRUNC);
         if (n < 0) {
                 if (IN_SET(errno, EAGAIN, EINTR))
-                        return 0; /* Spurious wakeup, try again */
+                        return 0; /* Spurious wakeup, or everything read, try again */
 
                 /* If this is any other, real error, then let's stop processing this socket. This of course means we
                  * won't take notification messages anymore, but that's still better than busy looping around this:
@@ -2380,35 +2639,43 @@ static int manager_dispatch_notify_fd(sd_event_source *source, int fd, uint32_t
                 if (r < 0) {
                         close_many(fd_array, n_fds);
                         log_oom();
-                        return 0;
+                        return 1;
                 }
         }
 
         if (!ucred || !pid_is_valid(ucred->pid)) {
                 log_warning("Received notify message without valid credentials. Ignoring.");
-                return 0;
+                return 1;
         }
 
-        if ((size_t) n >= sizeof(buf) || (msghdr.msg_flags & MSG_TRUNC)) {
+        if ((size_t) n > NOTIFY_BUFFER_MAX || (msghdr.msg_flags & MSG_TRUNC)) {
                 log_warning("Received notify message exceeded maximum size. Ignoring.");
-                return 0;
+                return 1;
         }
 
         /* As extra safety check, let's make sure the string we get doesn't contain embedded NUL bytes. We permit one
          * trailing NUL byte in the message, but don't expect it. */
         if (n > 1 && memchr(buf, 0, n-1)) {
                 log_warning("Received notify message with embedded NUL bytes. Ignoring.");
-                return 0;
+                return 1;
         }
 
         /* Make sure it's NUL-terminated. */
         buf[n] = 0;
 
+        m->n_notify_messages++;
+
         /* Increase the generation counter used for filtering out duplicate unit invocations. */
         m->notifygen++;
 
-        /* Notify every unit that might be interested, which might be multiple. */
-        u1 = manager_get_unit_by_pid_cgroup(m, ucred->pid);
+        /* Notify every unit that might be interested, which might be multiple. Services which send many
+         * messages usually send them in a row, hence remember the unit we found for the PID by its cgroup, so
+         * that we don't have to look into /proc for each of them again. */
+        if (*cached_pid != ucred->pid) {
+                *cached_unit = manager_get_unit_by_pid_cgroup(m, ucred->pid);
+                *cached_pid = ucred->pid;
+        }
+        u1 = *cached_unit;
         u2 = hashmap_get(m->watch_pids, PID_TO_PTR(ucred->pid));
         array = hashmap_get(m->watch_pids, PID_TO_PTR(-ucred->pid));
         if (array) {
@@ -2443,6 +2710,33 @@ static int manager_dispatch_notify_fd(sd_event_source *source, int fd, uint32_t
         if (fdset_size(fds) > 0)
                 log_warning("Got extra auxiliary fds with notification message, closing them.");
 
+        return 1;
+}
+
+static int manager_dispatch_notify_fd(sd_event_source *source, int fd, uint32_t revents, void *userdata) {
+        char buf[NOTIFY_BUFFER_MAX+1];
+        Manager *m = userdata;
+        Unit *cached_unit = NULL;
+        pid_t cached_pid = 0;
+        unsigned n;
+        int r;
+
+        assert(m);
+        assert(m->notify_fd == fd);
+
+        if (revents != EPOLLIN) {
+                log_warning("Got unexpected poll event for notify fd.");
+                return 0;
+        }
+
+        /* Process a bunch of messages in one go rather than going through the event loop for each of them, but
+         * not so many that we starve everything else when services are chatty. */
+        for (n = 0; n < MANAGER_NOTIFY_BUDGET; n++) {
+                r = manager_dispatch_one_notify_message(m, buf, &cached_pid, &cached_unit);
+                if (r <= 0)
+                        return r;
+        }
+
         return 0;
 }
 
@@ -2467,14 +2761,13 @@ static void manager_invoke_sigchld_event(
                 UNIT_VTABLE(u)->sigchld_event(u, si->si_pid, si->si_code, si->si_status);
 }
 
-static int manager_dispatch_sigchld(sd_event_source *source, void *userdata) {
-        Manager *m = userdata;
+static int manager_dispatch_one_sigchld(Manager *m) {
         siginfo_t si = {};
-        int r;
 
-        assert(source);
         assert(m);
 
+        /* Returns > 0 if a child was processed, 0 if there are none left to process. */
+
         /* First we call waitid() for a PID and do not reap the zombie. That way we can still access /proc/$PID for it
          * while it is a zombie. */
 
@@ -2483,18 +2776,20 @@ static int manager_dispatch_sigchld(sd_event_source *source, void *userdata) {
                 if (errno != ECHILD)
                         log_error_errno(errno, "Failed to peek for child with waitid(), ignoring: %m");
 
-                goto turn_off;
+                return 0;
         }
 
         if (si.si_pid <= 0)
-                goto turn_off;
+                return 0;
 
         if (IN_SET(si.si_code, CLD_EXITED, CLD_KILLED, CLD_DUMPED)) {
                 _cleanup_free_ Unit **array_copy = NULL;
                 _cleanup_free_ char *name = NULL;
                 Unit *u1, *u2, **array;
 
-                (void) get_process_comm(si.si_pid, &name);
+                /* Reading the name from /proc is only worth it if we log it */
+                if (DEBUG_LOGGING)
+                        (void) get_process_comm(si.si_pid, &name);
 
                 log_debug("Child "PID_FMT" (%s) died (code=%s, status=%i/%s)",
                           si.si_pid, strna(name),
@@ -2542,9 +2837,31 @@ static int manager_dispatch_sigchld(sd_event_source *source, void *userdata) {
         }
 
         /* And now, we actually reap the zombie. */
-        if (waitid(P_PID, si.si_pid, &si, WEXITED) < 0) {
+        if (waitid(P_PID, si.si_pid, &si, WEXITED) < 0)
                 log_error_errno(errno, "Failed to dequeue child, ignoring: %m");
-                return 0;
+
+        return 1;
+}
+
+static int manager_dispatch_sigchld(sd_event_source *source, void *userdata) {
+        Manager *m = userdata;
+        unsigned n;
+        int r;
+
+        assert(source);
+        assert(m);
+
+        /* Reap a bunch of children in one go, rather than going through the whole event loop for each of them. The
+         * units' reactions to the deaths are queued, and hence processed in bulk afterwards. However, notification
+         * messages have to be processed before the death of the process that sent them, hence go back to the event
+         * loop as soon as one is waiting for us. */
+
+        for (n = 0; n < MANAGER_SIGCHLD_BUDGET; n++) {
+                if (n > 0 && m->notify_fd >= 0 && fd_wait_for_event(m->notify_fd, POLLIN, 0) > 0)
+                        return 0;
+
+                if (manager_dispatch_one_sigchld(m) == 0)
+                        goto turn_off;
         }
 
         return 0;
@@ -2872,6 +3189,23 @@ static int manager_dispatch_jobs_in_progress(sd_event_source *source, usec_t use
         return sd_event_source_set_enabled(source, SD_EVENT_ONESHOT);
 }
 
+static void manager_account_loop_iteration(Manager *m) {
+        usec_t woken, t;
+
+        assert(m);
+
+        /* We are about to go to sleep again. The time since the event loop woke us up is how long this
+         * iteration took, including dispatching our own queues. sd_event_now() returns > 0 if the event loop
+         * didn't run yet, in which case there's nothing to account. */
+        if (sd_event_now(m->event, CLOCK_MONOTONIC, &woken) != 0)
+                return;
+
+        t = usec_sub_unsigned(now(CLOCK_MONOTONIC), woken);
+        m->n_loop_iterations++;
+        m->loop_usec_total += t;
+        m->loop_usec_max = MAX(m->loop_usec_max, t);
+}
+
 int manager_loop(Manager *m) {
         RateLimit rl = { .interval = 1*USEC_PER_SEC, .burst = 50000 };
         int r;
@@ -2927,6 +3261,8 @@ int manager_loop(Manager *m) {
                 } else
                         wait_usec = USEC_INFINITY;
 
+                manager_account_loop_iteration(m);
+
                 r = sd_event_run(m->event, wait_usec);
                 if (r < 0)
                         return log_error_errno(r, "Failed to run event loop: %m");
@@ -3276,7 +3612,7 @@ static int manager_deserialize_units(Manager *m, FILE *f, FDSet *fds) {
         for (;;) {
                 _cleanup_free_ char *line = NULL;
                 /* Start marker */
-                r = read_line(f, LONG_LINE_MAX, &line);
+                r = deserialize_read_line(f, &line);
                 if (r < 0)
                         return log_error_errno(r, "Failed to read serialization line: %m");
                 if (r == 0)
@@ -3314,7 +3650,7 @@ int manager_deserialize(Manager *m, FILE *f, FDSet *fds) {
                 _cleanup_free_ char *line = NULL;
                 const char *val, *l;
 
-                r = read_line(f, LONG_LINE_MAX, &line);
+                r = deserialize_read_line(f, &line);
                 if (r < 0)
                         return log_error_errno(r, "Failed to read serialization line: %m");
                 if (r == 0)
@@ -3500,14 +3836,258 @@ int manager_deserialize(Manager *m, FILE *f, FDSet *fds) {
         return manager_deserialize_units(m, f, fds);
 }
 
+/* Changes to files are detected by their ctime, which unlike the mtime cannot be set from userspace. The kernel
+ * stamps inodes from a coarse clock, hence allow for some slack. */
+#define UNIT_CONFIG_TIMESTAMP_SLACK_USEC USEC_PER_SEC
+
+static bool path_changed_since(const char *path, usec_t since, unsigned depth) {
+        _cleanup_closedir_ DIR *d = NULL;
+        struct dirent *de;
+        struct stat st;
+
+        assert(path);
+
+        if (lstat(path, &st) < 0)
+                return errno != ENOENT;
+
+        if (timespec_load(&st.st_ctim) >= since)
+                return true;
+
+        if (S_ISLNK(st.st_mode)) {
+                /* Also check what the link points to, it might be a linked unit file outside of the search path */
+                if (stat(path, &st) < 0)
+                        return false;
+
+                if (timespec_load(&st.st_ctim) >= since)
+                        return true;
+        }
+
+        if (!S_ISDIR(st.st_mode) || depth == 0)
+                return false;
+
+        d = opendir(path);
+        if (!d)
+                return errno != ENOENT;
+
+        FOREACH_DIRENT(de, d, return true) {
+                _cleanup_free_ char *p = NULL;
+
+                p = path_join(path, de->d_name);
+                if (!p)
+                        return true;
+
+                if (path_changed_since(p, since, depth - 1))
+                        return true;
+        }
+
+        return false;
+}
+
+static bool manager_unit_config_changed(Manager *m) {
+        char **dir;
+        usec_t since;
+
+        assert(m);
+
+        /* Checks whether any unit file, drop-in, .wants/.requires symlink or manager configuration file was
+         * added, changed or removed since the units were last loaded. The generator directories are not
+         * checked here, as they are rewritten on each reload. Neither is the transient directory, as its
+         * contents are written by us from the state of the transient units. */
+
+        if (m->unit_config_timestamp == 0)
+                return true;
+
+        since = usec_sub_unsigned(m->unit_config_timestamp, UNIT_CONFIG_TIMESTAMP_SLACK_USEC);
+        if (now(CLOCK_REALTIME) < since)
+                return true; /* The clock jumped backwards, we can't tell */
+
+        STRV_FOREACH(dir, m->lookup_paths.search_path) {
+                if (path_equal_ptr(*dir, m->lookup_paths.generator) ||
+                    path_equal_ptr(*dir, m->lookup_paths.generator_early) ||
+                    path_equal_ptr(*dir, m->lookup_paths.generator_late) ||
+                    path_equal_ptr(*dir, m->lookup_paths.transient))
+                        continue;
+
+                /* The directory itself, the unit files, and the files in foo.d/, foo.wants/ and foo.requires/ */
+                if (path_changed_since(*dir, since, 2)) {
+                        log_debug("Unit files in %s changed.", *dir);
+                        return true;
+                }
+        }
+
+        if (path_changed_since(MANAGER_IS_SYSTEM(m) ? PKGSYSCONFDIR "/system.conf" : PKGSYSCONFDIR "/user.conf", since, 0))
+                return true;
+
+        STRV_FOREACH(dir, MANAGER_IS_SYSTEM(m) ? CONF_PATHS_STRV("systemd/system.conf.d") : CONF_PATHS_STRV("systemd/user.conf.d"))
+                if (path_changed_since(*dir, since, 1))
+                        return true;
+
+        return false;
+}
+
+static int hash_directory(const char *path, unsigned depth, struct siphash *state) {
+        _cleanup_strv_free_ char **names = NULL;
+        _cleanup_closedir_ DIR *d = NULL;
+        struct dirent *de;
+        char **name;
+        int r;
+
+        assert(path);
+        assert(state);
+
+        d = opendir(path);
+        if (!d) {
+                if (errno == ENOENT)
+                        return 0;
+
+                return -errno;
+        }
+
+        /* The directory order depends on the order the files were created in, which isn't stable for
+         * generators running in parallel, hence sort first. */
+        FOREACH_DIRENT_ALL(de, d, return -errno) {
+                if (dot_or_dot_dot(de->d_name))
+                        continue;
+
+                r = strv_extend(&names, de->d_name);
+                if (r < 0)
+                        return r;
+        }
+
+        strv_sort(names);
+
+        STRV_FOREACH(name, names) {
+                _cleanup_free_ char *p = NULL, *contents = NULL;
+                struct stat st;
+                size_t size;
+
+                p = path_join(path, *name);
+                if (!p)
+                        return -ENOMEM;
+
+                if (lstat(p, &st) < 0)
+                        return -errno;
+
+                siphash24_compress(*name, strlen(*name) + 1, state);
+                siphash24_compress(&st.st_mode, sizeof(st.st_mode), state);
+
+                if (S_ISLNK(st.st_mode)) {
+                        r = readlink_malloc(p, &contents);
+                        if (r < 0)
+                                return r;
+
+                        siphash24_compress(contents, strlen(contents) + 1, state);
+
+                } else if (S_ISREG(st.st_mode)) {
+                        r = read_full_file(p, &contents, &size);
+                        if (r < 0)
+                                return r;
+
+                        siphash24_compress(&size, sizeof(size), state);
+                        siphash24_compress(contents, size, state);
+
+                } else if (S_ISDIR(st.st_mode)) {
+                        if (depth == 0)
+                                return -E2BIG;
+
+                        r = hash_directory(p, depth - 1, state);
+                        if (r < 0)
+                                return r;
+                }
+        }
+
+        return 0;
+}
+
+static int manager_hash_generator_output(Manager *m, uint64_t *ret) {
+        static const sd_id128_t key = SD_ID128_MAKE(d9,2f,4b,e9,59,c6,4a,ab,a8,be,52,7b,6a,a5,33,53);
+        const char *dirs[] = {
+                m->lookup_paths.generator_early,
+                m->lookup_paths.generator,
+                m->lookup_paths.generator_late,
+        };
+        struct siphash state;
+        size_t i;
+        int r;
+
+        assert(m);
+        assert(ret);
+
+        siphash24_init(&state, key.bytes);
+
+        for (i = 0; i < ELEMENTSOF(dirs); i++) {
+                if (!dirs[i])
+                        continue;
+
+                siphash24_compress(dirs[i], strlen(dirs[i]) + 1, &state);
+
+                r = hash_directory(dirs[i], 3, &state);
+                if (r < 0)
+                        return log_debug_errno(r, "Failed to hash generator output in %s: %m", dirs[i]);
+        }
+
+        *ret = siphash24_finalize(&state);
+        return 0;
+}
+
+static void manager_units_current(Manager *m, usec_t timestamp) {
+        Iterator i;
+        Unit *u;
+
+        assert(m);
+
+        /* The configuration on disk is what the units were loaded from, even though the generated files have
+         * been written anew. Hence make sure the units aren't considered in need of a reload. */
+
+        HASHMAP_FOREACH(u, m->units, i) {
+                if (u->fragment_mtime > 0)
+                        u->fragment_mtime = timestamp;
+                if (u->source_mtime > 0)
+                        u->source_mtime = timestamp;
+                u->dropin_mtime = timestamp;
+        }
+
+        m->unit_config_timestamp = timestamp;
+}
+
 int manager_reload(Manager *m) {
         _cleanup_(manager_reloading_stopp) Manager *reloading = NULL;
         _cleanup_fdset_free_ FDSet *fds = NULL;
         _cleanup_fclose_ FILE *f = NULL;
+        uint64_t generator_hash = 0;
+        nsec_t reload_ts, ts;
+        usec_t timestamp;
         int r;
 
         assert(m);
 
+        reload_ts = trace_now();
+
+        /* We are officially in reload mode from here on. */
+        reloading = manager_reloading_start(m);
+
+        /* Rerun the generators first. If neither their output nor any unit file changed since the units were
+         * loaded there's nothing to reload, and tearing down and rebuilding all units would be pointless. */
+        timestamp = now(CLOCK_REALTIME);
+
+        lookup_paths_flush_generator(&m->lookup_paths);
+        (void) manager_run_environment_generators(m);
+        (void) manager_run_generators(m);
+
+        r = manager_hash_generator_output(m, &generator_hash);
+        if (r >= 0 && generator_hash == m->generator_output_hash && !manager_unit_config_changed(m)) {
+                log_info("Unit configuration unchanged, not reloading units.");
+
+                bus_manager_send_reloading(m, true);
+                manager_units_current(m, timestamp);
+
+                m->objective = MANAGER_OK;
+                m->send_reloading_done = true;
+
+                trace_record(&m->trace, TRACE_RELOAD, NULL, reload_ts);
+                return 0;
+        }
+
         r = manager_open_serialization(m, &f);
         if (r < 0)
                 return log_error_errno(r, "Failed to create serialization file: %m");
@@ -3516,10 +4096,10 @@ int manager_reload(Manager *m) {
         if (!fds)
                 return log_oom();
 
-        /* We are officially in reload mode from here on. */
-        reloading = manager_reloading_start(m);
-
+        /* We'll read this back ourselves, hence use the cheaper binary framing */
+        serialize_set_binary(f);
         r = manager_serialize(m, f, fds, false);
+        serialize_set_binary(NULL);
         if (r < 0)
                 return r;
 
@@ -3536,7 +4116,6 @@ int manager_reload(Manager *m) {
          * it.*/
 
         manager_clear_jobs_and_units(m);
-        lookup_paths_flush_generator(&m->lookup_paths);
         lookup_paths_free(&m->lookup_paths);
         exec_runtime_vacuum(m);
         dynamic_user_vacuum(m, false);
@@ -3547,22 +4126,24 @@ int manager_reload(Manager *m) {
         if (r < 0)
                 log_warning_errno(r, "Failed to initialize path lookup table, ignoring: %m");
 
-        (void) manager_run_environment_generators(m);
-        (void) manager_run_generators(m);
-
         lookup_paths_log(&m->lookup_paths);
 
         /* We flushed out generated files, for which we don't watch mtime, so we should flush the old map. */
         manager_free_unit_name_maps(m);
 
+        m->unit_config_timestamp = timestamp;
+        m->generator_output_hash = generator_hash;
+
         /* First, enumerate what we can from kernel and suchlike */
         manager_enumerate_perpetual(m);
         manager_enumerate(m);
 
         /* Second, deserialize our stored data */
+        ts = trace_now();
         r = manager_deserialize(m, f, fds);
         if (r < 0)
                 log_warning_errno(r, "Deserialization failed, proceeding anyway: %m");
+        trace_record(&m->trace, TRACE_DESERIALIZE, NULL, ts);
 
         /* We don't need the serialization anymore */
         f = safe_fclose(f);
@@ -3590,6 +4171,8 @@ int manager_reload(Manager *m) {
         manager_ready(m);
 
         m->send_reloading_done = true;
+
+        trace_record(&m->trace, TRACE_RELOAD, NULL, reload_ts);
         return 0;
 }
 
@@ -3857,6 +4440,9 @@ static int manager_run_environment_generators(Manager *m) {
 
 static int manager_run_generators(Manager *m) {
         _cleanup_strv_free_ char **paths = NULL;
+        ExecDirTiming *timings = NULL;
+        size_t n_timings = 0, i;
+        nsec_t ts = trace_now();
         const char *argv[5];
         int r;
 
@@ -3885,13 +4471,28 @@ static int manager_run_generators(Manager *m) {
         argv[4] = NULL;
 
         RUN_WITH_UMASK(0022)
-                (void) execute_directories((const char* const*) paths, DEFAULT_TIMEOUT_USEC, NULL, NULL,
-                                           (char**) argv, m->transient_environment, EXEC_DIR_PARALLEL | EXEC_DIR_IGNORE_ERRORS);
+                (void) execute_directories_full((const char* const*) paths, DEFAULT_TIMEOUT_USEC, NULL, NULL,
+                                                (char**) argv, m->transient_environment, EXEC_DIR_PARALLEL | EXEC_DIR_IGNORE_ERRORS,
+                                                &timings, &n_timings);
+
+        /* Generators run in parallel, record how long each of them took, so that slow ones can be spotted
+         * with "systemd-analyze trace" */
+        for (i = 0; i < n_timings; i++) {
+                char buf[FORMAT_TIMESPAN_MAX];
+
+                log_debug("Generator %s finished in %s.", timings[i].name,
+                          format_timespan(buf, sizeof(buf), timings[i].duration, USEC_PER_MSEC));
+
+                trace_record_span(&m->trace, TRACE_GENERATOR, timings[i].name,
+                                  timings[i].start * NSEC_PER_USEC, timings[i].duration * NSEC_PER_USEC);
+        }
 
+        exec_dir_timing_free_many(timings, n_timings);
         r = 0;
 
 finish:
         lookup_paths_trim_generator(&m->lookup_paths);
+        trace_record(&m->trace, TRACE_GENERATORS, NULL, ts);
         return r;
 }
 
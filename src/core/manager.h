@@ -10,6 +10,7 @@
 
 #include "cgroup-util.h"
 #include "cgroup.h"
+#include "conf-files.h"
 #include "fdset.h"
 #include "hashmap.h"
 #include "ip-address-access.h"
@@ -116,6 +117,7 @@ typedef enum ManagerTimestamp {
 #include "job.h"
 #include "path-lookup.h"
 #include "show-status.h"
+#include "trace.h"
 #include "unit-name.h"
 
 typedef enum ManagerTestRunFlags {
@@ -156,6 +158,12 @@ struct Manager {
         LIST_HEAD(Unit, dbus_unit_queue);
         LIST_HEAD(Job, dbus_job_queue);
 
+        /* If non-zero, units' change signals are held back for this long after the first unit was queued, so
+         * that more changes can be coalesced into them. */
+        usec_t dbus_signal_coalesce_usec;
+        usec_t dbus_unit_queue_since;
+        sd_event_source *dbus_coalesce_event_source;
+
         /* Units to remove */
         LIST_HEAD(Unit, cleanup_queue);
 
@@ -221,13 +229,34 @@ struct Manager {
 
         sd_event_source *sync_bus_names_event_source;
 
+        sd_event_source *memory_pressure_event_source;
+
         UnitFileScope unit_file_scope;
         LookupPaths lookup_paths;
         Hashmap *unit_id_map;
         Hashmap *unit_name_map;
         Set *unit_path_cache;
+        ConfFilesCache *dropin_cache;
         usec_t unit_cache_mtime;
 
+        /* Unit files read ahead while dispatching the load queue */
+        Hashmap *prefetched_files;
+
+        /* Recent phases of our own work, for "systemd-analyze trace" */
+        TraceRing trace;
+
+        /* Counters for "systemd-analyze dump --stats" */
+        unsigned n_load_queue, n_load_queue_max;
+        uint64_t n_transactions;
+        usec_t transaction_usec_total, transaction_usec_max;
+        uint64_t n_loop_iterations;
+        usec_t loop_usec_total, loop_usec_max;
+
+        /* When the units were last loaded from disk, and a hash of the generator output they were loaded from,
+         * so that a reload can tell whether there's anything new to load at all */
+        usec_t unit_config_timestamp;
+        uint64_t generator_output_hash;
+
         char **transient_environment;  /* The environment, as determined from config files, kernel cmdline and environment generators */
         char **client_environment;     /* Environment variables created by clients through the bus API */
 
@@ -403,6 +432,12 @@ struct Manager {
         /* ExecRuntime, indexed by their owner unit id */
         Hashmap *exec_runtime_by_id;
 
+        /* BPF firewall access maps shared by units with the same rules, indexed by their contents */
+        Hashmap *bpf_firewall_maps;
+
+        /* Reference counted strings shared between units, see manager_intern_string() */
+        Hashmap *interned_strings;
+
         /* When the user hits C-A-D more than 7 times per 2s, do something immediately... */
         RateLimit ctrl_alt_del_ratelimit;
         EmergencyAction cad_burst_action;
@@ -423,6 +458,9 @@ struct Manager {
         unsigned sigchldgen;
         unsigned notifygen;
 
+        /* Number of sd_notify() messages processed, for statistics */
+        uint64_t n_notify_messages;
+
         bool honor_device_enumeration;
 };
 
@@ -464,6 +502,9 @@ int manager_add_job_by_name(Manager *m, JobType type, const char *name, JobMode
 int manager_add_job_by_name_and_warn(Manager *m, JobType type, const char *name, JobMode mode, Set *affected_jobs,  Job **ret);
 int manager_propagate_reload(Manager *m, Unit *unit, JobMode mode, sd_bus_error *e);
 
+char *manager_intern_string(Manager *m, const char *s);
+void manager_unintern_string(Manager *m, const char *s);
+
 void manager_dump_units(Manager *s, FILE *f, const char *prefix);
 void manager_dump_jobs(Manager *s, FILE *f, const char *prefix);
 void manager_dump(Manager *s, FILE *f, const char *prefix);
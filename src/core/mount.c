@@ -1516,7 +1516,7 @@ static int mount_setup_new_unit(
         if (r < 0)
                 return r;
 
-        r = free_and_strdup(&u->source_path, "/proc/self/mountinfo");
+        r = unit_set_source_path(u, "/proc/self/mountinfo");
         if (r < 0)
                 return r;
 
@@ -95,6 +95,8 @@ static void socket_init(Unit *u) {
 
         s->control_command_id = _SOCKET_EXEC_COMMAND_INVALID;
 
+        s->accept_helper_fd = -1;
+
         s->trigger_limit.interval = USEC_INFINITY;
         s->trigger_limit.burst = (unsigned) -1;
 }
@@ -134,12 +136,27 @@ void socket_free_ports(Socket *s) {
         }
 }
 
+static void socket_stop_accept_helper(Socket *s) {
+        assert(s);
+
+        s->accept_helper_fd = safe_close(s->accept_helper_fd);
+
+        /* The helper lives in our cgroup. Make sure it is gone before we go on killing the cgroup, so that it
+         * doesn't delay stopping the unit. It doesn't do anything but wait for our requests, hence this is
+         * quick. */
+        if (s->accept_helper_pid > 0) {
+                sigkill_wait(s->accept_helper_pid);
+                s->accept_helper_pid = 0;
+        }
+}
+
 static void socket_done(Unit *u) {
         Socket *s = SOCKET(u);
         SocketPeer *p;
 
         assert(s);
 
+        socket_stop_accept_helper(s);
         socket_free_ports(s);
 
         while ((p = set_steal_first(s->peers_by_address)))
@@ -1814,6 +1831,9 @@ static void socket_set_state(Socket *s, SocketState state) {
         if (state != SOCKET_LISTENING)
                 socket_unwatch_fds(s);
 
+        if (!IN_SET(state, SOCKET_LISTENING, SOCKET_RUNNING))
+                socket_stop_accept_helper(s);
+
         if (!IN_SET(state,
                     SOCKET_START_CHOWN,
                     SOCKET_START_POST,
@@ -2304,12 +2324,10 @@ static void socket_enter_running(Socket *s, int cfd) {
         if (cfd < 0) {
                 bool pending = false;
                 Unit *other;
-                Iterator i;
-                void *v;
 
                 /* If there's already a start pending don't bother to
                  * do anything */
-                HASHMAP_FOREACH_KEY(v, other, UNIT(s)->dependencies[UNIT_TRIGGERS], i)
+                UNIT_FOREACH_DEPENDENCY(other, UNIT(s), UNIT_TRIGGERS)
                         if (unit_active_or_pending(other)) {
                                 pending = true;
                                 break;
@@ -2883,6 +2901,112 @@ static int socket_accept_do(Socket *s, int fd) {
         return cfd;
 }
 
+static int socket_start_accept_helper(Socket *s) {
+        _cleanup_close_pair_ int pair[2] = { -1, -1 };
+        pid_t pid;
+        int r;
+
+        assert(s);
+        assert(s->accept_helper_fd < 0);
+
+        if (socketpair(AF_UNIX, SOCK_SEQPACKET|SOCK_CLOEXEC, 0, pair) < 0)
+                return log_unit_error_errno(UNIT(s), errno, "Failed to create communication channel: %m");
+
+        r = unit_fork_helper_process(UNIT(s), "(sd-accept)", &pid);
+        if (r < 0)
+                return log_unit_error_errno(UNIT(s), r, "Failed to fork off accept helper process: %m");
+        if (r == 0) {
+                /* Child */
+
+                pair[0] = safe_close(pair[0]);
+
+                /* Don't keep any of our other fds open, in particular not the listening sockets of other units */
+                log_forget_fds();
+                log_set_open_when_needed(true);
+
+                r = close_all_fds(&pair[1], 1);
+                if (r < 0) {
+                        log_unit_error_errno(UNIT(s), r, "Failed to close file descriptors: %m");
+                        _exit(EXIT_FDS);
+                }
+
+                /* We get passed the listening socket to accept a connection on, and pass back either the
+                 * connection socket, or the error we got. We exit once the manager closes the other side. */
+                for (;;) {
+                        int lfd, cfd;
+
+                        lfd = receive_one_fd(pair[1], 0);
+                        if (lfd < 0)
+                                _exit(EXIT_SUCCESS);
+
+                        cfd = socket_accept_do(s, lfd);
+                        safe_close(lfd);
+
+                        if (cfd >= 0) {
+                                r = send_one_fd(pair[1], cfd, 0);
+                                safe_close(cfd);
+                        } else
+                                r = send(pair[1], &cfd, sizeof(cfd), MSG_NOSIGNAL) < 0 ? -errno : 0;
+                        if (r < 0) {
+                                log_unit_error_errno(UNIT(s), r, "Failed to send connection socket to manager: %m");
+                                _exit(EXIT_FAILURE);
+                        }
+                }
+        }
+
+        s->accept_helper_fd = TAKE_FD(pair[0]);
+        s->accept_helper_pid = pid;
+
+        log_unit_debug(UNIT(s), "Started accept helper process " PID_FMT ".", pid);
+        return 0;
+}
+
+static int socket_accept_via_helper(Socket *s, int fd, int *ret_cfd) {
+        struct iovec iov;
+        ssize_t n;
+        int cfd, error = 0, r;
+
+        assert(s);
+        assert(fd >= 0);
+        assert(ret_cfd);
+
+        /* Returns < 0 if talking to the helper failed, and 0 otherwise, in which case ret_cfd is either the
+         * connection socket or the error accept() failed with. */
+
+        if (s->accept_helper_fd < 0) {
+                r = socket_start_accept_helper(s);
+                if (r < 0)
+                        return r;
+        }
+
+        r = send_one_fd(s->accept_helper_fd, fd, 0);
+        if (r < 0)
+                goto fail;
+
+        iov = IOVEC_MAKE(&error, sizeof(error));
+        n = receive_one_fd_iov(s->accept_helper_fd, &iov, 1, 0, &cfd);
+        if (n < 0) {
+                r = n;
+                goto fail;
+        }
+        if (cfd >= 0) {
+                *ret_cfd = cfd;
+                return 0;
+        }
+        if (n != sizeof(error) || error >= 0) {
+                r = -EBADMSG;
+                goto fail;
+        }
+
+        *ret_cfd = error;
+        return 0;
+
+fail:
+        log_unit_debug_errno(UNIT(s), r, "Failed to talk to accept helper process, stopping it: %m");
+        socket_stop_accept_helper(s);
+        return r;
+}
+
 static int socket_accept_in_cgroup(Socket *s, SocketPort *p, int fd) {
         _cleanup_close_pair_ int pair[2] = { -1, -1 };
         int cfd, r;
@@ -2904,6 +3028,17 @@ static int socket_accept_in_cgroup(Socket *s, SocketPort *p, int fd) {
         if (r == BPF_FIREWALL_UNSUPPORTED)
                 goto shortcut;
 
+        /* Usually the long-running helper does the job. Only if that doesn't work out fork off one for just
+         * this connection, as before. */
+        if (socket_accept_via_helper(s, fd, &cfd) >= 0) {
+                if (cfd == -EAGAIN) /* spurious accept(), skip it silently */
+                        return -EAGAIN;
+                if (cfd < 0)
+                        return log_unit_error_errno(UNIT(s), cfd, "Failed to accept connection socket: %m");
+
+                return cfd;
+        }
+
         if (socketpair(AF_UNIX, SOCK_SEQPACKET|SOCK_CLOEXEC, 0, pair) < 0)
                 return log_unit_error_errno(UNIT(s), errno, "Failed to create communication channel: %m");
 
@@ -99,6 +99,11 @@ struct Socket {
         SocketExecCommand control_command_id;
         pid_t control_pid;
 
+        /* A long-running helper process in our cgroup that accepts connections on our behalf, so that we don't
+         * have to fork one for each connection, see socket_accept_in_cgroup() */
+        pid_t accept_helper_pid;
+        int accept_helper_fd;
+
         mode_t directory_mode;
         mode_t socket_mode;
 
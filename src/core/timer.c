@@ -120,7 +120,7 @@ static int timer_add_trigger_dependencies(Timer *t) {
 
         assert(t);
 
-        if (!hashmap_isempty(UNIT(t)->dependencies[UNIT_TRIGGERS]))
+        if (unit_dependency_count(UNIT(t), UNIT_TRIGGERS) > 0)
                 return 0;
 
         r = unit_load_related_unit(UNIT(t), ".service", &x);
@@ -383,9 +383,18 @@ static void timer_enter_waiting(Timer *t, bool time_change) {
                                         b = ts.realtime;
                         }
 
-                        r = calendar_spec_next_usec(v->calendar_spec, b, &v->next_elapse);
-                        if (r < 0)
-                                continue;
+                        /* The next elapse only depends on the base (and the timezone, see
+                         * timer_timezone_change()), hence there's no need to calculate it again after the
+                         * clock was changed, unless the base changed too. */
+                        if (v->next_elapse_base == 0 || v->next_elapse_base != b) {
+                                v->next_elapse_base = 0;
+
+                                r = calendar_spec_next_usec(v->calendar_spec, b, &v->next_elapse);
+                                if (r < 0)
+                                        continue;
+
+                                v->next_elapse_base = b;
+                        }
 
                         /* To make the delay due to RandomizedDelaySec= work even at boot,
                          * if the scheduled time has already passed, set the time when systemd
@@ -817,9 +826,14 @@ static void timer_time_change(Unit *u) {
 
 static void timer_timezone_change(Unit *u) {
         Timer *t = TIMER(u);
+        TimerValue *v;
 
         assert(u);
 
+        /* Calendar events are calculated in local time, hence forget what we calculated so far */
+        LIST_FOREACH(value, v, t->values)
+                v->next_elapse_base = 0;
+
         if (t->state != TIMER_WAITING)
                 return;
 
@@ -24,6 +24,7 @@ typedef struct TimerValue {
         usec_t value; /* only for monotonic events */
         CalendarSpec *calendar_spec; /* only for calendar events */
         usec_t next_elapse;
+        usec_t next_elapse_base; /* only for calendar events: what next_elapse was calculated from, 0 if not yet */
 
         LIST_FIELDS(struct TimerValue, value);
 } TimerValue;
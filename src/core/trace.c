@@ -0,0 +1,88 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include "alloc-util.h"
+#include "string-table.h"
+#include "trace.h"
+
+void trace_record_span(TraceRing *ring, TracePhase phase, const char *subject, nsec_t start, nsec_t duration) {
+        TraceEvent *e;
+
+        assert(ring);
+        assert(phase >= 0);
+        assert(phase < _TRACE_PHASE_MAX);
+
+        if (!ring->events) {
+                ring->events = new0(TraceEvent, TRACE_RING_SIZE);
+                if (!ring->events)
+                        return; /* Tracing is best effort */
+        }
+
+        e = ring->events + ring->n_recorded % TRACE_RING_SIZE;
+
+        /* The subject string of the event we overwrite is reused where it fits, so that a ring that wrapped
+         * around doesn't need an allocation per event */
+        if (subject && e->subject && strlen(e->subject) >= strlen(subject))
+                strcpy(e->subject, subject);
+        else {
+                free(e->subject);
+                e->subject = subject ? strdup(subject) : NULL;
+        }
+
+        e->phase = phase;
+        e->start = start;
+        e->duration = duration;
+
+        ring->n_recorded++;
+}
+
+void trace_record(TraceRing *ring, TracePhase phase, const char *subject, nsec_t start) {
+        trace_record_span(ring, phase, subject, start, LESS_BY(trace_now(), start));
+}
+
+size_t trace_ring_size(const TraceRing *ring) {
+        assert(ring);
+
+        if (!ring->events)
+                return 0;
+
+        return (size_t) MIN(ring->n_recorded, (uint64_t) TRACE_RING_SIZE);
+}
+
+const TraceEvent *trace_ring_get(const TraceRing *ring, size_t i) {
+        uint64_t first;
+
+        assert(ring);
+        assert(i < trace_ring_size(ring));
+
+        first = ring->n_recorded - trace_ring_size(ring);
+
+        return ring->events + (first + i) % TRACE_RING_SIZE;
+}
+
+void trace_ring_done(TraceRing *ring) {
+        size_t i;
+
+        assert(ring);
+
+        if (ring->events)
+                for (i = 0; i < TRACE_RING_SIZE; i++)
+                        free(ring->events[i].subject);
+
+        ring->events = mfree(ring->events);
+        ring->n_recorded = 0;
+}
+
+static const char* const trace_phase_table[_TRACE_PHASE_MAX] = {
+        [TRACE_GENERATORS] = "generators",
+        [TRACE_GENERATOR] = "generator",
+        [TRACE_ENUMERATE] = "enumerate",
+        [TRACE_DESERIALIZE] = "deserialize",
+        [TRACE_COLDPLUG] = "coldplug",
+        [TRACE_UNIT_LOAD] = "unit-load",
+        [TRACE_TRANSACTION] = "transaction",
+        [TRACE_CGROUP_REALIZE] = "cgroup-realize",
+        [TRACE_SPAWN] = "spawn",
+        [TRACE_RELOAD] = "reload",
+};
+
+DEFINE_STRING_TABLE_LOOKUP(trace_phase, TracePhase);
@@ -0,0 +1,57 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+#pragma once
+
+#include "macro.h"
+#include "time-util.h"
+
+/* A ring of the most recent phases of internal work of the manager, such as running generators, loading
+ * units or forking off processes, each with its start time and duration. This is cheap enough to be always
+ * on, and lets "systemd-analyze trace" show where the manager itself spent its time during boot. */
+
+#define TRACE_RING_SIZE 4096U
+
+typedef enum TracePhase {
+        TRACE_GENERATORS,
+        TRACE_GENERATOR,
+        TRACE_ENUMERATE,
+        TRACE_DESERIALIZE,
+        TRACE_COLDPLUG,
+        TRACE_UNIT_LOAD,
+        TRACE_TRANSACTION,
+        TRACE_CGROUP_REALIZE,
+        TRACE_SPAWN,
+        TRACE_RELOAD,
+        _TRACE_PHASE_MAX,
+        _TRACE_PHASE_INVALID = -1,
+} TracePhase;
+
+typedef struct TraceEvent {
+        TracePhase phase;
+        char *subject;          /* the unit the work was done for, if any */
+        nsec_t start;           /* CLOCK_MONOTONIC */
+        nsec_t duration;
+} TraceEvent;
+
+typedef struct TraceRing {
+        TraceEvent *events;     /* allocated on first use */
+        uint64_t n_recorded;    /* total number of events, the next one goes to n_recorded % TRACE_RING_SIZE */
+} TraceRing;
+
+static inline nsec_t trace_now(void) {
+        return now_nsec(CLOCK_MONOTONIC);
+}
+
+/* Records a phase that started at the specified time and ends now */
+void trace_record(TraceRing *ring, TracePhase phase, const char *subject, nsec_t start);
+
+/* Records a phase that was measured elsewhere, for example by a child process */
+void trace_record_span(TraceRing *ring, TracePhase phase, const char *subject, nsec_t start, nsec_t duration);
+
+/* Iterates through the recorded events, oldest first */
+size_t trace_ring_size(const TraceRing *ring);
+const TraceEvent *trace_ring_get(const TraceRing *ring, size_t i);
+
+void trace_ring_done(TraceRing *ring);
+
+const char* trace_phase_to_string(TracePhase p) _const_;
+TracePhase trace_phase_from_string(const char *s) _pure_;
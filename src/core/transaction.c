@@ -280,40 +280,41 @@ static int transaction_merge_jobs(Transaction *tr, sd_bus_error *e) {
 }
 
 static void transaction_drop_redundant(Transaction *tr) {
-        bool again;
+        Iterator i;
+        Job *j;
 
         /* Goes through the transaction and removes all jobs of the units whose jobs are all noops. If not
-         * all of a unit's jobs are redundant, they are kept. */
+         * all of a unit's jobs are redundant, they are kept.
+         *
+         * Whether a unit's jobs are redundant doesn't depend on the other jobs in the transaction, and
+         * deleting jobs without their dependencies doesn't delete any other jobs, hence a single pass
+         * suffices. */
 
         assert(tr);
 
-        do {
-                Iterator i;
-                Job *j;
-
-                again = false;
-
-                HASHMAP_FOREACH(j, tr->jobs, i) {
-                        bool keep = false;
-                        Job *k;
-
-                        LIST_FOREACH(transaction, k, j)
-                                if (tr->anchor_job == k ||
-                                    !job_type_is_redundant(k->type, unit_active_state(k->unit)) ||
-                                    (k->unit->job && job_type_is_conflicting(k->type, k->unit->job->type))) {
-                                        keep = true;
-                                        break;
-                                }
+        HASHMAP_FOREACH(j, tr->jobs, i) {
+                bool keep = false;
+                Unit *u = j->unit;
+                Job *k;
 
-                        if (!keep) {
-                                log_trace("Found redundant job %s/%s, dropping from transaction.",
-                                          j->unit->id, job_type_to_string(j->type));
-                                transaction_delete_job(tr, j, false);
-                                again = true;
+                LIST_FOREACH(transaction, k, j)
+                        if (tr->anchor_job == k ||
+                            !job_type_is_redundant(k->type, unit_active_state(k->unit)) ||
+                            (k->unit->job && job_type_is_conflicting(k->type, k->unit->job->type))) {
+                                keep = true;
                                 break;
                         }
+
+                if (keep)
+                        continue;
+
+                /* This removes the current entry only, which is safe while iterating */
+                while ((k = hashmap_get(tr->jobs, u))) {
+                        log_trace("Found redundant job %s/%s, dropping from transaction.",
+                                  k->unit->id, job_type_to_string(k->type));
+                        transaction_delete_job(tr, k, false);
                 }
-        } while (again);
+        }
 }
 
 _pure_ static bool unit_matters_to_anchor(Unit *u, Job *j) {
@@ -350,9 +351,7 @@ static char* merge_unit_ids(const char* unit_log_field, char **pairs) {
 }
 
 static int transaction_verify_order_one(Transaction *tr, Job *j, Job *from, unsigned generation, sd_bus_error *e) {
-        Iterator i;
         Unit *u;
-        void *v;
         int r;
         static const UnitDependency directions[] = {
                 UNIT_BEFORE,
@@ -452,7 +451,7 @@ static int transaction_verify_order_one(Transaction *tr, Job *j, Job *from, unsi
          * ordering dependencies and we test with job_compare() whether it is the 'before' edge in the job
          * execution ordering. */
         for (d = 0; d < ELEMENTSOF(directions); d++) {
-                HASHMAP_FOREACH_KEY(v, u, j->unit->dependencies[directions[d]], i) {
+                UNIT_FOREACH_DEPENDENCY(u, j->unit, directions[d]) {
                         Job *o;
 
                         /* Is there a job for this unit? */
@@ -507,36 +506,69 @@ static int transaction_verify_order(Transaction *tr, unsigned *generation, sd_bu
 }
 
 static void transaction_collect_garbage(Transaction *tr) {
-        bool again;
+        _cleanup_set_free_ Set *todo = NULL;
+        Iterator i;
+        Job *j, *k;
 
         assert(tr);
 
-        /* Drop jobs that are not required by any other job */
+        /* Drop jobs that are not required by any other job.
+         *
+         * Deleting a job only makes a difference to the jobs it pulled in, hence we start with all jobs and
+         * only reconsider those afterwards. Since a job we delete has no object dependencies left, deleting
+         * it doesn't delete any other jobs. */
 
-        do {
-                Iterator i;
-                Job *j;
+        todo = set_new(NULL);
+        if (!todo)
+                goto fallback;
 
-                again = false;
+        HASHMAP_FOREACH(j, tr->jobs, i)
+                LIST_FOREACH(transaction, k, j)
+                        if (set_put(todo, k) < 0)
+                                goto fallback;
 
-                HASHMAP_FOREACH(j, tr->jobs, i) {
-                        if (tr->anchor_job == j)
-                                continue;
+        while ((j = set_steal_first(todo))) {
+                JobDependency *l;
 
-                        if (!j->object_list) {
-                                log_trace("Garbage collecting job %s/%s", j->unit->id, job_type_to_string(j->type));
-                                transaction_delete_job(tr, j, true);
-                                again = true;
-                                break;
-                        }
+                if (tr->anchor_job == j)
+                        continue;
 
+                if (j->object_list) {
                         log_trace("Keeping job %s/%s because of %s/%s",
                                   j->unit->id, job_type_to_string(j->type),
                                   j->object_list->subject ? j->object_list->subject->unit->id : "root",
                                   j->object_list->subject ? job_type_to_string(j->object_list->subject->type) : "root");
+                        continue;
                 }
 
-        } while (again);
+                LIST_FOREACH(subject, l, j->subject_list)
+                        if (set_put(todo, l->object) < 0)
+                                goto fallback;
+
+                log_trace("Garbage collecting job %s/%s", j->unit->id, job_type_to_string(j->type));
+                transaction_delete_job(tr, j, true);
+        }
+
+        return;
+
+fallback:
+        /* Out of memory, do it the slow way */
+        for (;;) {
+                bool again = false;
+
+                HASHMAP_FOREACH(j, tr->jobs, i) {
+                        if (tr->anchor_job == j || j->object_list)
+                                continue;
+
+                        log_trace("Garbage collecting job %s/%s", j->unit->id, job_type_to_string(j->type));
+                        transaction_delete_job(tr, j, true);
+                        again = true;
+                        break;
+                }
+
+                if (!again)
+                        break;
+        }
 }
 
 static int transaction_is_destructive(Transaction *tr, JobMode mode, sd_bus_error *e) {
@@ -565,44 +597,61 @@ static int transaction_is_destructive(Transaction *tr, JobMode mode, sd_bus_erro
         return 0;
 }
 
+static bool job_has_impact(Job *j) {
+        assert(j);
+
+        /* If it matters, we shouldn't drop it */
+        if (j->matters_to_anchor)
+                return false;
+
+        /* Would this stop a running service? Would this change an existing job? */
+        return (j->type == JOB_STOP && UNIT_IS_ACTIVE_OR_ACTIVATING(unit_active_state(j->unit))) ||
+                (j->unit->job && job_type_is_conflicting(j->type, j->unit->job->type));
+}
+
 static void transaction_minimize_impact(Transaction *tr) {
+        _cleanup_free_ Unit **units = NULL;
+        size_t n_units = 0, n_allocated = 0, k;
         Job *j;
         Iterator i;
 
         assert(tr);
 
         /* Drops all unnecessary jobs that reverse already active jobs
-         * or that stop a running service. */
+         * or that stop a running service.
+         *
+         * Whether a job is to be dropped doesn't depend on other jobs, but deleting one may delete others
+         * too, hence remember the units only, and look at their jobs when we get to them. */
 
-rescan:
         HASHMAP_FOREACH(j, tr->jobs, i) {
-                LIST_FOREACH(transaction, j, j) {
-                        bool stops_running_service, changes_existing_job;
-
-                        /* If it matters, we shouldn't drop it */
-                        if (j->matters_to_anchor)
-                                continue;
+                Job *l;
 
-                        /* Would this stop a running service?
-                         * Would this change an existing job?
-                         * If so, let's drop this entry */
+                LIST_FOREACH(transaction, l, j)
+                        if (job_has_impact(l))
+                                break;
+                if (!l)
+                        continue;
 
-                        stops_running_service =
-                                j->type == JOB_STOP && UNIT_IS_ACTIVE_OR_ACTIVATING(unit_active_state(j->unit));
+                if (!GREEDY_REALLOC(units, n_allocated, n_units + 1)) {
+                        log_oom();
+                        return;
+                }
 
-                        changes_existing_job =
-                                j->unit->job &&
-                                job_type_is_conflicting(j->type, j->unit->job->type);
+                units[n_units++] = j->unit;
+        }
 
-                        if (!stops_running_service && !changes_existing_job)
+        for (k = 0; k < n_units; k++) {
+        rescan:
+                LIST_FOREACH(transaction, j, (Job*) hashmap_get(tr->jobs, units[k])) {
+                        if (!job_has_impact(j))
                                 continue;
 
-                        if (stops_running_service)
+                        if (j->type == JOB_STOP && UNIT_IS_ACTIVE_OR_ACTIVATING(unit_active_state(j->unit)))
                                 log_unit_debug(j->unit,
                                                "%s/%s would stop a running service.",
                                                j->unit->id, job_type_to_string(j->type));
 
-                        if (changes_existing_job)
+                        if (j->unit->job && job_type_is_conflicting(j->type, j->unit->job->type))
                                 log_unit_debug(j->unit,
                                                "%s/%s would change existing job.",
                                                j->unit->id, job_type_to_string(j->type));
@@ -885,16 +934,14 @@ static void transaction_unlink_job(Transaction *tr, Job *j, bool delete_dependen
 }
 
 void transaction_add_propagate_reload_jobs(Transaction *tr, Unit *unit, Job *by, bool ignore_order, sd_bus_error *e) {
-        Iterator i;
         JobType nt;
         Unit *dep;
-        void *v;
         int r;
 
         assert(tr);
         assert(unit);
 
-        HASHMAP_FOREACH_KEY(v, dep, unit->dependencies[UNIT_PROPAGATES_RELOAD_TO], i) {
+        UNIT_FOREACH_DEPENDENCY(dep, unit, UNIT_PROPAGATES_RELOAD_TO) {
                 nt = job_type_collapse(JOB_TRY_RELOAD, dep);
                 if (nt == JOB_NOP)
                         continue;
@@ -924,7 +971,6 @@ int transaction_add_job_and_dependencies(
         Iterator i;
         Unit *dep;
         Job *ret;
-        void *v;
         int r;
 
         assert(tr);
@@ -997,7 +1043,7 @@ int transaction_add_job_and_dependencies(
 
                 /* Finally, recursively add in all dependencies. */
                 if (IN_SET(type, JOB_START, JOB_RESTART)) {
-                        HASHMAP_FOREACH_KEY(v, dep, ret->unit->dependencies[UNIT_REQUIRES], i) {
+                        UNIT_FOREACH_DEPENDENCY(dep, ret->unit, UNIT_REQUIRES) {
                                 r = transaction_add_job_and_dependencies(tr, JOB_START, dep, ret, true, false, false, ignore_order, e);
                                 if (r < 0) {
                                         if (r != -EBADR) /* job type not applicable */
@@ -1007,7 +1053,7 @@ int transaction_add_job_and_dependencies(
                                 }
                         }
 
-                        HASHMAP_FOREACH_KEY(v, dep, ret->unit->dependencies[UNIT_BINDS_TO], i) {
+                        UNIT_FOREACH_DEPENDENCY(dep, ret->unit, UNIT_BINDS_TO) {
                                 r = transaction_add_job_and_dependencies(tr, JOB_START, dep, ret, true, false, false, ignore_order, e);
                                 if (r < 0) {
                                         if (r != -EBADR) /* job type not applicable */
@@ -1017,7 +1063,7 @@ int transaction_add_job_and_dependencies(
                                 }
                         }
 
-                        HASHMAP_FOREACH_KEY(v, dep, ret->unit->dependencies[UNIT_WANTS], i) {
+                        UNIT_FOREACH_DEPENDENCY(dep, ret->unit, UNIT_WANTS) {
                                 r = transaction_add_job_and_dependencies(tr, JOB_START, dep, ret, false, false, false, ignore_order, e);
                                 if (r < 0) {
                                         /* unit masked, job type not applicable and unit not found are not considered as errors. */
@@ -1029,7 +1075,7 @@ int transaction_add_job_and_dependencies(
                                 }
                         }
 
-                        HASHMAP_FOREACH_KEY(v, dep, ret->unit->dependencies[UNIT_REQUISITE], i) {
+                        UNIT_FOREACH_DEPENDENCY(dep, ret->unit, UNIT_REQUISITE) {
                                 r = transaction_add_job_and_dependencies(tr, JOB_VERIFY_ACTIVE, dep, ret, true, false, false, ignore_order, e);
                                 if (r < 0) {
                                         if (r != -EBADR) /* job type not applicable */
@@ -1039,7 +1085,7 @@ int transaction_add_job_and_dependencies(
                                 }
                         }
 
-                        HASHMAP_FOREACH_KEY(v, dep, ret->unit->dependencies[UNIT_CONFLICTS], i) {
+                        UNIT_FOREACH_DEPENDENCY(dep, ret->unit, UNIT_CONFLICTS) {
                                 r = transaction_add_job_and_dependencies(tr, JOB_STOP, dep, ret, true, true, false, ignore_order, e);
                                 if (r < 0) {
                                         if (r != -EBADR) /* job type not applicable */
@@ -1049,7 +1095,7 @@ int transaction_add_job_and_dependencies(
                                 }
                         }
 
-                        HASHMAP_FOREACH_KEY(v, dep, ret->unit->dependencies[UNIT_CONFLICTED_BY], i) {
+                        UNIT_FOREACH_DEPENDENCY(dep, ret->unit, UNIT_CONFLICTED_BY) {
                                 r = transaction_add_job_and_dependencies(tr, JOB_STOP, dep, ret, false, false, false, ignore_order, e);
                                 if (r < 0) {
                                         log_unit_warning(dep,
@@ -1078,7 +1124,7 @@ int transaction_add_job_and_dependencies(
                         ptype = type == JOB_RESTART ? JOB_TRY_RESTART : type;
 
                         for (j = 0; j < ELEMENTSOF(propagate_deps); j++)
-                                HASHMAP_FOREACH_KEY(v, dep, ret->unit->dependencies[propagate_deps[j]], i) {
+                                UNIT_FOREACH_DEPENDENCY(dep, ret->unit, propagate_deps[j]) {
                                         JobType nt;
 
                                         nt = job_type_collapse(ptype, dep);
@@ -1142,15 +1188,13 @@ int transaction_add_isolate_jobs(Transaction *tr, Manager *m) {
 }
 
 int transaction_add_triggering_jobs(Transaction *tr, Unit *u) {
-        Iterator i;
-        void *v;
         Unit *trigger;
         int r;
 
         assert(tr);
         assert(u);
 
-        HASHMAP_FOREACH_KEY(v, trigger, u->dependencies[UNIT_TRIGGERED_BY], i) {
+        UNIT_FOREACH_DEPENDENCY(trigger, u, UNIT_TRIGGERED_BY) {
                 /* No need to stop inactive jobs */
                 if (UNIT_IS_INACTIVE_OR_FAILED(unit_active_state(trigger)) && !trigger->job)
                         continue;
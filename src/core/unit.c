@@ -115,10 +115,6 @@ Unit *unit_new(Manager *m, size_t size) {
 
         u->ip_accounting_ingress_map_fd = -1;
         u->ip_accounting_egress_map_fd = -1;
-        u->ipv4_allow_map_fd = -1;
-        u->ipv6_allow_map_fd = -1;
-        u->ipv4_deny_map_fd = -1;
-        u->ipv6_deny_map_fd = -1;
 
         u->last_section_private = -1;
 
@@ -414,6 +410,9 @@ void unit_add_to_load_queue(Unit *u) {
 
         LIST_PREPEND(load_queue, u->manager->load_queue, u);
         u->in_load_queue = true;
+
+        u->manager->n_load_queue++;
+        u->manager->n_load_queue_max = MAX(u->manager->n_load_queue_max, u->manager->n_load_queue);
 }
 
 void unit_add_to_cleanup_queue(Unit *u) {
@@ -454,6 +453,9 @@ void unit_add_to_dbus_queue(Unit *u) {
                 return;
         }
 
+        if (u->manager->dbus_signal_coalesce_usec > 0 && !u->manager->dbus_unit_queue)
+                u->manager->dbus_unit_queue_since = now(CLOCK_MONOTONIC);
+
         LIST_PREPEND(dbus_queue, u->manager->dbus_unit_queue, u);
         u->in_dbus_queue = true;
 }
@@ -474,25 +476,132 @@ void unit_submit_to_stop_when_unneeded_queue(Unit *u) {
         u->in_stop_when_unneeded_queue = true;
 }
 
-static void bidi_set_free(Unit *u, Hashmap *h) {
-        Unit *other;
-        Iterator i;
-        void *v;
+static unsigned unit_dependency_list_bisect(const UnitDependencyList *l, const Unit *other) {
+        unsigned a = 0, b = l->n_entries;
+
+        /* Returns the index of the first entry that isn't ordered before 'other' */
+
+        while (a < b) {
+                unsigned m = a + (b - a) / 2;
+
+                if ((uintptr_t) l->entries[m].unit < (uintptr_t) other)
+                        a = m + 1;
+                else
+                        b = m;
+        }
+
+        return a;
+}
+
+UnitDependencyEntry* unit_dependency_list_get(const UnitDependencyList *l, const Unit *other) {
+        unsigned k;
+
+        assert(l);
+        assert(other);
+
+        k = unit_dependency_list_bisect(l, other);
+        if (k >= l->n_entries || l->entries[k].unit != other)
+                return NULL;
+
+        return l->entries + k;
+}
+
+int unit_dependency_list_reserve(UnitDependencyList *l, unsigned n_add) {
+        UnitDependencyEntry *p;
+        unsigned n;
+
+        assert(l);
+
+        if (n_add > UINT_MAX - l->n_entries)
+                return -ENOMEM;
+
+        n = l->n_entries + n_add;
+        if (n <= l->n_allocated)
+                return 0;
+
+        /* Grow exponentially, but start small, as most lists only have a few entries */
+        if (l->n_allocated <= UINT_MAX / 2)
+                n = MAX(n, l->n_allocated * 2);
+
+        p = reallocarray(l->entries, n, sizeof(UnitDependencyEntry));
+        if (!p)
+                return -ENOMEM;
+
+        l->entries = p;
+        l->n_allocated = n;
+
+        return 0;
+}
+
+int unit_dependency_list_put(UnitDependencyList *l, Unit *other, UnitDependencyInfo info) {
+        unsigned k;
+        int r;
+
+        assert(l);
+        assert(other);
+
+        k = unit_dependency_list_bisect(l, other);
+        if (k < l->n_entries && l->entries[k].unit == other)
+                return -EEXIST;
+
+        r = unit_dependency_list_reserve(l, 1);
+        if (r < 0)
+                return r;
+
+        memmove(l->entries + k + 1, l->entries + k, (l->n_entries - k) * sizeof(UnitDependencyEntry));
+        l->entries[k] = (UnitDependencyEntry) {
+                .unit = other,
+                .info = info,
+        };
+        l->n_entries++;
+
+        return 0;
+}
+
+bool unit_dependency_list_remove(UnitDependencyList *l, const Unit *other) {
+        unsigned k;
+
+        assert(l);
+        assert(other);
+
+        /* Never shrinks the allocation, so that entries may be added again afterwards without failing */
+
+        k = unit_dependency_list_bisect(l, other);
+        if (k >= l->n_entries || l->entries[k].unit != other)
+                return false;
+
+        memmove(l->entries + k, l->entries + k + 1, (l->n_entries - k - 1) * sizeof(UnitDependencyEntry));
+        l->n_entries--;
+
+        return true;
+}
+
+void unit_dependency_list_free(UnitDependencyList *l) {
+        assert(l);
+
+        l->entries = mfree(l->entries);
+        l->n_entries = l->n_allocated = 0;
+}
+
+static void bidi_set_free(Unit *u, UnitDependencyList *l) {
+        unsigned i;
 
         assert(u);
+        assert(l);
 
-        /* Frees the hashmap and makes sure we are dropped from the inverse pointers */
+        /* Frees the list and makes sure we are dropped from the inverse pointers */
 
-        HASHMAP_FOREACH_KEY(v, other, h, i) {
+        for (i = 0; i < l->n_entries; i++) {
+                Unit *other = l->entries[i].unit;
                 UnitDependency d;
 
                 for (d = 0; d < _UNIT_DEPENDENCY_MAX; d++)
-                        hashmap_remove(other->dependencies[d], u);
+                        unit_dependency_list_remove(other->dependencies + d, u);
 
                 unit_add_to_gc_queue(other);
         }
 
-        hashmap_free(h);
+        unit_dependency_list_free(l);
 }
 
 static void unit_remove_transient(Unit *u) {
@@ -633,7 +742,7 @@ void unit_free(Unit *u) {
         }
 
         for (d = 0; d < _UNIT_DEPENDENCY_MAX; d++)
-                bidi_set_free(u, u->dependencies[d]);
+                bidi_set_free(u, u->dependencies + d);
 
         if (u->on_console)
                 manager_unref_console(u->manager);
@@ -657,8 +766,10 @@ void unit_free(Unit *u) {
         if (u->type != _UNIT_TYPE_INVALID)
                 LIST_REMOVE(units_by_type, u->manager->units_by_type[u->type], u);
 
-        if (u->in_load_queue)
+        if (u->in_load_queue) {
                 LIST_REMOVE(load_queue, u->manager->load_queue, u);
+                u->manager->n_load_queue--;
+        }
 
         if (u->in_dbus_queue)
                 LIST_REMOVE(dbus_queue, u->manager->dbus_unit_queue, u);
@@ -684,10 +795,10 @@ void unit_free(Unit *u) {
         safe_close(u->ip_accounting_ingress_map_fd);
         safe_close(u->ip_accounting_egress_map_fd);
 
-        safe_close(u->ipv4_allow_map_fd);
-        safe_close(u->ipv6_allow_map_fd);
-        safe_close(u->ipv4_deny_map_fd);
-        safe_close(u->ipv6_deny_map_fd);
+        bpf_firewall_map_unref(u->ipv4_allow_map);
+        bpf_firewall_map_unref(u->ipv6_allow_map);
+        bpf_firewall_map_unref(u->ipv4_deny_map);
+        bpf_firewall_map_unref(u->ipv6_deny_map);
 
         bpf_program_unref(u->ip_bpf_ingress);
         bpf_program_unref(u->ip_bpf_ingress_installed);
@@ -706,8 +817,8 @@ void unit_free(Unit *u) {
 
         free(u->description);
         strv_free(u->documentation);
-        free(u->fragment_path);
-        free(u->source_path);
+        (void) unit_set_fragment_path(u, NULL);
+        (void) unit_set_source_path(u, NULL);
         strv_free(u->dropin_paths);
         free(u->instance);
 
@@ -799,24 +910,23 @@ static int reserve_dependencies(Unit *u, Unit *other, UnitDependency d) {
         assert(d < _UNIT_DEPENDENCY_MAX);
 
         /*
-         * If u does not have this dependency set allocated, there is no need
-         * to reserve anything. In that case other's set will be transferred
-         * as a whole to u by complete_move().
+         * If u does not have any dependencies of this type, there is no need
+         * to reserve anything. In that case other's list will be transferred
+         * as a whole to u by merge_dependencies().
          */
-        if (!u->dependencies[d])
+        if (u->dependencies[d].n_entries == 0)
                 return 0;
 
         /* merge_dependencies() will skip a u-on-u dependency */
-        n_reserve = hashmap_size(other->dependencies[d]) - !!hashmap_get(other->dependencies[d], u);
+        n_reserve = other->dependencies[d].n_entries - unit_has_dependency(other, d, u);
 
-        return hashmap_reserve(u->dependencies[d], n_reserve);
+        return unit_dependency_list_reserve(u->dependencies + d, n_reserve);
 }
 
 static void merge_dependencies(Unit *u, Unit *other, const char *other_id, UnitDependency d) {
-        Iterator i;
+        UnitDependencyList *l;
         Unit *back;
-        void *v;
-        int r;
+        unsigned i;
 
         /* Merges all dependencies of type 'd' of the unit 'other' into the deps of the unit 'u' */
 
@@ -825,7 +935,7 @@ static void merge_dependencies(Unit *u, Unit *other, const char *other_id, UnitD
         assert(d < _UNIT_DEPENDENCY_MAX);
 
         /* Fix backwards pointers. Let's iterate through all dependent units of the other unit. */
-        HASHMAP_FOREACH_KEY(v, back, other->dependencies[d], i) {
+        UNIT_FOREACH_DEPENDENCY(back, other, d) {
                 UnitDependency k;
 
                 /* Let's now iterate through the dependencies of that dependencies of the other units, looking for
@@ -834,46 +944,57 @@ static void merge_dependencies(Unit *u, Unit *other, const char *other_id, UnitD
                 for (k = 0; k < _UNIT_DEPENDENCY_MAX; k++) {
                         if (back == u) {
                                 /* Do not add dependencies between u and itself. */
-                                if (hashmap_remove(back->dependencies[k], other))
+                                if (unit_dependency_list_remove(back->dependencies + k, other))
                                         maybe_warn_about_dependency(u, other_id, k);
                         } else {
-                                UnitDependencyInfo di_u, di_other, di_merged;
+                                UnitDependencyEntry *e_u, *e_other;
+                                UnitDependencyInfo di_other;
 
                                 /* Let's drop this dependency between "back" and "other", and let's create it between
                                  * "back" and "u" instead. Let's merge the bit masks of the dependency we are moving,
                                  * and any such dependency which might already exist */
 
-                                di_other.data = hashmap_get(back->dependencies[k], other);
-                                if (!di_other.data)
+                                e_other = unit_dependency_list_get(back->dependencies + k, other);
+                                if (!e_other)
                                         continue; /* dependency isn't set, let's try the next one */
 
-                                di_u.data = hashmap_get(back->dependencies[k], u);
-
-                                di_merged = (UnitDependencyInfo) {
-                                        .origin_mask = di_u.origin_mask | di_other.origin_mask,
-                                        .destination_mask = di_u.destination_mask | di_other.destination_mask,
-                                };
+                                di_other = e_other->info;
+                                assert_se(unit_dependency_list_remove(back->dependencies + k, other));
 
-                                r = hashmap_remove_and_replace(back->dependencies[k], other, u, di_merged.data);
-                                if (r < 0)
-                                        log_warning_errno(r, "Failed to remove/replace: back=%s other=%s u=%s: %m", back->id, other_id, u->id);
-                                assert(r >= 0);
-
-                                /* assert_se(hashmap_remove_and_replace(back->dependencies[k], other, u, di_merged.data) >= 0); */
+                                e_u = unit_dependency_list_get(back->dependencies + k, u);
+                                if (e_u) {
+                                        e_u->info.origin_mask |= di_other.origin_mask;
+                                        e_u->info.destination_mask |= di_other.destination_mask;
+                                } else
+                                        /* We just freed up an entry, hence this cannot fail */
+                                        assert_se(unit_dependency_list_put(back->dependencies + k, u, di_other) >= 0);
                         }
                 }
-
         }
 
         /* Also do not move dependencies on u to itself */
-        back = hashmap_remove(other->dependencies[d], u);
-        if (back)
+        if (unit_dependency_list_remove(other->dependencies + d, u))
                 maybe_warn_about_dependency(u, other_id, d);
 
-        /* The move cannot fail. The caller must have performed a reservation. */
-        assert_se(hashmap_complete_move(&u->dependencies[d], &other->dependencies[d]) == 0);
+        l = u->dependencies + d;
+        if (l->n_entries == 0) {
+                /* Nothing to merge, just take over the other unit's list */
+                unit_dependency_list_free(l);
+                *l = other->dependencies[d];
+                other->dependencies[d] = (UnitDependencyList) {};
+                return;
+        }
 
-        other->dependencies[d] = hashmap_free(other->dependencies[d]);
+        /* The move cannot fail. The caller must have performed a reservation. Entries that u already has are kept
+         * as they are. */
+        for (i = 0; i < other->dependencies[d].n_entries; i++) {
+                UnitDependencyEntry *e = other->dependencies[d].entries + i;
+
+                if (!unit_dependency_list_get(l, e->unit))
+                        assert_se(unit_dependency_list_put(l, e->unit, e->info) >= 0);
+        }
+
+        unit_dependency_list_free(other->dependencies + d);
 }
 
 int unit_merge(Unit *u, Unit *other) {
@@ -1291,16 +1412,16 @@ void unit_dump(Unit *u, FILE *f, const char *prefix) {
                         prefix, yes_no(u->assert_result));
 
         for (d = 0; d < _UNIT_DEPENDENCY_MAX; d++) {
-                UnitDependencyInfo di;
-                Unit *other;
+                unsigned k;
 
-                HASHMAP_FOREACH_KEY(di.data, other, u->dependencies[d], i) {
+                for (k = 0; k < u->dependencies[d].n_entries; k++) {
+                        const UnitDependencyEntry *e = u->dependencies[d].entries + k;
                         bool space = false;
 
-                        fprintf(f, "%s\t%s: %s (", prefix, unit_dependency_to_string(d), other->id);
+                        fprintf(f, "%s\t%s: %s (", prefix, unit_dependency_to_string(d), e->unit->id);
 
-                        print_unit_dependency_mask(f, "origin", di.origin_mask, &space);
-                        print_unit_dependency_mask(f, "destination", di.destination_mask, &space);
+                        print_unit_dependency_mask(f, "origin", e->info.origin_mask, &space);
+                        print_unit_dependency_mask(f, "destination", e->info.destination_mask, &space);
 
                         fputs(")\n", f);
                 }
@@ -1415,7 +1536,7 @@ int unit_add_default_target_dependency(Unit *u, Unit *target) {
                 return 0;
 
         /* Don't create loops */
-        if (hashmap_get(target->dependencies[UNIT_BEFORE], u))
+        if (unit_has_dependency(target, UNIT_BEFORE, u))
                 return 0;
 
         return unit_add_dependency(target, UNIT_AFTER, u, true, UNIT_DEPENDENCY_DEFAULT);
@@ -1520,6 +1641,7 @@ int unit_load(Unit *u) {
         if (u->in_load_queue) {
                 LIST_REMOVE(load_queue, u->manager->load_queue, u);
                 u->in_load_queue = false;
+                u->manager->n_load_queue--;
         }
 
         if (u->type == _UNIT_TYPE_INVALID)
@@ -1561,7 +1683,7 @@ int unit_load(Unit *u) {
                 if (r < 0)
                         goto fail;
 
-                if (u->on_failure_job_mode == JOB_ISOLATE && hashmap_size(u->dependencies[UNIT_ON_FAILURE]) > 1) {
+                if (u->on_failure_job_mode == JOB_ISOLATE && unit_dependency_count(u, UNIT_ON_FAILURE) > 1) {
                         log_unit_error(u, "More than one OnFailure= dependencies specified but OnFailureJobMode=isolate set. Refusing.");
                         r = -ENOEXEC;
                         goto fail;
@@ -1687,8 +1809,6 @@ bool unit_shall_confirm_spawn(Unit *u) {
 
 static bool unit_verify_deps(Unit *u) {
         Unit *other;
-        Iterator j;
-        void *v;
 
         assert(u);
 
@@ -1697,9 +1817,9 @@ static bool unit_verify_deps(Unit *u) {
          * processing, but do not have any effect afterwards. We don't check BindsTo= dependencies that are not used in
          * conjunction with After= as for them any such check would make things entirely racy. */
 
-        HASHMAP_FOREACH_KEY(v, other, u->dependencies[UNIT_BINDS_TO], j) {
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_BINDS_TO) {
 
-                if (!hashmap_contains(u->dependencies[UNIT_AFTER], other))
+                if (!unit_has_dependency(u, UNIT_AFTER, other))
                         continue;
 
                 if (!UNIT_IS_ACTIVE_OR_RELOADING(unit_active_state(other))) {
@@ -1907,7 +2027,7 @@ bool unit_can_reload(Unit *u) {
         if (UNIT_VTABLE(u)->can_reload)
                 return UNIT_VTABLE(u)->can_reload(u);
 
-        if (!hashmap_isempty(u->dependencies[UNIT_PROPAGATES_RELOAD_TO]))
+        if (unit_dependency_count(u, UNIT_PROPAGATES_RELOAD_TO) > 0)
                 return true;
 
         return UNIT_VTABLE(u)->reload;
@@ -1935,13 +2055,11 @@ bool unit_is_unneeded(Unit *u) {
 
         for (j = 0; j < ELEMENTSOF(deps); j++) {
                 Unit *other;
-                Iterator i;
-                void *v;
 
                 /* If a dependent unit has a job queued, is active or transitioning, or is marked for
                  * restart, then don't clean this one up. */
 
-                HASHMAP_FOREACH_KEY(v, other, u->dependencies[deps[j]], i) {
+                UNIT_FOREACH_DEPENDENCY(other, u, deps[j]) {
                         if (other->job)
                                 return false;
 
@@ -1972,10 +2090,8 @@ static void check_unneeded_dependencies(Unit *u) {
 
         for (j = 0; j < ELEMENTSOF(deps); j++) {
                 Unit *other;
-                Iterator i;
-                void *v;
 
-                HASHMAP_FOREACH_KEY(v, other, u->dependencies[deps[j]], i)
+                UNIT_FOREACH_DEPENDENCY(other, u, deps[j])
                         unit_submit_to_stop_when_unneeded_queue(other);
         }
 }
@@ -1984,8 +2100,6 @@ static void unit_check_binds_to(Unit *u) {
         _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
         bool stop = false;
         Unit *other;
-        Iterator i;
-        void *v;
         int r;
 
         assert(u);
@@ -1996,7 +2110,7 @@ static void unit_check_binds_to(Unit *u) {
         if (unit_active_state(u) != UNIT_ACTIVE)
                 return;
 
-        HASHMAP_FOREACH_KEY(v, other, u->dependencies[UNIT_BINDS_TO], i) {
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_BINDS_TO) {
                 if (other->job)
                         continue;
 
@@ -2032,65 +2146,59 @@ static void unit_check_binds_to(Unit *u) {
 }
 
 static void retroactively_start_dependencies(Unit *u) {
-        Iterator i;
         Unit *other;
-        void *v;
 
         assert(u);
         assert(UNIT_IS_ACTIVE_OR_ACTIVATING(unit_active_state(u)));
 
-        HASHMAP_FOREACH_KEY(v, other, u->dependencies[UNIT_REQUIRES], i)
-                if (!hashmap_get(u->dependencies[UNIT_AFTER], other) &&
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_REQUIRES)
+                if (!unit_has_dependency(u, UNIT_AFTER, other) &&
                     !UNIT_IS_ACTIVE_OR_ACTIVATING(unit_active_state(other)))
                         manager_add_job(u->manager, JOB_START, other, JOB_REPLACE, NULL, NULL, NULL);
 
-        HASHMAP_FOREACH_KEY(v, other, u->dependencies[UNIT_BINDS_TO], i)
-                if (!hashmap_get(u->dependencies[UNIT_AFTER], other) &&
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_BINDS_TO)
+                if (!unit_has_dependency(u, UNIT_AFTER, other) &&
                     !UNIT_IS_ACTIVE_OR_ACTIVATING(unit_active_state(other)))
                         manager_add_job(u->manager, JOB_START, other, JOB_REPLACE, NULL, NULL, NULL);
 
-        HASHMAP_FOREACH_KEY(v, other, u->dependencies[UNIT_WANTS], i)
-                if (!hashmap_get(u->dependencies[UNIT_AFTER], other) &&
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_WANTS)
+                if (!unit_has_dependency(u, UNIT_AFTER, other) &&
                     !UNIT_IS_ACTIVE_OR_ACTIVATING(unit_active_state(other)))
                         manager_add_job(u->manager, JOB_START, other, JOB_FAIL, NULL, NULL, NULL);
 
-        HASHMAP_FOREACH_KEY(v, other, u->dependencies[UNIT_CONFLICTS], i)
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_CONFLICTS)
                 if (!UNIT_IS_INACTIVE_OR_DEACTIVATING(unit_active_state(other)))
                         manager_add_job(u->manager, JOB_STOP, other, JOB_REPLACE, NULL, NULL, NULL);
 
-        HASHMAP_FOREACH_KEY(v, other, u->dependencies[UNIT_CONFLICTED_BY], i)
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_CONFLICTED_BY)
                 if (!UNIT_IS_INACTIVE_OR_DEACTIVATING(unit_active_state(other)))
                         manager_add_job(u->manager, JOB_STOP, other, JOB_REPLACE, NULL, NULL, NULL);
 }
 
 static void retroactively_stop_dependencies(Unit *u) {
         Unit *other;
-        Iterator i;
-        void *v;
 
         assert(u);
         assert(UNIT_IS_INACTIVE_OR_DEACTIVATING(unit_active_state(u)));
 
         /* Pull down units which are bound to us recursively if enabled */
-        HASHMAP_FOREACH_KEY(v, other, u->dependencies[UNIT_BOUND_BY], i)
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_BOUND_BY)
                 if (!UNIT_IS_INACTIVE_OR_DEACTIVATING(unit_active_state(other)))
                         manager_add_job(u->manager, JOB_STOP, other, JOB_REPLACE, NULL, NULL, NULL);
 }
 
 void unit_start_on_failure(Unit *u) {
         Unit *other;
-        Iterator i;
-        void *v;
         int r;
 
         assert(u);
 
-        if (hashmap_size(u->dependencies[UNIT_ON_FAILURE]) <= 0)
+        if (unit_dependency_count(u, UNIT_ON_FAILURE) <= 0)
                 return;
 
         log_unit_info(u, "Triggering OnFailure= dependencies.");
 
-        HASHMAP_FOREACH_KEY(v, other, u->dependencies[UNIT_ON_FAILURE], i) {
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_ON_FAILURE) {
                 _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
 
                 r = manager_add_job(u->manager, JOB_START, other, u->on_failure_job_mode, NULL, &error, NULL);
@@ -2101,12 +2209,10 @@ void unit_start_on_failure(Unit *u) {
 
 void unit_trigger_notify(Unit *u) {
         Unit *other;
-        Iterator i;
-        void *v;
 
         assert(u);
 
-        HASHMAP_FOREACH_KEY(v, other, u->dependencies[UNIT_TRIGGERED_BY], i)
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_TRIGGERED_BY)
                 if (UNIT_VTABLE(other)->trigger_notify)
                         UNIT_VTABLE(other)->trigger_notify(other, u);
 }
@@ -2842,49 +2948,39 @@ static void maybe_warn_about_dependency(Unit *u, const char *other, UnitDependen
                 log_unit_warning(u, "Dependency %s=%s dropped, merged into %s", unit_dependency_to_string(dependency), strna(other), u->id);
 }
 
-static int unit_add_dependency_hashmap(
-                Hashmap **h,
+static int unit_add_dependency_list(
+                UnitDependencyList *l,
                 Unit *other,
                 UnitDependencyMask origin_mask,
                 UnitDependencyMask destination_mask) {
 
-        UnitDependencyInfo info;
+        UnitDependencyEntry *e;
         int r;
 
-        assert(h);
+        assert(l);
         assert(other);
         assert(origin_mask < _UNIT_DEPENDENCY_MASK_FULL);
         assert(destination_mask < _UNIT_DEPENDENCY_MASK_FULL);
         assert(origin_mask > 0 || destination_mask > 0);
 
-        r = hashmap_ensure_allocated(h, NULL);
-        if (r < 0)
-                return r;
-
-        assert_cc(sizeof(void*) == sizeof(info));
-
-        info.data = hashmap_get(*h, other);
-        if (info.data) {
+        e = unit_dependency_list_get(l, other);
+        if (e) {
                 /* Entry already exists. Add in our mask. */
 
-                if (FLAGS_SET(origin_mask, info.origin_mask) &&
-                    FLAGS_SET(destination_mask, info.destination_mask))
+                if (FLAGS_SET(origin_mask, e->info.origin_mask) &&
+                    FLAGS_SET(destination_mask, e->info.destination_mask))
                         return 0; /* NOP */
 
-                info.origin_mask |= origin_mask;
-                info.destination_mask |= destination_mask;
-
-                r = hashmap_update(*h, other, info.data);
+                e->info.origin_mask |= origin_mask;
+                e->info.destination_mask |= destination_mask;
         } else {
-                info = (UnitDependencyInfo) {
-                        .origin_mask = origin_mask,
-                        .destination_mask = destination_mask,
-                };
-
-                r = hashmap_put(*h, other, info.data);
+                r = unit_dependency_list_put(l, other, (UnitDependencyInfo) {
+                                .origin_mask = origin_mask,
+                                .destination_mask = destination_mask,
+                        });
+                if (r < 0)
+                        return r;
         }
-        if (r < 0)
-                return r;
 
         return 1;
 }
@@ -2943,22 +3039,22 @@ int unit_add_dependency(
                 return 0;
         }
 
-        r = unit_add_dependency_hashmap(u->dependencies + d, other, mask, 0);
+        r = unit_add_dependency_list(u->dependencies + d, other, mask, 0);
         if (r < 0)
                 return r;
 
         if (inverse_table[d] != _UNIT_DEPENDENCY_INVALID && inverse_table[d] != d) {
-                r = unit_add_dependency_hashmap(other->dependencies + inverse_table[d], u, 0, mask);
+                r = unit_add_dependency_list(other->dependencies + inverse_table[d], u, 0, mask);
                 if (r < 0)
                         return r;
         }
 
         if (add_reference) {
-                r = unit_add_dependency_hashmap(u->dependencies + UNIT_REFERENCES, other, mask, 0);
+                r = unit_add_dependency_list(u->dependencies + UNIT_REFERENCES, other, mask, 0);
                 if (r < 0)
                         return r;
 
-                r = unit_add_dependency_hashmap(other->dependencies + UNIT_REFERENCED_BY, u, 0, mask);
+                r = unit_add_dependency_list(other->dependencies + UNIT_REFERENCED_BY, u, 0, mask);
                 if (r < 0)
                         return r;
         }
@@ -3417,6 +3513,7 @@ int unit_serialize(Unit *u, FILE *f, FDSet *fds, bool serialize_jobs) {
         (void) serialize_cgroup_mask(f, "cgroup-realized-mask", u->cgroup_realized_mask);
         (void) serialize_cgroup_mask(f, "cgroup-enabled-mask", u->cgroup_enabled_mask);
         (void) serialize_cgroup_mask(f, "cgroup-invalidated-mask", u->cgroup_invalidated_mask);
+        (void) unit_serialize_cgroup_attributes(u, f);
 
         if (uid_is_valid(u->ref_uid))
                 (void) serialize_item_format(f, "ref-uid", UID_FMT, u->ref_uid);
@@ -3489,7 +3586,7 @@ int unit_deserialize(Unit *u, FILE *f, FDSet *fds) {
                 ssize_t m;
                 size_t k;
 
-                r = read_line(f, LONG_LINE_MAX, &line);
+                r = deserialize_read_line(f, &line);
                 if (r < 0)
                         return log_error_errno(r, "Failed to read serialization line: %m");
                 if (r == 0) /* eof */
@@ -3693,6 +3790,13 @@ int unit_deserialize(Unit *u, FILE *f, FDSet *fds) {
                                 log_unit_debug(u, "Failed to parse cgroup-invalidated-mask %s, ignoring.", v);
                         continue;
 
+                } else if (streq(l, "cgroup-attribute")) {
+
+                        r = unit_deserialize_cgroup_attribute(u, v);
+                        if (r < 0)
+                                log_unit_debug_errno(u, r, "Failed to parse cgroup-attribute %s, ignoring: %m", v);
+                        continue;
+
                 } else if (streq(l, "ref-uid")) {
                         uid_t uid;
 
@@ -3816,7 +3920,7 @@ int unit_deserialize_skip(FILE *f) {
                 _cleanup_free_ char *line = NULL;
                 char *l;
 
-                r = read_line(f, LONG_LINE_MAX, &line);
+                r = deserialize_read_line(f, &line);
                 if (r < 0)
                         return log_error_errno(r, "Failed to read serialization line: %m");
                 if (r == 0)
@@ -4591,9 +4695,36 @@ int unit_write_settingf(Unit *u, UnitWriteFlags flags, const char *name, const c
         return unit_write_setting(u, flags, name, p);
 }
 
+static int unit_set_interned_string(Unit *u, char **field, const char *s) {
+        char *n = NULL;
+
+        assert(u);
+        assert(field);
+
+        if (s) {
+                n = manager_intern_string(u->manager, s);
+                if (!n)
+                        return -ENOMEM;
+        }
+
+        manager_unintern_string(u->manager, *field);
+        *field = n;
+
+        return 0;
+}
+
+int unit_set_fragment_path(Unit *u, const char *path) {
+        return unit_set_interned_string(u, &u->fragment_path, path);
+}
+
+int unit_set_source_path(Unit *u, const char *path) {
+        return unit_set_interned_string(u, &u->source_path, path);
+}
+
 int unit_make_transient(Unit *u) {
         _cleanup_free_ char *path = NULL;
         FILE *f;
+        int r;
 
         assert(u);
 
@@ -4618,9 +4749,11 @@ int unit_make_transient(Unit *u) {
         safe_fclose(u->transient_file);
         u->transient_file = f;
 
-        free_and_replace(u->fragment_path, path);
+        r = unit_set_fragment_path(u, path);
+        if (r < 0)
+                return r;
 
-        u->source_path = mfree(u->source_path);
+        (void) unit_set_source_path(u, NULL);
         u->dropin_paths = strv_free(u->dropin_paths);
         u->fragment_mtime = u->source_mtime = u->dropin_mtime = 0;
 
@@ -4882,8 +5015,6 @@ int unit_setup_exec_runtime(Unit *u) {
         ExecRuntime **rt;
         size_t offset;
         Unit *other;
-        Iterator i;
-        void *v;
         int r;
 
         offset = UNIT_VTABLE(u)->exec_runtime_offset;
@@ -4895,7 +5026,7 @@ int unit_setup_exec_runtime(Unit *u) {
                 return 0;
 
         /* Try to get it from somebody else */
-        HASHMAP_FOREACH_KEY(v, other, u->dependencies[UNIT_JOINS_NAMESPACE_OF], i) {
+        UNIT_FOREACH_DEPENDENCY(other, u, UNIT_JOINS_NAMESPACE_OF) {
                 r = exec_runtime_acquire(u->manager, NULL, other->id, false, rt);
                 if (r == 1)
                         return 1;
@@ -5304,19 +5435,25 @@ int unit_fork_and_watch_rm_rf(Unit *u, char **paths, pid_t *ret_pid) {
         return 0;
 }
 
-static void unit_update_dependency_mask(Unit *u, UnitDependency d, Unit *other, UnitDependencyInfo di) {
+static bool unit_update_dependency_mask(Unit *u, UnitDependency d, UnitDependencyEntry *e, UnitDependencyInfo di) {
+        Unit *other;
+
         assert(u);
         assert(d >= 0);
         assert(d < _UNIT_DEPENDENCY_MAX);
-        assert(other);
+        assert(e);
 
         if (di.origin_mask == 0 && di.destination_mask == 0) {
                 /* No bit set anymore, let's drop the whole entry */
-                assert_se(hashmap_remove(u->dependencies[d], other));
+                other = e->unit;
+                assert_se(unit_dependency_list_remove(u->dependencies + d, other));
                 log_unit_debug(u, "%s lost dependency %s=%s", u->id, unit_dependency_to_string(d), other->id);
-        } else
-                /* Mask was reduced, let's update the entry */
-                assert_se(hashmap_update(u->dependencies[d], other, di.data) == 0);
+                return true;
+        }
+
+        /* Mask was reduced, let's update the entry */
+        e->info = di;
+        return false;
 }
 
 void unit_remove_dependencies(Unit *u, UnitDependencyMask mask) {
@@ -5330,46 +5467,47 @@ void unit_remove_dependencies(Unit *u, UnitDependencyMask mask) {
                 return;
 
         for (d = 0; d < _UNIT_DEPENDENCY_MAX; d++) {
-                bool done;
-
-                do {
-                        UnitDependencyInfo di;
-                        Unit *other;
-                        Iterator i;
+                unsigned k = 0;
 
-                        done = true;
+                while (k < u->dependencies[d].n_entries) {
+                        UnitDependencyEntry *e = u->dependencies[d].entries + k;
+                        UnitDependencyInfo di = e->info;
+                        Unit *other = e->unit;
+                        UnitDependency q;
 
-                        HASHMAP_FOREACH_KEY(di.data, other, u->dependencies[d], i) {
-                                UnitDependency q;
-
-                                if ((di.origin_mask & ~mask) == di.origin_mask)
-                                        continue;
-                                di.origin_mask &= ~mask;
-                                unit_update_dependency_mask(u, d, other, di);
+                        if ((di.origin_mask & ~mask) == di.origin_mask) {
+                                k++;
+                                continue;
+                        }
+                        di.origin_mask &= ~mask;
 
-                                /* We updated the dependency from our unit to the other unit now. But most dependencies
-                                 * imply a reverse dependency. Hence, let's delete that one too. For that we go through
-                                 * all dependency types on the other unit and delete all those which point to us and
-                                 * have the right mask set. */
+                        /* If the entry is dropped, the next one moves into its place */
+                        if (!unit_update_dependency_mask(u, d, e, di))
+                                k++;
 
-                                for (q = 0; q < _UNIT_DEPENDENCY_MAX; q++) {
-                                        UnitDependencyInfo dj;
+                        /* We updated the dependency from our unit to the other unit now. But most dependencies
+                         * imply a reverse dependency. Hence, let's delete that one too. For that we go through
+                         * all dependency types on the other unit and delete all those which point to us and
+                         * have the right mask set. */
 
-                                        dj.data = hashmap_get(other->dependencies[q], u);
-                                        if ((dj.destination_mask & ~mask) == dj.destination_mask)
-                                                continue;
-                                        dj.destination_mask &= ~mask;
+                        for (q = 0; q < _UNIT_DEPENDENCY_MAX; q++) {
+                                UnitDependencyEntry *f;
+                                UnitDependencyInfo dj;
 
-                                        unit_update_dependency_mask(other, q, u, dj);
-                                }
+                                f = unit_dependency_list_get(other->dependencies + q, u);
+                                if (!f)
+                                        continue;
 
-                                unit_add_to_gc_queue(other);
+                                dj = f->info;
+                                if ((dj.destination_mask & ~mask) == dj.destination_mask)
+                                        continue;
+                                dj.destination_mask &= ~mask;
 
-                                done = false;
-                                break;
+                                (void) unit_update_dependency_mask(other, q, f, dj);
                         }
 
-                } while (!done);
+                        unit_add_to_gc_queue(other);
+                }
         }
 }
 
@@ -14,6 +14,7 @@
 #include "cgroup.h"
 
 typedef struct UnitRef UnitRef;
+typedef struct BPFFirewallMap BPFFirewallMap;
 
 typedef enum KillOperation {
         KILL_TERMINATE,
@@ -84,9 +85,9 @@ typedef enum UnitDependencyMask {
         _UNIT_DEPENDENCY_MASK_FULL         = (1 << 8) - 1,
 } UnitDependencyMask;
 
-/* The Unit's dependencies[] hashmaps use this structure as value. It has the same size as a void pointer, and thus can
- * be stored directly as hashmap value, without any indirection. Note that this stores two masks, as both the origin
- * and the destination of a dependency might have created it. */
+/* The Unit's dependencies[] lists and the requires_mounts_for hashmap use this structure as value. It has the same size
+ * as a void pointer, and thus can be stored directly as hashmap value, without any indirection. Note that this stores
+ * two masks, as both the origin and the destination of a dependency might have created it. */
 typedef union UnitDependencyInfo {
         void *data;
         struct {
@@ -95,6 +96,19 @@ typedef union UnitDependencyInfo {
         } _packed_;
 } UnitDependencyInfo;
 
+typedef struct UnitDependencyEntry {
+        Unit *unit;
+        UnitDependencyInfo info;
+} UnitDependencyEntry;
+
+/* An array of entries, sorted by the address of the other unit. Most units have only a handful of dependencies of each
+ * type, hence this is a lot more compact than a hashmap, and cheaper to iterate through. */
+typedef struct UnitDependencyList {
+        UnitDependencyEntry *entries;
+        unsigned n_entries;
+        unsigned n_allocated;
+} UnitDependencyList;
+
 #include "job.h"
 
 struct UnitRef {
@@ -118,9 +132,9 @@ typedef struct Unit {
 
         Set *names;
 
-        /* For each dependency type we maintain a Hashmap whose key is the Unit* object, and the value encodes why the
-         * dependency exists, using the UnitDependencyInfo type */
-        Hashmap *dependencies[_UNIT_DEPENDENCY_MAX];
+        /* For each dependency type we maintain a list of the other Unit* objects, together with the UnitDependencyInfo
+         * that encodes why the dependency exists */
+        UnitDependencyList dependencies[_UNIT_DEPENDENCY_MAX];
 
         /* Similar, for RequiresMountsFor= path dependencies. The key is the path, the value the UnitDependencyInfo type */
         Hashmap *requires_mounts_for;
@@ -128,6 +142,7 @@ typedef struct Unit {
         char *description;
         char **documentation;
 
+        /* Both paths are interned, use unit_set_fragment_path() and unit_set_source_path() to change them */
         char *fragment_path; /* if loaded from a config file this is the primary path to it */
         char *source_path; /* if converted, the source file */
         char **dropin_paths;
@@ -265,6 +280,11 @@ typedef struct Unit {
         CGroupMask cgroup_invalidated_mask;        /* A mask specifying controllers which shall be considered invalidated, and require re-realization */
         CGroupMask cgroup_members_mask;            /* A cache for the controllers required by all children of this cgroup (only relevant for slice units) */
 
+        /* The values we last wrote successfully to the cgroup attribute files, keyed by attribute name (plus the
+         * device for attributes that are keyed by device), so that we can skip writes that wouldn't change
+         * anything */
+        Hashmap *cgroup_attributes;
+
         /* Inotify watch descriptors for watching cgroup.events and memory.events on cgroupv2 */
         int cgroup_control_inotify_wd;
         int cgroup_memory_inotify_wd;
@@ -276,10 +296,10 @@ typedef struct Unit {
         int ip_accounting_ingress_map_fd;
         int ip_accounting_egress_map_fd;
 
-        int ipv4_allow_map_fd;
-        int ipv6_allow_map_fd;
-        int ipv4_deny_map_fd;
-        int ipv6_deny_map_fd;
+        BPFFirewallMap *ipv4_allow_map;
+        BPFFirewallMap *ipv6_allow_map;
+        BPFFirewallMap *ipv4_deny_map;
+        BPFFirewallMap *ipv6_deny_map;
 
         BPFProgram *ip_bpf_ingress, *ip_bpf_ingress_installed;
         BPFProgram *ip_bpf_egress, *ip_bpf_egress_installed;
@@ -359,6 +379,9 @@ typedef struct Unit {
         /* Did we already invoke unit_coldplug() for this unit? */
         bool coldplugged:1;
 
+        /* Did we already try to read the unit file ahead, see manager_prefetch_load_queue()? */
+        bool load_prefetched:1;
+
         /* For transient units: whether to add a bus track reference after creating the unit */
         bool bus_track_add:1;
 
@@ -634,8 +657,33 @@ static inline const UnitVTable* UNIT_VTABLE(Unit *u) {
 #define UNIT_HAS_CGROUP_CONTEXT(u) (UNIT_VTABLE(u)->cgroup_context_offset > 0)
 #define UNIT_HAS_KILL_CONTEXT(u) (UNIT_VTABLE(u)->kill_context_offset > 0)
 
+UnitDependencyEntry* unit_dependency_list_get(const UnitDependencyList *l, const Unit *other);
+int unit_dependency_list_reserve(UnitDependencyList *l, unsigned n_add);
+int unit_dependency_list_put(UnitDependencyList *l, Unit *other, UnitDependencyInfo info);
+bool unit_dependency_list_remove(UnitDependencyList *l, const Unit *other);
+void unit_dependency_list_free(UnitDependencyList *l);
+
+static inline unsigned unit_dependency_count(const Unit *u, UnitDependency d) {
+        return u->dependencies[d].n_entries;
+}
+
+static inline bool unit_has_dependency(const Unit *u, UnitDependency d, const Unit *other) {
+        return unit_dependency_list_get(u->dependencies + d, other);
+}
+
+/* Iterates through the units that 'u' has a dependency of type 'd' on. The dependencies of this type must not be
+ * modified from within the loop. */
+#define _UNIT_FOREACH_DEPENDENCY(other, u, d, idx)                      \
+        for (unsigned idx = 0;                                          \
+             idx < (u)->dependencies[d].n_entries &&                    \
+                     ((other) = (u)->dependencies[d].entries[idx].unit, true); \
+             idx++)
+
+#define UNIT_FOREACH_DEPENDENCY(other, u, d)                            \
+        _UNIT_FOREACH_DEPENDENCY(other, u, d, UNIQ_T(i, UNIQ))
+
 static inline Unit* UNIT_TRIGGER(Unit *u) {
-        return hashmap_first_key(u->dependencies[UNIT_TRIGGERS]);
+        return u->dependencies[UNIT_TRIGGERS].n_entries > 0 ? u->dependencies[UNIT_TRIGGERS].entries[0].unit : NULL;
 }
 
 Unit *unit_new(Manager *m, size_t size);
@@ -788,6 +836,9 @@ int unit_write_settingf(Unit *u, UnitWriteFlags mode, const char *name, const ch
 
 int unit_kill_context(Unit *u, KillContext *c, KillOperation k, pid_t main_pid, pid_t control_pid, bool main_pid_alien);
 
+int unit_set_fragment_path(Unit *u, const char *path);
+int unit_set_source_path(Unit *u, const char *path);
+
 int unit_make_transient(Unit *u);
 
 int unit_require_mounts_for(Unit *u, const char *path, UnitDependencyMask mask);
@@ -875,8 +926,10 @@ int unit_can_clean(Unit *u, ExecCleanMask *ret_mask);
 #define log_unit_full(unit, level, error, ...)                          \
         ({                                                              \
                 const Unit *_u = (unit);                                \
-                _u ? log_object_internal(level, error, PROJECT_FILE, __LINE__, __func__, _u->manager->unit_log_field, _u->id, _u->manager->invocation_log_field, _u->invocation_id_string, ##__VA_ARGS__) : \
-                        log_internal(level, error, PROJECT_FILE, __LINE__, __func__, ##__VA_ARGS__); \
+                int _level = (level), _e = (error);                     \
+                !log_level_enabled(_level) ? -ERRNO_VALUE(_e) :         \
+                _u ? log_object_internal(_level, _e, PROJECT_FILE, __LINE__, __func__, _u->manager->unit_log_field, _u->id, _u->manager->invocation_log_field, _u->invocation_id_string, ##__VA_ARGS__) : \
+                        log_internal(_level, _e, PROJECT_FILE, __LINE__, __func__, ##__VA_ARGS__); \
         })
 
 #define log_unit_debug(unit, ...)   log_unit_full(unit, LOG_DEBUG, 0, ##__VA_ARGS__)
@@ -22,7 +22,6 @@
 #include "cgroup-util.h"
 #include "compress.h"
 #include "conf-parser.h"
-#include "copy.h"
 #include "coredump-vacuum.h"
 #include "dirent-util.h"
 #include "escape.h"
@@ -283,6 +282,180 @@ static int fix_permissions(
         return 0;
 }
 
+/* The core is copied from the kernel's pipe in chunks of this size */
+#define COPY_BUFFER_SIZE (256U * 1024U)
+
+static int copy_core(int input_fd, int fd, int *compress_fd, uint64_t max_size) {
+        _cleanup_free_ uint8_t *buf = NULL;
+        uint64_t total = 0;
+        size_t ps;
+        bool truncated = false;
+        int r;
+
+        assert(input_fd >= 0);
+        assert(fd >= 0);
+        assert(compress_fd);
+
+        /* Copies the core from the kernel's pipe into fd. Pages that contain only zeros, which is what the
+         * kernel writes for memory that was mapped but never touched, are skipped over and hence remain
+         * holes. If *compress_fd is valid everything is also passed on to it as is. If that fails, it is
+         * closed and invalidated, so that the caller knows the compressed copy is incomplete.
+         *
+         * Returns 1 if the core was truncated to max_size, 0 otherwise. */
+
+        buf = malloc(COPY_BUFFER_SIZE);
+        if (!buf)
+                return -ENOMEM;
+
+        ps = page_size();
+
+        for (;;) {
+                size_t i, j;
+                ssize_t n;
+
+                if (total >= max_size) {
+                        truncated = true;
+                        break;
+                }
+
+                n = loop_read(input_fd, buf, (size_t) MIN((uint64_t) COPY_BUFFER_SIZE, max_size - total), true);
+                if (n < 0)
+                        return (int) n;
+                if (n == 0)
+                        break;
+
+                /* Write out the runs of non-zero pages, and seek over the zero ones */
+                for (i = 0; i < (size_t) n; i = j) {
+                        bool zero;
+
+                        zero = memeqzero(buf + i, MIN(ps, (size_t) n - i));
+                        for (j = i + ps; j < (size_t) n; j += ps)
+                                if (memeqzero(buf + j, MIN(ps, (size_t) n - j)) != zero)
+                                        break;
+                        j = MIN(j, (size_t) n);
+
+                        if (zero) {
+                                if (lseek(fd, j - i, SEEK_CUR) < 0)
+                                        return -errno;
+                        } else {
+                                r = loop_write(fd, buf + i, j - i, false);
+                                if (r < 0)
+                                        return r;
+                        }
+                }
+
+                if (*compress_fd >= 0) {
+                        r = loop_write(*compress_fd, buf, n, false);
+                        if (r < 0) {
+                                log_debug_errno(r, "Failed to pass coredump on to compressor, continuing without: %m");
+                                *compress_fd = safe_close(*compress_fd);
+                        }
+                }
+
+                total += n;
+        }
+
+        /* Make sure a hole at the end is part of the file, too */
+        if (ftruncate(fd, total) < 0)
+                return -errno;
+
+        return truncated;
+}
+
+typedef struct Compressor {
+        char *filename;  /* where the compressed core is linked to eventually */
+        char *tmp;       /* its temporary name, NULL if it is an O_TMPFILE */
+        int fd;
+        int pipe_fd;     /* the uncompressed core is written here */
+        pid_t pid;
+} Compressor;
+
+#define COMPRESSOR_NULL { .fd = -1, .pipe_fd = -1 }
+
+static void compressor_done(Compressor *c) {
+        assert(c);
+
+        c->pipe_fd = safe_close(c->pipe_fd);
+        if (c->pid > 0) {
+                sigkill_wait(c->pid);
+                c->pid = 0;
+        }
+
+        c->fd = safe_close(c->fd);
+        if (c->tmp)
+                (void) unlink(c->tmp);
+
+        c->tmp = mfree(c->tmp);
+        c->filename = mfree(c->filename);
+}
+
+static int compressor_start(Compressor *c, const char *fn) {
+        _cleanup_close_pair_ int pipefd[2] = { -1, -1 };
+        int r;
+
+        assert(c);
+        assert(fn);
+
+        /* Compresses the core in a separate process, while it is being stored, so that the compressed
+         * version is complete as soon as the uncompressed one, and we don't have to read the core back. */
+
+        c->filename = strjoin(fn, COMPRESSED_EXT);
+        if (!c->filename)
+                return log_oom();
+
+        c->fd = open_tmpfile_linkable(c->filename, O_RDWR|O_CLOEXEC, &c->tmp);
+        if (c->fd < 0)
+                return log_error_errno(c->fd, "Failed to create temporary file for coredump %s: %m", c->filename);
+
+        if (pipe2(pipefd, O_CLOEXEC) < 0)
+                return log_error_errno(errno, "Failed to create pipe for compressor: %m");
+
+        /* Let's get EPIPE rather than being killed if the compressor dies early */
+        (void) ignore_signals(SIGPIPE, -1);
+
+        r = safe_fork("(sd-compress)", FORK_DEATHSIG|FORK_LOG, &c->pid);
+        if (r < 0)
+                return r;
+        if (r == 0) {
+                /* Child */
+                pipefd[1] = safe_close(pipefd[1]);
+
+                r = compress_stream(pipefd[0], c->fd, (uint64_t) -1);
+                if (r < 0) {
+                        log_error_errno(r, "Failed to compress %s: %m", coredump_tmpfile_name(c->tmp));
+                        _exit(EXIT_FAILURE);
+                }
+
+                _exit(EXIT_SUCCESS);
+        }
+
+        c->pipe_fd = TAKE_FD(pipefd[1]);
+        return 0;
+}
+
+static int compressor_finish(Compressor *c) {
+        pid_t pid;
+        int r;
+
+        assert(c);
+
+        /* If passing on the data failed, the compressed core is incomplete */
+        if (c->pipe_fd < 0)
+                return -EPIPE;
+
+        /* Signal EOF, and wait until everything is written */
+        c->pipe_fd = safe_close(c->pipe_fd);
+
+        pid = TAKE_PID(c->pid);
+        r = wait_for_terminate_and_check("(sd-compress)", pid, 0);
+        if (r < 0)
+                return r;
+        if (r != EXIT_SUCCESS)
+                return -EPROTO;
+
+        return 0;
+}
+
 static int maybe_remove_external_coredump(const char *filename, uint64_t size) {
 
         /* Returns 1 if might remove, 0 if will not remove, < 0 on error. */
@@ -348,6 +521,7 @@ static int save_external_coredump(
                 uint64_t *ret_size,
                 bool *ret_truncated) {
 
+        _cleanup_(compressor_done) Compressor compressor = COMPRESSOR_NULL;
         _cleanup_free_ char *fn = NULL, *tmp = NULL;
         _cleanup_close_ int fd = -1;
         uint64_t rlimit, process_limit, max_size;
@@ -397,7 +571,15 @@ static int save_external_coredump(
         if (fd < 0)
                 return log_error_errno(fd, "Failed to create temporary file for coredump %s: %m", fn);
 
-        r = copy_bytes(input_fd, fd, max_size, 0);
+#if HAVE_XZ || HAVE_LZ4 || HAVE_ZSTD
+        /* Only bother compressing if we might keep the core. Whether it's small enough to be kept we only know
+         * after storing it though. */
+        if (arg_compress && arg_storage == COREDUMP_STORAGE_EXTERNAL)
+                if (compressor_start(&compressor, fn) < 0)
+                        compressor_done(&compressor);
+#endif
+
+        r = copy_core(input_fd, fd, &compressor.pipe_fd, max_size);
         if (r < 0) {
                 log_error_errno(r, "Cannot store coredump of %s (%s): %m",
                                 context->meta[META_ARGV_PID], context->meta[META_COMM]);
@@ -420,53 +602,36 @@ static int save_external_coredump(
                 goto fail;
         }
 
-#if HAVE_XZ || HAVE_LZ4
-        /* If we will remove the coredump anyway, do not compress. */
-        if (arg_compress && !maybe_remove_external_coredump(NULL, st.st_size)) {
+        /* If we will remove the coredump anyway, don't keep the compressed version either. */
+        if (compressor.fd >= 0 && !maybe_remove_external_coredump(NULL, st.st_size)) {
 
-                _cleanup_free_ char *fn_compressed = NULL, *tmp_compressed = NULL;
-                _cleanup_close_ int fd_compressed = -1;
-
-                fn_compressed = strjoin(fn, COMPRESSED_EXT);
-                if (!fn_compressed) {
-                        log_oom();
+                r = compressor_finish(&compressor);
+                if (r < 0) {
+                        log_error_errno(r, "Failed to compress %s: %m", coredump_tmpfile_name(compressor.tmp));
                         goto uncompressed;
                 }
 
-                fd_compressed = open_tmpfile_linkable(fn_compressed, O_RDWR|O_CLOEXEC, &tmp_compressed);
-                if (fd_compressed < 0) {
-                        log_error_errno(fd_compressed, "Failed to create temporary file for coredump %s: %m", fn_compressed);
+                r = fix_permissions(compressor.fd, compressor.tmp, compressor.filename, context, uid);
+                if (r < 0)
                         goto uncompressed;
-                }
-
-                r = compress_stream(fd, fd_compressed, -1);
-                if (r < 0) {
-                        log_error_errno(r, "Failed to compress %s: %m", coredump_tmpfile_name(tmp_compressed));
-                        goto fail_compressed;
-                }
 
-                r = fix_permissions(fd_compressed, tmp_compressed, fn_compressed, context, uid);
-                if (r < 0)
-                        goto fail_compressed;
+                /* It's linked into place now, don't remove it */
+                compressor.tmp = mfree(compressor.tmp);
 
                 /* OK, this worked, we can get rid of the uncompressed version now */
                 if (tmp)
                         unlink_noerrno(tmp);
 
-                *ret_filename = TAKE_PTR(fn_compressed);     /* compressed */
-                *ret_node_fd = TAKE_FD(fd_compressed);      /* compressed */
-                *ret_data_fd = TAKE_FD(fd);                 /* uncompressed */
+                *ret_filename = TAKE_PTR(compressor.filename); /* compressed */
+                *ret_node_fd = TAKE_FD(compressor.fd);        /* compressed */
+                *ret_data_fd = TAKE_FD(fd);                   /* uncompressed */
                 *ret_size = (uint64_t) st.st_size; /* uncompressed */
 
                 return 0;
-
-        fail_compressed:
-                if (tmp_compressed)
-                        (void) unlink(tmp_compressed);
         }
 
 uncompressed:
-#endif
+        compressor_done(&compressor);
 
         r = fix_permissions(fd, tmp, fn, context, uid);
         if (r < 0)
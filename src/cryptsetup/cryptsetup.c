@@ -1,7 +1,9 @@
 /* SPDX-License-Identifier: LGPL-2.1+ */
 
 #include <errno.h>
+#include <fcntl.h>
 #include <mntent.h>
+#include <sys/file.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -15,17 +17,22 @@
 #include "cryptsetup-pkcs11.h"
 #include "device-util.h"
 #include "escape.h"
+#include "fd-util.h"
 #include "fileio.h"
 #include "fstab-util.h"
 #include "hexdecoct.h"
+#include "limits-util.h"
 #include "log.h"
 #include "main-func.h"
+#include "mkdir.h"
 #include "mount-util.h"
 #include "nulstr-util.h"
 #include "parse-util.h"
 #include "path-util.h"
 #include "pkcs11-util.h"
 #include "pretty-print.h"
+#include "process-util.h"
+#include "stdio-util.h"
 #include "string-util.h"
 #include "strv.h"
 
@@ -35,6 +42,10 @@
 #define CRYPT_SECTOR_SIZE 512
 #define CRYPT_MAX_SECTOR_SIZE 4096
 
+/* Lock files limiting how many instances run memory hard key derivations at the same time */
+#define KDF_SLOTS_DIR "/run/systemd/cryptsetup/"
+#define KDF_SLOTS_MAX 64U
+
 static const char *arg_type = NULL; /* ANY_LUKS, CRYPT_LUKS1, CRYPT_LUKS2, CRYPT_TCRYPT or CRYPT_PLAIN */
 static char *arg_cipher = NULL;
 static unsigned arg_key_size = 0;
@@ -704,6 +715,108 @@ static int attach_luks_or_plain(
         return r;
 }
 
+static uint64_t kdf_memory(struct crypt_device *cd) {
+        struct crypt_pbkdf_type pbkdf;
+        const char *type;
+        uint64_t m = 0;
+        int slot, n;
+
+        assert(cd);
+
+        /* Returns the most memory unlocking any of the key slots we are going to try may take */
+
+        type = crypt_get_type(cd);
+        if (!type)
+                return 0;
+
+        n = crypt_keyslot_max(type);
+        for (slot = 0; slot < n; slot++) {
+                if (arg_key_slot != CRYPT_ANY_SLOT && slot != arg_key_slot)
+                        continue;
+
+                if (!IN_SET(crypt_keyslot_status(cd, slot), CRYPT_SLOT_ACTIVE, CRYPT_SLOT_ACTIVE_LAST))
+                        continue;
+
+                if (crypt_keyslot_get_pbkdf(cd, slot, &pbkdf) < 0)
+                        continue;
+
+                /* PBKDF2 needs no memory worth mentioning */
+                if (!pbkdf.type || !startswith_no_case(pbkdf.type, "argon2"))
+                        continue;
+
+                m = MAX(m, (uint64_t) pbkdf.max_memory_kb * 1024U);
+        }
+
+        return m;
+}
+
+static int acquire_kdf_slot(struct crypt_device *cd, const char *name) {
+        char path[STRLEN(KDF_SLOTS_DIR "kdf-") + DECIMAL_STR_MAX(unsigned) + STRLEN(".lock")];
+        _cleanup_close_ int fd = -1;
+        uint64_t m, n;
+        unsigned i;
+        int r;
+
+        assert(cd);
+        assert(name);
+
+        /* With one instance of us per volume, machines with many LUKS2 volumes run as many argon2 key
+         * derivations at once, each of which may allocate up to a GiB. Together they may well exceed the
+         * available memory, which is why libcryptsetup serializes them all by default. Instead, derive keys
+         * as many at a time as fit into half of the physical memory, holding one of that many lock files
+         * while doing so. Returns the locked fd, or -1 if the key slots do not need any noteworthy memory
+         * or locking failed, in which case libcryptsetup's serialization is kept. */
+
+        m = kdf_memory(cd);
+        if (m == 0)
+                return -1;
+
+        n = CLAMP(physical_memory() / 2 / m, 1U, KDF_SLOTS_MAX);
+
+        r = mkdir_p(KDF_SLOTS_DIR, 0700);
+        if (r < 0) {
+                log_debug_errno(r, "Failed to create %s, not limiting concurrent key derivations: %m", KDF_SLOTS_DIR);
+                return -1;
+        }
+
+        for (i = 0; i < n; i++) {
+                xsprintf(path, KDF_SLOTS_DIR "kdf-%u.lock", i);
+
+                fd = open(path, O_RDWR|O_CREAT|O_CLOEXEC|O_NOCTTY|O_NOFOLLOW, 0600);
+                if (fd < 0) {
+                        log_debug_errno(errno, "Failed to open %s, not limiting concurrent key derivations: %m", path);
+                        return -1;
+                }
+
+                if (flock(fd, LOCK_EX|LOCK_NB) >= 0)
+                        return TAKE_FD(fd);
+                if (errno != EWOULDBLOCK) {
+                        log_debug_errno(errno, "Failed to lock %s, not limiting concurrent key derivations: %m", path);
+                        return -1;
+                }
+
+                fd = safe_close(fd);
+        }
+
+        /* All slots are taken, queue up behind one of them. Spread the waiters evenly. */
+        xsprintf(path, KDF_SLOTS_DIR "kdf-%u.lock", (unsigned) (getpid_cached() % n));
+
+        fd = open(path, O_RDWR|O_CREAT|O_CLOEXEC|O_NOCTTY|O_NOFOLLOW, 0600);
+        if (fd < 0) {
+                log_debug_errno(errno, "Failed to open %s, not limiting concurrent key derivations: %m", path);
+                return -1;
+        }
+
+        log_info("Waiting for other volumes to finish key derivation before unlocking %s.", name);
+
+        if (flock(fd, LOCK_EX) < 0) {
+                log_debug_errno(errno, "Failed to lock %s, not limiting concurrent key derivations: %m", path);
+                return -1;
+        }
+
+        return TAKE_FD(fd);
+}
+
 static int help(void) {
         _cleanup_free_ char *link = NULL;
         int r;
@@ -856,6 +969,7 @@ static int run(int argc, char *argv[]) {
 
                 for (tries = 0; arg_tries == 0 || tries < arg_tries; tries++) {
                         _cleanup_strv_free_erase_ char **passwords = NULL;
+                        _cleanup_close_ int kdf_fd = -1;
 
                         if (!key_file && !arg_pkcs11_uri) {
                                 r = get_password(argv[2], argv[3], until, tries == 0 && !arg_verify, &passwords);
@@ -867,8 +981,23 @@ static int run(int argc, char *argv[]) {
 
                         if (streq_ptr(arg_type, CRYPT_TCRYPT))
                                 r = attach_tcrypt(cd, argv[2], key_file, passwords, flags);
-                        else
-                                r = attach_luks_or_plain(cd, argv[2], key_file, passwords, flags, until);
+                        else {
+                                /* Only taken once the password is known, so that nobody waits for us while
+                                 * we wait for the user. For the same reason not while we might still wait
+                                 * for a PKCS#11 token to be plugged in. */
+                                uint32_t attach_flags = flags;
+
+                                if (!arg_pkcs11_uri)
+                                        kdf_fd = acquire_kdf_slot(cd, argv[2]);
+#ifdef CRYPT_ACTIVATE_SERIALIZE_MEMORY_HARD_PBKDF
+                                /* We limit concurrency ourselves now, let libcryptsetup not serialize all
+                                 * key derivations across the system on top */
+                                if (kdf_fd >= 0)
+                                        attach_flags &= ~CRYPT_ACTIVATE_SERIALIZE_MEMORY_HARD_PBKDF;
+#endif
+
+                                r = attach_luks_or_plain(cd, argv[2], key_file, passwords, attach_flags, until);
+                        }
                         if (r >= 0)
                                 break;
                         if (r != -EAGAIN)
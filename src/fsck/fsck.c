@@ -19,10 +19,13 @@
 #include "bus-error.h"
 #include "bus-util.h"
 #include "device-util.h"
+#include "dirent-util.h"
 #include "fd-util.h"
+#include "fileio.h"
 #include "fs-util.h"
 #include "fsck-util.h"
 #include "main-func.h"
+#include "mkdir.h"
 #include "parse-util.h"
 #include "path-util.h"
 #include "proc-cmdline.h"
@@ -34,6 +37,10 @@
 #include "stdio-util.h"
 #include "util.h"
 
+/* Every instance publishes the progress of its check here, so that the one that owns the console can show
+ * the combined progress of all file systems checked in parallel */
+#define FSCK_PROGRESS_DIR "/run/systemd/fsck-progress"
+
 static bool arg_skip = false;
 static bool arg_force = false;
 static bool arg_show_progress = false;
@@ -155,8 +162,94 @@ static double percent(int pass, unsigned long cur, unsigned long max) {
                 (double) cur / (double) max;
 }
 
+static int publish_progress(const char *device, double p, char **published) {
+        char buf[DECIMAL_STR_MAX(unsigned) + 1];
+        int r;
+
+        assert(device);
+        assert(published);
+
+        if (!*published) {
+                _cleanup_free_ char *fn = NULL;
+
+                r = path_extract_filename(device, &fn);
+                if (r < 0)
+                        return r;
+
+                (void) mkdir_p(FSCK_PROGRESS_DIR, 0755);
+
+                *published = path_join(FSCK_PROGRESS_DIR, fn);
+                if (!*published)
+                        return -ENOMEM;
+        }
+
+        /* Stored in per-mille, so that reading it back is not locale dependent */
+        xsprintf(buf, "%u", (unsigned) (p * 10.0));
+
+        return write_string_file(*published, buf, WRITE_STRING_FILE_CREATE|WRITE_STRING_FILE_ATOMIC);
+}
+
+static int summarize_progress(unsigned *ret_n, double *ret_avg, char **ret_slowest, double *ret_min) {
+        _cleanup_closedir_ DIR *d = NULL;
+        _cleanup_free_ char *slowest = NULL;
+        double sum = 0.0, min = 100.0;
+        struct dirent *de;
+        unsigned n = 0;
+
+        d = opendir(FSCK_PROGRESS_DIR);
+        if (!d)
+                return -errno;
+
+        FOREACH_DIRENT(de, d, return -errno) {
+                _cleanup_free_ char *line = NULL;
+                const char *fn;
+                unsigned permille;
+
+                fn = strjoina(FSCK_PROGRESS_DIR "/", de->d_name);
+                if (read_one_line_file(fn, &line) < 0)
+                        continue;
+                if (safe_atou(line, &permille) < 0 || permille > 1000)
+                        continue;
+
+                n++;
+                sum += permille / 10.0;
+
+                if (!slowest || permille / 10.0 < min) {
+                        if (free_and_strdup(&slowest, de->d_name) < 0)
+                                return -ENOMEM;
+                        min = permille / 10.0;
+                }
+        }
+
+        if (n == 0)
+                return -ENOENT;
+
+        *ret_n = n;
+        *ret_avg = sum / n;
+        *ret_slowest = TAKE_PTR(slowest);
+        *ret_min = min;
+        return 0;
+}
+
+static int show_progress(FILE *console, const char *device, double p) {
+        _cleanup_free_ char *slowest = NULL;
+        double avg, min;
+        unsigned n;
+        int m;
+
+        if (summarize_progress(&n, &avg, &slowest, &min) >= 0 && n > 1)
+                fprintf(console, "\rfsck: %u file systems, %3.1f%% complete, %s at %3.1f%%...\r%n",
+                        n, avg, slowest, min, &m);
+        else
+                fprintf(console, "\r%s: fsck %3.1f%% complete...\r%n", device, p, &m);
+
+        fflush(console);
+        return m;
+}
+
 static int process_progress(int fd, FILE* console) {
         _cleanup_fclose_ FILE *f = NULL;
+        _cleanup_free_ char *published = NULL;
         usec_t last = 0;
         bool locked = false;
         int clear = 0, r;
@@ -190,14 +283,6 @@ static int process_progress(int fd, FILE* console) {
                         break;
                 }
 
-                /* Only show one progress counter at max */
-                if (!locked) {
-                        if (flock(fileno(console), LOCK_EX|LOCK_NB) < 0)
-                                continue;
-
-                        locked = true;
-                }
-
                 /* Only update once every 50ms */
                 t = now(CLOCK_MONOTONIC);
                 if (last + 50 * USEC_PER_MSEC > t)
@@ -206,8 +291,22 @@ static int process_progress(int fd, FILE* console) {
                 last = t;
 
                 p = percent(pass, cur, max);
-                fprintf(console, "\r%s: fsck %3.1f%% complete...\r%n", device, p, &m);
-                fflush(console);
+
+                r = publish_progress(device, p, &published);
+                if (r < 0)
+                        log_debug_errno(r, "Failed to publish fsck progress, ignoring: %m");
+
+                /* Only show one progress counter at max. When file systems on several disks are checked in
+                 * parallel, the instance that owns the console shows the combined progress of all of them;
+                 * once it finishes, another instance takes over. */
+                if (!locked) {
+                        if (flock(fileno(console), LOCK_EX|LOCK_NB) < 0)
+                                continue;
+
+                        locked = true;
+                }
+
+                m = show_progress(console, device, p);
 
                 if (m > clear)
                         clear = m;
@@ -223,6 +322,9 @@ static int process_progress(int fd, FILE* console) {
                 fflush(console);
         }
 
+        if (published)
+                (void) unlink(published);
+
         return r;
 }
 
@@ -4,27 +4,122 @@
 #include "log.h"
 #include "fileio.h"
 #include "fuzz.h"
+#include "parse-util.h"
+#include "string-util.h"
 #include "tests.h"
+#include "time-util.h"
 
 /* This is a test driver for the systemd fuzzers that provides main function
  * for regression testing outside of oss-fuzz (https://github.com/google/oss-fuzz)
  *
  * It reads files named on the command line and passes them one by one into the
- * fuzzer that it is compiled into. */
+ * fuzzer that it is compiled into.
+ *
+ * With --benchmark=N as first argument every input is instead passed N times,
+ * and the time and memory allocations each pass took are reported. */
 
 /* This one was borrowed from
  * https://github.com/google/oss-fuzz/blob/646fca1b506b056db3a60d32c4a1a7398f171c94/infra/base-images/base-runner/bad_build_check#L19
  */
 #define MIN_NUMBER_OF_RUNS 4
 
+/* Count allocations by interposing glibc's allocator. Sanitizers bring their own, leave them alone. */
+#if defined(__GLIBC__) && !HAS_FEATURE_ADDRESS_SANITIZER && !HAS_FEATURE_MEMORY_SANITIZER
+#  define COUNT_ALLOCATIONS 1
+
+static bool count_allocations = false;
+static uint64_t n_allocations = 0, n_allocated_bytes = 0;
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *p, size_t size);
+
+void *malloc(size_t size) {
+        if (count_allocations) {
+                n_allocations++;
+                n_allocated_bytes += size;
+        }
+
+        return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size) {
+        if (count_allocations) {
+                n_allocations++;
+                n_allocated_bytes += nmemb * size;
+        }
+
+        return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *p, size_t size) {
+        if (count_allocations) {
+                n_allocations++;
+                n_allocated_bytes += size;
+        }
+
+        return __libc_realloc(p, size);
+}
+#else
+#  define COUNT_ALLOCATIONS 0
+#endif
+
+static int benchmark_one(const char *name, const uint8_t *buf, size_t size, unsigned runs) {
+        nsec_t total = 0, fastest = NSEC_INFINITY;
+        unsigned j;
+
+        for (j = 0; j < runs; j++) {
+                nsec_t t;
+
+                t = now_nsec(CLOCK_MONOTONIC);
+#if COUNT_ALLOCATIONS
+                count_allocations = true;
+#endif
+                if (LLVMFuzzerTestOneInput(buf, size) == EXIT_TEST_SKIP)
+                        return EXIT_TEST_SKIP;
+#if COUNT_ALLOCATIONS
+                count_allocations = false;
+#endif
+                t = now_nsec(CLOCK_MONOTONIC) - t;
+
+                total += t;
+                fastest = MIN(fastest, t);
+        }
+
+        printf("%s: %zu bytes, %u runs, %"PRIu64" ns/run (fastest %"PRIu64" ns)",
+               name, size, runs, total / runs, fastest);
+#if COUNT_ALLOCATIONS
+        printf(", %"PRIu64" allocations/run, %"PRIu64" bytes allocated/run",
+               n_allocations / runs, n_allocated_bytes / runs);
+        n_allocations = n_allocated_bytes = 0;
+#endif
+        printf("\n");
+
+        return 0;
+}
+
 int main(int argc, char **argv) {
-        int i, r;
+        unsigned benchmark_runs = 0;
+        const char *e;
+        int i = 1, r;
         size_t size;
         char *name;
 
         test_setup_logging(LOG_DEBUG);
 
-        for (i = 1; i < argc; i++) {
+        if (argc > 1 && (e = startswith(argv[1], "--benchmark="))) {
+                r = safe_atou(e, &benchmark_runs);
+                if (r < 0 || benchmark_runs == 0) {
+                        log_error("Invalid number of benchmark runs: %s", e);
+                        return EXIT_FAILURE;
+                }
+
+                /* Logging would dominate what we measure */
+                log_set_max_level(LOG_CRIT);
+                i++;
+        }
+
+        for (; i < argc; i++) {
                 _cleanup_free_ char *buf = NULL;
 
                 name = argv[i];
@@ -33,6 +128,17 @@ int main(int argc, char **argv) {
                         log_error_errno(r, "Failed to open '%s': %m", name);
                         return EXIT_FAILURE;
                 }
+
+                if (benchmark_runs > 0) {
+                        /* One pass first, so that one-time initialization is not measured */
+                        if (LLVMFuzzerTestOneInput((uint8_t*)buf, size) == EXIT_TEST_SKIP)
+                                return EXIT_TEST_SKIP;
+
+                        if (benchmark_one(name, (uint8_t*)buf, size, benchmark_runs) == EXIT_TEST_SKIP)
+                                return EXIT_TEST_SKIP;
+                        continue;
+                }
+
                 printf("%s... ", name);
                 fflush(stdout);
                 for (int j = 0; j < MIN_NUMBER_OF_RUNS; j++)
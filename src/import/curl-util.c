@@ -15,15 +15,15 @@ static void curl_glue_check_finished(CurlGlue *g) {
 
         assert(g);
 
-        msg = curl_multi_info_read(g->curl, &k);
-        if (!msg)
-                return;
+        /* Several transfers might have finished at once, handle all of them */
+        while ((msg = curl_multi_info_read(g->curl, &k))) {
 
-        if (msg->msg != CURLMSG_DONE)
-                return;
+                if (msg->msg != CURLMSG_DONE)
+                        continue;
 
-        if (g->on_finished)
-                g->on_finished(g, msg->easy_handle, msg->data.result);
+                if (g->on_finished)
+                        g->on_finished(g, msg->easy_handle, msg->data.result);
+        }
 }
 
 static int curl_glue_on_io(sd_event_source *s, int fd, uint32_t revents, void *userdata) {
@@ -10,13 +10,21 @@
 #include "export-raw.h"
 #include "export-tar.h"
 #include "fd-util.h"
+#include "fileio.h"
 #include "fs-util.h"
 #include "hostname-util.h"
+#include "import-chunk.h"
+#include "import-compress.h"
 #include "import-util.h"
 #include "machine-image.h"
 #include "main-func.h"
+#include "memory-util.h"
+#include "mkdir.h"
+#include "path-util.h"
 #include "signal-util.h"
+#include "stat-util.h"
 #include "string-util.h"
+#include "tmpfile-util.h"
 #include "verbs.h"
 
 static ImportCompressType arg_compress = IMPORT_COMPRESS_UNKNOWN;
@@ -37,6 +45,8 @@ static void determine_compression_from_filename(const char *p) {
                 arg_compress = IMPORT_COMPRESS_GZIP;
         else if (endswith(p, ".bz2"))
                 arg_compress = IMPORT_COMPRESS_BZIP2;
+        else if (endswith(p, ".zst"))
+                arg_compress = IMPORT_COMPRESS_ZSTD;
         else
                 arg_compress = IMPORT_COMPRESS_UNCOMPRESSED;
 }
@@ -199,6 +209,140 @@ static int export_raw(int argc, char *argv[], void *userdata) {
         return -r;
 }
 
+typedef struct ChunkExport {
+        const char *store;
+        FILE *index;
+        uint64_t n_chunks;
+        uint64_t n_written;
+} ChunkExport;
+
+static int export_chunk(const void *data, size_t size, const char *id, void *userdata) {
+        _cleanup_(import_compress_free) ImportCompress c = {};
+        _cleanup_free_ void *buffer = NULL, *compressed = NULL;
+        size_t buffer_size = 0, buffer_allocated = 0, compressed_size = 0, compressed_allocated = 0;
+        ChunkExport *e = userdata;
+        unsigned k;
+        int r;
+
+        assert(e);
+
+        fprintf(e->index, "%s %zu\n", id, size);
+        e->n_chunks++;
+
+        r = chunk_store_has(e->store, id);
+        if (r < 0)
+                return log_error_errno(r, "Failed to check for chunk %s: %m", id);
+        if (r > 0)
+                return 0;
+
+        /* The chunk is named after its uncompressed contents, the puller detects the compression itself */
+        r = import_compress_init(&c, arg_compress);
+        if (r < 0)
+                return log_error_errno(r, "Failed to initialize compressor: %m");
+
+        for (k = 0; k < 2; k++) {
+                if (k == 0)
+                        r = import_compress(&c, data, size, &buffer, &buffer_size, &buffer_allocated);
+                else
+                        r = import_compress_finish(&c, &buffer, &buffer_size, &buffer_allocated);
+                if (r < 0)
+                        return log_error_errno(r, "Failed to compress chunk %s: %m", id);
+
+                if (!GREEDY_REALLOC(compressed, compressed_allocated, compressed_size + buffer_size))
+                        return log_oom();
+
+                memcpy_safe((uint8_t*) compressed + compressed_size, buffer, buffer_size);
+                compressed_size += buffer_size;
+        }
+
+        r = chunk_store_put(e->store, id, compressed, compressed_size);
+        if (r < 0)
+                return log_error_errno(r, "Failed to write chunk %s: %m", id);
+
+        e->n_written++;
+        return 0;
+}
+
+static int export_chunked(int argc, char *argv[], void *userdata) {
+        _cleanup_(image_unrefp) Image *image = NULL;
+        _cleanup_free_ char *index_path = NULL, *temp_path = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        _cleanup_close_ int fd = -1;
+        const char *local, *store;
+        ChunkExport e = {};
+        int r;
+
+        if (machine_name_is_valid(argv[1])) {
+                r = image_find(IMAGE_MACHINE, argv[1], &image);
+                if (r == -ENOENT)
+                        return log_error_errno(r, "Machine image %s not found.", argv[1]);
+                if (r < 0)
+                        return log_error_errno(r, "Failed to look for machine %s: %m", argv[1]);
+                if (image->type != IMAGE_RAW)
+                        return log_error_errno(SYNTHETIC_ERRNO(EMEDIUMTYPE), "Machine image %s is not a raw image.", argv[1]);
+
+                local = image->path;
+        } else
+                local = argv[1];
+
+        determine_compression_from_filename(NULL);
+
+        fd = open(local, O_RDONLY|O_CLOEXEC|O_NOCTTY);
+        if (fd < 0)
+                return log_error_errno(errno, "Failed to open raw image %s: %m", local);
+
+        r = fd_verify_regular(fd);
+        if (r < 0)
+                return log_error_errno(r, "Raw image %s is not a regular file: %m", local);
+
+        store = strjoina(argv[2], "/chunks");
+
+        r = mkdir_p(store, 0755);
+        if (r < 0)
+                return log_error_errno(r, "Failed to create chunk directory %s: %m", store);
+
+        index_path = path_join(argv[2], strjoina(basename(local), ".chunks"));
+        if (!index_path)
+                return log_oom();
+
+        r = fopen_temporary(index_path, &f, &temp_path);
+        if (r < 0)
+                return log_error_errno(r, "Failed to create chunk index %s: %m", index_path);
+
+        (void) fchmod(fileno(f), 0644);
+
+        log_info("Exporting '%s' as chunks to '%s', with compression '%s'.", local, argv[2], import_compress_type_to_string(arg_compress));
+
+        e = (ChunkExport) {
+                .store = store,
+                .index = f,
+        };
+
+        r = chunk_split_fd(fd, export_chunk, &e);
+        if (r < 0) {
+                log_error_errno(r, "Failed to export image as chunks: %m");
+                goto fail;
+        }
+
+        r = fflush_and_check(f);
+        if (r < 0) {
+                log_error_errno(r, "Failed to write chunk index %s: %m", index_path);
+                goto fail;
+        }
+
+        if (rename(temp_path, index_path) < 0) {
+                r = log_error_errno(errno, "Failed to move chunk index into place: %m");
+                goto fail;
+        }
+
+        log_info("Wrote index %s with %" PRIu64 " chunks, %" PRIu64 " of them new.", index_path, e.n_chunks, e.n_written);
+        return 0;
+
+fail:
+        (void) unlink(temp_path);
+        return r;
+}
+
 static int help(int argc, char *argv[], void *userdata) {
 
         printf("%s [OPTIONS...] {COMMAND} ...\n\n"
@@ -208,7 +352,8 @@ static int help(int argc, char *argv[], void *userdata) {
                "     --format=FORMAT           Select format\n\n"
                "Commands:\n"
                "  tar NAME [FILE]              Export a TAR image\n"
-               "  raw NAME [FILE]              Export a RAW image\n",
+               "  raw NAME [FILE]              Export a RAW image\n"
+               "  chunked NAME DIRECTORY       Export a RAW image as chunks\n",
                program_invocation_short_name);
 
         return 0;
@@ -252,6 +397,8 @@ static int parse_argv(int argc, char *argv[]) {
                                 arg_compress = IMPORT_COMPRESS_GZIP;
                         else if (streq(optarg, "bzip2"))
                                 arg_compress = IMPORT_COMPRESS_BZIP2;
+                        else if (streq(optarg, "zstd"))
+                                arg_compress = IMPORT_COMPRESS_ZSTD;
                         else
                                 return log_error_errno(SYNTHETIC_ERRNO(EINVAL),
                                                        "Unknown format: %s", optarg);
@@ -269,9 +416,10 @@ static int parse_argv(int argc, char *argv[]) {
 
 static int export_main(int argc, char *argv[]) {
         static const Verb verbs[] = {
-                { "help", VERB_ANY, VERB_ANY, 0, help       },
-                { "tar",  2,        3,        0, export_tar },
-                { "raw",  2,        3,        0, export_raw },
+                { "help",    VERB_ANY, VERB_ANY, 0, help           },
+                { "tar",     2,        3,        0, export_tar     },
+                { "raw",     2,        3,        0, export_raw     },
+                { "chunked", 3,        3,        0, export_chunked },
                 {}
         };
 
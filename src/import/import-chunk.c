@@ -0,0 +1,320 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "alloc-util.h"
+#include "btrfs-util.h"
+#include "copy.h"
+#include "fd-util.h"
+#include "gcrypt-util.h"
+#include "hexdecoct.h"
+#include "import-chunk.h"
+#include "io-util.h"
+#include "parse-util.h"
+#include "string-util.h"
+#include "tmpfile-util.h"
+
+/* The number of bytes the rolling hash covers */
+#define CHUNK_WINDOW 48U
+
+static uint32_t chunk_table[256];
+
+static inline uint32_t rol32(uint32_t x, unsigned n) {
+        n %= 32;
+        return n == 0 ? x : (x << n) | (x >> (32 - n));
+}
+
+static void chunk_table_init(void) {
+        static bool initialized = false;
+        uint32_t x = 0x6a09e667U;
+        size_t i;
+
+        if (initialized)
+                return;
+
+        /* The table must be the same everywhere, since it determines where chunk boundaries are placed,
+         * hence fill it from a fixed seed */
+        for (i = 0; i < ELEMENTSOF(chunk_table); i++) {
+                x ^= x << 13;
+                x ^= x >> 17;
+                x ^= x << 5;
+                chunk_table[i] = x;
+        }
+
+        initialized = true;
+}
+
+static size_t chunk_find_boundary(const uint8_t *p, size_t n) {
+        uint32_t h = 0;
+        size_t i, end;
+
+        /* Boundaries are never placed before CHUNK_SIZE_MIN, hence start hashing one window before that.
+         * Once the window is full the hash only depends on the bytes in it, so this gives the same
+         * boundaries as hashing from the start of the chunk. After the minimum, a boundary follows on
+         * average every CHUNK_SIZE_AVG bytes. */
+
+        if (n <= CHUNK_SIZE_MIN)
+                return n;
+
+        end = MIN(n, (size_t) CHUNK_SIZE_MAX);
+
+        for (i = CHUNK_SIZE_MIN - CHUNK_WINDOW; i < CHUNK_SIZE_MIN; i++)
+                h = rol32(h, 1) ^ chunk_table[p[i]];
+
+        for (; i < end; i++) {
+                if ((h & (CHUNK_SIZE_AVG - 1)) == 0)
+                        return i;
+
+                h = rol32(h, 1) ^ rol32(chunk_table[p[i - CHUNK_WINDOW]], CHUNK_WINDOW) ^ chunk_table[p[i]];
+        }
+
+        return end;
+}
+
+int chunk_make_id(const void *data, size_t size, char ret[static CHUNK_ID_LENGTH + 1]) {
+        uint8_t h[CHUNK_ID_LENGTH / 2];
+        size_t i;
+
+        assert(data || size == 0);
+        assert(ret);
+
+        initialize_libgcrypt(false);
+
+        assert(gcry_md_get_algo_dlen(GCRY_MD_SHA256) == sizeof(h));
+        gcry_md_hash_buffer(GCRY_MD_SHA256, h, data, size);
+
+        for (i = 0; i < sizeof(h); i++) {
+                ret[i * 2] = hexchar(h[i] >> 4);
+                ret[i * 2 + 1] = hexchar(h[i] & 15);
+        }
+        ret[CHUNK_ID_LENGTH] = 0;
+
+        return 0;
+}
+
+bool chunk_id_is_valid(const char *id) {
+        if (!id)
+                return false;
+
+        return strlen(id) == CHUNK_ID_LENGTH && in_charset(id, "0123456789abcdef");
+}
+
+int chunk_split_fd(int fd, ChunkCallback callback, void *userdata) {
+        _cleanup_free_ uint8_t *buf = NULL;
+        bool eof = false;
+        size_t n = 0;
+        int r;
+
+        assert(fd >= 0);
+        assert(callback);
+
+        chunk_table_init();
+
+        buf = malloc(CHUNK_SIZE_MAX);
+        if (!buf)
+                return -ENOMEM;
+
+        for (;;) {
+                char id[CHUNK_ID_LENGTH + 1];
+                size_t k;
+
+                /* Keep the buffer filled up to the maximum chunk size, so that a boundary is always found
+                 * in it, unless we hit the end of the file */
+                if (!eof && n < CHUNK_SIZE_MAX) {
+                        ssize_t l;
+
+                        l = loop_read(fd, buf + n, CHUNK_SIZE_MAX - n, true);
+                        if (l < 0)
+                                return (int) l;
+                        if ((size_t) l < CHUNK_SIZE_MAX - n)
+                                eof = true;
+
+                        n += l;
+                }
+
+                if (n == 0)
+                        return 0;
+
+                k = chunk_find_boundary(buf, n);
+
+                r = chunk_make_id(buf, k, id);
+                if (r < 0)
+                        return r;
+
+                r = callback(buf, k, id, userdata);
+                if (r < 0)
+                        return r;
+
+                memmove(buf, buf + k, n - k);
+                n -= k;
+        }
+}
+
+void chunk_index_done(ChunkIndex *index) {
+        assert(index);
+
+        index->entries = mfree(index->entries);
+        index->n_entries = index->n_allocated = 0;
+        index->size = 0;
+}
+
+int chunk_index_parse(ChunkIndex *index, const void *data, size_t size) {
+        const char *p = data, *e = p + size;
+        int r;
+
+        assert(index);
+        assert(data || size == 0);
+
+        while (p < e) {
+                _cleanup_free_ char *line = NULL;
+                ChunkIndexEntry *entry;
+                const char *nl, *sp;
+                uint64_t sz;
+
+                nl = memchr(p, '\n', e - p);
+                if (!nl)
+                        return -EBADMSG;
+
+                line = strndup(p, nl - p);
+                if (!line)
+                        return -ENOMEM;
+
+                p = nl + 1;
+
+                sp = strchr(line, ' ');
+                if (!sp || sp - line != CHUNK_ID_LENGTH)
+                        return -EBADMSG;
+
+                r = safe_atou64(sp + 1, &sz);
+                if (r < 0)
+                        return -EBADMSG;
+                if (sz <= 0 || sz > CHUNK_SIZE_MAX)
+                        return -EBADMSG;
+
+                if (index->size + sz < index->size)
+                        return -EOVERFLOW;
+
+                if (!GREEDY_REALLOC(index->entries, index->n_allocated, index->n_entries + 1))
+                        return -ENOMEM;
+
+                entry = index->entries + index->n_entries;
+                memcpy(entry->id, line, CHUNK_ID_LENGTH);
+                entry->id[CHUNK_ID_LENGTH] = 0;
+                entry->size = sz;
+
+                if (!chunk_id_is_valid(entry->id))
+                        return -EBADMSG;
+
+                index->n_entries++;
+                index->size += sz;
+        }
+
+        return 0;
+}
+
+int chunk_store_has(const char *store, const char *id) {
+        const char *p;
+
+        assert(store);
+        assert(chunk_id_is_valid(id));
+
+        p = strjoina(store, "/", id);
+
+        if (access(p, F_OK) < 0)
+                return errno == ENOENT ? 0 : -errno;
+
+        return 1;
+}
+
+int chunk_store_put(const char *store, const char *id, const void *data, size_t size) {
+        _cleanup_free_ char *t = NULL;
+        _cleanup_close_ int fd = -1;
+        const char *p;
+        int r;
+
+        assert(store);
+        assert(chunk_id_is_valid(id));
+        assert(data || size == 0);
+
+        p = strjoina(store, "/", id);
+
+        fd = open_tmpfile_linkable(p, O_WRONLY|O_CLOEXEC, &t);
+        if (fd < 0)
+                return fd;
+
+        r = loop_write(fd, data, size, false);
+        if (r < 0)
+                goto fail;
+
+        r = link_tmpfile(fd, t, p);
+        if (r == -EEXIST) {
+                /* Somebody else stored the same chunk in the meantime, which is just as good */
+                r = 0;
+                goto fail;
+        }
+        if (r < 0)
+                goto fail;
+
+        return 1;
+
+fail:
+        if (t)
+                (void) unlink(t);
+
+        return r;
+}
+
+int chunk_store_assemble(const char *store, const ChunkIndex *index, int fd) {
+        uint64_t offset = 0;
+        struct stat st;
+        size_t i;
+        int r;
+
+        assert(store);
+        assert(index);
+        assert(fd >= 0);
+
+        if (fstat(fd, &st) < 0)
+                return -errno;
+
+        for (i = 0; i < index->n_entries; i++) {
+                const ChunkIndexEntry *entry = index->entries + i;
+                _cleanup_close_ int chunk_fd = -1;
+                struct stat cst;
+                const char *p;
+                bool cloned = false;
+
+                p = strjoina(store, "/", entry->id);
+
+                chunk_fd = open(p, O_RDONLY|O_CLOEXEC|O_NOCTTY);
+                if (chunk_fd < 0)
+                        return -errno;
+
+                if (fstat(chunk_fd, &cst) < 0)
+                        return -errno;
+                if ((uint64_t) cst.st_size != entry->size)
+                        return -EBADMSG;
+
+                /* Extents can only be shared on block boundaries. Where the chunk sits on one, reflink it
+                 * rather than copying, so that the image and the store share the data on disk. */
+                if (st.st_blksize > 0 &&
+                    offset % st.st_blksize == 0 &&
+                    (entry->size % st.st_blksize == 0 || i == index->n_entries - 1))
+                        cloned = btrfs_clone_range(chunk_fd, 0, fd, offset, entry->size) >= 0;
+
+                if (cloned) {
+                        if (lseek(fd, offset + entry->size, SEEK_SET) < 0)
+                                return -errno;
+                } else {
+                        r = copy_bytes(chunk_fd, fd, entry->size, 0);
+                        if (r < 0)
+                                return r;
+                }
+
+                offset += entry->size;
+        }
+
+        return 0;
+}
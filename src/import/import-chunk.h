@@ -0,0 +1,42 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+#pragma once
+
+#include <inttypes.h>
+#include <sys/types.h>
+
+#include "macro.h"
+
+/* Images are split into chunks at content-defined boundaries, using a rolling hash over a small window of
+ * bytes. An edit to the image hence only changes the chunks around it, all others stay the same. Chunks are
+ * named by the SHA256 of their contents, and an image is described by an index listing its chunks in order,
+ * one "<sha256> <size>" line per chunk. */
+
+#define CHUNK_SIZE_MIN (16U * 1024U)
+#define CHUNK_SIZE_AVG (64U * 1024U)
+#define CHUNK_SIZE_MAX (256U * 1024U)
+
+#define CHUNK_ID_LENGTH 64U
+
+typedef struct ChunkIndexEntry {
+        char id[CHUNK_ID_LENGTH + 1];
+        uint64_t size;
+} ChunkIndexEntry;
+
+typedef struct ChunkIndex {
+        ChunkIndexEntry *entries;
+        size_t n_entries, n_allocated;
+        uint64_t size;
+} ChunkIndex;
+
+typedef int (*ChunkCallback)(const void *data, size_t size, const char *id, void *userdata);
+
+int chunk_split_fd(int fd, ChunkCallback callback, void *userdata);
+int chunk_make_id(const void *data, size_t size, char ret[static CHUNK_ID_LENGTH + 1]);
+bool chunk_id_is_valid(const char *id) _pure_;
+
+void chunk_index_done(ChunkIndex *index);
+int chunk_index_parse(ChunkIndex *index, const void *data, size_t size);
+
+int chunk_store_has(const char *store, const char *id);
+int chunk_store_put(const char *store, const char *id, const void *data, size_t size);
+int chunk_store_assemble(const char *store, const ChunkIndex *index, int fd);
@@ -20,6 +20,13 @@ void import_compress_free(ImportCompress *c) {
                         BZ2_bzCompressEnd(&c->bzip2);
                 else
                         BZ2_bzDecompressEnd(&c->bzip2);
+#endif
+#if HAVE_ZSTD
+        } else if (c->type == IMPORT_COMPRESS_ZSTD) {
+                if (c->encoding)
+                        ZSTD_freeCCtx(c->zstd_c);
+                else
+                        ZSTD_freeDCtx(c->zstd_d);
 #endif
         }
 
@@ -36,6 +43,9 @@ int import_uncompress_detect(ImportCompress *c, const void *data, size_t size) {
         static const uint8_t bzip2_signature[] = {
                 'B', 'Z', 'h'
         };
+        static const uint8_t zstd_signature[] = {
+                0x28, 0xb5, 0x2f, 0xfd
+        };
 
         int r;
 
@@ -44,9 +54,10 @@ int import_uncompress_detect(ImportCompress *c, const void *data, size_t size) {
         if (c->type != IMPORT_COMPRESS_UNKNOWN)
                 return 1;
 
-        if (size < MAX3(sizeof(xz_signature),
-                        sizeof(gzip_signature),
-                        sizeof(bzip2_signature)))
+        if (size < MAX(MAX3(sizeof(xz_signature),
+                            sizeof(gzip_signature),
+                            sizeof(bzip2_signature)),
+                       sizeof(zstd_signature)))
                 return 0;
 
         assert(data);
@@ -74,6 +85,14 @@ int import_uncompress_detect(ImportCompress *c, const void *data, size_t size) {
                         return -EIO;
 
                 c->type = IMPORT_COMPRESS_BZIP2;
+#endif
+#if HAVE_ZSTD
+        } else if (memcmp(data, zstd_signature, sizeof(zstd_signature)) == 0) {
+                c->zstd_d = ZSTD_createDCtx();
+                if (!c->zstd_d)
+                        return -ENOMEM;
+
+                c->type = IMPORT_COMPRESS_ZSTD;
 #endif
         } else
                 c->type = IMPORT_COMPRESS_UNCOMPRESSED;
@@ -176,6 +195,34 @@ int import_uncompress(ImportCompress *c, const void *data, size_t size, ImportCo
                 break;
 #endif
 
+#if HAVE_ZSTD
+        case IMPORT_COMPRESS_ZSTD: {
+                ZSTD_inBuffer input = {
+                        .src = data,
+                        .size = size,
+                };
+
+                while (input.pos < input.size) {
+                        uint8_t buffer[16 * 1024];
+                        ZSTD_outBuffer output = {
+                                .dst = buffer,
+                                .size = sizeof(buffer),
+                        };
+                        size_t k;
+
+                        k = ZSTD_decompressStream(c->zstd_d, &output, &input);
+                        if (ZSTD_isError(k))
+                                return -EIO;
+
+                        r = callback(buffer, output.pos, userdata);
+                        if (r < 0)
+                                return r;
+                }
+
+                break;
+        }
+#endif
+
         default:
                 assert_not_reached("Unknown compression");
         }
@@ -219,6 +266,25 @@ int import_compress_init(ImportCompress *c, ImportCompressType t) {
                 break;
 #endif
 
+#if HAVE_ZSTD
+        case IMPORT_COMPRESS_ZSTD: {
+                size_t k;
+
+                c->zstd_c = ZSTD_createCCtx();
+                if (!c->zstd_c)
+                        return -ENOMEM;
+
+                k = ZSTD_CCtx_setParameter(c->zstd_c, ZSTD_c_checksumFlag, 1);
+                if (ZSTD_isError(k)) {
+                        ZSTD_freeCCtx(c->zstd_c);
+                        return -EIO;
+                }
+
+                c->type = IMPORT_COMPRESS_ZSTD;
+                break;
+        }
+#endif
+
         case IMPORT_COMPRESS_UNCOMPRESSED:
                 c->type = IMPORT_COMPRESS_UNCOMPRESSED;
                 break;
@@ -339,6 +405,37 @@ int import_compress(ImportCompress *c, const void *data, size_t size, void **buf
                 break;
 #endif
 
+#if HAVE_ZSTD
+        case IMPORT_COMPRESS_ZSTD: {
+                ZSTD_inBuffer input = {
+                        .src = data,
+                        .size = size,
+                };
+
+                while (input.pos < input.size) {
+                        ZSTD_outBuffer output;
+                        size_t k;
+
+                        r = enlarge_buffer(buffer, buffer_size, buffer_allocated);
+                        if (r < 0)
+                                return r;
+
+                        output = (ZSTD_outBuffer) {
+                                .dst = (uint8_t*) *buffer + *buffer_size,
+                                .size = *buffer_allocated - *buffer_size,
+                        };
+
+                        k = ZSTD_compressStream2(c->zstd_c, &output, &input, ZSTD_e_continue);
+                        if (ZSTD_isError(k))
+                                return -EIO;
+
+                        *buffer_size += output.pos;
+                }
+
+                break;
+        }
+#endif
+
         case IMPORT_COMPRESS_UNCOMPRESSED:
 
                 if (*buffer_allocated < size) {
@@ -443,6 +540,35 @@ int import_compress_finish(ImportCompress *c, void **buffer, size_t *buffer_size
                 break;
 #endif
 
+#if HAVE_ZSTD
+        case IMPORT_COMPRESS_ZSTD: {
+                ZSTD_inBuffer input = {};
+                size_t k;
+
+                do {
+                        ZSTD_outBuffer output;
+
+                        r = enlarge_buffer(buffer, buffer_size, buffer_allocated);
+                        if (r < 0)
+                                return r;
+
+                        output = (ZSTD_outBuffer) {
+                                .dst = (uint8_t*) *buffer + *buffer_size,
+                                .size = *buffer_allocated - *buffer_size,
+                        };
+
+                        /* Returns the number of bytes still to be flushed */
+                        k = ZSTD_compressStream2(c->zstd_c, &output, &input, ZSTD_e_end);
+                        if (ZSTD_isError(k))
+                                return -EIO;
+
+                        *buffer_size += output.pos;
+                } while (k != 0);
+
+                break;
+        }
+#endif
+
         case IMPORT_COMPRESS_UNCOMPRESSED:
                 break;
 
@@ -461,6 +587,9 @@ static const char* const import_compress_type_table[_IMPORT_COMPRESS_TYPE_MAX] =
 #if HAVE_BZIP2
         [IMPORT_COMPRESS_BZIP2] = "bzip2",
 #endif
+#if HAVE_ZSTD
+        [IMPORT_COMPRESS_ZSTD] = "zstd",
+#endif
 };
 
 DEFINE_STRING_TABLE_LOOKUP(import_compress_type, ImportCompressType);
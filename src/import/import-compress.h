@@ -7,6 +7,9 @@
 #include <lzma.h>
 #include <sys/types.h>
 #include <zlib.h>
+#if HAVE_ZSTD
+#include <zstd.h>
+#endif
 
 #include "macro.h"
 
@@ -16,6 +19,7 @@ typedef enum ImportCompressType {
         IMPORT_COMPRESS_XZ,
         IMPORT_COMPRESS_GZIP,
         IMPORT_COMPRESS_BZIP2,
+        IMPORT_COMPRESS_ZSTD,
         _IMPORT_COMPRESS_TYPE_MAX,
         _IMPORT_COMPRESS_TYPE_INVALID = -1,
 } ImportCompressType;
@@ -28,6 +32,10 @@ typedef struct ImportCompress {
                 z_stream gzip;
 #if HAVE_BZIP2
                 bz_stream bzip2;
+#endif
+#if HAVE_ZSTD
+                ZSTD_CCtx *zstd_c;
+                ZSTD_DCtx *zstd_d;
 #endif
         };
 } ImportCompress;
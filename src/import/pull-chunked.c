@@ -0,0 +1,553 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <curl/curl.h>
+
+#include "sd-daemon.h"
+
+#include "alloc-util.h"
+#include "curl-util.h"
+#include "fd-util.h"
+#include "fs-util.h"
+#include "hostname-util.h"
+#include "import-chunk.h"
+#include "import-util.h"
+#include "macro.h"
+#include "mkdir.h"
+#include "pull-chunked.h"
+#include "pull-common.h"
+#include "pull-job.h"
+#include "rm-rf.h"
+#include "set.h"
+#include "string-util.h"
+#include "tmpfile-util.h"
+#include "web-util.h"
+
+/* How many chunks to download in parallel */
+#define CHUNK_JOBS_MAX 8U
+
+/* Where downloaded chunks are kept below the image root, so that later versions of an image only need to
+ * download the chunks that changed */
+#define CHUNK_STORE ".chunks"
+
+typedef enum ChunkedProgress {
+        CHUNKED_DOWNLOADING_INDEX,
+        CHUNKED_DOWNLOADING_CHUNKS,
+        CHUNKED_ASSEMBLING,
+} ChunkedProgress;
+
+struct ChunkedPull {
+        sd_event *event;
+        CurlGlue *glue;
+
+        char *image_root;
+        char *store;
+
+        PullJob *index_job;
+        PullJob *checksum_job;
+        PullJob *signature_job;
+
+        PullJob *chunk_jobs[CHUNK_JOBS_MAX];
+        const ChunkIndexEntry *chunk_entries[CHUNK_JOBS_MAX];
+
+        ChunkedPullFinished on_finished;
+        void *userdata;
+
+        char *local;
+        bool force_local;
+
+        char *temp_path;
+
+        ImportVerify verify;
+
+        ChunkIndex index;
+        size_t next_entry;
+        Set *queued;
+
+        uint64_t n_done;
+        uint64_t n_fetched;
+        unsigned last_percent;
+};
+
+ChunkedPull* chunked_pull_unref(ChunkedPull *i) {
+        size_t k;
+
+        if (!i)
+                return NULL;
+
+        pull_job_unref(i->index_job);
+        pull_job_unref(i->checksum_job);
+        pull_job_unref(i->signature_job);
+
+        for (k = 0; k < CHUNK_JOBS_MAX; k++)
+                pull_job_unref(i->chunk_jobs[k]);
+
+        curl_glue_unref(i->glue);
+        sd_event_unref(i->event);
+
+        if (i->temp_path) {
+                (void) unlink(i->temp_path);
+                free(i->temp_path);
+        }
+
+        /* The set only references the ids in the index, hence free it first */
+        set_free(i->queued);
+        chunk_index_done(&i->index);
+
+        free(i->store);
+        free(i->image_root);
+        free(i->local);
+        return mfree(i);
+}
+
+int chunked_pull_new(
+                ChunkedPull **ret,
+                sd_event *event,
+                const char *image_root,
+                ChunkedPullFinished on_finished,
+                void *userdata) {
+
+        _cleanup_(curl_glue_unrefp) CurlGlue *g = NULL;
+        _cleanup_(sd_event_unrefp) sd_event *e = NULL;
+        _cleanup_(chunked_pull_unrefp) ChunkedPull *i = NULL;
+        _cleanup_free_ char *root = NULL, *store = NULL;
+        int r;
+
+        assert(ret);
+
+        root = strdup(image_root ?: "/var/lib/machines");
+        if (!root)
+                return -ENOMEM;
+
+        store = strjoin(root, "/" CHUNK_STORE);
+        if (!store)
+                return -ENOMEM;
+
+        if (event)
+                e = sd_event_ref(event);
+        else {
+                r = sd_event_default(&e);
+                if (r < 0)
+                        return r;
+        }
+
+        r = curl_glue_new(&g, e);
+        if (r < 0)
+                return r;
+
+        i = new(ChunkedPull, 1);
+        if (!i)
+                return -ENOMEM;
+
+        *i = (ChunkedPull) {
+                .on_finished = on_finished,
+                .userdata = userdata,
+                .image_root = TAKE_PTR(root),
+                .store = TAKE_PTR(store),
+                .event = TAKE_PTR(e),
+                .glue = TAKE_PTR(g),
+                .last_percent = (unsigned) -1,
+        };
+
+        i->glue->on_finished = pull_job_curl_on_finished;
+        i->glue->userdata = i;
+
+        *ret = TAKE_PTR(i);
+
+        return 0;
+}
+
+static void chunked_pull_report_progress(ChunkedPull *i, ChunkedProgress p) {
+        unsigned percent;
+
+        assert(i);
+
+        switch (p) {
+
+        case CHUNKED_DOWNLOADING_INDEX: {
+                unsigned remain = 10;
+
+                percent = 0;
+
+                if (i->checksum_job) {
+                        percent += i->checksum_job->progress_percent * 2 / 100;
+                        remain -= 2;
+                }
+
+                if (i->signature_job) {
+                        percent += i->signature_job->progress_percent * 2 / 100;
+                        remain -= 2;
+                }
+
+                if (i->index_job)
+                        percent += i->index_job->progress_percent * remain / 100;
+                break;
+        }
+
+        case CHUNKED_DOWNLOADING_CHUNKS:
+                percent = 10;
+
+                if (i->index.size > 0)
+                        percent += (unsigned) (i->n_done * 80 / i->index.size);
+                break;
+
+        case CHUNKED_ASSEMBLING:
+                percent = 90;
+                break;
+
+        default:
+                assert_not_reached("Unknown progress state");
+        }
+
+        /* There might be many thousands of chunks, only tell about actual changes */
+        if (percent == i->last_percent)
+                return;
+
+        i->last_percent = percent;
+
+        sd_notifyf(false, "X_IMPORT_PROGRESS=%u", percent);
+        log_debug("Combined progress %u%%", percent);
+}
+
+static int chunked_pull_assemble(ChunkedPull *i) {
+        _cleanup_close_ int fd = -1;
+        const char *p;
+        int r;
+
+        assert(i);
+
+        if (!i->local)
+                return 0;
+
+        chunked_pull_report_progress(i, CHUNKED_ASSEMBLING);
+
+        p = strjoina(i->image_root, "/", i->local, ".raw");
+
+        r = tempfn_random(p, NULL, &i->temp_path);
+        if (r < 0)
+                return log_oom();
+
+        /* Note that unlike the other pullers we leave copy-on-write enabled for the image, as extents can
+         * only be shared with the chunk store if both use it. */
+        fd = open(i->temp_path, O_WRONLY|O_CREAT|O_EXCL|O_NOCTTY|O_CLOEXEC, 0664);
+        if (fd < 0)
+                return log_error_errno(errno, "Failed to create %s: %m", i->temp_path);
+
+        r = chunk_store_assemble(i->store, &i->index, fd);
+        if (r < 0)
+                return log_error_errno(r, "Failed to assemble image from chunks: %m");
+
+        fd = safe_close(fd);
+
+        if (i->force_local)
+                (void) rm_rf(p, REMOVE_ROOT|REMOVE_PHYSICAL|REMOVE_SUBVOLUME);
+
+        r = rename_noreplace(AT_FDCWD, i->temp_path, AT_FDCWD, p);
+        if (r < 0)
+                return log_error_errno(r, "Failed to move image into place: %m");
+
+        i->temp_path = mfree(i->temp_path);
+
+        log_info("Created new local image '%s'.", i->local);
+        return 0;
+}
+
+static void chunked_pull_chunk_on_finished(PullJob *j);
+
+static int chunked_pull_queue_chunks(ChunkedPull *i) {
+        size_t k;
+        int r, n_running = 0;
+
+        assert(i);
+
+        for (k = 0; k < CHUNK_JOBS_MAX; k++) {
+
+                /* Completed jobs are released once their slot is reused. This might happen from within the
+                 * job's own completion callback, which is fine, as the job isn't accessed after it. */
+                if (i->chunk_jobs[k] && PULL_JOB_IS_COMPLETE(i->chunk_jobs[k])) {
+                        i->chunk_jobs[k] = pull_job_unref(i->chunk_jobs[k]);
+                        i->chunk_entries[k] = NULL;
+                }
+
+                while (!i->chunk_jobs[k] && i->next_entry < i->index.n_entries) {
+                        const ChunkIndexEntry *entry = i->index.entries + i->next_entry++;
+                        _cleanup_free_ char *url = NULL;
+                        const char *suffix;
+
+                        /* Chunks that are in the cache already, or that are being downloaded for an earlier
+                         * part of the image, don't need to be downloaded (again) */
+                        if (set_contains(i->queued, entry->id)) {
+                                i->n_done += entry->size;
+                                continue;
+                        }
+
+                        r = chunk_store_has(i->store, entry->id);
+                        if (r < 0)
+                                return log_error_errno(r, "Failed to check for chunk %s: %m", entry->id);
+                        if (r > 0) {
+                                i->n_done += entry->size;
+                                continue;
+                        }
+
+                        r = set_put(i->queued, entry->id);
+                        if (r < 0)
+                                return log_oom();
+
+                        suffix = strjoina("chunks/", entry->id);
+
+                        r = import_url_change_last_component(i->index_job->url, suffix, &url);
+                        if (r < 0)
+                                return log_oom();
+
+                        r = pull_job_new(&i->chunk_jobs[k], url, i->glue, i);
+                        if (r < 0)
+                                return log_oom();
+
+                        i->chunk_jobs[k]->on_finished = chunked_pull_chunk_on_finished;
+                        i->chunk_jobs[k]->uncompressed_max = CHUNK_SIZE_MAX;
+                        i->chunk_jobs[k]->compressed_max = 2 * CHUNK_SIZE_MAX;
+                        i->chunk_entries[k] = entry;
+
+                        r = pull_job_begin(i->chunk_jobs[k]);
+                        if (r < 0)
+                                return log_error_errno(r, "Failed to start download of chunk %s: %m", entry->id);
+                }
+
+                if (i->chunk_jobs[k])
+                        n_running++;
+        }
+
+        chunked_pull_report_progress(i, CHUNKED_DOWNLOADING_CHUNKS);
+
+        return n_running;
+}
+
+static void chunked_pull_finish(ChunkedPull *i, int r) {
+        assert(i);
+
+        if (i->on_finished)
+                i->on_finished(i, r, i->userdata);
+        else
+                sd_event_exit(i->event, r);
+}
+
+static int chunked_pull_continue(ChunkedPull *i) {
+        int r;
+
+        assert(i);
+
+        r = chunked_pull_queue_chunks(i);
+        if (r != 0)
+                return r;
+
+        log_info("Downloaded %" PRIu64 " of %" PRIu64 " bytes, the rest was found in the chunk cache.",
+                 i->n_fetched, i->index.size);
+
+        r = chunked_pull_assemble(i);
+        if (r < 0)
+                return r;
+
+        chunked_pull_finish(i, 0);
+        return 0;
+}
+
+static void chunked_pull_chunk_on_finished(PullJob *j) {
+        char id[CHUNK_ID_LENGTH + 1];
+        const ChunkIndexEntry *entry;
+        ChunkedPull *i;
+        size_t k;
+        int r;
+
+        assert(j);
+        assert(j->userdata);
+
+        i = j->userdata;
+
+        for (k = 0; k < CHUNK_JOBS_MAX; k++)
+                if (i->chunk_jobs[k] == j)
+                        break;
+        assert(k < CHUNK_JOBS_MAX);
+
+        entry = i->chunk_entries[k];
+
+        if (j->error != 0) {
+                r = log_error_errno(j->error, "Failed to retrieve chunk %s.", entry->id);
+                goto finish;
+        }
+
+        /* The index has been verified, and chunks are named by their hash, hence this verifies the chunk */
+        r = chunk_make_id(j->payload, j->payload_size, id);
+        if (r < 0)
+                goto finish;
+
+        if (j->payload_size != entry->size || !streq(id, entry->id)) {
+                r = log_error_errno(SYNTHETIC_ERRNO(EBADMSG),
+                                    "DOWNLOAD INVALID: Checksum of chunk %s did not check out, file has been tampered with.", entry->id);
+                goto finish;
+        }
+
+        r = chunk_store_put(i->store, entry->id, j->payload, j->payload_size);
+        if (r < 0) {
+                log_error_errno(r, "Failed to store chunk %s: %m", entry->id);
+                goto finish;
+        }
+
+        i->n_done += entry->size;
+        i->n_fetched += entry->size;
+
+        r = chunked_pull_continue(i);
+        if (r >= 0)
+                return;
+
+finish:
+        chunked_pull_finish(i, r);
+}
+
+static bool chunked_pull_is_done(ChunkedPull *i) {
+        assert(i);
+        assert(i->index_job);
+
+        if (!PULL_JOB_IS_COMPLETE(i->index_job))
+                return false;
+        if (i->checksum_job && !PULL_JOB_IS_COMPLETE(i->checksum_job))
+                return false;
+        if (i->signature_job && !PULL_JOB_IS_COMPLETE(i->signature_job))
+                return false;
+
+        return true;
+}
+
+static void chunked_pull_job_on_finished(PullJob *j) {
+        ChunkedPull *i;
+        int r;
+
+        assert(j);
+        assert(j->userdata);
+
+        i = j->userdata;
+        if (j->error != 0 && j != i->signature_job) {
+                if (j == i->checksum_job)
+                        log_error_errno(j->error, "Failed to retrieve SHA256 checksum, cannot verify. (Try --verify=no?)");
+                else
+                        log_error_errno(j->error, "Failed to retrieve chunk index. (Wrong URL?)");
+
+                r = j->error;
+                goto finish;
+        }
+
+        if (!chunked_pull_is_done(i))
+                return;
+
+        if (i->signature_job && i->checksum_job->style == VERIFICATION_PER_DIRECTORY && i->signature_job->error != 0) {
+                log_error_errno(j->error, "Failed to retrieve signature file, cannot verify. (Try --verify=no?)");
+
+                r = i->signature_job->error;
+                goto finish;
+        }
+
+        r = pull_verify(i->index_job, NULL, NULL, i->checksum_job, i->signature_job);
+        if (r < 0)
+                goto finish;
+
+        r = chunk_index_parse(&i->index, i->index_job->payload, i->index_job->payload_size);
+        if (r < 0) {
+                log_error_errno(r, "Failed to parse chunk index: %m");
+                goto finish;
+        }
+
+        log_info("Image consists of %zu chunks, %" PRIu64 " bytes.", i->index.n_entries, i->index.size);
+
+        r = mkdir_p_label(i->store, 0700);
+        if (r < 0) {
+                log_error_errno(r, "Failed to create chunk cache %s: %m", i->store);
+                goto finish;
+        }
+
+        r = chunked_pull_continue(i);
+        if (r >= 0)
+                return;
+
+finish:
+        chunked_pull_finish(i, r);
+}
+
+static void chunked_pull_job_on_progress(PullJob *j) {
+        ChunkedPull *i;
+
+        assert(j);
+        assert(j->userdata);
+
+        i = j->userdata;
+
+        chunked_pull_report_progress(i, CHUNKED_DOWNLOADING_INDEX);
+}
+
+int chunked_pull_start(
+                ChunkedPull *i,
+                const char *url,
+                const char *local,
+                bool force_local,
+                ImportVerify verify) {
+
+        int r;
+
+        assert(i);
+        assert(verify < _IMPORT_VERIFY_MAX);
+        assert(verify >= 0);
+
+        if (!http_url_is_valid(url))
+                return -EINVAL;
+
+        if (local && !machine_name_is_valid(local))
+                return -EINVAL;
+
+        if (i->index_job)
+                return -EBUSY;
+
+        r = free_and_strdup(&i->local, local);
+        if (r < 0)
+                return r;
+
+        i->force_local = force_local;
+        i->verify = verify;
+
+        i->queued = set_new(&string_hash_ops);
+        if (!i->queued)
+                return -ENOMEM;
+
+        /* Queue job for the index, which is kept in memory */
+        r = pull_job_new(&i->index_job, url, i->glue, i);
+        if (r < 0)
+                return r;
+
+        i->index_job->on_finished = chunked_pull_job_on_finished;
+        i->index_job->on_progress = chunked_pull_job_on_progress;
+        i->index_job->calc_checksum = verify != IMPORT_VERIFY_NO;
+        i->index_job->uncompressed_max = i->index_job->compressed_max = 256ULL * 1024ULL * 1024ULL;
+
+        r = pull_make_verification_jobs(&i->checksum_job, &i->signature_job, verify, url, i->glue, chunked_pull_job_on_finished, i);
+        if (r < 0)
+                return r;
+
+        r = pull_job_begin(i->index_job);
+        if (r < 0)
+                return r;
+
+        if (i->checksum_job) {
+                i->checksum_job->on_progress = chunked_pull_job_on_progress;
+                i->checksum_job->style = VERIFICATION_PER_FILE;
+
+                r = pull_job_begin(i->checksum_job);
+                if (r < 0)
+                        return r;
+        }
+
+        if (i->signature_job) {
+                i->signature_job->on_progress = chunked_pull_job_on_progress;
+
+                r = pull_job_begin(i->signature_job);
+                if (r < 0)
+                        return r;
+        }
+
+        return 0;
+}
@@ -0,0 +1,18 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+#pragma once
+
+#include "sd-event.h"
+
+#include "import-util.h"
+#include "macro.h"
+
+typedef struct ChunkedPull ChunkedPull;
+
+typedef void (*ChunkedPullFinished)(ChunkedPull *pull, int error, void *userdata);
+
+int chunked_pull_new(ChunkedPull **pull, sd_event *event, const char *image_root, ChunkedPullFinished on_finished, void *userdata);
+ChunkedPull* chunked_pull_unref(ChunkedPull *pull);
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(ChunkedPull*, chunked_pull_unref);
+
+int chunked_pull_start(ChunkedPull *pull, const char *url, const char *local, bool force_local, ImportVerify verify);
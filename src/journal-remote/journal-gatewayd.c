@@ -15,6 +15,7 @@
 
 #include "alloc-util.h"
 #include "bus-util.h"
+#include "dirent-util.h"
 #include "errno-util.h"
 #include "fd-util.h"
 #include "fileio.h"
@@ -25,8 +26,11 @@
 #include "microhttpd-util.h"
 #include "os-util.h"
 #include "parse-util.h"
+#include "path-util.h"
 #include "pretty-print.h"
 #include "sigbus.h"
+#include "stdio-util.h"
+#include "strv.h"
 #include "tmpfile-util.h"
 #include "util.h"
 
@@ -139,6 +143,66 @@ static int request_meta_ensure_tmp(RequestMeta *m) {
         return 0;
 }
 
+/* Entries are serialized into the temporary file until it holds at least this much, so that exports of
+ * large ranges aren't dominated by the per-chunk overhead, and passed to µhttpd in blocks of this size. */
+#define ENTRIES_CHUNK_SIZE (128U*1024U)
+#define ENTRIES_BLOCK_SIZE (64U*1024U)
+
+static int request_meta_next_entry(RequestMeta *m, bool wait) {
+        int r;
+
+        assert(m);
+
+        /* Moves to the next entry to serialize. Returns > 0 if there is one, 0 at the end of the requested
+         * range, and -EAGAIN if we are following and there's nothing new yet. Waits for new entries only if
+         * requested to. */
+
+        if (m->n_entries_set &&
+            m->n_entries <= 0)
+                return 0;
+
+        for (;;) {
+                if (m->n_skip < 0)
+                        r = sd_journal_previous_skip(m->journal, (uint64_t) -m->n_skip + 1);
+                else if (m->n_skip > 0)
+                        r = sd_journal_next_skip(m->journal, (uint64_t) m->n_skip + 1);
+                else
+                        r = sd_journal_next(m->journal);
+                if (r < 0)
+                        return log_error_errno(r, "Failed to advance journal pointer: %m");
+                if (r > 0)
+                        break;
+
+                if (!m->follow)
+                        return 0;
+                if (!wait)
+                        return -EAGAIN;
+
+                r = sd_journal_wait(m->journal, (uint64_t) JOURNAL_WAIT_TIMEOUT);
+                if (r < 0)
+                        return log_error_errno(r, "Couldn't wait for journal event: %m");
+                if (r == SD_JOURNAL_NOP)
+                        return -EAGAIN;
+        }
+
+        if (m->discrete) {
+                assert(m->cursor);
+
+                r = sd_journal_test_cursor(m->journal, m->cursor);
+                if (r < 0)
+                        return log_error_errno(r, "Failed to test cursor: %m");
+                if (r == 0)
+                        return 0;
+        }
+
+        if (m->n_entries_set)
+                m->n_entries -= 1;
+
+        m->n_skip = 0;
+
+        return 1;
+}
+
 static ssize_t request_reader_entries(
                 void *cls,
                 uint64_t pos,
@@ -159,78 +223,49 @@ static ssize_t request_reader_entries(
         while (pos >= m->size) {
                 off_t sz;
 
-                /* End of this entry, so let's serialize the next
-                 * one */
-
-                if (m->n_entries_set &&
-                    m->n_entries <= 0)
-                        return MHD_CONTENT_READER_END_OF_STREAM;
+                /* End of this chunk, so let's serialize the next entries */
 
-                if (m->n_skip < 0)
-                        r = sd_journal_previous_skip(m->journal, (uint64_t) -m->n_skip + 1);
-                else if (m->n_skip > 0)
-                        r = sd_journal_next_skip(m->journal, (uint64_t) m->n_skip + 1);
-                else
-                        r = sd_journal_next(m->journal);
-
-                if (r < 0) {
-                        log_error_errno(r, "Failed to advance journal pointer: %m");
+                r = request_meta_next_entry(m, true);
+                if (r == -EAGAIN)
+                        break;
+                if (r < 0)
                         return MHD_CONTENT_READER_END_WITH_ERROR;
-                } else if (r == 0) {
-
-                        if (m->follow) {
-                                r = sd_journal_wait(m->journal, (uint64_t) JOURNAL_WAIT_TIMEOUT);
-                                if (r < 0) {
-                                        log_error_errno(r, "Couldn't wait for journal event: %m");
-                                        return MHD_CONTENT_READER_END_WITH_ERROR;
-                                }
-                                if (r == SD_JOURNAL_NOP)
-                                        break;
-
-                                continue;
-                        }
-
+                if (r == 0)
                         return MHD_CONTENT_READER_END_OF_STREAM;
-                }
-
-                if (m->discrete) {
-                        assert(m->cursor);
-
-                        r = sd_journal_test_cursor(m->journal, m->cursor);
-                        if (r < 0) {
-                                log_error_errno(r, "Failed to test cursor: %m");
-                                return MHD_CONTENT_READER_END_WITH_ERROR;
-                        }
-
-                        if (r == 0)
-                                return MHD_CONTENT_READER_END_OF_STREAM;
-                }
 
                 pos -= m->size;
                 m->delta += m->size;
 
-                if (m->n_entries_set)
-                        m->n_entries -= 1;
-
-                m->n_skip = 0;
-
                 r = request_meta_ensure_tmp(m);
                 if (r < 0) {
                         log_error_errno(r, "Failed to create temporary file: %m");
                         return MHD_CONTENT_READER_END_WITH_ERROR;
                 }
 
-                r = show_journal_entry(m->tmp, m->journal, m->mode, 0, OUTPUT_FULL_WIDTH,
-                                   NULL, NULL, NULL);
-                if (r < 0) {
-                        log_error_errno(r, "Failed to serialize item: %m");
-                        return MHD_CONTENT_READER_END_WITH_ERROR;
-                }
+                for (;;) {
+                        r = show_journal_entry(m->tmp, m->journal, m->mode, 0, OUTPUT_FULL_WIDTH,
+                                               NULL, NULL, NULL);
+                        if (r < 0) {
+                                log_error_errno(r, "Failed to serialize item: %m");
+                                return MHD_CONTENT_READER_END_WITH_ERROR;
+                        }
 
-                sz = ftello(m->tmp);
-                if (sz == (off_t) -1) {
-                        log_error_errno(errno, "Failed to retrieve file position: %m");
-                        return MHD_CONTENT_READER_END_WITH_ERROR;
+                        sz = ftello(m->tmp);
+                        if (sz == (off_t) -1) {
+                                log_error_errno(errno, "Failed to retrieve file position: %m");
+                                return MHD_CONTENT_READER_END_WITH_ERROR;
+                        }
+
+                        if ((uint64_t) sz >= ENTRIES_CHUNK_SIZE)
+                                break;
+
+                        /* Add more entries to the chunk, as long as they are available right away. The end of
+                         * the range is noticed again when the chunk was sent. */
+                        r = request_meta_next_entry(m, false);
+                        if (r < 0 && r != -EAGAIN)
+                                return MHD_CONTENT_READER_END_WITH_ERROR;
+                        if (r <= 0)
+                                break;
                 }
 
                 m->size = (uint64_t) sz;
@@ -501,7 +536,7 @@ static int request_handler_entries(
         if (r < 0)
                 return mhd_respond(connection, MHD_HTTP_BAD_REQUEST, "Failed to seek in journal.");
 
-        response = MHD_create_response_from_callback(MHD_SIZE_UNKNOWN, 4*1024, request_reader_entries, m, NULL);
+        response = MHD_create_response_from_callback(MHD_SIZE_UNKNOWN, ENTRIES_BLOCK_SIZE, request_reader_entries, m, NULL);
         if (!response)
                 return respond_oom(connection);
 
@@ -697,6 +732,211 @@ static int request_handler_file(
         return MHD_queue_response(connection, MHD_HTTP_OK, response);
 }
 
+static bool archived_file_name_valid(const char *fn) {
+        assert(fn);
+
+        /* Only archived files are served, since they are never modified anymore and hence can be sent as
+         * they are. Unless a directory was specified, we only serve system journals, like /entries. */
+
+        if (!filename_is_valid(fn))
+                return false;
+
+        if (!arg_directory && !startswith(fn, "system@"))
+                return false;
+
+        return strchr(fn, '@') && endswith(fn, ".journal");
+}
+
+static int archived_file_directories(char ***ret) {
+        _cleanup_strv_free_ char **l = NULL;
+        char mid[SD_ID128_STRING_MAX];
+        sd_id128_t machine;
+        int r;
+
+        assert(ret);
+
+        if (arg_directory) {
+                l = strv_new(arg_directory);
+                if (!l)
+                        return -ENOMEM;
+
+                *ret = TAKE_PTR(l);
+                return 0;
+        }
+
+        r = sd_id128_get_machine(&machine);
+        if (r < 0)
+                return r;
+
+        sd_id128_to_string(machine, mid);
+
+        l = strv_new(strjoina("/var/log/journal/", mid),
+                     strjoina("/run/log/journal/", mid));
+        if (!l)
+                return -ENOMEM;
+
+        *ret = TAKE_PTR(l);
+        return 0;
+}
+
+static int request_handler_files_list(struct MHD_Connection *connection) {
+        _cleanup_(MHD_destroy_responsep) struct MHD_Response *response = NULL;
+        _cleanup_strv_free_ char **dirs = NULL, **files = NULL;
+        _cleanup_free_ char *page = NULL;
+        char **d;
+        int r;
+
+        assert(connection);
+
+        r = archived_file_directories(&dirs);
+        if (r < 0)
+                return mhd_respondf(connection, r, MHD_HTTP_INTERNAL_SERVER_ERROR, "Failed to determine journal directories: %m");
+
+        STRV_FOREACH(d, dirs) {
+                _cleanup_closedir_ DIR *dir = NULL;
+                struct dirent *de;
+
+                dir = opendir(*d);
+                if (!dir) {
+                        if (errno == ENOENT)
+                                continue;
+
+                        return mhd_respondf(connection, errno, MHD_HTTP_INTERNAL_SERVER_ERROR, "Failed to open %s: %m", *d);
+                }
+
+                FOREACH_DIRENT(de, dir, return mhd_respondf(connection, errno, MHD_HTTP_INTERNAL_SERVER_ERROR, "Failed to read %s: %m", *d)) {
+                        if (!archived_file_name_valid(de->d_name))
+                                continue;
+
+                        r = strv_extend(&files, de->d_name);
+                        if (r < 0)
+                                return respond_oom(connection);
+                }
+        }
+
+        strv_sort(files);
+
+        page = strv_join(files, "\n");
+        if (!page)
+                return respond_oom(connection);
+
+        if (!strv_isempty(files) && !strextend(&page, "\n", NULL))
+                return respond_oom(connection);
+
+        response = MHD_create_response_from_buffer(strlen(page), page, MHD_RESPMEM_MUST_FREE);
+        if (!response)
+                return respond_oom(connection);
+        TAKE_PTR(page);
+
+        MHD_add_response_header(response, "Content-Type", "text/plain");
+        return MHD_queue_response(connection, MHD_HTTP_OK, response);
+}
+
+static int request_parse_byte_range(struct MHD_Connection *connection, uint64_t *ret) {
+        _cleanup_free_ char *t = NULL;
+        const char *range, *e;
+
+        assert(connection);
+        assert(ret);
+
+        /* Only open ended ranges are supported, which is what is needed to resume an interrupted transfer.
+         * Other ranges are ignored, and the whole file is sent. */
+
+        *ret = 0;
+
+        range = MHD_lookup_connection_value(connection, MHD_HEADER_KIND, "Range");
+        if (!range)
+                return 0;
+
+        range = startswith(range, "bytes=");
+        if (!range)
+                return 0;
+
+        e = endswith(range, "-");
+        if (!e || e == range)
+                return 0;
+
+        t = strndup(range, e - range);
+        if (!t)
+                return -ENOMEM;
+
+        if (safe_atou64(t, ret) < 0)
+                return 0;
+
+        return 1;
+}
+
+static int request_handler_files_get(
+                struct MHD_Connection *connection,
+                const char *name) {
+
+        _cleanup_(MHD_destroy_responsep) struct MHD_Response *response = NULL;
+        _cleanup_strv_free_ char **dirs = NULL;
+        _cleanup_close_ int fd = -1;
+        uint64_t offset;
+        struct stat st;
+        char **d;
+        int r;
+
+        assert(connection);
+        assert(name);
+
+        if (!archived_file_name_valid(name))
+                return mhd_respond(connection, MHD_HTTP_NOT_FOUND, "Not an archived journal file.");
+
+        r = archived_file_directories(&dirs);
+        if (r < 0)
+                return mhd_respondf(connection, r, MHD_HTTP_INTERNAL_SERVER_ERROR, "Failed to determine journal directories: %m");
+
+        STRV_FOREACH(d, dirs) {
+                _cleanup_free_ char *p = NULL;
+
+                p = path_join(*d, name);
+                if (!p)
+                        return respond_oom(connection);
+
+                fd = open(p, O_RDONLY|O_CLOEXEC|O_NOCTTY|O_NOFOLLOW);
+                if (fd >= 0)
+                        break;
+                if (errno != ENOENT)
+                        return mhd_respondf(connection, errno, MHD_HTTP_INTERNAL_SERVER_ERROR, "Failed to open file %s: %m", p);
+        }
+        if (fd < 0)
+                return mhd_respond(connection, MHD_HTTP_NOT_FOUND, "No such archived journal file.");
+
+        if (fstat(fd, &st) < 0)
+                return mhd_respondf(connection, errno, MHD_HTTP_INTERNAL_SERVER_ERROR, "Failed to stat file: %m");
+        if (!S_ISREG(st.st_mode))
+                return mhd_respond(connection, MHD_HTTP_NOT_FOUND, "Not an archived journal file.");
+
+        r = request_parse_byte_range(connection, &offset);
+        if (r < 0)
+                return respond_oom(connection);
+        if (r > 0 && offset >= (uint64_t) st.st_size)
+                return mhd_respond(connection, MHD_HTTP_RANGE_NOT_SATISFIABLE, "Range starts beyond the end of the file.");
+
+        /* Responses from a file descriptor are sent with sendfile() by µhttpd (unless TLS is used), hence
+         * the data never has to pass through our buffers. */
+        response = MHD_create_response_from_fd_at_offset64(st.st_size - offset, fd, offset);
+        if (!response)
+                return respond_oom(connection);
+        TAKE_FD(fd);
+
+        MHD_add_response_header(response, "Content-Type", "application/octet-stream");
+        MHD_add_response_header(response, "Accept-Ranges", "bytes");
+
+        if (r > 0) {
+                char range[STRLEN("bytes -/") + 3 * DECIMAL_STR_MAX(uint64_t)];
+
+                xsprintf(range, "bytes %" PRIu64 "-%" PRIu64 "/%" PRIu64, offset, (uint64_t) st.st_size - 1, (uint64_t) st.st_size);
+                MHD_add_response_header(response, "Content-Range", range);
+
+                return MHD_queue_response(connection, MHD_HTTP_PARTIAL_CONTENT, response);
+        }
+
+        return MHD_queue_response(connection, MHD_HTTP_OK, response);
+}
+
 static int get_virtualization(char **v) {
         _cleanup_(sd_bus_unrefp) sd_bus *bus = NULL;
         char *b = NULL;
@@ -844,6 +1084,12 @@ static int request_handler(
         if (streq(url, "/machine"))
                 return request_handler_machine(connection, *connection_cls);
 
+        if (streq(url, "/files"))
+                return request_handler_files_list(connection);
+
+        if (startswith(url, "/files/"))
+                return request_handler_files_get(connection, url + 7);
+
         return mhd_respond(connection, MHD_HTTP_NOT_FOUND, "Not found.");
 }
 
@@ -39,6 +39,7 @@ static char** arg_gnutls_log = NULL;
 
 static JournalWriteSplitMode arg_split_mode = _JOURNAL_WRITE_SPLIT_INVALID;
 static const char* arg_output = NULL;
+static unsigned arg_threads = 0;
 
 static char *arg_key = NULL;
 static char *arg_cert = NULL;
@@ -146,7 +147,7 @@ static int dispatch_http_event(sd_event_source *event,
                                uint32_t revents,
                                void *userdata);
 
-static int request_meta(void **connection_cls, int fd, char *hostname) {
+static int request_meta(void **connection_cls, int fd, char *hostname, bool binary, bool compressed) {
         RemoteSource *source;
         Writer *writer;
         int r;
@@ -166,6 +167,17 @@ static int request_meta(void **connection_cls, int fd, char *hostname) {
                 return log_oom();
         }
 
+        source->importer.binary = binary;
+
+        if (compressed) {
+                r = journal_importer_set_compressed(&source->importer);
+                if (r < 0) {
+                        source->importer.name = NULL; /* the caller still owns the hostname */
+                        source_free(source);
+                        return r;
+                }
+        }
+
         log_debug("Added RemoteSource as connection metadata %p", source);
 
         *connection_cls = source;
@@ -265,7 +277,7 @@ static int request_handler(
         const char *header;
         int r, code, fd;
         _cleanup_free_ char *hostname = NULL;
-        bool chunked = false;
+        bool chunked = false, binary = false, compressed = false;
 
         assert(connection);
         assert(connection_cls);
@@ -286,9 +298,21 @@ static int request_handler(
                 return mhd_respond(connection, MHD_HTTP_NOT_FOUND, "Not found.");
 
         header = MHD_lookup_connection_value(connection, MHD_HEADER_KIND, "Content-Type");
-        if (!header || !streq(header, "application/vnd.fdo.journal"))
+        if (streq_ptr(header, "application/vnd.fdo.journal.binary"))
+                binary = true;
+        else if (!streq_ptr(header, "application/vnd.fdo.journal"))
                 return mhd_respond(connection, MHD_HTTP_UNSUPPORTED_MEDIA_TYPE,
-                                   "Content-Type: application/vnd.fdo.journal is required.");
+                                   "Content-Type: application/vnd.fdo.journal or "
+                                   "application/vnd.fdo.journal.binary is required.");
+
+        header = MHD_lookup_connection_value(connection, MHD_HEADER_KIND, "Content-Encoding");
+        if (header && !strcaseeq(header, "identity")) {
+                if (!HAVE_ZSTD || !strcaseeq(header, "zstd"))
+                        return mhd_respondf(connection, 0, MHD_HTTP_UNSUPPORTED_MEDIA_TYPE,
+                                            "Unsupported Content-Encoding type: %s", header);
+
+                compressed = true;
+        }
 
         header = MHD_lookup_connection_value(connection, MHD_HEADER_KIND, "Transfer-Encoding");
         if (header) {
@@ -348,7 +372,7 @@ static int request_handler(
 
         assert(hostname);
 
-        r = request_meta(connection_cls, fd, hostname);
+        r = request_meta(connection_cls, fd, hostname, binary, compressed);
         if (r == -ENOMEM)
                 return respond_oom(connection);
         else if (r < 0)
@@ -603,6 +627,11 @@ static int create_remoteserver(
         if (r < 0)
                 return log_error_errno(r, "Failed to set up signals: %m");
 
+        /* Started after the signals are blocked, so that the threads inherit the mask */
+        r = journal_remote_start_workers(s, arg_threads);
+        if (r < 0)
+                return r;
+
         n = sd_listen_fds(true);
         if (n < 0)
                 return log_error_errno(n, "Failed to read listening file descriptors from environment: %m");
@@ -632,7 +661,7 @@ static int create_remoteserver(
 
                         log_debug("Received a connection socket (fd:%d) from %s", fd, hostname);
 
-                        r = journal_remote_add_source(s, fd, hostname, true);
+                        r = journal_remote_add_connection(s, fd, hostname);
                 } else
                         return log_error_errno(SYNTHETIC_ERRNO(EINVAL),
                                                "Unknown socket passed on fd:%d", fd);
@@ -758,6 +787,7 @@ static int parse_config(void) {
                 { "Remote",  "ServerKeyFile",          config_parse_path,             0, &arg_key        },
                 { "Remote",  "ServerCertificateFile",  config_parse_path,             0, &arg_cert       },
                 { "Remote",  "TrustedCertificateFile", config_parse_path,             0, &arg_trust      },
+                { "Remote",  "Threads",                config_parse_unsigned,         0, &arg_threads    },
                 {}
         };
 
@@ -796,6 +826,8 @@ static int help(void) {
                "     --gnutls-log=CATEGORY...\n"
                "                            Specify a list of gnutls logging categories\n"
                "     --split-mode=none|host How many output files to create\n"
+               "     --threads=N            Number of threads to receive raw connections with\n"
+               "                            (default: 0, i.e. the main thread)\n"
                "\nNote: file descriptors from sd_listen_fds() will be consumed, too.\n"
                "\nSee the %s for details.\n"
                , program_invocation_short_name
@@ -820,6 +852,7 @@ static int parse_argv(int argc, char *argv[]) {
                 ARG_CERT,
                 ARG_TRUST,
                 ARG_GNUTLS_LOG,
+                ARG_THREADS,
         };
 
         static const struct option options[] = {
@@ -838,6 +871,7 @@ static int parse_argv(int argc, char *argv[]) {
                 { "cert",         required_argument, NULL, ARG_CERT         },
                 { "trust",        required_argument, NULL, ARG_TRUST        },
                 { "gnutls-log",   required_argument, NULL, ARG_GNUTLS_LOG   },
+                { "threads",      required_argument, NULL, ARG_THREADS      },
                 {}
         };
 
@@ -962,6 +996,12 @@ static int parse_argv(int argc, char *argv[]) {
                                                        "Invalid split mode: %s", optarg);
                         break;
 
+                case ARG_THREADS:
+                        r = safe_atou(optarg, &arg_threads);
+                        if (r < 0)
+                                return log_error_errno(r, "Failed to parse --threads= parameter: %s", optarg);
+                        break;
+
                 case ARG_COMPRESS:
                         if (optarg) {
                                 r = parse_boolean(optarg);
@@ -1060,6 +1100,10 @@ static int parse_argv(int argc, char *argv[]) {
                 return log_error_errno(SYNTHETIC_ERRNO(EINVAL),
                                        "For SplitMode=host, output must be a directory.");
 
+        if (arg_threads > 0 && arg_split_mode != JOURNAL_WRITE_SPLIT_HOST)
+                return log_error_errno(SYNTHETIC_ERRNO(EINVAL),
+                                       "Threads= requires SplitMode=host.");
+
         log_debug("Full config: SplitMode=%s Key=%s Cert=%s Trust=%s",
                   journal_write_split_mode_to_string(arg_split_mode),
                   strna(arg_key),
@@ -1159,6 +1203,9 @@ static int run(int argc, char **argv) {
                         return log_error_errno(r, "Failed to run event loop: %m");
         }
 
+        /* Let the workers finish their sources, so that their entries are counted */
+        journal_remote_stop_workers(&s);
+
         notify_message = NULL;
         (void) sd_notifyf(false,
                           "STOPPING=1\n"
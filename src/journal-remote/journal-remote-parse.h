@@ -10,6 +10,7 @@ typedef struct RemoteSource {
         JournalImporter importer;
 
         Writer *writer;
+        RemoteServer *server;
 
         sd_event_source *event;
         sd_event_source *buffer_event;
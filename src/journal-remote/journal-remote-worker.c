@@ -0,0 +1,232 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+
+#include "alloc-util.h"
+#include "fd-util.h"
+#include "io-util.h"
+#include "journal-remote-worker.h"
+#include "journal-remote.h"
+#include "stdio-util.h"
+
+typedef struct PendingSource {
+        int fd;
+        char *name;
+} PendingSource;
+
+struct RemoteWorker {
+        /* Only ever touched by the worker thread, except for the event count after the thread exited */
+        RemoteServer server;
+        sd_event_source *queue_event;
+
+        const RemoteServer *parent;
+        unsigned index;
+
+        pthread_t thread;
+        bool running;
+
+        /* Wakes up the worker */
+        int event_fd;
+
+        /* Protected by the mutex */
+        pthread_mutex_t mutex;
+        pthread_cond_t cond;
+        PendingSource *queue;
+        size_t n_queue, n_queue_allocated;
+        bool started;
+        int start_result;
+        bool dead;
+};
+
+static void pending_sources_free(PendingSource *queue, size_t n) {
+        size_t i;
+
+        for (i = 0; i < n; i++) {
+                safe_close(queue[i].fd);
+                free(queue[i].name);
+        }
+
+        free(queue);
+}
+
+static int dispatch_queue(sd_event_source *event, int fd, uint32_t revents, void *userdata) {
+        RemoteWorker *w = userdata;
+        PendingSource *queue;
+        size_t n, i;
+        bool dead;
+
+        assert(w);
+
+        (void) flush_fd(fd);
+
+        assert_se(pthread_mutex_lock(&w->mutex) == 0);
+        queue = TAKE_PTR(w->queue);
+        n = w->n_queue;
+        w->n_queue = w->n_queue_allocated = 0;
+        dead = w->dead;
+        assert_se(pthread_mutex_unlock(&w->mutex) == 0);
+
+        if (dead) {
+                pending_sources_free(queue, n);
+                return sd_event_exit(w->server.events, 0);
+        }
+
+        for (i = 0; i < n; i++) {
+                int r;
+
+                /* This takes ownership of the name */
+                r = journal_remote_add_source(&w->server, queue[i].fd, queue[i].name, true);
+                if (r < 0)
+                        log_warning_errno(r, "Worker %u failed to add source for fd:%d, ignoring: %m",
+                                          w->index, queue[i].fd);
+        }
+
+        free(queue);
+        return 0;
+}
+
+static void* worker_thread(void *userdata) {
+        RemoteWorker *w = userdata;
+        char name[STRLEN("remote-") + DECIMAL_STR_MAX(unsigned)];
+        int r;
+
+        xsprintf(name, "remote-%u", w->index);
+        (void) pthread_setname_np(pthread_self(), name);
+
+        /* Everything the worker owns is allocated and freed in this thread, as hashmaps allocated by the main
+         * thread must not be freed elsewhere. */
+        r = journal_remote_server_init_worker(&w->server, w->parent);
+        if (r >= 0) {
+                r = sd_event_add_io(w->server.events, &w->queue_event, w->event_fd, EPOLLIN, dispatch_queue, w);
+                if (r < 0)
+                        log_error_errno(r, "Failed to watch worker queue: %m");
+        }
+
+        assert_se(pthread_mutex_lock(&w->mutex) == 0);
+        w->started = true;
+        w->start_result = r;
+        assert_se(pthread_cond_signal(&w->cond) == 0);
+        assert_se(pthread_mutex_unlock(&w->mutex) == 0);
+
+        if (r >= 0) {
+                r = sd_event_loop(w->server.events);
+                if (r < 0)
+                        log_error_errno(r, "Event loop of worker %u failed: %m", w->index);
+        }
+
+        w->queue_event = sd_event_source_unref(w->queue_event);
+        journal_remote_server_destroy(&w->server);
+
+        return NULL;
+}
+
+int journal_remote_worker_new(const RemoteServer *parent, unsigned index, RemoteWorker **ret) {
+        _cleanup_(journal_remote_worker_freep) RemoteWorker *w = NULL;
+        int r;
+
+        assert(parent);
+        assert(ret);
+
+        w = new(RemoteWorker, 1);
+        if (!w)
+                return log_oom();
+
+        *w = (RemoteWorker) {
+                .parent = parent,
+                .index = index,
+                .event_fd = -1,
+                .mutex = PTHREAD_MUTEX_INITIALIZER,
+                .cond = PTHREAD_COND_INITIALIZER,
+        };
+
+        w->event_fd = eventfd(0, EFD_CLOEXEC|EFD_NONBLOCK);
+        if (w->event_fd < 0)
+                return log_error_errno(errno, "Failed to allocate event fd: %m");
+
+        r = pthread_create(&w->thread, NULL, worker_thread, w);
+        if (r > 0)
+                return log_error_errno(r, "Failed to start worker thread: %m");
+
+        w->running = true;
+
+        assert_se(pthread_mutex_lock(&w->mutex) == 0);
+        while (!w->started)
+                assert_se(pthread_cond_wait(&w->cond, &w->mutex) == 0);
+        r = w->start_result;
+        assert_se(pthread_mutex_unlock(&w->mutex) == 0);
+
+        if (r < 0)
+                return r;
+
+        *ret = TAKE_PTR(w);
+        return 0;
+}
+
+static void worker_wake_up(RemoteWorker *w) {
+        assert(w);
+
+        if (eventfd_write(w->event_fd, 1) < 0)
+                log_warning_errno(errno, "Failed to wake up worker %u, ignoring: %m", w->index);
+}
+
+uint64_t journal_remote_worker_stop(RemoteWorker *w) {
+        assert(w);
+
+        if (w->running) {
+                assert_se(pthread_mutex_lock(&w->mutex) == 0);
+                w->dead = true;
+                assert_se(pthread_mutex_unlock(&w->mutex) == 0);
+
+                worker_wake_up(w);
+
+                (void) pthread_join(w->thread, NULL);
+                w->running = false;
+        }
+
+        return w->server.event_count;
+}
+
+RemoteWorker* journal_remote_worker_free(RemoteWorker *w) {
+        if (!w)
+                return NULL;
+
+        (void) journal_remote_worker_stop(w);
+
+        pending_sources_free(w->queue, w->n_queue);
+        safe_close(w->event_fd);
+
+        pthread_cond_destroy(&w->cond);
+        pthread_mutex_destroy(&w->mutex);
+
+        return mfree(w);
+}
+
+int journal_remote_worker_add_source(RemoteWorker *w, int fd, char *name) {
+        _cleanup_close_ int fd_ = fd;
+        _cleanup_free_ char *name_ = name;
+        int r = 0;
+
+        assert(w);
+        assert(fd >= 0);
+        assert(name);
+
+        assert_se(pthread_mutex_lock(&w->mutex) == 0);
+
+        if (!GREEDY_REALLOC(w->queue, w->n_queue_allocated, w->n_queue + 1))
+                r = log_oom();
+        else
+                w->queue[w->n_queue++] = (PendingSource) {
+                        .fd = TAKE_FD(fd_),
+                        .name = TAKE_PTR(name_),
+                };
+
+        assert_se(pthread_mutex_unlock(&w->mutex) == 0);
+
+        if (r < 0)
+                return r;
+
+        worker_wake_up(w);
+        return 0;
+}
@@ -0,0 +1,25 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+#pragma once
+
+#include <inttypes.h>
+
+#include "macro.h"
+
+typedef struct RemoteServer RemoteServer;
+
+/* A worker thread with an event loop, sources and writers of its own. Connections are handed to a worker by
+ * the main thread, and are then read, parsed and written out entirely in the worker. */
+
+typedef struct RemoteWorker RemoteWorker;
+
+int journal_remote_worker_new(const RemoteServer *parent, unsigned index, RemoteWorker **ret);
+
+RemoteWorker* journal_remote_worker_free(RemoteWorker *w);
+DEFINE_TRIVIAL_CLEANUP_FUNC(RemoteWorker*, journal_remote_worker_free);
+
+/* Takes ownership of fd and name, even on failure. */
+int journal_remote_worker_add_source(RemoteWorker *w, int fd, char *name);
+
+/* Stops the worker thread, after it closed all its sources and output files. Returns the number of entries
+ * the worker wrote. */
+uint64_t journal_remote_worker_stop(RemoteWorker *w);
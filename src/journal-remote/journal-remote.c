@@ -160,6 +160,8 @@ static int dispatch_raw_connection_event(sd_event_source *event,
                                          uint32_t revents,
                                          void *userdata);
 
+static RemoteWorker* pick_worker(RemoteServer *s, const char *host);
+
 static int get_source_for_fd(RemoteServer *s,
                              int fd, char *name, RemoteSource **source) {
         Writer *writer;
@@ -185,6 +187,7 @@ static int get_source_for_fd(RemoteServer *s,
                         return log_oom();
                 }
 
+                s->sources[fd]->server = s;
                 s->active++;
         }
 
@@ -269,6 +272,17 @@ int journal_remote_add_source(RemoteServer *s, int fd, char* name, bool own_name
         return r;
 }
 
+int journal_remote_add_connection(RemoteServer *s, int fd, char *hostname) {
+        assert(s);
+        assert(fd >= 0);
+        assert(hostname);
+
+        if (s->n_workers > 0)
+                return journal_remote_worker_add_source(pick_worker(s, hostname), fd, hostname);
+
+        return journal_remote_add_source(s, fd, hostname, true);
+}
+
 int journal_remote_add_raw_socket(RemoteServer *s, int fd) {
         int r;
         _cleanup_close_ int fd_ = fd;
@@ -335,6 +349,105 @@ int journal_remote_server_init(
         return 0;
 }
 
+int journal_remote_server_init_worker(RemoteServer *s, const RemoteServer *parent) {
+        int r;
+
+        assert(s);
+        assert(parent);
+
+        s->split_mode = parent->split_mode;
+        s->compress = parent->compress;
+        s->seal = parent->seal;
+        s->output = parent->output;
+
+        /* Not the default event loop, that one belongs to the main thread */
+        r = sd_event_new(&s->events);
+        if (r < 0)
+                return log_error_errno(r, "Failed to allocate event loop: %m");
+
+        r = init_writer_hashmap(s);
+        if (r < 0)
+                return r;
+
+        return 0;
+}
+
+int journal_remote_start_workers(RemoteServer *s, unsigned n_workers) {
+        unsigned i;
+        int r;
+
+        assert(s);
+        assert(s->n_workers == 0);
+
+        if (n_workers == 0)
+                return 0;
+
+        /* Writers are per host, so there is no way to share the one output file between threads */
+        if (s->split_mode != JOURNAL_WRITE_SPLIT_HOST)
+                return log_error_errno(SYNTHETIC_ERRNO(EINVAL),
+                                       "Worker threads require split mode \"host\".");
+
+        s->workers = new0(RemoteWorker*, n_workers);
+        if (!s->workers)
+                return log_oom();
+
+        s->worker_by_host = hashmap_new(&string_hash_ops);
+        if (!s->worker_by_host)
+                return log_oom();
+
+        for (i = 0; i < n_workers; i++) {
+                r = journal_remote_worker_new(s, i, s->workers + i);
+                if (r < 0)
+                        return r;
+
+                s->n_workers++;
+        }
+
+        log_debug("Started %u worker threads.", n_workers);
+        return 0;
+}
+
+void journal_remote_stop_workers(RemoteServer *s) {
+        size_t i;
+
+        assert(s);
+
+        for (i = 0; i < s->n_workers; i++) {
+                s->event_count += journal_remote_worker_stop(s->workers[i]);
+                journal_remote_worker_free(s->workers[i]);
+        }
+
+        s->workers = mfree(s->workers);
+        s->n_workers = s->next_worker = 0;
+        s->worker_by_host = hashmap_free_free_key(s->worker_by_host);
+}
+
+static RemoteWorker* pick_worker(RemoteServer *s, const char *host) {
+        _cleanup_free_ char *key = NULL;
+        RemoteWorker *w;
+
+        assert(s);
+        assert(s->n_workers > 0);
+        assert(host);
+
+        w = hashmap_get(s->worker_by_host, host);
+        if (w)
+                return w;
+
+        /* New hosts are distributed round-robin */
+        w = s->workers[s->next_worker];
+        s->next_worker = (s->next_worker + 1) % s->n_workers;
+
+        /* If we can't remember the choice, the next connection from the same host might end up with
+         * another worker, which then fails to open the output file that is locked by the first one. That's
+         * not worse than the OOM situation we are in anyway. */
+        key = strdup(host);
+        if (key && hashmap_put(s->worker_by_host, key, w) >= 0)
+                TAKE_PTR(key);
+
+        return w;
+}
+
 #if HAVE_MICROHTTPD
 static void MHDDaemonWrapper_free(MHDDaemonWrapper *d) {
         MHD_stop_daemon(d->daemon);
@@ -347,6 +460,8 @@ static void MHDDaemonWrapper_free(MHDDaemonWrapper *d) {
 void journal_remote_server_destroy(RemoteServer *s) {
         size_t i;
 
+        journal_remote_stop_workers(s);
+
 #if HAVE_MICROHTTPD
         hashmap_free_with_destructor(s->daemons, MHDDaemonWrapper_free);
 #endif
@@ -428,7 +543,7 @@ static int dispatch_raw_source_until_block(sd_event_source *event,
         /* Make sure event stays around even if source is destroyed */
         sd_event_source_ref(event);
 
-        r = journal_remote_handle_raw_source(event, source->importer.fd, EPOLLIN, journal_remote_server_global);
+        r = journal_remote_handle_raw_source(event, source->importer.fd, EPOLLIN, source->server);
         if (r != 1)
                 /* No more data for now */
                 sd_event_source_set_enabled(event, SD_EVENT_OFF);
@@ -448,7 +563,7 @@ static int dispatch_raw_source_event(sd_event_source *event,
         assert(source->event);
         assert(source->buffer_event);
 
-        r = journal_remote_handle_raw_source(event, fd, EPOLLIN, journal_remote_server_global);
+        r = journal_remote_handle_raw_source(event, fd, EPOLLIN, source->server);
         if (r == 1)
                 /* Might have more data. We need to rerun the handler
                  * until we are sure the buffer is exhausted. */
@@ -461,7 +576,7 @@ static int dispatch_blocking_source_event(sd_event_source *event,
                                           void *userdata) {
         RemoteSource *source = userdata;
 
-        return journal_remote_handle_raw_source(event, source->importer.fd, EPOLLIN, journal_remote_server_global);
+        return journal_remote_handle_raw_source(event, source->importer.fd, EPOLLIN, source->server);
 }
 
 static int accept_connection(
@@ -532,5 +647,5 @@ static int dispatch_raw_connection_event(
         if (fd2 < 0)
                 return fd2;
 
-        return journal_remote_add_source(s, fd2, hostname, true);
+        return journal_remote_add_connection(s, fd2, hostname);
 }
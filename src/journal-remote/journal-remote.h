@@ -5,6 +5,7 @@
 
 #include "hashmap.h"
 #include "journal-remote-parse.h"
+#include "journal-remote-worker.h"
 #include "journal-remote-write.h"
 
 #if HAVE_MICROHTTPD
@@ -36,6 +37,14 @@ struct RemoteServer {
 #if HAVE_MICROHTTPD
         Hashmap *daemons;
 #endif
+
+        /* Accepted raw connections are handed to the workers, if there are any. All connections from the
+         * same host go to the same worker, so that each output file is written by one thread only. */
+        RemoteWorker **workers;
+        size_t n_workers;
+        size_t next_worker;
+        Hashmap *worker_by_host;
+
         const char *output;                    /* either the output file or directory */
 
         JournalWriteSplitMode split_mode;
@@ -52,9 +61,20 @@ int journal_remote_server_init(
                 bool compress,
                 bool seal);
 
+/* Initializes the server of a worker thread, with the output settings of the parent */
+int journal_remote_server_init_worker(RemoteServer *s, const RemoteServer *parent);
+
+int journal_remote_start_workers(RemoteServer *s, unsigned n_workers);
+
+/* Stops all workers, adding the number of entries they wrote to the event count */
+void journal_remote_stop_workers(RemoteServer *s);
+
 int journal_remote_get_writer(RemoteServer *s, const char *host, Writer **writer);
 
 int journal_remote_add_source(RemoteServer *s, int fd, char* name, bool own_name);
+/* Like journal_remote_add_source(), but hands the connection to a worker thread, if there are any. Always
+ * takes ownership of hostname. */
+int journal_remote_add_connection(RemoteServer *s, int fd, char *hostname);
 int journal_remote_add_raw_socket(RemoteServer *s, int fd);
 int journal_remote_handle_raw_source(
                 sd_event_source *event,
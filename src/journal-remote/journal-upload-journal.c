@@ -3,15 +3,23 @@
 #include <curl/curl.h>
 #include <stdbool.h>
 
+#if HAVE_ZSTD
+#include <zstd.h>
+#endif
+
 #include "sd-daemon.h"
 
 #include "alloc-util.h"
 #include "journal-upload.h"
 #include "log.h"
+#include "memory-util.h"
+#include "stdio-util.h"
 #include "string-util.h"
 #include "utf8.h"
 #include "util.h"
 
+#define UPLOAD_STAGING_SIZE (64U*1024U)
+
 /**
  * Write up to size bytes to buf. Return negative on error, and number of
  * bytes written otherwise. The last case is a kind of an error too.
@@ -235,6 +243,207 @@ static ssize_t write_entry(char *buf, size_t size, Uploader *u) {
         assert_not_reached("WTF?");
 }
 
+static int put_frame_field(Uploader *u, uint8_t *p, const char *name, size_t name_len, size_t value_len, size_t *ret) {
+        _cleanup_free_ char *key = NULL;
+        uint8_t *start = p;
+        unsigned id;
+        int r;
+
+        assert(u);
+        assert(name_len > 0);
+
+        if (name_len > 64)
+                return log_error_errno(SYNTHETIC_ERRNO(EINVAL), "Invalid field.");
+
+        key = strndup(name, name_len);
+        if (!key)
+                return log_oom();
+
+        id = PTR_TO_UINT(hashmap_get(u->field_ids, key));
+        if (id > 0)
+                p += journal_binary_put_varint(p, JOURNAL_BINARY_FIELD_FIRST_REF + id - 1);
+        else {
+                p += journal_binary_put_varint(p, JOURNAL_BINARY_FIELD_NEW);
+                p += journal_binary_put_varint(p, name_len);
+                p = mempcpy(p, name, name_len);
+
+                /* The receiver adds names in the same order, up to the same limit */
+                if (hashmap_size(u->field_ids) < JOURNAL_BINARY_FIELD_NAMES_MAX) {
+                        r = hashmap_ensure_allocated(&u->field_ids, &string_hash_ops);
+                        if (r < 0)
+                                return log_oom();
+
+                        r = hashmap_put(u->field_ids, key, UINT_TO_PTR(hashmap_size(u->field_ids) + 1));
+                        if (r < 0)
+                                return log_oom();
+
+                        TAKE_PTR(key);
+                }
+        }
+
+        p += journal_binary_put_varint(p, value_len);
+
+        *ret = p - start;
+        return 0;
+}
+
+static int put_frame_string(Uploader *u, const char *name, const char *value) {
+        size_t n, l;
+        int r;
+
+        assert(u);
+
+        l = strlen(value);
+        assert(u->frame_length + 3 * VARINT_SIZE_MAX + strlen(name) + l <= sizeof(u->frame));
+
+        r = put_frame_field(u, u->frame + u->frame_length, name, strlen(name), l, &n);
+        if (r < 0)
+                return r;
+
+        u->frame_length += n;
+        memcpy(u->frame + u->frame_length, value, l);
+        u->frame_length += l;
+
+        return 0;
+}
+
+static bool copy_out(char *buf, size_t size, size_t *pos, const void *data, size_t length, size_t *data_pos) {
+        size_t n;
+
+        /* Copies as much as fits, and returns true if everything was copied. */
+
+        n = MIN(size - *pos, length - *data_pos);
+        memcpy_safe(buf + *pos, (const uint8_t*) data + *data_pos, n);
+        *pos += n;
+        *data_pos += n;
+
+        return *data_pos == length;
+}
+
+/**
+ * Like write_entry(), but for the binary framing. The fields of the entry header are encoded in one go,
+ * and the other fields as a header followed by the value, each of which may span calls.
+ */
+static ssize_t write_entry_binary(char *buf, size_t size, Uploader *u) {
+        size_t pos = 0;
+        int r;
+
+        assert(size <= SSIZE_MAX);
+
+        for (;;) {
+
+                switch(u->entry_state) {
+                case ENTRY_CURSOR:
+                case ENTRY_REALTIME:
+                case ENTRY_MONOTONIC:
+                case ENTRY_BOOT_ID: {
+                        char sid[SD_ID128_STRING_MAX], t[DECIMAL_STR_MAX(usec_t)];
+                        usec_t realtime, monotonic;
+                        sd_id128_t boot_id;
+
+                        /* The receiver ignores the cursor, hence it is not sent. We still need it for
+                         * the state file. */
+                        u->current_cursor = mfree(u->current_cursor);
+
+                        r = sd_journal_get_cursor(u->journal, &u->current_cursor);
+                        if (r < 0)
+                                return log_error_errno(r, "Failed to get cursor: %m");
+
+                        r = sd_journal_get_realtime_usec(u->journal, &realtime);
+                        if (r < 0)
+                                return log_error_errno(r, "Failed to get realtime timestamp: %m");
+
+                        r = sd_journal_get_monotonic_usec(u->journal, &monotonic, &boot_id);
+                        if (r < 0)
+                                return log_error_errno(r, "Failed to get monotonic timestamp: %m");
+
+                        u->frame_length = u->frame_pos = 0;
+
+                        xsprintf(t, USEC_FMT, realtime);
+                        r = put_frame_string(u, "__REALTIME_TIMESTAMP", t);
+                        if (r < 0)
+                                return r;
+
+                        xsprintf(t, USEC_FMT, monotonic);
+                        r = put_frame_string(u, "__MONOTONIC_TIMESTAMP", t);
+                        if (r < 0)
+                                return r;
+
+                        r = put_frame_string(u, "_BOOT_ID", sd_id128_to_string(boot_id, sid));
+                        if (r < 0)
+                                return r;
+
+                        /* There is no value following these */
+                        u->field_pos = u->field_length = 0;
+                        u->entry_state = ENTRY_FRAME_HEADER;
+                        continue;
+                }
+
+                case ENTRY_NEW_FIELD: {
+                        const char *c;
+                        size_t len;
+
+                        r = sd_journal_enumerate_data(u->journal,
+                                                      &u->field_data,
+                                                      &u->field_length);
+                        if (r < 0)
+                                return log_error_errno(r, "Failed to move to next field in entry: %m");
+                        else if (r == 0) {
+                                u->entry_state = ENTRY_OUTRO;
+                                continue;
+                        }
+
+                        /* Sent in the header already */
+                        if (memory_startswith(u->field_data, u->field_length, "_BOOT_ID="))
+                                continue;
+
+                        c = memchr(u->field_data, '=', u->field_length);
+                        if (!c || c == u->field_data)
+                                return log_error_errno(SYNTHETIC_ERRNO(EINVAL),
+                                                       "Invalid field.");
+
+                        len = c - (const char*) u->field_data;
+
+                        r = put_frame_field(u, u->frame, u->field_data, len, u->field_length - len - 1,
+                                            &u->frame_length);
+                        if (r < 0)
+                                return r;
+
+                        u->frame_pos = 0;
+                        u->field_pos = len + 1;
+                        u->entry_state = ENTRY_FRAME_HEADER;
+                }
+                        _fallthrough_;
+                case ENTRY_FRAME_HEADER:
+                        if (!copy_out(buf, size, &pos, u->frame, u->frame_length, &u->frame_pos))
+                                return size;
+
+                        u->entry_state = ENTRY_FRAME_VALUE;
+                        _fallthrough_;
+                case ENTRY_FRAME_VALUE:
+                        if (!copy_out(buf, size, &pos, u->field_data, u->field_length, &u->field_pos))
+                                return size;
+
+                        u->entry_state = ENTRY_NEW_FIELD;
+                        continue;
+
+                case ENTRY_OUTRO:
+                        if (size - pos < 1)
+                                return pos;
+
+                        buf[pos++] = JOURNAL_BINARY_FIELD_END;
+                        u->entry_state = ENTRY_DONE;
+                        u->entries_sent++;
+
+                        return pos;
+
+                default:
+                        assert_not_reached("WTF?");
+                }
+        }
+        assert_not_reached("WTF?");
+}
+
 static void check_update_watchdog(Uploader *u) {
         usec_t after;
         usec_t elapsed_time;
@@ -251,21 +460,17 @@ static void check_update_watchdog(Uploader *u) {
         }
 }
 
-static size_t journal_input_callback(void *buf, size_t size, size_t nmemb, void *userp) {
-        Uploader *u = userp;
+static size_t fill_entries(Uploader *u, char *buf, size_t size) {
         int r;
         sd_journal *j;
         size_t filled = 0;
         ssize_t w;
 
         assert(u);
-        assert(nmemb <= SSIZE_MAX / size);
-
-        check_update_watchdog(u);
 
         j = u->journal;
 
-        while (j && filled < size * nmemb) {
+        while (j && filled < size) {
                 if (u->entry_state == ENTRY_DONE) {
                         r = sd_journal_next(j);
                         if (r < 0) {
@@ -287,7 +492,10 @@ static size_t journal_input_callback(void *buf, size_t size, size_t nmemb, void
                         u->entry_state = ENTRY_CURSOR;
                 }
 
-                w = write_entry((char*)buf + filled, size * nmemb - filled, u);
+                if (u->format == UPLOAD_FORMAT_BINARY)
+                        w = write_entry_binary(buf + filled, size - filled, u);
+                else
+                        w = write_entry(buf + filled, size - filled, u);
                 if (w < 0)
                         return CURL_READFUNC_ABORT;
                 filled += w;
@@ -306,6 +514,121 @@ static size_t journal_input_callback(void *buf, size_t size, size_t nmemb, void
         return filled;
 }
 
+#if HAVE_ZSTD
+static size_t fill_compressed(Uploader *u, char *buf, size_t size) {
+        ZSTD_outBuffer output = {
+                .dst = buf,
+                .size = size,
+        };
+
+        assert(u);
+
+        /* Entries are written to the staging buffer first, and compressed from there into the buffer of
+         * curl. Each upload is one zstd frame, which is ended when there are no more entries. */
+
+        if (u->frame_ended) {
+                u->frame_ended = false;
+                return 0;
+        }
+
+        if (!u->cctx) {
+                u->cctx = ZSTD_createCCtx();
+                if (!u->cctx) {
+                        log_oom();
+                        return CURL_READFUNC_ABORT;
+                }
+        }
+
+        if (!u->staging) {
+                u->staging = malloc(UPLOAD_STAGING_SIZE);
+                if (!u->staging) {
+                        log_oom();
+                        return CURL_READFUNC_ABORT;
+                }
+        }
+
+        while (output.pos < output.size) {
+                ZSTD_inBuffer input;
+                size_t k;
+
+                if (u->staging_pos >= u->staging_filled && !u->frame_ending) {
+                        k = fill_entries(u, u->staging, UPLOAD_STAGING_SIZE);
+                        if (k == CURL_READFUNC_ABORT)
+                                return k;
+
+                        u->staging_pos = 0;
+                        u->staging_filled = k;
+                        u->frame_ending = k == 0;
+                }
+
+                input = (ZSTD_inBuffer) {
+                        .src = u->staging,
+                        .size = u->staging_filled,
+                        .pos = u->staging_pos,
+                };
+
+                k = ZSTD_compressStream2(u->cctx, &output, &input,
+                                         u->frame_ending ? ZSTD_e_end : ZSTD_e_continue);
+                if (ZSTD_isError(k)) {
+                        log_error("Failed to compress entries: %s", ZSTD_getErrorName(k));
+                        return CURL_READFUNC_ABORT;
+                }
+
+                u->staging_pos = input.pos;
+
+                if (u->frame_ending && k == 0) {
+                        /* The frame is complete, the upload ends with the next call */
+                        u->frame_ending = false;
+                        u->frame_ended = output.pos > 0;
+                        break;
+                }
+        }
+
+        return output.pos;
+}
+#endif
+
+static size_t journal_input_callback(void *buf, size_t size, size_t nmemb, void *userp) {
+        Uploader *u = userp;
+
+        assert(u);
+        assert(nmemb <= SSIZE_MAX / size);
+
+        check_update_watchdog(u);
+
+#if HAVE_ZSTD
+        if (u->compress)
+                return fill_compressed(u, buf, size * nmemb);
+#endif
+
+        return fill_entries(u, buf, size * nmemb);
+}
+
+void free_journal_upload_state(Uploader *u) {
+        assert(u);
+
+        u->field_ids = hashmap_free_free_key(u->field_ids);
+        u->staging = mfree(u->staging);
+#if HAVE_ZSTD
+        ZSTD_freeCCtx(u->cctx);
+        u->cctx = NULL;
+#endif
+}
+
+static void reset_journal_upload_state(Uploader *u) {
+        assert(u);
+
+        /* Each upload is a stream of its own, with its own dictionary and compression frame */
+        hashmap_clear_free_key(u->field_ids);
+
+        u->staging_pos = u->staging_filled = 0;
+        u->frame_ending = u->frame_ended = false;
+#if HAVE_ZSTD
+        if (u->cctx)
+                (void) ZSTD_CCtx_reset(u->cctx, ZSTD_reset_session_only);
+#endif
+}
+
 void close_journal_input(Uploader *u) {
         assert(u);
 
@@ -332,6 +655,7 @@ static int process_journal_input(Uploader *u, int skip) {
 
         /* have data */
         u->entry_state = ENTRY_CURSOR;
+        reset_journal_upload_state(u);
         return start_upload(u, journal_input_callback, u);
 }
 
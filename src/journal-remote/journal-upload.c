@@ -28,6 +28,7 @@
 #include "rlimit-util.h"
 #include "sigbus.h"
 #include "signal-util.h"
+#include "string-table.h"
 #include "string-util.h"
 #include "strv.h"
 #include "tmpfile-util.h"
@@ -51,6 +52,8 @@ static const char *arg_machine = NULL;
 static bool arg_merge = false;
 static int arg_follow = -1;
 static const char *arg_save_state = NULL;
+static UploadFormat arg_format = UPLOAD_FORMAT_EXPORT;
+static bool arg_compress = false;
 
 static void close_fd_input(Uploader *u);
 
@@ -58,6 +61,17 @@ static void close_fd_input(Uploader *u);
 
 #define STATE_FILE "/var/lib/systemd/journal-upload/state"
 
+static const char* const upload_format_table[_UPLOAD_FORMAT_MAX] = {
+        [UPLOAD_FORMAT_EXPORT] = "export",
+        [UPLOAD_FORMAT_BINARY] = "binary",
+};
+
+DEFINE_PRIVATE_STRING_TABLE_LOOKUP(upload_format, UploadFormat);
+static DEFINE_CONFIG_PARSE_ENUM(config_parse_upload_format,
+                                upload_format,
+                                UploadFormat,
+                                "Failed to parse upload format setting");
+
 #define easy_setopt(curl, opt, value, level, cmd)                       \
         do {                                                            \
                 code = curl_easy_setopt(curl, opt, value);              \
@@ -180,10 +194,21 @@ int start_upload(Uploader *u,
         if (!u->header) {
                 struct curl_slist *h;
 
-                h = curl_slist_append(NULL, "Content-Type: application/vnd.fdo.journal");
+                h = curl_slist_append(NULL,
+                                      u->format == UPLOAD_FORMAT_BINARY ?
+                                      "Content-Type: application/vnd.fdo.journal.binary" :
+                                      "Content-Type: application/vnd.fdo.journal");
                 if (!h)
                         return log_oom();
 
+                if (u->compress) {
+                        h = curl_slist_append(h, "Content-Encoding: zstd");
+                        if (!h) {
+                                curl_slist_free_all(h);
+                                return log_oom();
+                        }
+                }
+
                 h = curl_slist_append(h, "Transfer-Encoding: chunked");
                 if (!h) {
                         curl_slist_free_all(h);
@@ -462,6 +487,8 @@ static void destroy_uploader(Uploader *u) {
         free(u->last_cursor);
         free(u->current_cursor);
 
+        free_journal_upload_state(u);
+
         free(u->url);
 
         u->input_event = sd_event_source_unref(u->input_event);
@@ -498,7 +525,12 @@ static int perform_upload(Uploader *u) {
                                        "Failed to retrieve response code: %s",
                                        curl_easy_strerror(code));
 
-        if (status >= 300)
+        if (status == 415 && (u->format != UPLOAD_FORMAT_EXPORT || u->compress))
+                return log_error_errno(SYNTHETIC_ERRNO(EPROTONOSUPPORT),
+                                       "Upload to %s failed with code %ld, the server does not support "
+                                       "the binary format or compression, try --format=export --compress=no: %s",
+                                       u->url, status, strna(u->answer));
+        else if (status >= 300)
                 return log_error_errno(SYNTHETIC_ERRNO(EIO),
                                        "Upload to %s failed with code %ld: %s",
                                        u->url, status, strna(u->answer));
@@ -521,6 +553,8 @@ static int parse_config(void) {
                 { "Upload",  "ServerKeyFile",          config_parse_path,   0, &arg_key    },
                 { "Upload",  "ServerCertificateFile",  config_parse_path,   0, &arg_cert   },
                 { "Upload",  "TrustedCertificateFile", config_parse_path,   0, &arg_trust  },
+                { "Upload",  "Format",                 config_parse_upload_format, 0, &arg_format },
+                { "Upload",  "Compress",               config_parse_bool,   0, &arg_compress },
                 {}};
 
         return config_parse_many_nulstr(PKGSYSCONFDIR "/journal-upload.conf",
@@ -560,6 +594,9 @@ static int help(void) {
                "     --follow[=BOOL]        Do [not] wait for input\n"
                "     --save-state[=FILE]    Save uploaded cursors (default \n"
                "                            " STATE_FILE ")\n"
+               "     --format=export|binary Upload in the export format or the compact binary\n"
+               "                            framing\n"
+               "     --compress[=BOOL]      Compress the upload with zstd\n"
                "\nSee the %s for details.\n"
                , program_invocation_short_name
                , link
@@ -581,6 +618,8 @@ static int parse_argv(int argc, char *argv[]) {
                 ARG_AFTER_CURSOR,
                 ARG_FOLLOW,
                 ARG_SAVE_STATE,
+                ARG_FORMAT,
+                ARG_COMPRESS,
         };
 
         static const struct option options[] = {
@@ -600,6 +639,8 @@ static int parse_argv(int argc, char *argv[]) {
                 { "after-cursor", required_argument, NULL, ARG_AFTER_CURSOR   },
                 { "follow",       optional_argument, NULL, ARG_FOLLOW         },
                 { "save-state",   optional_argument, NULL, ARG_SAVE_STATE     },
+                { "format",       required_argument, NULL, ARG_FORMAT         },
+                { "compress",     optional_argument, NULL, ARG_COMPRESS       },
                 {}
         };
 
@@ -718,6 +759,26 @@ static int parse_argv(int argc, char *argv[]) {
                         arg_save_state = optarg ?: STATE_FILE;
                         break;
 
+                case ARG_FORMAT:
+                        arg_format = upload_format_from_string(optarg);
+                        if (arg_format < 0)
+                                return log_error_errno(SYNTHETIC_ERRNO(EINVAL),
+                                                       "Invalid upload format: %s", optarg);
+                        break;
+
+                case ARG_COMPRESS:
+                        if (optarg) {
+                                r = parse_boolean(optarg);
+                                if (r < 0)
+                                        return log_error_errno(SYNTHETIC_ERRNO(EINVAL),
+                                                               "Failed to parse --compress= parameter.");
+
+                                arg_compress = !!r;
+                        } else
+                                arg_compress = true;
+
+                        break;
+
                 case '?':
                         return log_error_errno(SYNTHETIC_ERRNO(EINVAL),
                                                "Unknown option %s.",
@@ -744,6 +805,10 @@ static int parse_argv(int argc, char *argv[]) {
                 return log_error_errno(SYNTHETIC_ERRNO(EINVAL),
                                        "Input arguments make no sense with journal input.");
 
+        if (arg_compress && !HAVE_ZSTD)
+                return log_error_errno(SYNTHETIC_ERRNO(EOPNOTSUPP),
+                                       "Compression requires zstd support.");
+
         return 1;
 }
 
@@ -802,6 +867,11 @@ static int run(int argc, char **argv) {
         use_journal = optind >= argc;
         if (use_journal) {
                 sd_journal *j;
+
+                /* Files are uploaded as they are, these only apply to the entries we serialize ourselves */
+                u.format = arg_format;
+                u.compress = arg_compress;
+
                 r = open_journal(&j);
                 if (r < 0)
                         return r;
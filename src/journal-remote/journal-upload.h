@@ -5,8 +5,19 @@
 #include "sd-event.h"
 #include "sd-journal.h"
 
+#include "hashmap.h"
+#include "journal-importer.h"
 #include "time-util.h"
 
+struct ZSTD_CCtx_s;
+
+typedef enum UploadFormat {
+        UPLOAD_FORMAT_EXPORT,       /* The journal export format */
+        UPLOAD_FORMAT_BINARY,       /* The compact binary framing */
+        _UPLOAD_FORMAT_MAX,
+        _UPLOAD_FORMAT_INVALID = -1,
+} UploadFormat;
+
 typedef enum {
         ENTRY_CURSOR = 0,           /* Nothing actually written yet. */
         ENTRY_REALTIME,
@@ -17,6 +28,8 @@ typedef enum {
         ENTRY_BINARY_FIELD_START,   /* Writing the name of a binary field. */
         ENTRY_BINARY_FIELD_SIZE,    /* Writing the size of a binary field. */
         ENTRY_BINARY_FIELD,         /* In the middle of a binary field. */
+        ENTRY_FRAME_HEADER,         /* Writing the header of a field in the binary framing. */
+        ENTRY_FRAME_VALUE,          /* Writing the value of a field in the binary framing. */
         ENTRY_OUTRO,                /* Writing '\n' */
         ENTRY_DONE,                 /* Need to move to a new field. */
 } entry_state;
@@ -41,10 +54,23 @@ typedef struct Uploader {
         /* journal stuff */
         sd_journal* journal;
 
+        UploadFormat format;
         entry_state entry_state;
         const void *field_data;
         size_t field_pos, field_length;
 
+        /* binary framing: the field names sent in this upload, and the encoded field header */
+        Hashmap *field_ids;
+        uint8_t frame[256];
+        size_t frame_pos, frame_length;
+
+        /* compression: the uncompressed data that is not consumed by the compressor yet */
+        bool compress;
+        struct ZSTD_CCtx_s *cctx;
+        char *staging;
+        size_t staging_pos, staging_filled;
+        bool frame_ending, frame_ended;
+
         /* general metrics */
         const char *state_file;
 
@@ -69,4 +95,5 @@ int open_journal_for_upload(Uploader *u,
                             bool after_cursor,
                             bool follow);
 void close_journal_input(Uploader *u);
+void free_journal_upload_state(Uploader *u);
 int check_journal_input(Uploader *u);
@@ -43,6 +43,11 @@
 #  define MHD_HTTP_PAYLOAD_TOO_LARGE MHD_HTTP_REQUEST_ENTITY_TOO_LARGE
 #endif
 
+/* Renamed in µhttpd 0.9.64 */
+#ifndef MHD_HTTP_RANGE_NOT_SATISFIABLE
+#  define MHD_HTTP_RANGE_NOT_SATISFIABLE MHD_HTTP_REQUESTED_RANGE_NOT_SATISFIABLE
+#endif
+
 #if MHD_VERSION < 0x00094203
 #  define MHD_create_response_from_fd_at_offset64 MHD_create_response_from_fd_at_offset
 #endif
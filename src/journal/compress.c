@@ -16,6 +16,12 @@
 #include <lz4frame.h>
 #endif
 
+#if HAVE_ZSTD
+#include <zdict.h>
+#include <zstd.h>
+#include <zstd_errors.h>
+#endif
+
 #include "alloc-util.h"
 #include "compress.h"
 #include "fd-util.h"
@@ -33,11 +39,42 @@ DEFINE_TRIVIAL_CLEANUP_FUNC(LZ4F_compressionContext_t, LZ4F_freeCompressionConte
 DEFINE_TRIVIAL_CLEANUP_FUNC(LZ4F_decompressionContext_t, LZ4F_freeDecompressionContext);
 #endif
 
+#if HAVE_ZSTD
+DEFINE_TRIVIAL_CLEANUP_FUNC(ZSTD_CCtx *, ZSTD_freeCCtx);
+DEFINE_TRIVIAL_CLEANUP_FUNC(ZSTD_DCtx *, ZSTD_freeDCtx);
+
+static int zstd_ret_to_errno(size_t ret) {
+        switch (ZSTD_getErrorCode(ret)) {
+        case ZSTD_error_dstSize_tooSmall:
+                return -ENOBUFS;
+        case ZSTD_error_memory_allocation:
+                return -ENOMEM;
+        case ZSTD_error_dictionary_wrong:
+                return -ENOKEY;
+        default:
+                return -EBADMSG;
+        }
+}
+
+struct CompressDictionary {
+        void *data;
+        size_t size;
+        uint32_t id;
+
+        /* Digested forms of the dictionary, populated on first use, as readers only need the
+         * decompression side and writers mostly the compression side. */
+        ZSTD_CDict *cdict;
+        ZSTD_DDict *ddict;
+        ZSTD_CCtx *cctx;
+};
+#endif
+
 #define ALIGN_8(l) ALIGN_TO(l, sizeof(size_t))
 
 static const char* const object_compressed_table[_OBJECT_COMPRESSED_MAX] = {
         [OBJECT_COMPRESSED_XZ] = "XZ",
         [OBJECT_COMPRESSED_LZ4] = "LZ4",
+        [OBJECT_COMPRESSED_ZSTD] = "ZSTD",
 };
 
 DEFINE_STRING_TABLE_LOOKUP(object_compressed, int);
@@ -110,6 +147,174 @@ int compress_blob_lz4(const void *src, uint64_t src_size,
 #endif
 }
 
+int compress_blob_zstd(const void *src, uint64_t src_size,
+                       void *dst, size_t dst_alloc_size, size_t *dst_size) {
+#if HAVE_ZSTD
+        size_t k;
+
+        assert(src);
+        assert(src_size > 0);
+        assert(dst);
+        assert(dst_alloc_size > 0);
+        assert(dst_size);
+
+        /* Returns < 0 if we couldn't compress the data or the
+         * compressed result is longer than the original */
+
+        k = ZSTD_compress(dst, dst_alloc_size, src, src_size, 0);
+        if (ZSTD_isError(k))
+                return zstd_ret_to_errno(k);
+
+        *dst_size = k;
+        return 0;
+#else
+        return -EPROTONOSUPPORT;
+#endif
+}
+
+int compress_dictionary_new(const void *data, size_t size, CompressDictionary **ret) {
+#if HAVE_ZSTD
+        _cleanup_(compress_dictionary_freep) CompressDictionary *d = NULL;
+        unsigned id;
+
+        assert(data);
+        assert(ret);
+
+        /* We only accept dictionaries in the zstd format (i.e. with a header carrying a dictionary ID), so
+         * that compressed frames can be matched to the dictionary they need. */
+        id = ZDICT_getDictID(data, size);
+        if (id == 0)
+                return -EBADMSG;
+
+        d = new0(CompressDictionary, 1);
+        if (!d)
+                return -ENOMEM;
+
+        d->data = memdup(data, size);
+        if (!d->data)
+                return -ENOMEM;
+
+        d->size = size;
+        d->id = id;
+
+        *ret = TAKE_PTR(d);
+        return 0;
+#else
+        return -EPROTONOSUPPORT;
+#endif
+}
+
+CompressDictionary* compress_dictionary_free(CompressDictionary *d) {
+        if (!d)
+                return NULL;
+
+#if HAVE_ZSTD
+        ZSTD_freeCDict(d->cdict);
+        ZSTD_freeDDict(d->ddict);
+        ZSTD_freeCCtx(d->cctx);
+        free(d->data);
+#endif
+
+        return mfree(d);
+}
+
+uint32_t compress_dictionary_id(const CompressDictionary *d) {
+#if HAVE_ZSTD
+        return d ? d->id : 0;
+#else
+        return 0;
+#endif
+}
+
+int compress_dictionary_train(
+                const void *samples, const size_t *sample_sizes, unsigned n_samples,
+                size_t max_size,
+                void **ret, size_t *ret_size) {
+#if HAVE_ZSTD
+        _cleanup_free_ void *buf = NULL;
+        size_t k;
+
+        assert(samples);
+        assert(sample_sizes);
+        assert(max_size > 0);
+        assert(ret);
+        assert(ret_size);
+
+        buf = malloc(max_size);
+        if (!buf)
+                return -ENOMEM;
+
+        k = ZDICT_trainFromBuffer(buf, max_size, samples, sample_sizes, n_samples);
+        if (ZDICT_isError(k)) {
+                log_debug("Failed to train ZSTD dictionary from %u samples: %s", n_samples, ZDICT_getErrorName(k));
+                return -EBADMSG;
+        }
+
+        *ret = TAKE_PTR(buf);
+        *ret_size = k;
+        return 0;
+#else
+        return -EPROTONOSUPPORT;
+#endif
+}
+
+int compress_blob_zstd_dict(const void *src, uint64_t src_size,
+                            void *dst, size_t dst_alloc_size, size_t *dst_size,
+                            CompressDictionary *d) {
+#if HAVE_ZSTD
+        size_t k;
+
+        assert(src);
+        assert(src_size > 0);
+        assert(dst);
+        assert(dst_alloc_size > 0);
+        assert(dst_size);
+        assert(d);
+
+        if (!d->cdict) {
+                d->cdict = ZSTD_createCDict(d->data, d->size, 0);
+                if (!d->cdict)
+                        return -ENOMEM;
+        }
+
+        if (!d->cctx) {
+                d->cctx = ZSTD_createCCtx();
+                if (!d->cctx)
+                        return -ENOMEM;
+        }
+
+        k = ZSTD_compress_usingCDict(d->cctx, dst, dst_alloc_size, src, src_size, d->cdict);
+        if (ZSTD_isError(k))
+                return zstd_ret_to_errno(k);
+
+        *dst_size = k;
+        return 0;
+#else
+        return -EPROTONOSUPPORT;
+#endif
+}
+
+#if HAVE_ZSTD
+static ZSTD_DCtx* zstd_dctx_new(CompressDictionary *d) {
+        _cleanup_(ZSTD_freeDCtxp) ZSTD_DCtx *dctx = NULL;
+
+        if (d && !d->ddict) {
+                d->ddict = ZSTD_createDDict(d->data, d->size);
+                if (!d->ddict)
+                        return NULL;
+        }
+
+        dctx = ZSTD_createDCtx();
+        if (!dctx)
+                return NULL;
+
+        if (d && ZSTD_isError(ZSTD_DCtx_refDDict(dctx, d->ddict)))
+                return NULL;
+
+        return TAKE_PTR(dctx);
+}
+#endif
+
 int decompress_blob_xz(const void *src, uint64_t src_size,
                        void **dst, size_t *dst_alloc_size, size_t* dst_size, size_t dst_max) {
 
@@ -210,6 +415,71 @@ int decompress_blob_lz4(const void *src, uint64_t src_size,
 #endif
 }
 
+int decompress_blob_zstd_dict(const void *src, uint64_t src_size,
+                              void **dst, size_t *dst_alloc_size, size_t* dst_size, size_t dst_max,
+                              CompressDictionary *d) {
+
+#if HAVE_ZSTD
+        _cleanup_(ZSTD_freeDCtxp) ZSTD_DCtx *dctx = NULL;
+        ZSTD_inBuffer input;
+        ZSTD_outBuffer output;
+        uint64_t size;
+        size_t k;
+
+        assert(src);
+        assert(src_size > 0);
+        assert(dst);
+        assert(dst_alloc_size);
+        assert(dst_size);
+        assert(*dst_alloc_size == 0 || *dst);
+
+        size = ZSTD_getFrameContentSize(src, src_size);
+        if (IN_SET(size, ZSTD_CONTENTSIZE_ERROR, ZSTD_CONTENTSIZE_UNKNOWN))
+                return -EBADMSG;
+
+        if (dst_max > 0 && size > dst_max)
+                size = dst_max;
+        if (size > SIZE_MAX)
+                return -E2BIG;
+
+        if (!(greedy_realloc(dst, dst_alloc_size, MAX(ZSTD_DStreamOutSize(), size), 1)))
+                return -ENOMEM;
+
+        dctx = zstd_dctx_new(d);
+        if (!dctx)
+                return -ENOMEM;
+
+        input = (ZSTD_inBuffer) {
+                .src = src,
+                .size = src_size,
+        };
+        output = (ZSTD_outBuffer) {
+                .dst = *dst,
+                .size = *dst_alloc_size,
+        };
+
+        /* The output buffer is at least as large as what we want to get out of it, hence a single call
+         * either decompresses the full frame, or at least the first dst_max bytes of it. */
+        k = ZSTD_decompressStream(dctx, &output, &input);
+        if (ZSTD_isError(k)) {
+                log_debug("ZSTD decoder failed: %s", ZSTD_getErrorName(k));
+                return zstd_ret_to_errno(k);
+        }
+        if (output.pos < size)
+                return -EBADMSG;
+
+        *dst_size = size;
+        return 0;
+#else
+        return -EPROTONOSUPPORT;
+#endif
+}
+
+int decompress_blob_zstd(const void *src, uint64_t src_size,
+                         void **dst, size_t *dst_alloc_size, size_t* dst_size, size_t dst_max) {
+        return decompress_blob_zstd_dict(src, src_size, dst, dst_alloc_size, dst_size, dst_max, NULL);
+}
+
 int decompress_blob(int compression,
                     const void *src, uint64_t src_size,
                     void **dst, size_t *dst_alloc_size, size_t* dst_size, size_t dst_max) {
@@ -219,6 +489,9 @@ int decompress_blob(int compression,
         else if (compression == OBJECT_COMPRESSED_LZ4)
                 return decompress_blob_lz4(src, src_size,
                                            dst, dst_alloc_size, dst_size, dst_max);
+        else if (compression == OBJECT_COMPRESSED_ZSTD)
+                return decompress_blob_zstd(src, src_size,
+                                            dst, dst_alloc_size, dst_size, dst_max);
         else
                 return -EBADMSG;
 }
@@ -344,6 +617,74 @@ int decompress_startswith_lz4(const void *src, uint64_t src_size,
 #endif
 }
 
+int decompress_startswith_zstd_dict(const void *src, uint64_t src_size,
+                                    void **buffer, size_t *buffer_size,
+                                    const void *prefix, size_t prefix_len,
+                                    uint8_t extra,
+                                    CompressDictionary *d) {
+#if HAVE_ZSTD
+        _cleanup_(ZSTD_freeDCtxp) ZSTD_DCtx *dctx = NULL;
+        ZSTD_inBuffer input;
+        ZSTD_outBuffer output;
+        uint64_t size;
+        size_t k;
+
+        /* Checks whether the decompressed blob starts with the
+         * mentioned prefix. The byte extra needs to follow the
+         * prefix */
+
+        assert(src);
+        assert(src_size > 0);
+        assert(buffer);
+        assert(buffer_size);
+        assert(prefix);
+        assert(*buffer_size == 0 || *buffer);
+
+        size = ZSTD_getFrameContentSize(src, src_size);
+        if (IN_SET(size, ZSTD_CONTENTSIZE_ERROR, ZSTD_CONTENTSIZE_UNKNOWN))
+                return -EBADMSG;
+
+        if (size < prefix_len + 1)
+                return 0; /* Decompressed text too short to match the prefix and extra */
+
+        dctx = zstd_dctx_new(d);
+        if (!dctx)
+                return -ENOMEM;
+
+        if (!(greedy_realloc(buffer, buffer_size, MAX(ZSTD_DStreamOutSize(), prefix_len + 1), 1)))
+                return -ENOMEM;
+
+        input = (ZSTD_inBuffer) {
+                .src = src,
+                .size = src_size,
+        };
+        output = (ZSTD_outBuffer) {
+                .dst = *buffer,
+                .size = *buffer_size,
+        };
+
+        k = ZSTD_decompressStream(dctx, &output, &input);
+        if (ZSTD_isError(k)) {
+                log_debug("ZSTD decoder failed: %s", ZSTD_getErrorName(k));
+                return zstd_ret_to_errno(k);
+        }
+        if (output.pos < prefix_len + 1)
+                return -EBADMSG;
+
+        return memcmp(*buffer, prefix, prefix_len) == 0 &&
+                ((const uint8_t*) *buffer)[prefix_len] == extra;
+#else
+        return -EPROTONOSUPPORT;
+#endif
+}
+
+int decompress_startswith_zstd(const void *src, uint64_t src_size,
+                               void **buffer, size_t *buffer_size,
+                               const void *prefix, size_t prefix_len,
+                               uint8_t extra) {
+        return decompress_startswith_zstd_dict(src, src_size, buffer, buffer_size, prefix, prefix_len, extra, NULL);
+}
+
 int decompress_startswith(int compression,
                           const void *src, uint64_t src_size,
                           void **buffer, size_t *buffer_size,
@@ -359,6 +700,11 @@ int decompress_startswith(int compression,
                                                  buffer, buffer_size,
                                                  prefix, prefix_len,
                                                  extra);
+        else if (compression == OBJECT_COMPRESSED_ZSTD)
+                return decompress_startswith_zstd(src, src_size,
+                                                  buffer, buffer_size,
+                                                  prefix, prefix_len,
+                                                  extra);
         else
                 return -EBADMSG;
 }
@@ -532,6 +878,97 @@ int compress_stream_lz4(int fdf, int fdt, uint64_t max_bytes) {
 #endif
 }
 
+int compress_stream_zstd(int fdf, int fdt, uint64_t max_bytes) {
+#if HAVE_ZSTD
+        _cleanup_(ZSTD_freeCCtxp) ZSTD_CCtx *cctx = NULL;
+        _cleanup_free_ void *in_buff = NULL, *out_buff = NULL;
+        size_t in_allocsize, out_allocsize;
+        size_t z;
+        uint64_t in_bytes = 0, out_bytes = 0;
+
+        assert(fdf >= 0);
+        assert(fdt >= 0);
+
+        /* Create the context and buffers */
+        in_allocsize = ZSTD_CStreamInSize();
+        out_allocsize = ZSTD_CStreamOutSize();
+        in_buff = malloc(in_allocsize);
+        out_buff = malloc(out_allocsize);
+        cctx = ZSTD_createCCtx();
+        if (!cctx || !out_buff || !in_buff)
+                return -ENOMEM;
+
+        z = ZSTD_CCtx_setParameter(cctx, ZSTD_c_checksumFlag, 1);
+        if (ZSTD_isError(z))
+                log_debug("Failed to enable ZSTD checksum, ignoring: %s", ZSTD_getErrorName(z));
+
+        /* This loop reads from the input file, compresses that entire chunk, and writes all output produced
+         * to the output file. */
+        for (;;) {
+                ZSTD_inBuffer input = {
+                        .src = in_buff,
+                };
+                bool is_last_chunk, finished = false;
+                ssize_t red;
+
+                red = loop_read(fdf, in_buff, in_allocsize, true);
+                if (red < 0)
+                        return red;
+                is_last_chunk = red == 0;
+
+                in_bytes += (size_t) red;
+                input.size = (size_t) red;
+
+                while (!finished) {
+                        ZSTD_outBuffer output = {
+                                .dst = out_buff,
+                                .size = out_allocsize,
+                        };
+                        size_t remaining;
+                        ssize_t wrote;
+
+                        /* Compress into the output buffer and write all of the output to the file so we can
+                         * reuse the buffer next iteration. */
+                        remaining = ZSTD_compressStream2(
+                                        cctx, &output, &input,
+                                        is_last_chunk ? ZSTD_e_end : ZSTD_e_continue);
+                        if (ZSTD_isError(remaining)) {
+                                log_debug("ZSTD encoder failed: %s", ZSTD_getErrorName(remaining));
+                                return zstd_ret_to_errno(remaining);
+                        }
+
+                        out_bytes += output.pos;
+                        if (max_bytes != (uint64_t) -1 && out_bytes > max_bytes) {
+                                log_debug("Compressed stream longer than %"PRIu64" bytes", max_bytes);
+                                return -EFBIG;
+                        }
+
+                        wrote = loop_write(fdt, output.dst, output.pos, false);
+                        if (wrote < 0)
+                                return wrote;
+
+                        /* If we're on the last chunk we're finished when zstd returns 0, which means it
+                         * consumed all the input AND finished the frame. Otherwise, we're finished when we've
+                         * consumed all the input. */
+                        finished = is_last_chunk ? (remaining == 0) : (input.pos == input.size);
+                }
+
+                /* zstd only returns 0 when the input is completely consumed */
+                assert(input.pos == input.size);
+                if (is_last_chunk)
+                        break;
+        }
+
+        log_debug("ZSTD compression finished (%"PRIu64" -> %"PRIu64" bytes, %.1f%%)",
+                  in_bytes, out_bytes,
+                  in_bytes > 0 ? (double) out_bytes / in_bytes * 100 : 0.0);
+
+        return 0;
+#else
+        return -EPROTONOSUPPORT;
+#endif
+}
+
 int decompress_stream_xz(int fdf, int fdt, uint64_t max_bytes) {
 
 #if HAVE_XZ
@@ -668,12 +1105,104 @@ int decompress_stream_lz4(int in, int out, uint64_t max_bytes) {
 #endif
 }
 
+int decompress_stream_zstd(int fdf, int fdt, uint64_t max_bytes) {
+#if HAVE_ZSTD
+        _cleanup_(ZSTD_freeDCtxp) ZSTD_DCtx *dctx = NULL;
+        _cleanup_free_ void *in_buff = NULL, *out_buff = NULL;
+        size_t in_allocsize, out_allocsize;
+        size_t last_result = 0;
+        uint64_t in_bytes = 0, out_bytes = 0;
+
+        assert(fdf >= 0);
+        assert(fdt >= 0);
+
+        /* Create the context and buffers */
+        in_allocsize = ZSTD_DStreamInSize();
+        out_allocsize = ZSTD_DStreamOutSize();
+        in_buff = malloc(in_allocsize);
+        out_buff = malloc(out_allocsize);
+        dctx = ZSTD_createDCtx();
+        if (!dctx || !out_buff || !in_buff)
+                return -ENOMEM;
+
+        /* The input file is expected to consist of one or more concatenated zstd frames.
+         * ZSTD_decompressStream() returns 0 exactly when a frame is completed, and resets itself for the
+         * next one. */
+        for (;;) {
+                ZSTD_inBuffer input = {
+                        .src = in_buff,
+                };
+                bool has_error = false;
+                ssize_t red;
+
+                red = loop_read(fdf, in_buff, in_allocsize, true);
+                if (red < 0)
+                        return red;
+                if (red == 0)
+                        break;
+
+                in_bytes += (size_t) red;
+                input.size = (size_t) red;
+
+                /* Given a valid frame, zstd won't consume the last byte of the frame until it has flushed all
+                 * of the decompressed data of the frame, hence it is sufficient to loop until all input is
+                 * consumed. */
+                while (input.pos < input.size) {
+                        ZSTD_outBuffer output = {
+                                .dst = out_buff,
+                                .size = out_allocsize,
+                        };
+                        ssize_t wrote;
+
+                        last_result = ZSTD_decompressStream(dctx, &output, &input);
+                        if (ZSTD_isError(last_result)) {
+                                has_error = true;
+                                break;
+                        }
+
+                        out_bytes += output.pos;
+                        if (max_bytes != (uint64_t) -1 && out_bytes > max_bytes) {
+                                log_debug("Decompressed stream longer than %"PRIu64" bytes", max_bytes);
+                                return -EFBIG;
+                        }
+
+                        wrote = loop_write(fdt, output.dst, output.pos, false);
+                        if (wrote < 0)
+                                return wrote;
+                }
+
+                if (has_error)
+                        break;
+        }
+
+        if (in_bytes == 0)
+                return log_debug_errno(SYNTHETIC_ERRNO(EBADMSG), "ZSTD decoder failed: no data read");
+
+        if (last_result != 0) {
+                /* The last return value from ZSTD_decompressStream() did not end on a frame, but we reached
+                 * the end of the file! We assume this is an error, and the input was truncated. */
+                log_debug("ZSTD decoder failed: %s", ZSTD_getErrorName(last_result));
+                return zstd_ret_to_errno(last_result);
+        }
+
+        log_debug("ZSTD decompression finished (%"PRIu64" -> %"PRIu64" bytes, %.1f%%)",
+                  in_bytes, out_bytes,
+                  (double) out_bytes / in_bytes * 100);
+        return 0;
+#else
+        log_debug("Cannot decompress file. Compiled without ZSTD support.");
+        return -EPROTONOSUPPORT;
+#endif
+}
+
 int decompress_stream(const char *filename, int fdf, int fdt, uint64_t max_bytes) {
 
         if (endswith(filename, ".lz4"))
                 return decompress_stream_lz4(fdf, fdt, max_bytes);
         else if (endswith(filename, ".xz"))
                 return decompress_stream_xz(fdf, fdt, max_bytes);
+        else if (endswith(filename, ".zst"))
+                return decompress_stream_zstd(fdf, fdt, max_bytes);
         else
                 return -EPROTONOSUPPORT;
 }
@@ -24,6 +24,66 @@ static uint64_t journal_file_tag_seqnum(JournalFile *f) {
         return r;
 }
 
+/* Pieces at least this large are passed to the HMAC right away, copying them around wouldn't pay off */
+#define HMAC_BUFFER_DIRECT_MIN 512U
+#define HMAC_BUFFER_MAX (64U*1024U)
+
+static void journal_file_hmac_flush(JournalFile *f) {
+        assert(f);
+
+        if (f->hmac_buffer_size <= 0)
+                return;
+
+        gcry_md_write(f->hmac, f->hmac_buffer, f->hmac_buffer_size);
+        f->hmac_buffer_size = 0;
+}
+
+static void journal_file_hmac_write(JournalFile *f, const void *p, size_t n) {
+        assert(f);
+
+        if (!f->hmac_batch || n >= HMAC_BUFFER_DIRECT_MIN) {
+                journal_file_hmac_flush(f);
+                gcry_md_write(f->hmac, p, n);
+                return;
+        }
+
+        if (f->hmac_buffer_size + n > HMAC_BUFFER_MAX)
+                journal_file_hmac_flush(f);
+
+        memcpy(f->hmac_buffer + f->hmac_buffer_size, p, n);
+        f->hmac_buffer_size += n;
+}
+
+void journal_file_hmac_begin_batch(JournalFile *f) {
+        assert(f);
+
+        /* Every object adds two or three small pieces to the HMAC. Within a batch of entries we collect them
+         * and hash them together when the batch is finished or a tag is due, which saves most of the per-call
+         * overhead of gcry_md_write(). The HMAC only has to be up-to-date when it is read, hence this doesn't
+         * change what ends up in the tags. */
+
+        if (!f->seal)
+                return;
+
+        if (!f->hmac_buffer) {
+                f->hmac_buffer = malloc(HMAC_BUFFER_MAX);
+                if (!f->hmac_buffer)
+                        return; /* Not fatal, let's just write everything directly then */
+        }
+
+        f->hmac_batch = true;
+}
+
+void journal_file_hmac_end_batch(JournalFile *f) {
+        assert(f);
+
+        if (!f->hmac_batch)
+                return;
+
+        journal_file_hmac_flush(f);
+        f->hmac_batch = false;
+}
+
 int journal_file_append_tag(JournalFile *f) {
         Object *o;
         uint64_t p;
@@ -56,6 +116,8 @@ int journal_file_append_tag(JournalFile *f) {
         if (r < 0)
                 return r;
 
+        journal_file_hmac_flush(f);
+
         /* Get the HMAC tag and store it in the object */
         memcpy(o->tag.tag, gcry_md_read(f->hmac, 0), TAG_LENGTH);
         f->hmac_running = false;
@@ -73,6 +135,8 @@ int journal_file_hmac_start(JournalFile *f) {
         if (f->hmac_running)
                 return 0;
 
+        assert(f->hmac_buffer_size == 0);
+
         /* Prepare HMAC for next cycle */
         gcry_md_reset(f->hmac);
         FSPRG_GetKey(f->fsprg_state, key, sizeof(key), 0);
@@ -236,25 +300,25 @@ int journal_file_hmac_put_object(JournalFile *f, ObjectType type, Object *o, uin
                         return -EBADMSG;
         }
 
-        gcry_md_write(f->hmac, o, offsetof(ObjectHeader, payload));
+        journal_file_hmac_write(f, o, offsetof(ObjectHeader, payload));
 
         switch (o->object.type) {
 
         case OBJECT_DATA:
                 /* All but hash and payload are mutable */
-                gcry_md_write(f->hmac, &o->data.hash, sizeof(o->data.hash));
-                gcry_md_write(f->hmac, o->data.payload, le64toh(o->object.size) - offsetof(DataObject, payload));
+                journal_file_hmac_write(f, &o->data.hash, sizeof(o->data.hash));
+                journal_file_hmac_write(f, o->data.payload, le64toh(o->object.size) - offsetof(DataObject, payload));
                 break;
 
         case OBJECT_FIELD:
                 /* Same here */
-                gcry_md_write(f->hmac, &o->field.hash, sizeof(o->field.hash));
-                gcry_md_write(f->hmac, o->field.payload, le64toh(o->object.size) - offsetof(FieldObject, payload));
+                journal_file_hmac_write(f, &o->field.hash, sizeof(o->field.hash));
+                journal_file_hmac_write(f, o->field.payload, le64toh(o->object.size) - offsetof(FieldObject, payload));
                 break;
 
         case OBJECT_ENTRY:
                 /* All */
-                gcry_md_write(f->hmac, &o->entry.seqnum, le64toh(o->object.size) - offsetof(EntryObject, seqnum));
+                journal_file_hmac_write(f, &o->entry.seqnum, le64toh(o->object.size) - offsetof(EntryObject, seqnum));
                 break;
 
         case OBJECT_FIELD_HASH_TABLE:
@@ -265,9 +329,25 @@ int journal_file_hmac_put_object(JournalFile *f, ObjectType type, Object *o, uin
 
         case OBJECT_TAG:
                 /* All but the tag itself */
-                gcry_md_write(f->hmac, &o->tag.seqnum, sizeof(o->tag.seqnum));
-                gcry_md_write(f->hmac, &o->tag.epoch, sizeof(o->tag.epoch));
+                journal_file_hmac_write(f, &o->tag.seqnum, sizeof(o->tag.seqnum));
+                journal_file_hmac_write(f, &o->tag.epoch, sizeof(o->tag.epoch));
                 break;
+
+        case OBJECT_DICTIONARY:
+                /* All */
+                journal_file_hmac_write(f, &o->dictionary.dict_id, le64toh(o->object.size) - offsetof(DictionaryObject, dict_id));
+                break;
+
+        case OBJECT_TIME_INDEX:
+                /* All */
+                journal_file_hmac_write(f, o->time_index.items, le64toh(o->object.size) - offsetof(TimeIndexObject, items));
+                break;
+
+        case OBJECT_ENTRY_ARRAY_INDEX:
+                /* All */
+                journal_file_hmac_write(f, o->entry_array_index.items, le64toh(o->object.size) - offsetof(EntryArrayIndexObject, items));
+                break;
+
         default:
                 return -EINVAL;
         }
@@ -292,12 +372,13 @@ int journal_file_hmac_put_header(JournalFile *f) {
          * tail_entry_seqnum, head_entry_seqnum, entry_array_offset,
          * head_entry_realtime, tail_entry_realtime,
          * tail_entry_monotonic, n_data, n_fields, n_tags,
-         * n_entry_arrays. */
+         * n_entry_arrays, dictionary_offset, trigram_index_offset,
+         * time_index_offset, entry_array_index_offset. */
 
-        gcry_md_write(f->hmac, f->header->signature, offsetof(Header, state) - offsetof(Header, signature));
-        gcry_md_write(f->hmac, &f->header->file_id, offsetof(Header, boot_id) - offsetof(Header, file_id));
-        gcry_md_write(f->hmac, &f->header->seqnum_id, offsetof(Header, arena_size) - offsetof(Header, seqnum_id));
-        gcry_md_write(f->hmac, &f->header->data_hash_table_offset, offsetof(Header, tail_object_offset) - offsetof(Header, data_hash_table_offset));
+        journal_file_hmac_write(f, f->header->signature, offsetof(Header, state) - offsetof(Header, signature));
+        journal_file_hmac_write(f, &f->header->file_id, offsetof(Header, boot_id) - offsetof(Header, file_id));
+        journal_file_hmac_write(f, &f->header->seqnum_id, offsetof(Header, arena_size) - offsetof(Header, seqnum_id));
+        journal_file_hmac_write(f, &f->header->data_hash_table_offset, offsetof(Header, tail_object_offset) - offsetof(Header, data_hash_table_offset));
 
         return 0;
 }
@@ -14,6 +14,9 @@ int journal_file_hmac_start(JournalFile *f);
 int journal_file_hmac_put_header(JournalFile *f);
 int journal_file_hmac_put_object(JournalFile *f, ObjectType type, Object *o, uint64_t p);
 
+void journal_file_hmac_begin_batch(JournalFile *f);
+void journal_file_hmac_end_batch(JournalFile *f);
+
 int journal_file_fss_load(JournalFile *f);
 int journal_file_parse_verification_key(JournalFile *f, const char *key);
 
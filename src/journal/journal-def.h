@@ -23,9 +23,16 @@ typedef struct EntryObject EntryObject;
 typedef struct HashTableObject HashTableObject;
 typedef struct EntryArrayObject EntryArrayObject;
 typedef struct TagObject TagObject;
+typedef struct DictionaryObject DictionaryObject;
+typedef struct TrigramIndexObject TrigramIndexObject;
+typedef struct TimeIndexObject TimeIndexObject;
+typedef struct EntryArrayIndexObject EntryArrayIndexObject;
 
 typedef struct EntryItem EntryItem;
 typedef struct HashItem HashItem;
+typedef struct TrigramIndexItem TrigramIndexItem;
+typedef struct TimeIndexItem TimeIndexItem;
+typedef struct EntryArrayIndexItem EntryArrayIndexItem;
 
 typedef struct FSSHeader FSSHeader;
 
@@ -39,6 +46,10 @@ typedef enum ObjectType {
         OBJECT_FIELD_HASH_TABLE,
         OBJECT_ENTRY_ARRAY,
         OBJECT_TAG,
+        OBJECT_DICTIONARY,
+        OBJECT_TRIGRAM_INDEX,
+        OBJECT_TIME_INDEX,
+        OBJECT_ENTRY_ARRAY_INDEX,
         _OBJECT_TYPE_MAX
 } ObjectType;
 
@@ -46,10 +57,11 @@ typedef enum ObjectType {
 enum {
         OBJECT_COMPRESSED_XZ = 1 << 0,
         OBJECT_COMPRESSED_LZ4 = 1 << 1,
+        OBJECT_COMPRESSED_ZSTD = 1 << 2,
         _OBJECT_COMPRESSED_MAX
 };
 
-#define OBJECT_COMPRESSION_MASK (OBJECT_COMPRESSED_XZ | OBJECT_COMPRESSED_LZ4)
+#define OBJECT_COMPRESSION_MASK (OBJECT_COMPRESSED_XZ | OBJECT_COMPRESSED_LZ4 | OBJECT_COMPRESSED_ZSTD)
 
 struct ObjectHeader {
         uint8_t type;
@@ -126,6 +138,57 @@ struct TagObject {
         uint8_t tag[TAG_LENGTH]; /* SHA-256 HMAC */
 } _packed_;
 
+/* A zstd dictionary that small DATA objects in the same file may be compressed against. The dictionary
+ * ID is also recorded in every frame compressed against it. */
+struct DictionaryObject {
+        ObjectHeader object;
+        le32_t dict_id;
+        uint8_t reserved[4];
+        uint8_t payload[];
+} _packed_;
+
+/* A bloom filter of the (ASCII case folded) trigrams of each MESSAGE= data object, for pruning the DATA
+ * objects a pattern can possibly match. Items are ordered by data_offset. */
+#define TRIGRAM_BLOOM_SIZE 32
+
+struct TrigramIndexItem {
+        le64_t data_offset;
+        uint8_t bloom[TRIGRAM_BLOOM_SIZE];
+} _packed_;
+
+struct TrigramIndexObject {
+        ObjectHeader object;
+        TrigramIndexItem items[];
+} _packed_;
+
+/* A sparse index of the global entry array by realtime: the index of the first entry of every minute
+ * that has any, ordered by realtime. Only written if the realtime timestamps of the entries never go
+ * backwards. */
+struct TimeIndexItem {
+        le64_t realtime;
+        le64_t entry_index;
+} _packed_;
+
+struct TimeIndexObject {
+        ObjectHeader object;
+        TimeIndexItem items[];
+} _packed_;
+
+/* The entry array objects of the longer entry array chains, so that a bisection can go straight to the
+ * array its needle is in, instead of walking the chain from its head. Items are ordered by chain_offset,
+ * and then by total. */
+struct EntryArrayIndexItem {
+        le64_t chain_offset;       /* the first entry array object of the chain */
+        le64_t array_offset;       /* an entry array object in the chain */
+        le64_t first_entry_offset; /* the first item of that entry array object */
+        le64_t total;              /* the number of items in the chain before it */
+} _packed_;
+
+struct EntryArrayIndexObject {
+        ObjectHeader object;
+        EntryArrayIndexItem items[];
+} _packed_;
+
 union Object {
         ObjectHeader object;
         DataObject data;
@@ -134,6 +197,10 @@ union Object {
         HashTableObject hash_table;
         EntryArrayObject entry_array;
         TagObject tag;
+        DictionaryObject dictionary;
+        TrigramIndexObject trigram_index;
+        TimeIndexObject time_index;
+        EntryArrayIndexObject entry_array_index;
 };
 
 enum {
@@ -147,19 +214,18 @@ enum {
 enum {
         HEADER_INCOMPATIBLE_COMPRESSED_XZ = 1 << 0,
         HEADER_INCOMPATIBLE_COMPRESSED_LZ4 = 1 << 1,
+        HEADER_INCOMPATIBLE_COMPRESSED_ZSTD = 1 << 2,
+        HEADER_INCOMPATIBLE_ZSTD_DICTIONARY = 1 << 3,
 };
 
-#define HEADER_INCOMPATIBLE_ANY (HEADER_INCOMPATIBLE_COMPRESSED_XZ|HEADER_INCOMPATIBLE_COMPRESSED_LZ4)
+#define HEADER_INCOMPATIBLE_ANY (HEADER_INCOMPATIBLE_COMPRESSED_XZ|HEADER_INCOMPATIBLE_COMPRESSED_LZ4|HEADER_INCOMPATIBLE_COMPRESSED_ZSTD| \
+                                 HEADER_INCOMPATIBLE_ZSTD_DICTIONARY)
 
-#if HAVE_XZ && HAVE_LZ4
-#  define HEADER_INCOMPATIBLE_SUPPORTED HEADER_INCOMPATIBLE_ANY
-#elif HAVE_XZ
-#  define HEADER_INCOMPATIBLE_SUPPORTED HEADER_INCOMPATIBLE_COMPRESSED_XZ
-#elif HAVE_LZ4
-#  define HEADER_INCOMPATIBLE_SUPPORTED HEADER_INCOMPATIBLE_COMPRESSED_LZ4
-#else
-#  define HEADER_INCOMPATIBLE_SUPPORTED 0
-#endif
+#define HEADER_INCOMPATIBLE_SUPPORTED                                   \
+        ((HAVE_XZ ? HEADER_INCOMPATIBLE_COMPRESSED_XZ : 0) |            \
+         (HAVE_LZ4 ? HEADER_INCOMPATIBLE_COMPRESSED_LZ4 : 0) |          \
+         (HAVE_ZSTD ? HEADER_INCOMPATIBLE_COMPRESSED_ZSTD : 0) |        \
+         (HAVE_ZSTD ? HEADER_INCOMPATIBLE_ZSTD_DICTIONARY : 0))
 
 enum {
         HEADER_COMPATIBLE_SEALED = 1
@@ -205,12 +271,17 @@ enum {
         /* Added in 189 */                              \
         le64_t n_tags;                                  \
         le64_t n_entry_arrays;                          \
+        /* Added in 245 */                              \
+        le64_t dictionary_offset;                       \
+        le64_t trigram_index_offset;                    \
+        le64_t time_index_offset;                       \
+        le64_t entry_array_index_offset;                \
         }
 
 struct Header struct_Header__contents;
 struct Header__packed struct_Header__contents _packed_;
 assert_cc(sizeof(struct Header) == sizeof(struct Header__packed));
-assert_cc(sizeof(struct Header) == 240);
+assert_cc(sizeof(struct Header) == 272);
 
 #define FSS_HEADER_SIGNATURE ((char[]) { 'K', 'S', 'H', 'H', 'R', 'H', 'L', 'P' })
 
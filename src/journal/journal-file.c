@@ -17,6 +17,7 @@
 #include "chattr-util.h"
 #include "compress.h"
 #include "fd-util.h"
+#include "fileio.h"
 #include "format-util.h"
 #include "fs-util.h"
 #include "journal-authenticate.h"
@@ -75,9 +76,46 @@
 /* How much to increase the journal file size at once each time we allocate something new. */
 #define FILE_SIZE_INCREASE (8 * 1024 * 1024ULL)          /* 8MB */
 
+/* How many recently written data objects to remember, and up to which payload size. The cache is direct mapped
+ * by hash, hence the number of slots should be a power of two. */
+#define DATA_CACHE_SIZE 128U
+#define DATA_CACHE_PAYLOAD_MAX 128U
+
+/* Payloads below the compression threshold but at least this large are compressed against the
+ * file's dictionary, once it has one */
+#define DICTIONARY_PAYLOAD_MIN 32U
+
+/* Train the dictionary once this many small payloads or bytes of them have been collected */
+#define DICTIONARY_SAMPLES_MAX 1024U
+#define DICTIONARY_SAMPLES_SIZE_MAX (256U*1024U)
+
+/* How large a trained or loaded dictionary may be at most */
+#define DICTIONARY_SIZE_MAX (64U*1024U)
+#define DICTIONARY_TRAINED_SIZE (8U*1024U)
+
+/* A prepared dictionary to use instead of training one per file */
+#define DICTIONARY_PATH "/var/lib/systemd/journal-dict/journal.dict"
+
+/* The granularity of the time index */
+#define TIME_INDEX_BUCKET_USEC (60*USEC_PER_SEC)
+
+/* Entry array chains with fewer arrays than this are walked quickly enough, and aren't indexed */
+#define ENTRY_ARRAY_INDEX_MIN_ARRAYS 8
+
 /* Reread fstat() of the file for detecting deletions at least this often */
 #define LAST_STAT_REFRESH_USEC (5*USEC_PER_SEC)
 
+/* The header flag matching the algorithm compress_blob() picks for new objects */
+#if HAVE_ZSTD
+#  define HEADER_INCOMPATIBLE_COMPRESSED_DEFAULT HEADER_INCOMPATIBLE_COMPRESSED_ZSTD
+#elif HAVE_LZ4
+#  define HEADER_INCOMPATIBLE_COMPRESSED_DEFAULT HEADER_INCOMPATIBLE_COMPRESSED_LZ4
+#elif HAVE_XZ
+#  define HEADER_INCOMPATIBLE_COMPRESSED_DEFAULT HEADER_INCOMPATIBLE_COMPRESSED_XZ
+#else
+#  define HEADER_INCOMPATIBLE_COMPRESSED_DEFAULT 0
+#endif
+
 /* The mmap context to use for the header we pick as one above the last defined typed */
 #define CONTEXT_HEADER _OBJECT_TYPE_MAX
 
@@ -365,6 +403,9 @@ JournalFile* journal_file_close(JournalFile *f) {
 
         journal_file_set_offline(f, true);
 
+        journal_file_unpin_objects(f);
+        free(f->pinned_windows);
+
         if (f->mmap && f->cache_fd)
                 mmap_cache_free_fd(f->mmap, f->cache_fd);
 
@@ -387,11 +428,20 @@ JournalFile* journal_file_close(JournalFile *f) {
         mmap_cache_unref(f->mmap);
 
         ordered_hashmap_free_free(f->chain_cache);
+        free(f->data_cache);
+        free(f->time_index);
+        free(f->entry_array_index);
 
-#if HAVE_XZ || HAVE_LZ4
+#if HAVE_XZ || HAVE_LZ4 || HAVE_ZSTD
         free(f->compress_buffer);
 #endif
 
+#if HAVE_ZSTD
+        compress_dictionary_free(f->dictionary);
+        free(f->dictionary_samples);
+        free(f->dictionary_sample_sizes);
+#endif
+
 #if HAVE_GCRYPT
         if (f->fss_file)
                 munmap(f->fss_file, PAGE_ALIGN(f->fss_file_size));
@@ -402,6 +452,7 @@ JournalFile* journal_file_close(JournalFile *f) {
 
         if (f->hmac)
                 gcry_md_close(f->hmac);
+        free(f->hmac_buffer);
 #endif
 
         return mfree(f);
@@ -419,7 +470,9 @@ static int journal_file_init_header(JournalFile *f, JournalFile *template) {
 
         h.incompatible_flags |= htole32(
                 f->compress_xz * HEADER_INCOMPATIBLE_COMPRESSED_XZ |
-                f->compress_lz4 * HEADER_INCOMPATIBLE_COMPRESSED_LZ4);
+                f->compress_lz4 * HEADER_INCOMPATIBLE_COMPRESSED_LZ4 |
+                f->compress_zstd * HEADER_INCOMPATIBLE_COMPRESSED_ZSTD |
+                f->compress_zstd * HEADER_INCOMPATIBLE_ZSTD_DICTIONARY);
 
         h.compatible_flags = htole32(
                 f->seal * HEADER_COMPATIBLE_SEALED);
@@ -489,7 +542,7 @@ static bool warn_wrong_flags(const JournalFile *f, bool compatible) {
                                   f->path, type, flags & ~any);
                 flags = (flags & any) & ~supported;
                 if (flags) {
-                        const char* strv[3];
+                        const char* strv[6];
                         unsigned n = 0;
                         _cleanup_free_ char *t = NULL;
 
@@ -499,6 +552,10 @@ static bool warn_wrong_flags(const JournalFile *f, bool compatible) {
                                 strv[n++] = "xz-compressed";
                         if (!compatible && (flags & HEADER_INCOMPATIBLE_COMPRESSED_LZ4))
                                 strv[n++] = "lz4-compressed";
+                        if (!compatible && (flags & HEADER_INCOMPATIBLE_COMPRESSED_ZSTD))
+                                strv[n++] = "zstd-compressed";
+                        if (!compatible && (flags & HEADER_INCOMPATIBLE_ZSTD_DICTIONARY))
+                                strv[n++] = "zstd-dictionary";
                         strv[n] = NULL;
                         assert(n < ELEMENTSOF(strv));
 
@@ -595,6 +652,7 @@ static int journal_file_verify_header(JournalFile *f) {
 
         f->compress_xz = JOURNAL_HEADER_COMPRESSED_XZ(f->header);
         f->compress_lz4 = JOURNAL_HEADER_COMPRESSED_LZ4(f->header);
+        f->compress_zstd = JOURNAL_HEADER_COMPRESSED_ZSTD(f->header);
 
         f->seal = JOURNAL_HEADER_SEALED(f->header);
 
@@ -727,6 +785,39 @@ static int journal_file_move_to(JournalFile *f, ObjectType type, bool keep_alway
         return mmap_cache_get(f->mmap, f->cache_fd, f->prot, type_to_context(type), keep_always, offset, size, &f->last_stat, ret, ret_size);
 }
 
+int journal_file_pin_object(JournalFile *f, ObjectType type) {
+        MMapWindow *w;
+        size_t i;
+
+        assert(f);
+
+        w = mmap_cache_pin(f->mmap, type_to_context(type));
+        if (!w)
+                return -EADDRNOTAVAIL;
+
+        /* Most objects of an entry are close to each other, pin each window only once */
+        for (i = 0; i < f->n_pinned_windows; i++)
+                if (f->pinned_windows[i] == w) {
+                        mmap_cache_unpin(w);
+                        return 0;
+                }
+
+        if (!GREEDY_REALLOC(f->pinned_windows, f->n_pinned_windows_allocated, f->n_pinned_windows + 1)) {
+                mmap_cache_unpin(w);
+                return -ENOMEM;
+        }
+
+        f->pinned_windows[f->n_pinned_windows++] = w;
+        return 1;
+}
+
+void journal_file_unpin_objects(JournalFile *f) {
+        assert(f);
+
+        for (; f->n_pinned_windows > 0; f->n_pinned_windows--)
+                mmap_cache_unpin(f->pinned_windows[f->n_pinned_windows - 1]);
+}
+
 static uint64_t minimum_header_size(Object *o) {
 
         static const uint64_t table[] = {
@@ -737,6 +828,10 @@ static uint64_t minimum_header_size(Object *o) {
                 [OBJECT_FIELD_HASH_TABLE] = sizeof(HashTableObject),
                 [OBJECT_ENTRY_ARRAY] = sizeof(EntryArrayObject),
                 [OBJECT_TAG] = sizeof(TagObject),
+                [OBJECT_DICTIONARY] = sizeof(DictionaryObject),
+                [OBJECT_TRIGRAM_INDEX] = sizeof(TrigramIndexObject),
+                [OBJECT_TIME_INDEX] = sizeof(TimeIndexObject),
+                [OBJECT_ENTRY_ARRAY_INDEX] = sizeof(EntryArrayIndexObject),
         };
 
         if (o->object.type >= ELEMENTSOF(table) || table[o->object.type] <= 0)
@@ -873,6 +968,50 @@ static int journal_file_check_object(JournalFile *f, uint64_t offset, Object *o)
                                                le64toh(o->tag.epoch), offset);
 
                 break;
+
+        case OBJECT_DICTIONARY:
+                if (le64toh(o->object.size) <= offsetof(DictionaryObject, payload) ||
+                    le64toh(o->object.size) - offsetof(DictionaryObject, payload) > DICTIONARY_SIZE_MAX)
+                        return log_debug_errno(SYNTHETIC_ERRNO(EBADMSG),
+                                               "Invalid object dictionary size: %" PRIu64 ": %" PRIu64,
+                                               le64toh(o->object.size),
+                                               offset);
+
+                if (le32toh(o->dictionary.dict_id) == 0)
+                        return log_debug_errno(SYNTHETIC_ERRNO(EBADMSG),
+                                               "Invalid object dictionary ID: %" PRIu64,
+                                               offset);
+
+                break;
+
+        case OBJECT_TRIGRAM_INDEX:
+                if ((le64toh(o->object.size) - offsetof(TrigramIndexObject, items)) % sizeof(TrigramIndexItem) != 0)
+                        return log_debug_errno(SYNTHETIC_ERRNO(EBADMSG),
+                                               "Invalid object trigram index size: %" PRIu64 ": %" PRIu64,
+                                               le64toh(o->object.size),
+                                               offset);
+
+                break;
+
+        case OBJECT_TIME_INDEX:
+                if (le64toh(o->object.size) <= offsetof(TimeIndexObject, items) ||
+                    (le64toh(o->object.size) - offsetof(TimeIndexObject, items)) % sizeof(TimeIndexItem) != 0)
+                        return log_debug_errno(SYNTHETIC_ERRNO(EBADMSG),
+                                               "Invalid object time index size: %" PRIu64 ": %" PRIu64,
+                                               le64toh(o->object.size),
+                                               offset);
+
+                break;
+
+        case OBJECT_ENTRY_ARRAY_INDEX:
+                if (le64toh(o->object.size) <= offsetof(EntryArrayIndexObject, items) ||
+                    (le64toh(o->object.size) - offsetof(EntryArrayIndexObject, items)) % sizeof(EntryArrayIndexItem) != 0)
+                        return log_debug_errno(SYNTHETIC_ERRNO(EBADMSG),
+                                               "Invalid object entry array index size: %" PRIu64 ": %" PRIu64,
+                                               le64toh(o->object.size),
+                                               offset);
+
+                break;
         }
 
         return 0;
@@ -1306,6 +1445,94 @@ int journal_file_find_field_object(
                                                         ret, offset);
 }
 
+#if HAVE_ZSTD
+static int journal_file_get_dictionary(JournalFile *f, CompressDictionary **ret) {
+        uint64_t p, l;
+        Object *o;
+        int r;
+
+        assert(f);
+        assert(ret);
+
+        if (f->dictionary) {
+                *ret = f->dictionary;
+                return 1;
+        }
+
+        if (!JOURNAL_HEADER_CONTAINS(f->header, dictionary_offset) || f->header->dictionary_offset == 0) {
+                *ret = NULL;
+                return 0;
+        }
+
+        p = le64toh(f->header->dictionary_offset);
+        r = journal_file_move_to_object(f, OBJECT_DICTIONARY, p, &o);
+        if (r < 0)
+                return r;
+
+        l = le64toh(o->object.size) - offsetof(Object, dictionary.payload);
+
+        r = compress_dictionary_new(o->dictionary.payload, l, &f->dictionary);
+        if (r < 0)
+                return r;
+
+        if (compress_dictionary_id(f->dictionary) != le32toh(o->dictionary.dict_id)) {
+                f->dictionary = compress_dictionary_free(f->dictionary);
+                return -EBADMSG;
+        }
+
+        *ret = f->dictionary;
+        return 1;
+}
+#endif
+
+int journal_file_decompress_blob(
+                JournalFile *f, int compression,
+                const void *src, uint64_t src_size,
+                void **dst, size_t *dst_alloc_size, size_t* dst_size, size_t dst_max) {
+
+        assert(f);
+
+#if HAVE_ZSTD
+        if (compression == OBJECT_COMPRESSED_ZSTD && JOURNAL_HEADER_ZSTD_DICTIONARY(f->header)) {
+                CompressDictionary *d;
+                int r;
+
+                r = journal_file_get_dictionary(f, &d);
+                if (r < 0)
+                        return r;
+
+                return decompress_blob_zstd_dict(src, src_size, dst, dst_alloc_size, dst_size, dst_max, d);
+        }
+#endif
+
+        return decompress_blob(compression, src, src_size, dst, dst_alloc_size, dst_size, dst_max);
+}
+
+int journal_file_decompress_startswith(
+                JournalFile *f, int compression,
+                const void *src, uint64_t src_size,
+                void **buffer, size_t *buffer_size,
+                const void *prefix, size_t prefix_len,
+                uint8_t extra) {
+
+        assert(f);
+
+#if HAVE_ZSTD
+        if (compression == OBJECT_COMPRESSED_ZSTD && JOURNAL_HEADER_ZSTD_DICTIONARY(f->header)) {
+                CompressDictionary *d;
+                int r;
+
+                r = journal_file_get_dictionary(f, &d);
+                if (r < 0)
+                        return r;
+
+                return decompress_startswith_zstd_dict(src, src_size, buffer, buffer_size, prefix, prefix_len, extra, d);
+        }
+#endif
+
+        return decompress_startswith(compression, src, src_size, buffer, buffer_size, prefix, prefix_len, extra);
+}
+
 int journal_file_find_data_object_with_hash(
                 JournalFile *f,
                 const void *data, uint64_t size, uint64_t hash,
@@ -1347,7 +1574,7 @@ int journal_file_find_data_object_with_hash(
                         goto next;
 
                 if (o->object.flags & OBJECT_COMPRESSION_MASK) {
-#if HAVE_XZ || HAVE_LZ4
+#if HAVE_XZ || HAVE_LZ4 || HAVE_ZSTD
                         uint64_t l;
                         size_t rsize = 0;
 
@@ -1357,8 +1584,8 @@ int journal_file_find_data_object_with_hash(
 
                         l -= offsetof(Object, data.payload);
 
-                        r = decompress_blob(o->object.flags & OBJECT_COMPRESSION_MASK,
-                                            o->data.payload, l, &f->compress_buffer, &f->compress_buffer_size, &rsize, 0);
+                        r = journal_file_decompress_blob(f, o->object.flags & OBJECT_COMPRESSION_MASK,
+                                                         o->data.payload, l, &f->compress_buffer, &f->compress_buffer_size, &rsize, 0);
                         if (r < 0)
                                 return r;
 
@@ -1474,6 +1701,180 @@ static int journal_file_append_field(
         return 0;
 }
 
+struct DataCacheItem {
+        uint64_t hash;
+        uint64_t offset;
+        uint64_t size;
+        uint8_t payload[DATA_CACHE_PAYLOAD_MAX];
+};
+
+static int journal_file_data_cache_get(
+                JournalFile *f,
+                const void *data, uint64_t size, uint64_t hash,
+                Object **ret, uint64_t *offset) {
+
+        DataCacheItem *i;
+        Object *o;
+        int r;
+
+        assert(f);
+        assert(data || size == 0);
+
+        if (!f->data_cache || size > DATA_CACHE_PAYLOAD_MAX)
+                return 0;
+
+        i = f->data_cache + (hash % DATA_CACHE_SIZE);
+        if (i->offset == 0 || i->hash != hash || i->size != size || memcmp_safe(i->payload, data, size) != 0)
+                return 0;
+
+        r = journal_file_move_to_object(f, OBJECT_DATA, i->offset, &o);
+        if (r < 0)
+                return r;
+
+        /* Data objects never move, hence this is just a safety net */
+        if (le64toh(o->data.hash) != hash) {
+                i->offset = 0;
+                return 0;
+        }
+
+        if (ret)
+                *ret = o;
+
+        if (offset)
+                *offset = i->offset;
+
+        return 1;
+}
+
+static void journal_file_data_cache_put(JournalFile *f, const void *data, uint64_t size, uint64_t hash, uint64_t offset) {
+        DataCacheItem *i;
+
+        assert(f);
+        assert(data || size == 0);
+        assert(offset > 0);
+
+        /* Fields such as _HOSTNAME=, _BOOT_ID= or _SYSTEMD_UNIT= show up in almost every entry we write. Remember
+         * where their data objects are, so that we can skip the hash table lookup for them next time. Older items
+         * are just overwritten when another one hashes to the same slot. The cache is per file, hence rotating
+         * implicitly invalidates it. */
+
+        if (size > DATA_CACHE_PAYLOAD_MAX)
+                return;
+
+        if (!f->data_cache) {
+                f->data_cache = new0(DataCacheItem, DATA_CACHE_SIZE);
+                if (!f->data_cache)
+                        return; /* Just a cache, ignore allocation failures */
+        }
+
+        i = f->data_cache + (hash % DATA_CACHE_SIZE);
+        i->hash = hash;
+        i->offset = offset;
+        i->size = size;
+        memcpy_safe(i->payload, data, size);
+}
+
+#if HAVE_ZSTD
+static int journal_file_append_dictionary(JournalFile *f, const void *data, size_t size) {
+        _cleanup_(compress_dictionary_freep) CompressDictionary *d = NULL;
+        uint64_t p;
+        Object *o;
+        int r;
+
+        assert(f);
+        assert(data);
+
+        if (size <= 0 || size > DICTIONARY_SIZE_MAX)
+                return -EINVAL;
+
+        r = compress_dictionary_new(data, size, &d);
+        if (r < 0)
+                return r;
+
+        r = journal_file_append_object(f, OBJECT_DICTIONARY, offsetof(Object, dictionary.payload) + size, &o, &p);
+        if (r < 0)
+                return r;
+
+        o->dictionary.dict_id = htole32(compress_dictionary_id(d));
+        memcpy(o->dictionary.payload, data, size);
+
+#if HAVE_GCRYPT
+        r = journal_file_hmac_put_object(f, OBJECT_DICTIONARY, o, p);
+        if (r < 0)
+                return r;
+#endif
+
+        f->header->dictionary_offset = htole64(p);
+
+        f->dictionary = TAKE_PTR(d);
+
+        return 0;
+}
+
+static void journal_file_prepare_dictionary(JournalFile *f, const void *data, uint64_t size) {
+        _cleanup_free_ void *dict = NULL;
+        size_t dict_size;
+        int r;
+
+        assert(f);
+
+        /* Small payloads don't compress on their own, but do against a dictionary of what typical payloads
+         * look like. Use a prepared dictionary if there is one, otherwise collect the first small payloads
+         * appended to the file and train one from them. Objects appended before that stay uncompressed. */
+
+        if (f->dictionary || f->dictionary_failed)
+                return;
+
+        /* The flag is set when the file is created, so that it doesn't change under readers (and the
+         * header seal) later on. Files created without it never get a dictionary. */
+        if (!JOURNAL_HEADER_ZSTD_DICTIONARY(f->header) || !JOURNAL_HEADER_CONTAINS(f->header, dictionary_offset)) {
+                f->dictionary_failed = true;
+                return;
+        }
+
+        if (f->n_dictionary_samples == 0) {
+                _cleanup_free_ char *buf = NULL;
+                size_t buf_size;
+
+                r = read_full_file(DICTIONARY_PATH, &buf, &buf_size);
+                if (r >= 0) {
+                        r = journal_file_append_dictionary(f, buf, buf_size);
+                        if (r >= 0)
+                                return;
+
+                        log_debug_errno(r, "Failed to use journal dictionary %s, training one instead: %m", DICTIONARY_PATH);
+                } else if (r != -ENOENT)
+                        log_debug_errno(r, "Failed to read journal dictionary %s, training one instead: %m", DICTIONARY_PATH);
+        }
+
+        if (!greedy_realloc(&f->dictionary_samples, &f->dictionary_samples_allocated, f->dictionary_samples_size + size, 1) ||
+            !GREEDY_REALLOC(f->dictionary_sample_sizes, f->dictionary_sample_sizes_allocated, f->n_dictionary_samples + 1))
+                return; /* Try again next time */
+
+        memcpy((uint8_t*) f->dictionary_samples + f->dictionary_samples_size, data, size);
+        f->dictionary_samples_size += size;
+        f->dictionary_sample_sizes[f->n_dictionary_samples++] = size;
+
+        if (f->n_dictionary_samples < DICTIONARY_SAMPLES_MAX &&
+            f->dictionary_samples_size < DICTIONARY_SAMPLES_SIZE_MAX)
+                return;
+
+        r = compress_dictionary_train(f->dictionary_samples, f->dictionary_sample_sizes, f->n_dictionary_samples,
+                                      DICTIONARY_TRAINED_SIZE, &dict, &dict_size);
+        if (r >= 0)
+                r = journal_file_append_dictionary(f, dict, dict_size);
+        if (r < 0) {
+                log_debug_errno(r, "Failed to set up dictionary for journal file %s, not compressing small objects: %m", f->path);
+                f->dictionary_failed = true;
+        }
+
+        f->dictionary_samples = mfree(f->dictionary_samples);
+        f->dictionary_samples_size = f->dictionary_samples_allocated = 0;
+        f->dictionary_sample_sizes = mfree(f->dictionary_sample_sizes);
+        f->dictionary_sample_sizes_allocated = 0;
+}
+#endif
+
 static int journal_file_append_data(
                 JournalFile *f,
                 const void *data, uint64_t size,
@@ -1490,11 +1891,15 @@ static int journal_file_append_data(
 
         hash = hash64(data, size);
 
-        r = journal_file_find_data_object_with_hash(f, data, size, hash, &o, &p);
+        r = journal_file_data_cache_get(f, data, size, hash, &o, &p);
+        if (r == 0) {
+                r = journal_file_find_data_object_with_hash(f, data, size, hash, &o, &p);
+                if (r > 0)
+                        journal_file_data_cache_put(f, data, size, hash, p);
+        }
         if (r < 0)
                 return r;
         if (r > 0) {
-
                 if (ret)
                         *ret = o;
 
@@ -1504,6 +1909,12 @@ static int journal_file_append_data(
                 return 0;
         }
 
+#if HAVE_ZSTD
+        /* This may append a dictionary object, hence do it before we append the data object itself */
+        if (f->compress_zstd && size >= DICTIONARY_PAYLOAD_MIN && size < f->compress_threshold_bytes)
+                journal_file_prepare_dictionary(f, data, size);
+#endif
+
         osize = offsetof(Object, data.payload) + size;
         r = journal_file_append_object(f, OBJECT_DATA, osize, &o, &p);
         if (r < 0)
@@ -1511,7 +1922,7 @@ static int journal_file_append_data(
 
         o->data.hash = htole64(hash);
 
-#if HAVE_XZ || HAVE_LZ4
+#if HAVE_XZ || HAVE_LZ4 || HAVE_ZSTD
         if (JOURNAL_FILE_COMPRESS(f) && size >= f->compress_threshold_bytes) {
                 size_t rsize = 0;
 
@@ -1529,6 +1940,21 @@ static int journal_file_append_data(
         }
 #endif
 
+#if HAVE_ZSTD
+        if (f->dictionary && size >= DICTIONARY_PAYLOAD_MIN && size < f->compress_threshold_bytes) {
+                size_t rsize = 0;
+
+                r = compress_blob_zstd_dict(data, size, o->data.payload, size - 1, &rsize, f->dictionary);
+                if (r >= 0) {
+                        compression = OBJECT_COMPRESSED_ZSTD;
+                        o->object.size = htole64(offsetof(Object, data.payload) + rsize);
+                        o->object.flags |= compression;
+
+                        log_debug("Compressed data object %"PRIu64" -> %zu using ZSTD with dictionary", size, rsize);
+                }
+        }
+#endif
+
         if (compression == 0)
                 memcpy_safe(o->data.payload, data, size);
 
@@ -1566,6 +1992,8 @@ static int journal_file_append_data(
                 fo->field.head_data_offset = le64toh(p);
         }
 
+        journal_file_data_cache_put(f, data, size, hash, p);
+
         if (ret)
                 *ret = o;
 
@@ -1602,6 +2030,27 @@ uint64_t journal_file_hash_table_n_items(Object *o) {
         return (le64toh(o->object.size) - offsetof(Object, hash_table.items)) / sizeof(HashItem);
 }
 
+static void journal_file_entry_array_index_add(JournalFile *f, uint64_t chain, uint64_t array, uint64_t first_entry, uint64_t total) {
+        assert(f);
+
+        if (f->entry_array_index_broken)
+                return;
+
+        if (!GREEDY_REALLOC(f->entry_array_index, f->n_entry_array_index_allocated, f->n_entry_array_index + 1)) {
+                f->entry_array_index = mfree(f->entry_array_index);
+                f->n_entry_array_index = f->n_entry_array_index_allocated = 0;
+                f->entry_array_index_broken = true;
+                return;
+        }
+
+        f->entry_array_index[f->n_entry_array_index++] = (EntryArrayIndexItem) {
+                .chain_offset = htole64(chain),
+                .array_offset = htole64(array),
+                .first_entry_offset = htole64(first_entry),
+                .total = htole64(total),
+        };
+}
+
 static int link_entry_into_array(JournalFile *f,
                                  le64_t *first,
                                  le64_t *idx,
@@ -1668,6 +2117,9 @@ static int link_entry_into_array(JournalFile *f,
                 o->entry_array.next_entry_array_offset = htole64(q);
         }
 
+        if (!f->entry_array_index_incomplete && i == 0)
+                journal_file_entry_array_index_add(f, le64toh(*first), q, p, hidx);
+
         if (JOURNAL_HEADER_CONTAINS(f->header, n_entry_arrays))
                 f->header->n_entry_arrays = htole64(le64toh(f->header->n_entry_arrays) + 1);
 
@@ -1768,6 +2220,39 @@ static int journal_file_link_entry(JournalFile *f, Object *o, uint64_t offset) {
         return 0;
 }
 
+static void journal_file_time_index_add(JournalFile *f, uint64_t realtime, uint64_t i) {
+        assert(f);
+
+        if (f->time_index_broken)
+                return;
+
+        /* If the clock jumped backwards the entries aren't ordered by realtime, and neither bisection nor
+         * the index can find anything reliably. Don't bother with an index then. */
+        if (f->n_time_index > 0 && realtime < f->time_index_last_realtime)
+                goto broken;
+
+        f->time_index_last_realtime = realtime;
+
+        if (f->n_time_index > 0 &&
+            realtime / TIME_INDEX_BUCKET_USEC == le64toh(f->time_index[f->n_time_index - 1].realtime) / TIME_INDEX_BUCKET_USEC)
+                return;
+
+        if (!GREEDY_REALLOC(f->time_index, f->n_time_index_allocated, f->n_time_index + 1))
+                goto broken;
+
+        f->time_index[f->n_time_index++] = (TimeIndexItem) {
+                .realtime = htole64(realtime),
+                .entry_index = htole64(i),
+        };
+
+        return;
+
+broken:
+        f->time_index = mfree(f->time_index);
+        f->n_time_index = f->n_time_index_allocated = 0;
+        f->time_index_broken = true;
+}
+
 static int journal_file_append_entry_internal(
                 JournalFile *f,
                 const dual_timestamp *ts,
@@ -1811,6 +2296,9 @@ static int journal_file_append_entry_internal(
         if (r < 0)
                 return r;
 
+        if (!f->time_index_incomplete)
+                journal_file_time_index_add(f, ts->realtime, le64toh(f->header->n_entries) - 1);
+
         if (ret)
                 *ret = o;
 
@@ -1913,7 +2401,7 @@ static int entry_item_cmp(const EntryItem *a, const EntryItem *b) {
         return CMP(le64toh(a->object_offset), le64toh(b->object_offset));
 }
 
-int journal_file_append_entry(
+static int journal_file_append_entry_one(
                 JournalFile *f,
                 const dual_timestamp *ts,
                 const sd_id128_t *boot_id,
@@ -1971,7 +2459,11 @@ int journal_file_append_entry(
          * times for rotating media. */
         typesafe_qsort(items, n_iovec, entry_item_cmp);
 
-        r = journal_file_append_entry_internal(f, ts, boot_id, xor_hash, items, n_iovec, seqnum, ret, offset);
+        return journal_file_append_entry_internal(f, ts, boot_id, xor_hash, items, n_iovec, seqnum, ret, offset);
+}
+
+static int journal_file_finish_append(JournalFile *f, int r) {
+        assert(f);
 
         /* If the memory mapping triggered a SIGBUS then we return an
          * IO error and ignore the error code passed down to us, since
@@ -1989,13 +2481,81 @@ int journal_file_append_entry(
         return r;
 }
 
-typedef struct ChainCacheItem {
-        uint64_t first; /* the array at the beginning of the chain */
-        uint64_t array; /* the cached array */
-        uint64_t begin; /* the first item in the cached array */
-        uint64_t total; /* the total number of items in all arrays before this one in the chain */
-        uint64_t last_index; /* the last index we looked at, to optimize locality when bisecting */
-} ChainCacheItem;
+int journal_file_append_entry(
+                JournalFile *f,
+                const dual_timestamp *ts,
+                const sd_id128_t *boot_id,
+                const struct iovec iovec[], unsigned n_iovec,
+                uint64_t *seqnum,
+                Object **ret, uint64_t *offset) {
+
+        int r;
+
+        assert(f);
+        assert(f->header);
+        assert(iovec || n_iovec == 0);
+
+        r = journal_file_append_entry_one(f, ts, boot_id, iovec, n_iovec, seqnum, ret, offset);
+        return journal_file_finish_append(f, r);
+}
+
+int journal_file_append_entries(
+                JournalFile *f,
+                const JournalEntryIovec entries[], size_t n_entries,
+                uint64_t *seqnum,
+                size_t *ret_n_appended) {
+
+        size_t i;
+        int r = 0;
+
+        assert(f);
+        assert(f->header);
+        assert(entries || n_entries == 0);
+
+        /* Appends a number of entries in one go. The entries are linked in one after the other exactly as
+         * journal_file_append_entry() would do it, but the SIGBUS check and the change notification (i.e. the
+         * ftruncate() that triggers inotify, or the rescheduling of the coalescing timer) is done only once
+         * for the whole batch. On failure the entries before the failing one remain appended, and their
+         * number is returned in ret_n_appended, so that the caller may rotate and retry with the rest. */
+
+#if HAVE_GCRYPT
+        journal_file_hmac_begin_batch(f);
+#endif
+
+        for (i = 0; i < n_entries; i++) {
+                r = journal_file_append_entry_one(f,
+                                                  entries[i].ts,
+                                                  entries[i].boot_id,
+                                                  entries[i].iovec, entries[i].n_iovec,
+                                                  seqnum, NULL, NULL);
+                if (r < 0)
+                        break;
+
+                /* Check for SIGBUS after each entry, so that we don't continue writing to a broken mapping */
+                if (mmap_cache_got_sigbus(f->mmap, f->cache_fd))
+                        break;
+        }
+
+#if HAVE_GCRYPT
+        journal_file_hmac_end_batch(f);
+#endif
+
+        if (ret_n_appended)
+                *ret_n_appended = i;
+
+        if (n_entries == 0)
+                return 0;
+
+        return journal_file_finish_append(f, r);
+}
+
+typedef struct ChainCacheItem {
+        uint64_t first; /* the array at the beginning of the chain */
+        uint64_t array; /* the cached array */
+        uint64_t begin; /* the first item in the cached array */
+        uint64_t total; /* the total number of items in all arrays before this one in the chain */
+        uint64_t last_index; /* the last index we looked at, to optimize locality when bisecting */
+} ChainCacheItem;
 
 static void chain_cache_put(
                 OrderedHashmap *h,
@@ -2036,6 +2596,108 @@ static void chain_cache_put(
         ci->last_index = last_index;
 }
 
+static int entry_array_index_find_chain(
+                JournalFile *f,
+                uint64_t first,
+                Object **ret,
+                uint64_t *ret_begin,
+                uint64_t *ret_end) {
+
+        uint64_t n_items, left, right, begin;
+        Object *o;
+        int r;
+
+        assert(f);
+        assert(f->header);
+        assert(ret);
+        assert(ret_begin);
+        assert(ret_end);
+
+        /* Looks up the items of the chain starting at 'first' in the entry array index. Returns 0 if there
+         * is no index, or the chain is not in it. */
+
+        if (!JOURNAL_HEADER_CONTAINS(f->header, entry_array_index_offset) || f->header->entry_array_index_offset == 0)
+                return 0;
+
+        r = journal_file_move_to_object(f, OBJECT_ENTRY_ARRAY_INDEX, le64toh(f->header->entry_array_index_offset), &o);
+        if (r < 0)
+                return r;
+
+        n_items = (le64toh(o->object.size) - offsetof(EntryArrayIndexObject, items)) / sizeof(EntryArrayIndexItem);
+
+        left = 0;
+        right = n_items;
+        while (left < right) {
+                uint64_t m = left + (right - left) / 2;
+
+                if (le64toh(o->entry_array_index.items[m].chain_offset) < first)
+                        left = m + 1;
+                else
+                        right = m;
+        }
+
+        begin = left;
+
+        right = n_items;
+        while (left < right) {
+                uint64_t m = left + (right - left) / 2;
+
+                if (le64toh(o->entry_array_index.items[m].chain_offset) <= first)
+                        left = m + 1;
+                else
+                        right = m;
+        }
+
+        if (begin == left)
+                return 0;
+
+        *ret = o;
+        *ret_begin = begin;
+        *ret_end = left;
+        return 1;
+}
+
+static int entry_array_index_get(
+                JournalFile *f,
+                uint64_t first,
+                uint64_t i,
+                uint64_t *ret_array,
+                uint64_t *ret_total) {
+
+        uint64_t begin, end, left, right;
+        Object *o;
+        int r;
+
+        assert(f);
+        assert(ret_array);
+        assert(ret_total);
+
+        /* Finds the entry array object item i of the chain is in, or at least the last one before it */
+
+        r = entry_array_index_find_chain(f, first, &o, &begin, &end);
+        if (r <= 0)
+                return r;
+
+        left = begin;
+        right = end;
+        while (left < right) {
+                uint64_t m = left + (right - left) / 2;
+
+                if (le64toh(o->entry_array_index.items[m].total) <= i)
+                        left = m + 1;
+                else
+                        right = m;
+        }
+
+        /* The first item of a chain is for its first array, with total 0 */
+        if (left == begin)
+                return -EBADMSG;
+
+        *ret_array = le64toh(o->entry_array_index.items[left - 1].array_offset);
+        *ret_total = le64toh(o->entry_array_index.items[left - 1].total);
+        return 1;
+}
+
 static int generic_array_get(
                 JournalFile *f,
                 uint64_t first,
@@ -2057,6 +2719,18 @@ static int generic_array_get(
                 a = ci->array;
                 i -= ci->total;
                 t = ci->total;
+        } else {
+                uint64_t ia, it;
+
+                /* Otherwise, let's see if the entry array index can tell us where to start */
+                r = entry_array_index_get(f, first, i, &ia, &it);
+                if (r < 0)
+                        log_debug_errno(r, "Failed to look up entry array in index, ignoring: %m");
+                else if (r > 0) {
+                        a = ia;
+                        i -= it;
+                        t = it;
+                }
         }
 
         while (a > 0) {
@@ -2132,6 +2806,67 @@ enum {
         TEST_RIGHT
 };
 
+static int entry_array_index_bisect(
+                JournalFile *f,
+                uint64_t first,
+                uint64_t n,
+                uint64_t needle,
+                int (*test_object)(JournalFile *f, uint64_t p, uint64_t needle),
+                uint64_t *ret_array,
+                uint64_t *ret_total) {
+
+        uint64_t begin, end, left, right;
+        Object *o;
+        int r, t;
+
+        assert(f);
+        assert(test_object);
+        assert(ret_array);
+        assert(ret_total);
+
+        /* Finds the last entry array object among the first n items of the chain that begins with an entry
+         * strictly before the needle. All arrays before it can be skipped when bisecting, whichever the
+         * direction is. */
+
+        r = entry_array_index_find_chain(f, first, &o, &begin, &end);
+        if (r <= 0)
+                return r;
+
+        left = begin;
+        right = end;
+        while (left < right) {
+                uint64_t m = left + (right - left) / 2, p;
+
+                if (le64toh(o->entry_array_index.items[m].total) >= n) {
+                        right = m;
+                        continue;
+                }
+
+                p = le64toh(o->entry_array_index.items[m].first_entry_offset);
+
+                t = test_object(f, p, needle);
+                if (t < 0)
+                        return t;
+
+                /* test_object() might have moved the mmap window */
+                r = journal_file_move_to_object(f, OBJECT_ENTRY_ARRAY_INDEX, le64toh(f->header->entry_array_index_offset), &o);
+                if (r < 0)
+                        return r;
+
+                if (t == TEST_LEFT)
+                        left = m + 1;
+                else
+                        right = m;
+        }
+
+        if (left == begin)
+                return 0;
+
+        *ret_array = le64toh(o->entry_array_index.items[left - 1].array_offset);
+        *ret_total = le64toh(o->entry_array_index.items[left - 1].total);
+        return 1;
+}
+
 static int generic_array_bisect(
                 JournalFile *f,
                 uint64_t first,
@@ -2143,7 +2878,7 @@ static int generic_array_bisect(
                 uint64_t *offset,
                 uint64_t *idx) {
 
-        uint64_t a, p, t = 0, i = 0, last_p = 0, last_index = (uint64_t) -1;
+        uint64_t a, p, t = 0, i = 0, last_p = 0, last_index = (uint64_t) -1, ia, it;
         bool subtract_one = false;
         Object *o, *array = NULL;
         int r;
@@ -2180,6 +2915,17 @@ static int generic_array_bisect(
                 }
         }
 
+        /* If the entry array index gets us further along the chain, skip ahead even more */
+        r = entry_array_index_bisect(f, first, n + t, needle, test_object, &ia, &it);
+        if (r < 0)
+                log_debug_errno(r, "Failed to bisect entry array index, ignoring: %m");
+        else if (r > 0 && it > t) {
+                a = ia;
+                n -= it - t;
+                t = it;
+                last_index = (uint64_t) -1;
+        }
+
         while (a > 0) {
                 uint64_t left, right, k, lp;
 
@@ -2490,6 +3236,288 @@ static int test_object_realtime(JournalFile *f, uint64_t p, uint64_t needle) {
                 return TEST_RIGHT;
 }
 
+static int journal_file_append_time_index(JournalFile *f) {
+        uint64_t p, i, n;
+        Object *o;
+        int r;
+
+        assert(f);
+        assert(f->header);
+
+        if (!JOURNAL_HEADER_CONTAINS(f->header, time_index_offset))
+                return -EOPNOTSUPP;
+        if (f->header->time_index_offset != 0)
+                return 0;
+
+        n = le64toh(f->header->n_entries);
+        if (n == 0)
+                return 0;
+
+        /* If the file wasn't empty when we opened it, we didn't see all entries being appended, and need to
+         * go through all of them once now. */
+        if (f->time_index_incomplete) {
+                f->time_index = mfree(f->time_index);
+                f->n_time_index = f->n_time_index_allocated = 0;
+                f->time_index_broken = false;
+
+                for (i = 0; i < n && !f->time_index_broken; i++) {
+                        r = generic_array_get(f, le64toh(f->header->entry_array_offset), i, &o, NULL);
+                        if (r < 0)
+                                return r;
+                        if (r == 0)
+                                return -EBADMSG;
+
+                        journal_file_time_index_add(f, le64toh(o->entry.realtime), i);
+                }
+
+                f->time_index_incomplete = false;
+        }
+
+        if (f->time_index_broken || f->n_time_index == 0)
+                return 0;
+
+        r = journal_file_append_object(f, OBJECT_TIME_INDEX,
+                                       offsetof(Object, time_index.items) + f->n_time_index * sizeof(TimeIndexItem),
+                                       &o, &p);
+        if (r < 0)
+                return r;
+
+        memcpy(o->time_index.items, f->time_index, f->n_time_index * sizeof(TimeIndexItem));
+
+#if HAVE_GCRYPT
+        r = journal_file_hmac_put_object(f, OBJECT_TIME_INDEX, o, p);
+        if (r < 0)
+                return r;
+#endif
+
+        f->header->time_index_offset = htole64(p);
+
+        log_debug("Added time index of %zu items to %s.", f->n_time_index, f->path);
+
+        f->time_index = mfree(f->time_index);
+        f->n_time_index = f->n_time_index_allocated = 0;
+
+        return 0;
+}
+
+static int entry_array_index_add_chain(JournalFile *f, uint64_t first) {
+        uint64_t a, t = 0;
+        Object *o;
+        int r;
+
+        assert(f);
+
+        for (a = first; a > 0 && !f->entry_array_index_broken; a = le64toh(o->entry_array.next_entry_array_offset)) {
+                r = journal_file_move_to_object(f, OBJECT_ENTRY_ARRAY, a, &o);
+                if (r < 0)
+                        return r;
+
+                if (o->entry_array.items[0] == 0)
+                        break;
+
+                journal_file_entry_array_index_add(f, first, a, le64toh(o->entry_array.items[0]), t);
+                t += journal_file_entry_array_n_items(o);
+        }
+
+        return 0;
+}
+
+static int entry_array_index_item_compare(const EntryArrayIndexItem *a, const EntryArrayIndexItem *b) {
+        int r;
+
+        r = CMP(le64toh(a->chain_offset), le64toh(b->chain_offset));
+        if (r != 0)
+                return r;
+
+        return CMP(le64toh(a->total), le64toh(b->total));
+}
+
+static int journal_file_append_entry_array_index(JournalFile *f) {
+        size_t i, j, k, n = 0;
+        uint64_t p;
+        Object *o;
+        int r;
+
+        assert(f);
+        assert(f->header);
+
+        if (!JOURNAL_HEADER_CONTAINS(f->header, entry_array_index_offset))
+                return -EOPNOTSUPP;
+        if (f->header->entry_array_index_offset != 0)
+                return 0;
+
+        /* If the file wasn't empty when we opened it, we didn't see all entry arrays being appended, and
+         * need to go through the chains of the file and of all data objects once now. */
+        if (f->entry_array_index_incomplete) {
+                uint64_t m;
+
+                f->entry_array_index = mfree(f->entry_array_index);
+                f->n_entry_array_index = f->n_entry_array_index_allocated = 0;
+                f->entry_array_index_broken = false;
+
+                r = entry_array_index_add_chain(f, le64toh(f->header->entry_array_offset));
+                if (r < 0)
+                        return r;
+
+                r = journal_file_map_data_hash_table(f);
+                if (r < 0)
+                        return r;
+
+                m = le64toh(f->header->data_hash_table_size) / sizeof(HashItem);
+                for (i = 0; i < m && !f->entry_array_index_broken; i++) {
+                        uint64_t q = le64toh(f->data_hash_table[i].head_hash_offset);
+
+                        while (q > 0) {
+                                uint64_t chain;
+
+                                r = journal_file_move_to_object(f, OBJECT_DATA, q, &o);
+                                if (r < 0)
+                                        return r;
+
+                                chain = le64toh(o->data.entry_array_offset);
+                                q = le64toh(o->data.next_hash_offset);
+
+                                r = entry_array_index_add_chain(f, chain);
+                                if (r < 0)
+                                        return r;
+                        }
+                }
+
+                f->entry_array_index_incomplete = false;
+        }
+
+        if (f->entry_array_index_broken)
+                return 0;
+
+        /* Only keep the chains long enough to be worth it */
+        typesafe_qsort(f->entry_array_index, f->n_entry_array_index, entry_array_index_item_compare);
+
+        for (i = 0; i < f->n_entry_array_index; i = j) {
+                for (j = i + 1; j < f->n_entry_array_index; j++)
+                        if (f->entry_array_index[j].chain_offset != f->entry_array_index[i].chain_offset)
+                                break;
+
+                if (j - i < ENTRY_ARRAY_INDEX_MIN_ARRAYS)
+                        continue;
+
+                for (k = i; k < j; k++)
+                        f->entry_array_index[n++] = f->entry_array_index[k];
+        }
+
+        if (n > 0) {
+                r = journal_file_append_object(f, OBJECT_ENTRY_ARRAY_INDEX,
+                                               offsetof(Object, entry_array_index.items) + n * sizeof(EntryArrayIndexItem),
+                                               &o, &p);
+                if (r < 0)
+                        return r;
+
+                memcpy(o->entry_array_index.items, f->entry_array_index, n * sizeof(EntryArrayIndexItem));
+
+#if HAVE_GCRYPT
+                r = journal_file_hmac_put_object(f, OBJECT_ENTRY_ARRAY_INDEX, o, p);
+                if (r < 0)
+                        return r;
+#endif
+
+                f->header->entry_array_index_offset = htole64(p);
+
+                log_debug("Added entry array index of %zu items to %s.", n, f->path);
+        }
+
+        f->entry_array_index = mfree(f->entry_array_index);
+        f->n_entry_array_index = f->n_entry_array_index_allocated = 0;
+
+        return 0;
+}
+
+static int journal_file_move_to_entry_by_realtime_indexed(
+                JournalFile *f,
+                uint64_t realtime,
+                direction_t direction,
+                Object **ret,
+                uint64_t *offset) {
+
+        uint64_t n, n_items, left, right, begin, end;
+        Object *o;
+        int r;
+
+        assert(f);
+        assert(f->header);
+
+        /* Looks up the minute the needle is in from the time index, and then bisects only the few entries of
+         * that minute, rather than the whole entry array, which touches far fewer pages. */
+
+        n = le64toh(f->header->n_entries);
+
+        r = journal_file_move_to_object(f, OBJECT_TIME_INDEX, le64toh(f->header->time_index_offset), &o);
+        if (r < 0)
+                return r;
+
+        n_items = (le64toh(o->object.size) - offsetof(TimeIndexObject, items)) / sizeof(TimeIndexItem);
+
+        /* Find the first item after the needle */
+        left = 0;
+        right = n_items;
+        while (left < right) {
+                uint64_t m = left + (right - left) / 2;
+
+                if (le64toh(o->time_index.items[m].realtime) <= realtime)
+                        left = m + 1;
+                else
+                        right = m;
+        }
+
+        if (left == 0) {
+                /* The needle is before the first entry */
+                if (direction == DIRECTION_UP)
+                        return 0;
+
+                begin = end = 0;
+        } else {
+                begin = le64toh(o->time_index.items[left - 1].entry_index);
+                end = left < n_items ? le64toh(o->time_index.items[left].entry_index) : n;
+        }
+
+        if (begin > end || end > n)
+                return -EBADMSG;
+
+        /* The entry at 'begin' is at or before the needle, the one at 'end' (if any) after it */
+        left = begin;
+        right = end;
+        while (left < right) {
+                uint64_t m = left + (right - left) / 2;
+                uint64_t t;
+
+                r = generic_array_get(f, le64toh(f->header->entry_array_offset), m, &o, NULL);
+                if (r < 0)
+                        return r;
+                if (r == 0)
+                        return -EBADMSG;
+
+                t = le64toh(o->entry.realtime);
+                if (direction == DIRECTION_DOWN ? t < realtime : t <= realtime)
+                        left = m + 1;
+                else
+                        right = m;
+        }
+
+        if (direction == DIRECTION_UP) {
+                if (left == 0)
+                        return 0;
+
+                left--;
+        } else if (left >= n)
+                return 0;
+
+        r = generic_array_get(f, le64toh(f->header->entry_array_offset), left, ret, offset);
+        if (r < 0)
+                return r;
+        if (r == 0)
+                return -EBADMSG;
+
+        return 1;
+}
+
 int journal_file_move_to_entry_by_realtime(
                 JournalFile *f,
                 uint64_t realtime,
@@ -2499,6 +3527,16 @@ int journal_file_move_to_entry_by_realtime(
         assert(f);
         assert(f->header);
 
+        if (JOURNAL_HEADER_CONTAINS(f->header, time_index_offset) && f->header->time_index_offset != 0) {
+                int r;
+
+                r = journal_file_move_to_entry_by_realtime_indexed(f, realtime, direction, ret, offset);
+                if (r != -EBADMSG)
+                        return r;
+
+                log_debug_errno(r, "Time index of %s is invalid, bisecting entry array instead: %m", f->path);
+        }
+
         return generic_array_bisect(f,
                                     le64toh(f->header->entry_array_offset),
                                     le64toh(f->header->n_entries),
@@ -3026,6 +4064,26 @@ void journal_file_dump(JournalFile *f) {
                                le64toh(o->tag.epoch));
                         break;
 
+                case OBJECT_DICTIONARY:
+                        printf("Type: OBJECT_DICTIONARY id=%"PRIu32"\n",
+                               le32toh(o->dictionary.dict_id));
+                        break;
+
+                case OBJECT_TRIGRAM_INDEX:
+                        printf("Type: OBJECT_TRIGRAM_INDEX items=%"PRIu64"\n",
+                               (le64toh(o->object.size) - offsetof(TrigramIndexObject, items)) / sizeof(TrigramIndexItem));
+                        break;
+
+                case OBJECT_TIME_INDEX:
+                        printf("Type: OBJECT_TIME_INDEX items=%"PRIu64"\n",
+                               (le64toh(o->object.size) - offsetof(TimeIndexObject, items)) / sizeof(TimeIndexItem));
+                        break;
+
+                case OBJECT_ENTRY_ARRAY_INDEX:
+                        printf("Type: OBJECT_ENTRY_ARRAY_INDEX items=%"PRIu64"\n",
+                               (le64toh(o->object.size) - offsetof(EntryArrayIndexObject, items)) / sizeof(EntryArrayIndexItem));
+                        break;
+
                 default:
                         printf("Type: unknown (%i)\n", o->object.type);
                         break;
@@ -3071,7 +4129,7 @@ void journal_file_print_header(JournalFile *f) {
                "Sequential number ID: %s\n"
                "State: %s\n"
                "Compatible flags:%s%s\n"
-               "Incompatible flags:%s%s%s\n"
+               "Incompatible flags:%s%s%s%s%s\n"
                "Header size: %"PRIu64"\n"
                "Arena size: %"PRIu64"\n"
                "Data hash table size: %"PRIu64"\n"
@@ -3096,6 +4154,8 @@ void journal_file_print_header(JournalFile *f) {
                (le32toh(f->header->compatible_flags) & ~HEADER_COMPATIBLE_ANY) ? " ???" : "",
                JOURNAL_HEADER_COMPRESSED_XZ(f->header) ? " COMPRESSED-XZ" : "",
                JOURNAL_HEADER_COMPRESSED_LZ4(f->header) ? " COMPRESSED-LZ4" : "",
+               JOURNAL_HEADER_COMPRESSED_ZSTD(f->header) ? " COMPRESSED-ZSTD" : "",
+               JOURNAL_HEADER_ZSTD_DICTIONARY(f->header) ? " ZSTD-DICTIONARY" : "",
                (le32toh(f->header->incompatible_flags) & ~HEADER_INCOMPATIBLE_ANY) ? " ???" : "",
                le64toh(f->header->header_size),
                le64toh(f->header->arena_size),
@@ -3128,6 +4188,18 @@ void journal_file_print_header(JournalFile *f) {
         if (JOURNAL_HEADER_CONTAINS(f->header, n_entry_arrays))
                 printf("Entry array objects: %"PRIu64"\n",
                        le64toh(f->header->n_entry_arrays));
+        if (JOURNAL_HEADER_CONTAINS(f->header, dictionary_offset) && f->header->dictionary_offset != 0)
+                printf("Dictionary object: "OFSfmt"\n",
+                       le64toh(f->header->dictionary_offset));
+        if (JOURNAL_HEADER_CONTAINS(f->header, trigram_index_offset) && f->header->trigram_index_offset != 0)
+                printf("Trigram index object: "OFSfmt"\n",
+                       le64toh(f->header->trigram_index_offset));
+        if (JOURNAL_HEADER_CONTAINS(f->header, time_index_offset) && f->header->time_index_offset != 0)
+                printf("Time index object: "OFSfmt"\n",
+                       le64toh(f->header->time_index_offset));
+        if (JOURNAL_HEADER_CONTAINS(f->header, entry_array_index_offset) && f->header->entry_array_index_offset != 0)
+                printf("Entry array index object: "OFSfmt"\n",
+                       le64toh(f->header->entry_array_index_offset));
 
         if (fstat(f->fd, &st) >= 0)
                 printf("Disk usage: %s\n", format_bytes(bytes, sizeof(bytes), (uint64_t) st.st_blocks * 512ULL));
@@ -3208,7 +4280,9 @@ int journal_file_open(
                 .prot = prot_from_flags(flags),
                 .writable = (flags & O_ACCMODE) != O_RDONLY,
 
-#if HAVE_LZ4
+#if HAVE_ZSTD
+                .compress_zstd = compress,
+#elif HAVE_LZ4
                 .compress_lz4 = compress,
 #elif HAVE_XZ
                 .compress_xz = compress,
@@ -3358,6 +4432,10 @@ int journal_file_open(
                         goto fail;
         }
 
+        /* Entries appended before we opened the file aren't in the time and entry array indexes yet */
+        if (f->writable && f->header->n_entries != 0)
+                f->time_index_incomplete = f->entry_array_index_incomplete = true;
+
 #if HAVE_GCRYPT
         if (!newly_created && f->writable) {
                 r = journal_file_fss_load(f);
@@ -3432,6 +4510,7 @@ fail:
 
 int journal_file_archive(JournalFile *f) {
         _cleanup_free_ char *p = NULL;
+        int r;
 
         assert(f);
 
@@ -3461,6 +4540,15 @@ int journal_file_archive(JournalFile *f) {
         /* Sync the rename to disk */
         (void) fsync_directory_of_file(f->fd);
 
+        /* The file won't be appended to anymore, hence now is the time to add the indexes */
+        r = journal_file_append_time_index(f);
+        if (r < 0)
+                log_debug_errno(r, "Failed to append time index to %s, ignoring: %m", f->path);
+
+        r = journal_file_append_entry_array_index(f);
+        if (r < 0)
+                log_debug_errno(r, "Failed to append entry array index to %s, ignoring: %m", f->path);
+
         /* Set as archive so offlining commits w/state=STATE_ARCHIVED. Previously we would set old_file->header->state
          * to STATE_ARCHIVED directly here, but journal_file_set_offline() short-circuits when state != STATE_ONLINE,
          * which would result in the rotated journal never getting fsync() called before closing.  Now we simply queue
@@ -3618,7 +4706,105 @@ int journal_file_open_reliably(
                                  deferred_closes, template, ret);
 }
 
-int journal_file_copy_entry(JournalFile *from, JournalFile *to, Object *o, uint64_t p) {
+/* Bounds the memory used by the copy cache, about 64 bytes per item */
+#define COPY_CACHE_ITEMS_MAX (256U*1024U)
+
+typedef struct CopyCacheItem {
+        JournalFile *from;
+        uint64_t from_offset;
+        uint64_t to_offset;
+        le64_t hash;
+} CopyCacheItem;
+
+struct JournalFileCopyCache {
+        sd_id128_t to_file_id;
+        Set *items;
+};
+
+static void copy_cache_item_hash_func(const CopyCacheItem *i, struct siphash *state) {
+        siphash24_compress(&i->from, sizeof(i->from), state);
+        siphash24_compress(&i->from_offset, sizeof(i->from_offset), state);
+}
+
+static int copy_cache_item_compare_func(const CopyCacheItem *a, const CopyCacheItem *b) {
+        int r;
+
+        r = CMP(a->from, b->from);
+        if (r != 0)
+                return r;
+
+        return CMP(a->from_offset, b->from_offset);
+}
+
+DEFINE_PRIVATE_HASH_OPS_WITH_KEY_DESTRUCTOR(copy_cache_item_hash_ops, CopyCacheItem,
+                                            copy_cache_item_hash_func, copy_cache_item_compare_func,
+                                            free);
+
+JournalFileCopyCache* journal_file_copy_cache_free(JournalFileCopyCache *c) {
+        if (!c)
+                return NULL;
+
+        set_free(c->items);
+        return mfree(c);
+}
+
+static int journal_file_copy_cache_prepare(JournalFileCopyCache **cache, JournalFile *to) {
+        JournalFileCopyCache *c;
+
+        assert(cache);
+        assert(to);
+
+        c = *cache;
+        if (!c) {
+                c = new0(JournalFileCopyCache, 1);
+                if (!c)
+                        return -ENOMEM;
+
+                c->to_file_id = to->header->file_id;
+                *cache = c;
+        }
+
+        /* The offsets are only valid for the file they were recorded for. Compare the file ids rather than
+         * the pointers, as after a rotation the new file might be allocated at the same address. */
+        if (!sd_id128_equal(c->to_file_id, to->header->file_id)) {
+                set_clear(c->items);
+                c->to_file_id = to->header->file_id;
+        }
+
+        return 0;
+}
+
+static void journal_file_copy_cache_put(JournalFileCopyCache *c, JournalFile *from, uint64_t from_offset, uint64_t to_offset, le64_t hash) {
+        CopyCacheItem *i;
+
+        assert(c);
+
+        /* Failing to remember an offset only means we look the payload up again, hence ignore errors. Once
+         * the cache is full start over, entries close to each other are the ones most likely to share
+         * data. */
+
+        if (set_size(c->items) >= COPY_CACHE_ITEMS_MAX)
+                set_clear(c->items);
+
+        if (set_ensure_allocated(&c->items, &copy_cache_item_hash_ops) < 0)
+                return;
+
+        i = new(CopyCacheItem, 1);
+        if (!i)
+                return;
+
+        *i = (CopyCacheItem) {
+                .from = from,
+                .from_offset = from_offset,
+                .to_offset = to_offset,
+                .hash = hash,
+        };
+
+        if (set_put(c->items, i) <= 0)
+                free(i);
+}
+
+int journal_file_copy_entry(JournalFile *from, JournalFile *to, Object *o, uint64_t p, JournalFileCopyCache **cache) {
         uint64_t i, n;
         uint64_t q, xor_hash = 0;
         int r;
@@ -3634,6 +4820,12 @@ int journal_file_copy_entry(JournalFile *from, JournalFile *to, Object *o, uint6
         if (!to->writable)
                 return -EPERM;
 
+        if (cache) {
+                r = journal_file_copy_cache_prepare(cache, to);
+                if (r < 0)
+                        return r;
+        }
+
         ts.monotonic = le64toh(o->entry.monotonic);
         ts.realtime = le64toh(o->entry.realtime);
         boot_id = &o->entry.boot_id;
@@ -3652,6 +4844,19 @@ int journal_file_copy_entry(JournalFile *from, JournalFile *to, Object *o, uint6
                 q = le64toh(o->entry.items[i].object_offset);
                 le_hash = o->entry.items[i].hash;
 
+                if (cache) {
+                        CopyCacheItem *c;
+
+                        /* We copied this data object before, no need to read, hash and look it up again */
+                        c = set_get((*cache)->items, &(CopyCacheItem) { .from = from, .from_offset = q });
+                        if (c) {
+                                xor_hash ^= le64toh(c->hash);
+                                items[i].object_offset = htole64(c->to_offset);
+                                items[i].hash = c->hash;
+                                continue;
+                        }
+                }
+
                 r = journal_file_move_to_object(from, OBJECT_DATA, q, &o);
                 if (r < 0)
                         return r;
@@ -3667,11 +4872,11 @@ int journal_file_copy_entry(JournalFile *from, JournalFile *to, Object *o, uint6
                         return -E2BIG;
 
                 if (o->object.flags & OBJECT_COMPRESSION_MASK) {
-#if HAVE_XZ || HAVE_LZ4
+#if HAVE_XZ || HAVE_LZ4 || HAVE_ZSTD
                         size_t rsize = 0;
 
-                        r = decompress_blob(o->object.flags & OBJECT_COMPRESSION_MASK,
-                                            o->data.payload, l, &from->compress_buffer, &from->compress_buffer_size, &rsize, 0);
+                        r = journal_file_decompress_blob(from, o->object.flags & OBJECT_COMPRESSION_MASK,
+                                                         o->data.payload, l, &from->compress_buffer, &from->compress_buffer_size, &rsize, 0);
                         if (r < 0)
                                 return r;
 
@@ -3691,6 +4896,9 @@ int journal_file_copy_entry(JournalFile *from, JournalFile *to, Object *o, uint6
                 items[i].object_offset = htole64(h);
                 items[i].hash = u->data.hash;
 
+                if (cache)
+                        journal_file_copy_cache_put(*cache, from, q, h, u->data.hash);
+
                 r = journal_file_move_to_object(from, OBJECT_ENTRY, p, &o);
                 if (r < 0)
                         return r;
@@ -3863,6 +5071,117 @@ int journal_file_get_cutoff_monotonic_usec(JournalFile *f, sd_id128_t boot_id, u
         return 1;
 }
 
+static int boot_range_add(JournalBootRange **boots, size_t *n_allocated, size_t *n_boots, Object *o) {
+        JournalBootRange *b;
+        usec_t t;
+
+        assert(boots);
+        assert(n_allocated);
+        assert(n_boots);
+        assert(o);
+
+        t = le64toh(o->entry.realtime);
+
+        /* Entries of the same boot are next to each other, unless files were merged, hence it's enough to look
+         * at the last item. The caller merges whatever is left. */
+        if (*n_boots > 0) {
+                b = *boots + *n_boots - 1;
+
+                if (sd_id128_equal(b->boot_id, o->entry.boot_id)) {
+                        b->first_realtime = MIN(b->first_realtime, t);
+                        b->last_realtime = MAX(b->last_realtime, t);
+                        return 0;
+                }
+        }
+
+        if (!GREEDY_REALLOC(*boots, *n_allocated, *n_boots + 1))
+                return -ENOMEM;
+
+        (*boots)[(*n_boots)++] = (JournalBootRange) {
+                .boot_id = o->entry.boot_id,
+                .first_realtime = t,
+                .last_realtime = t,
+        };
+
+        return 0;
+}
+
+int journal_file_get_boots(JournalFile *f, JournalBootRange **boots, size_t *n_allocated, size_t *n_boots) {
+        uint64_t p;
+        Object *o;
+        int r;
+
+        assert(f);
+        assert(boots);
+        assert(n_allocated);
+        assert(n_boots);
+
+        /* journald adds _BOOT_ID= to every entry, hence the data objects of that field list all boots, and
+         * the first and last entry of each is found without looking at any other entries. */
+        r = journal_file_find_field_object(f, "_BOOT_ID", STRLEN("_BOOT_ID"), &o, NULL);
+        if (r < 0)
+                return r;
+        if (r > 0) {
+                p = le64toh(o->field.head_data_offset);
+
+                while (p > 0) {
+                        uint64_t next, n;
+
+                        r = journal_file_move_to_object(f, OBJECT_DATA, p, &o);
+                        if (r < 0)
+                                return r;
+
+                        next = le64toh(o->data.next_field_offset);
+                        n = le64toh(o->data.n_entries);
+
+                        if (n > 0) {
+                                r = journal_file_move_to_object(f, OBJECT_ENTRY, le64toh(o->data.entry_offset), &o);
+                                if (r < 0)
+                                        return r;
+
+                                r = boot_range_add(boots, n_allocated, n_boots, o);
+                                if (r < 0)
+                                        return r;
+
+                                r = journal_file_move_to_object(f, OBJECT_DATA, p, &o);
+                                if (r < 0)
+                                        return r;
+
+                                r = generic_array_get_plus_one(f,
+                                                               le64toh(o->data.entry_offset),
+                                                               le64toh(o->data.entry_array_offset),
+                                                               n - 1,
+                                                               &o, NULL);
+                                if (r < 0)
+                                        return r;
+                                if (r > 0) {
+                                        r = boot_range_add(boots, n_allocated, n_boots, o);
+                                        if (r < 0)
+                                                return r;
+                                }
+                        }
+
+                        p = next;
+                }
+
+                return 0;
+        }
+
+        /* Files written by something else than journald may lack the field, look at every entry then */
+        p = 0;
+        for (;;) {
+                r = journal_file_next_entry(f, p, DIRECTION_DOWN, &o, &p);
+                if (r < 0)
+                        return r;
+                if (r == 0)
+                        return 0;
+
+                r = boot_range_add(boots, n_allocated, n_boots, o);
+                if (r < 0)
+                        return r;
+        }
+}
+
 bool journal_file_rotate_suggested(JournalFile *f, usec_t max_file_usec) {
         assert(f);
         assert(f->header);
@@ -3902,6 +5221,15 @@ bool journal_file_rotate_suggested(JournalFile *f, usec_t max_file_usec) {
                         return true;
                 }
 
+        /* If the file is set up for a different compression algorithm than the one we'd use for new objects
+         * (e.g. because it was created before we were built with zstd support), suggest rotation, so that a
+         * new file with consistent header flags is started. */
+        if (JOURNAL_FILE_COMPRESS(f) &&
+            (le32toh(f->header->incompatible_flags) & HEADER_INCOMPATIBLE_COMPRESSED_DEFAULT) == 0) {
+                log_debug("%s uses a different compression algorithm, suggesting rotation.", f->path);
+                return true;
+        }
+
         /* Are the data objects properly indexed by field objects? */
         if (JOURNAL_HEADER_CONTAINS(f->header, n_data) &&
             JOURNAL_HEADER_CONTAINS(f->header, n_fields) &&
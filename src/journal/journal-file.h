@@ -11,6 +11,7 @@
 #include "sd-event.h"
 #include "sd-id128.h"
 
+#include "compress.h"
 #include "hashmap.h"
 #include "journal-def.h"
 #include "mmap-cache.h"
@@ -56,6 +57,8 @@ typedef enum OfflineState {
         OFFLINE_DONE
 } OfflineState;
 
+typedef struct DataCacheItem DataCacheItem;
+
 typedef struct JournalFile {
         int fd;
         MMapFileDescriptor *cache_fd;
@@ -67,6 +70,7 @@ typedef struct JournalFile {
         bool writable:1;
         bool compress_xz:1;
         bool compress_lz4:1;
+        bool compress_zstd:1;
         bool seal:1;
         bool defrag_on_close:1;
         bool close_fd:1;
@@ -76,6 +80,11 @@ typedef struct JournalFile {
         LocationType location_type;
         uint64_t last_n_entries;
 
+        /* The range of the file that was handed to the prefetch threads last, see SD_JOURNAL_PARALLEL */
+        uint64_t prefetch_begin, prefetch_end;
+        /* The entry whose data objects were prefetched last */
+        uint64_t prefetch_entry_offset;
+
         char *path;
         struct stat last_stat;
         usec_t last_stat_usec;
@@ -98,6 +107,27 @@ typedef struct JournalFile {
         usec_t post_change_timer_period;
 
         OrderedHashmap *chain_cache;
+        DataCacheItem *data_cache;
+
+        /* The time index collected while appending entries, written out when the file is archived */
+        TimeIndexItem *time_index;
+        size_t n_time_index;
+        size_t n_time_index_allocated;
+        uint64_t time_index_last_realtime;
+        bool time_index_incomplete;
+        bool time_index_broken;
+
+        /* The entry array objects appended, the longer chains of which are indexed when the file is archived */
+        EntryArrayIndexItem *entry_array_index;
+        size_t n_entry_array_index;
+        size_t n_entry_array_index_allocated;
+        bool entry_array_index_incomplete;
+        bool entry_array_index_broken;
+
+        /* Windows kept mapped while the data of the current entry is referenced by stable pointers */
+        MMapWindow **pinned_windows;
+        size_t n_pinned_windows;
+        size_t n_pinned_windows_allocated;
 
         pthread_t offline_thread;
         volatile OfflineState offline_state;
@@ -105,15 +135,33 @@ typedef struct JournalFile {
         unsigned last_seen_generation;
 
         uint64_t compress_threshold_bytes;
-#if HAVE_XZ || HAVE_LZ4
+#if HAVE_XZ || HAVE_LZ4 || HAVE_ZSTD
         void *compress_buffer;
         size_t compress_buffer_size;
 #endif
 
+#if HAVE_ZSTD
+        CompressDictionary *dictionary;
+
+        /* Payloads of small DATA objects collected while the file has no dictionary yet */
+        void *dictionary_samples;
+        size_t dictionary_samples_size;
+        size_t dictionary_samples_allocated;
+        size_t *dictionary_sample_sizes;
+        size_t dictionary_sample_sizes_allocated;
+        unsigned n_dictionary_samples;
+        bool dictionary_failed;
+#endif
+
 #if HAVE_GCRYPT
         gcry_md_hd_t hmac;
         bool hmac_running;
 
+        /* While a batch of entries is appended, the HMAC input is collected here and written in one go */
+        uint8_t *hmac_buffer;
+        size_t hmac_buffer_size;
+        bool hmac_batch;
+
         FSSHeader *fss_file;
         size_t fss_file_size;
 
@@ -194,8 +242,29 @@ static inline bool VALID_EPOCH(uint64_t u) {
 #define JOURNAL_HEADER_COMPRESSED_LZ4(h) \
         (!!(le32toh((h)->incompatible_flags) & HEADER_INCOMPATIBLE_COMPRESSED_LZ4))
 
+#define JOURNAL_HEADER_COMPRESSED_ZSTD(h) \
+        (!!(le32toh((h)->incompatible_flags) & HEADER_INCOMPATIBLE_COMPRESSED_ZSTD))
+
+#define JOURNAL_HEADER_ZSTD_DICTIONARY(h) \
+        (!!(le32toh((h)->incompatible_flags) & HEADER_INCOMPATIBLE_ZSTD_DICTIONARY))
+
 int journal_file_move_to_object(JournalFile *f, ObjectType type, uint64_t offset, Object **ret);
 
+/* Keeps the object of the specified type that was moved to last mapped, until journal_file_unpin_objects() */
+int journal_file_pin_object(JournalFile *f, ObjectType type);
+void journal_file_unpin_objects(JournalFile *f);
+
+int journal_file_decompress_blob(
+                JournalFile *f, int compression,
+                const void *src, uint64_t src_size,
+                void **dst, size_t *dst_alloc_size, size_t* dst_size, size_t dst_max);
+int journal_file_decompress_startswith(
+                JournalFile *f, int compression,
+                const void *src, uint64_t src_size,
+                void **buffer, size_t *buffer_size,
+                const void *prefix, size_t prefix_len,
+                uint8_t extra);
+
 uint64_t journal_file_entry_n_items(Object *o) _pure_;
 uint64_t journal_file_entry_array_n_items(Object *o) _pure_;
 uint64_t journal_file_hash_table_n_items(Object *o) _pure_;
@@ -210,6 +279,19 @@ int journal_file_append_entry(
                 Object **ret,
                 uint64_t *offset);
 
+typedef struct JournalEntryIovec {
+        const dual_timestamp *ts;  /* NULL means "now" */
+        const sd_id128_t *boot_id; /* NULL means "keep the boot ID of the previous entry" */
+        const struct iovec *iovec;
+        unsigned n_iovec;
+} JournalEntryIovec;
+
+int journal_file_append_entries(
+                JournalFile *f,
+                const JournalEntryIovec entries[], size_t n_entries,
+                uint64_t *seqno,
+                size_t *ret_n_appended);
+
 int journal_file_find_data_object(JournalFile *f, const void *data, uint64_t size, Object **ret, uint64_t *offset);
 int journal_file_find_data_object_with_hash(JournalFile *f, const void *data, uint64_t size, uint64_t hash, Object **ret, uint64_t *offset);
 
@@ -232,7 +314,14 @@ int journal_file_move_to_entry_by_seqnum_for_data(JournalFile *f, uint64_t data_
 int journal_file_move_to_entry_by_realtime_for_data(JournalFile *f, uint64_t data_offset, uint64_t realtime, direction_t direction, Object **ret, uint64_t *offset);
 int journal_file_move_to_entry_by_monotonic_for_data(JournalFile *f, uint64_t data_offset, sd_id128_t boot_id, uint64_t monotonic, direction_t direction, Object **ret, uint64_t *offset);
 
-int journal_file_copy_entry(JournalFile *from, JournalFile *to, Object *o, uint64_t p);
+/* Remembers where the data objects of the source files ended up in the destination file while entries are
+ * copied in bulk, so that each distinct payload is only looked up once. */
+typedef struct JournalFileCopyCache JournalFileCopyCache;
+
+JournalFileCopyCache* journal_file_copy_cache_free(JournalFileCopyCache *c);
+DEFINE_TRIVIAL_CLEANUP_FUNC(JournalFileCopyCache*, journal_file_copy_cache_free);
+
+int journal_file_copy_entry(JournalFile *from, JournalFile *to, Object *o, uint64_t p, JournalFileCopyCache **cache);
 
 void journal_file_dump(JournalFile *f);
 void journal_file_print_header(JournalFile *f);
@@ -252,6 +341,16 @@ void journal_default_metrics(JournalMetrics *m, int fd);
 int journal_file_get_cutoff_realtime_usec(JournalFile *f, usec_t *from, usec_t *to);
 int journal_file_get_cutoff_monotonic_usec(JournalFile *f, sd_id128_t boot, usec_t *from, usec_t *to);
 
+typedef struct JournalBootRange {
+        sd_id128_t boot_id;
+        usec_t first_realtime;
+        usec_t last_realtime;
+} JournalBootRange;
+
+/* Appends the boots the file has entries of to the array, with the realtime range they cover in this file. The
+ * same boot may be listed more than once. */
+int journal_file_get_boots(JournalFile *f, JournalBootRange **boots, size_t *n_allocated, size_t *n_boots);
+
 bool journal_file_rotate_suggested(JournalFile *f, usec_t max_file_usec);
 
 int journal_file_map_data_hash_table(JournalFile *f);
@@ -259,5 +358,5 @@ int journal_file_map_field_hash_table(JournalFile *f);
 
 static inline bool JOURNAL_FILE_COMPRESS(JournalFile *f) {
         assert(f);
-        return f->compress_xz || f->compress_lz4;
+        return f->compress_xz || f->compress_lz4 || f->compress_zstd;
 }
@@ -11,6 +11,7 @@
 #include "hashmap.h"
 #include "journal-def.h"
 #include "journal-file.h"
+#include "journal-prefetch.h"
 #include "list.h"
 #include "set.h"
 
@@ -72,6 +73,11 @@ struct sd_journal {
 
         OrderedHashmap *files;
         IteratedCache *files_cache;
+
+        /* Archived files listed in a directory manifest, which are only opened once needed, and only if they
+         * cover the realtime range set with journal_set_realtime_range() */
+        Hashmap *deferred_files;
+        usec_t realtime_since, realtime_until;
         MMapCache *mmap;
 
         Location current_location;
@@ -93,6 +99,11 @@ struct sd_journal {
         JournalFile *unique_file;
         uint64_t unique_offset;
 
+        /* Iterating through boots */
+        JournalBootRange *boots;
+        size_t n_boots, n_boots_allocated;
+        size_t boots_index;
+
         /* Iterating through known fields */
         JournalFile *fields_file;
         uint64_t fields_offset;
@@ -100,6 +111,11 @@ struct sd_journal {
         char *fields_buffer;
         size_t fields_buffer_allocated;
 
+        /* Decompressed data of the current entry handed out by the _stable() data calls */
+        void **data_arena;
+        size_t n_data_arena;
+        size_t data_arena_allocated;
+
         int flags;
 
         bool on_network:1;
@@ -112,6 +128,9 @@ struct sd_journal {
         bool fields_file_lost:1;
         bool has_runtime_files:1;
         bool has_persistent_files:1;
+        bool prefetch_failed:1;
+        bool deferred_pending:1;
+        bool boots_loaded:1;
 
         size_t data_threshold;
 
@@ -119,10 +138,19 @@ struct sd_journal {
         Hashmap *directories_by_wd;
 
         Hashmap *errors;
+
+        JournalPrefetch *prefetch;
 };
 
 char *journal_make_match_string(sd_journal *j);
 void journal_print_header(sd_journal *j);
 
+void journal_set_realtime_range(sd_journal *j, usec_t since, usec_t until);
+int journal_open_deferred_files(sd_journal *j);
+int journal_unique_n_entries(sd_journal *j, uint64_t *ret);
+
 #define JOURNAL_FOREACH_DATA_RETVAL(j, data, l, retval)                     \
         for (sd_journal_restart_data(j); ((retval) = sd_journal_enumerate_data((j), &(data), &(l))) > 0; )
+
+#define JOURNAL_FOREACH_DATA_STABLE_RETVAL(j, data, l, retval)              \
+        for (sd_journal_restart_data(j); ((retval) = sd_journal_enumerate_data_stable((j), &(data), &(l))) > 0; )
@@ -0,0 +1,286 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "alloc-util.h"
+#include "dirent-util.h"
+#include "fd-util.h"
+#include "fileio.h"
+#include "journal-def.h"
+#include "journal-manifest.h"
+#include "parse-util.h"
+#include "path-util.h"
+#include "string-util.h"
+#include "strv.h"
+#include "tmpfile-util.h"
+
+JournalManifestEntry *journal_manifest_entry_free(JournalManifestEntry *e) {
+        if (!e)
+                return NULL;
+
+        free(e->filename);
+        return mfree(e);
+}
+
+DEFINE_HASH_OPS_WITH_VALUE_DESTRUCTOR(journal_manifest_entry_hash_ops, char, string_hash_func, string_compare_func,
+                                      JournalManifestEntry, journal_manifest_entry_free);
+
+static bool filename_is_archived_journal(const char *fn) {
+        assert(fn);
+
+        /* Only the names of archived files carry an '@'. The manifest is whitespace separated, hence names
+         * with whitespace can't be listed, but journald never generates those anyway. */
+
+        return endswith(fn, ".journal") &&
+                strchr(fn, '@') &&
+                fn[strcspn(fn, WHITESPACE)] == 0;
+}
+
+static int manifest_entry_read(int dir_fd, const struct dirent *de, JournalManifestEntry **ret) {
+        _cleanup_(journal_manifest_entry_freep) JournalManifestEntry *e = NULL;
+        _cleanup_close_ int fd = -1;
+        Header h;
+        ssize_t n;
+
+        assert(dir_fd >= 0);
+        assert(de);
+        assert(ret);
+
+        fd = openat(dir_fd, de->d_name, O_RDONLY|O_CLOEXEC|O_NOFOLLOW|O_NONBLOCK|O_NOATIME);
+        if (fd < 0) {
+                /* Maybe failed due to O_NOATIME and lack of privileges? */
+                fd = openat(dir_fd, de->d_name, O_RDONLY|O_CLOEXEC|O_NOFOLLOW|O_NONBLOCK);
+                if (fd < 0)
+                        return -errno;
+        }
+
+        /* Everything we need is in the part of the header that every file has */
+        n = pread(fd, &h, sizeof(h), 0);
+        if (n < 0)
+                return -errno;
+        if ((size_t) n < offsetof(Header, n_data) ||
+            memcmp(h.signature, HEADER_SIGNATURE, sizeof(h.signature)) != 0)
+                return -EBADMSG;
+
+        /* Empty files are removed by the next vacuum, there's nothing to find in them anyway */
+        if (le64toh(h.n_entries) <= 0) {
+                *ret = NULL;
+                return 0;
+        }
+
+        e = new(JournalManifestEntry, 1);
+        if (!e)
+                return -ENOMEM;
+
+        /* The inode number is taken from the dirent rather than from fstat(), since that is what readers
+         * compare it with, and the two may differ on overlay file systems. */
+        *e = (JournalManifestEntry) {
+                .inode = de->d_ino,
+                .seqnum_id = h.seqnum_id,
+                .head_seqnum = le64toh(h.head_entry_seqnum),
+                .tail_seqnum = le64toh(h.tail_entry_seqnum),
+                .head_realtime = le64toh(h.head_entry_realtime),
+                .tail_realtime = le64toh(h.tail_entry_realtime),
+        };
+
+        e->filename = strdup(de->d_name);
+        if (!e->filename)
+                return -ENOMEM;
+
+        *ret = TAKE_PTR(e);
+        return 1;
+}
+
+static int manifest_write(const char *directory, Hashmap *entries) {
+        _cleanup_free_ char *p = NULL, *temp_path = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        JournalManifestEntry *e;
+        Iterator i;
+        int r;
+
+        assert(directory);
+
+        p = path_join(directory, JOURNAL_MANIFEST_NAME);
+        if (!p)
+                return -ENOMEM;
+
+        r = fopen_temporary(p, &f, &temp_path);
+        if (r < 0)
+                return r;
+
+        /* Readers run unprivileged, and may list the directory anyway */
+        (void) fchmod(fileno(f), 0644);
+
+        fputs("# name inode seqnum-id head-seqnum tail-seqnum head-realtime tail-realtime\n", f);
+
+        HASHMAP_FOREACH(e, entries, i) {
+                char sid[SD_ID128_STRING_MAX];
+
+                fprintf(f, "%s %" PRIu64 " %s %" PRIu64 " %" PRIu64 " " USEC_FMT " " USEC_FMT "\n",
+                        e->filename, (uint64_t) e->inode, sd_id128_to_string(e->seqnum_id, sid),
+                        e->head_seqnum, e->tail_seqnum, e->head_realtime, e->tail_realtime);
+        }
+
+        r = fflush_and_check(f);
+        if (r >= 0 && rename(temp_path, p) < 0)
+                r = -errno;
+        if (r < 0) {
+                (void) unlink(temp_path);
+                return r;
+        }
+
+        return 0;
+}
+
+int journal_manifest_update(const char *directory, Hashmap **cache) {
+        _cleanup_hashmap_free_ Hashmap *entries = NULL;
+        _cleanup_closedir_ DIR *d = NULL;
+        struct dirent *de;
+        bool changed;
+        int r;
+
+        assert(directory);
+
+        /* Without a cache we don't know what the manifest on disk says, hence write it in any case */
+        changed = !cache || !*cache;
+
+        d = opendir(directory);
+        if (!d)
+                return -errno;
+
+        entries = hashmap_new(&journal_manifest_entry_hash_ops);
+        if (!entries)
+                return -ENOMEM;
+
+        FOREACH_DIRENT_ALL(de, d, return -errno) {
+                _cleanup_(journal_manifest_entry_freep) JournalManifestEntry *e = NULL;
+
+                if (!filename_is_archived_journal(de->d_name))
+                        continue;
+
+                /* Entries are moved over from the cache, so that whatever is left there in the end belongs to
+                 * files that disappeared. */
+                if (cache) {
+                        e = hashmap_remove(*cache, de->d_name);
+                        if (e && e->inode != de->d_ino) {
+                                e = journal_manifest_entry_free(e);
+                                changed = true;
+                        }
+                }
+
+                if (!e) {
+                        r = manifest_entry_read(dirfd(d), de, &e);
+                        if (r < 0) {
+                                log_debug_errno(r, "Failed to read header of %s/%s, not listing it in the manifest: %m",
+                                                directory, de->d_name);
+                                continue;
+                        }
+                        if (r == 0)
+                                continue;
+
+                        changed = true;
+                }
+
+                r = hashmap_put(entries, e->filename, e);
+                if (r < 0)
+                        return r;
+
+                TAKE_PTR(e);
+        }
+
+        if (cache && !hashmap_isempty(*cache))
+                changed = true;
+
+        if (changed) {
+                r = manifest_write(directory, entries);
+                if (r < 0)
+                        return r;
+
+                log_debug("Updated manifest of %s, listing %u archived files.", directory, hashmap_size(entries));
+        }
+
+        if (cache) {
+                hashmap_free(*cache);
+                *cache = TAKE_PTR(entries);
+        }
+
+        return 0;
+}
+
+int journal_manifest_load(int dir_fd, Hashmap **ret) {
+        _cleanup_hashmap_free_ Hashmap *entries = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        _cleanup_close_ int fd = -1;
+        int r;
+
+        assert(dir_fd >= 0);
+        assert(ret);
+
+        fd = openat(dir_fd, JOURNAL_MANIFEST_NAME, O_RDONLY|O_CLOEXEC|O_NOCTTY|O_NOFOLLOW);
+        if (fd < 0)
+                return -errno;
+
+        r = fdopen_unlocked(fd, "r", &f);
+        if (r < 0)
+                return r;
+        TAKE_FD(fd);
+
+        entries = hashmap_new(&journal_manifest_entry_hash_ops);
+        if (!entries)
+                return -ENOMEM;
+
+        for (;;) {
+                _cleanup_(journal_manifest_entry_freep) JournalManifestEntry *e = NULL;
+                _cleanup_free_ char *line = NULL;
+                _cleanup_strv_free_ char **w = NULL;
+                uint64_t inode;
+
+                r = read_line(f, LONG_LINE_MAX, &line);
+                if (r < 0)
+                        return r;
+                if (r == 0)
+                        break;
+
+                if (isempty(line) || line[0] == '#')
+                        continue;
+
+                w = strv_split(line, WHITESPACE);
+                if (!w)
+                        return -ENOMEM;
+
+                e = new0(JournalManifestEntry, 1);
+                if (!e)
+                        return -ENOMEM;
+
+                if (strv_length(w) != 7 ||
+                    !filename_is_archived_journal(w[0]) ||
+                    safe_atou64(w[1], &inode) < 0 ||
+                    sd_id128_from_string(w[2], &e->seqnum_id) < 0 ||
+                    safe_atou64(w[3], &e->head_seqnum) < 0 ||
+                    safe_atou64(w[4], &e->tail_seqnum) < 0 ||
+                    safe_atou64(w[5], &e->head_realtime) < 0 ||
+                    safe_atou64(w[6], &e->tail_realtime) < 0) {
+                        log_debug("Invalid line in journal manifest, ignoring: %s", line);
+                        continue;
+                }
+
+                e->inode = (ino_t) inode;
+                e->filename = strdup(w[0]);
+                if (!e->filename)
+                        return -ENOMEM;
+
+                r = hashmap_put(entries, e->filename, e);
+                if (r == -EEXIST)
+                        continue;
+                if (r < 0)
+                        return r;
+
+                TAKE_PTR(e);
+        }
+
+        *ret = TAKE_PTR(entries);
+        return 0;
+}
@@ -0,0 +1,40 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+#pragma once
+
+#include <inttypes.h>
+#include <sys/types.h>
+
+#include "sd-id128.h"
+
+#include "hashmap.h"
+#include "time-util.h"
+
+/* journald keeps a list of the archived journal files of each directory it writes to, together with the ranges
+ * they cover, so that readers may decide which of them are relevant without opening them. Archived files are
+ * never modified, hence the information stays valid as long as the file name refers to the same inode. */
+
+#define JOURNAL_MANIFEST_NAME "archive.manifest"
+
+typedef struct JournalManifestEntry {
+        char *filename;
+        ino_t inode;
+
+        sd_id128_t seqnum_id;
+        uint64_t head_seqnum;
+        uint64_t tail_seqnum;
+
+        usec_t head_realtime;
+        usec_t tail_realtime;
+} JournalManifestEntry;
+
+JournalManifestEntry *journal_manifest_entry_free(JournalManifestEntry *e);
+DEFINE_TRIVIAL_CLEANUP_FUNC(JournalManifestEntry*, journal_manifest_entry_free);
+
+/* Maps file names to JournalManifestEntry objects, and frees the latter */
+extern const struct hash_ops journal_manifest_entry_hash_ops;
+
+/* Rewrites the manifest of the specified directory, if anything changed. If cache is non-NULL, the entries are
+ * kept there, so that the next invocation only has to look at new files. Free it with hashmap_free(). */
+int journal_manifest_update(const char *directory, Hashmap **cache);
+
+int journal_manifest_load(int dir_fd, Hashmap **ret);
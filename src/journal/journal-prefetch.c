@@ -0,0 +1,183 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+
+#include "alloc-util.h"
+#include "fd-util.h"
+#include "journal-prefetch.h"
+#include "process-util.h"
+
+#define PREFETCH_WORKERS_MAX 16U
+#define PREFETCH_QUEUE_MAX 64U
+
+typedef struct PrefetchRequest {
+        int fd;
+        uint64_t offset;
+        uint64_t size;
+} PrefetchRequest;
+
+struct JournalPrefetch {
+        pthread_mutex_t mutex;
+        pthread_cond_t cond;
+
+        pthread_t workers[PREFETCH_WORKERS_MAX];
+        unsigned n_workers;
+
+        /* A ring buffer of queued requests, protected by the mutex */
+        PrefetchRequest queue[PREFETCH_QUEUE_MAX];
+        unsigned queue_first, n_queued;
+
+        bool dead;
+
+        pid_t original_pid;
+};
+
+static void* prefetch_worker(void *userdata) {
+        JournalPrefetch *p = userdata;
+
+        (void) pthread_setname_np(pthread_self(), "sd-journal-pf");
+
+        for (;;) {
+                PrefetchRequest req;
+
+                assert_se(pthread_mutex_lock(&p->mutex) == 0);
+
+                while (!p->dead && p->n_queued == 0)
+                        assert_se(pthread_cond_wait(&p->cond, &p->mutex) == 0);
+
+                if (p->dead) {
+                        assert_se(pthread_mutex_unlock(&p->mutex) == 0);
+                        break;
+                }
+
+                req = p->queue[p->queue_first];
+                p->queue_first = (p->queue_first + 1) % PREFETCH_QUEUE_MAX;
+                p->n_queued--;
+
+                assert_se(pthread_mutex_unlock(&p->mutex) == 0);
+
+                /* This blocks until the pages are read, which is what we have the threads for: the reads
+                 * for different files are issued concurrently, rather than one after the other as the reader
+                 * faults them in. Errors don't matter, the reader will see them again when touching the
+                 * pages. */
+                (void) readahead(req.fd, req.offset, req.size);
+                safe_close(req.fd);
+        }
+
+        return NULL;
+}
+
+int journal_prefetch_new(unsigned n_workers, JournalPrefetch **ret) {
+        _cleanup_(journal_prefetch_freep) JournalPrefetch *p = NULL;
+        sigset_t ss, saved_ss;
+        int r, k;
+
+        assert(n_workers > 0);
+        assert(ret);
+
+        p = new(JournalPrefetch, 1);
+        if (!p)
+                return -ENOMEM;
+
+        *p = (JournalPrefetch) {
+                .mutex = PTHREAD_MUTEX_INITIALIZER,
+                .cond = PTHREAD_COND_INITIALIZER,
+                .original_pid = getpid_cached(),
+        };
+
+        /* No signals in the worker threads please, so that they don't interfere with the signal handling of
+         * the program we are linked into. */
+        assert_se(sigfillset(&ss) >= 0);
+        r = pthread_sigmask(SIG_BLOCK, &ss, &saved_ss);
+        if (r > 0)
+                return -r;
+
+        n_workers = MIN(n_workers, PREFETCH_WORKERS_MAX);
+        while (p->n_workers < n_workers) {
+                r = pthread_create(p->workers + p->n_workers, NULL, prefetch_worker, p);
+                if (r > 0)
+                        break;
+
+                p->n_workers++;
+        }
+
+        k = pthread_sigmask(SIG_SETMASK, &saved_ss, NULL);
+        if (r > 0)
+                return -r;
+        if (k > 0)
+                return -k;
+
+        *ret = TAKE_PTR(p);
+        return 0;
+}
+
+JournalPrefetch* journal_prefetch_free(JournalPrefetch *p) {
+        unsigned i;
+
+        if (!p)
+                return NULL;
+
+        /* After a fork the worker threads are gone, and the mutex might be in any state. Let's not touch
+         * anything then, and just leak the object. */
+        if (p->original_pid != getpid_cached())
+                return NULL;
+
+        assert_se(pthread_mutex_lock(&p->mutex) == 0);
+        p->dead = true;
+        assert_se(pthread_cond_broadcast(&p->cond) == 0);
+        assert_se(pthread_mutex_unlock(&p->mutex) == 0);
+
+        for (i = 0; i < p->n_workers; i++)
+                (void) pthread_join(p->workers[i], NULL);
+
+        for (; p->n_queued > 0; p->n_queued--) {
+                safe_close(p->queue[p->queue_first].fd);
+                p->queue_first = (p->queue_first + 1) % PREFETCH_QUEUE_MAX;
+        }
+
+        pthread_cond_destroy(&p->cond);
+        pthread_mutex_destroy(&p->mutex);
+
+        return mfree(p);
+}
+
+int journal_prefetch_queue(JournalPrefetch *p, int fd, uint64_t offset, uint64_t size) {
+        _cleanup_close_ int copy = -1;
+        int r;
+
+        assert(p);
+        assert(fd >= 0);
+
+        if (size == 0)
+                return 0;
+
+        /* The file might be closed by the reader before a worker gets to it, hence operate on a copy of
+         * the file descriptor */
+        copy = fcntl(fd, F_DUPFD_CLOEXEC, 3);
+        if (copy < 0)
+                return -errno;
+
+        assert_se(pthread_mutex_lock(&p->mutex) == 0);
+
+        if (p->n_queued >= PREFETCH_QUEUE_MAX)
+                r = -EBUSY;
+        else {
+                p->queue[(p->queue_first + p->n_queued) % PREFETCH_QUEUE_MAX] = (PrefetchRequest) {
+                        .fd = TAKE_FD(copy),
+                        .offset = offset,
+                        .size = size,
+                };
+                p->n_queued++;
+
+                assert_se(pthread_cond_signal(&p->cond) == 0);
+                r = 0;
+        }
+
+        assert_se(pthread_mutex_unlock(&p->mutex) == 0);
+
+        return r;
+}
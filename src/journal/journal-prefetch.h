@@ -0,0 +1,20 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+#pragma once
+
+#include <inttypes.h>
+
+#include "macro.h"
+
+/* A small pool of worker threads that pull ranges of journal files into the page cache ahead of the reader,
+ * so that page faults of the (single-threaded) merge step are served from memory, and the I/O for multiple
+ * files is in flight at the same time. */
+
+typedef struct JournalPrefetch JournalPrefetch;
+
+int journal_prefetch_new(unsigned n_workers, JournalPrefetch **ret);
+JournalPrefetch* journal_prefetch_free(JournalPrefetch *p);
+DEFINE_TRIVIAL_CLEANUP_FUNC(JournalPrefetch*, journal_prefetch_free);
+
+/* Queues readahead of the specified range of the file. Returns -EBUSY if too many requests are queued
+ * already. The file descriptor is duplicated, the caller may close it any time. */
+int journal_prefetch_queue(JournalPrefetch *p, int fd, uint64_t offset, uint64_t size);
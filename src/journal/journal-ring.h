@@ -0,0 +1,57 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+#pragma once
+
+#include <inttypes.h>
+
+#include "macro.h"
+
+/* A shared memory ring for submitting native protocol messages to journald without a syscall per message.
+ *
+ * The client allocates a memfd with the header below followed by the data area, and passes it to journald
+ * over the native socket, together with one end of a socket pair used as doorbell. The datagram carrying
+ * the file descriptors has JOURNAL_RING_SIGNATURE as its payload. journald attributes all messages in the
+ * ring to the credentials of that datagram, and forgets about the ring when the client closes its end of
+ * the doorbell.
+ *
+ * The data area is a sequence of records, each a 32bit length followed by the message, padded to
+ * JOURNAL_RING_ALIGN. A record with length JOURNAL_RING_WRAP says the rest of the data area is unused, and
+ * the next record is found at its start. 'head' and 'tail' count the bytes produced by the client and
+ * consumed by journald, respectively, and only ever increase.
+ *
+ * journald sets 'waiting' before waiting for the doorbell, and clears it when it is woken up. The client
+ * only writes to the doorbell when it sees 'waiting' set after advancing 'head', hence as long as journald
+ * keeps up no syscalls are made at all. Both sides issue a full barrier between their store and the
+ * following load, so that a message can't be missed.
+ *
+ * The ring is only used for messages once journald has set 'ready', so that messages submitted to a
+ * server that does not support rings, or that refused the ring, are not lost. */
+
+#define JOURNAL_RING_SIGNATURE "SDJRING1"
+#define JOURNAL_RING_ALIGN 8U
+#define JOURNAL_RING_WRAP UINT32_MAX
+
+#define JOURNAL_RING_DATA_SIZE_MIN (64U*1024U)
+#define JOURNAL_RING_DATA_SIZE_DEFAULT (1024U*1024U)
+#define JOURNAL_RING_DATA_SIZE_MAX (64U*1024U*1024U)
+
+typedef struct JournalRingHeader {
+        char signature[8];
+        uint32_t header_size;
+        uint32_t data_size;        /* a power of two */
+
+        /* Written by the client */
+        uint64_t head;
+
+        /* Written by journald */
+        uint64_t tail;
+        uint32_t waiting;
+        uint32_t ready;
+} JournalRingHeader;
+
+/* The data area starts on its own cache line, so that the header isn't shared with the records */
+#define JOURNAL_RING_HEADER_SIZE 64U
+assert_cc(sizeof(JournalRingHeader) <= JOURNAL_RING_HEADER_SIZE);
+
+static inline uint64_t journal_ring_record_size(uint64_t n) {
+        return ALIGN_TO(sizeof(uint32_t) + n, JOURNAL_RING_ALIGN);
+}
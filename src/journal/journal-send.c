@@ -3,7 +3,9 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <printf.h>
+#include <pthread.h>
 #include <stddef.h>
+#include <sys/mman.h>
 #include <sys/un.h>
 #include <unistd.h>
 
@@ -15,11 +17,15 @@
 #include "errno-util.h"
 #include "fd-util.h"
 #include "io-util.h"
+#include "journal-ring.h"
 #include "memfd-util.h"
+#include "parse-util.h"
+#include "process-util.h"
 #include "socket-util.h"
 #include "stdio-util.h"
 #include "string-util.h"
 #include "tmpfile-util.h"
+#include "unaligned.h"
 
 #define SNDBUF_SIZE (8*1024*1024)
 
@@ -61,6 +67,227 @@ retry:
         return fd;
 }
 
+/* The shared memory ring, if the SYSTEMD_JOURNAL_RING environment variable asks for one. It is shared by
+ * all threads of the process, but not with subprocesses: after a fork the mutex might be in any state, hence
+ * children just use the socket. */
+
+enum {
+        RING_UNCONFIGURED,
+        RING_ACTIVE,
+        RING_DISABLED,
+};
+
+static pthread_mutex_t ring_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int ring_state = RING_UNCONFIGURED;
+static pid_t ring_pid = 0;
+
+/* Protected by the mutex */
+static JournalRingHeader *ring_header = NULL;
+static uint8_t *ring_data = NULL;
+static uint64_t ring_data_size = 0;
+static uint64_t ring_head = 0;
+static int ring_doorbell_fd = -1;
+
+static void ring_disable(void) {
+        if (ring_header) {
+                (void) munmap(ring_header, JOURNAL_RING_HEADER_SIZE + ring_data_size);
+                ring_header = NULL;
+                ring_data = NULL;
+        }
+
+        ring_doorbell_fd = safe_close(ring_doorbell_fd);
+
+        __atomic_store_n(&ring_state, RING_DISABLED, __ATOMIC_RELEASE);
+}
+
+static uint64_t ring_size_from_env(void) {
+        const char *e;
+        uint64_t sz, size;
+        int r;
+
+        e = secure_getenv("SYSTEMD_JOURNAL_RING");
+        if (!e)
+                return 0;
+
+        r = parse_boolean(e);
+        if (r == 0)
+                return 0;
+        if (r > 0)
+                return JOURNAL_RING_DATA_SIZE_DEFAULT;
+
+        if (parse_size(e, 1024, &sz) < 0)
+                return 0;
+
+        sz = CLAMP(sz, (uint64_t) JOURNAL_RING_DATA_SIZE_MIN, (uint64_t) JOURNAL_RING_DATA_SIZE_MAX);
+
+        /* The data area size must be a power of two */
+        for (size = JOURNAL_RING_DATA_SIZE_MIN; size < sz; size <<= 1)
+                ;
+
+        return size;
+}
+
+static int ring_setup(int fd, const struct sockaddr *sa, socklen_t salen) {
+        _cleanup_close_pair_ int pair[2] = { -1, -1 };
+        _cleanup_close_ int memfd = -1;
+        union {
+                struct cmsghdr cmsghdr;
+                uint8_t buf[CMSG_SPACE(sizeof(int) * 2)];
+        } control = {};
+        struct msghdr mh = {
+                .msg_name = (struct sockaddr*) sa,
+                .msg_namelen = salen,
+                .msg_iov = &IOVEC_MAKE_STRING(JOURNAL_RING_SIGNATURE),
+                .msg_iovlen = 1,
+                .msg_control = &control,
+                .msg_controllen = sizeof(control),
+        };
+        struct cmsghdr *cmsg;
+        uint64_t size;
+        void *p;
+        int r;
+
+        size = ring_size_from_env();
+        if (size == 0)
+                return -EOPNOTSUPP;
+
+        memfd = memfd_new("journal-ring");
+        if (memfd < 0)
+                return memfd;
+
+        r = memfd_set_size(memfd, JOURNAL_RING_HEADER_SIZE + size);
+        if (r < 0)
+                return r;
+
+        /* journald maps the ring too, and must not get SIGBUS because we shrink it under its feet */
+        if (fcntl(memfd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0)
+                return -errno;
+
+        r = memfd_map(memfd, 0, JOURNAL_RING_HEADER_SIZE + size, &p);
+        if (r < 0)
+                return r;
+
+        ring_header = p;
+        ring_data = (uint8_t*) p + JOURNAL_RING_HEADER_SIZE;
+        ring_data_size = size;
+        ring_head = 0;
+
+        memcpy(ring_header->signature, JOURNAL_RING_SIGNATURE, sizeof(ring_header->signature));
+        ring_header->header_size = JOURNAL_RING_HEADER_SIZE;
+        ring_header->data_size = size;
+        ring_header->waiting = 1;
+
+        if (socketpair(AF_UNIX, SOCK_SEQPACKET|SOCK_CLOEXEC|SOCK_NONBLOCK, 0, pair) < 0)
+                return -errno;
+
+        cmsg = CMSG_FIRSTHDR(&mh);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int) * 2);
+        memcpy(CMSG_DATA(cmsg), (int[]) { memfd, pair[1] }, sizeof(int) * 2);
+
+        if (sendmsg(fd, &mh, MSG_NOSIGNAL) < 0)
+                return -errno;
+
+        ring_doorbell_fd = TAKE_FD(pair[0]);
+        return 0;
+}
+
+static void ring_ring_doorbell(void) {
+        if (send(ring_doorbell_fd, "", 1, MSG_NOSIGNAL|MSG_DONTWAIT) >= 0)
+                return;
+
+        /* A full doorbell is fine, journald will be woken up anyway. If journald is gone, forget about the
+         * ring, a restarted journald wouldn't know about it. */
+        if (IN_SET(errno, EPIPE, ECONNRESET, ENOTCONN))
+                ring_disable();
+}
+
+/* Returns > 0 if the message was put into the ring, 0 if it has to be sent over the socket */
+static int ring_put(const struct iovec *w, size_t j) {
+        uint64_t len, size, tail, pos, pad = 0;
+        size_t i;
+
+        if (!__atomic_load_n(&ring_header->ready, __ATOMIC_ACQUIRE))
+                return 0;
+
+        len = IOVEC_TOTAL_SIZE(w, j);
+        size = journal_ring_record_size(len);
+
+        /* Large messages would hog the ring, rather send them the traditional way */
+        if (size > ring_data_size / 4)
+                return 0;
+
+        pos = ring_head & (ring_data_size - 1);
+        if (pos + size > ring_data_size)
+                pad = ring_data_size - pos;
+
+        tail = __atomic_load_n(&ring_header->tail, __ATOMIC_ACQUIRE);
+        if (ring_head + pad + size - tail > ring_data_size) {
+                /* Full. Make sure journald is awake, and send this one over the socket. */
+                ring_ring_doorbell();
+                return 0;
+        }
+
+        if (pad > 0) {
+                unaligned_write_ne32(ring_data + pos, JOURNAL_RING_WRAP);
+                pos = 0;
+        }
+
+        unaligned_write_ne32(ring_data + pos, (uint32_t) len);
+        pos += sizeof(uint32_t);
+
+        for (i = 0; i < j; i++) {
+                memcpy(ring_data + pos, w[i].iov_base, w[i].iov_len);
+                pos += w[i].iov_len;
+        }
+
+        ring_head += pad + size;
+        __atomic_store_n(&ring_header->head, ring_head, __ATOMIC_RELEASE);
+
+        /* Pairs with the barrier in journald, after it set 'waiting' and before it checks 'head' again */
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+        if (__atomic_load_n(&ring_header->waiting, __ATOMIC_RELAXED))
+                ring_ring_doorbell();
+
+        return ring_state == RING_ACTIVE;
+}
+
+static int ring_send(int fd, const struct msghdr *mh) {
+        pid_t pid, p;
+        int r;
+
+        if (__atomic_load_n(&ring_state, __ATOMIC_ACQUIRE) == RING_DISABLED)
+                return 0;
+
+        /* Claim the ring for this process before ever taking the mutex, so that children forked off while
+         * the mutex is taken know not to touch it. */
+        pid = getpid_cached();
+        p = __atomic_load_n(&ring_pid, __ATOMIC_ACQUIRE);
+        if (p == 0 && __sync_bool_compare_and_swap(&ring_pid, 0, pid))
+                p = pid;
+        else
+                p = __atomic_load_n(&ring_pid, __ATOMIC_ACQUIRE);
+        if (p != pid)
+                return 0;
+
+        assert_se(pthread_mutex_lock(&ring_mutex) == 0);
+
+        if (ring_state == RING_UNCONFIGURED) {
+                if (ring_setup(fd, mh->msg_name, mh->msg_namelen) >= 0)
+                        __atomic_store_n(&ring_state, RING_ACTIVE, __ATOMIC_RELEASE);
+                else
+                        ring_disable();
+        }
+
+        r = ring_state == RING_ACTIVE ? ring_put(mh->msg_iov, mh->msg_iovlen) : 0;
+
+        assert_se(pthread_mutex_unlock(&ring_mutex) == 0);
+
+        return r;
+}
+
 _public_ int sd_journal_print(int priority, const char *format, ...) {
         int r;
         va_list ap;
@@ -276,6 +503,9 @@ _public_ int sd_journal_sendv(const struct iovec *iov, int n) {
         mh.msg_iov = w;
         mh.msg_iovlen = j;
 
+        if (ring_send(fd, &mh) > 0)
+                return 0;
+
         k = sendmsg(fd, &mh, MSG_NOSIGNAL);
         if (k >= 0)
                 return 0;
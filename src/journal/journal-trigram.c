@@ -0,0 +1,385 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "alloc-util.h"
+#include "fd-util.h"
+#include "id128-util.h"
+#include "journal-trigram.h"
+#include "sort-util.h"
+#include "string-util.h"
+
+struct TrigramFilter {
+        uint8_t bloom[TRIGRAM_BLOOM_SIZE];
+        Hashmap *candidates; /* file ID → TrigramCandidates */
+};
+
+typedef struct TrigramCandidates {
+        sd_id128_t file_id;
+        bool indexed;
+        uint64_t *offsets;
+        size_t n_offsets;
+} TrigramCandidates;
+
+static TrigramCandidates* trigram_candidates_free(TrigramCandidates *c) {
+        if (!c)
+                return NULL;
+
+        free(c->offsets);
+        return mfree(c);
+}
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(TrigramCandidates*, trigram_candidates_free);
+
+static unsigned trigram_bit(uint8_t a, uint8_t b, uint8_t c) {
+        uint32_t t;
+
+        t = ((uint32_t) (uint8_t) ascii_tolower(a) << 16) |
+            ((uint32_t) (uint8_t) ascii_tolower(b) << 8) |
+            (uint8_t) ascii_tolower(c);
+
+        /* Fibonacci hashing, folded down to one bit of the filter */
+        return (t * UINT32_C(2654435761)) >> (32 - 8);
+}
+
+assert_cc(TRIGRAM_BLOOM_SIZE * 8 == 1 << 8);
+
+static void trigram_bloom_add(uint8_t bloom[static TRIGRAM_BLOOM_SIZE], unsigned bit) {
+        bloom[bit / 8] |= 1U << (bit % 8);
+}
+
+static void trigram_bloom_fill(uint8_t bloom[static TRIGRAM_BLOOM_SIZE], const uint8_t *p, size_t n) {
+        size_t i;
+
+        for (i = 0; i + 3 <= n; i++)
+                trigram_bloom_add(bloom, trigram_bit(p[i], p[i+1], p[i+2]));
+}
+
+static int trigram_index_item_compare(const TrigramIndexItem *a, const TrigramIndexItem *b) {
+        return CMP(le64toh(a->data_offset), le64toh(b->data_offset));
+}
+
+static int journal_file_collect_trigrams(JournalFile *f, TrigramIndexItem **ret, size_t *ret_n) {
+        _cleanup_free_ TrigramIndexItem *items = NULL;
+        size_t n_items = 0, n_allocated = 0;
+        uint64_t p;
+        Object *o;
+        int r;
+
+        assert(f);
+        assert(ret);
+        assert(ret_n);
+
+        /* All data objects of a field are chained up from its field object, hence we only need to look at
+         * the MESSAGE= ones, and not at every entry. */
+        r = journal_file_find_field_object(f, "MESSAGE", STRLEN("MESSAGE"), &o, NULL);
+        if (r < 0)
+                return r;
+        if (r == 0) {
+                *ret = NULL;
+                *ret_n = 0;
+                return 0;
+        }
+
+        p = le64toh(o->field.head_data_offset);
+        while (p > 0) {
+                const uint8_t *payload;
+                uint64_t l;
+                int compression;
+
+                r = journal_file_move_to_object(f, OBJECT_DATA, p, &o);
+                if (r < 0)
+                        return r;
+
+                l = le64toh(o->object.size) - offsetof(Object, data.payload);
+
+                compression = o->object.flags & OBJECT_COMPRESSION_MASK;
+                if (compression) {
+#if HAVE_XZ || HAVE_LZ4 || HAVE_ZSTD
+                        size_t rsize;
+
+                        r = journal_file_decompress_blob(f, compression,
+                                                         o->data.payload, l,
+                                                         &f->compress_buffer, &f->compress_buffer_size, &rsize, 0);
+                        if (r < 0)
+                                return r;
+
+                        payload = f->compress_buffer;
+                        l = rsize;
+#else
+                        return -EPROTONOSUPPORT;
+#endif
+                } else
+                        payload = o->data.payload;
+
+                if (!GREEDY_REALLOC(items, n_allocated, n_items + 1))
+                        return -ENOMEM;
+
+                items[n_items] = (TrigramIndexItem) {
+                        .data_offset = htole64(p),
+                };
+
+                if (l > STRLEN("MESSAGE="))
+                        trigram_bloom_fill(items[n_items].bloom, payload + STRLEN("MESSAGE="), l - STRLEN("MESSAGE="));
+
+                n_items++;
+
+                p = le64toh(o->data.next_field_offset);
+        }
+
+        typesafe_qsort(items, n_items, trigram_index_item_compare);
+
+        *ret = TAKE_PTR(items);
+        *ret_n = n_items;
+        return 0;
+}
+
+static int pwrite_all(int fd, const void *buf, size_t n, uint64_t offset) {
+        ssize_t k;
+
+        k = pwrite(fd, buf, n, offset);
+        if (k < 0)
+                return -errno;
+        if ((size_t) k != n)
+                return -EIO;
+
+        return 0;
+}
+
+int journal_file_build_trigram_index(JournalFile *f) {
+        _cleanup_free_ TrigramIndexItem *items = NULL;
+        _cleanup_close_ int fd = -1;
+        uint64_t p, sz, end, header_size, arena_size;
+        ObjectHeader oh = {
+                .type = OBJECT_TRIGRAM_INDEX,
+        };
+        size_t n_items;
+        le64_t x;
+        Object *o;
+        int r;
+
+        assert(f);
+        assert(f->header);
+
+        /* Archived files are never appended to by journald again, which is why we can add the index to them
+         * without coordinating with anyone: the index is written as a new trailing object, and only then
+         * linked from the header. */
+
+        if (!JOURNAL_HEADER_CONTAINS(f->header, trigram_index_offset) || JOURNAL_HEADER_SEALED(f->header))
+                return -EOPNOTSUPP;
+        if (f->header->state != STATE_ARCHIVED)
+                return -EBUSY;
+        if (f->header->trigram_index_offset != 0)
+                return -EEXIST;
+        if (f->header->tail_object_offset == 0)
+                return -ENODATA;
+
+        r = journal_file_collect_trigrams(f, &items, &n_items);
+        if (r < 0)
+                return r;
+
+        r = journal_file_move_to_object(f, OBJECT_UNUSED, le64toh(f->header->tail_object_offset), &o);
+        if (r < 0)
+                return r;
+
+        p = le64toh(f->header->tail_object_offset) + ALIGN64(le64toh(o->object.size));
+        sz = offsetof(TrigramIndexObject, items) + n_items * sizeof(TrigramIndexItem);
+        end = p + ALIGN64(sz);
+
+        header_size = le64toh(f->header->header_size);
+        arena_size = le64toh(f->header->arena_size);
+
+        fd = open(f->path, O_RDWR|O_CLOEXEC|O_NOCTTY);
+        if (fd < 0)
+                return -errno;
+
+        if (end > header_size + arena_size) {
+                r = posix_fallocate(fd, 0, end);
+                if (r != 0)
+                        return -r;
+
+                arena_size = end - header_size;
+        }
+
+        oh.size = htole64(sz);
+
+        r = pwrite_all(fd, &oh, sizeof(oh), p);
+        if (r < 0)
+                return r;
+        if (n_items > 0) {
+                r = pwrite_all(fd, items, n_items * sizeof(TrigramIndexItem), p + offsetof(TrigramIndexObject, items));
+                if (r < 0)
+                        return r;
+        }
+
+        if (fsync(fd) < 0)
+                return -errno;
+
+        x = htole64(arena_size);
+        r = pwrite_all(fd, &x, sizeof(x), offsetof(Header, arena_size));
+        if (r < 0)
+                return r;
+        x = htole64(le64toh(f->header->n_objects) + 1);
+        r = pwrite_all(fd, &x, sizeof(x), offsetof(Header, n_objects));
+        if (r < 0)
+                return r;
+        x = htole64(p);
+        r = pwrite_all(fd, &x, sizeof(x), offsetof(Header, tail_object_offset));
+        if (r < 0)
+                return r;
+        r = pwrite_all(fd, &x, sizeof(x), offsetof(Header, trigram_index_offset));
+        if (r < 0)
+                return r;
+
+        if (fsync(fd) < 0)
+                return -errno;
+
+        log_debug("Added trigram index of %zu MESSAGE= objects to %s.", n_items, f->path);
+
+        return 0;
+}
+
+int trigram_filter_new(const char *literal, bool caseless, TrigramFilter **ret) {
+        _cleanup_(trigram_filter_freep) TrigramFilter *t = NULL;
+        size_t i, n, n_trigrams = 0;
+
+        assert(literal);
+        assert(ret);
+
+        t = new0(TrigramFilter, 1);
+        if (!t)
+                return -ENOMEM;
+
+        n = strlen(literal);
+        for (i = 0; i + 3 <= n; i++) {
+                const uint8_t *c = (const uint8_t*) literal + i;
+
+                /* With caseless matching, non-ASCII characters may match other byte sequences, and so may 'k'
+                 * and 's' (as the Kelvin and long s signs fold to them). Only trigrams made of other
+                 * characters remain necessary then. */
+                if (caseless &&
+                    (c[0] >= 0x80 || c[1] >= 0x80 || c[2] >= 0x80 ||
+                     memchr("kKsS", c[0], 4) || memchr("kKsS", c[1], 4) || memchr("kKsS", c[2], 4)))
+                        continue;
+
+                trigram_bloom_add(t->bloom, trigram_bit(c[0], c[1], c[2]));
+                n_trigrams++;
+        }
+
+        if (n_trigrams == 0) {
+                *ret = NULL;
+                return 0;
+        }
+
+        *ret = TAKE_PTR(t);
+        return 1;
+}
+
+TrigramFilter* trigram_filter_free(TrigramFilter *t) {
+        if (!t)
+                return NULL;
+
+        hashmap_free_with_destructor(t->candidates, trigram_candidates_free);
+        return mfree(t);
+}
+
+static bool trigram_filter_bloom_test(const TrigramFilter *t, const uint8_t bloom[static TRIGRAM_BLOOM_SIZE]) {
+        size_t i;
+
+        for (i = 0; i < TRIGRAM_BLOOM_SIZE; i++)
+                if ((bloom[i] & t->bloom[i]) != t->bloom[i])
+                        return false;
+
+        return true;
+}
+
+static int trigram_filter_load(TrigramFilter *t, JournalFile *f, TrigramCandidates **ret) {
+        _cleanup_(trigram_candidates_freep) TrigramCandidates *c = NULL;
+        size_t n_allocated = 0;
+        uint64_t p, n, i;
+        Object *o;
+        int r;
+
+        c = new0(TrigramCandidates, 1);
+        if (!c)
+                return -ENOMEM;
+
+        c->file_id = f->header->file_id;
+
+        if (JOURNAL_HEADER_CONTAINS(f->header, trigram_index_offset) && f->header->trigram_index_offset != 0) {
+                p = le64toh(f->header->trigram_index_offset);
+
+                r = journal_file_move_to_object(f, OBJECT_TRIGRAM_INDEX, p, &o);
+                if (r < 0)
+                        return r;
+
+                n = (le64toh(o->object.size) - offsetof(TrigramIndexObject, items)) / sizeof(TrigramIndexItem);
+                for (i = 0; i < n; i++) {
+                        if (!trigram_filter_bloom_test(t, o->trigram_index.items[i].bloom))
+                                continue;
+
+                        if (!GREEDY_REALLOC(c->offsets, n_allocated, c->n_offsets + 1))
+                                return -ENOMEM;
+
+                        c->offsets[c->n_offsets++] = le64toh(o->trigram_index.items[i].data_offset);
+                }
+
+                c->indexed = true;
+        }
+
+        r = hashmap_ensure_allocated(&t->candidates, &id128_hash_ops);
+        if (r < 0)
+                return r;
+
+        r = hashmap_put(t->candidates, &c->file_id, c);
+        if (r < 0)
+                return r;
+
+        *ret = TAKE_PTR(c);
+        return 0;
+}
+
+static int uint64_compare(const uint64_t *a, const uint64_t *b) {
+        return CMP(*a, *b);
+}
+
+int trigram_filter_test(TrigramFilter *t, JournalFile *f) {
+        TrigramCandidates *c;
+        uint64_t n, i;
+        Object *o;
+        int r;
+
+        assert(t);
+        assert(f);
+
+        c = hashmap_get(t->candidates, &f->header->file_id);
+        if (!c) {
+                r = trigram_filter_load(t, f, &c);
+                if (r < 0)
+                        return r;
+        }
+
+        if (!c->indexed)
+                return 1;
+        if (c->n_offsets == 0)
+                return 0;
+
+        r = journal_file_move_to_object(f, OBJECT_ENTRY, f->current_offset, &o);
+        if (r < 0)
+                return r;
+
+        /* The candidates are all MESSAGE= objects, hence it is sufficient to look at the item offsets, without
+         * looking at the data objects themselves */
+        n = journal_file_entry_n_items(o);
+        for (i = 0; i < n; i++) {
+                uint64_t q = le64toh(o->entry.items[i].object_offset);
+
+                if (typesafe_bsearch(&q, c->offsets, c->n_offsets, uint64_compare))
+                        return 1;
+        }
+
+        return 0;
+}
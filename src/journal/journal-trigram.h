@@ -0,0 +1,22 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+#pragma once
+
+#include <stdbool.h>
+
+#include "hashmap.h"
+#include "journal-def.h"
+#include "journal-file.h"
+#include "macro.h"
+
+/* Builds the trigram index of an archived journal file and appends it to the file */
+int journal_file_build_trigram_index(JournalFile *f);
+
+typedef struct TrigramFilter TrigramFilter;
+
+int trigram_filter_new(const char *literal, bool caseless, TrigramFilter **ret);
+TrigramFilter* trigram_filter_free(TrigramFilter *t);
+DEFINE_TRIVIAL_CLEANUP_FUNC(TrigramFilter*, trigram_filter_free);
+
+/* Returns 0 if the MESSAGE= field of the current entry of the file cannot contain the literal, > 0 if it
+ * might (including when the file has no index) */
+int trigram_filter_test(TrigramFilter *t, JournalFile *f);
@@ -22,6 +22,7 @@
 struct vacuum_info {
         uint64_t usage;
         char *filename;
+        ino_t inode;
 
         uint64_t realtime;
 
@@ -30,6 +31,46 @@ struct vacuum_info {
         bool have_seqnum;
 };
 
+static struct vacuum_info *vacuum_info_free(struct vacuum_info *i) {
+        if (!i)
+                return NULL;
+
+        free(i->filename);
+        return mfree(i);
+}
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(struct vacuum_info*, vacuum_info_free);
+
+DEFINE_PRIVATE_HASH_OPS_WITH_VALUE_DESTRUCTOR(vacuum_info_hash_ops, char, string_hash_func, string_compare_func,
+                                              struct vacuum_info, vacuum_info_free);
+
+static int vacuum_cache_add(Hashmap **cache, const struct vacuum_info *i) {
+        _cleanup_(vacuum_info_freep) struct vacuum_info *n = NULL;
+        int r;
+
+        assert(cache);
+        assert(i);
+
+        n = newdup(struct vacuum_info, i, 1);
+        if (!n)
+                return -ENOMEM;
+
+        n->filename = strdup(i->filename);
+        if (!n->filename)
+                return -ENOMEM;
+
+        r = hashmap_ensure_allocated(cache, &vacuum_info_hash_ops);
+        if (r < 0)
+                return r;
+
+        r = hashmap_put(*cache, n->filename, n);
+        if (r < 0)
+                return r;
+
+        TAKE_PTR(n);
+        return 0;
+}
+
 static int vacuum_compare(const struct vacuum_info *a, const struct vacuum_info *b) {
         int r;
 
@@ -124,10 +165,12 @@ int journal_directory_vacuum(
                 uint64_t n_max_files,
                 usec_t max_retention_usec,
                 usec_t *oldest_usec,
+                Hashmap **cache,
                 bool verbose) {
 
         uint64_t sum = 0, freed = 0, n_active_files = 0;
         size_t n_list = 0, n_allocated = 0, i;
+        _cleanup_hashmap_free_ Hashmap *new_cache = NULL;
         _cleanup_closedir_ DIR *d = NULL;
         struct vacuum_info *list = NULL;
         usec_t retention_limit = 0;
@@ -157,6 +200,41 @@ int journal_directory_vacuum(
                 struct stat st;
                 size_t q;
 
+                /* Archived files are never modified, hence if we looked at this one before, we know everything
+                 * about it already. Entries are moved over to the new cache, so that the ones for files that
+                 * disappeared are dropped in the end. */
+                if (cache) {
+                        struct vacuum_info *c;
+
+                        c = hashmap_get(*cache, de->d_name);
+                        if (c && c->inode == de->d_ino) {
+                                _cleanup_free_ char *fn = NULL;
+
+                                fn = strdup(c->filename);
+                                if (!fn || !GREEDY_REALLOC(list, n_allocated, n_list + 1)) {
+                                        r = -ENOMEM;
+                                        goto finish;
+                                }
+
+                                r = hashmap_ensure_allocated(&new_cache, &vacuum_info_hash_ops);
+                                if (r < 0)
+                                        goto finish;
+
+                                assert_se(hashmap_remove(*cache, c->filename) == c);
+                                r = hashmap_put(new_cache, c->filename, c);
+                                if (r < 0) {
+                                        vacuum_info_free(c);
+                                        goto finish;
+                                }
+
+                                list[n_list] = *c;
+                                list[n_list++].filename = TAKE_PTR(fn);
+
+                                sum += c->usage;
+                                continue;
+                        }
+                }
+
                 if (fstatat(dirfd(d), de->d_name, &st, AT_SYMLINK_NOFOLLOW) < 0) {
                         log_debug_errno(errno, "Failed to stat file %s while vacuuming, ignoring: %m", de->d_name);
                         continue;
@@ -269,6 +347,7 @@ int journal_directory_vacuum(
 
                 list[n_list++] = (struct vacuum_info) {
                         .filename = TAKE_PTR(p),
+                        .inode = st.st_ino,
                         .usage = size,
                         .seqnum = seqnum,
                         .realtime = realtime,
@@ -277,6 +356,12 @@ int journal_directory_vacuum(
                 };
 
                 sum += size;
+
+                if (cache) {
+                        r = vacuum_cache_add(&new_cache, list + n_list - 1);
+                        if (r < 0)
+                                goto finish;
+                }
         }
 
         typesafe_qsort(list, n_list, vacuum_compare);
@@ -291,6 +376,8 @@ int journal_directory_vacuum(
                     (n_max_files <= 0 || left <= n_max_files))
                         break;
 
+                vacuum_info_free(hashmap_remove(new_cache, list[i].filename));
+
                 r = unlinkat_deallocate(dirfd(d), list[i].filename, 0);
                 if (r >= 0) {
                         log_full(verbose ? LOG_INFO : LOG_DEBUG, "Deleted archived journal %s/%s (%s).", directory, list[i].filename, format_bytes(sbytes, sizeof(sbytes), list[i].usage));
@@ -308,6 +395,11 @@ int journal_directory_vacuum(
         if (oldest_usec && i < n_list && (*oldest_usec == 0 || list[i].realtime < *oldest_usec))
                 *oldest_usec = list[i].realtime;
 
+        if (cache) {
+                hashmap_free(*cache);
+                *cache = TAKE_PTR(new_cache);
+        }
+
         r = 0;
 
 finish:
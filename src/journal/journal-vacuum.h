@@ -4,6 +4,9 @@
 #include <inttypes.h>
 #include <stdbool.h>
 
+#include "hashmap.h"
 #include "time-util.h"
 
-int journal_directory_vacuum(const char *directory, uint64_t max_use, uint64_t n_max_files, usec_t max_retention_usec, usec_t *oldest_usec, bool verbose);
+/* If cache is non-NULL, what was learnt about the archived files in the directory is kept there, so that the
+ * next invocation only has to look at new ones. Free it with hashmap_free(). */
+int journal_directory_vacuum(const char *directory, uint64_t max_use, uint64_t n_max_files, usec_t max_retention_usec, usec_t *oldest_usec, Hashmap **cache, bool verbose);
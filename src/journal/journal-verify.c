@@ -1,14 +1,13 @@
 /* SPDX-License-Identifier: LGPL-2.1+ */
 
-#include <fcntl.h>
 #include <stddef.h>
-#include <sys/mman.h>
 #include <unistd.h>
 
 #include "alloc-util.h"
 #include "compress.h"
 #include "fd-util.h"
 #include "fileio.h"
+#include "format-util.h"
 #include "fs-util.h"
 #include "journal-authenticate.h"
 #include "journal-def.h"
@@ -17,7 +16,6 @@
 #include "lookup3.h"
 #include "macro.h"
 #include "terminal-util.h"
-#include "tmpfile-util.h"
 #include "util.h"
 
 static void draw_progress(uint64_t p, usec_t *last_usec) {
@@ -119,7 +117,7 @@ static int journal_file_object_verify(JournalFile *f, uint64_t offset, Object *o
          * possible field values. It does not follow any references to
          * other objects. */
 
-        if ((o->object.flags & OBJECT_COMPRESSED_XZ) &&
+        if ((o->object.flags & OBJECT_COMPRESSION_MASK) &&
             o->object.type != OBJECT_DATA) {
                 error(offset, "Found compressed object that isn't of type DATA, which is not allowed.");
                 return -EBADMSG;
@@ -153,10 +151,10 @@ static int journal_file_object_verify(JournalFile *f, uint64_t offset, Object *o
                         _cleanup_free_ void *b = NULL;
                         size_t alloc = 0, b_size;
 
-                        r = decompress_blob(compression,
-                                            o->data.payload,
-                                            le64toh(o->object.size) - offsetof(Object, data.payload),
-                                            &b, &alloc, &b_size, 0);
+                        r = journal_file_decompress_blob(f, compression,
+                                                         o->data.payload,
+                                                         le64toh(o->object.size) - offsetof(Object, data.payload),
+                                                         &b, &alloc, &b_size, 0);
                         if (r < 0) {
                                 error_errno(offset, r, "%s decompression failed: %m",
                                             object_compressed_to_string(compression));
@@ -344,74 +342,149 @@ static int journal_file_object_verify(JournalFile *f, uint64_t offset, Object *o
                         return -EBADMSG;
                 }
 
+                break;
+
+        case OBJECT_DICTIONARY:
+                if (le64toh(o->object.size) <= offsetof(DictionaryObject, payload)) {
+                        error(offset,
+                              "Invalid object dictionary size: %"PRIu64,
+                              le64toh(o->object.size));
+                        return -EBADMSG;
+                }
+
+                if (le32toh(o->dictionary.dict_id) == 0) {
+                        error(offset, "Invalid object dictionary ID");
+                        return -EBADMSG;
+                }
+
+                break;
+
+        case OBJECT_TRIGRAM_INDEX:
+                if ((le64toh(o->object.size) - offsetof(TrigramIndexObject, items)) % sizeof(TrigramIndexItem) != 0) {
+                        error(offset,
+                              "Invalid object trigram index size: %"PRIu64,
+                              le64toh(o->object.size));
+                        return -EBADMSG;
+                }
+
+                for (i = 0; i < (le64toh(o->object.size) - offsetof(TrigramIndexObject, items)) / sizeof(TrigramIndexItem); i++)
+                        if (!VALID64(le64toh(o->trigram_index.items[i].data_offset)) ||
+                            (i > 0 && le64toh(o->trigram_index.items[i].data_offset) <= le64toh(o->trigram_index.items[i-1].data_offset))) {
+                                error(offset,
+                                      "Invalid trigram index item (%"PRIu64"): "OFSfmt,
+                                      i, le64toh(o->trigram_index.items[i].data_offset));
+                                return -EBADMSG;
+                        }
+
+                break;
+
+        case OBJECT_TIME_INDEX:
+                if (le64toh(o->object.size) <= offsetof(TimeIndexObject, items) ||
+                    (le64toh(o->object.size) - offsetof(TimeIndexObject, items)) % sizeof(TimeIndexItem) != 0) {
+                        error(offset,
+                              "Invalid object time index size: %"PRIu64,
+                              le64toh(o->object.size));
+                        return -EBADMSG;
+                }
+
+                for (i = 0; i < (le64toh(o->object.size) - offsetof(TimeIndexObject, items)) / sizeof(TimeIndexItem); i++)
+                        if (le64toh(o->time_index.items[i].entry_index) >= le64toh(f->header->n_entries) ||
+                            (i > 0 && (le64toh(o->time_index.items[i].entry_index) <= le64toh(o->time_index.items[i-1].entry_index) ||
+                                       le64toh(o->time_index.items[i].realtime) <= le64toh(o->time_index.items[i-1].realtime)))) {
+                                error(offset,
+                                      "Invalid time index item (%"PRIu64"): %"PRIu64,
+                                      i, le64toh(o->time_index.items[i].entry_index));
+                                return -EBADMSG;
+                        }
+
+                break;
+
+        case OBJECT_ENTRY_ARRAY_INDEX:
+                if (le64toh(o->object.size) <= offsetof(EntryArrayIndexObject, items) ||
+                    (le64toh(o->object.size) - offsetof(EntryArrayIndexObject, items)) % sizeof(EntryArrayIndexItem) != 0) {
+                        error(offset,
+                              "Invalid object entry array index size: %"PRIu64,
+                              le64toh(o->object.size));
+                        return -EBADMSG;
+                }
+
+                for (i = 0; i < (le64toh(o->object.size) - offsetof(EntryArrayIndexObject, items)) / sizeof(EntryArrayIndexItem); i++) {
+                        const EntryArrayIndexItem *item = o->entry_array_index.items + i,
+                                *prev = i > 0 ? item - 1 : NULL;
+                        bool same_chain = prev && item->chain_offset == prev->chain_offset;
+
+                        /* Within a chain, the arrays are in order, and the first one is the chain itself */
+                        if (!VALID64(le64toh(item->chain_offset)) ||
+                            !VALID64(le64toh(item->array_offset)) ||
+                            !VALID64(le64toh(item->first_entry_offset)) ||
+                            le64toh(item->array_offset) == 0 ||
+                            le64toh(item->first_entry_offset) == 0 ||
+                            (same_chain && (le64toh(item->total) <= le64toh(prev->total) ||
+                                            le64toh(item->first_entry_offset) <= le64toh(prev->first_entry_offset))) ||
+                            (!same_chain && (le64toh(item->total) != 0 ||
+                                             item->array_offset != item->chain_offset ||
+                                             (prev && le64toh(item->chain_offset) < le64toh(prev->chain_offset))))) {
+                                error(offset,
+                                      "Invalid entry array index item (%"PRIu64"): "OFSfmt,
+                                      i, le64toh(item->array_offset));
+                                return -EBADMSG;
+                        }
+                }
+
                 break;
         }
 
         return 0;
 }
 
-static int write_uint64(int fd, uint64_t p) {
-        ssize_t k;
+static int append_offset(uint64_t **offsets, size_t *allocated, uint64_t n, uint64_t p) {
+        assert(offsets);
+        assert(allocated);
 
-        k = write(fd, &p, sizeof(p));
-        if (k < 0)
-                return -errno;
-        if (k != sizeof(p))
-                return -EIO;
+        /* Objects are enumerated in the order they appear in the file, hence the arrays stay sorted */
+        if (!GREEDY_REALLOC(*offsets, *allocated, n + 1))
+                return -ENOMEM;
 
+        (*offsets)[n] = p;
         return 0;
 }
 
-static int contains_uint64(MMapCache *m, MMapFileDescriptor *f, uint64_t n, uint64_t p) {
-        uint64_t a, b;
-        int r;
-
-        assert(m);
-        assert(f);
+static bool contains_offset(const uint64_t *offsets, uint64_t n, uint64_t p) {
+        uint64_t a = 0, b = n;
 
         /* Bisection ... */
 
-        a = 0; b = n;
         while (a < b) {
-                uint64_t c, *z;
-
-                c = (a + b) / 2;
+                uint64_t c = a + (b - a) / 2;
 
-                r = mmap_cache_get(m, f, PROT_READ|PROT_WRITE, 0, false, c * sizeof(uint64_t), sizeof(uint64_t), NULL, (void **) &z, NULL);
-                if (r < 0)
-                        return r;
+                if (offsets[c] == p)
+                        return true;
 
-                if (*z == p)
-                        return 1;
-
-                if (a + 1 >= b)
-                        return 0;
-
-                if (p < *z)
+                if (p < offsets[c])
                         b = c;
                 else
-                        a = c;
+                        a = c + 1;
         }
 
-        return 0;
+        return false;
 }
 
 static int entry_points_to_data(
                 JournalFile *f,
-                MMapFileDescriptor *cache_entry_fd,
+                const uint64_t *entry_offsets,
                 uint64_t n_entries,
                 uint64_t entry_p,
                 uint64_t data_p) {
 
         int r;
-        uint64_t i, n, a;
+        uint64_t i, n;
         Object *o;
         bool found = false;
 
         assert(f);
-        assert(cache_entry_fd);
+        assert(entry_offsets || n_entries == 0);
 
-        if (!contains_uint64(f->mmap, cache_entry_fd, n_entries, entry_p)) {
+        if (!contains_offset(entry_offsets, n_entries, entry_p)) {
                 error(data_p, "Data object references invalid entry at "OFSfmt, entry_p);
                 return -EBADMSG;
         }
@@ -432,52 +505,8 @@ static int entry_points_to_data(
                 return -EBADMSG;
         }
 
-        /* Check if this entry is also in main entry array. Since the
-         * main entry array has already been verified we can rely on
-         * its consistency. */
-
-        i = 0;
-        n = le64toh(f->header->n_entries);
-        a = le64toh(f->header->entry_array_offset);
-
-        while (i < n) {
-                uint64_t m, u;
-
-                r = journal_file_move_to_object(f, OBJECT_ENTRY_ARRAY, a, &o);
-                if (r < 0)
-                        return r;
-
-                m = journal_file_entry_array_n_items(o);
-                u = MIN(n - i, m);
-
-                if (entry_p <= le64toh(o->entry_array.items[u-1])) {
-                        uint64_t x, y, z;
-
-                        x = 0;
-                        y = u;
-
-                        while (x < y) {
-                                z = (x + y) / 2;
-
-                                if (le64toh(o->entry_array.items[z]) == entry_p)
-                                        return 0;
-
-                                if (x + 1 >= y)
-                                        break;
-
-                                if (entry_p < le64toh(o->entry_array.items[z]))
-                                        y = z;
-                                else
-                                        x = z;
-                        }
-
-                        error(entry_p, "Entry object doesn't exist in main entry array");
-                        return -EBADMSG;
-                }
-
-                i += u;
-                a = le64toh(o->entry_array.next_entry_array_offset);
-        }
+        /* The entry is also in the main entry array: that was verified before to consist of exactly the
+         * n_entries entry objects of the file, in order, and we checked above that this is one of them. */
 
         return 0;
 }
@@ -485,16 +514,16 @@ static int entry_points_to_data(
 static int verify_data(
                 JournalFile *f,
                 Object *o, uint64_t p,
-                MMapFileDescriptor *cache_entry_fd, uint64_t n_entries,
-                MMapFileDescriptor *cache_entry_array_fd, uint64_t n_entry_arrays) {
+                const uint64_t *entry_offsets, uint64_t n_entries,
+                const uint64_t *entry_array_offsets, uint64_t n_entry_arrays) {
 
         uint64_t i, n, a, last, q;
         int r;
 
         assert(f);
         assert(o);
-        assert(cache_entry_fd);
-        assert(cache_entry_array_fd);
+        assert(entry_offsets || n_entries == 0);
+        assert(entry_array_offsets || n_entry_arrays == 0);
 
         n = le64toh(o->data.n_entries);
         a = le64toh(o->data.entry_array_offset);
@@ -512,7 +541,7 @@ static int verify_data(
         assert(o->data.entry_offset);
 
         last = q = le64toh(o->data.entry_offset);
-        r = entry_points_to_data(f, cache_entry_fd, n_entries, q, p);
+        r = entry_points_to_data(f, entry_offsets, n_entries, q, p);
         if (r < 0)
                 return r;
 
@@ -525,7 +554,7 @@ static int verify_data(
                         return -EBADMSG;
                 }
 
-                if (!contains_uint64(f->mmap, cache_entry_array_fd, n_entry_arrays, a)) {
+                if (!contains_offset(entry_array_offsets, n_entry_arrays, a)) {
                         error(p, "Invalid array offset "OFSfmt, a);
                         return -EBADMSG;
                 }
@@ -550,7 +579,7 @@ static int verify_data(
                         }
                         last = q;
 
-                        r = entry_points_to_data(f, cache_entry_fd, n_entries, q, p);
+                        r = entry_points_to_data(f, entry_offsets, n_entries, q, p);
                         if (r < 0)
                                 return r;
 
@@ -568,9 +597,9 @@ static int verify_data(
 
 static int verify_hash_table(
                 JournalFile *f,
-                MMapFileDescriptor *cache_data_fd, uint64_t n_data,
-                MMapFileDescriptor *cache_entry_fd, uint64_t n_entries,
-                MMapFileDescriptor *cache_entry_array_fd, uint64_t n_entry_arrays,
+                const uint64_t *data_offsets, uint64_t n_data,
+                const uint64_t *entry_offsets, uint64_t n_entries,
+                const uint64_t *entry_array_offsets, uint64_t n_entry_arrays,
                 usec_t *last_usec,
                 bool show_progress) {
 
@@ -578,9 +607,9 @@ static int verify_hash_table(
         int r;
 
         assert(f);
-        assert(cache_data_fd);
-        assert(cache_entry_fd);
-        assert(cache_entry_array_fd);
+        assert(data_offsets || n_data == 0);
+        assert(entry_offsets || n_entries == 0);
+        assert(entry_array_offsets || n_entry_arrays == 0);
         assert(last_usec);
 
         n = le64toh(f->header->data_hash_table_size) / sizeof(HashItem);
@@ -602,7 +631,7 @@ static int verify_hash_table(
                         Object *o;
                         uint64_t next;
 
-                        if (!contains_uint64(f->mmap, cache_data_fd, n_data, p)) {
+                        if (!contains_offset(data_offsets, n_data, p)) {
                                 error(p, "Invalid data object at hash entry %"PRIu64" of %"PRIu64, i, n);
                                 return -EBADMSG;
                         }
@@ -622,7 +651,7 @@ static int verify_hash_table(
                                 return -EBADMSG;
                         }
 
-                        r = verify_data(f, o, p, cache_entry_fd, n_entries, cache_entry_array_fd, n_entry_arrays);
+                        r = verify_data(f, o, p, entry_offsets, n_entries, entry_array_offsets, n_entry_arrays);
                         if (r < 0)
                                 return r;
 
@@ -674,14 +703,14 @@ static int data_object_in_hash_table(JournalFile *f, uint64_t hash, uint64_t p)
 static int verify_entry(
                 JournalFile *f,
                 Object *o, uint64_t p,
-                MMapFileDescriptor *cache_data_fd, uint64_t n_data) {
+                const uint64_t *data_offsets, uint64_t n_data) {
 
         uint64_t i, n;
         int r;
 
         assert(f);
         assert(o);
-        assert(cache_data_fd);
+        assert(data_offsets || n_data == 0);
 
         n = journal_file_entry_n_items(o);
         for (i = 0; i < n; i++) {
@@ -691,7 +720,7 @@ static int verify_entry(
                 q = le64toh(o->entry.items[i].object_offset);
                 h = le64toh(o->entry.items[i].hash);
 
-                if (!contains_uint64(f->mmap, cache_data_fd, n_data, q)) {
+                if (!contains_offset(data_offsets, n_data, q)) {
                         error(p, "Invalid data object of entry");
                         return -EBADMSG;
                 }
@@ -719,9 +748,9 @@ static int verify_entry(
 
 static int verify_entry_array(
                 JournalFile *f,
-                MMapFileDescriptor *cache_data_fd, uint64_t n_data,
-                MMapFileDescriptor *cache_entry_fd, uint64_t n_entries,
-                MMapFileDescriptor *cache_entry_array_fd, uint64_t n_entry_arrays,
+                const uint64_t *data_offsets, uint64_t n_data,
+                const uint64_t *entry_offsets, uint64_t n_entries,
+                const uint64_t *entry_array_offsets, uint64_t n_entry_arrays,
                 usec_t *last_usec,
                 bool show_progress) {
 
@@ -729,9 +758,9 @@ static int verify_entry_array(
         int r;
 
         assert(f);
-        assert(cache_data_fd);
-        assert(cache_entry_fd);
-        assert(cache_entry_array_fd);
+        assert(data_offsets || n_data == 0);
+        assert(entry_offsets || n_entries == 0);
+        assert(entry_array_offsets || n_entry_arrays == 0);
         assert(last_usec);
 
         n = le64toh(f->header->n_entries);
@@ -748,7 +777,7 @@ static int verify_entry_array(
                         return -EBADMSG;
                 }
 
-                if (!contains_uint64(f->mmap, cache_entry_array_fd, n_entry_arrays, a)) {
+                if (!contains_offset(entry_array_offsets, n_entry_arrays, a)) {
                         error(a, "Invalid array %"PRIu64" of %"PRIu64, i, n);
                         return -EBADMSG;
                 }
@@ -774,7 +803,7 @@ static int verify_entry_array(
                         }
                         last = p;
 
-                        if (!contains_uint64(f->mmap, cache_entry_fd, n_entries, p)) {
+                        if (!contains_offset(entry_offsets, n_entries, p)) {
                                 error(a, "Invalid array entry at %"PRIu64" of %"PRIu64, i, n);
                                 return -EBADMSG;
                         }
@@ -783,7 +812,7 @@ static int verify_entry_array(
                         if (r < 0)
                                 return r;
 
-                        r = verify_entry(f, o, p, cache_data_fd, n_data);
+                        r = verify_entry(f, o, p, data_offsets, n_data);
                         if (r < 0)
                                 return r;
 
@@ -811,13 +840,13 @@ int journal_file_verify(
         uint64_t entry_seqnum = 0, entry_monotonic = 0, entry_realtime = 0;
         sd_id128_t entry_boot_id;
         bool entry_seqnum_set = false, entry_monotonic_set = false, entry_realtime_set = false, found_main_entry_array = false;
-        uint64_t n_weird = 0, n_objects = 0, n_entries = 0, n_data = 0, n_fields = 0, n_data_hash_tables = 0, n_field_hash_tables = 0, n_entry_arrays = 0, n_tags = 0;
-        usec_t last_usec = 0;
-        int data_fd = -1, entry_fd = -1, entry_array_fd = -1;
-        MMapFileDescriptor *cache_data_fd = NULL, *cache_entry_fd = NULL, *cache_entry_array_fd = NULL;
+        uint64_t n_weird = 0, n_objects = 0, n_entries = 0, n_data = 0, n_fields = 0, n_data_hash_tables = 0, n_field_hash_tables = 0, n_entry_arrays = 0, n_tags = 0, n_dictionaries = 0;
+        usec_t last_usec = 0, start_usec;
+        char ts[FORMAT_TIMESPAN_MAX], bytes[FORMAT_BYTES_MAX];
+        _cleanup_free_ uint64_t *data_offsets = NULL, *entry_offsets = NULL, *entry_array_offsets = NULL;
+        size_t n_data_allocated = 0, n_entries_allocated = 0, n_entry_arrays_allocated = 0;
         unsigned i;
         bool found_last = false;
-        const char *tmp_dir = NULL;
 
 #if HAVE_GCRYPT
         uint64_t last_tag = 0;
@@ -837,48 +866,7 @@ int journal_file_verify(
         } else if (f->seal)
                 return -ENOKEY;
 
-        r = var_tmp_dir(&tmp_dir);
-        if (r < 0) {
-                log_error_errno(r, "Failed to determine temporary directory: %m");
-                goto fail;
-        }
-
-        data_fd = open_tmpfile_unlinkable(tmp_dir, O_RDWR | O_CLOEXEC);
-        if (data_fd < 0) {
-                r = log_error_errno(data_fd, "Failed to create data file: %m");
-                goto fail;
-        }
-
-        entry_fd = open_tmpfile_unlinkable(tmp_dir, O_RDWR | O_CLOEXEC);
-        if (entry_fd < 0) {
-                r = log_error_errno(entry_fd, "Failed to create entry file: %m");
-                goto fail;
-        }
-
-        entry_array_fd = open_tmpfile_unlinkable(tmp_dir, O_RDWR | O_CLOEXEC);
-        if (entry_array_fd < 0) {
-                r = log_error_errno(entry_array_fd,
-                                    "Failed to create entry array file: %m");
-                goto fail;
-        }
-
-        cache_data_fd = mmap_cache_add_fd(f->mmap, data_fd);
-        if (!cache_data_fd) {
-                r = log_oom();
-                goto fail;
-        }
-
-        cache_entry_fd = mmap_cache_add_fd(f->mmap, entry_fd);
-        if (!cache_entry_fd) {
-                r = log_oom();
-                goto fail;
-        }
-
-        cache_entry_array_fd = mmap_cache_add_fd(f->mmap, entry_array_fd);
-        if (!cache_entry_array_fd) {
-                r = log_oom();
-                goto fail;
-        }
+        start_usec = now(CLOCK_MONOTONIC);
 
         if (le32toh(f->header->compatible_flags) & ~HEADER_COMPATIBLE_SUPPORTED) {
                 log_error("Cannot verify file with unknown extensions.");
@@ -925,8 +913,9 @@ int journal_file_verify(
                         goto fail;
                 }
 
-                if ((o->object.flags & OBJECT_COMPRESSED_XZ) &&
-                    (o->object.flags & OBJECT_COMPRESSED_LZ4)) {
+                if (!!(o->object.flags & OBJECT_COMPRESSED_XZ) +
+                    !!(o->object.flags & OBJECT_COMPRESSED_LZ4) +
+                    !!(o->object.flags & OBJECT_COMPRESSED_ZSTD) > 1) {
                         error(p, "Objected with double compression");
                         r = -EINVAL;
                         goto fail;
@@ -944,10 +933,16 @@ int journal_file_verify(
                         goto fail;
                 }
 
+                if ((o->object.flags & OBJECT_COMPRESSED_ZSTD) && !JOURNAL_HEADER_COMPRESSED_ZSTD(f->header)) {
+                        error(p, "ZSTD compressed object in file without ZSTD compression");
+                        r = -EBADMSG;
+                        goto fail;
+                }
+
                 switch (o->object.type) {
 
                 case OBJECT_DATA:
-                        r = write_uint64(data_fd, p);
+                        r = append_offset(&data_offsets, &n_data_allocated, n_data, p);
                         if (r < 0)
                                 goto fail;
 
@@ -965,7 +960,7 @@ int journal_file_verify(
                                 goto fail;
                         }
 
-                        r = write_uint64(entry_fd, p);
+                        r = append_offset(&entry_offsets, &n_entries_allocated, n_entries, p);
                         if (r < 0)
                                 goto fail;
 
@@ -1052,7 +1047,7 @@ int journal_file_verify(
                         break;
 
                 case OBJECT_ENTRY_ARRAY:
-                        r = write_uint64(entry_array_fd, p);
+                        r = append_offset(&entry_array_offsets, &n_entry_arrays_allocated, n_entry_arrays, p);
                         if (r < 0)
                                 goto fail;
 
@@ -1157,6 +1152,53 @@ int journal_file_verify(
                         n_tags++;
                         break;
 
+                case OBJECT_DICTIONARY:
+                        if (!JOURNAL_HEADER_ZSTD_DICTIONARY(f->header)) {
+                                error(p, "Dictionary object in file without dictionary support");
+                                r = -EBADMSG;
+                                goto fail;
+                        }
+
+                        if (!JOURNAL_HEADER_CONTAINS(f->header, dictionary_offset) ||
+                            le64toh(f->header->dictionary_offset) != p) {
+                                error(p, "Dictionary object not referenced from header");
+                                r = -EBADMSG;
+                                goto fail;
+                        }
+
+                        n_dictionaries++;
+                        break;
+
+                case OBJECT_TRIGRAM_INDEX:
+                        if (!JOURNAL_HEADER_CONTAINS(f->header, trigram_index_offset) ||
+                            le64toh(f->header->trigram_index_offset) != p) {
+                                error(p, "Trigram index object not referenced from header");
+                                r = -EBADMSG;
+                                goto fail;
+                        }
+
+                        break;
+
+                case OBJECT_TIME_INDEX:
+                        if (!JOURNAL_HEADER_CONTAINS(f->header, time_index_offset) ||
+                            le64toh(f->header->time_index_offset) != p) {
+                                error(p, "Time index object not referenced from header");
+                                r = -EBADMSG;
+                                goto fail;
+                        }
+
+                        break;
+
+                case OBJECT_ENTRY_ARRAY_INDEX:
+                        if (!JOURNAL_HEADER_CONTAINS(f->header, entry_array_index_offset) ||
+                            le64toh(f->header->entry_array_index_offset) != p) {
+                                error(p, "Entry array index object not referenced from header");
+                                r = -EBADMSG;
+                                goto fail;
+                        }
+
+                        break;
+
                 default:
                         n_weird++;
                 }
@@ -1215,6 +1257,13 @@ int journal_file_verify(
                 goto fail;
         }
 
+        if (JOURNAL_HEADER_CONTAINS(f->header, dictionary_offset) &&
+            le64toh(f->header->dictionary_offset) != 0 && n_dictionaries == 0) {
+                error(offsetof(Header, dictionary_offset), "Dictionary object pointer dead");
+                r = -EBADMSG;
+                goto fail;
+        }
+
         if (!found_main_entry_array && le64toh(f->header->entry_array_offset) != 0) {
                 error(0, "Missing entry array");
                 r = -EBADMSG;
@@ -1251,18 +1300,18 @@ int journal_file_verify(
          * referenced is consistent. */
 
         r = verify_entry_array(f,
-                               cache_data_fd, n_data,
-                               cache_entry_fd, n_entries,
-                               cache_entry_array_fd, n_entry_arrays,
+                               data_offsets, n_data,
+                               entry_offsets, n_entries,
+                               entry_array_offsets, n_entry_arrays,
                                &last_usec,
                                show_progress);
         if (r < 0)
                 goto fail;
 
         r = verify_hash_table(f,
-                              cache_data_fd, n_data,
-                              cache_entry_fd, n_entries,
-                              cache_entry_array_fd, n_entry_arrays,
+                              data_offsets, n_data,
+                              entry_offsets, n_entries,
+                              entry_array_offsets, n_entry_arrays,
                               &last_usec,
                               show_progress);
         if (r < 0)
@@ -1271,13 +1320,10 @@ int journal_file_verify(
         if (show_progress)
                 flush_progress();
 
-        mmap_cache_free_fd(f->mmap, cache_data_fd);
-        mmap_cache_free_fd(f->mmap, cache_entry_fd);
-        mmap_cache_free_fd(f->mmap, cache_entry_array_fd);
-
-        safe_close(data_fd);
-        safe_close(entry_fd);
-        safe_close(entry_array_fd);
+        log_debug("Verified %s (%s) in %s.",
+                  f->path,
+                  format_bytes(bytes, sizeof(bytes), le64toh(f->header->header_size) + le64toh(f->header->arena_size)),
+                  format_timespan(ts, sizeof(ts), now(CLOCK_MONOTONIC) - start_usec, USEC_PER_MSEC));
 
         if (first_contained)
                 *first_contained = le64toh(f->header->head_entry_realtime);
@@ -1298,23 +1344,5 @@ fail:
                   (unsigned long long) f->last_stat.st_size,
                   100 * p / f->last_stat.st_size);
 
-        if (data_fd >= 0)
-                safe_close(data_fd);
-
-        if (entry_fd >= 0)
-                safe_close(entry_fd);
-
-        if (entry_array_fd >= 0)
-                safe_close(entry_array_fd);
-
-        if (cache_data_fd)
-                mmap_cache_free_fd(f->mmap, cache_data_fd);
-
-        if (cache_entry_fd)
-                mmap_cache_free_fd(f->mmap, cache_entry_fd);
-
-        if (cache_entry_array_fd)
-                mmap_cache_free_fd(f->mmap, cache_entry_array_fd);
-
         return r;
 }
@@ -31,6 +31,7 @@
 #include "chattr-util.h"
 #include "def.h"
 #include "device-private.h"
+#include "escape.h"
 #include "fd-util.h"
 #include "fileio.h"
 #include "format-util.h"
@@ -43,6 +44,7 @@
 #include "journal-def.h"
 #include "journal-internal.h"
 #include "journal-qrcode.h"
+#include "journal-trigram.h"
 #include "journal-util.h"
 #include "journal-vacuum.h"
 #include "journal-verify.h"
@@ -60,6 +62,7 @@
 #include "rlimit-util.h"
 #include "set.h"
 #include "sigbus.h"
+#include "sort-util.h"
 #include "string-table.h"
 #include "strv.h"
 #include "syslog-util.h"
@@ -72,6 +75,7 @@
 #define DEFAULT_FSS_INTERVAL_USEC (15*USEC_PER_MINUTE)
 
 #define PROCESS_INOTIFY_INTERVAL 1024   /* Every 1,024 messages processed */
+#define COLUMNAR_ROWS_PER_BLOCK 1024U  /* Entries per block in columnar output mode */
 
 #if HAVE_PCRE2
 DEFINE_TRIVIAL_CLEANUP_FUNC(pcre2_match_data*, pcre2_match_data_free);
@@ -98,6 +102,98 @@ static int pattern_compile(const char *pattern, unsigned flags, pcre2_code **out
         return 0;
 }
 
+/* Determines the longest run of literal characters every match of the pattern has to contain, so that
+ * files with a trigram index can be pruned. This is deliberately conservative: any alternation or inline
+ * option makes us give up, and groups, character classes, escapes and anchors end a run. A character
+ * followed by a quantifier that permits zero repetitions is not required, hence dropped. */
+static int pattern_required_literal(const char *pattern, char **ret) {
+        _cleanup_free_ char *best = NULL, *run = NULL;
+        size_t n_best = 0, n_run = 0;
+        unsigned depth = 0;
+        bool last_literal = false;
+        const char *p;
+
+        assert(pattern);
+        assert(ret);
+
+        if (strchr(pattern, '|') || strstr(pattern, "(?") || strstr(pattern, "\\Q")) {
+                *ret = NULL;
+                return 0;
+        }
+
+        best = new(char, strlen(pattern) + 1);
+        run = new(char, strlen(pattern) + 1);
+        if (!best || !run)
+                return -ENOMEM;
+
+        for (p = pattern; *p; p++) {
+                bool literal = false;
+                char c = *p;
+
+                if (c == '\\') {
+                        if (!p[1])
+                                break;
+
+                        c = *(++p);
+                        /* \d, \w, \b, backreferences and friends are no literals */
+                        literal = !strchr(ALPHANUMERICAL, c);
+                } else if (c == '[') {
+                        /* Skip over the character class, which may start with a literal ']' */
+                        p++;
+                        if (*p == '^')
+                                p++;
+                        if (*p == ']')
+                                p++;
+                        for (; *p && *p != ']'; p++)
+                                if (*p == '\\' && p[1])
+                                        p++;
+                        if (!*p)
+                                break;
+                } else if (c == '(')
+                        depth++;
+                else if (c == ')') {
+                        if (depth > 0)
+                                depth--;
+                } else if (IN_SET(c, '?', '*', '{')) {
+                        /* The preceding character is optional, drop it (with all bytes of a UTF-8 sequence) */
+                        if (last_literal && n_run > 0) {
+                                while (n_run > 0 && ((uint8_t) run[n_run - 1] & 0xC0) == 0x80)
+                                        n_run--;
+                                if (n_run > 0)
+                                        n_run--;
+                        }
+                } else
+                        literal = !IN_SET(c, '^', '$', '.', '+', '}', ']');
+
+                if (literal && depth == 0) {
+                        run[n_run++] = c;
+                        last_literal = true;
+                        continue;
+                }
+
+                if (n_run > n_best) {
+                        memcpy(best, run, n_run);
+                        n_best = n_run;
+                }
+                n_run = 0;
+                last_literal = false;
+        }
+
+        if (n_run > n_best) {
+                memcpy(best, run, n_run);
+                n_best = n_run;
+        }
+
+        if (n_best < 3) {
+                *ret = NULL;
+                return 0;
+        }
+
+        best[n_best] = 0;
+        *ret = TAKE_PTR(best);
+        return 1;
+}
+
 #endif
 
 enum {
@@ -140,6 +236,7 @@ static char **arg_syslog_identifier = NULL;
 static char **arg_system_units = NULL;
 static char **arg_user_units = NULL;
 static const char *arg_field = NULL;
+static usec_t arg_histogram = 0;
 static bool arg_catalog = false;
 static bool arg_reverse = false;
 static int arg_journal_type = 0;
@@ -153,6 +250,7 @@ static char **arg_output_fields = NULL;
 #if HAVE_PCRE2
 static const char *arg_pattern = NULL;
 static pcre2_code *arg_compiled_pattern = NULL;
+static TrigramFilter *arg_trigram_filter = NULL;
 static int arg_case_sensitive = -1; /* -1 means be smart */
 #endif
 
@@ -162,6 +260,7 @@ static enum {
         ACTION_PRINT_HEADER,
         ACTION_SETUP_KEYS,
         ACTION_VERIFY,
+        ACTION_BUILD_INDEX,
         ACTION_DISK_USAGE,
         ACTION_LIST_CATALOG,
         ACTION_DUMP_CATALOG,
@@ -170,11 +269,14 @@ static enum {
         ACTION_FLUSH,
         ACTION_RELINQUISH_VAR,
         ACTION_SYNC,
+        ACTION_STATISTICS,
         ACTION_ROTATE,
         ACTION_VACUUM,
         ACTION_ROTATE_AND_VACUUM,
         ACTION_LIST_FIELDS,
         ACTION_LIST_FIELD_NAMES,
+        ACTION_COUNT_BY,
+        ACTION_HISTOGRAM,
 } arg_action = ACTION_SHOW;
 
 typedef struct BootId {
@@ -343,8 +445,9 @@ static int help(void) {
                "                               short-iso, short-iso-precise, short-full,\n"
                "                               short-monotonic, short-unix, verbose, export,\n"
                "                               json, json-pretty, json-sse, json-seq, cat,\n"
-               "                               with-unit)\n"
-               "     --output-fields=LIST    Select fields to print in verbose/export/json modes\n"
+               "                               with-unit, columnar)\n"
+               "     --output-fields=LIST    Select fields to print in verbose/export/json/\n"
+               "                               columnar modes\n"
                "     --utc                   Express time in Coordinated Universal Time (UTC)\n"
                "  -x --catalog               Add message explanations where available\n"
                "     --no-full               Ellipsize fields\n"
@@ -364,16 +467,20 @@ static int help(void) {
                "     --version               Show package version\n"
                "  -N --fields                List all field names currently used\n"
                "  -F --field=FIELD           List all values that a specified field takes\n"
+               "     --count-by=FIELD        Count the entries for each value of a field\n"
+               "     --histogram=TIME        Count the entries in intervals of the given length\n"
                "     --disk-usage            Show total disk usage of all journal files\n"
                "     --vacuum-size=BYTES     Reduce disk usage below specified size\n"
                "     --vacuum-files=INT      Leave only the specified number of journal files\n"
                "     --vacuum-time=TIME      Remove journal files older than specified time\n"
                "     --verify                Verify journal file consistency\n"
+               "     --build-index           Add a --grep index to archived journal files\n"
                "     --sync                  Synchronize unwritten journal messages to disk\n"
                "     --relinquish-var        Stop logging to disk, log to temporary file system\n"
                "     --smart-relinquish-var  Similar, but NOP if log directory is on root mount\n"
                "     --flush                 Flush all journal data from /run into /var\n"
                "     --rotate                Request immediate rotation of the journal files\n"
+               "     --statistics            Show internal statistics of the journal service\n"
                "     --header                Show journal header information\n"
                "     --list-catalog          Show all message IDs in the catalog\n"
                "     --dump-catalog          Show entries in the message catalog\n"
@@ -407,6 +514,7 @@ static int parse_argv(int argc, char *argv[]) {
                 ARG_INTERVAL,
                 ARG_VERIFY,
                 ARG_VERIFY_KEY,
+                ARG_BUILD_INDEX,
                 ARG_DISK_USAGE,
                 ARG_AFTER_CURSOR,
                 ARG_CURSOR_FILE,
@@ -419,6 +527,7 @@ static int parse_argv(int argc, char *argv[]) {
                 ARG_CASE_SENSITIVE,
                 ARG_UTC,
                 ARG_SYNC,
+                ARG_STATISTICS,
                 ARG_FLUSH,
                 ARG_RELINQUISH_VAR,
                 ARG_SMART_RELINQUISH_VAR,
@@ -428,6 +537,8 @@ static int parse_argv(int argc, char *argv[]) {
                 ARG_VACUUM_TIME,
                 ARG_NO_HOSTNAME,
                 ARG_OUTPUT_FIELDS,
+                ARG_COUNT_BY,
+                ARG_HISTOGRAM,
         };
 
         static const struct option options[] = {
@@ -464,6 +575,7 @@ static int parse_argv(int argc, char *argv[]) {
                 { "interval",             required_argument, NULL, ARG_INTERVAL             },
                 { "verify",               no_argument,       NULL, ARG_VERIFY               },
                 { "verify-key",           required_argument, NULL, ARG_VERIFY_KEY           },
+                { "build-index",          no_argument,       NULL, ARG_BUILD_INDEX          },
                 { "disk-usage",           no_argument,       NULL, ARG_DISK_USAGE           },
                 { "cursor",               required_argument, NULL, 'c'                      },
                 { "cursor-file",          required_argument, NULL, ARG_CURSOR_FILE          },
@@ -486,12 +598,15 @@ static int parse_argv(int argc, char *argv[]) {
                 { "relinquish-var",       no_argument,       NULL, ARG_RELINQUISH_VAR       },
                 { "smart-relinquish-var", no_argument,       NULL, ARG_SMART_RELINQUISH_VAR },
                 { "sync",                 no_argument,       NULL, ARG_SYNC                 },
+                { "statistics",           no_argument,       NULL, ARG_STATISTICS           },
                 { "rotate",               no_argument,       NULL, ARG_ROTATE               },
                 { "vacuum-size",          required_argument, NULL, ARG_VACUUM_SIZE          },
                 { "vacuum-files",         required_argument, NULL, ARG_VACUUM_FILES         },
                 { "vacuum-time",          required_argument, NULL, ARG_VACUUM_TIME          },
                 { "no-hostname",          no_argument,       NULL, ARG_NO_HOSTNAME          },
                 { "output-fields",        required_argument, NULL, ARG_OUTPUT_FIELDS        },
+                { "count-by",             required_argument, NULL, ARG_COUNT_BY             },
+                { "histogram",            required_argument, NULL, ARG_HISTOGRAM            },
                 {}
         };
 
@@ -538,7 +653,7 @@ static int parse_argv(int argc, char *argv[]) {
                                 return -EINVAL;
                         }
 
-                        if (IN_SET(arg_output, OUTPUT_EXPORT, OUTPUT_JSON, OUTPUT_JSON_PRETTY, OUTPUT_JSON_SSE, OUTPUT_JSON_SEQ, OUTPUT_CAT))
+                        if (IN_SET(arg_output, OUTPUT_EXPORT, OUTPUT_JSON, OUTPUT_JSON_PRETTY, OUTPUT_JSON_SSE, OUTPUT_JSON_SEQ, OUTPUT_CAT, OUTPUT_COLUMNAR))
                                 arg_quiet = true;
 
                         break;
@@ -704,6 +819,10 @@ static int parse_argv(int argc, char *argv[]) {
                         arg_action = ACTION_VERIFY;
                         break;
 
+                case ARG_BUILD_INDEX:
+                        arg_action = ACTION_BUILD_INDEX;
+                        break;
+
                 case ARG_DISK_USAGE:
                         arg_action = ACTION_DISK_USAGE;
                         break;
@@ -891,6 +1010,21 @@ static int parse_argv(int argc, char *argv[]) {
                         arg_action = ACTION_LIST_FIELD_NAMES;
                         break;
 
+                case ARG_COUNT_BY:
+                        arg_action = ACTION_COUNT_BY;
+                        arg_field = optarg;
+                        break;
+
+                case ARG_HISTOGRAM:
+                        r = parse_sec(optarg, &arg_histogram);
+                        if (r < 0 || arg_histogram <= 0 || arg_histogram == USEC_INFINITY) {
+                                log_error("Failed to parse histogram interval: %s", optarg);
+                                return -EINVAL;
+                        }
+
+                        arg_action = ACTION_HISTOGRAM;
+                        break;
+
                 case ARG_NO_HOSTNAME:
                         arg_no_hostname = true;
                         break;
@@ -960,6 +1094,10 @@ static int parse_argv(int argc, char *argv[]) {
                         arg_action = ACTION_SYNC;
                         break;
 
+                case ARG_STATISTICS:
+                        arg_action = ACTION_STATISTICS;
+                        break;
+
                 case ARG_OUTPUT_FIELDS: {
                         _cleanup_strv_free_ char **v = NULL;
 
@@ -1007,7 +1145,13 @@ static int parse_argv(int argc, char *argv[]) {
                 return -EINVAL;
         }
 
-        if (!IN_SET(arg_action, ACTION_SHOW, ACTION_DUMP_CATALOG, ACTION_LIST_CATALOG) && optind < argc) {
+        if (IN_SET(arg_action, ACTION_COUNT_BY, ACTION_HISTOGRAM) &&
+            (arg_follow || arg_cursor || arg_after_cursor || arg_cursor_file)) {
+                log_error("Using --count-by= or --histogram= with --follow, --cursor=, --after-cursor= or --cursor-file= is not supported.");
+                return -EINVAL;
+        }
+
+        if (!IN_SET(arg_action, ACTION_SHOW, ACTION_COUNT_BY, ACTION_HISTOGRAM, ACTION_DUMP_CATALOG, ACTION_LIST_CATALOG) && optind < argc) {
                 log_error("Extraneous arguments starting with '%s'", argv[optind]);
                 return -EINVAL;
         }
@@ -1029,7 +1173,13 @@ static int parse_argv(int argc, char *argv[]) {
         }
 
 #if HAVE_PCRE2
+        if (arg_pattern && IN_SET(arg_action, ACTION_COUNT_BY, ACTION_HISTOGRAM)) {
+                log_error("Using --count-by= or --histogram= with --grep= is not supported.");
+                return -EINVAL;
+        }
+
         if (arg_pattern) {
+                _cleanup_free_ char *literal = NULL;
                 unsigned flags;
 
                 if (arg_case_sensitive >= 0)
@@ -1060,6 +1210,17 @@ static int parse_argv(int argc, char *argv[]) {
                 r = pattern_compile(arg_pattern, flags, &arg_compiled_pattern);
                 if (r < 0)
                         return r;
+
+                r = pattern_required_literal(arg_pattern, &literal);
+                if (r < 0)
+                        return log_oom();
+                if (r > 0) {
+                        log_debug("Using trigram indexes for literal \"%s\", where available.", literal);
+
+                        r = trigram_filter_new(literal, flags & PCRE2_CASELESS, &arg_trigram_filter);
+                        if (r < 0)
+                                return log_oom();
+                }
         }
 #endif
 
@@ -1157,247 +1318,394 @@ static void boot_id_free_all(BootId *l) {
         }
 }
 
-static int discover_next_boot(sd_journal *j,
-                sd_id128_t previous_boot_id,
-                bool advance_older,
-                BootId **ret) {
+static int get_boots(
+                sd_journal *j,
+                BootId **boots,
+                sd_id128_t *boot_id,
+                int offset) {
 
-        _cleanup_free_ BootId *next_boot = NULL;
-        char match[9+32+1] = "_BOOT_ID=";
-        sd_id128_t boot_id;
-        int r;
+        BootId *head = NULL, *tail = NULL, *id;
+        int r, k, count = 0;
 
         assert(j);
-        assert(ret);
+        assert(!boots != !boot_id);
 
-        /* We expect the journal to be on the last position of a boot
-         * (in relation to the direction we are going), so that the next
-         * invocation of sd_journal_next/previous will be from a different
-         * boot. We then collect any information we desire and then jump
-         * to the last location of the new boot by using a _BOOT_ID match
-         * coming from the other journal direction. */
+        sd_journal_restart_boots(j);
 
-        /* Make sure we aren't restricted by any _BOOT_ID matches, so that
-         * we can actually advance to a *different* boot. */
-        sd_journal_flush_matches(j);
+        for (;;) {
+                _cleanup_free_ BootId *current = NULL;
 
-        do {
-                if (advance_older)
-                        r = sd_journal_previous(j);
-                else
-                        r = sd_journal_next(j);
-                if (r < 0)
-                        return r;
-                else if (r == 0)
-                        return 0; /* End of journal, yay. */
+                current = new0(BootId, 1);
+                if (!current) {
+                        boot_id_free_all(head);
+                        return -ENOMEM;
+                }
 
-                r = sd_journal_get_monotonic_usec(j, NULL, &boot_id);
-                if (r < 0)
+                r = sd_journal_enumerate_boots(j, &current->id, &current->first, &current->last);
+                if (r < 0) {
+                        boot_id_free_all(head);
                         return r;
+                }
+                if (r == 0)
+                        break;
 
-                /* We iterate through this in a loop, until the boot ID differs from the previous one. Note that
-                 * normally, this will only require a single iteration, as we seeked to the last entry of the previous
-                 * boot entry already. However, it might happen that the per-journal-field entry arrays are less
-                 * complete than the main entry array, and hence might reference an entry that's not actually the last
-                 * one of the boot ID as last one. Let's hence use the per-field array is initial seek position to
-                 * speed things up, but let's not trust that it is complete, and hence, manually advance as
-                 * necessary. */
+                LIST_INSERT_AFTER(boot_list, head, tail, current);
+                tail = TAKE_PTR(current);
+                count++;
+        }
 
-        } while (sd_id128_equal(boot_id, previous_boot_id));
+        if (boots) {
+                *boots = head;
+                return count;
+        }
 
-        next_boot = new0(BootId, 1);
-        if (!next_boot)
-                return -ENOMEM;
+        /* Offset 0 is the last (and current) boot, 1 the chronologically first one, and negative offsets count
+         * backwards from the last one. If a reference boot ID is given, the offset is relative to that. */
+        if (sd_id128_is_null(*boot_id))
+                k = offset > 0 ? offset - 1 : count - 1 + offset;
+        else {
+                k = 0;
+                LIST_FOREACH(boot_list, id, head) {
+                        if (sd_id128_equal(id->id, *boot_id))
+                                break;
+                        k++;
+                }
 
-        next_boot->id = boot_id;
+                if (!id)
+                        k = count; /* Not found */
+                else
+                        k += offset;
+        }
 
-        r = sd_journal_get_realtime_usec(j, &next_boot->first);
-        if (r < 0)
-                return r;
+        r = 0;
+        if (k >= 0 && k < count) {
+                LIST_FOREACH(boot_list, id, head)
+                        if (k-- == 0)
+                                break;
 
-        /* Now seek to the last occurrence of this boot ID. */
-        sd_id128_to_string(next_boot->id, match + 9);
-        r = sd_journal_add_match(j, match, sizeof(match) - 1);
-        if (r < 0)
+                *boot_id = id->id;
+                r = 1;
+        }
+
+        boot_id_free_all(head);
+        return r;
+}
+
+static int list_boots(sd_journal *j) {
+        int w, i, count;
+        BootId *id, *all_ids;
+
+        assert(j);
+
+        count = get_boots(j, &all_ids, NULL, 0);
+        if (count < 0)
+                return log_error_errno(count, "Failed to determine boots: %m");
+        if (count == 0)
+                return count;
+
+        (void) pager_open(arg_pager_flags);
+
+        /* numbers are one less, but we need an extra char for the sign */
+        w = DECIMAL_STR_WIDTH(count - 1) + 1;
+
+        i = 0;
+        LIST_FOREACH(boot_list, id, all_ids) {
+                char a[FORMAT_TIMESTAMP_MAX], b[FORMAT_TIMESTAMP_MAX];
+
+                printf("% *i " SD_ID128_FORMAT_STR " %s—%s\n",
+                       w, i - count + 1,
+                       SD_ID128_FORMAT_VAL(id->id),
+                       format_timestamp_maybe_utc(a, sizeof(a), id->first),
+                       format_timestamp_maybe_utc(b, sizeof(b), id->last));
+                i++;
+        }
+
+        boot_id_free_all(all_ids);
+
+        return 0;
+}
+
+typedef struct FieldCount {
+        char *value;
+        uint64_t n;
+} FieldCount;
+
+static FieldCount* field_count_free(FieldCount *c) {
+        if (!c)
+                return NULL;
+
+        free(c->value);
+        return mfree(c);
+}
+
+DEFINE_PRIVATE_HASH_OPS_WITH_VALUE_DESTRUCTOR(field_count_hash_ops, char, string_hash_func, string_compare_func,
+                                              FieldCount, field_count_free);
+
+static int field_count_compare(FieldCount * const *a, FieldCount * const *b) {
+        int r;
+
+        /* Most frequent values first */
+        r = CMP((*b)->n, (*a)->n);
+        if (r != 0)
                 return r;
 
-        if (advance_older)
-                r = sd_journal_seek_head(j);
+        return strcmp((*a)->value, (*b)->value);
+}
+
+static int count_value(Hashmap *counts, const void *data, size_t size, uint64_t n) {
+        _cleanup_free_ char *value = NULL;
+        FieldCount *c;
+        int r;
+
+        assert(counts);
+
+        /* Values may contain anything, escape them so that they can be printed, and used as keys */
+        value = cescape_length(data, size);
+        if (!value)
+                return log_oom();
+
+        c = hashmap_get(counts, value);
+        if (c) {
+                c->n += n;
+                return 0;
+        }
+
+        c = new(FieldCount, 1);
+        if (!c)
+                return log_oom();
+
+        *c = (FieldCount) {
+                .value = TAKE_PTR(value),
+                .n = n,
+        };
+
+        r = hashmap_put(counts, c->value, c);
+        if (r < 0) {
+                field_count_free(c);
+                return log_oom();
+        }
+
+        return 0;
+}
+
+static int aggregate_seek(sd_journal *j) {
+        int r;
+
+        assert(j);
+
+        if (arg_since_set)
+                r = sd_journal_seek_realtime_usec(j, arg_since);
         else
-                r = sd_journal_seek_tail(j);
+                r = sd_journal_seek_head(j);
         if (r < 0)
-                return r;
+                return log_error_errno(r, "Failed to seek: %m");
 
-        if (advance_older)
-                r = sd_journal_next(j);
-        else
-                r = sd_journal_previous(j);
+        return 0;
+}
+
+static int aggregate_next(sd_journal *j, usec_t *ret_realtime) {
+        usec_t t;
+        int r;
+
+        assert(j);
+
+        /* Moves to the next entry, and returns 0 once we are past --until= */
+
+        r = sd_journal_next(j);
         if (r < 0)
-                return r;
-        else if (r == 0)
-                return log_debug_errno(SYNTHETIC_ERRNO(ENODATA),
-                                       "Whoopsie! We found a boot ID but can't read its last entry."); /* This shouldn't happen. We just came from this very boot ID. */
+                return log_error_errno(r, "Failed to iterate through journal: %m");
+        if (r == 0)
+                return 0;
 
-        r = sd_journal_get_realtime_usec(j, &next_boot->last);
+        if (!arg_until_set && !ret_realtime)
+                return 1;
+
+        r = sd_journal_get_realtime_usec(j, &t);
         if (r < 0)
-                return r;
+                return log_error_errno(r, "Failed to get realtime timestamp: %m");
+        if (arg_until_set && t > arg_until)
+                return 0;
 
-        *ret = TAKE_PTR(next_boot);
+        if (ret_realtime)
+                *ret_realtime = t;
 
-        return 0;
+        return 1;
 }
 
-static int get_boots(
-                sd_journal *j,
-                BootId **boots,
-                sd_id128_t *boot_id,
-                int offset) {
-
-        bool skip_once;
-        int r, count = 0;
-        BootId *head = NULL, *tail = NULL, *id;
-        const bool advance_older = boot_id && offset <= 0;
-        sd_id128_t previous_boot_id;
+static int count_by(sd_journal *j) {
+        _cleanup_hashmap_free_ Hashmap *counts = NULL;
+        _cleanup_free_ FieldCount **sorted = NULL;
+        _cleanup_free_ char *prefix = NULL;
+        const void *data;
+        FieldCount *c;
+        uint64_t max = 0;
+        size_t n = 0, size, k;
+        Iterator i;
+        int r, w;
 
         assert(j);
+        assert(arg_field);
 
-        /* Adjust for the asymmetry that offset 0 is
-         * the last (and current) boot, while 1 is considered the
-         * (chronological) first boot in the journal. */
-        skip_once = boot_id && sd_id128_is_null(*boot_id) && offset <= 0;
+        counts = hashmap_new(&field_count_hash_ops);
+        if (!counts)
+                return log_oom();
 
-        /* Advance to the earliest/latest occurrence of our reference
-         * boot ID (taking our lookup direction into account), so that
-         * discover_next_boot() can do its job.
-         * If no reference is given, the journal head/tail will do,
-         * they're "virtual" boots after all. */
-        if (boot_id && !sd_id128_is_null(*boot_id)) {
-                char match[9+32+1] = "_BOOT_ID=";
+        r = sd_journal_set_data_threshold(j, 0);
+        if (r < 0)
+                return log_error_errno(r, "Failed to unset data size threshold: %m");
 
-                sd_journal_flush_matches(j);
+        if (!j->level0 && !arg_since_set && !arg_until_set) {
+                /* Without any filter the counters kept in the data objects already tell how many entries
+                 * carry each value, hence there's no need to look at the entries at all. */
 
-                sd_id128_to_string(*boot_id, match + 9);
-                r = sd_journal_add_match(j, match, sizeof(match) - 1);
+                r = sd_journal_query_unique(j, arg_field);
                 if (r < 0)
-                        return r;
+                        return log_error_errno(r, "Failed to query unique data objects: %m");
 
-                if (advance_older)
-                        r = sd_journal_seek_head(j); /* seek to oldest */
-                else
-                        r = sd_journal_seek_tail(j); /* seek to newest */
-                if (r < 0)
-                        return r;
+                k = strlen(arg_field) + 1;
 
-                if (advance_older)
-                        r = sd_journal_next(j);     /* read the oldest entry */
-                else
-                        r = sd_journal_previous(j); /* read the most recently added entry */
-                if (r < 0)
-                        return r;
-                else if (r == 0)
-                        goto finish;
-                else if (offset == 0) {
-                        count = 1;
-                        goto finish;
-                }
+                SD_JOURNAL_FOREACH_UNIQUE(j, data, size) {
+                        uint64_t m;
 
-                /* At this point the read pointer is positioned at the oldest/newest occurrence of the reference boot
-                 * ID. After flushing the matches, one more invocation of _previous()/_next() will hence place us at
-                 * the following entry, which must then have an older/newer boot ID */
+                        r = journal_unique_n_entries(j, &m);
+                        if (r < 0)
+                                return log_error_errno(r, "Failed to count entries: %m");
+
+                        r = count_value(counts, (const uint8_t*) data + k, size - k, m);
+                        if (r < 0)
+                                return r;
+                }
         } else {
+                prefix = strjoin(arg_field, "=");
+                if (!prefix)
+                        return log_oom();
 
-                if (advance_older)
-                        r = sd_journal_seek_tail(j); /* seek to newest */
-                else
-                        r = sd_journal_seek_head(j); /* seek to oldest */
+                r = aggregate_seek(j);
                 if (r < 0)
                         return r;
 
-                /* No sd_journal_next()/_previous() here.
-                 *
-                 * At this point the read pointer is positioned after the newest/before the oldest entry in the whole
-                 * journal. The next invocation of _previous()/_next() will hence position us at the newest/oldest
-                 * entry we have. */
-        }
-
-        previous_boot_id = SD_ID128_NULL;
-        for (;;) {
-                _cleanup_free_ BootId *current = NULL;
-
-                r = discover_next_boot(j, previous_boot_id, advance_older, &current);
-                if (r < 0) {
-                        boot_id_free_all(head);
-                        return r;
-                }
-
-                if (!current)
-                        break;
+                for (;;) {
+                        r = aggregate_next(j, NULL);
+                        if (r < 0)
+                                return r;
+                        if (r == 0)
+                                break;
 
-                previous_boot_id = current->id;
+                        JOURNAL_FOREACH_DATA_RETVAL(j, data, size, r) {
+                                const char *v;
 
-                if (boot_id) {
-                        if (!skip_once)
-                                offset += advance_older ? 1 : -1;
-                        skip_once = false;
+                                v = memory_startswith(data, size, prefix);
+                                if (!v)
+                                        continue;
 
-                        if (offset == 0) {
-                                count = 1;
-                                *boot_id = current->id;
-                                break;
+                                r = count_value(counts, v, size - ((const char*) v - (const char*) data), 1);
+                                if (r < 0)
+                                        return r;
                         }
-                } else {
-                        LIST_FOREACH(boot_list, id, head) {
-                                if (sd_id128_equal(id->id, current->id)) {
-                                        /* boot id already stored, something wrong with the journal files */
-                                        /* exiting as otherwise this problem would cause forever loop */
-                                        goto finish;
-                                }
+                        if (r == -EBADMSG) {
+                                log_debug_errno(r, "Skipping entry we can't read: %m");
+                                continue;
                         }
-                        LIST_INSERT_AFTER(boot_list, head, tail, current);
-                        tail = TAKE_PTR(current);
-                        count++;
+                        if (r < 0)
+                                return log_error_errno(r, "Failed to read journal entry: %m");
                 }
         }
 
-finish:
-        if (boots)
-                *boots = head;
+        if (hashmap_isempty(counts))
+                return 0;
+
+        sorted = new(FieldCount*, hashmap_size(counts));
+        if (!sorted)
+                return log_oom();
+
+        HASHMAP_FOREACH(c, counts, i) {
+                sorted[n++] = c;
+                max = MAX(max, c->n);
+        }
+
+        typesafe_qsort(sorted, n, field_count_compare);
+
+        (void) pager_open(arg_pager_flags);
 
-        sd_journal_flush_matches(j);
+        w = DECIMAL_STR_WIDTH(max);
+        for (k = 0; k < n; k++)
+                printf("%*" PRIu64 " %s\n", w, sorted[k]->n, sorted[k]->value);
 
-        return count;
+        return 0;
 }
 
-static int list_boots(sd_journal *j) {
-        int w, i, count;
-        BootId *id, *all_ids;
+typedef struct HistogramBucket {
+        usec_t start;
+        uint64_t n;
+} HistogramBucket;
+
+static int histogram_bucket_compare(const HistogramBucket *a, const HistogramBucket *b) {
+        return CMP(a->start, b->start);
+}
+
+static int histogram(sd_journal *j) {
+        _cleanup_free_ HistogramBucket *buckets = NULL;
+        size_t n_buckets = 0, n_allocated = 0, i, k;
+        uint64_t max = 0;
+        int r, w;
 
         assert(j);
+        assert(arg_histogram > 0);
 
-        count = get_boots(j, &all_ids, NULL, 0);
-        if (count < 0)
-                return log_error_errno(count, "Failed to determine boots: %m");
-        if (count == 0)
-                return count;
+        r = aggregate_seek(j);
+        if (r < 0)
+                return r;
 
-        (void) pager_open(arg_pager_flags);
+        /* Entries are returned in chronological order, so usually they fall into the bucket of the previous
+         * one. If the clock jumped backwards they don't, hence sort and merge the buckets in the end. */
+        for (;;) {
+                usec_t t;
 
-        /* numbers are one less, but we need an extra char for the sign */
-        w = DECIMAL_STR_WIDTH(count - 1) + 1;
+                r = aggregate_next(j, &t);
+                if (r < 0)
+                        return r;
+                if (r == 0)
+                        break;
 
-        i = 0;
-        LIST_FOREACH(boot_list, id, all_ids) {
-                char a[FORMAT_TIMESTAMP_MAX], b[FORMAT_TIMESTAMP_MAX];
+                t -= t % arg_histogram;
 
-                printf("% *i " SD_ID128_FORMAT_STR " %s—%s\n",
-                       w, i - count + 1,
-                       SD_ID128_FORMAT_VAL(id->id),
-                       format_timestamp_maybe_utc(a, sizeof(a), id->first),
-                       format_timestamp_maybe_utc(b, sizeof(b), id->last));
-                i++;
+                if (n_buckets > 0 && buckets[n_buckets - 1].start == t) {
+                        buckets[n_buckets - 1].n++;
+                        continue;
+                }
+
+                if (!GREEDY_REALLOC(buckets, n_allocated, n_buckets + 1))
+                        return log_oom();
+
+                buckets[n_buckets++] = (HistogramBucket) {
+                        .start = t,
+                        .n = 1,
+                };
         }
 
-        boot_id_free_all(all_ids);
+        typesafe_qsort(buckets, n_buckets, histogram_bucket_compare);
+
+        for (i = 0, k = 0; i < n_buckets; i++) {
+                if (k > 0 && buckets[k - 1].start == buckets[i].start)
+                        buckets[k - 1].n += buckets[i].n;
+                else
+                        buckets[k++] = buckets[i];
+        }
+        n_buckets = k;
+
+        for (i = 0; i < n_buckets; i++)
+                max = MAX(max, buckets[i].n);
+
+        (void) pager_open(arg_pager_flags);
+
+        w = DECIMAL_STR_WIDTH(max);
+        for (i = 0; i < n_buckets; i++) {
+                char a[FORMAT_TIMESTAMP_MAX];
+
+                printf("%s %*" PRIu64 "\n",
+                       format_timestamp_maybe_utc(a, sizeof(a), buckets[i].start),
+                       w, buckets[i].n);
+        }
 
         return 0;
 }
@@ -1904,6 +2212,10 @@ static int verify(sd_journal *j) {
 
         log_show_color(true);
 
+        r = journal_open_deferred_files(j);
+        if (r < 0)
+                return log_error_errno(r, "Failed to open journal files: %m");
+
         ORDERED_HASHMAP_FOREACH(f, j->files, i) {
                 int k;
                 usec_t first = 0, validated = 0, last = 0;
@@ -1942,6 +2254,35 @@ static int verify(sd_journal *j) {
         return r;
 }
 
+static int build_index(sd_journal *j) {
+        int r = 0;
+        Iterator i;
+        JournalFile *f;
+
+        assert(j);
+
+        r = journal_open_deferred_files(j);
+        if (r < 0)
+                return log_error_errno(r, "Failed to open journal files: %m");
+
+        ORDERED_HASHMAP_FOREACH(f, j->files, i) {
+                int k;
+
+                k = journal_file_build_trigram_index(f);
+                if (k == -EEXIST)
+                        log_debug("Journal file %s is already indexed, skipping.", f->path);
+                else if (IN_SET(k, -EBUSY, -EOPNOTSUPP, -ENODATA))
+                        log_debug_errno(k, "Journal file %s is active, sealed, empty or too old to be indexed, skipping: %m", f->path);
+                else if (k < 0) {
+                        log_warning_errno(k, "Failed to index %s: %m", f->path);
+                        r = k;
+                } else
+                        log_info("Indexed %s.", f->path);
+        }
+
+        return r;
+}
+
 static int simple_varlink_call(const char *option, const char *method) {
         _cleanup_(varlink_flush_close_unrefp) Varlink *link = NULL;
         const char *error;
@@ -1983,6 +2324,34 @@ static int sync_journal(void) {
         return simple_varlink_call("--sync", "io.systemd.Journal.Synchronize");
 }
 
+static int show_statistics(void) {
+        _cleanup_(varlink_flush_close_unrefp) Varlink *link = NULL;
+        JsonVariant *reply = NULL;
+        const char *error;
+        int r;
+
+        if (arg_machine)
+                return log_error_errno(SYNTHETIC_ERRNO(EOPNOTSUPP), "--statistics is not supported in conjunction with --machine=.");
+
+        r = varlink_connect_address(&link, "/run/systemd/journal/io.systemd.journal");
+        if (r < 0)
+                return log_error_errno(r, "Failed to connect to /run/systemd/journal/io.systemd.journal: %m");
+
+        (void) varlink_set_description(link, "journal");
+
+        r = varlink_call(link, "io.systemd.Journal.GetStatistics", NULL, &reply, &error, NULL);
+        if (r < 0)
+                return log_error_errno(r, "Failed to execute varlink call: %m");
+        if (error)
+                return log_error_errno(SYNTHETIC_ERRNO(ENOANO),
+                                       "Failed to execute varlink call: %s", error);
+
+        json_variant_dump(reply,
+                          (arg_output == OUTPUT_JSON ? 0 : JSON_FORMAT_PRETTY) | JSON_FORMAT_COLOR_AUTO | JSON_FORMAT_NEWLINE,
+                          NULL, NULL);
+        return 0;
+}
+
 static int wait_for_change(sd_journal *j, int poll_fd) {
         struct pollfd pollfds[] = {
                 { .fd = poll_fd, .events = POLLIN },
@@ -2025,6 +2394,7 @@ static int wait_for_change(sd_journal *j, int poll_fd) {
 int main(int argc, char *argv[]) {
         bool previous_boot_id_valid = false, first_line = true, ellipsized = false, need_seek = false;
         bool use_cursor = false, after_cursor = false;
+        _cleanup_(columnar_writer_freep) ColumnarWriter *columnar = NULL;
         _cleanup_(sd_journal_closep) sd_journal *j = NULL;
         sd_id128_t previous_boot_id;
         int n_shown = 0, r, poll_fd = -1;
@@ -2098,6 +2468,10 @@ int main(int argc, char *argv[]) {
                 r = sync_journal();
                 goto finish;
 
+        case ACTION_STATISTICS:
+                r = show_statistics();
+                goto finish;
+
         case ACTION_ROTATE:
                 r = rotate();
                 goto finish;
@@ -2105,12 +2479,15 @@ int main(int argc, char *argv[]) {
         case ACTION_SHOW:
         case ACTION_PRINT_HEADER:
         case ACTION_VERIFY:
+        case ACTION_BUILD_INDEX:
         case ACTION_DISK_USAGE:
         case ACTION_LIST_BOOTS:
         case ACTION_VACUUM:
         case ACTION_ROTATE_AND_VACUUM:
         case ACTION_LIST_FIELDS:
         case ACTION_LIST_FIELD_NAMES:
+        case ACTION_COUNT_BY:
+        case ACTION_HISTOGRAM:
                 /* These ones require access to the journal files, continue below. */
                 break;
 
@@ -2119,14 +2496,14 @@ int main(int argc, char *argv[]) {
         }
 
         if (arg_directory)
-                r = sd_journal_open_directory(&j, arg_directory, arg_journal_type);
+                r = sd_journal_open_directory(&j, arg_directory, arg_journal_type | SD_JOURNAL_PARALLEL);
         else if (arg_root)
-                r = sd_journal_open_directory(&j, arg_root, arg_journal_type | SD_JOURNAL_OS_ROOT);
+                r = sd_journal_open_directory(&j, arg_root, arg_journal_type | SD_JOURNAL_OS_ROOT | SD_JOURNAL_PARALLEL);
         else if (arg_file_stdin) {
                 int ifd = STDIN_FILENO;
-                r = sd_journal_open_files_fd(&j, &ifd, 1, 0);
+                r = sd_journal_open_files_fd(&j, &ifd, 1, SD_JOURNAL_PARALLEL);
         } else if (arg_file)
-                r = sd_journal_open_files(&j, (const char**) arg_file, 0);
+                r = sd_journal_open_files(&j, (const char**) arg_file, SD_JOURNAL_PARALLEL);
         else if (arg_machine) {
                 _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
                 _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
@@ -2173,11 +2550,11 @@ int main(int argc, char *argv[]) {
                         goto finish;
                 }
 
-                r = sd_journal_open_directory_fd(&j, fd, SD_JOURNAL_OS_ROOT);
+                r = sd_journal_open_directory_fd(&j, fd, SD_JOURNAL_OS_ROOT | SD_JOURNAL_PARALLEL);
                 if (r < 0)
                         safe_close(fd);
         } else
-                r = sd_journal_open(&j, !arg_merge*SD_JOURNAL_LOCAL_ONLY + arg_journal_type);
+                r = sd_journal_open(&j, !arg_merge*SD_JOURNAL_LOCAL_ONLY + arg_journal_type + SD_JOURNAL_PARALLEL);
         if (r < 0) {
                 log_error_errno(r, "Failed to open %s: %m", arg_directory ?: arg_file ? "files" : "journal");
                 goto finish;
@@ -2197,6 +2574,7 @@ int main(int argc, char *argv[]) {
         case ACTION_UPDATE_CATALOG:
         case ACTION_FLUSH:
         case ACTION_SYNC:
+        case ACTION_STATISTICS:
         case ACTION_ROTATE:
                 assert_not_reached("Unexpected action.");
 
@@ -2209,6 +2587,10 @@ int main(int argc, char *argv[]) {
                 r = verify(j);
                 goto finish;
 
+        case ACTION_BUILD_INDEX:
+                r = build_index(j);
+                goto finish;
+
         case ACTION_DISK_USAGE: {
                 uint64_t bytes = 0;
                 char sbytes[FORMAT_BYTES_MAX];
@@ -2241,7 +2623,7 @@ int main(int argc, char *argv[]) {
                 HASHMAP_FOREACH(d, j->directories_by_path, i) {
                         int q;
 
-                        q = journal_directory_vacuum(d->path, arg_vacuum_size, arg_vacuum_n_files, arg_vacuum_time, NULL, !arg_quiet);
+                        q = journal_directory_vacuum(d->path, arg_vacuum_size, arg_vacuum_n_files, arg_vacuum_time, NULL, NULL, !arg_quiet);
                         if (q < 0) {
                                 log_error_errno(q, "Failed to vacuum %s: %m", d->path);
                                 r = q;
@@ -2265,6 +2647,8 @@ int main(int argc, char *argv[]) {
 
         case ACTION_SHOW:
         case ACTION_LIST_FIELDS:
+        case ACTION_COUNT_BY:
+        case ACTION_HISTOGRAM:
                 break;
 
         default:
@@ -2355,6 +2739,22 @@ int main(int argc, char *argv[]) {
                 goto finish;
         }
 
+        /* Archived files entirely outside of --since/--until don't need to be opened at all */
+        if (arg_since_set || arg_until_set)
+                journal_set_realtime_range(j,
+                                           arg_since_set ? arg_since : 0,
+                                           arg_until_set ? arg_until : USEC_INFINITY);
+
+        if (arg_action == ACTION_COUNT_BY) {
+                r = count_by(j);
+                goto finish;
+        }
+
+        if (arg_action == ACTION_HISTOGRAM) {
+                r = histogram(j);
+                goto finish;
+        }
+
         /* Opening the fd now means the first sd_journal_wait() will actually wait */
         if (arg_follow) {
                 poll_fd = sd_journal_get_fd(j);
@@ -2466,6 +2866,14 @@ int main(int argc, char *argv[]) {
         if (!arg_follow)
                 (void) pager_open(arg_pager_flags);
 
+        if (arg_output == OUTPUT_COLUMNAR) {
+                r = columnar_writer_new(stdout, arg_output_fields, COLUMNAR_ROWS_PER_BLOCK, &columnar);
+                if (r < 0) {
+                        log_error_errno(r, "Failed to allocate columnar writer: %m");
+                        goto finish;
+                }
+        }
+
         if (!arg_quiet && (arg_lines != 0 || arg_follow)) {
                 usec_t start, end;
                 char start_buf[FORMAT_TIMESTAMP_MAX], end_buf[FORMAT_TIMESTAMP_MAX];
@@ -2555,6 +2963,17 @@ int main(int argc, char *argv[]) {
                                 if (!md)
                                         return log_oom();
 
+                                if (arg_trigram_filter && j->current_file) {
+                                        r = trigram_filter_test(arg_trigram_filter, j->current_file);
+                                        if (r == 0) {
+                                                need_seek = true;
+                                                continue;
+                                        }
+                                        if (r < 0)
+                                                log_debug_errno(r, "Failed to consult trigram index of %s, ignoring: %m",
+                                                                j->current_file->path);
+                                }
+
                                 r = sd_journal_get_data(j, "MESSAGE", &message, &len);
                                 if (r < 0) {
                                         if (r == -ENOENT) {
@@ -2604,8 +3023,11 @@ int main(int argc, char *argv[]) {
                                 arg_utc * OUTPUT_UTC |
                                 arg_no_hostname * OUTPUT_NO_HOSTNAME;
 
-                        r = show_journal_entry(stdout, j, arg_output, 0, flags,
-                                               arg_output_fields, highlight, &ellipsized);
+                        if (columnar)
+                                r = columnar_writer_add(columnar, j, flags);
+                        else
+                                r = show_journal_entry(stdout, j, arg_output, 0, flags,
+                                                       arg_output_fields, highlight, &ellipsized);
                         need_seek = true;
                         if (r == -EADDRNOTAVAIL)
                                 break;
@@ -2629,6 +3051,12 @@ int main(int argc, char *argv[]) {
                         }
                 }
 
+                if (columnar) {
+                        r = columnar_writer_flush(columnar);
+                        if (r < 0)
+                                goto finish;
+                }
+
                 if (!arg_follow) {
                         if (n_shown == 0 && !arg_quiet)
                                 printf("-- No entries --\n");
@@ -2681,6 +3109,8 @@ finish:
         free(arg_verify_key);
 
 #if HAVE_PCRE2
+        trigram_filter_free(arg_trigram_filter);
+
         if (arg_compiled_pattern) {
                 pcre2_code_free(arg_compiled_pattern);
 
@@ -366,6 +366,7 @@ void process_audit_string(Server *s, int type, const char *data, size_t size) {
         }
 
         iov[n_iov++] = IOVEC_MAKE_STRING("_TRANSPORT=audit");
+        s->n_messages_received[SERVER_TRANSPORT_AUDIT]++;
 
         sprintf(source_time_field, "_SOURCE_REALTIME_TIMESTAMP=%" PRIu64,
                 (usec_t) seconds * USEC_PER_SEC + (usec_t) msec * USEC_PER_MSEC);
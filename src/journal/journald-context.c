@@ -12,6 +12,7 @@
 #include "fileio.h"
 #include "fs-util.h"
 #include "io-util.h"
+#include "missing_syscall.h"
 #include "journal-util.h"
 #include "journald-context.h"
 #include "parse-util.h"
@@ -22,6 +23,7 @@
 #include "syslog-util.h"
 #include "unaligned.h"
 #include "user-util.h"
+#include "util.h"
 
 /* This implements a metadata cache for clients, which are identified by their PID. Requesting metadata through /proc
  * is expensive, hence let's cache the data if we can. Note that this means the metadata might be out-of-date when we
@@ -34,6 +36,12 @@
  * refreshed in an incremental way (meaning: data is reread from /proc, but any old data we can't refresh is not
  * flushed out). Data newer than 1s is used immediately without refresh.
  *
+ * Where pidfds are available each cache entry watches the process it is about. When the process exits the entry is
+ * flushed out right away, if it isn't pinned, so that dead clients don't push out live ones. As long as the process
+ * is alive its PID can't be reused, hence such entries are never flushed out for their age. During early boot (i.e. in
+ * the initrd and until the journal is flushed to /var) such entries are also refreshed only every 5s rather than
+ * every 1s: lots of processes log then, and the time spent reading /proc directly delays boot.
+ *
  * Log stream clients (i.e. all clients using the AF_UNIX/SOCK_STREAM stdout/stderr transport) will pin a cache entry
  * as long as their socket is connected. Note that cache entries are shared between different transports. That means a
  * cache entry pinned for the stream connection logic may be reused for the syslog or native protocols.
@@ -56,6 +64,9 @@
 /* We refresh every 1s */
 #define REFRESH_USEC (1*USEC_PER_SEC)
 
+/* … but only every 5s during early boot, for processes we watch */
+#define EARLY_BOOT_REFRESH_USEC (5*USEC_PER_SEC)
+
 /* Data older than 5s we flush out */
 #define MAX_USEC (5*USEC_PER_SEC)
 
@@ -66,9 +77,13 @@
 #define CACHE_MAX_MAX (16*1024U)
 #define CACHE_MAX_MIN 64U
 
-static size_t cache_max(void) {
+static size_t cache_max(Server *s) {
         static size_t cached = -1;
 
+        /* An explicitly configured size wins */
+        if (s->metadata_cache_max > 0)
+                return s->metadata_cache_max;
+
         if (cached == (size_t) -1) {
                 uint64_t mem_total;
                 int r;
@@ -101,6 +116,53 @@ static int client_context_compare(const void *a, const void *b) {
         return CMP(x->pid, y->pid);
 }
 
+static ClientContext* client_context_free(Server *s, ClientContext *c);
+
+static int on_client_exit(sd_event_source *es, int fd, uint32_t revents, void *userdata) {
+        ClientContext *c = userdata;
+
+        assert(c);
+
+        /* The process is gone, and its PID may be reused from now on. Entries that are pinned stay around,
+         * and are subject to the usual age checks from now on. */
+        c->pidfd_event_source = sd_event_source_disable_unref(c->pidfd_event_source);
+        c->pidfd = safe_close(c->pidfd);
+
+        if (c->n_ref == 0)
+                client_context_free(c->server, c);
+
+        return 0;
+}
+
+static void client_context_watch(Server *s, ClientContext *c) {
+        _cleanup_close_ int fd = -1;
+        int r;
+
+        assert(s);
+        assert(c);
+
+        /* Failing here is not fatal, we'll then check the entry for its age and whether the PID is still
+         * around, as for kernels without pidfd support. */
+
+        fd = pidfd_open(c->pid, 0);
+        if (fd < 0) {
+                if (!IN_SET(errno, ENOSYS, ESRCH))
+                        log_debug_errno(errno, "Failed to open pidfd for PID "PID_FMT", ignoring: %m", c->pid);
+                return;
+        }
+
+        r = sd_event_add_io(s->event, &c->pidfd_event_source, fd, EPOLLIN, on_client_exit, c);
+        if (r < 0) {
+                log_debug_errno(r, "Failed to watch PID "PID_FMT", ignoring: %m", c->pid);
+                return;
+        }
+
+        /* Process any messages the client sent before exiting first */
+        (void) sd_event_source_set_priority(c->pidfd_event_source, SD_EVENT_PRIORITY_IDLE);
+
+        c->pidfd = TAKE_FD(fd);
+}
+
 static int client_context_new(Server *s, pid_t pid, ClientContext **ret) {
         ClientContext *c;
         int r;
@@ -121,7 +183,9 @@ static int client_context_new(Server *s, pid_t pid, ClientContext **ret) {
         if (!c)
                 return -ENOMEM;
 
+        c->server = s;
         c->pid = pid;
+        c->pidfd = -1;
 
         c->uid = UID_INVALID;
         c->gid = GID_INVALID;
@@ -141,6 +205,8 @@ static int client_context_new(Server *s, pid_t pid, ClientContext **ret) {
                 return r;
         }
 
+        client_context_watch(s, c);
+
         *ret = c;
         return 0;
 }
@@ -199,6 +265,9 @@ static ClientContext* client_context_free(Server *s, ClientContext *c) {
 
         client_context_reset(s, c);
 
+        sd_event_source_disable_unref(c->pidfd_event_source);
+        safe_close(c->pidfd);
+
         return mfree(c);
 }
 
@@ -520,6 +589,8 @@ static void client_context_really_refresh(
         if (timestamp == USEC_INFINITY)
                 timestamp = now(CLOCK_MONOTONIC);
 
+        s->n_client_context_refreshes++;
+
         client_context_read_uid_gid(c, ucred);
         client_context_read_basic(c);
         (void) client_context_read_label(c, label, label_size);
@@ -542,6 +613,29 @@ static void client_context_really_refresh(
         }
 }
 
+static bool server_in_early_boot(Server *s) {
+        assert(s);
+
+        if (in_initrd())
+                return true;
+
+        /* With persistent storage, early boot ends when we are asked to flush to /var */
+        return IN_SET(s->storage, STORAGE_AUTO, STORAGE_PERSISTENT) && !s->system_journal;
+}
+
+static usec_t client_context_refresh_usec(Server *s, ClientContext *c) {
+        assert(s);
+        assert(c);
+
+        /* If we watch the process we know its PID wasn't reused, only its metadata might have changed,
+         * e.g. because it exec()ed another binary. During early boot we accept that such changes show up
+         * a bit later, in return for not rereading /proc for every running process every second. */
+        if (c->pidfd >= 0 && server_in_early_boot(s))
+                return EARLY_BOOT_REFRESH_USEC;
+
+        return REFRESH_USEC;
+}
+
 void client_context_maybe_refresh(
                 Server *s,
                 ClientContext *c,
@@ -561,14 +655,15 @@ void client_context_maybe_refresh(
                 goto refresh;
 
         /* If the data isn't pinned and if the cashed data is older than the upper limit, we flush it out
-         * entirely. This follows the logic that as long as an entry is pinned the PID reuse is unlikely. */
-        if (c->n_ref == 0 && c->timestamp + MAX_USEC < timestamp) {
+         * entirely. This follows the logic that as long as an entry is pinned the PID reuse is unlikely. If
+         * we watch the process, we know the PID wasn't reused. */
+        if (c->n_ref == 0 && c->pidfd < 0 && c->timestamp + MAX_USEC < timestamp) {
                 client_context_reset(s, c);
                 goto refresh;
         }
 
         /* If the data is older than the lower limit, we refresh, but keep the old data for all we can't update */
-        if (c->timestamp + REFRESH_USEC < timestamp)
+        if (c->timestamp + client_context_refresh_usec(s, c) < timestamp)
                 goto refresh;
 
         /* If the data passed along doesn't match the cached data we also do a refresh */
@@ -607,7 +702,8 @@ static void client_context_try_shrink_to(Server *s, size_t limit) {
 
                         assert(c->n_ref == 0);
 
-                        if (!pid_is_unwaited(c->pid))
+                        /* Entries with a pidfd are flushed out as soon as their process exits */
+                        if (c->pidfd < 0 && !pid_is_unwaited(c->pid))
                                 client_context_free(s, c);
                         else
                                 idx ++;
@@ -634,6 +730,15 @@ static void client_context_try_shrink_to(Server *s, size_t limit) {
         }
 }
 
+void client_context_flush_regular(Server *s) {
+        assert(s);
+
+        /* Flush out all entries that aren't pinned, for example when memory gets tight. They are simply
+         * created again when the client logs next. */
+
+        client_context_try_shrink_to(s, 0);
+}
+
 void client_context_flush_all(Server *s) {
         assert(s);
 
@@ -651,6 +756,14 @@ void client_context_flush_all(Server *s) {
         s->client_contexts = hashmap_free(s->client_contexts);
 }
 
+void client_context_log_statistics(Server *s) {
+        assert(s);
+
+        log_debug("Client metadata cache: %u entries (limit %zu), %" PRIu64 " hits, %" PRIu64 " misses, %" PRIu64 " refreshes from /proc.",
+                  hashmap_size(s->client_contexts), cache_max(s),
+                  s->n_client_context_hits, s->n_client_context_misses, s->n_client_context_refreshes);
+}
+
 static int client_context_get_internal(
                 Server *s,
                 pid_t pid,
@@ -671,6 +784,7 @@ static int client_context_get_internal(
 
         c = hashmap_get(s->client_contexts, PID_TO_PTR(pid));
         if (c) {
+                s->n_client_context_hits++;
 
                 if (add_ref) {
                         if (c->in_lru) {
@@ -689,7 +803,9 @@ static int client_context_get_internal(
                 return 0;
         }
 
-        client_context_try_shrink_to(s, cache_max()-1);
+        s->n_client_context_misses++;
+
+        client_context_try_shrink_to(s, cache_max(s)-1);
 
         r = client_context_new(s, pid, &c);
         if (r < 0)
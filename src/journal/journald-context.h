@@ -5,6 +5,7 @@
 #include <sys/socket.h>
 #include <sys/types.h>
 
+#include "sd-event.h"
 #include "sd-id128.h"
 
 #include "time-util.h"
@@ -14,12 +15,16 @@ typedef struct ClientContext ClientContext;
 #include "journald-server.h"
 
 struct ClientContext {
+        Server *server;
+
         unsigned n_ref;
         unsigned lru_index;
         usec_t timestamp;
         bool in_lru;
 
         pid_t pid;
+        int pidfd;
+        sd_event_source *pidfd_event_source;
         uid_t uid;
         gid_t gid;
 
@@ -84,7 +89,9 @@ void client_context_maybe_refresh(
                 usec_t tstamp);
 
 void client_context_acquire_default(Server *s);
+void client_context_flush_regular(Server *s);
 void client_context_flush_all(Server *s);
+void client_context_log_statistics(Server *s);
 
 static inline size_t client_context_extra_fields_n_iovec(const ClientContext *c) {
         return c ? c->extra_fields_n_iovec : 0;
@@ -23,6 +23,9 @@
 #include "stdio-util.h"
 #include "string-util.h"
 
+/* How many kernel log records to read before returning to the event loop */
+#define DEV_KMSG_BUDGET 64U
+
 void server_forward_kmsg(
         Server *s,
         int priority,
@@ -141,12 +144,15 @@ void dev_kmsg_record(Server *s, char *p, size_t l) {
                         return;
 
                 /* Did we lose any? */
-                if (serial > *s->kernel_seqnum)
+                if (serial > *s->kernel_seqnum) {
+                        s->n_dev_kmsg_lost += serial - *s->kernel_seqnum;
+
                         server_driver_message(s, 0,
                                               "MESSAGE_ID=" SD_MESSAGE_JOURNAL_MISSED_STR,
                                               LOG_MESSAGE("Missed %"PRIu64" kernel messages",
                                                           serial - *s->kernel_seqnum),
                                               NULL);
+                }
 
                 /* Make sure we never read this one again. Note that
                  * we always store the next message serial we expect
@@ -253,6 +259,7 @@ void dev_kmsg_record(Server *s, char *p, size_t l) {
                 iovec[n++] = IOVEC_MAKE_STRING(source_time);
 
         iovec[n++] = IOVEC_MAKE_STRING("_TRANSPORT=kernel");
+        s->n_messages_received[SERVER_TRANSPORT_KERNEL]++;
 
         if (asprintf(&syslog_priority, "PRIORITY=%i", priority & LOG_PRIMASK) >= 0)
                 iovec[n++] = IOVEC_MAKE_STRING(syslog_priority);
@@ -312,12 +319,20 @@ static int server_read_dev_kmsg(Server *s) {
                         return 0;
                 }
 
-                if (IN_SET(errno, EAGAIN, EINTR, EPIPE))
+                /* The kernel overwrote the record we were about to read. The next read() continues with the
+                 * oldest record still available, and the gap is accounted for in dev_kmsg_record(). */
+                if (errno == EPIPE) {
+                        s->n_dev_kmsg_overruns++;
+                        return 1;
+                }
+
+                if (IN_SET(errno, EAGAIN, EINTR))
                         return 0;
 
                 return log_error_errno(errno, "Failed to read from kernel: %m");
         }
 
+        s->n_dev_kmsg_records++;
         dev_kmsg_record(s, buffer, l);
         return 1;
 }
@@ -347,8 +362,20 @@ int server_flush_dev_kmsg(Server *s) {
         return 0;
 }
 
+void server_dev_kmsg_log_statistics(Server *s) {
+        assert(s);
+
+        if (s->dev_kmsg_fd < 0 || !s->dev_kmsg_readable)
+                return;
+
+        log_debug("Kernel log: %" PRIu64 " records read, %" PRIu64 " records lost in %" PRIu64 " buffer overruns.",
+                  s->n_dev_kmsg_records, s->n_dev_kmsg_lost, s->n_dev_kmsg_overruns);
+}
+
 static int dispatch_dev_kmsg(sd_event_source *es, int fd, uint32_t revents, void *userdata) {
         Server *s = userdata;
+        unsigned n;
+        int r;
 
         assert(es);
         assert(fd == s->dev_kmsg_fd);
@@ -360,7 +387,16 @@ static int dispatch_dev_kmsg(sd_event_source *es, int fd, uint32_t revents, void
         if (!(revents & EPOLLIN))
                 log_error("Got invalid event from epoll for /dev/kmsg: %"PRIx32, revents);
 
-        return server_read_dev_kmsg(s);
+        /* /dev/kmsg returns one record per read(). During kernel log floods going back to the event loop
+         * after each of them makes us fall behind until the kernel overwrites records we haven't read yet,
+         * hence read a bunch of them in one go. */
+        for (n = 0; n < DEV_KMSG_BUDGET; n++) {
+                r = server_read_dev_kmsg(s);
+                if (r <= 0)
+                        return r;
+        }
+
+        return 0;
 }
 
 int server_open_dev_kmsg(Server *s) {
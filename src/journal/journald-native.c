@@ -248,6 +248,7 @@ static int server_process_entry(
         tn = n++;
         iovec[tn] = IOVEC_MAKE_STRING("_TRANSPORT=journal");
         entry_size += STRLEN("_TRANSPORT=journal");
+        s->n_messages_received[SERVER_TRANSPORT_JOURNAL]++;
 
         if (entry_size + n + 1 > ENTRY_SIZE_MAX) { /* data + separators + trailer */
                 log_debug("Entry is too big with %zu properties and %zu bytes, ignoring.", n, entry_size);
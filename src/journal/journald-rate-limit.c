@@ -6,13 +6,11 @@
 #include "hashmap.h"
 #include "journald-rate-limit.h"
 #include "list.h"
-#include "random-util.h"
 #include "string-util.h"
 #include "time-util.h"
 
 #define POOLS_MAX 5
-#define BUCKETS_MAX 127
-#define GROUPS_MAX 2047
+#define GROUPS_MAX 8191
 
 static const int priority_map[] = {
         [LOG_EMERG]   = 0,
@@ -37,26 +35,25 @@ struct JournalRateLimitPool {
 struct JournalRateLimitGroup {
         JournalRateLimit *parent;
 
-        char *id;
-
         /* Interval is stored to keep track of when the group expires */
         usec_t interval;
 
         JournalRateLimitPool pools[POOLS_MAX];
-        uint64_t hash;
 
-        LIST_FIELDS(JournalRateLimitGroup, bucket);
+        /* All messages suppressed since the group was created, for statistics */
+        uint64_t n_suppressed;
+
         LIST_FIELDS(JournalRateLimitGroup, lru);
+
+        char id[];
 };
 
 struct JournalRateLimit {
-
-        JournalRateLimitGroup* buckets[BUCKETS_MAX];
+        /* Groups by id, and ordered by last use, most recently used first */
+        Hashmap *groups;
         JournalRateLimitGroup *lru, *lru_tail;
 
         unsigned n_groups;
-
-        uint8_t hash_key[16];
 };
 
 JournalRateLimit *journal_ratelimit_new(void) {
@@ -66,7 +63,9 @@ JournalRateLimit *journal_ratelimit_new(void) {
         if (!r)
                 return NULL;
 
-        random_bytes(r->hash_key, sizeof(r->hash_key));
+        r->groups = hashmap_new(&string_hash_ops);
+        if (!r->groups)
+                return mfree(r);
 
         return r;
 }
@@ -81,12 +80,11 @@ static void journal_ratelimit_group_free(JournalRateLimitGroup *g) {
                         g->parent->lru_tail = g->lru_prev;
 
                 LIST_REMOVE(lru, g->parent->lru, g);
-                LIST_REMOVE(bucket, g->parent->buckets[g->hash % BUCKETS_MAX], g);
+                hashmap_remove(g->parent->groups, g->id);
 
                 g->parent->n_groups--;
         }
 
-        free(g->id);
         free(g);
 }
 
@@ -96,6 +94,7 @@ void journal_ratelimit_free(JournalRateLimit *r) {
         while (r->lru)
                 journal_ratelimit_group_free(r->lru);
 
+        hashmap_free(r->groups);
         free(r);
 }
 
@@ -115,7 +114,8 @@ static void journal_ratelimit_vacuum(JournalRateLimit *r, usec_t ts) {
         assert(r);
 
         /* Makes room for at least one new item, but drop all
-         * expored items too. */
+         * expired items too. Since groups are moved to the front
+         * whenever they are used, only the tail needs to be looked at. */
 
         while (r->n_groups >= GROUPS_MAX ||
                (r->lru_tail && journal_ratelimit_group_expired(r->lru_tail, ts)))
@@ -124,25 +124,27 @@ static void journal_ratelimit_vacuum(JournalRateLimit *r, usec_t ts) {
 
 static JournalRateLimitGroup* journal_ratelimit_group_new(JournalRateLimit *r, const char *id, usec_t interval, usec_t ts) {
         JournalRateLimitGroup *g;
+        size_t l;
 
         assert(r);
         assert(id);
 
-        g = new0(JournalRateLimitGroup, 1);
+        l = strlen(id);
+
+        g = malloc0(offsetof(JournalRateLimitGroup, id) + l + 1);
         if (!g)
                 return NULL;
 
-        g->id = strdup(id);
-        if (!g->id)
-                goto fail;
-
-        g->hash = siphash24_string(g->id, r->hash_key);
-
+        memcpy(g->id, id, l + 1);
         g->interval = interval;
 
         journal_ratelimit_vacuum(r, ts);
 
-        LIST_PREPEND(bucket, r->buckets[g->hash % BUCKETS_MAX], g);
+        if (hashmap_put(r->groups, g->id, g) < 0) {
+                free(g);
+                return NULL;
+        }
+
         LIST_PREPEND(lru, r->lru, g);
         if (!g->lru_next)
                 r->lru_tail = g;
@@ -150,10 +152,23 @@ static JournalRateLimitGroup* journal_ratelimit_group_new(JournalRateLimit *r, c
 
         g->parent = r;
         return g;
+}
+
+static void journal_ratelimit_group_touch(JournalRateLimitGroup *g) {
+        JournalRateLimit *r;
+
+        assert(g);
+        assert(g->parent);
+
+        r = g->parent;
+        if (r->lru == g)
+                return;
+
+        if (r->lru_tail == g)
+                r->lru_tail = g->lru_prev;
 
-fail:
-        journal_ratelimit_group_free(g);
-        return NULL;
+        LIST_REMOVE(lru, r->lru, g);
+        LIST_PREPEND(lru, r->lru, g);
 }
 
 static unsigned burst_modulate(unsigned burst, uint64_t available) {
@@ -185,7 +200,6 @@ static unsigned burst_modulate(unsigned burst, uint64_t available) {
 }
 
 int journal_ratelimit_test(JournalRateLimit *r, const char *id, usec_t rl_interval, unsigned rl_burst, int priority, uint64_t available) {
-        uint64_t h;
         JournalRateLimitGroup *g;
         JournalRateLimitPool *p;
         unsigned burst;
@@ -205,19 +219,15 @@ int journal_ratelimit_test(JournalRateLimit *r, const char *id, usec_t rl_interv
 
         ts = now(CLOCK_MONOTONIC);
 
-        h = siphash24_string(id, r->hash_key);
-        g = r->buckets[h % BUCKETS_MAX];
-
-        LIST_FOREACH(bucket, g, g)
-                if (streq(g->id, id))
-                        break;
-
+        g = hashmap_get(r->groups, id);
         if (!g) {
                 g = journal_ratelimit_group_new(r, id, rl_interval, ts);
                 if (!g)
                         return -ENOMEM;
-        } else
+        } else {
                 g->interval = rl_interval;
+                journal_ratelimit_group_touch(g);
+        }
 
         if (rl_interval == 0 || rl_burst == 0)
                 return 1;
@@ -250,5 +260,47 @@ int journal_ratelimit_test(JournalRateLimit *r, const char *id, usec_t rl_interv
         }
 
         p->suppressed++;
+        g->n_suppressed++;
         return 0;
 }
+
+int journal_ratelimit_build_json(JournalRateLimit *r, JsonVariant **ret) {
+        JsonVariant **array = NULL;
+        JournalRateLimitGroup *g;
+        size_t n = 0;
+        int k;
+
+        assert(ret);
+
+        /* Returns an object mapping the ids of all groups that had messages suppressed to their number. The
+         * members are collected first and turned into an object in one go, as there might be thousands. */
+
+        if (r && r->n_groups > 0) {
+                array = new(JsonVariant*, r->n_groups * 2);
+                if (!array)
+                        return -ENOMEM;
+
+                LIST_FOREACH(lru, g, r->lru) {
+                        if (g->n_suppressed == 0)
+                                continue;
+
+                        k = json_variant_new_string(array + n, g->id);
+                        if (k < 0)
+                                goto finish;
+                        n++;
+
+                        k = json_variant_new_unsigned(array + n, g->n_suppressed);
+                        if (k < 0)
+                                goto finish;
+                        n++;
+                }
+        }
+
+        k = json_variant_new_object(ret, array, n);
+
+finish:
+        json_variant_unref_many(array, n);
+        free(array);
+
+        return k;
+}
@@ -0,0 +1,329 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "alloc-util.h"
+#include "format-util.h"
+#include "fd-util.h"
+#include "io-util.h"
+#include "journal-ring.h"
+#include "journald-native.h"
+#include "journald-ring.h"
+#include "journald-server.h"
+#include "list.h"
+
+#define RINGS_MAX 64U
+
+/* Process this many messages before giving other event sources a chance */
+#define RING_MESSAGES_PER_DISPATCH 1024U
+
+struct JournalRing {
+        Server *server;
+
+        int doorbell_fd;
+        sd_event_source *doorbell_event_source;
+        sd_event_source *drain_event_source;
+
+        JournalRingHeader *header;
+        const uint8_t *data;
+        size_t map_size;
+        uint64_t data_size;
+        uint64_t tail;
+
+        struct ucred ucred;
+        char *label;
+        size_t label_len;
+
+        LIST_FIELDS(JournalRing, rings);
+};
+
+void journal_ring_free(JournalRing *r) {
+        if (!r)
+                return;
+
+        if (r->server) {
+                assert(r->server->n_rings > 0);
+                r->server->n_rings--;
+                LIST_REMOVE(rings, r->server->rings, r);
+        }
+
+        sd_event_source_unref(r->doorbell_event_source);
+        sd_event_source_unref(r->drain_event_source);
+        safe_close(r->doorbell_fd);
+
+        if (r->header)
+                (void) munmap(r->header, r->map_size);
+
+        free(r->label);
+        free(r);
+}
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(JournalRing*, journal_ring_free);
+
+static int journal_ring_drain(JournalRing *r, unsigned budget) {
+        Server *s;
+
+        assert(r);
+
+        s = r->server;
+
+        /* Returns > 0 if the budget is exhausted and more messages might be pending, 0 if the ring is empty
+         * and the client was told to ring the doorbell for the next message. */
+
+        for (;;) {
+                uint64_t head, available, pos, size;
+                uint32_t len;
+
+                head = __atomic_load_n(&r->header->head, __ATOMIC_ACQUIRE);
+                if (head == r->tail) {
+                        __atomic_store_n(&r->header->waiting, 1, __ATOMIC_RELAXED);
+                        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+                        head = __atomic_load_n(&r->header->head, __ATOMIC_ACQUIRE);
+                        if (head == r->tail)
+                                return 0;
+
+                        __atomic_store_n(&r->header->waiting, 0, __ATOMIC_RELAXED);
+                }
+
+                if (budget == 0)
+                        return 1;
+
+                available = head - r->tail;
+                if (available > r->data_size)
+                        return log_warning_errno(SYNTHETIC_ERRNO(EBADMSG),
+                                                 "Ring of PID "PID_FMT" claims more data than it holds, dropping it.",
+                                                 r->ucred.pid);
+
+                pos = r->tail & (r->data_size - 1);
+                len = __atomic_load_n((const uint32_t*) (r->data + pos), __ATOMIC_RELAXED);
+
+                if (len == JOURNAL_RING_WRAP)
+                        size = r->data_size - pos;
+                else {
+                        size = journal_ring_record_size(len);
+                        if (pos + size > r->data_size)
+                                return log_warning_errno(SYNTHETIC_ERRNO(EBADMSG),
+                                                         "Ring of PID "PID_FMT" contains a record crossing its end, dropping it.",
+                                                         r->ucred.pid);
+                }
+
+                if (size > available)
+                        return log_warning_errno(SYNTHETIC_ERRNO(EBADMSG),
+                                                 "Ring of PID "PID_FMT" contains a truncated record, dropping it.",
+                                                 r->ucred.pid);
+
+                if (len != JOURNAL_RING_WRAP) {
+                        /* The client may modify the shared memory any time, hence copy the message out
+                         * before looking at it. */
+                        if (!GREEDY_REALLOC(s->buffer, s->buffer_size, (size_t) len + 1))
+                                return log_oom();
+
+                        memcpy(s->buffer, r->data + pos + sizeof(uint32_t), len);
+                        s->buffer[len] = 0;
+                }
+
+                r->tail += size;
+                __atomic_store_n(&r->header->tail, r->tail, __ATOMIC_RELEASE);
+
+                if (len != JOURNAL_RING_WRAP) {
+                        server_process_native_message(s, s->buffer, len, &r->ucred, NULL, r->label, r->label_len);
+                        budget--;
+                }
+        }
+}
+
+static int journal_ring_dispatch(JournalRing *r, unsigned budget) {
+        int k;
+
+        assert(r);
+
+        k = journal_ring_drain(r, budget);
+        if (k < 0) {
+                journal_ring_free(r);
+                return 0;
+        }
+
+        if (k > 0) {
+                k = sd_event_source_set_enabled(r->drain_event_source, SD_EVENT_ONESHOT);
+                if (k < 0) {
+                        log_error_errno(k, "Failed to schedule draining of ring of PID "PID_FMT", dropping it: %m",
+                                        r->ucred.pid);
+                        journal_ring_free(r);
+                }
+        }
+
+        return 0;
+}
+
+static int dispatch_drain(sd_event_source *es, void *userdata) {
+        JournalRing *r = userdata;
+
+        assert(r);
+
+        return journal_ring_dispatch(r, RING_MESSAGES_PER_DISPATCH);
+}
+
+static int dispatch_doorbell(sd_event_source *es, int fd, uint32_t revents, void *userdata) {
+        JournalRing *r = userdata;
+
+        assert(r);
+
+        (void) flush_fd(fd);
+
+        if (revents & (EPOLLHUP|EPOLLERR)) {
+                /* The client is gone, pick up what it left behind and forget about the ring */
+                (void) journal_ring_drain(r, UINT_MAX);
+                journal_ring_free(r);
+                return 0;
+        }
+
+        __atomic_store_n(&r->header->waiting, 0, __ATOMIC_RELAXED);
+
+        return journal_ring_dispatch(r, RING_MESSAGES_PER_DISPATCH);
+}
+
+static int journal_ring_map(JournalRing *r, int fd) {
+        JournalRingHeader *h;
+        struct stat st;
+        void *p;
+        int seals;
+
+        assert(r);
+        assert(fd >= 0);
+
+        /* The client must not be able to shrink the file under us, or we'd get SIGBUS */
+        seals = fcntl(fd, F_GET_SEALS);
+        if (seals < 0)
+                return log_warning_errno(errno, "Failed to get seals of ring memfd: %m");
+        if ((seals & (F_SEAL_SHRINK|F_SEAL_SEAL)) != (F_SEAL_SHRINK|F_SEAL_SEAL))
+                return log_warning_errno(SYNTHETIC_ERRNO(EPERM), "Ring memfd is not sealed against shrinking, refusing.");
+
+        if (fstat(fd, &st) < 0)
+                return log_warning_errno(errno, "Failed to stat ring memfd: %m");
+
+        if (!S_ISREG(st.st_mode) ||
+            st.st_size < JOURNAL_RING_HEADER_SIZE + JOURNAL_RING_DATA_SIZE_MIN ||
+            st.st_size > JOURNAL_RING_HEADER_SIZE + JOURNAL_RING_DATA_SIZE_MAX)
+                return log_warning_errno(SYNTHETIC_ERRNO(EBADMSG), "Ring memfd has invalid size, refusing.");
+
+        p = mmap(NULL, st.st_size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED)
+                return log_warning_errno(errno, "Failed to map ring memfd: %m");
+
+        r->header = h = p;
+        r->map_size = st.st_size;
+
+        if (memcmp(h->signature, JOURNAL_RING_SIGNATURE, sizeof(h->signature)) != 0 ||
+            h->header_size != JOURNAL_RING_HEADER_SIZE ||
+            h->data_size == 0 || (h->data_size & (h->data_size - 1)) != 0 ||
+            (uint64_t) st.st_size != (uint64_t) JOURNAL_RING_HEADER_SIZE + h->data_size)
+                return log_warning_errno(SYNTHETIC_ERRNO(EBADMSG), "Ring memfd has invalid header, refusing.");
+
+        r->data = (const uint8_t*) p + JOURNAL_RING_HEADER_SIZE;
+        r->data_size = h->data_size;
+        r->tail = __atomic_load_n(&h->tail, __ATOMIC_ACQUIRE);
+
+        return 0;
+}
+
+void server_add_native_ring(
+                Server *s,
+                int fds[static 2],
+                const struct ucred *ucred,
+                const char *label,
+                size_t label_len) {
+
+        _cleanup_(journal_ring_freep) JournalRing *r = NULL;
+        _cleanup_close_ int memfd = -1;
+        int k;
+
+        assert(s);
+        assert(fds);
+
+        memfd = TAKE_FD(fds[0]);
+
+        if (!ucred) {
+                log_warning("Ring submitted without credentials, refusing.");
+                return;
+        }
+
+        if (s->n_rings >= RINGS_MAX) {
+                log_warning("Too many rings, refusing ring of PID "PID_FMT".", ucred->pid);
+                return;
+        }
+
+        r = new(JournalRing, 1);
+        if (!r) {
+                log_oom();
+                return;
+        }
+
+        *r = (JournalRing) {
+                .doorbell_fd = TAKE_FD(fds[1]),
+                .ucred = *ucred,
+        };
+
+        if (label) {
+                r->label = memdup_suffix0(label, label_len);
+                if (!r->label) {
+                        log_oom();
+                        return;
+                }
+
+                r->label_len = label_len;
+        }
+
+        if (journal_ring_map(r, memfd) < 0)
+                return;
+
+        k = fd_nonblock(r->doorbell_fd, true);
+        if (k < 0) {
+                log_warning_errno(k, "Failed to make ring doorbell non-blocking: %m");
+                return;
+        }
+
+        k = sd_event_add_io(s->event, &r->doorbell_event_source, r->doorbell_fd, EPOLLIN, dispatch_doorbell, r);
+        if (k < 0) {
+                log_error_errno(k, "Failed to add ring doorbell to event loop: %m");
+                return;
+        }
+
+        k = sd_event_source_set_priority(r->doorbell_event_source, SD_EVENT_PRIORITY_NORMAL+5);
+        if (k < 0) {
+                log_error_errno(k, "Failed to adjust ring doorbell event source priority: %m");
+                return;
+        }
+
+        k = sd_event_add_defer(s->event, &r->drain_event_source, dispatch_drain, r);
+        if (k < 0) {
+                log_error_errno(k, "Failed to add ring drain event source: %m");
+                return;
+        }
+
+        k = sd_event_source_set_enabled(r->drain_event_source, SD_EVENT_OFF);
+        if (k < 0) {
+                log_error_errno(k, "Failed to disable ring drain event source: %m");
+                return;
+        }
+
+        k = sd_event_source_set_priority(r->drain_event_source, SD_EVENT_PRIORITY_NORMAL+5);
+        if (k < 0) {
+                log_error_errno(k, "Failed to adjust ring drain event source priority: %m");
+                return;
+        }
+
+        r->server = s;
+        LIST_PREPEND(rings, s->rings, r);
+        s->n_rings++;
+
+        /* From now on the client may put messages into the ring */
+        __atomic_store_n(&r->header->ready, 1, __ATOMIC_RELEASE);
+
+        log_debug("Added ring of %"PRIu64" bytes for PID "PID_FMT".", r->data_size, r->ucred.pid);
+
+        TAKE_PTR(r);
+}
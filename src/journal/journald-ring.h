@@ -0,0 +1,18 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+#pragma once
+
+#include <sys/socket.h>
+
+typedef struct JournalRing JournalRing;
+
+#include "journald-server.h"
+
+/* Takes ownership of fds[0] (the memfd) and fds[1] (the doorbell), and sets them to -1 */
+void server_add_native_ring(
+                Server *s,
+                int fds[static 2],
+                const struct ucred *ucred,
+                const char *label,
+                size_t label_len);
+
+void journal_ring_free(JournalRing *r);
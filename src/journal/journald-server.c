@@ -31,12 +31,15 @@
 #include "journal-authenticate.h"
 #include "journal-file.h"
 #include "journal-internal.h"
+#include "journal-manifest.h"
+#include "journal-ring.h"
 #include "journal-vacuum.h"
 #include "journald-audit.h"
 #include "journald-context.h"
 #include "journald-kmsg.h"
 #include "journald-native.h"
 #include "journald-rate-limit.h"
+#include "journald-ring.h"
 #include "journald-server.h"
 #include "journald-stream.h"
 #include "journald-syslog.h"
@@ -76,6 +79,14 @@
 
 #define DEFERRED_CLOSES_MAX (4096)
 
+/* Appending an entry normally takes a few µs. If it takes longer than this we stalled on the disk (page faults on
+ * the memory map, or waiting for the offline thread), and ingestion was blocked meanwhile. */
+#define SLOW_WRITE_USEC (100*USEC_PER_MSEC)
+#define WARN_SLOW_WRITES_USEC (30*USEC_PER_SEC)
+
+/* How many datagrams to read from a socket per event loop wakeup at most */
+#define SERVER_DATAGRAM_BATCH_MAX 64U
+
 static int determine_path_usage(Server *s, const char *path, uint64_t *ret_used, uint64_t *ret_free) {
         _cleanup_closedir_ DIR *d = NULL;
         struct dirent *de;
@@ -639,11 +650,21 @@ void server_rotate(Server *s) {
         server_process_deferred_closes(s);
 }
 
+static void latency_histogram_add(uint64_t histogram[static SERVER_LATENCY_BUCKETS], usec_t t) {
+        unsigned k;
+
+        k = t > 0 ? MIN(u64log2(t) + 1, SERVER_LATENCY_BUCKETS - 1U) : 0;
+        histogram[k]++;
+}
+
 void server_sync(Server *s) {
         JournalFile *f;
         Iterator i;
+        usec_t start;
         int r;
 
+        start = now(CLOCK_MONOTONIC);
+
         if (s->system_journal) {
                 r = journal_file_set_offline(s->system_journal, false);
                 if (r < 0)
@@ -656,6 +677,9 @@ void server_sync(Server *s) {
                         log_warning_errno(r, "Failed to sync user journal, ignoring: %m");
         }
 
+        s->n_syncs++;
+        latency_histogram_add(s->sync_latency, usec_sub_unsigned(now(CLOCK_MONOTONIC), start));
+
         if (s->sync_event_source) {
                 r = sd_event_source_set_enabled(s->sync_event_source, SD_EVENT_OFF);
                 if (r < 0)
@@ -679,10 +703,15 @@ static void do_vacuum(Server *s, JournalStorage *storage, bool verbose) {
 
         r = journal_directory_vacuum(storage->path, storage->space.limit,
                                      storage->metrics.n_max_files, s->max_retention_usec,
-                                     &s->oldest_file_usec, verbose);
+                                     &s->oldest_file_usec, &storage->vacuum_cache, verbose);
         if (r < 0 && r != -ENOENT)
                 log_warning_errno(r, "Failed to vacuum %s, ignoring: %m", storage->path);
 
+        /* Vacuuming runs after every rotation, which is when the set of archived files changes */
+        r = journal_manifest_update(storage->path, &storage->manifest_cache);
+        if (r < 0 && r != -ENOENT)
+                log_warning_errno(r, "Failed to update journal manifest of %s, ignoring: %m", storage->path);
+
         cache_space_invalidate(&storage->space);
 }
 
@@ -794,6 +823,58 @@ static bool shall_try_append_again(JournalFile *f, int r) {
         }
 }
 
+static int server_append_entry(Server *s, JournalFile *f, const dual_timestamp *ts, struct iovec *iovec, size_t n) {
+        usec_t start, delta;
+        int r;
+
+        assert(s);
+        assert(f);
+
+        start = now(CLOCK_MONOTONIC);
+        r = journal_file_append_entry(f, ts, NULL, iovec, n, &s->seqnum, NULL, NULL);
+        delta = usec_sub_unsigned(now(CLOCK_MONOTONIC), start);
+
+        if (delta >= SLOW_WRITE_USEC) {
+                s->n_slow_writes++;
+                s->slow_write_max_usec = MAX(s->slow_write_max_usec, delta);
+        }
+
+        if (r >= 0) {
+                s->n_entries_written++;
+                s->n_bytes_written += IOVEC_TOTAL_SIZE(iovec, n);
+        }
+
+        return r;
+}
+
+void server_maybe_warn_slow_writes(Server *s) {
+        char buf[FORMAT_TIMESPAN_MAX];
+        unsigned n_slow;
+        usec_t n, max_usec;
+
+        assert(s);
+
+        if (s->n_slow_writes <= 0)
+                return;
+
+        n = now(CLOCK_MONOTONIC);
+        if (s->last_warn_slow_writes + WARN_SLOW_WRITES_USEC > n)
+                return;
+
+        /* Reset first, as writing the message below might be slow again */
+        n_slow = s->n_slow_writes;
+        max_usec = s->slow_write_max_usec;
+        s->n_slow_writes = 0;
+        s->slow_write_max_usec = 0;
+        s->last_warn_slow_writes = n;
+
+        server_driver_message(s, 0, NULL,
+                              LOG_MESSAGE("Writing to the journal was slow %u times, blocking message reception for up to %s.",
+                                          n_slow, format_timespan(buf, sizeof(buf), max_usec, USEC_PER_MSEC)),
+                              "N_SLOW_WRITES=%u", n_slow,
+                              NULL);
+}
+
 static void write_to_journal(Server *s, uid_t uid, struct iovec *iovec, size_t n, int priority) {
         bool vacuumed = false, rotate = false;
         struct dual_timestamp ts;
@@ -842,7 +923,7 @@ static void write_to_journal(Server *s, uid_t uid, struct iovec *iovec, size_t n
 
         s->last_realtime_clock = ts.realtime;
 
-        r = journal_file_append_entry(f, &ts, NULL, iovec, n, &s->seqnum, NULL, NULL);
+        r = server_append_entry(s, f, &ts, iovec, n);
         if (r >= 0) {
                 server_schedule_sync(s, priority);
                 return;
@@ -861,7 +942,7 @@ static void write_to_journal(Server *s, uid_t uid, struct iovec *iovec, size_t n
                 return;
 
         log_debug("Retrying write.");
-        r = journal_file_append_entry(f, &ts, NULL, iovec, n, &s->seqnum, NULL, NULL);
+        r = server_append_entry(s, f, &ts, iovec, n);
         if (r < 0)
                 log_error_errno(r, "Failed to write entry (%zu items, %zu bytes) despite vacuuming, ignoring: %m", n, IOVEC_TOTAL_SIZE(iovec, n));
         else
@@ -1039,6 +1120,7 @@ void server_driver_message(Server *s, pid_t object_pid, const char *message_id,
         iovec[n++] = IOVEC_MAKE_STRING("SYSLOG_IDENTIFIER=systemd-journald");
 
         iovec[n++] = IOVEC_MAKE_STRING("_TRANSPORT=driver");
+        s->n_messages_received[SERVER_TRANSPORT_DRIVER]++;
         assert_cc(6 == LOG_INFO);
         iovec[n++] = IOVEC_MAKE_STRING("PRIORITY=6");
 
@@ -1099,8 +1181,10 @@ void server_dispatch_message(
                 (void) determine_space(s, &available, NULL);
 
                 rl = journal_ratelimit_test(s->ratelimit, c->unit, c->log_ratelimit_interval, c->log_ratelimit_burst, priority & LOG_PRIMASK, available);
-                if (rl == 0)
+                if (rl == 0) {
+                        s->n_messages_suppressed++;
                         return;
+                }
 
                 /* Write a suppression message if we suppressed something */
                 if (rl > 1)
@@ -1115,6 +1199,7 @@ void server_dispatch_message(
 }
 
 int server_flush_to_var(Server *s, bool require_flag_file) {
+        _cleanup_(journal_file_copy_cache_freep) JournalFileCopyCache *cache = NULL;
         sd_journal *j = NULL;
         char ts[FORMAT_TIMESPAN_MAX];
         usec_t start;
@@ -1162,7 +1247,7 @@ int server_flush_to_var(Server *s, bool require_flag_file) {
                         goto finish;
                 }
 
-                r = journal_file_copy_entry(f, s->system_journal, o, f->current_offset);
+                r = journal_file_copy_entry(f, s->system_journal, o, f->current_offset, &cache);
                 if (r >= 0)
                         continue;
 
@@ -1181,7 +1266,7 @@ int server_flush_to_var(Server *s, bool require_flag_file) {
                 }
 
                 log_debug("Retrying write.");
-                r = journal_file_copy_entry(f, s->system_journal, o, f->current_offset);
+                r = journal_file_copy_entry(f, s->system_journal, o, f->current_offset, &cache);
                 if (r < 0) {
                         log_error_errno(r, "Can't write entry: %m");
                         goto finish;
@@ -1237,8 +1322,7 @@ static int server_relinquish_var(Server *s) {
         return 0;
 }
 
-int server_process_datagram(sd_event_source *es, int fd, uint32_t revents, void *userdata) {
-        Server *s = userdata;
+static int server_process_one_datagram(Server *s, int fd) {
         struct ucred *ucred = NULL;
         struct timeval *tv = NULL;
         struct cmsghdr *cmsg;
@@ -1261,7 +1345,7 @@ int server_process_datagram(sd_event_source *es, int fd, uint32_t revents, void
                  * one day when the final limit is known. */
                 uint8_t buf[CMSG_SPACE(sizeof(struct ucred)) +
                             CMSG_SPACE(sizeof(struct timeval)) +
-                            CMSG_SPACE(sizeof(int)) + /* fd */
+                            CMSG_SPACE(sizeof(int) * 2) + /* fds */
                             CMSG_SPACE(NAME_MAX)]; /* selinux label */
         } control = {};
 
@@ -1279,11 +1363,6 @@ int server_process_datagram(sd_event_source *es, int fd, uint32_t revents, void
         assert(s);
         assert(fd == s->native_fd || fd == s->syslog_fd || fd == s->audit_fd);
 
-        if (revents != EPOLLIN)
-                return log_error_errno(SYNTHETIC_ERRNO(EIO),
-                                       "Got invalid event from epoll for datagram fd: %" PRIx32,
-                                       revents);
-
         /* Try to get the right size, if we can. (Not all sockets support SIOCINQ, hence we just try, but don't rely on
          * it.) */
         (void) ioctl(fd, SIOCINQ, &v);
@@ -1339,6 +1418,9 @@ int server_process_datagram(sd_event_source *es, int fd, uint32_t revents, void
                         server_process_native_message(s, s->buffer, n, ucred, tv, label, label_len);
                 else if (n == 0 && n_fds == 1)
                         server_process_native_file(s, fds[0], ucred, tv, label, label_len);
+                else if (n == STRLEN(JOURNAL_RING_SIGNATURE) && n_fds == 2 &&
+                         memcmp(s->buffer, JOURNAL_RING_SIGNATURE, n) == 0)
+                        server_add_native_ring(s, fds, ucred, label, label_len);
                 else if (n_fds > 0)
                         log_warning("Got too many file descriptors via native socket. Ignoring.");
 
@@ -1352,6 +1434,32 @@ int server_process_datagram(sd_event_source *es, int fd, uint32_t revents, void
         }
 
         close_many(fds, n_fds);
+        return 1;
+}
+
+int server_process_datagram(sd_event_source *es, int fd, uint32_t revents, void *userdata) {
+        Server *s = userdata;
+        unsigned i;
+        int r;
+
+        assert(s);
+
+        if (revents != EPOLLIN)
+                return log_error_errno(SYNTHETIC_ERRNO(EIO),
+                                       "Got invalid event from epoll for datagram fd: %" PRIx32,
+                                       revents);
+
+        /* Drain a number of queued datagrams per wakeup, so that under load we don't pay an epoll round trip
+         * for each of them. The number is bounded so that the other event sources of the same priority get
+         * their turn, too. We stick to plain recvmsg() here rather than recvmmsg(), since the latter needs a
+         * fixed buffer size per datagram and would silently truncate large native messages, while the
+         * SIOCINQ logic in server_process_one_datagram() sizes the buffer for each datagram individually. */
+        for (i = 0; i < SERVER_DATAGRAM_BATCH_MAX; i++) {
+                r = server_process_one_datagram(s, fd);
+                if (r <= 0)
+                        return r;
+        }
+
         return 0;
 }
 
@@ -1424,6 +1532,9 @@ static void server_full_sync(Server *s) {
 
         server_sync(s);
 
+        client_context_log_statistics(s);
+        server_dev_kmsg_log_statistics(s);
+
         /* Let clients know when the most recent sync happened. */
         r = write_timestamp_file_atomic("/run/systemd/journal/synced", now(CLOCK_MONOTONIC));
         if (r < 0)
@@ -1699,6 +1810,38 @@ static int server_open_hostname(Server *s) {
         return 0;
 }
 
+static int dispatch_memory_pressure(sd_event_source *es, void *userdata) {
+        Server *s = userdata;
+        size_t n;
+        unsigned w;
+
+        assert(s);
+
+        /* Everything we drop here is recreated on demand, so we'll merely run a bit slower for a while */
+        n = hashmap_size(s->client_contexts);
+        client_context_flush_regular(s);
+        n -= hashmap_size(s->client_contexts);
+
+        w = mmap_cache_trim(s->mmap);
+
+        log_debug("Memory pressure reported, released %zu client contexts and %u mmap windows.", n, w);
+
+        sd_event_trim_memory();
+        return 0;
+}
+
+static int server_watch_memory_pressure(Server *s) {
+        int r;
+
+        assert(s);
+
+        r = sd_event_add_memory_pressure(s->event, &s->memory_pressure_event_source, dispatch_memory_pressure, s);
+        if (r < 0)
+                return log_debug_errno(r, "Failed to watch memory pressure, ignoring: %m");
+
+        return 0;
+}
+
 static int dispatch_notify_event(sd_event_source *es, int fd, uint32_t revents, void *userdata) {
         Server *s = userdata;
         int r;
@@ -1958,6 +2101,97 @@ static int vl_method_relinquish_var(Varlink *link, JsonVariant *parameters, Varl
         return varlink_reply(link, NULL);
 }
 
+static int latency_histogram_build_json(const uint64_t histogram[static SERVER_LATENCY_BUCKETS], JsonVariant **ret) {
+        _cleanup_(json_variant_unrefp) JsonVariant *v = NULL;
+        unsigned k;
+        int r;
+
+        assert(ret);
+
+        /* Only non-empty buckets are listed, each with its exclusive upper bound, except for the last one */
+        for (k = 0; k < SERVER_LATENCY_BUCKETS; k++) {
+                _cleanup_(json_variant_unrefp) JsonVariant *b = NULL;
+
+                if (histogram[k] == 0)
+                        continue;
+
+                r = json_build(&b, JSON_BUILD_OBJECT(
+                                       JSON_BUILD_PAIR_CONDITION(k < SERVER_LATENCY_BUCKETS - 1, "lessThanUSec", JSON_BUILD_UNSIGNED(UINT64_C(1) << k)),
+                                       JSON_BUILD_PAIR("count", JSON_BUILD_UNSIGNED(histogram[k]))));
+                if (r < 0)
+                        return r;
+
+                r = json_variant_append_array(&v, b);
+                if (r < 0)
+                        return r;
+        }
+
+        if (!v) {
+                r = json_variant_new_array(&v, NULL, 0);
+                if (r < 0)
+                        return r;
+        }
+
+        *ret = TAKE_PTR(v);
+        return 0;
+}
+
+static int vl_method_get_statistics(Varlink *link, JsonVariant *parameters, VarlinkMethodFlags flags, void *userdata) {
+        _cleanup_(json_variant_unrefp) JsonVariant *received = NULL, *suppressed = NULL, *sync_latency = NULL;
+        Server *s = userdata;
+        ServerTransport t;
+        int r;
+
+        assert(link);
+        assert(s);
+
+        if (json_variant_elements(parameters) > 0)
+                return varlink_error_invalid_parameter(link, parameters);
+
+        for (t = 0; t < _SERVER_TRANSPORT_MAX; t++) {
+                r = json_variant_set_field_unsigned(&received, server_transport_to_string(t), s->n_messages_received[t]);
+                if (r < 0)
+                        return r;
+        }
+
+        r = journal_ratelimit_build_json(s->ratelimit, &suppressed);
+        if (r < 0)
+                return r;
+
+        r = latency_histogram_build_json(s->sync_latency, &sync_latency);
+        if (r < 0)
+                return r;
+
+        return varlink_replyb(link,
+                        JSON_BUILD_OBJECT(
+                                JSON_BUILD_PAIR("messagesReceived", JSON_BUILD_VARIANT(received)),
+                                JSON_BUILD_PAIR("messagesSuppressed", JSON_BUILD_UNSIGNED(s->n_messages_suppressed)),
+                                JSON_BUILD_PAIR("messagesSuppressedByUnit", JSON_BUILD_VARIANT(suppressed)),
+                                JSON_BUILD_PAIR("entriesWritten", JSON_BUILD_UNSIGNED(s->n_entries_written)),
+                                JSON_BUILD_PAIR("bytesWritten", JSON_BUILD_UNSIGNED(s->n_bytes_written)),
+                                JSON_BUILD_PAIR("syncs", JSON_BUILD_UNSIGNED(s->n_syncs)),
+                                JSON_BUILD_PAIR("syncLatency", JSON_BUILD_VARIANT(sync_latency)),
+                                JSON_BUILD_PAIR("clientContextCache", JSON_BUILD_OBJECT(
+                                                JSON_BUILD_PAIR("entries", JSON_BUILD_UNSIGNED(hashmap_size(s->client_contexts))),
+                                                JSON_BUILD_PAIR("hits", JSON_BUILD_UNSIGNED(s->n_client_context_hits)),
+                                                JSON_BUILD_PAIR("misses", JSON_BUILD_UNSIGNED(s->n_client_context_misses)),
+                                                JSON_BUILD_PAIR("refreshes", JSON_BUILD_UNSIGNED(s->n_client_context_refreshes)))),
+                                JSON_BUILD_PAIR("mmapCache", JSON_BUILD_OBJECT(
+                                                JSON_BUILD_PAIR("hits", JSON_BUILD_UNSIGNED(mmap_cache_get_hit(s->mmap))),
+                                                JSON_BUILD_PAIR("misses", JSON_BUILD_UNSIGNED(mmap_cache_get_missed(s->mmap))),
+                                                JSON_BUILD_PAIR("evicted", JSON_BUILD_UNSIGNED(mmap_cache_get_evicted(s->mmap))),
+                                                JSON_BUILD_PAIR("windows", JSON_BUILD_UNSIGNED(mmap_cache_get_n_windows(s->mmap))))),
+                                JSON_BUILD_PAIR("kernel", JSON_BUILD_OBJECT(
+                                                JSON_BUILD_PAIR("records", JSON_BUILD_UNSIGNED(s->n_dev_kmsg_records)),
+                                                JSON_BUILD_PAIR("lost", JSON_BUILD_UNSIGNED(s->n_dev_kmsg_lost)),
+                                                JSON_BUILD_PAIR("overruns", JSON_BUILD_UNSIGNED(s->n_dev_kmsg_overruns)))),
+                                JSON_BUILD_PAIR("queues", JSON_BUILD_OBJECT(
+                                                JSON_BUILD_PAIR("stdoutStreams", JSON_BUILD_UNSIGNED(s->n_stdout_streams)),
+                                                JSON_BUILD_PAIR("rings", JSON_BUILD_UNSIGNED(s->n_rings)),
+                                                JSON_BUILD_PAIR("deferredCloses", JSON_BUILD_UNSIGNED(set_size(s->deferred_closes))),
+                                                JSON_BUILD_PAIR("syslogForward", JSON_BUILD_UNSIGNED(s->n_syslog_forward_entries))))));
+}
+
 static int server_open_varlink(Server *s) {
         int r;
 
@@ -1974,7 +2208,8 @@ static int server_open_varlink(Server *s) {
                         "io.systemd.Journal.Synchronize",   vl_method_synchronize,
                         "io.systemd.Journal.Rotate",        vl_method_rotate,
                         "io.systemd.Journal.FlushToVar",    vl_method_flush_to_var,
-                        "io.systemd.Journal.RelinquishVar", vl_method_relinquish_var);
+                        "io.systemd.Journal.RelinquishVar", vl_method_relinquish_var,
+                        "io.systemd.Journal.GetStatistics", vl_method_get_statistics);
         if (r < 0)
                 return r;
 
@@ -2175,6 +2410,8 @@ int server_init(Server *s) {
         if (r < 0)
                 return r;
 
+        (void) server_watch_memory_pressure(s);
+
         s->ratelimit = journal_ratelimit_new();
         if (!s->ratelimit)
                 return -ENOMEM;
@@ -2223,6 +2460,9 @@ void server_done(Server *s) {
         while (s->stdout_streams)
                 stdout_stream_free(s->stdout_streams);
 
+        while (s->rings)
+                journal_ring_free(s->rings);
+
         client_context_flush_all(s);
 
         (void) journal_file_close(s->system_journal);
@@ -2232,6 +2472,11 @@ void server_done(Server *s) {
 
         varlink_server_unref(s->varlink_server);
 
+        server_flush_syslog_forward(s);
+        free(s->syslog_forward_entries);
+        free(s->syslog_forward_buffer);
+
+        sd_event_source_unref(s->syslog_forward_event_source);
         sd_event_source_unref(s->syslog_event_source);
         sd_event_source_unref(s->native_event_source);
         sd_event_source_unref(s->stdout_event_source);
@@ -2244,6 +2489,7 @@ void server_done(Server *s) {
         sd_event_source_unref(s->sigint_event_source);
         sd_event_source_unref(s->sigrtmin1_event_source);
         sd_event_source_unref(s->hostname_event_source);
+        sd_event_source_unref(s->memory_pressure_event_source);
         sd_event_source_unref(s->notify_event_source);
         sd_event_source_unref(s->watchdog_event_source);
         sd_event_unref(s->event);
@@ -2269,6 +2515,12 @@ void server_done(Server *s) {
         free(s->runtime_storage.path);
         free(s->system_storage.path);
 
+        hashmap_free(s->runtime_storage.vacuum_cache);
+        hashmap_free(s->system_storage.vacuum_cache);
+
+        hashmap_free(s->runtime_storage.manifest_cache);
+        hashmap_free(s->system_storage.manifest_cache);
+
         mmap_cache_unref(s->mmap);
 }
 
@@ -2291,6 +2543,18 @@ static const char* const split_mode_table[_SPLIT_MAX] = {
 DEFINE_STRING_TABLE_LOOKUP(split_mode, SplitMode);
 DEFINE_CONFIG_PARSE_ENUM(config_parse_split_mode, split_mode, SplitMode, "Failed to parse split mode setting");
 
+/* The values of the _TRANSPORT= field */
+static const char* const server_transport_table[_SERVER_TRANSPORT_MAX] = {
+        [SERVER_TRANSPORT_DRIVER] = "driver",
+        [SERVER_TRANSPORT_SYSLOG] = "syslog",
+        [SERVER_TRANSPORT_JOURNAL] = "journal",
+        [SERVER_TRANSPORT_STDOUT] = "stdout",
+        [SERVER_TRANSPORT_KERNEL] = "kernel",
+        [SERVER_TRANSPORT_AUDIT] = "audit",
+};
+
+DEFINE_STRING_TABLE_LOOKUP(server_transport, ServerTransport);
+
 int config_parse_line_max(
                 const char* unit,
                 const char *filename,
@@ -13,6 +13,7 @@ typedef struct Server Server;
 #include "journal-file.h"
 #include "journald-context.h"
 #include "journald-rate-limit.h"
+#include "journald-ring.h"
 #include "journald-stream.h"
 #include "list.h"
 #include "prioq.h"
@@ -36,6 +37,21 @@ typedef enum SplitMode {
         _SPLIT_INVALID = -1
 } SplitMode;
 
+typedef enum ServerTransport {
+        SERVER_TRANSPORT_DRIVER,
+        SERVER_TRANSPORT_SYSLOG,
+        SERVER_TRANSPORT_JOURNAL,
+        SERVER_TRANSPORT_STDOUT,
+        SERVER_TRANSPORT_KERNEL,
+        SERVER_TRANSPORT_AUDIT,
+        _SERVER_TRANSPORT_MAX,
+        _SERVER_TRANSPORT_INVALID = -1
+} ServerTransport;
+
+/* Buckets of the latency histograms: the first one counts latencies of 0µs, bucket k ≥ 1 those in [2^(k-1)µs,
+ * 2^k µs), and the last one everything above. */
+#define SERVER_LATENCY_BUCKETS 25
+
 typedef struct JournalCompressOptions {
         bool enabled;
         uint64_t threshold_bytes;
@@ -57,6 +73,9 @@ typedef struct JournalStorage {
 
         JournalMetrics metrics;
         JournalStorageSpace space;
+
+        Hashmap *vacuum_cache;
+        Hashmap *manifest_cache;
 } JournalStorage;
 
 struct Server {
@@ -82,6 +101,7 @@ struct Server {
         sd_event_source *sigint_event_source;
         sd_event_source *sigrtmin1_event_source;
         sd_event_source *hostname_event_source;
+        sd_event_source *memory_pressure_event_source;
         sd_event_source *notify_event_source;
         sd_event_source *watchdog_event_source;
 
@@ -114,6 +134,19 @@ struct Server {
         unsigned n_forward_syslog_missed;
         usec_t last_warn_forward_syslog_missed;
 
+        /* Messages to forward to syslog, sent with a single sendmmsg() once we ran out of other work */
+        sd_event_source *syslog_forward_event_source;
+        struct SyslogForwardEntry *syslog_forward_entries;
+        size_t n_syslog_forward_entries;
+        char *syslog_forward_buffer;
+        size_t syslog_forward_buffer_used, syslog_forward_buffer_allocated;
+
+        /* Appends that blocked the event loop for longer than SLOW_WRITE_USEC, i.e. when ingestion stalled
+         * because of the disk */
+        unsigned n_slow_writes;
+        usec_t slow_write_max_usec;
+        usec_t last_warn_slow_writes;
+
         usec_t max_retention_usec;
         usec_t max_file_usec;
         usec_t oldest_file_usec;
@@ -122,6 +155,9 @@ struct Server {
         LIST_HEAD(StdoutStream, stdout_streams_notify_queue);
         unsigned n_stdout_streams;
 
+        LIST_HEAD(JournalRing, rings);
+        unsigned n_rings;
+
         char *tty_path;
 
         int max_level_store;
@@ -160,9 +196,27 @@ struct Server {
         /* Caching of client metadata */
         Hashmap *client_contexts;
         Prioq *client_contexts_lru;
+        unsigned metadata_cache_max;
 
         usec_t last_cache_pid_flush;
 
+        uint64_t n_client_context_hits;
+        uint64_t n_client_context_misses;
+        uint64_t n_client_context_refreshes;
+
+        /* Statistics, reported via io.systemd.Journal.GetStatistics() */
+        uint64_t n_messages_received[_SERVER_TRANSPORT_MAX];
+        uint64_t n_messages_suppressed;
+        uint64_t n_entries_written;
+        uint64_t n_bytes_written;
+        uint64_t n_syncs;
+        uint64_t sync_latency[SERVER_LATENCY_BUCKETS];
+
+        /* Records read from /dev/kmsg, and records the kernel overwrote before we got to them */
+        uint64_t n_dev_kmsg_records;
+        uint64_t n_dev_kmsg_lost;
+        uint64_t n_dev_kmsg_overruns;
+
         ClientContext *my_context; /* the context of journald itself */
         ClientContext *pid1_context; /* the context of PID 1 */
 
@@ -204,6 +258,9 @@ CONFIG_PARSER_PROTOTYPE(config_parse_split_mode);
 const char *split_mode_to_string(SplitMode s) _const_;
 SplitMode split_mode_from_string(const char *s) _pure_;
 
+const char *server_transport_to_string(ServerTransport t) _const_;
+ServerTransport server_transport_from_string(const char *s) _pure_;
+
 int server_init(Server *s);
 void server_done(Server *s);
 void server_sync(Server *s);
@@ -212,5 +269,6 @@ void server_rotate(Server *s);
 int server_schedule_sync(Server *s, int priority);
 int server_flush_to_var(Server *s, bool require_flag_file);
 void server_maybe_append_tags(Server *s);
+void server_maybe_warn_slow_writes(Server *s);
 int server_process_datagram(sd_event_source *es, int fd, uint32_t revents, void *userdata);
 void server_space_usage_message(Server *s, JournalStorage *storage);
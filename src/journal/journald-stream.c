@@ -81,6 +81,7 @@ struct StdoutStream {
         char *buffer;
         size_t length;
         size_t allocated;
+        size_t scanned; /* how much of the buffer is known to contain no line break */
 
         sd_event_source *event_source;
 
@@ -283,6 +284,7 @@ static int stdout_stream_log(StdoutStream *s, const char *p, LineBreak line_brea
         iovec = newa(struct iovec, m);
 
         iovec[n++] = IOVEC_MAKE_STRING("_TRANSPORT=stdout");
+        s->server->n_messages_received[SERVER_TRANSPORT_STDOUT]++;
         iovec[n++] = IOVEC_MAKE_STRING(s->id_field);
 
         syslog_priority[STRLEN("PRIORITY=")] = '0' + LOG_PRI(priority);
@@ -425,32 +427,44 @@ static int stdout_stream_line(StdoutStream *s, char *p, LineBreak line_break) {
 
 static int stdout_stream_scan(StdoutStream *s, bool force_flush) {
         char *p;
-        size_t remaining;
+        size_t remaining, scanned;
+        char saved;
         int r;
 
         assert(s);
+        assert(s->length < s->allocated);
 
         p = s->buffer;
         remaining = s->length;
 
+        /* The beginning of the buffer is what was left over by the previous scan, and is known not to
+         * contain any line break, hence don't look at it again. */
+        scanned = MIN(s->scanned, remaining);
+
+        /* Terminate the buffer, so that we can look for both kinds of line breaks in one go with
+         * strchrnul(), which is vectorized in libc. The byte might already be data read after a change of
+         * credentials, hence restore it afterwards. */
+        saved = p[remaining];
+        p[remaining] = 0;
+
         /* XXX: This function does nothing if (s->length == 0) */
 
         for (;;) {
                 LineBreak line_break;
                 size_t skip;
-                char *end1, *end2;
+                char *end;
 
-                end1 = memchr(p, '\n', remaining);
-                end2 = memchr(p, 0, end1 ? (size_t) (end1 - p) : remaining);
+                end = strchrnul(p + scanned, '\n');
+                scanned = 0;
 
-                if (end2) {
+                if (end < p + remaining && *end == 0) {
                         /* We found a NUL terminator */
-                        skip = end2 - p + 1;
+                        skip = end - p + 1;
                         line_break = LINE_BREAK_NUL;
-                } else if (end1) {
+                } else if (end < p + remaining) {
                         /* We found a \n terminator */
-                        *end1 = 0;
-                        skip = end1 - p + 1;
+                        *end = 0;
+                        skip = end - p + 1;
                         line_break = LINE_BREAK_NEWLINE;
                 } else if (remaining >= s->server->line_max) {
                         /* Force a line break after the maximum line length */
@@ -468,6 +482,8 @@ static int stdout_stream_scan(StdoutStream *s, bool force_flush) {
                 p += skip;
         }
 
+        p[remaining] = saved;
+
         if (force_flush && remaining > 0) {
                 p[remaining] = 0;
                 r = stdout_stream_line(s, p, LINE_BREAK_EOF);
@@ -483,6 +499,8 @@ static int stdout_stream_scan(StdoutStream *s, bool force_flush) {
                 s->length = remaining;
         }
 
+        s->scanned = remaining;
+
         return 0;
 }
 
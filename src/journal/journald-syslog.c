@@ -25,77 +25,188 @@
 /* Warn once every 30s if we missed syslog message */
 #define WARN_FORWARD_SYSLOG_MISSED_USEC (30 * USEC_PER_SEC)
 
-static void forward_syslog_iovec(Server *s, const struct iovec *iovec, unsigned n_iovec, const struct ucred *ucred, const struct timeval *tv) {
+/* Upper bounds for the messages queued for forwarding to syslog. When either is hit, the queue is flushed right
+ * away. */
+#define SYSLOG_FORWARD_QUEUE_MAX 64U
+#define SYSLOG_FORWARD_BUFFER_MAX (256U*1024U)
+
+typedef struct SyslogForwardEntry {
+        size_t offset, size;
+        struct ucred ucred;
+        bool has_ucred;
+} SyslogForwardEntry;
+
+void server_flush_syslog_forward(Server *s) {
 
         static const union sockaddr_union sa = {
                 .un.sun_family = AF_UNIX,
                 .un.sun_path = "/run/systemd/journal/syslog",
         };
-        struct msghdr msghdr = {
-                .msg_iov = (struct iovec *) iovec,
-                .msg_iovlen = n_iovec,
-                .msg_name = (struct sockaddr*) &sa.sa,
-                .msg_namelen = SOCKADDR_UN_LEN(sa.un),
-        };
-        struct cmsghdr *cmsg;
+        struct mmsghdr mmsg[SYSLOG_FORWARD_QUEUE_MAX] = {};
+        struct iovec iovec[SYSLOG_FORWARD_QUEUE_MAX];
         union {
                 struct cmsghdr cmsghdr;
                 uint8_t buf[CMSG_SPACE(sizeof(struct ucred))];
-        } control;
+        } control[SYSLOG_FORWARD_QUEUE_MAX];
+        size_t i, n;
 
         assert(s);
-        assert(iovec);
-        assert(n_iovec > 0);
 
-        if (ucred) {
-                zero(control);
-                msghdr.msg_control = &control;
-                msghdr.msg_controllen = sizeof(control);
-
-                cmsg = CMSG_FIRSTHDR(&msghdr);
-                cmsg->cmsg_level = SOL_SOCKET;
-                cmsg->cmsg_type = SCM_CREDENTIALS;
-                cmsg->cmsg_len = CMSG_LEN(sizeof(struct ucred));
-                memcpy(CMSG_DATA(cmsg), ucred, sizeof(struct ucred));
-                msghdr.msg_controllen = cmsg->cmsg_len;
+        n = s->n_syslog_forward_entries;
+        if (n == 0)
+                return;
+
+        for (i = 0; i < n; i++) {
+                SyslogForwardEntry *e = s->syslog_forward_entries + i;
+                struct msghdr *mh = &mmsg[i].msg_hdr;
+
+                iovec[i] = IOVEC_MAKE(s->syslog_forward_buffer + e->offset, e->size);
+
+                *mh = (struct msghdr) {
+                        .msg_iov = iovec + i,
+                        .msg_iovlen = 1,
+                        .msg_name = (struct sockaddr*) &sa.sa,
+                        .msg_namelen = SOCKADDR_UN_LEN(sa.un),
+                };
+
+                if (e->has_ucred) {
+                        struct cmsghdr *cmsg;
+
+                        zero(control[i]);
+                        mh->msg_control = &control[i];
+                        mh->msg_controllen = sizeof(control[i]);
+
+                        cmsg = CMSG_FIRSTHDR(mh);
+                        cmsg->cmsg_level = SOL_SOCKET;
+                        cmsg->cmsg_type = SCM_CREDENTIALS;
+                        cmsg->cmsg_len = CMSG_LEN(sizeof(struct ucred));
+                        memcpy(CMSG_DATA(cmsg), &e->ucred, sizeof(struct ucred));
+                        mh->msg_controllen = cmsg->cmsg_len;
+                }
         }
 
-        /* Forward the syslog message we received via /dev/log to
+        /* Forward the syslog messages we received via /dev/log to
          * /run/systemd/syslog. Unfortunately we currently can't set
          * the SO_TIMESTAMP auxiliary data, and hence we don't. */
 
-        if (sendmsg(s->syslog_fd, &msghdr, MSG_NOSIGNAL) >= 0)
-                return;
+        for (i = 0; i < n;) {
+                SyslogForwardEntry *e = s->syslog_forward_entries + i;
+                int k;
+
+                k = sendmmsg(s->syslog_fd, mmsg + i, n - i, MSG_NOSIGNAL);
+                if (k > 0) {
+                        i += k;
+                        continue;
+                }
+
+                /* The socket is full? I guess the syslog implementation is
+                 * too slow, and we shouldn't wait for that... */
+                if (errno == EAGAIN) {
+                        s->n_forward_syslog_missed += n - i;
+                        break;
+                }
+
+                /* Nobody is listening, drop everything */
+                if (errno == ENOENT)
+                        break;
+
+                if (e->has_ucred && e->ucred.pid != getpid_cached() && IN_SET(errno, ESRCH, EPERM)) {
+                        struct cmsghdr *cmsg;
+
+                        /* Hmm, presumably the sender process vanished
+                         * by now, or we don't have CAP_SYS_AMDIN, so
+                         * let's fix it as good as we can, and retry */
+
+                        e->ucred.pid = getpid_cached();
+                        cmsg = CMSG_FIRSTHDR(&mmsg[i].msg_hdr);
+                        memcpy(CMSG_DATA(cmsg), &e->ucred, sizeof(struct ucred));
+                        continue;
+                }
+
+                log_debug_errno(errno, "Failed to forward syslog message: %m");
+                i++;
+        }
 
-        /* The socket is full? I guess the syslog implementation is
-         * too slow, and we shouldn't wait for that... */
-        if (errno == EAGAIN) {
+        s->n_syslog_forward_entries = 0;
+        s->syslog_forward_buffer_used = 0;
+}
+
+static int dispatch_syslog_forward(sd_event_source *es, void *userdata) {
+        Server *s = userdata;
+
+        assert(s);
+
+        server_flush_syslog_forward(s);
+        return 0;
+}
+
+static void forward_syslog_iovec(Server *s, const struct iovec *iovec, unsigned n_iovec, const struct ucred *ucred, const struct timeval *tv) {
+        SyslogForwardEntry *e;
+        size_t size;
+        unsigned i;
+        char *p;
+        int r;
+
+        assert(s);
+        assert(iovec);
+        assert(n_iovec > 0);
+
+        /* Messages are not sent right away, but queued and sent in one go once we're done with everything
+         * else pending, so that a burst of messages costs a single syscall. */
+
+        size = IOVEC_TOTAL_SIZE(iovec, n_iovec);
+        if (size > SYSLOG_FORWARD_BUFFER_MAX) {
                 s->n_forward_syslog_missed++;
                 return;
         }
 
-        if (ucred && IN_SET(errno, ESRCH, EPERM)) {
-                struct ucred u;
+        if (s->n_syslog_forward_entries >= SYSLOG_FORWARD_QUEUE_MAX ||
+            s->syslog_forward_buffer_used + size > SYSLOG_FORWARD_BUFFER_MAX)
+                server_flush_syslog_forward(s);
 
-                /* Hmm, presumably the sender process vanished
-                 * by now, or we don't have CAP_SYS_AMDIN, so
-                 * let's fix it as good as we can, and retry */
+        if (!s->syslog_forward_entries) {
+                s->syslog_forward_entries = new(SyslogForwardEntry, SYSLOG_FORWARD_QUEUE_MAX);
+                if (!s->syslog_forward_entries)
+                        goto fail;
+        }
 
-                u = *ucred;
-                u.pid = getpid_cached();
-                memcpy(CMSG_DATA(cmsg), &u, sizeof(struct ucred));
+        if (!GREEDY_REALLOC(s->syslog_forward_buffer, s->syslog_forward_buffer_allocated, s->syslog_forward_buffer_used + size))
+                goto fail;
 
-                if (sendmsg(s->syslog_fd, &msghdr, MSG_NOSIGNAL) >= 0)
-                        return;
+        if (!s->syslog_forward_event_source) {
+                r = sd_event_add_defer(s->event, &s->syslog_forward_event_source, dispatch_syslog_forward, s);
+                if (r < 0)
+                        goto fail;
 
-                if (errno == EAGAIN) {
-                        s->n_forward_syslog_missed++;
-                        return;
-                }
+                /* Run after the input sources, so that we only flush once we're through with a burst of
+                 * messages, but before a sync or exit request is handled. */
+                (void) sd_event_source_set_priority(s->syslog_forward_event_source, SD_EVENT_PRIORITY_NORMAL+10);
+                (void) sd_event_source_set_description(s->syslog_forward_event_source, "syslog-forward");
         }
 
-        if (errno != ENOENT)
-                log_debug_errno(errno, "Failed to forward syslog message: %m");
+        r = sd_event_source_set_enabled(s->syslog_forward_event_source, SD_EVENT_ONESHOT);
+        if (r < 0)
+                goto fail;
+
+        e = s->syslog_forward_entries + s->n_syslog_forward_entries++;
+        *e = (SyslogForwardEntry) {
+                .offset = s->syslog_forward_buffer_used,
+                .size = size,
+                .has_ucred = ucred,
+        };
+        if (ucred)
+                e->ucred = *ucred;
+
+        p = s->syslog_forward_buffer + s->syslog_forward_buffer_used;
+        for (i = 0; i < n_iovec; i++)
+                if (iovec[i].iov_len > 0)
+                        p = mempcpy(p, iovec[i].iov_base, iovec[i].iov_len);
+
+        s->syslog_forward_buffer_used += size;
+        return;
+
+fail:
+        s->n_forward_syslog_missed++;
 }
 
 static void forward_syslog_raw(Server *s, int priority, const char *buffer, size_t buffer_len, const struct ucred *ucred, const struct timeval *tv) {
@@ -387,6 +498,7 @@ void server_process_syslog_message(
         iovec = newa(struct iovec, m);
 
         iovec[n++] = IOVEC_MAKE_STRING("_TRANSPORT=syslog");
+        s->n_messages_received[SERVER_TRANSPORT_SYSLOG]++;
 
         xsprintf(syslog_priority, "PRIORITY=%i", priority & LOG_PRIMASK);
         iovec[n++] = IOVEC_MAKE_STRING(syslog_priority);
@@ -97,6 +97,7 @@ int main(int argc, char *argv[]) {
 
                 server_maybe_append_tags(&server);
                 server_maybe_warn_forward_syslog_missed(&server);
+                server_maybe_warn_slow_writes(&server);
         }
 
         log_debug("systemd-journald stopped as pid "PID_FMT, getpid_cached());
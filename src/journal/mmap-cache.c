@@ -25,6 +25,9 @@ struct Window {
         bool keep_always:1;
         bool in_unused:1;
 
+        /* Pinned windows are neither unmapped nor reused, even when no context refers to them anymore */
+        unsigned n_pinned;
+
         int prot;
         void *ptr;
         uint64_t offset;
@@ -38,11 +41,27 @@ struct Window {
         LIST_HEAD(Context, contexts);
 };
 
+typedef enum AccessPattern {
+        ACCESS_UNKNOWN,
+        ACCESS_FORWARD,
+        ACCESS_BACKWARD,
+        ACCESS_RANDOM,
+} AccessPattern;
+
 struct Context {
         MMapCache *cache;
         unsigned id;
         Window *window;
 
+        /* The size of the windows we create for this context, adjusted to how it is accessed */
+        uint64_t window_size;
+        AccessPattern pattern;
+
+        /* The last window created for this context */
+        int last_fd;
+        uint64_t last_offset;
+        uint64_t last_size;
+
         LIST_FIELDS(Context, by_window);
 };
 
@@ -57,7 +76,7 @@ struct MMapCache {
         unsigned n_ref;
         unsigned n_windows;
 
-        unsigned n_hit, n_missed;
+        unsigned n_hit, n_missed, n_evicted;
 
         Hashmap *fds;
         Context *contexts[MMAP_CACHE_MAX_CONTEXTS];
@@ -71,8 +90,11 @@ struct MMapCache {
 #if ENABLE_DEBUG_MMAP_CACHE
 /* Tiny windows increase mmap activity and the chance of exposing unsafe use. */
 # define WINDOW_SIZE (page_size())
+# define WINDOW_SIZE_MAX WINDOW_SIZE
 #else
 # define WINDOW_SIZE (8ULL*1024ULL*1024ULL)
+/* Don't exhaust the address space with WINDOWS_MIN large windows on 32bit */
+# define WINDOW_SIZE_MAX (sizeof(void*) >= 8 ? 64ULL*1024ULL*1024ULL : WINDOW_SIZE)
 #endif
 
 MMapCache* mmap_cache_new(void) {
@@ -172,6 +194,7 @@ static Window *window_add(MMapCache *m, MMapFileDescriptor *f, int prot, bool ke
                 w = m->last_unused;
                 window_unlink(w);
                 zero(*w);
+                m->n_evicted++;
         }
 
         w->cache = m;
@@ -187,33 +210,39 @@ static Window *window_add(MMapCache *m, MMapFileDescriptor *f, int prot, bool ke
         return w;
 }
 
-static void context_detach_window(Context *c) {
-        Window *w;
-
-        assert(c);
-
-        if (!c->window)
-                return;
-
-        w = TAKE_PTR(c->window);
-        LIST_REMOVE(by_window, w->contexts, c);
+static void window_maybe_unused(Window *w) {
+        assert(w);
 
-        if (!w->contexts && !w->keep_always) {
+        if (!w->contexts && !w->keep_always && w->n_pinned == 0) {
                 /* Not used anymore? */
 #if ENABLE_DEBUG_MMAP_CACHE
                 /* Unmap unused windows immediately to expose use-after-unmap
                  * by SIGSEGV. */
                 window_free(w);
 #else
-                LIST_PREPEND(unused, c->cache->unused, w);
-                if (!c->cache->last_unused)
-                        c->cache->last_unused = w;
+                LIST_PREPEND(unused, w->cache->unused, w);
+                if (!w->cache->last_unused)
+                        w->cache->last_unused = w;
 
                 w->in_unused = true;
 #endif
         }
 }
 
+static void context_detach_window(Context *c) {
+        Window *w;
+
+        assert(c);
+
+        if (!c->window)
+                return;
+
+        w = TAKE_PTR(c->window);
+        LIST_REMOVE(by_window, w->contexts, c);
+
+        window_maybe_unused(w);
+}
+
 static void context_attach_window(Context *c, Window *w) {
         assert(c);
         assert(w);
@@ -251,6 +280,8 @@ static Context *context_add(MMapCache *m, unsigned id) {
 
         c->cache = m;
         c->id = id;
+        c->window_size = WINDOW_SIZE;
+        c->last_fd = -1;
 
         assert(!m->contexts[id]);
         m->contexts[id] = c;
@@ -290,6 +321,20 @@ static MMapCache *mmap_cache_free(MMapCache *m) {
 
 DEFINE_TRIVIAL_REF_UNREF_FUNC(MMapCache, mmap_cache, mmap_cache_free);
 
+unsigned mmap_cache_trim(MMapCache *m) {
+        unsigned n = 0;
+
+        assert(m);
+
+        while (m->unused) {
+                window_free(m->unused);
+                m->n_evicted++;
+                n++;
+        }
+
+        return n;
+}
+
 static int make_room(MMapCache *m) {
         assert(m);
 
@@ -297,6 +342,7 @@ static int make_room(MMapCache *m) {
                 return 0;
 
         window_free(m->last_unused);
+        m->n_evicted++;
         return 1;
 }
 
@@ -417,6 +463,44 @@ static int mmap_try_harder(MMapCache *m, void *addr, MMapFileDescriptor *f, int
         return 0;
 }
 
+static void context_adapt_window_size(Context *c, MMapFileDescriptor *f, uint64_t offset) {
+        AccessPattern pattern;
+
+        assert(c);
+        assert(f);
+
+        /* Called when the context needs a new window. If the requested offset follows (or precedes) the
+         * last window of the context directly, the file is read sequentially, and larger windows mean fewer
+         * mappings. If it is somewhere else entirely, large windows just map lots of pages that are never
+         * touched, hence we go back to the default size. We don't go below it though: random lookups (of
+         * hash table buckets, data objects, entry arrays) tend to be spread over the whole file, and with
+         * smaller windows they no longer fit into the WINDOWS_MIN windows we keep around, so that almost
+         * every lookup ends up in mmap(). */
+
+        if (c->last_fd != f->fd || c->last_size == 0)
+                return;
+
+        if (offset >= c->last_offset + c->last_size &&
+            offset < c->last_offset + 2 * c->last_size)
+                pattern = ACCESS_FORWARD;
+        else if (offset < c->last_offset &&
+                 offset + c->last_size >= c->last_offset)
+                pattern = ACCESS_BACKWARD;
+        else if (offset >= c->last_offset &&
+                 offset < c->last_offset + c->last_size)
+                /* The window was evicted, or the requested object is partly beyond it, no news */
+                return;
+        else
+                pattern = ACCESS_RANDOM;
+
+        if (pattern == ACCESS_RANDOM)
+                c->window_size = MAX(c->window_size / 2, WINDOW_SIZE);
+        else if (pattern == c->pattern)
+                c->window_size = MIN(c->window_size * 2, WINDOW_SIZE_MAX);
+
+        c->pattern = pattern;
+}
+
 static int add_mmap(
                 MMapCache *m,
                 MMapFileDescriptor *f,
@@ -441,21 +525,35 @@ static int add_mmap(
         assert(size > 0);
         assert(ret);
 
+        c = context_add(m, context);
+        if (!c)
+                return -ENOMEM;
+
+        context_adapt_window_size(c, f, offset);
+
         woffset = offset & ~((uint64_t) page_size() - 1ULL);
         wsize = size + (offset - woffset);
         wsize = PAGE_ALIGN(wsize);
 
-        if (wsize < WINDOW_SIZE) {
+        if (wsize < c->window_size) {
                 uint64_t delta;
 
-                delta = PAGE_ALIGN((WINDOW_SIZE - wsize) / 2);
+                /* Place the window so that most of it covers what is likely accessed next: for sequential
+                 * access the range following the requested one (in the direction of the access), otherwise
+                 * the area around it. */
+                if (c->pattern == ACCESS_FORWARD)
+                        delta = PAGE_ALIGN((c->window_size - wsize) / 8);
+                else if (c->pattern == ACCESS_BACKWARD)
+                        delta = PAGE_ALIGN((c->window_size - wsize) / 8 * 7);
+                else
+                        delta = PAGE_ALIGN((c->window_size - wsize) / 2);
 
                 if (delta > offset)
                         woffset = 0;
                 else
                         woffset -= delta;
 
-                wsize = WINDOW_SIZE;
+                wsize = c->window_size;
         }
 
         if (st) {
@@ -474,9 +572,16 @@ static int add_mmap(
         if (r < 0)
                 return r;
 
-        c = context_add(m, context);
-        if (!c)
-                goto outofmem;
+        /* These are only hints, hence ignore failures */
+        if (IN_SET(c->pattern, ACCESS_FORWARD, ACCESS_BACKWARD)) {
+                (void) madvise(d, wsize, MADV_SEQUENTIAL);
+                (void) madvise(d, wsize, MADV_WILLNEED);
+        } else if (c->pattern == ACCESS_RANDOM)
+                (void) madvise(d, wsize, MADV_RANDOM);
+
+        c->last_fd = f->fd;
+        c->last_offset = woffset;
+        c->last_size = wsize;
 
         w = window_add(m, f, prot, keep_always, woffset, wsize, d);
         if (!w)
@@ -548,6 +653,47 @@ unsigned mmap_cache_get_missed(MMapCache *m) {
         return m->n_missed;
 }
 
+unsigned mmap_cache_get_evicted(MMapCache *m) {
+        assert(m);
+
+        return m->n_evicted;
+}
+
+unsigned mmap_cache_get_n_windows(MMapCache *m) {
+        assert(m);
+
+        return m->n_windows;
+}
+
+uint64_t mmap_cache_get_window_size(MMapCache *m, unsigned context) {
+        assert(m);
+        assert(context < MMAP_CACHE_MAX_CONTEXTS);
+
+        return m->contexts[context] ? m->contexts[context]->window_size : WINDOW_SIZE;
+}
+
+MMapWindow* mmap_cache_pin(MMapCache *m, unsigned context) {
+        Context *c;
+
+        assert(m);
+        assert(context < MMAP_CACHE_MAX_CONTEXTS);
+
+        c = m->contexts[context];
+        if (!c || !c->window)
+                return NULL;
+
+        c->window->n_pinned++;
+        return c->window;
+}
+
+void mmap_cache_unpin(MMapWindow *w) {
+        assert(w);
+        assert(w->n_pinned > 0);
+
+        w->n_pinned--;
+        window_maybe_unused(w);
+}
+
 static void mmap_cache_process_sigbus(MMapCache *m) {
         bool found = false;
         MMapFileDescriptor *f;
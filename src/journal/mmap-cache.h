@@ -1,14 +1,16 @@
 /* SPDX-License-Identifier: LGPL-2.1+ */
 #pragma once
 
+#include <inttypes.h>
 #include <stdbool.h>
 #include <sys/stat.h>
 
 /* One context per object type, plus one of the header, plus one "additional" one */
-#define MMAP_CACHE_MAX_CONTEXTS 9
+#define MMAP_CACHE_MAX_CONTEXTS 14
 
 typedef struct MMapCache MMapCache;
 typedef struct MMapFileDescriptor MMapFileDescriptor;
+typedef struct Window MMapWindow;
 
 MMapCache* mmap_cache_new(void);
 MMapCache* mmap_cache_ref(MMapCache *m);
@@ -30,5 +32,21 @@ void mmap_cache_free_fd(MMapCache *m, MMapFileDescriptor *f);
 
 unsigned mmap_cache_get_hit(MMapCache *m);
 unsigned mmap_cache_get_missed(MMapCache *m);
+unsigned mmap_cache_get_evicted(MMapCache *m);
+unsigned mmap_cache_get_n_windows(MMapCache *m);
+
+/* The size of the windows currently created for the context, which grows with sequential and shrinks
+ * with random access */
+uint64_t mmap_cache_get_window_size(MMapCache *m, unsigned context);
+
+/* Pins the window the context currently refers to, so that pointers into it stay valid even after the context
+ * moved on, until the window is unpinned again or its file descriptor is freed. Returns NULL if the context
+ * has no window. */
+MMapWindow* mmap_cache_pin(MMapCache *m, unsigned context);
+void mmap_cache_unpin(MMapWindow *w);
+
+/* Unmaps all windows that are neither pinned nor referenced by a context. Returns the number of windows
+ * released. */
+unsigned mmap_cache_trim(MMapCache *m);
 
 bool mmap_cache_got_sigbus(MMapCache *m, MMapFileDescriptor *f);
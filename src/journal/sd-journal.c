@@ -29,11 +29,13 @@
 #include "journal-def.h"
 #include "journal-file.h"
 #include "journal-internal.h"
+#include "journal-manifest.h"
 #include "list.h"
 #include "lookup3.h"
 #include "nulstr-util.h"
 #include "path-util.h"
 #include "process-util.h"
+#include "sort-util.h"
 #include "replace-var.h"
 #include "stat-util.h"
 #include "stdio-util.h"
@@ -48,6 +50,33 @@
 
 #define DEFAULT_DATA_THRESHOLD (64*1024)
 
+/* With SD_JOURNAL_PARALLEL, how many threads read ahead, and how far */
+#define PREFETCH_WORKERS 4U
+#define PREFETCH_WINDOW (1024ULL*1024ULL)
+
+/* How much to read for each data object of the next entries. Most are much smaller. */
+#define PREFETCH_OBJECT_SIZE (8U*1024U)
+
+typedef struct DeferredFile {
+        char *path;
+        usec_t head_realtime;
+        usec_t tail_realtime;
+        unsigned last_seen_generation;
+} DeferredFile;
+
+static DeferredFile *deferred_file_free(DeferredFile *f) {
+        if (!f)
+                return NULL;
+
+        free(f->path);
+        return mfree(f);
+}
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(DeferredFile*, deferred_file_free);
+
+DEFINE_PRIVATE_HASH_OPS_WITH_VALUE_DESTRUCTOR(deferred_file_hash_ops, char, path_hash_func, path_compare,
+                                              DeferredFile, deferred_file_free);
+
 static void remove_file_real(sd_journal *j, JournalFile *f);
 
 static bool journal_pid_changed(sd_journal *j) {
@@ -101,12 +130,26 @@ static int journal_put_error(sd_journal *j, int r, const char *path) {
         return 0;
 }
 
+static void release_stable_data(sd_journal *j) {
+        assert(j);
+
+        /* Invalidates the pointers handed out by the _stable() data calls for the current entry */
+
+        if (j->current_file)
+                journal_file_unpin_objects(j->current_file);
+
+        for (; j->n_data_arena > 0; j->n_data_arena--)
+                free(j->data_arena[j->n_data_arena - 1]);
+}
+
 static void detach_location(sd_journal *j) {
         Iterator i;
         JournalFile *f;
 
         assert(j);
 
+        release_stable_data(j);
+
         j->current_file = NULL;
         j->current_field = 0;
 
@@ -145,6 +188,8 @@ static void set_location(sd_journal *j, JournalFile *f, Object *o) {
 
         init_location(&j->current_location, LOCATION_DISCRETE, f, o);
 
+        release_stable_data(j);
+
         j->current_file = f;
         j->current_field = 0;
 
@@ -574,6 +619,105 @@ static int next_for_match(
         return 1;
 }
 
+static int match_n_entries(JournalFile *f, Match *m, uint64_t *ret) {
+        uint64_t n;
+        Match *i;
+        int r;
+
+        assert(f);
+        assert(m);
+        assert(ret);
+
+        /* Returns an upper bound for the number of entries in the file the match can hit, taken from the
+         * entry counts of the data objects */
+
+        if (m->type == MATCH_DISCRETE) {
+                Object *d;
+
+                r = journal_file_find_data_object_with_hash(f, m->data, m->size, le64toh(m->le_hash), &d, NULL);
+                if (r < 0)
+                        return r;
+
+                *ret = r > 0 ? le64toh(d->data.n_entries) : 0;
+                return 0;
+        }
+
+        n = m->type == MATCH_OR_TERM || !m->matches ? 0 : UINT64_MAX;
+
+        LIST_FOREACH(matches, i, m->matches) {
+                uint64_t k;
+
+                r = match_n_entries(f, i, &k);
+                if (r < 0)
+                        return r;
+
+                if (m->type == MATCH_OR_TERM)
+                        n = k > UINT64_MAX - n ? UINT64_MAX : n + k;
+                else
+                        n = MIN(n, k);
+        }
+
+        *ret = n;
+        return 0;
+}
+
+typedef struct MatchCost {
+        Match *match;
+        uint64_t n_entries;
+} MatchCost;
+
+static int match_cost_compare(const MatchCost *a, const MatchCost *b) {
+        return CMP(a->n_entries, b->n_entries);
+}
+
+static int match_sort_by_selectivity(JournalFile *f, Match *m) {
+        _cleanup_free_ MatchCost *costs = NULL;
+        size_t n = 0, k;
+        Match *i;
+        int r;
+
+        assert(f);
+        assert(m);
+        assert(m->type == MATCH_AND_TERM);
+
+        /* next_for_match() starts each round of the intersection with the first term of an AND term, and
+         * bisects the others to catch up with it. Put the most selective term first, so that it drives the
+         * walk, instead of one that matches most entries anyway, like PRIORITY= often does. The order of the
+         * terms doesn't change the result, hence the list is simply reordered. Returns 0 if one of the terms
+         * matches nothing in this file, 1 otherwise. */
+
+        LIST_FOREACH(matches, i, m->matches)
+                n++;
+
+        if (n <= 1)
+                return 1;
+
+        costs = new(MatchCost, n);
+        if (!costs)
+                return -ENOMEM;
+
+        k = 0;
+        LIST_FOREACH(matches, i, m->matches) {
+                costs[k].match = i;
+
+                r = match_n_entries(f, i, &costs[k].n_entries);
+                if (r < 0)
+                        return r;
+                if (costs[k].n_entries == 0)
+                        return 0;
+
+                k++;
+        }
+
+        typesafe_qsort(costs, n, match_cost_compare);
+
+        LIST_HEAD_INIT(m->matches);
+        for (k = n; k > 0; k--)
+                LIST_PREPEND(matches, m->matches, costs[k-1].match);
+
+        return 1;
+}
+
 static int find_location_for_match(
                 sd_journal *j,
                 Match *m,
@@ -658,6 +802,10 @@ static int find_location_for_match(
                 if (!m->matches)
                         return 0;
 
+                r = match_sort_by_selectivity(f, m);
+                if (r <= 0)
+                        return r;
+
                 LIST_FOREACH(matches, i, m->matches) {
                         uint64_t cp;
 
@@ -802,6 +950,109 @@ static int next_beyond_location(sd_journal *j, JournalFile *f, direction_t direc
         }
 }
 
+static void journal_file_prefetch(sd_journal *j, JournalFile *f, direction_t direction) {
+        uint64_t begin, end, size;
+        bool in_range;
+        int r;
+
+        assert(j);
+        assert(f);
+
+        /* Entries, and the data objects they reference, are appended to the file in order, hence the
+         * entries following the current one are most likely located in the range right after it. Let's make
+         * sure a window of that is read in by the prefetch threads, while the merge step works on what is
+         * in memory already. */
+
+        if (!j->prefetch || f->current_offset <= 0)
+                return;
+
+        size = f->last_stat.st_size;
+        in_range = f->current_offset >= f->prefetch_begin && f->current_offset < f->prefetch_end;
+
+        if (direction == DIRECTION_DOWN) {
+                if (in_range && f->current_offset + PREFETCH_WINDOW / 2 <= f->prefetch_end)
+                        return;
+
+                begin = in_range ? f->prefetch_end : f->current_offset;
+                end = MIN(f->current_offset + PREFETCH_WINDOW, size);
+                if (begin >= end)
+                        return;
+
+                r = journal_prefetch_queue(j->prefetch, f->fd, begin, end - begin);
+                if (r < 0)
+                        return;
+
+                if (!in_range)
+                        f->prefetch_begin = f->current_offset;
+                f->prefetch_end = end;
+        } else {
+                if (in_range && f->current_offset >= f->prefetch_begin + PREFETCH_WINDOW / 2)
+                        return;
+
+                begin = f->current_offset > PREFETCH_WINDOW ? f->current_offset - PREFETCH_WINDOW : 0;
+                end = in_range ? f->prefetch_begin : f->current_offset;
+                if (begin >= end)
+                        return;
+
+                r = journal_prefetch_queue(j->prefetch, f->fd, begin, end - begin);
+                if (r < 0)
+                        return;
+
+                f->prefetch_begin = begin;
+                if (!in_range)
+                        f->prefetch_end = f->current_offset + 1;
+        }
+}
+
+static void journal_file_prefetch_entry(sd_journal *j, JournalFile *f) {
+        uint64_t n, i;
+        Object *o;
+        int r;
+
+        assert(j);
+        assert(f);
+
+        /* The data objects of an entry are deduplicated, and hence are usually located anywhere in the file,
+         * far away from the entry itself. Once we know which entry of the file comes next, ask the kernel
+         * to read all of its data objects at once, instead of faulting them in one after the other while
+         * the entry is processed. This doesn't block, and all reads are in flight in parallel. */
+
+        if (!j->prefetch || f->current_offset <= 0 || f->current_offset == f->prefetch_entry_offset)
+                return;
+
+        f->prefetch_entry_offset = f->current_offset;
+
+        r = journal_file_move_to_object(f, OBJECT_ENTRY, f->current_offset, &o);
+        if (r < 0)
+                return;
+
+        n = journal_file_entry_n_items(o);
+        for (i = 0; i < n; i++) {
+                uint64_t q = le64toh(o->entry.items[i].object_offset);
+
+                /* Already covered by the window read ahead by the prefetch threads? */
+                if (q >= f->prefetch_begin && q < f->prefetch_end)
+                        continue;
+
+                (void) posix_fadvise(f->fd, q & ~((uint64_t) page_size() - 1), PREFETCH_OBJECT_SIZE, POSIX_FADV_WILLNEED);
+        }
+}
+
+static void journal_setup_prefetch(sd_journal *j) {
+        int r;
+
+        assert(j);
+
+        if (!(j->flags & SD_JOURNAL_PARALLEL) || j->prefetch || j->prefetch_failed)
+                return;
+
+        r = journal_prefetch_new(PREFETCH_WORKERS, &j->prefetch);
+        if (r < 0) {
+                log_debug_errno(r, "Failed to start prefetch threads, reading files serially: %m");
+                j->prefetch_failed = true;
+        }
+}
+
 static int real_journal_next(sd_journal *j, direction_t direction) {
         JournalFile *new_file = NULL;
         unsigned i, n_files;
@@ -812,10 +1063,16 @@ static int real_journal_next(sd_journal *j, direction_t direction) {
         assert_return(j, -EINVAL);
         assert_return(!journal_pid_changed(j), -ECHILD);
 
+        r = journal_open_deferred_files(j);
+        if (r < 0)
+                return r;
+
         r = iterated_cache_get(j->files_cache, NULL, &files, &n_files);
         if (r < 0)
                 return r;
 
+        journal_setup_prefetch(j);
+
         for (i = 0; i < n_files; i++) {
                 JournalFile *f = (JournalFile *)files[i];
                 bool found;
@@ -830,6 +1087,9 @@ static int real_journal_next(sd_journal *j, direction_t direction) {
                         continue;
                 }
 
+                journal_file_prefetch(j, f, direction);
+                journal_file_prefetch_entry(j, f);
+
                 if (!new_file)
                         found = true;
                 else {
@@ -1290,6 +1550,9 @@ static int add_any_file(
                 goto finish;
         }
 
+        /* If we deferred opening this file, that's done now */
+        deferred_file_free(hashmap_remove(j->deferred_files, path));
+
         f = ordered_hashmap_get(j->files, path);
         if (f) {
                 if (f->last_stat.st_dev == st.st_dev &&
@@ -1379,6 +1642,40 @@ static int add_file_by_name(
         return add_any_file(j, -1, path);
 }
 
+static int refresh_file_by_name(
+                sd_journal *j,
+                const char *prefix,
+                const char *filename) {
+
+        const char *path;
+        JournalFile *f;
+
+        assert(j);
+        assert(prefix);
+        assert(filename);
+
+        /* Content and attribute changes never replace the file, hence if we track it already there's no need
+         * to open and stat it again, which would be done by every reader for every change otherwise. New
+         * entries are noticed by checking the header while iterating. */
+
+        path = prefix_roota(prefix, filename);
+        f = ordered_hashmap_get(j->files, path);
+        if (!f) {
+                DeferredFile *d;
+
+                d = hashmap_get(j->deferred_files, path);
+                if (d) {
+                        d->last_seen_generation = j->generation;
+                        return 0;
+                }
+
+                return add_file_by_name(j, prefix, filename);
+        }
+
+        f->last_seen_generation = j->generation;
+        return 0;
+}
+
 static void remove_file_by_name(
                 sd_journal *j,
                 const char *prefix,
@@ -1392,6 +1689,9 @@ static void remove_file_by_name(
         assert(filename);
 
         path = prefix_roota(prefix, filename);
+
+        deferred_file_free(hashmap_remove(j->deferred_files, path));
+
         f = ordered_hashmap_get(j->files, path);
         if (!f)
                 return;
@@ -1408,6 +1708,7 @@ static void remove_file_real(sd_journal *j, JournalFile *f) {
         log_debug("File %s removed.", f->path);
 
         if (j->current_file == f) {
+                /* Closing the file unpins its windows, the decompressed data stays around */
                 j->current_file = NULL;
                 j->current_field = 0;
         }
@@ -1488,16 +1789,98 @@ static int directory_open(sd_journal *j, const char *path, DIR **ret) {
 
 static int add_directory(sd_journal *j, const char *prefix, const char *dirname);
 
+static int defer_file_by_name(
+                sd_journal *j,
+                const char *prefix,
+                const struct dirent *de,
+                Hashmap *manifest) {
+
+        _cleanup_(deferred_file_freep) DeferredFile *n = NULL;
+        JournalManifestEntry *e;
+        DeferredFile *f;
+        const char *path;
+        int r;
+
+        assert(j);
+        assert(prefix);
+        assert(de);
+
+        /* Returns > 0 if the file is listed in the manifest, and hence doesn't need to be opened now */
+
+        if (j->no_new_files)
+                return 0;
+
+        if (!file_type_wanted(j->flags, de->d_name))
+                return 0;
+
+        path = prefix_roota(prefix, de->d_name);
+
+        /* Files we opened already are dealt with like all others */
+        if (ordered_hashmap_contains(j->files, path))
+                return 0;
+
+        f = hashmap_get(j->deferred_files, path);
+
+        e = hashmap_get(manifest, de->d_name);
+        if (!e || e->inode != de->d_ino) {
+                /* Not listed (anymore), or replaced by a different file. */
+                deferred_file_free(hashmap_remove(j->deferred_files, path));
+                return 0;
+        }
+
+        if (f) {
+                f->last_seen_generation = j->generation;
+                return 1;
+        }
+
+        r = hashmap_ensure_allocated(&j->deferred_files, &deferred_file_hash_ops);
+        if (r < 0)
+                return r;
+
+        n = new(DeferredFile, 1);
+        if (!n)
+                return -ENOMEM;
+
+        *n = (DeferredFile) {
+                .head_realtime = e->head_realtime,
+                .tail_realtime = e->tail_realtime,
+                .last_seen_generation = j->generation,
+        };
+
+        n->path = strdup(path);
+        if (!n->path)
+                return -ENOMEM;
+
+        r = hashmap_put(j->deferred_files, n->path, n);
+        if (r < 0)
+                return r;
+
+        TAKE_PTR(n);
+        j->deferred_pending = true;
+
+        log_debug("File %s deferred.", path);
+        return 1;
+}
+
 static void directory_enumerate(sd_journal *j, Directory *m, DIR *d) {
+        _cleanup_hashmap_free_ Hashmap *manifest = NULL;
         struct dirent *de;
+        int r;
 
         assert(j);
         assert(m);
         assert(d);
 
+        /* If journald listed its archived files, they aren't opened before they are needed, and maybe not at
+         * all, if they don't cover the time range the caller is interested in. */
+        r = journal_manifest_load(dirfd(d), &manifest);
+        if (r < 0 && r != -ENOENT)
+                log_debug_errno(r, "Failed to read journal manifest of %s, ignoring: %m", m->path);
+
         FOREACH_DIRENT_ALL(de, d, goto fail) {
 
-                if (dirent_is_journal_file(de))
+                if (dirent_is_journal_file(de) &&
+                    defer_file_by_name(j, m->path, de, manifest) <= 0)
                         (void) add_file_by_name(j, m->path, de->d_name);
 
                 if (m->is_root && dirent_is_id128_subdir(de))
@@ -1815,6 +2198,7 @@ static sd_journal *journal_new(int flags, const char *path) {
         j->inotify_fd = -1;
         j->flags = flags;
         j->data_threshold = DEFAULT_DATA_THRESHOLD;
+        j->realtime_until = USEC_INFINITY;
 
         if (path) {
                 char *t;
@@ -1845,7 +2229,8 @@ static sd_journal *journal_new(int flags, const char *path) {
 #define OPEN_ALLOWED_FLAGS                              \
         (SD_JOURNAL_LOCAL_ONLY |                        \
          SD_JOURNAL_RUNTIME_ONLY |                      \
-         SD_JOURNAL_SYSTEM | SD_JOURNAL_CURRENT_USER)
+         SD_JOURNAL_SYSTEM | SD_JOURNAL_CURRENT_USER |  \
+         SD_JOURNAL_PARALLEL)
 
 _public_ int sd_journal_open(sd_journal **ret, int flags) {
         _cleanup_(sd_journal_closep) sd_journal *j = NULL;
@@ -1911,7 +2296,8 @@ _public_ int sd_journal_open_container(sd_journal **ret, const char *machine, in
 
 #define OPEN_DIRECTORY_ALLOWED_FLAGS                    \
         (SD_JOURNAL_OS_ROOT |                           \
-         SD_JOURNAL_SYSTEM | SD_JOURNAL_CURRENT_USER )
+         SD_JOURNAL_SYSTEM | SD_JOURNAL_CURRENT_USER |  \
+         SD_JOURNAL_PARALLEL)
 
 _public_ int sd_journal_open_directory(sd_journal **ret, const char *path, int flags) {
         _cleanup_(sd_journal_closep) sd_journal *j = NULL;
@@ -1936,13 +2322,16 @@ _public_ int sd_journal_open_directory(sd_journal **ret, const char *path, int f
         return 0;
 }
 
+#define OPEN_FILES_ALLOWED_FLAGS                        \
+        (SD_JOURNAL_PARALLEL)
+
 _public_ int sd_journal_open_files(sd_journal **ret, const char **paths, int flags) {
         _cleanup_(sd_journal_closep) sd_journal *j = NULL;
         const char **path;
         int r;
 
         assert_return(ret, -EINVAL);
-        assert_return(flags == 0, -EINVAL);
+        assert_return((flags & ~OPEN_FILES_ALLOWED_FLAGS) == 0, -EINVAL);
 
         j = journal_new(flags, NULL);
         if (!j)
@@ -1962,7 +2351,8 @@ _public_ int sd_journal_open_files(sd_journal **ret, const char **paths, int fla
 
 #define OPEN_DIRECTORY_FD_ALLOWED_FLAGS         \
         (SD_JOURNAL_OS_ROOT |                           \
-         SD_JOURNAL_SYSTEM | SD_JOURNAL_CURRENT_USER )
+         SD_JOURNAL_SYSTEM | SD_JOURNAL_CURRENT_USER |  \
+         SD_JOURNAL_PARALLEL)
 
 _public_ int sd_journal_open_directory_fd(sd_journal **ret, int fd, int flags) {
         _cleanup_(sd_journal_closep) sd_journal *j = NULL;
@@ -2005,7 +2395,7 @@ _public_ int sd_journal_open_files_fd(sd_journal **ret, int fds[], unsigned n_fd
 
         assert_return(ret, -EINVAL);
         assert_return(n_fds > 0, -EBADF);
-        assert_return(flags == 0, -EINVAL);
+        assert_return((flags & ~OPEN_FILES_ALLOWED_FLAGS) == 0, -EINVAL);
 
         j = journal_new(flags, NULL);
         if (!j)
@@ -2056,8 +2446,11 @@ _public_ void sd_journal_close(sd_journal *j) {
 
         sd_journal_flush_matches(j);
 
+        journal_prefetch_free(j->prefetch);
+
         ordered_hashmap_free_with_destructor(j->files, journal_file_close);
         iterated_cache_free(j->files_cache);
+        hashmap_free(j->deferred_files);
 
         while ((d = hashmap_first(j->directories_by_path)))
                 remove_directory(j, d);
@@ -2071,7 +2464,8 @@ _public_ void sd_journal_close(sd_journal *j) {
         safe_close(j->inotify_fd);
 
         if (j->mmap) {
-                log_debug("mmap cache statistics: %u hit, %u miss", mmap_cache_get_hit(j->mmap), mmap_cache_get_missed(j->mmap));
+                log_debug("mmap cache statistics: %u hit, %u miss, %u evicted",
+                          mmap_cache_get_hit(j->mmap), mmap_cache_get_missed(j->mmap), mmap_cache_get_evicted(j->mmap));
                 mmap_cache_unref(j->mmap);
         }
 
@@ -2081,6 +2475,12 @@ _public_ void sd_journal_close(sd_journal *j) {
         free(j->prefix);
         free(j->unique_field);
         free(j->fields_buffer);
+        free(j->boots);
+
+        for (; j->n_data_arena > 0; j->n_data_arena--)
+                free(j->data_arena[j->n_data_arena - 1]);
+        free(j->data_arena);
+
         free(j);
 }
 
@@ -2173,19 +2573,50 @@ static bool field_is_valid(const char *field) {
         return true;
 }
 
-_public_ int sd_journal_get_data(sd_journal *j, const char *field, const void **data, size_t *size) {
+#if HAVE_XZ || HAVE_LZ4 || HAVE_ZSTD
+static int decompress_stable(
+                sd_journal *j,
+                JournalFile *f,
+                int compression,
+                const void *src,
+                uint64_t src_size,
+                const void **data,
+                size_t *size) {
+
+        _cleanup_free_ void *buffer = NULL;
+        size_t buffer_size = 0, rsize;
+        int r;
+
+        assert(j);
+        assert(f);
+
+        /* Decompresses into a buffer of its own, which is kept until the read pointer moves to another entry */
+
+        if (!GREEDY_REALLOC(j->data_arena, j->data_arena_allocated, j->n_data_arena + 1))
+                return -ENOMEM;
+
+        r = journal_file_decompress_blob(f, compression, src, src_size, &buffer, &buffer_size, &rsize, j->data_threshold);
+        if (r < 0)
+                return r;
+
+        *data = j->data_arena[j->n_data_arena++] = TAKE_PTR(buffer);
+        *size = rsize;
+
+        return 0;
+}
+#endif
+
+static int get_data(sd_journal *j, const char *field, bool stable, const void **data, size_t *size) {
         JournalFile *f;
         uint64_t i, n;
         size_t field_length;
         int r;
         Object *o;
 
-        assert_return(j, -EINVAL);
-        assert_return(!journal_pid_changed(j), -ECHILD);
-        assert_return(field, -EINVAL);
-        assert_return(data, -EINVAL);
-        assert_return(size, -EINVAL);
-        assert_return(field_is_valid(field), -EINVAL);
+        assert(j);
+        assert(field);
+        assert(data);
+        assert(size);
 
         f = j->current_file;
         if (!f)
@@ -2220,11 +2651,11 @@ _public_ int sd_journal_get_data(sd_journal *j, const char *field, const void **
 
                 compression = o->object.flags & OBJECT_COMPRESSION_MASK;
                 if (compression) {
-#if HAVE_XZ || HAVE_LZ4
-                        r = decompress_startswith(compression,
-                                                  o->data.payload, l,
-                                                  &f->compress_buffer, &f->compress_buffer_size,
-                                                  field, field_length, '=');
+#if HAVE_XZ || HAVE_LZ4 || HAVE_ZSTD
+                        r = journal_file_decompress_startswith(f, compression,
+                                                               o->data.payload, l,
+                                                               &f->compress_buffer, &f->compress_buffer_size,
+                                                               field, field_length, '=');
                         if (r < 0)
                                 log_debug_errno(r, "Cannot decompress %s object of length %"PRIu64" at offset "OFSfmt": %m",
                                                 object_compressed_to_string(compression), l, p);
@@ -2232,10 +2663,13 @@ _public_ int sd_journal_get_data(sd_journal *j, const char *field, const void **
 
                                 size_t rsize;
 
-                                r = decompress_blob(compression,
-                                                    o->data.payload, l,
-                                                    &f->compress_buffer, &f->compress_buffer_size, &rsize,
-                                                    j->data_threshold);
+                                if (stable)
+                                        return decompress_stable(j, f, compression, o->data.payload, l, data, size);
+
+                                r = journal_file_decompress_blob(f, compression,
+                                                                 o->data.payload, l,
+                                                                 &f->compress_buffer, &f->compress_buffer_size, &rsize,
+                                                                 j->data_threshold);
                                 if (r < 0)
                                         return r;
 
@@ -2256,6 +2690,12 @@ _public_ int sd_journal_get_data(sd_journal *j, const char *field, const void **
                         if ((uint64_t) t != l)
                                 return -E2BIG;
 
+                        if (stable) {
+                                r = journal_file_pin_object(f, OBJECT_DATA);
+                                if (r < 0)
+                                        return r;
+                        }
+
                         *data = o->data.payload;
                         *size = t;
 
@@ -2270,7 +2710,29 @@ _public_ int sd_journal_get_data(sd_journal *j, const char *field, const void **
         return -ENOENT;
 }
 
-static int return_data(sd_journal *j, JournalFile *f, Object *o, const void **data, size_t *size) {
+_public_ int sd_journal_get_data(sd_journal *j, const char *field, const void **data, size_t *size) {
+        assert_return(j, -EINVAL);
+        assert_return(!journal_pid_changed(j), -ECHILD);
+        assert_return(field, -EINVAL);
+        assert_return(data, -EINVAL);
+        assert_return(size, -EINVAL);
+        assert_return(field_is_valid(field), -EINVAL);
+
+        return get_data(j, field, false, data, size);
+}
+
+_public_ int sd_journal_get_data_stable(sd_journal *j, const char *field, const void **data, size_t *size) {
+        assert_return(j, -EINVAL);
+        assert_return(!journal_pid_changed(j), -ECHILD);
+        assert_return(field, -EINVAL);
+        assert_return(data, -EINVAL);
+        assert_return(size, -EINVAL);
+        assert_return(field_is_valid(field), -EINVAL);
+
+        return get_data(j, field, true, data, size);
+}
+
+static int return_data(sd_journal *j, JournalFile *f, Object *o, bool stable, const void **data, size_t *size) {
         size_t t;
         uint64_t l;
         int compression;
@@ -2284,13 +2746,16 @@ static int return_data(sd_journal *j, JournalFile *f, Object *o, const void **da
 
         compression = o->object.flags & OBJECT_COMPRESSION_MASK;
         if (compression) {
-#if HAVE_XZ || HAVE_LZ4
+#if HAVE_XZ || HAVE_LZ4 || HAVE_ZSTD
                 size_t rsize;
                 int r;
 
-                r = decompress_blob(compression,
-                                    o->data.payload, l, &f->compress_buffer,
-                                    &f->compress_buffer_size, &rsize, j->data_threshold);
+                if (stable)
+                        return decompress_stable(j, f, compression, o->data.payload, l, data, size);
+
+                r = journal_file_decompress_blob(f, compression,
+                                                 o->data.payload, l, &f->compress_buffer,
+                                                 &f->compress_buffer_size, &rsize, j->data_threshold);
                 if (r < 0)
                         return r;
 
@@ -2300,6 +2765,14 @@ static int return_data(sd_journal *j, JournalFile *f, Object *o, const void **da
                 return -EPROTONOSUPPORT;
 #endif
         } else {
+                if (stable) {
+                        int r;
+
+                        r = journal_file_pin_object(f, OBJECT_DATA);
+                        if (r < 0)
+                                return r;
+                }
+
                 *data = o->data.payload;
                 *size = t;
         }
@@ -2307,17 +2780,16 @@ static int return_data(sd_journal *j, JournalFile *f, Object *o, const void **da
         return 0;
 }
 
-_public_ int sd_journal_enumerate_data(sd_journal *j, const void **data, size_t *size) {
+static int enumerate_data(sd_journal *j, bool stable, const void **data, size_t *size) {
         JournalFile *f;
         uint64_t p, n;
         le64_t le_hash;
         int r;
         Object *o;
 
-        assert_return(j, -EINVAL);
-        assert_return(!journal_pid_changed(j), -ECHILD);
-        assert_return(data, -EINVAL);
-        assert_return(size, -EINVAL);
+        assert(j);
+        assert(data);
+        assert(size);
 
         f = j->current_file;
         if (!f)
@@ -2343,7 +2815,7 @@ _public_ int sd_journal_enumerate_data(sd_journal *j, const void **data, size_t
         if (le_hash != o->data.hash)
                 return -EBADMSG;
 
-        r = return_data(j, f, o, data, size);
+        r = return_data(j, f, o, stable, data, size);
         if (r < 0)
                 return r;
 
@@ -2352,6 +2824,24 @@ _public_ int sd_journal_enumerate_data(sd_journal *j, const void **data, size_t
         return 1;
 }
 
+_public_ int sd_journal_enumerate_data(sd_journal *j, const void **data, size_t *size) {
+        assert_return(j, -EINVAL);
+        assert_return(!journal_pid_changed(j), -ECHILD);
+        assert_return(data, -EINVAL);
+        assert_return(size, -EINVAL);
+
+        return enumerate_data(j, false, data, size);
+}
+
+_public_ int sd_journal_enumerate_data_stable(sd_journal *j, const void **data, size_t *size) {
+        assert_return(j, -EINVAL);
+        assert_return(!journal_pid_changed(j), -ECHILD);
+        assert_return(data, -EINVAL);
+        assert_return(size, -EINVAL);
+
+        return enumerate_data(j, true, data, size);
+}
+
 _public_ void sd_journal_restart_data(sd_journal *j) {
         if (!j)
                 return;
@@ -2440,6 +2930,7 @@ _public_ int sd_journal_get_timeout(sd_journal *j, uint64_t *timeout_usec) {
 }
 
 static void process_q_overflow(sd_journal *j) {
+        DeferredFile *d;
         JournalFile *f;
         Directory *m;
         Iterator i;
@@ -2465,6 +2956,15 @@ static void process_q_overflow(sd_journal *j) {
                 remove_file_real(j, f);
         }
 
+        HASHMAP_FOREACH(d, j->deferred_files, i) {
+
+                if (d->last_seen_generation == j->generation)
+                        continue;
+
+                log_debug("File '%s' hasn't been seen in this enumeration, forgetting it.", d->path);
+                deferred_file_free(hashmap_remove(j->deferred_files, d->path));
+        }
+
         HASHMAP_FOREACH(m, j->directories_by_path, i) {
 
                 if (m->last_seen_generation == j->generation)
@@ -2500,8 +3000,10 @@ static void process_inotify_event(sd_journal *j, struct inotify_event *e) {
 
                         /* Event for a journal file */
 
-                        if (e->mask & (IN_CREATE|IN_MOVED_TO|IN_MODIFY|IN_ATTRIB))
+                        if (e->mask & (IN_CREATE|IN_MOVED_TO))
                                 (void) add_file_by_name(j, d->path, e->name);
+                        else if (e->mask & (IN_MODIFY|IN_ATTRIB))
+                                (void) refresh_file_by_name(j, d->path, e->name);
                         else if (e->mask & (IN_DELETE|IN_MOVED_FROM|IN_UNMOUNT))
                                 remove_file_by_name(j, d->path, e->name);
 
@@ -2630,6 +3132,10 @@ _public_ int sd_journal_get_cutoff_realtime_usec(sd_journal *j, uint64_t *from,
         assert_return(from || to, -EINVAL);
         assert_return(from != to, -EINVAL);
 
+        r = journal_open_deferred_files(j);
+        if (r < 0)
+                return r;
+
         ORDERED_HASHMAP_FOREACH(f, j->files, i) {
                 usec_t fr, t;
 
@@ -2670,6 +3176,10 @@ _public_ int sd_journal_get_cutoff_monotonic_usec(sd_journal *j, sd_id128_t boot
         assert_return(from || to, -EINVAL);
         assert_return(from != to, -EINVAL);
 
+        r = journal_open_deferred_files(j);
+        if (r < 0)
+                return r;
+
         ORDERED_HASHMAP_FOREACH(f, j->files, i) {
                 usec_t fr, t;
 
@@ -2705,6 +3215,8 @@ void journal_print_header(sd_journal *j) {
 
         assert(j);
 
+        (void) journal_open_deferred_files(j);
+
         ORDERED_HASHMAP_FOREACH(f, j->files, i) {
                 if (newline)
                         putchar('\n');
@@ -2713,17 +3225,36 @@ void journal_print_header(sd_journal *j) {
 
                 journal_file_print_header(f);
         }
+
+        if (newline)
+                putchar('\n');
+
+        /* Reading the headers above went through the cache too, but this is still useful to see how
+         * reading behaved when combined with other options */
+        printf("MMap cache hits: %u\n"
+               "MMap cache misses: %u\n"
+               "MMap cache evictions: %u\n"
+               "MMap cache windows: %u\n",
+               mmap_cache_get_hit(j->mmap),
+               mmap_cache_get_missed(j->mmap),
+               mmap_cache_get_evicted(j->mmap),
+               mmap_cache_get_n_windows(j->mmap));
 }
 
 _public_ int sd_journal_get_usage(sd_journal *j, uint64_t *bytes) {
         Iterator i;
         JournalFile *f;
         uint64_t sum = 0;
+        int r;
 
         assert_return(j, -EINVAL);
         assert_return(!journal_pid_changed(j), -ECHILD);
         assert_return(bytes, -EINVAL);
 
+        r = journal_open_deferred_files(j);
+        if (r < 0)
+                return r;
+
         ORDERED_HASHMAP_FOREACH(f, j->files, i) {
                 struct stat st;
 
@@ -2760,6 +3291,7 @@ _public_ int sd_journal_query_unique(sd_journal *j, const char *field) {
 
 _public_ int sd_journal_enumerate_unique(sd_journal *j, const void **data, size_t *l) {
         size_t k;
+        int r;
 
         assert_return(j, -EINVAL);
         assert_return(!journal_pid_changed(j), -ECHILD);
@@ -2773,6 +3305,10 @@ _public_ int sd_journal_enumerate_unique(sd_journal *j, const void **data, size_
                 if (j->unique_file_lost)
                         return 0;
 
+                r = journal_open_deferred_files(j);
+                if (r < 0)
+                        return r;
+
                 j->unique_file = ordered_hashmap_first(j->files);
                 if (!j->unique_file)
                         return 0;
@@ -2828,7 +3364,7 @@ _public_ int sd_journal_enumerate_unique(sd_journal *j, const void **data, size_
                                                j->unique_offset,
                                                o->object.type, OBJECT_DATA);
 
-                r = return_data(j, j->unique_file, o, &odata, &ol);
+                r = return_data(j, j->unique_file, o, false, &odata, &ol);
                 if (r < 0)
                         return r;
 
@@ -2870,7 +3406,7 @@ _public_ int sd_journal_enumerate_unique(sd_journal *j, const void **data, size_
                 if (found)
                         continue;
 
-                r = return_data(j, j->unique_file, o, data, l);
+                r = return_data(j, j->unique_file, o, false, data, l);
                 if (r < 0)
                         return r;
 
@@ -2878,6 +3414,61 @@ _public_ int sd_journal_enumerate_unique(sd_journal *j, const void **data, size_
         }
 }
 
+int journal_unique_n_entries(sd_journal *j, uint64_t *ret) {
+        JournalFile *of;
+        const void *odata;
+        uint64_t n, hash;
+        size_t ol;
+        Iterator i;
+        Object *o;
+        bool after = false;
+        int r;
+
+        assert(j);
+        assert(ret);
+
+        /* Returns the number of entries referencing the value last returned by sd_journal_enumerate_unique(),
+         * summed up over all files, as recorded in the data objects. Files traversed before the current one
+         * don't carry the value, as it wouldn't have been returned otherwise. */
+
+        if (!j->unique_file || j->unique_offset == 0)
+                return -EADDRNOTAVAIL;
+
+        r = journal_file_move_to_object(j->unique_file, OBJECT_UNUSED, j->unique_offset, &o);
+        if (r < 0)
+                return r;
+        if (o->object.type != OBJECT_DATA)
+                return -EBADMSG;
+
+        n = le64toh(o->data.n_entries);
+        hash = le64toh(o->data.hash);
+
+        r = return_data(j, j->unique_file, o, false, &odata, &ol);
+        if (r < 0)
+                return r;
+
+        ORDERED_HASHMAP_FOREACH(of, j->files, i) {
+                Object *d;
+
+                if (!after) {
+                        after = of == j->unique_file;
+                        continue;
+                }
+
+                if (JOURNAL_HEADER_CONTAINS(of->header, n_fields) && le64toh(of->header->n_fields) <= 0)
+                        continue;
+
+                r = journal_file_find_data_object_with_hash(of, odata, ol, hash, &d, NULL);
+                if (r < 0)
+                        return r;
+                if (r > 0)
+                        n += le64toh(d->data.n_entries);
+        }
+
+        *ret = n;
+        return 0;
+}
+
 _public_ void sd_journal_restart_unique(sd_journal *j) {
         if (!j)
                 return;
@@ -2898,6 +3489,10 @@ _public_ int sd_journal_enumerate_fields(sd_journal *j, const char **field) {
                 if (j->fields_file_lost)
                         return 0;
 
+                r = journal_open_deferred_files(j);
+                if (r < 0)
+                        return r;
+
                 j->fields_file = ordered_hashmap_first(j->files);
                 if (!j->fields_file)
                         return 0;
@@ -3121,14 +3716,167 @@ _public_ int sd_journal_get_data_threshold(sd_journal *j, size_t *sz) {
         return 0;
 }
 
+static int boot_range_compare_id(const JournalBootRange *a, const JournalBootRange *b) {
+        return memcmp(&a->boot_id, &b->boot_id, sizeof(a->boot_id));
+}
+
+static int boot_range_compare_time(const JournalBootRange *a, const JournalBootRange *b) {
+        int r;
+
+        r = CMP(a->first_realtime, b->first_realtime);
+        if (r != 0)
+                return r;
+
+        return CMP(a->last_realtime, b->last_realtime);
+}
+
+static int load_boots(sd_journal *j) {
+        size_t i, n = 0;
+        JournalFile *f;
+        Iterator it;
+        int r;
+
+        assert(j);
+
+        r = journal_open_deferred_files(j);
+        if (r < 0)
+                return r;
+
+        ORDERED_HASHMAP_FOREACH(f, j->files, it) {
+                r = journal_file_get_boots(f, &j->boots, &j->n_boots_allocated, &j->n_boots);
+                if (r == -ENOMEM)
+                        return r;
+                if (r < 0)
+                        log_debug_errno(r, "Failed to determine boots in %s, ignoring: %m", f->path);
+        }
+
+        /* Merge what the files told us about each boot, and put them in chronological order */
+        typesafe_qsort(j->boots, j->n_boots, boot_range_compare_id);
+
+        for (i = 0; i < j->n_boots; i++) {
+                if (n > 0 && sd_id128_equal(j->boots[n-1].boot_id, j->boots[i].boot_id)) {
+                        j->boots[n-1].first_realtime = MIN(j->boots[n-1].first_realtime, j->boots[i].first_realtime);
+                        j->boots[n-1].last_realtime = MAX(j->boots[n-1].last_realtime, j->boots[i].last_realtime);
+                } else
+                        j->boots[n++] = j->boots[i];
+        }
+
+        j->n_boots = n;
+        typesafe_qsort(j->boots, j->n_boots, boot_range_compare_time);
+
+        j->boots_loaded = true;
+        return 0;
+}
+
+_public_ int sd_journal_enumerate_boots(sd_journal *j, sd_id128_t *ret_boot_id, uint64_t *ret_first, uint64_t *ret_last) {
+        JournalBootRange *b;
+        int r;
+
+        assert_return(j, -EINVAL);
+        assert_return(!journal_pid_changed(j), -ECHILD);
+
+        if (!j->boots_loaded) {
+                r = load_boots(j);
+                if (r < 0) {
+                        sd_journal_restart_boots(j);
+                        return r;
+                }
+        }
+
+        if (j->boots_index >= j->n_boots)
+                return 0;
+
+        b = j->boots + j->boots_index++;
+
+        if (ret_boot_id)
+                *ret_boot_id = b->boot_id;
+        if (ret_first)
+                *ret_first = b->first_realtime;
+        if (ret_last)
+                *ret_last = b->last_realtime;
+
+        return 1;
+}
+
+_public_ void sd_journal_restart_boots(sd_journal *j) {
+        if (!j)
+                return;
+
+        j->boots = mfree(j->boots);
+        j->n_boots = j->n_boots_allocated = j->boots_index = 0;
+        j->boots_loaded = false;
+}
+
 _public_ int sd_journal_has_runtime_files(sd_journal *j) {
         assert_return(j, -EINVAL);
 
+        (void) journal_open_deferred_files(j);
+
         return j->has_runtime_files;
 }
 
 _public_ int sd_journal_has_persistent_files(sd_journal *j) {
         assert_return(j, -EINVAL);
 
+        (void) journal_open_deferred_files(j);
+
         return j->has_persistent_files;
 }
+
+void journal_set_realtime_range(sd_journal *j, usec_t since, usec_t until) {
+        assert(j);
+
+        if (j->realtime_since == since && j->realtime_until == until)
+                return;
+
+        j->realtime_since = since;
+        j->realtime_until = until;
+
+        /* Files skipped so far might be in range now */
+        j->deferred_pending = true;
+}
+
+static bool deferred_file_in_range(sd_journal *j, DeferredFile *f) {
+        assert(j);
+        assert(f);
+
+        /* Entries are written in order of their realtime timestamps, unless the clock was changed. Seeking by
+         * realtime assumes the same, hence there's no point in looking at a file whose entries are all outside of
+         * the range. */
+
+        return f->tail_realtime >= j->realtime_since &&
+                f->head_realtime <= j->realtime_until;
+}
+
+int journal_open_deferred_files(sd_journal *j) {
+        unsigned n_opened = 0, n_skipped = 0;
+        DeferredFile *f;
+        Iterator i;
+
+        assert(j);
+
+        if (!j->deferred_pending)
+                return 0;
+
+        HASHMAP_FOREACH(f, j->deferred_files, i) {
+                _cleanup_(deferred_file_freep) DeferredFile *taken = NULL;
+
+                if (!deferred_file_in_range(j, f)) {
+                        n_skipped++;
+                        continue;
+                }
+
+                /* Errors are recorded in j->errors, like for any other file we fail to open */
+                taken = hashmap_remove(j->deferred_files, f->path);
+                (void) add_any_file(j, -1, taken->path);
+                n_opened++;
+        }
+
+        j->deferred_pending = false;
+
+        if (n_opened > 0 || n_skipped > 0)
+                log_debug("Opened %u deferred journal files, skipped %u outside of the requested time range.",
+                          n_opened, n_skipped);
+
+        return 0;
+}
@@ -0,0 +1,307 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "sd-journal.h"
+
+#include "alloc-util.h"
+#include "io-util.h"
+#include "journal-file.h"
+#include "journal-internal.h"
+#include "json.h"
+#include "macro.h"
+#include "mmap-cache.h"
+#include "parse-util.h"
+#include "rm-rf.h"
+#include "stdio-util.h"
+#include "string-util.h"
+#include "strv.h"
+#include "tests.h"
+#include "time-util.h"
+
+/* Generates a stream of entries that look roughly like what journald writes, appends them to a journal file,
+ * reads them back and prints the results as JSON, so that runs of different versions can be compared. Usage:
+ *
+ *     test-journal-benchmark [ENTRIES [CARDINALITY]]
+ *
+ * CARDINALITY is the number of distinct values for the unit-related fields. */
+
+#define N_GROWTH_SAMPLES 10U
+#define LARGE_MESSAGE_EVERY 64U
+#define LARGE_MESSAGE_SIZE 4096U
+
+static unsigned arg_entries;
+static unsigned arg_cardinality = 64;
+
+/* A fixed seed, so that subsequent runs of the benchmark generate the same entries */
+static uint64_t benchmark_random(void) {
+        static uint64_t state = UINT64_C(0x9e3779b97f4a7c15);
+
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+
+        return state;
+}
+
+typedef struct Phase {
+        usec_t usec;
+        uint64_t n_entries;
+        uint64_t n_bytes;
+        unsigned n_hit;
+        unsigned n_missed;
+        unsigned n_evicted;
+} Phase;
+
+static int phase_to_json(const Phase *p, JsonVariant **ret) {
+        double dt, hit_rate;
+
+        assert(p);
+        assert(ret);
+
+        dt = MAX(p->usec, 1U) / (double) USEC_PER_SEC;
+        hit_rate = p->n_hit + p->n_missed > 0 ? (double) p->n_hit / (p->n_hit + p->n_missed) : 0;
+
+        return json_build(ret, JSON_BUILD_OBJECT(
+                                  JSON_BUILD_PAIR("usec", JSON_BUILD_UNSIGNED(p->usec)),
+                                  JSON_BUILD_PAIR("entries", JSON_BUILD_UNSIGNED(p->n_entries)),
+                                  JSON_BUILD_PAIR("bytes", JSON_BUILD_UNSIGNED(p->n_bytes)),
+                                  JSON_BUILD_PAIR("entries_per_sec", JSON_BUILD_REAL(p->n_entries / dt)),
+                                  JSON_BUILD_PAIR("bytes_per_sec", JSON_BUILD_REAL(p->n_bytes / dt)),
+                                  JSON_BUILD_PAIR("mmap_cache", JSON_BUILD_OBJECT(
+                                                                  JSON_BUILD_PAIR("hit", JSON_BUILD_UNSIGNED(p->n_hit)),
+                                                                  JSON_BUILD_PAIR("missed", JSON_BUILD_UNSIGNED(p->n_missed)),
+                                                                  JSON_BUILD_PAIR("evicted", JSON_BUILD_UNSIGNED(p->n_evicted)),
+                                                                  JSON_BUILD_PAIR("hit_rate", JSON_BUILD_REAL(hit_rate))))));
+}
+
+static void append_entries(JournalFile *f, Phase *ret, uint64_t growth[static N_GROWTH_SAMPLES]) {
+        _cleanup_free_ char *large = NULL;
+        unsigned hit, missed, evicted, n_growth = 0;
+        usec_t start;
+        Phase p = {};
+
+        large = malloc(STRLEN("MESSAGE=") + LARGE_MESSAGE_SIZE + 1);
+        assert_se(large);
+
+        hit = mmap_cache_get_hit(f->mmap);
+        missed = mmap_cache_get_missed(f->mmap);
+        evicted = mmap_cache_get_evicted(f->mmap);
+        start = now(CLOCK_MONOTONIC);
+
+        for (unsigned i = 0; i < arg_entries; i++) {
+                char message[STRLEN("MESSAGE=") + 128],
+                        priority[STRLEN("PRIORITY=") + DECIMAL_STR_MAX(unsigned)],
+                        unit[STRLEN("_SYSTEMD_UNIT=unit-.service") + DECIMAL_STR_MAX(unsigned)],
+                        identifier[STRLEN("SYSLOG_IDENTIFIER=ident-") + DECIMAL_STR_MAX(unsigned)],
+                        pid[STRLEN("_PID=") + DECIMAL_STR_MAX(unsigned)];
+                struct iovec iovec[6];
+                dual_timestamp ts;
+                unsigned u, n = 0;
+
+                u = benchmark_random() % arg_cardinality;
+
+                xsprintf(priority, "PRIORITY=%u", (unsigned) (benchmark_random() % 8));
+                xsprintf(unit, "_SYSTEMD_UNIT=unit-%u.service", u);
+                xsprintf(identifier, "SYSLOG_IDENTIFIER=ident-%u", u);
+                xsprintf(pid, "_PID=%u", u + 1000 * (i / 1000));
+
+                iovec[n++] = IOVEC_MAKE_STRING("_HOSTNAME=benchmark");
+                iovec[n++] = IOVEC_MAKE_STRING(priority);
+                iovec[n++] = IOVEC_MAKE_STRING(unit);
+                iovec[n++] = IOVEC_MAKE_STRING(identifier);
+                iovec[n++] = IOVEC_MAKE_STRING(pid);
+
+                if (i % LARGE_MESSAGE_EVERY == LARGE_MESSAGE_EVERY - 1) {
+                        /* Now and then a large, compressible message, e.g. a backtrace */
+                        char *e;
+
+                        e = stpcpy(large, "MESSAGE=");
+                        for (unsigned k = 0; k < LARGE_MESSAGE_SIZE; k++)
+                                e[k] = 'a' + (k + i) % 26;
+                        e[LARGE_MESSAGE_SIZE] = 0;
+
+                        iovec[n++] = IOVEC_MAKE_STRING(large);
+                } else {
+                        unsigned r = benchmark_random() % 1000;
+
+                        switch (i % 4) {
+                        case 0:
+                                xsprintf(message, "MESSAGE=Started Session %u of user user%u.", r, u);
+                                break;
+                        case 1:
+                                xsprintf(message, "MESSAGE=Accepted publickey for user%u from 192.0.2.%u port 22 ssh2", u, r % 256);
+                                break;
+                        case 2:
+                                xsprintf(message, "MESSAGE=Connection to 198.51.100.%u:%u timed out, retrying.", u % 256, r);
+                                break;
+                        default:
+                                xsprintf(message, "MESSAGE=Reached target unit-%u.target, %u jobs pending.", u, r);
+                        }
+
+                        iovec[n++] = IOVEC_MAKE_STRING(message);
+                }
+
+                for (unsigned k = 0; k < n; k++)
+                        p.n_bytes += iovec[k].iov_len;
+
+                assert_se(dual_timestamp_get(&ts));
+                assert_se(journal_file_append_entry(f, &ts, NULL, iovec, n, NULL, NULL, NULL) == 0);
+                p.n_entries++;
+
+                if (n_growth < N_GROWTH_SAMPLES &&
+                    (uint64_t) (i + 1) * N_GROWTH_SAMPLES >= (uint64_t) (n_growth + 1) * arg_entries)
+                        growth[n_growth++] = le64toh(f->header->header_size) + le64toh(f->header->arena_size);
+        }
+
+        p.usec = now(CLOCK_MONOTONIC) - start;
+        p.n_hit = mmap_cache_get_hit(f->mmap) - hit;
+        p.n_missed = mmap_cache_get_missed(f->mmap) - missed;
+        p.n_evicted = mmap_cache_get_evicted(f->mmap) - evicted;
+
+        *ret = p;
+}
+
+static void read_entries(sd_journal *j, char **matches, Phase *ret) {
+        unsigned hit, missed, evicted;
+        usec_t start;
+        char **m;
+        Phase p = {};
+
+        sd_journal_flush_matches(j);
+        STRV_FOREACH(m, matches)
+                assert_se(sd_journal_add_match(j, *m, 0) >= 0);
+
+        hit = mmap_cache_get_hit(j->mmap);
+        missed = mmap_cache_get_missed(j->mmap);
+        evicted = mmap_cache_get_evicted(j->mmap);
+        start = now(CLOCK_MONOTONIC);
+
+        SD_JOURNAL_FOREACH(j) {
+                const void *d;
+                size_t l;
+
+                assert_se(sd_journal_get_data(j, "MESSAGE", &d, &l) >= 0);
+
+                p.n_entries++;
+                p.n_bytes += l;
+        }
+
+        p.usec = now(CLOCK_MONOTONIC) - start;
+        p.n_hit = mmap_cache_get_hit(j->mmap) - hit;
+        p.n_missed = mmap_cache_get_missed(j->mmap) - missed;
+        p.n_evicted = mmap_cache_get_evicted(j->mmap) - evicted;
+
+        *ret = p;
+}
+
+static uint64_t count_entries_with(sd_journal *j, char **fields) {
+        uint64_t n = 0;
+
+        /* Counts the entries that carry all of the fields the slow way, to check the matches against */
+
+        sd_journal_flush_matches(j);
+
+        SD_JOURNAL_FOREACH(j) {
+                bool good = true;
+                char **field;
+
+                STRV_FOREACH(field, fields) {
+                        const char *eq = strchr(*field, '=');
+                        _cleanup_free_ char *name = NULL;
+                        const void *d;
+                        size_t l;
+
+                        name = strndup(*field, eq - *field);
+                        assert_se(name);
+
+                        if (sd_journal_get_data(j, name, &d, &l) < 0 ||
+                            l != strlen(*field) || memcmp(d, *field, l) != 0) {
+                                good = false;
+                                break;
+                        }
+                }
+
+                if (good)
+                        n++;
+        }
+
+        return n;
+}
+
+int main(int argc, char *argv[]) {
+        _cleanup_(json_variant_unrefp) JsonVariant *v = NULL, *append = NULL, *sequential = NULL, *matched = NULL, *matched_and = NULL;
+        JsonVariant *growth_variants[N_GROWTH_SAMPLES] = {};
+        uint64_t growth[N_GROWTH_SAMPLES] = {};
+        char t[] = "/var/tmp/journal-benchmark-XXXXXX";
+        Phase append_phase, sequential_phase, matched_phase, matched_and_phase;
+        sd_journal *j;
+        JournalFile *f;
+        struct stat st;
+
+        test_setup_logging(LOG_INFO);
+
+        /* journal_file_open requires a valid machine id */
+        if (access("/etc/machine-id", F_OK) != 0)
+                return log_tests_skipped("/etc/machine-id not found");
+
+        if (argc >= 2)
+                assert_se(safe_atou(argv[1], &arg_entries) >= 0 && arg_entries > 0);
+        else
+                arg_entries = slow_tests_enabled() ? 200000 : 2000;
+
+        if (argc >= 3)
+                assert_se(safe_atou(argv[2], &arg_cardinality) >= 0 && arg_cardinality > 0);
+
+        assert_se(mkdtemp(t));
+        assert_se(chdir(t) >= 0);
+
+        assert_se(journal_file_open(-1, "benchmark.journal", O_RDWR|O_CREAT, 0644, true, (uint64_t) -1, false, NULL, NULL, NULL, NULL, &f) == 0);
+        append_entries(f, &append_phase, growth);
+        assert_se(fstat(f->fd, &st) >= 0);
+        (void) journal_file_close(f);
+
+        assert_se(sd_journal_open_directory(&j, t, 0) >= 0);
+        read_entries(j, NULL, &sequential_phase);
+        read_entries(j, STRV_MAKE("_SYSTEMD_UNIT=unit-0.service"), &matched_phase);
+        /* A term matching an eighth of all entries, combined with a far more selective one */
+        read_entries(j, STRV_MAKE("PRIORITY=3", "_SYSTEMD_UNIT=unit-0.service"), &matched_and_phase);
+        assert_se(matched_and_phase.n_entries == count_entries_with(j, STRV_MAKE("PRIORITY=3", "_SYSTEMD_UNIT=unit-0.service")));
+        sd_journal_close(j);
+
+        assert_se(phase_to_json(&append_phase, &append) >= 0);
+        assert_se(phase_to_json(&sequential_phase, &sequential) >= 0);
+        assert_se(phase_to_json(&matched_phase, &matched) >= 0);
+        assert_se(phase_to_json(&matched_and_phase, &matched_and) >= 0);
+
+        for (unsigned i = 0; i < N_GROWTH_SAMPLES; i++)
+                assert_se(json_variant_new_unsigned(growth_variants + i, growth[i]) >= 0);
+
+        assert_se(json_build(&v, JSON_BUILD_OBJECT(
+                                     JSON_BUILD_PAIR("entries", JSON_BUILD_UNSIGNED(arg_entries)),
+                                     JSON_BUILD_PAIR("cardinality", JSON_BUILD_UNSIGNED(arg_cardinality)),
+                                     JSON_BUILD_PAIR("append", JSON_BUILD_VARIANT(append)),
+                                     JSON_BUILD_PAIR("read_sequential", JSON_BUILD_VARIANT(sequential)),
+                                     JSON_BUILD_PAIR("read_matched", JSON_BUILD_VARIANT(matched)),
+                                     JSON_BUILD_PAIR("read_matched_and", JSON_BUILD_VARIANT(matched_and)),
+                                     JSON_BUILD_PAIR("file", JSON_BUILD_OBJECT(
+                                                             JSON_BUILD_PAIR("size", JSON_BUILD_UNSIGNED(st.st_size)),
+                                                             JSON_BUILD_PAIR("allocated", JSON_BUILD_UNSIGNED((uint64_t) st.st_blocks * 512ULL)),
+                                                             JSON_BUILD_PAIR("bytes_per_entry", JSON_BUILD_REAL((double) st.st_size / arg_entries)),
+                                                             JSON_BUILD_PAIR("growth", JSON_BUILD_VARIANT_ARRAY(growth_variants, N_GROWTH_SAMPLES)))))) >= 0);
+
+        json_variant_unref_many(growth_variants, N_GROWTH_SAMPLES);
+
+        json_variant_dump(v, JSON_FORMAT_PRETTY_AUTO, stdout, NULL);
+
+        assert_se(sequential_phase.n_entries == arg_entries);
+        assert_se(matched_phase.n_entries <= arg_entries);
+        assert_se(matched_and_phase.n_entries <= matched_phase.n_entries);
+
+        assert_se(rm_rf(t, REMOVE_ROOT|REMOVE_PHYSICAL) >= 0);
+
+        return 0;
+}
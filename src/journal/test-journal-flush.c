@@ -14,6 +14,7 @@
 #include "string-util.h"
 
 int main(int argc, char *argv[]) {
+        _cleanup_(journal_file_copy_cache_freep) JournalFileCopyCache *cache = NULL;
         _cleanup_free_ char *fn = NULL;
         char dn[] = "/var/tmp/test-journal-flush.XXXXXX";
         JournalFile *new_journal = NULL;
@@ -46,7 +47,7 @@ int main(int argc, char *argv[]) {
                         log_error_errno(r, "journal_file_move_to_object failed: %m");
                 assert_se(r >= 0);
 
-                r = journal_file_copy_entry(f, new_journal, o, f->current_offset);
+                r = journal_file_copy_entry(f, new_journal, o, f->current_offset, &cache);
                 if (r < 0)
                         log_error_errno(r, "journal_file_copy_entry failed: %m");
                 assert_se(r >= 0);
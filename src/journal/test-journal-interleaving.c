@@ -140,7 +140,7 @@ static void mkdtemp_chdir_chattr(char *path) {
         (void) chattr_path(path, FS_NOCOW_FL, FS_NOCOW_FL, NULL);
 }
 
-static void test_skip(void (*setup)(void)) {
+static void test_skip(void (*setup)(void), int flags) {
         char t[] = "/var/tmp/journal-skip-XXXXXX";
         sd_journal *j;
         int r;
@@ -151,7 +151,7 @@ static void test_skip(void (*setup)(void)) {
 
         /* Seek to head, iterate down.
          */
-        assert_ret(sd_journal_open_directory(&j, t, 0));
+        assert_ret(sd_journal_open_directory(&j, t, flags));
         assert_ret(sd_journal_seek_head(j));
         assert_ret(sd_journal_next(j));
         test_check_numbers_down(j, 4);
@@ -159,7 +159,7 @@ static void test_skip(void (*setup)(void)) {
 
         /* Seek to tail, iterate up.
          */
-        assert_ret(sd_journal_open_directory(&j, t, 0));
+        assert_ret(sd_journal_open_directory(&j, t, flags));
         assert_ret(sd_journal_seek_tail(j));
         assert_ret(sd_journal_previous(j));
         test_check_numbers_up(j, 4);
@@ -167,7 +167,7 @@ static void test_skip(void (*setup)(void)) {
 
         /* Seek to tail, skip to head, iterate down.
          */
-        assert_ret(sd_journal_open_directory(&j, t, 0));
+        assert_ret(sd_journal_open_directory(&j, t, flags));
         assert_ret(sd_journal_seek_tail(j));
         assert_ret(r = sd_journal_previous_skip(j, 4));
         assert_se(r == 4);
@@ -176,7 +176,7 @@ static void test_skip(void (*setup)(void)) {
 
         /* Seek to head, skip to tail, iterate up.
          */
-        assert_ret(sd_journal_open_directory(&j, t, 0));
+        assert_ret(sd_journal_open_directory(&j, t, flags));
         assert_ret(sd_journal_seek_head(j));
         assert_ret(r = sd_journal_next_skip(j, 4));
         assert_se(r == 4);
@@ -188,7 +188,7 @@ static void test_skip(void (*setup)(void)) {
         if (arg_keep)
                 log_info("Not removing %s", t);
         else {
-                journal_directory_vacuum(".", 3000000, 0, 0, NULL, true);
+                journal_directory_vacuum(".", 3000000, 0, 0, NULL, NULL, true);
 
                 assert_se(rm_rf(t, REMOVE_ROOT|REMOVE_PHYSICAL) >= 0);
         }
@@ -272,7 +272,7 @@ static void test_sequence_numbers(void) {
         if (arg_keep)
                 log_info("Not removing %s", t);
         else {
-                journal_directory_vacuum(".", 3000000, 0, 0, NULL, true);
+                journal_directory_vacuum(".", 3000000, 0, 0, NULL, NULL, true);
 
                 assert_se(rm_rf(t, REMOVE_ROOT|REMOVE_PHYSICAL) >= 0);
         }
@@ -287,8 +287,12 @@ int main(int argc, char *argv[]) {
 
         arg_keep = argc > 1;
 
-        test_skip(setup_sequential);
-        test_skip(setup_interleaved);
+        test_skip(setup_sequential, 0);
+        test_skip(setup_interleaved, 0);
+
+        /* The prefetch threads must not change the order of anything */
+        test_skip(setup_sequential, SD_JOURNAL_PARALLEL);
+        test_skip(setup_interleaved, SD_JOURNAL_PARALLEL);
 
         test_sequence_numbers();
 
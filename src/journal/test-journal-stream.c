@@ -13,6 +13,7 @@
 #include "macro.h"
 #include "parse-util.h"
 #include "rm-rf.h"
+#include "string-util.h"
 #include "tests.h"
 #include "util.h"
 
@@ -61,7 +62,8 @@ static void verify_contents(sd_journal *j, unsigned skip) {
 int main(int argc, char *argv[]) {
         JournalFile *one, *two, *three;
         char t[] = "/var/tmp/journal-stream-XXXXXX";
-        unsigned i;
+        unsigned i, n_appended = 0;
+        uint64_t n_counted = 0;
         _cleanup_(sd_journal_closep) sd_journal *j = NULL;
         char *z;
         const void *data;
@@ -106,13 +108,17 @@ int main(int argc, char *argv[]) {
                 iovec[1].iov_base = q;
                 iovec[1].iov_len = strlen(q);
 
-                if (i % 10 == 0)
+                if (i % 10 == 0) {
                         assert_se(journal_file_append_entry(three, &ts, NULL, iovec, 2, NULL, NULL, NULL) == 0);
-                else {
-                        if (i % 3 == 0)
+                        n_appended++;
+                } else {
+                        if (i % 3 == 0) {
                                 assert_se(journal_file_append_entry(two, &ts, NULL, iovec, 2, NULL, NULL, NULL) == 0);
+                                n_appended++;
+                        }
 
                         assert_se(journal_file_append_entry(one, &ts, NULL, iovec, 2, NULL, NULL, NULL) == 0);
+                        n_appended++;
                 }
 
                 free(p);
@@ -148,6 +154,27 @@ int main(int argc, char *argv[]) {
 
         sd_journal_flush_matches(j);
 
+        /* Stable data survives lookups of other fields of the same entry */
+        SD_JOURNAL_FOREACH(j) {
+                const void *magic, *number;
+                size_t magic_l, number_l;
+                unsigned n = 0;
+
+                assert_se(sd_journal_get_data_stable(j, "MAGIC", &magic, &magic_l) >= 0);
+                assert_se(sd_journal_get_data_stable(j, "NUMBER", &number, &number_l) >= 0);
+
+                SD_JOURNAL_FOREACH_DATA_STABLE(j, data, l)
+                        n++;
+                assert_se(n == 2);
+
+                assert_se(sd_journal_get_data(j, "MAGIC", &data, &l) >= 0);
+                assert_se(sd_journal_get_data(j, "NUMBER", &data, &l) >= 0);
+                assert_se(l == number_l && memcmp(data, number, l) == 0);
+
+                assert_se(memory_startswith(magic, magic_l, "MAGIC="));
+                assert_se(memory_startswith(number, number_l, "NUMBER="));
+        }
+
         verify_contents(j, 1);
 
         printf("NEXT TEST\n");
@@ -176,6 +203,17 @@ int main(int argc, char *argv[]) {
         SD_JOURNAL_FOREACH_UNIQUE(j, data, l)
                 printf("%.*s\n", (int) l, (const char*) data);
 
+        /* Every entry carries exactly one MAGIC= value, hence the counters must add up to all entries in all files */
+        assert_se(sd_journal_query_unique(j, "MAGIC") >= 0);
+        SD_JOURNAL_FOREACH_UNIQUE(j, data, l) {
+                uint64_t n;
+
+                assert_se(journal_unique_n_entries(j, &n) >= 0);
+                printf("%.*s: %" PRIu64 " entries\n", (int) l, (const char*) data, n);
+                n_counted += n;
+        }
+        assert_se(n_counted == n_appended);
+
         assert_se(rm_rf(t, REMOVE_ROOT|REMOVE_PHYSICAL) >= 0);
 
         return 0;
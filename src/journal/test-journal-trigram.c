@@ -0,0 +1,119 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "sd-journal.h"
+
+#include "alloc-util.h"
+#include "io-util.h"
+#include "journal-file.h"
+#include "journal-internal.h"
+#include "journal-trigram.h"
+#include "log.h"
+#include "rm-rf.h"
+#include "stdio-util.h"
+#include "string-util.h"
+#include "tests.h"
+
+#define N_ENTRIES 200U
+
+static void test_filter(sd_journal *j, const char *literal, bool caseless) {
+        _cleanup_(trigram_filter_freep) TrigramFilter *t = NULL;
+        unsigned n_skipped = 0, n_matching = 0;
+
+        log_info("/* %s(\"%s\", %s) */", __func__, literal, yes_no(caseless));
+
+        assert_se(trigram_filter_new(literal, caseless, &t) > 0);
+
+        SD_JOURNAL_FOREACH(j) {
+                _cleanup_free_ char *m = NULL;
+                const void *d;
+                size_t l;
+                bool contains;
+                int r;
+
+                assert_se(sd_journal_get_data(j, "MESSAGE", &d, &l) >= 0);
+                assert_se(m = strndup(d, l));
+                contains = (caseless ? strcasestr(m, literal) : strstr(m, literal)) != NULL;
+
+                r = trigram_filter_test(t, j->current_file);
+                assert_se(r >= 0);
+
+                /* The index may have false positives, but never false negatives */
+                if (contains) {
+                        assert_se(r > 0);
+                        n_matching++;
+                } else if (r == 0)
+                        n_skipped++;
+        }
+
+        log_info("%u matching, %u skipped", n_matching, n_skipped);
+        assert_se(n_matching == N_ENTRIES / 10);
+        assert_se(n_skipped > 0);
+}
+
+static void test_trigram_index(void) {
+        char t[] = "/var/tmp/journal-trigram-XXXXXX";
+        _cleanup_(trigram_filter_freep) TrigramFilter *short_filter = NULL;
+        dual_timestamp ts;
+        JournalFile *f;
+        sd_journal *j;
+        Iterator i;
+        unsigned k;
+
+        assert_se(mkdtemp(t));
+        assert_se(chdir(t) >= 0);
+
+        assert_se(journal_file_open(-1, "test.journal", O_RDWR|O_CREAT, 0644, true, (uint64_t) -1, false, NULL, NULL, NULL, NULL, &f) == 0);
+
+        assert_se(dual_timestamp_get(&ts));
+        for (k = 0; k < N_ENTRIES; k++) {
+                char buf[STRLEN("MESSAGE=the needle in entry ") + DECIMAL_STR_MAX(unsigned)];
+                struct iovec iovec;
+
+                if (k % 10 == 0)
+                        xsprintf(buf, "MESSAGE=the Needle in entry %u", k);
+                else
+                        xsprintf(buf, "MESSAGE=hello world %u", k);
+
+                iovec = IOVEC_MAKE_STRING(buf);
+                assert_se(journal_file_append_entry(f, &ts, NULL, &iovec, 1, NULL, NULL, NULL) == 0);
+        }
+
+        /* Only archived files may be indexed */
+        assert_se(journal_file_build_trigram_index(f) == -EBUSY);
+
+        assert_se(journal_file_archive(f) >= 0);
+        (void) journal_file_close(f);
+
+        assert_se(sd_journal_open_directory(&j, t, 0) >= 0);
+
+        ORDERED_HASHMAP_FOREACH(f, j->files, i) {
+                assert_se(journal_file_build_trigram_index(f) >= 0);
+                assert_se(journal_file_build_trigram_index(f) == -EEXIST);
+        }
+
+        test_filter(j, "Needle", false);
+        test_filter(j, "needle", true);
+
+        /* Too short a literal can't be looked up */
+        assert_se(trigram_filter_new("ne", false, &short_filter) == 0);
+        assert_se(!short_filter);
+
+        sd_journal_close(j);
+
+        assert_se(rm_rf(t, REMOVE_ROOT|REMOVE_PHYSICAL) >= 0);
+}
+
+int main(int argc, char *argv[]) {
+        test_setup_logging(LOG_INFO);
+
+        /* journal_file_open requires a valid machine id */
+        if (access("/etc/machine-id", F_OK) != 0)
+                return log_tests_skipped("/etc/machine-id not found");
+
+        test_trigram_index();
+
+        return 0;
+}
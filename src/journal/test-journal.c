@@ -3,13 +3,21 @@
 #include <fcntl.h>
 #include <unistd.h>
 
+#include "sd-journal.h"
+
 #include "chattr-util.h"
+#include "fd-util.h"
 #include "io-util.h"
 #include "journal-authenticate.h"
 #include "journal-file.h"
+#include "journal-internal.h"
+#include "journal-manifest.h"
 #include "journal-vacuum.h"
+#include "journal-verify.h"
 #include "log.h"
 #include "rm-rf.h"
+#include "stdio-util.h"
+#include "string-util.h"
 #include "tests.h"
 
 static bool arg_keep = false;
@@ -108,7 +116,7 @@ static void test_non_empty(void) {
         if (arg_keep)
                 log_info("Not removing %s", t);
         else {
-                journal_directory_vacuum(".", 3000000, 0, 0, NULL, true);
+                journal_directory_vacuum(".", 3000000, 0, 0, NULL, NULL, true);
 
                 assert_se(rm_rf(t, REMOVE_ROOT|REMOVE_PHYSICAL) >= 0);
         }
@@ -146,7 +154,7 @@ static void test_empty(void) {
         if (arg_keep)
                 log_info("Not removing %s", t);
         else {
-                journal_directory_vacuum(".", 3000000, 0, 0, NULL, true);
+                journal_directory_vacuum(".", 3000000, 0, 0, NULL, NULL, true);
 
                 assert_se(rm_rf(t, REMOVE_ROOT|REMOVE_PHYSICAL) >= 0);
         }
@@ -157,7 +165,7 @@ static void test_empty(void) {
         (void) journal_file_close(f4);
 }
 
-#if HAVE_XZ || HAVE_LZ4
+#if HAVE_XZ || HAVE_LZ4 || HAVE_ZSTD
 static bool check_compressed(uint64_t compress_threshold, uint64_t data_size) {
         dual_timestamp ts;
         JournalFile *f;
@@ -209,7 +217,7 @@ static bool check_compressed(uint64_t compress_threshold, uint64_t data_size) {
         if (arg_keep)
                 log_info("Not removing %s", t);
         else {
-                journal_directory_vacuum(".", 3000000, 0, 0, NULL, true);
+                journal_directory_vacuum(".", 3000000, 0, 0, NULL, NULL, true);
 
                 assert_se(rm_rf(t, REMOVE_ROOT|REMOVE_PHYSICAL) >= 0);
         }
@@ -240,6 +248,534 @@ static void test_min_compress_size(void) {
 }
 #endif
 
+static void test_append_entries(void) {
+        static const char test[] = "TEST1=1", test2[] = "TEST2=2", test3[] = "TEST3=3";
+        struct iovec iovec[3];
+        JournalEntryIovec entries[3];
+        dual_timestamp ts;
+        JournalFile *f;
+        Object *o;
+        uint64_t p, seqnum = 0;
+        size_t n_appended = (size_t) -1;
+        char t[] = "/var/tmp/journal-batch-XXXXXX";
+
+        mkdtemp_chdir_chattr(t);
+
+        assert_se(journal_file_open(-1, "test.journal", O_RDWR|O_CREAT, 0666, true, (uint64_t) -1, false, NULL, NULL, NULL, NULL, &f) == 0);
+
+        assert_se(dual_timestamp_get(&ts));
+
+        iovec[0] = IOVEC_MAKE_STRING(test);
+        iovec[1] = IOVEC_MAKE_STRING(test2);
+        iovec[2] = IOVEC_MAKE_STRING(test3);
+
+        entries[0] = (JournalEntryIovec) { .ts = &ts, .iovec = iovec, .n_iovec = 1 };
+        entries[1] = (JournalEntryIovec) { .ts = &ts, .iovec = iovec, .n_iovec = 2 };
+        entries[2] = (JournalEntryIovec) { .ts = &ts, .iovec = iovec, .n_iovec = 3 };
+
+        assert_se(journal_file_append_entries(f, NULL, 0, &seqnum, &n_appended) == 0);
+        assert_se(n_appended == 0);
+        assert_se(seqnum == 0);
+
+        assert_se(journal_file_append_entries(f, entries, ELEMENTSOF(entries), &seqnum, &n_appended) == 0);
+        assert_se(n_appended == 3);
+        assert_se(seqnum == 3);
+        assert_se(le64toh(f->header->n_entries) == 3);
+
+        assert_se(journal_file_next_entry(f, 0, DIRECTION_DOWN, &o, &p) == 1);
+        assert_se(le64toh(o->entry.seqnum) == 1);
+        assert_se(journal_file_entry_n_items(o) == 1);
+
+        assert_se(journal_file_next_entry(f, p, DIRECTION_DOWN, &o, &p) == 1);
+        assert_se(le64toh(o->entry.seqnum) == 2);
+        assert_se(journal_file_entry_n_items(o) == 2);
+
+        assert_se(journal_file_next_entry(f, p, DIRECTION_DOWN, &o, &p) == 1);
+        assert_se(le64toh(o->entry.seqnum) == 3);
+        assert_se(journal_file_entry_n_items(o) == 3);
+
+        assert_se(journal_file_next_entry(f, p, DIRECTION_DOWN, &o, &p) == 0);
+
+        /* All three entries reference TEST1=1, but only the last one references TEST3=3 */
+        assert_se(journal_file_find_data_object(f, test, strlen(test), &o, NULL) == 1);
+        assert_se(le64toh(o->data.n_entries) == 3);
+        assert_se(journal_file_find_data_object(f, test3, strlen(test3), &o, NULL) == 1);
+        assert_se(le64toh(o->data.n_entries) == 1);
+
+        /* An invalid timestamp stops the batch, but keeps what was appended before it */
+        ts.realtime = 0;
+        entries[0].ts = NULL;
+        assert_se(journal_file_append_entries(f, entries, ELEMENTSOF(entries), &seqnum, &n_appended) == -EBADMSG);
+        assert_se(n_appended == 1);
+        assert_se(seqnum == 4);
+        assert_se(le64toh(f->header->n_entries) == 4);
+
+        (void) journal_file_close(f);
+
+        assert_se(rm_rf(t, REMOVE_ROOT|REMOVE_PHYSICAL) >= 0);
+
+        puts("------------------------------------------------------------");
+}
+
+static void test_data_cache(void) {
+        _cleanup_free_ char *large = NULL;
+        struct iovec iovec[3];
+        dual_timestamp ts;
+        JournalFile *f;
+        Object *o;
+        uint64_t p, q;
+        unsigned i;
+        char t[] = "/var/tmp/journal-cache-XXXXXX";
+
+        mkdtemp_chdir_chattr(t);
+
+        assert_se(journal_file_open(-1, "test.journal", O_RDWR|O_CREAT, 0666, false, (uint64_t) -1, false, NULL, NULL, NULL, NULL, &f) == 0);
+
+        /* One field small enough to be cached, and one too large for the cache */
+        large = strjoin("LARGE=", "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx",
+                        "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx");
+        assert_se(large);
+
+        assert_se(dual_timestamp_get(&ts));
+
+        for (i = 0; i < 16; i++) {
+                char buf[sizeof("COUNTER=") + DECIMAL_STR_MAX(unsigned)];
+
+                xsprintf(buf, "COUNTER=%u", i);
+
+                iovec[0] = IOVEC_MAKE_STRING("_HOSTNAME=cached");
+                iovec[1] = IOVEC_MAKE_STRING(large);
+                iovec[2] = IOVEC_MAKE_STRING(buf);
+
+                assert_se(journal_file_append_entry(f, &ts, NULL, iovec, ELEMENTSOF(iovec), NULL, NULL, NULL) == 0);
+        }
+
+        /* Cached and uncached lookups need to agree, and no duplicate data objects may have been created */
+        assert_se(le64toh(f->header->n_entries) == 16);
+        assert_se(le64toh(f->header->n_data) == 2 + 16);
+
+        assert_se(journal_file_find_data_object(f, "_HOSTNAME=cached", strlen("_HOSTNAME=cached"), &o, &p) == 1);
+        assert_se(le64toh(o->data.n_entries) == 16);
+        assert_se(journal_file_find_data_object(f, large, strlen(large), &o, &q) == 1);
+        assert_se(le64toh(o->data.n_entries) == 16);
+        assert_se(p != q);
+
+        (void) journal_file_close(f);
+
+        assert_se(rm_rf(t, REMOVE_ROOT|REMOVE_PHYSICAL) >= 0);
+
+        puts("------------------------------------------------------------");
+}
+
+#define N_TIME_INDEX_ENTRIES 1000U
+#define TIME_INDEX_STEP_USEC (7 * USEC_PER_SEC)
+
+static void test_time_index_seek(JournalFile *f, usec_t base, usec_t needle) {
+        Object *o;
+        uint64_t k;
+        int r;
+
+        /* The entries are TIME_INDEX_STEP_USEC apart, starting at base */
+        r = journal_file_move_to_entry_by_realtime(f, needle, DIRECTION_DOWN, &o, NULL);
+        assert_se(r >= 0);
+        if (needle <= base)
+                assert_se(r > 0 && le64toh(o->entry.realtime) == base);
+        else {
+                k = DIV_ROUND_UP(needle - base, TIME_INDEX_STEP_USEC);
+                if (k >= N_TIME_INDEX_ENTRIES)
+                        assert_se(r == 0);
+                else
+                        assert_se(r > 0 && le64toh(o->entry.realtime) == base + k * TIME_INDEX_STEP_USEC);
+        }
+
+        r = journal_file_move_to_entry_by_realtime(f, needle, DIRECTION_UP, &o, NULL);
+        assert_se(r >= 0);
+        if (needle < base)
+                assert_se(r == 0);
+        else {
+                k = MIN((needle - base) / TIME_INDEX_STEP_USEC, (uint64_t) N_TIME_INDEX_ENTRIES - 1);
+                assert_se(r > 0 && le64toh(o->entry.realtime) == base + k * TIME_INDEX_STEP_USEC);
+        }
+}
+
+static void test_time_index(void) {
+        struct iovec iovec;
+        dual_timestamp ts;
+        JournalFile *f;
+        usec_t base;
+        unsigned i;
+        char t[] = "/var/tmp/journal-time-index-XXXXXX";
+
+        mkdtemp_chdir_chattr(t);
+
+        assert_se(journal_file_open(-1, "test.journal", O_RDWR|O_CREAT, 0666, true, (uint64_t) -1, false, NULL, NULL, NULL, NULL, &f) == 0);
+
+        assert_se(dual_timestamp_get(&ts));
+        base = ts.realtime;
+
+        for (i = 0; i < N_TIME_INDEX_ENTRIES; i++) {
+                ts.realtime = base + i * TIME_INDEX_STEP_USEC;
+                iovec = IOVEC_MAKE_STRING("MESSAGE=tick");
+                assert_se(journal_file_append_entry(f, &ts, NULL, &iovec, 1, NULL, NULL, NULL) == 0);
+        }
+
+        /* The index is added when archiving */
+        assert_se(f->header->time_index_offset == 0);
+        assert_se(journal_file_archive(f) >= 0);
+        assert_se(f->header->time_index_offset != 0);
+
+        test_time_index_seek(f, base, 0);
+        test_time_index_seek(f, base, base - 1);
+        test_time_index_seek(f, base, base);
+        for (i = 0; i < N_TIME_INDEX_ENTRIES; i += 37) {
+                test_time_index_seek(f, base, base + i * TIME_INDEX_STEP_USEC);
+                test_time_index_seek(f, base, base + i * TIME_INDEX_STEP_USEC + 1);
+                test_time_index_seek(f, base, base + i * TIME_INDEX_STEP_USEC - 1);
+        }
+        test_time_index_seek(f, base, base + N_TIME_INDEX_ENTRIES * TIME_INDEX_STEP_USEC);
+        test_time_index_seek(f, base, USEC_INFINITY);
+
+        assert_se(journal_file_verify(f, NULL, NULL, NULL, NULL, false) >= 0);
+
+        (void) journal_file_close(f);
+
+        /* If the clock went backwards, no index may be written */
+        assert_se(journal_file_open(-1, "test.journal", O_RDWR|O_CREAT, 0666, true, (uint64_t) -1, false, NULL, NULL, NULL, NULL, &f) == 0);
+
+        for (i = 0; i < 10; i++) {
+                ts.realtime = base + (i % 5) * USEC_PER_MINUTE;
+                iovec = IOVEC_MAKE_STRING("MESSAGE=tock");
+                assert_se(journal_file_append_entry(f, &ts, NULL, &iovec, 1, NULL, NULL, NULL) == 0);
+        }
+
+        assert_se(journal_file_archive(f) >= 0);
+        assert_se(f->header->time_index_offset == 0);
+
+        (void) journal_file_close(f);
+
+        assert_se(rm_rf(t, REMOVE_ROOT|REMOVE_PHYSICAL) >= 0);
+
+        puts("------------------------------------------------------------");
+}
+
+static unsigned count_entries(sd_journal *j) {
+        unsigned n = 0;
+
+        assert_se(sd_journal_seek_head(j) >= 0);
+        while (sd_journal_next(j) > 0)
+                n++;
+
+        return n;
+}
+
+static void test_manifest(void) {
+        _cleanup_hashmap_free_ Hashmap *cache = NULL, *m = NULL;
+        _cleanup_close_ int fd = -1;
+        JournalManifestEntry *e;
+        struct iovec iovec;
+        dual_timestamp ts;
+        JournalFile *f;
+        sd_journal *j;
+        Iterator it;
+        usec_t base;
+        unsigned i;
+        char t[] = "/var/tmp/journal-manifest-XXXXXX";
+
+        mkdtemp_chdir_chattr(t);
+
+        assert_se(dual_timestamp_get(&ts));
+        base = ts.realtime;
+
+        /* Three archived files, an hour apart, with two entries each, and an active one */
+        for (i = 0; i < 4; i++) {
+                assert_se(journal_file_open(-1, "system.journal", O_RDWR|O_CREAT, 0666, true, (uint64_t) -1, false, NULL, NULL, NULL, NULL, &f) == 0);
+
+                iovec = IOVEC_MAKE_STRING("MESSAGE=hello");
+                ts.realtime = base + i * USEC_PER_HOUR;
+                assert_se(journal_file_append_entry(f, &ts, NULL, &iovec, 1, NULL, NULL, NULL) == 0);
+                ts.realtime += USEC_PER_MINUTE;
+                assert_se(journal_file_append_entry(f, &ts, NULL, &iovec, 1, NULL, NULL, NULL) == 0);
+
+                if (i < 3)
+                        assert_se(journal_file_archive(f) >= 0);
+
+                (void) journal_file_close(f);
+        }
+
+        assert_se(journal_manifest_update(t, &cache) >= 0);
+        assert_se(hashmap_size(cache) == 3);
+
+        fd = open(t, O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+        assert_se(fd >= 0);
+        assert_se(journal_manifest_load(fd, &m) >= 0);
+        assert_se(hashmap_size(m) == 3);
+
+        HASHMAP_FOREACH(e, m, it) {
+                assert_se(startswith(e->filename, "system@"));
+                assert_se(e->head_seqnum == 1);
+                assert_se(e->tail_seqnum == 2);
+                assert_se((e->head_realtime - base) % USEC_PER_HOUR == 0);
+                assert_se(e->tail_realtime == e->head_realtime + USEC_PER_MINUTE);
+        }
+
+        /* Archived files are only opened once needed, and only if they are in range */
+        assert_se(sd_journal_open_directory(&j, t, 0) >= 0);
+        assert_se(ordered_hashmap_size(j->files) == 1);
+        assert_se(hashmap_size(j->deferred_files) == 3);
+
+        journal_set_realtime_range(j, base + 2 * USEC_PER_HOUR, USEC_INFINITY);
+        assert_se(count_entries(j) == 4);
+        assert_se(ordered_hashmap_size(j->files) == 2);
+        assert_se(hashmap_size(j->deferred_files) == 2);
+
+        journal_set_realtime_range(j, 0, USEC_INFINITY);
+        assert_se(count_entries(j) == 8);
+        assert_se(ordered_hashmap_size(j->files) == 4);
+        assert_se(hashmap_isempty(j->deferred_files));
+
+        sd_journal_close(j);
+
+        /* Files that are gone are dropped from the manifest */
+        e = hashmap_first(m);
+        assert_se(unlink(e->filename) >= 0);
+        assert_se(journal_manifest_update(t, &cache) >= 0);
+        assert_se(hashmap_size(cache) == 2);
+
+        m = hashmap_free(m);
+        assert_se(journal_manifest_load(fd, &m) >= 0);
+        assert_se(hashmap_size(m) == 2);
+
+        assert_se(rm_rf(t, REMOVE_ROOT|REMOVE_PHYSICAL) >= 0);
+
+        puts("------------------------------------------------------------");
+}
+
+static void append_boot_entry(JournalFile *f, sd_id128_t boot_id, usec_t realtime, bool with_field) {
+        char field[STRLEN("_BOOT_ID=") + SD_ID128_STRING_MAX] = "_BOOT_ID=";
+        struct iovec iovec[2];
+        dual_timestamp ts;
+
+        assert_se(dual_timestamp_get(&ts));
+        ts.realtime = realtime;
+
+        sd_id128_to_string(boot_id, field + STRLEN("_BOOT_ID="));
+        iovec[0] = IOVEC_MAKE_STRING("MESSAGE=boot");
+        iovec[1] = IOVEC_MAKE_STRING(field);
+
+        assert_se(journal_file_append_entry(f, &ts, &boot_id, iovec, with_field ? 2 : 1, NULL, NULL, NULL) == 0);
+}
+
+static void test_boots(void) {
+        sd_id128_t x, y, z, w, id;
+        uint64_t first, last;
+        JournalFile *a, *b, *c;
+        sd_journal *j;
+        char t[] = "/var/tmp/journal-boots-XXXXXX";
+
+        mkdtemp_chdir_chattr(t);
+
+        assert_se(sd_id128_randomize(&x) >= 0);
+        assert_se(sd_id128_randomize(&y) >= 0);
+        assert_se(sd_id128_randomize(&z) >= 0);
+        assert_se(sd_id128_randomize(&w) >= 0);
+
+        assert_se(journal_file_open(-1, "a.journal", O_RDWR|O_CREAT, 0666, true, (uint64_t) -1, false, NULL, NULL, NULL, NULL, &a) == 0);
+        assert_se(journal_file_open(-1, "b.journal", O_RDWR|O_CREAT, 0666, true, (uint64_t) -1, false, NULL, NULL, NULL, NULL, &b) == 0);
+        assert_se(journal_file_open(-1, "c.journal", O_RDWR|O_CREAT, 0666, true, (uint64_t) -1, false, NULL, NULL, NULL, NULL, &c) == 0);
+
+        append_boot_entry(a, x, 1000, true);
+        append_boot_entry(a, x, 1001, true);
+        append_boot_entry(a, y, 1010, true);
+        append_boot_entry(a, y, 1011, true);
+        append_boot_entry(b, y, 1012, true);
+        append_boot_entry(b, z, 1020, true);
+        append_boot_entry(b, z, 1025, true);
+
+        /* Without the _BOOT_ID= field, the entries themselves are looked at */
+        append_boot_entry(c, w, 1030, false);
+        append_boot_entry(c, w, 1031, false);
+
+        (void) journal_file_close(a);
+        (void) journal_file_close(b);
+        (void) journal_file_close(c);
+
+        assert_se(sd_journal_open_directory(&j, t, 0) >= 0);
+
+        assert_se(sd_journal_enumerate_boots(j, &id, &first, &last) == 1);
+        assert_se(sd_id128_equal(id, x) && first == 1000 && last == 1001);
+        assert_se(sd_journal_enumerate_boots(j, &id, &first, &last) == 1);
+        assert_se(sd_id128_equal(id, y) && first == 1010 && last == 1012);
+        assert_se(sd_journal_enumerate_boots(j, &id, &first, &last) == 1);
+        assert_se(sd_id128_equal(id, z) && first == 1020 && last == 1025);
+        assert_se(sd_journal_enumerate_boots(j, &id, &first, &last) == 1);
+        assert_se(sd_id128_equal(id, w) && first == 1030 && last == 1031);
+        assert_se(sd_journal_enumerate_boots(j, &id, &first, &last) == 0);
+
+        sd_journal_restart_boots(j);
+        assert_se(sd_journal_enumerate_boots(j, &id, NULL, NULL) == 1);
+        assert_se(sd_id128_equal(id, x));
+
+        sd_journal_close(j);
+
+        assert_se(rm_rf(t, REMOVE_ROOT|REMOVE_PHYSICAL) >= 0);
+
+        puts("------------------------------------------------------------");
+}
+
+#define N_ENTRY_ARRAY_INDEX_ENTRIES 30000U
+
+static void test_entry_array_index_seek(JournalFile *f, uint64_t dp, uint64_t seqnum) {
+        Object *o;
+        int r;
+
+        /* Every entry has FOO=bar, every third one (seqnum 3, 6, 9, …) has BAR=foo too */
+
+        r = journal_file_move_to_entry_by_seqnum(f, seqnum, DIRECTION_DOWN, &o, NULL);
+        assert_se(r >= 0);
+        if (seqnum > N_ENTRY_ARRAY_INDEX_ENTRIES)
+                assert_se(r == 0);
+        else
+                assert_se(r > 0 && le64toh(o->entry.seqnum) == MAX(seqnum, 1U));
+
+        r = journal_file_move_to_entry_by_seqnum_for_data(f, dp, seqnum, DIRECTION_DOWN, &o, NULL);
+        assert_se(r >= 0);
+        if (DIV_ROUND_UP(MAX(seqnum, 1U), 3) * 3 > N_ENTRY_ARRAY_INDEX_ENTRIES)
+                assert_se(r == 0);
+        else
+                assert_se(r > 0 && le64toh(o->entry.seqnum) == DIV_ROUND_UP(MAX(seqnum, 1U), 3) * 3);
+
+        r = journal_file_move_to_entry_by_seqnum_for_data(f, dp, seqnum, DIRECTION_UP, &o, NULL);
+        assert_se(r >= 0);
+        if (seqnum < 3)
+                assert_se(r == 0);
+        else
+                assert_se(r > 0 && le64toh(o->entry.seqnum) == MIN(seqnum, N_ENTRY_ARRAY_INDEX_ENTRIES) / 3 * 3);
+}
+
+static void test_entry_array_index_one(bool reopen) {
+        struct iovec iovec[2];
+        dual_timestamp ts;
+        JournalFile *f;
+        uint64_t dp;
+        Object *o;
+        unsigned i;
+        char t[] = "/var/tmp/journal-entry-array-index-XXXXXX";
+
+        mkdtemp_chdir_chattr(t);
+
+        assert_se(journal_file_open(-1, "test.journal", O_RDWR|O_CREAT, 0666, true, (uint64_t) -1, false, NULL, NULL, NULL, NULL, &f) == 0);
+
+        for (i = 1; i <= N_ENTRY_ARRAY_INDEX_ENTRIES; i++) {
+                /* When reopening, the entry arrays appended before are only found by walking the chains */
+                if (reopen && i == N_ENTRY_ARRAY_INDEX_ENTRIES / 2) {
+                        (void) journal_file_close(f);
+                        assert_se(journal_file_open(-1, "test.journal", O_RDWR, 0, true, (uint64_t) -1, false, NULL, NULL, NULL, NULL, &f) == 0);
+                }
+
+                assert_se(dual_timestamp_get(&ts));
+                iovec[0] = IOVEC_MAKE_STRING("FOO=bar");
+                iovec[1] = IOVEC_MAKE_STRING("BAR=foo");
+                assert_se(journal_file_append_entry(f, &ts, NULL, iovec, i % 3 == 0 ? 2 : 1, NULL, NULL, NULL) == 0);
+        }
+
+        /* The index is added when archiving */
+        assert_se(f->header->entry_array_index_offset == 0);
+        assert_se(journal_file_archive(f) >= 0);
+        assert_se(f->header->entry_array_index_offset != 0);
+
+        assert_se(journal_file_find_data_object(f, "BAR=foo", STRLEN("BAR=foo"), NULL, &dp) > 0);
+
+        test_entry_array_index_seek(f, dp, 0);
+        test_entry_array_index_seek(f, dp, 1);
+        for (i = 2; i <= N_ENTRY_ARRAY_INDEX_ENTRIES; i += 997) {
+                test_entry_array_index_seek(f, dp, i);
+                test_entry_array_index_seek(f, dp, i + 1);
+                test_entry_array_index_seek(f, dp, i + 2);
+        }
+        test_entry_array_index_seek(f, dp, N_ENTRY_ARRAY_INDEX_ENTRIES);
+        test_entry_array_index_seek(f, dp, N_ENTRY_ARRAY_INDEX_ENTRIES + 1);
+
+        /* Looking up the last entry goes through the index too */
+        assert_se(journal_file_next_entry_for_data(f, NULL, 0, dp, DIRECTION_UP, &o, NULL) > 0);
+        assert_se(le64toh(o->entry.seqnum) == N_ENTRY_ARRAY_INDEX_ENTRIES / 3 * 3);
+
+        assert_se(journal_file_verify(f, NULL, NULL, NULL, NULL, false) >= 0);
+
+        (void) journal_file_close(f);
+
+        assert_se(rm_rf(t, REMOVE_ROOT|REMOVE_PHYSICAL) >= 0);
+}
+
+static void test_entry_array_index(void) {
+        test_entry_array_index_one(false);
+        test_entry_array_index_one(true);
+
+        puts("------------------------------------------------------------");
+}
+
+#if HAVE_ZSTD
+#define N_DICTIONARY_ENTRIES 1500U
+
+static void test_dictionary(void) {
+        struct iovec iovec;
+        dual_timestamp ts;
+        JournalFile *f;
+        uint64_t p, n_compressed = 0;
+        Object *o;
+        unsigned i;
+        char t[] = "/var/tmp/journal-dictionary-XXXXXX";
+
+        mkdtemp_chdir_chattr(t);
+
+        assert_se(journal_file_open(-1, "test.journal", O_RDWR|O_CREAT, 0666, true, (uint64_t) -1, false, NULL, NULL, NULL, NULL, &f) == 0);
+        assert_se(JOURNAL_HEADER_ZSTD_DICTIONARY(f->header));
+
+        assert_se(dual_timestamp_get(&ts));
+
+        /* Lots of small, similar, but distinct payloads, i.e. what the dictionary is for */
+        for (i = 0; i < N_DICTIONARY_ENTRIES; i++) {
+                char buf[STRLEN("MESSAGE=Started Session  of user user") + 2 * DECIMAL_STR_MAX(unsigned) + 1];
+
+                xsprintf(buf, "MESSAGE=Started Session %u of user user%u", i, i % 37);
+                iovec = IOVEC_MAKE_STRING(buf);
+
+                assert_se(journal_file_append_entry(f, &ts, NULL, &iovec, 1, NULL, NULL, NULL) == 0);
+        }
+
+        if (f->dictionary)
+                assert_se(f->header->dictionary_offset != 0);
+        else
+                log_notice("No dictionary was set up, small objects stay uncompressed.");
+
+        /* Every payload needs to be found again, whether it was compressed against the dictionary or not */
+        for (i = 0; i < N_DICTIONARY_ENTRIES; i++) {
+                char buf[STRLEN("MESSAGE=Started Session  of user user") + 2 * DECIMAL_STR_MAX(unsigned) + 1];
+
+                xsprintf(buf, "MESSAGE=Started Session %u of user user%u", i, i % 37);
+
+                assert_se(journal_file_find_data_object(f, buf, strlen(buf), &o, &p) == 1);
+                if (o->object.flags & OBJECT_COMPRESSED_ZSTD)
+                        n_compressed++;
+        }
+
+        log_info("%"PRIu64" of %u data objects compressed against the dictionary", n_compressed, N_DICTIONARY_ENTRIES);
+        assert_se(!f->dictionary == (n_compressed == 0));
+
+        assert_se(journal_file_verify(f, NULL, NULL, NULL, NULL, false) >= 0);
+
+        (void) journal_file_close(f);
+
+        /* A reader has to pick the dictionary up from the file itself */
+        assert_se(journal_file_open(-1, "test.journal", O_RDONLY, 0666, true, (uint64_t) -1, false, NULL, NULL, NULL, NULL, &f) == 0);
+        assert_se(journal_file_find_data_object(f, "MESSAGE=Started Session 1499 of user user19", STRLEN("MESSAGE=Started Session 1499 of user user19"), NULL, NULL) == 1);
+        (void) journal_file_close(f);
+
+        assert_se(rm_rf(t, REMOVE_ROOT|REMOVE_PHYSICAL) >= 0);
+
+        puts("------------------------------------------------------------");
+}
+#endif
+
 int main(int argc, char *argv[]) {
         arg_keep = argc > 1;
 
@@ -251,7 +787,16 @@ int main(int argc, char *argv[]) {
 
         test_non_empty();
         test_empty();
-#if HAVE_XZ || HAVE_LZ4
+        test_append_entries();
+        test_data_cache();
+        test_time_index();
+        test_entry_array_index();
+        test_manifest();
+        test_boots();
+#if HAVE_ZSTD
+        test_dictionary();
+#endif
+#if HAVE_XZ || HAVE_LZ4 || HAVE_ZSTD
         test_min_compress_size();
 #endif
 
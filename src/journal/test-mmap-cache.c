@@ -2,6 +2,7 @@
 
 #include <fcntl.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/mman.h>
 #include <unistd.h>
 
@@ -11,6 +12,99 @@
 #include "tmpfile-util.h"
 #include "util.h"
 
+#define SCAN_FILE_SIZE (128ULL*1024ULL*1024ULL)
+/* Large enough for more than WINDOWS_MIN windows of the default size */
+#define PIN_FILE_SIZE (1024ULL*1024ULL*1024ULL)
+
+static void test_adaptive_windows(void) {
+        char px[] = "/tmp/testmmapSXXXXXX";
+        MMapFileDescriptor *fx;
+        unsigned missed;
+        uint64_t offset, size;
+        struct stat st;
+        MMapCache *m;
+        void *p;
+        int x;
+
+        assert_se(m = mmap_cache_new());
+
+        x = mkostemp_safe(px);
+        assert_se(x >= 0);
+        unlink(px);
+
+        /* A sparse file is good enough, we never look at the contents */
+        assert_se(ftruncate(x, SCAN_FILE_SIZE) >= 0);
+        assert_se(fstat(x, &st) >= 0);
+
+        assert_se(fx = mmap_cache_add_fd(m, x));
+
+        /* A sequential scan makes the windows grow, so that we need fewer of them than with fixed size
+         * windows */
+        size = mmap_cache_get_window_size(m, 0);
+        missed = mmap_cache_get_missed(m);
+        for (offset = 0; offset < SCAN_FILE_SIZE; offset += 64 * 1024)
+                assert_se(mmap_cache_get(m, fx, PROT_READ, 0, false, offset, 4096, &st, &p, NULL) > 0);
+
+        assert_se(mmap_cache_get_window_size(m, 0) >= size);
+        assert_se(mmap_cache_get_missed(m) - missed <= SCAN_FILE_SIZE / size);
+
+        /* Jumping around makes them shrink again */
+        size = mmap_cache_get_window_size(m, 1);
+        for (offset = 0; offset < 16; offset++)
+                assert_se(mmap_cache_get(m, fx, PROT_READ, 1, false, (offset * 7919 % 16) * (SCAN_FILE_SIZE / 16), 4096, &st, &p, NULL) > 0);
+
+        assert_se(mmap_cache_get_window_size(m, 1) <= size);
+
+        mmap_cache_free_fd(m, fx);
+        mmap_cache_unref(m);
+
+        safe_close(x);
+}
+
+static void test_pin(void) {
+        static const char marker[] = "pinned";
+        char px[] = "/tmp/testmmapPXXXXXX";
+        MMapFileDescriptor *fx;
+        MMapWindow *w;
+        unsigned k, evicted;
+        struct stat st;
+        MMapCache *m;
+        void *p, *q;
+        int x;
+
+        assert_se(m = mmap_cache_new());
+
+        x = mkostemp_safe(px);
+        assert_se(x >= 0);
+        unlink(px);
+
+        assert_se(ftruncate(x, PIN_FILE_SIZE) >= 0);
+        assert_se(pwrite(x, marker, sizeof(marker), 0) == sizeof(marker));
+        assert_se(fstat(x, &st) >= 0);
+
+        assert_se(fx = mmap_cache_add_fd(m, x));
+
+        assert_se(mmap_cache_get(m, fx, PROT_READ, 2, false, 0, sizeof(marker), &st, &p, NULL) >= 0);
+        assert_se(w = mmap_cache_pin(m, 2));
+
+        /* Map enough other windows via the same context for unused ones to be recycled */
+        evicted = mmap_cache_get_evicted(m);
+        for (k = 1; k < 512; k++)
+                assert_se(mmap_cache_get(m, fx, PROT_READ, 2, false, (k * 7919 % 128) * (PIN_FILE_SIZE / 128), 4096, &st, &q, NULL) >= 0);
+        assert_se(mmap_cache_get_evicted(m) > evicted);
+
+        /* The pinned window survived all that */
+        assert_se(memcmp(p, marker, sizeof(marker)) == 0);
+
+        mmap_cache_unpin(w);
+        assert_se(!mmap_cache_pin(m, 3));
+
+        mmap_cache_free_fd(m, fx);
+        mmap_cache_unref(m);
+
+        safe_close(x);
+}
+
 int main(int argc, char *argv[]) {
         MMapFileDescriptor *fx;
         int x, y, z, r;
@@ -62,5 +156,8 @@ int main(int argc, char *argv[]) {
         safe_close(y);
         safe_close(z);
 
+        test_adaptive_windows();
+        test_pin();
+
         return 0;
 }
@@ -11,6 +11,7 @@
 #include "dhcp-internal.h"
 #include "hashmap.h"
 #include "log.h"
+#include "prioq.h"
 #include "time-util.h"
 
 typedef enum DHCPRawOption {
@@ -35,6 +36,7 @@ typedef struct DHCPLease {
         be32_t gateway;
         uint8_t chaddr[16];
         usec_t expiration;
+        unsigned expiration_idx;
 } DHCPLease;
 
 struct sd_dhcp_server {
@@ -52,6 +54,7 @@ struct sd_dhcp_server {
         be32_t subnet;
         uint32_t pool_offset;
         uint32_t pool_size;
+        uint32_t pool_free;
 
         char *timezone;
 
@@ -65,6 +68,7 @@ struct sd_dhcp_server {
         Hashmap *leases_by_client_id;
         DHCPLease **bound_leases;
         DHCPLease invalid_lease;
+        Prioq *leases_by_expiration;
 
         uint32_t max_lease_time, default_lease_time;
 };
@@ -81,8 +85,8 @@ typedef struct DHCPRequest {
         uint32_t lifetime;
 } DHCPRequest;
 
-#define log_dhcp_server(client, fmt, ...) log_internal(LOG_DEBUG, 0, PROJECT_FILE, __LINE__, __func__, "DHCP SERVER: " fmt, ##__VA_ARGS__)
-#define log_dhcp_server_errno(client, error, fmt, ...) log_internal(LOG_DEBUG, error, PROJECT_FILE, __LINE__, __func__, "DHCP SERVER: " fmt, ##__VA_ARGS__)
+#define log_dhcp_server(client, fmt, ...) log_full(LOG_DEBUG, "DHCP SERVER: " fmt, ##__VA_ARGS__)
+#define log_dhcp_server_errno(client, error, fmt, ...) log_full_errno(LOG_DEBUG, error, "DHCP SERVER: " fmt, ##__VA_ARGS__)
 
 int dhcp_server_handle_message(sd_dhcp_server *server, DHCPMessage *message,
                                size_t length);
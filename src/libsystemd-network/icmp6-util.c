@@ -30,10 +30,13 @@
 
 static int icmp6_bind_router_message(const struct icmp6_filter *filter,
                                      const struct ipv6_mreq *mreq) {
-        int ifindex = mreq->ipv6mr_interface;
+        int ifindex = mreq ? (int) mreq->ipv6mr_interface : 0;
         _cleanup_close_ int s = -1;
         int r;
 
+        /* Without mreq the socket is not bound to any interface, and receives the messages of all of them.
+         * The all-nodes group is joined by the kernel on each IPv6 capable interface anyway. */
+
         s = socket(AF_INET6, SOCK_RAW | SOCK_CLOEXEC | SOCK_NONBLOCK, IPPROTO_ICMPV6);
         if (s < 0)
                 return -errno;
@@ -42,17 +45,21 @@ static int icmp6_bind_router_message(const struct icmp6_filter *filter,
         if (r < 0)
                 return -errno;
 
-        r = setsockopt(s, IPPROTO_IPV6, IPV6_ADD_MEMBERSHIP, mreq, sizeof(*mreq));
-        if (r < 0)
-                return -errno;
+        if (mreq) {
+                r = setsockopt(s, IPPROTO_IPV6, IPV6_ADD_MEMBERSHIP, mreq, sizeof(*mreq));
+                if (r < 0)
+                        return -errno;
+        }
 
         /* RFC 3315, section 6.7, bullet point 2 may indicate that an
            IPV6_PKTINFO socket option also applies for ICMPv6 multicast.
            Empirical experiments indicates otherwise and therefore an
            IPV6_MULTICAST_IF socket option is used here instead */
-        r = setsockopt_int(s, IPPROTO_IPV6, IPV6_MULTICAST_IF, ifindex);
-        if (r < 0)
-                return r;
+        if (ifindex > 0) {
+                r = setsockopt_int(s, IPPROTO_IPV6, IPV6_MULTICAST_IF, ifindex);
+                if (r < 0)
+                        return r;
+        }
 
         r = setsockopt_int(s, IPPROTO_IPV6, IPV6_MULTICAST_LOOP, false);
         if (r < 0)
@@ -74,9 +81,11 @@ static int icmp6_bind_router_message(const struct icmp6_filter *filter,
         if (r < 0)
                 return r;
 
-        r = socket_bind_to_ifindex(s, ifindex);
-        if (r < 0)
-                return r;
+        if (ifindex > 0) {
+                r = socket_bind_to_ifindex(s, ifindex);
+                if (r < 0)
+                        return r;
+        }
 
         return TAKE_FD(s);
 }
@@ -94,6 +103,15 @@ int icmp6_bind_router_solicitation(int index) {
         return icmp6_bind_router_message(&filter, &mreq);
 }
 
+int icmp6_bind_router_solicitation_shared(void) {
+        struct icmp6_filter filter = {};
+
+        ICMP6_FILTER_SETBLOCKALL(&filter);
+        ICMP6_FILTER_SETPASS(ND_ROUTER_ADVERT, &filter);
+
+        return icmp6_bind_router_message(&filter, NULL);
+}
+
 int icmp6_bind_router_advertisement(int index) {
         struct icmp6_filter filter = {};
         struct ipv6_mreq mreq = {
@@ -107,10 +125,11 @@ int icmp6_bind_router_advertisement(int index) {
         return icmp6_bind_router_message(&filter, &mreq);
 }
 
-int icmp6_send_router_solicitation(int s, const struct ether_addr *ether_addr) {
+int icmp6_send_router_solicitation(int s, int ifindex, const struct ether_addr *ether_addr) {
         struct sockaddr_in6 dst = {
                 .sin6_family = AF_INET6,
                 .sin6_addr = IN6ADDR_ALL_ROUTERS_MULTICAST_INIT,
+                .sin6_scope_id = ifindex, /* selects the outgoing interface on shared sockets */
         };
         struct {
                 struct nd_router_solicit rs;
@@ -146,7 +165,7 @@ int icmp6_send_router_solicitation(int s, const struct ether_addr *ether_addr) {
 }
 
 int icmp6_receive(int fd, void *buffer, size_t size, struct in6_addr *dst,
-                  triple_timestamp *timestamp) {
+                  triple_timestamp *timestamp, int *ret_ifindex) {
         union {
                 struct cmsghdr cmsghdr;
                 uint8_t buf[CMSG_SPACE(sizeof(int)) + /* ttl */
@@ -181,8 +200,14 @@ int icmp6_receive(int fd, void *buffer, size_t size, struct in6_addr *dst,
                 if (in_addr_is_link_local(AF_INET6, (union in_addr_union*) dst) <= 0)
                         return -EADDRNOTAVAIL;
 
+                /* The scope of a link-local source address is the interface the message arrived on */
+                if (ret_ifindex)
+                        *ret_ifindex = sa.in6.sin6_scope_id;
+
         } else if (msg.msg_namelen > 0)
                 return -EPFNOSUPPORT;
+        else if (ret_ifindex)
+                *ret_ifindex = 0;
 
         /* namelen == 0 only happens when running the test-suite over a socketpair */
 
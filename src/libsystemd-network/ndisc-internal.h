@@ -14,12 +14,19 @@
 #define NDISC_MAX_ROUTER_SOLICITATION_INTERVAL (3600U * USEC_PER_SEC)
 #define NDISC_MAX_ROUTER_SOLICITATIONS 3U
 
+typedef struct NDiscSharedSocket NDiscSharedSocket;
+
 struct sd_ndisc {
         unsigned n_ref;
 
         int ifindex;
         int fd;
 
+        /* If set, fd is not owned by us but by the socket shared with the other clients of the same event
+         * loop, and received messages are dispatched by the ifindex they arrived on. */
+        bool use_shared_socket;
+        NDiscSharedSocket *shared_socket;
+
         sd_event *event;
         int event_priority;
 
@@ -37,7 +44,7 @@ struct sd_ndisc {
         void *userdata;
 };
 
-#define log_ndisc_errno(error, fmt, ...) log_internal(LOG_DEBUG, error, PROJECT_FILE, __LINE__, __func__, "NDISC: " fmt, ##__VA_ARGS__)
+#define log_ndisc_errno(error, fmt, ...) log_full_errno(LOG_DEBUG, error, "NDISC: " fmt, ##__VA_ARGS__)
 #define log_ndisc(fmt, ...) log_ndisc_errno(0, fmt, ##__VA_ARGS__)
 
 const char* ndisc_event_to_string(sd_ndisc_event e) _const_;
@@ -21,6 +21,9 @@
 #define DHCP_DEFAULT_LEASE_TIME_USEC USEC_PER_HOUR
 #define DHCP_MAX_LEASE_TIME_USEC (USEC_PER_HOUR*12)
 
+/* How many datagrams to process per wakeup before giving other event sources a chance */
+#define DHCP_SERVER_RECEIVE_BATCH 16U
+
 static DHCPLease *dhcp_lease_free(DHCPLease *lease) {
         if (!lease)
                 return NULL;
@@ -81,15 +84,19 @@ int sd_dhcp_server_configure_pool(sd_dhcp_server *server, struct in_addr *addres
 
                 server->pool_offset = offset;
                 server->pool_size = size;
+                server->pool_free = size;
 
                 server->address = address->s_addr;
                 server->netmask = netmask;
                 server->subnet = address->s_addr & netmask;
 
-                if (server_off >= offset && server_off - offset < size)
+                if (server_off >= offset && server_off - offset < size) {
                         server->bound_leases[server_off - offset] = &server->invalid_lease;
+                        server->pool_free--;
+                }
 
                 /* Drop any leases associated with the old address range */
+                server->leases_by_expiration = prioq_free(server->leases_by_expiration);
                 hashmap_clear(server->leases_by_client_id);
         }
 
@@ -127,6 +134,12 @@ int client_id_compare_func(const DHCPClientId *a, const DHCPClientId *b) {
 DEFINE_PRIVATE_HASH_OPS_WITH_VALUE_DESTRUCTOR(dhcp_lease_hash_ops, DHCPClientId, client_id_hash_func, client_id_compare_func,
                                               DHCPLease, dhcp_lease_free);
 
+static int lease_compare_expiration(const void *a, const void *b) {
+        const DHCPLease *x = a, *y = b;
+
+        return CMP(x->expiration, y->expiration);
+}
+
 static sd_dhcp_server *dhcp_server_free(sd_dhcp_server *server) {
         assert(server);
 
@@ -141,6 +154,7 @@ static sd_dhcp_server *dhcp_server_free(sd_dhcp_server *server) {
         free(server->ntp);
         free(server->sip);
 
+        prioq_free(server->leases_by_expiration);
         hashmap_free(server->leases_by_client_id);
 
         ordered_hashmap_free(server->raw_option);
@@ -686,6 +700,43 @@ static int get_pool_offset(sd_dhcp_server *server, be32_t requested_ip) {
         return be32toh(requested_ip & ~server->netmask) - server->pool_offset;
 }
 
+static void dhcp_server_drop_lease(sd_dhcp_server *server, DHCPLease *lease) {
+        int pool_offset;
+
+        assert(server);
+        assert(lease);
+
+        pool_offset = get_pool_offset(server, lease->address);
+        if (pool_offset >= 0 && server->bound_leases[pool_offset] == lease) {
+                server->bound_leases[pool_offset] = NULL;
+                server->pool_free++;
+        }
+
+        prioq_remove(server->leases_by_expiration, lease, &lease->expiration_idx);
+        hashmap_remove_value(server->leases_by_client_id, &lease->client_id, lease);
+        dhcp_lease_free(lease);
+}
+
+static void dhcp_server_expire_leases(sd_dhcp_server *server) {
+        DHCPLease *lease;
+        usec_t time_now;
+
+        assert(server);
+
+        if (prioq_isempty(server->leases_by_expiration))
+                return;
+
+        if (!server->event ||
+            sd_event_now(server->event, clock_boottime_or_monotonic(), &time_now) < 0)
+                return;
+
+        /* The queue is ordered by expiration, hence only the expired leases are looked at */
+        while ((lease = prioq_peek(server->leases_by_expiration)) && lease->expiration <= time_now) {
+                log_dhcp_server(server, "EXPIRE (0x%x)", be32toh(lease->address));
+                dhcp_server_drop_lease(server, lease);
+        }
+}
+
 #define HASH_KEY SD_ID128_MAKE(0d,1d,fe,bd,f1,24,bd,b3,47,f1,dd,6e,73,21,93,30)
 
 int dhcp_server_handle_message(sd_dhcp_server *server, DHCPMessage *message,
@@ -716,6 +767,8 @@ int dhcp_server_handle_message(sd_dhcp_server *server, DHCPMessage *message,
                 /* this only fails on critical errors */
                 return r;
 
+        dhcp_server_expire_leases(server);
+
         existing_lease = hashmap_get(server->leases_by_client_id,
                                      &req->client_id);
 
@@ -735,7 +788,7 @@ int dhcp_server_handle_message(sd_dhcp_server *server, DHCPMessage *message,
                 /* for now pick a random free address from the pool */
                 if (existing_lease)
                         address = existing_lease->address;
-                else {
+                else if (server->pool_free > 0) {
                         struct siphash state;
                         uint64_t hash;
                         uint32_t next_offer;
@@ -842,6 +895,7 @@ int dhcp_server_handle_message(sd_dhcp_server *server, DHCPMessage *message,
                                 if (!lease)
                                         return -ENOMEM;
                                 lease->address = address;
+                                lease->expiration_idx = PRIOQ_IDX_NULL;
                                 lease->client_id.data = memdup(req->client_id.data,
                                                                req->client_id.length);
                                 if (!lease->client_id.data) {
@@ -879,9 +933,27 @@ int dhcp_server_handle_message(sd_dhcp_server *server, DHCPMessage *message,
                                 log_dhcp_server(server, "ACK (0x%x)",
                                                 be32toh(req->message->xid));
 
-                                server->bound_leases[pool_offset] = lease;
-                                hashmap_put(server->leases_by_client_id,
-                                            &lease->client_id, lease);
+                                if (!existing_lease) {
+                                        r = hashmap_put(server->leases_by_client_id,
+                                                        &lease->client_id, lease);
+                                        if (r < 0) {
+                                                dhcp_lease_free(lease);
+                                                return r;
+                                        }
+
+                                        server->bound_leases[pool_offset] = lease;
+                                        server->pool_free--;
+                                }
+
+                                r = prioq_ensure_allocated(&server->leases_by_expiration, lease_compare_expiration);
+                                if (r >= 0) {
+                                        if (lease->expiration_idx == PRIOQ_IDX_NULL)
+                                                r = prioq_put(server->leases_by_expiration, lease, &lease->expiration_idx);
+                                        else
+                                                r = prioq_reshuffle(server->leases_by_expiration, lease, &lease->expiration_idx);
+                                }
+                                if (r < 0)
+                                        log_dhcp_server_errno(server, r, "Failed to track lease expiration, ignoring: %m");
 
                                 return DHCP_ACK;
                         }
@@ -915,11 +987,8 @@ int dhcp_server_handle_message(sd_dhcp_server *server, DHCPMessage *message,
                 if (pool_offset < 0)
                         return 0;
 
-                if (server->bound_leases[pool_offset] == existing_lease) {
-                        server->bound_leases[pool_offset] = NULL;
-                        hashmap_remove(server->leases_by_client_id, existing_lease);
-                        dhcp_lease_free(existing_lease);
-                }
+                if (server->bound_leases[pool_offset] == existing_lease)
+                        dhcp_server_drop_lease(server, existing_lease);
 
                 return 0;
         }}
@@ -927,11 +996,9 @@ int dhcp_server_handle_message(sd_dhcp_server *server, DHCPMessage *message,
         return 0;
 }
 
-static int server_receive_message(sd_event_source *s, int fd,
-                                  uint32_t revents, void *userdata) {
+static int server_receive_one(sd_dhcp_server *server, int fd) {
         _cleanup_free_ DHCPMessage *message = NULL;
         uint8_t cmsgbuf[CMSG_LEN(sizeof(struct in_pktinfo))];
-        sd_dhcp_server *server = userdata;
         struct iovec iov = {};
         struct msghdr msg = {
                 .msg_iov = &iov,
@@ -945,7 +1012,11 @@ static int server_receive_message(sd_event_source *s, int fd,
 
         assert(server);
 
+        /* Returns 1 if a datagram was consumed, 0 if there was none queued */
+
         buflen = next_datagram_size_fd(fd);
+        if (IN_SET(buflen, -EAGAIN, -EINTR))
+                return 0;
         if (buflen < 0)
                 return buflen;
 
@@ -963,7 +1034,7 @@ static int server_receive_message(sd_event_source *s, int fd,
                 return -errno;
         }
         if ((size_t)len < sizeof(DHCPMessage))
-                return 0;
+                return 1;
 
         CMSG_FOREACH(cmsg, &msg) {
                 if (cmsg->cmsg_level == IPPROTO_IP &&
@@ -974,7 +1045,7 @@ static int server_receive_message(sd_event_source *s, int fd,
                         /* TODO figure out if this can be done as a filter on
                          * the socket, like for IPv6 */
                         if (server->ifindex != info->ipi_ifindex)
-                                return 0;
+                                return 1;
 
                         break;
                 }
@@ -984,6 +1055,25 @@ static int server_receive_message(sd_event_source *s, int fd,
         if (r < 0)
                 log_dhcp_server_errno(server, r, "Couldn't process incoming message: %m");
 
+        return 1;
+}
+
+static int server_receive_message(sd_event_source *s, int fd,
+                                  uint32_t revents, void *userdata) {
+        sd_dhcp_server *server = userdata;
+        unsigned i;
+        int r;
+
+        assert(server);
+
+        /* During boot storms many requests are queued at once, hence drain a bunch of them per wakeup
+         * instead of going through the event loop for each one. */
+        for (i = 0; i < DHCP_SERVER_RECEIVE_BATCH; i++) {
+                r = server_receive_one(server, fd);
+                if (r <= 0)
+                        return r;
+        }
+
         return 0;
 }
 
@@ -11,6 +11,7 @@
 #include "alloc-util.h"
 #include "event-util.h"
 #include "fd-util.h"
+#include "hashmap.h"
 #include "icmp6-util.h"
 #include "in-addr-util.h"
 #include "memory-util.h"
@@ -23,6 +24,19 @@
 
 #define NDISC_TIMEOUT_NO_RA_USEC (NDISC_ROUTER_SOLICITATION_INTERVAL * NDISC_MAX_ROUTER_SOLICITATIONS)
 
+/* One unbound ICMPv6 socket that receives the router advertisements for all clients that opted into it,
+ * instead of one socket per interface. There is at most one per thread, tied to the event loop of the
+ * first client using it. */
+struct NDiscSharedSocket {
+        sd_event *event;
+        int fd;
+        sd_event_source *recv_event_source;
+
+        Hashmap *ndisc_by_ifindex;
+};
+
+static thread_local NDiscSharedSocket *ndisc_shared_socket = NULL;
+
 static const char * const ndisc_event_table[_SD_NDISC_EVENT_MAX] = {
         [SD_NDISC_EVENT_TIMEOUT] = "timeout",
         [SD_NDISC_EVENT_ROUTER] = "router",
@@ -76,6 +90,14 @@ _public_ int sd_ndisc_set_mac(sd_ndisc *nd, const struct ether_addr *mac_addr) {
         return 0;
 }
 
+_public_ int sd_ndisc_set_shared_socket(sd_ndisc *nd, int b) {
+        assert_return(nd, -EINVAL);
+        assert_return(nd->fd < 0, -EBUSY);
+
+        nd->use_shared_socket = b;
+        return 0;
+}
+
 _public_ int sd_ndisc_attach_event(sd_ndisc *nd, sd_event *event, int64_t priority) {
         int r;
 
@@ -111,6 +133,41 @@ _public_ sd_event *sd_ndisc_get_event(sd_ndisc *nd) {
         return nd->event;
 }
 
+static NDiscSharedSocket *ndisc_shared_socket_free(NDiscSharedSocket *s) {
+        if (!s)
+                return NULL;
+
+        assert(hashmap_isempty(s->ndisc_by_ifindex));
+
+        if (ndisc_shared_socket == s)
+                ndisc_shared_socket = NULL;
+
+        sd_event_source_unref(s->recv_event_source);
+        safe_close(s->fd);
+        sd_event_unref(s->event);
+        hashmap_free(s->ndisc_by_ifindex);
+
+        return mfree(s);
+}
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(NDiscSharedSocket*, ndisc_shared_socket_free);
+
+static void ndisc_shared_socket_detach(sd_ndisc *nd) {
+        NDiscSharedSocket *s;
+
+        assert(nd);
+
+        s = TAKE_PTR(nd->shared_socket);
+        if (!s)
+                return;
+
+        hashmap_remove_value(s->ndisc_by_ifindex, INT_TO_PTR(nd->ifindex), nd);
+        nd->fd = -1;
+
+        if (hashmap_isempty(s->ndisc_by_ifindex))
+                ndisc_shared_socket_free(s);
+}
+
 static void ndisc_reset(sd_ndisc *nd) {
         assert(nd);
 
@@ -118,7 +175,11 @@ static void ndisc_reset(sd_ndisc *nd) {
         (void) event_source_disable(nd->timeout_no_ra);
         nd->retransmit_time = 0;
         nd->recv_event_source = sd_event_source_unref(nd->recv_event_source);
-        nd->fd = safe_close(nd->fd);
+
+        if (nd->shared_socket)
+                ndisc_shared_socket_detach(nd);
+        else
+                nd->fd = safe_close(nd->fd);
 }
 
 static sd_ndisc *ndisc_free(sd_ndisc *nd) {
@@ -202,16 +263,15 @@ static int ndisc_handle_datagram(sd_ndisc *nd, sd_ndisc_router *rt) {
         return 0;
 }
 
-static int ndisc_recv(sd_event_source *s, int fd, uint32_t revents, void *userdata) {
+static int ndisc_receive_router(int fd, sd_ndisc_router **ret, int *ret_ifindex) {
         _cleanup_(sd_ndisc_router_unrefp) sd_ndisc_router *rt = NULL;
-        sd_ndisc *nd = userdata;
+        _cleanup_free_ char *addr = NULL;
         ssize_t buflen;
         int r;
-        _cleanup_free_ char *addr = NULL;
 
-        assert(s);
-        assert(nd);
-        assert(nd->event);
+        assert(ret);
+
+        /* Returns 0 and no router if the datagram is to be ignored */
 
         buflen = next_datagram_size_fd(fd);
         if (buflen < 0)
@@ -222,7 +282,7 @@ static int ndisc_recv(sd_event_source *s, int fd, uint32_t revents, void *userda
                 return -ENOMEM;
 
         r = icmp6_receive(fd, NDISC_ROUTER_RAW(rt), rt->raw_size, &rt->address,
-                     &rt->timestamp);
+                          &rt->timestamp, ret_ifindex);
         if (r < 0) {
                 switch (r) {
                 case -EADDRNOTAVAIL:
@@ -246,14 +306,110 @@ static int ndisc_recv(sd_event_source *s, int fd, uint32_t revents, void *userda
                         break;
                 }
 
+                *ret = NULL;
                 return 0;
         }
 
+        *ret = TAKE_PTR(rt);
+        return 0;
+}
+
+static int ndisc_recv(sd_event_source *s, int fd, uint32_t revents, void *userdata) {
+        _cleanup_(sd_ndisc_router_unrefp) sd_ndisc_router *rt = NULL;
+        sd_ndisc *nd = userdata;
+        int r;
+
+        assert(s);
+        assert(nd);
+        assert(nd->event);
+
+        r = ndisc_receive_router(fd, &rt, NULL);
+        if (r < 0 || !rt)
+                return r;
+
         (void) event_source_disable(nd->timeout_event_source);
 
         return ndisc_handle_datagram(nd, rt);
 }
 
+static int ndisc_shared_recv(sd_event_source *s, int fd, uint32_t revents, void *userdata) {
+        _cleanup_(sd_ndisc_router_unrefp) sd_ndisc_router *rt = NULL;
+        NDiscSharedSocket *shared = userdata;
+        sd_ndisc *nd;
+        int ifindex, r;
+
+        assert(s);
+        assert(shared);
+
+        r = ndisc_receive_router(fd, &rt, &ifindex);
+        if (r < 0 || !rt)
+                return r;
+
+        nd = hashmap_get(shared->ndisc_by_ifindex, INT_TO_PTR(ifindex));
+        if (!nd)
+                return 0;
+
+        (void) event_source_disable(nd->timeout_event_source);
+
+        return ndisc_handle_datagram(nd, rt);
+}
+
+static int ndisc_shared_socket_attach(sd_ndisc *nd) {
+        _cleanup_(ndisc_shared_socket_freep) NDiscSharedSocket *new_socket = NULL;
+        NDiscSharedSocket *s;
+        int r;
+
+        assert(nd);
+        assert(nd->event);
+        assert(!nd->shared_socket);
+
+        s = ndisc_shared_socket;
+        if (s) {
+                if (s->event != nd->event)
+                        return -EXDEV;
+        } else {
+                new_socket = new(NDiscSharedSocket, 1);
+                if (!new_socket)
+                        return -ENOMEM;
+
+                *new_socket = (NDiscSharedSocket) {
+                        .event = sd_event_ref(nd->event),
+                        .fd = -1,
+                };
+
+                new_socket->fd = icmp6_bind_router_solicitation_shared();
+                if (new_socket->fd < 0)
+                        return new_socket->fd;
+
+                r = sd_event_add_io(nd->event, &new_socket->recv_event_source, new_socket->fd, EPOLLIN, ndisc_shared_recv, new_socket);
+                if (r < 0)
+                        return r;
+
+                r = sd_event_source_set_priority(new_socket->recv_event_source, nd->event_priority);
+                if (r < 0)
+                        return r;
+
+                (void) sd_event_source_set_description(new_socket->recv_event_source, "ndisc-receive-message-shared");
+
+                s = new_socket;
+        }
+
+        r = hashmap_ensure_allocated(&s->ndisc_by_ifindex, NULL);
+        if (r < 0)
+                return r;
+
+        r = hashmap_put(s->ndisc_by_ifindex, INT_TO_PTR(nd->ifindex), nd);
+        if (r < 0)
+                return r;
+
+        if (new_socket)
+                ndisc_shared_socket = TAKE_PTR(new_socket);
+
+        nd->shared_socket = s;
+        nd->fd = s->fd;
+        return 0;
+}
+
 static usec_t ndisc_timeout_compute_random(usec_t val) {
         /* compute a time that is random within ±10% of the given value */
         return val - val / 10 +
@@ -289,7 +445,7 @@ static int ndisc_timeout(sd_event_source *s, uint64_t usec, void *userdata) {
         if (r < 0)
                 goto fail;
 
-        r = icmp6_send_router_solicitation(nd->fd, &nd->mac_addr);
+        r = icmp6_send_router_solicitation(nd->fd, nd->ifindex, &nd->mac_addr);
         if (r < 0) {
                 log_ndisc_errno(r, "Error sending Router Solicitation: %m");
                 goto fail;
@@ -349,19 +505,27 @@ _public_ int sd_ndisc_start(sd_ndisc *nd) {
         if (r < 0)
                 goto fail;
 
-        nd->fd = icmp6_bind_router_solicitation(nd->ifindex);
-        if (nd->fd < 0)
-                return nd->fd;
+        if (nd->use_shared_socket) {
+                r = ndisc_shared_socket_attach(nd);
+                if (r < 0)
+                        log_ndisc_errno(r, "Failed to use shared ICMPv6 socket, using a separate one: %m");
+        }
 
-        r = sd_event_add_io(nd->event, &nd->recv_event_source, nd->fd, EPOLLIN, ndisc_recv, nd);
-        if (r < 0)
-                goto fail;
+        if (!nd->shared_socket) {
+                nd->fd = icmp6_bind_router_solicitation(nd->ifindex);
+                if (nd->fd < 0)
+                        return nd->fd;
 
-        r = sd_event_source_set_priority(nd->recv_event_source, nd->event_priority);
-        if (r < 0)
-                goto fail;
+                r = sd_event_add_io(nd->event, &nd->recv_event_source, nd->fd, EPOLLIN, ndisc_recv, nd);
+                if (r < 0)
+                        goto fail;
 
-        (void) sd_event_source_set_description(nd->recv_event_source, "ndisc-receive-message");
+                r = sd_event_source_set_priority(nd->recv_event_source, nd->event_priority);
+                if (r < 0)
+                        goto fail;
+
+                (void) sd_event_source_set_description(nd->recv_event_source, "ndisc-receive-message");
+        }
 
         r = event_reset_time(nd->event, &nd->timeout_event_source,
                              clock_boottime_or_monotonic(),
@@ -234,7 +234,7 @@ static int radv_recv(sd_event_source *s, int fd, uint32_t revents, void *userdat
         if (!buf)
                 return -ENOMEM;
 
-        r = icmp6_receive(fd, buf, buflen, &src, &timestamp);
+        r = icmp6_receive(fd, buf, buflen, &src, &timestamp, NULL);
         if (r < 0) {
                 switch (r) {
                 case -EADDRNOTAVAIL:
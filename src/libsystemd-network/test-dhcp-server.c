@@ -112,6 +112,9 @@ static void test_message_handler(void) {
         assert_se(sd_dhcp_server_attach_event(server, NULL, 0) >= 0);
         assert_se(sd_dhcp_server_start(server) >= 0);
 
+        /* the server's own address is reserved */
+        assert_se(server->pool_free == server->pool_size - 1);
+
         assert_se(dhcp_server_handle_message(server, (DHCPMessage*)&test, sizeof(test)) == DHCP_OFFER);
 
         test.end = 0;
@@ -155,6 +158,8 @@ static void test_message_handler(void) {
         test.option_server_id.address = htobe32(INADDR_LOOPBACK);
         test.option_requested_ip.address = htobe32(INADDR_LOOPBACK + 3);
         assert_se(dhcp_server_handle_message(server, (DHCPMessage*)&test, sizeof(test)) == DHCP_ACK);
+        assert_se(server->pool_free == server->pool_size - 2);
+        assert_se(prioq_size(server->leases_by_expiration) == 1);
 
         test.option_server_id.address = htobe32(0x12345678);
         test.option_requested_ip.address = htobe32(INADDR_LOOPBACK + 3);
@@ -176,6 +181,10 @@ static void test_message_handler(void) {
         test.option_client_id.id[6] = 'F';
         assert_se(dhcp_server_handle_message(server, (DHCPMessage*)&test, sizeof(test)) == DHCP_ACK);
 
+        /* renewing the lease does not allocate another address */
+        assert_se(server->pool_free == server->pool_size - 2);
+        assert_se(prioq_size(server->leases_by_expiration) == 1);
+
         test.option_requested_ip.address = htobe32(INADDR_LOOPBACK + 30);
         assert_se(dhcp_server_handle_message(server, (DHCPMessage*)&test, sizeof(test)) == 0);
 }
@@ -183,18 +183,26 @@ int icmp6_bind_router_solicitation(int index) {
         return test_fd[0];
 }
 
+int icmp6_bind_router_solicitation_shared(void) {
+
+        return -ENOSYS;
+}
+
 int icmp6_bind_router_advertisement(int index) {
 
         return -ENOSYS;
 }
 
 int icmp6_receive(int fd, void *iov_base, size_t iov_len,
-                  struct in6_addr *dst, triple_timestamp *timestamp) {
+                  struct in6_addr *dst, triple_timestamp *timestamp, int *ret_ifindex) {
         assert_se(read (fd, iov_base, iov_len) == (ssize_t)iov_len);
 
         if (timestamp)
                 triple_timestamp_get(timestamp);
 
+        if (ret_ifindex)
+                *ret_ifindex = 0;
+
         return 0;
 }
 
@@ -226,7 +234,7 @@ static int send_ra(uint8_t flags) {
         return 0;
 }
 
-int icmp6_send_router_solicitation(int s, const struct ether_addr *ether_addr) {
+int icmp6_send_router_solicitation(int s, int ifindex, const struct ether_addr *ether_addr) {
         if (!send_ra_function)
                 return 0;
 
@@ -516,13 +516,6 @@ typedef struct _packed_ pcap_hdr_s {
         uint32_t network;        /* data link type */
 } pcap_hdr_t ;
 
-typedef struct  _packed_ pcaprec_hdr_s {
-        uint32_t ts_sec;         /* timestamp seconds */
-        uint32_t ts_usec;        /* timestamp microseconds */
-        uint32_t incl_len;       /* number of octets of packet saved in file */
-        uint32_t orig_len;       /* actual length of packet */
-} pcaprec_hdr_t;
-
 int bus_pcap_header(size_t snaplen, FILE *f) {
 
         pcap_hdr_t hdr = {
@@ -547,29 +540,37 @@ int bus_pcap_header(size_t snaplen, FILE *f) {
         return fflush_and_check(f);
 }
 
-int bus_message_pcap_frame(sd_bus_message *m, size_t snaplen, FILE *f) {
-        struct bus_body_part *part;
-        pcaprec_hdr_t hdr = {};
+void bus_message_pcap_frame_header(sd_bus_message *m, size_t snaplen, pcaprec_hdr_t *ret) {
         struct timeval tv;
-        unsigned i;
-        size_t w;
-
-        if (!f)
-                f = stdout;
 
         assert(m);
         assert(snaplen > 0);
         assert((size_t) (uint32_t) snaplen == snaplen);
+        assert(ret);
 
         if (m->realtime != 0)
                 timeval_store(&tv, m->realtime);
         else
                 assert_se(gettimeofday(&tv, NULL) >= 0);
 
-        hdr.ts_sec = tv.tv_sec;
-        hdr.ts_usec = tv.tv_usec;
-        hdr.orig_len = BUS_MESSAGE_SIZE(m);
-        hdr.incl_len = MIN(hdr.orig_len, snaplen);
+        *ret = (pcaprec_hdr_t) {
+                .ts_sec = tv.tv_sec,
+                .ts_usec = tv.tv_usec,
+                .orig_len = BUS_MESSAGE_SIZE(m),
+                .incl_len = MIN(BUS_MESSAGE_SIZE(m), snaplen),
+        };
+}
+
+int bus_message_pcap_frame(sd_bus_message *m, size_t snaplen, FILE *f) {
+        struct bus_body_part *part;
+        pcaprec_hdr_t hdr;
+        unsigned i;
+        size_t w;
+
+        if (!f)
+                f = stdout;
+
+        bus_message_pcap_frame_header(m, snaplen, &hdr);
 
         /* write the pcap header */
         fwrite(&hdr, 1, sizeof(hdr), f);
@@ -6,6 +6,8 @@
 
 #include "sd-bus.h"
 
+#include "macro.h"
+
 enum {
         BUS_MESSAGE_DUMP_WITH_HEADER  = 1 << 0,
         BUS_MESSAGE_DUMP_SUBTREE_ONLY = 1 << 1,
@@ -15,5 +17,13 @@ int bus_message_dump(sd_bus_message *m, FILE *f, unsigned flags);
 
 int bus_creds_dump(sd_bus_creds *c, FILE *f, bool terse);
 
+typedef struct _packed_ pcaprec_hdr_s {
+        uint32_t ts_sec;         /* timestamp seconds */
+        uint32_t ts_usec;        /* timestamp microseconds */
+        uint32_t incl_len;       /* number of octets of packet saved in file */
+        uint32_t orig_len;       /* actual length of packet */
+} pcaprec_hdr_t;
+
 int bus_pcap_header(size_t snaplen, FILE *f);
+void bus_message_pcap_frame_header(sd_bus_message *m, size_t snaplen, pcaprec_hdr_t *ret);
 int bus_message_pcap_frame(sd_bus_message *m, size_t snaplen, FILE *f);
@@ -102,6 +102,12 @@ struct node_vtable {
         const sd_bus_vtable *vtable;
         sd_bus_object_find_t find;
 
+        /* The methods and properties of the vtable, ordered by member name */
+        struct vtable_member *methods;
+        size_t n_methods;
+        struct vtable_member *properties;
+        size_t n_properties;
+
         LIST_FIELDS(struct node_vtable, vtables);
 };
 
@@ -219,6 +225,10 @@ struct sd_bus {
 
         void *rbuffer;
         size_t rbuffer_size;
+        /* Once running, the bytes before this offset have been turned into messages already */
+        size_t rbuffer_offset;
+        /* May be less than what is actually allocated, but never more */
+        size_t rbuffer_allocated;
 
         sd_bus_message **rqueue;
         size_t rqueue_size;
@@ -241,8 +251,7 @@ struct sd_bus {
         LIST_HEAD(struct filter_callback, filter_callbacks);
 
         Hashmap *nodes;
-        Hashmap *vtable_methods;
-        Hashmap *vtable_properties;
+        Hashmap *properties_cache;
 
         union sockaddr_union sockaddr;
         socklen_t sockaddr_size;
@@ -336,6 +345,10 @@ struct sd_bus {
 
 #define BUS_MESSAGE_SIZE_MAX (128*1024*1024)
 #define BUS_AUTH_SIZE_MAX (64*1024)
+
+/* Read this much from the socket at once if we can, so that a burst of small messages can be read with a
+ * single syscall */
+#define BUS_READ_AHEAD_SIZE (64*1024)
 /* Note that the D-Bus specification states that bus paths shall have no size limit. We enforce here one
  * anyway, since truly unbounded strings are a security problem. The limit we pick is relatively large however,
  * to not clash unnecessarily with real-life applications. */
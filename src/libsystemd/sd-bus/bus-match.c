@@ -52,12 +52,6 @@ static bool BUS_MATCH_IS_COMPARE(enum bus_match_node_type t) {
         return t >= BUS_MATCH_SENDER && t <= BUS_MATCH_ARG_HAS_LAST;
 }
 
-static bool BUS_MATCH_CAN_HASH(enum bus_match_node_type t) {
-        return (t >= BUS_MATCH_MESSAGE_TYPE && t <= BUS_MATCH_PATH) ||
-                (t >= BUS_MATCH_ARG && t <= BUS_MATCH_ARG_LAST) ||
-                (t >= BUS_MATCH_ARG_HAS && t <= BUS_MATCH_ARG_HAS_LAST);
-}
-
 static void bus_match_node_free(struct bus_match_node *node) {
         assert(node);
         assert(node->parent);
@@ -86,15 +80,19 @@ static void bus_match_node_free(struct bus_match_node *node) {
 
                 if (node->parent->type == BUS_MATCH_MESSAGE_TYPE)
                         hashmap_remove(node->parent->compare.children, UINT_TO_PTR(node->value.u8));
-                else if (BUS_MATCH_CAN_HASH(node->parent->type) && node->value.str)
+                else if (node->value.str)
                         hashmap_remove(node->parent->compare.children, node->value.str);
 
+                if (node->parent->type == BUS_MATCH_SENDER)
+                        set_remove(node->parent->compare.well_known, node);
+
                 free(node->value.str);
         }
 
         if (BUS_MATCH_IS_COMPARE(node->type)) {
                 assert(hashmap_isempty(node->compare.children));
                 hashmap_free(node->compare.children);
+                set_free(node->compare.well_known);
         }
 
         free(node);
@@ -204,39 +202,166 @@ static bool value_node_test(
         }
 }
 
-static bool value_node_same(
+static int bus_match_run_value(
+                sd_bus *bus,
                 struct bus_match_node *node,
-                enum bus_match_node_type parent_type,
-                uint8_t value_u8,
-                const char *value_str) {
+                const void *key,
+                uint8_t test_u8,
+                const char *test_str,
+                char **test_strv,
+                sd_bus_message *m) {
 
-        /* Tests parameters against this value node, not doing prefix
-         * magic and stuff, i.e. this one actually compares the match
-         * itself. */
+        struct bus_match_node *found;
 
         assert(node);
-        assert(node->type == BUS_MATCH_VALUE);
+        assert(BUS_MATCH_IS_COMPARE(node->type));
 
-        switch (parent_type) {
+        /* Looks up the value node with the specified key below a
+         * compare node, and runs it if it really matches. */
 
-        case BUS_MATCH_MESSAGE_TYPE:
-                return node->value.u8 == value_u8;
+        found = hashmap_get(node->compare.children, key);
+        if (!found)
+                return 0;
 
-        case BUS_MATCH_SENDER:
-        case BUS_MATCH_DESTINATION:
-        case BUS_MATCH_INTERFACE:
-        case BUS_MATCH_MEMBER:
-        case BUS_MATCH_PATH:
-        case BUS_MATCH_ARG ... BUS_MATCH_ARG_LAST:
-        case BUS_MATCH_ARG_HAS ... BUS_MATCH_ARG_HAS_LAST:
-        case BUS_MATCH_ARG_NAMESPACE ... BUS_MATCH_ARG_NAMESPACE_LAST:
-        case BUS_MATCH_PATH_NAMESPACE:
-        case BUS_MATCH_ARG_PATH ... BUS_MATCH_ARG_PATH_LAST:
-                return streq(node->value.str, value_str);
+        if (!value_node_test(found, node->type, test_u8, test_str, test_strv, m))
+                return 0;
 
-        default:
-                assert_not_reached("Invalid node type");
+        return bus_match_run(bus, found, m);
+}
+
+static int bus_match_run_sender(
+                sd_bus *bus,
+                struct bus_match_node *node,
+                const char *sender,
+                sd_bus_message *m) {
+
+        struct bus_match_node *c;
+        Iterator i;
+        char **name;
+        int r;
+
+        assert(node);
+        assert(node->type == BUS_MATCH_SENDER);
+
+        if (sender) {
+                r = bus_match_run_value(bus, node, sender, 0, sender, NULL, m);
+                if (r != 0)
+                        return r;
+        }
+
+        if (m->creds.mask & SD_BUS_CREDS_WELL_KNOWN_NAMES) {
+                STRV_FOREACH(name, m->creds.well_known_names) {
+                        if (streq_ptr(*name, sender))
+                                continue;
+
+                        r = bus_match_run_value(bus, node, *name, 0, sender, NULL, m);
+                        if (r != 0)
+                                return r;
+                }
+
+                return 0;
+        }
+
+        /* Without the list of well-known names of the sender all
+         * matches on well-known names are considered to match a
+         * unique sender, see value_node_test(). Those are kept in a
+         * set of their own, so that we don't have to go through the
+         * matches on unique names to find them. */
+
+        if (!sender || sender[0] != ':')
+                return 0;
+
+        SET_FOREACH(c, node->compare.well_known, i) {
+                r = bus_match_run(bus, c, m);
+                if (r != 0)
+                        return r;
+
+                if (bus && bus->match_callbacks_modified)
+                        return 0;
+        }
+
+        return 0;
+}
+
+static int bus_match_run_prefixes(
+                sd_bus *bus,
+                struct bus_match_node *node,
+                const char *value,
+                char separator,
+                bool simple,
+                sd_bus_message *m) {
+
+        _cleanup_free_ char *key = NULL;
+        size_t n, i;
+        int r;
+
+        assert(node);
+
+        /* Namespace and path matches compare prefixes of the value
+         * at label boundaries, see simple_pattern_check() and
+         * complex_pattern_check(). Instead of testing all patterns
+         * on the value, look up every prefix of the value that a
+         * matching pattern could be. */
+
+        if (!value)
+                return 0;
+
+        r = bus_match_run_value(bus, node, value, 0, value, NULL, m);
+        if (r != 0)
+                return r;
+
+        key = strdup(value);
+        if (!key)
+                return -ENOMEM;
+
+        n = strlen(key);
+        for (i = 0; i < n; i++) {
+                char c;
+
+                if (key[i] != separator)
+                        continue;
+
+                /* Simple patterns may end right before the
+                 * separator, all patterns may end with it */
+                if (simple) {
+                        key[i] = 0;
+                        r = bus_match_run_value(bus, node, key, 0, value, NULL, m);
+                        key[i] = separator;
+                        if (r != 0)
+                                return r;
+                }
+
+                if (i + 1 < n) {
+                        c = key[i + 1];
+                        key[i + 1] = 0;
+                        r = bus_match_run_value(bus, node, key, 0, value, NULL, m);
+                        key[i + 1] = c;
+                        if (r != 0)
+                                return r;
+                }
+        }
+
+        /* Complex patterns also match if the value is a prefix of the
+         * pattern ending in the separator. Those can't be looked up,
+         * but values ending in the separator are rare. */
+        if (!simple && n > 0 && value[n - 1] == separator) {
+                struct bus_match_node *c;
+                Iterator j;
+
+                HASHMAP_FOREACH(c, node->compare.children, j) {
+                        if (streq(c->value.str, value) || !startswith(c->value.str, value))
+                                continue;
+
+                        r = bus_match_run(bus, c, m);
+                        if (r != 0)
+                                return r;
+
+                        if (bus && bus->match_callbacks_modified)
+                                return 0;
+                }
         }
+
+        return 0;
 }
 
 int bus_match_run(
@@ -379,53 +504,48 @@ int bus_match_run(
                 assert_not_reached("Unknown match type.");
         }
 
-        if (BUS_MATCH_CAN_HASH(node->type)) {
-                struct bus_match_node *found;
+        /* All value nodes are kept in a hash table, look up the
+         * ones that may match and jump there directly */
 
-                /* Lookup via hash table, nice! So let's jump directly. */
+        switch (node->type) {
 
-                if (test_str)
-                        found = hashmap_get(node->compare.children, test_str);
-                else if (test_strv) {
-                        char **i;
+        case BUS_MATCH_MESSAGE_TYPE:
+                r = bus_match_run_value(bus, node, UINT_TO_PTR(test_u8), test_u8, NULL, NULL, m);
+                break;
 
-                        STRV_FOREACH(i, test_strv) {
-                                found = hashmap_get(node->compare.children, *i);
-                                if (found) {
-                                        r = bus_match_run(bus, found, m);
-                                        if (r != 0)
-                                                return r;
-                                }
-                        }
+        case BUS_MATCH_SENDER:
+                r = bus_match_run_sender(bus, node, test_str, m);
+                break;
 
-                        found = NULL;
-                } else if (node->type == BUS_MATCH_MESSAGE_TYPE)
-                        found = hashmap_get(node->compare.children, UINT_TO_PTR(test_u8));
-                else
-                        found = NULL;
+        case BUS_MATCH_PATH_NAMESPACE:
+                r = bus_match_run_prefixes(bus, node, test_str, '/', true, m);
+                break;
 
-                if (found) {
-                        r = bus_match_run(bus, found, m);
-                        if (r != 0)
-                                return r;
-                }
-        } else {
-                struct bus_match_node *c;
+        case BUS_MATCH_ARG_NAMESPACE ... BUS_MATCH_ARG_NAMESPACE_LAST:
+                r = bus_match_run_prefixes(bus, node, test_str, '.', true, m);
+                break;
 
-                /* No hash table, so let's iterate manually... */
+        case BUS_MATCH_ARG_PATH ... BUS_MATCH_ARG_PATH_LAST:
+                r = bus_match_run_prefixes(bus, node, test_str, '/', false, m);
+                break;
 
-                for (c = node->child; c; c = c->next) {
-                        if (!value_node_test(c, node->type, test_u8, test_str, test_strv, m))
-                                continue;
+        case BUS_MATCH_ARG_HAS ... BUS_MATCH_ARG_HAS_LAST: {
+                char **i;
 
-                        r = bus_match_run(bus, c, m);
+                r = 0;
+                STRV_FOREACH(i, test_strv) {
+                        r = bus_match_run_value(bus, node, *i, 0, NULL, test_strv, m);
                         if (r != 0)
-                                return r;
-
-                        if (bus && bus->match_callbacks_modified)
-                                return 0;
+                                break;
                 }
+                break;
+        }
+
+        default:
+                r = test_str ? bus_match_run_value(bus, node, test_str, 0, test_str, NULL, m) : 0;
         }
+        if (r != 0)
+                return r;
 
         if (bus && bus->match_callbacks_modified)
                 return 0;
@@ -458,12 +578,8 @@ static int bus_match_add_compare_value(
 
                 if (t == BUS_MATCH_MESSAGE_TYPE)
                         n = hashmap_get(c->compare.children, UINT_TO_PTR(value_u8));
-                else if (BUS_MATCH_CAN_HASH(t))
+                else
                         n = hashmap_get(c->compare.children, value_str);
-                else {
-                        for (n = c->child; n && !value_node_same(n, t, value_u8, value_str); n = n->next)
-                                ;
-                }
 
                 if (n) {
                         *ret = n;
@@ -486,18 +602,10 @@ static int bus_match_add_compare_value(
                         c->next->prev = c;
                 where->child = c;
 
-                if (t == BUS_MATCH_MESSAGE_TYPE) {
-                        c->compare.children = hashmap_new(NULL);
-                        if (!c->compare.children) {
-                                r = -ENOMEM;
-                                goto fail;
-                        }
-                } else if (BUS_MATCH_CAN_HASH(t)) {
-                        c->compare.children = hashmap_new(&string_hash_ops);
-                        if (!c->compare.children) {
-                                r = -ENOMEM;
-                                goto fail;
-                        }
+                c->compare.children = hashmap_new(t == BUS_MATCH_MESSAGE_TYPE ? NULL : &string_hash_ops);
+                if (!c->compare.children) {
+                        r = -ENOMEM;
+                        goto fail;
                 }
         }
 
@@ -518,26 +626,31 @@ static int bus_match_add_compare_value(
         }
 
         n->parent = c;
-        if (c->compare.children) {
 
-                if (t == BUS_MATCH_MESSAGE_TYPE)
-                        r = hashmap_put(c->compare.children, UINT_TO_PTR(value_u8), n);
-                else
-                        r = hashmap_put(c->compare.children, n->value.str, n);
+        if (t == BUS_MATCH_SENDER && n->value.str && n->value.str[0] != ':') {
+                r = set_ensure_allocated(&c->compare.well_known, NULL);
+                if (r < 0)
+                        goto fail;
 
+                r = set_put(c->compare.well_known, n);
                 if (r < 0)
                         goto fail;
-        } else {
-                n->next = c->child;
-                if (n->next)
-                        n->next->prev = n;
-                c->child = n;
         }
 
+        if (t == BUS_MATCH_MESSAGE_TYPE)
+                r = hashmap_put(c->compare.children, UINT_TO_PTR(value_u8), n);
+        else
+                r = hashmap_put(c->compare.children, n->value.str, n);
+        if (r < 0)
+                goto fail;
+
         *ret = n;
         return 1;
 
 fail:
+        if (n && c)
+                set_remove(c->compare.well_known, n);
+
         if (c)
                 bus_match_node_maybe_free(c);
 
@@ -960,7 +1073,7 @@ void bus_match_free(struct bus_match_node *node) {
         if (!node)
                 return;
 
-        if (BUS_MATCH_CAN_HASH(node->type)) {
+        if (BUS_MATCH_IS_COMPARE(node->type)) {
                 Iterator i;
 
                 HASHMAP_FOREACH(c, node->compare.children, i)
@@ -1053,7 +1166,7 @@ void bus_match_dump(struct bus_match_node *node, unsigned level) {
         else
                 putchar('\n');
 
-        if (BUS_MATCH_CAN_HASH(node->type)) {
+        if (BUS_MATCH_IS_COMPARE(node->type)) {
                 Iterator i;
 
                 HASHMAP_FOREACH(c, node->compare.children, i)
@@ -4,6 +4,7 @@
 #include "sd-bus.h"
 
 #include "hashmap.h"
+#include "set.h"
 
 enum bus_match_node_type {
         BUS_MATCH_ROOT,
@@ -43,8 +44,10 @@ struct bus_match_node {
                         struct match_callback *callback;
                 } leaf;
                 struct {
-                        /* If this is set, then the child is NULL */
+                        /* All value nodes, hashed by value, child is always NULL */
                         Hashmap *children;
+                        /* For BUS_MATCH_SENDER, the value nodes of well-known names */
+                        Set *well_known;
                 } compare;
         };
 };
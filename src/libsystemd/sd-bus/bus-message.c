@@ -143,6 +143,8 @@ static sd_bus_message* message_free(sd_bus_message *m) {
 
         message_reset_containers(m);
         assert(m->n_containers == 0);
+        if (m->borrowed_signature)
+                m->root_container.signature = NULL;
         message_free_last_container(m);
 
         bus_creds_done(&m->creds);
@@ -572,7 +574,11 @@ int bus_message_from_malloc(
         if (r < 0)
                 return r;
 
-        /* We take possession of the memory and fds now */
+        /* We take possession of the memory and of the fds the message declares now, which are the first ones
+         * of the array. The caller has to take care of the others, if there are any. */
+        if (m->n_fds == 0)
+                m->fds = NULL;
+
         m->free_header = true;
         m->free_fds = true;
 
@@ -1242,6 +1248,7 @@ static int part_make_space(
                 struct sd_bus_message *m,
                 struct bus_body_part *part,
                 size_t sz,
+                bool exact,
                 void **q) {
 
         void *n;
@@ -1256,7 +1263,7 @@ static int part_make_space(
         if (part->allocated == 0 || sz > part->allocated) {
                 size_t new_allocated;
 
-                new_allocated = sz > 0 ? 2 * sz : 64;
+                new_allocated = sz > 0 ? (exact ? sz : 2 * sz) : 64;
                 n = realloc(part->data, new_allocated);
                 if (!n) {
                         m->poisoned = true;
@@ -1345,9 +1352,17 @@ static void *message_extend_body(
 
         if (added > 0) {
                 struct bus_body_part *part = NULL;
-                bool add_new_part;
+                bool add_new_part, large;
+
+                /* Large extensions (i.e. big arrays and strings) get a part of their own of exactly their
+                 * size, which is never extended afterwards. That way neither they nor what came before are
+                 * copied around again by realloc() when more data is appended, and we don't allocate twice
+                 * the memory we need. Since body parts are written to the socket with a single writev(),
+                 * this doesn't cost anything when sending. */
+                large = sz >= MEMFD_MIN_SIZE && !force_inline;
 
                 add_new_part =
+                        large ||
                         m->n_body_parts <= 0 ||
                         m->body_end->sealed ||
                         (padding != ALIGN_TO(m->body_end->size, align) - m->body_end->size) ||
@@ -1368,9 +1383,12 @@ static void *message_extend_body(
                         if (!part)
                                 return NULL;
 
-                        r = part_make_space(m, part, sz, &p);
+                        r = part_make_space(m, part, sz, large, &p);
                         if (r < 0)
                                 return NULL;
+
+                        if (large)
+                                part->sealed = true;
                 } else {
                         struct bus_container *c;
                         void *op;
@@ -1383,7 +1401,7 @@ static void *message_extend_body(
                         start_part = ALIGN_TO(part->size, align);
                         end_part = start_part + sz;
 
-                        r = part_make_space(m, part, end_part, &p);
+                        r = part_make_space(m, part, end_part, false, &p);
                         if (r < 0)
                                 return NULL;
 
@@ -1416,6 +1434,72 @@ static void *message_extend_body(
         return p;
 }
 
+int bus_message_append_raw(sd_bus_message *m, size_t align, const void *p, size_t sz) {
+        void *a;
+
+        assert(m);
+        assert(p || sz == 0);
+
+        /* Appends data previously taken from another body with bus_message_get_body_range(). The caller
+         * has to make sure that the data fits into the container currently open, and that the alignment
+         * of the place it was taken from is not smaller than 'align'. dbus1 marshalling keeps no offsets
+         * outside of the data itself, hence this works, but GVariant marshalling does. */
+
+        if (BUS_MESSAGE_IS_GVARIANT(m))
+                return -EOPNOTSUPP;
+        if (m->poisoned)
+                return -ESTALE;
+
+        a = message_extend_body(m, align, sz, false, false);
+        if (!a)
+                return -ENOMEM;
+
+        memcpy_safe(a, p, sz);
+        return 0;
+}
+
+int bus_message_get_body_range(sd_bus_message *m, size_t begin, size_t end, void **ret) {
+        _cleanup_free_ uint8_t *buf = NULL;
+        struct bus_body_part *part;
+        size_t offset = 0, i;
+        int r;
+
+        assert(m);
+        assert(begin <= end);
+        assert(end <= m->body_size);
+        assert(ret);
+
+        /* Copies the body bytes between the two offsets into a buffer of their own */
+
+        buf = malloc(MAX(end - begin, (size_t) 1));
+        if (!buf)
+                return -ENOMEM;
+
+        MESSAGE_FOREACH_PART(part, i, m) {
+                size_t a, b;
+
+                a = MAX(begin, offset);
+                b = MIN(end, offset + part->size);
+
+                if (a < b) {
+                        if (part->is_zero)
+                                memzero(buf + a - begin, b - a);
+                        else {
+                                r = bus_body_part_map(part);
+                                if (r < 0)
+                                        return r;
+
+                                memcpy(buf + a - begin, (uint8_t*) part->data + a - offset, b - a);
+                        }
+                }
+
+                offset += part->size;
+        }
+
+        *ret = TAKE_PTR(buf);
+        return 0;
+}
+
 static int message_push_fd(sd_bus_message *m, int fd) {
         int *f, copy;
 
@@ -3333,6 +3417,10 @@ static bool validate_signature(const char *s, size_t l) {
         if (!validate_nul(s, l))
                 return false;
 
+        /* Shortcut for the single type signatures of all header fields and of many variants */
+        if (l == 1)
+                return bus_type_is_basic(s[0]) || s[0] == SD_BUS_TYPE_VARIANT;
+
         /* Check if valid signature */
         if (!signature_is_valid(s, true))
                 return false;
@@ -5376,7 +5464,6 @@ int bus_message_parse_fields(sd_bus_message *m) {
 
                 case BUS_MESSAGE_HEADER_SIGNATURE: {
                         const char *s;
-                        char *c;
 
                         if (BUS_MESSAGE_IS_GVARIANT(m)) /* only applies to dbus1 */
                                 return -EBADMSG;
@@ -5391,11 +5478,10 @@ int bus_message_parse_fields(sd_bus_message *m) {
                         if (r < 0)
                                 return r;
 
-                        c = strdup(s);
-                        if (!c)
-                                return -ENOMEM;
-
-                        free_and_replace(m->root_container.signature, c);
+                        /* Like the other header fields, the signature is not copied, the header stays
+                         * around as long as the message does */
+                        m->root_container.signature = (char*) s;
+                        m->borrowed_signature = true;
                         break;
                 }
 
@@ -5457,9 +5543,12 @@ int bus_message_parse_fields(sd_bus_message *m) {
                 i++;
         }
 
-        if (m->n_fds != unix_fds)
+        /* The caller may pass more fds than the message declares, see bus_message_from_malloc() */
+        if (m->n_fds < unix_fds)
                 return -EBADMSG;
 
+        m->n_fds = unix_fds;
+
         switch (m->header->type) {
 
         case SD_BUS_MESSAGE_SIGNAL:
@@ -5562,8 +5651,18 @@ int bus_message_get_blob(sd_bus_message *m, void **buffer, size_t *sz) {
                 return -ENOMEM;
 
         e = mempcpy(p, m->header, BUS_MESSAGE_BODY_BEGIN(m));
-        MESSAGE_FOREACH_PART(part, i, m)
+        MESSAGE_FOREACH_PART(part, i, m) {
+                int r;
+
+                /* Padding parts might not have been mapped yet */
+                r = bus_body_part_map(part);
+                if (r < 0) {
+                        free(p);
+                        return r;
+                }
+
                 e = mempcpy(e, part->data, part->size);
+        }
 
         assert(total == (size_t) ((uint8_t*) e - (uint8_t*) p));
 
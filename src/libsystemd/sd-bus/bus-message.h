@@ -83,6 +83,7 @@ struct sd_bus_message {
         bool dont_send:1;
         bool allow_fds:1;
         bool free_header:1;
+        bool borrowed_signature:1; /* root_container.signature points into the header */
         bool free_fds:1;
         bool poisoned:1;
         bool sensitive:1;
@@ -209,6 +210,9 @@ int bus_message_parse_fields(sd_bus_message *m);
 
 struct bus_body_part *message_append_part(sd_bus_message *m);
 
+int bus_message_append_raw(sd_bus_message *m, size_t align, const void *p, size_t sz);
+int bus_message_get_body_range(sd_bus_message *m, size_t begin, size_t end, void **ret);
+
 #define MESSAGE_FOREACH_PART(part, i, m) \
         for ((i) = 0, (part) = &(m)->body; (i) < (m)->n_body_parts; (i)++, (part) = (part)->next)
 
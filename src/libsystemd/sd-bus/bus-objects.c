@@ -11,6 +11,7 @@
 #include "bus-util.h"
 #include "missing_capability.h"
 #include "set.h"
+#include "sort-util.h"
 #include "string-util.h"
 #include "strv.h"
 
@@ -437,7 +438,6 @@ static int invoke_property_get(
         int r;
 
         assert(bus);
-        assert(slot);
         assert(v);
         assert(path);
         assert(interface);
@@ -487,6 +487,25 @@ static int invoke_property_get(
         return sd_bus_message_append_basic(reply, v->x.property.signature[0], p);
 }
 
+int bus_vtable_property_get(
+                sd_bus *bus,
+                const sd_bus_vtable *v,
+                const char *path,
+                const char *interface,
+                sd_bus_message *reply,
+                void *userdata,
+                sd_bus_error *error) {
+
+        assert(v);
+        assert(IN_SET(v->type, _SD_BUS_VTABLE_PROPERTY, _SD_BUS_VTABLE_WRITABLE_PROPERTY));
+
+        /* For callers that located the vtable entry on their own, without going through a registered
+         * slot. The property offset is applied to userdata here, like the object dispatcher does. */
+
+        return invoke_property_get(bus, NULL, v, path, interface, v->x.property.member, reply,
+                                   vtable_property_convert_userdata(v, userdata), error);
+}
+
 static int invoke_property_set(
                 sd_bus *bus,
                 sd_bus_slot *slot,
@@ -680,6 +699,8 @@ static int property_get_set_callbacks_run(
                 if (bus->nodes_modified)
                         return 0;
 
+                bus_properties_cache_invalidate(bus, m->path, c->interface);
+
                 r = sd_bus_message_exit_container(m);
                 if (r < 0)
                         return r;
@@ -747,43 +768,298 @@ static int vtable_append_one_property(
         return 0;
 }
 
-static int vtable_append_all_properties(
+/* Serialized properties of vtables marked with SD_BUS_VTABLE_CACHE_PROPERTIES, indexed by object path. Only
+ * properties that never change or for which a PropertiesChanged signal is promised are cached, since only
+ * for those we learn when the cached data goes stale. */
+struct properties_cache_entry {
+        struct node_vtable *vtable;
+        void *userdata;
+
+        void *data;
+        size_t size;
+
+        LIST_FIELDS(struct properties_cache_entry, entries);
+};
+
+struct properties_cache_object {
+        char *path;
+        LIST_HEAD(struct properties_cache_entry, entries);
+};
+
+/* Let's not grow without bounds if objects come and go without anybody telling us */
+#define PROPERTIES_CACHE_OBJECTS_MAX 16384U
+
+static struct properties_cache_entry* properties_cache_entry_free(struct properties_cache_entry *e) {
+        if (!e)
+                return NULL;
+
+        free(e->data);
+        return mfree(e);
+}
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(struct properties_cache_entry*, properties_cache_entry_free);
+
+static struct properties_cache_object* properties_cache_object_free(struct properties_cache_object *o) {
+        struct properties_cache_entry *e;
+
+        if (!o)
+                return NULL;
+
+        while ((e = o->entries)) {
+                LIST_REMOVE(entries, o->entries, e);
+                properties_cache_entry_free(e);
+        }
+
+        free(o->path);
+        return mfree(o);
+}
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(struct properties_cache_object*, properties_cache_object_free);
+
+DEFINE_PRIVATE_HASH_OPS_WITH_VALUE_DESTRUCTOR(properties_cache_hash_ops, char, string_hash_func, string_compare_func,
+                                              struct properties_cache_object, properties_cache_object_free);
+
+void bus_properties_cache_invalidate(sd_bus *bus, const char *path, const char *interface) {
+        struct properties_cache_object *o;
+
+        assert(bus);
+
+        if (!path) {
+                bus->properties_cache = hashmap_free(bus->properties_cache);
+                return;
+        }
+
+        o = hashmap_get(bus->properties_cache, path);
+        if (!o)
+                return;
+
+        if (interface) {
+                struct properties_cache_entry *e, *n;
+
+                LIST_FOREACH_SAFE(entries, e, n, o->entries)
+                        if (streq(e->vtable->interface, interface)) {
+                                LIST_REMOVE(entries, o->entries, e);
+                                properties_cache_entry_free(e);
+                        }
+
+                if (o->entries)
+                        return;
+        }
+
+        hashmap_remove(bus->properties_cache, path);
+        properties_cache_object_free(o);
+}
+
+static bool vtable_property_include_in_dump(sd_bus_message *reply, const sd_bus_vtable *v) {
+        assert(reply);
+        assert(v);
+
+        if (!IN_SET(v->type, _SD_BUS_VTABLE_PROPERTY, _SD_BUS_VTABLE_WRITABLE_PROPERTY))
+                return false;
+
+        if (v->flags & SD_BUS_VTABLE_HIDDEN)
+                return false;
+
+        /* Let's not include properties marked as "explicit" in any message that contians a generic
+         * dump of properties, but only in those generated as a response to an explicit request. */
+        if (v->flags & SD_BUS_VTABLE_PROPERTY_EXPLICIT)
+                return false;
+
+        /* Let's not include properties marked only for invalidation on change (i.e. in contrast to
+         * those whose new values are included in PropertiesChanges message) in any signals. This is
+         * useful to ensure they aren't included in InterfacesAdded messages. */
+        if (reply->header->type != SD_BUS_MESSAGE_METHOD_RETURN &&
+            FLAGS_SET(v->flags, SD_BUS_VTABLE_PROPERTY_EMITS_INVALIDATION))
+                return false;
+
+        return true;
+}
+
+static bool vtable_property_is_cacheable(const sd_bus_vtable *v) {
+        assert(v);
+
+        return v->flags & (SD_BUS_VTABLE_PROPERTY_CONST|
+                           SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE|
+                           SD_BUS_VTABLE_PROPERTY_EMITS_INVALIDATION);
+}
+
+static bool vtable_properties_use_cache(sd_bus_message *reply, struct node_vtable *c) {
+        assert(reply);
+        assert(c);
+
+        /* Signals are built rarely, and usually right after something changed, hence we only bother for
+         * replies. The cached data is spliced into the reply as is, which only works for the dbus1
+         * marshalling in native endianness. Sensitive data is never kept around longer than necessary. */
+
+        return FLAGS_SET(c->vtable[0].flags, SD_BUS_VTABLE_CACHE_PROPERTIES) &&
+                !FLAGS_SET(c->vtable[0].flags, SD_BUS_VTABLE_SENSITIVE) &&
+                reply->header->type == SD_BUS_MESSAGE_METHOD_RETURN &&
+                reply->header->endian == BUS_NATIVE_ENDIAN &&
+                !BUS_MESSAGE_IS_GVARIANT(reply);
+}
+
+static int properties_cache_get(
                 sd_bus *bus,
                 sd_bus_message *reply,
                 const char *path,
                 struct node_vtable *c,
                 void *userdata,
-                sd_bus_error *error) {
+                sd_bus_error *error,
+                struct properties_cache_entry **ret) {
 
+        _cleanup_(properties_cache_entry_freep) struct properties_cache_entry *e = NULL;
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL;
+        struct properties_cache_object *o;
+        struct properties_cache_entry *i;
         const sd_bus_vtable *v;
+        size_t begin;
         int r;
 
         assert(bus);
         assert(reply);
         assert(path);
         assert(c);
+        assert(ret);
+
+        o = hashmap_get(bus->properties_cache, path);
+        if (o)
+                LIST_FOREACH(entries, i, o->entries)
+                        if (i->vtable == c) {
+                                if (i->userdata == userdata) {
+                                        *ret = i;
+                                        return 1;
+                                }
 
-        if (c->vtable[0].flags & SD_BUS_VTABLE_HIDDEN)
-                return 1;
+                                /* The object behind the path changed, let's serialize it again */
+                                LIST_REMOVE(entries, o->entries, i);
+                                properties_cache_entry_free(i);
+                                break;
+                        }
+
+        /* Serialize the cacheable properties into a message of their own, so that we can take the bytes
+         * out of it. Array elements are always 8 byte aligned, hence the data can be appended at any
+         * 8 byte boundary of another array of the same type later on. */
+        r = sd_bus_message_new(bus, &m, SD_BUS_MESSAGE_METHOD_RETURN);
+        if (r < 0)
+                return r;
+        if (BUS_MESSAGE_IS_GVARIANT(m) || m->header->endian != reply->header->endian)
+                return 0;
+
+        r = sd_bus_message_open_container(m, 'a', "{sv}");
+        if (r < 0)
+                return r;
+
+        begin = ALIGN8(m->body_size);
 
         v = c->vtable;
         for (v = bus_vtable_next(c->vtable, v); v->type != _SD_BUS_VTABLE_END; v = bus_vtable_next(c->vtable, v)) {
-                if (!IN_SET(v->type, _SD_BUS_VTABLE_PROPERTY, _SD_BUS_VTABLE_WRITABLE_PROPERTY))
+                if (!vtable_property_include_in_dump(reply, v))
                         continue;
 
-                if (v->flags & SD_BUS_VTABLE_HIDDEN)
+                if (!vtable_property_is_cacheable(v))
                         continue;
 
-                /* Let's not include properties marked as "explicit" in any message that contians a generic
-                 * dump of properties, but only in those generated as a response to an explicit request. */
-                if (v->flags & SD_BUS_VTABLE_PROPERTY_EXPLICIT)
+                r = vtable_append_one_property(bus, m, path, c, v, userdata, error);
+                if (r < 0)
+                        return r;
+                if (bus->nodes_modified)
+                        return 0;
+        }
+
+        /* File descriptors are per message, they cannot be copied around as bytes */
+        if (m->n_fds > 0)
+                return 0;
+
+        e = new0(struct properties_cache_entry, 1);
+        if (!e)
+                return -ENOMEM;
+
+        e->vtable = c;
+        e->userdata = userdata;
+
+        if (m->body_size > begin) {
+                e->size = m->body_size - begin;
+
+                r = bus_message_get_body_range(m, begin, m->body_size, &e->data);
+                if (r < 0)
+                        return r;
+        }
+
+        if (!o) {
+                _cleanup_(properties_cache_object_freep) struct properties_cache_object *no = NULL;
+
+                if (hashmap_size(bus->properties_cache) >= PROPERTIES_CACHE_OBJECTS_MAX)
+                        bus_properties_cache_invalidate(bus, NULL, NULL);
+
+                r = hashmap_ensure_allocated(&bus->properties_cache, &properties_cache_hash_ops);
+                if (r < 0)
+                        return r;
+
+                no = new0(struct properties_cache_object, 1);
+                if (!no)
+                        return -ENOMEM;
+
+                no->path = strdup(path);
+                if (!no->path)
+                        return -ENOMEM;
+
+                r = hashmap_put(bus->properties_cache, no->path, no);
+                if (r < 0)
+                        return r;
+
+                o = TAKE_PTR(no);
+        }
+
+        LIST_PREPEND(entries, o->entries, e);
+
+        *ret = TAKE_PTR(e);
+        return 1;
+}
+
+static int vtable_append_all_properties(
+                sd_bus *bus,
+                sd_bus_message *reply,
+                const char *path,
+                struct node_vtable *c,
+                void *userdata,
+                sd_bus_error *error) {
+
+        const sd_bus_vtable *v;
+        bool use_cache;
+        int r;
+
+        assert(bus);
+        assert(reply);
+        assert(path);
+        assert(c);
+
+        if (c->vtable[0].flags & SD_BUS_VTABLE_HIDDEN)
+                return 1;
+
+        use_cache = vtable_properties_use_cache(reply, c);
+        if (use_cache) {
+                struct properties_cache_entry *e;
+
+                r = properties_cache_get(bus, reply, path, c, userdata, error, &e);
+                if (r < 0)
+                        return r;
+                if (bus->nodes_modified)
+                        return 0;
+                if (r == 0)
+                        use_cache = false;
+                else if (e->size > 0) {
+                        r = bus_message_append_raw(reply, 8, e->data, e->size);
+                        if (r < 0)
+                                return r;
+                }
+        }
+
+        v = c->vtable;
+        for (v = bus_vtable_next(c->vtable, v); v->type != _SD_BUS_VTABLE_END; v = bus_vtable_next(c->vtable, v)) {
+                if (!vtable_property_include_in_dump(reply, v))
                         continue;
 
-                /* Let's not include properties marked only for invalidation on change (i.e. in contrast to
-                 * those whose new values are included in PropertiesChanges message) in any signals. This is
-                 * useful to ensure they aren't included in InterfacesAdded messages. */
-                if (reply->header->type != SD_BUS_MESSAGE_METHOD_RETURN &&
-                    FLAGS_SET(v->flags, SD_BUS_VTABLE_PROPERTY_EMITS_INVALIDATION))
+                if (use_cache && vtable_property_is_cacheable(v))
                         continue;
 
                 r = vtable_append_one_property(bus, reply, path, c, v, userdata, error);
@@ -1292,6 +1568,52 @@ static int process_get_managed_objects(
         return 1;
 }
 
+static int vtable_member_compare_func(const struct vtable_member *x, const struct vtable_member *y) {
+        assert(x);
+        assert(y);
+
+        return strcmp(x->member, y->member);
+}
+
+static struct vtable_member* node_vtable_find_member(struct node_vtable *c, bool property, const char *member) {
+        struct vtable_member key = {
+                .member = member,
+        };
+
+        assert(c);
+        assert(member);
+
+        if (property)
+                return typesafe_bsearch(&key, c->properties, c->n_properties, vtable_member_compare_func);
+
+        return typesafe_bsearch(&key, c->methods, c->n_methods, vtable_member_compare_func);
+}
+
+static struct vtable_member* node_find_member(struct node *n, bool property, const char *interface, const char *member) {
+        struct node_vtable *c;
+
+        assert(n);
+        assert(interface);
+        assert(member);
+
+        /* There are only a few vtables registered for each node, hence let's just walk them and look up the
+         * member in the table of each one implementing the interface. This way neither the path nor the
+         * interface need to be hashed for each incoming method call. */
+
+        LIST_FOREACH(vtables, c, n->vtables) {
+                struct vtable_member *v;
+
+                if (!streq(c->interface, interface))
+                        continue;
+
+                v = node_vtable_find_member(c, property, member);
+                if (v)
+                        return v;
+        }
+
+        return NULL;
+}
+
 static int object_find_and_run(
                 sd_bus *bus,
                 sd_bus_message *m,
@@ -1299,8 +1621,8 @@ static int object_find_and_run(
                 bool require_fallback,
                 bool *found_object) {
 
+        struct vtable_member *v;
         struct node *n;
-        struct vtable_member vtable_key, *v;
         int r;
 
         assert(bus);
@@ -1323,11 +1645,7 @@ static int object_find_and_run(
                 return 0;
 
         /* Then, look for a known method */
-        vtable_key.path = (char*) p;
-        vtable_key.interface = m->interface;
-        vtable_key.member = m->member;
-
-        v = hashmap_get(bus->vtable_methods, &vtable_key);
+        v = node_find_member(n, false, m->interface, m->member);
         if (v) {
                 r = method_callbacks_run(bus, m, v, require_fallback, found_object);
                 if (r != 0)
@@ -1343,18 +1661,17 @@ static int object_find_and_run(
                 get = streq(m->member, "Get");
 
                 if (get || streq(m->member, "Set")) {
+                        const char *iface, *member;
 
                         r = sd_bus_message_rewind(m, true);
                         if (r < 0)
                                 return r;
 
-                        vtable_key.path = (char*) p;
-
-                        r = sd_bus_message_read(m, "ss", &vtable_key.interface, &vtable_key.member);
+                        r = sd_bus_message_read(m, "ss", &iface, &member);
                         if (r < 0)
                                 return sd_bus_reply_method_errorf(m, SD_BUS_ERROR_INVALID_ARGS, "Expected interface and member parameters");
 
-                        v = hashmap_get(bus->vtable_properties, &vtable_key);
+                        v = node_find_member(n, true, iface, member);
                         if (v) {
                                 r = property_get_set_callbacks_run(bus, m, v, require_fallback, get, found_object);
                                 if (r != 0)
@@ -1670,32 +1987,6 @@ _public_ int sd_bus_add_fallback(
         return bus_add_object(bus, slot, true, prefix, callback, userdata);
 }
 
-static void vtable_member_hash_func(const struct vtable_member *m, struct siphash *state) {
-        assert(m);
-
-        string_hash_func(m->path, state);
-        string_hash_func(m->interface, state);
-        string_hash_func(m->member, state);
-}
-
-static int vtable_member_compare_func(const struct vtable_member *x, const struct vtable_member *y) {
-        int r;
-
-        assert(x);
-        assert(y);
-
-        r = strcmp(x->path, y->path);
-        if (r != 0)
-                return r;
-
-        r = strcmp(x->interface, y->interface);
-        if (r != 0)
-                return r;
-
-        return strcmp(x->member, y->member);
-}
-
-DEFINE_PRIVATE_HASH_OPS(vtable_member_hash_ops, struct vtable_member, vtable_member_hash_func, vtable_member_compare_func);
 
 typedef enum {
         NAMES_FIRST_PART        = 1 << 0, /* first part of argument name list (input names). It is reset by names_are_valid() */
@@ -1800,6 +2091,7 @@ static int add_object_vtable_internal(
 
         sd_bus_slot *s = NULL;
         struct node_vtable *i, *existing = NULL;
+        size_t n_methods_allocated = 0, n_properties_allocated = 0, k;
         const sd_bus_vtable *v;
         struct node *n;
         int r;
@@ -1821,14 +2113,6 @@ static int add_object_vtable_internal(
                       !streq(interface, "org.freedesktop.DBus.Peer") &&
                       !streq(interface, "org.freedesktop.DBus.ObjectManager"), -EINVAL);
 
-        r = hashmap_ensure_allocated(&bus->vtable_methods, &vtable_member_hash_ops);
-        if (r < 0)
-                return r;
-
-        r = hashmap_ensure_allocated(&bus->vtable_properties, &vtable_member_hash_ops);
-        if (r < 0)
-                return r;
-
         n = bus_node_allocate(bus, path);
         if (!n)
                 return -ENOMEM;
@@ -1889,23 +2173,19 @@ static int add_object_vtable_internal(
                                 goto fail;
                         }
 
-                        m = new0(struct vtable_member, 1);
-                        if (!m) {
+                        if (!GREEDY_REALLOC(s->node_vtable.methods, n_methods_allocated, s->node_vtable.n_methods + 1)) {
                                 r = -ENOMEM;
                                 goto fail;
                         }
 
-                        m->parent = &s->node_vtable;
-                        m->path = n->path;
-                        m->interface = s->node_vtable.interface;
-                        m->member = v->x.method.member;
-                        m->vtable = v;
-
-                        r = hashmap_put(bus->vtable_methods, m, m);
-                        if (r < 0) {
-                                free(m);
-                                goto fail;
-                        }
+                        m = s->node_vtable.methods + s->node_vtable.n_methods++;
+                        *m = (struct vtable_member) {
+                                .parent = &s->node_vtable,
+                                .path = n->path,
+                                .interface = s->node_vtable.interface,
+                                .member = v->x.method.member,
+                                .vtable = v,
+                        };
 
                         break;
                 }
@@ -1937,23 +2217,19 @@ static int add_object_vtable_internal(
                                 goto fail;
                         }
 
-                        m = new0(struct vtable_member, 1);
-                        if (!m) {
+                        if (!GREEDY_REALLOC(s->node_vtable.properties, n_properties_allocated, s->node_vtable.n_properties + 1)) {
                                 r = -ENOMEM;
                                 goto fail;
                         }
 
-                        m->parent = &s->node_vtable;
-                        m->path = n->path;
-                        m->interface = s->node_vtable.interface;
-                        m->member = v->x.property.member;
-                        m->vtable = v;
-
-                        r = hashmap_put(bus->vtable_properties, m, m);
-                        if (r < 0) {
-                                free(m);
-                                goto fail;
-                        }
+                        m = s->node_vtable.properties + s->node_vtable.n_properties++;
+                        *m = (struct vtable_member) {
+                                .parent = &s->node_vtable,
+                                .path = n->path,
+                                .interface = s->node_vtable.interface,
+                                .member = v->x.property.member,
+                                .vtable = v,
+                        };
 
                         break;
                 }
@@ -1980,6 +2256,25 @@ static int add_object_vtable_internal(
                 }
         }
 
+        /* Sort the members for lookups by name, and refuse any name that is registered twice for the same
+         * interface on this node, whether in this vtable or in another one. */
+        typesafe_qsort(s->node_vtable.methods, s->node_vtable.n_methods, vtable_member_compare_func);
+        typesafe_qsort(s->node_vtable.properties, s->node_vtable.n_properties, vtable_member_compare_func);
+
+        for (k = 0; k < s->node_vtable.n_methods; k++)
+                if ((k > 0 && streq(s->node_vtable.methods[k-1].member, s->node_vtable.methods[k].member)) ||
+                    node_find_member(n, false, interface, s->node_vtable.methods[k].member)) {
+                        r = -EEXIST;
+                        goto fail;
+                }
+
+        for (k = 0; k < s->node_vtable.n_properties; k++)
+                if ((k > 0 && streq(s->node_vtable.properties[k-1].member, s->node_vtable.properties[k].member)) ||
+                    node_find_member(n, true, interface, s->node_vtable.properties[k].member)) {
+                        r = -EEXIST;
+                        goto fail;
+                }
+
         s->node_vtable.node = n;
         LIST_INSERT_AFTER(vtables, n->vtables, existing, &s->node_vtable);
         bus->nodes_modified = true;
@@ -2079,7 +2374,6 @@ static int emit_properties_changed_on_interface(
         _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
         _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL;
         bool has_invalidating = false, has_changing = false;
-        struct vtable_member key = {};
         struct node_vtable *c;
         struct node *n;
         char **property;
@@ -2108,9 +2402,6 @@ static int emit_properties_changed_on_interface(
         if (r < 0)
                 return r;
 
-        key.path = prefix;
-        key.interface = interface;
-
         LIST_FOREACH(vtables, c, n->vtables) {
                 if (require_fallback && !c->is_fallback)
                         continue;
@@ -2138,8 +2429,7 @@ static int emit_properties_changed_on_interface(
 
                                 assert_return(member_name_is_valid(*property), -EINVAL);
 
-                                key.member = *property;
-                                v = hashmap_get(bus->vtable_properties, &key);
+                                v = node_find_member(n, true, interface, *property);
                                 if (!v)
                                         return -ENOENT;
 
@@ -2232,8 +2522,7 @@ static int emit_properties_changed_on_interface(
                                 STRV_FOREACH(property, names) {
                                         struct vtable_member *v;
 
-                                        key.member = *property;
-                                        assert_se(v = hashmap_get(bus->vtable_properties, &key));
+                                        assert_se(v = node_find_member(n, true, interface, *property));
                                         assert(c == v->parent);
 
                                         if (!(v->vtable->flags & SD_BUS_VTABLE_PROPERTY_EMITS_INVALIDATION))
@@ -2303,6 +2592,8 @@ _public_ int sd_bus_emit_properties_changed_strv(
         if (names && names[0] == NULL)
                 return 0;
 
+        bus_properties_cache_invalidate(bus, path, interface);
+
         BUS_DONT_DESTROY(bus);
 
         pl = strlen(path);
@@ -2538,6 +2829,8 @@ _public_ int sd_bus_emit_object_added(sd_bus *bus, const char *path) {
         if (!BUS_IS_OPEN(bus->state))
                 return -ENOTCONN;
 
+        bus_properties_cache_invalidate(bus, path, NULL);
+
         r = bus_find_parent_object_manager(bus, &object_manager, path);
         if (r < 0)
                 return r;
@@ -2715,6 +3008,8 @@ _public_ int sd_bus_emit_object_removed(sd_bus *bus, const char *path) {
         if (!BUS_IS_OPEN(bus->state))
                 return -ENOTCONN;
 
+        bus_properties_cache_invalidate(bus, path, NULL);
+
         r = bus_find_parent_object_manager(bus, &object_manager, path);
         if (r < 0)
                 return r;
@@ -2878,6 +3173,9 @@ _public_ int sd_bus_emit_interfaces_added_strv(sd_bus *bus, const char *path, ch
         if (strv_isempty(interfaces))
                 return 0;
 
+        STRV_FOREACH(i, interfaces)
+                bus_properties_cache_invalidate(bus, path, *i);
+
         r = bus_find_parent_object_manager(bus, &object_manager, path);
         if (r < 0)
                 return r;
@@ -2952,6 +3250,7 @@ _public_ int sd_bus_emit_interfaces_added(sd_bus *bus, const char *path, const c
 _public_ int sd_bus_emit_interfaces_removed_strv(sd_bus *bus, const char *path, char **interfaces) {
         _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL;
         struct node *object_manager;
+        char **i;
         int r;
 
         assert_return(bus, -EINVAL);
@@ -2965,6 +3264,9 @@ _public_ int sd_bus_emit_interfaces_removed_strv(sd_bus *bus, const char *path,
         if (strv_isempty(interfaces))
                 return 0;
 
+        STRV_FOREACH(i, interfaces)
+                bus_properties_cache_invalidate(bus, path, *i);
+
         r = bus_find_parent_object_manager(bus, &object_manager, path);
         if (r < 0)
                 return r;
@@ -3002,6 +3304,18 @@ _public_ int sd_bus_emit_interfaces_removed(sd_bus *bus, const char *path, const
         return sd_bus_emit_interfaces_removed_strv(bus, path, interfaces);
 }
 
+_public_ int sd_bus_object_invalidate_properties(sd_bus *bus, const char *path, const char *interface) {
+        assert_return(bus, -EINVAL);
+        assert_return(bus = bus_resolve(bus), -ENOPKG);
+        assert_return(!path || object_path_is_valid(path), -EINVAL);
+        assert_return(!interface || interface_name_is_valid(interface), -EINVAL);
+        assert_return(path || !interface, -EINVAL);
+        assert_return(!bus_pid_changed(bus), -ECHILD);
+
+        bus_properties_cache_invalidate(bus, path, interface);
+        return 0;
+}
+
 _public_ int sd_bus_add_object_manager(sd_bus *bus, sd_bus_slot **slot, const char *path) {
         sd_bus_slot *s;
         struct node *n;
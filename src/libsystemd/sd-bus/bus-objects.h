@@ -6,8 +6,10 @@
 
 const sd_bus_vtable* bus_vtable_next(const sd_bus_vtable *vtable, const sd_bus_vtable *v);
 bool bus_vtable_has_names(const sd_bus_vtable *vtable);
+int bus_vtable_property_get(sd_bus *bus, const sd_bus_vtable *v, const char *path, const char *interface, sd_bus_message *reply, void *userdata, sd_bus_error *error);
 int bus_process_object(sd_bus *bus, sd_bus_message *m);
 void bus_node_gc(sd_bus *b, struct node *n);
+void bus_properties_cache_invalidate(sd_bus *bus, const char *path, const char *interface);
 
 int introspect_path(
                 sd_bus *bus,
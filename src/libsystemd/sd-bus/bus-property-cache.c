@@ -0,0 +1,633 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include "sd-bus.h"
+
+#include "alloc-util.h"
+#include "bus-internal.h"
+#include "bus-message.h"
+#include "bus-signature.h"
+#include "bus-type.h"
+#include "hashmap.h"
+#include "string-util.h"
+#include "strv.h"
+
+struct sd_bus_property_cache {
+        unsigned n_ref;
+        sd_bus *bus;
+
+        char *destination;
+        char *path;
+        char *interface;
+
+        /* Maps property names to sealed messages that carry nothing but the value variant. A NULL value
+         * marks a property that exists, but whose value has been invalidated by the peer. */
+        Hashmap *properties;
+        bool loaded;
+
+        /* The read counter of the message we loaded the properties from. Signals read before that
+         * describe an older state than the one we have. */
+        uint64_t read_counter;
+
+        sd_bus_slot *properties_changed_slot;
+        sd_bus_slot *interfaces_added_slot;
+        sd_bus_slot *interfaces_removed_slot;
+        sd_bus_slot *name_owner_changed_slot;
+};
+
+DEFINE_PRIVATE_HASH_OPS_FULL(property_hash_ops, char, string_hash_func, string_compare_func, free,
+                             sd_bus_message, sd_bus_message_unref);
+
+static void property_cache_flush(sd_bus_property_cache *c) {
+        assert(c);
+
+        hashmap_clear(c->properties);
+        c->loaded = false;
+}
+
+static int property_cache_store(sd_bus_property_cache *c, const char *member, sd_bus_message *m) {
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *v = NULL;
+        _cleanup_free_ char *k = NULL;
+        int r;
+
+        assert(c);
+        assert(member);
+
+        /* Copies the variant at the current read position of 'm' into a message of its own, and caches it
+         * under the property name. If 'm' is NULL the property is marked as invalidated. */
+
+        if (m) {
+                r = sd_bus_message_new(c->bus, &v, SD_BUS_MESSAGE_METHOD_RETURN);
+                if (r < 0)
+                        return r;
+
+                r = sd_bus_message_copy(v, m, false);
+                if (r < 0)
+                        return r;
+                if (r == 0)
+                        return -EBADMSG;
+
+                r = sd_bus_message_seal(v, 1, 0);
+                if (r < 0)
+                        return r;
+        }
+
+        if (hashmap_contains(c->properties, member)) {
+                sd_bus_message *old;
+
+                old = hashmap_get(c->properties, member);
+                assert_se(hashmap_update(c->properties, member, v) >= 0);
+                TAKE_PTR(v);
+
+                sd_bus_message_unref(old);
+                return 0;
+        }
+
+        r = hashmap_ensure_allocated(&c->properties, &property_hash_ops);
+        if (r < 0)
+                return r;
+
+        k = strdup(member);
+        if (!k)
+                return -ENOMEM;
+
+        r = hashmap_put(c->properties, k, v);
+        if (r < 0)
+                return r;
+
+        TAKE_PTR(k);
+        TAKE_PTR(v);
+
+        return 0;
+}
+
+static int property_cache_store_dict(sd_bus_property_cache *c, sd_bus_message *m) {
+        int r;
+
+        assert(c);
+        assert(m);
+
+        r = sd_bus_message_enter_container(m, 'a', "{sv}");
+        if (r < 0)
+                return r;
+
+        while ((r = sd_bus_message_enter_container(m, 'e', "sv")) > 0) {
+                const char *member;
+
+                r = sd_bus_message_read_basic(m, 's', &member);
+                if (r < 0)
+                        return r;
+
+                r = property_cache_store(c, member, m);
+                if (r < 0)
+                        return r;
+
+                r = sd_bus_message_exit_container(m);
+                if (r < 0)
+                        return r;
+        }
+        if (r < 0)
+                return r;
+
+        return sd_bus_message_exit_container(m);
+}
+
+static int property_cache_load(sd_bus_property_cache *c, sd_bus_error *error) {
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
+        int r;
+
+        assert(c);
+
+        r = sd_bus_call_method(c->bus, c->destination, c->path, "org.freedesktop.DBus.Properties", "GetAll",
+                               error, &reply, "s", c->interface);
+        if (r < 0)
+                return r;
+
+        property_cache_flush(c);
+
+        r = property_cache_store_dict(c, reply);
+        if (r < 0) {
+                property_cache_flush(c);
+                return sd_bus_error_set_errno(error, r);
+        }
+
+        c->loaded = true;
+        c->read_counter = reply->read_counter;
+
+        return 0;
+}
+
+static int property_cache_find(sd_bus_property_cache *c, const char *member, sd_bus_error *error, sd_bus_message **ret) {
+        sd_bus_message *v;
+        int r;
+
+        assert(c);
+        assert(member);
+        assert(ret);
+
+        if (!c->loaded) {
+                r = property_cache_load(c, error);
+                if (r < 0)
+                        return r;
+        }
+
+        v = hashmap_get(c->properties, member);
+        if (!v) {
+                _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
+
+                if (!hashmap_contains(c->properties, member))
+                        return sd_bus_error_setf(error, SD_BUS_ERROR_UNKNOWN_PROPERTY, "Unknown property '%s'.", member);
+
+                /* The value was invalidated, fetch it on its own */
+                r = sd_bus_call_method(c->bus, c->destination, c->path, "org.freedesktop.DBus.Properties", "Get",
+                                       error, &reply, "ss", c->interface, member);
+                if (r < 0)
+                        return r;
+
+                r = property_cache_store(c, member, reply);
+                if (r < 0)
+                        return sd_bus_error_set_errno(error, r);
+
+                v = hashmap_get(c->properties, member);
+                assert(v);
+        }
+
+        r = sd_bus_message_rewind(v, true);
+        if (r < 0)
+                return sd_bus_error_set_errno(error, r);
+
+        *ret = v;
+        return 0;
+}
+
+static int on_properties_changed(sd_bus_message *m, void *userdata, sd_bus_error *error) {
+        sd_bus_property_cache *c = userdata;
+        const char *interface, *member;
+        int r;
+
+        assert(m);
+        assert(c);
+
+        /* Nothing cached yet, or the signal is older than what we have */
+        if (!c->loaded || m->read_counter < c->read_counter)
+                return 0;
+
+        r = sd_bus_message_read_basic(m, 's', &interface);
+        if (r < 0)
+                goto fail;
+
+        if (!streq(interface, c->interface))
+                return 0;
+
+        r = property_cache_store_dict(c, m);
+        if (r < 0)
+                goto fail;
+
+        r = sd_bus_message_enter_container(m, 'a', "s");
+        if (r < 0)
+                goto fail;
+
+        while ((r = sd_bus_message_read_basic(m, 's', &member)) > 0) {
+                r = property_cache_store(c, member, NULL);
+                if (r < 0)
+                        goto fail;
+        }
+        if (r < 0)
+                goto fail;
+
+        return 0;
+
+fail:
+        /* If we can't follow the changes, we can't trust anything we have anymore */
+        log_debug_errno(r, "Failed to process PropertiesChanged signal, flushing property cache: %m");
+        property_cache_flush(c);
+        return 0;
+}
+
+static int on_interfaces_added(sd_bus_message *m, void *userdata, sd_bus_error *error) {
+        sd_bus_property_cache *c = userdata;
+        const char *path, *interface;
+        int r;
+
+        assert(m);
+        assert(c);
+
+        if (m->read_counter < c->read_counter)
+                return 0;
+
+        r = sd_bus_message_read_basic(m, 'o', &path);
+        if (r < 0)
+                goto fail;
+
+        if (!streq(path, c->path))
+                return 0;
+
+        r = sd_bus_message_enter_container(m, 'a', "{sa{sv}}");
+        if (r < 0)
+                goto fail;
+
+        while ((r = sd_bus_message_enter_container(m, 'e', "sa{sv}")) > 0) {
+                r = sd_bus_message_read_basic(m, 's', &interface);
+                if (r < 0)
+                        goto fail;
+
+                if (streq(interface, c->interface)) {
+                        /* The signal carries all properties, hence take it as if we loaded them */
+                        property_cache_flush(c);
+
+                        r = property_cache_store_dict(c, m);
+                        if (r < 0)
+                                goto fail;
+
+                        c->loaded = true;
+                        c->read_counter = m->read_counter;
+                        return 0;
+                }
+
+                r = sd_bus_message_skip(m, "a{sv}");
+                if (r < 0)
+                        goto fail;
+
+                r = sd_bus_message_exit_container(m);
+                if (r < 0)
+                        goto fail;
+        }
+        if (r < 0)
+                goto fail;
+
+        return 0;
+
+fail:
+        log_debug_errno(r, "Failed to process InterfacesAdded signal, flushing property cache: %m");
+        property_cache_flush(c);
+        return 0;
+}
+
+static int on_interfaces_removed(sd_bus_message *m, void *userdata, sd_bus_error *error) {
+        sd_bus_property_cache *c = userdata;
+        _cleanup_strv_free_ char **interfaces = NULL;
+        const char *path;
+        int r;
+
+        assert(m);
+        assert(c);
+
+        if (m->read_counter < c->read_counter)
+                return 0;
+
+        r = sd_bus_message_read(m, "o", &path);
+        if (r >= 0 && !streq(path, c->path))
+                return 0;
+        if (r >= 0)
+                r = sd_bus_message_read_strv(m, &interfaces);
+        if (r < 0 || strv_contains(interfaces, c->interface))
+                property_cache_flush(c);
+
+        return 0;
+}
+
+static int on_name_owner_changed(sd_bus_message *m, void *userdata, sd_bus_error *error) {
+        sd_bus_property_cache *c = userdata;
+
+        assert(m);
+        assert(c);
+
+        /* Whoever owns the name now knows nothing of what we cached */
+        property_cache_flush(c);
+        return 0;
+}
+
+static sd_bus_property_cache *property_cache_free(sd_bus_property_cache *c) {
+        assert(c);
+
+        sd_bus_slot_unref(c->properties_changed_slot);
+        sd_bus_slot_unref(c->interfaces_added_slot);
+        sd_bus_slot_unref(c->interfaces_removed_slot);
+        sd_bus_slot_unref(c->name_owner_changed_slot);
+
+        hashmap_free(c->properties);
+
+        free(c->destination);
+        free(c->path);
+        free(c->interface);
+
+        sd_bus_unref(c->bus);
+
+        return mfree(c);
+}
+
+DEFINE_PUBLIC_TRIVIAL_REF_UNREF_FUNC(sd_bus_property_cache, sd_bus_property_cache, property_cache_free);
+
+_public_ int sd_bus_property_cache_new(
+                sd_bus *bus,
+                sd_bus_property_cache **ret,
+                const char *destination,
+                const char *path,
+                const char *interface) {
+
+        _cleanup_(sd_bus_property_cache_unrefp) sd_bus_property_cache *c = NULL;
+        const char *sender, *match;
+        int r;
+
+        assert_return(bus, -EINVAL);
+        assert_return(bus = bus_resolve(bus), -ENOPKG);
+        assert_return(ret, -EINVAL);
+        assert_return(!destination || service_name_is_valid(destination), -EINVAL);
+        assert_return(object_path_is_valid(path), -EINVAL);
+        assert_return(interface_name_is_valid(interface), -EINVAL);
+        assert_return(!bus_pid_changed(bus), -ECHILD);
+
+        c = new(sd_bus_property_cache, 1);
+        if (!c)
+                return -ENOMEM;
+
+        *c = (sd_bus_property_cache) {
+                .n_ref = 1,
+                .bus = sd_bus_ref(bus),
+        };
+
+        if (destination) {
+                c->destination = strdup(destination);
+                if (!c->destination)
+                        return -ENOMEM;
+        }
+
+        c->path = strdup(path);
+        if (!c->path)
+                return -ENOMEM;
+
+        c->interface = strdup(interface);
+        if (!c->interface)
+                return -ENOMEM;
+
+        /* Subscribe to changes right away, so that the subscription is in place before we load the
+         * properties, and nothing gets lost in between. */
+
+        sender = destination ? strjoina("sender='", destination, "',") : "";
+
+        match = strjoina("type='signal',",
+                         sender,
+                         "path='", path, "',"
+                         "interface='org.freedesktop.DBus.Properties',"
+                         "member='PropertiesChanged',"
+                         "arg0='", interface, "'");
+        r = sd_bus_add_match_async(bus, &c->properties_changed_slot, match, on_properties_changed, NULL, c);
+        if (r < 0)
+                return r;
+
+        match = strjoina("type='signal',",
+                         sender,
+                         "interface='org.freedesktop.DBus.ObjectManager',"
+                         "member='InterfacesAdded',"
+                         "arg0path='", path, "'");
+        r = sd_bus_add_match_async(bus, &c->interfaces_added_slot, match, on_interfaces_added, NULL, c);
+        if (r < 0)
+                return r;
+
+        match = strjoina("type='signal',",
+                         sender,
+                         "interface='org.freedesktop.DBus.ObjectManager',"
+                         "member='InterfacesRemoved',"
+                         "arg0path='", path, "'");
+        r = sd_bus_add_match_async(bus, &c->interfaces_removed_slot, match, on_interfaces_removed, NULL, c);
+        if (r < 0)
+                return r;
+
+        if (destination && bus->bus_client) {
+                match = strjoina("type='signal',"
+                                 "sender='org.freedesktop.DBus',"
+                                 "path='/org/freedesktop/DBus',"
+                                 "interface='org.freedesktop.DBus',"
+                                 "member='NameOwnerChanged',"
+                                 "arg0='", destination, "'");
+                r = sd_bus_add_match_async(bus, &c->name_owner_changed_slot, match, on_name_owner_changed, NULL, c);
+                if (r < 0)
+                        return r;
+        }
+
+        *ret = TAKE_PTR(c);
+        return 0;
+}
+
+_public_ sd_bus *sd_bus_property_cache_get_bus(sd_bus_property_cache *c) {
+        assert_return(c, NULL);
+
+        return c->bus;
+}
+
+_public_ int sd_bus_property_cache_invalidate(sd_bus_property_cache *c) {
+        assert_return(c, -EINVAL);
+
+        property_cache_flush(c);
+        return 0;
+}
+
+_public_ int sd_bus_property_cache_get(
+                sd_bus_property_cache *c,
+                const char *member,
+                sd_bus_error *error,
+                sd_bus_message **reply,
+                const char *type) {
+
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL;
+        sd_bus_message *v;
+        int r;
+
+        bus_assert_return(c, -EINVAL, error);
+        bus_assert_return(member_name_is_valid(member), -EINVAL, error);
+        bus_assert_return(reply, -EINVAL, error);
+        bus_assert_return(signature_is_single(type, false), -EINVAL, error);
+        bus_assert_return(!bus_pid_changed(c->bus), -ECHILD, error);
+
+        if (!BUS_IS_OPEN(c->bus->state)) {
+                r = -ENOTCONN;
+                goto fail;
+        }
+
+        r = property_cache_find(c, member, error, &v);
+        if (r < 0)
+                return r;
+
+        /* Hand out a copy, so that the caller may read it at their own pace */
+        r = sd_bus_message_new(c->bus, &m, SD_BUS_MESSAGE_METHOD_RETURN);
+        if (r < 0)
+                goto fail;
+
+        r = sd_bus_message_copy(m, v, true);
+        if (r < 0)
+                goto fail;
+
+        r = sd_bus_message_seal(m, 1, 0);
+        if (r < 0)
+                goto fail;
+
+        r = sd_bus_message_enter_container(m, 'v', type);
+        if (r < 0)
+                goto fail;
+
+        *reply = TAKE_PTR(m);
+        return 0;
+
+fail:
+        return sd_bus_error_set_errno(error, r);
+}
+
+_public_ int sd_bus_property_cache_get_trivial(
+                sd_bus_property_cache *c,
+                const char *member,
+                sd_bus_error *error,
+                char type, void *ptr) {
+
+        sd_bus_message *v;
+        int r;
+
+        bus_assert_return(c, -EINVAL, error);
+        bus_assert_return(member_name_is_valid(member), -EINVAL, error);
+        bus_assert_return(bus_type_is_trivial(type), -EINVAL, error);
+        bus_assert_return(ptr, -EINVAL, error);
+        bus_assert_return(!bus_pid_changed(c->bus), -ECHILD, error);
+
+        if (!BUS_IS_OPEN(c->bus->state)) {
+                r = -ENOTCONN;
+                goto fail;
+        }
+
+        r = property_cache_find(c, member, error, &v);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_enter_container(v, 'v', CHAR_TO_STR(type));
+        if (r < 0)
+                goto fail;
+
+        r = sd_bus_message_read_basic(v, type, ptr);
+        if (r < 0)
+                goto fail;
+
+        return 0;
+
+fail:
+        return sd_bus_error_set_errno(error, r);
+}
+
+_public_ int sd_bus_property_cache_get_string(
+                sd_bus_property_cache *c,
+                const char *member,
+                sd_bus_error *error,
+                char **ret) {
+
+        sd_bus_message *v;
+        const char *s;
+        char *n;
+        int r;
+
+        bus_assert_return(c, -EINVAL, error);
+        bus_assert_return(member_name_is_valid(member), -EINVAL, error);
+        bus_assert_return(ret, -EINVAL, error);
+        bus_assert_return(!bus_pid_changed(c->bus), -ECHILD, error);
+
+        if (!BUS_IS_OPEN(c->bus->state)) {
+                r = -ENOTCONN;
+                goto fail;
+        }
+
+        r = property_cache_find(c, member, error, &v);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_enter_container(v, 'v', "s");
+        if (r < 0)
+                goto fail;
+
+        r = sd_bus_message_read_basic(v, 's', &s);
+        if (r < 0)
+                goto fail;
+
+        n = strdup(s);
+        if (!n) {
+                r = -ENOMEM;
+                goto fail;
+        }
+
+        *ret = n;
+        return 0;
+
+fail:
+        return sd_bus_error_set_errno(error, r);
+}
+
+_public_ int sd_bus_property_cache_get_strv(
+                sd_bus_property_cache *c,
+                const char *member,
+                sd_bus_error *error,
+                char ***ret) {
+
+        sd_bus_message *v;
+        int r;
+
+        bus_assert_return(c, -EINVAL, error);
+        bus_assert_return(member_name_is_valid(member), -EINVAL, error);
+        bus_assert_return(ret, -EINVAL, error);
+        bus_assert_return(!bus_pid_changed(c->bus), -ECHILD, error);
+
+        if (!BUS_IS_OPEN(c->bus->state)) {
+                r = -ENOTCONN;
+                goto fail;
+        }
+
+        r = property_cache_find(c, member, error, &v);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_enter_container(v, 'v', NULL);
+        if (r < 0)
+                goto fail;
+
+        r = sd_bus_message_read_strv(v, ret);
+        if (r < 0)
+                goto fail;
+
+        return 0;
+
+fail:
+        return sd_bus_error_set_errno(error, r);
+}
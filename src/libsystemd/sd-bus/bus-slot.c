@@ -114,40 +114,13 @@ void bus_slot_disconnect(sd_bus_slot *slot, bool unref) {
 
         case BUS_NODE_VTABLE:
 
-                if (slot->node_vtable.node && slot->node_vtable.interface && slot->node_vtable.vtable) {
-                        const sd_bus_vtable *v;
+                /* The cached properties refer to the vtable, let's not bother finding out which ones */
+                bus_properties_cache_invalidate(slot->bus, NULL, NULL);
 
-                        for (v = slot->node_vtable.vtable; v->type != _SD_BUS_VTABLE_END; v = bus_vtable_next(slot->node_vtable.vtable, v)) {
-                                struct vtable_member *x = NULL;
-
-                                switch (v->type) {
-
-                                case _SD_BUS_VTABLE_METHOD: {
-                                        struct vtable_member key;
-
-                                        key.path = slot->node_vtable.node->path;
-                                        key.interface = slot->node_vtable.interface;
-                                        key.member = v->x.method.member;
-
-                                        x = hashmap_remove(slot->bus->vtable_methods, &key);
-                                        break;
-                                }
-
-                                case _SD_BUS_VTABLE_PROPERTY:
-                                case _SD_BUS_VTABLE_WRITABLE_PROPERTY: {
-                                        struct vtable_member key;
-
-                                        key.path = slot->node_vtable.node->path;
-                                        key.interface = slot->node_vtable.interface;
-                                        key.member = v->x.method.member;
-
-                                        x = hashmap_remove(slot->bus->vtable_properties, &key);
-                                        break;
-                                }}
-
-                                free(x);
-                        }
-                }
+                slot->node_vtable.methods = mfree(slot->node_vtable.methods);
+                slot->node_vtable.n_methods = 0;
+                slot->node_vtable.properties = mfree(slot->node_vtable.properties);
+                slot->node_vtable.n_properties = 0;
 
                 slot->node_vtable.interface = mfree(slot->node_vtable.interface);
 
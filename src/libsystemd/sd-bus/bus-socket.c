@@ -1052,6 +1052,7 @@ int bus_socket_write_message(sd_bus *bus, sd_bus_message *m, size_t *idx) {
 }
 
 static int bus_socket_read_message_need(sd_bus *bus, size_t *need) {
+        const uint8_t *p;
         uint32_t a, b;
         uint8_t e;
         uint64_t sum;
@@ -1059,8 +1060,9 @@ static int bus_socket_read_message_need(sd_bus *bus, size_t *need) {
         assert(bus);
         assert(need);
         assert(IN_SET(bus->state, BUS_RUNNING, BUS_HELLO));
+        assert(bus->rbuffer_offset <= bus->rbuffer_size);
 
-        if (bus->rbuffer_size < sizeof(struct bus_header)) {
+        if (bus->rbuffer_size - bus->rbuffer_offset < sizeof(struct bus_header)) {
                 *need = sizeof(struct bus_header) + 8;
 
                 /* Minimum message size:
@@ -1082,10 +1084,12 @@ static int bus_socket_read_message_need(sd_bus *bus, size_t *need) {
                 return 0;
         }
 
-        a = ((const uint32_t*) bus->rbuffer)[1];
-        b = ((const uint32_t*) bus->rbuffer)[3];
+        /* The offset is not necessarily aligned, hence don't access the header fields directly */
+        p = (const uint8_t*) bus->rbuffer + bus->rbuffer_offset;
+        memcpy(&a, p + 4, sizeof(a));
+        memcpy(&b, p + 12, sizeof(b));
 
-        e = ((const uint8_t*) bus->rbuffer)[0];
+        e = p[0];
         if (e == BUS_LITTLE_ENDIAN) {
                 a = le32toh(a);
                 b = le32toh(b);
@@ -1103,46 +1107,106 @@ static int bus_socket_read_message_need(sd_bus *bus, size_t *need) {
         return 0;
 }
 
+static void bus_socket_drop_fds(sd_bus *bus) {
+        assert(bus);
+
+        close_many(bus->fds, bus->n_fds);
+        bus->fds = mfree(bus->fds);
+        bus->n_fds = 0;
+}
+
 static int bus_socket_make_message(sd_bus *bus, size_t size) {
+        _cleanup_free_ int *fds = NULL;
         sd_bus_message *t = NULL;
-        void *b;
+        size_t remaining;
+        void *b, *m;
+        bool whole;
         int r;
 
         assert(bus);
-        assert(bus->rbuffer_size >= size);
+        assert(bus->rbuffer_size - bus->rbuffer_offset >= size);
         assert(IN_SET(bus->state, BUS_RUNNING, BUS_HELLO));
 
         r = bus_rqueue_make_room(bus);
         if (r < 0)
                 return r;
 
-        if (bus->rbuffer_size > size) {
-                b = memdup((const uint8_t*) bus->rbuffer + size,
-                           bus->rbuffer_size - size);
-                if (!b)
+        remaining = bus->rbuffer_size - bus->rbuffer_offset - size;
+
+        /* If a large message starts the buffer and is at least as large as what follows it, hand the
+         * buffer over to the message and keep a copy of the rest, as before. Otherwise, which is the common
+         * case for a burst of small messages read at once, copy the message out, so that it doesn't pin the
+         * whole read-ahead buffer, and keep the buffer for the next ones. */
+        whole = bus->rbuffer_offset == 0 && size >= remaining && size >= BUS_READ_AHEAD_SIZE / 2;
+        if (whole) {
+                m = bus->rbuffer;
+
+                if (remaining > 0) {
+                        b = memdup((const uint8_t*) bus->rbuffer + size, remaining);
+                        if (!b)
+                                return -ENOMEM;
+                } else
+                        b = NULL;
+        } else {
+                m = memdup((const uint8_t*) bus->rbuffer + bus->rbuffer_offset, size);
+                if (!m)
                         return -ENOMEM;
-        } else
+
                 b = NULL;
+        }
+
+        /* With fd passing, a single read might return the fds of a message following the one we are
+         * looking at, as the kernel only attaches them to the first byte of their message. Hence we pass
+         * all fds we have, and the message takes as many as it declares, in order. */
+        if (bus->n_fds > 0) {
+                fds = newdup(int, bus->fds, bus->n_fds);
+                if (!fds) {
+                        free(whole ? b : m);
+                        return -ENOMEM;
+                }
+        }
 
         r = bus_message_from_malloc(bus,
-                                    bus->rbuffer, size,
-                                    bus->fds, bus->n_fds,
+                                    m, size,
+                                    fds, bus->n_fds,
                                     NULL,
                                     &t);
         if (r == -EBADMSG) {
                 log_debug_errno(r, "Received invalid message from connection %s, dropping.", strna(bus->description));
-                free(bus->rbuffer); /* We want to drop current rbuffer and proceed with whatever remains in b */
+                free(m); /* We want to drop the message and proceed with whatever remains */
+
+                /* We can't tell which fds the message would have owned, hence drop all */
+                bus_socket_drop_fds(bus);
         } else if (r < 0) {
-                free(b);
+                free(whole ? b : m);
                 return r;
+        } else if (t->n_fds > 0) {
+                /* The message owns the copy of the fd array now */
+                TAKE_PTR(fds);
+
+                memmove(bus->fds, bus->fds + t->n_fds, (bus->n_fds - t->n_fds) * sizeof(int));
+                bus->n_fds -= t->n_fds;
+                if (bus->n_fds == 0)
+                        bus->fds = mfree(bus->fds);
         }
 
-        /* rbuffer ownership was either transferred to t, or we got EBADMSG and dropped it. */
-        bus->rbuffer = b;
-        bus->rbuffer_size -= size;
+        /* Message memory ownership was either transferred to t, or we got EBADMSG and dropped it. */
+        if (whole) {
+                bus->rbuffer = b;
+                bus->rbuffer_size = bus->rbuffer_allocated = remaining;
+        } else {
+                bus->rbuffer_offset += size;
+                if (bus->rbuffer_offset == bus->rbuffer_size)
+                        bus->rbuffer_offset = bus->rbuffer_size = 0;
+        }
 
-        bus->fds = NULL;
-        bus->n_fds = 0;
+        /* Everything we have read has been turned into messages, hence any fds left over were not
+         * declared by anyone */
+        if (bus->rbuffer_size == bus->rbuffer_offset && bus->n_fds > 0) {
+                log_debug("Received %zu undeclared file descriptors on connection %s, closing them.",
+                          bus->n_fds, strna(bus->description));
+                bus_socket_drop_fds(bus);
+        }
 
         if (t) {
                 t->read_counter = ++bus->read_counter;
@@ -1153,11 +1217,36 @@ static int bus_socket_make_message(sd_bus *bus, size_t size) {
         return 1;
 }
 
+static int bus_socket_make_messages(sd_bus *bus) {
+        size_t need;
+        int r, ret = 0;
+
+        assert(bus);
+
+        /* Turn everything complete in the buffer into messages, so that the rqueue tells whether there's
+         * more to dispatch without another read. */
+
+        for (;;) {
+                r = bus_socket_read_message_need(bus, &need);
+                if (r < 0)
+                        return r;
+
+                if (bus->rbuffer_size - bus->rbuffer_offset < need)
+                        return ret;
+
+                r = bus_socket_make_message(bus, need);
+                if (r < 0)
+                        return r;
+
+                ret = 1;
+        }
+}
+
 int bus_socket_read_message(sd_bus *bus) {
         struct msghdr mh;
         struct iovec iov = {};
         ssize_t k;
-        size_t need;
+        size_t need, want;
         int r;
         void *b;
         union {
@@ -1169,20 +1258,33 @@ int bus_socket_read_message(sd_bus *bus) {
         assert(bus);
         assert(IN_SET(bus->state, BUS_RUNNING, BUS_HELLO));
 
+        r = bus_socket_make_messages(bus);
+        if (r != 0)
+                return r;
+
         r = bus_socket_read_message_need(bus, &need);
         if (r < 0)
                 return r;
 
-        if (bus->rbuffer_size >= need)
-                return bus_socket_make_message(bus, need);
+        /* Only the beginning of a message is left, move it to the front */
+        if (bus->rbuffer_offset > 0) {
+                bus->rbuffer_size -= bus->rbuffer_offset;
+                memmove(bus->rbuffer, (uint8_t*) bus->rbuffer + bus->rbuffer_offset, bus->rbuffer_size);
+                bus->rbuffer_offset = 0;
+        }
 
-        b = realloc(bus->rbuffer, need);
-        if (!b)
-                return -ENOMEM;
+        /* Read as much as is there, but at least the rest of the current message */
+        want = MAX(need, (size_t) BUS_READ_AHEAD_SIZE);
+        if (bus->rbuffer_allocated < want) {
+                b = realloc(bus->rbuffer, want);
+                if (!b)
+                        return -ENOMEM;
 
-        bus->rbuffer = b;
+                bus->rbuffer = b;
+                bus->rbuffer_allocated = want;
+        }
 
-        iov = IOVEC_MAKE((uint8_t *)bus->rbuffer + bus->rbuffer_size, need - bus->rbuffer_size);
+        iov = IOVEC_MAKE((uint8_t *)bus->rbuffer + bus->rbuffer_size, bus->rbuffer_allocated - bus->rbuffer_size);
 
         if (bus->prefer_readv)
                 k = readv(bus->input_fd, &iov, 1);
@@ -1226,6 +1328,14 @@ int bus_socket_read_message(sd_bus *bus) {
                                         return -EIO;
                                 }
 
+                                /* The kernel returns the fds of at most one message per read, and we
+                                 * only read when no complete message is buffered anymore. Hence anything
+                                 * beyond the fds of two messages is bogus. */
+                                if (bus->n_fds + n > 2 * BUS_FDS_MAX) {
+                                        close_many((int*) CMSG_DATA(cmsg), n);
+                                        return -EIO;
+                                }
+
                                 f = reallocarray(bus->fds, bus->n_fds + n, sizeof(int));
                                 if (!f) {
                                         close_many((int*) CMSG_DATA(cmsg), n);
@@ -1240,13 +1350,10 @@ int bus_socket_read_message(sd_bus *bus) {
                                           cmsg->cmsg_level, cmsg->cmsg_type);
         }
 
-        r = bus_socket_read_message_need(bus, &need);
+        r = bus_socket_make_messages(bus);
         if (r < 0)
                 return r;
 
-        if (bus->rbuffer_size >= need)
-                return bus_socket_make_message(bus, need);
-
         return 1;
 }
 
@@ -214,8 +214,7 @@ static sd_bus* bus_free(sd_bus *b) {
         assert(b->match_callbacks.type == BUS_MATCH_ROOT);
         bus_match_free(&b->match_callbacks);
 
-        hashmap_free_free(b->vtable_methods);
-        hashmap_free_free(b->vtable_properties);
+        hashmap_free(b->properties_cache);
 
         assert(hashmap_isempty(b->nodes));
         hashmap_free(b->nodes);
@@ -8,22 +8,143 @@
 #include "alloc-util.h"
 #include "bus-internal.h"
 #include "bus-kernel.h"
+#include "bus-message.h"
 #include "bus-util.h"
 #include "def.h"
 #include "fd-util.h"
+#include "io-util.h"
+#include "json.h"
 #include "missing_resource.h"
+#include "parse-util.h"
+#include "sort-util.h"
+#include "stdio-util.h"
 #include "time-util.h"
 #include "util.h"
 
 #define MAX_SIZE (2*1024*1024)
+#define MAX_PIPELINE_DEPTH 64U
+#define N_STRINGS 256U
+#define FANOUT_BATCH 64U
 
 static usec_t arg_loop_usec = 100 * USEC_PER_MSEC;
+static bool arg_json = false;
+static unsigned arg_subscribers = 4;
+static unsigned arg_matches = 16;
 
 typedef enum Type {
         TYPE_LEGACY,
         TYPE_DIRECT,
 } Type;
 
+static const char *type_to_string(Type type) {
+        return type == TYPE_DIRECT ? "direct" : "legacy";
+}
+
+static int property_get_value(
+                sd_bus *bus,
+                const char *path,
+                const char *interface,
+                const char *property,
+                sd_bus_message *reply,
+                void *userdata,
+                sd_bus_error *error) {
+
+        return sd_bus_message_append(reply, "t", (uint64_t) strlen(property));
+}
+
+static int property_get_strings(
+                sd_bus *bus,
+                const char *path,
+                const char *interface,
+                const char *property,
+                sd_bus_message *reply,
+                void *userdata,
+                sd_bus_error *error) {
+
+        unsigned i;
+        int r;
+
+        r = sd_bus_message_open_container(reply, 'a', "s");
+        if (r < 0)
+                return r;
+
+        for (i = 0; i < N_STRINGS; i++) {
+                char buf[STRLEN("string") + DECIMAL_STR_MAX(unsigned)];
+
+                xsprintf(buf, "string%u", i);
+
+                r = sd_bus_message_append(reply, "s", buf);
+                if (r < 0)
+                        return r;
+        }
+
+        return sd_bus_message_close_container(reply);
+}
+
+#define VALUE_PROPERTY(n) SD_BUS_PROPERTY("Value" #n, "t", property_get_value, 0, 0)
+
+static const sd_bus_vtable properties_vtable[] = {
+        SD_BUS_VTABLE_START(0),
+        SD_BUS_PROPERTY("Strings", "as", property_get_strings, 0, 0),
+        VALUE_PROPERTY(0),
+        VALUE_PROPERTY(1),
+        VALUE_PROPERTY(2),
+        VALUE_PROPERTY(3),
+        VALUE_PROPERTY(4),
+        VALUE_PROPERTY(5),
+        VALUE_PROPERTY(6),
+        VALUE_PROPERTY(7),
+        VALUE_PROPERTY(8),
+        VALUE_PROPERTY(9),
+        VALUE_PROPERTY(10),
+        VALUE_PROPERTY(11),
+        VALUE_PROPERTY(12),
+        VALUE_PROPERTY(13),
+        VALUE_PROPERTY(14),
+        VALUE_PROPERTY(15),
+        VALUE_PROPERTY(16),
+        VALUE_PROPERTY(17),
+        VALUE_PROPERTY(18),
+        VALUE_PROPERTY(19),
+        VALUE_PROPERTY(20),
+        VALUE_PROPERTY(21),
+        VALUE_PROPERTY(22),
+        VALUE_PROPERTY(23),
+        VALUE_PROPERTY(24),
+        VALUE_PROPERTY(25),
+        VALUE_PROPERTY(26),
+        VALUE_PROPERTY(27),
+        VALUE_PROPERTY(28),
+        VALUE_PROPERTY(29),
+        VALUE_PROPERTY(30),
+        VALUE_PROPERTY(31),
+        SD_BUS_VTABLE_END
+};
+
+static void report(JsonVariant *v) {
+        JsonVariant *e;
+        const char *k;
+
+        if (arg_json) {
+                json_variant_dump(v, JSON_FORMAT_NEWLINE|JSON_FORMAT_FLUSH, stdout, NULL);
+                return;
+        }
+
+        JSON_VARIANT_OBJECT_FOREACH(k, e, v) {
+                _cleanup_free_ char *t = NULL;
+
+                if (json_variant_is_string(e))
+                        printf("%s\t%s\n", k, json_variant_string(e));
+                else {
+                        assert_se(json_variant_format(e, 0, &t) >= 0);
+                        printf("%s\t%s\n", k, t);
+                }
+        }
+
+        putchar('\n');
+        fflush(stdout);
+}
+
 static void server(sd_bus *b, size_t *result) {
         int r;
 
@@ -147,28 +268,342 @@ static void client_bisect(const char *address, const char *server_name) {
         sd_bus_unref(b);
 }
 
-static void client_chart(Type type, const char *address, const char *server_name, int fd) {
+static sd_bus *client_connect(Type type, const char *address, int fd) {
+        sd_bus *b;
+
+        assert_se(sd_bus_new(&b) >= 0);
+
+        if (type == TYPE_DIRECT)
+                assert_se(sd_bus_set_fd(b, fd, fd) >= 0);
+        else {
+                assert_se(sd_bus_set_address(b, address) >= 0);
+                assert_se(sd_bus_set_bus_client(b, true) >= 0);
+        }
+
+        assert_se(sd_bus_start(b) >= 0);
+
+        return b;
+}
+
+static void client_exit(sd_bus *b, const char *server_name, uint64_t result) {
         _cleanup_(sd_bus_message_unrefp) sd_bus_message *x = NULL;
-        size_t csize;
+
+        assert_se(sd_bus_message_new_method_call(b, &x, server_name, "/", "benchmark.server", "Exit") >= 0);
+        assert_se(sd_bus_message_append(x, "t", result) >= 0);
+        assert_se(sd_bus_send(b, x, NULL) >= 0);
+        assert_se(sd_bus_flush(b) >= 0);
+}
+
+static int nsec_compare(const nsec_t *a, const nsec_t *b) {
+        return CMP(*a, *b);
+}
+
+static nsec_t percentile(const nsec_t *samples, size_t n, unsigned permille) {
+        assert(n > 0);
+
+        return samples[MIN(n * permille / 1000, n - 1)];
+}
+
+static void client_latency(Type type, const char *address, const char *server_name, int fd) {
+        _cleanup_(json_variant_unrefp) JsonVariant *v = NULL;
+        _cleanup_free_ nsec_t *samples = NULL;
+        size_t n_samples = 0, n_allocated = 0;
+        usec_t t;
         sd_bus *b;
+
+        b = client_connect(type, address, fd);
+
+        assert_se(sd_bus_call_method(b, server_name, "/", "benchmark.server", "Ping", NULL, NULL, NULL) >= 0);
+
+        t = now(CLOCK_MONOTONIC);
+        do {
+                nsec_t n;
+
+                n = now_nsec(CLOCK_MONOTONIC);
+                assert_se(sd_bus_call_method(b, server_name, "/", "benchmark.server", "Ping", NULL, NULL, NULL) >= 0);
+
+                assert_se(GREEDY_REALLOC(samples, n_allocated, n_samples + 1));
+                samples[n_samples++] = now_nsec(CLOCK_MONOTONIC) - n;
+        } while (now(CLOCK_MONOTONIC) < t + arg_loop_usec);
+
+        typesafe_qsort(samples, n_samples, nsec_compare);
+
+        assert_se(json_build(&v, JSON_BUILD_OBJECT(
+                                             JSON_BUILD_PAIR("benchmark", JSON_BUILD_STRING("latency")),
+                                             JSON_BUILD_PAIR("connection", JSON_BUILD_STRING(type_to_string(type))),
+                                             JSON_BUILD_PAIR("calls", JSON_BUILD_UNSIGNED(n_samples)),
+                                             JSON_BUILD_PAIR("p50_nsec", JSON_BUILD_UNSIGNED(percentile(samples, n_samples, 500))),
+                                             JSON_BUILD_PAIR("p90_nsec", JSON_BUILD_UNSIGNED(percentile(samples, n_samples, 900))),
+                                             JSON_BUILD_PAIR("p99_nsec", JSON_BUILD_UNSIGNED(percentile(samples, n_samples, 990))),
+                                             JSON_BUILD_PAIR("p999_nsec", JSON_BUILD_UNSIGNED(percentile(samples, n_samples, 999))),
+                                             JSON_BUILD_PAIR("max_nsec", JSON_BUILD_UNSIGNED(samples[n_samples - 1])))) >= 0);
+        report(v);
+
+        client_exit(b, server_name, 0);
+        sd_bus_unref(b);
+}
+
+typedef struct Pipeline {
+        unsigned n_pending;
+        uint64_t n_completed;
+} Pipeline;
+
+static int pipeline_reply(sd_bus_message *m, void *userdata, sd_bus_error *error) {
+        Pipeline *p = userdata;
+
+        assert_se(!sd_bus_message_is_method_error(m, NULL));
+
+        p->n_pending--;
+        p->n_completed++;
+
+        return 1;
+}
+
+static void pipeline_process(sd_bus *b) {
         int r;
 
-        r = sd_bus_new(&b);
+        r = sd_bus_process(b, NULL);
         assert_se(r >= 0);
+        if (r == 0)
+                assert_se(sd_bus_wait(b, USEC_INFINITY) >= 0);
+}
 
-        if (type == TYPE_DIRECT) {
-                r = sd_bus_set_fd(b, fd, fd);
-                assert_se(r >= 0);
-        } else {
-                r = sd_bus_set_address(b, address);
-                assert_se(r >= 0);
+static void client_pipeline(Type type, const char *address, const char *server_name, int fd) {
+        unsigned depth;
+        sd_bus *b;
 
-                r = sd_bus_set_bus_client(b, true);
+        b = client_connect(type, address, fd);
+
+        assert_se(sd_bus_call_method(b, server_name, "/", "benchmark.server", "Ping", NULL, NULL, NULL) >= 0);
+
+        for (depth = 1; depth <= MAX_PIPELINE_DEPTH; depth *= 2) {
+                _cleanup_(json_variant_unrefp) JsonVariant *v = NULL;
+                Pipeline p = {};
+                uint64_t n;
+                usec_t t;
+
+                t = now(CLOCK_MONOTONIC);
+                do {
+                        while (p.n_pending < depth) {
+                                assert_se(sd_bus_call_method_async(b, NULL, server_name, "/", "benchmark.server", "Ping", pipeline_reply, &p, NULL) >= 0);
+                                p.n_pending++;
+                        }
+
+                        pipeline_process(b);
+                } while (now(CLOCK_MONOTONIC) < t + arg_loop_usec);
+
+                n = p.n_completed;
+
+                /* Collect the calls still in flight, they must not be attributed to the next depth */
+                while (p.n_pending > 0)
+                        pipeline_process(b);
+
+                assert_se(json_build(&v, JSON_BUILD_OBJECT(
+                                                     JSON_BUILD_PAIR("benchmark", JSON_BUILD_STRING("pipeline")),
+                                                     JSON_BUILD_PAIR("connection", JSON_BUILD_STRING(type_to_string(type))),
+                                                     JSON_BUILD_PAIR("depth", JSON_BUILD_UNSIGNED(depth)),
+                                                     JSON_BUILD_PAIR("calls_per_sec", JSON_BUILD_UNSIGNED(n * USEC_PER_SEC / arg_loop_usec)))) >= 0);
+                report(v);
+        }
+
+        client_exit(b, server_name, 0);
+        sd_bus_unref(b);
+}
+
+static void client_getall(Type type, const char *address, const char *server_name, int fd) {
+        _cleanup_(json_variant_unrefp) JsonVariant *v = NULL;
+        size_t reply_size = 0;
+        unsigned n;
+        usec_t t;
+        sd_bus *b;
+
+        b = client_connect(type, address, fd);
+
+        assert_se(sd_bus_call_method(b, server_name, "/", "benchmark.server", "Ping", NULL, NULL, NULL) >= 0);
+
+        t = now(CLOCK_MONOTONIC);
+        for (n = 0;; n++) {
+                _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
+
+                assert_se(sd_bus_call_method(b, server_name, "/bench", "org.freedesktop.DBus.Properties", "GetAll", NULL, &reply, "s", "benchmark.properties") >= 0);
+                reply_size = BUS_MESSAGE_SIZE(reply);
+
+                if (now(CLOCK_MONOTONIC) >= t + arg_loop_usec)
+                        break;
+        }
+
+        assert_se(json_build(&v, JSON_BUILD_OBJECT(
+                                             JSON_BUILD_PAIR("benchmark", JSON_BUILD_STRING("getall")),
+                                             JSON_BUILD_PAIR("connection", JSON_BUILD_STRING(type_to_string(type))),
+                                             JSON_BUILD_PAIR("reply_size", JSON_BUILD_UNSIGNED(reply_size)),
+                                             JSON_BUILD_PAIR("calls_per_sec", JSON_BUILD_UNSIGNED((uint64_t) n * USEC_PER_SEC / arg_loop_usec)))) >= 0);
+        report(v);
+
+        client_exit(b, server_name, 0);
+        sd_bus_unref(b);
+}
+
+typedef struct Subscriber {
+        uint64_t n_ticks;
+        bool stop;
+} Subscriber;
+
+static int subscriber_tick(sd_bus_message *m, void *userdata, sd_bus_error *error) {
+        Subscriber *s = userdata;
+
+        s->n_ticks++;
+        return 0;
+}
+
+static int subscriber_stop(sd_bus_message *m, void *userdata, sd_bus_error *error) {
+        Subscriber *s = userdata;
+
+        s->stop = true;
+        return 0;
+}
+
+static int subscriber_other(sd_bus_message *m, void *userdata, sd_bus_error *error) {
+        assert_not_reached("Signal nobody sends received");
+}
+
+static void subscriber(Type type, const char *address, int fd, int report_fd) {
+        Subscriber s = {};
+        unsigned i;
+        sd_bus *b;
+        int r;
+
+        b = client_connect(type, address, fd);
+
+        /* Matches that never fire, so that match evaluation is part of the measurement */
+        for (i = 1; i < arg_matches; i++) {
+                char member[STRLEN("Other") + DECIMAL_STR_MAX(unsigned)];
+
+                xsprintf(member, "Other%u", i);
+                assert_se(sd_bus_match_signal(b, NULL, NULL, "/bench", "benchmark.signal", member, subscriber_other, NULL) >= 0);
+        }
+
+        assert_se(sd_bus_match_signal(b, NULL, NULL, "/bench", "benchmark.signal", "Tick", subscriber_tick, &s) >= 0);
+        assert_se(sd_bus_match_signal(b, NULL, NULL, "/bench", "benchmark.signal", "Stop", subscriber_stop, &s) >= 0);
+
+        /* Tell the emitter that the matches are in place */
+        assert_se(loop_write(report_fd, &s.n_ticks, sizeof(s.n_ticks), false) >= 0);
+
+        while (!s.stop) {
+                r = sd_bus_process(b, NULL);
                 assert_se(r >= 0);
+                if (r == 0)
+                        assert_se(sd_bus_wait(b, USEC_INFINITY) >= 0);
         }
 
-        r = sd_bus_start(b);
-        assert_se(r >= 0);
+        assert_se(loop_write(report_fd, &s.n_ticks, sizeof(s.n_ticks), false) >= 0);
+
+        sd_bus_unref(b);
+}
+
+static void fanout(Type type, const char *address) {
+        _cleanup_(json_variant_unrefp) JsonVariant *v = NULL;
+        _cleanup_close_pair_ int report_pipe[2] = { -1, -1 };
+        uint64_t n_sent = 0, n_received = 0;
+        size_t n_emitters;
+        sd_bus **emitters;
+        usec_t t, duration;
+        unsigned i;
+        pid_t *pids;
+
+        /* On direct connections the emitter has to send each signal to every subscriber itself, on the bus
+         * the broker does that. */
+        n_emitters = type == TYPE_DIRECT ? arg_subscribers : 1;
+        emitters = newa0(sd_bus*, n_emitters);
+        pids = newa(pid_t, arg_subscribers);
+
+        assert_se(pipe2(report_pipe, O_CLOEXEC) >= 0);
+
+        for (i = 0; i < arg_subscribers; i++) {
+                _cleanup_close_pair_ int pair[2] = { -1, -1 };
+
+                if (type == TYPE_DIRECT) {
+                        assert_se(socketpair(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC, 0, pair) >= 0);
+
+                        assert_se(sd_bus_new(&emitters[i]) >= 0);
+                        assert_se(sd_bus_set_fd(emitters[i], pair[0], pair[0]) >= 0);
+                        assert_se(sd_bus_set_server(emitters[i], true, SD_ID128_NULL) >= 0);
+                        assert_se(sd_bus_start(emitters[i]) >= 0);
+                        pair[0] = -1;
+                }
+
+                pids[i] = fork();
+                assert_se(pids[i] >= 0);
+
+                if (pids[i] == 0) {
+                        report_pipe[0] = safe_close(report_pipe[0]);
+                        subscriber(type, address, TAKE_FD(pair[1]), report_pipe[1]);
+                        _exit(EXIT_SUCCESS);
+                }
+        }
+
+        report_pipe[1] = safe_close(report_pipe[1]);
+
+        if (type != TYPE_DIRECT)
+                emitters[0] = client_connect(type, address, -1);
+
+        for (i = 0; i < arg_subscribers; i++) {
+                uint64_t x;
+
+                assert_se(loop_read_exact(report_pipe[0], &x, sizeof(x), false) >= 0);
+        }
+
+        t = now(CLOCK_MONOTONIC);
+        do {
+                unsigned k;
+                size_t j;
+
+                /* Send a batch, and then wait until it is written, so that the queues don't grow without
+                 * bounds if the subscribers are slower than we are */
+                for (k = 0; k < FANOUT_BATCH; k++, n_sent++)
+                        for (j = 0; j < n_emitters; j++)
+                                assert_se(sd_bus_emit_signal(emitters[j], "/bench", "benchmark.signal", "Tick", "t", n_sent) >= 0);
+
+                for (j = 0; j < n_emitters; j++)
+                        assert_se(sd_bus_flush(emitters[j]) >= 0);
+        } while (now(CLOCK_MONOTONIC) < t + arg_loop_usec);
+
+        for (i = 0; i < n_emitters; i++) {
+                assert_se(sd_bus_emit_signal(emitters[i], "/bench", "benchmark.signal", "Stop", NULL) >= 0);
+                assert_se(sd_bus_flush(emitters[i]) >= 0);
+        }
+
+        for (i = 0; i < arg_subscribers; i++) {
+                uint64_t x;
+
+                assert_se(loop_read_exact(report_pipe[0], &x, sizeof(x), false) >= 0);
+                n_received += x;
+        }
+
+        duration = now(CLOCK_MONOTONIC) - t;
+
+        for (i = 0; i < arg_subscribers; i++)
+                assert_se(waitpid(pids[i], NULL, 0) == pids[i]);
+
+        for (i = 0; i < n_emitters; i++)
+                sd_bus_flush_close_unref(emitters[i]);
+
+        assert_se(json_build(&v, JSON_BUILD_OBJECT(
+                                             JSON_BUILD_PAIR("benchmark", JSON_BUILD_STRING("fanout")),
+                                             JSON_BUILD_PAIR("connection", JSON_BUILD_STRING(type_to_string(type))),
+                                             JSON_BUILD_PAIR("subscribers", JSON_BUILD_UNSIGNED(arg_subscribers)),
+                                             JSON_BUILD_PAIR("matches", JSON_BUILD_UNSIGNED(arg_matches)),
+                                             JSON_BUILD_PAIR("signals", JSON_BUILD_UNSIGNED(n_sent)),
+                                             JSON_BUILD_PAIR("deliveries", JSON_BUILD_UNSIGNED(n_received)),
+                                             JSON_BUILD_PAIR("deliveries_per_sec", JSON_BUILD_UNSIGNED(n_received * USEC_PER_SEC / MAX(duration, (usec_t) 1))))) >= 0);
+        report(v);
+}
+
+static void client_chart(Type type, const char *address, const char *server_name, int fd) {
+        size_t csize;
+        sd_bus *b;
+        int r;
+
+        b = client_connect(type, address, fd);
 
         r = sd_bus_call_method(b, server_name, "/", "benchmark.server", "Ping", NULL, NULL, NULL);
         assert_se(r >= 0);
@@ -199,23 +634,63 @@ static void client_chart(Type type, const char *address, const char *server_name
         }
 
         b->use_memfd = 1;
-        assert_se(sd_bus_message_new_method_call(b, &x, server_name, "/", "benchmark.server", "Exit") >= 0);
-        assert_se(sd_bus_message_append(x, "t", csize) >= 0);
-        assert_se(sd_bus_send(b, x, NULL) >= 0);
+        client_exit(b, server_name, csize);
 
         sd_bus_unref(b);
 }
 
+static void parse_chart(sd_bus *b) {
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL;
+        _cleanup_free_ void *blob = NULL;
+        unsigned n;
+        size_t sz;
+        usec_t t;
+
+        /* Measures how fast a received signal is parsed and dropped again, as happens to most of the
+         * broadcasts a client with a few matches installed gets to see */
+
+        assert_se(sd_bus_message_new_signal(b, &m, "/org/freedesktop/systemd1/unit/foobar_2eservice", "org.freedesktop.DBus.Properties", "PropertiesChanged") >= 0);
+        assert_se(sd_bus_message_set_sender(m, ":1.4711") >= 0);
+        assert_se(sd_bus_message_append(m, "sa{sv}as", "org.freedesktop.systemd1.Unit", 2, "ActiveState", "s", "active", "SubState", "s", "running", 0) >= 0);
+        assert_se(sd_bus_message_seal(m, 4711, 0) >= 0);
+        assert_se(bus_message_get_blob(m, &blob, &sz) >= 0);
+
+        printf("SIZE\tPARSE\n");
+        printf("%zu\t", sz);
+
+        t = now(CLOCK_MONOTONIC);
+        for (n = 0;; n++) {
+                _cleanup_(sd_bus_message_unrefp) sd_bus_message *x = NULL;
+                void *copy;
+
+                copy = memdup(blob, sz);
+                assert_se(copy);
+
+                assert_se(bus_message_from_malloc(b, copy, sz, NULL, 0, NULL, &x) >= 0);
+                assert_se(sd_bus_message_is_signal(x, "org.freedesktop.DBus.Properties", "PropertiesChanged"));
+
+                if (now(CLOCK_MONOTONIC) >= t + arg_loop_usec)
+                        break;
+        }
+
+        printf("%u\n", (unsigned) ((n * USEC_PER_SEC) / arg_loop_usec));
+}
+
 int main(int argc, char *argv[]) {
         enum {
                 MODE_BISECT,
                 MODE_CHART,
+                MODE_PARSE,
+                MODE_LATENCY,
+                MODE_PIPELINE,
+                MODE_GETALL,
+                MODE_FANOUT,
         } mode = MODE_BISECT;
         Type type = TYPE_LEGACY;
         int i, pair[2] = { -1, -1 };
         _cleanup_free_ char *address = NULL, *server_name = NULL;
         _cleanup_close_ int bus_ref = -1;
-        const char *unique;
+        const char *unique, *e;
         cpu_set_t cpuset;
         size_t result;
         sd_bus *b;
@@ -226,6 +701,30 @@ int main(int argc, char *argv[]) {
                 if (streq(argv[i], "chart")) {
                         mode = MODE_CHART;
                         continue;
+                } else if (streq(argv[i], "parse")) {
+                        mode = MODE_PARSE;
+                        continue;
+                } else if (streq(argv[i], "latency")) {
+                        mode = MODE_LATENCY;
+                        continue;
+                } else if (streq(argv[i], "pipeline")) {
+                        mode = MODE_PIPELINE;
+                        continue;
+                } else if (streq(argv[i], "getall")) {
+                        mode = MODE_GETALL;
+                        continue;
+                } else if (streq(argv[i], "fanout")) {
+                        mode = MODE_FANOUT;
+                        continue;
+                } else if (streq(argv[i], "json")) {
+                        arg_json = true;
+                        continue;
+                } else if ((e = startswith(argv[i], "subscribers="))) {
+                        assert_se(safe_atou(e, &arg_subscribers) >= 0 && arg_subscribers > 0);
+                        continue;
+                } else if ((e = startswith(argv[i], "matches="))) {
+                        assert_se(safe_atou(e, &arg_matches) >= 0 && arg_matches > 0);
+                        continue;
                 } else if (streq(argv[i], "legacy")) {
                         type = TYPE_LEGACY;
                         continue;
@@ -239,9 +738,11 @@ int main(int argc, char *argv[]) {
 
         assert_se(arg_loop_usec > 0);
 
-        if (type == TYPE_LEGACY) {
-                const char *e;
+        /* Parsing needs no peer, a socket pair is enough to get a bus object */
+        if (mode == MODE_PARSE)
+                type = TYPE_DIRECT;
 
+        if (type == TYPE_LEGACY) {
                 e = secure_getenv("DBUS_SESSION_BUS_ADDRESS");
                 assert_se(e);
 
@@ -249,9 +750,17 @@ int main(int argc, char *argv[]) {
                 assert_se(address);
         }
 
+        if (mode == MODE_FANOUT) {
+                fanout(type, address);
+                return 0;
+        }
+
         r = sd_bus_new(&b);
         assert_se(r >= 0);
 
+        r = sd_bus_add_object_vtable(b, NULL, "/bench", "benchmark.properties", properties_vtable, NULL);
+        assert_se(r >= 0);
+
         if (type == TYPE_DIRECT) {
                 assert_se(socketpair(AF_UNIX, SOCK_STREAM, 0, pair) >= 0);
 
@@ -271,6 +780,14 @@ int main(int argc, char *argv[]) {
         r = sd_bus_start(b);
         assert_se(r >= 0);
 
+        if (mode == MODE_PARSE) {
+                parse_chart(b);
+
+                safe_close(pair[1]);
+                sd_bus_unref(b);
+                return 0;
+        }
+
         if (type != TYPE_DIRECT) {
                 r = sd_bus_get_unique_name(b, &unique);
                 assert_se(r >= 0);
@@ -301,8 +818,24 @@ int main(int argc, char *argv[]) {
                 case MODE_CHART:
                         client_chart(type, address, server_name, pair[1]);
                         break;
+
+                case MODE_LATENCY:
+                        client_latency(type, address, server_name, pair[1]);
+                        break;
+
+                case MODE_PIPELINE:
+                        client_pipeline(type, address, server_name, pair[1]);
+                        break;
+
+                case MODE_GETALL:
+                        client_getall(type, address, server_name, pair[1]);
+                        break;
+
+                default:
+                        assert_not_reached("Unexpected mode");
                 }
 
+                fflush(stdout);
                 _exit(EXIT_SUCCESS);
         }
 
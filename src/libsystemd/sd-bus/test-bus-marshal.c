@@ -105,6 +105,54 @@ static void test_bus_label_escape(void) {
         test_bus_label_escape_one(":1", "_3a1");
 }
 
+static void test_bus_large_array(sd_bus *bus) {
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL;
+        _cleanup_free_ uint8_t *blob = NULL;
+        const uint8_t *array;
+        const char *x, *y;
+        void *buffer = NULL, *space;
+        size_t sz, i;
+        uint32_t u;
+
+        /* Large arrays get a body part of their own, make sure the message still looks the same on the
+         * wire, and that the memory returned by sd_bus_message_append_array_space() stays valid while more
+         * is appended. */
+
+        blob = malloc(2 * 1024 * 1024);
+        assert_se(blob);
+        for (i = 0; i < 2 * 1024 * 1024; i++)
+                blob[i] = (uint8_t) (i * 7);
+
+        assert_se(sd_bus_message_new_method_call(bus, &m, "foobar.waldo", "/", "foobar.waldo", "Large") >= 0);
+        assert_se(sd_bus_message_append(m, "s", "before") >= 0);
+        assert_se(sd_bus_message_append_array(m, 'y', blob, 2 * 1024 * 1024) >= 0);
+        assert_se(sd_bus_message_append_array_space(m, 'y', 1024 * 1024, &space) >= 0);
+        assert_se(sd_bus_message_append(m, "us", 4711, "after") >= 0);
+        assert_se(sd_bus_message_append_array(m, 't', blob, 1024 * 1024) >= 0);
+        memcpy(space, blob, 1024 * 1024);
+        assert_se(sd_bus_message_seal(m, 4713, 0) >= 0);
+
+        assert_se(bus_message_get_blob(m, &buffer, &sz) >= 0);
+        m = sd_bus_message_unref(m);
+
+        assert_se(bus_message_from_malloc(bus, buffer, sz, NULL, 0, NULL, &m) >= 0);
+
+        assert_se(sd_bus_message_read(m, "s", &x) > 0);
+        assert_se(streq(x, "before"));
+        assert_se(sd_bus_message_read_array(m, 'y', (const void**) &array, &sz) > 0);
+        assert_se(sz == 2 * 1024 * 1024);
+        assert_se(memcmp(array, blob, sz) == 0);
+        assert_se(sd_bus_message_read_array(m, 'y', (const void**) &array, &sz) > 0);
+        assert_se(sz == 1024 * 1024);
+        assert_se(memcmp(array, blob, sz) == 0);
+        assert_se(sd_bus_message_read(m, "us", &u, &y) > 0);
+        assert_se(u == 4711);
+        assert_se(streq(y, "after"));
+        assert_se(sd_bus_message_read_array(m, 't', (const void**) &array, &sz) > 0);
+        assert_se(sz == 1024 * 1024);
+        assert_se(memcmp(array, blob, sz) == 0);
+}
+
 int main(int argc, char *argv[]) {
         _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL, *copy = NULL;
         int r, boolean;
@@ -413,6 +461,8 @@ int main(int argc, char *argv[]) {
         assert_se(streq(c, "ccc"));
         assert_se(streq(d, "3"));
 
+        test_bus_large_array(bus);
+
         test_bus_label_escape();
         test_bus_path_encode();
         test_bus_path_encode_unique();
@@ -1,5 +1,6 @@
 /* SPDX-License-Identifier: LGPL-2.1+ */
 
+#include "alloc-util.h"
 #include "bus-match.h"
 #include "bus-message.h"
 #include "bus-slot.h"
@@ -8,6 +9,7 @@
 #include "macro.h"
 #include "memory-util.h"
 #include "tests.h"
+#include "time-util.h"
 
 static bool mask[32];
 
@@ -68,6 +70,92 @@ static void test_match_scope(const char *match, enum bus_match_scope scope) {
         bus_match_parse_free(components, n_components);
 }
 
+#define N_BENCHMARK_MATCHES 10000U
+#define N_BENCHMARK_RUNS 10000U
+
+static unsigned n_benchmark_hits;
+
+static int filter_count(sd_bus_message *m, void *userdata, sd_bus_error *ret_error) {
+        n_benchmark_hits++;
+        return 0;
+}
+
+static void test_match_benchmark(sd_bus *bus) {
+        struct bus_match_node root = {
+                .type = BUS_MATCH_ROOT,
+        };
+
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL;
+        _cleanup_free_ sd_bus_slot *slots = NULL;
+        char buf[FORMAT_TIMESPAN_MAX];
+        usec_t t;
+        unsigned i;
+
+        /* Install many matches of the kinds that used to be looked at one by one, and see that dispatching
+         * a message only hits the few that match */
+
+        assert_se(slots = new0(sd_bus_slot, N_BENCHMARK_MATCHES));
+
+        for (i = 0; i < N_BENCHMARK_MATCHES; i++) {
+                struct bus_match_component *components = NULL;
+                _cleanup_free_ char *match = NULL;
+                unsigned n_components = 0;
+                unsigned k = i / 5;
+
+                switch (i % 5) {
+
+                case 0:
+                        assert_se(asprintf(&match, "type='signal',path_namespace='/org/example/%u'", k) >= 0);
+                        break;
+
+                case 1:
+                        assert_se(asprintf(&match, "arg0namespace='org.example.n%u'", k) >= 0);
+                        break;
+
+                case 2:
+                        assert_se(asprintf(&match, "sender=':1.%u'", k) >= 0);
+                        break;
+
+                case 3:
+                        assert_se(asprintf(&match, "interface='org.example.i%u'", k) >= 0);
+                        break;
+
+                case 4:
+                        assert_se(asprintf(&match, "arg1path='/org/example/%u/'", k) >= 0);
+                        break;
+                }
+
+                assert_se(bus_match_parse(match, &components, &n_components) >= 0);
+
+                slots[i].userdata = UINT_TO_PTR(i);
+                slots[i].match_callback.callback = filter_count;
+
+                assert_se(bus_match_add(&root, components, n_components, &slots[i].match_callback) >= 0);
+                bus_match_parse_free(components, n_components);
+        }
+
+        assert_se(sd_bus_message_new_signal(bus, &m, "/org/example/7/sub", "org.example.i7", "Changed") >= 0);
+        assert_se(sd_bus_message_set_sender(m, ":1.7") >= 0);
+        assert_se(sd_bus_message_append(m, "ss", "org.example.n7.foo", "/org/example/7/x/y") >= 0);
+        assert_se(sd_bus_message_seal(m, 1, 0) >= 0);
+
+        n_benchmark_hits = 0;
+        t = now(CLOCK_MONOTONIC);
+
+        for (i = 0; i < N_BENCHMARK_RUNS; i++)
+                assert_se(bus_match_run(NULL, &root, m) == 0);
+
+        t = now(CLOCK_MONOTONIC) - t;
+
+        /* One match of each kind matches */
+        assert_se(n_benchmark_hits == 5 * N_BENCHMARK_RUNS);
+
+        log_info("%u matches, dispatching a message took %s on average.",
+                 N_BENCHMARK_MATCHES, format_timespan(buf, sizeof(buf), t / N_BENCHMARK_RUNS, 1));
+
+        bus_match_free(&root);
+}
+
 int main(int argc, char *argv[]) {
         struct bus_match_node root = {
                 .type = BUS_MATCH_ROOT,
@@ -137,6 +225,8 @@ int main(int argc, char *argv[]) {
 
         bus_match_free(&root);
 
+        test_match_benchmark(bus);
+
         test_match_scope("interface='foobar'", BUS_MATCH_GENERIC);
         test_match_scope("", BUS_MATCH_GENERIC);
         test_match_scope("interface='org.freedesktop.DBus.Local'", BUS_MATCH_LOCAL);
@@ -21,6 +21,9 @@ struct context {
         char *something;
         char *automatic_string_property;
         uint32_t automatic_integer_property;
+        uint32_t cached_value;
+        unsigned n_cached_get;
+        unsigned n_live_get;
 };
 
 static int something_handler(sd_bus_message *m, void *userdata, sd_bus_error *error) {
@@ -111,6 +114,32 @@ static int value_handler(sd_bus *bus, const char *path, const char *interface, c
         return 1;
 }
 
+static int cached_value_handler(sd_bus *bus, const char *path, const char *interface, const char *property, sd_bus_message *reply, void *userdata, sd_bus_error *error) {
+        struct context *c = userdata;
+
+        c->n_cached_get++;
+
+        return sd_bus_message_append(reply, "u", c->cached_value);
+}
+
+static int live_value_handler(sd_bus *bus, const char *path, const char *interface, const char *property, sd_bus_message *reply, void *userdata, sd_bus_error *error) {
+        struct context *c = userdata;
+
+        c->n_live_get++;
+
+        return sd_bus_message_append(reply, "u", c->n_live_get);
+}
+
+static int bump_handler(sd_bus_message *m, void *userdata, sd_bus_error *error) {
+        struct context *c = userdata;
+
+        c->cached_value++;
+
+        assert_se(sd_bus_emit_properties_changed(sd_bus_message_get_bus(m), "/cached", "org.freedesktop.systemd.CacheTest", "Value", NULL) >= 0);
+
+        return sd_bus_reply_method_return(m, "");
+}
+
 static int notify_test(sd_bus_message *m, void *userdata, sd_bus_error *error) {
         int r;
 
@@ -204,6 +233,21 @@ static const sd_bus_vtable vtable2[] = {
         SD_BUS_VTABLE_END
 };
 
+static const sd_bus_vtable vtable_duplicate[] = {
+        SD_BUS_VTABLE_START(0),
+        SD_BUS_METHOD("Exit", "", "", exit_handler, 0),
+        SD_BUS_VTABLE_END
+};
+
+static const sd_bus_vtable vtable3[] = {
+        SD_BUS_VTABLE_START(SD_BUS_VTABLE_CACHE_PROPERTIES),
+        SD_BUS_METHOD("Bump", "", "", bump_handler, 0),
+        SD_BUS_PROPERTY("Value", "u", cached_value_handler, 0, SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
+        SD_BUS_PROPERTY("Constant", "s", NULL, offsetof(struct context, automatic_string_property), SD_BUS_VTABLE_PROPERTY_CONST),
+        SD_BUS_PROPERTY("Live", "u", live_value_handler, 0, 0),
+        SD_BUS_VTABLE_END
+};
+
 static int enumerator_callback(sd_bus *bus, const char *path, void *userdata, char ***nodes, sd_bus_error *error) {
 
         if (object_path_startswith("/value", path))
@@ -236,9 +280,11 @@ static void *server(void *p) {
 
         assert_se(sd_bus_add_object_vtable(bus, NULL, "/foo", "org.freedesktop.systemd.test", vtable, c) >= 0);
         assert_se(sd_bus_add_object_vtable(bus, NULL, "/foo", "org.freedesktop.systemd.test2", vtable, c) >= 0);
+        assert_se(sd_bus_add_object_vtable(bus, NULL, "/foo", "org.freedesktop.systemd.test", vtable_duplicate, c) == -EEXIST);
         assert_se(sd_bus_add_fallback_vtable(bus, NULL, "/value", "org.freedesktop.systemd.ValueTest", vtable2, NULL, UINT_TO_PTR(20)) >= 0);
         assert_se(sd_bus_add_node_enumerator(bus, NULL, "/value", enumerator_callback, NULL) >= 0);
         assert_se(sd_bus_add_node_enumerator(bus, NULL, "/value/a", enumerator2_callback, NULL) >= 0);
+        assert_se(sd_bus_add_object_vtable(bus, NULL, "/cached", "org.freedesktop.systemd.CacheTest", vtable3, c) >= 0);
         assert_se(sd_bus_add_object_manager(bus, NULL, "/value") >= 0);
         assert_se(sd_bus_add_object_manager(bus, NULL, "/value/a") >= 0);
 
@@ -277,6 +323,37 @@ fail:
         return INT_TO_PTR(r);
 }
 
+static void check_cached_properties(sd_bus *bus, struct context *c, uint32_t value, uint32_t live) {
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
+        _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
+        unsigned n = 0;
+        const char *name;
+
+        assert_se(sd_bus_call_method(bus, "org.freedesktop.systemd.test", "/cached", "org.freedesktop.DBus.Properties", "GetAll", &error, &reply, "s", "org.freedesktop.systemd.CacheTest") >= 0);
+
+        assert_se(sd_bus_message_enter_container(reply, 'a', "{sv}") > 0);
+        while (sd_bus_message_enter_container(reply, 'e', "sv") > 0) {
+                const char *t;
+                uint32_t u;
+
+                assert_se(sd_bus_message_read(reply, "s", &name) > 0);
+
+                if (streq(name, "Constant")) {
+                        assert_se(sd_bus_message_read(reply, "v", "s", &t) > 0);
+                        assert_se(streq(t, c->automatic_string_property));
+                } else {
+                        assert_se(sd_bus_message_read(reply, "v", "u", &u) > 0);
+                        assert_se(u == (streq(name, "Value") ? value : live));
+                }
+
+                assert_se(sd_bus_message_exit_container(reply) > 0);
+                n++;
+        }
+        assert_se(sd_bus_message_exit_container(reply) > 0);
+
+        assert_se(n == 3);
+}
+
 static int client(struct context *c) {
         _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
         _cleanup_(sd_bus_unrefp) sd_bus *bus = NULL;
@@ -494,6 +571,28 @@ static int client(struct context *c) {
         sd_bus_message_unref(reply);
         reply = NULL;
 
+        /* Only the property that is not promised to emit PropertiesChanged is queried each time */
+        check_cached_properties(bus, c, 0, 1);
+        check_cached_properties(bus, c, 0, 2);
+        assert_se(c->n_cached_get == 1);
+        assert_se(c->n_live_get == 2);
+
+        r = sd_bus_call_method(bus, "org.freedesktop.systemd.test", "/cached", "org.freedesktop.systemd.CacheTest", "Bump", &error, NULL, "");
+        assert_se(r >= 0);
+
+        r = sd_bus_process(bus, &reply);
+        assert_se(r > 0);
+
+        assert_se(sd_bus_message_is_signal(reply, "org.freedesktop.DBus.Properties", "PropertiesChanged"));
+
+        sd_bus_message_unref(reply);
+        reply = NULL;
+
+        /* The signal dropped the cached data, the next call serializes it again */
+        check_cached_properties(bus, c, 1, 3);
+        check_cached_properties(bus, c, 1, 4);
+        assert_se(c->n_cached_get == 3);
+
         r = sd_bus_call_method(bus, "org.freedesktop.systemd.test", "/foo", "org.freedesktop.systemd.test", "Exit", &error, NULL, "");
         assert_se(r >= 0);
 
@@ -0,0 +1,197 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "sd-bus.h"
+
+#include "alloc-util.h"
+#include "log.h"
+#include "macro.h"
+#include "string-util.h"
+#include "tests.h"
+
+struct context {
+        int fds[2];
+        bool quit;
+
+        uint32_t counter;
+        char *name;
+
+        unsigned n_get_all;
+};
+
+static int bump_handler(sd_bus_message *m, void *userdata, sd_bus_error *error) {
+        struct context *c = userdata;
+
+        c->counter++;
+        assert_se(free_and_strdup(&c->name, "second") >= 0);
+
+        assert_se(sd_bus_emit_properties_changed(sd_bus_message_get_bus(m), "/foo", "org.freedesktop.systemd.test", "Counter", "Name", NULL) >= 0);
+
+        return sd_bus_reply_method_return(m, NULL);
+}
+
+static int exit_handler(sd_bus_message *m, void *userdata, sd_bus_error *error) {
+        struct context *c = userdata;
+
+        c->quit = true;
+
+        return sd_bus_reply_method_return(m, NULL);
+}
+
+static int get_constant(sd_bus *bus, const char *path, const char *interface, const char *property, sd_bus_message *reply, void *userdata, sd_bus_error *error) {
+        return sd_bus_message_append(reply, "as", 1, "constant");
+}
+
+static int get_all_filter(sd_bus_message *m, void *userdata, sd_bus_error *error) {
+        struct context *c = userdata;
+
+        if (sd_bus_message_is_method_call(m, "org.freedesktop.DBus.Properties", "GetAll"))
+                c->n_get_all++;
+
+        return 0;
+}
+
+static const sd_bus_vtable vtable[] = {
+        SD_BUS_VTABLE_START(0),
+        SD_BUS_METHOD("Bump", NULL, NULL, bump_handler, 0),
+        SD_BUS_METHOD("Exit", NULL, NULL, exit_handler, 0),
+        SD_BUS_PROPERTY("Counter", "u", NULL, offsetof(struct context, counter), SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
+        SD_BUS_PROPERTY("Name", "s", NULL, offsetof(struct context, name), SD_BUS_VTABLE_PROPERTY_EMITS_INVALIDATION),
+        SD_BUS_PROPERTY("Constant", "as", get_constant, 0, SD_BUS_VTABLE_PROPERTY_CONST),
+        SD_BUS_VTABLE_END
+};
+
+static void *server(void *p) {
+        struct context *c = p;
+        _cleanup_(sd_bus_flush_close_unrefp) sd_bus *bus = NULL;
+        sd_id128_t id;
+        int r;
+
+        assert_se(sd_id128_randomize(&id) >= 0);
+
+        assert_se(sd_bus_new(&bus) >= 0);
+        assert_se(sd_bus_set_fd(bus, c->fds[0], c->fds[0]) >= 0);
+        assert_se(sd_bus_set_server(bus, 1, id) >= 0);
+
+        assert_se(sd_bus_add_filter(bus, NULL, get_all_filter, c) >= 0);
+        assert_se(sd_bus_add_object_vtable(bus, NULL, "/foo", "org.freedesktop.systemd.test", vtable, c) >= 0);
+
+        assert_se(sd_bus_start(bus) >= 0);
+
+        while (!c->quit) {
+                r = sd_bus_process(bus, NULL);
+                if (r < 0)
+                        return INT_TO_PTR(log_error_errno(r, "Failed to process requests: %m"));
+
+                if (r == 0) {
+                        r = sd_bus_wait(bus, (uint64_t) -1);
+                        if (r < 0)
+                                return INT_TO_PTR(log_error_errno(r, "Failed to wait: %m"));
+                }
+        }
+
+        return NULL;
+}
+
+static int client(struct context *c) {
+        _cleanup_(sd_bus_property_cache_unrefp) sd_bus_property_cache *cache = NULL;
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
+        _cleanup_(sd_bus_flush_close_unrefp) sd_bus *bus = NULL;
+        _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
+        _cleanup_free_ char *name = NULL;
+        const char *s;
+        uint32_t u;
+        unsigned i;
+        int r;
+
+        assert_se(sd_bus_new(&bus) >= 0);
+        assert_se(sd_bus_set_fd(bus, c->fds[1], c->fds[1]) >= 0);
+        assert_se(sd_bus_start(bus) >= 0);
+
+        /* There's no bus driver that could resolve names, hence talk to the peer directly */
+        assert_se(sd_bus_property_cache_new(bus, &cache, NULL, "/foo", "org.freedesktop.systemd.test") >= 0);
+        assert_se(sd_bus_property_cache_get_bus(cache) == bus);
+
+        /* All properties are loaded at once, and then served locally */
+        for (i = 0; i < 3; i++) {
+                assert_se(sd_bus_property_cache_get_trivial(cache, "Counter", &error, 'u', &u) >= 0);
+                assert_se(u == 0);
+
+                assert_se(sd_bus_property_cache_get_string(cache, "Name", &error, &name) >= 0);
+                assert_se(streq(name, "first"));
+                name = mfree(name);
+
+                assert_se(sd_bus_property_cache_get(cache, "Constant", &error, &reply, "as") >= 0);
+                assert_se(sd_bus_message_enter_container(reply, 'a', "s") >= 0);
+                assert_se(sd_bus_message_read_basic(reply, 's', &s) > 0);
+                assert_se(streq(s, "constant"));
+                reply = sd_bus_message_unref(reply);
+        }
+
+        assert_se(c->n_get_all == 1);
+
+        r = sd_bus_property_cache_get_trivial(cache, "DoesNotExist", &error, 'u', &u);
+        assert_se(r < 0);
+        assert_se(sd_bus_error_has_name(&error, SD_BUS_ERROR_UNKNOWN_PROPERTY));
+        sd_bus_error_free(&error);
+
+        /* Counter is sent along in the signal, Name is only invalidated and fetched again */
+        assert_se(sd_bus_call_method(bus, NULL, "/foo", "org.freedesktop.systemd.test", "Bump", &error, NULL, NULL) >= 0);
+
+        while ((r = sd_bus_process(bus, NULL)) > 0)
+                ;
+        assert_se(r == 0);
+
+        assert_se(sd_bus_property_cache_get_trivial(cache, "Counter", &error, 'u', &u) >= 0);
+        assert_se(u == 1);
+
+        assert_se(sd_bus_property_cache_get_string(cache, "Name", &error, &name) >= 0);
+        assert_se(streq(name, "second"));
+        name = mfree(name);
+
+        assert_se(c->n_get_all == 1);
+
+        /* After explicit invalidation, everything is loaded again */
+        assert_se(sd_bus_property_cache_invalidate(cache) >= 0);
+        assert_se(sd_bus_property_cache_get_trivial(cache, "Counter", &error, 'u', &u) >= 0);
+        assert_se(u == 1);
+        assert_se(c->n_get_all == 2);
+
+        assert_se(sd_bus_call_method(bus, NULL, "/foo", "org.freedesktop.systemd.test", "Exit", &error, NULL, NULL) >= 0);
+
+        return 0;
+}
+
+int main(int argc, char *argv[]) {
+        struct context c = {};
+        pthread_t s;
+        void *p;
+        int r, q;
+
+        test_setup_logging(LOG_DEBUG);
+
+        assert_se(c.name = strdup("first"));
+        assert_se(socketpair(AF_UNIX, SOCK_STREAM, 0, c.fds) >= 0);
+
+        r = pthread_create(&s, NULL, server, &c);
+        if (r != 0)
+                return -r;
+
+        r = client(&c);
+
+        q = pthread_join(s, &p);
+        if (q != 0)
+                return -q;
+
+        if (r < 0)
+                return r;
+
+        if (PTR_TO_INT(p) < 0)
+                return PTR_TO_INT(p);
+
+        free(c.name);
+
+        return EXIT_SUCCESS;
+}
@@ -1,19 +1,28 @@
 /* SPDX-License-Identifier: LGPL-2.1+ */
 
+#include <fcntl.h>
 #include <pthread.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 #include "sd-bus.h"
 
 #include "bus-internal.h"
 #include "bus-util.h"
+#include "fd-util.h"
 #include "log.h"
 #include "macro.h"
 #include "memory-util.h"
 
+/* Sent by the client before the Exit call, so that the server gets to read bursts of messages, some of which
+ * carry fds */
+#define N_BURST 500U
+
 struct context {
         int fds[2];
 
+        unsigned n_burst;
+
         bool client_negotiate_unix_fds;
         bool server_negotiate_unix_fds;
 
@@ -59,10 +68,31 @@ static void *server(void *p) {
                 if (!m)
                         continue;
 
+                if (sd_bus_message_is_signal(m, "org.freedesktop.systemd.test", "Burst")) {
+                        uint32_t i;
+
+                        /* Messages need to arrive in order, and each with its own fd */
+                        if (streq(sd_bus_message_get_signature(m, true), "uh")) {
+                                uint8_t x;
+                                int fd;
+
+                                assert_se(sd_bus_message_read(m, "uh", &i, &fd) >= 0);
+                                assert_se(read(fd, &x, 1) == 1);
+                                assert_se(x == (uint8_t) i);
+                        } else
+                                assert_se(sd_bus_message_read(m, "u", &i) >= 0);
+
+                        assert_se(i == c->n_burst);
+                        c->n_burst++;
+                        continue;
+                }
+
                 log_info("Got message! member=%s", strna(sd_bus_message_get_member(m)));
 
                 if (sd_bus_message_is_method_call(m, "org.freedesktop.systemd.test", "Exit")) {
 
+                        assert_se(c->n_burst == N_BURST);
+
                         assert_se((sd_bus_can_send(bus, 'h') >= 1) ==
                                   (c->server_negotiate_unix_fds && c->client_negotiate_unix_fds));
 
@@ -109,6 +139,8 @@ static int client(struct context *c) {
         _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL, *reply = NULL;
         _cleanup_(sd_bus_unrefp) sd_bus *bus = NULL;
         sd_bus_error error = SD_BUS_ERROR_NULL;
+        bool can_fds;
+        unsigned i;
         int r;
 
         assert_se(sd_bus_new(&bus) >= 0);
@@ -117,6 +149,29 @@ static int client(struct context *c) {
         assert_se(sd_bus_set_anonymous(bus, c->client_anonymous_auth) >= 0);
         assert_se(sd_bus_start(bus) >= 0);
 
+        r = sd_bus_can_send(bus, 'h');
+        if (r < 0)
+                return log_error_errno(r, "Failed to connect: %m");
+        can_fds = r > 0;
+
+        for (i = 0; i < N_BURST; i++) {
+                _cleanup_(sd_bus_message_unrefp) sd_bus_message *s = NULL;
+
+                assert_se(sd_bus_message_new_signal(bus, &s, "/", "org.freedesktop.systemd.test", "Burst") >= 0);
+
+                if (can_fds && i % 3 == 0) {
+                        _cleanup_close_pair_ int p[2] = { -1, -1 };
+                        uint8_t x = i;
+
+                        assert_se(pipe2(p, O_CLOEXEC) >= 0);
+                        assert_se(write(p[1], &x, 1) == 1);
+                        assert_se(sd_bus_message_append(s, "uh", i, p[0]) >= 0);
+                } else
+                        assert_se(sd_bus_message_append(s, "u", i) >= 0);
+
+                assert_se(sd_bus_send(bus, s, NULL) >= 0);
+        }
+
         r = sd_bus_message_new_method_call(
                         bus,
                         &m,
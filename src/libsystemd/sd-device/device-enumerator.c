@@ -7,9 +7,12 @@
 
 #include "alloc-util.h"
 #include "device-enumerator-private.h"
+#include "device-private.h"
 #include "device-util.h"
 #include "dirent-util.h"
 #include "fd-util.h"
+#include "fs-util.h"
+#include "path-util.h"
 #include "set.h"
 #include "sort-util.h"
 #include "string-util.h"
@@ -461,6 +464,55 @@ static bool match_sysname(sd_device_enumerator *enumerator, const char *sysname)
         return false;
 }
 
+static int device_new_from_sysfs_entry(sd_device **ret, int dir_fd, const char *path, const struct dirent *dent) {
+        _cleanup_free_ char *target = NULL, *syspath = NULL;
+        const char *t;
+        size_t n;
+        int r;
+
+        assert(ret);
+        assert(path);
+        assert(dent);
+
+        /* The entries of /sys/bus/<bus>/devices/ and /sys/class/<class>/ are symlinks that the kernel
+         * creates as relative links to the device directory below /sys/devices/, in the form
+         * "../../devices/...". Resolve those directly, instead of chasing symlinks on every component of
+         * the path for each device. Anything else takes the slow path. */
+        if (dent->d_type != DT_LNK)
+                goto fallback;
+
+        r = readlinkat_malloc(dir_fd, dent->d_name, &target);
+        if (r < 0)
+                goto fallback;
+
+        /* path always ends in a slash, strip one more component for each "../" */
+        n = strlen(path) - 1;
+        for (t = target; startswith(t, "../"); t += 3) {
+                while (n > 0 && path[n - 1] != '/')
+                        n--;
+                if (n == 0)
+                        goto fallback;
+                n--;
+        }
+
+        if (strstr(t, "/.") || startswith(t, "."))
+                goto fallback;
+
+        syspath = strndup(path, n + 1);
+        if (!syspath)
+                return -ENOMEM;
+        if (!strextend(&syspath, t, NULL))
+                return -ENOMEM;
+
+        if (!path_startswith(syspath, "/sys/devices/"))
+                goto fallback;
+
+        return device_new_from_canonical_syspath(ret, syspath);
+
+fallback:
+        return sd_device_new_from_syspath(ret, strjoina(path, dent->d_name));
+}
+
 static int enumerator_scan_dir_and_add_devices(sd_device_enumerator *enumerator, const char *basedir, const char *subdir1, const char *subdir2) {
         _cleanup_closedir_ DIR *dir = NULL;
         char *path;
@@ -484,7 +536,6 @@ static int enumerator_scan_dir_and_add_devices(sd_device_enumerator *enumerator,
 
         FOREACH_DIRENT_ALL(dent, dir, return -errno) {
                 _cleanup_(sd_device_unrefp) sd_device *device = NULL;
-                char syspath[strlen(path) + 1 + strlen(dent->d_name) + 1];
                 int initialized, k;
 
                 if (dent->d_name[0] == '.')
@@ -493,9 +544,7 @@ static int enumerator_scan_dir_and_add_devices(sd_device_enumerator *enumerator,
                 if (!match_sysname(enumerator, dent->d_name))
                         continue;
 
-                (void) sprintf(syspath, "%s%s", path, dent->d_name);
-
-                k = sd_device_new_from_syspath(&device, syspath);
+                k = device_new_from_sysfs_entry(&device, dirfd(dir), path, dent);
                 if (k < 0) {
                         if (k != -ENODEV)
                                 /* this is necessarily racey, so ignore missing devices */
@@ -504,6 +553,10 @@ static int enumerator_scan_dir_and_add_devices(sd_device_enumerator *enumerator,
                         continue;
                 }
 
+                /* Check the cheap matches first, before the udev database is read */
+                if (!match_parent(enumerator, device))
+                        continue;
+
                 initialized = sd_device_get_is_initialized(device);
                 if (initialized < 0) {
                         if (initialized != -ENOENT)
@@ -529,9 +582,6 @@ static int enumerator_scan_dir_and_add_devices(sd_device_enumerator *enumerator,
                      sd_device_get_ifindex(device, NULL) >= 0))
                         continue;
 
-                if (!match_parent(enumerator, device))
-                        continue;
-
                 if (!match_tag(enumerator, device))
                         continue;
 
@@ -702,7 +752,11 @@ static int parent_add_child(sd_device_enumerator *enumerator, const char *path)
         const char *subsystem, *sysname;
         int r;
 
-        r = sd_device_new_from_syspath(&device, path);
+        /* The parent's syspath is canonical, and we only descend into real directories below it */
+        if (path_startswith(path, "/sys/devices/"))
+                r = device_new_from_canonical_syspath(&device, path);
+        else
+                r = sd_device_new_from_syspath(&device, path);
         if (r == -ENODEV)
                 /* this is necessarily racy, so ignore missing devices */
                 return 0;
@@ -43,6 +43,9 @@ struct sd_device_monitor {
 
 #define UDEV_MONITOR_MAGIC                0xfeedcafe
 
+/* Maximum number of messages to receive per wakeup of the event loop */
+#define DEVICE_MONITOR_BATCH_MAX          64U
+
 typedef struct monitor_netlink_header {
         /* "libudev" prefix to distinguish libudev and kernel messages */
         char prefix[8];
@@ -185,16 +188,39 @@ _public_ int sd_device_monitor_stop(sd_device_monitor *m) {
 }
 
 static int device_monitor_event_handler(sd_event_source *s, int fd, uint32_t revents, void *userdata) {
-        _cleanup_(sd_device_unrefp) sd_device *device = NULL;
+        _cleanup_(sd_device_monitor_unrefp) sd_device_monitor *ref = NULL;
         sd_device_monitor *m = userdata;
+        unsigned n;
+        int r;
 
         assert(m);
 
-        if (device_monitor_receive_device(m, &device) <= 0)
-                return 0;
+        /* The callback might drop the last reference to the monitor */
+        ref = sd_device_monitor_ref(m);
+
+        /* Uevents usually arrive in bursts. Process a bunch of them per wakeup, instead of going through
+         * another event loop iteration for each. Stop early when the callback stops the monitor, or asks
+         * the event loop to exit, so that no device is dispatched after that. */
+        for (n = 0; n < DEVICE_MONITOR_BATCH_MAX; n++) {
+                _cleanup_(sd_device_unrefp) sd_device *device = NULL;
+                int code;
+
+                r = device_monitor_receive_device(m, &device);
+                if (r < 0)
+                        return 0;
+                if (r == 0)
+                        continue;
 
-        if (m->callback)
-                return m->callback(m, device, m->userdata);
+                if (m->callback) {
+                        r = m->callback(m, device, m->userdata);
+                        if (r < 0)
+                                return r;
+                }
+
+                if (m->event_source != s ||
+                    sd_event_get_exit_code(m->event, &code) != -ENODATA)
+                        break;
+        }
 
         return 0;
 }
@@ -379,9 +405,9 @@ int device_monitor_receive_device(sd_device_monitor *m, sd_device **ret) {
 
         assert(ret);
 
-        buflen = recvmsg(m->sock, &smsg, 0);
+        buflen = recvmsg(m->sock, &smsg, MSG_DONTWAIT);
         if (buflen < 0) {
-                if (errno != EINTR)
+                if (!IN_SET(errno, EINTR, EAGAIN))
                         log_debug_errno(errno, "sd-device-monitor: Failed to receive message: %m");
                 return -errno;
         }
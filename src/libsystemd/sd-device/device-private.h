@@ -26,6 +26,9 @@ typedef enum DeviceAction {
 int device_new_from_nulstr(sd_device **ret, uint8_t *nulstr, size_t len);
 int device_new_from_strv(sd_device **ret, char **strv);
 int device_new_from_stat_rdev(sd_device **ret, const struct stat *st);
+/* Like sd_device_new_from_syspath(), but skips the canonicalization. Only for paths below /sys/devices/
+ * that are known to contain no symlinks. */
+int device_new_from_canonical_syspath(sd_device **ret, const char *syspath);
 
 int device_get_id_filename(sd_device *device, const char **ret);
 
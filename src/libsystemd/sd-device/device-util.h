@@ -37,11 +37,12 @@
                 sd_device *_d = (device);                               \
                 int _level = (level), _error = (error);                 \
                                                                         \
-                if (_d && _unlikely_(log_get_max_level() >= _level))    \
+                if (_d && log_level_enabled(_level))                    \
                         (void) sd_device_get_sysname(_d, &_sysname);    \
-                log_object_internal(_level, _error, PROJECT_FILE, __LINE__, __func__, \
-                                    _sysname ? "DEVICE=" : NULL, _sysname, \
-                                    NULL, NULL, ##__VA_ARGS__);         \
+                !log_level_enabled(_level) ? -ERRNO_VALUE(_error) :     \
+                        log_object_internal(_level, _error, PROJECT_FILE, __LINE__, __func__, \
+                                            _sysname ? "DEVICE=" : NULL, _sysname, \
+                                            NULL, NULL, ##__VA_ARGS__); \
         })
 
 #define log_device_debug(device, ...)   log_device_full(device, LOG_DEBUG, 0, ##__VA_ARGS__)
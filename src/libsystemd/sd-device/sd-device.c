@@ -678,6 +678,31 @@ _public_ int sd_device_get_syspath(sd_device *device, const char **ret) {
         return 0;
 }
 
+int device_new_from_canonical_syspath(sd_device **ret, const char *syspath) {
+        _cleanup_(sd_device_unrefp) sd_device *device = NULL;
+        const char *path;
+        int r;
+
+        assert(ret);
+        assert(syspath);
+        assert(path_startswith(syspath, "/sys/devices/"));
+
+        path = strjoina(syspath, "/uevent");
+        if (access(path, F_OK) < 0)
+                return errno == ENOENT ? -ENODEV : -errno;
+
+        r = device_new_aux(&device);
+        if (r < 0)
+                return r;
+
+        r = device_set_syspath(device, syspath, false);
+        if (r < 0)
+                return r;
+
+        *ret = TAKE_PTR(device);
+        return 0;
+}
+
 static int device_new_from_child(sd_device **ret, sd_device *child) {
         _cleanup_free_ char *path = NULL;
         const char *subdir, *syspath;
@@ -704,7 +729,14 @@ static int device_new_from_child(sd_device **ret, sd_device *child) {
 
                 *pos = '\0';
 
-                r = sd_device_new_from_syspath(ret, path);
+                /* The syspath of the child is canonical, and so are the paths of its parent
+                 * directories. Avoid chasing symlinks for every single one of them in that case: below
+                 * /sys/devices/ it is sufficient to check for the 'uevent' file, like
+                 * device_set_syspath() does after canonicalization. */
+                if (path_startswith(path, "/sys/devices/"))
+                        r = device_new_from_canonical_syspath(ret, path);
+                else
+                        r = sd_device_new_from_syspath(ret, path);
                 if (r < 0)
                         continue;
 
@@ -1298,8 +1330,13 @@ int device_read_db_internal_filename(sd_device *device, const char *filename) {
 
         r = read_full_file(filename, &db, &db_len);
         if (r < 0) {
-                if (r == -ENOENT)
+                if (r == -ENOENT) {
+                        /* The device has not been processed by udevd (yet). Remember that, so that
+                         * later property or tag lookups on this object don't try to open the file
+                         * again. Like all other data, the db is only read once per object. */
+                        device->db_loaded = true;
                         return 0;
+                }
 
                 return log_device_debug_errno(device, r, "sd-device: Failed to read db '%s': %m", filename);
         }
@@ -1596,18 +1633,13 @@ static int device_sysattrs_read_all(sd_device *device) {
                 return r;
 
         FOREACH_DIRENT_ALL(dent, dir, return -errno) {
-                _cleanup_free_ char *path = NULL;
                 struct stat statbuf;
 
                 /* only handle symlinks and regular files */
                 if (!IN_SET(dent->d_type, DT_LNK, DT_REG))
                         continue;
 
-                path = path_join(syspath, dent->d_name);
-                if (!path)
-                        return -ENOMEM;
-
-                if (lstat(path, &statbuf) != 0)
+                if (fstatat(dirfd(dir), dent->d_name, &statbuf, AT_SYMLINK_NOFOLLOW) < 0)
                         continue;
 
                 if (!(statbuf.st_mode & S_IRUSR))
@@ -1799,7 +1831,9 @@ _public_ int sd_device_get_sysattr_value(sd_device *device, const char *sysattr,
         if (r < 0)
                 return r;
 
-        *_value = TAKE_PTR(value);
+        if (_value)
+                *_value = value;
+        TAKE_PTR(value);
 
         return 0;
 }
@@ -4,18 +4,29 @@
 #include "device-private.h"
 #include "device-util.h"
 #include "hashmap.h"
+#include "path-util.h"
 #include "string-util.h"
 #include "tests.h"
 #include "time-util.h"
 
 static void test_sd_device_one(sd_device *d) {
+        _cleanup_(sd_device_unrefp) sd_device *dev = NULL;
         const char *syspath, *subsystem, *val;
+        sd_device *parent;
         dev_t devnum;
         usec_t usec;
         int i, r;
 
         assert_se(sd_device_get_syspath(d, &syspath) >= 0);
 
+        /* Enumerated devices must have canonical syspaths, even if the symlinks were resolved manually */
+        r = sd_device_new_from_syspath(&dev, syspath);
+        assert_se(r >= 0 || r == -ENODEV);
+        if (r >= 0) {
+                assert_se(sd_device_get_syspath(dev, &val) >= 0);
+                assert_se(streq(syspath, val));
+        }
+
         r = sd_device_get_subsystem(d, &subsystem);
         assert_se(r >= 0 || r == -ENOENT);
 
@@ -51,6 +62,23 @@ static void test_sd_device_one(sd_device *d) {
         r = sd_device_get_sysattr_value(d, "name_assign_type", &val);
         assert_se(r >= 0 || IN_SET(r, -ENOENT, -EINVAL));
 
+        r = sd_device_get_sysattr_value(d, "uevent", NULL);
+        assert_se(r >= 0 || IN_SET(r, -ENOENT, -EACCES, -EPERM));
+
+        r = sd_device_get_parent(d, &parent);
+        assert_se(r >= 0 || r == -ENOENT);
+        if (r >= 0) {
+                _cleanup_(sd_device_unrefp) sd_device *verified = NULL;
+                const char *parent_syspath, *verified_syspath;
+
+                /* The parent looked up without canonicalization must match the canonicalized one */
+                assert_se(sd_device_get_syspath(parent, &parent_syspath) >= 0);
+                assert_se(path_startswith(syspath, parent_syspath));
+                assert_se(sd_device_new_from_syspath(&verified, parent_syspath) >= 0);
+                assert_se(sd_device_get_syspath(verified, &verified_syspath) >= 0);
+                assert_se(streq(parent_syspath, verified_syspath));
+        }
+
         r = sd_device_get_property_value(d, "ID_NET_DRIVER", &val);
         assert_se(r >= 0 || r == -ENOENT);
 
@@ -161,12 +189,48 @@ static void test_sd_device_enumerator_filter_subsystem(void) {
         assert_se(n_new_dev <= 10);
 }
 
+static unsigned n_evaluated = 0;
+
+static const char *evaluate(const char *s) {
+        n_evaluated++;
+        return s;
+}
+
+static void test_log_device_disabled(void) {
+        _cleanup_(sd_device_unrefp) sd_device *d = NULL;
+        char buf[FORMAT_TIMESPAN_MAX];
+        unsigned i, n = slow_tests_enabled() ? 10000000 : 100000;
+        usec_t start, t;
+
+        log_info("/* %s */", __func__);
+
+        if (sd_device_new_from_subsystem_sysname(&d, "net", "lo") < 0) {
+                log_info("Loopback device not found, skipping.");
+                return;
+        }
+
+        /* Debug messages are disabled, hence neither their arguments nor the device's name may be looked at */
+        assert_se(log_get_max_level() < LOG_DEBUG);
+
+        start = now(CLOCK_MONOTONIC);
+        for (i = 0; i < n; i++)
+                assert_se(log_device_debug_errno(d, SYNTHETIC_ERRNO(EINVAL), "%s", evaluate("foo")) == -EINVAL);
+        t = now(CLOCK_MONOTONIC) - start;
+
+        assert_se(n_evaluated == 0);
+        log_info("%u disabled debug messages in %s", n, format_timespan(buf, sizeof(buf), t, 1));
+
+        assert_se(log_device_info(d, "%s", evaluate("Enabled message")) == 0);
+        assert_se(n_evaluated == 1);
+}
+
 int main(int argc, char **argv) {
         test_setup_logging(LOG_INFO);
 
         test_sd_device_enumerator_devices();
         test_sd_device_enumerator_subsystems();
         test_sd_device_enumerator_filter_subsystem();
+        test_log_device_disabled();
 
         return 0;
 }
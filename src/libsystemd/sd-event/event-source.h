@@ -26,6 +26,8 @@ typedef enum EventSourceType {
         SOURCE_EXIT,
         SOURCE_WATCHDOG,
         SOURCE_INOTIFY,
+        SOURCE_WORK,
+        SOURCE_MEMORY_PRESSURE,
         _SOURCE_EVENT_SOURCE_TYPE_MAX,
         _SOURCE_EVENT_SOURCE_TYPE_INVALID = -1
 } EventSourceType;
@@ -34,7 +36,7 @@ typedef enum EventSourceType {
  * we know how to dispatch it */
 typedef enum WakeupType {
         WAKEUP_NONE,
-        WAKEUP_EVENT_SOURCE, /* either I/O or pidfd wakeup */
+        WAKEUP_EVENT_SOURCE, /* either I/O, pidfd, work queue or memory pressure wakeup */
         WAKEUP_CLOCK_DATA,
         WAKEUP_SIGNAL_DATA,
         WAKEUP_INOTIFY_DATA,
@@ -44,6 +46,17 @@ typedef enum WakeupType {
 
 struct inode_data;
 
+/* An item submitted to a work event source with sd_event_source_post_work() */
+typedef struct WorkItem WorkItem;
+struct WorkItem {
+        WorkItem *next;
+        void *data;
+};
+
+/* Bucket i of the dispatch latency histogram counts latencies in [4^(i-1), 4^i) µs, bucket 0 those below
+ * 1µs, and the last one everything above */
+#define EVENT_SOURCE_LATENCY_BUCKETS 16U
+
 struct sd_event_source {
         WakeupType wakeup;
 
@@ -69,6 +82,13 @@ struct sd_event_source {
 
         sd_event_destroy_t destroy_callback;
 
+        /* Dispatch statistics, see sd_event_source_get_statistics() */
+        uint64_t n_dispatched;
+        usec_t runtime;
+        usec_t runtime_max;
+        usec_t latency_max;
+        unsigned latency[EVENT_SOURCE_LATENCY_BUCKETS];
+
         LIST_FIELDS(sd_event_source, sources);
 
         union {
@@ -77,12 +97,22 @@ struct sd_event_source {
                         int fd;
                         uint32_t events;
                         uint32_t revents;
+                        /* What the kernel currently watches for, EPOLLONESHOT included, or 0 if an
+                         * EPOLLONESHOT registration fired */
+                        uint32_t registered_events;
                         bool registered:1;
                         bool owned:1;
+                        bool dirty:1; /* registration needs to be updated before the next epoll_wait() */
+                        LIST_FIELDS(sd_event_source, by_dirty);
                 } io;
                 struct {
                         sd_event_time_handler_t callback;
                         usec_t next, accuracy;
+                        /* The times the source is ordered by in the prioqs. When a source is moved to a
+                         * later time these are left alone, and only catch up once the source makes it to
+                         * the top of the prioq, see time_prioq_peek(). They hence may be earlier than
+                         * the actual times, but never later. */
+                        usec_t earliest_key, latest_key;
                         unsigned earliest_index;
                         unsigned latest_index;
                 } time;
@@ -119,6 +149,23 @@ struct sd_event_source {
                         struct inode_data *inode_data;
                         LIST_FIELDS(sd_event_source, by_inode_data);
                 } inotify;
+                struct {
+                        sd_event_work_handler_t callback;
+                        /* eventfd other threads wake us up through */
+                        int fd;
+                        /* Pushed to by other threads, newest item first, only accessed atomically */
+                        WorkItem *posted;
+                        /* Items taken over from 'posted' but not dispatched yet, oldest item first */
+                        WorkItem *queue;
+                } work;
+                struct {
+                        sd_event_handler_t callback;
+                        /* The PSI file the trigger is installed on, and the trigger itself */
+                        char *path;
+                        int fd;
+                        usec_t threshold_usec;
+                        usec_t window_usec;
+                } memory_pressure;
         };
 };
 
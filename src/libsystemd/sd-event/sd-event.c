@@ -1,6 +1,9 @@
 /* SPDX-License-Identifier: LGPL-2.1+ */
 
+#include <malloc.h>
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/prctl.h>
 #include <sys/timerfd.h>
 #include <sys/wait.h>
 
@@ -11,17 +14,21 @@
 #include "alloc-util.h"
 #include "env-util.h"
 #include "event-source.h"
+#include "event-util.h"
 #include "fd-util.h"
+#include "format-util.h"
 #include "fs-util.h"
 #include "hashmap.h"
 #include "list.h"
 #include "macro.h"
 #include "memory-util.h"
 #include "missing_syscall.h"
+#include "path-util.h"
 #include "prioq.h"
 #include "process-util.h"
 #include "set.h"
 #include "signal-util.h"
+#include "stdio-util.h"
 #include "string-table.h"
 #include "string-util.h"
 #include "strxcpyx.h"
@@ -29,6 +36,10 @@
 
 #define DEFAULT_ACCURACY_USEC (250 * USEC_PER_MSEC)
 
+/* Report memory pressure if tasks were stalled on memory for 200ms of any 2s window */
+#define DEFAULT_MEMORY_PRESSURE_THRESHOLD_USEC (200 * USEC_PER_MSEC)
+#define DEFAULT_MEMORY_PRESSURE_WINDOW_USEC (2 * USEC_PER_SEC)
+
 static bool EVENT_SOURCE_WATCH_PIDFD(sd_event_source *s) {
         /* Returns true if this is a PID event source and can be implemented by watching EPOLLIN */
         return s &&
@@ -51,6 +62,8 @@ static const char* const event_source_type_table[_SOURCE_EVENT_SOURCE_TYPE_MAX]
         [SOURCE_EXIT] = "exit",
         [SOURCE_WATCHDOG] = "watchdog",
         [SOURCE_INOTIFY] = "inotify",
+        [SOURCE_WORK] = "work",
+        [SOURCE_MEMORY_PRESSURE] = "memory-pressure",
 };
 
 DEFINE_PRIVATE_STRING_TABLE_LOOKUP_TO_STRING(event_source_type, int);
@@ -95,6 +108,9 @@ struct sd_event {
         /* A list of inotify objects that already have events buffered which aren't processed yet */
         LIST_HEAD(struct inotify_data, inotify_data_buffered);
 
+        /* A list of IO event sources whose epoll registration is to be updated before the next epoll_wait() */
+        LIST_HEAD(sd_event_source, io_dirty);
+
         pid_t original_pid;
 
         uint64_t iteration;
@@ -105,6 +121,7 @@ struct sd_event {
         bool need_process_child:1;
         bool watchdog:1;
         bool profile_delays:1;
+        bool fd_exported:1;
 
         int exit_code;
 
@@ -113,6 +130,12 @@ struct sd_event {
 
         usec_t watchdog_last, watchdog_period;
 
+        /* Unless the epoll fd is polled by somebody else, the CLOCK_MONOTONIC wakeup is implemented through
+         * the epoll_wait() timeout, rather than the timerfd. This is the time to wake up at, and the end of
+         * the accuracy window. */
+        usec_t wait_until, wait_latest;
+        usec_t timer_slack;
+
         unsigned n_sources;
 
         struct epoll_event *event_queue;
@@ -198,7 +221,7 @@ static int earliest_time_prioq_compare(const void *a, const void *b) {
                 return 1;
 
         /* Order by time */
-        return CMP(x->time.next, y->time.next);
+        return CMP(x->time.earliest_key, y->time.earliest_key);
 }
 
 static usec_t time_event_source_latest(const sd_event_source *s) {
@@ -224,7 +247,7 @@ static int latest_time_prioq_compare(const void *a, const void *b) {
                 return 1;
 
         /* Order by time */
-        return CMP(time_event_source_latest(x), time_event_source_latest(y));
+        return CMP(x->time.latest_key, y->time.latest_key);
 }
 
 static int exit_prioq_compare(const void *a, const void *b) {
@@ -324,6 +347,7 @@ _public_ int sd_event_new(sd_event** ret) {
                 .boottime_alarm.fd = -1,
                 .boottime_alarm.next = USEC_INFINITY,
                 .perturb = USEC_INFINITY,
+                .wait_until = USEC_INFINITY,
                 .original_pid = getpid_cached(),
         };
 
@@ -339,6 +363,10 @@ _public_ int sd_event_new(sd_event** ret) {
 
         e->epoll_fd = fd_move_above_stdio(e->epoll_fd);
 
+        /* The slack the kernel applies to our epoll_wait() timeouts, see event_arm_wait_timeout() */
+        r = prctl(PR_GET_TIMERSLACK);
+        e->timer_slack = r > 0 ? DIV_ROUND_UP((usec_t) r, NSEC_PER_USEC) : USEC_PER_MSEC;
+
         if (secure_getenv("SD_EVENT_PROFILE_DELAYS")) {
                 log_debug("Event loop profiling enabled. Logarithmic histogram of event loop iterations in the range 2^0 ... 2^63 us will be logged every 5s.");
                 e->profile_delays = true;
@@ -369,10 +397,23 @@ static bool event_pid_changed(sd_event *e) {
         return e->original_pid != getpid_cached();
 }
 
+static void source_io_clear_dirty(sd_event_source *s) {
+        assert(s);
+        assert(s->type == SOURCE_IO);
+
+        if (!s->io.dirty)
+                return;
+
+        LIST_REMOVE(io.by_dirty, s->event->io_dirty, s);
+        s->io.dirty = false;
+}
+
 static void source_io_unregister(sd_event_source *s) {
         assert(s);
         assert(s->type == SOURCE_IO);
 
+        source_io_clear_dirty(s);
+
         if (event_pid_changed(s->event))
                 return;
 
@@ -386,31 +427,44 @@ static void source_io_unregister(sd_event_source *s) {
         s->io.registered = false;
 }
 
+static uint32_t source_io_epoll_events(int enabled, uint32_t events) {
+        return events | (enabled == SD_EVENT_ONESHOT ? EPOLLONESHOT : 0);
+}
+
 static int source_io_register(
                 sd_event_source *s,
                 int enabled,
                 uint32_t events) {
 
         struct epoll_event ev;
-        int r;
 
         assert(s);
         assert(s->type == SOURCE_IO);
         assert(enabled != SD_EVENT_OFF);
 
+        /* Sources that are already in the epoll are only updated right before the next epoll_wait(), see
+         * event_flush_io_dirty(). sd-bus and varlink toggle EPOLLOUT all the time, and often end up where
+         * they started before we get to wait. Adding stays synchronous, so that callers learn about fds
+         * epoll doesn't support. */
+        if (s->io.registered) {
+                if (!s->io.dirty) {
+                        LIST_PREPEND(io.by_dirty, s->event->io_dirty, s);
+                        s->io.dirty = true;
+                }
+
+                return 0;
+        }
+
         ev = (struct epoll_event) {
-                .events = events | (enabled == SD_EVENT_ONESHOT ? EPOLLONESHOT : 0),
+                .events = source_io_epoll_events(enabled, events),
                 .data.ptr = s,
         };
 
-        if (s->io.registered)
-                r = epoll_ctl(s->event->epoll_fd, EPOLL_CTL_MOD, s->io.fd, &ev);
-        else
-                r = epoll_ctl(s->event->epoll_fd, EPOLL_CTL_ADD, s->io.fd, &ev);
-        if (r < 0)
+        if (epoll_ctl(s->event->epoll_fd, EPOLL_CTL_ADD, s->io.fd, &ev) < 0)
                 return -errno;
 
         s->io.registered = true;
+        s->io.registered_events = ev.events;
 
         return 0;
 }
@@ -533,6 +587,60 @@ static struct clock_data* event_get_clock_data(sd_event *e, EventSourceType t) {
         }
 }
 
+static void event_source_time_prioq_reshuffle(sd_event_source *s) {
+        struct clock_data *d;
+
+        assert(s);
+        assert(EVENT_SOURCE_IS_TIME(s->type));
+
+        /* Called whenever the time, accuracy, enabled or pending state of a time event source changed */
+
+        d = event_get_clock_data(s->event, s->type);
+        assert(d);
+
+        s->time.earliest_key = s->time.next;
+        s->time.latest_key = time_event_source_latest(s);
+
+        prioq_reshuffle(d->earliest, s, &s->time.earliest_index);
+        prioq_reshuffle(d->latest, s, &s->time.latest_index);
+        d->needs_rearm = true;
+}
+
+static sd_event_source* time_prioq_peek(Prioq *q, bool latest) {
+        sd_event_source *s;
+
+        /* Returns the top of the earliest or latest prioq, after bringing its key up to date. As the keys of
+         * all sources are never later than their actual times, a top entry whose key is current is the
+         * actual first one. */
+
+        for (;;) {
+                unsigned *idx;
+                usec_t *key, t;
+
+                s = prioq_peek(q);
+                if (!s)
+                        return NULL;
+
+                if (latest) {
+                        key = &s->time.latest_key;
+                        idx = &s->time.latest_index;
+                        t = time_event_source_latest(s);
+                } else {
+                        key = &s->time.earliest_key;
+                        idx = &s->time.earliest_index;
+                        t = s->time.next;
+                }
+
+                if (*key == t)
+                        return s;
+
+                assert(*key < t);
+
+                *key = t;
+                prioq_reshuffle(q, s, idx);
+        }
+}
+
 static void event_free_signal_data(sd_event *e, struct signal_data *d) {
         assert(e);
 
@@ -818,6 +926,18 @@ static void source_disconnect(sd_event_source *s) {
                 break;
         }
 
+        case SOURCE_WORK:
+                if (s->work.fd >= 0)
+                        (void) epoll_ctl(s->event->epoll_fd, EPOLL_CTL_DEL, s->work.fd, NULL);
+
+                break;
+
+        case SOURCE_MEMORY_PRESSURE:
+                if (s->memory_pressure.fd >= 0)
+                        (void) epoll_ctl(s->event->epoll_fd, EPOLL_CTL_DEL, s->memory_pressure.fd, NULL);
+
+                break;
+
         default:
                 assert_not_reached("Wut? I shouldn't exist.");
         }
@@ -841,6 +961,15 @@ static void source_disconnect(sd_event_source *s) {
                 sd_event_unref(event);
 }
 
+static void work_items_free(WorkItem *w) {
+        while (w) {
+                WorkItem *next = w->next;
+
+                free(w);
+                w = next;
+        }
+}
+
 static void source_free(sd_event_source *s) {
         assert(s);
 
@@ -887,6 +1016,18 @@ static void source_free(sd_event_source *s) {
                         s->child.pidfd = safe_close(s->child.pidfd);
         }
 
+        if (s->type == SOURCE_WORK) {
+                /* Nobody may post to the event source anymore at this point, hence no need to be careful */
+                work_items_free(s->work.queue);
+                work_items_free(s->work.posted);
+                s->work.fd = safe_close(s->work.fd);
+        }
+
+        if (s->type == SOURCE_MEMORY_PRESSURE) {
+                s->memory_pressure.fd = safe_close(s->memory_pressure.fd);
+                s->memory_pressure.path = mfree(s->memory_pressure.path);
+        }
+
         if (s->destroy_callback)
                 s->destroy_callback(s->userdata);
 
@@ -917,16 +1058,8 @@ static int source_set_pending(sd_event_source *s, bool b) {
         } else
                 assert_se(prioq_remove(s->event->pending, s, &s->pending_index));
 
-        if (EVENT_SOURCE_IS_TIME(s->type)) {
-                struct clock_data *d;
-
-                d = event_get_clock_data(s->event, s->type);
-                assert(d);
-
-                prioq_reshuffle(d->earliest, s, &s->time.earliest_index);
-                prioq_reshuffle(d->latest, s, &s->time.latest_index);
-                d->needs_rearm = true;
-        }
+        if (EVENT_SOURCE_IS_TIME(s->type))
+                event_source_time_prioq_reshuffle(s);
 
         if (s->type == SOURCE_SIGNAL && !b) {
                 struct signal_data *d;
@@ -1134,6 +1267,8 @@ _public_ int sd_event_add_time(
         s->time.next = usec;
         s->time.accuracy = accuracy == 0 ? DEFAULT_ACCURACY_USEC : accuracy;
         s->time.callback = callback;
+        s->time.earliest_key = s->time.next;
+        s->time.latest_key = time_event_source_latest(s);
         s->time.earliest_index = s->time.latest_index = PRIOQ_IDX_NULL;
         s->userdata = userdata;
         s->enabled = SD_EVENT_ONESHOT;
@@ -1521,6 +1656,152 @@ _public_ int sd_event_add_exit(
         return 0;
 }
 
+_public_ int sd_event_add_work(
+                sd_event *e,
+                sd_event_source **ret,
+                sd_event_work_handler_t callback,
+                void *userdata) {
+
+        _cleanup_(source_freep) sd_event_source *s = NULL;
+        struct epoll_event ev;
+
+        assert_return(e, -EINVAL);
+        assert_return(e = event_resolve(e), -ENOPKG);
+        assert_return(callback, -EINVAL);
+        assert_return(e->state != SD_EVENT_FINISHED, -ESTALE);
+        assert_return(!event_pid_changed(e), -ECHILD);
+
+        s = source_new(e, !ret, SOURCE_WORK);
+        if (!s)
+                return -ENOMEM;
+
+        s->wakeup = WAKEUP_EVENT_SOURCE;
+        s->work.callback = callback;
+        s->userdata = userdata;
+        s->enabled = SD_EVENT_ON;
+
+        s->work.fd = eventfd(0, EFD_CLOEXEC|EFD_NONBLOCK);
+        if (s->work.fd < 0)
+                return -errno;
+
+        ev = (struct epoll_event) {
+                .events = EPOLLIN,
+                .data.ptr = s,
+        };
+
+        if (epoll_ctl(e->epoll_fd, EPOLL_CTL_ADD, s->work.fd, &ev) < 0)
+                return -errno;
+
+        if (ret)
+                *ret = s;
+        TAKE_PTR(s);
+
+        return 0;
+}
+
+static int memory_pressure_install(sd_event_source *s) {
+        _cleanup_close_ int fd = -1;
+        char trigger[STRLEN("some ") + 2 * DECIMAL_STR_MAX(usec_t) + 2];
+        struct epoll_event ev;
+        int r;
+
+        assert(s);
+        assert(s->type == SOURCE_MEMORY_PRESSURE);
+
+        /* A PSI trigger can't be changed once it is written, hence every change of the period means a new
+         * file descriptor */
+
+        fd = open(s->memory_pressure.path, O_RDWR|O_CLOEXEC|O_NONBLOCK|O_NOCTTY);
+        if (fd < 0)
+                return errno == ENOENT ? -EOPNOTSUPP : -errno;
+
+        xsprintf(trigger, "some " USEC_FMT " " USEC_FMT, s->memory_pressure.threshold_usec, s->memory_pressure.window_usec);
+
+        /* The trailing NUL byte is part of the trigger */
+        if (write(fd, trigger, strlen(trigger) + 1) < 0)
+                return -errno;
+
+        ev = (struct epoll_event) {
+                .events = EPOLLPRI,
+                .data.ptr = s,
+        };
+
+        if (epoll_ctl(s->event->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0)
+                return -errno;
+
+        if (s->memory_pressure.fd >= 0) {
+                r = epoll_ctl(s->event->epoll_fd, EPOLL_CTL_DEL, s->memory_pressure.fd, NULL);
+                if (r < 0)
+                        log_debug_errno(errno, "Failed to remove old memory pressure fd from epoll, ignoring: %m");
+
+                safe_close(s->memory_pressure.fd);
+        }
+
+        s->memory_pressure.fd = TAKE_FD(fd);
+        return 0;
+}
+
+static int memory_pressure_callback(sd_event_source *s, void *userdata) {
+        assert(s);
+
+        sd_event_trim_memory();
+        return 0;
+}
+
+_public_ int sd_event_add_memory_pressure(
+                sd_event *e,
+                sd_event_source **ret,
+                sd_event_handler_t callback,
+                void *userdata) {
+
+        _cleanup_(source_freep) sd_event_source *s = NULL;
+        const char *path;
+        int r;
+
+        assert_return(e, -EINVAL);
+        assert_return(e = event_resolve(e), -ENOPKG);
+        assert_return(e->state != SD_EVENT_FINISHED, -ESTALE);
+        assert_return(!event_pid_changed(e), -ECHILD);
+
+        /* Without a handler of its own, the caller just wants to give memory back to the kernel */
+        if (!callback)
+                callback = memory_pressure_callback;
+
+        /* Watch the system-wide memory pressure by default, but let whoever started us point us to a
+         * different PSI file, for example the memory.pressure attribute of our cgroup */
+        path = secure_getenv("MEMORY_PRESSURE_WATCH");
+        if (isempty(path))
+                path = "/proc/pressure/memory";
+        else if (!path_is_absolute(path))
+                return -EINVAL;
+
+        s = source_new(e, !ret, SOURCE_MEMORY_PRESSURE);
+        if (!s)
+                return -ENOMEM;
+
+        s->wakeup = WAKEUP_EVENT_SOURCE;
+        s->memory_pressure.callback = callback;
+        s->memory_pressure.fd = -1;
+        s->memory_pressure.threshold_usec = DEFAULT_MEMORY_PRESSURE_THRESHOLD_USEC;
+        s->memory_pressure.window_usec = DEFAULT_MEMORY_PRESSURE_WINDOW_USEC;
+        s->userdata = userdata;
+        s->enabled = SD_EVENT_ON;
+
+        s->memory_pressure.path = strdup(path);
+        if (!s->memory_pressure.path)
+                return -ENOMEM;
+
+        r = memory_pressure_install(s);
+        if (r < 0)
+                return r;
+
+        if (ret)
+                *ret = s;
+        TAKE_PTR(s);
+
+        return 0;
+}
+
 static void event_free_inotify_data(sd_event *e, struct inotify_data *d) {
         assert(e);
 
@@ -1955,6 +2236,106 @@ _public_ int sd_event_source_get_pending(sd_event_source *s) {
         return s->pending;
 }
 
+_public_ int sd_event_source_get_statistics(
+                sd_event_source *s,
+                uint64_t *ret_n_dispatched,
+                uint64_t *ret_runtime_usec,
+                uint64_t *ret_runtime_max_usec,
+                uint64_t *ret_latency_max_usec) {
+
+        assert_return(s, -EINVAL);
+        assert_return(!event_pid_changed(s->event), -ECHILD);
+
+        if (ret_n_dispatched)
+                *ret_n_dispatched = s->n_dispatched;
+        if (ret_runtime_usec)
+                *ret_runtime_usec = s->runtime;
+        if (ret_runtime_max_usec)
+                *ret_runtime_max_usec = s->runtime_max;
+        if (ret_latency_max_usec)
+                *ret_latency_max_usec = s->latency_max;
+
+        return 0;
+}
+
+_public_ int sd_event_source_get_latency_histogram(sd_event_source *s, unsigned *ret_counts, size_t n) {
+        assert_return(s, -EINVAL);
+        assert_return(ret_counts || n == 0, -EINVAL);
+        assert_return(!event_pid_changed(s->event), -ECHILD);
+
+        n = MIN(n, (size_t) EVENT_SOURCE_LATENCY_BUCKETS);
+        memcpy_safe(ret_counts, s->latency, n * sizeof(unsigned));
+
+        return (int) n;
+}
+
+_public_ int sd_event_source_post_work(sd_event_source *s, void *data) {
+        WorkItem *w, *head;
+
+        /* This may be called from any thread, hence don't touch anything but the fields meant for that, and
+         * don't check which process we are in, as that would look at the event loop object. */
+
+        assert_return(s, -EINVAL);
+        assert_return(s->type == SOURCE_WORK, -EDOM);
+
+        w = new(WorkItem, 1);
+        if (!w)
+                return -ENOMEM;
+
+        *w = (WorkItem) {
+                .data = data,
+        };
+
+        head = __atomic_load_n(&s->work.posted, __ATOMIC_RELAXED);
+        do
+                w->next = head;
+        while (!__atomic_compare_exchange_n(&s->work.posted, &head, w, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+        /* Only the first item posted since the event loop last looked needs a wake-up. If the eventfd
+         * counter overflows the event loop has a wake-up pending anyway. */
+        if (!head) {
+                uint64_t one = 1;
+
+                if (write(s->work.fd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+                        return -errno;
+        }
+
+        return 0;
+}
+
+_public_ int sd_event_source_set_memory_pressure_period(sd_event_source *s, uint64_t threshold_usec, uint64_t window_usec) {
+        usec_t old_threshold, old_window;
+        int r;
+
+        assert_return(s, -EINVAL);
+        assert_return(s->type == SOURCE_MEMORY_PRESSURE, -EDOM);
+        assert_return(threshold_usec > 0, -ERANGE);
+        assert_return(threshold_usec <= window_usec, -ERANGE);
+        assert_return(window_usec < USEC_INFINITY, -ERANGE);
+        assert_return(s->event->state != SD_EVENT_FINISHED, -ESTALE);
+        assert_return(!event_pid_changed(s->event), -ECHILD);
+
+        if (s->memory_pressure.threshold_usec == threshold_usec &&
+            s->memory_pressure.window_usec == window_usec)
+                return 0;
+
+        old_threshold = s->memory_pressure.threshold_usec;
+        old_window = s->memory_pressure.window_usec;
+
+        s->memory_pressure.threshold_usec = threshold_usec;
+        s->memory_pressure.window_usec = window_usec;
+
+        r = memory_pressure_install(s);
+        if (r < 0) {
+                /* The old trigger is still in place */
+                s->memory_pressure.threshold_usec = old_threshold;
+                s->memory_pressure.window_usec = old_window;
+                return r;
+        }
+
+        return 0;
+}
+
 _public_ int sd_event_source_get_io_fd(sd_event_source *s) {
         assert_return(s, -EINVAL);
         assert_return(s->type == SOURCE_IO, -EDOM);
@@ -2229,18 +2610,10 @@ _public_ int sd_event_source_set_enabled(sd_event_source *s, int m) {
                 case SOURCE_TIME_BOOTTIME:
                 case SOURCE_TIME_MONOTONIC:
                 case SOURCE_TIME_REALTIME_ALARM:
-                case SOURCE_TIME_BOOTTIME_ALARM: {
-                        struct clock_data *d;
-
+                case SOURCE_TIME_BOOTTIME_ALARM:
                         s->enabled = m;
-                        d = event_get_clock_data(s->event, s->type);
-                        assert(d);
-
-                        prioq_reshuffle(d->earliest, s, &s->time.earliest_index);
-                        prioq_reshuffle(d->latest, s, &s->time.latest_index);
-                        d->needs_rearm = true;
+                        event_source_time_prioq_reshuffle(s);
                         break;
-                }
 
                 case SOURCE_SIGNAL:
                         s->enabled = m;
@@ -2269,6 +2642,8 @@ _public_ int sd_event_source_set_enabled(sd_event_source *s, int m) {
                 case SOURCE_DEFER:
                 case SOURCE_POST:
                 case SOURCE_INOTIFY:
+                case SOURCE_WORK:
+                case SOURCE_MEMORY_PRESSURE:
                         s->enabled = m;
                         break;
 
@@ -2299,18 +2674,10 @@ _public_ int sd_event_source_set_enabled(sd_event_source *s, int m) {
                 case SOURCE_TIME_BOOTTIME:
                 case SOURCE_TIME_MONOTONIC:
                 case SOURCE_TIME_REALTIME_ALARM:
-                case SOURCE_TIME_BOOTTIME_ALARM: {
-                        struct clock_data *d;
-
+                case SOURCE_TIME_BOOTTIME_ALARM:
                         s->enabled = m;
-                        d = event_get_clock_data(s->event, s->type);
-                        assert(d);
-
-                        prioq_reshuffle(d->earliest, s, &s->time.earliest_index);
-                        prioq_reshuffle(d->latest, s, &s->time.latest_index);
-                        d->needs_rearm = true;
+                        event_source_time_prioq_reshuffle(s);
                         break;
-                }
 
                 case SOURCE_SIGNAL:
 
@@ -2360,9 +2727,25 @@ _public_ int sd_event_source_set_enabled(sd_event_source *s, int m) {
                         prioq_reshuffle(s->event->exit, s, &s->exit.prioq_index);
                         break;
 
+                case SOURCE_WORK:
+                        s->enabled = m;
+
+                        /* Wake-ups while we were disabled were flushed without marking us pending, hence
+                         * check whether anything has been left for us. */
+                        if (s->work.queue || __atomic_load_n(&s->work.posted, __ATOMIC_ACQUIRE)) {
+                                r = source_set_pending(s, true);
+                                if (r < 0) {
+                                        s->enabled = SD_EVENT_OFF;
+                                        return r;
+                                }
+                        }
+
+                        break;
+
                 case SOURCE_DEFER:
                 case SOURCE_POST:
                 case SOURCE_INOTIFY:
+                case SOURCE_MEMORY_PRESSURE:
                         s->enabled = m;
                         break;
 
@@ -2405,12 +2788,16 @@ _public_ int sd_event_source_set_time(sd_event_source *s, uint64_t usec) {
 
         s->time.next = usec;
 
-        d = event_get_clock_data(s->event, s->type);
-        assert(d);
+        /* Timeouts are commonly pushed into the future again and again before they ever elapse, so let's not
+         * reorder the prioqs in that case. The prioqs are fixed up lazily if the source makes it to the top
+         * of them. */
+        if (s->time.next >= s->time.earliest_key && time_event_source_latest(s) >= s->time.latest_key) {
+                d = event_get_clock_data(s->event, s->type);
+                assert(d);
 
-        prioq_reshuffle(d->earliest, s, &s->time.earliest_index);
-        prioq_reshuffle(d->latest, s, &s->time.latest_index);
-        d->needs_rearm = true;
+                d->needs_rearm = true;
+        } else
+                event_source_time_prioq_reshuffle(s);
 
         return 0;
 }
@@ -2426,7 +2813,6 @@ _public_ int sd_event_source_get_time_accuracy(sd_event_source *s, uint64_t *use
 }
 
 _public_ int sd_event_source_set_time_accuracy(sd_event_source *s, uint64_t usec) {
-        struct clock_data *d;
         int r;
 
         assert_return(s, -EINVAL);
@@ -2444,11 +2830,7 @@ _public_ int sd_event_source_set_time_accuracy(sd_event_source *s, uint64_t usec
 
         s->time.accuracy = usec;
 
-        d = event_get_clock_data(s->event, s->type);
-        assert(d);
-
-        prioq_reshuffle(d->latest, s, &s->time.latest_index);
-        d->needs_rearm = true;
+        event_source_time_prioq_reshuffle(s);
 
         return 0;
 }
@@ -2704,14 +3086,50 @@ static usec_t sleep_between(sd_event *e, usec_t a, usec_t b) {
         return b;
 }
 
+static int clock_data_set_timerfd(struct clock_data *d, usec_t t) {
+        struct itimerspec its = {};
+
+        assert(d);
+
+        if (d->next == t)
+                return 0;
+
+        if (t == USEC_INFINITY) {
+                if (d->fd < 0)
+                        return 0;
+
+                /* disarm */
+        } else if (t == 0) {
+                /* We don' want to disarm here, just mean some time looooong ago. */
+                its.it_value.tv_sec = 0;
+                its.it_value.tv_nsec = 1;
+        } else
+                timespec_store(&its.it_value, t);
+
+        assert_se(d->fd >= 0);
+
+        if (timerfd_settime(d->fd, TFD_TIMER_ABSTIME, &its, NULL) < 0)
+                return -errno;
+
+        d->next = t;
+        return 0;
+}
+
+static bool event_monotonic_in_wait(sd_event *e, struct clock_data *d) {
+        assert(e);
+        assert(d);
+
+        /* If the epoll fd is polled by somebody else, they won't know about our timeout, hence all timers
+         * need to be timerfds then */
+        return d == &e->monotonic && !e->fd_exported;
+}
+
 static int event_arm_timer(
                 sd_event *e,
                 struct clock_data *d) {
 
-        struct itimerspec its = {};
         sd_event_source *a, *b;
         usec_t t;
-        int r;
 
         assert(e);
         assert(d);
@@ -2721,46 +3139,90 @@ static int event_arm_timer(
         else
                 d->needs_rearm = false;
 
-        a = prioq_peek(d->earliest);
+        a = time_prioq_peek(d->earliest, false);
         if (!a || a->enabled == SD_EVENT_OFF || a->time.next == USEC_INFINITY) {
+                if (event_monotonic_in_wait(e, d))
+                        e->wait_until = USEC_INFINITY;
 
-                if (d->fd < 0)
-                        return 0;
+                return clock_data_set_timerfd(d, USEC_INFINITY);
+        }
 
-                if (d->next == USEC_INFINITY)
-                        return 0;
+        b = time_prioq_peek(d->latest, true);
+        assert_se(b && b->enabled != SD_EVENT_OFF);
 
-                /* disarm */
-                r = timerfd_settime(d->fd, TFD_TIMER_ABSTIME, &its, NULL);
-                if (r < 0)
-                        return r;
+        t = sleep_between(e, a->time.next, time_event_source_latest(b));
 
-                d->next = USEC_INFINITY;
+        if (event_monotonic_in_wait(e, d)) {
+                /* The timerfd is armed, or not, in sd_event_wait(), see event_arm_wait_timeout() */
+                e->wait_until = t;
+                e->wait_latest = time_event_source_latest(b);
                 return 0;
         }
 
-        b = prioq_peek(d->latest);
-        assert_se(b && b->enabled != SD_EVENT_OFF);
+        return clock_data_set_timerfd(d, t);
+}
 
-        t = sleep_between(e, a->time.next, time_event_source_latest(b));
-        if (d->next == t)
-                return 0;
+static int event_arm_wait_timeout(sd_event *e, uint64_t *timeout) {
+        usec_t n, left, wakeup;
 
-        assert_se(d->fd >= 0);
+        assert(e);
+        assert(timeout);
 
-        if (t == 0) {
-                /* We don' want to disarm here, just mean some time looooong ago. */
-                its.it_value.tv_sec = 0;
-                its.it_value.tv_nsec = 1;
-        } else
-                timespec_store(&its.it_value, t);
+        if (e->wait_until == USEC_INFINITY)
+                return clock_data_set_timerfd(&e->monotonic, USEC_INFINITY);
 
-        r = timerfd_settime(d->fd, TFD_TIMER_ABSTIME, &its, NULL);
-        if (r < 0)
-                return -errno;
+        n = now(CLOCK_MONOTONIC);
+        left = usec_sub_unsigned(e->wait_until, n);
 
-        d->next = t;
-        return 0;
+        /* epoll_wait() takes milliseconds, and the kernel adds some slack to its timeout, 0.1% of it plus the
+         * timer slack of the thread. If we might end up waking up after the accuracy window that way, fall
+         * back to the timerfd, which fires on time. */
+        wakeup = usec_add(n, DIV_ROUND_UP(left, USEC_PER_MSEC) * USEC_PER_MSEC);
+        wakeup = usec_add(wakeup, usec_add(left / 1000, e->timer_slack));
+        if (wakeup > e->wait_latest)
+                return clock_data_set_timerfd(&e->monotonic, e->wait_until);
+
+        *timeout = MIN(*timeout, left);
+
+        return clock_data_set_timerfd(&e->monotonic, USEC_INFINITY);
+}
+
+static void event_flush_io_dirty(sd_event *e) {
+        sd_event_source *s;
+
+        assert(e);
+
+        while ((s = e->io_dirty)) {
+                struct epoll_event ev;
+
+                source_io_clear_dirty(s);
+
+                assert(s->io.registered);
+                assert(s->enabled != SD_EVENT_OFF);
+
+                ev = (struct epoll_event) {
+                        .events = source_io_epoll_events(s->enabled, s->io.events),
+                        .data.ptr = s,
+                };
+
+                /* Skip changes that were undone again, except for edge-triggered sources, where an update
+                 * resets the edge */
+                if (ev.events == s->io.registered_events && !(ev.events & EPOLLET))
+                        continue;
+
+                if (epoll_ctl(e->epoll_fd, EPOLL_CTL_MOD, s->io.fd, &ev) < 0) {
+                        /* We can't return this to the caller anymore, hence let the source deal with it
+                         * as if the fd failed. */
+                        log_debug_errno(errno, "Failed to update source %s (type %s) in epoll, marking it failed: %m",
+                                        strna(s->description), event_source_type_to_string(s->type));
+
+                        s->io.revents = EPOLLERR|EPOLLHUP;
+                        (void) source_set_pending(s, true);
+                        continue;
+                }
+
+                s->io.registered_events = ev.events;
+        }
 }
 
 static int process_io(sd_event *e, sd_event_source *s, uint32_t revents) {
@@ -2779,6 +3241,10 @@ static int process_io(sd_event *e, sd_event_source *s, uint32_t revents) {
         else
                 s->io.revents = revents;
 
+        /* The kernel disarmed a oneshot registration after reporting it */
+        if (s->io.registered_events & EPOLLONESHOT)
+                s->io.registered_events = 0;
+
         return source_set_pending(s, true);
 }
 
@@ -2820,20 +3286,17 @@ static int process_timer(
         assert(d);
 
         for (;;) {
-                s = prioq_peek(d->earliest);
+                s = time_prioq_peek(d->earliest, false);
                 if (!s ||
                     s->time.next > n ||
                     s->enabled == SD_EVENT_OFF ||
                     s->pending)
                         break;
 
+                /* This reorders the prioqs too */
                 r = source_set_pending(s, true);
                 if (r < 0)
                         return r;
-
-                prioq_reshuffle(d->earliest, s, &s->time.earliest_index);
-                prioq_reshuffle(d->latest, s, &s->time.latest_index);
-                d->needs_rearm = true;
         }
 
         return 0;
@@ -2912,6 +3375,42 @@ static int process_child(sd_event *e) {
         return 0;
 }
 
+static int process_work(sd_event *e, sd_event_source *s, uint32_t revents) {
+        uint64_t x;
+
+        assert(e);
+        assert(s);
+        assert(s->type == SOURCE_WORK);
+
+        /* Reset the eventfd before looking at the posted items, so that a wake-up for an item we don't see
+         * in this iteration anymore is never lost */
+        if (read(s->work.fd, &x, sizeof(x)) < 0 && !IN_SET(errno, EAGAIN, EINTR))
+                return -errno;
+
+        if (s->enabled == SD_EVENT_OFF)
+                return 0;
+
+        return source_set_pending(s, true);
+}
+
+static int process_memory_pressure(sd_event *e, sd_event_source *s, uint32_t revents) {
+        assert(e);
+        assert(s);
+        assert(s->type == SOURCE_MEMORY_PRESSURE);
+
+        /* The kernel reports each crossing of the threshold once per window, and resets the event when we
+         * see it, hence there's nothing to read or acknowledge. Events while we are disabled are lost, which
+         * is fine, as the pressure will be reported again if it persists. */
+
+        if (s->enabled == SD_EVENT_OFF)
+                return 0;
+
+        if (revents & EPOLLERR)
+                log_debug("Memory pressure file %s reported an error.", s->memory_pressure.path);
+
+        return source_set_pending(s, true);
+}
+
 static int process_pidfd(sd_event *e, sd_event_source *s, uint32_t revents) {
         assert(e);
         assert(s);
@@ -3155,8 +3654,63 @@ static int process_inotify(sd_event *e) {
         return done;
 }
 
+static int source_dispatch_work(sd_event_source *s) {
+        WorkItem *posted, *reversed = NULL, **tail;
+        int r = 0;
+
+        assert(s);
+        assert(s->type == SOURCE_WORK);
+
+        /* Take over everything posted so far, and append it to whatever is left over from the last
+         * dispatch in the order it was posted */
+        posted = __atomic_exchange_n(&s->work.posted, NULL, __ATOMIC_ACQUIRE);
+        while (posted) {
+                WorkItem *next = posted->next;
+
+                posted->next = reversed;
+                reversed = posted;
+                posted = next;
+        }
+
+        for (tail = &s->work.queue; *tail; tail = &(*tail)->next)
+                ;
+        *tail = reversed;
+
+        /* Invoke the callback for each item, until it fails, or the event source is disabled (which is
+         * also the case for oneshot sources after the first item) or unreferenced by it. Any left over
+         * items are dispatched once the event source is enabled again. */
+        while (s->work.queue) {
+                WorkItem *w = s->work.queue;
+                void *data = w->data;
+
+                s->work.queue = w->next;
+                free(w);
+
+                r = s->work.callback(s, data, s->userdata);
+                if (r < 0 || s->n_ref == 0 || s->enabled == SD_EVENT_OFF)
+                        break;
+        }
+
+        return r;
+}
+
+static void source_account_dispatch(sd_event_source *s, usec_t latency, usec_t runtime) {
+        unsigned b;
+
+        assert(s);
+
+        s->n_dispatched++;
+        s->runtime = usec_add(s->runtime, runtime);
+        s->runtime_max = MAX(s->runtime_max, runtime);
+        s->latency_max = MAX(s->latency_max, latency);
+
+        b = latency == 0 ? 0 : MIN(u64log2(latency) / 2 + 1, EVENT_SOURCE_LATENCY_BUCKETS - 1);
+        s->latency[b]++;
+}
+
 static int source_dispatch(sd_event_source *s) {
         EventSourceType saved_type;
+        usec_t start, latency;
         int r = 0;
 
         assert(s);
@@ -3195,6 +3749,14 @@ static int source_dispatch(sd_event_source *s) {
                         return r;
         }
 
+        /* The time the event loop woke up is our best guess for when the event happened. Exit sources are
+         * not dispatched because of a wakeup, hence don't count any latency for them. */
+        start = now(CLOCK_MONOTONIC);
+        if (s->type == SOURCE_EXIT || !triple_timestamp_is_set(&s->event->timestamp))
+                latency = 0;
+        else
+                latency = usec_sub_unsigned(start, s->event->timestamp.monotonic);
+
         s->dispatching = true;
 
         switch (s->type) {
@@ -3265,6 +3827,14 @@ static int source_dispatch(sd_event_source *s) {
                 break;
         }
 
+        case SOURCE_WORK:
+                r = source_dispatch_work(s);
+                break;
+
+        case SOURCE_MEMORY_PRESSURE:
+                r = s->memory_pressure.callback(s, s->userdata);
+                break;
+
         case SOURCE_WATCHDOG:
         case _SOURCE_EVENT_SOURCE_TYPE_MAX:
         case _SOURCE_EVENT_SOURCE_TYPE_INVALID:
@@ -3273,6 +3843,8 @@ static int source_dispatch(sd_event_source *s) {
 
         s->dispatching = false;
 
+        source_account_dispatch(s, latency, usec_sub_unsigned(now(CLOCK_MONOTONIC), start));
+
         if (r < 0)
                 log_debug_errno(r, "Event source %s (type %s) returned error, disabling: %m",
                                 strna(s->description), event_source_type_to_string(saved_type));
@@ -3465,6 +4037,9 @@ _public_ int sd_event_prepare(sd_event *e) {
 
         event_close_inode_data_fds(e);
 
+        /* After the prepare callbacks, as they are likely to change the IO events */
+        event_flush_io_dirty(e);
+
         if (event_next_pending(e) || e->need_process_child)
                 goto pending;
 
@@ -3504,6 +4079,10 @@ _public_ int sd_event_wait(sd_event *e, uint64_t timeout) {
         if (e->inotify_data_buffered)
                 timeout = 0;
 
+        r = event_arm_wait_timeout(e, &timeout);
+        if (r < 0)
+                goto finish;
+
         m = epoll_wait(e->epoll_fd, e->event_queue, event_queue_max,
                        timeout == (uint64_t) -1 ? -1 : (int) DIV_ROUND_UP(timeout, USEC_PER_MSEC));
         if (m < 0) {
@@ -3542,6 +4121,14 @@ _public_ int sd_event_wait(sd_event *e, uint64_t timeout) {
                                         r = process_pidfd(e, s, e->event_queue[i].events);
                                         break;
 
+                                case SOURCE_WORK:
+                                        r = process_work(e, s, e->event_queue[i].events);
+                                        break;
+
+                                case SOURCE_MEMORY_PRESSURE:
+                                        r = process_memory_pressure(e, s, e->event_queue[i].events);
+                                        break;
+
                                 default:
                                         assert_not_reached("Unexpected event source type");
                                 }
@@ -3735,6 +4322,13 @@ _public_ int sd_event_get_fd(sd_event *e) {
         assert_return(e = event_resolve(e), -ENOPKG);
         assert_return(!event_pid_changed(e), -ECHILD);
 
+        /* Whoever polls the fd needs to be woken up by CLOCK_MONOTONIC timers too */
+        if (!e->fd_exported) {
+                e->fd_exported = true;
+                e->wait_until = USEC_INFINITY;
+                e->monotonic.needs_rearm = true;
+        }
+
         return e->epoll_fd;
 }
 
@@ -3907,6 +4501,47 @@ _public_ int sd_event_get_iteration(sd_event *e, uint64_t *ret) {
         return 0;
 }
 
+_public_ int sd_event_trim_memory(void) {
+        char buf[FORMAT_BYTES_MAX];
+        size_t n;
+
+        /* Gives memory back to the kernel that we keep around for reuse: first the unused hashmap pools,
+         * then whatever malloc() can release from its arenas. Daemons call this after dropping their own
+         * caches. */
+
+        n = hashmap_trim_pools();
+        log_debug("Released %s of hashmap pools.", format_bytes(buf, sizeof(buf), n));
+
+        if (malloc_trim(0) > 0)
+                log_debug("Released memory from malloc() arenas.");
+
+        return 0;
+}
+
+void event_dump_statistics(sd_event *e, FILE *f, const char *prefix) {
+        sd_event_source *s;
+
+        assert(e);
+        assert(f);
+
+        LIST_FOREACH(sources, s, e->sources) {
+                char a[FORMAT_TIMESPAN_MAX], b[FORMAT_TIMESPAN_MAX], c[FORMAT_TIMESPAN_MAX];
+
+                if (s->n_dispatched == 0)
+                        continue;
+
+                fprintf(f,
+                        "%sEvent source %s (%s): dispatched %" PRIu64 " times, runtime %s, max %s, max latency %s\n",
+                        strempty(prefix),
+                        strna(s->description),
+                        strna(event_source_type_to_string(s->type)),
+                        s->n_dispatched,
+                        format_timespan(a, sizeof(a), s->runtime, 1),
+                        format_timespan(b, sizeof(b), s->runtime_max, 1),
+                        format_timespan(c, sizeof(c), s->latency_max, 1));
+        }
+}
+
 _public_ int sd_event_source_set_destroy_callback(sd_event_source *s, sd_event_destroy_t callback) {
         assert_return(s, -EINVAL);
 
@@ -1,11 +1,16 @@
 /* SPDX-License-Identifier: LGPL-2.1+ */
 
+#include <poll.h>
+#include <pthread.h>
 #include <sys/wait.h>
 
 #include "sd-event.h"
 
 #include "alloc-util.h"
+#include "event-source.h"
+#include "event-util.h"
 #include "fd-util.h"
+#include "fileio.h"
 #include "fs-util.h"
 #include "log.h"
 #include "macro.h"
@@ -590,6 +595,373 @@ static void test_pidfd(void) {
         sd_event_unref(e);
 }
 
+static uint32_t last_revents;
+static unsigned n_revents;
+
+static int revents_handler(sd_event_source *s, int fd, uint32_t revents, void *userdata) {
+        last_revents = revents;
+        n_revents++;
+        return 0;
+}
+
+static void test_io_events_update(void) {
+        _cleanup_close_pair_ int fds[2] = { -1, -1 };
+        sd_event_source *source = NULL;
+        sd_event *e = NULL;
+
+        log_info("/* %s */", __func__);
+
+        /* Updates of the watched events are applied right before waiting, check that the last one wins, and
+         * that changes that are undone again are not lost. */
+
+        assert_se(sd_event_new(&e) >= 0);
+        assert_se(socketpair(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC|SOCK_NONBLOCK, 0, fds) >= 0);
+        assert_se(write(fds[1], "x", 1) == 1);
+
+        assert_se(sd_event_add_io(e, &source, fds[0], EPOLLIN, revents_handler, NULL) >= 0);
+
+        assert_se(sd_event_source_set_io_events(source, EPOLLOUT) >= 0);
+        assert_se(sd_event_source_set_io_events(source, EPOLLIN) >= 0);
+        assert_se(sd_event_run(e, 0) > 0);
+        assert_se(n_revents == 1 && last_revents == EPOLLIN);
+
+        assert_se(sd_event_source_set_io_events(source, EPOLLIN|EPOLLOUT) >= 0);
+        assert_se(sd_event_source_set_io_events(source, EPOLLOUT) >= 0);
+        assert_se(sd_event_run(e, 0) > 0);
+        assert_se(n_revents == 2 && last_revents == EPOLLOUT);
+
+        /* Oneshot sources are disarmed by the kernel after firing, and must be rearmed even if nothing else
+         * changed */
+        assert_se(sd_event_source_set_io_events(source, EPOLLIN) >= 0);
+        assert_se(sd_event_source_set_enabled(source, SD_EVENT_ONESHOT) >= 0);
+        assert_se(sd_event_run(e, 0) > 0);
+        assert_se(n_revents == 3 && last_revents == EPOLLIN);
+        assert_se(sd_event_run(e, 0) == 0);
+
+        assert_se(sd_event_source_set_enabled(source, SD_EVENT_ONESHOT) >= 0);
+        assert_se(sd_event_run(e, 0) > 0);
+        assert_se(n_revents == 4 && last_revents == EPOLLIN);
+
+        /* Disabling drops a pending update */
+        assert_se(sd_event_source_set_enabled(source, SD_EVENT_ON) >= 0);
+        assert_se(sd_event_source_set_io_events(source, EPOLLOUT) >= 0);
+        assert_se(sd_event_source_set_enabled(source, SD_EVENT_OFF) >= 0);
+        assert_se(sd_event_run(e, 0) == 0);
+        assert_se(n_revents == 4);
+
+        sd_event_source_unref(source);
+        sd_event_unref(e);
+}
+
+static unsigned n_monotonic_dispatched;
+
+static int monotonic_handler(sd_event_source *s, uint64_t usec, void *userdata) {
+        assert_se(now(CLOCK_MONOTONIC) >= usec);
+
+        n_monotonic_dispatched++;
+        return 0;
+}
+
+static void test_time_monotonic(void) {
+        sd_event_source *x = NULL, *y = NULL, *z = NULL;
+        struct pollfd pollfd;
+        sd_event *e = NULL;
+        usec_t base;
+
+        log_info("/* %s */", __func__);
+
+        /* CLOCK_MONOTONIC timers are implemented through the epoll_wait() timeout where the accuracy window
+         * allows it, and through the timerfd otherwise */
+
+        assert_se(sd_event_new(&e) >= 0);
+        base = now(CLOCK_MONOTONIC);
+
+        assert_se(sd_event_add_time(e, &x, CLOCK_MONOTONIC, base + 20 * USEC_PER_MSEC, 1, monotonic_handler, NULL) >= 0);
+        assert_se(sd_event_add_time(e, &y, CLOCK_MONOTONIC, base + 30 * USEC_PER_MSEC, 50 * USEC_PER_MSEC, monotonic_handler, NULL) >= 0);
+        assert_se(sd_event_add_time(e, &z, CLOCK_MONOTONIC, base + 10 * USEC_PER_MSEC, 0, monotonic_handler, NULL) >= 0);
+
+        while (n_monotonic_dispatched < 3)
+                assert_se(sd_event_run(e, (uint64_t) -1) >= 0);
+
+        /* When the epoll fd is polled by somebody else, timers must make it readable */
+        assert_se(sd_event_source_set_time(x, now(CLOCK_MONOTONIC) + 20 * USEC_PER_MSEC) >= 0);
+        assert_se(sd_event_source_set_time_accuracy(x, 50 * USEC_PER_MSEC) >= 0);
+        assert_se(sd_event_source_set_enabled(x, SD_EVENT_ONESHOT) >= 0);
+
+        pollfd = (struct pollfd) {
+                .fd = sd_event_get_fd(e),
+                .events = POLLIN,
+        };
+        assert_se(pollfd.fd >= 0);
+
+        assert_se(sd_event_prepare(e) == 0);
+        assert_se(poll(&pollfd, 1, 10 * MSEC_PER_SEC) == 1);
+        assert_se(sd_event_wait(e, 0) > 0);
+        assert_se(sd_event_dispatch(e) > 0);
+        assert_se(n_monotonic_dispatched == 4);
+
+        sd_event_source_unref(x);
+        sd_event_source_unref(y);
+        sd_event_source_unref(z);
+        sd_event_unref(e);
+}
+
+#define N_RESCHEDULE 64U
+
+static sd_event_source *reschedule_sources[N_RESCHEDULE] = {};
+static bool reschedule_dispatched[N_RESCHEDULE] = {};
+static unsigned n_reschedule_dispatched;
+
+static int reschedule_handler(sd_event_source *s, uint64_t usec, void *userdata) {
+        unsigned i;
+
+        /* Sources must not be dispatched before they elapsed, and all sources that elapsed earlier must
+         * have been dispatched already, or be about to be, in the same iteration. */
+        assert_se(now(CLOCK_MONOTONIC) >= usec);
+
+        for (i = 0; i < N_RESCHEDULE; i++) {
+                uint64_t t;
+
+                if (reschedule_dispatched[i] || reschedule_sources[i] == s)
+                        continue;
+
+                assert_se(sd_event_source_get_time(reschedule_sources[i], &t) >= 0);
+                if (t < usec)
+                        assert_se(sd_event_source_get_pending(reschedule_sources[i]) > 0);
+        }
+
+        reschedule_dispatched[PTR_TO_UINT(userdata)] = true;
+
+        if (++n_reschedule_dispatched == N_RESCHEDULE)
+                assert_se(sd_event_exit(sd_event_source_get_event(s), 0) >= 0);
+
+        return 0;
+}
+
+static void test_time_reschedule(void) {
+        sd_event_source **sources = reschedule_sources;
+        sd_event *e = NULL;
+        usec_t base;
+        unsigned i;
+
+        log_info("/* %s */", __func__);
+
+        /* Moving sources to a later time doesn't reorder the prioqs right-away, check that the dispatch
+         * order is still right */
+
+        assert_se(sd_event_default(&e) >= 0);
+
+        base = now(CLOCK_MONOTONIC);
+
+        for (i = 0; i < N_RESCHEDULE; i++)
+                assert_se(sd_event_add_time(e, &sources[i], CLOCK_MONOTONIC, base + USEC_PER_HOUR + i, 1,
+                                            reschedule_handler, UINT_TO_PTR(i)) >= 0);
+
+        /* Earlier than before */
+        for (i = 0; i < N_RESCHEDULE; i++)
+                assert_se(sd_event_source_set_time(sources[i], base + 10 * USEC_PER_MSEC + (i * 37) % N_RESCHEDULE * 10) >= 0);
+
+        /* Later than before, in a different order, with some sources disabled in between */
+        for (i = 0; i < N_RESCHEDULE; i++) {
+                assert_se(sd_event_source_set_time(sources[i], base + 20 * USEC_PER_MSEC + (i * 23) % N_RESCHEDULE * 100) >= 0);
+
+                if (i % 5 == 0) {
+                        assert_se(sd_event_source_set_enabled(sources[i], SD_EVENT_OFF) >= 0);
+                        assert_se(sd_event_source_set_enabled(sources[i], SD_EVENT_ONESHOT) >= 0);
+                }
+        }
+
+        /* And a few later again, after pushing them even further */
+        for (i = 0; i < N_RESCHEDULE; i += 3) {
+                assert_se(sd_event_source_set_time(sources[i], base + USEC_PER_HOUR) >= 0);
+                assert_se(sd_event_source_set_time(sources[i], base + 30 * USEC_PER_MSEC + i) >= 0);
+        }
+
+        assert_se(sd_event_loop(e) >= 0);
+        assert_se(n_reschedule_dispatched == N_RESCHEDULE);
+
+        for (i = 0; i < N_RESCHEDULE; i++)
+                sd_event_source_unref(sources[i]);
+
+        sd_event_unref(e);
+}
+
+static int sleepy_handler(sd_event_source *s, void *userdata) {
+        usleep(10 * USEC_PER_MSEC);
+        return 0;
+}
+
+static void test_statistics(void) {
+        _cleanup_free_ char *dump = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        uint64_t n, runtime, runtime_max, latency_max;
+        unsigned histogram[EVENT_SOURCE_LATENCY_BUCKETS + 1] = {}, sum = 0;
+        sd_event_source *s = NULL;
+        sd_event *e = NULL;
+        size_t size;
+        int i, k;
+
+        log_info("/* %s */", __func__);
+
+        assert_se(sd_event_new(&e) >= 0);
+        assert_se(sd_event_add_defer(e, &s, sleepy_handler, NULL) >= 0);
+        assert_se(sd_event_source_set_description(s, "sleepy") >= 0);
+        assert_se(sd_event_source_set_enabled(s, SD_EVENT_ON) >= 0);
+
+        assert_se(sd_event_source_get_statistics(s, &n, &runtime, &runtime_max, &latency_max) >= 0);
+        assert_se(n == 0 && runtime == 0 && runtime_max == 0 && latency_max == 0);
+
+        for (i = 0; i < 3; i++)
+                assert_se(sd_event_run(e, 0) > 0);
+
+        assert_se(sd_event_source_get_statistics(s, &n, &runtime, &runtime_max, &latency_max) >= 0);
+        assert_se(n == 3);
+        assert_se(runtime >= 30 * USEC_PER_MSEC);
+        assert_se(runtime_max >= 10 * USEC_PER_MSEC && runtime_max <= runtime);
+
+        k = sd_event_source_get_latency_histogram(s, histogram, ELEMENTSOF(histogram));
+        assert_se(k == (int) EVENT_SOURCE_LATENCY_BUCKETS);
+        for (i = 0; i < k; i++)
+                sum += histogram[i];
+        assert_se(sum == 3);
+        assert_se(sd_event_source_get_latency_histogram(s, NULL, 0) == 0);
+
+        f = open_memstream_unlocked(&dump, &size);
+        assert_se(f);
+        event_dump_statistics(e, f, NULL);
+        assert_se(fflush_and_check(f) >= 0);
+        assert_se(strstr(dump, "Event source sleepy (defer): dispatched 3 times"));
+
+        sd_event_source_unref(s);
+        sd_event_unref(e);
+}
+
+#define WORK_THREADS 4U
+#define WORK_ITEMS 10000U
+
+static unsigned work_next[WORK_THREADS], n_work;
+
+static int work_handler(sd_event_source *s, void *data, void *userdata) {
+        unsigned thread, item;
+
+        /* Items are numbered from 1, and must arrive in the order each thread posted them */
+        thread = (PTR_TO_UINT(data) - 1) / WORK_ITEMS;
+        item = (PTR_TO_UINT(data) - 1) % WORK_ITEMS;
+
+        assert_se(thread < WORK_THREADS);
+        assert_se(item == work_next[thread]);
+
+        work_next[thread]++;
+        n_work++;
+
+        return 0;
+}
+
+struct work_thread_args {
+        sd_event_source *source;
+        unsigned index;
+};
+
+static void *work_thread(void *p) {
+        struct work_thread_args *args = p;
+        unsigned i;
+
+        for (i = 0; i < WORK_ITEMS; i++)
+                assert_se(sd_event_source_post_work(args->source, UINT_TO_PTR(args->index * WORK_ITEMS + i + 1)) >= 0);
+
+        return NULL;
+}
+
+static void test_work(void) {
+        struct work_thread_args args[WORK_THREADS];
+        pthread_t threads[WORK_THREADS];
+        sd_event_source *s = NULL;
+        sd_event *e = NULL;
+        unsigned i;
+
+        log_info("/* %s */", __func__);
+
+        assert_se(sd_event_new(&e) >= 0);
+        assert_se(sd_event_add_work(e, &s, work_handler, NULL) >= 0);
+
+        /* Nothing posted, nothing to do */
+        assert_se(sd_event_run(e, 0) == 0);
+
+        for (i = 0; i < WORK_THREADS; i++) {
+                args[i] = (struct work_thread_args) {
+                        .source = s,
+                        .index = i,
+                };
+
+                assert_se(pthread_create(threads + i, NULL, work_thread, args + i) == 0);
+        }
+
+        while (n_work < WORK_THREADS * WORK_ITEMS)
+                assert_se(sd_event_run(e, (uint64_t) -1) > 0);
+
+        for (i = 0; i < WORK_THREADS; i++)
+                assert_se(pthread_join(threads[i], NULL) == 0);
+
+        assert_se(sd_event_run(e, 0) == 0);
+
+        /* Items posted while the source is disabled are kept, and oneshot sources dispatch one at a time */
+        memzero(work_next, sizeof(work_next));
+        n_work = 0;
+
+        assert_se(sd_event_source_set_enabled(s, SD_EVENT_OFF) >= 0);
+        assert_se(sd_event_source_post_work(s, UINT_TO_PTR(1)) >= 0);
+        assert_se(sd_event_source_post_work(s, UINT_TO_PTR(2)) >= 0);
+        assert_se(sd_event_run(e, 0) == 0);
+        assert_se(n_work == 0);
+
+        assert_se(sd_event_source_set_enabled(s, SD_EVENT_ONESHOT) >= 0);
+        assert_se(sd_event_run(e, 0) > 0);
+        assert_se(n_work == 1);
+        assert_se(sd_event_run(e, 0) == 0);
+
+        assert_se(sd_event_source_set_enabled(s, SD_EVENT_ON) >= 0);
+        assert_se(sd_event_run(e, 0) > 0);
+        assert_se(n_work == 2);
+
+        /* Undispatched items are released with the source */
+        assert_se(sd_event_source_post_work(s, UINT_TO_PTR(3)) >= 0);
+
+        sd_event_source_unref(s);
+        sd_event_unref(e);
+}
+
+static int memory_pressure_handler(sd_event_source *s, void *userdata) {
+        return 0;
+}
+
+static void test_memory_pressure(void) {
+        sd_event_source *s = NULL;
+        sd_event *e = NULL;
+        int r;
+
+        log_info("/* %s */", __func__);
+
+        assert_se(sd_event_new(&e) >= 0);
+
+        r = sd_event_add_memory_pressure(e, &s, memory_pressure_handler, NULL);
+        if (IN_SET(r, -EOPNOTSUPP, -EPERM, -EACCES)) {
+                log_notice_errno(r, "Memory pressure notifications not available, skipping: %m");
+                sd_event_unref(e);
+                return;
+        }
+        assert_se(r >= 0);
+
+        assert_se(sd_event_source_set_memory_pressure_period(s, 100 * USEC_PER_MSEC, 2 * USEC_PER_SEC) >= 0);
+        assert_se(sd_event_source_set_memory_pressure_period(s, 0, 1 * USEC_PER_SEC) == -ERANGE);
+        assert_se(sd_event_source_set_memory_pressure_period(s, 2 * USEC_PER_SEC, 1 * USEC_PER_SEC) == -ERANGE);
+
+        /* Nothing to dispatch unless the system is actually short on memory */
+        assert_se(sd_event_run(e, 0) >= 0);
+
+        sd_event_source_unref(s);
+        sd_event_unref(e);
+}
+
 int main(int argc, char *argv[]) {
         test_setup_logging(LOG_INFO);
 
@@ -598,6 +970,12 @@ int main(int argc, char *argv[]) {
 
         test_sd_event_now();
         test_rtqueue();
+        test_time_reschedule();
+        test_io_events_update();
+        test_time_monotonic();
+        test_statistics();
+        test_work();
+        test_memory_pressure();
 
         test_inotify(100); /* should work without overflow */
         test_inotify(33000); /* should trigger a q overflow */
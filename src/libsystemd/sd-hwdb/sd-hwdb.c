@@ -35,8 +35,22 @@ struct sd_hwdb {
         OrderedHashmap *properties;
         Iterator properties_iterator;
         bool properties_modified;
+        char *properties_modalias;
+
+        /* modalias → HwdbCacheEntry, the results of earlier lookups */
+        Hashmap *cache;
 };
 
+/* Many devices share the same modalias, and callers tend to look up the same modalias several times in a
+ * row. Remember the matching value entries in the order they were added, so that repeated lookups don't have
+ * to search the trie again, which involves an fnmatch() for every glob in the matching subtrees. */
+#define HWDB_CACHE_MAX 1024U
+
+typedef struct HwdbCacheEntry {
+        size_t n_entries;
+        const struct trie_value_entry_f *entries[];
+} HwdbCacheEntry;
+
 struct linebuf {
         char bytes[LINE_MAX];
         size_t size;
@@ -367,6 +381,8 @@ static sd_hwdb *hwdb_free(sd_hwdb *hwdb) {
                 munmap((void *)hwdb->map, hwdb->st.st_size);
         safe_fclose(hwdb->f);
         ordered_hashmap_free(hwdb->properties);
+        free(hwdb->properties_modalias);
+        hashmap_free(hwdb->cache);
         return mfree(hwdb);
 }
 
@@ -396,14 +412,106 @@ bool hwdb_validate(sd_hwdb *hwdb) {
         return false;
 }
 
+static int cache_add(sd_hwdb *hwdb, const char *modalias) {
+        _cleanup_free_ HwdbCacheEntry *e = NULL;
+        _cleanup_free_ char *k = NULL;
+        const struct trie_value_entry_f *entry;
+        Iterator i;
+        size_t n;
+        int r;
+
+        assert(hwdb);
+        assert(modalias);
+
+        n = ordered_hashmap_size(hwdb->properties);
+        e = malloc(offsetof(HwdbCacheEntry, entries) + n * sizeof(e->entries[0]));
+        if (!e)
+                return -ENOMEM;
+
+        e->n_entries = 0;
+        ORDERED_HASHMAP_FOREACH(entry, hwdb->properties, i)
+                e->entries[e->n_entries++] = entry;
+
+        k = strdup(modalias);
+        if (!k)
+                return -ENOMEM;
+
+        r = hashmap_ensure_allocated(&hwdb->cache, &string_hash_ops_free_free);
+        if (r < 0)
+                return r;
+
+        /* Keep the cache bounded, the lookups are cheap enough to simply start over */
+        if (hashmap_size(hwdb->cache) >= HWDB_CACHE_MAX)
+                hashmap_clear(hwdb->cache);
+
+        r = hashmap_put(hwdb->cache, k, e);
+        if (r < 0)
+                return r;
+
+        TAKE_PTR(k);
+        TAKE_PTR(e);
+
+        return 0;
+}
+
+static int cache_replay(sd_hwdb *hwdb, const HwdbCacheEntry *e) {
+        size_t i;
+        int r;
+
+        assert(hwdb);
+        assert(e);
+
+        if (e->n_entries == 0)
+                return 0;
+
+        r = ordered_hashmap_ensure_allocated(&hwdb->properties, &string_hash_ops);
+        if (r < 0)
+                return r;
+
+        for (i = 0; i < e->n_entries; i++) {
+                r = ordered_hashmap_put(hwdb->properties, trie_string(hwdb, e->entries[i]->key_off) + 1, (void *) e->entries[i]);
+                if (r < 0)
+                        return r;
+        }
+
+        return 0;
+}
+
 static int properties_prepare(sd_hwdb *hwdb, const char *modalias) {
+        _cleanup_free_ char *m = NULL;
+        HwdbCacheEntry *e;
+        int r;
+
         assert(hwdb);
         assert(modalias);
 
+        /* The properties are still those of the same modalias, nothing to do */
+        if (streq_ptr(hwdb->properties_modalias, modalias))
+                return 0;
+
+        m = strdup(modalias);
+        if (!m)
+                return -ENOMEM;
+
         ordered_hashmap_clear(hwdb->properties);
         hwdb->properties_modified = true;
+        hwdb->properties_modalias = mfree(hwdb->properties_modalias);
+
+        e = hashmap_get(hwdb->cache, modalias);
+        if (e)
+                r = cache_replay(hwdb, e);
+        else {
+                r = trie_search_f(hwdb, modalias);
+                if (r >= 0)
+                        r = cache_add(hwdb, modalias);
+        }
+        if (r < 0) {
+                ordered_hashmap_clear(hwdb->properties);
+                return r;
+        }
 
-        return trie_search_f(hwdb, modalias);
+        hwdb->properties_modalias = TAKE_PTR(m);
+        return 0;
 }
 
 _public_ int sd_hwdb_get(sd_hwdb *hwdb, const char *modalias, const char *key, const char **_value) {
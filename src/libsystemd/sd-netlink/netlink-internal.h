@@ -13,8 +13,17 @@
 #define RTNL_DEFAULT_TIMEOUT ((usec_t) (25 * USEC_PER_SEC))
 
 #define RTNL_WQUEUE_MAX 1024
+/* Stay well below the default socket send buffer size, the kernel refuses larger datagrams */
+#define RTNL_WQUEUE_SIZE_MAX (32*1024)
 #define RTNL_RQUEUE_MAX 64*1024
 
+/* The kernel packs dump replies into datagrams as large as the largest receive buffer it has seen, up
+ * to 32K. Allocate that much right away, to make dumps take fewer system calls. */
+#define RTNL_RBUFFER_SIZE_MIN (32*1024)
+
+/* How often to ask again for a dump the kernel reported as inconsistent */
+#define RTNL_DUMP_ATTEMPTS_MAX 3U
+
 #define RTNL_CONTAINER_DEPTH 32
 
 struct reply_callback {
@@ -81,6 +90,13 @@ struct sd_netlink {
         struct nlmsghdr *rbuffer;
         size_t rbuffer_allocated;
 
+        /* Sealed messages queued while a batch is open, sent with a single sendmsg() */
+        sd_netlink_message **wqueue;
+        unsigned wqueue_size;
+        size_t wqueue_allocated;
+        size_t wqueue_bytes;
+        unsigned n_batch;
+
         bool processing:1;
 
         uint32_t serial;
@@ -126,6 +142,7 @@ struct sd_netlink_message {
         unsigned n_containers; /* number of containers */
         bool sealed:1;
         bool broadcast:1;
+        bool dump_interrupted:1; /* NLM_F_DUMP_INTR was set */
 
         sd_netlink_message *next; /* next in a chain of multi-part messages */
 };
@@ -140,6 +157,7 @@ int socket_bind(sd_netlink *nl);
 int socket_broadcast_group_ref(sd_netlink *nl, unsigned group);
 int socket_broadcast_group_unref(sd_netlink *nl, unsigned group);
 int socket_write_message(sd_netlink *nl, sd_netlink_message *m);
+int socket_writev_message(sd_netlink *nl, sd_netlink_message **m, size_t msgcount);
 int socket_read_message(sd_netlink *nl);
 
 int rtnl_rqueue_make_room(sd_netlink *rtnl);
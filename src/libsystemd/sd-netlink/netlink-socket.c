@@ -238,6 +238,50 @@ int socket_write_message(sd_netlink *nl, sd_netlink_message *m) {
         return k;
 }
 
+/* returns the number of bytes sent, or a negative error code */
+int socket_writev_message(sd_netlink *nl, sd_netlink_message **m, size_t msgcount) {
+        union {
+                struct sockaddr sa;
+                struct sockaddr_nl nl;
+        } addr = {
+                .nl.nl_family = AF_NETLINK,
+        };
+        struct msghdr mh = {
+                .msg_name = &addr.sa,
+                .msg_namelen = sizeof(addr.nl),
+        };
+        _cleanup_free_ struct iovec *iovs = NULL;
+        ssize_t k;
+        size_t i;
+
+        assert(nl);
+        assert(m);
+        assert(msgcount > 0);
+
+        /* The kernel processes all netlink messages contained in a single datagram one after another, and
+         * acknowledges each of them individually, hence several requests may be sent at once. */
+
+        iovs = new(struct iovec, msgcount);
+        if (!iovs)
+                return -ENOMEM;
+
+        for (i = 0; i < msgcount; i++) {
+                assert(m[i]->hdr);
+                assert(m[i]->hdr->nlmsg_len > 0);
+
+                iovs[i] = IOVEC_MAKE(m[i]->hdr, m[i]->hdr->nlmsg_len);
+        }
+
+        mh.msg_iov = iovs;
+        mh.msg_iovlen = msgcount;
+
+        k = sendmsg(nl->fd, &mh, 0);
+        if (k < 0)
+                return -errno;
+
+        return k;
+}
+
 static int socket_recv_message(int fd, struct iovec *iov, uint32_t *_group, bool peek) {
         union sockaddr_union sender;
         uint8_t cmsg_buffer[CMSG_SPACE(sizeof(struct nl_pktinfo))];
@@ -307,7 +351,7 @@ int socket_read_message(sd_netlink *rtnl) {
         _cleanup_(sd_netlink_message_unrefp) sd_netlink_message *first = NULL;
         struct iovec iov = {};
         uint32_t group = 0;
-        bool multi_part = false, done = false;
+        bool multi_part = false, done = false, dump_interrupted = false;
         struct nlmsghdr *new_msg;
         size_t len;
         int r;
@@ -367,6 +411,11 @@ int socket_read_message(sd_netlink *rtnl) {
                         /* silently drop noop messages */
                         continue;
 
+                /* The kernel sets this on the messages of a dump, including NLMSG_DONE, once it notices
+                 * that the dumped table changed in the meantime */
+                if (new_msg->nlmsg_flags & NLM_F_DUMP_INTR)
+                        dump_interrupted = true;
+
                 if (new_msg->nlmsg_type == NLMSG_DONE) {
                         /* finished reading multi-part message */
                         done = true;
@@ -419,6 +468,9 @@ int socket_read_message(sd_netlink *rtnl) {
         if (!first)
                 return 0;
 
+        if (dump_interrupted)
+                first->dump_interrupted = true;
+
         if (!multi_part || done) {
                 /* we got a complete message, push it on the read queue */
                 r = rtnl_rqueue_make_room(rtnl);
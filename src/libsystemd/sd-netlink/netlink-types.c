@@ -745,6 +745,15 @@ static const NLTypeSystem rtnl_nexthop_type_system = {
        .types = rtnl_nexthop_types,
 };
 
+static const NLType rtnl_stats_types[] = {
+        [IFLA_STATS_LINK_64]      = { .size = sizeof(struct rtnl_link_stats64) },
+};
+
+static const NLTypeSystem rtnl_stats_type_system = {
+       .count = ELEMENTSOF(rtnl_stats_types),
+       .types = rtnl_stats_types,
+};
+
 static const NLType rtnl_tca_option_data_fq_types[] = {
         [TCA_FQ_PLIMIT]             = { .type = NETLINK_TYPE_U32 },
         [TCA_FQ_FLOW_PLIMIT]        = { .type = NETLINK_TYPE_U32 },
@@ -860,6 +869,8 @@ static const NLType rtnl_types[] = {
         [RTM_NEWQDISC]     = { .type = NETLINK_TYPE_NESTED, .type_system = &rtnl_qdisc_type_system, .size = sizeof(struct tcmsg) },
         [RTM_DELQDISC]     = { .type = NETLINK_TYPE_NESTED, .type_system = &rtnl_qdisc_type_system, .size = sizeof(struct tcmsg) },
         [RTM_GETQDISC]     = { .type = NETLINK_TYPE_NESTED, .type_system = &rtnl_qdisc_type_system, .size = sizeof(struct tcmsg) },
+        [RTM_NEWSTATS]     = { .type = NETLINK_TYPE_NESTED, .type_system = &rtnl_stats_type_system, .size = sizeof(struct if_stats_msg) },
+        [RTM_GETSTATS]     = { .type = NETLINK_TYPE_NESTED, .type_system = &rtnl_stats_type_system, .size = sizeof(struct if_stats_msg) },
 };
 
 const NLTypeSystem rtnl_type_system_root = {
@@ -41,8 +41,9 @@ static int sd_netlink_new(sd_netlink **ret) {
 
         /* We guarantee that the read buffer has at least space for
          * a message header */
+        assert_cc(RTNL_RBUFFER_SIZE_MIN >= sizeof(struct nlmsghdr));
         if (!greedy_realloc((void**)&rtnl->rbuffer, &rtnl->rbuffer_allocated,
-                            sizeof(struct nlmsghdr), sizeof(uint8_t)))
+                            RTNL_RBUFFER_SIZE_MIN, sizeof(uint8_t)))
                 return -ENOMEM;
 
         *ret = TAKE_PTR(rtnl);
@@ -167,6 +168,10 @@ static sd_netlink *netlink_free(sd_netlink *rtnl) {
 
         free(rtnl->rbuffer);
 
+        for (i = 0; i < rtnl->wqueue_size; i++)
+                sd_netlink_message_unref(rtnl->wqueue[i]);
+        free(rtnl->wqueue);
+
         while ((s = rtnl->slots)) {
                 assert(s->floating);
                 netlink_slot_disconnect(s, true);
@@ -204,6 +209,76 @@ static void rtnl_seal_message(sd_netlink *rtnl, sd_netlink_message *m) {
         return;
 }
 
+static int rtnl_flush_wqueue(sd_netlink *nl) {
+        unsigned i, n;
+        int r;
+
+        assert(nl);
+
+        if (nl->wqueue_size == 0)
+                return 0;
+
+        r = socket_writev_message(nl, nl->wqueue, nl->wqueue_size);
+
+        /* On failure the replies to the queued messages will never arrive, and their callbacks will be
+         * called with a timeout eventually. */
+        n = nl->wqueue_size;
+        for (i = 0; i < n; i++)
+                sd_netlink_message_unref(nl->wqueue[i]);
+        nl->wqueue_size = 0;
+        nl->wqueue_bytes = 0;
+
+        if (r < 0)
+                return log_debug_errno(r, "rtnl: failed to send %u queued messages: %m", n);
+
+        return 0;
+}
+
+static int rtnl_wqueue_push(sd_netlink *nl, sd_netlink_message *m) {
+        int r;
+
+        assert(nl);
+        assert(m);
+
+        if (nl->wqueue_size >= RTNL_WQUEUE_MAX ||
+            nl->wqueue_bytes + m->hdr->nlmsg_len > RTNL_WQUEUE_SIZE_MAX) {
+                r = rtnl_flush_wqueue(nl);
+                if (r < 0)
+                        return r;
+        }
+
+        if (!GREEDY_REALLOC(nl->wqueue, nl->wqueue_allocated, nl->wqueue_size + 1))
+                return -ENOMEM;
+
+        nl->wqueue[nl->wqueue_size++] = sd_netlink_message_ref(m);
+        nl->wqueue_bytes += m->hdr->nlmsg_len;
+
+        return 0;
+}
+
+int sd_netlink_batch_begin(sd_netlink *nl) {
+        assert_return(nl, -EINVAL);
+        assert_return(!rtnl_pid_changed(nl), -ECHILD);
+
+        /* Until the matching sd_netlink_batch_end(), messages are not sent individually but queued, and
+         * then passed to the kernel in as few datagrams as possible. Batches may be nested. */
+
+        nl->n_batch++;
+
+        return 0;
+}
+
+int sd_netlink_batch_end(sd_netlink *nl) {
+        assert_return(nl, -EINVAL);
+        assert_return(!rtnl_pid_changed(nl), -ECHILD);
+        assert_return(nl->n_batch > 0, -EPERM);
+
+        if (--nl->n_batch > 0)
+                return 0;
+
+        return rtnl_flush_wqueue(nl);
+}
+
 int sd_netlink_send(sd_netlink *nl,
                     sd_netlink_message *message,
                     uint32_t *serial) {
@@ -216,7 +291,10 @@ int sd_netlink_send(sd_netlink *nl,
 
         rtnl_seal_message(nl, message);
 
-        r = socket_write_message(nl, message);
+        if (nl->n_batch > 0)
+                r = rtnl_wqueue_push(nl, message);
+        else
+                r = socket_write_message(nl, message);
         if (r < 0)
                 return r;
 
@@ -591,19 +669,21 @@ int sd_netlink_call_async(
         return k;
 }
 
-int sd_netlink_call(sd_netlink *rtnl,
-                sd_netlink_message *message,
+int sd_netlink_read(sd_netlink *rtnl,
+                uint32_t serial,
                 uint64_t usec,
                 sd_netlink_message **ret) {
         usec_t timeout;
-        uint32_t serial;
         int r;
 
         assert_return(rtnl, -EINVAL);
         assert_return(!rtnl_pid_changed(rtnl), -ECHILD);
-        assert_return(message, -EINVAL);
 
-        r = sd_netlink_send(rtnl, message, &serial);
+        /* Waits for the reply to a message previously passed to sd_netlink_send(). This allows sending
+         * several requests first and collecting their replies afterwards, paying for a single round trip. */
+
+        /* We are going to wait for the reply, hence make sure the message is actually sent */
+        r = rtnl_flush_wqueue(rtnl);
         if (r < 0)
                 return r;
 
@@ -638,7 +718,8 @@ int sd_netlink_call(sd_netlink *rtnl,
                                         return r;
 
                                 if (type == NLMSG_DONE) {
-                                        *ret = NULL;
+                                        if (ret)
+                                                *ret = NULL;
                                         return 0;
                                 }
 
@@ -675,6 +756,69 @@ int sd_netlink_call(sd_netlink *rtnl,
         }
 }
 
+static int netlink_call_once(sd_netlink *rtnl,
+                sd_netlink_message *message,
+                uint64_t usec,
+                sd_netlink_message **ret) {
+        uint32_t serial;
+        int r;
+
+        assert_return(rtnl, -EINVAL);
+        assert_return(!rtnl_pid_changed(rtnl), -ECHILD);
+        assert_return(message, -EINVAL);
+
+        r = sd_netlink_send(rtnl, message, &serial);
+        if (r < 0)
+                return r;
+
+        return sd_netlink_read(rtnl, serial, usec, ret);
+}
+
+static bool rtnl_message_dump_interrupted(sd_netlink_message *m) {
+        for (; m; m = m->next)
+                if (m->dump_interrupted)
+                        return true;
+
+        return false;
+}
+
+int sd_netlink_call(sd_netlink *rtnl,
+                sd_netlink_message *message,
+                uint64_t usec,
+                sd_netlink_message **ret) {
+        unsigned n_attempts = 0;
+        int r;
+
+        assert_return(rtnl, -EINVAL);
+        assert_return(!rtnl_pid_changed(rtnl), -ECHILD);
+        assert_return(message, -EINVAL);
+
+        for (;;) {
+                _cleanup_(sd_netlink_message_unrefp) sd_netlink_message *reply = NULL;
+
+                r = netlink_call_once(rtnl, message, usec, &reply);
+                if (r <= 0) {
+                        if (ret)
+                                *ret = NULL;
+                        return r;
+                }
+
+                /* The object table changed while the kernel was dumping it, hence the reply might be
+                 * inconsistent. Ask again, rather than leaving it to the caller to notice. */
+                if (rtnl_message_dump_interrupted(reply) && ++n_attempts < RTNL_DUMP_ATTEMPTS_MAX) {
+                        log_debug("sd-netlink: dump was interrupted, requesting it again.");
+
+                        message->sealed = false;
+                        continue;
+                }
+
+                if (ret)
+                        *ret = TAKE_PTR(reply);
+
+                return r;
+        }
+}
+
 int sd_netlink_get_events(const sd_netlink *rtnl) {
         assert_return(rtnl, -EINVAL);
         assert_return(!rtnl_pid_changed(rtnl), -ECHILD);
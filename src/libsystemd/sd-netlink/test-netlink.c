@@ -423,6 +423,73 @@ static void test_pipe(int ifindex) {
         assert_se((rtnl = sd_netlink_unref(rtnl)) == NULL);
 }
 
+static void test_batch(int ifindex) {
+        _cleanup_(sd_netlink_unrefp) sd_netlink *rtnl = NULL;
+        int counter = 0;
+        unsigned i;
+
+        assert_se(sd_netlink_open(&rtnl) >= 0);
+
+        assert_se(sd_netlink_batch_end(rtnl) == -EPERM);
+
+        assert_se(sd_netlink_batch_begin(rtnl) >= 0);
+        assert_se(sd_netlink_batch_begin(rtnl) >= 0);
+
+        for (i = 0; i < 3; i++) {
+                _cleanup_(sd_netlink_message_unrefp) sd_netlink_message *m = NULL;
+
+                assert_se(sd_rtnl_message_new_link(rtnl, &m, RTM_GETLINK, ifindex) >= 0);
+
+                counter++;
+                assert_se(sd_netlink_call_async(rtnl, NULL, m, pipe_handler, NULL, &counter, 0, NULL) >= 0);
+        }
+
+        /* Nothing is sent before the outermost batch is closed */
+        assert_se(sd_netlink_batch_end(rtnl) >= 0);
+        assert_se(sd_netlink_wait(rtnl, 0) == 0);
+        assert_se(counter == 3);
+
+        assert_se(sd_netlink_batch_end(rtnl) >= 0);
+
+        while (counter > 0) {
+                assert_se(sd_netlink_wait(rtnl, 0) >= 0);
+                assert_se(sd_netlink_process(rtnl, NULL) >= 0);
+        }
+
+        assert_se((rtnl = sd_netlink_unref(rtnl)) == NULL);
+}
+
+static void test_read(int ifindex) {
+        _cleanup_(sd_netlink_unrefp) sd_netlink *rtnl = NULL;
+        uint32_t serials[3];
+        unsigned i;
+
+        assert_se(sd_netlink_open(&rtnl) >= 0);
+
+        assert_se(sd_netlink_batch_begin(rtnl) >= 0);
+
+        for (i = 0; i < ELEMENTSOF(serials); i++) {
+                _cleanup_(sd_netlink_message_unrefp) sd_netlink_message *m = NULL;
+
+                assert_se(sd_rtnl_message_new_link(rtnl, &m, RTM_GETLINK, ifindex) >= 0);
+                assert_se(sd_netlink_send(rtnl, m, serials + i) >= 0);
+        }
+
+        assert_se(sd_netlink_batch_end(rtnl) >= 0);
+
+        /* Replies may be collected in any order */
+        for (i = ELEMENTSOF(serials); i > 0; i--) {
+                _cleanup_(sd_netlink_message_unrefp) sd_netlink_message *r = NULL;
+                uint16_t type;
+
+                assert_se(sd_netlink_read(rtnl, serials[i - 1], 0, &r) > 0);
+                assert_se(sd_netlink_message_get_type(r, &type) >= 0);
+                assert_se(type == RTM_NEWLINK);
+        }
+
+        assert_se((rtnl = sd_netlink_unref(rtnl)) == NULL);
+}
+
 static void test_container(sd_netlink *rtnl) {
         _cleanup_(sd_netlink_message_unrefp) sd_netlink_message *m = NULL;
         uint16_t u16_data;
@@ -607,6 +674,8 @@ int main(void) {
         test_slot_set(if_loopback);
         test_async_destroy_callback(if_loopback);
         test_pipe(if_loopback);
+        test_batch(if_loopback);
+        test_read(if_loopback);
         test_event_loop(if_loopback);
         test_link_configure(rtnl, if_loopback);
 
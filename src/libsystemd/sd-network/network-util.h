@@ -4,9 +4,12 @@
 #include "sd-network.h"
 
 #include "macro.h"
+#include "set.h"
 
 bool network_is_online(void);
 
+int network_monitor_flush_links(sd_network_monitor *m, Set **changed);
+
 typedef enum LinkOperationalState {
         LINK_OPERSTATE_OFF,
         LINK_OPERSTATE_NO_CARRIER,
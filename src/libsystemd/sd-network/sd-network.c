@@ -11,6 +11,7 @@
 #include "fd-util.h"
 #include "fs-util.h"
 #include "macro.h"
+#include "network-util.h"
 #include "parse-util.h"
 #include "stdio-util.h"
 #include "string-util.h"
@@ -393,13 +394,18 @@ _public_ sd_network_monitor* sd_network_monitor_unref(sd_network_monitor *m) {
         return NULL;
 }
 
-_public_ int sd_network_monitor_flush(sd_network_monitor *m) {
+int network_monitor_flush_links(sd_network_monitor *m, Set **changed) {
         union inotify_event_buffer buffer;
         struct inotify_event *e;
+        bool rescan = false;
         ssize_t l;
         int fd, k;
 
-        assert_return(m, -EINVAL);
+        /* Like sd_network_monitor_flush(), but also collects the indexes of the links whose state files
+         * were replaced or removed into 'changed'. Returns > 0 if that information is incomplete, i.e.
+         * the links directory just appeared or events were lost, and all links need to be looked at. */
+
+        assert(m);
 
         fd = MONITOR_TO_FD(m);
 
@@ -412,6 +418,13 @@ _public_ int sd_network_monitor_flush(sd_network_monitor *m) {
         }
 
         FOREACH_INOTIFY_EVENT(e, buffer, l) {
+                int ifindex;
+
+                if (e->mask & IN_Q_OVERFLOW) {
+                        rescan = true;
+                        continue;
+                }
+
                 if (e->mask & IN_ISDIR) {
                         k = monitor_add_inotify_watch(fd);
                         if (k < 0)
@@ -420,9 +433,38 @@ _public_ int sd_network_monitor_flush(sd_network_monitor *m) {
                         k = inotify_rm_watch(fd, e->wd);
                         if (k < 0)
                                 return -errno;
+
+                        rescan = true;
+                        continue;
                 }
+
+                if (!changed || rescan || e->len <= 0)
+                        continue;
+
+                if (parse_ifindex(e->name, &ifindex) < 0)
+                        continue;
+
+                k = set_ensure_allocated(changed, NULL);
+                if (k < 0)
+                        return k;
+
+                k = set_put(*changed, INT_TO_PTR(ifindex));
+                if (k < 0)
+                        return k;
         }
 
+        return rescan;
+}
+
+_public_ int sd_network_monitor_flush(sd_network_monitor *m) {
+        int r;
+
+        assert_return(m, -EINVAL);
+
+        r = network_monitor_flush_links(m, NULL);
+        if (r < 0)
+                return r;
+
         return 0;
 }
 
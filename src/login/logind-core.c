@@ -184,9 +184,19 @@ int manager_add_user_by_name(
 
 int manager_add_user_by_uid(Manager *m, uid_t uid, User **ret_user) {
         struct passwd *p;
+        User *u;
 
         assert(m);
 
+        /* manager_add_user() wouldn't use the record for a known user anyway, hence don't bother NSS (which
+         * might mean a network roundtrip) for every further session of a user. */
+        u = hashmap_get(m->users, UID_TO_PTR(uid));
+        if (u) {
+                if (ret_user)
+                        *ret_user = u;
+                return 0;
+        }
+
         errno = 0;
         p = getpwuid(uid);
         if (!p)
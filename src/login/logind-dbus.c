@@ -3458,10 +3458,12 @@ int match_job_removed(sd_bus_message *message, void *userdata, sd_bus_error *err
         if (session) {
                 if (streq_ptr(path, session->scope_job)) {
                         session->scope_job = mfree(session->scope_job);
-                        (void) session_jobs_reply(session, unit, result);
 
-                        session_save(session);
-                        user_save(session->user);
+                        /* Queue before replying, so that the files are written once, right before the reply */
+                        session_add_to_save_queue(session);
+                        user_add_to_save_queue(session->user);
+
+                        (void) session_jobs_reply(session, unit, result);
                 }
 
                 session_add_to_gc_queue(session);
@@ -3475,7 +3477,7 @@ int match_job_removed(sd_bus_message *message, void *userdata, sd_bus_error *err
                         LIST_FOREACH(sessions_by_user, session, user->sessions)
                                 (void) session_jobs_reply(session, unit, NULL /* don't propagate user service failures to the client */);
 
-                        user_save(user);
+                        user_add_to_save_queue(user);
                 }
 
                 user_add_to_gc_queue(user);
@@ -75,6 +75,9 @@ Seat* seat_free(Seat *s) {
 
         hashmap_remove(s->manager->seats, s->id);
 
+        if (s->in_save_queue)
+                LIST_REMOVE(save_queue, s->manager->seat_save_queue, s);
+
         free(s->positions);
         free(s->state_file);
 
@@ -88,6 +91,11 @@ int seat_save(Seat *s) {
 
         assert(s);
 
+        if (s->in_save_queue) {
+                LIST_REMOVE(save_queue, s->manager->seat_save_queue, s);
+                s->in_save_queue = false;
+        }
+
         if (!s->started)
                 return 0;
 
@@ -252,17 +260,17 @@ int seat_set_active(Seat *s, Session *session) {
         if (!session || session->started)
                 seat_send_changed(s, "ActiveSession", NULL);
 
-        seat_save(s);
+        seat_add_to_save_queue(s);
 
         if (session) {
-                session_save(session);
-                user_save(session->user);
+                session_add_to_save_queue(session);
+                user_add_to_save_queue(session->user);
         }
 
         if (old_active) {
-                session_save(old_active);
+                session_add_to_save_queue(old_active);
                 if (!session || session->user != old_active->user)
-                        user_save(old_active->user);
+                        user_add_to_save_queue(old_active->user);
         }
 
         return 0;
@@ -414,7 +422,7 @@ int seat_start(Seat *s) {
         s->started = true;
 
         /* Save seat data */
-        seat_save(s);
+        seat_add_to_save_queue(s);
 
         seat_send_signal(s, true);
 
@@ -641,6 +649,18 @@ void seat_add_to_gc_queue(Seat *s) {
         s->in_gc_queue = true;
 }
 
+void seat_add_to_save_queue(Seat *s) {
+        assert(s);
+
+        if (s->in_save_queue)
+                return;
+
+        LIST_PREPEND(save_queue, s->manager->seat_save_queue, s);
+        s->in_save_queue = true;
+
+        manager_schedule_save_queue(s->manager);
+}
+
 static bool seat_name_valid_char(char c) {
         return
                 (c >= 'a' && c <= 'z') ||
@@ -22,9 +22,11 @@ struct Seat {
         size_t position_count;
 
         bool in_gc_queue:1;
+        bool in_save_queue:1;
         bool started:1;
 
         LIST_FIELDS(Seat, gc_queue);
+        LIST_FIELDS(Seat, save_queue);
 };
 
 int seat_new(Seat **ret, Manager *m, const char *id);
@@ -33,6 +35,7 @@ Seat* seat_free(Seat *s);
 DEFINE_TRIVIAL_CLEANUP_FUNC(Seat *, seat_free);
 
 int seat_save(Seat *s);
+void seat_add_to_save_queue(Seat *s);
 int seat_load(Seat *s);
 
 int seat_apply_acls(Seat *s, Session *old_active);
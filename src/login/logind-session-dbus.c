@@ -416,7 +416,7 @@ static int method_take_device(sd_bus_message *message, void *userdata, sd_bus_er
         if (r < 0)
                 goto error;
 
-        session_save(s);
+        session_add_to_save_queue(s);
         return 1;
 
 error:
@@ -450,7 +450,7 @@ static int method_release_device(sd_bus_message *message, void *userdata, sd_bus
                 return sd_bus_error_setf(error, BUS_ERROR_DEVICE_NOT_TAKEN, "Device not taken");
 
         session_device_free(sd);
-        session_save(s);
+        session_add_to_save_queue(s);
 
         return sd_bus_reply_method_return(message, NULL);
 }
@@ -806,8 +806,13 @@ int session_send_create_reply(Session *s, sd_bus_error *error) {
         if (fifo_fd < 0)
                 return fifo_fd;
 
-        /* Update the session state file before we notify the client about the result. */
+        /* Update the state files before we notify the client about the result. Everything else that is
+         * queued for saving may wait. */
         session_save(s);
+        if (s->user->in_save_queue)
+                user_save(s->user);
+        if (s->seat && s->seat->in_save_queue)
+                seat_save(s->seat);
 
         p = session_bus_path(s);
         if (!p)
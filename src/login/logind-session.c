@@ -133,6 +133,9 @@ Session* session_free(Session *s) {
 
         sd_bus_message_unref(s->create_message);
 
+        if (s->in_save_queue)
+                LIST_REMOVE(save_queue, s->manager->session_save_queue, s);
+
         free(s->tty);
         free(s->display);
         free(s->remote_host);
@@ -206,6 +209,11 @@ int session_save(Session *s) {
 
         assert(s);
 
+        if (s->in_save_queue) {
+                LIST_REMOVE(save_queue, s->manager->session_save_queue, s);
+                s->in_save_queue = false;
+        }
+
         if (!s->user)
                 return -ESTALE;
 
@@ -713,10 +721,10 @@ int session_start(Session *s, sd_bus_message *properties, sd_bus_error *error) {
         user_elect_display(s->user);
 
         /* Save data */
-        session_save(s);
-        user_save(s->user);
+        session_add_to_save_queue(s);
+        user_add_to_save_queue(s->user);
         if (s->seat)
-                seat_save(s->seat);
+                seat_add_to_save_queue(s->seat);
 
         /* Send signals */
         session_send_signal(s, true);
@@ -806,8 +814,8 @@ int session_stop(Session *s, bool force) {
 
         user_elect_display(s->user);
 
-        session_save(s);
-        user_save(s->user);
+        session_add_to_save_queue(s);
+        user_add_to_save_queue(s->user);
 
         return r;
 }
@@ -850,10 +858,10 @@ int session_finalize(Session *s) {
                 if (s->seat->active == s)
                         seat_set_active(s->seat, NULL);
 
-                seat_save(s->seat);
+                seat_add_to_save_queue(s->seat);
         }
 
-        user_save(s->user);
+        user_add_to_save_queue(s->user);
         user_send_changed(s->user, "Display", NULL);
 
         return 0;
@@ -1140,6 +1148,18 @@ void session_add_to_gc_queue(Session *s) {
         s->in_gc_queue = true;
 }
 
+void session_add_to_save_queue(Session *s) {
+        assert(s);
+
+        if (s->in_save_queue)
+                return;
+
+        LIST_PREPEND(save_queue, s->manager->session_save_queue, s);
+        s->in_save_queue = true;
+
+        manager_schedule_save_queue(s->manager);
+}
+
 SessionState session_get_state(Session *s) {
         assert(s);
 
@@ -1374,7 +1394,7 @@ int session_set_controller(Session *s, const char *sender, bool force, bool prep
 
         session_release_controller(s, true);
         s->controller = TAKE_PTR(name);
-        session_save(s);
+        session_add_to_save_queue(s);
 
         return 0;
 }
@@ -1387,7 +1407,7 @@ void session_drop_controller(Session *s) {
 
         s->track = sd_bus_track_unref(s->track);
         session_release_controller(s, false);
-        session_save(s);
+        session_add_to_save_queue(s);
         session_restore_vt(s);
 }
 
@@ -100,6 +100,7 @@ struct Session {
         bool locked_hint;
 
         bool in_gc_queue:1;
+        bool in_save_queue:1;
         bool started:1;
         bool stopping:1;
 
@@ -118,6 +119,7 @@ struct Session {
         LIST_FIELDS(Session, sessions_by_seat);
 
         LIST_FIELDS(Session, gc_queue);
+        LIST_FIELDS(Session, save_queue);
 };
 
 int session_new(Session **ret, Manager *m, const char *id);
@@ -141,6 +143,7 @@ int session_stop(Session *s, bool force);
 int session_finalize(Session *s);
 int session_release(Session *s);
 int session_save(Session *s);
+void session_add_to_save_queue(Session *s);
 int session_load(Session *s);
 int session_kill(Session *s, KillWho who, int signo);
 
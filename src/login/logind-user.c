@@ -135,6 +135,9 @@ User *user_free(User *u) {
 
         u->service_job = mfree(u->service_job);
 
+        if (u->in_save_queue)
+                LIST_REMOVE(save_queue, u->manager->user_save_queue, u);
+
         u->service = mfree(u->service);
         u->runtime_dir_service = mfree(u->runtime_dir_service);
         u->slice = mfree(u->slice);
@@ -304,6 +307,11 @@ fail:
 int user_save(User *u) {
         assert(u);
 
+        if (u->in_save_queue) {
+                LIST_REMOVE(save_queue, u->manager->user_save_queue, u);
+                u->in_save_queue = false;
+        }
+
         if (!u->started)
                 return 0;
 
@@ -393,7 +401,7 @@ int user_start(User *u) {
         }
 
         /* Save new user data */
-        user_save(u);
+        user_add_to_save_queue(u);
 
         return 0;
 }
@@ -429,7 +437,7 @@ int user_stop(User *u, bool force) {
                 return 0;
 
         if (u->stopping) { /* Stop jobs have already been queued */
-                user_save(u);
+                user_add_to_save_queue(u);
                 return 0;
         }
 
@@ -445,7 +453,7 @@ int user_stop(User *u, bool force) {
 
         u->stopping = true;
 
-        user_save(u);
+        user_add_to_save_queue(u);
 
         return r;
 }
@@ -621,6 +629,18 @@ void user_add_to_gc_queue(User *u) {
         u->in_gc_queue = true;
 }
 
+void user_add_to_save_queue(User *u) {
+        assert(u);
+
+        if (u->in_save_queue)
+                return;
+
+        LIST_PREPEND(save_queue, u->manager->user_save_queue, u);
+        u->in_save_queue = true;
+
+        manager_schedule_save_queue(u->manager);
+}
+
 UserState user_get_state(User *u) {
         Session *i;
 
@@ -31,6 +31,10 @@
 #include "terminal-util.h"
 #include "udev-util.h"
 
+/* Under continuous load the idle event source writing out the save queue might not get dispatched for a
+ * while, make sure state files don't lag behind for longer than this */
+#define SAVE_QUEUE_MAX_DELAY_USEC (250 * USEC_PER_MSEC)
+
 static Manager* manager_unref(Manager *m);
 DEFINE_TRIVIAL_CLEANUP_FUNC(Manager*, manager_unref);
 
@@ -95,6 +99,9 @@ static Manager* manager_unref(Manager *m) {
         if (!m)
                 return NULL;
 
+        /* The state files are picked up again when we are restarted, hence write out what is pending */
+        manager_dispatch_save_queue(m);
+
         while ((session = hashmap_first(m->sessions)))
                 session_free(session);
 
@@ -125,6 +132,7 @@ static Manager* manager_unref(Manager *m) {
         hashmap_free(m->user_units);
         hashmap_free(m->session_units);
 
+        sd_event_source_unref(m->save_queue_event_source);
         sd_event_source_unref(m->idle_action_event_source);
         sd_event_source_unref(m->inhibit_timeout_source);
         sd_event_source_unref(m->scheduled_shutdown_timeout_source);
@@ -934,6 +942,73 @@ static int manager_connect_udev(Manager *m) {
         return 0;
 }
 
+void manager_dispatch_save_queue(Manager *m) {
+        Session *session;
+        User *user;
+        Seat *seat;
+
+        assert(m);
+
+        /* Saving an object removes it from the queue. Sessions go first, since the user and seat files
+         * refer to them. */
+
+        while ((session = m->session_save_queue))
+                (void) session_save(session);
+
+        while ((user = m->user_save_queue))
+                (void) user_save(user);
+
+        while ((seat = m->seat_save_queue))
+                (void) seat_save(seat);
+
+        m->save_queue_timestamp = 0;
+        if (m->save_queue_event_source)
+                (void) sd_event_source_set_enabled(m->save_queue_event_source, SD_EVENT_OFF);
+}
+
+static int manager_dispatch_save_queue_event(sd_event_source *s, void *userdata) {
+        Manager *m = userdata;
+
+        assert(m);
+
+        manager_dispatch_save_queue(m);
+        return 0;
+}
+
+void manager_schedule_save_queue(Manager *m) {
+        int r;
+
+        assert(m);
+
+        if (m->save_queue_timestamp > 0)
+                return;
+
+        if (!m->save_queue_event_source) {
+                r = sd_event_add_defer(m->event, &m->save_queue_event_source, manager_dispatch_save_queue_event, m);
+                if (r < 0)
+                        goto fail;
+
+                /* Only write the files once nothing else is to be done, so that changes done while
+                 * processing a burst of requests are merged. */
+                r = sd_event_source_set_priority(m->save_queue_event_source, SD_EVENT_PRIORITY_IDLE);
+                if (r < 0)
+                        goto fail;
+
+                (void) sd_event_source_set_description(m->save_queue_event_source, "logind-save-queue");
+        }
+
+        r = sd_event_source_set_enabled(m->save_queue_event_source, SD_EVENT_ONESHOT);
+        if (r < 0)
+                goto fail;
+
+        m->save_queue_timestamp = now(CLOCK_MONOTONIC);
+        return;
+
+fail:
+        log_warning_errno(r, "Failed to schedule writing of state files, writing them right away: %m");
+        manager_dispatch_save_queue(m);
+}
+
 static void manager_gc(Manager *m, bool drop_not_started) {
         Seat *seat;
         Session *session;
@@ -1177,6 +1252,10 @@ static int manager_run(Manager *m) {
 
                 manager_gc(m, true);
 
+                if (m->save_queue_timestamp > 0 &&
+                    now(CLOCK_MONOTONIC) >= usec_add(m->save_queue_timestamp, SAVE_QUEUE_MAX_DELAY_USEC))
+                        manager_dispatch_save_queue(m);
+
                 r = manager_dispatch_delayed(m, false);
                 if (r < 0)
                         return r;
@@ -37,6 +37,14 @@ struct Manager {
         LIST_HEAD(Session, session_gc_queue);
         LIST_HEAD(User, user_gc_queue);
 
+        /* State files are written in batches, so that a burst of changes to the same objects (as happens
+         * on every login and logout) results in a single write of each file. */
+        LIST_HEAD(Seat, seat_save_queue);
+        LIST_HEAD(Session, session_save_queue);
+        LIST_HEAD(User, user_save_queue);
+        sd_event_source *save_queue_event_source;
+        usec_t save_queue_timestamp;
+
         sd_device_monitor *device_seat_monitor, *device_monitor, *device_vcsa_monitor, *device_button_monitor;
 
         sd_event_source *console_active_event_source;
@@ -135,6 +143,9 @@ int manager_add_user_by_name(Manager *m, const char *name, User **ret_user);
 int manager_add_user_by_uid(Manager *m, uid_t uid, User **ret_user);
 int manager_add_inhibitor(Manager *m, const char* id, Inhibitor **ret_inhibitor);
 
+void manager_schedule_save_queue(Manager *m);
+void manager_dispatch_save_queue(Manager *m);
+
 int manager_process_seat_device(Manager *m, sd_device *d);
 int manager_process_button_device(Manager *m, sd_device *d);
 
@@ -2201,6 +2201,8 @@ static void determine_compression_from_filename(const char *p) {
                 arg_format = "gzip";
         else if (endswith(p, ".bz2"))
                 arg_format = "bzip2";
+        else if (endswith(p, ".zst"))
+                arg_format = "zstd";
 }
 
 static int export_tar(int argc, char *argv[], void *userdata) {
@@ -2410,7 +2412,7 @@ static int pull_raw(int argc, char *argv[], void *userdata) {
                         "org.freedesktop.import1",
                         "/org/freedesktop/import1",
                         "org.freedesktop.import1.Manager",
-                        "PullRaw");
+                        streq(argv[0], "pull-chunked") ? "PullChunked" : "PullRaw");
         if (r < 0)
                 return bus_log_create_error(r);
 
@@ -2725,6 +2727,8 @@ static int help(int argc, char *argv[], void *userdata) {
                "Image Transfer Commands:\n"
                "  pull-tar URL [NAME]         Download a TAR container image\n"
                "  pull-raw URL [NAME]         Download a RAW container or VM image\n"
+               "  pull-chunked URL [NAME]     Download a RAW container or VM image from\n"
+               "                              a chunk index\n"
                "  import-tar FILE [NAME]      Import a local TAR container image\n"
                "  import-raw FILE [NAME]      Import a local RAW container or VM image\n"
                "  import-fs DIRECTORY [NAME]  Import a local directory container image\n"
@@ -2997,7 +3001,7 @@ static int parse_argv(int argc, char *argv[]) {
                         break;
 
                 case ARG_FORMAT:
-                        if (!STR_IN_SET(optarg, "uncompressed", "xz", "gzip", "bzip2"))
+                        if (!STR_IN_SET(optarg, "uncompressed", "xz", "gzip", "bzip2", "zstd"))
                                 return log_error_errno(SYNTHETIC_ERRNO(EINVAL),
                                                        "Unknown format: %s", optarg);
 
@@ -3090,6 +3094,7 @@ static int machinectl_main(int argc, char *argv[], sd_bus *bus) {
                 { "export-raw",      2,        3,        0,            export_raw        },
                 { "pull-tar",        2,        3,        0,            pull_tar          },
                 { "pull-raw",        2,        3,        0,            pull_raw          },
+                { "pull-chunked",    2,        3,        0,            pull_raw          },
                 { "list-transfers",  VERB_ANY, 1,        0,            list_transfers    },
                 { "cancel-transfer", 2,        VERB_ANY, 0,            cancel_transfer   },
                 { "set-limit",       2,        3,        0,            set_limit         },
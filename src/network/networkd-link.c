@@ -41,7 +41,6 @@
 #include "string-table.h"
 #include "strv.h"
 #include "sysctl-util.h"
-#include "tmpfile-util.h"
 #include "udev-util.h"
 #include "util.h"
 #include "vrf.h"
@@ -959,16 +958,24 @@ static int nexthop_handler(sd_netlink *rtnl, sd_netlink_message *m, Link *link)
 
 int link_request_set_nexthop(Link *link) {
         NextHop *nh;
-        int r;
+        int r = 0, k;
+
+        (void) sd_netlink_batch_begin(link->manager->rtnl);
 
         LIST_FOREACH(nexthops, nh, link->network->static_nexthops) {
                 r = nexthop_configure(nh, link, nexthop_handler);
                 if (r < 0)
-                        return log_link_warning_errno(link, r, "Could not set nexthop: %m");
+                        break;
                 if (r > 0)
                         link->nexthop_messages++;
         }
 
+        k = sd_netlink_batch_end(link->manager->rtnl);
+        if (r < 0)
+                return log_link_warning_errno(link, r, "Could not set nexthop: %m");
+        if (k < 0)
+                return log_link_warning_errno(link, k, "Could not send nexthop requests: %m");
+
         if (link->nexthop_messages == 0) {
                 link->static_nexthops_configured = true;
                 link_check_ready(link);
@@ -1016,7 +1023,7 @@ int link_request_set_routes(Link *link) {
                 _PHASE_MAX
         } phase;
         Route *rt;
-        int r;
+        int r, k;
 
         assert(link);
         assert(link->network);
@@ -1036,8 +1043,12 @@ int link_request_set_routes(Link *link) {
         if (r < 0)
                 return r;
 
+        /* Many routes may be configured at once, hence pass them to the kernel in batches. The kernel
+         * processes the requests in order, hence the ordering below is kept. */
+        (void) sd_netlink_batch_begin(link->manager->rtnl);
+
         /* First add the routes that enable us to talk to gateways, then add in the others that need a gateway. */
-        for (phase = 0; phase < _PHASE_MAX; phase++)
+        for (phase = 0; phase < _PHASE_MAX && r >= 0; phase++)
                 LIST_FOREACH(routes, rt, link->network->static_routes) {
 
                         if (in_addr_is_null(rt->family, &rt->gw) != (phase == PHASE_NON_GATEWAY))
@@ -1045,11 +1056,17 @@ int link_request_set_routes(Link *link) {
 
                         r = route_configure(rt, link, route_handler);
                         if (r < 0)
-                                return log_link_warning_errno(link, r, "Could not set routes: %m");
+                                break;
                         if (r > 0)
                                 link->route_messages++;
                 }
 
+        k = sd_netlink_batch_end(link->manager->rtnl);
+        if (r < 0)
+                return log_link_warning_errno(link, r, "Could not set routes: %m");
+        if (k < 0)
+                return log_link_warning_errno(link, k, "Could not send route requests: %m");
+
         if (link->route_messages == 0) {
                 link->static_routes_configured = true;
                 link_check_ready(link);
@@ -1215,7 +1232,7 @@ static int link_set_bridge_fdb(Link *link) {
 static int link_request_set_addresses(Link *link) {
         AddressLabel *label;
         Address *ad;
-        int r;
+        int r, k;
 
         assert(link);
         assert(link->network);
@@ -1238,6 +1255,9 @@ static int link_request_set_addresses(Link *link) {
         if (r < 0)
                 return r;
 
+        /* Links may carry thousands of addresses, hence pass them to the kernel in batches */
+        (void) sd_netlink_batch_begin(link->manager->rtnl);
+
         LIST_FOREACH(addresses, ad, link->network->static_addresses) {
                 bool update;
 
@@ -1245,11 +1265,17 @@ static int link_request_set_addresses(Link *link) {
 
                 r = address_configure(ad, link, address_handler, update);
                 if (r < 0)
-                        return log_link_warning_errno(link, r, "Could not set addresses: %m");
+                        break;
                 if (r > 0)
                         link->address_messages++;
         }
 
+        k = sd_netlink_batch_end(link->manager->rtnl);
+        if (r < 0)
+                return log_link_warning_errno(link, r, "Could not set addresses: %m");
+        if (k < 0)
+                return log_link_warning_errno(link, k, "Could not send address requests: %m");
+
         LIST_FOREACH(labels, label, link->network->address_labels) {
                 r = address_label_configure(label, link, NULL, false);
                 if (r < 0)
@@ -3817,12 +3843,13 @@ static void link_save_dns(FILE *f, struct in_addr_data *dns, unsigned n_dns, boo
 }
 
 int link_save(Link *link) {
-        _cleanup_free_ char *temp_path = NULL;
+        _cleanup_free_ char *contents = NULL;
         _cleanup_fclose_ FILE *f = NULL;
         const char *admin_state, *oper_state, *carrier_state, *address_state;
         Address *a;
         Route *route;
         Iterator i;
+        size_t size;
         int r;
 
         assert(link);
@@ -3832,6 +3859,7 @@ int link_save(Link *link) {
 
         if (link->state == LINK_STATE_LINGER) {
                 (void) unlink(link->state_file);
+                link->state_file_hash = 0;
                 return 0;
         }
 
@@ -3849,11 +3877,11 @@ int link_save(Link *link) {
         address_state = link_address_state_to_string(link->address_state);
         assert(address_state);
 
-        r = fopen_temporary(link->state_file, &f, &temp_path);
-        if (r < 0)
+        f = open_memstream_unlocked(&contents, &size);
+        if (!f) {
+                r = -ENOMEM;
                 goto fail;
-
-        (void) fchmod(fileno(f), 0644);
+        }
 
         fprintf(f,
                 "# This is private data. Do not parse.\n"
@@ -4153,17 +4181,16 @@ int link_save(Link *link) {
         if (r < 0)
                 goto fail;
 
-        if (rename(temp_path, link->state_file) < 0) {
-                r = -errno;
+        f = safe_fclose(f);
+
+        r = network_write_state_file(link->state_file, contents, size, &link->state_file_hash);
+        if (r < 0)
                 goto fail;
-        }
 
         return 0;
 
 fail:
         (void) unlink(link->state_file);
-        if (temp_path)
-                (void) unlink(temp_path);
 
         return log_link_error_errno(link, r, "Failed to save link data to %s: %m", link->state_file);
 }
@@ -4213,6 +4240,9 @@ DEFINE_STRING_TABLE_LOOKUP(link_state, LinkState);
 int log_link_message_full_errno(Link *link, sd_netlink_message *m, int level, int err, const char *msg) {
         const char *err_msg = NULL;
 
+        if (!log_level_enabled(level))
+                return -ERRNO_VALUE(err);
+
         (void) sd_netlink_message_read_string(m, NLMSGERR_ATTR_MSG, &err_msg);
         return log_link_full(link, level, err, "%s: %s%s%m", msg, strempty(err_msg), err_msg ? " " : "");
 }
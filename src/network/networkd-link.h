@@ -52,6 +52,7 @@ typedef struct Link {
         char *kind;
         unsigned short iftype;
         char *state_file;
+        uint64_t state_file_hash;
         struct ether_addr mac;
         struct in6_addr ipv6ll_address;
         uint32_t mtu;
@@ -134,6 +135,7 @@ typedef struct Link {
         /* This is about LLDP reception */
         sd_lldp *lldp;
         char *lldp_file;
+        uint64_t lldp_file_hash;
 
         /* This is about LLDP transmission */
         unsigned lldp_tx_fast; /* The LLDP txFast counter (See 802.1ab-2009, section 9.2.5.18) */
@@ -12,7 +12,6 @@
 #include "networkd-network.h"
 #include "string-table.h"
 #include "string-util.h"
-#include "tmpfile-util.h"
 
 DEFINE_CONFIG_PARSE_ENUM(config_parse_lldp_mode, lldp_mode, LLDPMode, "Failed to parse LLDP= setting.");
 
@@ -51,7 +50,11 @@ static void lldp_handler(sd_lldp *lldp, sd_lldp_event event, sd_lldp_neighbor *n
 
         assert(link);
 
-        (void) link_lldp_save(link);
+        /* A refresh means the very same data was received again, which does not change what is saved.
+         * Otherwise, let the state be written once the current event loop iteration is done, instead of
+         * for each received frame. */
+        if (event != SD_LLDP_EVENT_REFRESHED)
+                link_dirty(link);
 
         if (link_lldp_emit_enabled(link) && event == SD_LLDP_EVENT_ADDED) {
                 /* If we received information about a new neighbor, restart the LLDP "fast" logic */
@@ -127,9 +130,10 @@ int link_update_lldp(Link *link) {
 }
 
 int link_lldp_save(Link *link) {
-        _cleanup_free_ char *temp_path = NULL;
+        _cleanup_free_ char *contents = NULL;
         _cleanup_fclose_ FILE *f = NULL;
         sd_lldp_neighbor **l = NULL;
+        size_t size;
         int n = 0, r, i;
 
         assert(link);
@@ -137,6 +141,7 @@ int link_lldp_save(Link *link) {
 
         if (!link->lldp) {
                 (void) unlink(link->lldp_file);
+                link->lldp_file_hash = 0;
                 return 0;
         }
 
@@ -145,16 +150,17 @@ int link_lldp_save(Link *link) {
                 goto finish;
         if (r == 0) {
                 (void) unlink(link->lldp_file);
+                link->lldp_file_hash = 0;
                 goto finish;
         }
 
         n = r;
 
-        r = fopen_temporary(link->lldp_file, &f, &temp_path);
-        if (r < 0)
+        f = open_memstream_unlocked(&contents, &size);
+        if (!f) {
+                r = -ENOMEM;
                 goto finish;
-
-        fchmod(fileno(f), 0644);
+        }
 
         for (i = 0; i < n; i++) {
                 const void *p;
@@ -174,16 +180,14 @@ int link_lldp_save(Link *link) {
         if (r < 0)
                 goto finish;
 
-        if (rename(temp_path, link->lldp_file) < 0) {
-                r = -errno;
-                goto finish;
-        }
+        f = safe_fclose(f);
+
+        r = network_write_state_file(link->lldp_file, contents, size, &link->lldp_file_hash);
 
 finish:
         if (r < 0) {
                 (void) unlink(link->lldp_file);
-                if (temp_path)
-                        (void) unlink(temp_path);
+                link->lldp_file_hash = 0;
 
                 log_link_error_errno(link, r, "Failed to save LLDP data to %s: %m", link->lldp_file);
         }
@@ -34,7 +34,6 @@
 #include "signal-util.h"
 #include "strv.h"
 #include "sysctl-util.h"
-#include "tmpfile-util.h"
 #include "udev-util.h"
 #include "virt.h"
 
@@ -325,6 +324,11 @@ int manager_rtnl_process_route(sd_netlink *rtnl, sd_netlink_message *message, vo
                 return 0;
         }
 
+        /* Without any routes of our own on the link, only foreign routes can match. Skip parsing them
+         * altogether if we are not supposed to track those. */
+        if (!m->manage_foreign_routes && set_isempty(link->routes))
+                return 0;
+
         r = route_new(&tmp);
         if (r < 0)
                 return log_oom();
@@ -505,8 +509,15 @@ int manager_rtnl_process_route(sd_netlink *rtnl, sd_netlink_message *message, vo
         switch (type) {
         case RTM_NEWROUTE:
                 if (!route) {
+                        if (!m->manage_foreign_routes)
+                                return 0;
+
                         /* A route appeared that we did not request */
                         r = route_add_foreign(link, tmp, &route);
+                        if (r == -E2BIG) {
+                                log_link_debug(link, "Too many foreign routes on the interface, not remembering any more of them.");
+                                return 0;
+                        }
                         if (r < 0) {
                                 log_link_warning_errno(link, r, "Failed to remember foreign route, ignoring: %m");
                                 return 0;
@@ -1476,11 +1487,12 @@ static int manager_save(Manager *m) {
         LinkOperationalState operstate = LINK_OPERSTATE_OFF;
         LinkCarrierState carrier_state = LINK_CARRIER_STATE_OFF;
         LinkAddressState address_state = LINK_ADDRESS_STATE_OFF;
-        _cleanup_free_ char *temp_path = NULL;
+        _cleanup_free_ char *contents = NULL;
         _cleanup_strv_free_ char **p = NULL;
         _cleanup_fclose_ FILE *f = NULL;
         Link *link;
         Iterator i;
+        size_t size;
         int r;
 
         assert(m);
@@ -1615,11 +1627,9 @@ static int manager_save(Manager *m) {
         address_state_str = link_address_state_to_string(address_state);
         assert(address_state_str);
 
-        r = fopen_temporary(m->state_file, &f, &temp_path);
-        if (r < 0)
-                return r;
-
-        (void) fchmod(fileno(f), 0644);
+        f = open_memstream_unlocked(&contents, &size);
+        if (!f)
+                return -ENOMEM;
 
         fprintf(f,
                 "# This is private data. Do not parse.\n"
@@ -1642,10 +1652,11 @@ static int manager_save(Manager *m) {
         if (r < 0)
                 goto fail;
 
-        if (rename(temp_path, m->state_file) < 0) {
-                r = -errno;
+        f = safe_fclose(f);
+
+        r = network_write_state_file(m->state_file, contents, size, &m->state_file_hash);
+        if (r < 0)
                 goto fail;
-        }
 
         if (m->operational_state != operstate) {
                 m->operational_state = operstate;
@@ -1677,7 +1688,6 @@ static int manager_save(Manager *m) {
 
 fail:
         (void) unlink(m->state_file);
-        (void) unlink(temp_path);
 
         return log_error_errno(r, "Failed to save network state to %s: %m", m->state_file);
 }
@@ -1731,6 +1741,7 @@ int manager_new(Manager **ret) {
 
         *m = (Manager) {
                 .speed_meter_interval_usec = SPEED_METER_DEFAULT_TIME_INTERVAL,
+                .manage_foreign_routes = true,
         };
 
         m->state_file = strdup("/run/systemd/netif/state");
@@ -1813,6 +1824,7 @@ void manager_free(Manager *m) {
         m->links = hashmap_free_with_destructor(m->links, link_unref);
 
         m->duids_requesting_uuid = set_free(m->duids_requesting_uuid);
+        manager_flush_network_index(m);
         m->networks = ordered_hashmap_free_with_destructor(m->networks, network_unref);
 
         m->netdevs = hashmap_free_with_destructor(m->netdevs, netdev_unref);
@@ -2000,6 +2012,12 @@ int manager_rtnl_enumerate_routes(Manager *m) {
         assert(m);
         assert(m->rtnl);
 
+        /* Routes configured by us are tracked as we add them, hence the dump is only needed to learn about
+         * foreign routes. On hosts with full routing tables this is by far the most expensive part of the
+         * enumeration. */
+        if (!m->manage_foreign_routes)
+                return 0;
+
         r = sd_rtnl_message_new_route(m->rtnl, &req, RTM_GETROUTE, 0, 0);
         if (r < 0)
                 return r;
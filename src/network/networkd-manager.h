@@ -34,6 +34,7 @@ struct Manager {
         Set *dirty_links;
 
         char *state_file;
+        uint64_t state_file_hash;
         LinkOperationalState operational_state;
         LinkCarrierState carrier_state;
         LinkAddressState address_state;
@@ -42,6 +43,14 @@ struct Manager {
         Hashmap *netdevs;
         OrderedHashmap *networks;
         Hashmap *dhcp6_prefixes;
+
+        /* Index of the networks above, see manager_index_networks() */
+        Hashmap *networks_by_name;
+        Hashmap *networks_by_mac;
+        Network **networks_unindexed;
+        size_t n_networks_unindexed;
+        bool networks_indexed;
+
         LIST_HEAD(AddressPool, address_pools);
 
         usec_t network_dirs_ts_usec;
@@ -61,11 +70,15 @@ struct Manager {
 
         /* For link speed meter*/
         bool use_speed_meter;
+        bool speed_meter_use_getlink;
         sd_event_source *speed_meter_event_source;
         usec_t speed_meter_interval_usec;
         usec_t speed_meter_usec_new;
         usec_t speed_meter_usec_old;
 
+        bool manage_foreign_routes;
+        bool ndisc_shared_socket;
+
         bool dhcp4_prefix_root_cannot_set_table;
 };
 
@@ -694,6 +694,10 @@ int ndisc_configure(Link *link) {
         if (r < 0)
                 return r;
 
+        r = sd_ndisc_set_shared_socket(link->ndisc, link->manager->ndisc_shared_socket);
+        if (r < 0)
+                return r;
+
         r = sd_ndisc_set_callback(link->ndisc, ndisc_handler, link);
         if (r < 0)
                 return r;
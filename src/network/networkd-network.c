@@ -8,7 +8,9 @@
 #include "conf-files.h"
 #include "conf-parser.h"
 #include "dns-domain.h"
+#include "ether-addr-util.h"
 #include "fd-util.h"
+#include "glob-util.h"
 #include "hostname-util.h"
 #include "in-addr-util.h"
 #include "networkd-dhcp-server.h"
@@ -515,6 +517,8 @@ int network_load_one(Manager *manager, OrderedHashmap **networks, const char *fi
         if (r < 0)
                 return r;
 
+        manager_flush_network_index(manager);
+
         network = NULL;
         return 0;
 }
@@ -526,6 +530,7 @@ int network_load(Manager *manager, OrderedHashmap **networks) {
 
         assert(manager);
 
+        manager_flush_network_index(manager);
         ordered_hashmap_clear_with_destructor(*networks, network_unref);
 
         r = conf_files_list_strv(&files, ".network", NULL, 0, NETWORK_DIRS);
@@ -572,6 +577,7 @@ int network_reload(Manager *manager) {
                 network_unref(n);
         }
 
+        manager_flush_network_index(manager);
         ordered_hashmap_free_with_destructor(manager->networks, network_unref);
         manager->networks = new_networks;
 
@@ -720,43 +726,232 @@ int network_get_by_name(Manager *manager, const char *name, Network **ret) {
         return 0;
 }
 
+void manager_flush_network_index(Manager *manager) {
+        assert(manager);
+
+        manager->networks_by_name = hashmap_free_with_destructor(manager->networks_by_name, set_free);
+        manager->networks_by_mac = hashmap_free_with_destructor(manager->networks_by_mac, set_free);
+        manager->networks_unindexed = mfree(manager->networks_unindexed);
+        manager->n_networks_unindexed = 0;
+        manager->networks_indexed = false;
+}
+
+static bool network_match_name_is_exact(char * const *names) {
+        char * const *n;
+
+        if (strv_isempty(names))
+                return false;
+
+        STRV_FOREACH(n, names)
+                if (**n == '!' || string_is_glob(*n))
+                        return false;
+
+        return true;
+}
+
+static int network_index_put(Hashmap **index, const struct hash_ops *hash_ops, const void *key, Network *network) {
+        _cleanup_set_free_ Set *s = NULL;
+        Set *existing;
+        int r;
+
+        existing = hashmap_get(*index, key);
+        if (existing)
+                return set_put(existing, network);
+
+        r = hashmap_ensure_allocated(index, hash_ops);
+        if (r < 0)
+                return r;
+
+        s = set_new(NULL);
+        if (!s)
+                return -ENOMEM;
+
+        r = set_put(s, network);
+        if (r < 0)
+                return r;
+
+        r = hashmap_put(*index, key, s);
+        if (r < 0)
+                return r;
+
+        TAKE_PTR(s);
+        return 0;
+}
+
+static int manager_index_networks(Manager *manager) {
+        Network *network;
+        unsigned order = 0;
+        Iterator i;
+        int r;
+
+        assert(manager);
+
+        /* Networks that match on exact interface names, or failing that on MAC addresses, are indexed by
+         * those, so that finding the networks for a link does not require checking all of them. The key
+         * strings and addresses are owned by the networks, hence the index has to be flushed whenever
+         * the set of networks changes. The index is built lazily, on the first lookup after that. */
+
+        manager_flush_network_index(manager);
+
+        if (ordered_hashmap_isempty(manager->networks)) {
+                manager->networks_indexed = true;
+                return 0;
+        }
+
+        manager->networks_unindexed = new(Network*, ordered_hashmap_size(manager->networks));
+        if (!manager->networks_unindexed)
+                return -ENOMEM;
+
+        ORDERED_HASHMAP_FOREACH(network, manager->networks, i) {
+                network->match_order = order++;
+
+                if (network_match_name_is_exact(network->match_name)) {
+                        char **n;
+
+                        STRV_FOREACH(n, network->match_name) {
+                                r = network_index_put(&manager->networks_by_name, &string_hash_ops, *n, network);
+                                if (r < 0)
+                                        goto fail;
+                        }
+                } else if (!set_isempty(network->match_mac)) {
+                        struct ether_addr *mac;
+                        Iterator j;
+
+                        SET_FOREACH(mac, network->match_mac, j) {
+                                r = network_index_put(&manager->networks_by_mac, &ether_addr_hash_ops, mac, network);
+                                if (r < 0)
+                                        goto fail;
+                        }
+                } else
+                        manager->networks_unindexed[manager->n_networks_unindexed++] = network;
+        }
+
+        manager->networks_indexed = true;
+        return 0;
+
+fail:
+        manager_flush_network_index(manager);
+        return r;
+}
+
+static int network_collect_candidates(Set **candidates, Hashmap *index, const void *key) {
+        Network *network;
+        Iterator i;
+        int r;
+
+        assert(candidates);
+
+        if (!key)
+                return 0;
+
+        SET_FOREACH(network, hashmap_get(index, key), i) {
+                r = set_ensure_allocated(candidates, NULL);
+                if (r < 0)
+                        return r;
+
+                r = set_put(*candidates, network);
+                if (r < 0)
+                        return r;
+        }
+
+        return 0;
+}
+
 int network_get(Manager *manager, sd_device *device,
                 const char *ifname, char * const *alternative_names, const struct ether_addr *address,
                 enum nl80211_iftype wlan_iftype, const char *ssid, const struct ether_addr *bssid,
                 Network **ret) {
-        Network *network;
+        _cleanup_set_free_ Set *candidates = NULL;
+        const struct ether_addr *mac = address;
+        struct ether_addr mac_buf;
+        Network *network, *found = NULL;
+        char * const *a;
         Iterator i;
+        size_t k;
+        int r;
 
         assert(manager);
         assert(ret);
 
-        ORDERED_HASHMAP_FOREACH(network, manager->networks, i)
+        if (!manager->networks_indexed) {
+                r = manager_index_networks(manager);
+                if (r < 0)
+                        return r;
+        }
+
+        if (!mac && device) {
+                const char *mac_str;
+
+                if (sd_device_get_sysattr_value(device, "address", &mac_str) >= 0)
+                        mac = ether_aton_r(mac_str, &mac_buf);
+        }
+
+        if (!ifname && device)
+                (void) sd_device_get_sysname(device, &ifname);
+
+        r = network_collect_candidates(&candidates, manager->networks_by_name, ifname);
+        if (r < 0)
+                return r;
+
+        STRV_FOREACH(a, alternative_names) {
+                r = network_collect_candidates(&candidates, manager->networks_by_name, *a);
+                if (r < 0)
+                        return r;
+        }
+
+        r = network_collect_candidates(&candidates, manager->networks_by_mac, mac);
+        if (r < 0)
+                return r;
+
+        /* The first matching .network file in load order wins, whether it is indexed or not */
+        SET_FOREACH(network, candidates, i) {
+                if (found && network->match_order > found->match_order)
+                        continue;
+
+                if (net_match_config(network->match_mac, network->match_path, network->match_driver,
+                                     network->match_type, network->match_name, network->match_property,
+                                     network->match_wlan_iftype, network->match_ssid, network->match_bssid,
+                                     device, address, ifname, alternative_names, wlan_iftype, ssid, bssid))
+                        found = network;
+        }
+
+        for (k = 0; k < manager->n_networks_unindexed; k++) {
+                network = manager->networks_unindexed[k];
+
+                if (found && network->match_order > found->match_order)
+                        break;
+
                 if (net_match_config(network->match_mac, network->match_path, network->match_driver,
                                      network->match_type, network->match_name, network->match_property,
                                      network->match_wlan_iftype, network->match_ssid, network->match_bssid,
                                      device, address, ifname, alternative_names, wlan_iftype, ssid, bssid)) {
-                        if (network->match_name && device) {
-                                const char *attr;
-                                uint8_t name_assign_type = NET_NAME_UNKNOWN;
-
-                                if (sd_device_get_sysattr_value(device, "name_assign_type", &attr) >= 0)
-                                        (void) safe_atou8(attr, &name_assign_type);
-
-                                if (name_assign_type == NET_NAME_ENUM)
-                                        log_warning("%s: found matching network '%s', based on potentially unpredictable ifname",
-                                                    ifname, network->filename);
-                                else
-                                        log_debug("%s: found matching network '%s'", ifname, network->filename);
-                        } else
-                                log_debug("%s: found matching network '%s'", ifname, network->filename);
-
-                        *ret = network;
-                        return 0;
+                        found = network;
+                        break;
                 }
+        }
 
-        *ret = NULL;
+        if (!found) {
+                *ret = NULL;
+                return -ENOENT;
+        }
+
+        if (found->match_name && device) {
+                const char *attr;
+                uint8_t name_assign_type = NET_NAME_UNKNOWN;
+
+                if (sd_device_get_sysattr_value(device, "name_assign_type", &attr) >= 0)
+                        (void) safe_atou8(attr, &name_assign_type);
 
-        return -ENOENT;
+                if (name_assign_type == NET_NAME_ENUM)
+                        log_warning("%s: found matching network '%s', based on potentially unpredictable ifname",
+                                    ifname, found->filename);
+                else
+                        log_debug("%s: found matching network '%s'", ifname, found->filename);
+        } else
+                log_debug("%s: found matching network '%s'", ifname, found->filename);
+
+        *ret = found;
+        return 0;
 }
 
 int network_apply(Network *network, Link *link) {
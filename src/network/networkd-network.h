@@ -63,6 +63,9 @@ struct Network {
 
         unsigned n_ref;
 
+        /* Position in load order, assigned when the networks are indexed */
+        unsigned match_order;
+
         Set *match_mac;
         char **match_path;
         char **match_driver;
@@ -296,6 +299,7 @@ DEFINE_TRIVIAL_CLEANUP_FUNC(Network*, network_unref);
 
 int network_load(Manager *manager, OrderedHashmap **networks);
 int network_reload(Manager *manager);
+void manager_flush_network_index(Manager *manager);
 int network_load_one(Manager *manager, OrderedHashmap **networks, const char *filename);
 int network_verify(Network *network);
 
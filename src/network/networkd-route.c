@@ -349,6 +349,12 @@ static int route_add_internal(Link *link, Set **routes, Route *in, Route **ret)
 }
 
 int route_add_foreign(Link *link, Route *in, Route **ret) {
+        assert(link);
+
+        /* Don't let other routing daemons make us use unbounded amounts of memory */
+        if (set_size(link->routes_foreign) >= routes_max())
+                return -E2BIG;
+
         return route_add_internal(link, &link->routes_foreign, in, ret);
 }
 
@@ -1,6 +1,7 @@
 /* SPDX-License-Identifier: LGPL-2.1+ */
 
 #include <errno.h>
+#include <linux/if_link.h>
 
 #include "sd-event.h"
 #include "sd-netlink.h"
@@ -19,10 +20,12 @@ static int process_message(Manager *manager, sd_netlink_message *message) {
         if (r < 0)
                 return r;
 
-        if (type != RTM_NEWLINK)
+        if (type == RTM_NEWSTATS)
+                r = sd_rtnl_message_stats_get_ifindex(message, &ifindex);
+        else if (type == RTM_NEWLINK)
+                r = sd_rtnl_message_link_get_ifindex(message, &ifindex);
+        else
                 return 0;
-
-        r = sd_rtnl_message_link_get_ifindex(message, &ifindex);
         if (r < 0)
                 return r;
 
@@ -32,7 +35,8 @@ static int process_message(Manager *manager, sd_netlink_message *message) {
 
         link->stats_old = link->stats_new;
 
-        r = sd_netlink_message_read(message, IFLA_STATS64, sizeof link->stats_new, &link->stats_new);
+        r = sd_netlink_message_read(message, type == RTM_NEWSTATS ? IFLA_STATS_LINK_64 : IFLA_STATS64,
+                                    sizeof link->stats_new, &link->stats_new);
         if (r < 0)
                 return r;
 
@@ -41,8 +45,49 @@ static int process_message(Manager *manager, sd_netlink_message *message) {
         return 0;
 }
 
+static int speed_meter_dump_stats(Manager *manager, sd_netlink_message **ret) {
+        _cleanup_(sd_netlink_message_unrefp) sd_netlink_message *req = NULL;
+        int r;
+
+        /* Only ask for the 64bit counters, a full RTM_GETLINK dump carries everything else about each link
+         * too, which is a lot of data to generate and parse every interval with thousands of links. */
+
+        r = sd_rtnl_message_new_stats(manager->rtnl, &req, RTM_GETSTATS, 0, IFLA_STATS_FILTER_BIT(IFLA_STATS_LINK_64));
+        if (r < 0)
+                return log_warning_errno(r, "Failed to allocate RTM_GETSTATS netlink message, ignoring: %m");
+
+        r = sd_netlink_message_request_dump(req, true);
+        if (r < 0)
+                return log_warning_errno(r, "Failed to set dump flag, ignoring: %m");
+
+        r = sd_netlink_call(manager->rtnl, req, 0, ret);
+        if (r < 0 && !IN_SET(r, -EOPNOTSUPP, -EINVAL))
+                return log_warning_errno(r, "Failed to call RTM_GETSTATS, ignoring: %m");
+
+        return r;
+}
+
+static int speed_meter_dump_links(Manager *manager, sd_netlink_message **ret) {
+        _cleanup_(sd_netlink_message_unrefp) sd_netlink_message *req = NULL;
+        int r;
+
+        r = sd_rtnl_message_new_link(manager->rtnl, &req, RTM_GETLINK, 0);
+        if (r < 0)
+                return log_warning_errno(r, "Failed to allocate RTM_GETLINK netlink message, ignoring: %m");
+
+        r = sd_netlink_message_request_dump(req, true);
+        if (r < 0)
+                return log_warning_errno(r, "Failed to set dump flag, ignoring: %m");
+
+        r = sd_netlink_call(manager->rtnl, req, 0, ret);
+        if (r < 0)
+                return log_warning_errno(r, "Failed to call RTM_GETLINK, ignoring: %m");
+
+        return r;
+}
+
 static int speed_meter_handler(sd_event_source *s, uint64_t usec, void *userdata) {
-        _cleanup_(sd_netlink_message_unrefp) sd_netlink_message *req = NULL, *reply = NULL;
+        _cleanup_(sd_netlink_message_unrefp) sd_netlink_message *reply = NULL;
         Manager *manager = userdata;
         sd_netlink_message *i;
         usec_t usec_now;
@@ -67,23 +112,17 @@ static int speed_meter_handler(sd_event_source *s, uint64_t usec, void *userdata
         HASHMAP_FOREACH(link, manager->links, j)
                 link->stats_updated = false;
 
-        r = sd_rtnl_message_new_link(manager->rtnl, &req, RTM_GETLINK, 0);
-        if (r < 0) {
-                log_warning_errno(r, "Failed to allocate RTM_GETLINK netlink message, ignoring: %m");
-                return 0;
-        }
-
-        r = sd_netlink_message_request_dump(req, true);
-        if (r < 0) {
-                log_warning_errno(r, "Failed to set dump flag, ignoring: %m");
-                return 0;
+        if (!manager->speed_meter_use_getlink) {
+                r = speed_meter_dump_stats(manager, &reply);
+                if (IN_SET(r, -EOPNOTSUPP, -EINVAL)) {
+                        log_debug_errno(r, "Kernel does not support RTM_GETSTATS, falling back to RTM_GETLINK: %m");
+                        manager->speed_meter_use_getlink = true;
+                }
         }
-
-        r = sd_netlink_call(manager->rtnl, req, 0, &reply);
-        if (r < 0) {
-                log_warning_errno(r, "Failed to call RTM_GETLINK, ignoring: %m");
+        if (manager->speed_meter_use_getlink)
+                r = speed_meter_dump_links(manager, &reply);
+        if (r < 0)
                 return 0;
-        }
 
         for (i = reply; i; i = sd_netlink_message_next(i))
                 (void) process_message(manager, i);
@@ -1,13 +1,24 @@
 /* SPDX-License-Identifier: LGPL-2.1+ */
 
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "sd-id128.h"
+
 #include "condition.h"
 #include "conf-parser.h"
+#include "fd-util.h"
+#include "fileio.h"
 #include "networkd-util.h"
 #include "parse-util.h"
+#include "siphash24.h"
 #include "string-table.h"
 #include "string-util.h"
+#include "tmpfile-util.h"
 #include "util.h"
 
+#define STATE_FILE_HASH_KEY SD_ID128_MAKE(5e,1b,9d,0a,c4,7f,4b,38,a2,61,3c,8e,f0,d7,19,64)
+
 static const char * const address_family_table[_ADDRESS_FAMILY_MAX] = {
         [ADDRESS_FAMILY_NO]            = "no",
         [ADDRESS_FAMILY_YES]           = "yes",
@@ -106,6 +117,51 @@ int kernel_route_expiration_supported(void) {
         return cached;
 }
 
+int network_write_state_file(const char *path, const void *contents, size_t size, uint64_t *hash) {
+        _cleanup_free_ char *temp_path = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        uint64_t h;
+        int r;
+
+        assert(path);
+        assert(contents || size == 0);
+        assert(hash);
+
+        /* The state files in /run are watched by the sd-network consumers with inotify. Only replace them
+         * when their contents actually changed, so that those are not woken up for nothing, e.g. when many
+         * links flap. Returns 1 if the file was written, 0 if it was already up-to-date. */
+
+        h = siphash24(contents, size, STATE_FILE_HASH_KEY.bytes);
+        if (h == *hash && access(path, F_OK) >= 0)
+                return 0;
+
+        *hash = 0;
+
+        r = fopen_temporary(path, &f, &temp_path);
+        if (r < 0)
+                return r;
+
+        (void) fchmod(fileno(f), 0644);
+
+        (void) fwrite(contents, 1, size, f);
+
+        r = fflush_and_check(f);
+        if (r < 0)
+                goto fail;
+
+        if (rename(temp_path, path) < 0) {
+                r = -errno;
+                goto fail;
+        }
+
+        *hash = h;
+        return 1;
+
+fail:
+        (void) unlink(temp_path);
+        return r;
+}
+
 static void network_config_hash_func(const NetworkConfigSection *c, struct siphash *state) {
         siphash24_compress(c->filename, strlen(c->filename), state);
         siphash24_compress(&c->line, sizeof(c->line), state);
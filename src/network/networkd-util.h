@@ -40,6 +40,8 @@ AddressFamily duplicate_address_detection_address_family_from_string(const char
 
 int kernel_route_expiration_supported(void);
 
+int network_write_state_file(const char *path, const void *contents, size_t size, uint64_t *hash);
+
 int network_config_section_new(const char *filename, unsigned line, NetworkConfigSection **s);
 void network_config_section_free(NetworkConfigSection *network);
 DEFINE_TRIVIAL_CLEANUP_FUNC(NetworkConfigSection*, network_config_section_free);
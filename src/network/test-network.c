@@ -7,11 +7,16 @@
 
 #include "alloc-util.h"
 #include "dhcp-lease-internal.h"
+#include "ether-addr-util.h"
+#include "fileio.h"
 #include "hostname-util.h"
 #include "network-internal.h"
 #include "networkd-manager.h"
+#include "path-util.h"
+#include "rm-rf.h"
 #include "string-util.h"
 #include "tests.h"
+#include "tmpfile-util.h"
 
 static void test_deserialize_in_addr(void) {
         _cleanup_free_ struct in_addr *addresses = NULL;
@@ -129,6 +134,52 @@ static void test_network_get(Manager *manager, sd_device *loopback) {
         assert_se(!network);
 }
 
+static void load_network(Manager *manager, const char *dir, const char *name, const char *contents) {
+        _cleanup_free_ char *path = NULL;
+
+        assert_se(path = path_join(dir, name));
+        assert_se(write_string_file(path, contents, WRITE_STRING_FILE_CREATE) >= 0);
+        assert_se(network_load_one(manager, &manager->networks, path) >= 0);
+}
+
+static const char *get_network_name(Manager *manager, const char *ifname, const struct ether_addr *mac) {
+        Network *network;
+
+        if (network_get(manager, NULL, ifname, NULL, mac, 0, NULL, NULL, &network) < 0)
+                return NULL;
+
+        return network->name;
+}
+
+static void test_network_get_index(void) {
+        _cleanup_(rm_rf_physical_and_freep) char *dir = NULL;
+        _cleanup_(manager_freep) Manager *manager = NULL;
+        const struct ether_addr mac = {{ 0x00, 0x11, 0x22, 0x33, 0x44, 0x55 }};
+
+        log_info("/* %s */", __func__);
+
+        assert_se(manager_new(&manager) >= 0);
+        assert_se(mkdtemp_malloc("/tmp/test-network-XXXXXX", &dir) >= 0);
+
+        load_network(manager, dir, "a.network", "[Match]\nName=veth1 eth1\n");
+        load_network(manager, dir, "b.network", "[Match]\nName=veth*\n");
+        load_network(manager, dir, "c.network", "[Match]\nMACAddress=00:11:22:33:44:55\n");
+
+        assert_se(streq_ptr(get_network_name(manager, "veth1", NULL), "a"));
+        assert_se(streq_ptr(get_network_name(manager, "eth1", NULL), "a"));
+        assert_se(streq_ptr(get_network_name(manager, "veth2", NULL), "b"));
+        assert_se(streq_ptr(get_network_name(manager, "foo", &mac), "c"));
+        assert_se(!get_network_name(manager, "foo", NULL));
+
+        /* The glob matching network comes earlier than the one matching on the address */
+        assert_se(streq_ptr(get_network_name(manager, "veth3", &mac), "b"));
+
+        /* Loading another network invalidates the index */
+        load_network(manager, dir, "d.network", "[Match]\nName=foo\n");
+        assert_se(streq_ptr(get_network_name(manager, "foo", NULL), "d"));
+        assert_se(streq_ptr(get_network_name(manager, "foo", &mac), "c"));
+}
+
 static void test_address_equality(void) {
         _cleanup_(address_freep) Address *a1 = NULL, *a2 = NULL;
 
@@ -230,6 +281,7 @@ int main(void) {
         test_deserialize_dhcp_routes();
         test_address_equality();
         test_dhcp_hostname_shorten_overlong();
+        test_network_get_index();
 
         assert_se(manager_new(&manager) >= 0);
 
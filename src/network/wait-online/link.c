@@ -60,6 +60,8 @@ Link *link_free(Link *l) {
                 return NULL;
 
         if (l->manager) {
+                manager_unaccount_link(l->manager, l);
+
                 hashmap_remove(l->manager->links, INT_TO_PTR(l->ifindex));
                 hashmap_remove(l->manager->links_by_name, l->ifname);
         }
@@ -20,6 +20,11 @@ struct Link {
         LinkOperationalState required_operstate;
         LinkOperationalState operational_state;
         char *state;
+
+        /* The last result of manager_link_is_online(), if the link is accounted for in the manager's
+         * counters of pending and online links */
+        int online;
+        bool accounted;
 };
 
 int link_new(Manager *m, Link **ret, int ifindex, const char *ifname);
@@ -59,13 +59,56 @@ static int manager_link_is_online(Manager *m, Link *l, LinkOperationalState s) {
         return 1;
 }
 
+void manager_unaccount_link(Manager *m, Link *l) {
+        assert(m);
+        assert(l);
+
+        if (!l->accounted)
+                return;
+
+        if (l->online < 0) {
+                assert(m->n_links_pending > 0);
+                m->n_links_pending--;
+        } else if (l->online > 0) {
+                assert(m->n_links_online > 0);
+                m->n_links_online--;
+        }
+
+        l->accounted = false;
+}
+
+void manager_update_link(Manager *m, Link *l) {
+        assert(m);
+        assert(l);
+
+        /* Re-evaluates a single link after its state changed, so that manager_configured() does not need
+         * to look at all links again. */
+
+        manager_unaccount_link(m, l);
+
+        if (!hashmap_isempty(m->interfaces))
+                return;
+
+        if (manager_ignore_link(m, l)) {
+                log_link_debug(l, "link is ignored");
+                return;
+        }
+
+        l->online = manager_link_is_online(m, l, _LINK_OPERSTATE_INVALID);
+        if (l->online < 0)
+                m->n_links_pending++;
+        else if (l->online > 0)
+                m->n_links_online++;
+
+        l->accounted = true;
+}
+
 bool manager_configured(Manager *m) {
         bool one_ready = false;
         Iterator i;
         const char *ifname;
         void *p;
         Link *l;
-        int r;
 
         if (!hashmap_isempty(m->interfaces)) {
                 /* wait for all the links given on the command line to appear */
@@ -96,22 +139,25 @@ bool manager_configured(Manager *m) {
 
         /* wait for all links networkd manages to be in admin state 'configured'
          * and at least one link to gain a carrier */
-        HASHMAP_FOREACH(l, m->links, i) {
-                if (manager_ignore_link(m, l)) {
-                        log_link_debug(l, "link is ignored");
-                        continue;
-                }
+        if (m->n_links_pending > 0 && !m->any)
+                return false;
 
-                r = manager_link_is_online(m, l, _LINK_OPERSTATE_INVALID);
-                if (r < 0 && !m->any)
-                        return false;
-                if (r > 0)
-                        /* we wait for at least one link to be ready,
-                         * regardless of who manages it */
-                        one_ready = true;
-        }
+        /* we wait for at least one link to be ready,
+         * regardless of who manages it */
+        return m->n_links_online > 0;
+}
+
+static void manager_update_link_monitor(Manager *m, Link *l) {
+        int r;
 
-        return one_ready;
+        assert(m);
+        assert(l);
+
+        r = link_update_monitor(l);
+        if (r < 0 && r != -ENODATA)
+                log_link_warning_errno(l, r, "Failed to update link state, ignoring: %m");
+
+        manager_update_link(m, l);
 }
 
 static int manager_process_link(sd_netlink *rtnl, sd_netlink_message *mm, void *userdata) {
@@ -163,10 +209,7 @@ static int manager_process_link(sd_netlink *rtnl, sd_netlink_message *mm, void *
                 if (r < 0)
                         log_link_warning_errno(l, r, "Failed to process RTNL link message, ignoring: %m");
 
-                r = link_update_monitor(l);
-                if (r < 0 && r != -ENODATA)
-                        log_link_warning_errno(l, r, "Failed to update link state, ignoring: %m");
-
+                manager_update_link_monitor(m, l);
                 break;
 
         case RTM_DELLINK:
@@ -242,20 +285,30 @@ static int manager_rtnl_listen(Manager *m) {
 }
 
 static int on_network_event(sd_event_source *s, int fd, uint32_t revents, void *userdata) {
+        _cleanup_set_free_ Set *changed = NULL;
         Manager *m = userdata;
         Iterator i;
+        void *p;
         Link *l;
         int r;
 
         assert(m);
 
-        sd_network_monitor_flush(m->network_monitor);
-
-        HASHMAP_FOREACH(l, m->links, i) {
-                r = link_update_monitor(l);
-                if (r < 0 && r != -ENODATA)
-                        log_link_warning_errno(l, r, "Failed to update link state, ignoring: %m");
-        }
+        /* Only re-read the state files of the links that actually changed, there might be thousands of
+         * links of which only one is of interest. */
+        r = network_monitor_flush_links(m->network_monitor, &changed);
+        if (r != 0) {
+                if (r < 0)
+                        log_warning_errno(r, "Failed to determine changed links, rescanning all of them: %m");
+
+                HASHMAP_FOREACH(l, m->links, i)
+                        manager_update_link_monitor(m, l);
+        } else
+                SET_FOREACH(p, changed, i) {
+                        l = hashmap_get(m->links, p);
+                        if (l)
+                                manager_update_link_monitor(m, l);
+                }
 
         if (manager_configured(m))
                 sd_event_exit(m->event, 0);
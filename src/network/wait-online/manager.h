@@ -16,6 +16,11 @@ struct Manager {
         Hashmap *links;
         Hashmap *links_by_name;
 
+        /* Links that are neither loopback nor ignored, and which are not processed yet, or online. Only
+         * maintained when no interfaces are given on the command line. */
+        unsigned n_links_pending;
+        unsigned n_links_online;
+
         /* Do not free the two members below. */
         Hashmap *interfaces;
         char **ignore;
@@ -40,3 +45,5 @@ int manager_new(Manager **ret, Hashmap *interfaces, char **ignore,
 DEFINE_TRIVIAL_CLEANUP_FUNC(Manager*, manager_free);
 
 bool manager_configured(Manager *m);
+void manager_update_link(Manager *m, Link *l);
+void manager_unaccount_link(Manager *m, Link *l);
@@ -52,6 +52,61 @@ static int remove_one_link(sd_netlink *rtnl, const char *name) {
         return 1;
 }
 
+static sd_netlink_message **netlink_message_unref_many(sd_netlink_message **l) {
+        sd_netlink_message **i;
+
+        for (i = l; i && *i; i++)
+                sd_netlink_message_unref(*i);
+
+        return mfree(l);
+}
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(sd_netlink_message**, netlink_message_unref_many);
+
+static int netlink_call_many(sd_netlink *rtnl, sd_netlink_message **messages, int *ret_errors) {
+        _cleanup_free_ uint32_t *serials = NULL;
+        size_t n, i;
+        int r;
+
+        assert(rtnl);
+        assert(ret_errors);
+
+        /* Passes all messages of the NULL terminated array to the kernel in one go, and only then collects the
+         * replies, so that setting up many interfaces doesn't cost a round trip each. The result of each
+         * message is stored in ret_errors, transport failures are returned. */
+
+        n = 0;
+        while (messages && messages[n])
+                n++;
+        if (n == 0)
+                return 0;
+
+        serials = new(uint32_t, n);
+        if (!serials)
+                return log_oom();
+
+        r = sd_netlink_batch_begin(rtnl);
+        if (r < 0)
+                return log_error_errno(r, "Failed to start netlink batch: %m");
+
+        for (i = 0; i < n; i++) {
+                r = sd_netlink_send(rtnl, messages[i], serials + i);
+                if (r < 0) {
+                        (void) sd_netlink_batch_end(rtnl);
+                        return log_error_errno(r, "Failed to queue netlink message: %m");
+                }
+        }
+
+        r = sd_netlink_batch_end(rtnl);
+        if (r < 0)
+                return log_error_errno(r, "Failed to send netlink messages: %m");
+
+        for (i = 0; i < n; i++)
+                ret_errors[i] = sd_netlink_read(rtnl, serials[i], 0, NULL);
+
+        return 0;
+}
+
 static int generate_mac(
                 const char *machine_name,
                 struct ether_addr *mac,
@@ -97,13 +152,14 @@ static int generate_mac(
         return 0;
 }
 
-static int add_veth(
+static int veth_message_new(
                 sd_netlink *rtnl,
                 pid_t pid,
                 const char *ifname_host,
                 const struct ether_addr *mac_host,
                 const char *ifname_container,
-                const struct ether_addr *mac_container) {
+                const struct ether_addr *mac_container,
+                sd_netlink_message **ret) {
 
         _cleanup_(sd_netlink_message_unrefp) sd_netlink_message *m = NULL;
         int r;
@@ -113,6 +169,7 @@ static int add_veth(
         assert(mac_host);
         assert(ifname_container);
         assert(mac_container);
+        assert(ret);
 
         r = sd_rtnl_message_new_link(rtnl, &m, RTM_NEWLINK, 0);
         if (r < 0)
@@ -162,22 +219,21 @@ static int add_veth(
         if (r < 0)
                 return log_error_errno(r, "Failed to close netlink container: %m");
 
-        r = sd_netlink_call(rtnl, m, 0, NULL);
-        if (r < 0)
-                return log_error_errno(r, "Failed to add new veth interfaces (%s:%s): %m", ifname_host, ifname_container);
-
+        *ret = TAKE_PTR(m);
         return 0;
 }
 
-int setup_veth(const char *machine_name,
+int setup_veth(sd_netlink *rtnl,
+               const char *machine_name,
                pid_t pid,
                char iface_name[IFNAMSIZ],
                bool bridge) {
 
-        _cleanup_(sd_netlink_unrefp) sd_netlink *rtnl = NULL;
+        _cleanup_(sd_netlink_message_unrefp) sd_netlink_message *m = NULL;
         struct ether_addr mac_host, mac_container;
         int r, i;
 
+        assert(rtnl);
         assert(machine_name);
         assert(pid > 0);
         assert(iface_name);
@@ -195,13 +251,13 @@ int setup_veth(const char *machine_name,
         if (r < 0)
                 return log_error_errno(r, "Failed to generate predictable MAC address for host side: %m");
 
-        r = sd_netlink_open(&rtnl);
+        r = veth_message_new(rtnl, pid, iface_name, &mac_host, "host0", &mac_container, &m);
         if (r < 0)
-                return log_error_errno(r, "Failed to connect to netlink: %m");
+                return r;
 
-        r = add_veth(rtnl, pid, iface_name, &mac_host, "host0", &mac_container);
+        r = sd_netlink_call(rtnl, m, 0, NULL);
         if (r < 0)
-                return r;
+                return log_error_errno(r, "Failed to add new veth interfaces (%s:%s): %m", iface_name, "host0");
 
         r = parse_ifindex_or_ifname(iface_name, &i);
         if (r < 0)
@@ -211,24 +267,30 @@ int setup_veth(const char *machine_name,
 }
 
 int setup_veth_extra(
+                sd_netlink *rtnl,
                 const char *machine_name,
                 pid_t pid,
                 char **pairs) {
 
-        _cleanup_(sd_netlink_unrefp) sd_netlink *rtnl = NULL;
+        _cleanup_(netlink_message_unref_manyp) sd_netlink_message **messages = NULL;
+        _cleanup_free_ int *errors = NULL;
         uint64_t idx = 0;
+        size_t n;
         char **a, **b;
         int r;
 
+        assert(rtnl);
         assert(machine_name);
         assert(pid > 0);
 
         if (strv_isempty(pairs))
                 return 0;
 
-        r = sd_netlink_open(&rtnl);
-        if (r < 0)
-                return log_error_errno(r, "Failed to connect to netlink: %m");
+        n = strv_length(pairs) / 2;
+        messages = new0(sd_netlink_message*, n + 1);
+        errors = new(int, n);
+        if (!messages || !errors)
+                return log_oom();
 
         STRV_FOREACH_PAIR(a, b, pairs) {
                 struct ether_addr mac_host, mac_container;
@@ -241,13 +303,24 @@ int setup_veth_extra(
                 if (r < 0)
                         return log_error_errno(r, "Failed to generate predictable MAC address for container side of extra veth link: %m");
 
-                r = add_veth(rtnl, pid, *a, &mac_host, *b, &mac_container);
+                r = veth_message_new(rtnl, pid, *a, &mac_host, *b, &mac_container, messages + idx);
                 if (r < 0)
                         return r;
 
                 idx++;
         }
 
+        r = netlink_call_many(rtnl, messages, errors);
+        if (r < 0)
+                return r;
+
+        idx = 0;
+        STRV_FOREACH_PAIR(a, b, pairs) {
+                if (errors[idx] < 0)
+                        return log_error_errno(errors[idx], "Failed to add new veth interfaces (%s:%s): %m", *a, *b);
+                idx++;
+        }
+
         return 0;
 }
 
@@ -321,19 +394,15 @@ static int create_bridge(sd_netlink *rtnl, const char *bridge_name) {
         return 0;
 }
 
-int setup_bridge(const char *veth_name, const char *bridge_name, bool create) {
+int setup_bridge(sd_netlink *rtnl, const char *veth_name, const char *bridge_name, bool create) {
         _cleanup_(release_lock_file) LockFile bridge_lock = LOCK_FILE_INIT;
-        _cleanup_(sd_netlink_unrefp) sd_netlink *rtnl = NULL;
         int r, bridge_ifi;
         unsigned n = 0;
 
+        assert(rtnl);
         assert(veth_name);
         assert(bridge_name);
 
-        r = sd_netlink_open(&rtnl);
-        if (r < 0)
-                return log_error_errno(r, "Failed to connect to netlink: %m");
-
         if (create) {
                 /* We take a system-wide lock here, so that we can safely check whether there's still a member in the
                  * bridge before removing it, without risking interference from other nspawn instances. */
@@ -428,17 +497,22 @@ static int parse_interface(const char *name) {
         return ifi;
 }
 
-int move_network_interfaces(pid_t pid, char **ifaces) {
-        _cleanup_(sd_netlink_unrefp) sd_netlink *rtnl = NULL;
+int move_network_interfaces(sd_netlink *rtnl, pid_t pid, char **ifaces) {
+        _cleanup_(netlink_message_unref_manyp) sd_netlink_message **messages = NULL;
+        _cleanup_free_ int *errors = NULL;
+        size_t k = 0;
         char **i;
         int r;
 
+        assert(rtnl);
+
         if (strv_isempty(ifaces))
                 return 0;
 
-        r = sd_netlink_open(&rtnl);
-        if (r < 0)
-                return log_error_errno(r, "Failed to connect to netlink: %m");
+        messages = new0(sd_netlink_message*, strv_length(ifaces) + 1);
+        errors = new(int, strv_length(ifaces));
+        if (!messages || !errors)
+                return log_oom();
 
         STRV_FOREACH(i, ifaces) {
                 _cleanup_(sd_netlink_message_unrefp) sd_netlink_message *m = NULL;
@@ -456,26 +530,40 @@ int move_network_interfaces(pid_t pid, char **ifaces) {
                 if (r < 0)
                         return log_error_errno(r, "Failed to append namespace PID to netlink message: %m");
 
-                r = sd_netlink_call(rtnl, m, 0, NULL);
-                if (r < 0)
-                        return log_error_errno(r, "Failed to move interface %s to namespace: %m", *i);
+                messages[k++] = TAKE_PTR(m);
+        }
+
+        r = netlink_call_many(rtnl, messages, errors);
+        if (r < 0)
+                return r;
+
+        k = 0;
+        STRV_FOREACH(i, ifaces) {
+                if (errors[k] < 0)
+                        return log_error_errno(errors[k], "Failed to move interface %s to namespace: %m", *i);
+                k++;
         }
 
         return 0;
 }
 
-int setup_macvlan(const char *machine_name, pid_t pid, char **ifaces) {
-        _cleanup_(sd_netlink_unrefp) sd_netlink *rtnl = NULL;
+int setup_macvlan(sd_netlink *rtnl, const char *machine_name, pid_t pid, char **ifaces) {
+        _cleanup_(netlink_message_unref_manyp) sd_netlink_message **messages = NULL;
+        _cleanup_free_ int *errors = NULL;
         unsigned idx = 0;
+        size_t k = 0;
         char **i;
         int r;
 
+        assert(rtnl);
+
         if (strv_isempty(ifaces))
                 return 0;
 
-        r = sd_netlink_open(&rtnl);
-        if (r < 0)
-                return log_error_errno(r, "Failed to connect to netlink: %m");
+        messages = new0(sd_netlink_message*, strv_length(ifaces) + 1);
+        errors = new(int, strv_length(ifaces));
+        if (!messages || !errors)
+                return log_oom();
 
         STRV_FOREACH(i, ifaces) {
                 _cleanup_(sd_netlink_message_unrefp) sd_netlink_message *m = NULL;
@@ -537,25 +625,39 @@ int setup_macvlan(const char *machine_name, pid_t pid, char **ifaces) {
                 if (r < 0)
                         return log_error_errno(r, "Failed to close netlink container: %m");
 
-                r = sd_netlink_call(rtnl, m, 0, NULL);
-                if (r < 0)
-                        return log_error_errno(r, "Failed to add new macvlan interfaces: %m");
+                messages[k++] = TAKE_PTR(m);
+        }
+
+        r = netlink_call_many(rtnl, messages, errors);
+        if (r < 0)
+                return r;
+
+        k = 0;
+        STRV_FOREACH(i, ifaces) {
+                if (errors[k] < 0)
+                        return log_error_errno(errors[k], "Failed to add new macvlan interface for %s: %m", *i);
+                k++;
         }
 
         return 0;
 }
 
-int setup_ipvlan(const char *machine_name, pid_t pid, char **ifaces) {
-        _cleanup_(sd_netlink_unrefp) sd_netlink *rtnl = NULL;
+int setup_ipvlan(sd_netlink *rtnl, const char *machine_name, pid_t pid, char **ifaces) {
+        _cleanup_(netlink_message_unref_manyp) sd_netlink_message **messages = NULL;
+        _cleanup_free_ int *errors = NULL;
+        size_t k = 0;
         char **i;
         int r;
 
+        assert(rtnl);
+
         if (strv_isempty(ifaces))
                 return 0;
 
-        r = sd_netlink_open(&rtnl);
-        if (r < 0)
-                return log_error_errno(r, "Failed to connect to netlink: %m");
+        messages = new0(sd_netlink_message*, strv_length(ifaces) + 1);
+        errors = new(int, strv_length(ifaces));
+        if (!messages || !errors)
+                return log_oom();
 
         STRV_FOREACH(i, ifaces) {
                 _cleanup_(sd_netlink_message_unrefp) sd_netlink_message *m = NULL;
@@ -608,9 +710,18 @@ int setup_ipvlan(const char *machine_name, pid_t pid, char **ifaces) {
                 if (r < 0)
                         return log_error_errno(r, "Failed to close netlink container: %m");
 
-                r = sd_netlink_call(rtnl, m, 0, NULL);
-                if (r < 0)
-                        return log_error_errno(r, "Failed to add new ipvlan interfaces: %m");
+                messages[k++] = TAKE_PTR(m);
+        }
+
+        r = netlink_call_many(rtnl, messages, errors);
+        if (r < 0)
+                return r;
+
+        k = 0;
+        STRV_FOREACH(i, ifaces) {
+                if (errors[k] < 0)
+                        return log_error_errno(errors[k], "Failed to add new ipvlan interface for %s: %m", *i);
+                k++;
         }
 
         return 0;
@@ -5,16 +5,18 @@
 #include <stdbool.h>
 #include <sys/types.h>
 
-int setup_veth(const char *machine_name, pid_t pid, char iface_name[IFNAMSIZ], bool bridge);
-int setup_veth_extra(const char *machine_name, pid_t pid, char **pairs);
+#include "sd-netlink.h"
 
-int setup_bridge(const char *veth_name, const char *bridge_name, bool create);
+int setup_veth(sd_netlink *rtnl, const char *machine_name, pid_t pid, char iface_name[IFNAMSIZ], bool bridge);
+int setup_veth_extra(sd_netlink *rtnl, const char *machine_name, pid_t pid, char **pairs);
+
+int setup_bridge(sd_netlink *rtnl, const char *veth_name, const char *bridge_name, bool create);
 int remove_bridge(const char *bridge_name);
 
-int setup_macvlan(const char *machine_name, pid_t pid, char **ifaces);
-int setup_ipvlan(const char *machine_name, pid_t pid, char **ifaces);
+int setup_macvlan(sd_netlink *rtnl, const char *machine_name, pid_t pid, char **ifaces);
+int setup_ipvlan(sd_netlink *rtnl, const char *machine_name, pid_t pid, char **ifaces);
 
-int move_network_interfaces(pid_t pid, char **ifaces);
+int move_network_interfaces(sd_netlink *rtnl, pid_t pid, char **ifaces);
 
 int veth_extra_parse(char ***l, const char *p);
 
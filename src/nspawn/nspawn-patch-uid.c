@@ -6,18 +6,29 @@
 #include <unistd.h>
 
 #include "acl-util.h"
+#include "cpu-set-util.h"
 #include "dirent-util.h"
 #include "fd-util.h"
 #include "fs-util.h"
 #include "missing_magic.h"
 #include "nspawn-def.h"
 #include "nspawn-patch-uid.h"
+#include "process-util.h"
 #include "stat-util.h"
 #include "stdio-util.h"
 #include "string-util.h"
 #include "strv.h"
 #include "user-util.h"
 
+/* Directories at this depth below the top-level directory are patched in worker processes, up to
+ * PATCH_WORKERS_MAX at a time. Two levels down from an OS tree's root we usually find plenty of
+ * similarly sized subtrees (/usr/lib, /usr/share, /var/lib, …). */
+#define PATCH_FANOUT_DEPTH 2U
+#define PATCH_WORKERS_MAX 16U
+
+/* The exit code of a worker that changed something */
+#define PATCH_EXIT_CHANGED 2
+
 #if HAVE_ACL
 
 static int get_acl(int fd, const char *name, acl_type_t type, acl_t *ret) {
@@ -242,16 +253,19 @@ static int patch_fd(int fd, const char *name, const struct stat *st, uid_t shift
                 if (r < 0)
                         return -errno;
 
-                /* The Linux kernel alters the mode in some cases of chown(). Let's undo this. */
-                if (name) {
-                        if (!S_ISLNK(st->st_mode))
-                                r = fchmodat(fd, name, st->st_mode, 0);
-                        else /* AT_SYMLINK_NOFOLLOW is not available for fchmodat() */
-                                r = 0;
-                } else
-                        r = fchmod(fd, st->st_mode);
-                if (r < 0)
-                        return -errno;
+                /* The Linux kernel drops the SUID/SGID bits on chown(). Let's undo this. Other bits are left
+                 * alone, hence we can skip this for the vast majority of inodes. */
+                if ((st->st_mode & (S_ISUID|S_ISGID)) != 0) {
+                        if (name) {
+                                if (!S_ISLNK(st->st_mode))
+                                        r = fchmodat(fd, name, st->st_mode, 0);
+                                else /* AT_SYMLINK_NOFOLLOW is not available for fchmodat() */
+                                        r = 0;
+                        } else
+                                r = fchmod(fd, st->st_mode);
+                        if (r < 0)
+                                return -errno;
+                }
 
                 changed = true;
         }
@@ -291,11 +305,99 @@ static int is_fs_fully_userns_compatible(const struct statfs *sfs) {
                F_TYPE_EQUAL(sfs->f_type, SYSFS_MAGIC);
 }
 
-static int recurse_fd(int fd, bool donate_fd, const struct stat *st, uid_t shift, bool is_toplevel) {
+static bool is_shifted(const struct stat *st, uid_t shift) {
+        assert(st);
+
+        return ((uint32_t) (st->st_uid ^ shift) >> 16) == 0 &&
+               ((uint32_t) (st->st_gid ^ shift) >> 16) == 0;
+}
+
+typedef struct PatchJobs {
+        pid_t pids[PATCH_WORKERS_MAX];
+        unsigned n_pids;
+        unsigned n_workers;
+} PatchJobs;
+
+static int patch_jobs_wait_one(PatchJobs *jobs, bool *changed) {
+        int r;
+
+        assert(jobs);
+        assert(jobs->n_pids > 0);
+        assert(changed);
+
+        /* Waits for the oldest worker, they are all expected to take roughly the same time anyway */
+
+        r = wait_for_terminate_and_check("(sd-patchuid)", jobs->pids[0], 0);
+        memmove(jobs->pids, jobs->pids + 1, --jobs->n_pids * sizeof(pid_t));
+        if (r < 0)
+                return r;
+        if (r == PATCH_EXIT_CHANGED) {
+                *changed = true;
+                return 0;
+        }
+        if (r != EXIT_SUCCESS)
+                return -EPROTO;
+
+        return 0;
+}
+
+static int patch_jobs_wait_all(PatchJobs *jobs, bool *changed) {
+        int r = 0, q;
+
+        assert(jobs);
+
+        while (jobs->n_pids > 0) {
+                q = patch_jobs_wait_one(jobs, changed);
+                if (q < 0 && r >= 0)
+                        r = q;
+        }
+
+        return r;
+}
+
+static int recurse_fd(int fd, bool donate_fd, const struct stat *st, uid_t shift, unsigned depth, unsigned n_workers, bool resuming);
+
+static int patch_jobs_start(PatchJobs *jobs, int fd, const struct stat *st, uid_t shift, unsigned depth, bool resuming, bool *changed) {
+        pid_t pid;
+        int r;
+
+        assert(jobs);
+        assert(fd >= 0);
+
+        /* Takes possession of fd */
+
+        if (jobs->n_pids >= jobs->n_workers) {
+                r = patch_jobs_wait_one(jobs, changed);
+                if (r < 0) {
+                        safe_close(fd);
+                        return r;
+                }
+        }
+
+        r = safe_fork("(sd-patchuid)", FORK_DEATHSIG|FORK_LOG, &pid);
+        if (r < 0) {
+                safe_close(fd);
+                return r;
+        }
+        if (r == 0) {
+                /* Child */
+                r = recurse_fd(fd, true, st, shift, depth, 0, resuming);
+                _exit(r < 0 ? EXIT_FAILURE : r > 0 ? PATCH_EXIT_CHANGED : EXIT_SUCCESS);
+        }
+
+        safe_close(fd);
+        jobs->pids[jobs->n_pids++] = pid;
+        return 0;
+}
+
+static int recurse_fd(int fd, bool donate_fd, const struct stat *st, uid_t shift, unsigned depth, unsigned n_workers, bool resuming) {
         _cleanup_closedir_ DIR *d = NULL;
+        PatchJobs jobs = {
+                .n_workers = n_workers,
+        };
         bool changed = false;
         struct statfs sfs;
-        int r;
+        int r, q;
 
         assert(fd >= 0);
 
@@ -356,6 +458,12 @@ static int recurse_fd(int fd, bool donate_fd, const struct stat *st, uid_t shift
                         if (S_ISDIR(fst.st_mode)) {
                                 int subdir_fd;
 
+                                /* Directories are patched after everything below them. Hence, if we continue
+                                 * where an earlier, interrupted run left off, a directory that is already
+                                 * shifted has been fully taken care of. */
+                                if (resuming && is_shifted(&fst, shift))
+                                        continue;
+
                                 subdir_fd = openat(dirfd(d), de->d_name, O_RDONLY|O_NONBLOCK|O_DIRECTORY|O_CLOEXEC|O_NOFOLLOW|O_NOATIME);
                                 if (subdir_fd < 0) {
                                         r = -errno;
@@ -363,7 +471,15 @@ static int recurse_fd(int fd, bool donate_fd, const struct stat *st, uid_t shift
 
                                 }
 
-                                r = recurse_fd(subdir_fd, true, &fst, shift, false);
+                                if (n_workers > 1 && depth + 1 == PATCH_FANOUT_DEPTH) {
+                                        r = patch_jobs_start(&jobs, subdir_fd, &fst, shift, depth + 1, resuming, &changed);
+                                        if (r < 0)
+                                                goto finish;
+
+                                        continue;
+                                }
+
+                                r = recurse_fd(subdir_fd, true, &fst, shift, depth + 1, n_workers, resuming);
                                 if (r < 0)
                                         goto finish;
                                 if (r > 0)
@@ -379,6 +495,10 @@ static int recurse_fd(int fd, bool donate_fd, const struct stat *st, uid_t shift
                 }
         }
 
+        r = patch_jobs_wait_all(&jobs, &changed);
+        if (r < 0)
+                goto finish;
+
         /* After we descended, also patch the directory itself. It's key to do this in this order so that the top-level
          * directory is patched as very last object in the tree, so that we can use it as quick indicator whether the
          * tree is properly chown()ed already. */
@@ -392,7 +512,7 @@ static int recurse_fd(int fd, bool donate_fd, const struct stat *st, uid_t shift
         goto finish;
 
 read_only:
-        if (!is_toplevel) {
+        if (depth > 0) {
                 _cleanup_free_ char *name = NULL;
 
                 /* When we hit a ready-only subtree we simply skip it, but log about it. */
@@ -402,6 +522,11 @@ read_only:
         }
 
 finish:
+        /* Don't leave any workers behind on failure */
+        q = patch_jobs_wait_all(&jobs, &changed);
+        if (q < 0 && r >= 0)
+                r = q;
+
         if (donate_fd)
                 safe_close(fd);
 
@@ -409,8 +534,9 @@ finish:
 }
 
 static int fd_patch_uid_internal(int fd, bool donate_fd, uid_t shift, uid_t range) {
+        bool resuming;
         struct stat st;
-        int r;
+        int r, n;
 
         assert(fd >= 0);
 
@@ -452,6 +578,10 @@ static int fd_patch_uid_internal(int fd, bool donate_fd, uid_t shift, uid_t rang
         if (((uint32_t) (st.st_uid ^ shift) >> 16) == 0)
                 return 0;
 
+        /* If the top-level dir is still marked as busy, an earlier run was interrupted, and we can skip the
+         * parts it completed */
+        resuming = (st.st_uid & UID_BUSY_MASK) == UID_BUSY_BASE;
+
         /* Before we start recursively chowning, mark the top-level dir as "busy" by chowning it to the "busy"
          * range. Should we be interrupted in the middle of our work, we'll see it owned by this user and will start
          * chown()ing it again, unconditionally, as the busy UID is not a valid UID we'd everpick for ourselves. */
@@ -465,7 +595,11 @@ static int fd_patch_uid_internal(int fd, bool donate_fd, uid_t shift, uid_t rang
                 }
         }
 
-        return recurse_fd(fd, donate_fd, &st, shift, true);
+        n = cpus_in_affinity_mask();
+        if (n < 0)
+                n = 1;
+
+        return recurse_fd(fd, donate_fd, &st, shift, 0, MIN((unsigned) n, PATCH_WORKERS_MAX), resuming);
 
 finish:
         if (donate_fd)
@@ -4403,18 +4403,25 @@ static int run_container(
         }
 
         if (arg_private_network) {
+                _cleanup_(sd_netlink_unrefp) sd_netlink *host_rtnl = NULL;
+
                 if (!arg_network_namespace_path) {
                         /* Wait until the child has unshared its network namespace. */
                         if (!barrier_place_and_sync(&barrier)) /* #3 */
                                 return log_error_errno(SYNTHETIC_ERRNO(ESRCH), "Child died too early");
                 }
 
-                r = move_network_interfaces(*pid, arg_network_interfaces);
+                /* Share one netlink connection for setting up all interfaces */
+                r = sd_netlink_open(&host_rtnl);
+                if (r < 0)
+                        return log_error_errno(r, "Failed to connect to netlink: %m");
+
+                r = move_network_interfaces(host_rtnl, *pid, arg_network_interfaces);
                 if (r < 0)
                         return r;
 
                 if (arg_network_veth) {
-                        r = setup_veth(arg_machine, *pid, veth_name,
+                        r = setup_veth(host_rtnl, arg_machine, *pid, veth_name,
                                        arg_network_bridge || arg_network_zone);
                         if (r < 0)
                                 return r;
@@ -4423,14 +4430,14 @@ static int run_container(
 
                         if (arg_network_bridge) {
                                 /* Add the interface to a bridge */
-                                r = setup_bridge(veth_name, arg_network_bridge, false);
+                                r = setup_bridge(host_rtnl, veth_name, arg_network_bridge, false);
                                 if (r < 0)
                                         return r;
                                 if (r > 0)
                                         ifi = r;
                         } else if (arg_network_zone) {
                                 /* Add the interface to a bridge, possibly creating it */
-                                r = setup_bridge(veth_name, arg_network_zone, true);
+                                r = setup_bridge(host_rtnl, veth_name, arg_network_zone, true);
                                 if (r < 0)
                                         return r;
                                 if (r > 0)
@@ -4438,7 +4445,7 @@ static int run_container(
                         }
                 }
 
-                r = setup_veth_extra(arg_machine, *pid, arg_network_veth_extra);
+                r = setup_veth_extra(host_rtnl, arg_machine, *pid, arg_network_veth_extra);
                 if (r < 0)
                         return r;
 
@@ -4448,11 +4455,11 @@ static int run_container(
                    remove them on its own, since they cannot be referenced by anything yet. */
                 *veth_created = true;
 
-                r = setup_macvlan(arg_machine, *pid, arg_network_macvlan);
+                r = setup_macvlan(host_rtnl, arg_machine, *pid, arg_network_macvlan);
                 if (r < 0)
                         return r;
 
-                r = setup_ipvlan(arg_machine, *pid, arg_network_ipvlan);
+                r = setup_ipvlan(host_rtnl, arg_machine, *pid, arg_network_ipvlan);
                 if (r < 0)
                         return r;
         }
@@ -5002,7 +5009,7 @@ static int run(int argc, char *argv[]) {
 
                         {
                                 BLOCK_SIGNALS(SIGINT);
-                                r = copy_file(arg_image, np, O_EXCL, arg_read_only ? 0400 : 0600, FS_NOCOW_FL, FS_NOCOW_FL, COPY_REFLINK|COPY_CRTIME|COPY_SIGINT);
+                                r = copy_file(arg_image, np, O_EXCL, arg_read_only ? 0400 : 0600, FS_NOCOW_FL, FS_NOCOW_FL, COPY_REFLINK|COPY_CRTIME|COPY_SIGINT|COPY_HOLES);
                         }
                         if (r == -EINTR) {
                                 log_error_errno(r, "Interrupted while copying image file to %s, removed again.", np);
@@ -3,79 +3,256 @@
 #include <errno.h>
 #include <netdb.h>
 #include <nss.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <sys/types.h>
 #include <unistd.h>
 
-#include "sd-bus.h"
-
-#include "bus-common-errors.h"
 #include "errno-util.h"
 #include "in-addr-util.h"
 #include "macro.h"
 #include "nss-util.h"
+#include "process-util.h"
 #include "resolved-def.h"
 #include "signal-util.h"
 #include "string-util.h"
+#include "strv.h"
+#include "varlink.h"
 
 NSS_GETHOSTBYNAME_PROTOTYPES(resolve);
 NSS_GETHOSTBYADDR_PROTOTYPES(resolve);
 
-static bool bus_error_shall_fallback(sd_bus_error *e) {
-        return sd_bus_error_has_name(e, SD_BUS_ERROR_SERVICE_UNKNOWN) ||
-               sd_bus_error_has_name(e, SD_BUS_ERROR_NAME_HAS_NO_OWNER) ||
-               sd_bus_error_has_name(e, SD_BUS_ERROR_NO_REPLY) ||
-               sd_bus_error_has_name(e, SD_BUS_ERROR_ACCESS_DENIED) ||
-               sd_bus_error_has_name(e, SD_BUS_ERROR_DISCONNECTED) ||
-               sd_bus_error_has_name(e, SD_BUS_ERROR_TIMEOUT);
+static bool error_shall_fallback(const char *error_id) {
+        return STR_IN_SET(error_id,
+                          VARLINK_ERROR_DISCONNECTED,
+                          VARLINK_ERROR_TIMEOUT,
+                          VARLINK_ERROR_PROTOCOL,
+                          VARLINK_ERROR_INTERFACE_NOT_FOUND,
+                          VARLINK_ERROR_METHOD_NOT_FOUND,
+                          VARLINK_ERROR_METHOD_NOT_IMPLEMENTED);
 }
 
-static int count_addresses(sd_bus_message *m, int af, const char **canonical) {
-        int c = 0, r;
+/* Connecting to resolved is a good part of the cost of a lookup, and many programs resolve a number of names
+ * in a row. Hence, keep the connection of the last lookup around for the next one. Lookups running
+ * concurrently in other threads simply open a connection of their own. */
+static struct {
+        pthread_mutex_t mutex;
+        Varlink *link;
+        pid_t pid;
+} idle_connection = {
+        .mutex = PTHREAD_MUTEX_INITIALIZER,
+};
 
-        assert(m);
-        assert(canonical);
+static Varlink *idle_connection_take(void) {
+        Varlink *link;
 
-        r = sd_bus_message_enter_container(m, 'a', "(iiay)");
-        if (r < 0)
-                return r;
+        assert_se(pthread_mutex_lock(&idle_connection.mutex) == 0);
 
-        while ((r = sd_bus_message_enter_container(m, 'r', "iiay")) > 0) {
-                int family, ifindex;
+        link = TAKE_PTR(idle_connection.link);
 
-                assert_cc(sizeof(int32_t) == sizeof(int));
+        /* A connection inherited from our parent process is shared with it, never talk on it. Closing our
+         * copy of the socket doesn't affect the parent. */
+        if (link && idle_connection.pid != getpid_cached())
+                link = varlink_unref(link);
 
-                r = sd_bus_message_read(m, "ii", &ifindex, &family);
-                if (r < 0)
+        assert_se(pthread_mutex_unlock(&idle_connection.mutex) == 0);
+
+        return link;
+}
+
+static void idle_connection_put(Varlink *link) {
+        if (!link)
+                return;
+
+        assert_se(pthread_mutex_lock(&idle_connection.mutex) == 0);
+
+        if (!idle_connection.link) {
+                idle_connection.link = TAKE_PTR(link);
+                idle_connection.pid = getpid_cached();
+        }
+
+        assert_se(pthread_mutex_unlock(&idle_connection.mutex) == 0);
+
+        varlink_unref(link);
+}
+
+static void idle_connection_putp(Varlink **link) {
+        idle_connection_put(*link);
+}
+
+static int resolved_call(
+                Varlink **link,
+                const char *method,
+                JsonVariant *parameters,
+                JsonVariant **ret_parameters,
+                const char **ret_error_id) {
+
+        int r;
+
+        assert(link);
+        assert(!*link);
+
+        /* On success the reply is owned by the returned connection, which must be handed back to
+         * idle_connection_put() only once the reply has been consumed. */
+
+        for (;;) {
+                bool reused;
+
+                *link = idle_connection_take();
+                reused = *link;
+
+                if (!*link) {
+                        r = varlink_connect_address(link, "/run/systemd/resolve/io.systemd.Resolve");
+                        if (r < 0)
+                                return r;
+
+                        r = varlink_set_relative_timeout(*link, SD_RESOLVED_QUERY_TIMEOUT_USEC);
+                        if (r < 0)
+                                return r;
+                }
+
+                r = varlink_call(*link, method, parameters, ret_parameters, ret_error_id, NULL);
+                if (r >= 0)
                         return r;
 
-                r = sd_bus_message_skip(m, "ay");
-                if (r < 0)
+                *link = varlink_unref(*link);
+
+                /* resolved might have closed the idle connection in the meantime, try again with a new one */
+                if (!reused || !ERRNO_IS_DISCONNECT(r))
                         return r;
+        }
+}
+
+typedef struct ResolveHostnameReply {
+        JsonVariant *addresses;
+        char *name;
+        uint64_t flags;
+} ResolveHostnameReply;
+
+static void resolve_hostname_reply_destroy(ResolveHostnameReply *p) {
+        assert(p);
+
+        json_variant_unref(p->addresses);
+        free(p->name);
+}
+
+static const JsonDispatch resolve_hostname_reply_dispatch_table[] = {
+        { "addresses", JSON_VARIANT_ARRAY,    json_dispatch_variant, offsetof(ResolveHostnameReply, addresses), JSON_MANDATORY },
+        { "name",      JSON_VARIANT_STRING,   json_dispatch_string,  offsetof(ResolveHostnameReply, name),      0              },
+        { "flags",     JSON_VARIANT_UNSIGNED, json_dispatch_uint64,  offsetof(ResolveHostnameReply, flags),     0              },
+        {}
+};
+
+typedef struct AddressParameters {
+        int ifindex;
+        int family;
+        union in_addr_union address;
+        size_t address_size;
+} AddressParameters;
+
+static int json_dispatch_address(const char *name, JsonVariant *variant, JsonDispatchFlags flags, void *userdata) {
+        AddressParameters *p = userdata;
+        union in_addr_union buf = {};
+        JsonVariant *i;
+        size_t n, k = 0;
+
+        assert(variant);
+        assert(p);
+
+        if (!json_variant_is_array(variant))
+                return -EINVAL;
+
+        n = json_variant_elements(variant);
+        if (!IN_SET(n, 4, 16))
+                return -EINVAL;
 
-                r = sd_bus_message_exit_container(m);
+        JSON_VARIANT_ARRAY_FOREACH(i, variant) {
+                intmax_t b;
+
+                if (!json_variant_is_integer(i))
+                        return -EINVAL;
+
+                b = json_variant_integer(i);
+                if (b < 0 || b > 0xff)
+                        return -EINVAL;
+
+                ((uint8_t*) &buf)[k++] = (uint8_t) b;
+        }
+
+        p->address = buf;
+        p->address_size = k;
+
+        return 0;
+}
+
+static const JsonDispatch address_parameters_dispatch_table[] = {
+        { "ifindex", JSON_VARIANT_INTEGER, json_dispatch_int32,   offsetof(AddressParameters, ifindex), 0              },
+        { "family",  JSON_VARIANT_INTEGER, json_dispatch_int32,   offsetof(AddressParameters, family),  JSON_MANDATORY },
+        { "address", JSON_VARIANT_ARRAY,   json_dispatch_address, 0,                                    JSON_MANDATORY },
+        {}
+};
+
+typedef struct ResolveAddressReply {
+        JsonVariant *names;
+        uint64_t flags;
+} ResolveAddressReply;
+
+static void resolve_address_reply_destroy(ResolveAddressReply *p) {
+        assert(p);
+
+        json_variant_unref(p->names);
+}
+
+static const JsonDispatch resolve_address_reply_dispatch_table[] = {
+        { "names", JSON_VARIANT_ARRAY,    json_dispatch_variant, offsetof(ResolveAddressReply, names), JSON_MANDATORY },
+        { "flags", JSON_VARIANT_UNSIGNED, json_dispatch_uint64,  offsetof(ResolveAddressReply, flags), 0              },
+        {}
+};
+
+typedef struct NameParameters {
+        int ifindex;
+        char *name;
+} NameParameters;
+
+static void name_parameters_destroy(NameParameters *p) {
+        assert(p);
+
+        free(p->name);
+}
+
+static const JsonDispatch name_parameters_dispatch_table[] = {
+        { "ifindex", JSON_VARIANT_INTEGER, json_dispatch_int32,  offsetof(NameParameters, ifindex), 0              },
+        { "name",    JSON_VARIANT_STRING,  json_dispatch_string, offsetof(NameParameters, name),    JSON_MANDATORY },
+        {}
+};
+
+static int count_addresses(JsonVariant *addresses, int af) {
+        JsonVariant *entry;
+        int c = 0, r;
+
+        /* Validates all entries, and counts those of the requested family */
+
+        JSON_VARIANT_ARRAY_FOREACH(entry, addresses) {
+                AddressParameters p = {};
+
+                r = json_dispatch(entry, address_parameters_dispatch_table, NULL, 0, &p);
                 if (r < 0)
                         return r;
 
-                if (af != AF_UNSPEC && family != af)
-                        continue;
+                if (p.ifindex < 0)
+                        return -EINVAL;
 
-                c++;
-        }
-        if (r < 0)
-                return r;
+                if (!IN_SET(p.family, AF_INET, AF_INET6))
+                        continue;
 
-        r = sd_bus_message_exit_container(m);
-        if (r < 0)
-                return r;
+                if (p.address_size != FAMILY_ADDRESS_SIZE(p.family))
+                        return -EINVAL;
 
-        r = sd_bus_message_read(m, "s", canonical);
-        if (r < 0)
-                return r;
+                if (af != AF_UNSPEC && p.family != af)
+                        continue;
 
-        r = sd_bus_message_rewind(m, true);
-        if (r < 0)
-                return r;
+                c++;
+        }
 
         return c;
 }
@@ -115,11 +292,12 @@ enum nss_status _nss_resolve_gethostbyname4_r(
                 int *errnop, int *h_errnop,
                 int32_t *ttlp) {
 
-        _cleanup_(sd_bus_message_unrefp) sd_bus_message *req = NULL, *reply = NULL;
-        _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
+        _cleanup_(idle_connection_putp) Varlink *link = NULL; /* must be released last, the reply is owned by it */
+        _cleanup_(resolve_hostname_reply_destroy) ResolveHostnameReply p = {};
+        _cleanup_(json_variant_unrefp) JsonVariant *cparams = NULL;
         struct gaih_addrtuple *r_tuple, *r_tuple_first = NULL;
-        _cleanup_(sd_bus_flush_close_unrefp) sd_bus *bus = NULL;
-        const char *canonical = NULL;
+        JsonVariant *rparams, *entry;
+        const char *canonical = NULL, *error_id;
         size_t l, ms, idx;
         char *r_name;
         int c, r, i = 0;
@@ -138,31 +316,15 @@ enum nss_status _nss_resolve_gethostbyname4_r(
                 goto fail;
         }
 
-        r = sd_bus_open_system(&bus);
+        r = json_build(&cparams, JSON_BUILD_OBJECT(JSON_BUILD_PAIR("name", JSON_BUILD_STRING(name))));
         if (r < 0)
                 goto fail;
 
-        r = sd_bus_message_new_method_call(
-                        bus,
-                        &req,
-                        "org.freedesktop.resolve1",
-                        "/org/freedesktop/resolve1",
-                        "org.freedesktop.resolve1.Manager",
-                        "ResolveHostname");
+        r = resolved_call(&link, "io.systemd.Resolve.ResolveHostname", cparams, &rparams, &error_id);
         if (r < 0)
                 goto fail;
-
-        r = sd_bus_message_set_auto_start(req, false);
-        if (r < 0)
-                goto fail;
-
-        r = sd_bus_message_append(req, "isit", 0, name, AF_UNSPEC, (uint64_t) 0);
-        if (r < 0)
-                goto fail;
-
-        r = sd_bus_call(bus, req, SD_RESOLVED_QUERY_TIMEOUT_USEC, &error, &reply);
-        if (r < 0) {
-                if (!bus_error_shall_fallback(&error))
+        if (!isempty(error_id)) {
+                if (!error_shall_fallback(error_id))
                         goto not_found;
 
                 /* Return NSS_STATUS_UNAVAIL when communication with systemd-resolved fails,
@@ -170,10 +332,15 @@ enum nss_status _nss_resolve_gethostbyname4_r(
                    NOTFOUND. This includes DNSSEC errors and suchlike. (We don't use UNAVAIL in this
                    case so that the nsswitch.conf configuration can distinguish such executed but
                    negative replies from complete failure to talk to resolved). */
+                r = -ECONNREFUSED;
                 goto fail;
         }
 
-        c = count_addresses(reply, AF_UNSPEC, &canonical);
+        r = json_dispatch(rparams, resolve_hostname_reply_dispatch_table, NULL, 0, &p);
+        if (r < 0)
+                goto fail;
+
+        c = count_addresses(p.addresses, AF_UNSPEC);
         if (c < 0) {
                 r = c;
                 goto fail;
@@ -181,8 +348,7 @@ enum nss_status _nss_resolve_gethostbyname4_r(
         if (c == 0)
                 goto not_found;
 
-        if (isempty(canonical))
-                canonical = name;
+        canonical = isempty(p.name) ? name : p.name;
 
         l = strlen(canonical);
         ms = ALIGN(l+1) + ALIGN(sizeof(struct gaih_addrtuple)) * c;
@@ -201,54 +367,25 @@ enum nss_status _nss_resolve_gethostbyname4_r(
         /* Second, append addresses */
         r_tuple_first = (struct gaih_addrtuple*) (buffer + idx);
 
-        r = sd_bus_message_enter_container(reply, 'a', "(iiay)");
-        if (r < 0)
-                goto fail;
-
-        while ((r = sd_bus_message_enter_container(reply, 'r', "iiay")) > 0) {
-                int family, ifindex;
-                const void *a;
-                size_t sz;
-
-                assert_cc(sizeof(int32_t) == sizeof(int));
-
-                r = sd_bus_message_read(reply, "ii", &ifindex, &family);
-                if (r < 0)
-                        goto fail;
-
-                if (ifindex < 0) {
-                        r = -EINVAL;
-                        goto fail;
-                }
+        JSON_VARIANT_ARRAY_FOREACH(entry, p.addresses) {
+                AddressParameters q = {};
 
-                r = sd_bus_message_read_array(reply, 'y', &a, &sz);
-                if (r < 0)
-                        goto fail;
+                /* Already validated by count_addresses() above */
+                assert_se(json_dispatch(entry, address_parameters_dispatch_table, NULL, 0, &q) >= 0);
 
-                r = sd_bus_message_exit_container(reply);
-                if (r < 0)
-                        goto fail;
-
-                if (!IN_SET(family, AF_INET, AF_INET6))
+                if (!IN_SET(q.family, AF_INET, AF_INET6))
                         continue;
 
-                if (sz != FAMILY_ADDRESS_SIZE(family)) {
-                        r = -EINVAL;
-                        goto fail;
-                }
-
                 r_tuple = (struct gaih_addrtuple*) (buffer + idx);
                 r_tuple->next = i == c-1 ? NULL : (struct gaih_addrtuple*) ((char*) r_tuple + ALIGN(sizeof(struct gaih_addrtuple)));
                 r_tuple->name = r_name;
-                r_tuple->family = family;
-                r_tuple->scopeid = ifindex_to_scopeid(family, a, ifindex);
-                memcpy(r_tuple->addr, a, sz);
+                r_tuple->family = q.family;
+                r_tuple->scopeid = ifindex_to_scopeid(q.family, &q.address, q.ifindex);
+                memcpy(r_tuple->addr, &q.address, q.address_size);
 
                 idx += ALIGN(sizeof(struct gaih_addrtuple));
                 i++;
         }
-        if (r < 0)
-                goto fail;
 
         assert(i == c);
         assert(idx == ms);
@@ -288,12 +425,13 @@ enum nss_status _nss_resolve_gethostbyname3_r(
                 int32_t *ttlp,
                 char **canonp) {
 
-        _cleanup_(sd_bus_message_unrefp) sd_bus_message *req = NULL, *reply = NULL;
-        _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
+        _cleanup_(idle_connection_putp) Varlink *link = NULL; /* must be released last, the reply is owned by it */
+        _cleanup_(resolve_hostname_reply_destroy) ResolveHostnameReply p = {};
+        _cleanup_(json_variant_unrefp) JsonVariant *cparams = NULL;
         char *r_name, *r_aliases, *r_addr, *r_addr_list;
-        _cleanup_(sd_bus_flush_close_unrefp) sd_bus *bus = NULL;
+        JsonVariant *rparams, *entry;
+        const char *canonical, *error_id;
         size_t l, idx, ms, alen;
-        const char *canonical;
         int c, r, i = 0;
 
         PROTECT_ERRNO;
@@ -318,37 +456,28 @@ enum nss_status _nss_resolve_gethostbyname3_r(
                 goto fail;
         }
 
-        r = sd_bus_open_system(&bus);
+        r = json_build(&cparams, JSON_BUILD_OBJECT(
+                                       JSON_BUILD_PAIR("name", JSON_BUILD_STRING(name)),
+                                       JSON_BUILD_PAIR("family", JSON_BUILD_INTEGER(af))));
         if (r < 0)
                 goto fail;
 
-        r = sd_bus_message_new_method_call(
-                        bus,
-                        &req,
-                        "org.freedesktop.resolve1",
-                        "/org/freedesktop/resolve1",
-                        "org.freedesktop.resolve1.Manager",
-                        "ResolveHostname");
+        r = resolved_call(&link, "io.systemd.Resolve.ResolveHostname", cparams, &rparams, &error_id);
         if (r < 0)
                 goto fail;
+        if (!isempty(error_id)) {
+                if (!error_shall_fallback(error_id))
+                        goto not_found;
 
-        r = sd_bus_message_set_auto_start(req, false);
-        if (r < 0)
+                r = -ECONNREFUSED;
                 goto fail;
+        }
 
-        r = sd_bus_message_append(req, "isit", 0, name, af, (uint64_t) 0);
+        r = json_dispatch(rparams, resolve_hostname_reply_dispatch_table, NULL, 0, &p);
         if (r < 0)
                 goto fail;
 
-        r = sd_bus_call(bus, req, SD_RESOLVED_QUERY_TIMEOUT_USEC, &error, &reply);
-        if (r < 0) {
-                if (!bus_error_shall_fallback(&error))
-                        goto not_found;
-
-                goto fail;
-        }
-
-        c = count_addresses(reply, af, &canonical);
+        c = count_addresses(p.addresses, af);
         if (c < 0) {
                 r = c;
                 goto fail;
@@ -356,8 +485,7 @@ enum nss_status _nss_resolve_gethostbyname3_r(
         if (c == 0)
                 goto not_found;
 
-        if (isempty(canonical))
-                canonical = name;
+        canonical = isempty(p.name) ? name : p.name;
 
         alen = FAMILY_ADDRESS_SIZE(af);
         l = strlen(canonical);
@@ -384,45 +512,18 @@ enum nss_status _nss_resolve_gethostbyname3_r(
         /* Third, append addresses */
         r_addr = buffer + idx;
 
-        r = sd_bus_message_enter_container(reply, 'a', "(iiay)");
-        if (r < 0)
-                goto fail;
+        JSON_VARIANT_ARRAY_FOREACH(entry, p.addresses) {
+                AddressParameters q = {};
 
-        while ((r = sd_bus_message_enter_container(reply, 'r', "iiay")) > 0) {
-                int ifindex, family;
-                const void *a;
-                size_t sz;
+                /* Already validated by count_addresses() above */
+                assert_se(json_dispatch(entry, address_parameters_dispatch_table, NULL, 0, &q) >= 0);
 
-                r = sd_bus_message_read(reply, "ii", &ifindex, &family);
-                if (r < 0)
-                        goto fail;
-
-                if (ifindex < 0) {
-                        r = -EINVAL;
-                        goto fail;
-                }
-
-                r = sd_bus_message_read_array(reply, 'y', &a, &sz);
-                if (r < 0)
-                        goto fail;
-
-                r = sd_bus_message_exit_container(reply);
-                if (r < 0)
-                        goto fail;
-
-                if (family != af)
+                if (q.family != af)
                         continue;
 
-                if (sz != alen) {
-                        r = -EINVAL;
-                        goto fail;
-                }
-
-                memcpy(r_addr + i*ALIGN(alen), a, alen);
+                memcpy(r_addr + i*ALIGN(alen), &q.address, alen);
                 i++;
         }
-        if (r < 0)
-                goto fail;
 
         assert(i == c);
         idx += c * ALIGN(alen);
@@ -475,14 +576,15 @@ enum nss_status _nss_resolve_gethostbyaddr2_r(
                 int *errnop, int *h_errnop,
                 int32_t *ttlp) {
 
-        _cleanup_(sd_bus_message_unrefp) sd_bus_message *req = NULL, *reply = NULL;
-        _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
+        _cleanup_(idle_connection_putp) Varlink *link = NULL; /* must be released last, the reply is owned by it */
+        _cleanup_(resolve_address_reply_destroy) ResolveAddressReply p = {};
+        _cleanup_(json_variant_unrefp) JsonVariant *cparams = NULL, *address = NULL;
         char *r_name, *r_aliases, *r_addr, *r_addr_list;
-        _cleanup_(sd_bus_flush_close_unrefp) sd_bus *bus = NULL;
+        JsonVariant *rparams, *entry;
         unsigned c = 0, i = 0;
         size_t ms = 0, idx;
-        const char *n;
-        int r, ifindex;
+        const char *error_id;
+        int r;
 
         PROTECT_ERRNO;
         BLOCK_SIGNALS(NSS_SIGNALS_BLOCK);
@@ -510,64 +612,46 @@ enum nss_status _nss_resolve_gethostbyaddr2_r(
                 goto fail;
         }
 
-        r = sd_bus_open_system(&bus);
-        if (r < 0)
-                goto fail;
-
-        r = sd_bus_message_new_method_call(
-                        bus,
-                        &req,
-                        "org.freedesktop.resolve1",
-                        "/org/freedesktop/resolve1",
-                        "org.freedesktop.resolve1.Manager",
-                        "ResolveAddress");
-        if (r < 0)
-                goto fail;
-
-        r = sd_bus_message_set_auto_start(req, false);
-        if (r < 0)
-                goto fail;
-
-        r = sd_bus_message_append(req, "ii", 0, af);
+        r = json_variant_new_array_bytes(&address, addr, len);
         if (r < 0)
                 goto fail;
 
-        r = sd_bus_message_append_array(req, 'y', addr, len);
+        r = json_build(&cparams, JSON_BUILD_OBJECT(
+                                       JSON_BUILD_PAIR("address", JSON_BUILD_VARIANT(address)),
+                                       JSON_BUILD_PAIR("family", JSON_BUILD_INTEGER(af))));
         if (r < 0)
                 goto fail;
 
-        r = sd_bus_message_append(req, "t", (uint64_t) 0);
+        r = resolved_call(&link, "io.systemd.Resolve.ResolveAddress", cparams, &rparams, &error_id);
         if (r < 0)
                 goto fail;
-
-        r = sd_bus_call(bus, req, SD_RESOLVED_QUERY_TIMEOUT_USEC, &error, &reply);
-        if (r < 0) {
-                if (!bus_error_shall_fallback(&error))
+        if (!isempty(error_id)) {
+                if (!error_shall_fallback(error_id))
                         goto not_found;
 
+                r = -ECONNREFUSED;
                 goto fail;
         }
 
-        r = sd_bus_message_enter_container(reply, 'a', "(is)");
+        r = json_dispatch(rparams, resolve_address_reply_dispatch_table, NULL, 0, &p);
         if (r < 0)
                 goto fail;
 
-        while ((r = sd_bus_message_read(reply, "(is)", &ifindex, &n)) > 0) {
+        JSON_VARIANT_ARRAY_FOREACH(entry, p.names) {
+                _cleanup_(name_parameters_destroy) NameParameters q = {};
 
-                if (ifindex < 0) {
+                r = json_dispatch(entry, name_parameters_dispatch_table, NULL, 0, &q);
+                if (r < 0)
+                        goto fail;
+
+                if (q.ifindex < 0) {
                         r = -EINVAL;
                         goto fail;
                 }
 
                 c++;
-                ms += ALIGN(strlen(n) + 1);
+                ms += ALIGN(strlen(q.name) + 1);
         }
-        if (r < 0)
-                goto fail;
-
-        r = sd_bus_message_rewind(reply, false);
-        if (r < 0)
-                goto fail;
 
         if (c <= 0)
                 goto not_found;
@@ -601,22 +685,24 @@ enum nss_status _nss_resolve_gethostbyaddr2_r(
         /* Fourth, place aliases */
         i = 0;
         r_name = buffer + idx;
-        while ((r = sd_bus_message_read(reply, "(is)", &ifindex, &n)) > 0) {
-                char *p;
+        JSON_VARIANT_ARRAY_FOREACH(entry, p.names) {
+                _cleanup_(name_parameters_destroy) NameParameters q = {};
                 size_t l;
+                char *z;
+
+                /* Already validated above */
+                assert_se(json_dispatch(entry, name_parameters_dispatch_table, NULL, 0, &q) >= 0);
 
-                l = strlen(n);
-                p = buffer + idx;
-                memcpy(p, n, l+1);
+                l = strlen(q.name);
+                z = buffer + idx;
+                memcpy(z, q.name, l+1);
 
                 if (i > 0)
-                        ((char**) r_aliases)[i-1] = p;
+                        ((char**) r_aliases)[i-1] = z;
                 i++;
 
                 idx += ALIGN(l+1);
         }
-        if (r < 0)
-                goto fail;
 
         ((char**) r_aliases)[c-1] = NULL;
         assert(idx == ms);
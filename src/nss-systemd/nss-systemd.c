@@ -2,6 +2,7 @@
 
 #include <nss.h>
 #include <pthread.h>
+#include <sys/stat.h>
 
 #include "sd-bus.h"
 
@@ -18,6 +19,7 @@
 #include "signal-util.h"
 #include "stdio-util.h"
 #include "string-util.h"
+#include "time-util.h"
 #include "user-util.h"
 #include "util.h"
 
@@ -133,46 +135,138 @@ static int direct_lookup_uid(uid_t uid, char **ret) {
         return 0;
 }
 
-enum nss_status _nss_systemd_getpwnam_r(
-                const char *name,
-                struct passwd *pwd,
-                char *buffer, size_t buflen,
-                int *errnop) {
+/* Programs such as ls or ps resolve the same handful of IDs over and over again, and each lookup otherwise costs
+ * us a new bus connection and a method call to PID 1. Hence, keep the most recent answers around for a while,
+ * including the negative ones, which are the common case for any ID that is not a dynamic user. */
+
+#define LOOKUP_CACHE_SIZE 32U
+#define LOOKUP_CACHE_TTL_USEC (10 * USEC_PER_SEC)
+
+typedef struct DynamicUserGeneration {
+        dev_t dev;
+        ino_t ino;
+        nsec_t mtime;
+} DynamicUserGeneration;
+
+typedef struct LookupCacheEntry {
+        char *name;    /* NULL if this is a negative entry for 'uid' */
+        uid_t uid;     /* UID_INVALID if this is a negative entry for 'name' */
+        usec_t until;
+        DynamicUserGeneration generation;
+} LookupCacheEntry;
+
+static struct {
+        pthread_mutex_t mutex;
+        LookupCacheEntry entries[LOOKUP_CACHE_SIZE];
+        unsigned next;
+} lookup_cache = {
+        .mutex = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static bool dynamic_user_generation_get(DynamicUserGeneration *ret) {
+        struct stat st;
+
+        assert(ret);
+
+        /* PID 1 adds and removes the lock files and "direct:" symlinks in this directory whenever it allocates or
+         * releases a dynamic user, hence its identity and modification time tell us whether an earlier answer might
+         * be outdated. Returns false if the directory was modified so recently that another modification might
+         * leave the timestamp unchanged, in which case nothing may be cached. */
+
+        if (stat("/run/systemd/dynamic-uid", &st) < 0) {
+                if (errno != ENOENT)
+                        return false;
+
+                /* No dynamic users have been allocated so far */
+                *ret = (DynamicUserGeneration) {};
+                return true;
+        }
+
+        *ret = (DynamicUserGeneration) {
+                .dev = st.st_dev,
+                .ino = st.st_ino,
+                .mtime = timespec_load_nsec(&st.st_mtim),
+        };
+
+        return timespec_load(&st.st_mtim) + USEC_PER_SEC <= now(CLOCK_REALTIME);
+}
+
+static bool dynamic_user_generation_equal(const DynamicUserGeneration *a, const DynamicUserGeneration *b) {
+        return a->dev == b->dev && a->ino == b->ino && a->mtime == b->mtime;
+}
+
+static LookupCacheEntry *lookup_cache_find(const char *name, uid_t uid, const DynamicUserGeneration *g, usec_t n) {
+        unsigned i;
+
+        /* Must be called with the mutex held. A positive entry answers lookups in both directions, a negative one
+         * only the lookup it was created for. */
+
+        for (i = 0; i < LOOKUP_CACHE_SIZE; i++) {
+                LookupCacheEntry *e = lookup_cache.entries + i;
+
+                if (e->until <= n || !dynamic_user_generation_equal(&e->generation, g))
+                        continue;
+
+                if (name ? streq_ptr(e->name, name) : e->uid == uid)
+                        return e;
+        }
+
+        return NULL;
+}
+
+static void lookup_cache_put(const char *name, uid_t uid, const DynamicUserGeneration *g) {
+        _cleanup_free_ char *copy = NULL;
+        LookupCacheEntry *e;
+
+        if (name) {
+                copy = strdup(name);
+                if (!copy)
+                        return; /* Not caching is fine too */
+        }
 
+        assert_se(pthread_mutex_lock(&lookup_cache.mutex) == 0);
+
+        e = lookup_cache.entries + lookup_cache.next;
+        lookup_cache.next = (lookup_cache.next + 1) % LOOKUP_CACHE_SIZE;
+
+        free_and_replace(e->name, copy);
+        e->uid = uid;
+        e->until = usec_add(now(CLOCK_MONOTONIC), LOOKUP_CACHE_TTL_USEC);
+        e->generation = *g;
+
+        assert_se(pthread_mutex_unlock(&lookup_cache.mutex) == 0);
+}
+
+static int lookup_dynamic_user_by_name(const char *name, uid_t *ret) {
         _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
         _cleanup_(sd_bus_message_unrefp) sd_bus_message* reply = NULL;
         _cleanup_(sd_bus_flush_close_unrefp) sd_bus *bus = NULL;
+        DynamicUserGeneration g;
+        LookupCacheEntry *e;
+        bool cacheable;
         uint32_t translated;
-        size_t l;
         int bypass, r;
 
-        PROTECT_ERRNO;
-        BLOCK_SIGNALS(NSS_SIGNALS_BLOCK);
-
         assert(name);
-        assert(pwd);
+        assert(ret);
 
-        /* If the username is not valid, then we don't know it. Ideally libc would filter these for us anyway. We don't
-         * generate EINVAL here, because it isn't really out business to complain about invalid user names. */
-        if (!valid_user_group_name(name))
-                return NSS_STATUS_NOTFOUND;
+        /* Returns > 0 if the name refers to a dynamic user, 0 if it doesn't, negative errno on failure. */
 
-        /* Synthesize entries for the root and nobody users, in case they are missing in /etc/passwd */
-        if (getenv_bool_secure("SYSTEMD_NSS_BYPASS_SYNTHETIC") <= 0) {
-                if (streq(name, root_passwd.pw_name)) {
-                        *pwd = root_passwd;
-                        return NSS_STATUS_SUCCESS;
-                }
-                if (synthesize_nobody() &&
-                    streq(name, nobody_passwd.pw_name)) {
-                        *pwd = nobody_passwd;
-                        return NSS_STATUS_SUCCESS;
-                }
-        }
+        /* Determine the generation before asking, so that any change while we ask invalidates the answer */
+        cacheable = dynamic_user_generation_get(&g);
 
-        /* Make sure that we don't go in circles when allocating a dynamic UID by checking our own database */
-        if (getenv_bool_secure("SYSTEMD_NSS_DYNAMIC_BYPASS") > 0)
-                return NSS_STATUS_NOTFOUND;
+        assert_se(pthread_mutex_lock(&lookup_cache.mutex) == 0);
+        e = lookup_cache_find(name, UID_INVALID, &g, now(CLOCK_MONOTONIC));
+        if (e)
+                translated = e->uid;
+        assert_se(pthread_mutex_unlock(&lookup_cache.mutex) == 0);
+        if (e) {
+                if (!uid_is_valid(translated))
+                        return 0;
+
+                *ret = translated;
+                return 1;
+        }
 
         bypass = getenv_bool_secure("SYSTEMD_NSS_BYPASS_BUS");
         if (bypass <= 0) {
@@ -184,9 +278,9 @@ enum nss_status _nss_systemd_getpwnam_r(
         if (bypass > 0) {
                 r = direct_lookup_name(name, (uid_t*) &translated);
                 if (r == -ENOENT)
-                        return NSS_STATUS_NOTFOUND;
-                if (r < 0)
-                        goto fail;
+                        translated = UID_INVALID;
+                else if (r < 0)
+                        return r;
         } else {
                 r = sd_bus_call_method(bus,
                                        "org.freedesktop.systemd1",
@@ -198,17 +292,148 @@ enum nss_status _nss_systemd_getpwnam_r(
                                        "s",
                                        name);
                 if (r < 0) {
-                        if (sd_bus_error_has_name(&error, BUS_ERROR_NO_SUCH_DYNAMIC_USER))
-                                return NSS_STATUS_NOTFOUND;
-
-                        goto fail;
+                        if (!sd_bus_error_has_name(&error, BUS_ERROR_NO_SUCH_DYNAMIC_USER))
+                                return r;
+
+                        translated = UID_INVALID;
+                } else {
+                        r = sd_bus_message_read(reply, "u", &translated);
+                        if (r < 0)
+                                return r;
                 }
+        }
+
+        if (cacheable)
+                lookup_cache_put(uid_is_valid(translated) ? name : NULL, translated, &g);
+        if (!uid_is_valid(translated))
+                return 0;
+
+        *ret = (uid_t) translated;
+        return 1;
+}
+
+static int lookup_dynamic_user_by_uid(uid_t uid, char **ret) {
+        _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message* reply = NULL;
+        _cleanup_(sd_bus_flush_close_unrefp) sd_bus *bus = NULL;
+        _cleanup_free_ char *translated = NULL;
+        DynamicUserGeneration g;
+        LookupCacheEntry *e;
+        bool cacheable;
+        int bypass, r;
+
+        assert(ret);
+
+        /* Returns > 0 if the UID belongs to a dynamic user, 0 if it doesn't, negative errno on failure. */
+
+        cacheable = dynamic_user_generation_get(&g);
+
+        assert_se(pthread_mutex_lock(&lookup_cache.mutex) == 0);
+        e = lookup_cache_find(NULL, uid, &g, now(CLOCK_MONOTONIC));
+        if (e && e->name) {
+                translated = strdup(e->name);
+                if (!translated)
+                        e = NULL; /* Ask again then, rather than failing */
+        }
+        assert_se(pthread_mutex_unlock(&lookup_cache.mutex) == 0);
+        if (e) {
+                if (!translated)
+                        return 0;
 
-                r = sd_bus_message_read(reply, "u", &translated);
+                *ret = TAKE_PTR(translated);
+                return 1;
+        }
+
+        bypass = getenv_bool_secure("SYSTEMD_NSS_BYPASS_BUS");
+        if (bypass <= 0) {
+                r = sd_bus_open_system(&bus);
                 if (r < 0)
-                        goto fail;
+                        bypass = 1;
+        }
+
+        if (bypass > 0) {
+                r = direct_lookup_uid(uid, &translated);
+                if (r < 0 && r != -ENOENT)
+                        return r;
+        } else {
+                const char *s;
+
+                r = sd_bus_call_method(bus,
+                                       "org.freedesktop.systemd1",
+                                       "/org/freedesktop/systemd1",
+                                       "org.freedesktop.systemd1.Manager",
+                                       "LookupDynamicUserByUID",
+                                       &error,
+                                       &reply,
+                                       "u",
+                                       (uint32_t) uid);
+                if (r < 0) {
+                        if (!sd_bus_error_has_name(&error, BUS_ERROR_NO_SUCH_DYNAMIC_USER))
+                                return r;
+                } else {
+                        r = sd_bus_message_read(reply, "s", &s);
+                        if (r < 0)
+                                return r;
+
+                        translated = strdup(s);
+                        if (!translated)
+                                return -ENOMEM;
+                }
+        }
+
+        if (cacheable)
+                lookup_cache_put(translated, uid, &g);
+        if (!translated)
+                return 0;
+
+        *ret = TAKE_PTR(translated);
+        return 1;
+}
+
+enum nss_status _nss_systemd_getpwnam_r(
+                const char *name,
+                struct passwd *pwd,
+                char *buffer, size_t buflen,
+                int *errnop) {
+
+        uid_t translated;
+        size_t l;
+        int r;
+
+        PROTECT_ERRNO;
+        BLOCK_SIGNALS(NSS_SIGNALS_BLOCK);
+
+        assert(name);
+        assert(pwd);
+
+        /* If the username is not valid, then we don't know it. Ideally libc would filter these for us anyway. We don't
+         * generate EINVAL here, because it isn't really out business to complain about invalid user names. */
+        if (!valid_user_group_name(name))
+                return NSS_STATUS_NOTFOUND;
+
+        /* Synthesize entries for the root and nobody users, in case they are missing in /etc/passwd */
+        if (getenv_bool_secure("SYSTEMD_NSS_BYPASS_SYNTHETIC") <= 0) {
+                if (streq(name, root_passwd.pw_name)) {
+                        *pwd = root_passwd;
+                        return NSS_STATUS_SUCCESS;
+                }
+                if (synthesize_nobody() &&
+                    streq(name, nobody_passwd.pw_name)) {
+                        *pwd = nobody_passwd;
+                        return NSS_STATUS_SUCCESS;
+                }
         }
 
+        /* Make sure that we don't go in circles when allocating a dynamic UID by checking our own database */
+        if (getenv_bool_secure("SYSTEMD_NSS_DYNAMIC_BYPASS") > 0)
+                return NSS_STATUS_NOTFOUND;
+
+        r = lookup_dynamic_user_by_name(name, &translated);
+        if (r == 0)
+                return NSS_STATUS_NOTFOUND;
+        if (r < 0)
+                goto fail;
+
         l = strlen(name);
         if (buflen < l+1) {
                 UNPROTECT_ERRNO;
@@ -219,8 +444,8 @@ enum nss_status _nss_systemd_getpwnam_r(
         memcpy(buffer, name, l+1);
 
         pwd->pw_name = buffer;
-        pwd->pw_uid = (uid_t) translated;
-        pwd->pw_gid = (uid_t) translated;
+        pwd->pw_uid = translated;
+        pwd->pw_gid = (gid_t) translated;
         pwd->pw_gecos = (char*) DYNAMIC_USER_GECOS;
         pwd->pw_passwd = (char*) DYNAMIC_USER_PASSWD;
         pwd->pw_dir = (char*) DYNAMIC_USER_DIR;
@@ -240,13 +465,9 @@ enum nss_status _nss_systemd_getpwuid_r(
                 char *buffer, size_t buflen,
                 int *errnop) {
 
-        _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
-        _cleanup_(sd_bus_message_unrefp) sd_bus_message* reply = NULL;
-        _cleanup_(sd_bus_flush_close_unrefp) sd_bus *bus = NULL;
-        _cleanup_free_ char *direct = NULL;
-        const char *translated;
+        _cleanup_free_ char *translated = NULL;
         size_t l;
-        int bypass, r;
+        int r;
 
         PROTECT_ERRNO;
         BLOCK_SIGNALS(NSS_SIGNALS_BLOCK);
@@ -273,43 +494,11 @@ enum nss_status _nss_systemd_getpwuid_r(
         if (getenv_bool_secure("SYSTEMD_NSS_DYNAMIC_BYPASS") > 0)
                 return NSS_STATUS_NOTFOUND;
 
-        bypass = getenv_bool_secure("SYSTEMD_NSS_BYPASS_BUS");
-        if (bypass <= 0) {
-                r = sd_bus_open_system(&bus);
-                if (r < 0)
-                        bypass = 1;
-        }
-
-        if (bypass > 0) {
-                r = direct_lookup_uid(uid, &direct);
-                if (r == -ENOENT)
-                        return NSS_STATUS_NOTFOUND;
-                if (r < 0)
-                        goto fail;
-
-                translated = direct;
-
-        } else {
-                r = sd_bus_call_method(bus,
-                                       "org.freedesktop.systemd1",
-                                       "/org/freedesktop/systemd1",
-                                       "org.freedesktop.systemd1.Manager",
-                                       "LookupDynamicUserByUID",
-                                       &error,
-                                       &reply,
-                                       "u",
-                                       (uint32_t) uid);
-                if (r < 0) {
-                        if (sd_bus_error_has_name(&error, BUS_ERROR_NO_SUCH_DYNAMIC_USER))
-                                return NSS_STATUS_NOTFOUND;
-
-                        goto fail;
-                }
-
-                r = sd_bus_message_read(reply, "s", &translated);
-                if (r < 0)
-                        goto fail;
-        }
+        r = lookup_dynamic_user_by_uid(uid, &translated);
+        if (r == 0)
+                return NSS_STATUS_NOTFOUND;
+        if (r < 0)
+                goto fail;
 
         l = strlen(translated) + 1;
         if (buflen < l) {
@@ -344,12 +533,9 @@ enum nss_status _nss_systemd_getgrnam_r(
                 char *buffer, size_t buflen,
                 int *errnop) {
 
-        _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
-        _cleanup_(sd_bus_message_unrefp) sd_bus_message* reply = NULL;
-        _cleanup_(sd_bus_flush_close_unrefp) sd_bus *bus = NULL;
-        uint32_t translated;
+        uid_t translated;
         size_t l;
-        int bypass, r;
+        int r;
 
         PROTECT_ERRNO;
         BLOCK_SIGNALS(NSS_SIGNALS_BLOCK);
@@ -376,40 +562,11 @@ enum nss_status _nss_systemd_getgrnam_r(
         if (getenv_bool_secure("SYSTEMD_NSS_DYNAMIC_BYPASS") > 0)
                 return NSS_STATUS_NOTFOUND;
 
-        bypass = getenv_bool_secure("SYSTEMD_NSS_BYPASS_BUS");
-        if (bypass <= 0) {
-                r = sd_bus_open_system(&bus);
-                if (r < 0)
-                        bypass = 1;
-        }
-
-        if (bypass > 0) {
-                r = direct_lookup_name(name, (uid_t*) &translated);
-                if (r == -ENOENT)
-                        return NSS_STATUS_NOTFOUND;
-                if (r < 0)
-                        goto fail;
-        } else {
-                r = sd_bus_call_method(bus,
-                                       "org.freedesktop.systemd1",
-                                       "/org/freedesktop/systemd1",
-                                       "org.freedesktop.systemd1.Manager",
-                                       "LookupDynamicUserByName",
-                                       &error,
-                                       &reply,
-                                       "s",
-                                       name);
-                if (r < 0) {
-                        if (sd_bus_error_has_name(&error, BUS_ERROR_NO_SUCH_DYNAMIC_USER))
-                                return NSS_STATUS_NOTFOUND;
-
-                        goto fail;
-                }
-
-                r = sd_bus_message_read(reply, "u", &translated);
-                if (r < 0)
-                        goto fail;
-        }
+        r = lookup_dynamic_user_by_name(name, &translated);
+        if (r == 0)
+                return NSS_STATUS_NOTFOUND;
+        if (r < 0)
+                goto fail;
 
         l = sizeof(char*) + strlen(name) + 1;
         if (buflen < l) {
@@ -440,13 +597,9 @@ enum nss_status _nss_systemd_getgrgid_r(
                 char *buffer, size_t buflen,
                 int *errnop) {
 
-        _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
-        _cleanup_(sd_bus_message_unrefp) sd_bus_message* reply = NULL;
-        _cleanup_(sd_bus_flush_close_unrefp) sd_bus *bus = NULL;
-        _cleanup_free_ char *direct = NULL;
-        const char *translated;
+        _cleanup_free_ char *translated = NULL;
         size_t l;
-        int bypass, r;
+        int r;
 
         PROTECT_ERRNO;
         BLOCK_SIGNALS(NSS_SIGNALS_BLOCK);
@@ -473,43 +626,11 @@ enum nss_status _nss_systemd_getgrgid_r(
         if (getenv_bool_secure("SYSTEMD_NSS_DYNAMIC_BYPASS") > 0)
                 return NSS_STATUS_NOTFOUND;
 
-        bypass = getenv_bool_secure("SYSTEMD_NSS_BYPASS_BUS");
-        if (bypass <= 0) {
-                r = sd_bus_open_system(&bus);
-                if (r < 0)
-                        bypass = 1;
-        }
-
-        if (bypass > 0) {
-                r = direct_lookup_uid(gid, &direct);
-                if (r == -ENOENT)
-                        return NSS_STATUS_NOTFOUND;
-                if (r < 0)
-                        goto fail;
-
-                translated = direct;
-
-        } else {
-                r = sd_bus_call_method(bus,
-                                       "org.freedesktop.systemd1",
-                                       "/org/freedesktop/systemd1",
-                                       "org.freedesktop.systemd1.Manager",
-                                       "LookupDynamicUserByUID",
-                                       &error,
-                                       &reply,
-                                       "u",
-                                       (uint32_t) gid);
-                if (r < 0) {
-                        if (sd_bus_error_has_name(&error, BUS_ERROR_NO_SUCH_DYNAMIC_USER))
-                                return NSS_STATUS_NOTFOUND;
-
-                        goto fail;
-                }
-
-                r = sd_bus_message_read(reply, "s", &translated);
-                if (r < 0)
-                        goto fail;
-        }
+        r = lookup_dynamic_user_by_uid((uid_t) gid, &translated);
+        if (r == 0)
+                return NSS_STATUS_NOTFOUND;
+        if (r < 0)
+                goto fail;
 
         l = sizeof(char*) + strlen(translated) + 1;
         if (buflen < l) {
@@ -0,0 +1,254 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <stdio.h>
+#include <sys/statfs.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+
+#include "alloc-util.h"
+#include "escape.h"
+#include "extract-word.h"
+#include "fd-util.h"
+#include "fileio.h"
+#include "parse-util.h"
+#include "path-util.h"
+#include "readahead-pack.h"
+#include "sort-util.h"
+#include "string-util.h"
+#include "tmpfile-util.h"
+
+#define READAHEAD_PACK_HEADER "READAHEAD-1"
+
+void readahead_pack_done(ReadaheadPack *p) {
+        size_t i;
+
+        assert(p);
+
+        for (i = 0; i < p->n_entries; i++)
+                free(p->entries[i].path);
+
+        p->entries = mfree(p->entries);
+        p->n_entries = p->n_allocated = 0;
+}
+
+int readahead_pack_add(ReadaheadPack *p, const char *path, const struct stat *st, uint64_t physical) {
+        _cleanup_free_ char *c = NULL;
+
+        assert(p);
+        assert(path);
+        assert(st);
+
+        c = strdup(path);
+        if (!c)
+                return -ENOMEM;
+
+        if (!GREEDY_REALLOC(p->entries, p->n_allocated, p->n_entries + 1))
+                return -ENOMEM;
+
+        p->entries[p->n_entries++] = (ReadaheadEntry) {
+                .path = TAKE_PTR(c),
+                .inode = st->st_ino,
+                .size = st->st_size,
+                .mtime = timespec_load(&st->st_mtim),
+                .physical = physical,
+        };
+
+        return 0;
+}
+
+static int entry_compare(const ReadaheadEntry *a, const ReadaheadEntry *b) {
+        int r;
+
+        /* Files whose location on disk is not known go last, sorted by path so that the files of a directory
+         * stay together */
+        r = CMP(a->physical, b->physical);
+        if (r != 0)
+                return r;
+
+        return strcmp(a->path, b->path);
+}
+
+void readahead_pack_sort(ReadaheadPack *p) {
+        assert(p);
+
+        /* Reading the files in the order they are stored on disk means the disk head moves in one direction
+         * only, instead of seeking back and forth as the files are opened during boot. */
+        typesafe_qsort(p->entries, p->n_entries, entry_compare);
+}
+
+int readahead_pack_write(const ReadaheadPack *p, const char *path) {
+        _cleanup_fclose_ FILE *f = NULL;
+        _cleanup_free_ char *t = NULL;
+        size_t i;
+        int r;
+
+        assert(p);
+        assert(path);
+
+        r = fopen_temporary(path, &f, &t);
+        if (r < 0)
+                return r;
+
+        (void) fchmod(fileno(f), 0644);
+
+        fprintf(f, READAHEAD_PACK_HEADER " %u:%u 0x%016" PRIx64 "\n",
+                major(p->root_dev), minor(p->root_dev), p->root_fsid);
+
+        for (i = 0; i < p->n_entries; i++) {
+                const ReadaheadEntry *e = p->entries + i;
+                _cleanup_free_ char *escaped = NULL;
+
+                escaped = cescape(e->path);
+                if (!escaped) {
+                        r = -ENOMEM;
+                        goto fail;
+                }
+
+                fprintf(f, "%" PRIu64 " %" PRIu64 " " USEC_FMT " %" PRIu64 " %s\n",
+                        (uint64_t) e->inode, e->size, e->mtime, e->physical, escaped);
+        }
+
+        r = fflush_and_check(f);
+        if (r < 0)
+                goto fail;
+
+        if (rename(t, path) < 0) {
+                r = -errno;
+                goto fail;
+        }
+
+        return 0;
+
+fail:
+        (void) unlink(t);
+        return r;
+}
+
+static int parse_header(ReadaheadPack *p, const char *line) {
+        _cleanup_free_ char *magic = NULL, *dev = NULL, *fsid = NULL;
+        const char *q = line;
+        unsigned ma, mi;
+        int r;
+
+        r = extract_many_words(&q, " ", 0, &magic, &dev, &fsid, NULL);
+        if (r < 0)
+                return r;
+        if (r < 3 || !streq(magic, READAHEAD_PACK_HEADER))
+                return -EBADMSG;
+
+        if (sscanf(dev, "%u:%u", &ma, &mi) != 2)
+                return -EBADMSG;
+
+        r = safe_atou64(fsid, &p->root_fsid);
+        if (r < 0)
+                return -EBADMSG;
+
+        p->root_dev = makedev(ma, mi);
+        return 0;
+}
+
+static int parse_entry(ReadaheadPack *p, const char *line) {
+        _cleanup_free_ char *inode = NULL, *size = NULL, *mtime = NULL, *physical = NULL, *path = NULL;
+        const char *q = line;
+        ReadaheadEntry e = {};
+        uint64_t ino;
+        int r;
+
+        r = extract_many_words(&q, " ", 0, &inode, &size, &mtime, &physical, NULL);
+        if (r < 0)
+                return r;
+        if (r < 4 || isempty(q))
+                return -EBADMSG;
+
+        if (safe_atou64(inode, &ino) < 0 ||
+            safe_atou64(size, &e.size) < 0 ||
+            safe_atou64(mtime, &e.mtime) < 0 ||
+            safe_atou64(physical, &e.physical) < 0)
+                return -EBADMSG;
+
+        e.inode = (ino_t) ino;
+
+        r = cunescape(q, 0, &path);
+        if (r < 0)
+                return r;
+        if (!path_is_absolute(path))
+                return -EBADMSG;
+
+        if (!GREEDY_REALLOC(p->entries, p->n_allocated, p->n_entries + 1))
+                return -ENOMEM;
+
+        e.path = TAKE_PTR(path);
+        p->entries[p->n_entries++] = e;
+
+        return 0;
+}
+
+int readahead_pack_read(ReadaheadPack *p, const char *path) {
+        _cleanup_fclose_ FILE *f = NULL;
+        bool header = false;
+        int r;
+
+        assert(p);
+        assert(path);
+
+        f = fopen(path, "re");
+        if (!f)
+                return -errno;
+
+        for (;;) {
+                _cleanup_free_ char *line = NULL;
+
+                r = read_line(f, LONG_LINE_MAX, &line);
+                if (r < 0)
+                        return r;
+                if (r == 0)
+                        break;
+
+                if (!header) {
+                        r = parse_header(p, line);
+                        header = true;
+                } else
+                        r = parse_entry(p, line);
+                if (r < 0)
+                        return r;
+        }
+
+        if (!header)
+                return -EBADMSG;
+
+        return 0;
+}
+
+int readahead_root_identify(dev_t *ret_dev, uint64_t *ret_fsid) {
+        struct statfs sfs;
+        struct stat st;
+
+        assert(ret_dev);
+        assert(ret_fsid);
+
+        /* The device number and the file system ID both change if the root file system is replaced, or ends
+         * up on a different partition */
+
+        if (stat("/", &st) < 0)
+                return -errno;
+
+        if (statfs("/", &sfs) < 0)
+                return -errno;
+
+        assert_cc(sizeof(sfs.f_fsid) == sizeof(uint64_t));
+
+        *ret_dev = st.st_dev;
+        memcpy(ret_fsid, &sfs.f_fsid, sizeof(uint64_t));
+
+        return 0;
+}
+
+bool readahead_entry_matches(const ReadaheadEntry *e, const struct stat *st) {
+        assert(e);
+        assert(st);
+
+        return S_ISREG(st->st_mode) &&
+                st->st_ino == e->inode &&
+                (uint64_t) st->st_size == e->size &&
+                timespec_load(&st->st_mtim) == e->mtime;
+}
@@ -0,0 +1,47 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+#pragma once
+
+#include <inttypes.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "macro.h"
+#include "time-util.h"
+
+/* The list of files read during boot, in the order of their location on disk. It lives on the root file
+ * system itself, since that's the only one we can rely on being around early during boot. */
+#define READAHEAD_PACK "/.readahead"
+
+/* Only read the beginning of large files, and don't record more than this many files */
+#define READAHEAD_FILE_SIZE_MAX (10U*1024U*1024U)
+#define READAHEAD_FILES_MAX 16384U
+
+typedef struct ReadaheadEntry {
+        char *path;
+        ino_t inode;
+        uint64_t size;
+        usec_t mtime;
+        uint64_t physical;      /* offset of the first extent on disk, UINT64_MAX if not known */
+} ReadaheadEntry;
+
+typedef struct ReadaheadPack {
+        /* Identifies the root file system the pack was recorded on */
+        dev_t root_dev;
+        uint64_t root_fsid;
+
+        ReadaheadEntry *entries;
+        size_t n_entries, n_allocated;
+} ReadaheadPack;
+
+void readahead_pack_done(ReadaheadPack *p);
+
+int readahead_pack_add(ReadaheadPack *p, const char *path, const struct stat *st, uint64_t physical);
+void readahead_pack_sort(ReadaheadPack *p);
+
+int readahead_pack_write(const ReadaheadPack *p, const char *path);
+int readahead_pack_read(ReadaheadPack *p, const char *path);
+
+int readahead_root_identify(dev_t *ret_dev, uint64_t *ret_fsid);
+
+/* Whether the file is still the one that was recorded, or has been replaced or modified since */
+bool readahead_entry_matches(const ReadaheadEntry *e, const struct stat *st) _pure_;
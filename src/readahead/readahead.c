@@ -0,0 +1,344 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/fiemap.h>
+#include <linux/fs.h>
+#include <sys/fanotify.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "sd-daemon.h"
+#include "sd-event.h"
+
+#include "alloc-util.h"
+#include "blockdev-util.h"
+#include "fd-util.h"
+#include "fileio.h"
+#include "format-util.h"
+#include "log.h"
+#include "main-func.h"
+#include "parse-util.h"
+#include "path-util.h"
+#include "process-util.h"
+#include "readahead-pack.h"
+#include "set.h"
+#include "signal-util.h"
+#include "string-util.h"
+#include "util.h"
+
+/* Stop collecting after this long, in case systemd-readahead-done.service is never started */
+#define COLLECT_TIMEOUT_USEC (2 * USEC_PER_MINUTE)
+
+typedef struct Collector {
+        ReadaheadPack pack;
+        Set *seen;              /* paths already recorded, pointing into pack */
+        dev_t root_dev;
+} Collector;
+
+static void collector_done(Collector *c) {
+        set_free(c->seen);
+        readahead_pack_done(&c->pack);
+}
+
+static int root_is_rotational(void) {
+        _cleanup_free_ char *line = NULL;
+        char p[SYS_BLOCK_PATH_MAX("/queue/rotational")];
+        dev_t devno;
+        int r;
+
+        r = get_block_device_harder("/", &devno);
+        if (r < 0)
+                return r;
+        if (r == 0)
+                return -ENODEV;
+
+        r = block_get_whole_disk(devno, &devno);
+        if (r < 0)
+                return r;
+
+        xsprintf_sys_block_path(p, "/queue/rotational", devno);
+
+        r = read_one_line_file(p, &line);
+        if (r < 0)
+                return r;
+
+        return parse_boolean(line);
+}
+
+static uint64_t fd_physical_offset(int fd) {
+        union {
+                struct fiemap fiemap;
+                uint8_t buffer[sizeof(struct fiemap) + sizeof(struct fiemap_extent)];
+        } data = {
+                .fiemap.fm_length = FIEMAP_MAX_OFFSET,
+                .fiemap.fm_extent_count = 1,
+        };
+
+        /* Only the first extent is interesting, that's where reading the file starts */
+        if (ioctl(fd, FS_IOC_FIEMAP, &data.fiemap) < 0)
+                return UINT64_MAX;
+        if (data.fiemap.fm_mapped_extents == 0)
+                return UINT64_MAX;
+
+        return data.fiemap.fm_extents[0].fe_physical;
+}
+
+static int collector_add(Collector *c, int fd) {
+        _cleanup_free_ char *p = NULL;
+        struct stat st;
+        int r;
+
+        assert(c);
+        assert(fd >= 0);
+
+        if (fstat(fd, &st) < 0)
+                return -errno;
+
+        /* Only regular files on the root file system, the pack is stored there and replayed before anything
+         * else is mounted */
+        if (!S_ISREG(st.st_mode) || st.st_dev != c->root_dev || st.st_size <= 0)
+                return 0;
+
+        r = fd_get_path(fd, &p);
+        if (r < 0)
+                return r;
+
+        if (!path_is_absolute(p) || endswith(p, " (deleted)"))
+                return 0;
+
+        if (set_contains(c->seen, p))
+                return 0;
+
+        r = readahead_pack_add(&c->pack, p, &st, fd_physical_offset(fd));
+        if (r < 0)
+                return r;
+
+        return set_put(c->seen, c->pack.entries[c->pack.n_entries - 1].path);
+}
+
+static int on_fanotify(sd_event_source *s, int fd, uint32_t revents, void *userdata) {
+        union {
+                struct fanotify_event_metadata metadata;
+                uint8_t buffer[4096];
+        } data;
+        struct fanotify_event_metadata *m;
+        Collector *c = userdata;
+        ssize_t n;
+        int r;
+
+        assert(c);
+
+        n = read(fd, &data, sizeof(data));
+        if (n < 0) {
+                if (IN_SET(errno, EINTR, EAGAIN))
+                        return 0;
+
+                log_error_errno(errno, "Failed to read fanotify events: %m");
+                return sd_event_exit(sd_event_source_get_event(s), -errno);
+        }
+
+        for (m = &data.metadata; FAN_EVENT_OK(m, n); m = FAN_EVENT_NEXT(m, n)) {
+                _cleanup_close_ int event_fd = m->fd;
+
+                if (m->vers != FANOTIFY_METADATA_VERSION) {
+                        log_error("Unexpected fanotify metadata version %u.", m->vers);
+                        return sd_event_exit(sd_event_source_get_event(s), -EPROTO);
+                }
+
+                /* Ignore what we open ourselves */
+                if (event_fd < 0 || m->pid == getpid_cached())
+                        continue;
+
+                r = collector_add(c, event_fd);
+                if (r == -ENOMEM)
+                        return sd_event_exit(sd_event_source_get_event(s), log_oom());
+                if (r < 0)
+                        log_debug_errno(r, "Failed to record opened file, ignoring: %m");
+        }
+
+        if (c->pack.n_entries >= READAHEAD_FILES_MAX) {
+                log_debug("Recorded %u files, stopping collection.", READAHEAD_FILES_MAX);
+                return sd_event_exit(sd_event_source_get_event(s), 0);
+        }
+
+        return 0;
+}
+
+static int collect(void) {
+        _cleanup_(sd_event_unrefp) sd_event *event = NULL;
+        _cleanup_(collector_done) Collector c = {};
+        _cleanup_close_ int fanotify_fd = -1;
+        struct stat st;
+        int r;
+
+        r = root_is_rotational();
+        if (r == 0) {
+                log_info("Root file system is not on a rotating disk, not collecting read-ahead data.");
+                return 0;
+        }
+        if (r < 0)
+                log_debug_errno(r, "Failed to determine whether root file system is on a rotating disk, assuming it is: %m");
+
+        if (stat("/", &st) < 0)
+                return log_error_errno(errno, "Failed to stat root file system: %m");
+        c.root_dev = st.st_dev;
+
+        r = readahead_root_identify(&c.pack.root_dev, &c.pack.root_fsid);
+        if (r < 0)
+                return log_error_errno(r, "Failed to identify root file system: %m");
+
+        c.seen = set_new(&path_hash_ops);
+        if (!c.seen)
+                return log_oom();
+
+        fanotify_fd = fanotify_init(FAN_CLOEXEC|FAN_NONBLOCK, O_RDONLY|O_LARGEFILE|O_CLOEXEC|O_NOATIME);
+        if (fanotify_fd < 0)
+                return log_error_errno(errno, "Failed to create fanotify object: %m");
+
+        if (fanotify_mark(fanotify_fd, FAN_MARK_ADD|FAN_MARK_MOUNT, FAN_OPEN, AT_FDCWD, "/") < 0)
+                return log_error_errno(errno, "Failed to mark root file system: %m");
+
+        assert_se(sigprocmask_many(SIG_BLOCK, NULL, SIGINT, SIGTERM, SIGUSR1, -1) >= 0);
+
+        r = sd_event_default(&event);
+        if (r < 0)
+                return log_error_errno(r, "Failed to allocate event loop: %m");
+
+        r = sd_event_add_io(event, NULL, fanotify_fd, EPOLLIN, on_fanotify, &c);
+        if (r < 0)
+                return log_error_errno(r, "Failed to watch fanotify object: %m");
+
+        /* systemd-readahead-done.service sends SIGUSR1 once boot is complete */
+        (void) sd_event_add_signal(event, NULL, SIGINT, NULL, NULL);
+        (void) sd_event_add_signal(event, NULL, SIGTERM, NULL, NULL);
+        (void) sd_event_add_signal(event, NULL, SIGUSR1, NULL, NULL);
+
+        r = sd_event_add_time(event, NULL, CLOCK_MONOTONIC, now(CLOCK_MONOTONIC) + COLLECT_TIMEOUT_USEC, 0, NULL, INT_TO_PTR(0));
+        if (r < 0)
+                return log_error_errno(r, "Failed to install timeout: %m");
+
+        /* Everything opened from now on is recorded, let the rest of the boot proceed */
+        (void) sd_notify(false,
+                         "READY=1\n"
+                         "STATUS=Collecting read-ahead data");
+
+        r = sd_event_loop(event);
+        if (r < 0)
+                return log_error_errno(r, "Failed to run event loop: %m");
+
+        fanotify_fd = safe_close(fanotify_fd);
+
+        if (c.pack.n_entries == 0) {
+                log_debug("No files recorded, not writing read-ahead data.");
+                return 0;
+        }
+
+        readahead_pack_sort(&c.pack);
+
+        r = readahead_pack_write(&c.pack, READAHEAD_PACK);
+        if (r < 0)
+                return log_error_errno(r, "Failed to write " READAHEAD_PACK ": %m");
+
+        log_debug("Recorded %zu files for read-ahead.", c.pack.n_entries);
+        return 0;
+}
+
+static void discard_pack(const char *reason) {
+        log_info("%s, discarding read-ahead data.", reason);
+
+        if (unlink(READAHEAD_PACK) < 0 && errno != ENOENT)
+                log_warning_errno(errno, "Failed to remove " READAHEAD_PACK ", ignoring: %m");
+}
+
+static int replay(void) {
+        _cleanup_(readahead_pack_done) ReadaheadPack pack = {};
+        char buf[FORMAT_BYTES_MAX];
+        size_t i, n_stale = 0;
+        uint64_t fsid, bytes = 0;
+        dev_t dev;
+        int r;
+
+        r = readahead_pack_read(&pack, READAHEAD_PACK);
+        if (r == -ENOENT) {
+                log_debug("No read-ahead data, nothing to replay.");
+                return 0;
+        }
+        if (r == -ENOMEM)
+                return log_oom();
+        if (r < 0) {
+                log_debug_errno(r, "Failed to read " READAHEAD_PACK ": %m");
+                discard_pack("Read-ahead data is corrupted");
+                return 0;
+        }
+
+        r = readahead_root_identify(&dev, &fsid);
+        if (r < 0)
+                return log_error_errno(r, "Failed to identify root file system: %m");
+
+        if (dev != pack.root_dev || fsid != pack.root_fsid) {
+                discard_pack("Root file system changed");
+                return 0;
+        }
+
+        /* Let the boot proceed, the files are read in parallel to it */
+        (void) sd_notify(false,
+                         "READY=1\n"
+                         "STATUS=Replaying read-ahead data");
+
+        for (i = 0; i < pack.n_entries; i++) {
+                const ReadaheadEntry *e = pack.entries + i;
+                _cleanup_close_ int fd = -1;
+                struct stat st;
+
+                fd = open(e->path, O_RDONLY|O_CLOEXEC|O_NOCTTY|O_NOFOLLOW|O_NOATIME);
+                if (fd < 0 && errno == EPERM)
+                        fd = open(e->path, O_RDONLY|O_CLOEXEC|O_NOCTTY|O_NOFOLLOW);
+                if (fd < 0) {
+                        n_stale++;
+                        continue;
+                }
+
+                if (fstat(fd, &st) < 0 || !readahead_entry_matches(e, &st)) {
+                        n_stale++;
+                        continue;
+                }
+
+                if (readahead(fd, 0, MIN(e->size, (uint64_t) READAHEAD_FILE_SIZE_MAX)) < 0) {
+                        log_debug_errno(errno, "Failed to read ahead %s, ignoring: %m", e->path);
+                        continue;
+                }
+
+                bytes += MIN(e->size, (uint64_t) READAHEAD_FILE_SIZE_MAX);
+        }
+
+        log_debug("Read ahead %zu files (%s), %zu were changed or removed since they were recorded.",
+                  pack.n_entries - n_stale, format_bytes(buf, sizeof(buf), bytes), n_stale);
+
+        /* If the files were updated, reinstalled or moved around, the order is not worth much anymore, and
+         * the list misses the new files. Remove it, so that it's recorded anew on the next boot. */
+        if (n_stale > pack.n_entries / 4)
+                discard_pack("Too many files changed since read-ahead data was recorded");
+
+        return 0;
+}
+
+static int run(int argc, char *argv[]) {
+        log_setup_service();
+
+        if (argc != 2)
+                return log_error_errno(SYNTHETIC_ERRNO(EINVAL),
+                                       "This program requires one argument.");
+
+        umask(0022);
+
+        if (streq(argv[1], "collect"))
+                return collect();
+        if (streq(argv[1], "replay"))
+                return replay();
+
+        return log_error_errno(SYNTHETIC_ERRNO(EINVAL), "Unknown verb '%s'.", argv[1]);
+}
+
+DEFINE_MAIN_FUNCTION(run);
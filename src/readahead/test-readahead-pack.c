@@ -0,0 +1,105 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <sys/sysmacros.h>
+#include <unistd.h>
+
+#include "fd-util.h"
+#include "fileio.h"
+#include "readahead-pack.h"
+#include "string-util.h"
+#include "tests.h"
+#include "tmpfile-util.h"
+
+static void test_sort(void) {
+        _cleanup_(readahead_pack_done) ReadaheadPack p = {};
+        struct stat st = { .st_mode = S_IFREG };
+
+        log_info("/* %s */", __func__);
+
+        assert_se(readahead_pack_add(&p, "/usr/lib/b", &st, UINT64_MAX) >= 0);
+        assert_se(readahead_pack_add(&p, "/usr/lib/c", &st, 4096) >= 0);
+        assert_se(readahead_pack_add(&p, "/usr/lib/a", &st, UINT64_MAX) >= 0);
+        assert_se(readahead_pack_add(&p, "/etc/d", &st, 0) >= 0);
+
+        readahead_pack_sort(&p);
+
+        assert_se(p.n_entries == 4);
+        assert_se(streq(p.entries[0].path, "/etc/d"));
+        assert_se(streq(p.entries[1].path, "/usr/lib/c"));
+        assert_se(streq(p.entries[2].path, "/usr/lib/a"));
+        assert_se(streq(p.entries[3].path, "/usr/lib/b"));
+}
+
+static void test_write_read(void) {
+        _cleanup_(readahead_pack_done) ReadaheadPack p = {}, q = {};
+        char fn[] = "/tmp/test-readahead-pack.XXXXXX";
+        _cleanup_close_ int fd = -1;
+        struct stat st;
+        size_t i;
+
+        log_info("/* %s */", __func__);
+
+        fd = mkostemp_safe(fn);
+        assert_se(fd >= 0);
+        assert_se(fstat(fd, &st) >= 0);
+
+        p.root_dev = makedev(8, 3);
+        p.root_fsid = UINT64_C(0xdeadbeefcafe0001);
+
+        assert_se(readahead_pack_add(&p, fn, &st, 123456) >= 0);
+        assert_se(readahead_pack_add(&p, "/usr/lib/with space\nand newline", &st, UINT64_MAX) >= 0);
+
+        assert_se(readahead_pack_write(&p, fn) >= 0);
+        assert_se(readahead_pack_read(&q, fn) >= 0);
+
+        assert_se(q.root_dev == p.root_dev);
+        assert_se(q.root_fsid == p.root_fsid);
+        assert_se(q.n_entries == p.n_entries);
+
+        for (i = 0; i < p.n_entries; i++) {
+                assert_se(streq(q.entries[i].path, p.entries[i].path));
+                assert_se(q.entries[i].inode == p.entries[i].inode);
+                assert_se(q.entries[i].size == p.entries[i].size);
+                assert_se(q.entries[i].mtime == p.entries[i].mtime);
+                assert_se(q.entries[i].physical == p.entries[i].physical);
+        }
+
+        /* The pack was written atomically over the original file, hence it's a different inode now */
+        assert_se(readahead_entry_matches(&q.entries[0], &st));
+        assert_se(stat(fn, &st) >= 0);
+        assert_se(!readahead_entry_matches(&q.entries[0], &st));
+
+        assert_se(unlink(fn) >= 0);
+        assert_se(readahead_pack_read(&q, fn) == -ENOENT);
+}
+
+static void test_read_invalid(void) {
+        _cleanup_(readahead_pack_done) ReadaheadPack p = {};
+        char fn[] = "/tmp/test-readahead-pack.XXXXXX";
+        _cleanup_close_ int fd = -1;
+
+        log_info("/* %s */", __func__);
+
+        fd = mkostemp_safe(fn);
+        assert_se(fd >= 0);
+
+        assert_se(write_string_file(fn, "READAHEAD-1 8:3 0x1\n1 2 3 4 relative/path", WRITE_STRING_FILE_CREATE) >= 0);
+        assert_se(readahead_pack_read(&p, fn) == -EBADMSG);
+        readahead_pack_done(&p);
+
+        assert_se(write_string_file(fn, "READAHEAD-0 8:3 0x1", WRITE_STRING_FILE_CREATE) >= 0);
+        assert_se(readahead_pack_read(&p, fn) == -EBADMSG);
+        readahead_pack_done(&p);
+
+        assert_se(unlink(fn) >= 0);
+}
+
+int main(int argc, char *argv[]) {
+        test_setup_logging(LOG_DEBUG);
+
+        test_sort();
+        test_write_read();
+        test_read_invalid();
+
+        return 0;
+}
@@ -1415,6 +1415,28 @@ static int bus_property_get_cache_statistics(
         return sd_bus_message_append(reply, "(ttt)", size, hit, miss);
 }
 
+static int bus_property_get_cache_evictions(
+                sd_bus *bus,
+                const char *path,
+                const char *interface,
+                const char *property,
+                sd_bus_message *reply,
+                void *userdata,
+                sd_bus_error *error) {
+
+        Manager *m = userdata;
+        uint64_t evict = 0;
+        DnsScope *s;
+
+        assert(reply);
+        assert(m);
+
+        LIST_FOREACH(scopes, s, m->dns_scopes)
+                evict += s->cache.n_evict;
+
+        return sd_bus_message_append(reply, "t", evict);
+}
+
 static int bus_property_get_dnssec_statistics(
                 sd_bus *bus,
                 const char *path,
@@ -1479,7 +1501,7 @@ static int bus_method_reset_statistics(sd_bus_message *message, void *userdata,
         assert(m);
 
         LIST_FOREACH(scopes, s, m->dns_scopes)
-                s->cache.n_hit = s->cache.n_miss = 0;
+                s->cache.n_hit = s->cache.n_miss = s->cache.n_evict = 0;
 
         m->n_transactions_total = 0;
         zero(m->n_dnssec_verdict);
@@ -1845,6 +1867,7 @@ static const sd_bus_vtable resolve_vtable[] = {
         SD_BUS_PROPERTY("Domains", "a(isb)", bus_property_get_domains, 0, 0),
         SD_BUS_PROPERTY("TransactionStatistics", "(tt)", bus_property_get_transaction_statistics, 0, 0),
         SD_BUS_PROPERTY("CacheStatistics", "(ttt)", bus_property_get_cache_statistics, 0, 0),
+        SD_BUS_PROPERTY("CacheEvictions", "t", bus_property_get_cache_evictions, 0, 0),
         SD_BUS_PROPERTY("DNSSEC", "s", bus_property_get_dnssec_mode, 0, 0),
         SD_BUS_PROPERTY("DNSSECStatistics", "(tttt)", bus_property_get_dnssec_statistics, 0, 0),
         SD_BUS_PROPERTY("DNSSECSupported", "b", bus_property_get_dnssec_supported, 0, 0),
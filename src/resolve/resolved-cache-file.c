@@ -0,0 +1,257 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "alloc-util.h"
+#include "fd-util.h"
+#include "fileio.h"
+#include "resolved-cache-file.h"
+#include "resolved-dns-cache.h"
+#include "resolved-dns-server.h"
+#include "resolved-link.h"
+#include "sparse-endian.h"
+#include "string-util.h"
+#include "tmpfile-util.h"
+
+/* The contents of the unicast DNS caches, written on shutdown and read back on the next start. This lives
+ * in /run, hence it never survives a reboot, and hence we can use CLOCK_BOOTTIME based expiry times
+ * internally. The timestamp in the header is CLOCK_REALTIME though, so that we notice how much time passed
+ * between writing and reading the file. */
+#define PRIVATE_CACHE_FILE "/run/systemd/resolve/cache.bin"
+
+#define CACHE_FILE_MAGIC "RSLVCCH1"
+
+/* Don't read anything absurdly large, a DNS server string is at most a few hundred bytes */
+#define CACHE_FILE_SERVER_SIZE_MAX 1024U
+
+typedef struct CacheFileHeader {
+        char magic[STRLEN(CACHE_FILE_MAGIC)];
+        le64_t timestamp;
+} _packed_ CacheFileHeader;
+
+enum {
+        CACHE_FILE_AUTHENTICATED = 1 << 0,
+};
+
+/* Followed by the string of the DNS server the RRs were received from, and a DNS packet carrying them in
+ * its answer section */
+typedef struct CacheFileBlock {
+        le32_t ifindex;
+        le32_t flags;
+        le32_t server_size;
+        le32_t packet_size;
+} _packed_ CacheFileBlock;
+
+static int write_scope_cache(DnsScope *s, FILE *f) {
+        DnsServer *server;
+        const char *server_string;
+        unsigned k;
+        int r;
+
+        assert(f);
+
+        if (!s || dns_cache_is_empty(&s->cache))
+                return 0;
+
+        /* Don't use dns_scope_get_dns_server() here, we don't want to switch servers (and flush the cache)
+         * while writing it out */
+        server = s->link ? s->link->current_dns_server : s->manager->current_dns_server;
+        if (!server)
+                return 0;
+
+        server_string = dns_server_string(server);
+        if (!server_string)
+                return -ENOMEM;
+
+        for (k = 0; k < 2; k++) {
+                _cleanup_(dns_packet_unrefp) DnsPacket *packets = NULL;
+                bool authenticated = k > 0;
+                DnsPacket *p;
+
+                r = dns_cache_export_to_packet(&s->cache, authenticated, &packets);
+                if (r < 0)
+                        return r;
+
+                for (p = packets; p; p = p->more) {
+                        CacheFileBlock b = {
+                                .ifindex = htole32(dns_scope_ifindex(s)),
+                                .flags = htole32(authenticated ? CACHE_FILE_AUTHENTICATED : 0),
+                                .server_size = htole32(strlen(server_string)),
+                                .packet_size = htole32(p->size),
+                        };
+
+                        fwrite(&b, sizeof(b), 1, f);
+                        fputs(server_string, f);
+                        fwrite(DNS_PACKET_DATA(p), p->size, 1, f);
+                }
+        }
+
+        return 0;
+}
+
+int manager_write_cache(Manager *m) {
+        _cleanup_free_ char *temp_path = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        CacheFileHeader h = {};
+        Iterator i;
+        Link *l;
+        int r;
+
+        assert(m);
+
+        if (!m->persistent_cache || m->enable_cache == DNS_CACHE_MODE_NO) {
+                (void) unlink(PRIVATE_CACHE_FILE);
+                return 0;
+        }
+
+        r = fopen_temporary(PRIVATE_CACHE_FILE, &f, &temp_path);
+        if (r < 0)
+                goto fail;
+
+        /* The cache contents are private, they tell what was looked up recently */
+        (void) fchmod(fileno(f), 0600);
+
+        memcpy(h.magic, CACHE_FILE_MAGIC, sizeof(h.magic));
+        h.timestamp = htole64(now(CLOCK_REALTIME));
+        fwrite(&h, sizeof(h), 1, f);
+
+        r = write_scope_cache(m->unicast_scope, f);
+        if (r < 0)
+                goto fail;
+
+        HASHMAP_FOREACH(l, m->links, i) {
+                r = write_scope_cache(l->unicast_scope, f);
+                if (r < 0)
+                        goto fail;
+        }
+
+        r = fflush_and_check(f);
+        if (r < 0)
+                goto fail;
+
+        if (rename(temp_path, PRIVATE_CACHE_FILE) < 0) {
+                r = -errno;
+                goto fail;
+        }
+
+        return 0;
+
+fail:
+        (void) unlink(PRIVATE_CACHE_FILE);
+
+        if (temp_path)
+                (void) unlink(temp_path);
+
+        return log_warning_errno(r, "Failed to write DNS cache to %s: %m", PRIVATE_CACHE_FILE);
+}
+
+static DnsScope *manager_find_unicast_scope(Manager *m, int ifindex) {
+        Link *l;
+
+        assert(m);
+
+        if (ifindex == 0)
+                return m->unicast_scope;
+
+        l = hashmap_get(m->links, INT_TO_PTR(ifindex));
+        if (!l)
+                return NULL;
+
+        return l->unicast_scope;
+}
+
+int manager_read_cache(Manager *m) {
+        _cleanup_fclose_ FILE *f = NULL;
+        CacheFileHeader h;
+        unsigned n = 0;
+        usec_t elapsed;
+        int r;
+
+        assert(m);
+
+        if (!m->persistent_cache || m->enable_cache == DNS_CACHE_MODE_NO)
+                return 0;
+
+        f = fopen(PRIVATE_CACHE_FILE, "re");
+        if (!f) {
+                if (errno == ENOENT)
+                        return 0;
+
+                return log_warning_errno(errno, "Failed to open %s: %m", PRIVATE_CACHE_FILE);
+        }
+
+        /* Read the file only once, the entries are in our cache from now on */
+        (void) unlink(PRIVATE_CACHE_FILE);
+
+        if (fread(&h, sizeof(h), 1, f) != 1 ||
+            memcmp(h.magic, CACHE_FILE_MAGIC, sizeof(h.magic)) != 0) {
+                log_debug("%s has an invalid header, ignoring.", PRIVATE_CACHE_FILE);
+                return 0;
+        }
+
+        elapsed = LESS_BY(now(CLOCK_REALTIME), (usec_t) le64toh(h.timestamp));
+
+        for (;;) {
+                _cleanup_(dns_packet_unrefp) DnsPacket *p = NULL;
+                _cleanup_free_ char *server_string = NULL;
+                size_t server_size, packet_size;
+                DnsServer *server;
+                DnsScope *scope;
+                CacheFileBlock b;
+
+                if (fread(&b, sizeof(b), 1, f) != 1) {
+                        if (ferror(f))
+                                return log_warning_errno(errno > 0 ? errno : EIO, "Failed to read %s: %m", PRIVATE_CACHE_FILE);
+
+                        break;
+                }
+
+                server_size = le32toh(b.server_size);
+                packet_size = le32toh(b.packet_size);
+                if (server_size <= 0 || server_size > CACHE_FILE_SERVER_SIZE_MAX ||
+                    packet_size < DNS_PACKET_HEADER_SIZE || packet_size > DNS_PACKET_SIZE_MAX) {
+                        log_debug("%s contains an invalid block, ignoring the rest.", PRIVATE_CACHE_FILE);
+                        break;
+                }
+
+                server_string = new(char, server_size + 1);
+                if (!server_string)
+                        return log_oom();
+
+                r = dns_packet_new(&p, DNS_PROTOCOL_DNS, packet_size, DNS_PACKET_SIZE_MAX);
+                if (r < 0)
+                        return log_oom();
+
+                if (fread(server_string, server_size, 1, f) != 1 ||
+                    fread(DNS_PACKET_DATA(p), packet_size, 1, f) != 1) {
+                        log_debug("%s is truncated, ignoring the rest.", PRIVATE_CACHE_FILE);
+                        break;
+                }
+
+                server_string[server_size] = 0;
+                p->size = packet_size;
+
+                /* Only use the RRs if they were received from the same server we'd ask now. Note that
+                 * selecting the server might flush the scope's cache, hence do this before adding
+                 * anything. */
+                scope = manager_find_unicast_scope(m, (int) le32toh(b.ifindex));
+                if (!scope)
+                        continue;
+
+                server = dns_scope_get_dns_server(scope);
+                if (!server || !streq_ptr(dns_server_string(server), server_string))
+                        continue;
+
+                r = dns_cache_import_packet(&scope->cache, p, le32toh(b.flags) & CACHE_FILE_AUTHENTICATED, elapsed, dns_scope_ifindex(scope));
+                if (r < 0) {
+                        log_debug_errno(r, "Failed to add RRs from %s to cache, ignoring: %m", PRIVATE_CACHE_FILE);
+                        continue;
+                }
+
+                n += r;
+        }
+
+        log_debug("Loaded %u RRs from %s into the cache.", n, PRIVATE_CACHE_FILE);
+        return 0;
+}
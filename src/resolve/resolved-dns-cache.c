@@ -11,10 +11,6 @@
 #include "resolved-dns-packet.h"
 #include "string-util.h"
 
-/* Never cache more than 4K entries. RFC 1536, Section 5 suggests to
- * leave DNS caches unbounded, but that's crazy. */
-#define CACHE_MAX 4096
-
 /* We never keep any item longer than 2h in our cache */
 #define CACHE_TTL_MAX_USEC (2 * USEC_PER_HOUR)
 
@@ -22,8 +18,12 @@
  * now) */
 #define CACHE_TTL_STRANGE_RCODE_USEC (30 * USEC_PER_SEC)
 
+/* Entries that were hit at least this often are refreshed once less than 1/CACHE_PREFETCH_DIVISOR of their
+ * lifetime is left, so that popular names don't expire right under their users */
+#define CACHE_PREFETCH_HITS_MIN 3U
+#define CACHE_PREFETCH_DIVISOR 10U
+
 typedef enum DnsCacheItemType DnsCacheItemType;
-typedef struct DnsCacheItem DnsCacheItem;
 
 enum DnsCacheItemType {
         DNS_CACHE_POSITIVE,
@@ -38,7 +38,9 @@ struct DnsCacheItem {
         DnsResourceRecord *rr;
         int rcode;
 
+        usec_t timestamp;
         usec_t until;
+        unsigned n_hit;
         bool authenticated:1;
         bool shared_owner:1;
 
@@ -48,6 +50,7 @@ struct DnsCacheItem {
 
         unsigned prioq_idx;
         LIST_FIELDS(DnsCacheItem, by_key);
+        LIST_FIELDS(DnsCacheItem, by_lru);
 };
 
 static const char *dns_cache_item_type_to_string(DnsCacheItem *item) {
@@ -82,6 +85,35 @@ static void dns_cache_item_free(DnsCacheItem *i) {
 
 DEFINE_TRIVIAL_CLEANUP_FUNC(DnsCacheItem*, dns_cache_item_free);
 
+static void dns_cache_lru_link(DnsCache *c, DnsCacheItem *i) {
+        assert(c);
+        assert(i);
+
+        LIST_PREPEND(by_lru, c->by_lru, i);
+        if (!c->lru_tail)
+                c->lru_tail = i;
+}
+
+static void dns_cache_lru_unlink(DnsCache *c, DnsCacheItem *i) {
+        assert(c);
+        assert(i);
+
+        if (c->lru_tail == i)
+                c->lru_tail = i->by_lru_prev;
+        LIST_REMOVE(by_lru, c->by_lru, i);
+}
+
+static void dns_cache_item_touch(DnsCache *c, DnsCacheItem *i) {
+        assert(c);
+        assert(i);
+
+        if (c->by_lru == i)
+                return;
+
+        dns_cache_lru_unlink(c, i);
+        dns_cache_lru_link(c, i);
+}
+
 static void dns_cache_item_unlink_and_free(DnsCache *c, DnsCacheItem *i) {
         DnsCacheItem *first;
 
@@ -99,6 +131,7 @@ static void dns_cache_item_unlink_and_free(DnsCache *c, DnsCacheItem *i) {
                 hashmap_remove(c->by_key, i->key);
 
         prioq_remove(c->by_expiry, i, &i->prioq_idx);
+        dns_cache_lru_unlink(c, i);
 
         dns_cache_item_free(i);
 }
@@ -133,6 +166,7 @@ static bool dns_cache_remove_by_key(DnsCache *c, DnsResourceKey *key) {
 
         LIST_FOREACH_SAFE(by_key, i, n, first) {
                 prioq_remove(c->by_expiry, i, &i->prioq_idx);
+                dns_cache_lru_unlink(c, i);
                 dns_cache_item_free(i);
         }
 
@@ -149,21 +183,32 @@ void dns_cache_flush(DnsCache *c) {
 
         assert(hashmap_size(c->by_key) == 0);
         assert(prioq_size(c->by_expiry) == 0);
+        assert(!c->by_lru && !c->lru_tail);
 
         c->by_key = hashmap_free(c->by_key);
         c->by_expiry = prioq_free(c->by_expiry);
 }
 
 static void dns_cache_make_space(DnsCache *c, unsigned add) {
+        unsigned size_max;
+        usec_t t = 0;
+
         assert(c);
 
         if (add <= 0)
                 return;
 
+        size_max = c->size_max > 0 ? c->size_max : DNS_CACHE_SIZE_DEFAULT;
+
         /* Makes space for n new entries. Note that we actually allow
-         * the cache to grow beyond CACHE_MAX, but only when we shall
-         * add more RRs to the cache than CACHE_MAX at once. In that
-         * case the cache will be emptied completely otherwise. */
+         * the cache to grow beyond the maximum size, but only when we
+         * shall add more RRs to the cache than that at once. In that
+         * case the cache will be emptied completely otherwise.
+         *
+         * Entries that expired already (including those we keep
+         * around to serve stale answers from) are dropped first. After that,
+         * the entries that were used least recently are evicted, so
+         * that popular names stay cached even if their TTL is short. */
 
         for (;;) {
                 _cleanup_(dns_resource_key_unrefp) DnsResourceKey *key = NULL;
@@ -172,12 +217,22 @@ static void dns_cache_make_space(DnsCache *c, unsigned add) {
                 if (prioq_size(c->by_expiry) <= 0)
                         break;
 
-                if (prioq_size(c->by_expiry) + add < CACHE_MAX)
+                if (prioq_size(c->by_expiry) + add <= size_max)
                         break;
 
+                if (t <= 0)
+                        t = now(clock_boottime_or_monotonic());
+
                 i = prioq_peek(c->by_expiry);
                 assert(i);
 
+                if (i->until > t) {
+                        i = c->lru_tail;
+                        assert(i);
+
+                        c->n_evict++;
+                }
+
                 /* Take an extra reference to the key so that it
                  * doesn't go away in the middle of the remove call */
                 key = dns_resource_key_ref(i->key);
@@ -190,7 +245,8 @@ void dns_cache_prune(DnsCache *c) {
 
         assert(c);
 
-        /* Remove all entries that are past their TTL */
+        /* Remove all entries that are past their TTL, plus the time we keep them around to answer from while
+         * they are refreshed */
 
         for (;;) {
                 DnsCacheItem *i;
@@ -203,7 +259,7 @@ void dns_cache_prune(DnsCache *c) {
                 if (t <= 0)
                         t = now(clock_boottime_or_monotonic());
 
-                if (i->until > t)
+                if (usec_add(i->until, c->stale_retention_usec) > t)
                         break;
 
                 /* Depending whether this is an mDNS shared entry
@@ -284,6 +340,8 @@ static int dns_cache_link_item(DnsCache *c, DnsCacheItem *i) {
                 }
         }
 
+        dns_cache_lru_link(c, i);
+
         return 0;
 }
 
@@ -367,7 +425,9 @@ static void dns_cache_item_update_positive(
         dns_resource_key_unref(i->key);
         i->key = dns_resource_key_ref(rr->key);
 
+        i->timestamp = timestamp;
         i->until = calculate_until(rr, (uint32_t) -1, timestamp, false);
+        i->n_hit = 0;
         i->authenticated = authenticated;
         i->shared_owner = shared_owner;
 
@@ -377,6 +437,7 @@ static void dns_cache_item_update_positive(
         i->owner_address = *owner_address;
 
         prioq_reshuffle(c->by_expiry, i, &i->prioq_idx);
+        dns_cache_item_touch(c, i);
 }
 
 static int dns_cache_put_positive(
@@ -443,6 +504,7 @@ static int dns_cache_put_positive(
         i->type = DNS_CACHE_POSITIVE;
         i->key = dns_resource_key_ref(rr->key);
         i->rr = dns_resource_record_ref(rr);
+        i->timestamp = timestamp;
         i->until = calculate_until(rr, (uint32_t) -1, timestamp, false);
         i->authenticated = authenticated;
         i->shared_owner = shared_owner;
@@ -528,6 +590,7 @@ static int dns_cache_put_negative(
         i->type =
                 rcode == DNS_RCODE_SUCCESS ? DNS_CACHE_NODATA :
                 rcode == DNS_RCODE_NXDOMAIN ? DNS_CACHE_NXDOMAIN : DNS_CACHE_RCODE;
+        i->timestamp = timestamp;
         i->until =
                 i->type == DNS_CACHE_RCODE ? timestamp + CACHE_TTL_STRANGE_RCODE_USEC :
                 calculate_until(soa, nsec_ttl, timestamp, true);
@@ -822,14 +885,38 @@ static DnsCacheItem *dns_cache_get_by_key_follow_cname_dname_nsec(DnsCache *c, D
         return NULL;
 }
 
-int dns_cache_lookup(DnsCache *c, DnsResourceKey *key, bool clamp_ttl, int *rcode, DnsAnswer **ret, bool *authenticated) {
+static void dns_cache_count_hit(DnsCache *c, bool stale, bool refresh, bool *ret_refresh) {
+        assert(c);
+
+        c->n_hit++;
+        if (stale)
+                c->n_stale++;
+
+        if (ret_refresh)
+                *ret_refresh = refresh;
+}
+
+static bool dns_cache_item_want_prefetch(DnsCache *c, DnsCacheItem *i, usec_t current) {
+        assert(c);
+        assert(i);
+
+        if (!c->prefetch)
+                return false;
+
+        if (i->n_hit < CACHE_PREFETCH_HITS_MIN)
+                return false;
+
+        return LESS_BY(i->until, current) <= (i->until - i->timestamp) / CACHE_PREFETCH_DIVISOR;
+}
+
+int dns_cache_lookup(DnsCache *c, DnsResourceKey *key, bool clamp_ttl, int *rcode, DnsAnswer **ret, bool *authenticated, bool *ret_refresh) {
         _cleanup_(dns_answer_unrefp) DnsAnswer *answer = NULL;
         char key_str[DNS_RESOURCE_KEY_STRING_MAX];
         unsigned n = 0;
         int r;
         bool nxdomain = false;
         DnsCacheItem *j, *first, *nsec = NULL;
-        bool have_authenticated = false, have_non_authenticated = false;
+        bool have_authenticated = false, have_non_authenticated = false, stale = false, refresh;
         usec_t current;
         int found_rcode = -1;
 
@@ -839,6 +926,9 @@ int dns_cache_lookup(DnsCache *c, DnsResourceKey *key, bool clamp_ttl, int *rcod
         assert(ret);
         assert(authenticated);
 
+        if (ret_refresh)
+                *ret_refresh = false;
+
         if (key->type == DNS_TYPE_ANY || key->class == DNS_CLASS_ANY) {
                 /* If we have ANY lookups we don't use the cache, so
                  * that the caller refreshes via the network. */
@@ -871,7 +961,17 @@ int dns_cache_lookup(DnsCache *c, DnsResourceKey *key, bool clamp_ttl, int *rcod
                 return 0;
         }
 
+        current = now(clock_boottime_or_monotonic());
+
         LIST_FOREACH(by_key, j, first) {
+                dns_cache_item_touch(c, j);
+                j->n_hit++;
+
+                /* Expired entries are removed by dns_cache_prune(), unless we keep them around for
+                 * serving stale answers while they are refreshed */
+                if (c->stale_retention_usec > 0 && j->until <= current)
+                        stale = true;
+
                 if (j->rr) {
                         if (j->rr->key->type == DNS_TYPE_NSEC)
                                 nsec = j;
@@ -888,6 +988,10 @@ int dns_cache_lookup(DnsCache *c, DnsResourceKey *key, bool clamp_ttl, int *rcod
                         have_non_authenticated = true;
         }
 
+        /* If the entry is stale, or popular and about to expire, let the caller know that it should be
+         * refreshed from the network */
+        refresh = stale || dns_cache_item_want_prefetch(c, first, current);
+
         if (found_rcode >= 0) {
                 log_debug("RCODE %s cache hit for %s",
                           dns_rcode_to_string(found_rcode),
@@ -897,7 +1001,7 @@ int dns_cache_lookup(DnsCache *c, DnsResourceKey *key, bool clamp_ttl, int *rcod
                 *rcode = found_rcode;
                 *authenticated = false;
 
-                c->n_hit++;
+                dns_cache_count_hit(c, stale, refresh, ret_refresh);
                 return 1;
         }
 
@@ -919,7 +1023,7 @@ int dns_cache_lookup(DnsCache *c, DnsResourceKey *key, bool clamp_ttl, int *rcod
                 if (!bitmap_isset(nsec->rr->nsec.types, key->type) &&
                     !bitmap_isset(nsec->rr->nsec.types, DNS_TYPE_CNAME) &&
                     !bitmap_isset(nsec->rr->nsec.types, DNS_TYPE_DNAME)) {
-                        c->n_hit++;
+                        dns_cache_count_hit(c, stale, refresh, ret_refresh);
                         return 1;
                 }
 
@@ -927,13 +1031,14 @@ int dns_cache_lookup(DnsCache *c, DnsResourceKey *key, bool clamp_ttl, int *rcod
                 return 0;
         }
 
-        log_debug("%s cache hit for %s",
+        log_debug("%s%s cache hit for %s",
+                  stale    ? "Stale " : "",
                   n > 0    ? "Positive" :
                   nxdomain ? "NXDOMAIN" : "NODATA",
                   dns_resource_key_to_string(key, key_str, sizeof key_str));
 
         if (n <= 0) {
-                c->n_hit++;
+                dns_cache_count_hit(c, stale, refresh, ret_refresh);
 
                 *ret = NULL;
                 *rcode = nxdomain ? DNS_RCODE_NXDOMAIN : DNS_RCODE_SUCCESS;
@@ -945,16 +1050,21 @@ int dns_cache_lookup(DnsCache *c, DnsResourceKey *key, bool clamp_ttl, int *rcod
         if (!answer)
                 return -ENOMEM;
 
-        if (clamp_ttl)
-                current = now(clock_boottime_or_monotonic());
-
         LIST_FOREACH(by_key, j, first) {
                 _cleanup_(dns_resource_record_unrefp) DnsResourceRecord *rr = NULL;
 
                 if (!j->rr)
                         continue;
 
-                if (clamp_ttl) {
+                if (stale) {
+                        /* The original TTL is meaningless for stale data, use a short one, so that clients
+                         * come back soon and get the refreshed data. */
+                        rr = dns_resource_record_ref(j->rr);
+
+                        r = dns_resource_record_clamp_ttl(&rr, DNS_CACHE_STALE_TTL_SEC);
+                        if (r < 0)
+                                return r;
+                } else if (clamp_ttl) {
                         rr = dns_resource_record_ref(j->rr);
 
                         r = dns_resource_record_clamp_ttl(&rr, LESS_BY(j->until, current) / USEC_PER_SEC);
@@ -967,7 +1077,7 @@ int dns_cache_lookup(DnsCache *c, DnsResourceKey *key, bool clamp_ttl, int *rcod
                         return r;
         }
 
-        c->n_hit++;
+        dns_cache_count_hit(c, stale, refresh, ret_refresh);
 
         *ret = answer;
         *rcode = DNS_RCODE_SUCCESS;
@@ -1062,6 +1172,133 @@ int dns_cache_export_shared_to_packet(DnsCache *cache, DnsPacket *p) {
         return 0;
 }
 
+int dns_cache_export_to_packet(DnsCache *cache, bool authenticated, DnsPacket **ret) {
+        _cleanup_(dns_packet_unrefp) DnsPacket *first = NULL;
+        DnsPacket *p = NULL;
+        unsigned ancount = 0;
+        Iterator iterator;
+        DnsCacheItem *i;
+        usec_t t;
+        int r;
+
+        assert(cache);
+        assert(ret);
+
+        /* Writes all positive entries with the specified authentication state to the answer section of a
+         * chain of packets, with the TTLs lowered to the time that is left until they expire. Shared mDNS
+         * entries and entries that will expire within a second are skipped. */
+
+        t = now(clock_boottime_or_monotonic());
+
+        HASHMAP_FOREACH(i, cache->by_key, iterator) {
+                DnsCacheItem *j;
+
+                LIST_FOREACH(by_key, j, i) {
+                        _cleanup_(dns_resource_record_unrefp) DnsResourceRecord *rr = NULL;
+
+                        if (!j->rr)
+                                continue;
+
+                        if (j->shared_owner || j->authenticated != authenticated)
+                                continue;
+
+                        if (j->until <= t + USEC_PER_SEC)
+                                continue;
+
+                        rr = dns_resource_record_ref(j->rr);
+                        r = dns_resource_record_clamp_ttl(&rr, (j->until - t) / USEC_PER_SEC);
+                        if (r < 0)
+                                return r;
+
+                        if (p)
+                                r = dns_packet_append_rr(p, rr, 0, NULL, NULL);
+                        if (!p || r == -EMSGSIZE) {
+                                DnsPacket *n;
+
+                                /* Start a new packet if this is the first RR, or the current one is full */
+
+                                r = dns_packet_new(&n, DNS_PROTOCOL_DNS, 0, DNS_PACKET_SIZE_MAX);
+                                if (r < 0)
+                                        return r;
+
+                                if (p) {
+                                        DNS_PACKET_HEADER(p)->ancount = htobe16(ancount);
+                                        p->more = n;
+                                } else
+                                        first = n;
+
+                                p = n;
+                                ancount = 0;
+
+                                r = dns_packet_append_rr(p, rr, 0, NULL, NULL);
+                        }
+                        if (r < 0)
+                                return r;
+
+                        ancount++;
+                }
+        }
+
+        if (p)
+                DNS_PACKET_HEADER(p)->ancount = htobe16(ancount);
+
+        *ret = TAKE_PTR(first);
+        return 0;
+}
+
+int dns_cache_import_packet(DnsCache *cache, DnsPacket *p, bool authenticated, usec_t elapsed, int ifindex) {
+        _cleanup_(dns_answer_unrefp) DnsAnswer *answer = NULL;
+        union in_addr_union owner_address = {};
+        DnsResourceRecord *rr;
+        uint32_t elapsed_sec;
+        int r;
+
+        assert(cache);
+        assert(p);
+
+        /* The reverse of dns_cache_export_to_packet(): adds the RRs from the answer section of the packet
+         * to the cache, with their TTLs reduced by the time that elapsed since the packet was written.
+         * Returns the number of RRs that had time left. */
+
+        r = dns_packet_extract(p);
+        if (r < 0)
+                return r;
+
+        if (dns_answer_size(p->answer) <= 0)
+                return 0;
+
+        answer = dns_answer_new(dns_answer_size(p->answer));
+        if (!answer)
+                return -ENOMEM;
+
+        elapsed_sec = (uint32_t) MIN(DIV_ROUND_UP(elapsed, USEC_PER_SEC), (usec_t) UINT32_MAX);
+
+        DNS_ANSWER_FOREACH(rr, p->answer) {
+                _cleanup_(dns_resource_record_unrefp) DnsResourceRecord *copy = NULL;
+
+                if (rr->ttl <= elapsed_sec)
+                        continue;
+
+                copy = dns_resource_record_ref(rr);
+                r = dns_resource_record_clamp_ttl(&copy, rr->ttl - elapsed_sec);
+                if (r < 0)
+                        return r;
+
+                r = dns_answer_add(answer, copy, ifindex, DNS_ANSWER_CACHEABLE | (authenticated ? DNS_ANSWER_AUTHENTICATED : 0));
+                if (r < 0)
+                        return r;
+        }
+
+        if (dns_answer_size(answer) <= 0)
+                return 0;
+
+        r = dns_cache_put(cache, DNS_CACHE_MODE_YES, NULL, DNS_RCODE_SUCCESS, answer, authenticated, UINT32_MAX, 0, AF_UNSPEC, &owner_address);
+        if (r < 0)
+                return r;
+
+        return (int) dns_answer_size(answer);
+}
+
 void dns_cache_dump(DnsCache *cache, FILE *f) {
         Iterator iterator;
         DnsCacheItem *i;
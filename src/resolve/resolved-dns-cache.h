@@ -7,11 +7,34 @@
 #include "resolve-util.h"
 #include "time-util.h"
 
+/* Never cache more than 4K entries by default. RFC 1536, Section 5 suggests to leave DNS caches unbounded,
+ * but that's crazy. */
+#define DNS_CACHE_SIZE_DEFAULT 4096U
+
+/* The TTL to use for answers served from entries that already expired, see RFC 8767, Section 4 */
+#define DNS_CACHE_STALE_TTL_SEC 30U
+
+typedef struct DnsCacheItem DnsCacheItem;
+
 typedef struct DnsCache {
         Hashmap *by_key;
         Prioq *by_expiry;
+
+        /* All items, most recently used first */
+        LIST_HEAD(DnsCacheItem, by_lru);
+        DnsCacheItem *lru_tail;
+
+        unsigned size_max; /* 0 means DNS_CACHE_SIZE_DEFAULT */
+
+        /* How long to keep entries past their TTL to answer from while they are refreshed, 0 to disable */
+        usec_t stale_retention_usec;
+        /* Whether to ask for refreshing popular entries shortly before they expire */
+        bool prefetch;
+
         unsigned n_hit;
         unsigned n_miss;
+        unsigned n_evict;
+        unsigned n_stale;
 } DnsCache;
 
 #include "resolved-dns-answer.h"
@@ -23,7 +46,7 @@ void dns_cache_flush(DnsCache *c);
 void dns_cache_prune(DnsCache *c);
 
 int dns_cache_put(DnsCache *c, DnsCacheMode cache_mode, DnsResourceKey *key, int rcode, DnsAnswer *answer, bool authenticated, uint32_t nsec_ttl, usec_t timestamp, int owner_family, const union in_addr_union *owner_address);
-int dns_cache_lookup(DnsCache *c, DnsResourceKey *key, bool clamp_ttl, int *rcode, DnsAnswer **answer, bool *authenticated);
+int dns_cache_lookup(DnsCache *c, DnsResourceKey *key, bool clamp_ttl, int *rcode, DnsAnswer **answer, bool *authenticated, bool *ret_refresh);
 
 int dns_cache_check_conflicts(DnsCache *cache, DnsResourceRecord *rr, int owner_family, const union in_addr_union *owner_address);
 
@@ -33,3 +56,6 @@ bool dns_cache_is_empty(DnsCache *cache);
 unsigned dns_cache_size(DnsCache *cache);
 
 int dns_cache_export_shared_to_packet(DnsCache *cache, DnsPacket *p);
+
+int dns_cache_export_to_packet(DnsCache *cache, bool authenticated, DnsPacket **ret);
+int dns_cache_import_packet(DnsCache *cache, DnsPacket *p, bool authenticated, usec_t elapsed, int ifindex);
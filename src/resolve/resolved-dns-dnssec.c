@@ -9,6 +9,8 @@
 #include "memory-util.h"
 #include "resolved-dns-dnssec.h"
 #include "resolved-dns-packet.h"
+#include "set.h"
+#include "siphash24.h"
 #include "sort-util.h"
 #include "string-table.h"
 
@@ -21,6 +23,9 @@
 /* Maximum number of NSEC3 iterations we'll do. RFC5155 says 2500 shall be the maximum useful value */
 #define NSEC3_ITERATIONS_MAX 2500
 
+/* Maximum number of successfully verified signatures we remember */
+#define VERIFIED_SIGNATURES_MAX 4096U
+
 /*
  * The DNSSEC Chain of trust:
  *
@@ -110,6 +115,91 @@ int dnssec_canonicalize(const char *n, char *buffer, size_t buffer_max) {
 
 #if HAVE_GCRYPT
 
+/* The same RRset, signed by the same RRSIG with the same DNSKEY, is frequently verified again, for example
+ * when a SOA or NSEC RR shows up in the authority section of many replies. The public key operation is by
+ * far the most expensive part of the verification, hence remember a digest of everything that went into
+ * it for the signatures that verified correctly, and skip it next time. Note that the validity interval of
+ * the RRSIG is still checked on every verification, and that the signed data covers it. */
+
+typedef struct VerifiedSignature {
+        uint8_t digest[32];
+} VerifiedSignature;
+
+static Set *verified_signatures = NULL;
+
+static void verified_signature_hash_func(const VerifiedSignature *v, struct siphash *state) {
+        siphash24_compress(v->digest, sizeof(v->digest), state);
+}
+
+static int verified_signature_compare_func(const VerifiedSignature *x, const VerifiedSignature *y) {
+        return memcmp(x->digest, y->digest, sizeof(x->digest));
+}
+
+DEFINE_PRIVATE_HASH_OPS_WITH_KEY_DESTRUCTOR(verified_signature_hash_ops, VerifiedSignature,
+                                            verified_signature_hash_func, verified_signature_compare_func, free);
+
+static int verified_signature_digest(
+                const void *data, size_t size,
+                DnsResourceRecord *rrsig,
+                DnsResourceRecord *dnskey,
+                VerifiedSignature *ret) {
+
+        _cleanup_(gcry_md_closep) gcry_md_hd_t md = NULL;
+        void *digest;
+
+        assert(data);
+        assert(rrsig);
+        assert(dnskey);
+        assert(ret);
+
+        assert_cc(sizeof(ret->digest) == 32); /* SHA256 */
+
+        gcry_md_open(&md, GCRY_MD_SHA256, 0);
+        if (!md)
+                return -EIO;
+
+        gcry_md_write(md, data, size);
+        gcry_md_write(md, rrsig->rrsig.signature, rrsig->rrsig.signature_size);
+        gcry_md_write(md, dnskey->dnskey.key, dnskey->dnskey.key_size);
+
+        digest = gcry_md_read(md, 0);
+        if (!digest)
+                return -EIO;
+
+        memcpy(ret->digest, digest, sizeof(ret->digest));
+        return 0;
+}
+
+static int verified_signature_add(const VerifiedSignature *v) {
+        _cleanup_free_ VerifiedSignature *copy = NULL;
+        int r;
+
+        assert(v);
+
+        /* Don't bother with any replacement logic, the entries are cheap to recalculate */
+        if (set_size(verified_signatures) >= VERIFIED_SIGNATURES_MAX)
+                set_clear(verified_signatures);
+
+        r = set_ensure_allocated(&verified_signatures, &verified_signature_hash_ops);
+        if (r < 0)
+                return r;
+
+        copy = newdup(VerifiedSignature, v, 1);
+        if (!copy)
+                return -ENOMEM;
+
+        r = set_put(verified_signatures, copy);
+        if (r <= 0)
+                return r;
+
+        TAKE_PTR(copy);
+        return 0;
+}
+
+void dnssec_flush_verified_signatures(void) {
+        verified_signatures = set_free(verified_signatures);
+}
+
 static int rr_compare(DnsResourceRecord * const *a, DnsResourceRecord * const *b) {
         const DnsResourceRecord *x = *a, *y = *b;
         size_t m;
@@ -693,6 +783,7 @@ int dnssec_verify_rrset(
         size_t sig_size = 0;
         _cleanup_free_ char *sig_data = NULL;
         _cleanup_fclose_ FILE *f = NULL;
+        VerifiedSignature verified;
         size_t hash_size;
         void *hash;
         bool wildcard;
@@ -846,6 +937,15 @@ int dnssec_verify_rrset(
 
         initialize_libgcrypt(false);
 
+        r = verified_signature_digest(sig_data, sig_size, rrsig, dnskey, &verified);
+        if (r < 0)
+                return r;
+
+        if (set_contains(verified_signatures, &verified)) {
+                r = 1;
+                goto finish;
+        }
+
         switch (rrsig->rrsig.algorithm) {
 #if GCRYPT_VERSION_NUMBER >= 0x010600
         case DNSSEC_ALGORITHM_ED25519:
@@ -915,6 +1015,10 @@ int dnssec_verify_rrset(
         if (r < 0)
                 return r;
 
+        if (r > 0)
+                (void) verified_signature_add(&verified);
+
+finish:
         /* Now, fix the ttl, expiry, and remember the synthesizing source and the signer */
         if (r > 0)
                 dnssec_fix_rrset_ttl(list, n, rrsig, realtime);
@@ -2228,6 +2332,9 @@ int dnssec_verify_rrset(
         return -EOPNOTSUPP;
 }
 
+void dnssec_flush_verified_signatures(void) {
+}
+
 int dnssec_rrsig_match_dnskey(DnsResourceRecord *rrsig, DnsResourceRecord *dnskey, bool revoked_ok) {
 
         return -EOPNOTSUPP;
@@ -4,6 +4,7 @@
 #include "sd-bus.h"
 
 #include "set.h"
+#include "varlink.h"
 
 typedef struct DnsQueryCandidate DnsQueryCandidate;
 typedef struct DnsQuery DnsQuery;
@@ -80,6 +81,9 @@ struct DnsQuery {
         unsigned block_all_complete;
         char *request_address_string;
 
+        /* Varlink client information */
+        Varlink *varlink_request;
+
         /* DNS stub information */
         DnsPacket *request_dns_packet;
         DnsStream *request_dns_stream;
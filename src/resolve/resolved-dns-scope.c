@@ -40,6 +40,9 @@ int dns_scope_new(Manager *m, DnsScope **ret, Link *l, DnsProtocol protocol, int
                 .protocol = protocol,
                 .family = family,
                 .resend_timeout = MULTICAST_RESEND_TIMEOUT_MIN_USEC,
+                .cache.size_max = m->cache_size,
+                .cache.stale_retention_usec = protocol == DNS_PROTOCOL_DNS ? m->stale_retention_usec : 0,
+                .cache.prefetch = protocol == DNS_PROTOCOL_DNS && m->cache_prefetch,
         };
 
         if (protocol == DNS_PROTOCOL_DNS) {
@@ -108,6 +111,7 @@ DnsScope* dns_scope_free(DnsScope *s) {
                 dns_query_candidate_free(s->query_candidates);
 
         hashmap_free(s->transactions_by_key);
+        hashmap_free(s->refresh_transactions);
 
         ordered_hashmap_free_with_destructor(s->conflict_queue, dns_resource_record_unref);
         sd_event_source_unref(s->conflict_event_source);
@@ -934,6 +938,10 @@ DnsTransaction *dns_scope_find_transaction(DnsScope *scope, DnsResourceKey *key,
         if (!t)
                 return NULL;
 
+        /* Don't wait for cache refreshes, the cache can answer right-away */
+        if (t->refresh)
+                return NULL;
+
         /* Refuse reusing transactions that completed based on cached
          * data instead of a real packet, if that's requested. */
         if (!cache_ok &&
@@ -944,6 +952,52 @@ DnsTransaction *dns_scope_find_transaction(DnsScope *scope, DnsResourceKey *key,
         return t;
 }
 
+int dns_scope_refresh_key(DnsScope *scope, DnsResourceKey *key) {
+        char key_str[DNS_RESOURCE_KEY_STRING_MAX];
+        DnsTransaction *t;
+        int r;
+
+        assert(scope);
+        assert(key);
+
+        /* Asks the network for the key again in the background, so that its cache entry is renewed when
+         * the transaction completes. Returns > 0 if a refresh was started, 0 if one is already ongoing. */
+
+        if (scope->protocol != DNS_PROTOCOL_DNS)
+                return 0;
+
+        if (hashmap_get(scope->refresh_transactions, key))
+                return 0;
+
+        r = hashmap_ensure_allocated(&scope->refresh_transactions, &dns_resource_key_hash_ops);
+        if (r < 0)
+                return r;
+
+        r = dns_transaction_new(&t, scope, key);
+        if (r < 0)
+                return r;
+
+        t->refresh = true;
+
+        r = hashmap_put(scope->refresh_transactions, t->key, t);
+        if (r < 0) {
+                dns_transaction_free(t);
+                return r;
+        }
+
+        log_debug("Refreshing cache entry for %s in the background.",
+                  dns_resource_key_to_string(key, key_str, sizeof key_str));
+
+        /* If this completes right away, the transaction is already freed on return */
+        r = dns_transaction_go(t);
+        if (r < 0) {
+                dns_transaction_free(t);
+                return r;
+        }
+
+        return 1;
+}
+
 static int dns_scope_make_conflict_packet(
                 DnsScope *s,
                 DnsResourceRecord *rr,
@@ -1147,6 +1201,10 @@ void dns_scope_dump(DnsScope *s, FILE *f) {
 
         fputs("]\n", f);
 
+        fprintf(f, "CACHE STATISTICS: size=%u max=%u hits=%u misses=%u evictions=%u stale=%u\n",
+                dns_cache_size(&s->cache), s->cache.size_max,
+                s->cache.n_hit, s->cache.n_miss, s->cache.n_evict, s->cache.n_stale);
+
         if (!dns_zone_is_empty(&s->zone)) {
                 fputs("ZONE:\n", f);
                 dns_zone_dump(&s->zone, f);
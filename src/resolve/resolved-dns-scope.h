@@ -63,6 +63,10 @@ struct DnsScope {
         Hashmap *transactions_by_key;
         LIST_HEAD(DnsTransaction, transactions);
 
+        /* Transactions renewing cache entries in the background, indexed by the rr key. These are not
+         * reused by queries, as those shall be answered from the cache in the meantime. */
+        Hashmap *refresh_transactions;
+
         LIST_FIELDS(DnsScope, scopes);
 };
 
@@ -90,6 +94,7 @@ int dns_scope_make_reply_packet(DnsScope *s, uint16_t id, int rcode, DnsQuestion
 void dns_scope_process_query(DnsScope *s, DnsStream *stream, DnsPacket *p);
 
 DnsTransaction *dns_scope_find_transaction(DnsScope *scope, DnsResourceKey *key, bool cache_ok);
+int dns_scope_refresh_key(DnsScope *scope, DnsResourceKey *key);
 
 int dns_scope_notify_conflict(DnsScope *scope, DnsResourceRecord *rr);
 void dns_scope_check_conflicts(DnsScope *scope, DnsPacket *p);
@@ -10,6 +10,11 @@
 #include "resolved-dns-stream.h"
 
 #define DNS_STREAM_TIMEOUT_USEC (10 * USEC_PER_SEC)
+
+/* How long to keep an outgoing lookup connection open when no lookups are pending on it. Lookups are
+ * pipelined on the connection of the server (RFC 7766, Section 6.2.1), so keeping it around a bit longer
+ * saves the TCP and TLS handshakes for the next burst of lookups. */
+#define DNS_STREAM_IDLE_TIMEOUT_USEC (30 * USEC_PER_SEC)
 #define DNS_STREAMS_MAX 128
 
 #define DNS_QUERIES_PER_STREAM 32
@@ -282,6 +287,28 @@ static ssize_t dns_stream_read(DnsStream *s, void *buf, size_t count) {
         return ss;
 }
 
+static usec_t dns_stream_timeout_usec(DnsStream *s) {
+        assert(s);
+
+        if (s->type == DNS_STREAM_LOOKUP && !s->transactions)
+                return DNS_STREAM_IDLE_TIMEOUT_USEC;
+
+        return DNS_STREAM_TIMEOUT_USEC;
+}
+
+void dns_stream_restart_timeout(DnsStream *s) {
+        int r;
+
+        assert(s);
+
+        if (!s->timeout_event_source)
+                return;
+
+        r = sd_event_source_set_time(s->timeout_event_source, usec_add(now(clock_boottime_or_monotonic()), dns_stream_timeout_usec(s)));
+        if (r < 0)
+                log_warning_errno(r, "Couldn't restart TCP connection timeout, ignoring: %m");
+}
+
 static int on_stream_timeout(sd_event_source *es, usec_t usec, void *userdata) {
         DnsStream *s = userdata;
 
@@ -445,11 +472,8 @@ static int on_stream_io(sd_event_source *es, int fd, uint32_t revents, void *use
                 return dns_stream_complete(s, 0);
 
         /* If we did something, let's restart the timeout event source */
-        if (progressed && s->timeout_event_source) {
-                r = sd_event_source_set_time(s->timeout_event_source, now(clock_boottime_or_monotonic()) + DNS_STREAM_TIMEOUT_USEC);
-                if (r < 0)
-                        log_warning_errno(errno, "Couldn't restart TCP connection timeout, ignoring: %m");
-        }
+        if (progressed)
+                dns_stream_restart_timeout(s);
 
         return 0;
 }
@@ -4,12 +4,20 @@
 #include "fd-util.h"
 #include "missing_network.h"
 #include "resolved-dns-stub.h"
+#include "resolved-etc-hosts.h"
 #include "socket-util.h"
 
 /* The MTU of the loopback device is 64K on Linux, advertise that as maximum datagram size, but subtract the Ethernet,
  * IP and UDP header sizes */
 #define ADVERTISE_DATAGRAM_SIZE_MAX (65536U-14U-20U-8U)
 
+/* The maximum number of queries read from the UDP socket per wakeup. Note that the stub shares the event loop
+ * (and the thread) with everything else resolved does: the caches, transactions and DNSSEC state are all
+ * reference counted objects without any locking, and answering from the cache is cheap compared to waiting
+ * for upstream servers. Hence, rather than splitting the stub off into worker threads, keep the batch bounded
+ * so that replies from upstream and bus calls get their turn under load, too. */
+#define DNS_STUB_UDP_BATCH_MAX 64U
+
 static int manager_dns_stub_udp_fd(Manager *m);
 static int manager_dns_stub_tcp_fd(Manager *m);
 
@@ -277,6 +285,156 @@ static int dns_stub_stream_complete(DnsStream *s, int error) {
         return 0;
 }
 
+static DnsScope *dns_stub_pick_scope(Manager *m, const char *name) {
+        DnsScopeMatch found = DNS_SCOPE_NO;
+        DnsScope *s, *first = NULL;
+        unsigned n = 0;
+
+        assert(m);
+        assert(name);
+
+        /* Picks the scope a query for the specified name would be sent to, following the same rules as
+         * dns_query_go(). Returns NULL if there's none, or more than one, in which case the answers would have
+         * to be merged. */
+
+        LIST_FOREACH(scopes, s, m->dns_scopes) {
+                DnsScopeMatch match;
+
+                match = dns_scope_good_domain(s, 0, SD_RESOLVED_PROTOCOLS_ALL|SD_RESOLVED_NO_SEARCH, name);
+                if (match < 0)
+                        return NULL;
+
+                if (match > found) {
+                        found = match;
+                        first = s;
+                        n = 1;
+                } else if (match == found && match != DNS_SCOPE_NO)
+                        n++;
+        }
+
+        if (n != 1)
+                return NULL;
+
+        return first;
+}
+
+static int dns_stub_reply_directly(Manager *m, DnsStream *s, DnsPacket *p, DnsAnswer *answer, bool authenticated) {
+        _cleanup_(dns_packet_unrefp) DnsPacket *reply = NULL;
+        bool truncated;
+        int r;
+
+        assert(m);
+        assert(p);
+
+        r = dns_stub_make_reply_packet(&reply, DNS_PACKET_PAYLOAD_SIZE_MAX(p), p->question, answer, &truncated);
+        if (r < 0)
+                return r;
+
+        r = dns_stub_finish_reply_packet(reply, DNS_PACKET_ID(p), DNS_RCODE_SUCCESS, truncated, !!p->opt, DNS_PACKET_DO(p), authenticated);
+        if (r < 0)
+                return r;
+
+        (void) dns_stub_send(m, s, p, reply);
+        return 0;
+}
+
+static int dns_stub_try_etc_hosts(Manager *m, DnsStream *s, DnsPacket *p) {
+        _cleanup_(dns_answer_unrefp) DnsAnswer *answer = NULL;
+        int r;
+
+        assert(m);
+        assert(p);
+
+        /* Answers the query directly from /etc/hosts, the same way dns_query_try_etc_hosts() would, but
+         * without allocating a DnsQuery for it. Returns > 0 if a reply was sent, 0 if the name is not listed
+         * in /etc/hosts. */
+
+        r = manager_etc_hosts_lookup(m, p->question, &answer);
+        if (r <= 0)
+                return r;
+
+        r = dns_stub_reply_directly(m, s, p, answer, true);
+        if (r < 0)
+                return log_debug_errno(r, "Failed to build reply packet from /etc/hosts, processing query normally: %m");
+
+        log_debug("Answering query for %s from /etc/hosts.", dns_question_first_name(p->question));
+        return 1;
+}
+
+static int dns_stub_try_cache(Manager *m, DnsStream *s, DnsPacket *p) {
+        _cleanup_(dns_answer_unrefp) DnsAnswer *answer = NULL;
+        bool authenticated, refresh, found = false;
+        DnsResourceRecord *rr;
+        DnsResourceKey *key;
+        DnsScope *scope;
+        int rcode, r;
+
+        assert(m);
+        assert(p);
+
+        /* Answers the query directly from the cache of the scope it would be sent to, without allocating a
+         * DnsQuery and its transactions. This only covers the simple case: a single question that is
+         * answered directly by positive cached RRs. Everything else (trust anchor lookups, CNAME chasing,
+         * negative answers that might be synthesized) is left to the regular query logic. Returns > 0 if a
+         * reply was sent, 0 if the query needs to be processed normally. */
+
+        if (dns_question_size(p->question) != 1)
+                return 0;
+
+        key = p->question->keys[0];
+        if (key->class != DNS_CLASS_IN || dns_type_is_dnssec(key->type))
+                return 0;
+
+        /* /etc/hosts takes precedence over everything else, like in dns_query_go() */
+        r = dns_stub_try_etc_hosts(m, s, p);
+        if (r != 0)
+                return r;
+
+        scope = dns_stub_pick_scope(m, dns_resource_key_name(key));
+        if (!scope || scope->protocol != DNS_PROTOCOL_DNS)
+                return 0;
+
+        if (!dns_scope_network_good(scope))
+                return 0;
+
+        /* Same as dns_transaction_prepare(): pick a server first, as that might flush the cache */
+        (void) dns_scope_get_dns_server(scope);
+        dns_cache_prune(&scope->cache);
+
+        r = dns_cache_lookup(&scope->cache, key, true, &rcode, &answer, &authenticated, &refresh);
+        if (r <= 0 || rcode != DNS_RCODE_SUCCESS)
+                return 0;
+
+        DNS_ANSWER_FOREACH(rr, answer) {
+                r = dns_question_matches_rr(p->question, rr, NULL);
+                if (r < 0)
+                        return 0;
+                if (r > 0) {
+                        found = true;
+                        break;
+                }
+        }
+        if (!found)
+                return 0;
+
+        if (refresh) {
+                r = dns_scope_refresh_key(scope, key);
+                if (r < 0)
+                        log_debug_errno(r, "Failed to start refreshing cache entry, ignoring: %m");
+        }
+
+        r = dns_stub_reply_directly(m, s, p, answer, authenticated);
+        if (r < 0) {
+                log_debug_errno(r, "Failed to build reply packet from cache, processing query normally: %m");
+                return 0;
+        }
+
+        log_debug("Answering query for %s from cache of scope on link %s.",
+                  dns_resource_key_name(key), scope->link ? scope->link->ifname : "*");
+
+        return 1;
+}
+
 static void dns_stub_process_query(Manager *m, DnsStream *s, DnsPacket *p) {
         DnsQuery *q = NULL;
         int r;
@@ -330,6 +488,9 @@ static void dns_stub_process_query(Manager *m, DnsStream *s, DnsPacket *p) {
                 goto fail;
         }
 
+        if (dns_stub_try_cache(m, s, p) > 0)
+                return;
+
         r = dns_query_new(m, &q, p->question, p->question, 0, SD_RESOLVED_PROTOCOLS_ALL|SD_RESOLVED_NO_SEARCH);
         if (r < 0) {
                 log_error_errno(r, "Failed to generate query object: %m");
@@ -375,20 +536,33 @@ fail:
 }
 
 static int on_dns_stub_packet(sd_event_source *s, int fd, uint32_t revents, void *userdata) {
-        _cleanup_(dns_packet_unrefp) DnsPacket *p = NULL;
         Manager *m = userdata;
+        unsigned n;
         int r;
 
-        r = manager_recv(m, fd, DNS_PROTOCOL_DNS, &p);
-        if (r <= 0)
-                return r;
+        /* Process all queries that are already queued, up to a limit so that the other event sources get
+         * their turn too, rather than returning to the event loop for each of them. */
 
-        if (dns_packet_validate_query(p) > 0) {
-                log_debug("Got DNS stub UDP query packet for id %u", DNS_PACKET_ID(p));
+        for (n = 0; n < DNS_STUB_UDP_BATCH_MAX; n++) {
+                _cleanup_(dns_packet_unrefp) DnsPacket *p = NULL;
 
-                dns_stub_process_query(m, NULL, p);
-        } else
-                log_debug("Invalid DNS stub UDP packet, ignoring.");
+                r = manager_recv(m, fd, DNS_PROTOCOL_DNS, &p);
+                if (r == -EAGAIN)
+                        return 0;
+                if (r <= 0)
+                        return r;
+
+                if (dns_packet_validate_query(p) > 0) {
+                        log_debug("Got DNS stub UDP query packet for id %u", DNS_PACKET_ID(p));
+
+                        dns_stub_process_query(m, NULL, p);
+                } else
+                        log_debug("Invalid DNS stub UDP packet, ignoring.");
+
+                /* The stub might have been stopped while processing the query */
+                if (m->dns_stub_udp_event_source != s)
+                        break;
+        }
 
         return 0;
 }
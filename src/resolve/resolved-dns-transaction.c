@@ -53,6 +53,10 @@ static void dns_transaction_close_connection(DnsTransaction *t) {
                 /* Let's detach the stream from our transaction, in case something else keeps a reference to it. */
                 LIST_REMOVE(transactions_by_stream, t->stream->transactions, t);
 
+                /* If this was the last lookup on the connection, it's idle now */
+                if (!t->stream->transactions)
+                        dns_stream_restart_timeout(t->stream);
+
                 /* Remove packet in case it's still in the queue */
                 dns_packet_unref(ordered_set_remove(t->stream->write_queue, t->sent));
 
@@ -89,6 +93,8 @@ DnsTransaction* dns_transaction_free(DnsTransaction *t) {
 
         if (t->scope) {
                 hashmap_remove_value(t->scope->transactions_by_key, t->key, t);
+                if (t->refresh)
+                        hashmap_remove_value(t->scope->refresh_transactions, t->key, t);
                 LIST_REMOVE(transactions_by_scope, t->scope->transactions, t);
 
                 if (t->id != 0)
@@ -136,6 +142,10 @@ bool dns_transaction_gc(DnsTransaction *t) {
         if (t->block_gc > 0)
                 return true;
 
+        /* Cache refreshes have nobody to keep them alive, hence keep them around until they are done */
+        if (t->refresh && DNS_TRANSACTION_IS_LIVE(t->state))
+                return true;
+
         if (set_isempty(t->notify_query_candidates) &&
             set_isempty(t->notify_query_candidates_done) &&
             set_isempty(t->notify_zone_items) &&
@@ -650,6 +660,9 @@ static int dns_transaction_emit_tcp(DnsTransaction *t) {
         t->stream = TAKE_PTR(s);
         LIST_PREPEND(transactions_by_stream, t->stream->transactions, t);
 
+        /* A reused connection might have been idle, switch back to the regular timeout */
+        dns_stream_restart_timeout(t->stream);
+
         r = dns_stream_write_packet(t->stream, t->sent);
         if (r < 0) {
                 dns_transaction_close_connection(t);
@@ -1338,6 +1351,7 @@ static usec_t transaction_get_resend_timeout(DnsTransaction *t) {
 }
 
 static int dns_transaction_prepare(DnsTransaction *t, usec_t ts) {
+        bool refresh;
         int r;
 
         assert(t);
@@ -1432,8 +1446,9 @@ static int dns_transaction_prepare(DnsTransaction *t, usec_t ts) {
         }
 
         /* Check the cache, but only if this transaction is not used
-         * for probing or verifying a zone item. */
-        if (set_isempty(t->notify_zone_items)) {
+         * for probing or verifying a zone item, or for refreshing
+         * the cache entry itself. */
+        if (set_isempty(t->notify_zone_items) && !t->refresh) {
 
                 /* Before trying the cache, let's make sure we figured out a
                  * server to use. Should this cause a change of server this
@@ -1443,10 +1458,16 @@ static int dns_transaction_prepare(DnsTransaction *t, usec_t ts) {
                 /* Let's then prune all outdated entries */
                 dns_cache_prune(&t->scope->cache);
 
-                r = dns_cache_lookup(&t->scope->cache, t->key, t->clamp_ttl, &t->answer_rcode, &t->answer, &t->answer_authenticated);
+                r = dns_cache_lookup(&t->scope->cache, t->key, t->clamp_ttl, &t->answer_rcode, &t->answer, &t->answer_authenticated, &refresh);
                 if (r < 0)
                         return r;
                 if (r > 0) {
+                        if (refresh) {
+                                r = dns_scope_refresh_key(t->scope, t->key);
+                                if (r < 0)
+                                        log_debug_errno(r, "Failed to start refreshing cache entry, ignoring: %m");
+                        }
+
                         t->answer_source = DNS_TRANSACTION_CACHE;
                         if (t->answer_rcode == DNS_RCODE_SUCCESS)
                                 dns_transaction_complete(t, DNS_TRANSACTION_SUCCESS);
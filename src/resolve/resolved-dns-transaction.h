@@ -62,6 +62,9 @@ struct DnsTransaction {
 
         bool probing:1;
 
+        /* Started in the background to renew a cache entry, nobody waits for the result */
+        bool refresh:1;
+
         DnsPacket *sent, *received;
 
         DnsAnswer *answer;
@@ -22,8 +22,15 @@ static void etc_hosts_item_free(EtcHostsItem *item) {
 }
 
 static void etc_hosts_item_by_name_free(EtcHostsItemByName *item) {
+        size_t i;
+
+        if (item->rrs)
+                for (i = 0; i < item->n_addresses; i++)
+                        dns_resource_record_unref(item->rrs[i]);
+
         free(item->name);
         free(item->addresses);
+        free(item->rrs);
         free(item);
 }
 
@@ -361,18 +368,26 @@ int manager_etc_hosts_lookup(Manager *m, DnsQuestion* q, DnsAnswer **answer) {
                         break;
         }
 
-        for (i = 0; bn && i < bn->n_addresses; i++) {
-                _cleanup_(dns_resource_record_unrefp) DnsResourceRecord *rr = NULL;
+        if (bn && bn->n_addresses > 0 && !bn->rrs) {
+                bn->rrs = new0(DnsResourceRecord*, bn->n_addresses);
+                if (!bn->rrs)
+                        return -ENOMEM;
+        }
 
+        for (i = 0; bn && i < bn->n_addresses; i++) {
                 if ((!found_a && bn->addresses[i]->family == AF_INET) ||
                     (!found_aaaa && bn->addresses[i]->family == AF_INET6))
                         continue;
 
-                r = dns_resource_record_new_address(&rr, bn->addresses[i]->family, &bn->addresses[i]->address, bn->name);
-                if (r < 0)
-                        return r;
+                /* Popular names are looked up over and over again, hence keep the RRs around instead of
+                 * building them from scratch each time */
+                if (!bn->rrs[i]) {
+                        r = dns_resource_record_new_address(&bn->rrs[i], bn->addresses[i]->family, &bn->addresses[i]->address, bn->name);
+                        if (r < 0)
+                                return r;
+                }
 
-                r = dns_answer_add(*answer, rr, 0, DNS_ANSWER_AUTHENTICATED);
+                r = dns_answer_add(*answer, bn->rrs[i], 0, DNS_ANSWER_AUTHENTICATED);
                 if (r < 0)
                         return r;
         }
@@ -16,6 +16,10 @@ typedef struct EtcHostsItemByName {
 
         struct in_addr_data **addresses;
         size_t n_addresses, n_allocated;
+
+        /* The A/AAAA RRs for the addresses above, same order, built on first use and reused for later
+         * lookups until /etc/hosts is read again */
+        DnsResourceRecord **rrs;
 } EtcHostsItemByName;
 
 int etc_hosts_parse(EtcHosts *hosts, FILE *f);
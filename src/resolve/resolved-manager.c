@@ -28,6 +28,7 @@
 #include "parse-util.h"
 #include "random-util.h"
 #include "resolved-bus.h"
+#include "resolved-cache-file.h"
 #include "resolved-conf.h"
 #include "resolved-dns-stub.h"
 #include "resolved-dnssd.h"
@@ -36,6 +37,7 @@
 #include "resolved-manager.h"
 #include "resolved-mdns.h"
 #include "resolved-resolv-conf.h"
+#include "resolved-varlink.h"
 #include "socket-util.h"
 #include "string-table.h"
 #include "string-util.h"
@@ -549,6 +551,18 @@ static int manager_sigusr2(sd_event_source *s, const struct signalfd_siginfo *si
         return 0;
 }
 
+static int manager_memory_pressure(sd_event_source *s, void *userdata) {
+        Manager *m = userdata;
+
+        assert(s);
+        assert(m);
+
+        /* The caches are refilled from the network as needed, hence drop them all */
+        manager_flush_caches(m);
+
+        return 0;
+}
+
 static int manager_sigrtmin1(sd_event_source *s, const struct signalfd_siginfo *si, void *userdata) {
         Manager *m = userdata;
 
@@ -586,6 +600,7 @@ int manager_new(Manager **ret) {
                 .dnssec_mode = DEFAULT_DNSSEC_MODE,
                 .dns_over_tls_mode = DEFAULT_DNS_OVER_TLS_MODE,
                 .enable_cache = DNS_CACHE_MODE_YES,
+                .cache_size = DNS_CACHE_SIZE_DEFAULT,
                 .dns_stub_listener_mode = DNS_STUB_LISTENER_YES,
                 .read_resolv_conf = true,
                 .need_builtin_fallbacks = true,
@@ -645,6 +660,8 @@ int manager_new(Manager **ret) {
         (void) sd_event_add_signal(m->event, &m->sigusr2_event_source, SIGUSR2, manager_sigusr2, m);
         (void) sd_event_add_signal(m->event, &m->sigrtmin1_event_source, SIGRTMIN+1, manager_sigrtmin1, m);
 
+        (void) sd_event_add_memory_pressure(m->event, &m->memory_pressure_event_source, manager_memory_pressure, m);
+
         manager_cleanup_saved_user(m);
 
         *ret = TAKE_PTR(m);
@@ -657,10 +674,17 @@ int manager_start(Manager *m) {
 
         assert(m);
 
+        /* Fill the caches before we start answering stub queries */
+        (void) manager_read_cache(m);
+
         r = manager_dns_stub_start(m);
         if (r < 0)
                 return r;
 
+        r = manager_varlink_init(m);
+        if (r < 0)
+                return r;
+
         return 0;
 }
 
@@ -695,6 +719,8 @@ Manager *manager_free(Manager *m) {
         hashmap_free(m->links);
         hashmap_free(m->dns_transactions);
 
+        dnssec_flush_verified_signatures();
+
         sd_event_source_unref(m->network_event_source);
         sd_network_monitor_unref(m->network_monitor);
 
@@ -704,6 +730,7 @@ Manager *manager_free(Manager *m) {
         manager_llmnr_stop(m);
         manager_mdns_stop(m);
         manager_dns_stub_stop(m);
+        manager_varlink_done(m);
 
         bus_verify_polkit_async_registry_free(m->polkit_registry);
 
@@ -712,6 +739,7 @@ Manager *manager_free(Manager *m) {
         sd_event_source_unref(m->sigusr1_event_source);
         sd_event_source_unref(m->sigusr2_event_source);
         sd_event_source_unref(m->sigrtmin1_event_source);
+        sd_event_source_unref(m->memory_pressure_event_source);
 
         sd_event_unref(m->event);
 
@@ -1447,7 +1475,12 @@ void manager_flush_caches(Manager *m) {
         LIST_FOREACH(scopes, scope, m->dns_scopes)
                 dns_cache_flush(&scope->cache);
 
+        dnssec_flush_verified_signatures();
+
         log_info("Flushed all caches.");
+
+        /* Give the memory of the flushed entries back to the kernel right away */
+        sd_event_trim_memory();
 }
 
 void manager_reset_server_features(Manager *m) {
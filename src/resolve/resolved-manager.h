@@ -38,6 +38,10 @@ struct Manager {
         DnssecMode dnssec_mode;
         DnsOverTlsMode dns_over_tls_mode;
         DnsCacheMode enable_cache;
+        unsigned cache_size;
+        usec_t stale_retention_usec;
+        bool cache_prefetch;
+        bool persistent_cache;
         DnsStubListenerMode dns_stub_listener_mode;
 
 #if ENABLE_DNS_OVER_TLS
@@ -104,6 +108,9 @@ struct Manager {
         /* dbus */
         sd_bus *bus;
 
+        /* Varlink, used by nss-resolve */
+        VarlinkServer *varlink_server;
+
         /* The hostname we publish on LLMNR and mDNS */
         char *full_hostname;
         char *llmnr_hostname;
@@ -121,6 +128,8 @@ struct Manager {
         sd_event_source *sigusr2_event_source;
         sd_event_source *sigrtmin1_event_source;
 
+        sd_event_source *memory_pressure_event_source;
+
         unsigned n_transactions_total;
         unsigned n_dnssec_verdict[_DNSSEC_VERDICT_MAX];
 
@@ -11,6 +11,7 @@
 #include "daemon-util.h"
 #include "main-func.h"
 #include "mkdir.h"
+#include "resolved-cache-file.h"
 #include "resolved-conf.h"
 #include "resolved-manager.h"
 #include "resolved-resolv-conf.h"
@@ -85,6 +86,8 @@ static int run(int argc, char *argv[]) {
         if (r < 0)
                 return log_error_errno(r, "Event loop failed: %m");
 
+        (void) manager_write_cache(m);
+
         return 0;
 }
 
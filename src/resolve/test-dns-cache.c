@@ -0,0 +1,218 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "log.h"
+#include "resolved-dns-cache.h"
+#include "stdio-util.h"
+#include "tests.h"
+
+static void put_a_at(DnsCache *c, const char *name, uint32_t ttl, usec_t timestamp) {
+        _cleanup_(dns_resource_record_unrefp) DnsResourceRecord *rr = NULL;
+        _cleanup_(dns_answer_unrefp) DnsAnswer *answer = NULL;
+        union in_addr_union owner = {};
+
+        assert_se(rr = dns_resource_record_new_full(DNS_CLASS_IN, DNS_TYPE_A, name));
+        rr->ttl = ttl;
+        rr->a.in_addr.s_addr = htobe32(0x7f000001);
+
+        assert_se(answer = dns_answer_new(1));
+        assert_se(dns_answer_add(answer, rr, 0, DNS_ANSWER_CACHEABLE) >= 0);
+
+        assert_se(dns_cache_put(c, DNS_CACHE_MODE_YES, rr->key, DNS_RCODE_SUCCESS, answer, false, UINT32_MAX, timestamp, AF_INET, &owner) >= 0);
+}
+
+static void put_a(DnsCache *c, const char *name, uint32_t ttl) {
+        put_a_at(c, name, ttl, 0);
+}
+
+static bool lookup_a_full(DnsCache *c, const char *name, uint32_t *ret_ttl, bool *ret_refresh) {
+        _cleanup_(dns_resource_key_unrefp) DnsResourceKey *key = NULL;
+        _cleanup_(dns_answer_unrefp) DnsAnswer *answer = NULL;
+        bool authenticated;
+        int rcode, r;
+
+        assert_se(key = dns_resource_key_new(DNS_CLASS_IN, DNS_TYPE_A, name));
+
+        r = dns_cache_lookup(c, key, false, &rcode, &answer, &authenticated, ret_refresh);
+        assert_se(r >= 0);
+
+        if (ret_ttl)
+                *ret_ttl = r > 0 ? answer->items[0].rr->ttl : 0;
+
+        return r > 0;
+}
+
+static bool lookup_a(DnsCache *c, const char *name) {
+        return lookup_a_full(c, name, NULL, NULL);
+}
+
+static void test_cache_evict_lru(void) {
+        DnsCache c = {
+                .size_max = 4,
+        };
+
+        log_info("/* %s */", __func__);
+
+        /* The entry that expires first is the one used most recently, it should survive */
+        put_a(&c, "a.example.com", 100);
+        put_a(&c, "b.example.com", 200);
+        put_a(&c, "c.example.com", 300);
+        assert_se(dns_cache_size(&c) == 3);
+        assert_se(c.n_evict == 0);
+
+        assert_se(lookup_a(&c, "a.example.com"));
+
+        /* Space is made for the RR and a possible negative entry for the key, hence one entry is evicted, and
+         * that's the one used least recently, not the one expiring first. */
+        put_a(&c, "d.example.com", 400);
+        assert_se(c.n_evict == 1);
+
+        assert_se(lookup_a(&c, "a.example.com"));
+        assert_se(!lookup_a(&c, "b.example.com"));
+        assert_se(lookup_a(&c, "c.example.com"));
+        assert_se(lookup_a(&c, "d.example.com"));
+
+        assert_se(c.n_hit == 4);
+        assert_se(c.n_miss == 1);
+
+        dns_cache_flush(&c);
+        assert_se(dns_cache_is_empty(&c));
+}
+
+static void test_cache_default_size(void) {
+        DnsCache c = {};
+        unsigned i;
+
+        log_info("/* %s */", __func__);
+
+        for (i = 0; i < DNS_CACHE_SIZE_DEFAULT + 10; i++) {
+                char name[DECIMAL_STR_MAX(unsigned) + STRLEN(".example.com")];
+
+                xsprintf(name, "%u.example.com", i);
+                put_a(&c, name, 100);
+        }
+
+        assert_se(dns_cache_size(&c) <= DNS_CACHE_SIZE_DEFAULT);
+        assert_se(c.n_evict > 0);
+
+        dns_cache_flush(&c);
+}
+
+static void test_cache_prefetch(void) {
+        DnsCache c = {
+                .prefetch = true,
+        };
+        usec_t n = now(clock_boottime_or_monotonic());
+        bool refresh;
+        unsigned i;
+
+        log_info("/* %s */", __func__);
+
+        /* 95s of 100s are over, but the entry is not popular yet */
+        put_a_at(&c, "a.example.com", 100, n - 95 * USEC_PER_SEC);
+        put_a(&c, "b.example.com", 100);
+
+        for (i = 1; i < 3; i++) {
+                assert_se(lookup_a_full(&c, "a.example.com", NULL, &refresh));
+                assert_se(!refresh);
+        }
+
+        assert_se(lookup_a_full(&c, "a.example.com", NULL, &refresh));
+        assert_se(refresh);
+
+        /* Popular, but far from expiry */
+        for (i = 0; i < 5; i++) {
+                assert_se(lookup_a_full(&c, "b.example.com", NULL, &refresh));
+                assert_se(!refresh);
+        }
+
+        /* Renewing the entry resets its popularity */
+        put_a(&c, "a.example.com", 100);
+        assert_se(lookup_a_full(&c, "a.example.com", NULL, &refresh));
+        assert_se(!refresh);
+
+        assert_se(c.n_stale == 0);
+
+        dns_cache_flush(&c);
+}
+
+static void test_cache_serve_stale(void) {
+        DnsCache c = {
+                .stale_retention_usec = 60 * USEC_PER_SEC,
+        };
+        usec_t n = now(clock_boottime_or_monotonic());
+        bool refresh;
+        uint32_t ttl;
+
+        log_info("/* %s */", __func__);
+
+        put_a_at(&c, "a.example.com", 10, n - 20 * USEC_PER_SEC);
+        put_a_at(&c, "b.example.com", 10, n - 100 * USEC_PER_SEC);
+        put_a(&c, "c.example.com", 300);
+
+        dns_cache_prune(&c);
+
+        /* Expired, but within the retention time: answered, with a short TTL, and to be refreshed */
+        assert_se(lookup_a_full(&c, "a.example.com", &ttl, &refresh));
+        assert_se(refresh);
+        assert_se(ttl == DNS_CACHE_STALE_TTL_SEC);
+
+        /* Past the retention time too */
+        assert_se(!lookup_a_full(&c, "b.example.com", NULL, &refresh));
+        assert_se(!refresh);
+
+        assert_se(lookup_a_full(&c, "c.example.com", &ttl, &refresh));
+        assert_se(!refresh);
+        assert_se(ttl == 300);
+
+        assert_se(c.n_stale == 1);
+
+        /* Without retention time expired entries are pruned right-away */
+        c.stale_retention_usec = 0;
+        dns_cache_prune(&c);
+        assert_se(!lookup_a(&c, "a.example.com"));
+
+        dns_cache_flush(&c);
+}
+
+static void test_cache_export_import(void) {
+        _cleanup_(dns_packet_unrefp) DnsPacket *unauthenticated = NULL, *authenticated = NULL;
+        DnsCache c = {}, d = {};
+        uint32_t ttl;
+
+        log_info("/* %s */", __func__);
+
+        put_a(&c, "a.example.com", 100);
+        put_a(&c, "b.example.com", 200);
+
+        assert_se(dns_cache_export_to_packet(&c, false, &unauthenticated) >= 0);
+        assert_se(unauthenticated);
+        assert_se(DNS_PACKET_ANCOUNT(unauthenticated) == 2);
+        assert_se(!unauthenticated->more);
+
+        assert_se(dns_cache_export_to_packet(&c, true, &authenticated) >= 0);
+        assert_se(!authenticated);
+
+        /* 150s later only one of them is left, with a lower TTL */
+        assert_se(dns_cache_import_packet(&d, unauthenticated, false, 150 * USEC_PER_SEC, 0) == 1);
+        assert_se(!lookup_a(&d, "a.example.com"));
+        assert_se(lookup_a_full(&d, "b.example.com", &ttl, NULL));
+        assert_se(ttl <= 50);
+
+        dns_cache_flush(&c);
+        dns_cache_flush(&d);
+}
+
+int main(int argc, char *argv[]) {
+        test_setup_logging(LOG_INFO);
+
+        test_cache_evict_lru();
+        test_cache_default_size();
+        test_cache_prefetch();
+        test_cache_serve_stale();
+        test_cache_export_import();
+
+        return 0;
+}
@@ -317,8 +317,8 @@ static void test_dnssec_verify_rrset(void) {
                 0x4f, 0x00, 0x51, 0x3b,
         };
 
-        _cleanup_(dns_resource_record_unrefp) DnsResourceRecord *a = NULL, *rrsig = NULL, *dnskey = NULL;
-        _cleanup_(dns_answer_unrefp) DnsAnswer *answer = NULL;
+        _cleanup_(dns_resource_record_unrefp) DnsResourceRecord *a = NULL, *rrsig = NULL, *dnskey = NULL, *other = NULL;
+        _cleanup_(dns_answer_unrefp) DnsAnswer *answer = NULL, *other_answer = NULL;
         DnssecResult result;
 
         a = dns_resource_record_new_full(DNS_CLASS_IN, DNS_TYPE_A, "nAsA.gov");
@@ -369,6 +369,28 @@ static void test_dnssec_verify_rrset(void) {
         /* Validate the RR as it if was 2015-12-2 today */
         assert_se(dnssec_verify_rrset(answer, a->key, rrsig, dnskey, 1449092754*USEC_PER_SEC, &result) >= 0);
         assert_se(result == DNSSEC_VALIDATED);
+
+        /* Again, this time the signature is already known to be good */
+        assert_se(dnssec_verify_rrset(answer, a->key, rrsig, dnskey, 1449092754*USEC_PER_SEC, &result) >= 0);
+        assert_se(result == DNSSEC_VALIDATED);
+
+        /* The signature is still checked for expiry */
+        assert_se(dnssec_verify_rrset(answer, a->key, rrsig, dnskey, 1500000000*USEC_PER_SEC, &result) >= 0);
+        assert_se(result == DNSSEC_SIGNATURE_EXPIRED);
+
+        /* A different RRset doesn't match the signature, even though it was validated before */
+        other = dns_resource_record_new_full(DNS_CLASS_IN, DNS_TYPE_A, "nAsA.gov");
+        assert_se(other);
+        other->a.in_addr.s_addr = inet_addr("52.0.14.117");
+
+        other_answer = dns_answer_new(1);
+        assert_se(other_answer);
+        assert_se(dns_answer_add(other_answer, other, 0, DNS_ANSWER_AUTHENTICATED) >= 0);
+
+        assert_se(dnssec_verify_rrset(other_answer, other->key, rrsig, dnskey, 1449092754*USEC_PER_SEC, &result) >= 0);
+        assert_se(result == DNSSEC_INVALID);
+
+        dnssec_flush_verified_signatures();
 }
 
 static void test_dnssec_verify_rrset2(void) {
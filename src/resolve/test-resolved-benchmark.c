@@ -0,0 +1,302 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "alloc-util.h"
+#include "fileio.h"
+#include "glob-util.h"
+#include "json.h"
+#include "log.h"
+#include "macro.h"
+#include "parse-util.h"
+#include "path-util.h"
+#include "random-util.h"
+#include "resolved-dns-cache.h"
+#include "resolved-dns-packet.h"
+#include "resolved-dns-rr.h"
+#include "stdio-util.h"
+#include "string-util.h"
+#include "tests.h"
+#include "unaligned.h"
+
+/* Measures the hot paths of resolved: parsing packets, serializing RRs with name compression, and cache
+ * insertion and lookups. Results are written to stdout as JSON, so that runs of different versions can be
+ * compared. Invoke as "test-resolved-benchmark [SECONDS [FILE.pkts…]]". */
+
+/* How many RRs to put into each packet built from the corpus */
+#define RRS_PER_PACKET 16U
+
+/* How many distinct names the cache is exercised with */
+#define CACHE_NAMES 4096U
+
+static usec_t arg_duration;
+
+typedef struct Corpus {
+        DnsResourceRecord **rrs;
+        size_t n_rrs, n_allocated;
+
+        DnsPacket **packets;
+        size_t n_packets, n_packets_allocated;
+} Corpus;
+
+static void corpus_done(Corpus *c) {
+        size_t i;
+
+        for (i = 0; i < c->n_rrs; i++)
+                dns_resource_record_unref(c->rrs[i]);
+        for (i = 0; i < c->n_packets; i++)
+                dns_packet_unref(c->packets[i]);
+
+        free(c->rrs);
+        free(c->packets);
+}
+
+static void corpus_load_file(Corpus *c, const char *filename) {
+        _cleanup_free_ char *data = NULL;
+        size_t data_size, packet_size, offset;
+
+        /* Same format as used by test-dns-packet: each RR prefixed by its size as le64 */
+
+        assert_se(read_full_file(filename, &data, &data_size) >= 0);
+
+        for (offset = 0; offset + 8 <= data_size; offset += 8 + packet_size) {
+                _cleanup_(dns_packet_unrefp) DnsPacket *p = NULL;
+                DnsResourceRecord *rr;
+
+                packet_size = unaligned_read_le64(data + offset);
+                assert_se(offset + 8 + packet_size <= data_size);
+
+                assert_se(dns_packet_new(&p, DNS_PROTOCOL_DNS, 0, DNS_PACKET_SIZE_MAX) >= 0);
+                assert_se(dns_packet_append_blob(p, data + offset + 8, packet_size, NULL) >= 0);
+                assert_se(dns_packet_read_rr(p, &rr, NULL, NULL) >= 0);
+
+                assert_se(GREEDY_REALLOC(c->rrs, c->n_allocated, c->n_rrs + 1));
+                c->rrs[c->n_rrs++] = rr;
+        }
+}
+
+static DnsPacket *corpus_build_packet(Corpus *c, size_t first, size_t n) {
+        _cleanup_(dns_packet_unrefp) DnsPacket *p = NULL;
+        size_t i;
+
+        assert_se(dns_packet_new(&p, DNS_PROTOCOL_DNS, 0, DNS_PACKET_SIZE_MAX) >= 0);
+
+        for (i = 0; i < n; i++)
+                assert_se(dns_packet_append_rr(p, c->rrs[(first + i) % c->n_rrs], 0, NULL, NULL) >= 0);
+
+        DNS_PACKET_HEADER(p)->flags = htobe16(DNS_PACKET_MAKE_FLAGS(1 /* qr */, 0 /* opcode */, 0 /* aa */, 0 /* tc */,
+                                                                    1 /* rd */, 1 /* ra */, 0 /* ad */, 0 /* cd */,
+                                                                    DNS_RCODE_SUCCESS));
+        DNS_PACKET_HEADER(p)->ancount = htobe16(n);
+
+        return TAKE_PTR(p);
+}
+
+static void corpus_load(Corpus *c, char **fnames, size_t n_fnames) {
+        size_t i;
+
+        for (i = 0; i < n_fnames; i++)
+                corpus_load_file(c, fnames[i]);
+
+        assert_se(c->n_rrs > 0);
+
+        for (i = 0; i < c->n_rrs; i += RRS_PER_PACKET) {
+                assert_se(GREEDY_REALLOC(c->packets, c->n_packets_allocated, c->n_packets + 1));
+                c->packets[c->n_packets++] = corpus_build_packet(c, i, RRS_PER_PACKET);
+        }
+}
+
+static JsonVariant *make_result(const char *unit, uint64_t n, usec_t usec) {
+        char buf[FORMAT_TIMESPAN_MAX];
+        JsonVariant *v = NULL;
+        double rate;
+
+        rate = usec > 0 ? (double) n * USEC_PER_SEC / usec : 0;
+
+        assert_se(json_build(&v, JSON_BUILD_OBJECT(
+                                             JSON_BUILD_PAIR(unit, JSON_BUILD_UNSIGNED(n)),
+                                             JSON_BUILD_PAIR("usec", JSON_BUILD_UNSIGNED(usec)),
+                                             JSON_BUILD_PAIR("per-second", JSON_BUILD_REAL(rate)))) >= 0);
+
+        log_info("%" PRIu64 " %s in %s, %.0f/s",
+                 n, unit, format_timespan(buf, sizeof(buf), usec, 1), rate);
+
+        return v;
+}
+
+static JsonVariant *bench_packet_extract(Corpus *c) {
+        usec_t start, end;
+        uint64_t n = 0;
+
+        log_info("/* %s */", __func__);
+
+        start = end = now(CLOCK_MONOTONIC);
+
+        while (end - start < arg_duration) {
+                _cleanup_(dns_packet_unrefp) DnsPacket *p = NULL;
+                DnsPacket *template = c->packets[n % c->n_packets];
+
+                /* Extraction is cached in the packet, hence parse a fresh copy each time */
+                assert_se(dns_packet_new(&p, DNS_PROTOCOL_DNS, template->size, DNS_PACKET_SIZE_MAX) >= 0);
+                memcpy(DNS_PACKET_DATA(p), DNS_PACKET_DATA(template), template->size);
+                p->size = template->size;
+
+                assert_se(dns_packet_extract(p) >= 0);
+                assert_se(dns_answer_size(p->answer) == RRS_PER_PACKET);
+
+                n++;
+                end = now(CLOCK_MONOTONIC);
+        }
+
+        return make_result("packets", n, end - start);
+}
+
+static JsonVariant *bench_packet_append(Corpus *c) {
+        usec_t start, end;
+        uint64_t n = 0;
+
+        log_info("/* %s */", __func__);
+
+        start = end = now(CLOCK_MONOTONIC);
+
+        while (end - start < arg_duration) {
+                _cleanup_(dns_packet_unrefp) DnsPacket *p = NULL;
+
+                p = corpus_build_packet(c, (n * RRS_PER_PACKET) % c->n_rrs, RRS_PER_PACKET);
+
+                n++;
+                end = now(CLOCK_MONOTONIC);
+        }
+
+        return make_result("packets", n, end - start);
+}
+
+static void cache_put_a(DnsCache *cache, unsigned i) {
+        _cleanup_(dns_resource_record_unrefp) DnsResourceRecord *rr = NULL;
+        _cleanup_(dns_answer_unrefp) DnsAnswer *answer = NULL;
+        char name[DECIMAL_STR_MAX(unsigned) + STRLEN(".example.com")];
+        union in_addr_union owner = {};
+
+        xsprintf(name, "%u.example.com", i);
+
+        assert_se(rr = dns_resource_record_new_full(DNS_CLASS_IN, DNS_TYPE_A, name));
+        rr->ttl = 3600;
+        rr->a.in_addr.s_addr = htobe32(0x7f000001);
+
+        assert_se(answer = dns_answer_new(1));
+        assert_se(dns_answer_add(answer, rr, 0, DNS_ANSWER_CACHEABLE) >= 0);
+
+        assert_se(dns_cache_put(cache, DNS_CACHE_MODE_YES, rr->key, DNS_RCODE_SUCCESS, answer, false, UINT32_MAX, 0, AF_INET, &owner) >= 0);
+}
+
+static bool cache_lookup_a(DnsCache *cache, unsigned i) {
+        _cleanup_(dns_resource_key_unrefp) DnsResourceKey *key = NULL;
+        _cleanup_(dns_answer_unrefp) DnsAnswer *answer = NULL;
+        char name[DECIMAL_STR_MAX(unsigned) + STRLEN(".example.com")];
+        bool authenticated;
+        int rcode, r;
+
+        xsprintf(name, "%u.example.com", i);
+
+        assert_se(key = dns_resource_key_new(DNS_CLASS_IN, DNS_TYPE_A, name));
+
+        r = dns_cache_lookup(cache, key, false, &rcode, &answer, &authenticated, NULL);
+        assert_se(r >= 0);
+
+        return r > 0;
+}
+
+static unsigned pick_name(bool skewed) {
+        unsigned x = random_u32() % CACHE_NAMES;
+
+        /* Roughly what real clients do: 80% of the lookups are for 20% of the names */
+        if (skewed && random_u32() % 10 < 8)
+                x /= 5;
+
+        return x;
+}
+
+static JsonVariant *bench_cache(bool skewed) {
+        DnsCache cache = {
+                .size_max = CACHE_NAMES / 2,
+        };
+        usec_t start, end;
+        uint64_t n = 0;
+        unsigned hit = 0;
+
+        log_info("/* %s(%s) */", __func__, skewed ? "skewed" : "uniform");
+
+        /* The cache only has room for half of the names, so that misses are followed by insertions
+         * and evictions, like on a busy system. */
+
+        start = end = now(CLOCK_MONOTONIC);
+
+        while (end - start < arg_duration) {
+                unsigned i = pick_name(skewed);
+
+                if (cache_lookup_a(&cache, i))
+                        hit++;
+                else
+                        cache_put_a(&cache, i);
+
+                n++;
+                end = now(CLOCK_MONOTONIC);
+        }
+
+        log_info("hit rate %.1f%%, %u evictions", n > 0 ? hit * 100.0 / n : 0, cache.n_evict);
+
+        dns_cache_flush(&cache);
+
+        return make_result("operations", n, end - start);
+}
+
+int main(int argc, char *argv[]) {
+        _cleanup_(json_variant_unrefp) JsonVariant *extract = NULL, *append = NULL, *uniform = NULL, *skewed = NULL, *v = NULL;
+        _cleanup_free_ char *pkts_glob = NULL;
+        _cleanup_globfree_ glob_t g = {};
+        _cleanup_(corpus_done) Corpus c = {};
+        char **fnames;
+        size_t n_fnames;
+
+        test_setup_logging(LOG_INFO);
+
+        if (argc >= 2) {
+                unsigned x;
+
+                assert_se(safe_atou(argv[1], &x) >= 0);
+                arg_duration = x * USEC_PER_SEC;
+        } else
+                arg_duration = slow_tests_enabled() ?
+                        2 * USEC_PER_SEC : USEC_PER_SEC / 50;
+
+        if (argc >= 3) {
+                fnames = argv + 2;
+                n_fnames = argc - 2;
+        } else {
+                pkts_glob = path_join(get_testdata_dir(), "test-resolve/*.pkts");
+                assert_se(pkts_glob);
+                assert_se(glob(pkts_glob, GLOB_NOSORT, NULL, &g) == 0);
+                fnames = g.gl_pathv;
+                n_fnames = g.gl_pathc;
+        }
+
+        corpus_load(&c, fnames, n_fnames);
+        log_info("Loaded %zu RRs in %zu packets.", c.n_rrs, c.n_packets);
+
+        extract = bench_packet_extract(&c);
+        append = bench_packet_append(&c);
+        uniform = bench_cache(false);
+        skewed = bench_cache(true);
+
+        assert_se(json_build(&v, JSON_BUILD_OBJECT(
+                                             JSON_BUILD_PAIR("rrs", JSON_BUILD_UNSIGNED(c.n_rrs)),
+                                             JSON_BUILD_PAIR("packet-extract", JSON_BUILD_VARIANT(extract)),
+                                             JSON_BUILD_PAIR("packet-append", JSON_BUILD_VARIANT(append)),
+                                             JSON_BUILD_PAIR("cache-uniform", JSON_BUILD_VARIANT(uniform)),
+                                             JSON_BUILD_PAIR("cache-skewed", JSON_BUILD_VARIANT(skewed)))) >= 0);
+
+        json_variant_dump(v, JSON_FORMAT_NEWLINE|JSON_FORMAT_PRETTY_AUTO, stdout, NULL);
+
+        return EXIT_SUCCESS;
+}
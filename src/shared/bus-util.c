@@ -1293,6 +1293,113 @@ int bus_map_all_properties(
         return r;
 }
 
+struct pipelined_call {
+        sd_bus_slot *slot;
+        sd_bus_message *reply;
+};
+
+static int pipelined_call_reply(sd_bus_message *m, void *userdata, sd_bus_error *ret_error) {
+        struct pipelined_call *c = userdata;
+
+        assert(m);
+        assert(c);
+
+        c->reply = sd_bus_message_ref(m);
+        return 1;
+}
+
+static void pipelined_calls_free(struct pipelined_call *calls, size_t n) {
+        size_t i;
+
+        for (i = 0; i < n; i++) {
+                sd_bus_slot_unref(calls[i].slot);
+                sd_bus_message_unref(calls[i].reply);
+        }
+
+        free(calls);
+}
+
+int bus_get_all_properties_pipelined(
+                sd_bus *bus,
+                const char *destination,
+                char **paths,
+                const char *interface,
+                bus_get_all_properties_handler_t handler,
+                void *userdata) {
+
+        struct pipelined_call *calls;
+        size_t n, n_sent = 0, n_handled = 0;
+        int r;
+
+        assert(bus);
+        assert(destination);
+        assert(handler);
+
+        /* Calls GetAll() on all objects in 'paths', without waiting for each reply before sending the next
+         * call, and invokes the handler for each reply, in order. This saves a round trip per object. */
+
+        n = strv_length(paths);
+        if (n == 0)
+                return 0;
+
+        calls = new0(struct pipelined_call, n);
+        if (!calls)
+                return -ENOMEM;
+
+        for (;;) {
+                while (n_sent < n && n_sent - n_handled < BUS_PIPELINED_CALLS_MAX) {
+                        r = sd_bus_call_method_async(
+                                        bus,
+                                        &calls[n_sent].slot,
+                                        destination,
+                                        paths[n_sent],
+                                        "org.freedesktop.DBus.Properties",
+                                        "GetAll",
+                                        pipelined_call_reply,
+                                        calls + n_sent,
+                                        "s", strempty(interface));
+                        if (r < 0)
+                                goto finish;
+
+                        n_sent++;
+                }
+
+                while (n_handled < n && calls[n_handled].reply) {
+                        struct pipelined_call *c = calls + n_handled;
+                        const sd_bus_error *e;
+
+                        e = sd_bus_message_get_error(c->reply);
+                        r = handler(paths[n_handled], e ? NULL : c->reply, e, userdata);
+
+                        c->slot = sd_bus_slot_unref(c->slot);
+                        c->reply = sd_bus_message_unref(c->reply);
+                        n_handled++;
+
+                        if (r < 0)
+                                goto finish;
+                }
+
+                if (n_handled >= n)
+                        break;
+
+                r = sd_bus_process(bus, NULL);
+                if (r < 0)
+                        goto finish;
+                if (r > 0)
+                        continue;
+
+                r = sd_bus_wait(bus, (uint64_t) -1);
+                if (r < 0)
+                        goto finish;
+        }
+
+        r = 0;
+
+finish:
+        pipelined_calls_free(calls, n);
+        return r;
+}
+
 int bus_connect_transport(BusTransport transport, const char *host, bool user, sd_bus **ret) {
         _cleanup_(sd_bus_close_unrefp) sd_bus *bus = NULL;
         int r;
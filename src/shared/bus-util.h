@@ -42,6 +42,14 @@ int bus_message_map_all_properties(sd_bus_message *m, const struct bus_propertie
 int bus_map_all_properties(sd_bus *bus, const char *destination, const char *path, const struct bus_properties_map *map,
                            unsigned flags, sd_bus_error *error, sd_bus_message **reply, void *userdata);
 
+/* dbus-daemon refuses to track more than 128 pending replies per connection by default, stay below that */
+#define BUS_PIPELINED_CALLS_MAX 64U
+
+typedef int (*bus_get_all_properties_handler_t)(const char *path, sd_bus_message *reply, const sd_bus_error *error, void *userdata);
+
+int bus_get_all_properties_pipelined(sd_bus *bus, const char *destination, char **paths, const char *interface,
+                                     bus_get_all_properties_handler_t handler, void *userdata);
+
 int bus_async_unregister_and_exit(sd_event *e, sd_bus *bus, const char *name);
 
 typedef bool (*check_idle_t)(void *userdata);
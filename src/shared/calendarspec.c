@@ -1077,17 +1077,153 @@ int calendar_spec_from_string(const char *p, CalendarSpec **spec) {
         return 0;
 }
 
-static int find_end_of_month(struct tm *tm, bool utc, int day) {
-        struct tm t = *tm;
+static bool year_is_leap(int year) {
+        return year % 4 == 0 && (year % 100 != 0 || year % 400 == 0);
+}
+
+static int days_in_month(int year, int month) {
+        static const int days[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+
+        assert(month >= 0 && month < 12);
+
+        return days[month] + (month == 1 && year_is_leap(year));
+}
+
+static int64_t tm_to_civil_days(const struct tm *tm) {
+        int64_t year, month, era, yoe, doy, doe;
+
+        /* Returns the number of days since the epoch of the date of the broken-down time. Out-of-range
+         * months and days are normalized the same way timegm() does it. The days are counted with the
+         * usual algorithm for the proleptic Gregorian calendar, with years starting in March. */
+
+        year = (int64_t) tm->tm_year + 1900 + tm->tm_mon / 12;
+        month = tm->tm_mon % 12;
+        if (month < 0) {
+                month += 12;
+                year--;
+        }
+
+        if (month < 2)
+                year--;
+        era = (year >= 0 ? year : year - 399) / 400;
+        yoe = year - era * 400;
+        doy = (153 * (month < 2 ? month + 10 : month - 2) + 2) / 5;
+        doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+        return era * 146097 + doe - 719468 + tm->tm_mday - 1;
+}
+
+static int64_t tm_to_civil_seconds(const struct tm *tm) {
+        /* The number of seconds since the epoch the broken-down time would correspond to if it was UTC */
+        return ((tm_to_civil_days(tm) * 24 + tm->tm_hour) * 60 + tm->tm_min) * 60 + tm->tm_sec;
+}
+
+/* We assume that the UTC offset of a time zone never changes by more than a day at once, and never twice within
+ * a week. */
+#define OFFSET_CHANGE_MAX ((time_t) (24 * 60 * 60))
+#define OFFSET_SPAN_MAX ((time_t) (7 * 24 * 60 * 60))
+
+typedef struct OffsetSpan {
+        /* The UTC offset of the local time zone is known to be constant in between */
+        time_t from;
+        time_t to;
+        long gmtoff;
+} OffsetSpan;
+
+static bool offset_span_add(OffsetSpan *span, time_t x) {
+        struct tm t;
+
+        if (x >= span->from && x <= span->to)
+                return true;
+
+        if (!localtime_r(&x, &t) || t.tm_gmtoff != span->gmtoff)
+                return false;
+
+        span->from = MIN(span->from, x);
+        span->to = MAX(span->to, x);
+        return true;
+}
+
+static time_t spec_mktime(const CalendarSpec *spec, struct tm *tm, OffsetSpan *span) {
+        struct tm t;
+        int64_t s;
+        time_t x;
+
+        assert(spec);
+        assert(tm);
+        assert(span);
 
-        t.tm_mon++;
-        t.tm_mday = 1 - day;
+        /* Like mktime_or_timegm(), but faster: glibc's mktime() checks whether /etc/localtime changed on
+         * every call, and searches for the time in a number of localtime() calls. Instead, try the UTC offset
+         * of the last conversion first, and check the result with localtime_r(). mktime() is only used if
+         * the local time doesn't exist or might be ambiguous, i.e. next to a change of the UTC offset, or if
+         * the DST flag doesn't match, in which case mktime() shifts the time. */
 
-        if (mktime_or_timegm(&t, utc) < 0 ||
-            t.tm_mon != tm->tm_mon)
+        s = tm_to_civil_seconds(tm);
+
+        if (spec->utc) {
+                x = (time_t) s;
+                if (!gmtime_r(&x, tm))
+                        return (time_t) -1;
+
+                return x;
+        }
+
+        for (unsigned i = 0; i < 2; i++) {
+                x = (time_t) (s - span->gmtoff);
+                if (!localtime_r(&x, &t))
+                        break;
+
+                if (t.tm_gmtoff != span->gmtoff) {
+                        *span = (OffsetSpan) {
+                                .from = x,
+                                .to = x,
+                                .gmtoff = t.tm_gmtoff,
+                        };
+                        continue;
+                }
+
+                if (tm->tm_isdst >= 0 && t.tm_isdst != tm->tm_isdst)
+                        break;
+
+                /* The offset must not change anywhere close to x, otherwise x might be ambiguous. Start a new
+                 * span around x if the current one would get too long to cover it. */
+                if (MAX(span->to, x + OFFSET_CHANGE_MAX) - MIN(span->from, x - OFFSET_CHANGE_MAX) > OFFSET_SPAN_MAX)
+                        span->from = span->to = x;
+                if (!offset_span_add(span, x - OFFSET_CHANGE_MAX) ||
+                    !offset_span_add(span, x + OFFSET_CHANGE_MAX))
+                        break;
+
+                *tm = t;
+                return x;
+        }
+
+        x = mktime(tm);
+        if (x != (time_t) -1)
+                *span = (OffsetSpan) {
+                        .from = x,
+                        .to = x,
+                        .gmtoff = tm->tm_gmtoff,
+                };
+
+        return x;
+}
+
+static int find_end_of_month(const struct tm *tm, int day) {
+        int n, k;
+
+        /* Returns the day of the month which is the specified number of days before the first day of the
+         * next month, or -1 if there is no such day in this month. */
+
+        if (tm->tm_mon < 0 || tm->tm_mon >= 12)
+                return -1;
+
+        n = days_in_month(tm->tm_year + 1900, tm->tm_mon);
+        k = n + 1 - day;
+        if (k < 1 || k > n)
                 return -1;
 
-        return t.tm_mday;
+        return k;
 }
 
 static int find_matching_component(const CalendarSpec *spec, const CalendarComponent *c,
@@ -1107,8 +1243,8 @@ static int find_matching_component(const CalendarSpec *spec, const CalendarCompo
                 stop = c->stop;
 
                 if (spec->end_of_month && p == spec->day) {
-                        start = find_end_of_month(tm, spec->utc, start);
-                        stop = find_end_of_month(tm, spec->utc, stop);
+                        start = find_end_of_month(tm, start);
+                        stop = find_end_of_month(tm, stop);
 
                         if (stop > 0)
                                 SWAP_TWO(start, stop);
@@ -1143,7 +1279,7 @@ static int find_matching_component(const CalendarSpec *spec, const CalendarCompo
         return r;
 }
 
-static int tm_within_bounds(struct tm *tm, bool utc) {
+static int tm_within_bounds(const CalendarSpec *spec, struct tm *tm, OffsetSpan *span) {
         struct tm t;
         assert(tm);
 
@@ -1155,8 +1291,17 @@ static int tm_within_bounds(struct tm *tm, bool utc) {
         if (tm->tm_year + 1900 > MAX_YEAR)
                 return -ERANGE;
 
+        /* In UTC, a time with all fields in range can't be normalized to anything else */
+        if (spec->utc &&
+            tm->tm_mon >= 0 && tm->tm_mon < 12 &&
+            tm->tm_mday >= 1 && tm->tm_mday <= days_in_month(tm->tm_year + 1900, tm->tm_mon) &&
+            tm->tm_hour >= 0 && tm->tm_hour < 24 &&
+            tm->tm_min >= 0 && tm->tm_min < 60 &&
+            tm->tm_sec >= 0 && tm->tm_sec < 60)
+                return true;
+
         t = *tm;
-        if (mktime_or_timegm(&t, utc) < 0)
+        if (spec_mktime(spec, &t, span) < 0)
                 return negative_errno();
 
         /* Did any normalization take place? If so, it was out of bounds before */
@@ -1171,22 +1316,19 @@ static int tm_within_bounds(struct tm *tm, bool utc) {
         return good;
 }
 
-static bool matches_weekday(int weekdays_bits, const struct tm *tm, bool utc) {
-        struct tm t;
+static bool matches_weekday(int weekdays_bits, const struct tm *tm) {
         int k;
 
         if (weekdays_bits < 0 || weekdays_bits >= BITS_WEEKDAYS)
                 return true;
 
-        t = *tm;
-        if (mktime_or_timegm(&t, utc) < 0)
-                return false;
-
-        k = t.tm_wday == 0 ? 6 : t.tm_wday - 1;
+        /* The weekday only depends on the date, which is already in bounds here. 1970-01-01 was a
+         * Thursday, and the bits start with Monday. */
+        k = (int) ((tm_to_civil_days(tm) % 7 + 7 + 3) % 7);
         return (weekdays_bits & (1 << k));
 }
 
-static int find_next(const CalendarSpec *spec, struct tm *tm, usec_t *usec) {
+static int find_next(const CalendarSpec *spec, struct tm *tm, usec_t *usec, OffsetSpan *span) {
         struct tm c;
         int tm_usec;
         int r;
@@ -1201,7 +1343,7 @@ static int find_next(const CalendarSpec *spec, struct tm *tm, usec_t *usec) {
 
         for (;;) {
                 /* Normalize the current date */
-                (void) mktime_or_timegm(&c, spec->utc);
+                (void) spec_mktime(spec, &c, span);
                 c.tm_isdst = spec->dst;
 
                 c.tm_year += 1900;
@@ -1215,7 +1357,7 @@ static int find_next(const CalendarSpec *spec, struct tm *tm, usec_t *usec) {
                 }
                 if (r < 0)
                         return r;
-                if (tm_within_bounds(&c, spec->utc) <= 0)
+                if (tm_within_bounds(spec, &c, span) <= 0)
                         return -ENOENT;
 
                 c.tm_mon += 1;
@@ -1226,7 +1368,7 @@ static int find_next(const CalendarSpec *spec, struct tm *tm, usec_t *usec) {
                         c.tm_mday = 1;
                         c.tm_hour = c.tm_min = c.tm_sec = tm_usec = 0;
                 }
-                if (r < 0 || (r = tm_within_bounds(&c, spec->utc)) < 0) {
+                if (r < 0 || (r = tm_within_bounds(spec, &c, span)) < 0) {
                         c.tm_year++;
                         c.tm_mon = 0;
                         c.tm_mday = 1;
@@ -1239,7 +1381,7 @@ static int find_next(const CalendarSpec *spec, struct tm *tm, usec_t *usec) {
                 r = find_matching_component(spec, spec->day, &c, &c.tm_mday);
                 if (r > 0)
                         c.tm_hour = c.tm_min = c.tm_sec = tm_usec = 0;
-                if (r < 0 || (r = tm_within_bounds(&c, spec->utc)) < 0) {
+                if (r < 0 || (r = tm_within_bounds(spec, &c, span)) < 0) {
                         c.tm_mon++;
                         c.tm_mday = 1;
                         c.tm_hour = c.tm_min = c.tm_sec = tm_usec = 0;
@@ -1248,7 +1390,7 @@ static int find_next(const CalendarSpec *spec, struct tm *tm, usec_t *usec) {
                 if (r == 0)
                         continue;
 
-                if (!matches_weekday(spec->weekdays_bits, &c, spec->utc)) {
+                if (!matches_weekday(spec->weekdays_bits, &c)) {
                         c.tm_mday++;
                         c.tm_hour = c.tm_min = c.tm_sec = tm_usec = 0;
                         continue;
@@ -1257,7 +1399,7 @@ static int find_next(const CalendarSpec *spec, struct tm *tm, usec_t *usec) {
                 r = find_matching_component(spec, spec->hour, &c, &c.tm_hour);
                 if (r > 0)
                         c.tm_min = c.tm_sec = tm_usec = 0;
-                if (r < 0 || (r = tm_within_bounds(&c, spec->utc)) < 0) {
+                if (r < 0 || (r = tm_within_bounds(spec, &c, span)) < 0) {
                         c.tm_mday++;
                         c.tm_hour = c.tm_min = c.tm_sec = tm_usec = 0;
                         continue;
@@ -1271,7 +1413,7 @@ static int find_next(const CalendarSpec *spec, struct tm *tm, usec_t *usec) {
                 r = find_matching_component(spec, spec->minute, &c, &c.tm_min);
                 if (r > 0)
                         c.tm_sec = tm_usec = 0;
-                if (r < 0 || (r = tm_within_bounds(&c, spec->utc)) < 0) {
+                if (r < 0 || (r = tm_within_bounds(spec, &c, span)) < 0) {
                         c.tm_hour++;
                         c.tm_min = c.tm_sec = tm_usec = 0;
                         continue;
@@ -1284,7 +1426,7 @@ static int find_next(const CalendarSpec *spec, struct tm *tm, usec_t *usec) {
                 tm_usec = c.tm_sec % USEC_PER_SEC;
                 c.tm_sec /= USEC_PER_SEC;
 
-                if (r < 0 || (r = tm_within_bounds(&c, spec->utc)) < 0) {
+                if (r < 0 || (r = tm_within_bounds(spec, &c, span)) < 0) {
                         c.tm_min++;
                         c.tm_sec = tm_usec = 0;
                         continue;
@@ -1303,6 +1445,7 @@ static int calendar_spec_next_usec_impl(const CalendarSpec *spec, usec_t usec, u
         time_t t;
         int r;
         usec_t tm_usec;
+        OffsetSpan span;
 
         assert(spec);
 
@@ -1313,12 +1456,17 @@ static int calendar_spec_next_usec_impl(const CalendarSpec *spec, usec_t usec, u
         t = (time_t) (usec / USEC_PER_SEC);
         assert_se(localtime_or_gmtime_r(&t, &tm, spec->utc));
         tm_usec = usec % USEC_PER_SEC;
+        span = (OffsetSpan) {
+                .from = t,
+                .to = t,
+                .gmtoff = tm.tm_gmtoff,
+        };
 
-        r = find_next(spec, &tm, &tm_usec);
+        r = find_next(spec, &tm, &tm_usec, &span);
         if (r < 0)
                 return r;
 
-        t = mktime_or_timegm(&tm, spec->utc);
+        t = spec_mktime(spec, &tm, &span);
         if (t < 0)
                 return -EINVAL;
 
@@ -159,6 +159,7 @@ static int parse_line(
                 void *userdata) {
 
         char *e, *include;
+        int r;
 
         assert(filename);
         assert(line > 0);
@@ -216,9 +217,9 @@ static int parse_line(
                         return -EBADMSG;
                 }
 
-                n = strndup(l+1, k-2);
-                if (!n)
-                        return -ENOMEM;
+                /* The section name is only copied if it changes */
+                l[k-1] = 0;
+                n = l + 1;
 
                 if (sections && !nulstr_contains(sections, n)) {
                         bool ignore = flags & CONFIG_PARSE_RELAXED;
@@ -236,12 +237,16 @@ static int parse_line(
                         if (!ignore)
                                 log_syntax(unit, LOG_WARNING, filename, line, 0, "Unknown section '%s'. Ignoring.", n);
 
-                        free(n);
                         *section = mfree(*section);
                         *section_line = 0;
                         *section_ignored = true;
                 } else {
-                        free_and_replace(*section, n);
+                        if (!streq_ptr(*section, n)) {
+                                r = free_and_strdup(section, n);
+                                if (r < 0)
+                                        return r;
+                        }
+
                         *section_line = line;
                         *section_ignored = false;
                 }
@@ -280,6 +285,40 @@ static int parse_line(
                                userdata);
 }
 
+/* Splits off the next line from a NUL terminated buffer, and terminates it in place. Recognizes the same
+ * combinations of \n, \r and \0 as line endings as read_line() does. Returns 0 at the end of the buffer. */
+static int split_line(char **p, const char *end, char **ret) {
+        char *l, *e;
+        unsigned seen = 0;
+
+        assert(p);
+        assert(end);
+        assert(ret);
+
+        l = *p;
+        if (l >= end)
+                return 0;
+
+        e = l + strcspn(l, "\n\r");
+        if ((size_t) (e - l) >= LONG_LINE_MAX)
+                return -ENOBUFS;
+
+        /* A line ends with at most one of each marker, and nothing follows a NUL */
+        for (*p = e; *p < end; (*p)++) {
+                unsigned m;
+
+                m = **p == '\0' ? 1 : **p == '\n' ? 2 : **p == '\r' ? 4 : 0;
+                if (m == 0 || (seen & (m | 1)) != 0)
+                        break;
+
+                seen |= m;
+        }
+
+        *e = 0;
+        *ret = l;
+        return 1;
+}
+
 /* Go through the file and parse each line */
 int config_parse(const char *unit,
                  const char *filename,
@@ -290,10 +329,12 @@ int config_parse(const char *unit,
                  ConfigParseFlags flags,
                  void *userdata) {
 
-        _cleanup_free_ char *section = NULL, *continuation = NULL;
+        _cleanup_free_ char *section = NULL, *contents = NULL;
         _cleanup_fclose_ FILE *ours = NULL;
+        char *p, *end, *continuation = NULL, *continuation_end = NULL;
         unsigned line = 0, section_line = 0;
         bool section_ignored = false, bom_seen = false;
+        size_t size;
         int r;
 
         assert(filename);
@@ -313,12 +354,17 @@ int config_parse(const char *unit,
 
         fd_warn_permissions(filename, fileno(f));
 
-        for (;;) {
-                _cleanup_free_ char *buf = NULL;
+        /* Read the file in one go and split it into lines in place, rather than reading and copying it line
+         * by line. Continuation lines are joined in place too. */
+        r = read_full_stream_full(f, filename, 0, &contents, &size);
+        if (r < 0)
+                return log_error_errno(r, "%s: Error while reading configuration file: %m", filename);
+
+        for (p = contents, end = contents + size;;) {
                 bool escaped = false;
-                char *l, *p, *e;
+                char *l, *e;
 
-                r = read_line(f, LONG_LINE_MAX, &buf);
+                r = split_line(&p, end, &l);
                 if (r == 0)
                         break;
                 if (r == -ENOBUFS) {
@@ -327,22 +373,15 @@ int config_parse(const char *unit,
 
                         return r;
                 }
-                if (r < 0) {
-                        if (CONFIG_PARSE_WARN)
-                                log_error_errno(r, "%s:%u: Error while reading configuration file: %m", filename, line);
 
-                        return r;
-                }
-
-                l = skip_leading_chars(buf, WHITESPACE);
-                if (*l != '\0' && strchr(COMMENTS, *l))
+                e = skip_leading_chars(l, WHITESPACE);
+                if (*e != '\0' && strchr(COMMENTS, *e))
                         continue;
 
-                l = buf;
                 if (!bom_seen) {
                         char *q;
 
-                        q = startswith(buf, UTF8_BYTE_ORDER_MARK);
+                        q = startswith(l, UTF8_BYTE_ORDER_MARK);
                         if (q) {
                                 l = q;
                                 bom_seen = true;
@@ -350,23 +389,23 @@ int config_parse(const char *unit,
                 }
 
                 if (continuation) {
-                        if (strlen(continuation) + strlen(l) > LONG_LINE_MAX) {
+                        size_t n;
+
+                        n = strlen(l);
+                        if ((size_t) (continuation_end - continuation) + n > LONG_LINE_MAX) {
                                 if (flags & CONFIG_PARSE_WARN)
                                         log_error("%s:%u: Continuation line too long", filename, line);
                                 return -ENOBUFS;
                         }
 
-                        if (!strextend(&continuation, l, NULL)) {
-                                if (flags & CONFIG_PARSE_WARN)
-                                        log_oom();
-                                return -ENOMEM;
-                        }
-
-                        p = continuation;
-                } else
-                        p = l;
+                        /* The line is always behind the continuation in the buffer, hence just move it down */
+                        memmove(continuation_end, l, n + 1);
+                        l = continuation_end;
+                }
 
-                for (e = p; *e; e++) {
+                /* The part of a continuation we already looked at ended in a backslash we replaced by a space,
+                 * hence no escape is pending and it is sufficient to look at the new line */
+                for (e = l; *e; e++) {
                         if (escaped)
                                 escaped = false;
                         else if (*e == '\\')
@@ -376,14 +415,9 @@ int config_parse(const char *unit,
                 if (escaped) {
                         *(e-1) = ' ';
 
-                        if (!continuation) {
-                                continuation = strdup(l);
-                                if (!continuation) {
-                                        if (flags & CONFIG_PARSE_WARN)
-                                                log_oom();
-                                        return -ENOMEM;
-                                }
-                        }
+                        if (!continuation)
+                                continuation = l;
+                        continuation_end = e;
 
                         continue;
                 }
@@ -398,7 +432,7 @@ int config_parse(const char *unit,
                                &section,
                                &section_line,
                                &section_ignored,
-                               p,
+                               continuation ?: l,
                                userdata);
                 if (r < 0) {
                         if (flags & CONFIG_PARSE_WARN)
@@ -406,7 +440,7 @@ int config_parse(const char *unit,
                         return r;
                 }
 
-                continuation = mfree(continuation);
+                continuation = NULL;
         }
 
         if (continuation) {
@@ -1,9 +1,55 @@
 /* SPDX-License-Identifier: LGPL-2.1+ */
 
 #if HAVE_LIBCRYPTSETUP
+#include "alloc-util.h"
 #include "crypt-util.h"
+#include "dlfcn-util.h"
 #include "log.h"
 
+static void *cryptsetup_dl = NULL;
+
+int (*sym_crypt_activate_by_passphrase)(struct crypt_device *cd, const char *name, int keyslot, const char *passphrase, size_t passphrase_size, uint32_t flags);
+int (*sym_crypt_activate_by_volume_key)(struct crypt_device *cd, const char *name, const char *volume_key, size_t volume_key_size, uint32_t flags);
+int (*sym_crypt_deactivate)(struct crypt_device *cd, const char *name);
+void (*sym_crypt_free)(struct crypt_device *cd);
+const char *(*sym_crypt_get_dir)(void);
+int (*sym_crypt_init)(struct crypt_device **cd, const char *device);
+int (*sym_crypt_load)(struct crypt_device *cd, const char *requested_type, void *params);
+int (*sym_crypt_set_data_device)(struct crypt_device *cd, const char *device);
+
+int dlopen_cryptsetup(void) {
+        _cleanup_(dlclosep) void *dl = NULL;
+        int r;
+
+        if (cryptsetup_dl)
+                return 0; /* Already loaded */
+
+        dl = dlopen("libcryptsetup.so.12", RTLD_LAZY);
+        if (!dl)
+                return log_debug_errno(SYNTHETIC_ERRNO(EOPNOTSUPP),
+                                       "libcryptsetup support is not installed: %s", dlerror());
+
+        r = dlsym_many_and_warn(
+                        dl,
+                        LOG_DEBUG,
+                        DLSYM_ARG(crypt_activate_by_passphrase),
+                        DLSYM_ARG(crypt_activate_by_volume_key),
+                        DLSYM_ARG(crypt_deactivate),
+                        DLSYM_ARG(crypt_free),
+                        DLSYM_ARG(crypt_get_dir),
+                        DLSYM_ARG(crypt_init),
+                        DLSYM_ARG(crypt_load),
+                        DLSYM_ARG(crypt_set_data_device),
+                        NULL);
+        if (r < 0)
+                return r;
+
+        /* Never released, just like a regular shared library dependency wouldn't be */
+        cryptsetup_dl = TAKE_PTR(dl);
+
+        return 1;
+}
+
 void cryptsetup_log_glue(int level, const char *msg, void *usrptr) {
         switch (level) {
         case CRYPT_LOG_NORMAL:
@@ -6,7 +6,23 @@
 
 #include "macro.h"
 
+/* libcryptsetup pulls in a lot of other libraries, hence libsystemd-shared only loads it when an image
+ * actually needs to be decrypted. Binaries that link against libcryptsetup themselves may call it
+ * directly. */
+
+extern int (*sym_crypt_activate_by_passphrase)(struct crypt_device *cd, const char *name, int keyslot, const char *passphrase, size_t passphrase_size, uint32_t flags);
+extern int (*sym_crypt_activate_by_volume_key)(struct crypt_device *cd, const char *name, const char *volume_key, size_t volume_key_size, uint32_t flags);
+extern int (*sym_crypt_deactivate)(struct crypt_device *cd, const char *name);
+extern void (*sym_crypt_free)(struct crypt_device *cd);
+extern const char *(*sym_crypt_get_dir)(void);
+extern int (*sym_crypt_init)(struct crypt_device **cd, const char *device);
+extern int (*sym_crypt_load)(struct crypt_device *cd, const char *requested_type, void *params);
+extern int (*sym_crypt_set_data_device)(struct crypt_device *cd, const char *device);
+
+int dlopen_cryptsetup(void);
+
 DEFINE_TRIVIAL_CLEANUP_FUNC(struct crypt_device *, crypt_free);
+DEFINE_TRIVIAL_CLEANUP_FUNC(struct crypt_device *, sym_crypt_free);
 
 void cryptsetup_log_glue(int level, const char *msg, void *usrptr);
 #endif
@@ -0,0 +1,43 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <stdarg.h>
+
+#include "dlfcn-util.h"
+#include "log.h"
+
+int dlsym_many_and_warn(void *dl, int level, ...) {
+        va_list ap;
+        int r;
+
+        /* Resolves a NULL terminated list of (function pointer, symbol name) pairs, and logs at the specified
+         * level if one of them cannot be found. Note that the pointers for the symbols before the missing
+         * one are already set in that case, the caller is expected to reset them. */
+
+        va_start(ap, level);
+
+        for (;;) {
+                void (**fn)(void);
+                void *tfn;
+                const char *symbol;
+
+                fn = va_arg(ap, typeof(fn));
+                if (!fn)
+                        break;
+
+                symbol = va_arg(ap, typeof(symbol));
+
+                tfn = (typeof(tfn)) dlsym(dl, symbol);
+                if (!tfn) {
+                        r = log_full_errno(level,
+                                           SYNTHETIC_ERRNO(ELIBBAD),
+                                           "Can't find symbol %s: %s", symbol, dlerror());
+                        va_end(ap);
+                        return r;
+                }
+
+                *fn = (typeof(*fn)) tfn;
+        }
+
+        va_end(ap);
+        return 0;
+}
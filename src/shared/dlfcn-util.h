@@ -0,0 +1,15 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+#pragma once
+
+#include <dlfcn.h>
+
+#include "macro.h"
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(void*, dlclose);
+
+int dlsym_many_and_warn(void *dl, int level, ...) _sentinel_;
+
+/* Expands to the two arguments dlsym_many_and_warn() expects for each symbol, for a function pointer
+ * called sym_<name> */
+#define DLSYM_ARG(arg) \
+        &sym_##arg, STRINGIFY(arg)
@@ -224,6 +224,7 @@ int unit_file_find_dropin_paths(
                 const char *original_root,
                 char **lookup_path,
                 Set *unit_path_cache,
+                ConfFilesCache *conf_files_cache,
                 const char *dir_suffix,
                 const char *file_suffix,
                 const Set *names,
@@ -267,7 +268,7 @@ int unit_file_find_dropin_paths(
                 return 0;
         }
 
-        r = conf_files_list_strv(ret, file_suffix, NULL, 0, (const char**) dirs);
+        r = conf_files_list_strv_cached(conf_files_cache, ret, file_suffix, NULL, 0, (const char**) dirs);
         if (r < 0)
                 return log_warning_errno(r, "Failed to create the list of configuration files: %m");
 
@@ -1,6 +1,7 @@
 /* SPDX-License-Identifier: LGPL-2.1+ */
 #pragma once
 
+#include "conf-files.h"
 #include "hashmap.h"
 #include "macro.h"
 #include "set.h"
@@ -19,6 +20,7 @@ int unit_file_find_dropin_paths(
                 const char *original_root,
                 char **lookup_path,
                 Set *unit_path_cache,
+                ConfFilesCache *conf_files_cache,
                 const char *dir_suffix,
                 const char *file_suffix,
                 const Set *names,
@@ -4,6 +4,7 @@
 #include <errno.h>
 #include <sys/prctl.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 #include <unistd.h>
 #include <stdio.h>
 
@@ -12,10 +13,12 @@
 #include "env-file.h"
 #include "env-util.h"
 #include "exec-util.h"
+#include "extract-word.h"
 #include "fd-util.h"
 #include "fileio.h"
 #include "hashmap.h"
 #include "macro.h"
+#include "parse-util.h"
 #include "process-util.h"
 #include "rlimit-util.h"
 #include "serialize.h"
@@ -72,18 +75,68 @@ static int do_spawn(const char *path, char *argv[], int stdout_fd, pid_t *pid) {
         return 1;
 }
 
+typedef struct ExecChild {
+        usec_t start;
+        char path[];
+} ExecChild;
+
+static unsigned exec_max_parallel(void) {
+        long n;
+
+        /* Most executables run from these directories are short-lived and mostly wait for I/O, hence allow
+         * some more of them than there are CPUs, but don't fork off hundreds at once either. */
+        n = sysconf(_SC_NPROCESSORS_ONLN);
+
+        return MAX(4U, n > 0 ? (unsigned) n * 2U : 0U);
+}
+
+static void exec_write_timing(int timing_fd, const char *path, usec_t start) {
+        if (timing_fd < 0)
+                return;
+
+        (void) dprintf(timing_fd, USEC_FMT " " USEC_FMT " %s\n", start, usec_sub_unsigned(now(CLOCK_MONOTONIC), start), basename(path));
+}
+
+static int wait_for_any(Hashmap *pids, int timing_fd) {
+        _cleanup_free_ ExecChild *c = NULL;
+        siginfo_t si = {};
+        int r;
+
+        /* Waits for whichever child finishes first, so that a slow one doesn't hold back the others, and the
+         * time of each is measured correctly. The child is left in waitable state, it's reaped below. */
+        for (;;) {
+                if (waitid(P_ALL, 0, &si, WEXITED|WNOWAIT) >= 0)
+                        break;
+                if (errno != EINTR)
+                        return -errno;
+        }
+
+        c = hashmap_remove(pids, PID_TO_PTR(si.si_pid));
+        if (!c) {
+                (void) wait_for_terminate(si.si_pid, NULL);
+                return 0;
+        }
+
+        r = wait_for_terminate_and_check(c->path, si.si_pid, WAIT_LOG);
+        exec_write_timing(timing_fd, c->path, c->start);
+
+        return r;
+}
+
 static int do_execute(
                 char **directories,
                 usec_t timeout,
                 gather_stdout_callback_t const callbacks[_STDOUT_CONSUME_MAX],
                 void* const callback_args[_STDOUT_CONSUME_MAX],
                 int output_fd,
+                int timing_fd,
                 char *argv[],
                 char *envp[],
                 ExecDirFlags flags) {
 
         _cleanup_hashmap_free_free_ Hashmap *pids = NULL;
         _cleanup_strv_free_ char **paths = NULL;
+        unsigned max_parallel = 0;
         char **path, **e;
         int r;
         bool parallel_execution;
@@ -104,6 +157,8 @@ static int do_execute(
                 pids = hashmap_new(NULL);
                 if (!pids)
                         return log_oom();
+
+                max_parallel = exec_max_parallel();
         }
 
         /* Abort execution of this process after the timeout. We simply rely on SIGALRM as
@@ -119,6 +174,7 @@ static int do_execute(
         STRV_FOREACH(path, paths) {
                 _cleanup_free_ char *t = NULL;
                 _cleanup_close_ int fd = -1;
+                usec_t start;
                 pid_t pid;
 
                 t = strdup(*path);
@@ -131,17 +187,37 @@ static int do_execute(
                                 return log_error_errno(fd, "Failed to open serialization file: %m");
                 }
 
+                /* Don't start more than max_parallel at the same time, wait for one to finish first */
+                while (parallel_execution && hashmap_size(pids) >= max_parallel) {
+                        r = wait_for_any(pids, timing_fd);
+                        if (!FLAGS_SET(flags, EXEC_DIR_IGNORE_ERRORS) && r > 0)
+                                return r;
+                }
+
+                start = now(CLOCK_MONOTONIC);
+
                 r = do_spawn(t, argv, fd, &pid);
                 if (r <= 0)
                         continue;
 
                 if (parallel_execution) {
-                        r = hashmap_put(pids, PID_TO_PTR(pid), t);
-                        if (r < 0)
+                        ExecChild *c;
+
+                        c = malloc(offsetof(ExecChild, path) + strlen(t) + 1);
+                        if (!c)
+                                return log_oom();
+
+                        c->start = start;
+                        strcpy(c->path, t);
+
+                        r = hashmap_put(pids, PID_TO_PTR(pid), c);
+                        if (r < 0) {
+                                free(c);
                                 return log_oom();
-                        t = NULL;
+                        }
                 } else {
                         r = wait_for_terminate_and_check(t, pid, WAIT_LOG);
+                        exec_write_timing(timing_fd, t, start);
                         if (FLAGS_SET(flags, EXEC_DIR_IGNORE_ERRORS)) {
                                 if (r < 0)
                                         continue;
@@ -167,39 +243,108 @@ static int do_execute(
         }
 
         while (!hashmap_isempty(pids)) {
-                _cleanup_free_ char *t = NULL;
-                pid_t pid;
+                r = wait_for_any(pids, timing_fd);
+                if (!FLAGS_SET(flags, EXEC_DIR_IGNORE_ERRORS) && r > 0)
+                        return r;
+        }
 
-                pid = PTR_TO_PID(hashmap_first_key(pids));
-                assert(pid > 0);
+        return 0;
+}
 
-                t = hashmap_remove(pids, PID_TO_PTR(pid));
-                assert(t);
+static int read_timings(int fd, ExecDirTiming **ret, size_t *ret_n) {
+        _cleanup_fclose_ FILE *f = NULL;
+        ExecDirTiming *timings = NULL;
+        size_t n = 0, allocated = 0;
+        int r;
 
-                r = wait_for_terminate_and_check(t, pid, WAIT_LOG);
-                if (!FLAGS_SET(flags, EXEC_DIR_IGNORE_ERRORS) && r > 0)
-                        return r;
+        f = fdopen(fd, "r");
+        if (!f) {
+                safe_close(fd);
+                return -errno;
+        }
+
+        for (;;) {
+                _cleanup_free_ char *line = NULL, *start = NULL, *duration = NULL;
+                const char *p;
+                ExecDirTiming *t;
+
+                r = read_line(f, LONG_LINE_MAX, &line);
+                if (r < 0)
+                        goto fail;
+                if (r == 0)
+                        break;
+
+                p = line;
+                r = extract_many_words(&p, " ", 0, &start, &duration, NULL);
+                if (r < 0)
+                        goto fail;
+                if (r < 2 || isempty(p)) {
+                        r = -EBADMSG;
+                        goto fail;
+                }
+
+                if (!GREEDY_REALLOC(timings, allocated, n + 1)) {
+                        r = -ENOMEM;
+                        goto fail;
+                }
+
+                t = timings + n;
+                *t = (ExecDirTiming) {};
+
+                r = safe_atou64(start, &t->start);
+                if (r < 0)
+                        goto fail;
+
+                r = safe_atou64(duration, &t->duration);
+                if (r < 0)
+                        goto fail;
+
+                t->name = strdup(p);
+                if (!t->name) {
+                        r = -ENOMEM;
+                        goto fail;
+                }
+
+                n++;
         }
 
+        *ret = timings;
+        *ret_n = n;
         return 0;
+
+fail:
+        exec_dir_timing_free_many(timings, n);
+        return r;
 }
 
-int execute_directories(
+void exec_dir_timing_free_many(ExecDirTiming *timings, size_t n) {
+        size_t i;
+
+        for (i = 0; i < n; i++)
+                free(timings[i].name);
+
+        free(timings);
+}
+
+int execute_directories_full(
                 const char* const* directories,
                 usec_t timeout,
                 gather_stdout_callback_t const callbacks[_STDOUT_CONSUME_MAX],
                 void* const callback_args[_STDOUT_CONSUME_MAX],
                 char *argv[],
                 char *envp[],
-                ExecDirFlags flags) {
+                ExecDirFlags flags,
+                ExecDirTiming **ret_timings,
+                size_t *ret_n_timings) {
 
         char **dirs = (char**) directories;
-        _cleanup_close_ int fd = -1;
+        _cleanup_close_ int fd = -1, timing_fd = -1;
         char *name;
         int r;
         pid_t executor_pid;
 
         assert(!strv_isempty(dirs));
+        assert(!ret_timings == !ret_n_timings);
 
         name = basename(dirs[0]);
         assert(!isempty(name));
@@ -215,6 +360,15 @@ int execute_directories(
                         return log_error_errno(fd, "Failed to open serialization file: %m");
         }
 
+        if (ret_timings) {
+                *ret_timings = NULL;
+                *ret_n_timings = 0;
+
+                timing_fd = open_serialization_fd("exec-timing");
+                if (timing_fd < 0)
+                        return log_error_errno(timing_fd, "Failed to open serialization file: %m");
+        }
+
         /* Executes all binaries in the directories serially or in parallel and waits for
          * them to finish. Optionally a timeout is applied. If a file with the same name
          * exists in more than one directory, the earliest one wins. */
@@ -223,13 +377,26 @@ int execute_directories(
         if (r < 0)
                 return r;
         if (r == 0) {
-                r = do_execute(dirs, timeout, callbacks, callback_args, fd, argv, envp, flags);
+                r = do_execute(dirs, timeout, callbacks, callback_args, fd, timing_fd, argv, envp, flags);
                 _exit(r < 0 ? EXIT_FAILURE : r);
         }
 
         r = wait_for_terminate_and_check("(sd-executor)", executor_pid, 0);
         if (r < 0)
                 return r;
+
+        if (timing_fd >= 0) {
+                int k;
+
+                /* The times are informational only, hence don't fail if they can't be read */
+                if (lseek(timing_fd, 0, SEEK_SET) < 0)
+                        log_debug_errno(errno, "Failed to rewind timing fd, ignoring: %m");
+                else {
+                        k = read_timings(TAKE_FD(timing_fd), ret_timings, ret_n_timings);
+                        if (k < 0)
+                                log_debug_errno(k, "Failed to read execution times, ignoring: %m");
+                }
+        }
         if (!FLAGS_SET(flags, EXEC_DIR_IGNORE_ERRORS) && r > 0)
                 return r;
 
@@ -246,6 +413,18 @@ int execute_directories(
         return 0;
 }
 
+int execute_directories(
+                const char* const* directories,
+                usec_t timeout,
+                gather_stdout_callback_t const callbacks[_STDOUT_CONSUME_MAX],
+                void* const callback_args[_STDOUT_CONSUME_MAX],
+                char *argv[],
+                char *envp[],
+                ExecDirFlags flags) {
+
+        return execute_directories_full(directories, timeout, callbacks, callback_args, argv, envp, flags, NULL, NULL);
+}
+
 static int gather_environment_generate(int fd, void *arg) {
         char ***env = arg, **x, **y;
         _cleanup_fclose_ FILE *f = NULL;
@@ -29,6 +29,25 @@ typedef enum ExecCommandFlags {
         _EXEC_COMMAND_FLAGS_INVALID   = -1,
 } ExecCommandFlags;
 
+/* How long each executable took to run, as measured by the executor process */
+typedef struct ExecDirTiming {
+        char *name;
+        usec_t start;    /* CLOCK_MONOTONIC */
+        usec_t duration;
+} ExecDirTiming;
+
+void exec_dir_timing_free_many(ExecDirTiming *timings, size_t n);
+
+int execute_directories_full(
+                const char* const* directories,
+                usec_t timeout,
+                gather_stdout_callback_t const callbacks[_STDOUT_CONSUME_MAX],
+                void* const callback_args[_STDOUT_CONSUME_MAX],
+                char *argv[],
+                char *envp[],
+                ExecDirFlags flags,
+                ExecDirTiming **ret_timings,
+                size_t *ret_n_timings);
 int execute_directories(
                 const char* const* directories,
                 usec_t timeout,
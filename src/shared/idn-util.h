@@ -0,0 +1,15 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+#pragma once
+
+#if HAVE_LIBIDN2
+#include <idn2.h>
+
+/* libidn2 is loaded on first use, so that the many binaries linking libsystemd-shared that never process
+ * domain names don't pay for loading it */
+
+extern int (*sym_idn2_lookup_u8)(const uint8_t* src, uint8_t** lookupname, int flags);
+extern const char *(*sym_idn2_strerror)(int rc);
+extern int (*sym_idn2_to_unicode_8z8z)(const char * input, char ** output, int flags);
+
+int dlopen_idn(void);
+#endif
@@ -82,6 +82,8 @@ int tar_strip_suffixes(const char *name, char **ret) {
                 e = endswith(name, ".tar.gz");
         if (!e)
                 e = endswith(name, ".tar.bz2");
+        if (!e)
+                e = endswith(name, ".tar.zst");
         if (!e)
                 e = endswith(name, ".tgz");
         if (!e)
@@ -104,6 +106,8 @@ int raw_strip_suffixes(const char *p, char **ret) {
                 ".xz\0"
                 ".gz\0"
                 ".bz2\0"
+                ".zst\0"
+                ".chunks\0"
                 ".raw\0"
                 ".qcow2\0"
                 ".img\0"
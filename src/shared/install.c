@@ -38,6 +38,8 @@
 
 #define UNIT_FILE_FOLLOW_SYMLINK_MAX 64
 
+#define INSTALL_PATH_CACHE_UNITS_MIN 4U
+
 typedef enum SearchFlags {
         SEARCH_LOAD                   = 1 << 0,
         SEARCH_FOLLOW_CONFIG_SYMLINKS = 1 << 1,
@@ -47,6 +49,10 @@ typedef enum SearchFlags {
 typedef struct {
         OrderedHashmap *will_process;
         OrderedHashmap *have_processed;
+
+        /* If set, the unit files and directories found in the search path when the operation started, as
+         * built by unit_file_build_name_map(). Not owned by the context. */
+        Set *unit_path_cache;
 } InstallContext;
 
 typedef enum {
@@ -436,9 +442,14 @@ static int create_symlink(
          * the right place, or negative on error.
          */
 
-        mkdir_parents_label(new_path, 0755);
-
-        if (symlink(old_path, new_path) >= 0) {
+        /* Usually the directory exists already, e.g. when enabling a number of units wanted by the same
+         * target, hence only create it if the symlink can't be created otherwise. */
+        r = symlink(old_path, new_path);
+        if (r < 0 && errno == ENOENT) {
+                mkdir_parents_label(new_path, 0755);
+                r = symlink(old_path, new_path);
+        }
+        if (r >= 0) {
                 unit_file_changes_add(changes, n_changes, UNIT_FILE_SYMLINK, new_path, old_path);
                 return 1;
         }
@@ -972,6 +983,28 @@ static void install_context_done(InstallContext *c) {
         c->have_processed = ordered_hashmap_free_with_destructor(c->have_processed, install_info_free);
 }
 
+static int install_context_build_path_cache(InstallContext *c, const LookupPaths *paths, size_t n_units, Set **ret) {
+        int r;
+
+        assert(c);
+        assert(paths);
+        assert(ret);
+
+        /* Each unit, and each of its drop-in directories, is looked for in every directory of the search
+         * path, where it usually doesn't exist. When operating on more than a few units, read the
+         * directories once instead, and only look at what is actually there. */
+
+        if (n_units < INSTALL_PATH_CACHE_UNITS_MIN)
+                return 0;
+
+        r = unit_file_build_name_map(paths, NULL, NULL, NULL, ret);
+        if (r < 0)
+                return r;
+
+        c->unit_path_cache = *ret;
+        return 0;
+}
+
 static UnitFileInstallInfo *install_info_find(InstallContext *c, const char *name) {
         UnitFileInstallInfo *i;
 
@@ -1389,6 +1422,14 @@ static int unit_file_load_or_readlink(
         return 0;
 }
 
+static bool install_context_may_have_path(const InstallContext *c, const char *path) {
+        assert(path);
+
+        /* Checks whether the path might exist, without accessing the file system if we have a cache */
+
+        return !c || !c->unit_path_cache || set_contains(c->unit_path_cache, path);
+}
+
 static int unit_file_search(
                 InstallContext *c,
                 UnitFileInstallInfo *info,
@@ -1427,6 +1468,11 @@ static int unit_file_search(
                 if (!path)
                         return -ENOMEM;
 
+                /* Symlinks in the configuration directories might have been created by the operation
+                 * itself, hence don't trust the cache for those. */
+                if (!path_is_config(paths, *p, false) && !install_context_may_have_path(c, path))
+                        continue;
+
                 r = unit_file_load_or_readlink(c, info, path, paths->root_dir, flags);
                 if (r >= 0) {
                         info->path = TAKE_PTR(path);
@@ -1450,6 +1496,9 @@ static int unit_file_search(
                         if (!path)
                                 return -ENOMEM;
 
+                        if (!path_is_config(paths, *p, false) && !install_context_may_have_path(c, path))
+                                continue;
+
                         r = unit_file_load_or_readlink(c, info, path, paths->root_dir, flags);
                         if (r >= 0) {
                                 info->path = TAKE_PTR(path);
@@ -1479,6 +1528,11 @@ static int unit_file_search(
                 if (!path)
                         return -ENOMEM;
 
+                if (!install_context_may_have_path(c, path)) {
+                        free(path);
+                        continue;
+                }
+
                 r = strv_consume(&dirs, path);
                 if (r < 0)
                         return r;
@@ -1493,6 +1547,11 @@ static int unit_file_search(
                         if (!path)
                                 return -ENOMEM;
 
+                        if (!install_context_may_have_path(c, path)) {
+                                free(path);
+                                continue;
+                        }
+
                         r = strv_consume(&dirs, path);
                         if (r < 0)
                                 return r;
@@ -1501,6 +1560,9 @@ static int unit_file_search(
 
         /* Load drop-in conf files */
 
+        if (strv_isempty(dirs))
+                return result;
+
         r = conf_files_list_strv(&files, ".conf", NULL, 0, (const char**) dirs);
         if (r < 0)
                 return log_debug_errno(r, "Failed to get list of conf files: %m");
@@ -2485,6 +2547,7 @@ int unit_file_enable(
 
         _cleanup_(lookup_paths_free) LookupPaths paths = {};
         _cleanup_(install_context_done) InstallContext c = {};
+        _cleanup_set_free_free_ Set *unit_path_cache = NULL;
         const char *config_path;
         UnitFileInstallInfo *i;
         char **f;
@@ -2501,6 +2564,10 @@ int unit_file_enable(
         if (!config_path)
                 return -ENXIO;
 
+        r = install_context_build_path_cache(&c, &paths, strv_length(files), &unit_path_cache);
+        if (r < 0)
+                return r;
+
         STRV_FOREACH(f, files) {
                 r = install_info_discover_and_check(scope, &c, &paths, *f, SEARCH_LOAD|SEARCH_FOLLOW_CONFIG_SYMLINKS,
                                                     &i, changes, n_changes);
@@ -2528,7 +2595,7 @@ int unit_file_disable(
 
         _cleanup_(lookup_paths_free) LookupPaths paths = {};
         _cleanup_(install_context_done) InstallContext c = {};
-        _cleanup_set_free_free_ Set *remove_symlinks_to = NULL;
+        _cleanup_set_free_free_ Set *remove_symlinks_to = NULL, *unit_path_cache = NULL;
         const char *config_path;
         char **i;
         int r;
@@ -2544,6 +2611,10 @@ int unit_file_disable(
         if (!config_path)
                 return -ENXIO;
 
+        r = install_context_build_path_cache(&c, &paths, strv_length(files), &unit_path_cache);
+        if (r < 0)
+                return r;
+
         STRV_FOREACH(i, files) {
                 if (!unit_name_is_valid(*i, UNIT_NAME_ANY))
                         return -EINVAL;
@@ -2657,13 +2728,16 @@ int unit_file_get_default(
         return 0;
 }
 
-int unit_file_lookup_state(
+static int unit_file_lookup_state_internal(
                 UnitFileScope scope,
                 const LookupPaths *paths,
+                Set *unit_path_cache,
                 const char *name,
                 UnitFileState *ret) {
 
-        _cleanup_(install_context_done) InstallContext c = {};
+        _cleanup_(install_context_done) InstallContext c = {
+                .unit_path_cache = unit_path_cache,
+        };
         UnitFileInstallInfo *i;
         UnitFileState state;
         int r;
@@ -2749,6 +2823,15 @@ int unit_file_lookup_state(
         return 0;
 }
 
+int unit_file_lookup_state(
+                UnitFileScope scope,
+                const LookupPaths *paths,
+                const char *name,
+                UnitFileState *ret) {
+
+        return unit_file_lookup_state_internal(scope, paths, NULL, name, ret);
+}
+
 int unit_file_get_state(
                 UnitFileScope scope,
                 const char *root_dir,
@@ -3092,7 +3175,9 @@ static int preset_prepare_one(
                 UnitFileChange **changes,
                 size_t *n_changes) {
 
-        _cleanup_(install_context_done) InstallContext tmp = {};
+        _cleanup_(install_context_done) InstallContext tmp = {
+                .unit_path_cache = plus->unit_path_cache,
+        };
         _cleanup_strv_free_ char **instance_name_list = NULL;
         UnitFileInstallInfo *i;
         int r;
@@ -3148,6 +3233,7 @@ int unit_file_preset(
         _cleanup_(install_context_done) InstallContext plus = {}, minus = {};
         _cleanup_(lookup_paths_free) LookupPaths paths = {};
         _cleanup_(presets_freep) Presets presets = {};
+        _cleanup_set_free_free_ Set *unit_path_cache = NULL;
         const char *config_path;
         char **i;
         int r;
@@ -3168,6 +3254,11 @@ int unit_file_preset(
         if (r < 0)
                 return r;
 
+        r = install_context_build_path_cache(&plus, &paths, strv_length(files), &unit_path_cache);
+        if (r < 0)
+                return r;
+        minus.unit_path_cache = unit_path_cache;
+
         STRV_FOREACH(i, files) {
                 r = preset_prepare_one(scope, &plus, &minus, &paths, *i, presets, changes, n_changes);
                 if (r < 0)
@@ -3188,6 +3279,7 @@ int unit_file_preset_all(
         _cleanup_(install_context_done) InstallContext plus = {}, minus = {};
         _cleanup_(lookup_paths_free) LookupPaths paths = {};
         _cleanup_(presets_freep) Presets presets = {};
+        _cleanup_set_free_free_ Set *unit_path_cache = NULL;
         const char *config_path = NULL;
         char **i;
         int r;
@@ -3208,6 +3300,11 @@ int unit_file_preset_all(
         if (r < 0)
                 return r;
 
+        r = install_context_build_path_cache(&plus, &paths, SIZE_MAX, &unit_path_cache);
+        if (r < 0)
+                return r;
+        minus.unit_path_cache = unit_path_cache;
+
         STRV_FOREACH(i, paths.search_path) {
                 _cleanup_closedir_ DIR *d = NULL;
                 struct dirent *de;
@@ -3270,6 +3367,7 @@ int unit_file_get_list(
                 char **patterns) {
 
         _cleanup_(lookup_paths_free) LookupPaths paths = {};
+        _cleanup_set_free_free_ Set *unit_path_cache = NULL;
         char **i;
         int r;
 
@@ -3281,6 +3379,11 @@ int unit_file_get_list(
         if (r < 0)
                 return r;
 
+        /* All units are looked at anyway, hence read the search path only once */
+        r = unit_file_build_name_map(&paths, NULL, NULL, NULL, &unit_path_cache);
+        if (r < 0)
+                return r;
+
         STRV_FOREACH(i, paths.search_path) {
                 _cleanup_closedir_ DIR *d = NULL;
                 struct dirent *de;
@@ -3322,7 +3425,7 @@ int unit_file_get_list(
                         if (!f->path)
                                 return -ENOMEM;
 
-                        r = unit_file_lookup_state(scope, &paths, de->d_name, &f->state);
+                        r = unit_file_lookup_state_internal(scope, &paths, unit_path_cache, de->d_name, &f->state);
                         if (r < 0)
                                 f->state = UNIT_FILE_BAD;
 
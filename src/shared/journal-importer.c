@@ -3,6 +3,10 @@
 #include <errno.h>
 #include <unistd.h>
 
+#if HAVE_ZSTD
+#include <zstd.h>
+#endif
+
 #include "alloc-util.h"
 #include "errno-util.h"
 #include "escape.h"
@@ -32,6 +36,15 @@ void journal_importer_cleanup(JournalImporter *imp) {
         free(imp->name);
         free(imp->buf);
         iovw_free_contents(&imp->iovw, false);
+
+        for (size_t i = 0; i < imp->n_field_names; i++)
+                free(imp->field_names[i]);
+        free(imp->field_names);
+        free(imp->entry_buf);
+
+#if HAVE_ZSTD
+        ZSTD_freeDCtx(imp->dctx);
+#endif
 }
 
 static char* realloc_buffer(JournalImporter *imp, size_t size) {
@@ -41,7 +54,9 @@ static char* realloc_buffer(JournalImporter *imp, size_t size) {
         if (!b)
                 return NULL;
 
-        iovw_rebase(&imp->iovw, old, imp->buf);
+        /* With the binary framing the iovw points into the entry buffer instead */
+        if (!imp->binary)
+                iovw_rebase(&imp->iovw, old, imp->buf);
 
         return b;
 }
@@ -110,17 +125,18 @@ static int get_line(JournalImporter *imp, char **line, size_t *size) {
         return 1;
 }
 
-static int fill_fixed_size(JournalImporter *imp, void **data, size_t size) {
+static int fill_available(JournalImporter *imp, size_t size) {
+
+        /* Makes sure that at least size bytes following the offset are in the buffer, without consuming
+         * them. */
 
         assert(imp);
-        assert(IN_SET(imp->state, IMPORTER_STATE_DATA_START, IMPORTER_STATE_DATA, IMPORTER_STATE_DATA_FINISH));
-        assert(size <= DATA_SIZE_MAX);
+        assert(size <= ENTRY_SIZE_MAX);
         assert(imp->offset <= imp->filled);
         assert(imp->filled <= imp->size);
         assert(imp->buf || imp->size == 0);
         assert(!imp->buf || imp->size > 0);
         assert(imp->fd >= 0);
-        assert(data);
 
         while (imp->filled - imp->offset < size) {
                 int n;
@@ -145,6 +161,21 @@ static int fill_fixed_size(JournalImporter *imp, void **data, size_t size) {
                 imp->filled += n;
         }
 
+        return 1;
+}
+
+static int fill_fixed_size(JournalImporter *imp, void **data, size_t size) {
+        int r;
+
+        assert(imp);
+        assert(IN_SET(imp->state, IMPORTER_STATE_DATA_START, IMPORTER_STATE_DATA, IMPORTER_STATE_DATA_FINISH));
+        assert(size <= DATA_SIZE_MAX);
+        assert(data);
+
+        r = fill_available(imp, size);
+        if (r <= 0)
+                return r;
+
         *data = imp->buf + imp->offset;
         imp->offset += size;
 
@@ -280,9 +311,194 @@ static int process_special_field(JournalImporter *imp, char *line) {
         return 0;
 }
 
+static int get_varint(JournalImporter *imp, size_t *pos, uint64_t *ret) {
+        uint64_t v = 0;
+        unsigned i;
+        int r;
+
+        /* Reads a varint at *pos bytes after the offset, without consuming it */
+
+        for (i = 0; i < VARINT_SIZE_MAX; i++) {
+                uint8_t b;
+
+                r = fill_available(imp, *pos + 1);
+                if (r <= 0)
+                        return r;
+
+                b = imp->buf[imp->offset + (*pos)++];
+                v |= (uint64_t) (b & 0x7f) << (7 * i);
+                if (!(b & 0x80)) {
+                        *ret = v;
+                        return 1;
+                }
+        }
+
+        return log_error_errno(SYNTHETIC_ERRNO(EBADMSG), "Overlong varint in binary stream.");
+}
+
+static int get_binary_field(
+                JournalImporter *imp,
+                uint64_t *ret_ref,
+                const char **ret_name,
+                size_t *ret_name_len,
+                const char **ret_value,
+                size_t *ret_value_len) {
+
+        uint64_t ref, name_len = 0, value_len;
+        size_t pos = 0, name_pos = 0;
+        int r;
+
+        /* Reads a complete field, so that we never have to resume in the middle of one. If the data isn't
+         * all there yet, we'll simply parse the field again from the beginning next time. */
+
+        r = get_varint(imp, &pos, &ref);
+        if (r <= 0)
+                return r;
+
+        if (ref == JOURNAL_BINARY_FIELD_END) {
+                imp->offset += pos;
+                *ret_ref = ref;
+                return 1;
+        }
+
+        if (ref == JOURNAL_BINARY_FIELD_NEW) {
+                r = get_varint(imp, &pos, &name_len);
+                if (r <= 0)
+                        return r;
+                if (name_len == 0 || name_len > LINE_CHUNK)
+                        return log_error_errno(SYNTHETIC_ERRNO(EBADMSG),
+                                               "Stream declares field name with invalid size %"PRIu64, name_len);
+
+                name_pos = pos;
+                r = fill_available(imp, pos + name_len);
+                if (r <= 0)
+                        return r;
+
+                pos += name_len;
+
+        } else if (ref - JOURNAL_BINARY_FIELD_FIRST_REF >= imp->n_field_names)
+                return log_error_errno(SYNTHETIC_ERRNO(EBADMSG),
+                                       "Stream refers to unknown field name %"PRIu64, ref);
+
+        r = get_varint(imp, &pos, &value_len);
+        if (r <= 0)
+                return r;
+        if (value_len > DATA_SIZE_MAX)
+                return log_error_errno(SYNTHETIC_ERRNO(ENOBUFS),
+                                       "Stream declares field with size %"PRIu64" > DATA_SIZE_MAX = %u",
+                                       value_len, DATA_SIZE_MAX);
+
+        r = fill_available(imp, pos + value_len);
+        if (r <= 0)
+                return r;
+
+        *ret_ref = ref;
+        *ret_name = imp->buf + imp->offset + name_pos;
+        *ret_name_len = name_len;
+        *ret_value = imp->buf + imp->offset + pos;
+        *ret_value_len = value_len;
+
+        imp->offset += pos + value_len;
+
+        return 1;
+}
+
+static int process_binary_field(JournalImporter *imp) {
+        const char *name = NULL, *value = NULL;
+        size_t name_len = 0, value_len = 0, n;
+        char *field, *old;
+        uint64_t ref;
+        int r;
+
+        r = get_binary_field(imp, &ref, &name, &name_len, &value, &value_len);
+        if (r < 0)
+                return r;
+        if (r == 0) {
+                imp->state = IMPORTER_STATE_EOF;
+                return 0;
+        }
+
+        if (ref == JOURNAL_BINARY_FIELD_END) {
+                log_trace("Received end of binary entry, event is ready");
+                return 1;
+        }
+
+        if (ref == JOURNAL_BINARY_FIELD_NEW) {
+                bool valid;
+
+                valid = journal_field_valid(name, name_len, true);
+
+                /* Invalid names are added to the dictionary too, so that the references stay in sync with
+                 * the sender. Fields referring to them are ignored. */
+                if (imp->n_field_names < JOURNAL_BINARY_FIELD_NAMES_MAX) {
+                        char *s = NULL;
+
+                        if (valid) {
+                                s = strndup(name, name_len);
+                                if (!s)
+                                        return log_oom();
+                        }
+
+                        if (!GREEDY_REALLOC(imp->field_names, imp->field_names_allocated, imp->n_field_names + 1)) {
+                                free(s);
+                                return log_oom();
+                        }
+
+                        imp->field_names[imp->n_field_names++] = s;
+                }
+
+                if (!valid) {
+                        char buf[64], *t;
+
+                        t = strndupa(name, name_len);
+                        log_debug("Ignoring invalid field: \"%s\"", cellescape(buf, sizeof buf, t));
+                        return 0;
+                }
+        } else {
+                name = imp->field_names[ref - JOURNAL_BINARY_FIELD_FIRST_REF];
+                if (!name)
+                        return 0;
+
+                name_len = strlen(name);
+        }
+
+        /* The field is assembled as NAME=value, with a trailing NUL for process_special_field() */
+        n = name_len + 1 + value_len;
+        if (imp->entry_filled + n + 1 > ENTRY_SIZE_MAX)
+                return log_error_errno(SYNTHETIC_ERRNO(ENOBUFS),
+                                       "Entry is bigger than %u bytes.", ENTRY_SIZE_MAX);
+
+        old = imp->entry_buf;
+        if (!GREEDY_REALLOC(imp->entry_buf, imp->entry_size, imp->entry_filled + n + 1))
+                return log_oom();
+
+        iovw_rebase(&imp->iovw, old, imp->entry_buf);
+
+        field = imp->entry_buf + imp->entry_filled;
+        memcpy(mempcpy(mempcpy(field, name, name_len), "=", 1), value, value_len);
+        field[n] = '\0';
+
+        r = process_special_field(imp, field);
+        if (r != 0)
+                return r < 0 ? r : 0;
+
+        r = iovw_put(&imp->iovw, field, n);
+        if (r < 0)
+                return r;
+
+        imp->entry_filled += n + 1;
+
+        log_trace("Received: %.*s (binary framing)", (int) n, field);
+
+        return 0; /* continue */
+}
+
 int journal_importer_process_data(JournalImporter *imp) {
         int r;
 
+        if (imp->binary && imp->state != IMPORTER_STATE_EOF)
+                return process_binary_field(imp);
+
         switch(imp->state) {
         case IMPORTER_STATE_LINE: {
                 char *line, *sep;
@@ -413,10 +629,56 @@ int journal_importer_process_data(JournalImporter *imp) {
         }
 }
 
+#if HAVE_ZSTD
+static int push_compressed_data(JournalImporter *imp, const char *data, size_t size) {
+        ZSTD_inBuffer input = {
+                .src = data,
+                .size = size,
+        };
+
+        for (;;) {
+                ZSTD_outBuffer output;
+                size_t k;
+
+                /* A small amount of input may decompress to a lot of data, hence limit what we are
+                 * willing to keep around before it is processed. */
+                if (imp->filled - imp->offset > ENTRY_SIZE_MAX)
+                        return log_error_errno(SYNTHETIC_ERRNO(ENOBUFS),
+                                               "Decompressed data is bigger than %u bytes.",
+                                               ENTRY_SIZE_MAX);
+
+                if (!realloc_buffer(imp, imp->filled + ZSTD_DStreamOutSize()))
+                        return log_oom();
+
+                output = (ZSTD_outBuffer) {
+                        .dst = imp->buf + imp->filled,
+                        .size = imp->size - imp->filled,
+                };
+
+                k = ZSTD_decompressStream(imp->dctx, &output, &input);
+                if (ZSTD_isError(k))
+                        return log_error_errno(SYNTHETIC_ERRNO(EBADMSG),
+                                               "Failed to decompress received data: %s",
+                                               ZSTD_getErrorName(k));
+
+                imp->filled += output.pos;
+
+                /* If the output buffer was filled up, the decompressor might hold more data */
+                if (input.pos >= input.size && output.pos < output.size)
+                        return 0;
+        }
+}
+#endif
+
 int journal_importer_push_data(JournalImporter *imp, const char *data, size_t size) {
         assert(imp);
         assert(imp->state != IMPORTER_STATE_EOF);
 
+#if HAVE_ZSTD
+        if (imp->dctx)
+                return push_compressed_data(imp, data, size);
+#endif
+
         if (!realloc_buffer(imp, imp->filled + size))
                 return log_error_errno(SYNTHETIC_ERRNO(ENOMEM),
                                        "Failed to store received data of size %zu "
@@ -436,6 +698,7 @@ void journal_importer_drop_iovw(JournalImporter *imp) {
         /* This function drops processed data that along with the iovw that points at it */
 
         iovw_free_contents(&imp->iovw, false);
+        imp->entry_filled = 0;
 
         /* possibly reset buffer position */
         remain = imp->filled - imp->offset;
@@ -468,6 +731,41 @@ void journal_importer_drop_iovw(JournalImporter *imp) {
         }
 }
 
+int journal_importer_set_compressed(JournalImporter *imp) {
+        assert(imp);
+        assert(imp->passive_fd);
+
+#if HAVE_ZSTD
+        if (imp->dctx)
+                return 0;
+
+        imp->dctx = ZSTD_createDCtx();
+        if (!imp->dctx)
+                return -ENOMEM;
+
+        return 0;
+#else
+        return -EPROTONOSUPPORT;
+#endif
+}
+
+size_t journal_binary_put_varint(uint8_t *buf, uint64_t v) {
+        size_t n = 0;
+
+        assert(buf);
+
+        /* Little-endian base 128: seven bits per byte, the high bit is set on all but the last byte. Writes
+         * at most VARINT_SIZE_MAX bytes. */
+
+        while (v >= 0x80) {
+                buf[n++] = (uint8_t) v | 0x80;
+                v >>= 7;
+        }
+        buf[n++] = (uint8_t) v;
+
+        return n;
+}
+
 bool journal_importer_eof(const JournalImporter *imp) {
         return imp->state == IMPORTER_STATE_EOF;
 }
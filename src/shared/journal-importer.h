@@ -25,6 +25,18 @@
 /* The maximum number of fields in an entry */
 #define ENTRY_FIELD_COUNT_MAX 1024
 
+/* The compact binary framing of entries, see docs/JOURNAL_BINARY_UPLOAD_FORMAT.md. Each field starts with a
+ * varint, which either terminates the entry, introduces a new field name, or refers to a field name
+ * introduced earlier in the stream. */
+#define JOURNAL_BINARY_FIELD_END 0U
+#define JOURNAL_BINARY_FIELD_NEW 1U
+#define JOURNAL_BINARY_FIELD_FIRST_REF 2U
+/* No more names are added to the dictionary after this many, new names are then sent literally each time */
+#define JOURNAL_BINARY_FIELD_NAMES_MAX 4096U
+#define VARINT_SIZE_MAX 10U
+
+struct ZSTD_DCtx_s;
+
 typedef struct JournalImporter {
         int fd;
         bool passive_fd;
@@ -41,6 +53,14 @@ typedef struct JournalImporter {
 
         struct iovec_wrapper iovw;
 
+        bool binary;         /* the input uses the binary framing rather than the export format */
+        char **field_names;  /* the field names of the binary framing seen so far */
+        size_t n_field_names, field_names_allocated;
+        char *entry_buf;     /* the assembled NAME=value fields of the binary framing */
+        size_t entry_size, entry_filled;
+
+        struct ZSTD_DCtx_s *dctx; /* for pushed data that is zstd compressed */
+
         int state;
         dual_timestamp ts;
         sd_id128_t boot_id;
@@ -52,9 +72,12 @@ typedef struct JournalImporter {
 void journal_importer_cleanup(JournalImporter *);
 int journal_importer_process_data(JournalImporter *);
 int journal_importer_push_data(JournalImporter *, const char *data, size_t size);
+int journal_importer_set_compressed(JournalImporter *);
 void journal_importer_drop_iovw(JournalImporter *);
 bool journal_importer_eof(const JournalImporter *);
 
+size_t journal_binary_put_varint(uint8_t *buf, uint64_t v);
+
 static inline size_t journal_importer_bytes_remaining(const JournalImporter *imp) {
         return imp->filled;
 }
@@ -23,6 +23,7 @@
 #include "string-util.h"
 #include "strv.h"
 #include "terminal-util.h"
+#include "unaligned.h"
 #include "user-util.h"
 #include "utf8.h"
 
@@ -1745,6 +1746,162 @@ int json_variant_format(JsonVariant *v, JsonFormatFlags flags, char **ret) {
         return (int) sz - 1;
 }
 
+/* A compact binary encoding of JSON variants, for local peers that both know it. It follows CBOR (RFC 8949)
+ * in the subset of it needed to express JSON: unsigned and negative integers, text strings, arrays, maps,
+ * booleans, null and doubles. Only definite lengths are used. Note that reals are transferred as doubles,
+ * i.e. with less precision than the long doubles we keep them in. */
+
+enum {
+        JSON_BINARY_UNSIGNED = 0,
+        JSON_BINARY_NEGATIVE = 1,
+        JSON_BINARY_STRING   = 3,
+        JSON_BINARY_ARRAY    = 4,
+        JSON_BINARY_OBJECT   = 5,
+        JSON_BINARY_SIMPLE   = 7,
+};
+
+#define JSON_BINARY_FALSE  UINT8_C(0xf4)
+#define JSON_BINARY_TRUE   UINT8_C(0xf5)
+#define JSON_BINARY_NULL   UINT8_C(0xf6)
+#define JSON_BINARY_DOUBLE UINT8_C(0xfb)
+
+typedef struct JsonBinaryBuffer {
+        uint8_t *data;
+        size_t size, allocated;
+} JsonBinaryBuffer;
+
+static int json_binary_append(JsonBinaryBuffer *b, const void *p, size_t n) {
+        assert(b);
+
+        if (!GREEDY_REALLOC(b->data, b->allocated, b->size + n))
+                return -ENOMEM;
+
+        memcpy_safe(b->data + b->size, p, n);
+        b->size += n;
+        return 0;
+}
+
+static int json_binary_append_head(JsonBinaryBuffer *b, uint8_t major, uint64_t x) {
+        uint8_t h[9];
+        size_t n;
+
+        if (x < 24) {
+                h[0] = major << 5 | x;
+                n = 1;
+        } else if (x <= UINT8_MAX) {
+                h[0] = major << 5 | 24;
+                h[1] = x;
+                n = 2;
+        } else if (x <= UINT16_MAX) {
+                h[0] = major << 5 | 25;
+                unaligned_write_be16(h + 1, x);
+                n = 3;
+        } else if (x <= UINT32_MAX) {
+                h[0] = major << 5 | 26;
+                unaligned_write_be32(h + 1, x);
+                n = 5;
+        } else {
+                h[0] = major << 5 | 27;
+                unaligned_write_be64(h + 1, x);
+                n = 9;
+        }
+
+        return json_binary_append(b, h, n);
+}
+
+static int json_binary_append_variant(JsonBinaryBuffer *b, JsonVariant *v) {
+        size_t i, n;
+        int r;
+
+        switch (json_variant_type(v)) {
+
+        case JSON_VARIANT_STRING: {
+                const char *s;
+
+                s = json_variant_string(v);
+                n = strlen(s);
+
+                r = json_binary_append_head(b, JSON_BINARY_STRING, n);
+                if (r < 0)
+                        return r;
+
+                return json_binary_append(b, s, n);
+        }
+
+        case JSON_VARIANT_INTEGER: {
+                intmax_t i = json_variant_integer(v);
+
+                if (i >= 0)
+                        return json_binary_append_head(b, JSON_BINARY_UNSIGNED, (uint64_t) i);
+
+                return json_binary_append_head(b, JSON_BINARY_NEGATIVE, (uint64_t) (-1 - i));
+        }
+
+        case JSON_VARIANT_UNSIGNED:
+                return json_binary_append_head(b, JSON_BINARY_UNSIGNED, json_variant_unsigned(v));
+
+        case JSON_VARIANT_REAL: {
+                union {
+                        double d;
+                        uint64_t u;
+                } x = {
+                        .d = (double) json_variant_real(v),
+                };
+                uint8_t h[9] = { JSON_BINARY_DOUBLE };
+
+                unaligned_write_be64(h + 1, x.u);
+                return json_binary_append(b, h, sizeof(h));
+        }
+
+        case JSON_VARIANT_BOOLEAN:
+                return json_binary_append(b, json_variant_boolean(v) ? &(const uint8_t) { JSON_BINARY_TRUE } : &(const uint8_t) { JSON_BINARY_FALSE }, 1);
+
+        case JSON_VARIANT_NULL:
+                return json_binary_append(b, &(const uint8_t) { JSON_BINARY_NULL }, 1);
+
+        case JSON_VARIANT_ARRAY:
+        case JSON_VARIANT_OBJECT:
+                n = json_variant_elements(v);
+
+                if (json_variant_is_array(v))
+                        r = json_binary_append_head(b, JSON_BINARY_ARRAY, n);
+                else
+                        r = json_binary_append_head(b, JSON_BINARY_OBJECT, n / 2);
+                if (r < 0)
+                        return r;
+
+                for (i = 0; i < n; i++) {
+                        r = json_binary_append_variant(b, json_variant_by_index(v, i));
+                        if (r < 0)
+                                return r;
+                }
+
+                return 0;
+
+        default:
+                assert_not_reached("Unexpected variant type.");
+        }
+}
+
+int json_variant_format_binary(JsonVariant *v, void **ret, size_t *ret_size) {
+        _cleanup_free_ uint8_t *data = NULL;
+        JsonBinaryBuffer b = {};
+        int r;
+
+        assert_return(v, -EINVAL);
+        assert_return(ret, -EINVAL);
+        assert_return(ret_size, -EINVAL);
+
+        r = json_binary_append_variant(&b, v);
+        data = b.data;
+        if (r < 0)
+                return r;
+
+        *ret = TAKE_PTR(data);
+        *ret_size = b.size;
+        return 0;
+}
+
 void json_variant_dump(JsonVariant *v, JsonFormatFlags flags, FILE *f, const char *prefix) {
         if (!v)
                 return;
@@ -2329,7 +2486,7 @@ static int unhex_ucs2(const char *c, uint16_t *ret) {
         return 0;
 }
 
-static int json_parse_string(const char **p, char **ret) {
+static int json_parse_string(const char **p, char **ret, const char **ret_view, size_t *ret_view_size) {
         _cleanup_free_ char *s = NULL;
         size_t n = 0, allocated = 0;
         const char *c;
@@ -2345,6 +2502,24 @@ static int json_parse_string(const char **p, char **ret) {
 
         c++;
 
+        if (ret_view) {
+                const char *e;
+
+                /* If the caller can take it, return strings without escapes and non-ASCII characters, i.e.
+                 * the vast majority, as a view into the input, instead of copying them */
+
+                for (e = c; *e >= ' ' && *e < 0x7f && !IN_SET(*e, '"', '\\'); e++)
+                        ;
+
+                if (*e == '"') {
+                        *ret = NULL;
+                        *ret_view = c;
+                        *ret_view_size = e - c;
+                        *p = e + 1;
+                        return JSON_TOKEN_STRING;
+                }
+        }
+
         for (;;) {
                 int len;
 
@@ -2558,9 +2733,11 @@ static int json_parse_number(const char **p, JsonValue *ret) {
         }
 }
 
-int json_tokenize(
+static int json_tokenize_internal(
                 const char **p,
                 char **ret_string,
+                const char **ret_view, /* if non-NULL, strings may be returned here instead of in ret_string */
+                size_t *ret_view_size,
                 JsonValue *ret_value,
                 unsigned *ret_line,   /* 'ret_line' returns the line at the beginning of this token */
                 unsigned *ret_column,
@@ -2643,7 +2820,7 @@ int json_tokenize(
 
                 } else if (*c == '"') {
 
-                        r = json_parse_string(&c, ret_string);
+                        r = json_parse_string(&c, ret_string, ret_view, ret_view_size);
                         if (r < 0)
                                 return r;
 
@@ -2736,6 +2913,19 @@ finish:
         return r;
 }
 
+int json_tokenize(
+                const char **p,
+                char **ret_string,
+                JsonValue *ret_value,
+                unsigned *ret_line,
+                unsigned *ret_column,
+                void **state,
+                unsigned *line,
+                unsigned *column) {
+
+        return json_tokenize_internal(p, ret_string, NULL, NULL, ret_value, ret_line, ret_column, state, line, column);
+}
+
 typedef enum JsonExpect {
         /* The following values are used by json_parse() */
         EXPECT_TOPLEVEL,
@@ -2807,6 +2997,8 @@ static int json_parse_internal(
                 _cleanup_(json_variant_unrefp) JsonVariant *add = NULL;
                 _cleanup_free_ char *string = NULL;
                 unsigned line_token, column_token;
+                const char *view = NULL;
+                size_t view_size = 0;
                 JsonStack *current;
                 JsonValue value;
                 int token;
@@ -2817,7 +3009,7 @@ static int json_parse_internal(
                 if (continue_end && current->expect == EXPECT_END)
                         goto done;
 
-                token = json_tokenize(&p, &string, &value, &line_token, &column_token, &tokenizer_state, line, column);
+                token = json_tokenize_internal(&p, &string, &view, &view_size, &value, &line_token, &column_token, &tokenizer_state, line, column);
                 if (token < 0) {
                         r = token;
                         goto finish;
@@ -2965,7 +3157,10 @@ static int json_parse_internal(
                                 goto finish;
                         }
 
-                        r = json_variant_new_string(&add, string);
+                        if (string)
+                                r = json_variant_new_string(&add, string);
+                        else
+                                r = json_variant_new_stringn(&add, view, view_size);
                         if (r < 0)
                                 goto finish;
 
@@ -3098,7 +3293,11 @@ static int json_parse_internal(
                         if (FLAGS_SET(flags, JSON_PARSE_SENSITIVE))
                                 json_variant_sensitive(add);
 
-                        (void) json_variant_set_source(&add, source, line_token, column_token);
+                        /* Positions are only ever shown together with the source, don't bother otherwise.
+                         * This matters, as null, booleans, zeros and empty strings would need surrogate
+                         * objects to carry them. */
+                        if (source)
+                                (void) json_variant_set_source(&add, source, line_token, column_token);
 
                         if (!GREEDY_REALLOC(current->elements, current->n_elements_allocated, current->n_elements + 1)) {
                                 r = -ENOMEM;
@@ -3159,6 +3358,198 @@ int json_parse_file_at(FILE *f, int dir_fd, const char *path, JsonParseFlags fla
         return json_parse_internal(&p, source, flags, ret, ret_line, ret_column, false);
 }
 
+static int json_binary_read_head(const uint8_t **p, const uint8_t *e, uint8_t *ret_major, uint8_t *ret_info, uint64_t *ret_x) {
+        const uint8_t *q = *p;
+        uint8_t info;
+        uint64_t x;
+
+        if (q >= e)
+                return -EBADMSG;
+
+        info = *q & 31;
+        *ret_major = *q >> 5;
+        *ret_info = info;
+        q++;
+
+        if (info < 24)
+                x = info;
+        else if (info == 24) {
+                if (e - q < 1)
+                        return -EBADMSG;
+                x = *q;
+                q += 1;
+        } else if (info == 25) {
+                if (e - q < 2)
+                        return -EBADMSG;
+                x = unaligned_read_be16(q);
+                q += 2;
+        } else if (info == 26) {
+                if (e - q < 4)
+                        return -EBADMSG;
+                x = unaligned_read_be32(q);
+                q += 4;
+        } else if (info == 27) {
+                if (e - q < 8)
+                        return -EBADMSG;
+                x = unaligned_read_be64(q);
+                q += 8;
+        } else
+                return -EBADMSG; /* Indefinite lengths and reserved values are not supported */
+
+        *ret_x = x;
+        *p = q;
+        return 0;
+}
+
+static int json_binary_read_variant(const uint8_t **p, const uint8_t *e, unsigned depth, JsonVariant **ret) {
+        uint8_t major, info;
+        uint64_t x;
+        int r;
+
+        assert(p);
+        assert(e);
+        assert(ret);
+
+        if (depth >= DEPTH_MAX)
+                return -ELNRNG;
+
+        r = json_binary_read_head(p, e, &major, &info, &x);
+        if (r < 0)
+                return r;
+
+        switch (major) {
+
+        case JSON_BINARY_UNSIGNED:
+                /* Like the text parser, prefer signed integers where they suffice */
+                if (x <= INTMAX_MAX)
+                        return json_variant_new_integer(ret, (intmax_t) x);
+
+                return json_variant_new_unsigned(ret, x);
+
+        case JSON_BINARY_NEGATIVE:
+                if (x > INTMAX_MAX)
+                        return -ERANGE;
+
+                return json_variant_new_integer(ret, -1 - (intmax_t) x);
+
+        case JSON_BINARY_STRING: {
+                _cleanup_(json_variant_unrefp) JsonVariant *v = NULL;
+
+                if (x > (uint64_t) (e - *p))
+                        return -EBADMSG;
+                if (memchr(*p, 0, x))
+                        return -EBADMSG;
+
+                r = json_variant_new_stringn(&v, (const char*) *p, x);
+                if (r < 0)
+                        return r;
+
+                if (!utf8_is_valid(json_variant_string(v)))
+                        return -EUCLEAN;
+
+                *p += x;
+                *ret = TAKE_PTR(v);
+                return 0;
+        }
+
+        case JSON_BINARY_ARRAY:
+        case JSON_BINARY_OBJECT: {
+                JsonVariant **elements = NULL;
+                size_t i, n;
+
+                if (major == JSON_BINARY_OBJECT) {
+                        if (x > (uint64_t) (e - *p) / 2)
+                                return -EBADMSG;
+                        n = x * 2;
+                } else {
+                        /* Every element takes at least one byte, which bounds the allocation below */
+                        if (x > (uint64_t) (e - *p))
+                                return -EBADMSG;
+                        n = x;
+                }
+
+                if (n > 0) {
+                        elements = new0(JsonVariant*, n);
+                        if (!elements)
+                                return -ENOMEM;
+                }
+
+                for (i = 0; i < n; i++) {
+                        r = json_binary_read_variant(p, e, depth + 1, elements + i);
+                        if (r < 0)
+                                goto finish;
+
+                        if (major == JSON_BINARY_OBJECT && i % 2 == 0 && !json_variant_is_string(elements[i])) {
+                                r = -EBADMSG;
+                                goto finish;
+                        }
+                }
+
+                if (major == JSON_BINARY_OBJECT)
+                        r = json_variant_new_object(ret, elements, n);
+                else
+                        r = json_variant_new_array(ret, elements, n);
+
+        finish:
+                json_variant_unref_many(elements, n);
+                free(elements);
+                return r;
+        }
+
+        case JSON_BINARY_SIMPLE:
+                if (info == 20)
+                        return json_variant_new_boolean(ret, false);
+                if (info == 21)
+                        return json_variant_new_boolean(ret, true);
+                if (info == 22)
+                        return json_variant_new_null(ret);
+                if (info == 26) {
+                        union {
+                                float f;
+                                uint32_t u;
+                        } y = {
+                                .u = x,
+                        };
+
+                        return json_variant_new_real(ret, y.f);
+                }
+                if (info == 27) {
+                        union {
+                                double d;
+                                uint64_t u;
+                        } y = {
+                                .u = x,
+                        };
+
+                        return json_variant_new_real(ret, y.d);
+                }
+
+                return -EBADMSG;
+
+        default:
+                return -EBADMSG;
+        }
+}
+
+int json_parse_binary(const void *data, size_t size, JsonVariant **ret) {
+        _cleanup_(json_variant_unrefp) JsonVariant *v = NULL;
+        const uint8_t *p = data;
+        int r;
+
+        assert_return(data || size == 0, -EINVAL);
+        assert_return(ret, -EINVAL);
+
+        r = json_binary_read_variant(&p, p + size, 0, &v);
+        if (r < 0)
+                return r;
+
+        if (p != (const uint8_t*) data + size) /* Trailing garbage */
+                return -EBADMSG;
+
+        *ret = TAKE_PTR(v);
+        return 0;
+}
+
 int json_buildv(JsonVariant **ret, va_list ap) {
         JsonStack *stack = NULL;
         size_t n_stack = 1, n_stack_allocated = 0, i;
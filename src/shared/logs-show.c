@@ -24,6 +24,7 @@
 #include "log.h"
 #include "logs-show.h"
 #include "macro.h"
+#include "memory-util.h"
 #include "namespace-util.h"
 #include "output-mode.h"
 #include "parse-util.h"
@@ -93,31 +94,58 @@ static int parse_field(const void *data, size_t length, const char *field, size_
         return 1;
 }
 
+/* The targets of a ParseFieldVec point directly into the data returned by sd_journal_enumerate_data_stable(),
+ * i.e. they are not NUL terminated, and only valid until the read pointer is moved to another entry. */
 typedef struct ParseFieldVec {
         const char *field;
         size_t field_len;
-        char **target;
+        const char **target;
         size_t *target_len;
 } ParseFieldVec;
 
 #define PARSE_FIELD_VEC_ENTRY(_field, _target, _target_len) \
-        { .field = _field, .field_len = strlen(_field), .target = _target, .target_len = _target_len }
+        { .field = _field, .field_len = STRLEN(_field), .target = _target, .target_len = _target_len }
 
-static int parse_fieldv(const void *data, size_t length, const ParseFieldVec *fields, unsigned n_fields) {
-        unsigned i;
+static void parse_fieldv(const void *data, size_t length, const ParseFieldVec *fields, size_t n_fields) {
+        size_t i;
 
         for (i = 0; i < n_fields; i++) {
                 const ParseFieldVec *f = &fields[i];
-                int r;
 
-                r = parse_field(data, length, f->field, f->field_len, f->target, f->target_len);
-                if (r < 0)
-                        return r;
-                else if (r > 0)
-                        break;
+                if (length < f->field_len || memcmp(data, f->field, f->field_len) != 0)
+                        continue;
+
+                *f->target = (const char*) data + f->field_len;
+                *f->target_len = length - f->field_len;
+                break;
         }
+}
 
-        return 0;
+static int parse_fieldv_all(sd_journal *j, const ParseFieldVec *fields, size_t n_fields) {
+        const void *data;
+        size_t length;
+        int r;
+
+        assert(j);
+
+        /* Extracts the specified fields of the current entry, without copying them */
+
+        JOURNAL_FOREACH_DATA_STABLE_RETVAL(j, data, length, r)
+                parse_fieldv(data, length, fields, n_fields);
+
+        return r;
+}
+
+static int safe_atou64_field(const char *p, size_t l, uint64_t *ret) {
+        char buf[DECIMAL_STR_MAX(uint64_t)];
+
+        if (!p || l >= sizeof(buf))
+                return -EINVAL;
+
+        memcpy(buf, p, l);
+        buf[l] = 0;
+
+        return safe_atou64(buf, ret);
 }
 
 static int field_set_test(Set *fields, const char *name, size_t n) {
@@ -257,7 +285,7 @@ static bool print_multiline(
         return ellipsized;
 }
 
-static int output_timestamp_monotonic(FILE *f, sd_journal *j, const char *monotonic) {
+static int output_timestamp_monotonic(FILE *f, sd_journal *j, const char *monotonic, size_t monotonic_len) {
         sd_id128_t boot_id;
         uint64_t t;
         int r;
@@ -265,9 +293,7 @@ static int output_timestamp_monotonic(FILE *f, sd_journal *j, const char *monoto
         assert(f);
         assert(j);
 
-        r = -ENXIO;
-        if (monotonic)
-                r = safe_atou64(monotonic, &t);
+        r = safe_atou64_field(monotonic, monotonic_len, &t);
         if (r < 0)
                 r = sd_journal_get_monotonic_usec(j, &t, &boot_id);
         if (r < 0)
@@ -277,85 +303,133 @@ static int output_timestamp_monotonic(FILE *f, sd_journal *j, const char *monoto
         return 1 + 5 + 1 + 6 + 1;
 }
 
-static int output_timestamp_realtime(FILE *f, sd_journal *j, OutputMode mode, OutputFlags flags, const char *realtime) {
-        char buf[MAX(FORMAT_TIMESTAMP_MAX, 64)];
+static int format_timestamp_seconds(char *buf, size_t l, OutputMode mode, OutputFlags flags, usec_t x) {
         struct tm *(*gettime_r)(const time_t *, struct tm *);
         struct tm tm;
-        uint64_t x;
         time_t t;
-        int r;
 
-        assert(f);
-        assert(j);
+        assert(buf);
 
-        if (realtime)
-                r = safe_atou64(realtime, &x);
-        if (!realtime || r < 0 || !VALID_REALTIME(x))
-                r = sd_journal_get_realtime_usec(j, &x);
-        if (r < 0)
-                return log_error_errno(r, "Failed to get realtime timestamp: %m");
+        /* Formats the part of the timestamp that only depends on the second, the precise modes fill in the
+         * microseconds later on. */
 
         if (IN_SET(mode, OUTPUT_SHORT_FULL, OUTPUT_WITH_UNIT)) {
                 const char *k;
 
                 if (flags & OUTPUT_UTC)
-                        k = format_timestamp_utc(buf, sizeof(buf), x);
+                        k = format_timestamp_utc(buf, l, x);
                 else
-                        k = format_timestamp(buf, sizeof(buf), x);
+                        k = format_timestamp(buf, l, x);
                 if (!k)
                         return log_error_errno(SYNTHETIC_ERRNO(EINVAL),
                                                "Failed to format timestamp: %" PRIu64, x);
 
-        } else {
-                char usec[7];
+                return 0;
+        }
 
-                gettime_r = (flags & OUTPUT_UTC) ? gmtime_r : localtime_r;
-                t = (time_t) (x / USEC_PER_SEC);
+        gettime_r = (flags & OUTPUT_UTC) ? gmtime_r : localtime_r;
+        t = (time_t) (x / USEC_PER_SEC);
 
-                switch (mode) {
+        switch (mode) {
 
-                case OUTPUT_SHORT_UNIX:
-                        xsprintf(buf, "%10"PRI_TIME".%06"PRIu64, t, x % USEC_PER_SEC);
-                        break;
+        case OUTPUT_SHORT_ISO:
+                if (strftime(buf, l, "%Y-%m-%dT%H:%M:%S%z", gettime_r(&t, &tm)) <= 0)
+                        return log_error_errno(SYNTHETIC_ERRNO(EINVAL),
+                                               "Failed to format ISO time");
+                break;
 
-                case OUTPUT_SHORT_ISO:
-                        if (strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S%z", gettime_r(&t, &tm)) <= 0)
-                                return log_error_errno(SYNTHETIC_ERRNO(EINVAL),
-                                                       "Failed to format ISO time");
-                        break;
+        case OUTPUT_SHORT_ISO_PRECISE:
+                /* No usec in strftime, so we leave space and copy over */
+                if (strftime(buf, l, "%Y-%m-%dT%H:%M:%S.xxxxxx%z", gettime_r(&t, &tm)) <= 0)
+                        return log_error_errno(SYNTHETIC_ERRNO(EINVAL),
+                                               "Failed to format ISO-precise time");
+                break;
 
-                case OUTPUT_SHORT_ISO_PRECISE:
-                        /* No usec in strftime, so we leave space and copy over */
-                        if (strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S.xxxxxx%z", gettime_r(&t, &tm)) <= 0)
-                                return log_error_errno(SYNTHETIC_ERRNO(EINVAL),
-                                                       "Failed to format ISO-precise time");
-                        xsprintf(usec, "%06"PRI_USEC, x % USEC_PER_SEC);
-                        memcpy(buf + 20, usec, 6);
-                        break;
+        case OUTPUT_SHORT:
+        case OUTPUT_SHORT_PRECISE:
+                if (strftime(buf, l, "%b %d %H:%M:%S", gettime_r(&t, &tm)) <= 0)
+                        return log_error_errno(SYNTHETIC_ERRNO(EINVAL),
+                                               "Failed to format syslog time");
+                break;
+
+        default:
+                assert_not_reached("Unknown time format");
+        }
+
+        return 0;
+}
+
+static int output_timestamp_realtime(
+                FILE *f,
+                sd_journal *j,
+                OutputMode mode,
+                OutputFlags flags,
+                const char *realtime,
+                size_t realtime_len) {
+
+        /* Converting to broken-down time and formatting it is the most expensive part of the short output
+         * modes, but consecutive entries are usually logged within the same second. Hence remember the last
+         * second we formatted. */
+        static thread_local struct {
+                OutputMode mode;
+                bool utc;
+                time_t t;
+                char buf[CONST_MAX(FORMAT_TIMESTAMP_MAX, 64)];
+        } cache = {
+                .mode = _OUTPUT_MODE_INVALID,
+        };
 
-                case OUTPUT_SHORT:
-                case OUTPUT_SHORT_PRECISE:
+        char buf[CONST_MAX(FORMAT_TIMESTAMP_MAX, 64)];
+        bool utc = flags & OUTPUT_UTC;
+        uint64_t x;
+        time_t t;
+        int r;
 
-                        if (strftime(buf, sizeof(buf), "%b %d %H:%M:%S", gettime_r(&t, &tm)) <= 0)
-                                return log_error_errno(SYNTHETIC_ERRNO(EINVAL),
-                                                       "Failed to format syslog time");
+        assert(f);
+        assert(j);
 
-                        if (mode == OUTPUT_SHORT_PRECISE) {
-                                size_t k;
+        r = safe_atou64_field(realtime, realtime_len, &x);
+        if (r < 0 || !VALID_REALTIME(x))
+                r = sd_journal_get_realtime_usec(j, &x);
+        if (r < 0)
+                return log_error_errno(r, "Failed to get realtime timestamp: %m");
 
-                                assert(sizeof(buf) > strlen(buf));
-                                k = sizeof(buf) - strlen(buf);
+        t = (time_t) (x / USEC_PER_SEC);
 
-                                r = snprintf(buf + strlen(buf), k, ".%06"PRIu64, x % USEC_PER_SEC);
-                                if (r <= 0 || (size_t) r >= k) /* too long? */
-                                        return log_error_errno(SYNTHETIC_ERRNO(EINVAL),
-                                                               "Failed to format precise time");
+        if (mode == OUTPUT_SHORT_UNIX)
+                xsprintf(buf, "%10"PRI_TIME".%06"PRIu64, t, x % USEC_PER_SEC);
+        else {
+                if (cache.mode != mode || cache.utc != utc || cache.t != t) {
+                        r = format_timestamp_seconds(cache.buf, sizeof(cache.buf), mode, flags, x);
+                        if (r < 0) {
+                                cache.mode = _OUTPUT_MODE_INVALID;
+                                return r;
                         }
-                        break;
 
-                default:
-                        assert_not_reached("Unknown time format");
+                        cache.mode = mode;
+                        cache.utc = utc;
+                        cache.t = t;
                 }
+
+                strcpy(buf, cache.buf);
+        }
+
+        if (mode == OUTPUT_SHORT_ISO_PRECISE) {
+                char usec[7];
+
+                xsprintf(usec, "%06"PRI_USEC, x % USEC_PER_SEC);
+                memcpy(buf + 20, usec, 6);
+
+        } else if (mode == OUTPUT_SHORT_PRECISE) {
+                size_t k;
+
+                assert(sizeof(buf) > strlen(buf));
+                k = sizeof(buf) - strlen(buf);
+
+                r = snprintf(buf + strlen(buf), k, ".%06"PRIu64, x % USEC_PER_SEC);
+                if (r <= 0 || (size_t) r >= k) /* too long? */
+                        return log_error_errno(SYNTHETIC_ERRNO(EINVAL),
+                                               "Failed to format precise time");
         }
 
         fputs(buf, f);
@@ -372,17 +446,17 @@ static int output_short(
                 const size_t highlight[2]) {
 
         int r;
-        const void *data;
-        size_t length;
         size_t n = 0;
-        _cleanup_free_ char *hostname = NULL, *identifier = NULL, *comm = NULL, *pid = NULL, *fake_pid = NULL, *message = NULL, *realtime = NULL, *monotonic = NULL, *priority = NULL, *transport = NULL, *config_file = NULL, *unit = NULL, *user_unit = NULL;
+        const char *hostname = NULL, *identifier = NULL, *comm = NULL, *pid = NULL, *fake_pid = NULL, *realtime = NULL, *monotonic = NULL, *priority = NULL, *transport = NULL, *config_file = NULL, *unit = NULL, *user_unit = NULL;
+        _cleanup_free_ char *message = NULL;
+        const char *m = NULL;
         size_t hostname_len = 0, identifier_len = 0, comm_len = 0, pid_len = 0, fake_pid_len = 0, message_len = 0, realtime_len = 0, monotonic_len = 0, priority_len = 0, transport_len = 0, config_file_len = 0, unit_len = 0, user_unit_len = 0;
         int p = LOG_INFO;
         bool ellipsized = false, audit;
         const ParseFieldVec fields[] = {
                 PARSE_FIELD_VEC_ENTRY("_PID=", &pid, &pid_len),
                 PARSE_FIELD_VEC_ENTRY("_COMM=", &comm, &comm_len),
-                PARSE_FIELD_VEC_ENTRY("MESSAGE=", &message, &message_len),
+                PARSE_FIELD_VEC_ENTRY("MESSAGE=", &m, &message_len),
                 PARSE_FIELD_VEC_ENTRY("PRIORITY=", &priority, &priority_len),
                 PARSE_FIELD_VEC_ENTRY("_TRANSPORT=", &transport, &transport_len),
                 PARSE_FIELD_VEC_ENTRY("_HOSTNAME=", &hostname, &hostname_len),
@@ -407,11 +481,7 @@ static int output_short(
          */
         sd_journal_set_data_threshold(j, flags & (OUTPUT_SHOW_ALL|OUTPUT_FULL_WIDTH) ? 0 : PRINT_CHAR_THRESHOLD + 1);
 
-        JOURNAL_FOREACH_DATA_RETVAL(j, data, length, r) {
-                r = parse_fieldv(data, length, fields, ELEMENTSOF(fields));
-                if (r < 0)
-                        return r;
-        }
+        r = parse_fieldv_all(j, fields, ELEMENTSOF(fields));
         if (r == -EBADMSG) {
                 log_debug_errno(r, "Skipping message we can't read: %m");
                 return 0;
@@ -419,30 +489,35 @@ static int output_short(
         if (r < 0)
                 return log_error_errno(r, "Failed to get journal fields: %m");
 
-        if (!message) {
+        if (!m) {
                 log_debug("Skipping message without MESSAGE= field.");
                 return 0;
         }
 
+        /* The message is the only field that is modified before printing it, hence copy it */
+        message = newdup_suffix0(char, m, message_len);
+        if (!message)
+                return log_oom();
+
         if (!(flags & OUTPUT_SHOW_ALL))
                 strip_tab_ansi(&message, &message_len, highlight_shifted);
 
         if (priority_len == 1 && *priority >= '0' && *priority <= '7')
                 p = *priority - '0';
 
-        audit = streq_ptr(transport, "audit");
+        audit = transport && memcmp_nn(transport, transport_len, "audit", STRLEN("audit")) == 0;
 
         if (mode == OUTPUT_SHORT_MONOTONIC)
-                r = output_timestamp_monotonic(f, j, monotonic);
+                r = output_timestamp_monotonic(f, j, monotonic, monotonic_len);
         else
-                r = output_timestamp_realtime(f, j, mode, flags, realtime);
+                r = output_timestamp_realtime(f, j, mode, flags, realtime, realtime_len);
         if (r < 0)
                 return r;
         n += r;
 
         if (flags & OUTPUT_NO_HOSTNAME) {
                 /* Suppress display of the hostname if this is requested. */
-                hostname = mfree(hostname);
+                hostname = NULL;
                 hostname_len = 0;
         }
 
@@ -791,8 +866,22 @@ struct json_data {
         JsonVariant* values[];
 };
 
+static void json_data_free_many(struct json_data **data, size_t n) {
+        size_t i;
+
+        for (i = 0; i < n; i++) {
+                json_variant_unref(data[i]->name);
+                json_variant_unref_many(data[i]->values, data[i]->n_values);
+                free(data[i]);
+        }
+
+        free(data);
+}
+
 static int update_json_data(
-                Hashmap *h,
+                struct json_data ***data,
+                size_t *n_data,
+                size_t *n_allocated,
                 OutputFlags flags,
                 const char *name,
                 const void *value,
@@ -800,8 +889,13 @@ static int update_json_data(
 
         _cleanup_(json_variant_unrefp) JsonVariant *v = NULL;
         struct json_data *d;
+        size_t i;
         int r;
 
+        assert(data);
+        assert(n_data);
+        assert(n_allocated);
+
         if (!(flags & OUTPUT_SHOW_ALL) && strlen(name) + 1 + size >= JSON_THRESHOLD)
                 r = json_variant_new_null(&v);
         else if (utf8_is_printable(value, size))
@@ -811,16 +905,18 @@ static int update_json_data(
         if (r < 0)
                 return log_error_errno(r, "Failed to allocate JSON data: %m");
 
-        d = hashmap_get(h, name);
-        if (d) {
-                struct json_data *w;
+        /* Entries have a few dozen fields at most, and hardly ever carry a field more than once. A linear search
+         * is hence cheaper than hashing every field name, and keeps the fields in the order we saw them. */
+        for (i = 0; i < *n_data; i++)
+                if (streq(json_variant_string((*data)[i]->name), name))
+                        break;
 
-                w = realloc(d, offsetof(struct json_data, values) + sizeof(JsonVariant*) * (d->n_values + 1));
-                if (!w)
+        if (i < *n_data) {
+                d = realloc((*data)[i], offsetof(struct json_data, values) + sizeof(JsonVariant*) * ((*data)[i]->n_values + 1));
+                if (!d)
                         return log_oom();
 
-                d = w;
-                assert_se(hashmap_update(h, json_variant_string(d->name), d) >= 0);
+                (*data)[i] = d;
         } else {
                 _cleanup_(json_variant_unrefp) JsonVariant *n = NULL;
 
@@ -828,17 +924,15 @@ static int update_json_data(
                 if (r < 0)
                         return log_error_errno(r, "Failed to allocate JSON name variant: %m");
 
+                if (!GREEDY_REALLOC(*data, *n_allocated, *n_data + 1))
+                        return log_oom();
+
                 d = malloc0(offsetof(struct json_data, values) + sizeof(JsonVariant*));
                 if (!d)
                         return log_oom();
 
-                r = hashmap_put(h, json_variant_string(n), d);
-                if (r < 0) {
-                        free(d);
-                        return log_error_errno(r, "Failed to insert JSON name into hashmap: %m");
-                }
-
                 d->name = TAKE_PTR(n);
+                (*data)[(*n_data)++] = d;
         }
 
         d->values[d->n_values++] = TAKE_PTR(v);
@@ -846,33 +940,35 @@ static int update_json_data(
 }
 
 static int update_json_data_split(
-                Hashmap *h,
+                struct json_data ***data,
+                size_t *n_data,
+                size_t *n_allocated,
                 OutputFlags flags,
                 Set *output_fields,
-                const void *data,
+                const void *p,
                 size_t size) {
 
         const char *eq;
         char *name;
 
-        assert(h);
-        assert(data || size == 0);
+        assert(data);
+        assert(p || size == 0);
 
-        if (memory_startswith(data, size, "_BOOT_ID="))
+        if (memory_startswith(p, size, "_BOOT_ID="))
                 return 0;
 
-        eq = memchr(data, '=', MIN(size, JSON_THRESHOLD));
+        eq = memchr(p, '=', MIN(size, JSON_THRESHOLD));
         if (!eq)
                 return 0;
 
-        if (eq == data)
+        if (eq == p)
                 return 0;
 
-        name = strndupa(data, eq - (const char*) data);
+        name = strndupa(p, eq - (const char*) p);
         if (output_fields && !set_get(output_fields, name))
                 return 0;
 
-        return update_json_data(h, flags, name, eq + 1, size - (eq - (const char*) data) - 1);
+        return update_json_data(data, n_data, n_allocated, flags, name, eq + 1, size - (eq - (const char*) p) - 1);
 }
 
 static int output_json(
@@ -889,11 +985,10 @@ static int output_json(
         _cleanup_free_ char *cursor = NULL;
         uint64_t realtime, monotonic;
         JsonVariant **array = NULL;
-        struct json_data *d;
+        struct json_data **data = NULL;
+        size_t n_data = 0, n_allocated = 0;
         sd_id128_t boot_id;
-        Hashmap *h = NULL;
-        size_t n = 0;
-        Iterator i;
+        size_t n = 0, i;
         int r;
 
         assert(j);
@@ -912,34 +1007,30 @@ static int output_json(
         if (r < 0)
                 return log_error_errno(r, "Failed to get cursor: %m");
 
-        h = hashmap_new(&string_hash_ops);
-        if (!h)
-                return log_oom();
-
-        r = update_json_data(h, flags, "__CURSOR", cursor, strlen(cursor));
+        r = update_json_data(&data, &n_data, &n_allocated, flags, "__CURSOR", cursor, strlen(cursor));
         if (r < 0)
                 goto finish;
 
         xsprintf(usecbuf, USEC_FMT, realtime);
-        r = update_json_data(h, flags, "__REALTIME_TIMESTAMP", usecbuf, strlen(usecbuf));
+        r = update_json_data(&data, &n_data, &n_allocated, flags, "__REALTIME_TIMESTAMP", usecbuf, strlen(usecbuf));
         if (r < 0)
                 goto finish;
 
         xsprintf(usecbuf, USEC_FMT, monotonic);
-        r = update_json_data(h, flags, "__MONOTONIC_TIMESTAMP", usecbuf, strlen(usecbuf));
+        r = update_json_data(&data, &n_data, &n_allocated, flags, "__MONOTONIC_TIMESTAMP", usecbuf, strlen(usecbuf));
         if (r < 0)
                 goto finish;
 
         sd_id128_to_string(boot_id, sid);
-        r = update_json_data(h, flags, "_BOOT_ID", sid, strlen(sid));
+        r = update_json_data(&data, &n_data, &n_allocated, flags, "_BOOT_ID", sid, strlen(sid));
         if (r < 0)
                 goto finish;
 
         for (;;) {
-                const void *data;
+                const void *p;
                 size_t size;
 
-                r = sd_journal_enumerate_data(j, &data, &size);
+                r = sd_journal_enumerate_data(j, &p, &size);
                 if (r == -EBADMSG) {
                         log_debug_errno(r, "Skipping message we can't read: %m");
                         r = 0;
@@ -952,18 +1043,20 @@ static int output_json(
                 if (r == 0)
                         break;
 
-                r = update_json_data_split(h, flags, output_fields, data, size);
+                r = update_json_data_split(&data, &n_data, &n_allocated, flags, output_fields, p, size);
                 if (r < 0)
                         goto finish;
         }
 
-        array = new(JsonVariant*, hashmap_size(h)*2);
+        array = new(JsonVariant*, n_data*2);
         if (!array) {
                 r = log_oom();
                 goto finish;
         }
 
-        HASHMAP_FOREACH(d, h, i) {
+        for (i = 0; i < n_data; i++) {
+                struct json_data *d = data[i];
+
                 assert(d->n_values > 0);
 
                 array[n++] = json_variant_ref(d->name);
@@ -997,24 +1090,559 @@ static int output_json(
         r = 0;
 
 finish:
-        while ((d = hashmap_steal_first(h))) {
-                size_t k;
+        json_data_free_many(data, n_data);
+
+        json_variant_unref_many(array, n);
+        free(array);
+
+        return r;
+}
+
+/* The columnar output mode collects up to rows_per_block entries, and then writes them as one JSON object,
+ * column by column. Field names are assigned numeric IDs the first time they are seen, and only these IDs
+ * are used afterwards. Columns with few distinct values are dictionary encoded: every value is written
+ * only once, and rows refer to it by its index in the dictionary of the column. */
+
+#define COLUMNAR_DICTIONARY_MAX 4096U
+
+typedef struct ColumnarCell {
+        JsonVariant **values;
+        size_t n_values;
+} ColumnarCell;
+
+typedef struct ColumnarColumn {
+        char *name;
+        unsigned id;
+        bool announced;
+
+        /* Dictionary encoding didn't pay off for this column, don't try again */
+        bool plain;
+
+        /* Value string → index in the dictionary + 1 */
+        Hashmap *dictionary;
+
+        /* One per row of the current block */
+        ColumnarCell *cells;
+        size_t n_cells;
+} ColumnarColumn;
 
-                json_variant_unref(d->name);
-                for (k = 0; k < d->n_values; k++)
-                        json_variant_unref(d->values[k]);
+struct ColumnarWriter {
+        FILE *f;
+        OutputFlags flags;
+        Set *output_fields;
+
+        OrderedHashmap *columns; /* name → ColumnarColumn, ordered by ID */
+
+        size_t rows_per_block;
+        size_t n_rows;
+};
+
+static void columnar_cell_clear(ColumnarCell *c) {
+        assert(c);
+
+        json_variant_unref_many(c->values, c->n_values);
+        c->values = mfree(c->values);
+        c->n_values = 0;
+}
+
+static ColumnarColumn* columnar_column_free(ColumnarColumn *c) {
+        size_t i;
+
+        if (!c)
+                return NULL;
+
+        for (i = 0; i < c->n_cells; i++)
+                columnar_cell_clear(c->cells + i);
+        free(c->cells);
+
+        hashmap_free_free_key(c->dictionary);
+        free(c->name);
+
+        return mfree(c);
+}
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(ColumnarColumn*, columnar_column_free);
+
+int columnar_writer_new(FILE *f, char **output_fields, size_t rows_per_block, ColumnarWriter **ret) {
+        _cleanup_(columnar_writer_freep) ColumnarWriter *w = NULL;
+        int r;
+
+        assert(f);
+        assert(rows_per_block > 0);
+        assert(ret);
+
+        w = new(ColumnarWriter, 1);
+        if (!w)
+                return -ENOMEM;
+
+        *w = (ColumnarWriter) {
+                .f = f,
+                .rows_per_block = rows_per_block,
+        };
+
+        w->columns = ordered_hashmap_new(&string_hash_ops);
+        if (!w->columns)
+                return -ENOMEM;
+
+        if (output_fields) {
+                w->output_fields = set_new(&string_hash_ops);
+                if (!w->output_fields)
+                        return -ENOMEM;
 
-                free(d);
+                r = set_put_strdupv(w->output_fields, output_fields);
+                if (r < 0)
+                        return r;
         }
 
-        hashmap_free(h);
+        *ret = TAKE_PTR(w);
+        return 0;
+}
 
-        json_variant_unref_many(array, n);
-        free(array);
+ColumnarWriter* columnar_writer_free(ColumnarWriter *w) {
+        if (!w)
+                return NULL;
+
+        ordered_hashmap_free_with_destructor(w->columns, columnar_column_free);
+        set_free_free(w->output_fields);
+
+        return mfree(w);
+}
+
+static int columnar_writer_add_value(ColumnarWriter *w, const char *name, const void *value, size_t size) {
+        _cleanup_(json_variant_unrefp) JsonVariant *v = NULL;
+        JsonVariant **values;
+        ColumnarColumn *c;
+        ColumnarCell *cell;
+        int r;
+
+        assert(w);
+        assert(name);
+        assert(w->n_rows < w->rows_per_block);
+
+        c = ordered_hashmap_get(w->columns, name);
+        if (!c) {
+                _cleanup_(columnar_column_freep) ColumnarColumn *n = NULL;
+
+                n = new0(ColumnarColumn, 1);
+                if (!n)
+                        return log_oom();
+
+                n->name = strdup(name);
+                n->cells = new0(ColumnarCell, w->rows_per_block);
+                if (!n->name || !n->cells)
+                        return log_oom();
+
+                n->n_cells = w->rows_per_block;
+                n->id = ordered_hashmap_size(w->columns);
+
+                r = ordered_hashmap_put(w->columns, n->name, n);
+                if (r < 0)
+                        return log_error_errno(r, "Failed to add column: %m");
+
+                c = TAKE_PTR(n);
+        }
+
+        if (!(w->flags & OUTPUT_SHOW_ALL) && strlen(name) + 1 + size >= JSON_THRESHOLD)
+                r = json_variant_new_null(&v);
+        else if (utf8_is_printable(value, size))
+                r = json_variant_new_stringn(&v, value, size);
+        else
+                r = json_variant_new_array_bytes(&v, value, size);
+        if (r < 0)
+                return log_error_errno(r, "Failed to allocate JSON data: %m");
+
+        cell = c->cells + w->n_rows;
+
+        values = reallocarray(cell->values, cell->n_values + 1, sizeof(JsonVariant*));
+        if (!values)
+                return log_oom();
+
+        cell->values = values;
+        cell->values[cell->n_values++] = TAKE_PTR(v);
+        return 0;
+}
+
+static bool columnar_column_can_use_dictionary(ColumnarColumn *c, size_t n_rows) {
+        _cleanup_set_free_ Set *fresh = NULL;
+        size_t i;
+
+        assert(c);
+
+        if (c->plain)
+                return false;
+
+        /* Only single, textual values can be looked up in the dictionary */
+        for (i = 0; i < n_rows; i++) {
+                ColumnarCell *cell = c->cells + i;
+
+                if (cell->n_values > 1)
+                        return false;
+                if (cell->n_values == 1 && !json_variant_is_string(cell->values[0]))
+                        return false;
+        }
+
+        fresh = set_new(&string_hash_ops);
+        if (!fresh)
+                return false;
+
+        for (i = 0; i < n_rows; i++) {
+                const char *s;
+
+                if (c->cells[i].n_values == 0)
+                        continue;
+
+                s = json_variant_string(c->cells[i].values[0]);
+                if (hashmap_contains(c->dictionary, s))
+                        continue;
+
+                if (set_put(fresh, s) < 0)
+                        return false;
+        }
+
+        /* If most values are new, the column has too many distinct values (e.g. MESSAGE=), and a dictionary
+         * only adds indexes to write. Give up on it then for good, unless the block is too small to tell. */
+        if (set_size(fresh) > n_rows / 2 ||
+            hashmap_size(c->dictionary) + set_size(fresh) > COLUMNAR_DICTIONARY_MAX) {
+                if (n_rows >= 16)
+                        c->plain = true;
+
+                return false;
+        }
+
+        return true;
+}
+
+static int columnar_column_build(ColumnarColumn *c, size_t n_rows, JsonVariant **ret) {
+        _cleanup_(json_variant_unrefp) JsonVariant *dictionary = NULL, *rows = NULL;
+        JsonVariant **new_values = NULL, **row_values = NULL;
+        size_t i, n_new = 0, n_row_values = 0;
+        int r;
+
+        assert(c);
+        assert(ret);
+
+        row_values = new0(JsonVariant*, n_rows);
+        if (!row_values)
+                return log_oom();
+
+        if (columnar_column_can_use_dictionary(c, n_rows)) {
+                new_values = new0(JsonVariant*, n_rows);
+                if (!new_values) {
+                        r = log_oom();
+                        goto finish;
+                }
+
+                r = hashmap_ensure_allocated(&c->dictionary, &string_hash_ops);
+                if (r < 0) {
+                        log_oom();
+                        goto finish;
+                }
+
+                for (i = 0; i < n_rows; i++) {
+                        ColumnarCell *cell = c->cells + i;
+                        const char *s;
+                        void *index;
+
+                        if (cell->n_values == 0) {
+                                r = json_variant_new_null(row_values + n_row_values++);
+                                if (r < 0)
+                                        goto fail;
+                                continue;
+                        }
+
+                        s = json_variant_string(cell->values[0]);
+
+                        index = hashmap_get(c->dictionary, s);
+                        if (!index) {
+                                _cleanup_free_ char *k = NULL;
+
+                                k = strdup(s);
+                                if (!k) {
+                                        r = log_oom();
+                                        goto finish;
+                                }
+
+                                index = UINT_TO_PTR(hashmap_size(c->dictionary) + 1);
+
+                                r = hashmap_put(c->dictionary, k, index);
+                                if (r < 0) {
+                                        log_oom();
+                                        goto finish;
+                                }
+
+                                TAKE_PTR(k);
+                                new_values[n_new++] = json_variant_ref(cell->values[0]);
+                        }
+
+                        r = json_variant_new_unsigned(row_values + n_row_values++, PTR_TO_UINT(index) - 1);
+                        if (r < 0)
+                                goto fail;
+                }
+
+                r = json_variant_new_array(&dictionary, new_values, n_new);
+                if (r < 0)
+                        goto fail;
+        } else
+                for (i = 0; i < n_rows; i++) {
+                        ColumnarCell *cell = c->cells + i;
+
+                        if (cell->n_values == 0)
+                                r = json_variant_new_null(row_values + n_row_values);
+                        else if (cell->n_values == 1)
+                                {
+                                row_values[n_row_values] = json_variant_ref(cell->values[0]);
+                                r = 0;
+                        }
+                        else
+                                r = json_variant_new_array(row_values + n_row_values, cell->values, cell->n_values);
+                        if (r < 0)
+                                goto fail;
+
+                        n_row_values++;
+                }
+
+        r = json_variant_new_array(&rows, row_values, n_row_values);
+        if (r < 0)
+                goto fail;
+
+        r = json_build(ret, JSON_BUILD_OBJECT(
+                                       JSON_BUILD_PAIR("field", JSON_BUILD_UNSIGNED(c->id)),
+                                       JSON_BUILD_PAIR_CONDITION(dictionary, "dictionary", JSON_BUILD_VARIANT(dictionary)),
+                                       JSON_BUILD_PAIR(dictionary ? "indexes" : "values", JSON_BUILD_VARIANT(rows))));
+        if (r < 0)
+                goto fail;
+
+        r = 0;
+        goto finish;
+
+fail:
+        log_error_errno(r, "Failed to build JSON column: %m");
+
+finish:
+        json_variant_unref_many(new_values, n_new);
+        free(new_values);
+        json_variant_unref_many(row_values, n_row_values);
+        free(row_values);
 
         return r;
 }
 
+int columnar_writer_flush(ColumnarWriter *w) {
+        _cleanup_(json_variant_unrefp) JsonVariant *block = NULL, *fields = NULL, *columns = NULL;
+        JsonVariant **field_names = NULL, **column_variants = NULL;
+        size_t n_field_names = 0, n_column_variants = 0, i;
+        ColumnarColumn *c;
+        Iterator it;
+        int r;
+
+        assert(w);
+
+        if (w->n_rows == 0)
+                return 0;
+
+        field_names = new0(JsonVariant*, ordered_hashmap_size(w->columns));
+        column_variants = new0(JsonVariant*, ordered_hashmap_size(w->columns));
+        if (!field_names || !column_variants) {
+                r = log_oom();
+                goto finish;
+        }
+
+        ORDERED_HASHMAP_FOREACH(c, w->columns, it) {
+                bool used = false;
+
+                if (!c->announced) {
+                        r = json_variant_new_string(field_names + n_field_names, c->name);
+                        if (r < 0) {
+                                log_error_errno(r, "Failed to allocate JSON field name: %m");
+                                goto finish;
+                        }
+
+                        n_field_names++;
+                        c->announced = true;
+                }
+
+                for (i = 0; i < w->n_rows; i++)
+                        if (c->cells[i].n_values > 0) {
+                                used = true;
+                                break;
+                        }
+
+                if (!used)
+                        continue;
+
+                r = columnar_column_build(c, w->n_rows, column_variants + n_column_variants);
+                if (r < 0)
+                        goto finish;
+
+                n_column_variants++;
+
+                for (i = 0; i < w->n_rows; i++)
+                        columnar_cell_clear(c->cells + i);
+        }
+
+        r = json_variant_new_array(&fields, field_names, n_field_names);
+        if (r < 0)
+                goto fail;
+
+        r = json_variant_new_array(&columns, column_variants, n_column_variants);
+        if (r < 0)
+                goto fail;
+
+        r = json_build(&block, JSON_BUILD_OBJECT(
+                                       JSON_BUILD_PAIR("rows", JSON_BUILD_UNSIGNED(w->n_rows)),
+                                       JSON_BUILD_PAIR("fields", JSON_BUILD_VARIANT(fields)),
+                                       JSON_BUILD_PAIR("columns", JSON_BUILD_VARIANT(columns))));
+        if (r < 0)
+                goto fail;
+
+        json_variant_dump(block,
+                          output_mode_to_json_format_flags(OUTPUT_COLUMNAR) |
+                          (FLAGS_SET(w->flags, OUTPUT_COLOR) ? JSON_FORMAT_COLOR : 0),
+                          w->f, NULL);
+
+        w->n_rows = 0;
+        r = 0;
+        goto finish;
+
+fail:
+        log_error_errno(r, "Failed to build JSON block: %m");
+
+finish:
+        json_variant_unref_many(field_names, n_field_names);
+        free(field_names);
+        json_variant_unref_many(column_variants, n_column_variants);
+        free(column_variants);
+
+        return r;
+}
+
+int columnar_writer_add(ColumnarWriter *w, sd_journal *j, OutputFlags flags) {
+        char sid[SD_ID128_STRING_MAX], usecbuf[DECIMAL_STR_MAX(usec_t)];
+        _cleanup_free_ char *cursor = NULL;
+        uint64_t realtime, monotonic;
+        sd_id128_t boot_id;
+        ColumnarColumn *c;
+        Iterator it;
+        int r;
+
+        assert(w);
+        assert(j);
+
+        w->flags = flags;
+
+        (void) sd_journal_set_data_threshold(j, flags & OUTPUT_SHOW_ALL ? 0 : JSON_THRESHOLD);
+
+        r = sd_journal_get_realtime_usec(j, &realtime);
+        if (r < 0)
+                return log_error_errno(r, "Failed to get realtime timestamp: %m");
+
+        r = sd_journal_get_monotonic_usec(j, &monotonic, &boot_id);
+        if (r < 0)
+                return log_error_errno(r, "Failed to get monotonic timestamp: %m");
+
+        r = sd_journal_get_cursor(j, &cursor);
+        if (r < 0)
+                return log_error_errno(r, "Failed to get cursor: %m");
+
+        r = columnar_writer_add_value(w, "__CURSOR", cursor, strlen(cursor));
+        if (r < 0)
+                goto fail;
+
+        xsprintf(usecbuf, USEC_FMT, realtime);
+        r = columnar_writer_add_value(w, "__REALTIME_TIMESTAMP", usecbuf, strlen(usecbuf));
+        if (r < 0)
+                goto fail;
+
+        xsprintf(usecbuf, USEC_FMT, monotonic);
+        r = columnar_writer_add_value(w, "__MONOTONIC_TIMESTAMP", usecbuf, strlen(usecbuf));
+        if (r < 0)
+                goto fail;
+
+        sd_id128_to_string(boot_id, sid);
+        r = columnar_writer_add_value(w, "_BOOT_ID", sid, strlen(sid));
+        if (r < 0)
+                goto fail;
+
+        for (;;) {
+                const void *data;
+                const char *eq;
+                size_t size;
+                char *name;
+
+                r = sd_journal_enumerate_data(j, &data, &size);
+                if (r == -EBADMSG) {
+                        log_debug_errno(r, "Skipping message we can't read: %m");
+                        r = 0;
+                        goto fail;
+                }
+                if (r < 0) {
+                        log_error_errno(r, "Failed to read journal: %m");
+                        goto fail;
+                }
+                if (r == 0)
+                        break;
+
+                if (memory_startswith(data, size, "_BOOT_ID="))
+                        continue;
+
+                eq = memchr(data, '=', MIN(size, JSON_THRESHOLD));
+                if (!eq || eq == data)
+                        continue;
+
+                name = strndupa(data, eq - (const char*) data);
+                if (w->output_fields && !set_get(w->output_fields, name))
+                        continue;
+
+                r = columnar_writer_add_value(w, name, eq + 1, size - (eq - (const char*) data) - 1);
+                if (r < 0)
+                        goto fail;
+        }
+
+        w->n_rows++;
+
+        if (w->n_rows >= w->rows_per_block)
+                return columnar_writer_flush(w);
+
+        return 0;
+
+fail:
+        /* Drop what we collected of this entry */
+        ORDERED_HASHMAP_FOREACH(c, w->columns, it)
+                columnar_cell_clear(c->cells + w->n_rows);
+
+        return r;
+}
+
+static int output_columnar(
+                FILE *f,
+                sd_journal *j,
+                OutputMode mode,
+                unsigned n_columns,
+                OutputFlags flags,
+                Set *output_fields,
+                const size_t highlight[2]) {
+
+        _cleanup_(columnar_writer_freep) ColumnarWriter *w = NULL;
+        char **fields = NULL;
+        int r;
+
+        /* If we are called for individual entries, each entry becomes a block of its own. Callers that show
+         * many entries should use a ColumnarWriter of their own instead. */
+
+        if (output_fields) {
+                fields = set_get_strv(output_fields);
+                if (!fields)
+                        return log_oom();
+        }
+
+        r = columnar_writer_new(f, fields, 1, &w);
+        free(fields);
+        if (r < 0)
+                return log_error_errno(r, "Failed to allocate columnar writer: %m");
+
+        return columnar_writer_add(w, j, flags);
+}
+
 static int output_cat(
                 FILE *f,
                 sd_journal *j,
@@ -1094,6 +1722,7 @@ static int (*output_funcs[_OUTPUT_MODE_MAX])(
         [OUTPUT_JSON_SEQ]          = output_json,
         [OUTPUT_CAT]               = output_cat,
         [OUTPUT_WITH_UNIT]         = output_short,
+        [OUTPUT_COLUMNAR]          = output_columnar,
 };
 
 int show_journal_entry(
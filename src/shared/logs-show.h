@@ -56,6 +56,16 @@ int show_journal_by_unit(
                 bool system_unit,
                 bool *ellipsized);
 
+typedef struct ColumnarWriter ColumnarWriter;
+
+int columnar_writer_new(FILE *f, char **output_fields, size_t rows_per_block, ColumnarWriter **ret);
+ColumnarWriter* columnar_writer_free(ColumnarWriter *w);
+DEFINE_TRIVIAL_CLEANUP_FUNC(ColumnarWriter*, columnar_writer_free);
+
+/* Adds the current entry of the journal to the block, writing the block out when it is full */
+int columnar_writer_add(ColumnarWriter *w, sd_journal *j, OutputFlags flags);
+int columnar_writer_flush(ColumnarWriter *w);
+
 void json_escape(
                 FILE *f,
                 const char* p,
@@ -14,6 +14,7 @@
 #include <unistd.h>
 
 #include "alloc-util.h"
+#include "dirent-util.h"
 #include "fd-util.h"
 #include "fileio.h"
 #include "loop-util.h"
@@ -29,6 +30,89 @@ static void cleanup_clear_loop_close(int *fd) {
         }
 }
 
+static int loop_device_find_attached(
+                const struct stat *st,
+                uint64_t offset,
+                uint64_t size,
+                uint32_t loop_flags,
+                LoopDevice **ret) {
+
+        _cleanup_closedir_ DIR *dir = NULL;
+        struct dirent *de;
+
+        assert(st);
+        assert(ret);
+
+        /* Looks for a loop device the same file is already attached to read-only, with the same offset,
+         * size and partition scanning flag. Such a device may simply be shared, which saves setting up
+         * another one and waiting for its partitions to be probed. */
+
+        dir = opendir("/sys/block");
+        if (!dir)
+                return errno == ENOENT ? 0 : -errno;
+
+        FOREACH_DIRENT(de, dir, return -errno) {
+                char sysfs[STRLEN("loop") + DECIMAL_STR_MAX(int) + STRLEN("/loop")];
+                _cleanup_free_ char *node = NULL;
+                _cleanup_close_ int loop = -1;
+                struct loop_info64 info;
+                const char *e;
+                LoopDevice *d;
+                int nr;
+
+                e = startswith(de->d_name, "loop");
+                if (!e || safe_atoi(e, &nr) < 0 || nr < 0)
+                        continue;
+
+                /* Only devices with a backing file have the "loop" subdirectory */
+                xsprintf(sysfs, "loop%i/loop", nr);
+                if (faccessat(dirfd(dir), sysfs, F_OK, 0) < 0)
+                        continue;
+
+                if (asprintf(&node, "/dev/loop%i", nr) < 0)
+                        return -ENOMEM;
+
+                /* Open the device before checking it, so that it cannot be auto-cleared under our feet */
+                loop = open(node, O_RDONLY|O_CLOEXEC|O_NONBLOCK|O_NOCTTY);
+                if (loop < 0)
+                        continue;
+
+                if (ioctl(loop, LOOP_GET_STATUS64, &info) < 0)
+                        continue;
+
+#if HAVE_VALGRIND_MEMCHECK_H
+                VALGRIND_MAKE_MEM_DEFINED(&info, sizeof(info));
+#endif
+
+                if (info.lo_device != (uint64_t) st->st_dev ||
+                    info.lo_inode != (uint64_t) st->st_ino ||
+                    info.lo_offset != offset ||
+                    info.lo_sizelimit != (size == UINT64_MAX ? 0 : size))
+                        continue;
+
+                if (!FLAGS_SET(info.lo_flags, LO_FLAGS_READ_ONLY) ||
+                    (info.lo_flags & LO_FLAGS_PARTSCAN) != (loop_flags & LO_FLAGS_PARTSCAN))
+                        continue;
+
+                d = new(LoopDevice, 1);
+                if (!d)
+                        return -ENOMEM;
+                *d = (LoopDevice) {
+                        .fd = TAKE_FD(loop),
+                        .nr = nr,
+                        .node = TAKE_PTR(node),
+                        .relinquished = true, /* It's not ours, don't try to destroy it when this object is freed */
+                };
+
+                log_debug("Reusing loop device %s, already attached read-only to the same file.", d->node);
+
+                *ret = d;
+                return 1;
+        }
+
+        return 0;
+}
+
 int loop_device_make(
                 int fd,
                 int open_flags,
@@ -90,6 +174,14 @@ int loop_device_make(
                 r = stat_verify_regular(&st);
                 if (r < 0)
                         return r;
+
+                if (open_flags == O_RDONLY) {
+                        r = loop_device_find_attached(&st, offset, size, loop_flags, ret);
+                        if (r < 0)
+                                log_debug_errno(r, "Failed to look for existing loop devices, ignoring: %m");
+                        if (r > 0)
+                                return 0;
+                }
         }
 
         _cleanup_close_ int control = -1;
@@ -134,7 +226,7 @@ int loop_device_make(
 
         info = (struct loop_info64) {
                 /* Use the specified flags, but configure the read-only flag from the open flags, and force autoclear */
-                .lo_flags = (loop_flags & ~LO_FLAGS_READ_ONLY) | ((loop_flags & O_ACCMODE) == O_RDONLY ? LO_FLAGS_READ_ONLY : 0) | LO_FLAGS_AUTOCLEAR,
+                .lo_flags = (loop_flags & ~LO_FLAGS_READ_ONLY) | ((open_flags & O_ACCMODE) == O_RDONLY ? LO_FLAGS_READ_ONLY : 0) | LO_FLAGS_AUTOCLEAR,
                 .lo_offset = offset,
                 .lo_sizelimit = size == UINT64_MAX ? 0 : size,
         };
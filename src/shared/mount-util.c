@@ -148,7 +148,7 @@ int bind_remount_recursive_with_mountinfo(
                 _cleanup_set_free_free_ Set *todo = NULL;
                 _cleanup_(mnt_free_tablep) struct libmnt_table *table = NULL;
                 _cleanup_(mnt_free_iterp) struct libmnt_iter *iter = NULL;
-                bool top_autofs = false;
+                bool top_autofs = false, made_top = false;
                 char *x;
                 unsigned long orig_flags;
 
@@ -243,6 +243,7 @@ int bind_remount_recursive_with_mountinfo(
                                 return -errno;
 
                         log_debug("Made top-level directory %s a mount point.", prefix);
+                        made_top = true;
 
                         r = set_put_strdup(done, cleaned);
                         if (r < 0)
@@ -286,6 +287,13 @@ int bind_remount_recursive_with_mountinfo(
 
                         log_debug("Remounted %s read-only.", x);
                 }
+
+                /* Remounting doesn't add or remove any mounts, hence if the top-level directory was a mount
+                 * already, the table we just went through was complete, and there's no point in parsing
+                 * mountinfo all over again just to find nothing new. Only if we bind mounted the top-level
+                 * directory onto itself, look once more at what that replicated. */
+                if (!made_top)
+                        return 0;
         }
 }
 
@@ -13,7 +13,9 @@
 #include "af-list.h"
 #include "alloc-util.h"
 #include "errno-list.h"
+#include "fd-util.h"
 #include "macro.h"
+#include "memfd-util.h"
 #include "nsflags.h"
 #include "nulstr-util.h"
 #include "process-util.h"
@@ -1003,6 +1005,53 @@ int seccomp_load_syscall_filter_set(uint32_t default_action, const SyscallFilter
         return 0;
 }
 
+static int seccomp_prepare_syscall_filter_set_raw(
+                uint32_t arch,
+                uint32_t default_action,
+                Hashmap* set,
+                uint32_t action,
+                bool log_missing,
+                scmp_filter_ctx *ret) {
+
+        _cleanup_(seccomp_releasep) scmp_filter_ctx seccomp = NULL;
+        Iterator i;
+        void *syscall_id, *val;
+        int r;
+
+        assert(ret);
+
+        r = seccomp_init_for_arch(&seccomp, arch, default_action);
+        if (r < 0)
+                return r;
+
+        HASHMAP_FOREACH_KEY(val, syscall_id, set, i) {
+                uint32_t a = action;
+                int id = PTR_TO_INT(syscall_id) - 1;
+                int error = PTR_TO_INT(val);
+
+                if (action != SCMP_ACT_ALLOW && error >= 0)
+                        a = SCMP_ACT_ERRNO(error);
+
+                r = seccomp_rule_add_exact(seccomp, a, id, 0);
+                if (r < 0) {
+                        /* If the system call is not known on this architecture, then that's fine, let's ignore it */
+                        _cleanup_free_ char *n = NULL;
+                        bool ignore;
+
+                        n = seccomp_syscall_resolve_num_arch(SCMP_ARCH_NATIVE, id);
+                        ignore = r == -EDOM;
+                        if (!ignore || log_missing)
+                                log_debug_errno(r, "Failed to add rule for system call %s() / %d%s: %m",
+                                                strna(n), id, ignore ? ", ignoring" : "");
+                        if (!ignore)
+                                return r;
+                }
+        }
+
+        *ret = TAKE_PTR(seccomp);
+        return 0;
+}
+
 int seccomp_load_syscall_filter_set_raw(uint32_t default_action, Hashmap* set, uint32_t action, bool log_missing) {
         uint32_t arch;
         int r;
@@ -1015,39 +1064,13 @@ int seccomp_load_syscall_filter_set_raw(uint32_t default_action, Hashmap* set, u
 
         SECCOMP_FOREACH_LOCAL_ARCH(arch) {
                 _cleanup_(seccomp_releasep) scmp_filter_ctx seccomp = NULL;
-                Iterator i;
-                void *syscall_id, *val;
 
                 log_debug("Operating on architecture: %s", seccomp_arch_to_string(arch));
 
-                r = seccomp_init_for_arch(&seccomp, arch, default_action);
+                r = seccomp_prepare_syscall_filter_set_raw(arch, default_action, set, action, log_missing, &seccomp);
                 if (r < 0)
                         return r;
 
-                HASHMAP_FOREACH_KEY(val, syscall_id, set, i) {
-                        uint32_t a = action;
-                        int id = PTR_TO_INT(syscall_id) - 1;
-                        int error = PTR_TO_INT(val);
-
-                        if (action != SCMP_ACT_ALLOW && error >= 0)
-                                a = SCMP_ACT_ERRNO(error);
-
-                        r = seccomp_rule_add_exact(seccomp, a, id, 0);
-                        if (r < 0) {
-                                /* If the system call is not known on this architecture, then that's fine, let's ignore it */
-                                _cleanup_free_ char *n = NULL;
-                                bool ignore;
-
-                                n = seccomp_syscall_resolve_num_arch(SCMP_ARCH_NATIVE, id);
-                                ignore = r == -EDOM;
-                                if (!ignore || log_missing)
-                                        log_debug_errno(r, "Failed to add rule for system call %s() / %d%s: %m",
-                                                        strna(n), id, ignore ? ", ignoring" : "");
-                                if (!ignore)
-                                        return r;
-                        }
-                }
-
                 r = seccomp_load(seccomp);
                 if (ERRNO_IS_SECCOMP_FATAL(r))
                         return r;
@@ -1058,6 +1081,135 @@ int seccomp_load_syscall_filter_set_raw(uint32_t default_action, Hashmap* set, u
         return 0;
 }
 
+static int seccomp_export_program(scmp_filter_ctx seccomp, struct sock_fprog *ret) {
+        _cleanup_close_ int fd = -1;
+        _cleanup_free_ struct sock_filter *insns = NULL;
+        struct stat st;
+        ssize_t n;
+        int r;
+
+        assert(seccomp);
+        assert(ret);
+
+        fd = memfd_new("seccomp-bpf");
+        if (fd < 0)
+                return fd;
+
+        r = seccomp_export_bpf(seccomp, fd);
+        if (r < 0)
+                return r;
+
+        if (fstat(fd, &st) < 0)
+                return -errno;
+
+        if (st.st_size <= 0 ||
+            st.st_size % sizeof(struct sock_filter) != 0 ||
+            st.st_size / sizeof(struct sock_filter) > USHRT_MAX)
+                return -EBADMSG;
+
+        insns = malloc(st.st_size);
+        if (!insns)
+                return -ENOMEM;
+
+        n = pread(fd, insns, st.st_size, 0);
+        if (n < 0)
+                return -errno;
+        if (n != st.st_size)
+                return -EIO;
+
+        *ret = (struct sock_fprog) {
+                .len = st.st_size / sizeof(struct sock_filter),
+                .filter = TAKE_PTR(insns),
+        };
+
+        return 0;
+}
+
+int seccomp_compile_syscall_filter_set_raw(
+                uint32_t default_action,
+                Hashmap* set,
+                uint32_t action,
+                bool log_missing,
+                SeccompCompiledFilter **ret) {
+
+        _cleanup_(seccomp_compiled_filter_freep) SeccompCompiledFilter *f = NULL;
+        uint32_t arch;
+        size_t n = 0;
+        int r;
+
+        /* Like seccomp_load_syscall_filter_set_raw(), but doesn't load the filters, but returns them as BPF
+         * programs, one for each local architecture, to be loaded later with seccomp_load_compiled_filter().
+         * This is useful to build the filter once in the manager, and then load it in many children. */
+
+        assert(ret);
+
+        SECCOMP_FOREACH_LOCAL_ARCH(arch)
+                n++;
+
+        f = malloc0(offsetof(SeccompCompiledFilter, programs) + n * sizeof(f->programs[0]));
+        if (!f)
+                return -ENOMEM;
+
+        if (hashmap_isempty(set) && default_action == SCMP_ACT_ALLOW) {
+                *ret = TAKE_PTR(f);
+                return 0;
+        }
+
+        SECCOMP_FOREACH_LOCAL_ARCH(arch) {
+                _cleanup_(seccomp_releasep) scmp_filter_ctx seccomp = NULL;
+
+                r = seccomp_prepare_syscall_filter_set_raw(arch, default_action, set, action, log_missing, &seccomp);
+                if (r < 0)
+                        return r;
+
+                r = seccomp_export_program(seccomp, &f->programs[f->n_programs].program);
+                if (r < 0)
+                        return log_debug_errno(r, "Failed to export filter set for architecture %s: %m", seccomp_arch_to_string(arch));
+
+                f->programs[f->n_programs++].arch = arch;
+        }
+
+        *ret = TAKE_PTR(f);
+        return 0;
+}
+
+int seccomp_load_compiled_filter(const SeccompCompiledFilter *f) {
+        size_t i;
+
+        assert(f);
+
+        /* libseccomp's seccomp_load() does the same, as we turn off NNP fiddling and thread syncing. Hence a
+         * plain prctl() is all that's needed, which doesn't allocate memory, nor look at the system call
+         * tables. */
+
+        for (i = 0; i < f->n_programs; i++) {
+                int r;
+
+                if (prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &f->programs[i].program, 0, 0) >= 0)
+                        continue;
+
+                r = -errno;
+                if (ERRNO_IS_SECCOMP_FATAL(r))
+                        return r;
+
+                log_debug_errno(r, "Failed to install filter set for architecture %s, skipping: %m", seccomp_arch_to_string(f->programs[i].arch));
+        }
+
+        return 0;
+}
+
+SeccompCompiledFilter *seccomp_compiled_filter_free(SeccompCompiledFilter *f) {
+        size_t i;
+
+        if (!f)
+                return NULL;
+
+        for (i = 0; i < f->n_programs; i++)
+                free(f->programs[i].program.filter);
+
+        return mfree(f);
+}
+
 int seccomp_parse_syscall_filter(
                 const char *name,
                 int errno_num,
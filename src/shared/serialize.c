@@ -14,6 +14,36 @@
 #include "strv.h"
 #include "tmpfile-util.h"
 
+/* Marks an item in the binary framing. Text lines never start with this, as keys and unit names don't. */
+#define SERIALIZE_RECORD_MARKER '\036'
+
+static FILE *binary_serialization = NULL;
+
+void serialize_set_binary(FILE *f) {
+        binary_serialization = f;
+}
+
+static void serialize_write(FILE *f, const char *key, const char *value) {
+        if (f == binary_serialization) {
+                uint32_t n;
+
+                /* The length of "key=value", followed by that, unterminated */
+                n = strlen(key) + 1 + strlen(value);
+
+                fputc(SERIALIZE_RECORD_MARKER, f);
+                fwrite(&n, sizeof(n), 1, f);
+                fputs(key, f);
+                fputc('=', f);
+                fputs(value, f);
+                return;
+        }
+
+        fputs(key, f);
+        fputc('=', f);
+        fputs(value, f);
+        fputc('\n', f);
+}
+
 int serialize_item(FILE *f, const char *key, const char *value) {
         assert(f);
         assert(key);
@@ -28,10 +58,7 @@ int serialize_item(FILE *f, const char *key, const char *value) {
                 return -EINVAL;
         }
 
-        fputs(key, f);
-        fputc('=', f);
-        fputs(value, f);
-        fputc('\n', f);
+        serialize_write(f, key, value);
 
         return 1;
 }
@@ -70,10 +97,7 @@ int serialize_item_format(FILE *f, const char *key, const char *format, ...) {
                 return -EINVAL;
         }
 
-        fputs(key, f);
-        fputc('=', f);
-        fputs(buf, f);
-        fputc('\n', f);
+        serialize_write(f, key, buf);
 
         return 1;
 }
@@ -131,6 +155,44 @@ int serialize_strv(FILE *f, const char *key, char **l) {
         return ret;
 }
 
+int deserialize_read_line(FILE *f, char **ret) {
+        _cleanup_free_ char *buf = NULL;
+        uint32_t n;
+        int c;
+
+        assert(f);
+        assert(ret);
+
+        /* Like read_line() with a limit of LONG_LINE_MAX, but also reads items written in the binary framing, see
+         * serialize_set_binary(). Both may be mixed freely. */
+
+        c = fgetc(f);
+        if (c != SERIALIZE_RECORD_MARKER) {
+                if (c != EOF)
+                        assert_se(ungetc(c, f) != EOF);
+
+                return read_line(f, LONG_LINE_MAX, ret);
+        }
+
+        if (fread(&n, sizeof(n), 1, f) != 1)
+                return ferror(f) ? -errno : -EBADMSG;
+        if (n >= LONG_LINE_MAX)
+                return -ENOBUFS;
+
+        buf = new(char, n + 1);
+        if (!buf)
+                return -ENOMEM;
+
+        if (n > 0 && fread(buf, n, 1, f) != 1)
+                return ferror(f) ? -errno : -EBADMSG;
+        if (memchr(buf, 0, n))
+                return -EBADMSG;
+        buf[n] = 0;
+
+        *ret = TAKE_PTR(buf);
+        return 1 + sizeof(n) + n;
+}
+
 int deserialize_usec(const char *value, usec_t *ret) {
         int r;
 
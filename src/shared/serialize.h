@@ -8,6 +8,11 @@
 #include "string-util.h"
 #include "time-util.h"
 
+/* Items written to the file set here are written in a length-prefixed binary framing instead of as text lines,
+ * which is cheaper to read back. Older versions cannot read that, hence only use it for serializations read back by
+ * the same binary. Pass NULL to turn it off again. */
+void serialize_set_binary(FILE *f);
+
 int serialize_item(FILE *f, const char *key, const char *value);
 int serialize_item_escaped(FILE *f, const char *key, const char *value);
 int serialize_item_format(FILE *f, const char *key, const char *value, ...) _printf_(3,4);
@@ -20,6 +25,7 @@ static inline int serialize_bool(FILE *f, const char *key, bool b) {
         return serialize_item(f, key, yes_no(b));
 }
 
+int deserialize_read_line(FILE *f, char **ret);
 int deserialize_usec(const char *value, usec_t *timestamp);
 int deserialize_dual_timestamp(const char *value, dual_timestamp *t);
 int deserialize_environment(const char *value, char ***environment);
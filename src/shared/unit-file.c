@@ -204,7 +204,8 @@ int unit_file_build_name_map(
          * have a key, but it is not present in the value for itself, there was an alias pointing to it, but
          * the unit itself is not loadable.
          *
-         * At the same, build a cache of paths where to find units.
+         * At the same, build a cache of paths where to find units. If only the latter is needed, the two
+         * mappings may be omitted, by passing NULL.
          */
 
         _cleanup_hashmap_free_ Hashmap *ids = NULL, *names = NULL;
@@ -270,7 +271,7 @@ int unit_file_build_name_map(
                         } else
                                 _filename_free = filename; /* Make sure we free the filename. */
 
-                        if (!valid_unit_name)
+                        if (!valid_unit_name || !ret_unit_ids_map)
                                 continue;
                         assert_se(suffix = strrchr(de->d_name, '.'));
 
@@ -382,8 +383,10 @@ int unit_file_build_name_map(
 
         if (cache_mtime)
                 *cache_mtime = mtime;
-        *ret_unit_ids_map = TAKE_PTR(ids);
-        *ret_unit_names_map = TAKE_PTR(names);
+        if (ret_unit_ids_map)
+                *ret_unit_ids_map = TAKE_PTR(ids);
+        if (ret_unit_names_map)
+                *ret_unit_names_map = TAKE_PTR(names);
         if (ret_path_cache)
                 *ret_path_cache = TAKE_PTR(paths);
 
@@ -1,11 +1,14 @@
 /* SPDX-License-Identifier: LGPL-2.1+ */
 
+#include <limits.h>
 #include <sys/poll.h>
+#include <sys/uio.h>
 
 #include "alloc-util.h"
 #include "errno-util.h"
 #include "fd-util.h"
 #include "hashmap.h"
+#include "io-util.h"
 #include "list.h"
 #include "process-util.h"
 #include "set.h"
@@ -116,10 +119,14 @@ struct Varlink {
         size_t input_buffer_size;
         size_t input_buffer_unscanned;
 
-        char *output_buffer; /* valid data starts at output_buffer_index, ends at output_buffer_index+output_buffer_size */
-        size_t output_buffer_allocated;
-        size_t output_buffer_index;
-        size_t output_buffer_size;
+        /* Formatted messages queued for sending, each including its trailing NUL byte. They are not copied
+         * into one buffer, but handed to the kernel in one go with sendmsg()/writev(). */
+        struct iovec *output_queue; /* valid entries start at output_queue_index, end at n_output_queue */
+        size_t output_queue_allocated;
+        size_t n_output_queue;
+        size_t output_queue_index;
+        size_t output_queue_offset; /* bytes of the entry at output_queue_index that are written already */
+        size_t output_queue_size;   /* total bytes not written yet */
 
         VarlinkReply reply_callback;
 
@@ -348,6 +355,19 @@ static void varlink_detach_event_sources(Varlink *v) {
         v->defer_event_source = sd_event_source_disable_unref(v->defer_event_source);
 }
 
+static void varlink_clear_output_queue(Varlink *v) {
+        size_t i;
+
+        assert(v);
+
+        for (i = v->output_queue_index; i < v->n_output_queue; i++)
+                free(v->output_queue[i].iov_base);
+
+        v->output_queue = mfree(v->output_queue);
+        v->output_queue_allocated = v->n_output_queue = v->output_queue_index = 0;
+        v->output_queue_offset = v->output_queue_size = 0;
+}
+
 static void varlink_clear(Varlink *v) {
         assert(v);
 
@@ -356,7 +376,7 @@ static void varlink_clear(Varlink *v) {
         v->fd = safe_close(v->fd);
 
         v->input_buffer = mfree(v->input_buffer);
-        v->output_buffer = mfree(v->output_buffer);
+        varlink_clear_output_queue(v);
 
         v->current = json_variant_unref(v->current);
         v->reply = json_variant_unref(v->reply);
@@ -396,7 +416,7 @@ static int varlink_test_disconnect(Varlink *v) {
                 return 0;
 
         /* Still something to write and we can write? Stay around */
-        if (v->output_buffer_size > 0 && !v->write_disconnected)
+        if (v->output_queue_size > 0 && !v->write_disconnected)
                 return 0;
 
         /* Both sides gone already? Then there's no need to stick around */
@@ -420,7 +440,34 @@ disconnect:
         return 1;
 }
 
+static void varlink_output_queue_advance(Varlink *v, size_t n) {
+        assert(v);
+        assert(n <= v->output_queue_size);
+
+        v->output_queue_size -= n;
+
+        while (n > 0) {
+                struct iovec *i = v->output_queue + v->output_queue_index;
+                size_t left = i->iov_len - v->output_queue_offset;
+
+                if (n < left) {
+                        v->output_queue_offset += n;
+                        break;
+                }
+
+                n -= left;
+                i->iov_base = mfree(i->iov_base);
+                v->output_queue_index++;
+                v->output_queue_offset = 0;
+        }
+
+        if (v->output_queue_index == v->n_output_queue)
+                v->output_queue_index = v->n_output_queue = 0;
+}
+
 static int varlink_write(Varlink *v) {
+        struct iovec *iov, first;
+        size_t n_iov;
         ssize_t n;
 
         assert(v);
@@ -430,22 +477,37 @@ static int varlink_write(Varlink *v) {
         if (v->connecting) /* Writing while we are still wait for a non-blocking connect() to complete will
                             * result in ENOTCONN, hence exit early here */
                 return 0;
-        if (v->output_buffer_size == 0)
+        if (v->output_queue_size == 0)
                 return 0;
         if (v->write_disconnected)
                 return 0;
 
         assert(v->fd >= 0);
 
-        /* We generally prefer recv()/send() (mostly because of MSG_NOSIGNAL) but also want to be compatible
+        /* Write out all queued messages at once, skipping over what was already written of the first one */
+        iov = v->output_queue + v->output_queue_index;
+        n_iov = MIN(v->n_output_queue - v->output_queue_index, (size_t) IOV_MAX);
+
+        first = iov[0];
+        iov[0] = IOVEC_MAKE((uint8_t*) first.iov_base + v->output_queue_offset, first.iov_len - v->output_queue_offset);
+
+        /* We generally prefer sendmsg() (mostly because of MSG_NOSIGNAL) but also want to be compatible
          * with non-socket IO, hence fall back automatically */
         if (!v->prefer_read_write) {
-                n = send(v->fd, v->output_buffer + v->output_buffer_index, v->output_buffer_size, MSG_DONTWAIT|MSG_NOSIGNAL);
+                struct msghdr mh = {
+                        .msg_iov = iov,
+                        .msg_iovlen = n_iov,
+                };
+
+                n = sendmsg(v->fd, &mh, MSG_DONTWAIT|MSG_NOSIGNAL);
                 if (n < 0 && errno == ENOTSOCK)
                         v->prefer_read_write = true;
         }
         if (v->prefer_read_write)
-                n = write(v->fd, v->output_buffer + v->output_buffer_index, v->output_buffer_size);
+                n = writev(v->fd, iov, n_iov);
+
+        iov[0] = first;
+
         if (n < 0) {
                 if (errno == EAGAIN)
                         return 0;
@@ -460,12 +522,7 @@ static int varlink_write(Varlink *v) {
                 return -errno;
         }
 
-        v->output_buffer_size -= n;
-
-        if (v->output_buffer_size == 0)
-                v->output_buffer_index = 0;
-        else
-                v->output_buffer_index += n;
+        varlink_output_queue_advance(v, n);
 
         v->timestamp = now(CLOCK_MONOTONIC);
         return 1;
@@ -1083,7 +1140,7 @@ int varlink_get_events(Varlink *v) {
                 ret |= EPOLLIN;
 
         if (!v->write_disconnected &&
-            v->output_buffer_size > 0)
+            v->output_queue_size > 0)
                 ret |= EPOLLOUT;
 
         return ret;
@@ -1118,7 +1175,7 @@ int varlink_flush(Varlink *v) {
         for (;;) {
                 struct pollfd pfd;
 
-                if (v->output_buffer_size == 0)
+                if (v->output_queue_size == 0)
                         break;
                 if (v->write_disconnected)
                         return -ECONNRESET;
@@ -1224,40 +1281,24 @@ static int varlink_enqueue_json(Varlink *v, JsonVariant *m) {
                 return r;
         assert(text[r] == '\0');
 
-        if (v->output_buffer_size + r + 1 > VARLINK_BUFFER_MAX)
+        if (v->output_queue_size + r + 1 > VARLINK_BUFFER_MAX)
                 return -ENOBUFS;
 
         varlink_log(v, "Sending message: %s", text);
 
-        if (v->output_buffer_size == 0) {
-
-                free_and_replace(v->output_buffer, text);
-
-                v->output_buffer_size = v->output_buffer_allocated = r + 1;
-                v->output_buffer_index = 0;
-
-        } else if (v->output_buffer_index == 0) {
-
-                if (!GREEDY_REALLOC(v->output_buffer, v->output_buffer_allocated, v->output_buffer_size + r + 1))
-                        return -ENOMEM;
-
-                memcpy(v->output_buffer + v->output_buffer_size, text, r + 1);
-                v->output_buffer_size += r + 1;
-
-        } else {
-                char *n;
-                const size_t new_size = v->output_buffer_size + r + 1;
-
-                n = new(char, new_size);
-                if (!n)
-                        return -ENOMEM;
+        /* Reuse the space of entries that were written already, before growing the queue */
+        if (v->n_output_queue >= v->output_queue_allocated && v->output_queue_index > 0) {
+                memmove(v->output_queue, v->output_queue + v->output_queue_index,
+                        (v->n_output_queue - v->output_queue_index) * sizeof(struct iovec));
+                v->n_output_queue -= v->output_queue_index;
+                v->output_queue_index = 0;
+        }
 
-                memcpy(mempcpy(n, v->output_buffer + v->output_buffer_index, v->output_buffer_size), text, r + 1);
+        if (!GREEDY_REALLOC(v->output_queue, v->output_queue_allocated, v->n_output_queue + 1))
+                return -ENOMEM;
 
-                free_and_replace(v->output_buffer, n);
-                v->output_buffer_allocated = v->output_buffer_size = new_size;
-                v->output_buffer_index = 0;
-        }
+        v->output_queue[v->n_output_queue++] = IOVEC_MAKE(TAKE_PTR(text), r + 1);
+        v->output_queue_size += r + 1;
 
         return 0;
 }
@@ -2465,3 +2506,179 @@ int varlink_server_set_description(VarlinkServer *s, const char *description) {
 
         return free_and_strdup(&s->description, description);
 }
+
+struct VarlinkPool {
+        char *address;
+        unsigned connections_max;
+
+        Varlink **connections;
+        size_t n_connections, n_allocated;
+
+        VarlinkReply reply_callback;
+        void *userdata;
+
+        sd_event *event;
+        int64_t priority;
+};
+
+int varlink_pool_new(VarlinkPool **ret, const char *address, unsigned connections_max) {
+        _cleanup_(varlink_pool_freep) VarlinkPool *p = NULL;
+
+        assert_return(ret, -EINVAL);
+        assert_return(address, -EINVAL);
+        assert_return(connections_max > 0, -EINVAL);
+
+        p = new(VarlinkPool, 1);
+        if (!p)
+                return -ENOMEM;
+
+        *p = (VarlinkPool) {
+                .connections_max = connections_max,
+        };
+
+        p->address = strdup(address);
+        if (!p->address)
+                return -ENOMEM;
+
+        *ret = TAKE_PTR(p);
+        return 0;
+}
+
+VarlinkPool *varlink_pool_free(VarlinkPool *p) {
+        size_t i;
+
+        if (!p)
+                return NULL;
+
+        for (i = 0; i < p->n_connections; i++)
+                varlink_flush_close_unref(p->connections[i]);
+
+        free(p->connections);
+        free(p->address);
+        sd_event_unref(p->event);
+
+        return mfree(p);
+}
+
+int varlink_pool_attach_event(VarlinkPool *p, sd_event *e, int64_t priority) {
+        size_t i;
+        int r;
+
+        assert_return(p, -EINVAL);
+        assert_return(!p->event, -EBUSY);
+
+        if (e)
+                p->event = sd_event_ref(e);
+        else {
+                r = sd_event_default(&p->event);
+                if (r < 0)
+                        return r;
+        }
+
+        p->priority = priority;
+
+        for (i = 0; i < p->n_connections; i++) {
+                r = varlink_attach_event(p->connections[i], p->event, p->priority);
+                if (r < 0)
+                        return r;
+        }
+
+        return 0;
+}
+
+int varlink_pool_bind_reply(VarlinkPool *p, VarlinkReply callback) {
+        size_t i;
+
+        assert_return(p, -EINVAL);
+
+        p->reply_callback = callback;
+
+        for (i = 0; i < p->n_connections; i++)
+                p->connections[i]->reply_callback = callback;
+
+        return 0;
+}
+
+void* varlink_pool_set_userdata(VarlinkPool *p, void *userdata) {
+        void *old;
+        size_t i;
+
+        assert_return(p, NULL);
+
+        old = p->userdata;
+        p->userdata = userdata;
+
+        for (i = 0; i < p->n_connections; i++)
+                p->connections[i]->userdata = userdata;
+
+        return old;
+}
+
+static int varlink_pool_add_connection(VarlinkPool *p, Varlink **ret) {
+        _cleanup_(varlink_close_unrefp) Varlink *v = NULL;
+        int r;
+
+        assert(p);
+        assert(ret);
+
+        if (!GREEDY_REALLOC(p->connections, p->n_allocated, p->n_connections + 1))
+                return -ENOMEM;
+
+        r = varlink_connect_address(&v, p->address);
+        if (r < 0)
+                return r;
+
+        v->reply_callback = p->reply_callback;
+        v->userdata = p->userdata;
+
+        if (p->event) {
+                r = varlink_attach_event(v, p->event, p->priority);
+                if (r < 0)
+                        return r;
+        }
+
+        *ret = p->connections[p->n_connections++] = TAKE_PTR(v);
+        return 0;
+}
+
+int varlink_pool_get(VarlinkPool *p, Varlink **ret) {
+        Varlink *best = NULL;
+        size_t i;
+
+        assert_return(p, -EINVAL);
+        assert_return(ret, -EINVAL);
+
+        /* Forget about connections that are dead */
+        for (i = 0; i < p->n_connections;) {
+                if (VARLINK_STATE_IS_ALIVE(p->connections[i]->state)) {
+                        i++;
+                        continue;
+                }
+
+                varlink_close_unref(p->connections[i]);
+                p->connections[i] = p->connections[--p->n_connections];
+        }
+
+        /* Prefer an idle connection, then a new one, and if we may not open any more, pipeline the call
+         * on the connection with the fewest calls in flight. */
+        for (i = 0; i < p->n_connections; i++) {
+                Varlink *v = p->connections[i];
+
+                if (v->state == VARLINK_IDLE_CLIENT) {
+                        *ret = v;
+                        return 0;
+                }
+
+                if (v->state == VARLINK_AWAITING_REPLY && (!best || v->n_pending < best->n_pending))
+                        best = v;
+        }
+
+        if (p->n_connections < p->connections_max)
+                return varlink_pool_add_connection(p, ret);
+
+        if (!best)
+                return -EBUSY;
+
+        *ret = best;
+        return 0;
+}
@@ -28,6 +28,7 @@
 
 typedef struct Varlink Varlink;
 typedef struct VarlinkServer VarlinkServer;
+typedef struct VarlinkPool VarlinkPool;
 
 typedef enum VarlinkReplyFlags {
         VARLINK_REPLY_ERROR     = 1 << 0,
@@ -152,10 +153,25 @@ int varlink_server_set_connections_max(VarlinkServer *s, unsigned m);
 
 int varlink_server_set_description(VarlinkServer *s, const char *description);
 
+/* A set of client connections to the same address, for clients that issue many concurrent calls. All
+ * connections share the reply callback and userdata set on the pool. varlink_pool_get() returns an idle
+ * connection, opens a new one while below the limit, and otherwise picks the connection with the fewest
+ * calls in flight, on which the next varlink_invoke() is then pipelined. Replies on each connection arrive
+ * in the order the calls were made. The returned connection remains owned by the pool. */
+int varlink_pool_new(VarlinkPool **ret, const char *address, unsigned connections_max);
+VarlinkPool *varlink_pool_free(VarlinkPool *p);
+
+int varlink_pool_attach_event(VarlinkPool *p, sd_event *e, int64_t priority);
+int varlink_pool_bind_reply(VarlinkPool *p, VarlinkReply callback);
+void* varlink_pool_set_userdata(VarlinkPool *p, void *userdata);
+
+int varlink_pool_get(VarlinkPool *p, Varlink **ret);
+
 DEFINE_TRIVIAL_CLEANUP_FUNC(Varlink *, varlink_unref);
 DEFINE_TRIVIAL_CLEANUP_FUNC(Varlink *, varlink_close_unref);
 DEFINE_TRIVIAL_CLEANUP_FUNC(Varlink *, varlink_flush_close_unref);
 DEFINE_TRIVIAL_CLEANUP_FUNC(VarlinkServer *, varlink_server_unref);
+DEFINE_TRIVIAL_CLEANUP_FUNC(VarlinkPool *, varlink_pool_free);
 
 #define VARLINK_ERROR_DISCONNECTED "io.systemd.Disconnected"
 #define VARLINK_ERROR_TIMEOUT "io.systemd.TimedOut"
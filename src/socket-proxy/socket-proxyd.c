@@ -4,8 +4,10 @@
 #include <fcntl.h>
 #include <getopt.h>
 #include <netdb.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/eventfd.h>
 #include <sys/un.h>
 #include <unistd.h>
 
@@ -24,20 +26,57 @@
 #include "resolve-private.h"
 #include "set.h"
 #include "socket-util.h"
+#include "stdio-util.h"
+#include "string-table.h"
 #include "string-util.h"
 #include "util.h"
 
 #define BUFFER_SIZE (256 * 1024)
 
+/* Creating and resizing the two pipes is the most expensive part of setting up a connection, hence the pipes
+ * of closed connections are kept for reuse, as long as they are empty. */
+#define PIPE_POOL_MAX 1024U
+
+#define THREADS_MAX 1024U
+
+typedef enum ConnectionsMaxPolicy {
+        CONNECTIONS_MAX_REFUSE,
+        CONNECTIONS_MAX_WAIT,
+        _CONNECTIONS_MAX_POLICY_MAX,
+        _CONNECTIONS_MAX_POLICY_INVALID = -1,
+} ConnectionsMaxPolicy;
+
+static const char* const connections_max_policy_table[_CONNECTIONS_MAX_POLICY_MAX] = {
+        [CONNECTIONS_MAX_REFUSE] = "refuse",
+        [CONNECTIONS_MAX_WAIT] = "wait",
+};
+
+DEFINE_PRIVATE_STRING_TABLE_LOOKUP_FROM_STRING(connections_max_policy, ConnectionsMaxPolicy);
+
 static unsigned arg_connections_max = 256;
+static ConnectionsMaxPolicy arg_connections_max_policy = CONNECTIONS_MAX_REFUSE;
+static unsigned arg_threads = 1;
 static const char *arg_remote_host = NULL;
 
+typedef struct PipeBuffer {
+        int fds[2];
+        size_t size;
+} PipeBuffer;
+
+/* Every thread has its own context, and serves the connections it accepted itself */
 typedef struct Context {
         sd_event *event;
         sd_resolve *resolve;
 
         Set *listen;
         Set *connections;
+
+        /* This thread's share of --connections-max= */
+        unsigned connections_max;
+        bool listen_paused;
+
+        PipeBuffer *pipe_pool;
+        size_t n_pipe_pool, n_pipe_pool_allocated;
 } Context;
 
 typedef struct Connection {
@@ -50,17 +89,83 @@ typedef struct Connection {
         size_t server_to_client_buffer_full, client_to_server_buffer_full;
         size_t server_to_client_buffer_size, client_to_server_buffer_size;
 
+        uint64_t server_to_client_bytes, client_to_server_bytes;
+
         sd_event_source *server_event_source, *client_event_source;
 
         sd_resolve_query *resolve_query;
 } Connection;
 
+typedef struct Worker {
+        Context context;
+        unsigned index;
+        unsigned n_listen_fds;
+
+        pthread_t thread;
+        bool running;
+
+        /* Tells the worker to exit */
+        int event_fd;
+} Worker;
+
+static void context_release_pipe(Context *context, int buffer[static 2], size_t full, size_t size) {
+        assert(context);
+        assert(buffer);
+
+        if (buffer[0] < 0)
+                return;
+
+        /* Pipes with data left in them can't be reused, and there's no point in draining them */
+        if (full > 0 ||
+            context->n_pipe_pool >= PIPE_POOL_MAX ||
+            !GREEDY_REALLOC(context->pipe_pool, context->n_pipe_pool_allocated, context->n_pipe_pool + 1)) {
+                safe_close_pair(buffer);
+                return;
+        }
+
+        context->pipe_pool[context->n_pipe_pool++] = (PipeBuffer) {
+                .fds = { buffer[0], buffer[1] },
+                .size = size,
+        };
+
+        buffer[0] = buffer[1] = -1;
+}
+
+static void context_set_listen_enabled(Context *context, bool b) {
+        sd_event_source *source;
+        Iterator i;
+        int r;
+
+        assert(context);
+
+        SET_FOREACH(source, context->listen, i) {
+                r = sd_event_source_set_enabled(source, b ? SD_EVENT_ONESHOT : SD_EVENT_OFF);
+                if (r < 0)
+                        log_warning_errno(r, "Failed to %s listener, ignoring: %m", b ? "enable" : "disable");
+        }
+
+        context->listen_paused = !b;
+}
+
 static void connection_free(Connection *c) {
         assert(c);
 
-        if (c->context)
+        log_debug("Connection closed, %" PRIu64 " bytes forwarded to the remote, %" PRIu64 " bytes from it.",
+                  c->server_to_client_bytes, c->client_to_server_bytes);
+
+        if (c->context) {
                 set_remove(c->context->connections, c);
 
+                context_release_pipe(c->context, c->server_to_client_buffer,
+                                     c->server_to_client_buffer_full, c->server_to_client_buffer_size);
+                context_release_pipe(c->context, c->client_to_server_buffer,
+                                     c->client_to_server_buffer_full, c->client_to_server_buffer_size);
+
+                if (c->context->listen_paused &&
+                    set_size(c->context->connections) < c->context->connections_max)
+                        context_set_listen_enabled(c->context, true);
+        }
+
         sd_event_source_unref(c->server_event_source);
         sd_event_source_unref(c->client_event_source);
 
@@ -76,11 +181,18 @@ static void connection_free(Connection *c) {
 }
 
 static void context_clear(Context *context) {
+        size_t i;
+
         assert(context);
 
         set_free_with_destructor(context->listen, sd_event_source_unref);
         set_free_with_destructor(context->connections, connection_free);
 
+        for (i = 0; i < context->n_pipe_pool; i++)
+                safe_close_pair(context->pipe_pool[i].fds);
+        context->pipe_pool = mfree(context->pipe_pool);
+        context->n_pipe_pool = context->n_pipe_pool_allocated = 0;
+
         sd_event_unref(context->event);
         sd_resolve_unref(context->resolve);
 }
@@ -95,6 +207,16 @@ static int connection_create_pipes(Connection *c, int buffer[static 2], size_t *
         if (buffer[0] >= 0)
                 return 0;
 
+        if (c->context->n_pipe_pool > 0) {
+                PipeBuffer *p = c->context->pipe_pool + --c->context->n_pipe_pool;
+
+                buffer[0] = p->fds[0];
+                buffer[1] = p->fds[1];
+                *sz = p->size;
+
+                return 0;
+        }
+
         r = pipe2(buffer, O_CLOEXEC|O_NONBLOCK);
         if (r < 0)
                 return log_error_errno(errno, "Failed to allocate pipe buffer: %m");
@@ -114,7 +236,7 @@ static int connection_create_pipes(Connection *c, int buffer[static 2], size_t *
 static int connection_shovel(
                 Connection *c,
                 int *from, int buffer[2], int *to,
-                size_t *full, size_t *sz,
+                size_t *full, size_t *sz, uint64_t *n_bytes,
                 sd_event_source **from_source, sd_event_source **to_source) {
 
         bool shoveled;
@@ -127,6 +249,7 @@ static int connection_shovel(
         assert(to);
         assert(full);
         assert(sz);
+        assert(n_bytes);
         assert(from_source);
         assert(to_source);
 
@@ -151,6 +274,7 @@ static int connection_shovel(
                         z = splice(buffer[0], NULL, *to, NULL, *full, SPLICE_F_MOVE|SPLICE_F_NONBLOCK);
                         if (z > 0) {
                                 *full -= z;
+                                *n_bytes += z;
                                 shoveled = true;
                         } else if (z == 0 || ERRNO_IS_DISCONNECT(errno)) {
                                 *to_source = sd_event_source_unref(*to_source);
@@ -176,6 +300,7 @@ static int traffic_cb(sd_event_source *s, int fd, uint32_t revents, void *userda
         r = connection_shovel(c,
                               &c->server_fd, c->server_to_client_buffer, &c->client_fd,
                               &c->server_to_client_buffer_full, &c->server_to_client_buffer_size,
+                              &c->server_to_client_bytes,
                               &c->server_event_source, &c->client_event_source);
         if (r < 0)
                 goto quit;
@@ -183,6 +308,7 @@ static int traffic_cb(sd_event_source *s, int fd, uint32_t revents, void *userda
         r = connection_shovel(c,
                               &c->client_fd, c->client_to_server_buffer, &c->server_fd,
                               &c->client_to_server_buffer_full, &c->client_to_server_buffer_size,
+                              &c->client_to_server_bytes,
                               &c->client_event_source, &c->server_event_source);
         if (r < 0)
                 goto quit;
@@ -419,7 +545,7 @@ static int add_connection_socket(Context *context, int fd) {
         assert(context);
         assert(fd >= 0);
 
-        if (set_size(context->connections) > arg_connections_max) {
+        if (set_size(context->connections) >= context->connections_max) {
                 log_warning("Hit connection limit, refusing connection.");
                 safe_close(fd);
                 return 0;
@@ -478,6 +604,14 @@ static int accept_cb(sd_event_source *s, int fd, uint32_t revents, void *userdat
                 }
         }
 
+        if (arg_connections_max_policy == CONNECTIONS_MAX_WAIT &&
+            set_size(context->connections) >= context->connections_max) {
+                /* Leave further connections in the listen backlog, until one of ours is closed */
+                log_debug("Hit connection limit, not accepting further connections for now.");
+                context_set_listen_enabled(context, false);
+                return 1;
+        }
+
         r = sd_event_source_set_enabled(s, SD_EVENT_ONESHOT);
         if (r < 0) {
                 log_error_errno(r, "Error while re-enabling listener with ONESHOT: %m");
@@ -532,6 +666,129 @@ static int add_listen_socket(Context *context, int fd) {
         return 0;
 }
 
+static int context_init(Context *context, unsigned n_listen_fds) {
+        int r, fd;
+
+        assert(context);
+
+        r = sd_event_default(&context->event);
+        if (r < 0)
+                return log_error_errno(r, "Failed to allocate event loop: %m");
+
+        r = sd_resolve_default(&context->resolve);
+        if (r < 0)
+                return log_error_errno(r, "Failed to allocate resolver: %m");
+
+        r = sd_resolve_attach_event(context->resolve, context->event, 0);
+        if (r < 0)
+                return log_error_errno(r, "Failed to attach resolver: %m");
+
+        context->connections_max = DIV_ROUND_UP(arg_connections_max, arg_threads);
+
+        /* All threads watch all sockets. The sources are oneshot, so that only one of them accepts a new
+         * connection, as with multiple processes sharing the sockets. */
+        for (fd = SD_LISTEN_FDS_START; fd < SD_LISTEN_FDS_START + (int) n_listen_fds; fd++) {
+                r = add_listen_socket(context, fd);
+                if (r < 0)
+                        return r;
+        }
+
+        return 0;
+}
+
+static int worker_exit_cb(sd_event_source *s, int fd, uint32_t revents, void *userdata) {
+        Worker *w = userdata;
+
+        assert(w);
+
+        return sd_event_exit(w->context.event, 0);
+}
+
+static void* worker_thread(void *userdata) {
+        Worker *w = userdata;
+        char name[STRLEN("proxy-") + DECIMAL_STR_MAX(unsigned)];
+        int r;
+
+        xsprintf(name, "proxy-%u", w->index);
+        (void) pthread_setname_np(pthread_self(), name);
+
+        /* Everything the worker owns is allocated and freed in this thread, as sets allocated by the main
+         * thread must not be freed elsewhere. */
+        r = context_init(&w->context, w->n_listen_fds);
+        if (r >= 0) {
+                r = sd_event_add_io(w->context.event, NULL, w->event_fd, EPOLLIN, worker_exit_cb, w);
+                if (r < 0)
+                        log_error_errno(r, "Failed to watch worker event fd: %m");
+        }
+        if (r >= 0) {
+                r = sd_event_loop(w->context.event);
+                if (r < 0)
+                        log_error_errno(r, "Event loop of worker %u failed: %m", w->index);
+        } else
+                log_warning("Worker %u failed to start, continuing without it.", w->index);
+
+        context_clear(&w->context);
+        return NULL;
+}
+
+static Worker* worker_free(Worker *w) {
+        if (!w)
+                return NULL;
+
+        if (w->running) {
+                if (eventfd_write(w->event_fd, 1) < 0)
+                        log_warning_errno(errno, "Failed to stop worker %u, ignoring: %m", w->index);
+                else
+                        (void) pthread_join(w->thread, NULL);
+        }
+
+        safe_close(w->event_fd);
+        return mfree(w);
+}
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(Worker*, worker_free);
+
+static int worker_new(unsigned index, unsigned n_listen_fds, Worker **ret) {
+        _cleanup_(worker_freep) Worker *w = NULL;
+        int r;
+
+        assert(ret);
+
+        w = new(Worker, 1);
+        if (!w)
+                return log_oom();
+
+        *w = (Worker) {
+                .index = index,
+                .n_listen_fds = n_listen_fds,
+                .event_fd = -1,
+        };
+
+        w->event_fd = eventfd(0, EFD_CLOEXEC|EFD_NONBLOCK);
+        if (w->event_fd < 0)
+                return log_error_errno(errno, "Failed to allocate event fd: %m");
+
+        r = pthread_create(&w->thread, NULL, worker_thread, w);
+        if (r > 0)
+                return log_error_errno(r, "Failed to start worker thread: %m");
+
+        w->running = true;
+
+        *ret = TAKE_PTR(w);
+        return 0;
+}
+
+static void workers_free(Worker **workers) {
+        Worker **w;
+
+        for (w = workers; w && *w; w++)
+                worker_free(*w);
+
+        free(workers);
+}
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(Worker**, workers_free);
+
 static int help(void) {
         _cleanup_free_ char *link = NULL;
         int r;
@@ -544,6 +801,10 @@ static int help(void) {
                "%1$s [SOCKET]\n\n"
                "Bidirectionally proxy local sockets to another (possibly remote) socket.\n\n"
                "  -c --connections-max=  Set the maximum number of connections to be accepted\n"
+               "     --connections-max-policy=refuse|wait\n"
+               "                         Refuse connections beyond the limit, or leave them\n"
+               "                         in the listen backlog\n"
+               "     --threads=N         Serve connections in N threads\n"
                "  -h --help              Show this help\n"
                "     --version           Show package version\n"
                "\nSee the %2$s for details.\n"
@@ -558,13 +819,17 @@ static int parse_argv(int argc, char *argv[]) {
 
         enum {
                 ARG_VERSION = 0x100,
-                ARG_IGNORE_ENV
+                ARG_IGNORE_ENV,
+                ARG_CONNECTIONS_MAX_POLICY,
+                ARG_THREADS,
         };
 
         static const struct option options[] = {
-                { "connections-max", required_argument, NULL, 'c'           },
-                { "help",            no_argument,       NULL, 'h'           },
-                { "version",         no_argument,       NULL, ARG_VERSION   },
+                { "connections-max",        required_argument, NULL, 'c'                        },
+                { "connections-max-policy", required_argument, NULL, ARG_CONNECTIONS_MAX_POLICY },
+                { "threads",                required_argument, NULL, ARG_THREADS                },
+                { "help",                   no_argument,       NULL, 'h'                        },
+                { "version",                no_argument,       NULL, ARG_VERSION                },
                 {}
         };
 
@@ -596,6 +861,29 @@ static int parse_argv(int argc, char *argv[]) {
 
                         break;
 
+                case ARG_CONNECTIONS_MAX_POLICY: {
+                        ConnectionsMaxPolicy p;
+
+                        p = connections_max_policy_from_string(optarg);
+                        if (p < 0)
+                                return log_error_errno(SYNTHETIC_ERRNO(EINVAL),
+                                                       "Failed to parse --connections-max-policy= argument: %s", optarg);
+
+                        arg_connections_max_policy = p;
+                        break;
+                }
+
+                case ARG_THREADS:
+                        r = safe_atou(optarg, &arg_threads);
+                        if (r < 0)
+                                return log_error_errno(r, "Failed to parse --threads= argument: %s", optarg);
+
+                        if (arg_threads < 1 || arg_threads > THREADS_MAX)
+                                return log_error_errno(SYNTHETIC_ERRNO(ERANGE),
+                                                       "Number of threads must be between 1 and %u.", THREADS_MAX);
+
+                        break;
+
                 case '?':
                         return -EINVAL;
 
@@ -617,7 +905,9 @@ static int parse_argv(int argc, char *argv[]) {
 
 static int run(int argc, char *argv[]) {
         _cleanup_(context_clear) Context context = {};
-        int r, n, fd;
+        _cleanup_(workers_freep) Worker **workers = NULL;
+        unsigned i;
+        int r, n;
 
         log_parse_environment();
         log_open();
@@ -626,20 +916,6 @@ static int run(int argc, char *argv[]) {
         if (r <= 0)
                 return r;
 
-        r = sd_event_default(&context.event);
-        if (r < 0)
-                return log_error_errno(r, "Failed to allocate event loop: %m");
-
-        r = sd_resolve_default(&context.resolve);
-        if (r < 0)
-                return log_error_errno(r, "Failed to allocate resolver: %m");
-
-        r = sd_resolve_attach_event(context.resolve, context.event, 0);
-        if (r < 0)
-                return log_error_errno(r, "Failed to attach resolver: %m");
-
-        sd_event_set_watchdog(context.event, true);
-
         r = sd_listen_fds(1);
         if (r < 0)
                 return log_error_errno(r, "Failed to receive sockets from parent.");
@@ -648,8 +924,19 @@ static int run(int argc, char *argv[]) {
 
         n = r;
 
-        for (fd = SD_LISTEN_FDS_START; fd < SD_LISTEN_FDS_START + n; fd++) {
-                r = add_listen_socket(&context, fd);
+        r = context_init(&context, n);
+        if (r < 0)
+                return r;
+
+        sd_event_set_watchdog(context.event, true);
+
+        /* The main thread serves connections too, hence one worker less */
+        workers = new0(Worker*, arg_threads);
+        if (!workers)
+                return log_oom();
+
+        for (i = 0; i < arg_threads - 1; i++) {
+                r = worker_new(i + 1, n, workers + i);
                 if (r < 0)
                         return r;
         }
@@ -572,25 +572,21 @@ static int output_units_list(const UnitInfo *unit_infos, unsigned c) {
         return 0;
 }
 
-static int get_unit_list(
+/* Invoked for every listed unit if properties are requested along with the list. If the manager returned
+ * them, the message is positioned at their "a{sv}" array, which needs to be consumed. If the manager is too
+ * old to do that, NULL is passed instead, and the properties need to be queried individually on the bus. */
+typedef int (*UnitPropertiesCallback)(sd_bus *bus, const UnitInfo *u, sd_bus_message *properties, void *userdata);
+
+static int call_list_units(
                 sd_bus *bus,
-                const char *machine,
+                const char *method,
                 char **patterns,
-                UnitInfo **unit_infos,
-                int c,
-                sd_bus_message **_reply) {
+                char **properties,
+                sd_bus_error *error,
+                sd_bus_message **reply) {
 
         _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL;
-        _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
-        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
-        size_t size = c;
         int r;
-        UnitInfo u;
-        bool fallback = false;
-
-        assert(bus);
-        assert(unit_infos);
-        assert(_reply);
 
         r = sd_bus_message_new_method_call(
                         bus,
@@ -598,7 +594,7 @@ static int get_unit_list(
                         "org.freedesktop.systemd1",
                         "/org/freedesktop/systemd1",
                         "org.freedesktop.systemd1.Manager",
-                        "ListUnitsByPatterns");
+                        method);
         if (r < 0)
                 return bus_log_create_error(r);
 
@@ -606,52 +602,140 @@ static int get_unit_list(
         if (r < 0)
                 return bus_log_create_error(r);
 
-        r = sd_bus_message_append_strv(m, patterns);
-        if (r < 0)
-                return bus_log_create_error(r);
-
-        r = sd_bus_call(bus, m, 0, &error, &reply);
-        if (r < 0 && (sd_bus_error_has_name(&error, SD_BUS_ERROR_UNKNOWN_METHOD) ||
-                      sd_bus_error_has_name(&error, SD_BUS_ERROR_ACCESS_DENIED))) {
-                /* Fallback to legacy ListUnitsFiltered method */
-                fallback = true;
-                log_debug_errno(r, "Failed to list units: %s Falling back to ListUnitsFiltered method.", bus_error_message(&error, r));
-                m = sd_bus_message_unref(m);
-                sd_bus_error_free(&error);
-
-                r = sd_bus_message_new_method_call(
-                                bus,
-                                &m,
-                                "org.freedesktop.systemd1",
-                                "/org/freedesktop/systemd1",
-                                "org.freedesktop.systemd1.Manager",
-                                "ListUnitsFiltered");
+        if (!streq(method, "ListUnitsFiltered")) {
+                r = sd_bus_message_append_strv(m, patterns);
                 if (r < 0)
                         return bus_log_create_error(r);
+        }
 
-                r = sd_bus_message_append_strv(m, arg_states);
+        if (streq(method, "ListUnitsWithProperties")) {
+                r = sd_bus_message_append_strv(m, properties);
                 if (r < 0)
                         return bus_log_create_error(r);
+        }
 
-                r = sd_bus_call(bus, m, 0, &error, &reply);
+        return sd_bus_call(bus, m, 0, error, reply);
+}
+
+static bool list_units_method_missing(const sd_bus_error *error) {
+        return sd_bus_error_has_name(error, SD_BUS_ERROR_UNKNOWN_METHOD) ||
+               sd_bus_error_has_name(error, SD_BUS_ERROR_ACCESS_DENIED);
+}
+
+static int get_unit_list(
+                sd_bus *bus,
+                const char *machine,
+                char **patterns,
+                char **properties,
+                UnitPropertiesCallback callback,
+                void *userdata,
+                UnitInfo **unit_infos,
+                int c,
+                sd_bus_message **_reply) {
+
+        _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
+        _cleanup_strv_free_ char **type_patterns = NULL;
+        size_t size = c;
+        int r;
+        bool with_properties = !!properties, fallback = false;
+
+        assert(bus);
+        assert(unit_infos);
+        assert(_reply);
+        assert(!properties || callback);
+
+        /* Unit types are filtered on our side in any case, but let the manager skip everything of the wrong
+         * type already if no patterns were specified, so that we don't get sent all units. */
+        if (strv_isempty(patterns) && !strv_isempty(arg_types)) {
+                char **t;
+
+                STRV_FOREACH(t, arg_types) {
+                        char *p;
+
+                        p = strjoin("*.", *t);
+                        if (!p)
+                                return log_oom();
+
+                        if (strv_consume(&type_patterns, p) < 0)
+                                return log_oom();
+                }
+
+                patterns = type_patterns;
+        }
+
+        if (with_properties) {
+                r = call_list_units(bus, "ListUnitsWithProperties", patterns, properties, &error, &reply);
+                if (r < 0 && list_units_method_missing(&error)) {
+                        /* Fallback to ListUnitsByPatterns, the properties are then queried per unit */
+                        with_properties = false;
+                        log_debug_errno(r, "Failed to list units: %s Falling back to ListUnitsByPatterns method.", bus_error_message(&error, r));
+                        sd_bus_error_free(&error);
+                }
+        }
+
+        if (!with_properties) {
+                r = call_list_units(bus, "ListUnitsByPatterns", patterns, NULL, &error, &reply);
+                if (r < 0 && list_units_method_missing(&error)) {
+                        /* Fallback to legacy ListUnitsFiltered method */
+                        fallback = true;
+                        log_debug_errno(r, "Failed to list units: %s Falling back to ListUnitsFiltered method.", bus_error_message(&error, r));
+                        sd_bus_error_free(&error);
+
+                        r = call_list_units(bus, "ListUnitsFiltered", NULL, NULL, &error, &reply);
+                }
         }
         if (r < 0)
                 return log_error_errno(r, "Failed to list units: %s", bus_error_message(&error, r));
 
-        r = sd_bus_message_enter_container(reply, SD_BUS_TYPE_ARRAY, "(ssssssouso)");
+        r = sd_bus_message_enter_container(reply, SD_BUS_TYPE_ARRAY, with_properties ? "(ssssssousoa{sv})" : "(ssssssouso)");
         if (r < 0)
                 return bus_log_parse_error(r);
 
-        while ((r = bus_parse_unit_info(reply, &u)) > 0) {
+        for (;;) {
+                UnitInfo u;
+
+                if (with_properties) {
+                        r = sd_bus_message_enter_container(reply, SD_BUS_TYPE_STRUCT, "ssssssousoa{sv}");
+                        if (r <= 0)
+                                break;
+
+                        u = (UnitInfo) {};
+                        r = sd_bus_message_read(reply, "ssssssouso",
+                                                &u.id, &u.description, &u.load_state, &u.active_state, &u.sub_state,
+                                                &u.following, &u.unit_path, &u.job_id, &u.job_type, &u.job_path);
+                        if (r < 0)
+                                break;
+                } else {
+                        r = bus_parse_unit_info(reply, &u);
+                        if (r <= 0)
+                                break;
+                }
+
                 u.machine = machine;
 
-                if (!output_show_unit(&u, fallback ? patterns : NULL))
-                        continue;
+                if (output_show_unit(&u, fallback ? patterns : NULL)) {
+                        if (!GREEDY_REALLOC(*unit_infos, size, c+1))
+                                return log_oom();
 
-                if (!GREEDY_REALLOC(*unit_infos, size, c+1))
-                        return log_oom();
+                        (*unit_infos)[c++] = u;
 
-                (*unit_infos)[c++] = u;
+                        if (callback) {
+                                r = callback(bus, &u, with_properties ? reply : NULL, userdata);
+                                if (r < 0)
+                                        return r;
+                        }
+                } else if (with_properties) {
+                        r = sd_bus_message_skip(reply, "a{sv}");
+                        if (r < 0)
+                                break;
+                }
+
+                if (with_properties) {
+                        r = sd_bus_message_exit_container(reply);
+                        if (r < 0)
+                                break;
+                }
         }
         if (r < 0)
                 return bus_log_parse_error(r);
@@ -672,6 +756,9 @@ static void message_set_freep(Set **set) {
 static int get_unit_list_recursive(
                 sd_bus *bus,
                 char **patterns,
+                char **properties,
+                UnitPropertiesCallback callback,
+                void *userdata,
                 UnitInfo **_unit_infos,
                 Set **_replies,
                 char ***_machines) {
@@ -690,7 +777,7 @@ static int get_unit_list_recursive(
         if (!replies)
                 return log_oom();
 
-        c = get_unit_list(bus, NULL, patterns, &unit_infos, 0, &reply);
+        c = get_unit_list(bus, NULL, patterns, properties, callback, userdata, &unit_infos, 0, &reply);
         if (c < 0)
                 return c;
 
@@ -718,7 +805,7 @@ static int get_unit_list_recursive(
                                 continue;
                         }
 
-                        k = get_unit_list(container, *i, patterns, &unit_infos, c, &reply);
+                        k = get_unit_list(container, *i, patterns, properties, callback, userdata, &unit_infos, c, &reply);
                         if (k < 0)
                                 return k;
 
@@ -773,7 +860,7 @@ static int expand_names(sd_bus *bus, char **names, const char* suffix, char ***r
                 _cleanup_free_ UnitInfo *unit_infos = NULL;
                 size_t allocated, n;
 
-                r = get_unit_list(bus, NULL, globs, &unit_infos, 0, &reply);
+                r = get_unit_list(bus, NULL, globs, NULL, NULL, NULL, &unit_infos, 0, &reply);
                 if (r < 0)
                         return r;
 
@@ -812,7 +899,7 @@ static int list_units(int argc, char *argv[], void *userdata) {
 
         (void) pager_open(arg_pager_flags);
 
-        r = get_unit_list_recursive(bus, strv_skip(argv, 1), &unit_infos, &replies, &machines);
+        r = get_unit_list_recursive(bus, strv_skip(argv, 1), NULL, NULL, NULL, &unit_infos, &replies, &machines);
         if (r < 0)
                 return r;
 
@@ -846,6 +933,46 @@ static int get_triggered_units(
         return 0;
 }
 
+static int read_listening(sd_bus_message *m, char ***listening) {
+        const char *type, *path;
+        int r, n = 0;
+
+        assert(m);
+        assert(listening);
+
+        r = sd_bus_message_enter_container(m, SD_BUS_TYPE_ARRAY, "(ss)");
+        if (r < 0)
+                return r;
+
+        while ((r = sd_bus_message_read(m, "(ss)", &type, &path)) > 0) {
+
+                r = strv_extend(listening, type);
+                if (r < 0)
+                        return r;
+
+                r = strv_extend(listening, path);
+                if (r < 0)
+                        return r;
+
+                n++;
+        }
+        if (r < 0)
+                return r;
+
+        r = sd_bus_message_exit_container(m);
+        if (r < 0)
+                return r;
+
+        return n;
+}
+
+static int map_listening(sd_bus *bus, const char *member, sd_bus_message *m, sd_bus_error *error, void *userdata) {
+        int r;
+
+        r = read_listening(m, userdata);
+        return r < 0 ? r : 0;
+}
+
 static int get_listening(
                 sd_bus *bus,
                 const char* unit_path,
@@ -853,8 +980,7 @@ static int get_listening(
 
         _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
         _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
-        const char *type, *path;
-        int r, n = 0;
+        int r;
 
         r = sd_bus_get_property(
                         bus,
@@ -868,30 +994,13 @@ static int get_listening(
         if (r < 0)
                 return log_error_errno(r, "Failed to get list of listening sockets: %s", bus_error_message(&error, r));
 
-        r = sd_bus_message_enter_container(reply, SD_BUS_TYPE_ARRAY, "(ss)");
-        if (r < 0)
-                return bus_log_parse_error(r);
-
-        while ((r = sd_bus_message_read(reply, "(ss)", &type, &path)) > 0) {
-
-                r = strv_extend(listening, type);
-                if (r < 0)
-                        return log_oom();
-
-                r = strv_extend(listening, path);
-                if (r < 0)
-                        return log_oom();
-
-                n++;
-        }
-        if (r < 0)
-                return bus_log_parse_error(r);
-
-        r = sd_bus_message_exit_container(reply);
+        r = read_listening(reply, listening);
+        if (r == -ENOMEM)
+                return log_oom();
         if (r < 0)
                 return bus_log_parse_error(r);
 
-        return n;
+        return r;
 }
 
 struct socket_info {
@@ -1006,16 +1115,87 @@ static int output_sockets_list(struct socket_info *socket_infos, unsigned cs) {
         return 0;
 }
 
+struct socket_properties {
+        char **triggered;
+        char **listening;
+};
+
+struct socket_list {
+        struct socket_info *infos;
+        size_t size;
+        unsigned n;
+};
+
+static int socket_list_add(sd_bus *bus, const UnitInfo *u, sd_bus_message *properties, void *userdata) {
+        static const struct bus_properties_map map[] = {
+                { "Triggers", "as",    NULL,          offsetof(struct socket_properties, triggered) },
+                { "Listen",   "a(ss)", map_listening, offsetof(struct socket_properties, listening) },
+                {}
+        };
+
+        _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
+        _cleanup_strv_free_ char **listening = NULL, **triggered = NULL;
+        struct socket_list *l = userdata;
+        size_t i, c;
+        int r;
+
+        assert(bus);
+        assert(u);
+        assert(l);
+
+        if (!endswith(u->id, ".socket"))
+                return properties ? sd_bus_message_skip(properties, "a{sv}") : 0;
+
+        if (properties) {
+                struct socket_properties p = {};
+
+                r = bus_message_map_all_properties(properties, map, 0, &error, &p);
+                triggered = p.triggered;
+                listening = p.listening;
+                if (r < 0)
+                        return log_error_errno(r, "Failed to parse properties of %s: %s", u->id, bus_error_message(&error, r));
+        } else {
+                r = get_triggered_units(bus, u->unit_path, &triggered);
+                if (r < 0)
+                        return r;
+
+                r = get_listening(bus, u->unit_path, &listening);
+                if (r < 0)
+                        return r;
+        }
+
+        c = strv_length(listening) / 2;
+        if (c == 0)
+                return 0;
+
+        if (!GREEDY_REALLOC(l->infos, l->size, l->n + c))
+                return log_oom();
+
+        for (i = 0; i < c; i++)
+                l->infos[l->n + i] = (struct socket_info) {
+                        .machine = u->machine,
+                        .id = u->id,
+                        .type = listening[i*2],
+                        .path = listening[i*2 + 1],
+                        .triggered = triggered,
+                        .own_triggered = i==0,
+                };
+
+        /* from this point on the socket list owns those strings */
+        l->n += c;
+        listening = mfree(listening);
+        triggered = NULL;
+
+        return 0;
+}
+
 static int list_sockets(int argc, char *argv[], void *userdata) {
         _cleanup_(message_set_freep) Set *replies = NULL;
         _cleanup_strv_free_ char **machines = NULL;
         _cleanup_strv_free_ char **sockets_with_suffix = NULL;
         _cleanup_free_ UnitInfo *unit_infos = NULL;
-        _cleanup_free_ struct socket_info *socket_infos = NULL;
-        const UnitInfo *u;
+        struct socket_list l = {};
         struct socket_info *s;
-        unsigned cs = 0;
-        size_t size = 0;
         int r = 0, n;
         sd_bus *bus;
 
@@ -1030,61 +1210,28 @@ static int list_sockets(int argc, char *argv[], void *userdata) {
                 return r;
 
         if (argc == 1 || sockets_with_suffix) {
-                n = get_unit_list_recursive(bus, sockets_with_suffix, &unit_infos, &replies, &machines);
-                if (n < 0)
-                        return n;
-
-                for (u = unit_infos; u < unit_infos + n; u++) {
-                        _cleanup_strv_free_ char **listening = NULL, **triggered = NULL;
-                        int i, c;
-
-                        if (!endswith(u->id, ".socket"))
-                                continue;
-
-                        r = get_triggered_units(bus, u->unit_path, &triggered);
-                        if (r < 0)
-                                goto cleanup;
-
-                        c = get_listening(bus, u->unit_path, &listening);
-                        if (c < 0) {
-                                r = c;
-                                goto cleanup;
-                        }
-
-                        if (!GREEDY_REALLOC(socket_infos, size, cs + c)) {
-                                r = log_oom();
-                                goto cleanup;
-                        }
-
-                        for (i = 0; i < c; i++)
-                                socket_infos[cs + i] = (struct socket_info) {
-                                        .machine = u->machine,
-                                        .id = u->id,
-                                        .type = listening[i*2],
-                                        .path = listening[i*2 + 1],
-                                        .triggered = triggered,
-                                        .own_triggered = i==0,
-                                };
-
-                        /* from this point on we will cleanup those socket_infos */
-                        cs += c;
-                        free(listening);
-                        listening = triggered = NULL; /* avoid cleanup */
+                n = get_unit_list_recursive(bus, sockets_with_suffix ?: STRV_MAKE("*.socket"),
+                                            STRV_MAKE("Triggers", "Listen"), socket_list_add, &l,
+                                            &unit_infos, &replies, &machines);
+                if (n < 0) {
+                        r = n;
+                        goto cleanup;
                 }
 
-                typesafe_qsort(socket_infos, cs, socket_info_compare);
+                typesafe_qsort(l.infos, l.n, socket_info_compare);
         }
 
-        output_sockets_list(socket_infos, cs);
+        output_sockets_list(l.infos, l.n);
 
  cleanup:
-        assert(cs == 0 || socket_infos);
-        for (s = socket_infos; s < socket_infos + cs; s++) {
+        assert(l.n == 0 || l.infos);
+        for (s = l.infos; s < l.infos + l.n; s++) {
                 free(s->type);
                 free(s->path);
                 if (s->own_triggered)
                         strv_free(s->triggered);
         }
+        free(l.infos);
 
         return r;
 }
@@ -1317,19 +1464,81 @@ static usec_t calc_next_elapse(dual_timestamp *nw, dual_timestamp *next) {
         return next_elapse;
 }
 
+struct timer_properties {
+        char **triggered;
+        dual_timestamp next;
+        usec_t last_trigger;
+};
+
+struct timer_list {
+        struct timer_info *infos;
+        size_t size;
+        unsigned n;
+        dual_timestamp nw;
+};
+
+static int timer_list_add(sd_bus *bus, const UnitInfo *u, sd_bus_message *properties, void *userdata) {
+        static const struct bus_properties_map map[] = {
+                { "Triggers",                "as", NULL, offsetof(struct timer_properties, triggered)      },
+                { "NextElapseUSecMonotonic", "t",  NULL, offsetof(struct timer_properties, next.monotonic) },
+                { "NextElapseUSecRealtime",  "t",  NULL, offsetof(struct timer_properties, next.realtime)  },
+                { "LastTriggerUSec",         "t",  NULL, offsetof(struct timer_properties, last_trigger)   },
+                {}
+        };
+
+        _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
+        _cleanup_strv_free_ char **triggered = NULL;
+        struct timer_properties p = {};
+        struct timer_list *l = userdata;
+        int r;
+
+        assert(bus);
+        assert(u);
+        assert(l);
+
+        if (!endswith(u->id, ".timer"))
+                return properties ? sd_bus_message_skip(properties, "a{sv}") : 0;
+
+        if (properties) {
+                r = bus_message_map_all_properties(properties, map, 0, &error, &p);
+                triggered = p.triggered;
+                if (r < 0)
+                        return log_error_errno(r, "Failed to parse properties of %s: %s", u->id, bus_error_message(&error, r));
+        } else {
+                r = get_triggered_units(bus, u->unit_path, &triggered);
+                if (r < 0)
+                        return r;
+
+                r = get_next_elapse(bus, u->unit_path, &p.next);
+                if (r < 0)
+                        return r;
+
+                get_last_trigger(bus, u->unit_path, &p.last_trigger);
+        }
+
+        if (!GREEDY_REALLOC(l->infos, l->size, l->n+1))
+                return log_oom();
+
+        l->infos[l->n++] = (struct timer_info) {
+                .machine = u->machine,
+                .id = u->id,
+                .next_elapse = calc_next_elapse(&l->nw, &p.next),
+                .last_trigger = p.last_trigger,
+                .triggered = TAKE_PTR(triggered),
+        };
+
+        return 0;
+}
+
 static int list_timers(int argc, char *argv[], void *userdata) {
         _cleanup_(message_set_freep) Set *replies = NULL;
         _cleanup_strv_free_ char **machines = NULL;
         _cleanup_strv_free_ char **timers_with_suffix = NULL;
-        _cleanup_free_ struct timer_info *timer_infos = NULL;
         _cleanup_free_ UnitInfo *unit_infos = NULL;
+        struct timer_list l = {};
         struct timer_info *t;
-        const UnitInfo *u;
-        size_t size = 0;
-        int n, c = 0;
-        dual_timestamp nw;
         sd_bus *bus;
-        int r = 0;
+        int r = 0, n;
 
         r = acquire_bus(BUS_MANAGER, &bus);
         if (r < 0)
@@ -1342,54 +1551,26 @@ static int list_timers(int argc, char *argv[], void *userdata) {
                 return r;
 
         if (argc == 1 || timers_with_suffix) {
-                n = get_unit_list_recursive(bus, timers_with_suffix, &unit_infos, &replies, &machines);
-                if (n < 0)
-                        return n;
-
-                dual_timestamp_get(&nw);
-
-                for (u = unit_infos; u < unit_infos + n; u++) {
-                        _cleanup_strv_free_ char **triggered = NULL;
-                        dual_timestamp next = DUAL_TIMESTAMP_NULL;
-                        usec_t m, last = 0;
-
-                        if (!endswith(u->id, ".timer"))
-                                continue;
-
-                        r = get_triggered_units(bus, u->unit_path, &triggered);
-                        if (r < 0)
-                                goto cleanup;
-
-                        r = get_next_elapse(bus, u->unit_path, &next);
-                        if (r < 0)
-                                goto cleanup;
-
-                        get_last_trigger(bus, u->unit_path, &last);
-
-                        if (!GREEDY_REALLOC(timer_infos, size, c+1)) {
-                                r = log_oom();
-                                goto cleanup;
-                        }
-
-                        m = calc_next_elapse(&nw, &next);
-
-                        timer_infos[c++] = (struct timer_info) {
-                                .machine = u->machine,
-                                .id = u->id,
-                                .next_elapse = m,
-                                .last_trigger = last,
-                                .triggered = TAKE_PTR(triggered),
-                        };
+                dual_timestamp_get(&l.nw);
+
+                n = get_unit_list_recursive(bus, timers_with_suffix ?: STRV_MAKE("*.timer"),
+                                            STRV_MAKE("Triggers", "NextElapseUSecMonotonic", "NextElapseUSecRealtime", "LastTriggerUSec"),
+                                            timer_list_add, &l,
+                                            &unit_infos, &replies, &machines);
+                if (n < 0) {
+                        r = n;
+                        goto cleanup;
                 }
 
-                typesafe_qsort(timer_infos, c, timer_info_compare);
+                typesafe_qsort(l.infos, l.n, timer_info_compare);
         }
 
-        output_timers_list(timer_infos, c);
+        output_timers_list(l.infos, l.n);
 
  cleanup:
-        for (t = timer_infos; t < timer_infos + c; t++)
+        for (t = l.infos; t < l.infos + l.n; t++)
                 strv_free(t->triggered);
+        free(l.infos);
 
         return r;
 }
@@ -2676,7 +2857,7 @@ static int unit_find_paths(
                 }
 
                 if (ret_dropin_paths) {
-                        r = unit_file_find_dropin_paths(arg_root, lp->search_path, NULL,
+                        r = unit_file_find_dropin_paths(arg_root, lp->search_path, NULL, NULL,
                                                         ".d", ".conf",
                                                         names, &dropins);
                         if (r < 0)
@@ -5514,9 +5695,9 @@ static const char* const systemctl_show_mode_table[_SYSTEMCTL_SHOW_MODE_MAX] = {
 
 DEFINE_PRIVATE_STRING_TABLE_LOOKUP_FROM_STRING(systemctl_show_mode, SystemctlShowMode);
 
-static int show_one(
+static int show_one_reply(
                 sd_bus *bus,
-                const char *path,
+                sd_bus_message *reply,
                 const char *unit,
                 SystemctlShowMode show_mode,
                 bool *new_line,
@@ -5612,7 +5793,6 @@ static int show_one(
                 {}
         };
 
-        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
         _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
         _cleanup_set_free_ Set *found_properties = NULL;
         _cleanup_(unit_status_info_free) UnitStatusInfo info = {
@@ -5632,19 +5812,14 @@ static int show_one(
         char **pp;
         int r;
 
-        assert(path);
+        assert(reply);
         assert(new_line);
 
-        log_debug("Showing one %s", path);
-
-        r = bus_map_all_properties(
-                        bus,
-                        "org.freedesktop.systemd1",
-                        path,
+        r = bus_message_map_all_properties(
+                        reply,
                         show_mode == SYSTEMCTL_SHOW_STATUS ? status_map : property_map,
                         BUS_MAP_BOOLEAN_AS_BOOL,
                         &error,
-                        &reply,
                         &info);
         if (r < 0)
                 return log_error_errno(r, "Failed to get properties: %s", bus_error_message(&error, r));
@@ -5692,6 +5867,110 @@ static int show_one(
         return 0;
 }
 
+static int show_one(
+                sd_bus *bus,
+                const char *path,
+                const char *unit,
+                SystemctlShowMode show_mode,
+                bool *new_line,
+                bool *ellipsized) {
+
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
+        _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
+        int r;
+
+        assert(path);
+
+        log_debug("Showing one %s", path);
+
+        r = sd_bus_call_method(
+                        bus,
+                        "org.freedesktop.systemd1",
+                        path,
+                        "org.freedesktop.DBus.Properties",
+                        "GetAll",
+                        &error,
+                        &reply,
+                        "s", "");
+        if (r < 0)
+                return log_error_errno(r, "Failed to get properties: %s", bus_error_message(&error, r));
+
+        return show_one_reply(bus, reply, unit, show_mode, new_line, ellipsized);
+}
+
+typedef struct ShowContext {
+        sd_bus *bus;
+        SystemctlShowMode show_mode;
+        bool *new_line;
+        bool *ellipsized;
+        int ret;
+} ShowContext;
+
+static int show_many_reply(const char *path, sd_bus_message *reply, const sd_bus_error *error, void *userdata) {
+        ShowContext *c = userdata;
+        _cleanup_free_ char *unit = NULL;
+        int r;
+
+        assert(path);
+        assert(c);
+
+        if (error) {
+                r = sd_bus_error_get_errno(error);
+                return log_error_errno(r, "Failed to get properties: %s", bus_error_message(error, r));
+        }
+
+        r = unit_name_from_dbus_path(path, &unit);
+        if (r < 0)
+                return log_oom();
+
+        r = show_one_reply(c->bus, reply, unit, c->show_mode, c->new_line, c->ellipsized);
+        if (r < 0)
+                return r;
+        if (r > 0 && c->ret == 0)
+                c->ret = r;
+
+        return 0;
+}
+
+static int show_many(
+                sd_bus *bus,
+                char **names,
+                SystemctlShowMode show_mode,
+                bool *new_line,
+                bool *ellipsized) {
+
+        _cleanup_strv_free_ char **paths = NULL;
+        ShowContext c = {
+                .bus = bus,
+                .show_mode = show_mode,
+                .new_line = new_line,
+                .ellipsized = ellipsized,
+        };
+        char **name;
+        int r;
+
+        /* Like show_one() for each unit, but doesn't wait for each unit's properties before asking for the
+         * next, which matters when there are many. */
+
+        STRV_FOREACH(name, names) {
+                char *p;
+
+                p = unit_dbus_path_from_name(*name);
+                if (!p)
+                        return log_oom();
+
+                r = strv_consume(&paths, p);
+                if (r < 0)
+                        return log_oom();
+        }
+
+        r = bus_get_all_properties_pipelined(bus, "org.freedesktop.systemd1", paths, NULL, show_many_reply, &c);
+        if (r < 0)
+                return r == -ENOMEM ? log_oom() : r;
+
+        return c.ret;
+}
+
 static int get_unit_dbus_path_by_pid(
                 sd_bus *bus,
                 uint32_t pid,
@@ -5733,11 +6012,11 @@ static int show_all(
 
         _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
         _cleanup_free_ UnitInfo *unit_infos = NULL;
-        const UnitInfo *u;
-        unsigned c;
-        int r, ret = 0;
+        _cleanup_free_ char **names = NULL;
+        unsigned c, i;
+        int r;
 
-        r = get_unit_list(bus, NULL, NULL, &unit_infos, 0, &reply);
+        r = get_unit_list(bus, NULL, NULL, NULL, NULL, NULL, &unit_infos, 0, &reply);
         if (r < 0)
                 return r;
 
@@ -5747,21 +6026,16 @@ static int show_all(
 
         typesafe_qsort(unit_infos, c, compare_unit_info);
 
-        for (u = unit_infos; u < unit_infos + c; u++) {
-                _cleanup_free_ char *p = NULL;
-
-                p = unit_dbus_path_from_name(u->id);
-                if (!p)
-                        return log_oom();
+        /* The names point into the reply, hence only free the array */
+        names = new(char*, c + 1);
+        if (!names)
+                return log_oom();
 
-                r = show_one(bus, p, u->id, SYSTEMCTL_SHOW_STATUS, new_line, ellipsized);
-                if (r < 0)
-                        return r;
-                else if (r > 0 && ret == 0)
-                        ret = r;
-        }
+        for (i = 0; i < c; i++)
+                names[i] = (char*) unit_infos[i].id;
+        names[c] = NULL;
 
-        return ret;
+        return show_many(bus, names, SYSTEMCTL_SHOW_STATUS, new_line, ellipsized);
 }
 
 static int show_system_status(sd_bus *bus) {
@@ -5909,19 +6183,11 @@ static int show(int argc, char *argv[], void *userdata) {
                         if (r < 0)
                                 return log_error_errno(r, "Failed to expand names: %m");
 
-                        STRV_FOREACH(name, names) {
-                                _cleanup_free_ char *path;
-
-                                path = unit_dbus_path_from_name(*name);
-                                if (!path)
-                                        return log_oom();
-
-                                r = show_one(bus, path, *name, show_mode, &new_line, &ellipsized);
-                                if (r < 0)
-                                        return r;
-                                if (r > 0 && ret == 0)
-                                        ret = r;
-                        }
+                        r = show_many(bus, names, show_mode, &new_line, &ellipsized);
+                        if (r < 0)
+                                return r;
+                        if (r > 0 && ret == 0)
+                                ret = r;
                 }
         }
 
@@ -46,6 +46,7 @@ typedef struct sd_bus_message sd_bus_message;
 typedef struct sd_bus_slot sd_bus_slot;
 typedef struct sd_bus_creds sd_bus_creds;
 typedef struct sd_bus_track sd_bus_track;
+typedef struct sd_bus_property_cache sd_bus_property_cache;
 
 typedef struct {
         const char *name;
@@ -226,6 +227,7 @@ int sd_bus_add_object_vtable(sd_bus *bus, sd_bus_slot **slot, const char *path,
 int sd_bus_add_fallback_vtable(sd_bus *bus, sd_bus_slot **slot, const char *prefix, const char *interface, const sd_bus_vtable *vtable, sd_bus_object_find_t find, void *userdata);
 int sd_bus_add_node_enumerator(sd_bus *bus, sd_bus_slot **slot, const char *path, sd_bus_node_enumerator_t callback, void *userdata);
 int sd_bus_add_object_manager(sd_bus *bus, sd_bus_slot **slot, const char *path);
+int sd_bus_object_invalidate_properties(sd_bus *bus, const char *path, const char *interface);
 
 /* Slot object */
 
@@ -499,6 +501,20 @@ const char* sd_bus_track_next(sd_bus_track *track);
 int sd_bus_track_set_destroy_callback(sd_bus_track *s, sd_bus_destroy_t callback);
 int sd_bus_track_get_destroy_callback(sd_bus_track *s, sd_bus_destroy_t *ret);
 
+/* Property caches */
+
+int sd_bus_property_cache_new(sd_bus *bus, sd_bus_property_cache **ret, const char *destination, const char *path, const char *interface);
+sd_bus_property_cache* sd_bus_property_cache_ref(sd_bus_property_cache *c);
+sd_bus_property_cache* sd_bus_property_cache_unref(sd_bus_property_cache *c);
+
+sd_bus* sd_bus_property_cache_get_bus(sd_bus_property_cache *c);
+int sd_bus_property_cache_invalidate(sd_bus_property_cache *c);
+
+int sd_bus_property_cache_get(sd_bus_property_cache *c, const char *member, sd_bus_error *ret_error, sd_bus_message **reply, const char *type);
+int sd_bus_property_cache_get_trivial(sd_bus_property_cache *c, const char *member, sd_bus_error *ret_error, char type, void *ret_ptr);
+int sd_bus_property_cache_get_string(sd_bus_property_cache *c, const char *member, sd_bus_error *ret_error, char **ret); /* free the result! */
+int sd_bus_property_cache_get_strv(sd_bus_property_cache *c, const char *member, sd_bus_error *ret_error, char ***ret); /* free the result! */
+
 /* Define helpers so that __attribute__((cleanup(sd_bus_unrefp))) and similar may be used. */
 _SD_DEFINE_POINTER_CLEANUP_FUNC(sd_bus, sd_bus_unref);
 _SD_DEFINE_POINTER_CLEANUP_FUNC(sd_bus, sd_bus_close_unref);
@@ -507,6 +523,7 @@ _SD_DEFINE_POINTER_CLEANUP_FUNC(sd_bus_slot, sd_bus_slot_unref);
 _SD_DEFINE_POINTER_CLEANUP_FUNC(sd_bus_message, sd_bus_message_unref);
 _SD_DEFINE_POINTER_CLEANUP_FUNC(sd_bus_creds, sd_bus_creds_unref);
 _SD_DEFINE_POINTER_CLEANUP_FUNC(sd_bus_track, sd_bus_track_unref);
+_SD_DEFINE_POINTER_CLEANUP_FUNC(sd_bus_property_cache, sd_bus_property_cache_unref);
 
 _SD_END_DECLARATIONS;
 
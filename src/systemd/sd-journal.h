@@ -69,6 +69,7 @@ enum {
         SD_JOURNAL_SYSTEM       = 1 << 2,
         SD_JOURNAL_CURRENT_USER = 1 << 3,
         SD_JOURNAL_OS_ROOT      = 1 << 4,
+        SD_JOURNAL_PARALLEL     = 1 << 5,
 
         SD_JOURNAL_SYSTEM_ONLY = SD_JOURNAL_SYSTEM /* deprecated name */
 };
@@ -102,6 +103,8 @@ int sd_journal_get_data_threshold(sd_journal *j, size_t *sz);
 
 int sd_journal_get_data(sd_journal *j, const char *field, const void **data, size_t *l);
 int sd_journal_enumerate_data(sd_journal *j, const void **data, size_t *l);
+int sd_journal_get_data_stable(sd_journal *j, const char *field, const void **data, size_t *l);
+int sd_journal_enumerate_data_stable(sd_journal *j, const void **data, size_t *l);
 void sd_journal_restart_data(sd_journal *j);
 
 int sd_journal_add_match(sd_journal *j, const void *data, size_t size);
@@ -121,6 +124,9 @@ int sd_journal_test_cursor(sd_journal *j, const char *cursor);
 int sd_journal_get_cutoff_realtime_usec(sd_journal *j, uint64_t *from, uint64_t *to);
 int sd_journal_get_cutoff_monotonic_usec(sd_journal *j, const sd_id128_t boot_id, uint64_t *from, uint64_t *to);
 
+int sd_journal_enumerate_boots(sd_journal *j, sd_id128_t *ret_boot_id, uint64_t *ret_first, uint64_t *ret_last);
+void sd_journal_restart_boots(sd_journal *j);
+
 int sd_journal_get_usage(sd_journal *j, uint64_t *bytes);
 
 int sd_journal_query_unique(sd_journal *j, const char *field);
@@ -157,6 +163,10 @@ int sd_journal_has_persistent_files(sd_journal *j);
 #define SD_JOURNAL_FOREACH_DATA(j, data, l)                             \
         for (sd_journal_restart_data(j); sd_journal_enumerate_data((j), &(data), &(l)) > 0; )
 
+/* Same, but the data stays valid until the read pointer moves to another entry */
+#define SD_JOURNAL_FOREACH_DATA_STABLE(j, data, l)                      \
+        for (sd_journal_restart_data(j); sd_journal_enumerate_data_stable((j), &(data), &(l)) > 0; )
+
 /* Iterate through the all known values of a specific field */
 #define SD_JOURNAL_FOREACH_UNIQUE(j, data, l)                           \
         for (sd_journal_restart_unique(j); sd_journal_enumerate_unique((j), &(data), &(l)) > 0; )
@@ -77,6 +77,7 @@ sd_event *sd_ndisc_get_event(sd_ndisc *nd);
 int sd_ndisc_set_callback(sd_ndisc *nd, sd_ndisc_callback_t cb, void *userdata);
 int sd_ndisc_set_ifindex(sd_ndisc *nd, int interface_index);
 int sd_ndisc_set_mac(sd_ndisc *nd, const struct ether_addr *mac_addr);
+int sd_ndisc_set_shared_socket(sd_ndisc *nd, int b);
 
 int sd_ndisc_get_mtu(sd_ndisc *nd, uint32_t *ret);
 int sd_ndisc_get_hop_limit(sd_ndisc *nd, uint8_t *ret);
@@ -232,7 +232,7 @@ static int make_backup(const char *target, const char *x) {
         if (futimens(fileno(dst), ts) < 0)
                 log_warning_errno(errno, "Failed to fix access and modification time of %s: %m", backup);
 
-        r = fflush_sync_and_check(dst);
+        r = fflush_and_check(dst);
         if (r < 0)
                 goto fail;
 
@@ -552,7 +552,7 @@ static int write_temporary_shadow(const char *shadow_path, FILE **tmpfile, char
         if (!IN_SET(errno, 0, ENOENT))
                 return -errno;
 
-        r = fflush_sync_and_check(shadow);
+        r = fflush_and_check(shadow);
         if (r < 0)
                 return r;
 
@@ -649,7 +649,7 @@ static int write_temporary_group(const char *group_path, FILE **tmpfile, char **
                         break;
         }
 
-        r = fflush_sync_and_check(group);
+        r = fflush_and_check(group);
         if (r < 0)
                 return r;
 
@@ -721,7 +721,7 @@ static int write_temporary_gshadow(const char * gshadow_path, FILE **tmpfile, ch
                 group_changed = true;
         }
 
-        r = fflush_sync_and_check(gshadow);
+        r = fflush_and_check(gshadow);
         if (r < 0)
                 return r;
 
@@ -785,6 +785,12 @@ static int write_files(void) {
                         return r;
         }
 
+        /* All new files and backups are placed in the same directory, hence sync them to disk in one go,
+         * before making them count */
+        if (group || gshadow || passwd || shadow)
+                if (syncfs(fileno(group ?: gshadow ?: passwd ?: shadow)) < 0)
+                        return -errno;
+
         /* And make the new files count */
         if (group) {
                 r = rename_and_apply_smack(group_tmp, group_path);
@@ -0,0 +1,110 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include "arena.h"
+#include "extract-word.h"
+#include "string-util.h"
+#include "strv.h"
+#include "tests.h"
+
+static void test_arena_alloc(void) {
+        _cleanup_(arena_done) Arena a = {};
+        char *p, *q, *big;
+        unsigned i;
+
+        log_info("/* %s */", __func__);
+
+        assert_se(p = arena_strdup(&a, "foo"));
+        assert_se(q = arena_strndup(&a, "barbaz", 3));
+        assert_se(streq(p, "foo"));
+        assert_se(streq(q, "bar"));
+        assert_se(((uintptr_t) q % sizeof(void*)) == 0);
+
+        /* The last allocation grows in place */
+        assert_se(arena_realloc(&a, q, 4, 100) == q);
+        assert_se(streq(q, "bar"));
+
+        /* Others are copied */
+        assert_se(p = arena_realloc(&a, p, 4, 100));
+        assert_se(streq(p, "foo"));
+
+        /* Large allocations don't take the place of the current chunk */
+        assert_se(big = arena_alloc0(&a, 1024 * 1024));
+        assert_se(big[1024 * 1024 - 1] == 0);
+        assert_se(arena_realloc(&a, p, 100, 200) == p);
+
+        for (i = 0; i < 100000; i++)
+                assert_se(arena_alloc(&a, i % 100));
+
+        arena_done(&a);
+        assert_se(!a.chunks);
+        assert_se(a.n_allocated == 0);
+
+        /* Can be reused after arena_done() */
+        assert_se(p = arena_strdup(&a, "quux"));
+        assert_se(streq(p, "quux"));
+}
+
+static void test_extract_first_word_arena(void) {
+        _cleanup_(arena_done) Arena a = {};
+        const char *p, *original;
+        char *t, *u;
+
+        log_info("/* %s */", __func__);
+
+        p = original = "  foo \"bar baz\" \\x41\\u00e4 ";
+
+        assert_se(extract_first_word_arena(&p, &a, &t, NULL, EXTRACT_UNQUOTE|EXTRACT_CUNESCAPE) > 0);
+        assert_se(streq(t, "foo"));
+        assert_se(extract_first_word_arena(&p, &a, &u, NULL, EXTRACT_UNQUOTE|EXTRACT_CUNESCAPE) > 0);
+        assert_se(streq(u, "bar baz"));
+        assert_se(streq(t, "foo"));
+        assert_se(extract_first_word_arena(&p, &a, &t, NULL, EXTRACT_UNQUOTE|EXTRACT_CUNESCAPE) > 0);
+        assert_se(streq(t, "Aä"));
+        assert_se(extract_first_word_arena(&p, &a, &t, NULL, EXTRACT_UNQUOTE|EXTRACT_CUNESCAPE) == 0);
+        assert_se(!t);
+        assert_se(!p);
+
+        p = "\"unbalanced";
+        assert_se(extract_first_word_arena(&p, &a, &t, NULL, EXTRACT_UNQUOTE) == -EINVAL);
+
+        p = "a,,b";
+        assert_se(extract_first_word_arena(&p, &a, &t, ",", EXTRACT_DONT_COALESCE_SEPARATORS) > 0);
+        assert_se(streq(t, "a"));
+        assert_se(extract_first_word_arena(&p, &a, &t, ",", EXTRACT_DONT_COALESCE_SEPARATORS) > 0);
+        assert_se(streq(t, ""));
+        assert_se(extract_first_word_arena(&p, &a, &t, ",", EXTRACT_DONT_COALESCE_SEPARATORS) > 0);
+        assert_se(streq(t, "b"));
+}
+
+static void test_strv_split_extract_arena(void) {
+        _cleanup_(arena_done) Arena a = {};
+        _cleanup_strv_free_ char **expected = NULL;
+        _cleanup_free_ char *line = NULL;
+        char **l;
+        unsigned i;
+
+        log_info("/* %s */", __func__);
+
+        assert_se(strv_split_extract_arena(&a, &l, "", NULL, 0) == 0);
+        assert_se(strv_isempty(l));
+
+        assert_se(strv_split_extract_arena(&a, &l, "one 'two three' four", NULL, EXTRACT_UNQUOTE) == 3);
+        assert_se(strv_equal(l, STRV_MAKE("one", "two three", "four")));
+
+        for (i = 0; i < 1000; i++)
+                assert_se(strv_extendf(&expected, "word%u", i) >= 0);
+        assert_se(line = strv_join(expected, " "));
+
+        assert_se(strv_split_extract_arena(&a, &l, line, NULL, 0) == 1000);
+        assert_se(strv_equal(l, expected));
+}
+
+int main(int argc, char *argv[]) {
+        test_setup_logging(LOG_DEBUG);
+
+        test_arena_alloc();
+        test_extract_first_word_arena();
+        test_strv_split_extract_arena();
+
+        return 0;
+}
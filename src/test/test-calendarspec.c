@@ -203,6 +203,12 @@ int main(int argc, char* argv[]) {
         test_next("2016-02~01 UTC", "", 12345, 1456704000000000);
         test_next("Mon 2017-05~01..07 UTC", "", 12345, 1496016000000000);
         test_next("Mon 2017-05~07/1 UTC", "", 12345, 1496016000000000);
+        test_next("2100-02~01 UTC", "", 12345, 4107456000000000);
+        test_next("2000-02~01 UTC", "", 12345, 951782400000000);
+        test_next("*-*-* 02:30:00", "Europe/Berlin", 1459033200000000, 1459125000000000);
+        test_next("Sun *-*-* 02:30:00", "Europe/Berlin", 1459033200000000, 1459643400000000);
+        test_next("*-*-* 02:30:00", "Europe/Berlin", 1477778400000000, 1477787400000000);
+        test_next("*-*-* 02:30:00", "Europe/Berlin", 1477787400000000, 1477877400000000);
         test_next("2017-08-06 9,11,13,15,17:00 UTC", "", 1502029800000000, 1502031600000000);
         test_next("2017-08-06 9..17/2:00 UTC", "", 1502029800000000, 1502031600000000);
         test_next("2016-12-* 3..21/6:00 UTC", "", 1482613200000001, 1482634800000000);
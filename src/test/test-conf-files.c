@@ -3,8 +3,10 @@
   Copyright © 2014 Michael Marineau
 ***/
 
+#include <fcntl.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <sys/stat.h>
 
 #include "alloc-util.h"
 #include "conf-files.h"
@@ -90,6 +92,82 @@ static void test_conf_files_list(bool use_root) {
         assert_se(rm_rf(tmp_dir, REMOVE_ROOT|REMOVE_PHYSICAL) == 0);
 }
 
+static void test_conf_files_list_cached(void) {
+        char tmp_dir[] = "/tmp/test-conf-files-XXXXXX";
+        _cleanup_(conf_files_cache_freep) ConfFilesCache *cache = NULL;
+        const char *dir1, *dir2, *expect_a, *expect_b, *expect_c;
+        unsigned i;
+        const struct timespec ts[2] = {
+                { .tv_sec = 1000000000 },
+                { .tv_sec = 1000000000 },
+        };
+
+        log_info("/* %s */", __func__);
+
+        setup_test_dir(tmp_dir,
+                       "/dir1/a.conf",
+                       "/dir2/a.conf",
+                       "/dir2/b.conf",
+                       NULL);
+
+        dir1 = strjoina(tmp_dir, "/dir1");
+        dir2 = strjoina(tmp_dir, "/dir2");
+        expect_a = strjoina(tmp_dir, "/dir1/a.conf");
+        expect_b = strjoina(tmp_dir, "/dir2/b.conf");
+        expect_c = strjoina(tmp_dir, "/dir2/c.conf");
+
+        /* Listings of directories that were just modified are never reused */
+        assert_se(cache = conf_files_cache_new());
+
+        for (i = 0; i < 2; i++) {
+                _cleanup_strv_free_ char **l = NULL;
+
+                assert_se(conf_files_list_strv_cached(cache, &l, ".conf", NULL, 0, (const char* const*) STRV_MAKE(dir1, dir2, "/nonexistent")) == 0);
+                assert_se(strv_equal(l, STRV_MAKE(expect_a, expect_b)));
+        }
+
+        assert_se(write_string_file(expect_c, "foobar", WRITE_STRING_FILE_CREATE) >= 0);
+
+        {
+                _cleanup_strv_free_ char **l = NULL;
+
+                assert_se(conf_files_list_strv_cached(cache, &l, ".conf", NULL, 0, (const char* const*) STRV_MAKE(dir1, dir2)) == 0);
+                assert_se(strv_equal(l, STRV_MAKE(expect_a, expect_b, expect_c)));
+        }
+
+        /* Older ones are reused as long as the mtime doesn't change… */
+        assert_se(utimensat(AT_FDCWD, dir2, ts, 0) >= 0);
+
+        {
+                _cleanup_strv_free_ char **l = NULL;
+
+                assert_se(conf_files_list_strv_cached(cache, &l, ".conf", NULL, 0, (const char* const*) STRV_MAKE(dir1, dir2)) == 0);
+                assert_se(strv_equal(l, STRV_MAKE(expect_a, expect_b, expect_c)));
+        }
+
+        assert_se(unlink(expect_c) >= 0);
+        assert_se(utimensat(AT_FDCWD, dir2, ts, 0) >= 0);
+
+        {
+                _cleanup_strv_free_ char **l = NULL;
+
+                assert_se(conf_files_list_strv_cached(cache, &l, ".conf", NULL, 0, (const char* const*) STRV_MAKE(dir1, dir2)) == 0);
+                assert_se(strv_equal(l, STRV_MAKE(expect_a, expect_b, expect_c)));
+        }
+
+        /* … and dropped once it does */
+        assert_se(unlink(expect_b) >= 0);
+
+        {
+                _cleanup_strv_free_ char **l = NULL;
+
+                assert_se(conf_files_list_strv_cached(cache, &l, ".conf", NULL, 0, (const char* const*) STRV_MAKE(dir1, dir2)) == 0);
+                assert_se(strv_equal(l, STRV_MAKE(expect_a)));
+        }
+
+        assert_se(rm_rf(tmp_dir, REMOVE_ROOT|REMOVE_PHYSICAL) == 0);
+}
+
 static void test_conf_files_insert(const char *root) {
         _cleanup_strv_free_ char **s = NULL;
 
@@ -149,6 +227,7 @@ int main(int argc, char **argv) {
 
         test_conf_files_list(false);
         test_conf_files_list(true);
+        test_conf_files_list_cached();
         test_conf_files_insert(NULL);
         test_conf_files_insert("/root");
         test_conf_files_insert("/root/");
@@ -7,7 +7,9 @@
 #include "macro.h"
 #include "string-util.h"
 #include "strv.h"
+#include "time-util.h"
 #include "tmpfile-util.h"
+#include "utf8.h"
 #include "util.h"
 
 static void test_config_parse_path_one(const char *rvalue, const char *expected) {
@@ -308,6 +310,15 @@ static const char* const config_file[] = {
         "setting1=3\n"
         "[X-Section]\n"
         "setting1=3\n",
+
+        "[Section]\r\n"
+        "setting1=1\\\r\n"   /* continuation with DOS line endings */
+        "2\\\r\n"
+        "3\r\n",
+
+        UTF8_BYTE_ORDER_MARK
+        "[Section]\r"        /* old MacOS line endings */
+        "setting1=1\r",
 };
 
 static void test_config_parse(unsigned i, const char *s) {
@@ -378,9 +389,83 @@ static void test_config_parse(unsigned i, const char *s) {
                 assert_se(r == 0);
                 assert_se(streq(setting1, "2"));
                 break;
+
+        case 18:
+                assert_se(r == 0);
+                assert_se(streq(setting1, "1 2 3"));
+                break;
+
+        case 19:
+                assert_se(r == 0);
+                assert_se(streq(setting1, "1"));
+                break;
         }
 }
 
+static int config_parse_count(
+                const char *unit,
+                const char *filename,
+                unsigned line,
+                const char *section,
+                unsigned section_line,
+                const char *lvalue,
+                int ltype,
+                const char *rvalue,
+                void *data,
+                void *userdata) {
+
+        unsigned *n = data;
+
+        (*n)++;
+        return 0;
+}
+
+#define PERFORMANCE_SECTIONS 400U
+#define PERFORMANCE_ITERATIONS 50U
+
+static void test_config_parse_performance(void) {
+        _cleanup_(unlink_tempfilep) char name[] = "/tmp/test-conf-parser.XXXXXX";
+        _cleanup_fclose_ FILE *f = NULL;
+        char ts[FORMAT_TIMESPAN_MAX];
+        unsigned i, n = 0;
+        usec_t t;
+
+        const ConfigTableItem items[] = {
+                { "Section", "setting1", config_parse_count, 0, &n },
+                { "Section", "setting2", config_parse_count, 0, &n },
+                {}
+        };
+
+        log_info("== %s ==", __func__);
+
+        /* Roughly what a few hundred unit files with drop-ins amount to */
+        assert_se(fmkostemp_safe(name, "r+", &f) == 0);
+        for (i = 0; i < PERFORMANCE_SECTIONS; i++)
+                fprintf(f,
+                        "[Section]\n"
+                        "# A comment\n"
+                        "setting1=/usr/bin/foo --bar=%u --baz\n"
+                        "setting2=some value \\\n"
+                        "         continued \\\n"
+                        "         twice\n"
+                        "\n",
+                        i);
+        assert_se(fflush_and_check(f) >= 0);
+
+        t = now(CLOCK_MONOTONIC);
+        for (i = 0; i < PERFORMANCE_ITERATIONS; i++) {
+                rewind(f);
+                assert_se(config_parse(NULL, name, f, "Section\0", config_item_table_lookup, items, CONFIG_PARSE_WARN, NULL) == 0);
+        }
+        t = now(CLOCK_MONOTONIC) - t;
+
+        assert_se(n == PERFORMANCE_ITERATIONS * PERFORMANCE_SECTIONS * 2);
+
+        log_info("%u lines parsed in %s per iteration",
+                 PERFORMANCE_SECTIONS * 7,
+                 format_timespan(ts, sizeof(ts), t / PERFORMANCE_ITERATIONS, 1));
+}
+
 int main(int argc, char **argv) {
         unsigned i;
 
@@ -403,5 +488,7 @@ int main(int argc, char **argv) {
         for (i = 0; i < ELEMENTSOF(config_file); i++)
                 test_config_parse(i, config_file[i]);
 
+        test_config_parse_performance();
+
         return 0;
 }
@@ -278,6 +278,51 @@ static void test_copy_atomic(void) {
         assert_se(copy_file_atomic("/etc/fstab", q, 0644, 0, 0, COPY_REPLACE) >= 0);
 }
 
+static void test_copy_holes(void) {
+        char fn[] = "/var/tmp/test-copy-hole-fd-XXXXXX";
+        char fn_copy[] = "/var/tmp/test-copy-hole-fd-XXXXXX";
+        _cleanup_close_ int fd = -1, fd_copy = -1;
+        char buf[4096] = { 'a', 'b', 'c' }, buf_copy[sizeof(buf)];
+        struct stat st;
+        off_t blksz;
+
+        log_info("/* %s */", __func__);
+
+        fd = mkostemp_safe(fn);
+        assert_se(fd >= 0);
+
+        fd_copy = mkostemp_safe(fn_copy);
+        assert_se(fd_copy >= 0);
+
+        assert_se(fstat(fd, &st) >= 0);
+        blksz = MAX(st.st_blksize, (blksize_t) sizeof(buf));
+
+        /* A hole, then data, then a hole again at the end */
+        assert_se(pwrite(fd, buf, sizeof(buf), blksz) == sizeof(buf));
+        assert_se(ftruncate(fd, 4 * blksz) >= 0);
+
+        if (lseek(fd, 0, SEEK_DATA) != blksz) {
+                log_notice("File system does not report holes, skipping test.");
+                goto finish;
+        }
+
+        assert_se(lseek(fd, 0, SEEK_SET) == 0);
+        assert_se(copy_bytes(fd, fd_copy, UINT64_MAX, COPY_HOLES) >= 0);
+
+        assert_se(fstat(fd_copy, &st) >= 0);
+        assert_se(st.st_size == 4 * blksz);
+
+        assert_se(lseek(fd_copy, 0, SEEK_DATA) == blksz);
+        assert_se(lseek(fd_copy, blksz, SEEK_HOLE) < 4 * blksz);
+
+        assert_se(pread(fd_copy, buf_copy, sizeof(buf_copy), blksz) == sizeof(buf_copy));
+        assert_se(memcmp(buf, buf_copy, sizeof(buf)) == 0);
+
+finish:
+        unlink(fn);
+        unlink(fn_copy);
+}
+
 int main(int argc, char *argv[]) {
         test_setup_logging(LOG_DEBUG);
 
@@ -292,6 +337,7 @@ int main(int argc, char *argv[]) {
         test_copy_bytes_regular_file(argv[0], false, 32000); /* larger than copy buffer size */
         test_copy_bytes_regular_file(argv[0], true, 32000);
         test_copy_atomic();
+        test_copy_holes();
 
         return 0;
 }
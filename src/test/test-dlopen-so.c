@@ -0,0 +1,31 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include "crypt-util.h"
+#include "idn-util.h"
+#include "macro.h"
+#include "main-func.h"
+#include "tests.h"
+
+static int run(int argc, char **argv) {
+        test_setup_logging(LOG_DEBUG);
+
+        /* Try to load each of our weak library dependencies once. This is supposed to help finding cases
+         * where .so versions change and distributions update, but systemd doesn't have the new so names
+         * around yet. Loading twice must return 0 the second time, without loading anything again. */
+
+#if HAVE_LIBIDN2
+        assert_se(dlopen_idn() > 0);
+        assert_se(dlopen_idn() == 0);
+        assert_se(sym_idn2_lookup_u8 && sym_idn2_strerror && sym_idn2_to_unicode_8z8z);
+#endif
+
+#if HAVE_LIBCRYPTSETUP
+        assert_se(dlopen_cryptsetup() > 0);
+        assert_se(dlopen_cryptsetup() == 0);
+        assert_se(sym_crypt_init && sym_crypt_free && sym_crypt_get_dir);
+#endif
+
+        return 0;
+}
+
+DEFINE_MAIN_FUNCTION(run);
@@ -0,0 +1,109 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <errno.h>
+#include <stdio.h>
+
+#include "alloc-util.h"
+#include "bus-util.h"
+#include "fileio.h"
+#include "manager.h"
+#include "path-util.h"
+#include "rm-rf.h"
+#include "string-util.h"
+#include "tests.h"
+#include "time-util.h"
+#include "tmpfile-util.h"
+
+/* Builds a large graph of target units, and measures how long it takes to build and apply transactions for
+ * it. Each unit wants and is ordered after two units further down in a binary tree, and is ordered after
+ * its successor too, so that there are plenty of overlapping paths for job merging and cycle detection to
+ * chew on. */
+
+#define N_UNITS 4000U
+
+static void write_unit(const char *dir, unsigned i) {
+        _cleanup_free_ char *p = NULL, *contents = NULL;
+        unsigned k;
+
+        assert_se(asprintf(&p, "%s/scale-%u.target", dir, i) >= 0);
+        assert_se(contents = strdup("[Unit]\n"));
+
+        for (k = 2 * i + 1; k <= 2 * i + 2 && k < N_UNITS; k++) {
+                _cleanup_free_ char *l = NULL;
+
+                assert_se(asprintf(&l, "Wants=scale-%u.target\nAfter=scale-%u.target\n", k, k) >= 0);
+                assert_se(strextend(&contents, l, NULL));
+        }
+
+        if (i + 1 < N_UNITS) {
+                _cleanup_free_ char *l = NULL;
+
+                assert_se(asprintf(&l, "After=scale-%u.target\n", i + 1) >= 0);
+                assert_se(strextend(&contents, l, NULL));
+        }
+
+        assert_se(write_string_file(p, contents, WRITE_STRING_FILE_CREATE) >= 0);
+}
+
+static void test_transaction(Manager *m, Unit *root, JobType type, JobMode mode, const char *what) {
+        _cleanup_(sd_bus_error_free) sd_bus_error err = SD_BUS_ERROR_NULL;
+        char buf[FORMAT_TIMESPAN_MAX];
+        usec_t t;
+        Job *j;
+        int r;
+
+        manager_clear_jobs(m);
+
+        t = now(CLOCK_MONOTONIC);
+        r = manager_add_job(m, type, root, mode, NULL, &err, &j);
+        t = now(CLOCK_MONOTONIC) - t;
+
+        if (sd_bus_error_is_set(&err))
+                log_error("error: %s: %s", err.name, err.message);
+        assert_se(r == 0);
+
+        log_info("%s of %u units: %u jobs, %s", what, N_UNITS, hashmap_size(m->jobs),
+                 format_timespan(buf, sizeof(buf), t, 1));
+}
+
+int main(int argc, char *argv[]) {
+        _cleanup_(rm_rf_physical_and_freep) char *runtime_dir = NULL, *unit_dir = NULL;
+        _cleanup_(manager_freep) Manager *m = NULL;
+        char buf[FORMAT_TIMESPAN_MAX];
+        Unit *root = NULL;
+        unsigned i;
+        usec_t t;
+        int r;
+
+        test_setup_logging(LOG_INFO);
+
+        r = enter_cgroup_subroot(NULL);
+        if (r == -ENOMEDIUM)
+                return log_tests_skipped("cgroupfs not available");
+
+        assert_se(mkdtemp_malloc("/tmp/test-engine-scale-XXXXXX", &unit_dir) >= 0);
+        for (i = 0; i < N_UNITS; i++)
+                write_unit(unit_dir, i);
+
+        /* prepare the test */
+        assert_se(set_unit_path(unit_dir) >= 0);
+        assert_se(runtime_dir = setup_fake_runtime_dir());
+        r = manager_new(UNIT_FILE_USER, MANAGER_TEST_RUN_BASIC, &m);
+        if (manager_errno_skip_test(r))
+                return log_tests_skipped_errno(r, "manager_new");
+        assert_se(r >= 0);
+        assert_se(manager_startup(m, NULL, NULL) >= 0);
+
+        t = now(CLOCK_MONOTONIC);
+        assert_se(manager_load_startable_unit_or_warn(m, "scale-0.target", NULL, &root) >= 0);
+        t = now(CLOCK_MONOTONIC) - t;
+        log_info("Loading %u units: %s", N_UNITS, format_timespan(buf, sizeof(buf), t, 1));
+
+        test_transaction(m, root, JOB_START, JOB_REPLACE, "Start");
+        assert_se(hashmap_size(m->jobs) == N_UNITS);
+
+        test_transaction(m, root, JOB_STOP, JOB_REPLACE, "Stop");
+        test_transaction(m, root, JOB_START, JOB_FAIL, "Start (fail mode)");
+
+        return 0;
+}
@@ -119,37 +119,44 @@ int main(int argc, char *argv[]) {
         assert_se(manager_add_job(m, JOB_START, a_conj, JOB_REPLACE, NULL, NULL, &j) == -EDEADLK);
         manager_dump_jobs(m, stdout, "\t");
 
-        assert_se(!hashmap_get(a->dependencies[UNIT_PROPAGATES_RELOAD_TO], b));
-        assert_se(!hashmap_get(b->dependencies[UNIT_RELOAD_PROPAGATED_FROM], a));
-        assert_se(!hashmap_get(a->dependencies[UNIT_PROPAGATES_RELOAD_TO], c));
-        assert_se(!hashmap_get(c->dependencies[UNIT_RELOAD_PROPAGATED_FROM], a));
+        assert_se(!unit_has_dependency(a, UNIT_PROPAGATES_RELOAD_TO, b));
+        assert_se(!unit_has_dependency(b, UNIT_RELOAD_PROPAGATED_FROM, a));
+        assert_se(!unit_has_dependency(a, UNIT_PROPAGATES_RELOAD_TO, c));
+        assert_se(!unit_has_dependency(c, UNIT_RELOAD_PROPAGATED_FROM, a));
 
         assert_se(unit_add_dependency(a, UNIT_PROPAGATES_RELOAD_TO, b, true, UNIT_DEPENDENCY_UDEV) == 0);
         assert_se(unit_add_dependency(a, UNIT_PROPAGATES_RELOAD_TO, c, true, UNIT_DEPENDENCY_PROC_SWAP) == 0);
 
-        assert_se(hashmap_get(a->dependencies[UNIT_PROPAGATES_RELOAD_TO], b));
-        assert_se(hashmap_get(b->dependencies[UNIT_RELOAD_PROPAGATED_FROM], a));
-        assert_se(hashmap_get(a->dependencies[UNIT_PROPAGATES_RELOAD_TO], c));
-        assert_se(hashmap_get(c->dependencies[UNIT_RELOAD_PROPAGATED_FROM], a));
+        assert_se(unit_has_dependency(a, UNIT_PROPAGATES_RELOAD_TO, b));
+        assert_se(unit_has_dependency(b, UNIT_RELOAD_PROPAGATED_FROM, a));
+        assert_se(unit_has_dependency(a, UNIT_PROPAGATES_RELOAD_TO, c));
+        assert_se(unit_has_dependency(c, UNIT_RELOAD_PROPAGATED_FROM, a));
 
         unit_remove_dependencies(a, UNIT_DEPENDENCY_UDEV);
 
-        assert_se(!hashmap_get(a->dependencies[UNIT_PROPAGATES_RELOAD_TO], b));
-        assert_se(!hashmap_get(b->dependencies[UNIT_RELOAD_PROPAGATED_FROM], a));
-        assert_se(hashmap_get(a->dependencies[UNIT_PROPAGATES_RELOAD_TO], c));
-        assert_se(hashmap_get(c->dependencies[UNIT_RELOAD_PROPAGATED_FROM], a));
+        assert_se(!unit_has_dependency(a, UNIT_PROPAGATES_RELOAD_TO, b));
+        assert_se(!unit_has_dependency(b, UNIT_RELOAD_PROPAGATED_FROM, a));
+        assert_se(unit_has_dependency(a, UNIT_PROPAGATES_RELOAD_TO, c));
+        assert_se(unit_has_dependency(c, UNIT_RELOAD_PROPAGATED_FROM, a));
 
         unit_remove_dependencies(a, UNIT_DEPENDENCY_PROC_SWAP);
 
-        assert_se(!hashmap_get(a->dependencies[UNIT_PROPAGATES_RELOAD_TO], b));
-        assert_se(!hashmap_get(b->dependencies[UNIT_RELOAD_PROPAGATED_FROM], a));
-        assert_se(!hashmap_get(a->dependencies[UNIT_PROPAGATES_RELOAD_TO], c));
-        assert_se(!hashmap_get(c->dependencies[UNIT_RELOAD_PROPAGATED_FROM], a));
+        assert_se(!unit_has_dependency(a, UNIT_PROPAGATES_RELOAD_TO, b));
+        assert_se(!unit_has_dependency(b, UNIT_RELOAD_PROPAGATED_FROM, a));
+        assert_se(!unit_has_dependency(a, UNIT_PROPAGATES_RELOAD_TO, c));
+        assert_se(!unit_has_dependency(c, UNIT_RELOAD_PROPAGATED_FROM, a));
 
         assert_se(manager_load_unit(m, "unit-with-multiple-dashes.service", NULL, NULL, &unit_with_multiple_dashes) >= 0);
 
         assert_se(strv_equal(unit_with_multiple_dashes->documentation, STRV_MAKE("man:test", "man:override2", "man:override3")));
         assert_se(streq_ptr(unit_with_multiple_dashes->description, "override4"));
 
+        /* Units with the same fragment path share one copy of it */
+        assert_se(a->fragment_path);
+        assert_se(manager_intern_string(m, a->fragment_path) == a->fragment_path);
+        manager_unintern_string(m, a->fragment_path);
+        assert_se(unit_set_fragment_path(b, a->fragment_path) >= 0);
+        assert_se(b->fragment_path == a->fragment_path);
+
         return 0;
 }
@@ -15,8 +15,10 @@
 #include "fs-util.h"
 #include "log.h"
 #include "macro.h"
+#include "parse-util.h"
 #include "path-util.h"
 #include "rm-rf.h"
+#include "stdio-util.h"
 #include "string-util.h"
 #include "strv.h"
 #include "tests.h"
@@ -401,6 +403,61 @@ static void test_error_catching(void) {
         assert_se(r == 42);
 }
 
+static void test_execute_directory_timing(void) {
+        char template[] = "/tmp/test-exec-util-timing.XXXXXXX";
+        const char *dirs[] = {template, NULL};
+        ExecDirTiming *timings = NULL;
+        size_t n_timings = 0, i;
+        char buf[FORMAT_TIMESPAN_MAX];
+        bool seen[20] = {};
+        usec_t ts;
+
+        log_info("/* %s */", __func__);
+
+        assert_se(mkdtemp(template));
+
+        /* More scripts than are run at the same time on small machines, so that the limit is hit */
+        for (i = 0; i < ELEMENTSOF(seen); i++) {
+                char name[STRLEN("/") + DECIMAL_STR_MAX(size_t) + 1];
+                const char *p;
+
+                xsprintf(name, "/%zu", i);
+                p = strjoina(template, name);
+
+                assert_se(write_string_file(p, "#!/bin/sh\nsleep 0.2\n", WRITE_STRING_FILE_CREATE) == 0);
+                assert_se(chmod(p, 0755) == 0);
+        }
+
+        ts = now(CLOCK_MONOTONIC);
+        assert_se(execute_directories_full(dirs, DEFAULT_TIMEOUT_USEC, NULL, NULL, NULL, NULL,
+                                           EXEC_DIR_PARALLEL | EXEC_DIR_IGNORE_ERRORS,
+                                           &timings, &n_timings) == 0);
+        ts = now(CLOCK_MONOTONIC) - ts;
+
+        log_info("All scripts finished in %s", format_timespan(buf, sizeof(buf), ts, USEC_PER_MSEC));
+
+        assert_se(n_timings == ELEMENTSOF(seen));
+
+        for (i = 0; i < n_timings; i++) {
+                unsigned k;
+
+                assert_se(safe_atou(timings[i].name, &k) >= 0);
+                assert_se(k < ELEMENTSOF(seen));
+                assert_se(!seen[k]);
+                seen[k] = true;
+
+                assert_se(timings[i].start > 0);
+                assert_se(timings[i].duration >= 200 * USEC_PER_MSEC);
+        }
+
+        /* They ran in parallel, hence all of them together took much less than one after the other */
+        assert_se(ts < ELEMENTSOF(seen) * 200 * USEC_PER_MSEC);
+
+        exec_dir_timing_free_many(timings, n_timings);
+
+        (void) rm_rf(template, REMOVE_ROOT|REMOVE_PHYSICAL);
+}
+
 static void test_exec_command_flags_from_strv(void) {
         ExecCommandFlags flags = 0;
         char **valid_strv = STRV_MAKE("no-env-expand", "no-setuid", "ignore-failure");
@@ -454,6 +511,7 @@ int main(int argc, char *argv[]) {
         test_stdout_gathering();
         test_environment_gathering();
         test_error_catching();
+        test_execute_directory_timing();
         test_exec_command_flags_from_strv();
         test_exec_command_flags_to_strv();
 
@@ -313,6 +313,34 @@ static void test_fd_duplicate_data_fd(void) {
         assert_se(read(fd2, &j, sizeof(j)) == 0);
 }
 
+static void test_close_all_fds_without_malloc(void) {
+        pid_t pid;
+        int r;
+
+        r = safe_fork("close-all", FORK_WAIT|FORK_LOG, &pid);
+        assert_se(r >= 0);
+
+        if (r == 0) {
+                int fds[64], keep[2];
+                size_t i;
+
+                /* Child */
+
+                for (i = 0; i < ELEMENTSOF(fds); i++)
+                        assert_se((fds[i] = open("/dev/null", O_RDONLY|O_CLOEXEC)) >= 0);
+
+                keep[0] = fds[7];
+                keep[1] = fds[42];
+
+                assert_se(close_all_fds_without_malloc(keep, ELEMENTSOF(keep)) >= 0);
+
+                for (i = 0; i < ELEMENTSOF(fds); i++)
+                        assert_se((fcntl(fds[i], F_GETFD) >= 0) == IN_SET(i, 7, 42));
+
+                _exit(EXIT_SUCCESS);
+        }
+}
+
 static void test_read_nr_open(void) {
         log_info("nr-open: %i", read_nr_open());
 }
@@ -329,6 +357,7 @@ int main(int argc, char *argv[]) {
         test_fd_move_above_stdio();
         test_rearrange_stdio();
         test_fd_duplicate_data_fd();
+        test_close_all_fds_without_malloc();
         test_read_nr_open();
 
         return 0;
@@ -784,6 +784,44 @@ static void test_hashmap_many(void) {
         }
 }
 
+static void test_hashmap_lookup_benchmark(void) {
+        _cleanup_strv_free_ char **names = NULL;
+        Hashmap *h;
+        unsigned i, k, n, rounds, hits = 0;
+        bool slow = slow_tests_enabled();
+        usec_t ts;
+        char b[FORMAT_TIMESPAN_MAX];
+
+        log_info("/* %s (%s) */", __func__, slow ? "slow" : "fast");
+
+        /* Lookups of names that are not in the table, interleaved with ones that are, similar to what
+         * happens when PID 1 loads units */
+        n = slow ? 1 << 16 : 1 << 10;
+        rounds = slow ? 50 : 2;
+
+        assert_se(names = new0(char*, 2 * n + 1));
+        for (i = 0; i < 2 * n; i++)
+                assert_se(asprintf(&names[i], "unit-%u.service", i) >= 0);
+
+        assert_se(h = hashmap_new(&string_hash_ops));
+        for (i = 0; i < n; i++)
+                assert_se(hashmap_put(h, names[2 * i], names[2 * i]) == 1);
+
+        ts = now(CLOCK_MONOTONIC);
+        for (k = 0; k < rounds; k++)
+                for (i = 0; i < 2 * n; i++)
+                        if (hashmap_get(h, names[i])) {
+                                assert_se(i % 2 == 0);
+                                hits++;
+                        }
+
+        assert_se(hits == n * rounds);
+        log_info("%u lookups (50%% misses) in %u buckets took %s",
+                 2 * n * rounds, hashmap_buckets(h), format_timespan(b, sizeof b, now(CLOCK_MONOTONIC) - ts, 0));
+
+        hashmap_free(h);
+}
+
 extern unsigned custom_counter;
 extern const struct hash_ops boring_hash_ops, custom_hash_ops;
 
@@ -1003,6 +1041,26 @@ static void test_hashmap_reserve(void) {
         assert_se(hashmap_reserve(m, UINT_MAX - 1) == -ENOMEM);
 }
 
+static void test_hashmap_put_many(void) {
+        _cleanup_hashmap_free_ Hashmap *m = NULL;
+        static const char * const keys[] = { "key 1", "key 2", "key 3" };
+        static char * const values[] = { (char*) "val 1", (char*) "val 2", (char*) "val 3" };
+
+        log_info("/* %s */", __func__);
+
+        m = hashmap_new(&string_hash_ops);
+
+        assert_se(hashmap_put_many(m, NULL, NULL, 0) == 0);
+        assert_se(hashmap_put_many(m, (const void**) keys, (void**) values, ELEMENTSOF(keys)) == 3);
+        assert_se(hashmap_size(m) == 3);
+        assert_se(streq(hashmap_get(m, "key 2"), "val 2"));
+
+        /* Same entries again are no-ops, a different value for an existing key is refused */
+        assert_se(hashmap_put_many(m, (const void**) keys, (void**) values, 2) == 0);
+        assert_se(hashmap_put_many(m, (const void**) keys + 1, (void**) values, 2) == -EEXIST);
+        assert_se(hashmap_size(m) == 3);
+}
+
 static void test_path_hashmap(void) {
         _cleanup_hashmap_free_ Hashmap *h = NULL;
 
@@ -1085,6 +1143,7 @@ void test_hashmap_funcs(void) {
         test_hashmap_get2();
         test_hashmap_size();
         test_hashmap_many();
+        test_hashmap_lookup_benchmark();
         test_hashmap_free();
         test_hashmap_free_with_destructor();
         test_hashmap_first();
@@ -1094,6 +1153,7 @@ void test_hashmap_funcs(void) {
         test_hashmap_clear_free_free();
         test_hashmap_clear_free_with_destructor();
         test_hashmap_reserve();
+        test_hashmap_put_many();
         test_path_hashmap();
         test_string_strv_hashmap();
 }
@@ -1,6 +1,13 @@
 /* SPDX-License-Identifier: LGPL-2.1+ */
 
+#include <pthread.h>
+
+#include "fasthash.h"
 #include "hashmap.h"
+#include "mempool.h"
+#include "strv.h"
+#include "tests.h"
+#include "time-util.h"
 #include "util.h"
 
 unsigned custom_counter = 0;
@@ -109,6 +116,170 @@ static void test_iterated_cache(void) {
         assert_se(iterated_cache_free(c) == NULL);
 }
 
+static void test_hashmap_trim_pools(void) {
+        Hashmap *h[1000], *kept;
+        unsigned i;
+
+        log_info("/* %s */", __func__);
+
+        for (i = 0; i < ELEMENTSOF(h); i++)
+                assert_se(h[i] = hashmap_new(NULL));
+
+        /* A pool with a hashmap still allocated from it stays around */
+        kept = h[ELEMENTSOF(h) - 1];
+        assert_se(hashmap_put(kept, INT_TO_PTR(1), INT_TO_PTR(2)) == 1);
+
+        for (i = 0; i < ELEMENTSOF(h) - 1; i++)
+                hashmap_free(h[i]);
+
+        if (mempool_enabled())
+                assert_se(hashmap_trim_pools() > 0);
+        assert_se(hashmap_get(kept, INT_TO_PTR(1)) == INT_TO_PTR(2));
+
+        hashmap_free(kept);
+        if (mempool_enabled())
+                assert_se(hashmap_trim_pools() > 0);
+        assert_se(hashmap_trim_pools() == 0);
+
+        /* The pools are built up again as needed */
+        for (i = 0; i < ELEMENTSOF(h); i++)
+                assert_se(h[i] = hashmap_new(NULL));
+        for (i = 0; i < ELEMENTSOF(h); i++)
+                hashmap_free(h[i]);
+}
+
+static void *pools_thread(void *p) {
+        Hashmap *h[100], **passed = p;
+        unsigned i;
+
+        for (i = 0; i < ELEMENTSOF(h); i++)
+                assert_se(h[i] = hashmap_new(NULL));
+
+        /* One hashmap is passed back to the main thread, the rest is freed here */
+        *passed = h[0];
+        for (i = 1; i < ELEMENTSOF(h); i++)
+                hashmap_free(h[i]);
+
+        /* Releases what's unused, but not the pool the passed hashmap was allocated from. The same happens
+         * again when the thread exits. */
+        (void) hashmap_trim_pools();
+
+        return NULL;
+}
+
+static void test_hashmap_pools_threads(void) {
+        Hashmap *passed = NULL;
+        pthread_t t;
+
+        log_info("/* %s */", __func__);
+
+        /* Threads have their own pools, and hashmaps may be freed by another thread than the one that
+         * allocated them */
+        assert_se(pthread_create(&t, NULL, pools_thread, &passed) == 0);
+        assert_se(pthread_join(t, NULL) == 0);
+
+        assert_se(passed);
+        assert_se(hashmap_put(passed, INT_TO_PTR(1), INT_TO_PTR(2)) == 1);
+        hashmap_free(passed);
+
+        /* The freed tile is reused by this thread */
+        assert_se(passed = hashmap_new(NULL));
+        hashmap_free(passed);
+}
+
+static void test_fasthash64(void) {
+        static const char data[] = "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+        size_t i;
+
+        log_info("/* %s */", __func__);
+
+        for (i = 0; i <= strlen(data); i++) {
+                assert_se(fasthash64(data, i, 4711) == fasthash64(data, i, 4711));
+                assert_se(fasthash64(data, i, 4711) != fasthash64(data, i, 4712));
+        }
+
+        assert_se(fasthash64("foo", 3, 0) != fasthash64("bar", 3, 0));
+        assert_se(fasthash64("foo", 3, 0) != fasthash64("foo", 2, 0));
+}
+
+static char **make_names(unsigned n) {
+        char **names;
+        unsigned i;
+
+        assert_se(names = new0(char*, n + 1));
+        for (i = 0; i < n; i++)
+                assert_se(asprintf(&names[i], "sys-devices-pci0000:00-0000:00:%02x.%u-net-eth%u.device",
+                                   i % 32, i % 8, i) >= 0);
+
+        return names;
+}
+
+static void test_string_fast_hash_ops(void) {
+        _cleanup_hashmap_free_ Hashmap *h = NULL;
+        _cleanup_strv_free_ char **names = NULL;
+        unsigned i, n = 10000;
+
+        log_info("/* %s */", __func__);
+
+        names = make_names(n);
+
+        assert_se(h = hashmap_new(&string_fast_hash_ops));
+        for (i = 0; i < n; i++)
+                assert_se(hashmap_put(h, names[i], UINT_TO_PTR(i + 1)) == 1);
+        assert_se(hashmap_size(h) == n);
+
+        for (i = 0; i < n; i++) {
+                char buf[strlen(names[i]) + 1];
+
+                /* Look up by a copy, so that we test the hash and not the pointer */
+                strcpy(buf, names[i]);
+                assert_se(hashmap_get(h, buf) == UINT_TO_PTR(i + 1));
+                assert_se(hashmap_put(h, buf, NULL) == -EEXIST);
+        }
+
+        assert_se(!hashmap_get(h, "foo.device"));
+
+        for (i = 0; i < n; i += 2)
+                assert_se(hashmap_remove(h, names[i]) == UINT_TO_PTR(i + 1));
+        for (i = 0; i < n; i++)
+                assert_se(hashmap_get(h, names[i]) == (i % 2 == 0 ? NULL : UINT_TO_PTR(i + 1)));
+}
+
+static usec_t bench_lookups(const struct hash_ops *ops, char **names, unsigned n, unsigned rounds) {
+        _cleanup_hashmap_free_ Hashmap *h = NULL;
+        usec_t start;
+        unsigned i, k;
+
+        assert_se(h = hashmap_new(ops));
+        for (i = 0; i < n; i++)
+                assert_se(hashmap_put(h, names[i], names[i]) == 1);
+
+        start = now(CLOCK_MONOTONIC);
+        for (k = 0; k < rounds; k++)
+                for (i = 0; i < n; i++)
+                        assert_se(hashmap_get(h, names[i]) == names[i]);
+
+        return now(CLOCK_MONOTONIC) - start;
+}
+
+static void test_string_fast_hash_ops_benchmark(void) {
+        _cleanup_strv_free_ char **names = NULL;
+        char buf[FORMAT_TIMESPAN_MAX];
+        unsigned n = 5000, rounds;
+        usec_t t;
+
+        log_info("/* %s */", __func__);
+
+        rounds = slow_tests_enabled() ? 200 : 2;
+        names = make_names(n);
+
+        t = bench_lookups(&string_hash_ops, names, n, rounds);
+        log_info("siphash24: %u lookups in %s", n * rounds, format_timespan(buf, sizeof(buf), t, 1));
+
+        t = bench_lookups(&string_fast_hash_ops, names, n, rounds);
+        log_info("fasthash64: %u lookups in %s", n * rounds, format_timespan(buf, sizeof(buf), t, 1));
+}
+
 int main(int argc, const char *argv[]) {
         /* This file tests in test-hashmap-plain.c, and tests in test-hashmap-ordered.c, which is generated
          * from test-hashmap-plain.c. Hashmap tests should be added to test-hashmap-plain.c, and here only if
@@ -127,6 +298,11 @@ int main(int argc, const char *argv[]) {
         test_trivial_compare_func();
         test_string_compare_func();
         test_iterated_cache();
+        test_hashmap_trim_pools();
+        test_hashmap_pools_threads();
+        test_fasthash64();
+        test_string_fast_hash_ops();
+        test_string_fast_hash_ops_benchmark();
 
         return 0;
 }
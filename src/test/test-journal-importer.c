@@ -3,6 +3,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <unistd.h>
 
 #include "alloc-util.h"
 #include "log.h"
@@ -68,11 +69,103 @@ static void test_bad_input(void) {
         assert_se(journal_importer_eof(&imp));
 }
 
+static void test_varint(void) {
+        uint8_t buf[VARINT_SIZE_MAX];
+
+        assert_se(journal_binary_put_varint(buf, 0) == 1);
+        assert_se(buf[0] == 0);
+        assert_se(journal_binary_put_varint(buf, 127) == 1);
+        assert_se(buf[0] == 127);
+        assert_se(journal_binary_put_varint(buf, 128) == 2);
+        assert_se(buf[0] == 0x80 && buf[1] == 0x01);
+        assert_se(journal_binary_put_varint(buf, UINT64_MAX) == VARINT_SIZE_MAX);
+        assert_se(buf[VARINT_SIZE_MAX - 1] == 0x01);
+}
+
+static uint8_t* put_field(uint8_t *p, uint64_t ref, const char *name, const void *value, size_t len) {
+        p += journal_binary_put_varint(p, ref);
+        if (ref == JOURNAL_BINARY_FIELD_NEW) {
+                p += journal_binary_put_varint(p, strlen(name));
+                p = mempcpy(p, name, strlen(name));
+        }
+        p += journal_binary_put_varint(p, len);
+        return mempcpy(p, value, len);
+}
+
+static void test_binary_parsing(void) {
+        _cleanup_(journal_importer_cleanup) JournalImporter imp = JOURNAL_IMPORTER_INIT(STDIN_FILENO);
+        uint8_t buf[512], *p = buf;
+        unsigned n_entries = 0;
+        sd_id128_t boot_id;
+        size_t i, bad;
+        int r = 0;
+
+        imp.passive_fd = true;
+        imp.binary = true;
+
+        /* The first entry introduces all names, the second one refers to them */
+        p = put_field(p, JOURNAL_BINARY_FIELD_NEW, "MESSAGE", "hello", 5);
+        p = put_field(p, JOURNAL_BINARY_FIELD_NEW, "_BOOT_ID", "1531fd22ec84429e85ae888b12fadb91", 32);
+        p = put_field(p, JOURNAL_BINARY_FIELD_NEW, "__REALTIME_TIMESTAMP", "1478389147837945", 16);
+        p = put_field(p, JOURNAL_BINARY_FIELD_NEW, "BINARY", "a\0b\n", 4);
+        *(p++) = JOURNAL_BINARY_FIELD_END;
+
+        p = put_field(p, JOURNAL_BINARY_FIELD_FIRST_REF + 0, NULL, "again", 5);
+        p = put_field(p, JOURNAL_BINARY_FIELD_NEW, "invalid name", "x", 1);
+        p = put_field(p, JOURNAL_BINARY_FIELD_FIRST_REF + 4, NULL, "y", 1);
+        *(p++) = JOURNAL_BINARY_FIELD_END;
+
+        /* A reference to a name that was never introduced */
+        bad = p - buf;
+        p = put_field(p, JOURNAL_BINARY_FIELD_FIRST_REF + 5, NULL, "z", 1);
+
+        assert_se(sd_id128_from_string("1531fd22ec84429e85ae888b12fadb91", &boot_id) >= 0);
+
+        /* Push the data byte by byte, so that every field is split up */
+        for (i = 0; i < (size_t) (p - buf); i++) {
+                assert_se(journal_importer_push_data(&imp, (char*) buf + i, 1) >= 0);
+
+                for (;;) {
+                        r = journal_importer_process_data(&imp);
+                        if (r < 0 || (r == 0 && journal_importer_eof(&imp)))
+                                break;
+                        if (r == 0)
+                                continue;
+
+                        if (n_entries == 0) {
+                                assert_se(imp.iovw.count == 3);
+                                assert_iovec_entry(&imp.iovw.iovec[0], "MESSAGE=hello");
+                                assert_iovec_entry(&imp.iovw.iovec[1], "_BOOT_ID=1531fd22ec84429e85ae888b12fadb91");
+                                assert_se(imp.iovw.iovec[2].iov_len == 11);
+                                assert_se(memcmp(imp.iovw.iovec[2].iov_base, "BINARY=a\0b\n", 11) == 0);
+                                assert_se(imp.ts.realtime == 1478389147837945);
+                                assert_se(sd_id128_equal(imp.boot_id, boot_id));
+                        } else {
+                                assert_se(n_entries == 1);
+                                assert_se(imp.iovw.count == 1);
+                                assert_iovec_entry(&imp.iovw.iovec[0], "MESSAGE=again");
+                        }
+
+                        n_entries++;
+                        journal_importer_drop_iovw(&imp);
+                }
+
+                if (r != -EAGAIN)
+                        break;
+        }
+
+        assert_se(n_entries == 2);
+        assert_se(r == -EBADMSG);
+        assert_se(i == bad);
+}
+
 int main(int argc, char **argv) {
         test_setup_logging(LOG_DEBUG);
 
         test_basic_parsing();
         test_bad_input();
+        test_varint();
+        test_binary_parsing();
 
         return 0;
 }
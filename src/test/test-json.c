@@ -7,6 +7,7 @@
 #include "fileio.h"
 #include "json-internal.h"
 #include "json.h"
+#include "memory-util.h"
 #include "string-util.h"
 #include "strv.h"
 #include "tests.h"
@@ -502,6 +503,159 @@ static void test_bisect(void) {
         }
 }
 
+static void test_parse_strings(void) {
+        _cleanup_(json_variant_unrefp) JsonVariant *v = NULL;
+        unsigned line, column;
+
+        /* Plain strings are taken from the input directly, the others are decoded. Both must give the same
+         * results. */
+
+        assert_se(json_parse("{ \"plain\" : \"foo bar\", \"esc\\u0061ped\" : \"foo\\tbar\", "
+                             "\"utf8\" : \"f\xc3\xbc\xc3\xbc\", \"\" : \"\", \"b\" : true, \"n\" : null }",
+                             0, &v, NULL, NULL) >= 0);
+
+        assert_se(streq(json_variant_string(json_variant_by_key(v, "plain")), "foo bar"));
+        assert_se(streq(json_variant_string(json_variant_by_key(v, "escaped")), "foo\tbar"));
+        assert_se(streq(json_variant_string(json_variant_by_key(v, "utf8")), "f\xc3\xbc\xc3\xbc"));
+        assert_se(streq(json_variant_string(json_variant_by_key(v, "")), ""));
+        assert_se(json_variant_boolean(json_variant_by_key(v, "b")));
+        assert_se(json_variant_is_null(json_variant_by_key(v, "n")));
+
+        /* No source, hence no positions */
+        assert_se(json_variant_get_source(json_variant_by_key(v, "b"), NULL, &line, &column) >= 0);
+        assert_se(line == 0 && column == 0);
+
+        v = json_variant_unref(v);
+
+        /* Control characters and unterminated strings are still refused */
+        assert_se(json_parse("\"foo\x01\"", 0, &v, NULL, NULL) == -EINVAL);
+        assert_se(json_parse("\"foo", 0, &v, NULL, NULL) == -EINVAL);
+        assert_se(json_parse("\"foo\x7f\"", 0, &v, NULL, NULL) == -EINVAL);
+}
+
+static void test_binary_one(const char *data, bool exact) {
+        _cleanup_(json_variant_unrefp) JsonVariant *v = NULL, *w = NULL;
+        _cleanup_free_ void *b = NULL, *c = NULL;
+        size_t size, size2;
+
+        assert_se(json_parse(data, 0, &v, NULL, NULL) >= 0);
+        assert_se(json_variant_format_binary(v, &b, &size) >= 0);
+        assert_se(json_parse_binary(b, size, &w) >= 0);
+
+        log_debug("%s → %zu bytes", data, size);
+
+        /* Reals are encoded as doubles, hence only compare documents without them directly. The encoding
+         * must be stable in any case. */
+        if (exact)
+                assert_se(json_variant_equal(v, w));
+
+        assert_se(json_variant_format_binary(w, &c, &size2) >= 0);
+        assert_se(memcmp_nn(b, size, c, size2) == 0);
+        assert_se(json_variant_is_normalized(v) == json_variant_is_normalized(w));
+
+        /* Every truncation must be refused */
+        for (size_t i = 0; i < size; i++) {
+                _cleanup_(json_variant_unrefp) JsonVariant *x = NULL;
+
+                assert_se(json_parse_binary(b, i, &x) < 0);
+        }
+}
+
+static void test_binary(void) {
+        _cleanup_(json_variant_unrefp) JsonVariant *v = NULL;
+
+        log_info("/* %s */", __func__);
+
+        test_binary_one("null", true);
+        test_binary_one("true", true);
+        test_binary_one("false", true);
+        test_binary_one("0", true);
+        test_binary_one("23", true);
+        test_binary_one("24", true);
+        test_binary_one("-1", true);
+        test_binary_one("-25", true);
+        test_binary_one("65536", true);
+        test_binary_one("18446744073709551615", true);
+        test_binary_one("-9223372036854775808", true);
+        test_binary_one("3.141", false);
+        test_binary_one("-0.5e-10", false);
+        test_binary_one("\"\"", true);
+        test_binary_one("\"f\\u00fc\\u00fc bar\"", true);
+        test_binary_one("[]", true);
+        test_binary_one("{}", true);
+        test_binary_one("[1, [2, [3, [4]]], {\"a\" : null}]", true);
+        test_binary_one("{\"k\": \"v\", \"foo\": [1, 2, 3], \"bar\": {\"zap\": null}}", true);
+        test_binary_one("{\"mutant\": [1, null, \"1\", {\"1\": [1, \"1\"]}], \"thisisaverylongproperty\": 1.27}", false);
+
+        /* Compatible with the CBOR encoding of the same data */
+        assert_se(json_parse_binary((const uint8_t[]) { 0xa1, 0x61, 'a', 0x82, 0x01, 0x20 }, 6, &v) >= 0);
+        assert_se(json_variant_integer(json_variant_by_index(json_variant_by_key(v, "a"), 1)) == -1);
+        v = json_variant_unref(v);
+
+        /* Refuse map keys that aren't strings, byte strings, embedded NULs, bad UTF-8, indefinite lengths
+         * and trailing garbage */
+        assert_se(json_parse_binary((const uint8_t[]) { 0xa1, 0x01, 0x01 }, 3, &v) == -EBADMSG);
+        assert_se(json_parse_binary((const uint8_t[]) { 0x41, 'a' }, 2, &v) == -EBADMSG);
+        assert_se(json_parse_binary((const uint8_t[]) { 0x62, 'a', 0 }, 3, &v) == -EBADMSG);
+        assert_se(json_parse_binary((const uint8_t[]) { 0x61, 0xff }, 2, &v) == -EUCLEAN);
+        assert_se(json_parse_binary((const uint8_t[]) { 0x9f, 0xff }, 2, &v) == -EBADMSG);
+        assert_se(json_parse_binary((const uint8_t[]) { 0xf6, 0xf6 }, 2, &v) == -EBADMSG);
+        assert_se(json_parse_binary((const uint8_t[]) { 0x3b, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff }, 9, &v) == -ERANGE);
+        assert_se(!v);
+}
+
+static void test_binary_benchmark(void) {
+        _cleanup_(json_variant_unrefp) JsonVariant *v = NULL, *array = NULL;
+        usec_t t_text = 0, t_binary = 0, start;
+        char buf[FORMAT_TIMESPAN_MAX];
+        size_t text_size = 0, binary_size = 0;
+        unsigned i, n = slow_tests_enabled() ? 10000 : 100;
+
+        /* No reals in here, so that both round trips give equal results */
+
+        log_info("/* %s */", __func__);
+
+        /* Something that looks like a user record as passed around by userdb */
+        assert_se(json_build(&v, JSON_BUILD_OBJECT(
+                                             JSON_BUILD_PAIR("userName", JSON_BUILD_STRING("someuser")),
+                                             JSON_BUILD_PAIR("uid", JSON_BUILD_UNSIGNED(60513)),
+                                             JSON_BUILD_PAIR("gid", JSON_BUILD_UNSIGNED(60513)),
+                                             JSON_BUILD_PAIR("realName", JSON_BUILD_STRING("Some User")),
+                                             JSON_BUILD_PAIR("homeDirectory", JSON_BUILD_STRING("/home/someuser")),
+                                             JSON_BUILD_PAIR("shell", JSON_BUILD_STRING("/bin/bash")),
+                                             JSON_BUILD_PAIR("memberOf", JSON_BUILD_STRV(STRV_MAKE("wheel", "audio", "video"))),
+                                             JSON_BUILD_PAIR("locked", JSON_BUILD_BOOLEAN(false)),
+                                             JSON_BUILD_PAIR("diskSize", JSON_BUILD_UNSIGNED(UINT64_C(274877906944))),
+                                             JSON_BUILD_PAIR("lastChangeUSec", JSON_BUILD_UNSIGNED(UINT64_C(1588089210314563)))))
+                  >= 0);
+
+        for (i = 0; i < 64; i++)
+                assert_se(json_variant_append_array(&array, v) >= 0);
+
+        for (i = 0; i < n; i++) {
+                _cleanup_(json_variant_unrefp) JsonVariant *a = NULL, *b = NULL;
+                _cleanup_free_ char *text = NULL;
+                _cleanup_free_ void *binary = NULL;
+                int r;
+
+                start = now(CLOCK_MONOTONIC);
+                assert_se((r = json_variant_format(array, 0, &text)) >= 0);
+                assert_se(json_parse(text, 0, &a, NULL, NULL) >= 0);
+                t_text += now(CLOCK_MONOTONIC) - start;
+                text_size = r;
+
+                start = now(CLOCK_MONOTONIC);
+                assert_se(json_variant_format_binary(array, &binary, &binary_size) >= 0);
+                assert_se(json_parse_binary(binary, binary_size, &b) >= 0);
+                t_binary += now(CLOCK_MONOTONIC) - start;
+
+                assert_se(json_variant_equal(a, b));
+        }
+
+        log_info("text: %zu bytes, %u round trips in %s", text_size, n, format_timespan(buf, sizeof(buf), t_text, 1));
+        log_info("binary: %zu bytes, %u round trips in %s", binary_size, n, format_timespan(buf, sizeof(buf), t_binary, 1));
+}
+
 int main(int argc, char *argv[]) {
         test_setup_logging(LOG_DEBUG);
 
@@ -554,6 +708,10 @@ int main(int argc, char *argv[]) {
 
         test_normalize();
         test_bisect();
+        test_parse_strings();
+
+        test_binary();
+        test_binary_benchmark();
 
         return 0;
 }
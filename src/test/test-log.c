@@ -74,6 +74,23 @@ static void test_log_syntax(void) {
         assert_se(log_syntax("unit", LOG_ERR, "filename", 10, SYNTHETIC_ERRNO(ENOTTY), "ENOTTY: %s: %m", "hogehoge") == -ENOTTY);
 }
 
+static void test_log_async(void) {
+        unsigned i;
+
+        assert_se(log_set_async(true) >= 0);
+
+        for (i = 0; i < 1000; i++)
+                log_info("Asynchronous message %u", i);
+
+        test_log_struct();
+        test_long_lines();
+
+        log_async_flush();
+        assert_se(log_get_async_dropped() == 0);
+
+        assert_se(log_set_async(false) >= 0);
+}
+
 int main(int argc, char* argv[]) {
         int target;
 
@@ -86,6 +103,7 @@ int main(int argc, char* argv[]) {
                 test_log_struct();
                 test_long_lines();
                 test_log_syntax();
+                test_log_async();
         }
 
         assert_se(log_info_errno(SYNTHETIC_ERRNO(EUCLEAN), "foo") == -EUCLEAN);
@@ -0,0 +1,295 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <dlfcn.h>
+#include <grp.h>
+#include <pwd.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "alloc-util.h"
+#include "errno-list.h"
+#include "format-util.h"
+#include "log.h"
+#include "main-func.h"
+#include "nss-util.h"
+#include "path-util.h"
+#include "stdio-util.h"
+#include "string-util.h"
+#include "strv.h"
+#include "tests.h"
+#include "time-util.h"
+#include "user-util.h"
+
+/* How often each lookup is repeated to measure how long it takes */
+#define N_ITERATIONS 1000U
+
+static const char* nss_status_to_string(enum nss_status status, char *buf, size_t buf_len) {
+        switch (status) {
+        case NSS_STATUS_TRYAGAIN:
+                return "NSS_STATUS_TRYAGAIN";
+        case NSS_STATUS_UNAVAIL:
+                return "NSS_STATUS_UNAVAIL";
+        case NSS_STATUS_NOTFOUND:
+                return "NSS_STATUS_NOTFOUND";
+        case NSS_STATUS_SUCCESS:
+                return "NSS_STATUS_SUCCESS";
+        case NSS_STATUS_RETURN:
+                return "NSS_STATUS_RETURN";
+        default:
+                snprintf(buf, buf_len, "%i", status);
+                return buf;
+        }
+};
+
+static void* open_handle(const char* dir, const char* module, int flags) {
+        const char *path = NULL;
+        void *handle;
+
+        if (dir)
+                path = strjoina(dir, "/libnss_", module, ".so.2");
+        if (!path || access(path, F_OK) < 0)
+                path = strjoina("libnss_", module, ".so.2");
+
+        handle = dlopen(path, flags);
+        if (!handle)
+                log_error("Failed to load module %s: %s", module, dlerror());
+        return handle;
+}
+
+static void log_timing(const char *fname, const char *what, usec_t start) {
+        char ts[FORMAT_TIMESPAN_MAX];
+        usec_t t;
+
+        t = now(CLOCK_MONOTONIC) - start;
+        log_info("    %s(%s): %u lookups in %s, %.1f µs per lookup",
+                 fname, what, N_ITERATIONS,
+                 format_timespan(ts, sizeof ts, t, 1),
+                 (double) t / N_ITERATIONS);
+}
+
+static void test_getpwnam_r(void *handle, const char *module, const char *name) {
+        const char *fname;
+        _nss_getpwnam_r_t f;
+        char buffer[4096], pretty_status[DECIMAL_STR_MAX(enum nss_status)];
+        struct passwd pwd;
+        enum nss_status status;
+        int errno1 = 999;
+        usec_t start;
+        unsigned i;
+
+        fname = strjoina("_nss_", module, "_getpwnam_r");
+        f = dlsym(handle, fname);
+        log_debug("dlsym(0x%p, %s) → 0x%p", handle, fname, f);
+        if (!f) {
+                log_info("%s not defined", fname);
+                return;
+        }
+
+        status = f(name, &pwd, buffer, sizeof buffer, &errno1);
+        log_info("%s(%s) → status=%s%-20serrno=%d/%s",
+                 fname, name,
+                 nss_status_to_string(status, pretty_status, sizeof pretty_status), "\n",
+                 errno1, errno_to_name(errno1) ?: "---");
+        if (status == NSS_STATUS_SUCCESS)
+                log_info("    %s:%s:"UID_FMT":"GID_FMT":%s:%s:%s",
+                         pwd.pw_name, pwd.pw_passwd, pwd.pw_uid, pwd.pw_gid,
+                         pwd.pw_gecos, pwd.pw_dir, pwd.pw_shell);
+
+        start = now(CLOCK_MONOTONIC);
+        for (i = 0; i < N_ITERATIONS; i++)
+                (void) f(name, &pwd, buffer, sizeof buffer, &errno1);
+        log_timing(fname, name, start);
+}
+
+static void test_getpwuid_r(void *handle, const char *module, uid_t uid) {
+        const char *fname;
+        _nss_getpwuid_r_t f;
+        char buffer[4096], pretty_status[DECIMAL_STR_MAX(enum nss_status)], what[DECIMAL_STR_MAX(uid_t)];
+        struct passwd pwd;
+        enum nss_status status;
+        int errno1 = 999;
+        usec_t start;
+        unsigned i;
+
+        fname = strjoina("_nss_", module, "_getpwuid_r");
+        f = dlsym(handle, fname);
+        log_debug("dlsym(0x%p, %s) → 0x%p", handle, fname, f);
+        if (!f) {
+                log_info("%s not defined", fname);
+                return;
+        }
+
+        xsprintf(what, UID_FMT, uid);
+
+        status = f(uid, &pwd, buffer, sizeof buffer, &errno1);
+        log_info("%s(%s) → status=%s%-20serrno=%d/%s",
+                 fname, what,
+                 nss_status_to_string(status, pretty_status, sizeof pretty_status), "\n",
+                 errno1, errno_to_name(errno1) ?: "---");
+        if (status == NSS_STATUS_SUCCESS)
+                log_info("    %s:%s:"UID_FMT":"GID_FMT":%s:%s:%s",
+                         pwd.pw_name, pwd.pw_passwd, pwd.pw_uid, pwd.pw_gid,
+                         pwd.pw_gecos, pwd.pw_dir, pwd.pw_shell);
+
+        start = now(CLOCK_MONOTONIC);
+        for (i = 0; i < N_ITERATIONS; i++)
+                (void) f(uid, &pwd, buffer, sizeof buffer, &errno1);
+        log_timing(fname, what, start);
+}
+
+static void test_getgrnam_r(void *handle, const char *module, const char *name) {
+        const char *fname;
+        _nss_getgrnam_r_t f;
+        char buffer[4096], pretty_status[DECIMAL_STR_MAX(enum nss_status)];
+        struct group gr;
+        enum nss_status status;
+        int errno1 = 999;
+        usec_t start;
+        unsigned i;
+
+        fname = strjoina("_nss_", module, "_getgrnam_r");
+        f = dlsym(handle, fname);
+        log_debug("dlsym(0x%p, %s) → 0x%p", handle, fname, f);
+        if (!f) {
+                log_info("%s not defined", fname);
+                return;
+        }
+
+        status = f(name, &gr, buffer, sizeof buffer, &errno1);
+        log_info("%s(%s) → status=%s%-20serrno=%d/%s",
+                 fname, name,
+                 nss_status_to_string(status, pretty_status, sizeof pretty_status), "\n",
+                 errno1, errno_to_name(errno1) ?: "---");
+        if (status == NSS_STATUS_SUCCESS)
+                log_info("    %s:%s:"GID_FMT, gr.gr_name, gr.gr_passwd, gr.gr_gid);
+
+        start = now(CLOCK_MONOTONIC);
+        for (i = 0; i < N_ITERATIONS; i++)
+                (void) f(name, &gr, buffer, sizeof buffer, &errno1);
+        log_timing(fname, name, start);
+}
+
+static void test_getgrgid_r(void *handle, const char *module, gid_t gid) {
+        const char *fname;
+        _nss_getgrgid_r_t f;
+        char buffer[4096], pretty_status[DECIMAL_STR_MAX(enum nss_status)], what[DECIMAL_STR_MAX(gid_t)];
+        struct group gr;
+        enum nss_status status;
+        int errno1 = 999;
+        usec_t start;
+        unsigned i;
+
+        fname = strjoina("_nss_", module, "_getgrgid_r");
+        f = dlsym(handle, fname);
+        log_debug("dlsym(0x%p, %s) → 0x%p", handle, fname, f);
+        if (!f) {
+                log_info("%s not defined", fname);
+                return;
+        }
+
+        xsprintf(what, GID_FMT, gid);
+
+        status = f(gid, &gr, buffer, sizeof buffer, &errno1);
+        log_info("%s(%s) → status=%s%-20serrno=%d/%s",
+                 fname, what,
+                 nss_status_to_string(status, pretty_status, sizeof pretty_status), "\n",
+                 errno1, errno_to_name(errno1) ?: "---");
+        if (status == NSS_STATUS_SUCCESS)
+                log_info("    %s:%s:"GID_FMT, gr.gr_name, gr.gr_passwd, gr.gr_gid);
+
+        start = now(CLOCK_MONOTONIC);
+        for (i = 0; i < N_ITERATIONS; i++)
+                (void) f(gid, &gr, buffer, sizeof buffer, &errno1);
+        log_timing(fname, what, start);
+}
+
+static int test_one_module(const char *dir, const char *module, char **names) {
+        void *handle;
+        char **name;
+
+        log_info("======== %s ========", module);
+
+        handle = open_handle(dir, module, RTLD_LAZY|RTLD_NODELETE);
+        if (!handle)
+                return -EINVAL;
+
+        STRV_FOREACH(name, names) {
+                uid_t uid;
+
+                /* Numeric arguments are looked up as UID and GID, everything else as user and group name */
+                if (parse_uid(*name, &uid) >= 0) {
+                        test_getpwuid_r(handle, module, uid);
+                        test_getgrgid_r(handle, module, (gid_t) uid);
+                } else {
+                        test_getpwnam_r(handle, module, *name);
+                        test_getgrnam_r(handle, module, *name);
+                }
+        }
+
+        log_info(" ");
+        dlclose(handle);
+        return 0;
+}
+
+static int parse_argv(int argc, char **argv, char ***the_modules, char ***the_names) {
+        _cleanup_strv_free_ char **modules = NULL, **names = NULL;
+
+        if (argc > 1)
+                modules = strv_new(argv[1]);
+        else
+                modules = strv_new(
+#if ENABLE_NSS_SYSTEMD
+                                "systemd",
+#endif
+                                "files");
+        if (!modules)
+                return -ENOMEM;
+
+        if (argc > 2) {
+                names = strv_copy(argv + 2);
+                if (!names)
+                        return -ENOMEM;
+        } else {
+                /* Synthesized entries, a name and an ID that are not known, and the first dynamic UID */
+                names = strv_new("root", "0", NOBODY_USER_NAME, "foo_no_such_user", "4711");
+                if (!names)
+                        return -ENOMEM;
+
+                if (strv_extendf(&names, UID_FMT, UID_NOBODY) < 0 ||
+                    strv_extendf(&names, UID_FMT, DYNAMIC_UID_MIN) < 0)
+                        return -ENOMEM;
+        }
+
+        *the_modules = TAKE_PTR(modules);
+        *the_names = TAKE_PTR(names);
+        return 0;
+}
+
+static int run(int argc, char **argv) {
+        _cleanup_free_ char *dir = NULL;
+        _cleanup_strv_free_ char **modules = NULL, **names = NULL;
+        char **module;
+        int r;
+
+        test_setup_logging(LOG_INFO);
+
+        r = parse_argv(argc, argv, &modules, &names);
+        if (r < 0) {
+                log_error_errno(r, "Failed to parse arguments: %m");
+                return EXIT_FAILURE;
+        }
+
+        dir = dirname_malloc(argv[0]);
+        if (!dir)
+                return log_oom();
+
+        STRV_FOREACH(module, modules) {
+                r = test_one_module(dir, *module, names);
+                if (r < 0)
+                        return r;
+        }
+
+        return 0;
+}
+
+DEFINE_MAIN_FUNCTION(run);
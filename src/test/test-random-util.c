@@ -1,6 +1,13 @@
 /* SPDX-License-Identifier: LGPL-2.1+ */
 
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "fd-util.h"
 #include "hexdecoct.h"
+#include "io-util.h"
+#include "memory-util.h"
+#include "process-util.h"
 #include "random-util.h"
 #include "log.h"
 #include "tests.h"
@@ -35,6 +42,43 @@ static void test_pseudo_random_bytes(void) {
         }
 }
 
+static void test_random_bytes(void) {
+        uint8_t buf[1024] = {}, zero[sizeof(buf)] = {}, a[16], b[16];
+        _cleanup_close_pair_ int pipefd[2] = { -1, -1 };
+        unsigned i;
+        pid_t pid;
+
+        log_info("/* %s */", __func__);
+
+        for (i = 1; i < 16; i++) {
+                random_bytes(buf, i);
+                assert_se(buf[i] == 0);
+
+                hexdump(stdout, buf, i);
+        }
+
+        /* Requests larger than the buffer are filled completely */
+        random_bytes(buf, sizeof(buf));
+        assert_se(memcmp(buf + sizeof(buf) - 64, zero, 64) != 0);
+
+        /* Parent and child must not hand out the same bytes after fork() */
+        assert_se(pipe2(pipefd, O_CLOEXEC) >= 0);
+
+        pid = fork();
+        assert_se(pid >= 0);
+        if (pid == 0) {
+                random_bytes(a, sizeof(a));
+                assert_se(loop_write(pipefd[1], a, sizeof(a), false) >= 0);
+                _exit(EXIT_SUCCESS);
+        }
+
+        random_bytes(b, sizeof(b));
+        assert_se(loop_read_exact(pipefd[0], a, sizeof(a), false) >= 0);
+        assert_se(wait_for_terminate_and_check("random-child", pid, WAIT_LOG) == EXIT_SUCCESS);
+
+        assert_se(memcmp(a, b, sizeof(a)) != 0);
+}
+
 static void test_rdrand(void) {
         int r, i;
 
@@ -60,6 +104,7 @@ int main(int argc, char **argv) {
         test_genuine_random_bytes(RANDOM_ALLOW_RDRAND);
 
         test_pseudo_random_bytes();
+        test_random_bytes();
 
         test_rdrand();
 
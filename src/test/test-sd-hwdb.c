@@ -3,6 +3,7 @@
 #include "alloc-util.h"
 #include "errno.h"
 #include "tests.h"
+#include "time-util.h"
 
 static int test_failed_enumerate(void) {
         _cleanup_(sd_hwdb_unrefp) sd_hwdb *hwdb = NULL;
@@ -59,6 +60,56 @@ static void test_basic_enumerate(void) {
         assert_se(len1 == len2);
 }
 
+static size_t enumerate_len(sd_hwdb *hwdb, const char *modalias) {
+        const char *key, *value;
+        size_t len = 0;
+
+        SD_HWDB_FOREACH_PROPERTY(hwdb, modalias, key, value)
+                len += strlen(key) + strlen(value);
+
+        return len;
+}
+
+#define N_LOOKUPS 10000U
+
+static void test_cached_lookup(void) {
+        static const char *const modaliases[] = {
+                DELL_MODALIAS,
+                "usb:v046DpC52Bd1201dc00dsc00dp00ic03isc01ip01in00",
+                "pci:v00008086d00001E31sv000017AAsd000021F3bc0Csc03i30",
+                "no-such-modalias-should-exist",
+        };
+        _cleanup_(sd_hwdb_unrefp) sd_hwdb *hwdb = NULL, *uncached = NULL;
+        char buf[FORMAT_TIMESPAN_MAX];
+        size_t len[ELEMENTSOF(modaliases)];
+        usec_t t;
+        unsigned i;
+
+        log_info("/* %s */", __func__);
+
+        assert_se(sd_hwdb_new(&hwdb) == 0);
+
+        for (i = 0; i < ELEMENTSOF(modaliases); i++)
+                len[i] = enumerate_len(hwdb, modaliases[i]);
+
+        /* Results served from the cache must match the ones from the first lookup */
+        t = now(CLOCK_MONOTONIC);
+        for (i = 0; i < N_LOOKUPS; i++)
+                assert_se(enumerate_len(hwdb, modaliases[i % ELEMENTSOF(modaliases)]) == len[i % ELEMENTSOF(modaliases)]);
+        t = now(CLOCK_MONOTONIC) - t;
+        log_info("%u cached lookups: %s", N_LOOKUPS, format_timespan(buf, sizeof(buf), t, 1));
+
+        /* A new object each time, so that nothing is cached */
+        t = now(CLOCK_MONOTONIC);
+        for (i = 0; i < N_LOOKUPS / 1000; i++) {
+                assert_se(sd_hwdb_new(&uncached) == 0);
+                assert_se(enumerate_len(uncached, modaliases[i % ELEMENTSOF(modaliases)]) == len[i % ELEMENTSOF(modaliases)]);
+                uncached = sd_hwdb_unref(uncached);
+        }
+        t = now(CLOCK_MONOTONIC) - t;
+        log_info("%u uncached lookups, including opening the hwdb: %s", N_LOOKUPS / 1000, format_timespan(buf, sizeof(buf), t, 1));
+}
+
 int main(int argc, char *argv[]) {
         int r;
 
@@ -69,6 +120,7 @@ int main(int argc, char *argv[]) {
                 return log_tests_skipped_errno(r, "cannot open hwdb");
 
         test_basic_enumerate();
+        test_cached_lookup();
 
         return 0;
 }
@@ -191,6 +191,111 @@ static void test_serialize_environment(void) {
         assert_se(strv_equal(env, env2));
 }
 
+static void test_serialize_binary(void) {
+        _cleanup_(unlink_tempfilep) char fn[] = "/tmp/test-serialize.XXXXXX";
+        _cleanup_fclose_ FILE *f = NULL;
+        char *line;
+
+        assert_se(fmkostemp_safe(fn, "r+", &f) == 0);
+        log_info("/* %s (%s) */", __func__, fn);
+
+        /* Binary items and text lines may be mixed */
+        fputs("foo.service\n", f);
+        serialize_set_binary(f);
+        assert_se(serialize_item(f, "a", "bbb") == 1);
+        assert_se(serialize_item(f, "a", "") == 1);
+        assert_se(serialize_item_escaped(f, "a", "b\nb") == 1);
+        assert_se(serialize_item_format(f, "a", "%i", 42) == 1);
+        assert_se(serialize_item(f, "a", long_string) == -EINVAL);
+        fputc('\n', f);
+        serialize_set_binary(NULL);
+        assert_se(serialize_item(f, "c", "ddd") == 1);
+
+        rewind(f);
+
+        assert_se(deserialize_read_line(f, &line) > 0);
+        assert_se(streq(line, "foo.service"));
+        free(line);
+        assert_se(deserialize_read_line(f, &line) > 0);
+        assert_se(streq(line, "a=bbb"));
+        free(line);
+        assert_se(deserialize_read_line(f, &line) > 0);
+        assert_se(streq(line, "a="));
+        free(line);
+        assert_se(deserialize_read_line(f, &line) > 0);
+        assert_se(streq(line, "a=b\\nb"));
+        free(line);
+        assert_se(deserialize_read_line(f, &line) > 0);
+        assert_se(streq(line, "a=42"));
+        free(line);
+        assert_se(deserialize_read_line(f, &line) > 0);
+        assert_se(streq(line, ""));
+        free(line);
+        assert_se(deserialize_read_line(f, &line) > 0);
+        assert_se(streq(line, "c=ddd"));
+        free(line);
+        assert_se(deserialize_read_line(f, &line) == 0);
+        assert_se(streq(line, ""));
+        free(line);
+}
+
+static usec_t serialize_benchmark_one(FILE *f, bool binary, unsigned n) {
+        dual_timestamp ts;
+        usec_t t;
+        unsigned i;
+
+        dual_timestamp_get(&ts);
+
+        assert_se(ftruncate(fileno(f), 0) >= 0);
+        rewind(f);
+
+        t = now(CLOCK_MONOTONIC);
+
+        if (binary)
+                serialize_set_binary(f);
+
+        for (i = 0; i < n; i++) {
+                assert_se(serialize_item(f, "state", "running") == 1);
+                assert_se(serialize_item_format(f, "main-pid", "%u", i) == 1);
+                assert_se(serialize_dual_timestamp(f, "state-change-timestamp", &ts) == 1);
+                assert_se(serialize_item_escaped(f, "status-text", "Processing requests...") == 1);
+        }
+
+        serialize_set_binary(NULL);
+        assert_se(fflush(f) == 0);
+        rewind(f);
+
+        for (i = 0;; i++) {
+                _cleanup_free_ char *line = NULL;
+                int r;
+
+                r = deserialize_read_line(f, &line);
+                assert_se(r >= 0);
+                if (r == 0)
+                        break;
+        }
+
+        assert_se(i == 4 * n);
+
+        return now(CLOCK_MONOTONIC) - t;
+}
+
+static void test_serialize_benchmark(void) {
+        _cleanup_(unlink_tempfilep) char fn[] = "/tmp/test-serialize.XXXXXX";
+        _cleanup_fclose_ FILE *f = NULL;
+        const unsigned n = 10000;
+        usec_t text, binary;
+
+        assert_se(fmkostemp_safe(fn, "r+", &f) == 0);
+        log_info("/* %s (%s) */", __func__, fn);
+
+        text = serialize_benchmark_one(f, false, n);
+        binary = serialize_benchmark_one(f, true, n);
+
+        log_info("%u items as text: %s", 4 * n, format_timespan((char[FORMAT_TIMESPAN_MAX]) {}, FORMAT_TIMESPAN_MAX, text, 1));
+        log_info("%u items as binary: %s", 4 * n, format_timespan((char[FORMAT_TIMESPAN_MAX]) {}, FORMAT_TIMESPAN_MAX, binary, 1));
+}
+
 int main(int argc, char *argv[]) {
         test_setup_logging(LOG_INFO);
 
@@ -203,6 +308,8 @@ int main(int argc, char *argv[]) {
         test_serialize_strv();
         test_deserialize_environment();
         test_serialize_environment();
+        test_serialize_binary();
+        test_serialize_benchmark();
 
         return EXIT_SUCCESS;
 }
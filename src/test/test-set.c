@@ -86,11 +86,34 @@ static void test_set_put(void) {
         assert_se(strv_length(t) == 3);
 }
 
+static void test_set_put_strv(void) {
+        _cleanup_set_free_ Set *m = NULL;
+        _cleanup_set_free_free_ Set *d = NULL;
+        char **l = STRV_MAKE("1", "22", "333", "22");
+
+        m = set_new(&string_hash_ops);
+        assert_se(m);
+
+        assert_se(set_put_strv(m, l) == 3);
+        assert_se(set_size(m) == 3);
+        assert_se(set_get(m, (char*) "22") == l[1]);
+        assert_se(set_put_strv(m, l) == 0);
+        assert_se(set_put_strv(m, NULL) == 0);
+
+        d = set_new(&string_hash_ops);
+        assert_se(d);
+
+        assert_se(set_put_strdupv(d, l) == 3);
+        assert_se(set_size(d) == 3);
+        assert_se(set_get(d, (char*) "22") != l[1]);
+}
+
 int main(int argc, const char *argv[]) {
         test_set_steal_first();
         test_set_free_with_destructor();
         test_set_free_with_hash_ops();
         test_set_put();
+        test_set_put_strv();
 
         return 0;
 }
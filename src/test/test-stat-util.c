@@ -7,10 +7,12 @@
 #include "alloc-util.h"
 #include "fd-util.h"
 #include "macro.h"
+#include "missing_stat.h"
 #include "mountpoint-util.h"
 #include "namespace-util.h"
 #include "path-util.h"
 #include "stat-util.h"
+#include "time-util.h"
 #include "tmpfile-util.h"
 
 static void test_files_same(void) {
@@ -48,6 +50,35 @@ static void test_is_symlink(void) {
         unlink(name_link);
 }
 
+static void test_fstatat_masked(void) {
+        char name[] = "/tmp/test-fstatat_masked.XXXXXX";
+        char name_link[] = "/tmp/test-fstatat_masked.link";
+        _cleanup_close_ int fd = -1;
+        struct stat a, b;
+
+        fd = mkostemp_safe(name);
+        assert_se(fd >= 0);
+        assert_se(symlink(name, name_link) >= 0);
+
+        assert_se(fstatat(AT_FDCWD, name, &a, 0) >= 0);
+        assert_se(fstatat_masked(AT_FDCWD, name, 0, STATX_TYPE|STATX_INO|STATX_UID|STATX_MTIME, &b) >= 0);
+        assert_se(a.st_dev == b.st_dev);
+        assert_se(a.st_ino == b.st_ino);
+        assert_se(S_ISREG(b.st_mode));
+        assert_se(a.st_uid == b.st_uid);
+        assert_se(timespec_load_nsec(&a.st_mtim) == timespec_load_nsec(&b.st_mtim));
+
+        assert_se(fstatat_masked(AT_FDCWD, name_link, AT_SYMLINK_NOFOLLOW, STATX_TYPE, &b) >= 0);
+        assert_se(S_ISLNK(b.st_mode));
+        assert_se(fstatat_masked(AT_FDCWD, name_link, 0, STATX_TYPE|STATX_INO, &b) >= 0);
+        assert_se(a.st_ino == b.st_ino);
+
+        assert_se(fstatat_masked(AT_FDCWD, "/a/file/which/does/not/exist/i/guess", 0, STATX_TYPE, &b) == -ENOENT);
+
+        unlink(name);
+        unlink(name_link);
+}
+
 static void test_path_is_fs_type(void) {
         /* run might not be a mount point in build chroots */
         if (path_is_mount_point("/run", NULL, AT_SYMLINK_FOLLOW) > 0) {
@@ -157,6 +188,7 @@ static void test_device_path_make_canonical(void) {
 int main(int argc, char *argv[]) {
         test_files_same();
         test_is_symlink();
+        test_fstatat_masked();
         test_path_is_fs_type();
         test_path_is_temporary_fs();
         test_fd_is_network_ns();
@@ -103,6 +103,7 @@ int main(int argc, char **argv) {
         test_table(socket_result, SOCKET_RESULT);
         test_table(socket_state, SOCKET_STATE);
         test_table(split_mode, SPLIT);
+        test_table(server_transport, SERVER_TRANSPORT);
         test_table(storage, STORAGE);
         test_table(swap_exec_command, SWAP_EXEC_COMMAND);
         test_table(swap_result, SWAP_RESULT);
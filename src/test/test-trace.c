@@ -0,0 +1,59 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include "stdio-util.h"
+#include "string-util.h"
+#include "tests.h"
+#include "trace.h"
+
+static void test_trace_ring(void) {
+        TraceRing ring = {};
+        char buf[32];
+        unsigned i;
+
+        log_info("/* %s */", __func__);
+
+        assert_se(trace_ring_size(&ring) == 0);
+
+        trace_record(&ring, TRACE_GENERATORS, NULL, trace_now());
+        assert_se(trace_ring_size(&ring) == 1);
+        assert_se(trace_ring_get(&ring, 0)->phase == TRACE_GENERATORS);
+        assert_se(!trace_ring_get(&ring, 0)->subject);
+
+        /* Overflow the ring, the oldest events are dropped */
+        for (i = 0; i < TRACE_RING_SIZE + 100; i++) {
+                xsprintf(buf, "unit%u.service", i);
+                trace_record(&ring, TRACE_UNIT_LOAD, buf, trace_now());
+        }
+
+        assert_se(trace_ring_size(&ring) == TRACE_RING_SIZE);
+
+        for (i = 0; i < TRACE_RING_SIZE; i++) {
+                const TraceEvent *e = trace_ring_get(&ring, i);
+
+                xsprintf(buf, "unit%u.service", i + 100);
+                assert_se(e->phase == TRACE_UNIT_LOAD);
+                assert_se(streq(e->subject, buf));
+                assert_se(e->duration < NSEC_INFINITY);
+        }
+
+        trace_ring_done(&ring);
+        assert_se(trace_ring_size(&ring) == 0);
+}
+
+static void test_trace_phase_strings(void) {
+        TracePhase p;
+
+        log_info("/* %s */", __func__);
+
+        for (p = 0; p < _TRACE_PHASE_MAX; p++)
+                assert_se(trace_phase_from_string(trace_phase_to_string(p)) == p);
+}
+
+int main(int argc, char *argv[]) {
+        test_setup_logging(LOG_INFO);
+
+        test_trace_ring();
+        test_trace_phase_strings();
+
+        return 0;
+}
@@ -0,0 +1,127 @@
+/* SPDX-License-Identifier: LGPL-2.1+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "alloc-util.h"
+#include "fd-util.h"
+#include "fs-util.h"
+#include "rm-rf.h"
+#include "stdio-util.h"
+#include "string-util.h"
+#include "tests.h"
+#include "time-util.h"
+#include "tmpfile-util.h"
+#include "udev-node.h"
+
+/* Number of devices claiming the same link in the benchmark, like the members of a large multipath setup */
+#define N_CONTENDERS 1000U
+
+static void add_entry(const char *stackdir, const char *id, int priority, const char *devnode) {
+        _cleanup_free_ char *data = NULL;
+        const char *fn;
+
+        fn = strjoina(stackdir, "/", id);
+        assert_se(asprintf(&data, "%i:%s", priority, devnode) >= 0);
+        assert_se(symlink_atomic(data, fn) >= 0);
+}
+
+static void test_stack_find_prioritized(void) {
+        _cleanup_(rm_rf_physical_and_freep) char *stackdir = NULL;
+        _cleanup_free_ char *target = NULL;
+        _cleanup_close_ int fd = -1;
+        const char *fn;
+        int priority = 0;
+
+        log_info("/* %s */", __func__);
+
+        assert_se(mkdtemp_malloc("/tmp/test-udev-node-XXXXXX", &stackdir) >= 0);
+
+        add_entry(stackdir, "b8:0", 0, "/dev/sda");
+        add_entry(stackdir, "b8:16", 10, "/dev/sdb");
+        add_entry(stackdir, "b8:32", -5, "/dev/sdc");
+        add_entry(stackdir, "b8:48", 20, "/dev/sdd");
+
+        /* Broken entries are ignored */
+        fn = strjoina(stackdir, "/b8:64");
+        assert_se(symlink("100", fn) >= 0);
+        fn = strjoina(stackdir, "/b8:80");
+        assert_se(symlink("100:sde", fn) >= 0);
+
+        /* So are entries in the old format which do not refer to an existing device */
+        fn = strjoina(stackdir, "/b4711:4711");
+        fd = open(fn, O_WRONLY|O_CREAT|O_CLOEXEC|O_TRUNC|O_NOFOLLOW, 0444);
+        assert_se(fd >= 0);
+
+        assert_se(udev_node_stack_find_prioritized(stackdir, NULL, &priority, &target) >= 0);
+        assert_se(streq(target, "/dev/sdd"));
+        assert_se(priority == 20);
+
+        /* Our own entry is skipped */
+        target = mfree(target);
+        priority = 0;
+        assert_se(udev_node_stack_find_prioritized(stackdir, "b8:48", &priority, &target) >= 0);
+        assert_se(streq(target, "/dev/sdb"));
+        assert_se(priority == 10);
+
+        /* A preset target is only replaced by a device with a higher priority */
+        assert_se(free_and_strdup(&target, "/dev/vda") >= 0);
+        priority = 20;
+        assert_se(udev_node_stack_find_prioritized(stackdir, "b8:48", &priority, &target) >= 0);
+        assert_se(streq(target, "/dev/vda"));
+        assert_se(priority == 20);
+
+        assert_se(free_and_strdup(&target, "/dev/vda") >= 0);
+        priority = 15;
+        assert_se(udev_node_stack_find_prioritized(stackdir, NULL, &priority, &target) >= 0);
+        assert_se(streq(target, "/dev/sdd"));
+        assert_se(priority == 20);
+
+        fn = strjoina(stackdir, "/nonexistent");
+        assert_se(udev_node_stack_find_prioritized(fn, NULL, &priority, &target) == -ENOENT);
+}
+
+static void test_stack_find_prioritized_performance(void) {
+        _cleanup_(rm_rf_physical_and_freep) char *stackdir = NULL;
+        _cleanup_free_ char *target = NULL;
+        char ts[FORMAT_TIMESPAN_MAX];
+        int priority = 0;
+        usec_t t;
+        unsigned i;
+
+        log_info("/* %s */", __func__);
+
+        assert_se(mkdtemp_malloc("/tmp/test-udev-node-XXXXXX", &stackdir) >= 0);
+
+        for (i = 0; i < N_CONTENDERS; i++) {
+                char id[STRLEN("b253:") + DECIMAL_STR_MAX(unsigned)], devnode[STRLEN("/dev/dm-") + DECIMAL_STR_MAX(unsigned)];
+
+                xsprintf(id, "b253:%u", i);
+                xsprintf(devnode, "/dev/dm-%u", i);
+                add_entry(stackdir, id, i == N_CONTENDERS / 2 ? 100 : (int) (i % 10), devnode);
+        }
+
+        /* Coldplug resolves the link once for every device claiming it */
+        t = now(CLOCK_MONOTONIC);
+        for (i = 0; i < N_CONTENDERS; i++) {
+                target = mfree(target);
+                priority = 0;
+                assert_se(udev_node_stack_find_prioritized(stackdir, NULL, &priority, &target) >= 0);
+        }
+        t = now(CLOCK_MONOTONIC) - t;
+
+        assert_se(priority == 100);
+        assert_se(streq(target, "/dev/dm-500"));
+
+        log_info("%u lookups in a stack directory with %u entries took %s",
+                 N_CONTENDERS, N_CONTENDERS, format_timespan(ts, sizeof ts, t, 1));
+}
+
+int main(int argc, char *argv[]) {
+        test_setup_logging(LOG_INFO);
+
+        test_stack_find_prioritized();
+        test_stack_find_prioritized_performance();
+
+        return 0;
+}
@@ -140,6 +140,52 @@ static void flood_test(const char *address) {
                 connections[k] = varlink_unref(connections[k]);
 }
 
+static int n_pool_replies = 0;
+static intmax_t pool_sum = 0;
+
+static int pool_reply(Varlink *link, JsonVariant *parameters, const char *error_id, VarlinkReplyFlags flags, void *userdata) {
+        assert_se(!error_id);
+
+        pool_sum += json_variant_integer(json_variant_by_key(parameters, "sum"));
+
+        if (++n_pool_replies == 3)
+                sd_event_exit(varlink_get_event(link), 0);
+
+        return 0;
+}
+
+static void pool_test(const char *address) {
+        _cleanup_(varlink_pool_freep) VarlinkPool *p = NULL;
+        _cleanup_(sd_event_unrefp) sd_event *e = NULL;
+        Varlink *a, *b;
+        intmax_t k;
+
+        log_debug("Testing connection pool...");
+
+        assert_se(sd_event_new(&e) >= 0);
+
+        assert_se(varlink_pool_new(&p, address, 2) >= 0);
+        assert_se(varlink_pool_attach_event(p, e, 0) >= 0);
+        assert_se(varlink_pool_bind_reply(p, pool_reply) >= 0);
+
+        /* Two connections are opened, then the third call is pipelined on the first one */
+        for (k = 0; k < 3; k++) {
+                Varlink *v;
+
+                assert_se(varlink_pool_get(p, &v) >= 0);
+                assert_se(varlink_invokeb(v, "io.test.DoSomething", JSON_BUILD_OBJECT(JSON_BUILD_PAIR("a", JSON_BUILD_INTEGER(k)),
+                                                                                      JSON_BUILD_PAIR("b", JSON_BUILD_INTEGER(100)))) >= 0);
+        }
+
+        assert_se(varlink_pool_get(p, &a) >= 0);
+        assert_se(varlink_pool_get(p, &b) >= 0);
+        assert_se(a == b);
+
+        assert_se(sd_event_loop(e) >= 0);
+        assert_se(n_pool_replies == 3);
+        assert_se(pool_sum == 100 + 101 + 102);
+}
+
 static void *thread(void *arg) {
         _cleanup_(varlink_flush_close_unrefp) Varlink *c = NULL;
         _cleanup_(json_variant_unrefp) JsonVariant *i = NULL;
@@ -160,6 +206,8 @@ static void *thread(void *arg) {
         assert_se(streq_ptr(json_variant_string(json_variant_by_key(o, "method")), "io.test.IDontExist"));
         assert_se(streq(e, VARLINK_ERROR_METHOD_NOT_FOUND));
 
+        pool_test(arg);
+
         flood_test(arg);
 
         assert_se(varlink_send(c, "io.test.Done", NULL) >= 0);
@@ -9,6 +9,8 @@
 #include <sys/timerfd.h>
 #include <sys/timex.h>
 #include <sys/types.h>
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
 
 #include "sd-daemon.h"
 
@@ -50,6 +52,13 @@
 /* Maximum number of missed replies before selecting another source. */
 #define NTP_MAX_MISSED_REPLIES          2
 
+/*
+ * Samples with a round-trip delay larger than this multiple of the best
+ * recent sample are likely to have been queued on one leg only, and are
+ * ignored by the clock filter.
+ */
+#define NTP_MAX_DELAY_FACTOR            2.0
+
 #define RETRY_USEC (30*USEC_PER_SEC)
 #define RATELIMIT_INTERVAL_USEC (10*USEC_PER_SEC)
 #define RATELIMIT_BURST 10
@@ -122,6 +131,7 @@ static int manager_send_request(Manager *m) {
          */
         assert_se(clock_gettime(clock_boottime_or_monotonic(), &m->trans_time_mon) >= 0);
         assert_se(clock_gettime(CLOCK_REALTIME, &m->trans_time) >= 0);
+        m->trans_time_kernel = (struct timespec) {};
         ntpmsg.trans_time.sec = htobe32(m->trans_time.tv_sec + OFFSET_1900_1970);
         ntpmsg.trans_time.frac = htobe32(m->trans_time.tv_nsec);
 
@@ -365,6 +375,11 @@ static bool manager_sample_spike_detection(Manager *m, double offset, double del
         if (fabs(offset) > m->samples[idx_min].delay)
                 return true;
 
+        /* clock filter: the excess delay of a slow sample may skew its offset by up to half of it */
+        if (delay > NTP_MAX_DELAY_FACTOR * m->samples[idx_min].delay &&
+            (delay - m->samples[idx_min].delay) / 2 > jitter)
+                return true;
+
         /* compare the difference between the current offset to the previous offset and jitter */
         return fabs(offset - m->samples[idx_cur].offset) > 3 * jitter;
 }
@@ -399,6 +414,47 @@ static void manager_adjust_poll(Manager *m, double offset, bool spike) {
         }
 }
 
+static int manager_receive_tx_timestamps(Manager *m, int fd) {
+        int n = 0;
+
+        assert(m);
+
+        /* Drain the error queue, where the kernel puts the transmit timestamps of the requests we sent. Keep
+         * the last one, it belongs to the request we are waiting for. */
+        for (;;) {
+                union {
+                        struct cmsghdr cmsghdr;
+                        uint8_t buf[CMSG_SPACE(sizeof(struct scm_timestamping)) +
+                                    CMSG_SPACE(sizeof(struct sock_extended_err) + sizeof(union sockaddr_union))];
+                } control;
+                struct msghdr msghdr = {
+                        .msg_control = &control,
+                        .msg_controllen = sizeof(control),
+                };
+                struct cmsghdr *cmsg;
+
+                if (recvmsg(fd, &msghdr, MSG_ERRQUEUE|MSG_DONTWAIT) < 0) {
+                        if (errno == EAGAIN)
+                                return n;
+
+                        return -errno;
+                }
+
+                n++;
+
+                CMSG_FOREACH(cmsg, &msghdr)
+                        if (cmsg->cmsg_level == SOL_SOCKET &&
+                            cmsg->cmsg_type == SCM_TIMESTAMPING &&
+                            cmsg->cmsg_len == CMSG_LEN(sizeof(struct scm_timestamping))) {
+                                struct scm_timestamping *tss = (struct scm_timestamping *) CMSG_DATA(cmsg);
+
+                                /* ts[0] is the software timestamp, taken in CLOCK_REALTIME */
+                                if (tss->ts[0].tv_sec != 0)
+                                        m->trans_time_kernel = tss->ts[0];
+                        }
+        }
+}
+
 static int manager_receive_response(sd_event_source *source, int fd, uint32_t revents, void *userdata) {
         Manager *m = userdata;
         struct ntp_msg ntpmsg;
@@ -409,7 +465,8 @@ static int manager_receive_response(sd_event_source *source, int fd, uint32_t re
         };
         union {
                 struct cmsghdr cmsghdr;
-                uint8_t buf[CMSG_SPACE(sizeof(struct timeval))];
+                uint8_t buf[CMSG_SPACE(sizeof(struct timeval)) +
+                            CMSG_SPACE(sizeof(struct scm_timestamping))];
         } control;
         union sockaddr_union server_addr;
         struct msghdr msghdr = {
@@ -421,7 +478,7 @@ static int manager_receive_response(sd_event_source *source, int fd, uint32_t re
                 .msg_namelen = sizeof(server_addr),
         };
         struct cmsghdr *cmsg;
-        struct timespec *recv_time = NULL;
+        struct timespec *recv_time = NULL, *origin_time;
         ssize_t len;
         double origin, receive, trans, dest;
         double delay, offset;
@@ -433,7 +490,19 @@ static int manager_receive_response(sd_event_source *source, int fd, uint32_t re
         assert(source);
         assert(m);
 
-        if (revents & (EPOLLHUP|EPOLLERR)) {
+        if (revents & EPOLLERR) {
+                /* Transmit timestamps are queued on the error queue, which raises EPOLLERR too */
+                r = manager_receive_tx_timestamps(m, fd);
+                if (r <= 0) {
+                        log_warning("Server connection returned error.");
+                        return manager_connect(m);
+                }
+
+                if (!(revents & (EPOLLIN|EPOLLHUP)))
+                        return 0;
+        }
+
+        if (revents & EPOLLHUP) {
                 log_warning("Server connection returned error.");
                 return manager_connect(m);
         }
@@ -544,7 +613,10 @@ static int manager_receive_response(sd_event_source *source, int fd, uint32_t re
          *  The round-trip delay, d, and system clock offset, t, are defined as:
          *  d = (T4 - T1) - (T3 - T2)     t = ((T2 - T1) + (T3 - T4)) / 2"
          */
-        origin = ts_to_d(&m->trans_time) + OFFSET_1900_1970;
+        /* Prefer the kernel's transmit timestamp, it does not include the time spent in the network stack */
+        origin_time = m->trans_time_kernel.tv_sec != 0 ? &m->trans_time_kernel : &m->trans_time;
+
+        origin = ts_to_d(origin_time) + OFFSET_1900_1970;
         receive = ntp_ts_to_d(&ntpmsg.recv_time);
         trans = ntp_ts_to_d(&ntpmsg.trans_time);
         dest = ts_to_d(recv_time) + OFFSET_1900_1970;
@@ -598,7 +670,7 @@ static int manager_receive_response(sd_event_source *source, int fd, uint32_t re
 
         /* Save NTP response */
         m->ntpmsg = ntpmsg;
-        m->origin_time = m->trans_time;
+        m->origin_time = *origin_time;
         m->dest_time = *recv_time;
         m->spike = spike;
 
@@ -652,6 +724,12 @@ static int manager_listen_setup(Manager *m) {
         if (r < 0)
                 return r;
 
+        /* Also timestamp outgoing requests in the kernel if possible, without looping the payload back */
+        r = setsockopt_int(m->server_socket, SOL_SOCKET, SO_TIMESTAMPING,
+                           SOF_TIMESTAMPING_TX_SOFTWARE|SOF_TIMESTAMPING_SOFTWARE|SOF_TIMESTAMPING_OPT_TSONLY);
+        if (r < 0)
+                log_debug_errno(r, "Failed to enable transmit timestamps, ignoring: %m");
+
         (void) setsockopt_int(m->server_socket, IPPROTO_IP, IP_TOS, IPTOS_LOWDELAY);
 
         return sd_event_add_io(m->event, &m->event_receive, m->server_socket, EPOLLIN, manager_receive_response, m);
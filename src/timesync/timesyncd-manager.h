@@ -56,6 +56,7 @@ struct Manager {
         /* last sent packet */
         struct timespec trans_time_mon;
         struct timespec trans_time;
+        struct timespec trans_time_kernel;
         usec_t retry_interval;
         bool pending;
 
@@ -10,6 +10,7 @@
 #include <stddef.h>
 #include <stdlib.h>
 #include <sys/file.h>
+#include <sys/wait.h>
 #include <sys/xattr.h>
 #include <sysexits.h>
 #include <time.h>
@@ -37,6 +38,7 @@
 #include "log.h"
 #include "macro.h"
 #include "main-func.h"
+#include "missing_stat.h"
 #include "mkdir.h"
 #include "mountpoint-util.h"
 #include "pager.h"
@@ -44,6 +46,7 @@
 #include "path-lookup.h"
 #include "path-util.h"
 #include "pretty-print.h"
+#include "process-util.h"
 #include "rlimit-util.h"
 #include "rm-rf.h"
 #include "selinux-util.h"
@@ -55,7 +58,9 @@
 #include "string-table.h"
 #include "string-util.h"
 #include "strv.h"
+#include "tmpfile-util.h"
 #include "umask-util.h"
+#include "unit-name.h"
 #include "user-util.h"
 
 /* This reads all files listed in /etc/tmpfiles.d/?*.conf and creates
@@ -146,6 +151,30 @@ typedef struct ItemArray {
         Set *children;
 } ItemArray;
 
+/* A subdirectory that is cleaned up by a worker process. We keep it open until the worker is done, so that
+ * the BSD lock on it is held until we removed it. */
+typedef struct CleanupJob {
+        pid_t pid;
+        DIR *dir;
+        char *name;
+        char *sub_path;
+        struct stat st;
+} CleanupJob;
+
+/* With --incremental we remember for each directory we cleaned up when the oldest file in it that we kept
+ * will be old enough to be removed. As long as no entry was added to or removed from the directory since
+ * (which changes its ctime), we don't have to look at the files in it again until then. */
+typedef struct AgeIndexEntry {
+        nsec_t ctime;
+        usec_t next;
+} AgeIndexEntry;
+
+typedef struct AgeIndex {
+        char *path;
+        Hashmap *old;   /* directory path → AgeIndexEntry, as loaded */
+        Hashmap *new;   /* same, as recorded in this run */
+} AgeIndex;
+
 typedef enum DirectoryType {
         DIRECTORY_RUNTIME,
         DIRECTORY_STATE,
@@ -159,6 +188,8 @@ static bool arg_user = false;
 static OperationMask arg_operation = 0;
 static bool arg_boot = false;
 static PagerFlags arg_pager_flags = 0;
+static unsigned arg_jobs = 1;
+static bool arg_incremental = false;
 
 static char **arg_include_prefixes = NULL;
 static char **arg_exclude_prefixes = NULL;
@@ -167,6 +198,8 @@ static char *arg_replace = NULL;
 
 #define MAX_DEPTH 256
 
+#define AGE_INDEX_DIR "/var/lib/systemd/tmpfiles"
+
 static OrderedHashmap *items = NULL, *globs = NULL;
 static Set *unix_sockets = NULL;
 
@@ -478,6 +511,298 @@ static DIR* opendir_nomod(const char *path) {
         return xopendirat_nomod(AT_FDCWD, path);
 }
 
+static void age_index_done(AgeIndex *index) {
+        assert(index);
+
+        index->path = mfree(index->path);
+        index->old = hashmap_free_free_free(index->old);
+        index->new = hashmap_free_free_free(index->new);
+}
+
+static int age_index_load(AgeIndex *index, const char *instance) {
+        _cleanup_free_ char *escaped = NULL, *fn = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        int r;
+
+        assert(index);
+        assert(instance);
+
+        r = unit_name_path_escape(instance, &escaped);
+        if (r < 0)
+                return r;
+
+        fn = strjoin(AGE_INDEX_DIR "/", escaped, ".index");
+        if (!fn)
+                return -ENOMEM;
+
+        *index = (AgeIndex) {
+                .path = TAKE_PTR(fn),
+        };
+
+        f = fopen(index->path, "re");
+        if (!f)
+                return errno == ENOENT ? 0 : -errno;
+
+        /* Each line consists of the ctime of the directory in ns, the time its oldest file expires in µs,
+         * and the C-escaped path of the directory */
+
+        for (;;) {
+                _cleanup_free_ char *line = NULL, *path = NULL;
+                _cleanup_free_ AgeIndexEntry *e = NULL;
+                const char *t;
+                unsigned long long c, n;
+                int k;
+
+                r = read_line(f, LONG_LINE_MAX, &line);
+                if (r < 0)
+                        return r;
+                if (r == 0)
+                        break;
+
+                if (sscanf(line, "%llu %llu %n", &c, &n, &k) != 2) {
+                        log_debug("Ignoring invalid line in %s.", index->path);
+                        continue;
+                }
+                t = line + k;
+
+                r = cunescape(t, 0, &path);
+                if (r < 0) {
+                        log_debug_errno(r, "Ignoring invalid path in %s: %m", index->path);
+                        continue;
+                }
+
+                e = new(AgeIndexEntry, 1);
+                if (!e)
+                        return -ENOMEM;
+
+                *e = (AgeIndexEntry) {
+                        .ctime = c,
+                        .next = n,
+                };
+
+                r = hashmap_ensure_allocated(&index->old, &string_hash_ops);
+                if (r < 0)
+                        return r;
+
+                r = hashmap_put(index->old, path, e);
+                if (r == -EEXIST)
+                        continue;
+                if (r < 0)
+                        return r;
+
+                TAKE_PTR(path);
+                TAKE_PTR(e);
+        }
+
+        return 0;
+}
+
+static int age_index_save(AgeIndex *index) {
+        _cleanup_free_ char *temp_path = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        AgeIndexEntry *e;
+        Iterator i;
+        const char *path;
+        int r;
+
+        assert(index);
+
+        if (!index->path)
+                return 0;
+
+        if (hashmap_isempty(index->new)) {
+                if (unlink(index->path) < 0 && errno != ENOENT)
+                        return -errno;
+
+                return 0;
+        }
+
+        (void) mkdir_p(AGE_INDEX_DIR, 0755);
+
+        r = fopen_temporary(index->path, &f, &temp_path);
+        if (r < 0)
+                return r;
+
+        HASHMAP_FOREACH_KEY(e, path, index->new, i) {
+                _cleanup_free_ char *escaped = NULL;
+
+                escaped = cescape(path);
+                if (!escaped) {
+                        r = -ENOMEM;
+                        goto fail;
+                }
+
+                fprintf(f, NSEC_FMT " " USEC_FMT " %s\n", e->ctime, e->next, escaped);
+        }
+
+        r = fflush_and_check(f);
+        if (r < 0)
+                goto fail;
+
+        if (rename(temp_path, index->path) < 0) {
+                r = -errno;
+                goto fail;
+        }
+
+        return 0;
+
+fail:
+        (void) unlink(temp_path);
+        return r;
+}
+
+static bool age_index_unchanged(AgeIndex *index, const char *p, const struct stat *ds, usec_t cutoff, usec_t *next) {
+        AgeIndexEntry *e;
+
+        assert(next);
+
+        /* Returns true if none of the files in the directory can be old enough yet, according to the
+         * index. In that case next is set to the time the first of them might be. */
+
+        if (!index)
+                return false;
+
+        e = hashmap_get(index->old, p);
+        if (!e)
+                return false;
+
+        if (e->ctime != timespec_load_nsec(&ds->st_ctim) || e->next < cutoff)
+                return false;
+
+        *next = e->next;
+        return true;
+}
+
+static int age_index_record(AgeIndex *index, const char *p, DIR *d, usec_t next) {
+        _cleanup_free_ AgeIndexEntry *e = NULL;
+        _cleanup_free_ char *k = NULL;
+        struct stat st;
+        int r;
+
+        if (!index)
+                return 0;
+
+        /* Record the ctime after we made our changes */
+        if (fstat(dirfd(d), &st) < 0)
+                return -errno;
+
+        k = strdup(p);
+        e = new(AgeIndexEntry, 1);
+        if (!k || !e)
+                return -ENOMEM;
+
+        *e = (AgeIndexEntry) {
+                .ctime = timespec_load_nsec(&st.st_ctim),
+                .next = next,
+        };
+
+        r = hashmap_ensure_allocated(&index->new, &string_hash_ops);
+        if (r < 0)
+                return r;
+
+        r = hashmap_put(index->new, k, e);
+        if (r < 0)
+                return r;
+
+        TAKE_PTR(k);
+        TAKE_PTR(e);
+        return 0;
+}
+
+static void age_index_forget(AgeIndex *index, const char *p) {
+        void *k;
+
+        if (!index)
+                return;
+
+        free(hashmap_remove2(index->new, p, &k));
+        free(k);
+}
+
+static int dir_cleanup_remove_directory(
+                DIR *d,
+                const char *name,
+                const char *sub_path,
+                const struct stat *s,
+                usec_t cutoff,
+                bool keep_this_level) {
+
+        usec_t age;
+
+        /* Note: if you are wondering why we don't support the sticky bit for excluding
+         * directories from cleaning like we do it for other file system objects: well, the
+         * sticky bit already has a meaning for directories, so we don't want to overload
+         * that. */
+
+        if (keep_this_level) {
+                log_debug("Keeping directory \"%s\".", sub_path);
+                return 0;
+        }
+
+        /* Ignore ctime, we change it when deleting */
+        age = timespec_load(&s->st_mtim);
+        if (age >= cutoff) {
+                char a[FORMAT_TIMESTAMP_MAX];
+                /* Follows spelling in stat(1). */
+                log_debug("Directory \"%s\": modify time %s is too new.",
+                          sub_path,
+                          format_timestamp_us(a, sizeof(a), age));
+                return 0;
+        }
+
+        age = timespec_load(&s->st_atim);
+        if (age >= cutoff) {
+                char a[FORMAT_TIMESTAMP_MAX];
+                log_debug("Directory \"%s\": access time %s is too new.",
+                          sub_path,
+                          format_timestamp_us(a, sizeof(a), age));
+                return 0;
+        }
+
+        log_debug("Removing directory \"%s\".", sub_path);
+        if (unlinkat(dirfd(d), name, AT_REMOVEDIR) < 0) {
+                if (!IN_SET(errno, ENOENT, ENOTEMPTY))
+                        return log_warning_errno(errno, "Failed to remove directory \"%s\", ignoring: %m", sub_path);
+
+                return 0;
+        }
+
+        return 1;
+}
+
+static int wait_for_worker(pid_t *ret_pid) {
+        siginfo_t si;
+
+        assert(ret_pid);
+
+        /* Waits for any of our worker processes to exit, and returns whether it was successful */
+
+        *ret_pid = 0;
+
+        for (;;) {
+                zero(si);
+
+                if (waitid(P_ALL, 0, &si, WEXITED) < 0) {
+                        if (errno == EINTR)
+                                continue;
+
+                        return -errno;
+                }
+
+                *ret_pid = si.si_pid;
+                return si.si_code == CLD_EXITED && si.si_status == EXIT_SUCCESS ? 0 : -EPROTO;
+        }
+}
+
+static void cleanup_job_done(CleanupJob *j) {
+        assert(j);
+
+        j->dir = safe_closedir(j->dir);
+        j->name = mfree(j->name);
+        j->sub_path = mfree(j->sub_path);
+        j->pid = 0;
+}
+
 static int dir_cleanup(
                 Item *i,
                 const char *p,
@@ -487,11 +812,119 @@ static int dir_cleanup(
                 dev_t rootdev,
                 bool mountpoint,
                 int maxdepth,
-                bool keep_this_level) {
+                bool keep_this_level,
+                AgeIndex *index);
+
+static int cleanup_job_start(
+                CleanupJob *j,
+                Item *i,
+                const char *name,
+                const char *sub_path,
+                DIR *sub_dir,
+                const struct stat *s,
+                usec_t cutoff,
+                dev_t rootdev,
+                int maxdepth) {
+
+        int r;
+
+        assert(j);
 
+        *j = (CleanupJob) {
+                .st = *s,
+        };
+
+        j->name = strdup(name);
+        j->sub_path = strdup(sub_path);
+        if (!j->name || !j->sub_path) {
+                cleanup_job_done(j);
+                return log_oom();
+        }
+
+        r = safe_fork("(sd-tmpfiles)", FORK_DEATHSIG|FORK_LOG, &j->pid);
+        if (r < 0) {
+                cleanup_job_done(j);
+                return r;
+        }
+        if (r == 0) {
+                /* Child */
+                arg_jobs = 1;
+
+                r = dir_cleanup(i, sub_path, sub_dir, s, cutoff, rootdev, false, maxdepth, false, NULL);
+                _exit(r < 0 ? EXIT_FAILURE : EXIT_SUCCESS);
+        }
+
+        /* We keep the directory open, and thus the BSD lock taken on it, until we removed it */
+        j->dir = sub_dir;
+        return 0;
+}
+
+static int cleanup_jobs_wait(CleanupJob *jobs, size_t *n_jobs, DIR *d, usec_t cutoff, bool keep_this_level) {
+        size_t k;
+        pid_t pid;
+        int r, q;
+
+        assert(jobs);
+        assert(n_jobs);
+        assert(*n_jobs > 0);
+
+        for (;;) {
+                r = wait_for_worker(&pid);
+                if (r < 0 && pid == 0)
+                        return log_error_errno(r, "Failed to wait for worker: %m");
+
+                for (k = 0; k < *n_jobs; k++)
+                        if (jobs[k].pid == pid)
+                                break;
+                if (k < *n_jobs)
+                        break;
+
+                /* Not one of ours, ignore */
+        }
+
+        if (r < 0)
+                log_debug("Worker cleaning up \"%s\" failed.", jobs[k].sub_path);
+
+        q = dir_cleanup_remove_directory(d, jobs[k].name, jobs[k].sub_path, &jobs[k].st, cutoff, keep_this_level);
+        if (q < 0 && r >= 0)
+                r = q;
+
+        cleanup_job_done(jobs + k);
+        jobs[k] = jobs[--(*n_jobs)];
+
+        return r;
+}
+
+static int dir_cleanup(
+                Item *i,
+                const char *p,
+                DIR *d,
+                const struct stat *ds,
+                usec_t cutoff,
+                dev_t rootdev,
+                bool mountpoint,
+                int maxdepth,
+                bool keep_this_level,
+                AgeIndex *index) {
+
+        _cleanup_free_ CleanupJob *jobs = NULL;
         struct dirent *dent;
-        bool deleted = false;
-        int r = 0;
+        size_t n_jobs = 0;
+        usec_t next = USEC_INFINITY;
+        bool deleted = false, files_unchanged;
+        int r = 0, q;
+
+        files_unchanged = age_index_unchanged(index, p, ds, cutoff, &next);
+        if (files_unchanged)
+                log_debug("Directory \"%s\" unchanged, only descending into subdirectories.", p);
+
+        /* With --jobs= the subdirectories of the top level are processed in parallel. The age index is
+         * kept in memory, hence this is not done when it is used. */
+        if (arg_jobs > 1 && maxdepth == MAX_DEPTH && !index) {
+                jobs = new0(CleanupJob, arg_jobs);
+                if (!jobs)
+                        return log_oom();
+        }
 
         FOREACH_DIRENT_ALL(dent, d, break) {
                 struct stat s;
@@ -501,12 +934,27 @@ static int dir_cleanup(
                 if (dot_or_dot_dot(dent->d_name))
                         continue;
 
-                if (fstatat(dirfd(d), dent->d_name, &s, AT_SYMLINK_NOFOLLOW) < 0) {
-                        if (errno == ENOENT)
+                /* Device nodes are never removed, no need to look at them any closer */
+                if (IN_SET(dent->d_type, DT_CHR, DT_BLK)) {
+                        log_debug("Skipping \"%s/%s\": a device.", p, dent->d_name);
+                        continue;
+                }
+
+                /* Nothing to do for files if we know that none of them is old enough */
+                if (files_unchanged && !IN_SET(dent->d_type, DT_DIR, DT_UNKNOWN))
+                        continue;
+
+                /* Only ask for what we look at below, this is noticeably cheaper on large trees */
+                q = fstatat_masked(dirfd(d), dent->d_name, AT_SYMLINK_NOFOLLOW,
+                                   STATX_TYPE|STATX_MODE|STATX_UID|STATX_ATIME|STATX_MTIME|STATX_CTIME, &s);
+                if (q < 0) {
+                        if (q == -ENOENT)
                                 continue;
 
+                        next = 0;
+
                         /* FUSE, NFS mounts, SELinux might return EACCES */
-                        r = log_full_errno(errno == EACCES ? LOG_DEBUG : LOG_ERR, errno,
+                        r = log_full_errno(q == -EACCES ? LOG_DEBUG : LOG_ERR, q,
                                            "stat(%s/%s) failed: %m", p, dent->d_name);
                         continue;
                 }
@@ -521,8 +969,6 @@ static int dir_cleanup(
                  * do not differ in device major/minors. This type of query is not
                  * supported on all kernels or filesystem types though. */
                 if (S_ISDIR(s.st_mode)) {
-                        int q;
-
                         q = fd_is_mount_point(dirfd(d), dent->d_name, 0);
                         if (q < 0)
                                 log_debug_errno(q, "Failed to determine whether \"%s/%s\" is a mount point, ignoring: %m", p, dent->d_name);
@@ -562,8 +1008,6 @@ static int dir_cleanup(
                         if (maxdepth <= 0)
                                 log_warning("Reached max depth on \"%s\".", sub_path);
                         else {
-                                int q;
-
                                 sub_dir = xopendirat_nomod(dirfd(d), dent->d_name);
                                 if (!sub_dir) {
                                         if (errno != ENOENT)
@@ -577,47 +1021,46 @@ static int dir_cleanup(
                                         continue;
                                 }
 
-                                q = dir_cleanup(i, sub_path, sub_dir, &s, cutoff, rootdev, false, maxdepth-1, false);
-                                if (q < 0)
-                                        r = q;
-                        }
-
-                        /* Note: if you are wondering why we don't support the sticky bit for excluding
-                         * directories from cleaning like we do it for other file system objects: well, the
-                         * sticky bit already has a meaning for directories, so we don't want to overload
-                         * that. */
+                                if (jobs) {
+                                        /* Clean up the subdirectory in a worker, and remove it once that is
+                                         * done. Wait for a free slot first. */
+                                        if (n_jobs >= arg_jobs) {
+                                                q = cleanup_jobs_wait(jobs, &n_jobs, d, cutoff, keep_this_level);
+                                                if (q < 0)
+                                                        r = q;
+                                        }
 
-                        if (keep_this_level) {
-                                log_debug("Keeping directory \"%s\".", sub_path);
-                                continue;
-                        }
+                                        q = cleanup_job_start(jobs + n_jobs, i, dent->d_name, sub_path, sub_dir, &s, cutoff, rootdev, maxdepth-1);
+                                        if (q >= 0) {
+                                                TAKE_PTR(sub_dir);
+                                                n_jobs++;
+                                                continue;
+                                        }
 
-                        /* Ignore ctime, we change it when deleting */
-                        age = timespec_load(&s.st_mtim);
-                        if (age >= cutoff) {
-                                char a[FORMAT_TIMESTAMP_MAX];
-                                /* Follows spelling in stat(1). */
-                                log_debug("Directory \"%s\": modify time %s is too new.",
-                                          sub_path,
-                                          format_timestamp_us(a, sizeof(a), age));
-                                continue;
-                        }
+                                        /* Fall back to doing it ourselves */
+                                }
 
-                        age = timespec_load(&s.st_atim);
-                        if (age >= cutoff) {
-                                char a[FORMAT_TIMESTAMP_MAX];
-                                log_debug("Directory \"%s\": access time %s is too new.",
-                                          sub_path,
-                                          format_timestamp_us(a, sizeof(a), age));
-                                continue;
+                                q = dir_cleanup(i, sub_path, sub_dir, &s, cutoff, rootdev, false, maxdepth-1, false, index);
+                                if (q < 0)
+                                        r = q;
                         }
 
-                        log_debug("Removing directory \"%s\".", sub_path);
-                        if (unlinkat(dirfd(d), dent->d_name, AT_REMOVEDIR) < 0)
-                                if (!IN_SET(errno, ENOENT, ENOTEMPTY))
-                                        r = log_warning_errno(errno, "Failed to remove directory \"%s\", ignoring: %m", sub_path);
+                        q = dir_cleanup_remove_directory(d, dent->d_name, sub_path, &s, cutoff, keep_this_level);
+                        if (q < 0)
+                                r = q;
+                        if (q > 0)
+                                age_index_forget(index, sub_path);
 
                 } else {
+                        usec_t newest;
+
+                        /* When this file will be old enough to be removed */
+                        newest = MAX3(timespec_load(&s.st_mtim),
+                                      timespec_load(&s.st_atim),
+                                      timespec_load(&s.st_ctim));
+                        if (newest >= cutoff)
+                                next = MIN(next, newest);
+
                         /* Skip files for which the sticky bit is set. These are semantics we define, and are
                          * unknown elsewhere. See XDG_RUNTIME_DIR specification for details. */
                         if (s.st_mode & S_ISVTX) {
@@ -639,6 +1082,7 @@ static int dir_cleanup(
                         /* Ignore sockets that are listed in /proc/net/unix */
                         if (S_ISSOCK(s.st_mode) && unix_socket_alive(sub_path)) {
                                 log_debug("Skipping \"%s\": live socket.", sub_path);
+                                next = MIN(next, newest);
                                 continue;
                         }
 
@@ -684,14 +1128,22 @@ static int dir_cleanup(
 
                         log_debug("Removing \"%s\".", sub_path);
                         if (unlinkat(dirfd(d), dent->d_name, 0) < 0)
-                                if (errno != ENOENT)
+                                if (errno != ENOENT) {
                                         r = log_warning_errno(errno, "Failed to remove \"%s\", ignoring: %m", sub_path);
+                                        next = MIN(next, newest);
+                                }
 
                         deleted = true;
                 }
         }
 
 finish:
+        while (n_jobs > 0) {
+                q = cleanup_jobs_wait(jobs, &n_jobs, d, cutoff, keep_this_level);
+                if (q < 0)
+                        r = q;
+        }
+
         if (deleted) {
                 char a[FORMAT_TIMESTAMP_MAX], b[FORMAT_TIMESTAMP_MAX];
                 usec_t age1, age2;
@@ -711,6 +1163,10 @@ finish:
                         log_warning_errno(errno, "Failed to revert timestamps of '%s', ignoring: %m", p);
         }
 
+        q = age_index_record(index, p, d, next);
+        if (q < 0)
+                log_debug_errno(q, "Failed to record \"%s\" in age index, ignoring: %m", p);
+
         return r;
 }
 
@@ -2165,8 +2621,10 @@ static int remove_item(Item *i) {
 }
 
 static int clean_item_instance(Item *i, const char* instance) {
+        _cleanup_(age_index_done) AgeIndex index = {};
         _cleanup_closedir_ DIR *d = NULL;
         struct stat s, ps;
+        int r, q;
         bool mountpoint;
         usec_t cutoff, n;
         char timestamp[FORMAT_TIMESTAMP_MAX];
@@ -2209,8 +2667,22 @@ static int clean_item_instance(Item *i, const char* instance) {
                   instance,
                   format_timestamp_us(timestamp, sizeof(timestamp), cutoff));
 
-        return dir_cleanup(i, instance, d, &s, cutoff, s.st_dev, mountpoint,
-                           MAX_DEPTH, i->keep_first_level);
+        if (arg_incremental) {
+                r = age_index_load(&index, instance);
+                if (r < 0)
+                        log_debug_errno(r, "Failed to load age index of \"%s\", ignoring: %m", instance);
+        }
+
+        r = dir_cleanup(i, instance, d, &s, cutoff, s.st_dev, mountpoint,
+                        MAX_DEPTH, i->keep_first_level, arg_incremental ? &index : NULL);
+
+        if (arg_incremental) {
+                q = age_index_save(&index);
+                if (q < 0)
+                        log_warning_errno(q, "Failed to save age index of \"%s\", ignoring: %m", instance);
+        }
+
+        return r;
 }
 
 static int clean_item(Item *i) {
@@ -2850,6 +3322,8 @@ static int help(void) {
                "     --exclude-prefix=PATH  Ignore rules with the specified prefix\n"
                "     --root=PATH            Operate on an alternate filesystem root\n"
                "     --replace=PATH         Treat arguments as replacement for PATH\n"
+               "     --jobs=N               Remove and clean up independent paths in N processes\n"
+               "     --incremental          Skip unchanged directories when cleaning up\n"
                "     --no-pager             Do not pipe output into a pager\n"
                "\nSee the %s for details.\n"
                , program_invocation_short_name
@@ -2873,6 +3347,8 @@ static int parse_argv(int argc, char *argv[]) {
                 ARG_EXCLUDE_PREFIX,
                 ARG_ROOT,
                 ARG_REPLACE,
+                ARG_JOBS,
+                ARG_INCREMENTAL,
                 ARG_NO_PAGER,
         };
 
@@ -2889,6 +3365,8 @@ static int parse_argv(int argc, char *argv[]) {
                 { "exclude-prefix", required_argument,   NULL, ARG_EXCLUDE_PREFIX },
                 { "root",           required_argument,   NULL, ARG_ROOT           },
                 { "replace",        required_argument,   NULL, ARG_REPLACE        },
+                { "jobs",           required_argument,   NULL, ARG_JOBS           },
+                { "incremental",    no_argument,         NULL, ARG_INCREMENTAL    },
                 { "no-pager",       no_argument,         NULL, ARG_NO_PAGER       },
                 {}
         };
@@ -2957,6 +3435,18 @@ static int parse_argv(int argc, char *argv[]) {
                         arg_replace = optarg;
                         break;
 
+                case ARG_JOBS:
+                        r = safe_atou(optarg, &arg_jobs);
+                        if (r < 0)
+                                return log_error_errno(r, "Failed to parse --jobs= argument: %s", optarg);
+                        if (arg_jobs == 0)
+                                return log_error_errno(SYNTHETIC_ERRNO(EINVAL), "The argument to --jobs= must be positive.");
+                        break;
+
+                case ARG_INCREMENTAL:
+                        arg_incremental = true;
+                        break;
+
                 case ARG_NO_PAGER:
                         arg_pager_flags |= PAGER_DISABLE;
                         break;
@@ -2976,6 +3466,10 @@ static int parse_argv(int argc, char *argv[]) {
                 return log_error_errno(SYNTHETIC_ERRNO(EINVAL),
                                        "Option --replace= is not supported with --cat-config");
 
+        if (arg_incremental && (arg_user || arg_root))
+                return log_error_errno(SYNTHETIC_ERRNO(EINVAL),
+                                       "Option --incremental is not supported with --user or --root=");
+
         if (arg_replace && optind >= argc)
                 return log_error_errno(SYNTHETIC_ERRNO(EINVAL),
                                        "When --replace= is given, some configuration items must be specified");
@@ -3154,6 +3648,136 @@ static int link_parent(ItemArray *a) {
         return 0;
 }
 
+static void item_array_mark_done(ItemArray *array, OperationMask operation) {
+        Iterator i;
+        ItemArray *c;
+        size_t n;
+
+        assert(array);
+
+        /* Marks a whole tree of item arrays as processed, after a worker took care of it */
+
+        for (n = 0; n < array->n_items; n++)
+                array->items[n].done |= operation;
+
+        SET_FOREACH(c, array->children, i)
+                item_array_mark_done(c, operation);
+}
+
+static char *item_array_literal_prefix(ItemArray *array) {
+        const char *path, *e;
+
+        /* Returns the part of the path of the array before the first path component with a glob in it,
+         * i.e. the directory the array might touch anything below of. */
+
+        path = array->items[0].path;
+        e = strpbrk(path, GLOB_CHARS);
+        if (!e)
+                return strdup(path);
+
+        while (e > path && e[-1] != '/')
+                e--;
+
+        if (e <= path + 1)
+                return strdup("/");
+
+        return strndup(path, e - path - 1);
+}
+
+static int process_item_arrays_parallel(OperationMask operation) {
+        _cleanup_free_ ItemArray **roots = NULL;
+        _cleanup_strv_free_ char **prefixes = NULL;
+        _cleanup_free_ bool *conflicting = NULL;
+        size_t n_roots = 0, n_allocated = 0, k, l;
+        unsigned n_workers = 0;
+        Iterator iterator;
+        ItemArray *a;
+        pid_t pid;
+        int r = 0, q;
+
+        /* Runs the top-level item arrays whose paths don't overlap with any other in worker processes, up to
+         * arg_jobs at a time. The item arrays handed off are marked as done, hence the ones left over (and
+         * those that could not be forked off) are processed by the caller afterwards, in the usual order. */
+
+        ORDERED_HASHMAP_FOREACH(a, items, iterator) {
+                if (a->parent || a->n_items <= 0)
+                        continue;
+
+                if (!GREEDY_REALLOC(roots, n_allocated, n_roots + 1))
+                        return log_oom();
+
+                roots[n_roots++] = a;
+        }
+        ORDERED_HASHMAP_FOREACH(a, globs, iterator) {
+                if (a->parent || a->n_items <= 0)
+                        continue;
+
+                if (!GREEDY_REALLOC(roots, n_allocated, n_roots + 1))
+                        return log_oom();
+
+                roots[n_roots++] = a;
+        }
+
+        if (n_roots < 2)
+                return 0;
+
+        prefixes = new0(char*, n_roots + 1);
+        conflicting = new0(bool, n_roots);
+        if (!prefixes || !conflicting)
+                return log_oom();
+
+        for (k = 0; k < n_roots; k++) {
+                prefixes[k] = item_array_literal_prefix(roots[k]);
+                if (!prefixes[k])
+                        return log_oom();
+        }
+
+        for (k = 0; k < n_roots; k++)
+                for (l = k + 1; l < n_roots; l++)
+                        if (path_startswith(prefixes[k], prefixes[l]) ||
+                            path_startswith(prefixes[l], prefixes[k]))
+                                conflicting[k] = conflicting[l] = true;
+
+        for (k = 0; k < n_roots; k++) {
+                if (conflicting[k])
+                        continue;
+
+                if (n_workers >= arg_jobs) {
+                        q = wait_for_worker(&pid);
+                        if (q < 0 && pid == 0)
+                                return log_error_errno(q, "Failed to wait for worker: %m");
+                        if (q < 0 && r >= 0)
+                                r = q;
+
+                        n_workers--;
+                }
+
+                q = safe_fork("(sd-tmpfiles)", FORK_DEATHSIG|FORK_LOG, NULL);
+                if (q < 0)
+                        break; /* Leave the rest to the caller */
+                if (q == 0) {
+                        /* Child */
+                        arg_jobs = 1;
+
+                        q = process_item_array(roots[k], operation);
+                        _exit(q < 0 ? EXIT_FAILURE : EXIT_SUCCESS);
+                }
+
+                item_array_mark_done(roots[k], operation);
+                n_workers++;
+        }
+
+        for (; n_workers > 0; n_workers--) {
+                q = wait_for_worker(&pid);
+                if (q < 0 && pid == 0)
+                        return log_error_errno(q, "Failed to wait for worker: %m");
+                if (q < 0 && r >= 0)
+                        r = q;
+        }
+
+        return r;
+}
+
 DEFINE_PRIVATE_HASH_OPS_WITH_VALUE_DESTRUCTOR(item_array_hash_ops, char, string_hash_func, string_compare_func,
                                               ItemArray, item_array_free);
 
@@ -3251,6 +3875,14 @@ static int run(int argc, char *argv[]) {
                 if (op == 0) /* Nothing requested in this phase */
                         continue;
 
+                /* With --jobs= hand off independent subtrees to worker processes first. Creation is always
+                 * done in order, later entries frequently depend on earlier ones. */
+                if (phase == PHASE_REMOVE_AND_CLEAN && arg_jobs > 1) {
+                        k = process_item_arrays_parallel(op);
+                        if (k < 0 && r >= 0)
+                                r = k;
+                }
+
                 /* The non-globbing ones usually create things, hence we apply them first */
                 ORDERED_HASHMAP_FOREACH(a, items, iterator) {
                         k = process_item_array(a, op);
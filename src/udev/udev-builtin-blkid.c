@@ -10,6 +10,8 @@
 #include <getopt.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
 #include <sys/stat.h>
 
 #include "sd-id128.h"
@@ -18,14 +20,28 @@
 #include "blkid-util.h"
 #include "device-util.h"
 #include "efi-loader.h"
+#include "device-private.h"
 #include "errno-util.h"
+#include "escape.h"
 #include "fd-util.h"
+#include "fileio.h"
 #include "gpt.h"
+#include "mkdir.h"
 #include "parse-util.h"
 #include "string-util.h"
+#include "strv.h"
 #include "strxcpyx.h"
+#include "tmpfile-util.h"
 #include "udev-builtin.h"
 
+/* Results of earlier probes, reused for 'change' events of devices which were not written to since */
+#define BLKID_CACHE_DIR "/run/udev/blkid/"
+
+/* Most superblocks are found in the first few KiB of a device, RAID metadata and the backup GPT header at its
+ * very end */
+#define BLKID_READAHEAD_HEAD (128U * 1024U)
+#define BLKID_READAHEAD_TAIL (64U * 1024U)
+
 static void print_property(sd_device *dev, bool test, const char *name, const char *value) {
         char s[256];
 
@@ -94,7 +110,7 @@ static void print_property(sd_device *dev, bool test, const char *name, const ch
         }
 }
 
-static int find_gpt_root(sd_device *dev, blkid_probe pr, bool test) {
+static int find_gpt_root(blkid_probe pr, char **ret) {
 
 #if defined(GPT_ROOT_NATIVE) && ENABLE_EFI
 
@@ -104,6 +120,7 @@ static int find_gpt_root(sd_device *dev, blkid_probe pr, bool test) {
         int i, nvals, r;
 
         assert(pr);
+        assert(ret);
 
         /* Iterate through the partitions on this disk, and see if the
          * EFI ESP we booted from is on it. If so, find the first root
@@ -171,8 +188,10 @@ static int find_gpt_root(sd_device *dev, blkid_probe pr, bool test) {
 
         /* We found the ESP on this disk, and also found a root
          * partition, nice! Let's export its UUID */
-        if (found_esp && root_id)
-                udev_builtin_add_property(dev, test, "ID_PART_GPT_AUTO_ROOT_UUID", root_id);
+        if (found_esp && root_id) {
+                *ret = TAKE_PTR(root_id);
+                return 1;
+        }
 #endif
 
         return 0;
@@ -212,11 +231,208 @@ static int probe_superblocks(blkid_probe pr) {
         return blkid_do_safeprobe(pr);
 }
 
+static int probe_stamp(sd_device *dev, int fd, int64_t offset, bool noraid, char **ret) {
+        const char *diskseq = NULL;
+        uint64_t size = 0;
+        struct stat st;
+
+        assert(dev);
+        assert(fd >= 0);
+        assert(ret);
+
+        /* Identifies the contents of the device. Writes through the device node update its mtime, media changes
+         * and resizes show in the disk sequence number or the size, and a device removed and added again gets
+         * a new device node. */
+
+        if (fstat(fd, &st) < 0)
+                return -errno;
+
+        /* The mtime is only updated once per clock tick, results are hence only cached if the device was not
+         * written to in the last second */
+        if (timespec_load(&st.st_mtim) + USEC_PER_SEC > now(CLOCK_REALTIME))
+                return -EBUSY;
+
+        if (S_ISBLK(st.st_mode) && ioctl(fd, BLKGETSIZE64, &size) < 0)
+                return -errno;
+
+        (void) sd_device_get_sysattr_value(dev, "diskseq", &diskseq);
+
+        if (asprintf(ret, "%u:%u ino=%ju mtime="NSEC_FMT" size=%"PRIu64" diskseq=%s offset=%"PRIi64" noraid=%s",
+                     major(st.st_rdev), minor(st.st_rdev), (uintmax_t) st.st_ino, timespec_load_nsec(&st.st_mtim),
+                     size, strempty(diskseq), offset, yes_no(noraid)) < 0)
+                return -ENOMEM;
+
+        return 0;
+}
+
+static int probe_cache_load(sd_device *dev, const char *stamp, char ***ret_values, char **ret_root_id) {
+        _cleanup_strv_free_ char **values = NULL;
+        _cleanup_free_ char *root_id = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        const char *id, *path;
+        bool valid = false;
+        int r;
+
+        assert(dev);
+        assert(stamp);
+        assert(ret_values);
+        assert(ret_root_id);
+
+        r = device_get_id_filename(dev, &id);
+        if (r < 0)
+                return r;
+
+        path = strjoina(BLKID_CACHE_DIR, id);
+        f = fopen(path, "re");
+        if (!f)
+                return errno == ENOENT ? 0 : -errno;
+
+        for (;;) {
+                _cleanup_free_ char *line = NULL, *value = NULL;
+                const char *p;
+
+                r = read_line(f, LONG_LINE_MAX, &line);
+                if (r < 0)
+                        return r;
+                if (r == 0)
+                        break;
+
+                if ((p = startswith(line, "S:"))) {
+                        /* The stamp comes first, anything else means the file is not ours */
+                        if (!streq(p, stamp))
+                                return 0;
+                        valid = true;
+
+                } else if (!valid)
+                        return 0;
+
+                else if ((p = startswith(line, "V:"))) {
+                        const char *eq;
+
+                        eq = strchr(p, '=');
+                        if (!eq)
+                                return -EBADMSG;
+
+                        r = cunescape(eq + 1, 0, &value);
+                        if (r < 0)
+                                return r;
+
+                        r = strv_consume_pair(&values, strndup(p, eq - p), TAKE_PTR(value));
+                        if (r < 0)
+                                return r;
+
+                } else if ((p = startswith(line, "R:"))) {
+                        r = free_and_strdup(&root_id, p);
+                        if (r < 0)
+                                return r;
+                }
+        }
+
+        if (!valid)
+                return 0;
+
+        *ret_values = TAKE_PTR(values);
+        *ret_root_id = TAKE_PTR(root_id);
+        return 1;
+}
+
+static int probe_cache_save(sd_device *dev, const char *stamp, char **values, const char *root_id) {
+        _cleanup_free_ char *path_tmp = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        const char *id, *path;
+        char **name, **data;
+        int r;
+
+        assert(dev);
+        assert(stamp);
+
+        r = device_get_id_filename(dev, &id);
+        if (r < 0)
+                return r;
+
+        path = strjoina(BLKID_CACHE_DIR, id);
+
+        r = mkdir_parents(path, 0755);
+        if (r < 0)
+                return r;
+
+        r = fopen_temporary(path, &f, &path_tmp);
+        if (r < 0)
+                return r;
+
+        fprintf(f, "S:%s\n", stamp);
+
+        STRV_FOREACH_PAIR(name, data, values) {
+                _cleanup_free_ char *escaped = NULL;
+
+                escaped = cescape(*data);
+                if (!escaped) {
+                        r = -ENOMEM;
+                        goto fail;
+                }
+
+                fprintf(f, "V:%s=%s\n", *name, escaped);
+        }
+
+        if (root_id)
+                fprintf(f, "R:%s\n", root_id);
+
+        r = fflush_and_check(f);
+        if (r < 0)
+                goto fail;
+
+        if (rename(path_tmp, path) < 0) {
+                r = -errno;
+                goto fail;
+        }
+
+        return 0;
+
+fail:
+        (void) unlink(path_tmp);
+        return r;
+}
+
+static void add_properties(sd_device *dev, bool test, char **values, const char *root_id) {
+        const char *root_partition = NULL;
+        char **name, **data;
+
+        /* If the device is a partition then its parent passed the root partition UUID to the device */
+        (void) sd_device_get_property_value(dev, "ID_PART_GPT_AUTO_ROOT_UUID", &root_partition);
+
+        STRV_FOREACH_PAIR(name, data, values) {
+                print_property(dev, test, *name, *data);
+
+                /* Is this a partition that matches the root partition
+                 * property inherited from the parent? */
+                if (root_partition && streq(*name, "PART_ENTRY_UUID") && streq(*data, root_partition))
+                        udev_builtin_add_property(dev, test, "ID_PART_GPT_AUTO_ROOT", "1");
+        }
+
+        if (root_id)
+                udev_builtin_add_property(dev, test, "ID_PART_GPT_AUTO_ROOT_UUID", root_id);
+}
+
+static void readahead_superblocks(int fd, int64_t offset) {
+        uint64_t size;
+
+        /* blkid reads the locations of the various superblocks one after the other. Let the kernel read the
+         * areas they are found in at once, and in the background while we are still setting up the prober. */
+
+        (void) posix_fadvise(fd, offset, BLKID_READAHEAD_HEAD, POSIX_FADV_WILLNEED);
+
+        if (ioctl(fd, BLKGETSIZE64, &size) >= 0 && size > (uint64_t) offset + BLKID_READAHEAD_HEAD + BLKID_READAHEAD_TAIL)
+                (void) posix_fadvise(fd, size - BLKID_READAHEAD_TAIL, BLKID_READAHEAD_TAIL, POSIX_FADV_WILLNEED);
+}
+
 static int builtin_blkid(sd_device *dev, int argc, char *argv[], bool test) {
-        const char *devnode, *root_partition = NULL, *data, *name;
+        _cleanup_strv_free_ char **values = NULL;
+        _cleanup_free_ char *stamp = NULL, *root_id = NULL;
         _cleanup_(blkid_free_probep) blkid_probe pr = NULL;
+        const char *devnode, *data, *name;
         bool noraid = false, is_gpt = false;
         _cleanup_close_ int fd = -1;
+        DeviceAction action = _DEVICE_ACTION_INVALID;
         int64_t offset = 0;
         int nvals, i, r;
 
@@ -247,6 +463,36 @@ static int builtin_blkid(sd_device *dev, int argc, char *argv[], bool test) {
                 }
         }
 
+        r = sd_device_get_devname(dev, &devnode);
+        if (r < 0)
+                return log_device_debug_errno(dev, r, "Failed to get device name: %m");
+
+        fd = open(devnode, O_RDONLY|O_CLOEXEC|O_NONBLOCK);
+        if (fd < 0)
+                return log_device_debug_errno(dev, errno, "Failed to open block device %s: %m", devnode);
+
+        if (!test) {
+                r = probe_stamp(dev, fd, offset, noraid, &stamp);
+                if (r < 0)
+                        log_device_debug_errno(dev, r, "Not caching probing results of %s: %m", devnode);
+        }
+
+        /* A 'change' event of a device nobody wrote to, e.g. from 'udevadm trigger', does not need to read the
+         * superblocks again */
+        (void) device_get_action(dev, &action);
+        if (stamp && action == DEVICE_ACTION_CHANGE) {
+                r = probe_cache_load(dev, stamp, &values, &root_id);
+                if (r < 0)
+                        log_device_debug_errno(dev, r, "Failed to read cached probing results, ignoring: %m");
+                if (r > 0) {
+                        log_device_debug(dev, "Contents of %s unchanged, using cached probing results", devnode);
+                        add_properties(dev, test, values, root_id);
+                        return 0;
+                }
+        }
+
+        readahead_superblocks(fd, offset);
+
         errno = 0;
         pr = blkid_new_probe();
         if (!pr)
@@ -260,14 +506,6 @@ static int builtin_blkid(sd_device *dev, int argc, char *argv[], bool test) {
         if (noraid)
                 blkid_probe_filter_superblocks_usage(pr, BLKID_FLTR_NOTIN, BLKID_USAGE_RAID);
 
-        r = sd_device_get_devname(dev, &devnode);
-        if (r < 0)
-                return log_device_debug_errno(dev, r, "Failed to get device name: %m");
-
-        fd = open(devnode, O_RDONLY|O_CLOEXEC|O_NONBLOCK);
-        if (fd < 0)
-                return log_device_debug_errno(dev, errno, "Failed to open block device %s: %m", devnode);
-
         errno = 0;
         r = blkid_probe_set_device(pr, fd, offset, 0);
         if (r < 0)
@@ -279,9 +517,6 @@ static int builtin_blkid(sd_device *dev, int argc, char *argv[], bool test) {
         if (r < 0)
                 return log_device_debug_errno(dev, r, "Failed to probe superblocks: %m");
 
-        /* If the device is a partition then its parent passed the root partition UUID to the device */
-        (void) sd_device_get_property_value(dev, "ID_PART_GPT_AUTO_ROOT_UUID", &root_partition);
-
         errno = 0;
         nvals = blkid_probe_numof_values(pr);
         if (nvals < 0)
@@ -291,20 +526,25 @@ static int builtin_blkid(sd_device *dev, int argc, char *argv[], bool test) {
                 if (blkid_probe_get_value(pr, i, &name, &data, NULL) < 0)
                         continue;
 
-                print_property(dev, test, name, data);
+                if (strv_extend(&values, name) < 0 ||
+                    strv_extend(&values, data) < 0)
+                        return log_oom();
 
                 /* Is this a disk with GPT partition table? */
                 if (streq(name, "PTTYPE") && streq(data, "gpt"))
                         is_gpt = true;
-
-                /* Is this a partition that matches the root partition
-                 * property inherited from the parent? */
-                if (root_partition && streq(name, "PART_ENTRY_UUID") && streq(data, root_partition))
-                        udev_builtin_add_property(dev, test, "ID_PART_GPT_AUTO_ROOT", "1");
         }
 
         if (is_gpt)
-                find_gpt_root(dev, pr, test);
+                (void) find_gpt_root(pr, &root_id);
+
+        add_properties(dev, test, values, root_id);
+
+        if (stamp) {
+                r = probe_cache_save(dev, stamp, values, root_id);
+                if (r < 0)
+                        log_device_debug_errno(dev, r, "Failed to cache probing results, ignoring: %m");
+        }
 
         return 0;
 }
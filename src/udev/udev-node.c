@@ -17,6 +17,7 @@
 #include "fs-util.h"
 #include "libudev-util.h"
 #include "mkdir.h"
+#include "parse-util.h"
 #include "path-util.h"
 #include "selinux-util.h"
 #include "smack-util.h"
@@ -104,46 +105,79 @@ static int node_symlink(sd_device *dev, const char *node, const char *slink) {
         return r;
 }
 
-/* find device node of device with highest priority */
-static int link_find_prioritized(sd_device *dev, bool add, const char *stackdir, char **ret) {
-        _cleanup_closedir_ DIR *dir = NULL;
-        _cleanup_free_ char *target = NULL;
-        struct dirent *dent;
-        int r, priority = 0;
-
-        assert(!add || dev);
-        assert(stackdir);
-        assert(ret);
-
-        if (add) {
-                const char *devnode;
-
-                r = device_get_devlink_priority(dev, &priority);
+/* Every entry in a stack directory is a symlink named after the ID of a device claiming the link, pointing to
+ * "<priority>:<devnode>", so that the link can be resolved without loading the databases of all devices claiming
+ * it. Older versions created empty regular files instead, for those we still have to look at the device. */
+static int stack_entry_read(int dfd, const char *id, int *ret_priority, char **ret_devnode) {
+        _cleanup_(sd_device_unrefp) sd_device *dev_db = NULL;
+        _cleanup_free_ char *buf = NULL;
+        const char *devnode;
+        char *colon;
+        int r, priority;
+
+        r = readlinkat_malloc(dfd, id, &buf);
+        if (r >= 0) {
+                colon = strchr(buf, ':');
+                if (!colon)
+                        return -EINVAL;
+                *colon = '\0';
+
+                r = safe_atoi(buf, &priority);
                 if (r < 0)
                         return r;
 
-                r = sd_device_get_devname(dev, &devnode);
+                if (!path_is_absolute(colon + 1))
+                        return -EINVAL;
+
+                r = free_and_strdup(ret_devnode, colon + 1);
                 if (r < 0)
                         return r;
 
-                target = strdup(devnode);
-                if (!target)
-                        return -ENOMEM;
+                *ret_priority = priority;
+                return 0;
         }
+        if (r != -EINVAL)
+                return r;
 
-        dir = opendir(stackdir);
-        if (!dir) {
-                if (target) {
-                        *ret = TAKE_PTR(target);
-                        return 0;
-                }
+        r = sd_device_new_from_device_id(&dev_db, id);
+        if (r < 0)
+                return r;
+
+        r = sd_device_get_devname(dev_db, &devnode);
+        if (r < 0)
+                return r;
+
+        r = device_get_devlink_priority(dev_db, &priority);
+        if (r < 0)
+                return r;
+
+        r = free_and_strdup(ret_devnode, devnode);
+        if (r < 0)
+                return r;
+
+        *ret_priority = priority;
+        return 0;
+}
+
+int udev_node_stack_find_prioritized(const char *stackdir, const char *skip_id, int *priority, char **target) {
+        _cleanup_closedir_ DIR *dir = NULL;
+        _cleanup_free_ char *devnode = NULL;
+        struct dirent *dent;
+        int r;
+
+        assert(stackdir);
+        assert(priority);
+        assert(target);
+
+        /* Looks for the entry with the highest priority in the stack directory, ignoring the one named
+         * 'skip_id'. If *target is already set on input, it is only replaced by an entry with a higher
+         * priority than *priority. */
 
+        dir = opendir(stackdir);
+        if (!dir)
                 return -errno;
-        }
 
         FOREACH_DIRENT_ALL(dent, dir, break) {
-                _cleanup_(sd_device_unrefp) sd_device *dev_db = NULL;
-                const char *devnode, *id_filename;
                 int db_prio = 0;
 
                 if (dent->d_name[0] == '\0')
@@ -151,37 +185,65 @@ static int link_find_prioritized(sd_device *dev, bool add, const char *stackdir,
                 if (dent->d_name[0] == '.')
                         continue;
 
-                log_device_debug(dev, "Found '%s' claiming '%s'", dent->d_name, stackdir);
-
-                if (device_get_id_filename(dev, &id_filename) < 0)
-                        continue;
+                log_debug("Found '%s' claiming '%s'", dent->d_name, stackdir);
 
                 /* did we find ourself? */
-                if (streq(dent->d_name, id_filename))
+                if (streq_ptr(dent->d_name, skip_id))
                         continue;
 
-                if (sd_device_new_from_device_id(&dev_db, dent->d_name) < 0)
+                r = stack_entry_read(dirfd(dir), dent->d_name, &db_prio, &devnode);
+                if (r == -ENOMEM)
+                        return r;
+                if (r < 0)
                         continue;
 
-                if (sd_device_get_devname(dev_db, &devnode) < 0)
+                if (*target && db_prio <= *priority)
                         continue;
 
-                if (device_get_devlink_priority(dev_db, &db_prio) < 0)
-                        continue;
+                log_debug("'%s' claims priority %i for '%s'", dent->d_name, db_prio, stackdir);
 
-                if (target && db_prio <= priority)
-                        continue;
+                free_and_replace(*target, devnode);
+                *priority = db_prio;
+        }
+
+        return 0;
+}
+
+/* find device node of device with highest priority */
+static int link_find_prioritized(sd_device *dev, bool add, const char *stackdir, char **ret) {
+        _cleanup_free_ char *target = NULL;
+        const char *id_filename;
+        int r, priority = 0;
+
+        assert(dev);
+        assert(stackdir);
+        assert(ret);
 
-                log_device_debug(dev_db, "Device claims priority %i for '%s'", db_prio, stackdir);
+        if (add) {
+                const char *devnode;
 
-                r = free_and_strdup(&target, devnode);
+                r = device_get_devlink_priority(dev, &priority);
                 if (r < 0)
                         return r;
-                priority = db_prio;
+
+                r = sd_device_get_devname(dev, &devnode);
+                if (r < 0)
+                        return r;
+
+                target = strdup(devnode);
+                if (!target)
+                        return -ENOMEM;
         }
 
+        r = device_get_id_filename(dev, &id_filename);
+        if (r < 0)
+                return r;
+
+        r = udev_node_stack_find_prioritized(stackdir, id_filename, &priority, &target);
+        if (r == -ENOMEM)
+                return r;
         if (!target)
-                return -ENOENT;
+                return r < 0 ? r : -ENOENT;
 
         *ret = TAKE_PTR(target);
         return 0;
@@ -220,17 +282,29 @@ static int link_update(sd_device *dev, const char *slink, bool add) {
         } else
                 (void) node_symlink(dev, target, slink);
 
-        if (add)
-                do {
-                        _cleanup_close_ int fd = -1;
+        if (add) {
+                _cleanup_free_ char *data = NULL;
+                const char *devnode;
+                int priority;
+
+                r = device_get_devlink_priority(dev, &priority);
+                if (r < 0)
+                        return log_device_debug_errno(dev, r, "Failed to get devlink priority: %m");
 
+                r = sd_device_get_devname(dev, &devnode);
+                if (r < 0)
+                        return log_device_debug_errno(dev, r, "Failed to get device node: %m");
+
+                if (asprintf(&data, "%i:%s", priority, devnode) < 0)
+                        return log_oom();
+
+                do {
                         r = mkdir_parents(filename, 0755);
                         if (!IN_SET(r, 0, -ENOENT))
                                 break;
-                        fd = open(filename, O_WRONLY|O_CREAT|O_CLOEXEC|O_TRUNC|O_NOFOLLOW, 0444);
-                        if (fd < 0)
-                                r = -errno;
+                        r = symlink_atomic(data, filename);
                 } while (r == -ENOENT);
+        }
 
         return r;
 }
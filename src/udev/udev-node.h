@@ -13,3 +13,5 @@ int udev_node_add(sd_device *dev, bool apply,
                   OrderedHashmap *seclabel_list);
 int udev_node_remove(sd_device *dev);
 int udev_node_update_old_links(sd_device *dev, sd_device *dev_old);
+
+int udev_node_stack_find_prioritized(const char *stackdir, const char *skip_id, int *priority, char **target);
@@ -152,18 +152,35 @@ struct UdevRuleToken {
 struct UdevRuleLine {
         char *line;
         unsigned line_number;
+        unsigned index; /* position among the lines of all files */
         UdevRuleLineType type;
 
         const char *label;
         const char *goto_label;
         UdevRuleLine *goto_line;
 
+        /* Prefilter, so that lines that can't match are skipped without walking their tokens: the
+         * actions all ACTION matches accept, and the first KERNEL and SUBSYSTEM matches */
+        unsigned action_mask;
+        UdevRuleToken *kernel_token;
+        UdevRuleToken *subsystem_token;
+
         UdevRuleFile *rule_file;
         UdevRuleToken *current_token;
         LIST_HEAD(UdevRuleToken, tokens);
         LIST_FIELDS(UdevRuleLine, rule_lines);
 };
 
+/* The properties of the event the prefilters are checked against, looked up once per event */
+typedef struct UdevRulePrefilter {
+        DeviceAction action;
+        const char *sysname;
+        const char *subsystem;
+        bool has_sysname:1;
+        bool has_subsystem:1;
+        UdevRuleLineType mask;
+} UdevRulePrefilter;
+
 struct UdevRuleFile {
         char *filename;
         UdevRuleLine *current_line;
@@ -178,15 +195,32 @@ struct UdevRules {
         Hashmap *known_groups;
         UdevRuleFile *current_file;
         LIST_HEAD(UdevRuleFile, rule_files);
+        unsigned n_lines;
+
+        /* The position while processing an event. This is kept here rather than in the files and lines,
+         * so that processing events doesn't write to the rules: workers share them with the main
+         * process copy-on-write, and every line written to would cost each worker a page copy. */
+        UdevRuleLine *current_line;
+        UdevRuleToken *current_token;
+
+        /* subsystem → UdevRuleLineIndex, built on first use */
+        Hashmap *lines_by_subsystem;
 };
 
+/* The lines of all files that may apply to devices of one subsystem, in order */
+typedef struct UdevRuleLineIndex {
+        size_t n_lines;
+        UdevRuleLine *lines[];
+} UdevRuleLineIndex;
+
 /*** Logging helpers ***/
 
 #define log_rule_full(device, rules, level, error, fmt, ...)            \
         ({                                                              \
                 UdevRules *_r = (rules);                                \
                 UdevRuleFile *_f = _r ? _r->current_file : NULL;        \
-                UdevRuleLine *_l = _f ? _f->current_line : NULL;        \
+                UdevRuleLine *_l = _r && _r->current_line ? _r->current_line : \
+                                   _f ? _f->current_line : NULL;        \
                 const char *_n = _f ? _f->filename : NULL;              \
                                                                         \
                 log_device_full(device, level, error, "%s:%u " fmt,     \
@@ -303,6 +337,7 @@ UdevRules *udev_rules_free(UdevRules *rules) {
 
         hashmap_free_free_key(rules->known_users);
         hashmap_free_free_key(rules->known_groups);
+        hashmap_free_free_free(rules->lines_by_subsystem);
         return mfree(rules);
 }
 
@@ -1076,6 +1111,37 @@ static void sort_tokens(UdevRuleLine *rule_line) {
         }
 }
 
+static bool token_match_string(UdevRuleToken *token, const char *str);
+
+static void rule_line_setup_prefilter(UdevRuleLine *rule_line) {
+        UdevRuleToken *token;
+
+        assert(rule_line);
+
+        /* All tokens sorted before TK_M_SUBSYSTEM are pure matches, hence checking ACTION, KERNEL and
+         * SUBSYSTEM first doesn't change the outcome. The set of actions is small and fixed, so ACTION
+         * matches are resolved into a bit mask right away. */
+
+        rule_line->action_mask = (1U << _DEVICE_ACTION_MAX) - 1;
+
+        LIST_FOREACH(tokens, token, rule_line->tokens) {
+                if (token->type > TK_M_SUBSYSTEM)
+                        break;
+
+                if (token->type == TK_M_ACTION) {
+                        DeviceAction a;
+
+                        for (a = 0; a < _DEVICE_ACTION_MAX; a++)
+                                if (!token_match_string(token, device_action_to_string(a)))
+                                        rule_line->action_mask &= ~(1U << a);
+
+                } else if (token->type == TK_M_KERNEL && !rule_line->kernel_token)
+                        rule_line->kernel_token = token;
+                else if (token->type == TK_M_SUBSYSTEM && !rule_line->subsystem_token)
+                        rule_line->subsystem_token = token;
+        }
+}
+
 static int rule_add_line(UdevRules *rules, const char *line_str, unsigned line_nr) {
         _cleanup_(udev_rule_line_freep) UdevRuleLine *rule_line = NULL;
         _cleanup_free_ char *line = NULL;
@@ -1103,6 +1169,7 @@ static int rule_add_line(UdevRules *rules, const char *line_str, unsigned line_n
         *rule_line = (UdevRuleLine) {
                 .line = TAKE_PTR(line),
                 .line_number = line_nr,
+                .index = rules->n_lines++,
                 .rule_file = rule_file,
         };
 
@@ -1134,6 +1201,7 @@ static int rule_add_line(UdevRules *rules, const char *line_str, unsigned line_n
         }
 
         sort_tokens(rule_line);
+        rule_line_setup_prefilter(rule_line);
         TAKE_PTR(rule_line);
         return 0;
 }
@@ -1540,7 +1608,7 @@ static int udev_rule_apply_token_to_event(
          * 1 on the current token matches the event, and
          * negative errno on some critical errors. */
 
-        token = rules->current_file->current_line->current_token;
+        token = rules->current_token;
 
         switch (token->type) {
         case TK_M_ACTION: {
@@ -2166,16 +2234,14 @@ static int udev_rule_apply_parent_token_to_event(
                 UdevRules *rules,
                 UdevEvent *event) {
 
-        UdevRuleLine *line;
         UdevRuleToken *head;
         int r;
 
-        line = rules->current_file->current_line;
-        head = rules->current_file->current_line->current_token;
+        head = rules->current_token;
         event->dev_parent = event->dev;
         for (;;) {
-                LIST_FOREACH(tokens, line->current_token, head) {
-                        if (!token_is_for_parents(line->current_token))
+                LIST_FOREACH(tokens, rules->current_token, head) {
+                        if (!token_is_for_parents(rules->current_token))
                                 return true; /* All parent tokens match. */
                         r = udev_rule_apply_token_to_event(rules, event->dev_parent, event, 0, NULL);
                         if (r < 0)
@@ -2183,7 +2249,7 @@ static int udev_rule_apply_parent_token_to_event(
                         if (r == 0)
                                 break;
                 }
-                if (!line->current_token)
+                if (!rules->current_token)
                         /* All parent tokens match. But no assign tokens in the line. Hmm... */
                         return true;
 
@@ -2194,38 +2260,77 @@ static int udev_rule_apply_parent_token_to_event(
         }
 }
 
+static int udev_rule_prefilter_init(UdevRulePrefilter *f, sd_device *dev) {
+        int r;
+
+        assert(f);
+        assert(dev);
+
+        *f = (UdevRulePrefilter) {
+                .mask = LINE_HAS_GOTO | LINE_UPDATE_SOMETHING,
+        };
+
+        r = device_get_action(dev, &f->action);
+        if (r < 0)
+                return r;
+
+        if (f->action != DEVICE_ACTION_REMOVE) {
+                if (sd_device_get_devnum(dev, NULL) >= 0)
+                        f->mask |= LINE_HAS_DEVLINK;
+
+                if (sd_device_get_ifindex(dev, NULL) >= 0)
+                        f->mask |= LINE_HAS_NAME;
+        }
+
+        /* If the lookups fail, the tokens are evaluated as usual, and report the failure themselves */
+        f->has_sysname = sd_device_get_sysname(dev, &f->sysname) >= 0;
+
+        r = sd_device_get_subsystem(dev, &f->subsystem);
+        f->has_subsystem = r >= 0 || r == -ENOENT;
+        if (r < 0)
+                f->subsystem = NULL;
+
+        return 0;
+}
+
+static bool udev_rule_line_prefilter_token(UdevRuleLine *line, UdevRuleToken *token, const UdevRulePrefilter *f) {
+        /* Returns true if the token was already checked by the prefilter */
+        return token->type == TK_M_ACTION ||
+                (token == line->kernel_token && f->has_sysname) ||
+                (token == line->subsystem_token && f->has_subsystem);
+}
+
 static int udev_rule_apply_line_to_event(
                 UdevRules *rules,
                 UdevEvent *event,
+                const UdevRulePrefilter *f,
                 usec_t timeout_usec,
                 Hashmap *properties_list,
                 UdevRuleLine **next_line) {
 
-        UdevRuleLine *line = rules->current_file->current_line;
-        UdevRuleLineType mask = LINE_HAS_GOTO | LINE_UPDATE_SOMETHING;
+        UdevRuleLine *line = rules->current_line;
         UdevRuleToken *token, *next_token;
         bool parents_done = false;
-        DeviceAction action;
         int r;
 
-        r = device_get_action(event->dev, &action);
-        if (r < 0)
-                return r;
+        if ((line->type & f->mask) == 0)
+                return 0;
 
-        if (action != DEVICE_ACTION_REMOVE) {
-                if (sd_device_get_devnum(event->dev, NULL) >= 0)
-                        mask |= LINE_HAS_DEVLINK;
+        if (!FLAGS_SET(line->action_mask, 1U << f->action))
+                return 0;
 
-                if (sd_device_get_ifindex(event->dev, NULL) >= 0)
-                        mask |= LINE_HAS_NAME;
-        }
+        if (line->kernel_token && f->has_sysname && !token_match_string(line->kernel_token, f->sysname))
+                return 0;
 
-        if ((line->type & mask) == 0)
+        if (line->subsystem_token && f->has_subsystem && !token_match_string(line->subsystem_token, f->subsystem))
                 return 0;
 
         event->esc = ESCAPE_UNSET;
         LIST_FOREACH_SAFE(tokens, token, next_token, line->tokens) {
-                line->current_token = token;
+                rules->current_token = token;
+
+                if (udev_rule_line_prefilter_token(line, token, f))
+                        continue;
 
                 if (token_is_for_parents(token)) {
                         if (parents_done)
@@ -2250,12 +2355,101 @@ static int udev_rule_apply_line_to_event(
         return 0;
 }
 
+static int udev_rules_get_line_index(UdevRules *rules, const char *subsystem, UdevRuleLineIndex **ret) {
+        _cleanup_free_ UdevRuleLineIndex *index = NULL;
+        _cleanup_free_ char *key = NULL;
+        UdevRuleLineIndex *shrunk;
+        UdevRuleFile *file;
+        UdevRuleLine *line;
+        int r;
+
+        assert(rules);
+        assert(ret);
+
+        /* Most lines match on a single subsystem, hence for each subsystem remember the lines whose
+         * SUBSYSTEM prefilter lets its devices pass, so that all others aren't even looked at. The rules
+         * never change once loaded, so the result stays valid until they are freed. */
+
+        index = hashmap_get(rules->lines_by_subsystem, strempty(subsystem));
+        if (index) {
+                *ret = TAKE_PTR(index);
+                return 0;
+        }
+
+        r = hashmap_ensure_allocated(&rules->lines_by_subsystem, &string_hash_ops);
+        if (r < 0)
+                return r;
+
+        key = strdup(strempty(subsystem));
+        if (!key)
+                return -ENOMEM;
+
+        index = malloc(offsetof(UdevRuleLineIndex, lines) + rules->n_lines * sizeof(UdevRuleLine*));
+        if (!index)
+                return -ENOMEM;
+
+        index->n_lines = 0;
+        LIST_FOREACH(rule_files, file, rules->rule_files)
+                LIST_FOREACH(rule_lines, line, file->rule_lines) {
+                        if (line->subsystem_token && !token_match_string(line->subsystem_token, subsystem))
+                                continue;
+
+                        assert(index->n_lines < rules->n_lines);
+                        index->lines[index->n_lines++] = line;
+                }
+
+        /* Give back what the lines filtered out don't need */
+        shrunk = realloc(index, offsetof(UdevRuleLineIndex, lines) + index->n_lines * sizeof(UdevRuleLine*));
+        if (shrunk)
+                index = shrunk;
+
+        r = hashmap_put(rules->lines_by_subsystem, key, index);
+        if (r < 0)
+                return r;
+
+        TAKE_PTR(key);
+        *ret = TAKE_PTR(index);
+        return 0;
+}
+
+static int udev_rules_apply_index_to_event(
+                UdevRules *rules,
+                UdevRuleLineIndex *index,
+                UdevEvent *event,
+                const UdevRulePrefilter *f,
+                usec_t timeout_usec,
+                Hashmap *properties_list) {
+
+        size_t i;
+        int r;
+
+        for (i = 0; i < index->n_lines; i++) {
+                UdevRuleLine *line = index->lines[i], *next_line = NULL;
+
+                rules->current_file = line->rule_file;
+                rules->current_line = line;
+
+                r = udev_rule_apply_line_to_event(rules, event, f, timeout_usec, properties_list, &next_line);
+                if (r < 0)
+                        return r;
+
+                /* Skip forward to the GOTO target, or to the first line after it in the index */
+                if (next_line)
+                        while (i + 1 < index->n_lines && index->lines[i + 1]->index < next_line->index)
+                                i++;
+        }
+
+        return 0;
+}
+
 int udev_rules_apply_to_event(
                 UdevRules *rules,
                 UdevEvent *event,
                 usec_t timeout_usec,
                 Hashmap *properties_list) {
 
+        UdevRuleLineIndex *index;
+        UdevRulePrefilter f;
         UdevRuleFile *file;
         UdevRuleLine *next_line;
         int r;
@@ -2263,10 +2457,22 @@ int udev_rules_apply_to_event(
         assert(rules);
         assert(event);
 
+        r = udev_rule_prefilter_init(&f, event->dev);
+        if (r < 0)
+                return r;
+
+        if (f.has_subsystem) {
+                r = udev_rules_get_line_index(rules, f.subsystem, &index);
+                if (r >= 0)
+                        return udev_rules_apply_index_to_event(rules, index, event, &f, timeout_usec, properties_list);
+
+                log_device_debug_errno(event->dev, r, "Failed to build rules index for subsystem, ignoring: %m");
+        }
+
         LIST_FOREACH(rule_files, file, rules->rule_files) {
                 rules->current_file = file;
-                LIST_FOREACH_SAFE(rule_lines, file->current_line, next_line, file->rule_lines) {
-                        r = udev_rule_apply_line_to_event(rules, event, timeout_usec, properties_list, &next_line);
+                LIST_FOREACH_SAFE(rule_lines, rules->current_line, next_line, file->rule_lines) {
+                        r = udev_rule_apply_line_to_event(rules, event, &f, timeout_usec, properties_list, &next_line);
                         if (r < 0)
                                 return r;
                 }
@@ -145,9 +145,9 @@ int udev_watch_end(sd_device *dev) {
         return 0;
 }
 
-int udev_watch_lookup(int wd, sd_device **ret) {
+/* Returns the device ID of the device a watch handle belongs to, 0 if there's no such watch */
+int udev_watch_lookup_id(int wd, char **ret) {
         char filename[STRLEN("/run/udev/watch/") + DECIMAL_STR_MAX(int)];
-        _cleanup_free_ char *device = NULL;
         int r;
 
         assert(ret);
@@ -161,12 +161,25 @@ int udev_watch_lookup(int wd, sd_device **ret) {
                                        "Invalid watch handle.");
 
         xsprintf(filename, "/run/udev/watch/%d", wd);
-        r = readlink_malloc(filename, &device);
+        r = readlink_malloc(filename, ret);
         if (r == -ENOENT)
                 return 0;
         if (r < 0)
                 return log_debug_errno(r, "Failed to read link '%s': %m", filename);
 
+        return 1;
+}
+
+int udev_watch_lookup(int wd, sd_device **ret) {
+        _cleanup_free_ char *device = NULL;
+        int r;
+
+        assert(ret);
+
+        r = udev_watch_lookup_id(wd, &device);
+        if (r <= 0)
+                return r;
+
         r = sd_device_new_from_device_id(ret, device);
         if (r == -ENODEV)
                 return 0;
@@ -8,3 +8,4 @@ int udev_watch_restore(void);
 int udev_watch_begin(sd_device *dev);
 int udev_watch_end(sd_device *dev);
 int udev_watch_lookup(int wd, sd_device **ret);
+int udev_watch_lookup_id(int wd, char **ret);
@@ -10,7 +10,9 @@
 #include "device-private.h"
 #include "fd-util.h"
 #include "fileio.h"
+#include "id128-util.h"
 #include "path-util.h"
+#include "parse-util.h"
 #include "process-util.h"
 #include "set.h"
 #include "string-util.h"
@@ -22,14 +24,34 @@
 
 static bool arg_verbose = false;
 static bool arg_dry_run = false;
+static bool arg_uuid = false;
+static unsigned arg_parallel = 0;
 
-static int exec_list(sd_device_enumerator *e, const char *action, Set *settle_set) {
+static int wait_for_settle(sd_event *event, Set *settle_set, unsigned max_pending) {
+        int r;
+
+        assert(event);
+        assert(settle_set);
+
+        /* Processes events from the device monitor until no more than max_pending of the triggered events
+         * are still waiting to be processed by udevd. */
+        while (set_size(settle_set) > max_pending) {
+                r = sd_event_run(event, (uint64_t) -1);
+                if (r < 0)
+                        return log_error_errno(r, "Failed to run event loop: %m");
+        }
+
+        return 0;
+}
+
+static int exec_list(sd_device_enumerator *e, const char *action, sd_event *event, Set *settle_set) {
         sd_device *d;
         int r, ret = 0;
 
         FOREACH_DEVICE_AND_SUBSYSTEM(e, d) {
                 _cleanup_free_ char *filename = NULL;
-                const char *syspath;
+                char uuid_str[ID128_UUID_STRING_MAX];
+                const char *syspath, *key;
 
                 if (sd_device_get_syspath(d, &syspath) < 0)
                         continue;
@@ -39,11 +61,42 @@ static int exec_list(sd_device_enumerator *e, const char *action, Set *settle_se
                 if (arg_dry_run)
                         continue;
 
+                /* Don't flood udevd: wait until some of the events we already triggered went through. */
+                if (settle_set && arg_parallel > 0) {
+                        r = wait_for_settle(event, settle_set, arg_parallel - 1);
+                        if (r < 0)
+                                return r;
+                }
+
                 filename = path_join(syspath, "uevent");
                 if (!filename)
                         return log_oom();
 
-                r = write_string_file(filename, action, WRITE_STRING_FILE_DISABLE_BUFFER);
+                key = syspath;
+                if (arg_uuid) {
+                        _cleanup_free_ char *buf = NULL;
+                        sd_id128_t id;
+
+                        r = sd_id128_randomize(&id);
+                        if (r < 0)
+                                return log_error_errno(r, "Failed to generate random UUID: %m");
+
+                        buf = strjoin(action, " ", id128_to_uuid_string(id, uuid_str));
+                        if (!buf)
+                                return log_oom();
+
+                        r = write_string_file(filename, buf, WRITE_STRING_FILE_DISABLE_BUFFER);
+                        if (r == -EINVAL) {
+                                /* Kernels before 4.13 don't know synthetic UUIDs. Track our events by
+                                 * their syspath instead from now on. */
+                                log_debug_errno(r, "Failed to write '%s' to '%s', kernel does not support synthetic UUIDs, ignoring: %m",
+                                                buf, filename);
+                                arg_uuid = false;
+                        } else
+                                key = uuid_str;
+                }
+                if (!arg_uuid)
+                        r = write_string_file(filename, action, WRITE_STRING_FILE_DISABLE_BUFFER);
                 if (r < 0) {
                         bool ignore = IN_SET(r, -ENOENT, -EACCES, -ENODEV, -EROFS);
 
@@ -57,8 +110,11 @@ static int exec_list(sd_device_enumerator *e, const char *action, Set *settle_se
                         continue;
                 }
 
+                if (arg_uuid && arg_verbose)
+                        printf("%s %s\n", uuid_str, syspath);
+
                 if (settle_set) {
-                        r = set_put_strdup(settle_set, syspath);
+                        r = set_put_strdup(settle_set, key);
                         if (r < 0)
                                 return log_oom();
                 }
@@ -70,7 +126,7 @@ static int exec_list(sd_device_enumerator *e, const char *action, Set *settle_se
 static int device_monitor_handler(sd_device_monitor *m, sd_device *dev, void *userdata) {
         _cleanup_free_ char *val = NULL;
         Set *settle_set = userdata;
-        const char *syspath;
+        const char *syspath, *uuid;
 
         assert(dev);
         assert(settle_set);
@@ -78,15 +134,19 @@ static int device_monitor_handler(sd_device_monitor *m, sd_device *dev, void *us
         if (sd_device_get_syspath(dev, &syspath) < 0)
                 return 0;
 
-        if (arg_verbose)
-                printf("settle %s\n", syspath);
-
-        val = set_remove(settle_set, syspath);
+        /* Events we triggered with a synthetic UUID are matched by it, so that other events for the same
+         * device, e.g. ones triggered concurrently by somebody else, are not mistaken for ours. */
+        if (sd_device_get_property_value(dev, "SYNTH_UUID", &uuid) >= 0)
+                val = set_remove(settle_set, uuid);
         if (!val)
-                log_debug("Got epoll event on syspath %s not present in syspath set", syspath);
+                val = set_remove(settle_set, syspath);
+        if (!val) {
+                log_debug("Got uevent for syspath %s not present in settle set", syspath);
+                return 0;
+        }
 
-        if (set_isempty(settle_set))
-                return sd_event_exit(sd_device_monitor_get_event(m), 0);
+        if (arg_verbose)
+                printf("settle %s\n", syspath);
 
         return 0;
 }
@@ -133,6 +193,10 @@ static int help(void) {
                "  -w --settle                       Wait for the triggered events to complete\n"
                "     --wait-daemon[=SECONDS]        Wait for udevd daemon to be initialized\n"
                "                                    before triggering uevents\n"
+               "     --uuid                         Tag the events with a random UUID, and wait\n"
+               "                                    only for them with --settle\n"
+               "     --parallel=N                   Keep at most N triggered events waiting\n"
+               "                                    to be processed by udevd\n"
                , program_invocation_short_name);
 
         return 0;
@@ -142,6 +206,8 @@ int trigger_main(int argc, char *argv[], void *userdata) {
         enum {
                 ARG_NAME = 0x100,
                 ARG_PING,
+                ARG_UUID,
+                ARG_PARALLEL,
         };
 
         static const struct option options[] = {
@@ -160,6 +226,8 @@ int trigger_main(int argc, char *argv[], void *userdata) {
                 { "parent-match",      required_argument, NULL, 'b'      },
                 { "settle",            no_argument,       NULL, 'w'      },
                 { "wait-daemon",       optional_argument, NULL, ARG_PING },
+                { "uuid",              no_argument,       NULL, ARG_UUID },
+                { "parallel",          required_argument, NULL, ARG_PARALLEL },
                 { "version",           no_argument,       NULL, 'V'      },
                 { "help",              no_argument,       NULL, 'h'      },
                 {}
@@ -302,6 +370,16 @@ int trigger_main(int argc, char *argv[], void *userdata) {
                         break;
                 }
 
+                case ARG_UUID:
+                        arg_uuid = true;
+                        break;
+
+                case ARG_PARALLEL:
+                        r = safe_atou(optarg, &arg_parallel);
+                        if (r < 0)
+                                return log_error_errno(r, "Failed to parse --parallel= value '%s': %m", optarg);
+                        break;
+
                 case 'V':
                         return print_version();
                 case 'h':
@@ -341,7 +419,7 @@ int trigger_main(int argc, char *argv[], void *userdata) {
                         return log_error_errno(r, "Failed to add parent match '%s': %m", argv[optind]);
         }
 
-        if (settle) {
+        if (settle || arg_parallel > 0) {
                 settle_set = set_new(&string_hash_ops);
                 if (!settle_set)
                         return log_oom();
@@ -377,14 +455,14 @@ int trigger_main(int argc, char *argv[], void *userdata) {
         default:
                 assert_not_reached("Unknown device type");
         }
-        r = exec_list(e, action, settle_set);
+        r = exec_list(e, action, event, settle_set);
         if (r < 0)
                 return r;
 
-        if (event && !set_isempty(settle_set)) {
-                r = sd_event_loop(event);
+        if (settle) {
+                r = wait_for_settle(event, settle_set, 0);
                 if (r < 0)
-                        return log_error_errno(r, "Event loop failed: %m");
+                        return r;
         }
 
         return 0;
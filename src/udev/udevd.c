@@ -48,6 +48,7 @@
 #include "main-func.h"
 #include "mkdir.h"
 #include "netlink-util.h"
+#include "ordered-set.h"
 #include "parse-util.h"
 #include "pretty-print.h"
 #include "proc-cmdline.h"
@@ -68,6 +69,9 @@
 
 #define WORKER_NUM_MAX 2048U
 
+/* Closing a watched block device makes us rescan its partitions, do not do that more often than this */
+#define SYNTHESIZE_CHANGE_INTERVAL_USEC (500 * USEC_PER_MSEC)
+
 static bool arg_debug = false;
 static int arg_daemonize = false;
 static ResolveNameTiming arg_resolve_name_timing = RESOLVE_NAME_EARLY;
@@ -79,6 +83,7 @@ typedef struct Manager {
         sd_event *event;
         Hashmap *workers;
         LIST_HEAD(struct event, events);
+        Hashmap *events_by_key; /* key → OrderedSet of events in queue order, see event_index() */
         const char *cgroup;
         pid_t pid; /* the process that originally allocated the manager object */
 
@@ -95,12 +100,45 @@ typedef struct Manager {
         sd_event_source *inotify_event;
         sd_event_source *kill_workers_event;
 
+        /* Watches we got inotify events for, wd → Watch, and the timer for the 'change' events held back */
+        Hashmap *watches;
+        sd_event_source *synthesize_change_event;
+
         usec_t last_usec;
 
         bool stop_exec_queue:1;
         bool exit:1;
 } Manager;
 
+/* A device node watched by inotify, as seen by the main process. Watches are added and removed by the workers,
+ * hence the device a watch belongs to is read from /run/udev/watch/ when we first get an event for it, and
+ * remembered until the watch is gone. */
+typedef struct Watch {
+        int wd;
+        char *device_id;
+
+        /* When we last synthesized a 'change' event for the device, and whether another one is due */
+        usec_t last_synthesized;
+        bool pending;
+} Watch;
+
+static Watch *watch_free(Watch *w) {
+        if (!w)
+                return NULL;
+
+        free(w->device_id);
+        return mfree(w);
+}
+
+static void manager_free_watches(Manager *manager) {
+        Watch *w;
+
+        while ((w = hashmap_steal_first(manager->watches)))
+                watch_free(w);
+
+        manager->watches = hashmap_free(manager->watches);
+}
+
 enum event_state {
         EVENT_UNDEF,
         EVENT_QUEUED,
@@ -116,7 +154,7 @@ struct event {
         sd_device *dev_kernel; /* clone of originally received device */
 
         uint64_t seqnum;
-        uint64_t delaying_seqnum;
+        char **index_keys;
 
         sd_event_source *timeout_warning_event;
         sd_event_source *timeout_event;
@@ -145,12 +183,39 @@ struct worker {
 struct worker_message {
 };
 
+static void event_unindex(struct event *event) {
+        char **k;
+
+        assert(event);
+        assert(event->manager);
+
+        STRV_FOREACH(k, event->index_keys) {
+                OrderedSet *s;
+                char *key;
+
+                s = hashmap_get2(event->manager->events_by_key, *k, (void**) &key);
+                if (!s)
+                        continue;
+
+                (void) ordered_set_remove(s, event);
+                if (!ordered_set_isempty(s))
+                        continue;
+
+                (void) hashmap_remove(event->manager->events_by_key, key);
+                ordered_set_free(s);
+                free(key);
+        }
+
+        event->index_keys = strv_free(event->index_keys);
+}
+
 static void event_free(struct event *event) {
         if (!event)
                 return;
 
         assert(event->manager);
 
+        event_unindex(event);
         LIST_REMOVE(event, event->manager->events, event);
         sd_device_unref(event->dev);
         sd_device_unref(event->dev_kernel);
@@ -277,12 +342,17 @@ static void manager_clear_for_worker(Manager *manager) {
 
         manager->inotify_event = sd_event_source_unref(manager->inotify_event);
         manager->kill_workers_event = sd_event_source_unref(manager->kill_workers_event);
+        manager->synthesize_change_event = sd_event_source_unref(manager->synthesize_change_event);
+        manager_free_watches(manager);
 
         manager->event = sd_event_unref(manager->event);
 
         manager->workers = hashmap_free(manager->workers);
         event_queue_cleanup(manager, EVENT_UNDEF);
 
+        assert(hashmap_isempty(manager->events_by_key));
+        manager->events_by_key = hashmap_free(manager->events_by_key);
+
         manager->monitor = sd_device_monitor_unref(manager->monitor);
         manager->ctrl = udev_ctrl_unref(manager->ctrl);
 
@@ -593,6 +663,147 @@ static void event_run(Manager *manager, struct event *event) {
         worker_spawn(manager, event);
 }
 
+static int event_index_add(struct event *event, const char *key) {
+        _cleanup_free_ char *k = NULL;
+        Manager *manager;
+        OrderedSet *s;
+        int r;
+
+        assert(event);
+        assert(key);
+
+        manager = event->manager;
+
+        /* Record the key first, so that event_unindex() cleans up even if we fail below */
+        r = strv_extend(&event->index_keys, key);
+        if (r < 0)
+                return r;
+
+        s = hashmap_get(manager->events_by_key, key);
+        if (!s) {
+                r = hashmap_ensure_allocated(&manager->events_by_key, &string_hash_ops);
+                if (r < 0)
+                        return r;
+
+                k = strdup(key);
+                if (!k)
+                        return -ENOMEM;
+
+                s = ordered_set_new(NULL);
+                if (!s)
+                        return -ENOMEM;
+
+                r = hashmap_put(manager->events_by_key, k, s);
+                if (r < 0) {
+                        ordered_set_free(s);
+                        return r;
+                }
+
+                TAKE_PTR(k);
+        }
+
+        return ordered_set_put(s, event);
+}
+
+static int event_get_index_properties(
+                struct event *event,
+                const char **ret_devpath,
+                const char **ret_devpath_old,
+                char **ret_devnum_key,
+                char **ret_ifindex_key) {
+
+        const char *subsystem, *devpath, *devpath_old = NULL;
+        _cleanup_free_ char *devnum_key = NULL, *ifindex_key = NULL;
+        dev_t devnum = makedev(0, 0);
+        int r, ifindex = 0;
+
+        assert(event);
+
+        r = sd_device_get_subsystem(event->dev, &subsystem);
+        if (r < 0)
+                return r;
+
+        r = sd_device_get_devpath(event->dev, &devpath);
+        if (r < 0)
+                return r;
+
+        r = sd_device_get_property_value(event->dev, "DEVPATH_OLD", &devpath_old);
+        if (r < 0 && r != -ENOENT)
+                return r;
+
+        r = sd_device_get_devnum(event->dev, &devnum);
+        if (r < 0 && r != -ENOENT)
+                return r;
+
+        r = sd_device_get_ifindex(event->dev, &ifindex);
+        if (r < 0 && r != -ENOENT)
+                return r;
+
+        /* Block and other device nodes are different namespaces for device numbers */
+        if (major(devnum) != 0 &&
+            asprintf(&devnum_key, "N%c%u:%u", streq(subsystem, "block") ? 'b' : 'c', major(devnum), minor(devnum)) < 0)
+                return -ENOMEM;
+
+        if (ifindex > 0 && asprintf(&ifindex_key, "I%i", ifindex) < 0)
+                return -ENOMEM;
+
+        *ret_devpath = devpath;
+        *ret_devpath_old = devpath_old;
+        *ret_devnum_key = TAKE_PTR(devnum_key);
+        *ret_ifindex_key = TAKE_PTR(ifindex_key);
+        return 0;
+}
+
+static int event_index(struct event *event) {
+        _cleanup_free_ char *devnum_key = NULL, *ifindex_key = NULL;
+        const char *devpath, *devpath_old;
+        char *p, *slash;
+        int r;
+
+        assert(event);
+
+        /* Events on the same or related devices must be processed in order. To find the events an event
+         * has to wait for without scanning the whole queue, each queued event is filed under:
+         *
+         *   P<devpath>      its own devpath,
+         *   A<devpath>      the devpath of each of its ancestors,
+         *   N<b|c><devnum>  its device number, if it has one,
+         *   I<ifindex>      its network interface index, if it has one.
+         *
+         * See is_device_busy() for the lookup side. */
+
+        r = event_get_index_properties(event, &devpath, &devpath_old, &devnum_key, &ifindex_key);
+        if (r < 0)
+                return r;
+
+        r = event_index_add(event, strjoina("P", devpath));
+        if (r < 0)
+                return r;
+
+        p = strjoina("A", devpath);
+        while ((slash = strrchr(p, '/')) && slash > p + 1) {
+                *slash = '\0';
+
+                r = event_index_add(event, p);
+                if (r < 0)
+                        return r;
+        }
+
+        if (devnum_key) {
+                r = event_index_add(event, devnum_key);
+                if (r < 0)
+                        return r;
+        }
+
+        if (ifindex_key) {
+                r = event_index_add(event, ifindex_key);
+                if (r < 0)
+                        return r;
+        }
+
+        return 0;
+}
+
 static int event_queue_insert(Manager *manager, sd_device *dev) {
         _cleanup_(sd_device_unrefp) sd_device *clone = NULL;
         struct event *event;
@@ -645,6 +856,12 @@ static int event_queue_insert(Manager *manager, sd_device *dev) {
 
         LIST_APPEND(event, manager->events, event);
 
+        r = event_index(event);
+        if (r < 0) {
+                event_free(event);
+                return r;
+        }
+
         log_device_debug(dev, "Device (SEQNUM=%"PRIu64", ACTION=%s) is queued",
                          seqnum, device_action_to_string(action));
 
@@ -667,111 +884,51 @@ static void manager_kill_workers(Manager *manager) {
 }
 
 /* lookup event for identical, parent, child device */
-static int is_device_busy(Manager *manager, struct event *event) {
-        const char *subsystem, *devpath, *devpath_old = NULL;
-        dev_t devnum = makedev(0, 0);
-        struct event *loop_event;
-        size_t devpath_len;
-        int r, ifindex = 0;
-        bool is_block;
-
-        r = sd_device_get_subsystem(event->dev, &subsystem);
-        if (r < 0)
-                return r;
-
-        is_block = streq(subsystem, "block");
-
-        r = sd_device_get_devpath(event->dev, &devpath);
-        if (r < 0)
-                return r;
+static bool event_index_has_earlier(Manager *manager, const char *key, uint64_t seqnum) {
+        struct event *first;
 
-        devpath_len = strlen(devpath);
+        /* Events are queued, and hence indexed, in the order of their sequence numbers, so the first
+         * event filed under a key is the earliest one */
+        first = ordered_set_first(hashmap_get(manager->events_by_key, key));
 
-        r = sd_device_get_property_value(event->dev, "DEVPATH_OLD", &devpath_old);
-        if (r < 0 && r != -ENOENT)
-                return r;
+        return first && first->seqnum < seqnum;
+}
 
-        r = sd_device_get_devnum(event->dev, &devnum);
-        if (r < 0 && r != -ENOENT)
-                return r;
+static int is_device_busy(Manager *manager, struct event *event) {
+        _cleanup_free_ char *devnum_key = NULL, *ifindex_key = NULL;
+        const char *devpath, *devpath_old;
+        char *p, *slash;
+        int r;
 
-        r = sd_device_get_ifindex(event->dev, &ifindex);
-        if (r < 0 && r != -ENOENT)
+        r = event_get_index_properties(event, &devpath, &devpath_old, &devnum_key, &ifindex_key);
+        if (r < 0)
                 return r;
 
-        /* check if queue contains events we depend on */
-        LIST_FOREACH(event, loop_event, manager->events) {
-                size_t loop_devpath_len, common;
-                const char *loop_devpath;
+        /* check if the queue contains earlier events on the same device, a parent or a child device */
+        if (event_index_has_earlier(manager, strjoina("P", devpath), event->seqnum) ||
+            event_index_has_earlier(manager, strjoina("A", devpath), event->seqnum))
+                return true;
 
-                /* we already found a later event, earlier cannot block us, no need to check again */
-                if (loop_event->seqnum < event->delaying_seqnum)
-                        continue;
+        p = strjoina("P", devpath);
+        while ((slash = strrchr(p, '/')) && slash > p + 1) {
+                *slash = '\0';
 
-                /* event we checked earlier still exists, no need to check again */
-                if (loop_event->seqnum == event->delaying_seqnum)
+                if (event_index_has_earlier(manager, p, event->seqnum))
                         return true;
+        }
 
-                /* found ourself, no later event can block us */
-                if (loop_event->seqnum >= event->seqnum)
-                        break;
-
-                /* check major/minor */
-                if (major(devnum) != 0) {
-                        const char *s;
-                        dev_t d;
-
-                        if (sd_device_get_subsystem(loop_event->dev, &s) < 0)
-                                continue;
-
-                        if (sd_device_get_devnum(loop_event->dev, &d) >= 0 &&
-                            devnum == d && is_block == streq(s, "block"))
-                                goto set_delaying_seqnum;
-                }
-
-                /* check network device ifindex */
-                if (ifindex > 0) {
-                        int i;
-
-                        if (sd_device_get_ifindex(loop_event->dev, &i) >= 0 &&
-                            ifindex == i)
-                                goto set_delaying_seqnum;
-                }
-
-                if (sd_device_get_devpath(loop_event->dev, &loop_devpath) < 0)
-                        continue;
-
-                /* check our old name */
-                if (devpath_old && streq(devpath_old, loop_devpath))
-                        goto set_delaying_seqnum;
-
-                loop_devpath_len = strlen(loop_devpath);
-
-                /* compare devpath */
-                common = MIN(devpath_len, loop_devpath_len);
-
-                /* one devpath is contained in the other? */
-                if (!strneq(devpath, loop_devpath, common))
-                        continue;
-
-                /* identical device event found */
-                if (devpath_len == loop_devpath_len)
-                        goto set_delaying_seqnum;
+        /* check major/minor and network device ifindex */
+        if (devnum_key && event_index_has_earlier(manager, devnum_key, event->seqnum))
+                return true;
 
-                /* parent device event found */
-                if (devpath[common] == '/')
-                        goto set_delaying_seqnum;
+        if (ifindex_key && event_index_has_earlier(manager, ifindex_key, event->seqnum))
+                return true;
 
-                /* child device event found */
-                if (loop_devpath[common] == '/')
-                        goto set_delaying_seqnum;
-        }
+        /* check our old name */
+        if (devpath_old && event_index_has_earlier(manager, strjoina("P", devpath_old), event->seqnum))
+                return true;
 
         return false;
-
-set_delaying_seqnum:
-        event->delaying_seqnum = loop_event->seqnum;
-        return true;
 }
 
 static void manager_exit(Manager *manager) {
@@ -814,6 +971,25 @@ static void manager_reload(Manager *manager) {
                    "STATUS=Processing with %u children at max", arg_children_max);
 }
 
+static int on_memory_pressure(sd_event_source *s, void *userdata) {
+        Manager *manager = userdata;
+
+        assert(manager);
+
+        /* While no events are queued, the workers, the rules and the hwdb are all cheap to get back: they
+         * are recreated when the next uevent comes in, just like after a reload */
+        if (LIST_IS_EMPTY(manager->events)) {
+                log_debug("Memory pressure reported, releasing idle workers, rules and hwdb");
+
+                manager_kill_workers(manager);
+                manager->rules = udev_rules_free(manager->rules);
+                udev_builtin_exit();
+        }
+
+        sd_event_trim_memory();
+        return 0;
+}
+
 static int on_kill_workers_event(sd_event_source *s, uint64_t usec, void *userdata) {
         Manager *manager = userdata;
 
@@ -1206,6 +1382,129 @@ static int synthesize_change(sd_device *dev) {
         return 0;
 }
 
+static Watch *manager_get_watch(Manager *manager, int wd) {
+        _cleanup_free_ char *id = NULL;
+        Watch *w;
+        int r;
+
+        assert(manager);
+
+        w = hashmap_get(manager->watches, INT_TO_PTR(wd));
+        if (w)
+                return w;
+
+        r = udev_watch_lookup_id(wd, &id);
+        if (r <= 0)
+                return NULL;
+
+        if (hashmap_ensure_allocated(&manager->watches, NULL) < 0) {
+                log_oom();
+                return NULL;
+        }
+
+        w = new(Watch, 1);
+        if (!w) {
+                log_oom();
+                return NULL;
+        }
+
+        *w = (Watch) {
+                .wd = wd,
+                .device_id = TAKE_PTR(id),
+        };
+
+        if (hashmap_put(manager->watches, INT_TO_PTR(wd), w) < 0) {
+                log_oom();
+                return watch_free(w);
+        }
+
+        return w;
+}
+
+static void manager_synthesize_change(Manager *manager, Watch *w, usec_t usec) {
+        _cleanup_(sd_device_unrefp) sd_device *dev = NULL;
+        const char *devnode;
+
+        assert(manager);
+        assert(w);
+
+        w->pending = false;
+        w->last_synthesized = usec;
+
+        if (sd_device_new_from_device_id(&dev, w->device_id) < 0)
+                return;
+
+        if (sd_device_get_devname(dev, &devnode) < 0)
+                return;
+
+        log_device_debug(dev, "Device %s closed after writing", devnode);
+        (void) synthesize_change(dev);
+}
+
+static int on_synthesize_change(sd_event_source *s, uint64_t usec, void *userdata) {
+        Manager *manager = userdata;
+        usec_t next = USEC_INFINITY;
+        Iterator i;
+        Watch *w;
+
+        assert(manager);
+
+        HASHMAP_FOREACH(w, manager->watches, i) {
+                if (!w->pending)
+                        continue;
+
+                if (usec >= usec_add(w->last_synthesized, SYNTHESIZE_CHANGE_INTERVAL_USEC))
+                        manager_synthesize_change(manager, w, usec);
+                else
+                        next = MIN(next, usec_add(w->last_synthesized, SYNTHESIZE_CHANGE_INTERVAL_USEC));
+        }
+
+        if (next != USEC_INFINITY)
+                (void) event_reset_time(manager->event, &manager->synthesize_change_event, CLOCK_MONOTONIC,
+                                        next, 0, on_synthesize_change, manager, 0, "synthesize-change-event", true);
+
+        return 1;
+}
+
+static void manager_queue_change(Manager *manager, Watch *w) {
+        usec_t usec, when, armed;
+        int r;
+
+        assert(manager);
+        assert(w);
+
+        /* Tools like mkfs or parted may close and reopen a device many times in a row. Every close triggers a
+         * partition rescan, hence synthesize at most one 'change' event per device and interval, and fold all
+         * closes within the interval into a single one at its end. */
+
+        if (w->pending)
+                return;
+
+        assert_se(sd_event_now(manager->event, CLOCK_MONOTONIC, &usec) >= 0);
+
+        when = usec_add(w->last_synthesized, SYNTHESIZE_CHANGE_INTERVAL_USEC);
+        if (w->last_synthesized == 0 || usec >= when) {
+                manager_synthesize_change(manager, w, usec);
+                return;
+        }
+
+        w->pending = true;
+
+        /* Only move the timer if it would fire too late for this watch */
+        if (manager->synthesize_change_event &&
+            sd_event_source_get_enabled(manager->synthesize_change_event, NULL) > 0 &&
+            sd_event_source_get_time(manager->synthesize_change_event, &armed) >= 0 &&
+            armed <= when)
+                return;
+
+        r = event_reset_time(manager->event, &manager->synthesize_change_event, CLOCK_MONOTONIC,
+                             when, 0, on_synthesize_change, manager, 0, "synthesize-change-event", true);
+        if (r < 0) {
+                log_warning_errno(r, "Failed to set up timer for synthesizing 'change' event, synthesizing immediately: %m");
+                manager_synthesize_change(manager, w, usec);
+        }
+}
+
 static int on_inotify(sd_event_source *s, int fd, uint32_t revents, void *userdata) {
         Manager *manager = userdata;
         union inotify_event_buffer buffer;
@@ -1229,19 +1528,26 @@ static int on_inotify(sd_event_source *s, int fd, uint32_t revents, void *userda
 
         FOREACH_INOTIFY_EVENT(e, buffer, l) {
                 _cleanup_(sd_device_unrefp) sd_device *dev = NULL;
-                const char *devnode;
+                Watch *w;
 
-                if (udev_watch_lookup(e->wd, &dev) <= 0)
-                        continue;
+                if (e->mask & IN_CLOSE_WRITE) {
+                        /* Resolve the watch handle from memory, it only hits the file system on the first
+                         * event for each watch */
+                        w = manager_get_watch(manager, e->wd);
+                        if (w)
+                                manager_queue_change(manager, w);
 
-                if (sd_device_get_devname(dev, &devnode) < 0)
-                        continue;
+                } else if (e->mask & IN_IGNORED) {
+                        /* The watch is gone, forget about it. A worker might have already added a new watch
+                         * for the device, hence look up the link, not our copy of it. */
+                        watch_free(hashmap_remove(manager->watches, INT_TO_PTR(e->wd)));
+
+                        if (udev_watch_lookup(e->wd, &dev) <= 0)
+                                continue;
 
-                log_device_debug(dev, "Inotify event: %x for %s", e->mask, devnode);
-                if (e->mask & IN_CLOSE_WRITE)
-                        synthesize_change(dev);
-                else if (e->mask & IN_IGNORED)
+                        log_device_debug(dev, "Inotify watch %i removed", e->wd);
                         udev_watch_end(dev);
+                }
         }
 
         return 1;
@@ -1634,6 +1940,10 @@ static int main_loop(Manager *manager) {
         if (r < 0)
                 return log_error_errno(r, "Failed to create SIGCHLD event source: %m");
 
+        r = sd_event_add_memory_pressure(manager->event, NULL, on_memory_pressure, manager);
+        if (r < 0)
+                log_debug_errno(r, "Failed to watch memory pressure, ignoring: %m");
+
         r = sd_event_set_watchdog(manager->event, true);
         if (r < 0)
                 return log_error_errno(r, "Failed to create watchdog event source: %m");
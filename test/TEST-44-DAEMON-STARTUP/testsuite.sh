@@ -0,0 +1,59 @@
+#!/bin/bash
+set -ex
+set -o pipefail
+
+# Restart each daemon a couple of times, and record how long it takes from the exec() of its main process
+# until it sends READY=1, as well as its resident memory at that point. Both timestamps are taken by PID 1,
+# hence the daemons are measured unmodified. The test fails if a daemon doesn't get ready within the budget.
+
+ITERATIONS=${ITERATIONS:-5}
+BUDGET_USEC=${BUDGET_USEC:-2000000}
+
+RESULTS=/startup-benchmark.txt
+
+printf "%-20s %10s %10s %10s %10s\n" UNIT "MIN(us)" "AVG(us)" "MAX(us)" "RSS(kB)" >$RESULTS
+
+for unit in systemd-journald systemd-udevd systemd-networkd systemd-resolved systemd-logind systemd-timesyncd; do
+    if ! systemctl cat $unit.service >/dev/null 2>&1; then
+        echo "$unit.service not installed, skipping."
+        continue
+    fi
+
+    min=
+    max=0
+    sum=0
+    rss=0
+
+    for ((i = 0; i < ITERATIONS; i++)); do
+        systemctl restart $unit.service
+
+        if [[ "$(systemctl show --value -p ActiveState $unit.service)" != active ]]; then
+            # e.g. timesyncd's ConditionCapability=CAP_SYS_TIME in a container
+            echo "$unit.service did not start, skipping."
+            continue 2
+        fi
+
+        start=$(systemctl show --value -p ExecMainStartTimestampMonotonic $unit.service)
+        ready=$(systemctl show --value -p ActiveEnterTimestampMonotonic $unit.service)
+        pid=$(systemctl show --value -p MainPID $unit.service)
+
+        t=$((ready - start))
+        test $t -ge 0
+        test $t -le $BUDGET_USEC
+
+        [[ -z "$min" || $t -lt $min ]] && min=$t
+        [[ $t -gt $max ]] && max=$t
+        sum=$((sum + t))
+
+        r=$(awk '/^VmRSS:/ { print $2 }' /proc/$pid/status)
+        [[ $r -gt $rss ]] && rss=$r
+    done
+
+    printf "%-20s %10d %10d %10d %10d\n" $unit $min $((sum / ITERATIONS)) $max $rss >>$RESULTS
+done
+
+cat $RESULTS
+
+echo OK > /testok
+
+exit 0